@@ -26,6 +26,7 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/stat.h>
 #include <time.h>
 #include <unistd.h>
 #include <zlib.h>
@@ -50,6 +51,7 @@
 #include <android-base/macros.h>
 #include <android-base/properties.h>
 #include <android-base/stringprintf.h>
+#include <android-base/unique_fd.h>
 
 using namespace android;
 using pdx::default_transport::ServiceUtility;
@@ -969,6 +971,77 @@ static void stopTrace()
     setTracingEnabled(false);
 }
 
+// Whether data can be spliced into fd: the kernel moves it into pipes, sockets
+// and files, except those opened for appending.
+static bool canSpliceTo(int fd)
+{
+    struct stat st;
+    if (fstat(fd, &st) == -1) {
+        return false;
+    }
+    if (!S_ISREG(st.st_mode) && !S_ISFIFO(st.st_mode) && !S_ISSOCK(st.st_mode)) {
+        return false;
+    }
+    int flags = fcntl(fd, F_GETFL);
+    return flags != -1 && (flags & O_APPEND) == 0;
+}
+
+// Move the kernel trace from traceFD to outFd through a pipe with splice(),
+// sparing atrace from copying it to and from user space, until the trace
+// ends or tracing is aborted. Returns false before moving anything if either
+// fd can't be spliced.
+static bool spliceTrace(int traceFD, int outFd)
+{
+    if (!canSpliceTo(outFd)) {
+        return false;
+    }
+    int pipeFds[2];
+    if (pipe2(pipeFds, O_CLOEXEC) == -1) {
+        return false;
+    }
+    android::base::unique_fd pipeIn(pipeFds[0]);
+    android::base::unique_fd pipeOut(pipeFds[1]);
+    // A larger pipe takes bigger bites out of busy trace buffers.
+    constexpr size_t spliceSize = 1024*1024;
+    fcntl(pipeOut, F_SETPIPE_SZ, spliceSize);
+
+    bool spliced = false;
+    while (!g_traceAborted) {
+        ssize_t bytes_in = splice(traceFD, nullptr, pipeOut, nullptr, spliceSize,
+                SPLICE_F_MOVE);
+        if (bytes_in == 0) {
+            break;
+        } else if (bytes_in == -1) {
+            if (errno == EINTR) {
+                continue;
+            }
+            if (!spliced && errno == EINVAL) {
+                return false;
+            }
+            if (!g_traceAborted) {
+                fprintf(stderr, "error splicing trace: %s (%d)\n",
+                        strerror(errno), errno);
+            }
+            break;
+        }
+        spliced = true;
+        while (bytes_in > 0) {
+            ssize_t bytes_out = splice(pipeIn, nullptr, outFd, nullptr, bytes_in,
+                    SPLICE_F_MOVE);
+            if (bytes_out == -1 && errno == EINTR) {
+                continue;
+            }
+            if (bytes_out <= 0) {
+                fprintf(stderr, "error writing trace: %s (%d)\n",
+                        strerror(errno), errno);
+                return true;
+            }
+            bytes_in -= bytes_out;
+        }
+    }
+    return true;
+}
+
 // Read data from the tracing pipe and forward to stdout
 static void streamTrace()
 {
@@ -979,6 +1052,11 @@ static void streamTrace()
                 strerror(errno), errno);
         return;
     }
+    fflush(stdout);
+    if (spliceTrace(traceFD, STDOUT_FILENO)) {
+        close(traceFD);
+        return;
+    }
     while (!g_traceAborted) {
         ssize_t bytes_read = read(traceFD, trace_data, 4096);
         if (bytes_read > 0) {
@@ -992,6 +1070,7 @@ static void streamTrace()
             break;
         }
     }
+    close(traceFD);
 }
 
 // Read the current kernel trace and write it to stdout.
@@ -1081,7 +1160,7 @@ static void dumpTrace(int outFd)
         if (result != Z_OK) {
             fprintf(stderr, "error cleaning up zlib: %d\n", result);
         }
-    } else {
+    } else if (!spliceTrace(traceFD, outFd)) {
         char buf[4096];
         ssize_t rc;
         while ((rc = TEMP_FAILURE_RETRY(read(traceFD, buf, sizeof(buf)))) > 0) {
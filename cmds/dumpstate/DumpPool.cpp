@@ -0,0 +1,182 @@
+/*
+ * Copyright (C) 2019 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#define LOG_TAG "dumpstate"
+
+#include "DumpPool.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <android-base/file.h>
+#include <log/log.h>
+
+#include "DumpstateInternal.h"
+#include "DumpstateSectionReporter.h"
+
+namespace android {
+namespace os {
+namespace dumpstate {
+
+DumpPool::DumpPool(const std::string& tmp_root, sp<android::os::IDumpstateListener> listener,
+                   bool sendReport)
+    : tmp_root_(tmp_root), listener_(listener), sendReport_(sendReport) {
+}
+
+DumpPool::~DumpPool() {
+    shutdown();
+}
+
+void DumpPool::start(int thread_count) {
+    std::lock_guard<std::mutex> lock(lock_);
+    for (int i = static_cast<int>(threads_.size()); i < thread_count; i++) {
+        threads_.emplace_back(&DumpPool::loop, this);
+    }
+}
+
+void DumpPool::shutdown() {
+    {
+        std::lock_guard<std::mutex> lock(lock_);
+        shutting_down_ = true;
+    }
+    work_cv_.notify_all();
+    for (auto& thread : threads_) {
+        thread.join();
+    }
+
+    std::lock_guard<std::mutex> lock(lock_);
+    threads_.clear();
+    if (!tasks_.empty()) {
+        MYLOGD("Dropping %zu dump tasks never waited for\n", tasks_.size());
+    }
+    tasks_.clear();
+    queue_.clear();
+    shutting_down_ = false;
+}
+
+void DumpPool::enqueueTask(const std::string& name, Task task) {
+    {
+        std::lock_guard<std::mutex> lock(lock_);
+        if (tasks_.count(name) != 0) {
+            MYLOGE("Dump task %s is already enqueued\n", name.c_str());
+            return;
+        }
+        auto state = std::make_shared<TaskState>();
+        state->task = std::move(task);
+        tasks_[name] = state;
+        queue_.push_back(name);
+    }
+    work_cv_.notify_one();
+}
+
+bool DumpPool::waitForTask(const std::string& name, int out_fd) {
+    std::unique_lock<std::mutex> lock(lock_);
+    auto it = tasks_.find(name);
+    if (it == tasks_.end()) {
+        MYLOGE("Dump task %s was never enqueued\n", name.c_str());
+        return false;
+    }
+    std::shared_ptr<TaskState> state = it->second;
+    tasks_.erase(it);
+
+    done_cv_.wait(lock, [&state] { return state->done || !state->started; });
+    if (!state->started) {
+        // No thread got to it, or the one which did couldn't.
+        state->started = true;
+        lock.unlock();
+        run(name, state->task, out_fd);
+        return true;
+    }
+    lock.unlock();
+
+    if (lseek(state->output, 0, SEEK_SET) != 0) {
+        MYLOGE("Failed to rewind the output of dump task %s: %s\n", name.c_str(), strerror(errno));
+        return true;
+    }
+    char buf[65536];
+    ssize_t byte_count;
+    while ((byte_count = TEMP_FAILURE_RETRY(read(state->output, buf, sizeof(buf)))) > 0) {
+        if (!android::base::WriteFully(out_fd, buf, byte_count)) {
+            MYLOGE("Failed to write the output of dump task %s: %s\n", name.c_str(),
+                   strerror(errno));
+            break;
+        }
+    }
+    return true;
+}
+
+void DumpPool::loop() {
+    std::unique_lock<std::mutex> lock(lock_);
+    while (true) {
+        work_cv_.wait(lock, [this] { return shutting_down_ || !queue_.empty(); });
+        if (shutting_down_) {
+            return;
+        }
+        std::string name = std::move(queue_.front());
+        queue_.pop_front();
+        auto it = tasks_.find(name);
+        if (it == tasks_.end() || it->second->started) {
+            continue;
+        }
+        std::shared_ptr<TaskState> state = it->second;
+        state->started = true;
+        lock.unlock();
+
+        android::base::unique_fd output = createTempFile();
+        if (output < 0) {
+            // Left for the thread waiting for it to run.
+            lock.lock();
+            state->started = false;
+            done_cv_.notify_all();
+            continue;
+        }
+        run(name, state->task, output);
+
+        lock.lock();
+        state->output = std::move(output);
+        state->done = true;
+        done_cv_.notify_all();
+    }
+}
+
+void DumpPool::run(const std::string& name, const Task& task, int out_fd) {
+    DumpstateSectionReporter section_reporter(name, listener_, sendReport_);
+    off_t start = lseek(out_fd, 0, SEEK_CUR);
+    task(out_fd);
+    off_t end = lseek(out_fd, 0, SEEK_CUR);
+    if (start >= 0 && end >= start) {
+        section_reporter.setSize(static_cast<int>(end - start));
+    }
+}
+
+android::base::unique_fd DumpPool::createTempFile() {
+    std::string path = tmp_root_ + "/dumptask-XXXXXX";
+    android::base::unique_fd fd(mkostemp(&path[0], O_CLOEXEC));
+    if (fd < 0) {
+        MYLOGE("Failed to create a temporary file in %s: %s\n", tmp_root_.c_str(),
+               strerror(errno));
+        return fd;
+    }
+    // Only the descriptor is needed, and nothing is left behind if dumpstate dies.
+    unlink(path.c_str());
+    return fd;
+}
+
+}  // namespace dumpstate
+}  // namespace os
+}  // namespace android
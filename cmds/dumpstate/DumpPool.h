@@ -0,0 +1,115 @@
+/*
+ * Copyright (C) 2019 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef ANDROID_OS_DUMPPOOL_H_
+#define ANDROID_OS_DUMPPOOL_H_
+
+#include <unistd.h>
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <android-base/macros.h>
+#include <android-base/unique_fd.h>
+#include <android/os/IDumpstateListener.h>
+#include <utils/StrongPointer.h>
+
+namespace android {
+namespace os {
+namespace dumpstate {
+
+/*
+ * Runs independent sections of a bugreport on a few worker threads. Each section writes into a
+ * temporary file of its own, which is copied to the output when the section is waited for, so
+ * sections show up in the order they are waited for, whatever order they complete in.
+ *
+ * Sections the threads haven't started yet are run by the thread waiting for them, and all of
+ * them are when the pool isn't started, so the output is the same either way.
+ *
+ * Typical usage:
+ *
+ *    DumpPool pool(tmp_dir, listener, sendReport);
+ *    pool.start();
+ *    pool.enqueueTask("CHECKIN", [](int out_fd) { ... });
+ *    ...
+ *    pool.waitForTask("CHECKIN");
+ *
+ */
+class DumpPool {
+  public:
+    // Writes a section to out_fd. Runs concurrently with other tasks and the rest of dumpstate.
+    using Task = std::function<void(int out_fd)>;
+
+    static constexpr int kDefaultThreadCount = 4;
+
+    // Temporary files are created in tmp_root. Every task is reported to listener as a section,
+    // when sendReport is set.
+    DumpPool(const std::string& tmp_root, sp<android::os::IDumpstateListener> listener,
+             bool sendReport);
+
+    ~DumpPool();
+
+    void start(int thread_count = kDefaultThreadCount);
+
+    // Stops the threads once they finish the tasks they run, and drops the tasks not yet waited
+    // for.
+    void shutdown();
+
+    void enqueueTask(const std::string& name, Task task);
+
+    // Waits for the task to be done, or runs it if it wasn't started, and writes its output to
+    // out_fd. Returns false if there is no such task.
+    bool waitForTask(const std::string& name, int out_fd = STDOUT_FILENO);
+
+  private:
+    struct TaskState {
+        Task task;
+        bool started = false;
+        bool done = false;
+        android::base::unique_fd output;
+    };
+
+    void loop();
+    void run(const std::string& name, const Task& task, int out_fd);
+    android::base::unique_fd createTempFile();
+
+    const std::string tmp_root_;
+    const android::sp<android::os::IDumpstateListener> listener_;
+    const bool sendReport_;
+
+    std::mutex lock_;
+    std::condition_variable work_cv_;
+    std::condition_variable done_cv_;
+    std::deque<std::string> queue_;
+    std::map<std::string, std::shared_ptr<TaskState>> tasks_;
+    std::vector<std::thread> threads_;
+    bool shutting_down_ = false;
+
+    DISALLOW_COPY_AND_ASSIGN(DumpPool);
+};
+
+}  // namespace dumpstate
+}  // namespace os
+}  // namespace android
+
+#endif  // ANDROID_OS_DUMPPOOL_H_
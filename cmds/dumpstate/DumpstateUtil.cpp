@@ -24,6 +24,7 @@
 #include <sys/wait.h>
 #include <unistd.h>
 
+#include <algorithm>
 #include <vector>
 
 #include <android-base/file.h>
@@ -43,6 +44,10 @@ namespace {
 
 static constexpr const char* kSuPath = "/system/xbin/su";
 
+// Commands may run on several threads at once, and any of them may consume the SIGCHLD of
+// another's child, so children are also polled at this interval.
+static constexpr int kChildPollIntervalMs = 50;
+
 static bool waitpid_with_timeout(pid_t pid, int timeout_ms, int* status) {
     sigset_t child_mask, old_mask;
     sigemptyset(&child_mask);
@@ -53,39 +58,43 @@ static bool waitpid_with_timeout(pid_t pid, int timeout_ms, int* status) {
         return false;
     }
 
-    timespec ts;
-    ts.tv_sec = MSEC_TO_SEC(timeout_ms);
-    ts.tv_nsec = (timeout_ms % 1000) * 1000000;
-    int ret = TEMP_FAILURE_RETRY(sigtimedwait(&child_mask, nullptr, &ts));
-    int saved_errno = errno;
-
-    // Set the signals back the way they were.
-    if (sigprocmask(SIG_SETMASK, &old_mask, nullptr) == -1) {
-        printf("*** sigprocmask failed: %s\n", strerror(errno));
-        if (ret == 0) {
-            return false;
+    bool exited = false;
+    const uint64_t deadline = Nanotime() + static_cast<uint64_t>(timeout_ms) * 1000000;
+    while (true) {
+        pid_t child_pid = TEMP_FAILURE_RETRY(waitpid(pid, status, WNOHANG));
+        if (child_pid == pid) {
+            exited = true;
+            break;
         }
-    }
-    if (ret == -1) {
-        errno = saved_errno;
-        if (errno == EAGAIN) {
+        if (child_pid == -1) {
+            printf("*** waitpid failed: %s\n", strerror(errno));
+            break;
+        }
+
+        const uint64_t now = Nanotime();
+        if (now >= deadline) {
             errno = ETIMEDOUT;
-        } else {
+            break;
+        }
+        const uint64_t wait_ns =
+            std::min(deadline - now, static_cast<uint64_t>(kChildPollIntervalMs) * 1000000);
+        timespec ts;
+        ts.tv_sec = wait_ns / NANOS_PER_SEC;
+        ts.tv_nsec = wait_ns % NANOS_PER_SEC;
+        if (TEMP_FAILURE_RETRY(sigtimedwait(&child_mask, nullptr, &ts)) == -1 &&
+            errno != EAGAIN) {
             printf("*** sigtimedwait failed: %s\n", strerror(errno));
+            break;
         }
-        return false;
     }
+    int saved_errno = errno;
 
-    pid_t child_pid = waitpid(pid, status, WNOHANG);
-    if (child_pid != pid) {
-        if (child_pid != -1) {
-            printf("*** Waiting for pid %d, got pid %d instead\n", pid, child_pid);
-        } else {
-            printf("*** waitpid failed: %s\n", strerror(errno));
-        }
-        return false;
+    // Set the signals back the way they were.
+    if (sigprocmask(SIG_SETMASK, &old_mask, nullptr) == -1) {
+        printf("*** sigprocmask failed: %s\n", strerror(errno));
     }
-    return true;
+    errno = saved_errno;
+    return exited;
 }
 }  // unnamed namespace
 
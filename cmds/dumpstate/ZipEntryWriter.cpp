@@ -0,0 +1,97 @@
+/*
+ * Copyright (C) 2019 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "ZipEntryWriter.h"
+
+namespace android {
+namespace os {
+namespace dumpstate {
+
+ZipEntryWriter::ZipEntryWriter(ZipWriter* zip_writer)
+    : zip_writer_(zip_writer), chunks_(kChunkCount, std::vector<uint8_t>(kChunkSize)) {
+    for (auto& chunk : chunks_) {
+        free_.push_back(&chunk);
+    }
+    thread_ = std::thread(&ZipEntryWriter::Loop, this);
+}
+
+ZipEntryWriter::~ZipEntryWriter() {
+    {
+        std::lock_guard<std::mutex> lock(lock_);
+        aborting_ = true;
+    }
+    Stop();
+}
+
+std::vector<uint8_t>* ZipEntryWriter::GetChunk() {
+    std::unique_lock<std::mutex> lock(lock_);
+    free_cv_.wait(lock, [this] { return err_ != 0 || !free_.empty(); });
+    if (err_ != 0) {
+        return nullptr;
+    }
+    std::vector<uint8_t>* chunk = free_.back();
+    free_.pop_back();
+    return chunk;
+}
+
+void ZipEntryWriter::QueueChunk(std::vector<uint8_t>* chunk, size_t size) {
+    {
+        std::lock_guard<std::mutex> lock(lock_);
+        queue_.emplace_back(chunk, size);
+    }
+    queued_cv_.notify_one();
+}
+
+int32_t ZipEntryWriter::Finish() {
+    {
+        std::lock_guard<std::mutex> lock(lock_);
+        finishing_ = true;
+    }
+    Stop();
+    std::lock_guard<std::mutex> lock(lock_);
+    return err_;
+}
+
+void ZipEntryWriter::Stop() {
+    queued_cv_.notify_one();
+    if (thread_.joinable()) {
+        thread_.join();
+    }
+}
+
+void ZipEntryWriter::Loop() {
+    std::unique_lock<std::mutex> lock(lock_);
+    while (true) {
+        queued_cv_.wait(lock, [this] { return aborting_ || finishing_ || !queue_.empty(); });
+        if (aborting_ || queue_.empty()) {
+            return;
+        }
+        auto chunk = queue_.front();
+        queue_.pop_front();
+        if (err_ == 0) {
+            lock.unlock();
+            int32_t err = zip_writer_->WriteBytes(chunk.first->data(), chunk.second);
+            lock.lock();
+            err_ = err;
+        }
+        free_.push_back(chunk.first);
+        free_cv_.notify_one();
+    }
+}
+
+}  // namespace dumpstate
+}  // namespace os
+}  // namespace android
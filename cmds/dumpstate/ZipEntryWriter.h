@@ -0,0 +1,100 @@
+/*
+ * Copyright (C) 2019 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef ANDROID_OS_ZIPENTRYWRITER_H_
+#define ANDROID_OS_ZIPENTRYWRITER_H_
+
+#include <stdint.h>
+
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include <android-base/macros.h>
+#include <ziparchive/zip_writer.h>
+
+namespace android {
+namespace os {
+namespace dumpstate {
+
+/*
+ * Compresses the data of a zip entry on a thread of its own, from the chunks the calling thread
+ * reads, so that reading a chunk overlaps with deflating the previous ones.
+ *
+ * The entry is started and finished by the caller, and nothing else may use the ZipWriter
+ * between the creation of the ZipEntryWriter and the return of Finish().
+ *
+ * Typical usage:
+ *
+ *    ZipEntryWriter entry_writer(zip_writer);
+ *    std::vector<uint8_t>* chunk;
+ *    while ((chunk = entry_writer.GetChunk()) != nullptr) {
+ *        ssize_t bytes_read = read(fd, chunk->data(), chunk->size());
+ *        ...
+ *        entry_writer.QueueChunk(chunk, bytes_read);
+ *    }
+ *    int32_t err = entry_writer.Finish();
+ *
+ */
+class ZipEntryWriter {
+  public:
+    static constexpr size_t kChunkSize = 65536;
+    static constexpr size_t kChunkCount = 4;
+
+    explicit ZipEntryWriter(ZipWriter* zip_writer);
+
+    // Stops compressing, dropping the chunks still queued, unless Finish() was called.
+    ~ZipEntryWriter();
+
+    // Returns a chunk to read into, waiting for one to be compressed when they are all queued,
+    // or nullptr once compressing failed.
+    std::vector<uint8_t>* GetChunk();
+
+    // Queues the first size bytes of a chunk returned by GetChunk() to be compressed.
+    void QueueChunk(std::vector<uint8_t>* chunk, size_t size);
+
+    // Waits for the queued chunks to be compressed, and returns the first error from
+    // ZipWriter::WriteBytes(), or 0.
+    int32_t Finish();
+
+  private:
+    void Loop();
+    void Stop();
+
+    ZipWriter* const zip_writer_;
+    std::vector<std::vector<uint8_t>> chunks_;
+
+    std::mutex lock_;
+    std::condition_variable queued_cv_;
+    std::condition_variable free_cv_;
+    std::deque<std::pair<std::vector<uint8_t>*, size_t>> queue_;
+    std::vector<std::vector<uint8_t>*> free_;
+    int32_t err_ = 0;
+    bool finishing_ = false;
+    bool aborting_ = false;
+    std::thread thread_;
+
+    DISALLOW_COPY_AND_ASSIGN(ZipEntryWriter);
+};
+
+}  // namespace dumpstate
+}  // namespace os
+}  // namespace android
+
+#endif  // ANDROID_OS_ZIPENTRYWRITER_H_
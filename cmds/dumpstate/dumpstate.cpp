@@ -34,6 +34,8 @@
 #include <sys/wait.h>
 #include <unistd.h>
 
+#include <algorithm>
+#include <atomic>
 #include <chrono>
 #include <fstream>
 #include <functional>
@@ -42,6 +44,7 @@
 #include <regex>
 #include <set>
 #include <string>
+#include <thread>
 #include <utility>
 #include <vector>
 
@@ -68,8 +71,10 @@
 #include <serviceutils/PriorityDumper.h>
 #include <utils/StrongPointer.h>
 #include "DumpstateInternal.h"
+#include "DumpPool.h"
 #include "DumpstateSectionReporter.h"
 #include "DumpstateService.h"
+#include "ZipEntryWriter.h"
 #include "dumpstate.h"
 
 using ::android::hardware::dumpstate::V1_0::IDumpstateDevice;
@@ -93,9 +98,11 @@ using android::base::StringPrintf;
 using android::os::IDumpstateListener;
 using android::os::dumpstate::CommandOptions;
 using android::os::dumpstate::DumpFileToFd;
+using android::os::dumpstate::DumpPool;
 using android::os::dumpstate::DumpstateSectionReporter;
 using android::os::dumpstate::GetPidByName;
 using android::os::dumpstate::PropertiesHelper;
+using android::os::dumpstate::ZipEntryWriter;
 
 typedef Dumpstate::ConsentCallback::ConsentResult UserConsentResult;
 
@@ -248,6 +255,85 @@ static int DumpFile(const std::string& title, const std::string& path) {
     return ds.DumpFile(title, path);
 }
 
+// The framework dumpsys sections which mostly wait on other processes, and so can run on the pool
+// while the rest of the bugreport is dumped. They are still written in their usual place.
+struct PooledDumpsysSection {
+    std::string title;
+    std::vector<std::string> args;
+    CommandOptions options;
+};
+
+static const std::vector<PooledDumpsysSection>& GetPooledDumpsysSections() {
+    // The following dumpsys internally collects output from running apps, so it can take a long
+    // time. So let's extend the timeout.
+    static const CommandOptions DUMPSYS_COMPONENTS_OPTIONS =
+        CommandOptions::WithTimeout(60).Build();
+    static const std::vector<PooledDumpsysSection> sections = {
+        {"CHECKIN BATTERYSTATS", {"batterystats", "-c"}, Dumpstate::DEFAULT_DUMPSYS},
+        {"CHECKIN MEMINFO", {"meminfo", "--checkin"}, Dumpstate::DEFAULT_DUMPSYS},
+        {"CHECKIN NETSTATS", {"netstats", "--checkin"}, Dumpstate::DEFAULT_DUMPSYS},
+        {"CHECKIN PROCSTATS", {"procstats", "-c"}, Dumpstate::DEFAULT_DUMPSYS},
+        {"CHECKIN USAGESTATS", {"usagestats", "-c"}, Dumpstate::DEFAULT_DUMPSYS},
+        {"CHECKIN PACKAGE", {"package", "--checkin"}, Dumpstate::DEFAULT_DUMPSYS},
+        {"APP ACTIVITIES", {"activity", "-v", "all"}, DUMPSYS_COMPONENTS_OPTIONS},
+        {"APP SERVICES PLATFORM", {"activity", "service", "all-platform-non-critical"},
+         DUMPSYS_COMPONENTS_OPTIONS},
+        {"APP SERVICES NON-PLATFORM", {"activity", "service", "all-non-platform"},
+         DUMPSYS_COMPONENTS_OPTIONS},
+        {"APP PROVIDERS PLATFORM", {"activity", "provider", "all-platform"},
+         DUMPSYS_COMPONENTS_OPTIONS},
+        {"APP PROVIDERS NON-PLATFORM", {"activity", "provider", "all-non-platform"},
+         DUMPSYS_COMPONENTS_OPTIONS},
+        {"DROPBOX SYSTEM SERVER CRASHES", {"dropbox", "-p", "system_server_crash"},
+         Dumpstate::DEFAULT_DUMPSYS},
+        {"DROPBOX SYSTEM APP CRASHES", {"dropbox", "-p", "system_app_crash"},
+         Dumpstate::DEFAULT_DUMPSYS},
+    };
+    return sections;
+}
+
+// Starts the pooled dumpsys sections, but only once the user has consented to sharing the
+// bugreport, or when no consent is needed, so that nothing runs in the background before that. It
+// is tried again at a few points of dumpstate(), as consent comes in. Sections are only written to
+// the output by WaitForDumpsys(), and only to the fd they're given until then, so unlike
+// RunDumpsys() they don't report their duration or progress.
+static void MaybeEnqueuePooledDumpsys(DumpPool* pool, bool* enqueued) {
+    if (*enqueued || !ds.IsUserConsentGranted()) {
+        return;
+    }
+    *enqueued = true;
+    for (const PooledDumpsysSection& section : GetPooledDumpsysSections()) {
+        std::vector<std::string> dumpsys = {"/system/bin/dumpsys", "-T",
+                                            std::to_string(section.options.TimeoutInMs())};
+        dumpsys.insert(dumpsys.end(), section.args.begin(), section.args.end());
+        pool->enqueueTask(section.title, [section, dumpsys](int out_fd) {
+            // Sections not started by the time consent is denied are cancelled.
+            if (ds.IsUserConsentDenied()) {
+                return;
+            }
+            RunCommandToFd(out_fd, section.title, dumpsys, section.options);
+        });
+    }
+}
+
+// Writes a pooled dumpsys section: waits for it when it was enqueued, runs it like RunDumpsys()
+// otherwise.
+static void WaitForDumpsys(DumpPool* pool, bool enqueued, const std::string& title) {
+    const std::vector<PooledDumpsysSection>& sections = GetPooledDumpsysSections();
+    auto section =
+        std::find_if(sections.begin(), sections.end(),
+                     [&title](const auto& candidate) { return candidate.title == title; });
+    if (section == sections.end()) {
+        MYLOGE("Unknown pooled dumpsys section %s\n", title.c_str());
+        return;
+    }
+    if (enqueued && pool->waitForTask(title)) {
+        ds.UpdateProgress(section->options.Timeout());
+    } else {
+        RunDumpsys(section->title, section->args, section->options);
+    }
+}
+
 // Relative directory (inside the zip) for all files copied as-is into the bugreport.
 static const std::string ZIP_ROOT_DIR = "FS";
 
@@ -264,6 +350,7 @@ static constexpr char PROPERTY_LAST_ID[] = "dumpstate.last_id";
 static constexpr char PROPERTY_VERSION[] = "dumpstate.version";
 static constexpr char PROPERTY_EXTRA_TITLE[] = "dumpstate.options.title";
 static constexpr char PROPERTY_EXTRA_DESCRIPTION[] = "dumpstate.options.description";
+static constexpr char PROPERTY_PARALLEL_RUN[] = "dumpstate.parallel_run";
 
 static const CommandOptions AS_ROOT_20 = CommandOptions::WithTimeout(20).AsRoot().Build();
 
@@ -837,7 +924,10 @@ status_t Dumpstate::AddZipEntryFromFd(const std::string& entry_name, int fd,
     auto end = start + timeout;
     struct pollfd pfd = {fd, POLLIN};
 
-    std::vector<uint8_t> buffer(65536);
+    // Small entries are compressed inline, and larger ones by an entry writer once the first
+    // chunk has been compressed, so that reading the rest overlaps with deflating it.
+    std::vector<uint8_t> buffer(ZipEntryWriter::kChunkSize);
+    std::unique_ptr<ZipEntryWriter> entry_writer;
     while (1) {
         if (timeout.count() > 0) {
             // lambda to recalculate the timeout.
@@ -859,18 +949,39 @@ status_t Dumpstate::AddZipEntryFromFd(const std::string& entry_name, int fd,
             }
         }
 
-        ssize_t bytes_read = TEMP_FAILURE_RETRY(read(fd, buffer.data(), buffer.size()));
+        std::vector<uint8_t>* chunk = entry_writer ? entry_writer->GetChunk() : &buffer;
+        if (chunk == nullptr) {
+            err = entry_writer->Finish();
+            MYLOGE("zip_writer_->WriteBytes(): %s\n", ZipWriter::ErrorCodeString(err));
+            return UNKNOWN_ERROR;
+        }
+        ssize_t bytes_read = TEMP_FAILURE_RETRY(read(fd, chunk->data(), chunk->size()));
         if (bytes_read == 0) {
             break;
         } else if (bytes_read == -1) {
             MYLOGE("read(%s): %s\n", entry_name.c_str(), strerror(errno));
             return -errno;
         }
+        if (entry_writer) {
+            entry_writer->QueueChunk(chunk, bytes_read);
+            continue;
+        }
         err = zip_writer_->WriteBytes(buffer.data(), bytes_read);
         if (err) {
             MYLOGE("zip_writer_->WriteBytes(): %s\n", ZipWriter::ErrorCodeString(err));
             return UNKNOWN_ERROR;
         }
+        if (static_cast<size_t>(bytes_read) == buffer.size()) {
+            entry_writer.reset(new ZipEntryWriter(zip_writer_.get()));
+        }
+    }
+    if (entry_writer) {
+        err = entry_writer->Finish();
+        entry_writer.reset();
+        if (err) {
+            MYLOGE("zip_writer_->WriteBytes(): %s\n", ZipWriter::ErrorCodeString(err));
+            return UNKNOWN_ERROR;
+        }
     }
 
     err = zip_writer_->FinishEntry();
@@ -1321,6 +1432,15 @@ static void DumpHals() {
 static Dumpstate::RunStatus dumpstate() {
     DurationReporter duration_reporter("DUMPSTATE");
 
+    // Any pooled section still queued when dumpstate() returns, e.g. as consent was denied, is
+    // dropped with the pool.
+    DumpPool dump_pool(ds.bugreport_internal_dir_, ds.listener_, ds.report_section_);
+    if (android::base::GetBoolProperty(PROPERTY_PARALLEL_RUN, true)) {
+        dump_pool.start();
+    }
+    bool pooled_dumpsys_enqueued = false;
+    MaybeEnqueuePooledDumpsys(&dump_pool, &pooled_dumpsys_enqueued);
+
     // Dump various things. Note that anything that takes "long" (i.e. several seconds) should
     // check intermittently (if it's intrerruptable like a foreach on pids) and/or should be wrapped
     // in a consent check (via RUN_SLOW_FUNCTION_WITH_CONSENT_CHECK).
@@ -1374,6 +1494,8 @@ static Dumpstate::RunStatus dumpstate() {
 
     RUN_SLOW_FUNCTION_WITH_CONSENT_CHECK(for_each_pid, do_showmap, "SMAPS OF ALL PROCESSES");
 
+    MaybeEnqueuePooledDumpsys(&dump_pool, &pooled_dumpsys_enqueued);
+
     for_each_tid(show_wchan, "BLOCKED PROCESS WAIT-CHANNELS");
     for_each_pid(show_showtime, "PROCESS TIMES (pid cmd user system iowait+percentage)");
 
@@ -1413,6 +1535,8 @@ static Dumpstate::RunStatus dumpstate() {
 
     RUN_SLOW_FUNCTION_WITH_CONSENT_CHECK(RunDumpsysHigh);
 
+    MaybeEnqueuePooledDumpsys(&dump_pool, &pooled_dumpsys_enqueued);
+
     RunCommand("SYSTEM PROPERTIES", {"getprop"});
 
     RunCommand("STORAGED IO INFO", {"storaged", "-u", "-p"});
@@ -1454,66 +1578,60 @@ static Dumpstate::RunStatus dumpstate() {
     printf("== Android Framework Services\n");
     printf("========================================================\n");
 
+    MaybeEnqueuePooledDumpsys(&dump_pool, &pooled_dumpsys_enqueued);
+
     RUN_SLOW_FUNCTION_WITH_CONSENT_CHECK(RunDumpsysNormal);
 
     printf("========================================================\n");
     printf("== Checkins\n");
     printf("========================================================\n");
 
-    RunDumpsys("CHECKIN BATTERYSTATS", {"batterystats", "-c"});
+    WaitForDumpsys(&dump_pool, pooled_dumpsys_enqueued, "CHECKIN BATTERYSTATS");
 
-    RUN_SLOW_FUNCTION_WITH_CONSENT_CHECK(RunDumpsys, "CHECKIN MEMINFO", {"meminfo", "--checkin"});
+    RUN_SLOW_FUNCTION_WITH_CONSENT_CHECK(WaitForDumpsys, &dump_pool, pooled_dumpsys_enqueued,
+                                         "CHECKIN MEMINFO");
 
-    RunDumpsys("CHECKIN NETSTATS", {"netstats", "--checkin"});
-    RunDumpsys("CHECKIN PROCSTATS", {"procstats", "-c"});
-    RunDumpsys("CHECKIN USAGESTATS", {"usagestats", "-c"});
-    RunDumpsys("CHECKIN PACKAGE", {"package", "--checkin"});
+    WaitForDumpsys(&dump_pool, pooled_dumpsys_enqueued, "CHECKIN NETSTATS");
+    WaitForDumpsys(&dump_pool, pooled_dumpsys_enqueued, "CHECKIN PROCSTATS");
+    WaitForDumpsys(&dump_pool, pooled_dumpsys_enqueued, "CHECKIN USAGESTATS");
+    WaitForDumpsys(&dump_pool, pooled_dumpsys_enqueued, "CHECKIN PACKAGE");
 
     printf("========================================================\n");
     printf("== Running Application Activities\n");
     printf("========================================================\n");
 
-    // The following dumpsys internally collects output from running apps, so it can take a long
-    // time. So let's extend the timeout.
-
-    const CommandOptions DUMPSYS_COMPONENTS_OPTIONS = CommandOptions::WithTimeout(60).Build();
-
-    RunDumpsys("APP ACTIVITIES", {"activity", "-v", "all"}, DUMPSYS_COMPONENTS_OPTIONS);
+    WaitForDumpsys(&dump_pool, pooled_dumpsys_enqueued, "APP ACTIVITIES");
 
     printf("========================================================\n");
     printf("== Running Application Services (platform)\n");
     printf("========================================================\n");
 
-    RunDumpsys("APP SERVICES PLATFORM", {"activity", "service", "all-platform-non-critical"},
-            DUMPSYS_COMPONENTS_OPTIONS);
+    WaitForDumpsys(&dump_pool, pooled_dumpsys_enqueued, "APP SERVICES PLATFORM");
 
     printf("========================================================\n");
     printf("== Running Application Services (non-platform)\n");
     printf("========================================================\n");
 
-    RunDumpsys("APP SERVICES NON-PLATFORM", {"activity", "service", "all-non-platform"},
-            DUMPSYS_COMPONENTS_OPTIONS);
+    WaitForDumpsys(&dump_pool, pooled_dumpsys_enqueued, "APP SERVICES NON-PLATFORM");
 
     printf("========================================================\n");
     printf("== Running Application Providers (platform)\n");
     printf("========================================================\n");
 
-    RunDumpsys("APP PROVIDERS PLATFORM", {"activity", "provider", "all-platform"},
-            DUMPSYS_COMPONENTS_OPTIONS);
+    WaitForDumpsys(&dump_pool, pooled_dumpsys_enqueued, "APP PROVIDERS PLATFORM");
 
     printf("========================================================\n");
     printf("== Running Application Providers (non-platform)\n");
     printf("========================================================\n");
 
-    RunDumpsys("APP PROVIDERS NON-PLATFORM", {"activity", "provider", "all-non-platform"},
-            DUMPSYS_COMPONENTS_OPTIONS);
+    WaitForDumpsys(&dump_pool, pooled_dumpsys_enqueued, "APP PROVIDERS NON-PLATFORM");
 
     printf("========================================================\n");
     printf("== Dropbox crashes\n");
     printf("========================================================\n");
 
-    RunDumpsys("DROPBOX SYSTEM SERVER CRASHES", {"dropbox", "-p", "system_server_crash"});
-    RunDumpsys("DROPBOX SYSTEM APP CRASHES", {"dropbox", "-p", "system_app_crash"});
+    WaitForDumpsys(&dump_pool, pooled_dumpsys_enqueued, "DROPBOX SYSTEM SERVER CRASHES");
+    WaitForDumpsys(&dump_pool, pooled_dumpsys_enqueued, "DROPBOX SYSTEM APP CRASHES");
 
     printf("========================================================\n");
     printf("== Final progress (pid %d): %d/%d (estimated %d)\n", ds.pid_, ds.progress_->Get(),
@@ -1681,6 +1799,41 @@ static void DumpstateWifiOnly() {
     printf("========================================================\n");
 }
 
+// Processes whose stacks are dumped at the same time by DumpTraces().
+static constexpr size_t kMaxConcurrentStackDumps = 4;
+
+namespace {
+
+// The stacks of a process, dumped into a temporary file of their own.
+struct StackDump {
+    StackDump(int pid, bool is_java_process) : pid(pid), is_java_process(is_java_process) {
+    }
+
+    int pid;
+    bool is_java_process;
+    android::base::unique_fd fd;
+    bool dumped = false;
+    int ret = -1;
+    uint64_t elapsed = 0;
+};
+
+}  // namespace
+
+static void AppendStackDump(int dump_fd, int out_fd) {
+    if (lseek(dump_fd, 0, SEEK_SET) != 0) {
+        MYLOGE("Failed to rewind stack dump: %s\n", strerror(errno));
+        return;
+    }
+    char buffer[65536];
+    ssize_t bytes_read;
+    while ((bytes_read = TEMP_FAILURE_RETRY(read(dump_fd, buffer, sizeof(buffer)))) > 0) {
+        if (!android::base::WriteFully(out_fd, buffer, bytes_read)) {
+            MYLOGE("Failed to append stack dump: %s\n", strerror(errno));
+            return;
+        }
+    }
+}
+
 Dumpstate::RunStatus Dumpstate::DumpTraces(const char** path) {
     DurationReporter duration_reporter("DUMP TRACES");
 
@@ -1716,10 +1869,8 @@ Dumpstate::RunStatus Dumpstate::DumpTraces(const char** path) {
         return RunStatus::OK;
     }
 
-    // Number of times process dumping has timed out. If we encounter too many
-    // failures, we'll give up.
-    int timeout_failures = 0;
     bool dalvik_found = false;
+    std::vector<StackDump> dumps;
 
     const std::set<int> hal_pids = get_interesting_hal_pids();
 
@@ -1753,34 +1904,86 @@ Dumpstate::RunStatus Dumpstate::DumpTraces(const char** path) {
             continue;
         }
 
-        // If 3 backtrace dumps fail in a row, consider debuggerd dead.
-        if (timeout_failures == 3) {
-            dprintf(fd, "ERROR: Too many stack dump failures, exiting.\n");
-            break;
+        dumps.emplace_back(pid, is_java_process);
+    }
+
+    // Number of times process dumping has timed out. If we encounter too many
+    // failures, we'll give up.
+    std::atomic<int> timeout_failures(0);
+    std::atomic<bool> gave_up(false);
+    std::atomic<size_t> next_dump(0);
+    auto dump_stacks = [&] {
+        size_t i;
+        while ((i = next_dump++) < dumps.size()) {
+            // If 3 backtrace dumps fail in a row, consider debuggerd dead.
+            if (timeout_failures >= 3) {
+                gave_up = true;
+                return;
+            }
+            if (IsUserConsentDenied()) {
+                return;
+            }
+            StackDump& dump = dumps[i];
+            std::string dump_path = temp_file_pattern;
+            dump.fd.reset(mkostemp(&dump_path[0], O_APPEND | O_CLOEXEC));
+            if (dump.fd < 0) {
+                MYLOGE("mkostemp on pattern %s: %s\n", temp_file_pattern.c_str(), strerror(errno));
+                continue;
+            }
+            // Only read back through the descriptor.
+            unlink(dump_path.c_str());
+
+            const uint64_t start = Nanotime();
+            dump.ret = dump_backtrace_to_file_timeout(
+                dump.pid,
+                dump.is_java_process ? kDebuggerdJavaBacktrace : kDebuggerdNativeBacktrace,
+                dump.is_java_process ? 5 : 20, dump.fd);
+            dump.elapsed = Nanotime() - start;
+            dump.dumped = true;
+            if (dump.ret == -1) {
+                timeout_failures++;
+            } else {
+                timeout_failures = 0;
+            }
         }
+    };
+
+    // Each dump mostly waits on the process and debuggerd, so a few of them are run at once,
+    // each into a file of its own, and the files are appended in order.
+    std::vector<std::thread> threads;
+    for (size_t i = 1; i < std::min(dumps.size(), kMaxConcurrentStackDumps); i++) {
+        threads.emplace_back(dump_stacks);
+    }
+    dump_stacks();
+    for (auto& thread : threads) {
+        thread.join();
+    }
+    RETURN_IF_USER_DENIED_CONSENT();
 
-        const uint64_t start = Nanotime();
-        const int ret = dump_backtrace_to_file_timeout(
-            pid, is_java_process ? kDebuggerdJavaBacktrace : kDebuggerdNativeBacktrace,
-            is_java_process ? 5 : 20, fd);
+    for (const StackDump& dump : dumps) {
+        if (!dump.dumped) {
+            if (gave_up) {
+                dprintf(fd, "ERROR: Too many stack dump failures, exiting.\n");
+                break;
+            }
+            continue;
+        }
+        AppendStackDump(dump.fd, fd);
 
-        if (ret == -1) {
+        if (dump.ret == -1) {
             // For consistency, the header and footer to this message match those
             // dumped by debuggerd in the success case.
-            dprintf(fd, "\n---- pid %d at [unknown] ----\n", pid);
+            dprintf(fd, "\n---- pid %d at [unknown] ----\n", dump.pid);
             dprintf(fd, "Dump failed, likely due to a timeout.\n");
-            dprintf(fd, "---- end %d ----", pid);
-            timeout_failures++;
+            dprintf(fd, "---- end %d ----", dump.pid);
             continue;
         }
 
-        // We've successfully dumped stack traces, reset the failure count
-        // and write a summary of the elapsed time to the file and continue with the
-        // next process.
-        timeout_failures = 0;
-
-        dprintf(fd, "[dump %s stack %d: %.3fs elapsed]\n", is_java_process ? "dalvik" : "native",
-                pid, (float)(Nanotime() - start) / NANOS_PER_SEC);
+        // We've successfully dumped stack traces, write a summary of the elapsed
+        // time to the file and continue with the next process.
+        dprintf(fd, "[dump %s stack %d: %.3fs elapsed]\n",
+                dump.is_java_process ? "dalvik" : "native", dump.pid,
+                (float)dump.elapsed / NANOS_PER_SEC);
     }
 
     if (!dalvik_found) {
@@ -2797,6 +3000,11 @@ bool Dumpstate::IsUserConsentDenied() const {
            ds.consent_callback_->getResult() == UserConsentResult::DENIED;
 }
 
+bool Dumpstate::IsUserConsentGranted() const {
+    return ds.consent_callback_ == nullptr ||
+           ds.consent_callback_->getResult() == UserConsentResult::APPROVED;
+}
+
 void Dumpstate::CleanupFiles() {
     android::os::UnlinkAndLogOnError(tmp_path_);
     android::os::UnlinkAndLogOnError(screenshot_path_);
@@ -190,7 +190,7 @@ struct DumpData {
  * that are spread accross utils.cpp and dumpstate.cpp will be moved to it.
  */
 class Dumpstate {
-    friend class DumpstateTest;
+    friend class android::os::dumpstate::DumpstateTest;
 
   public:
     enum RunStatus { OK, HELP, INVALID_INPUT, ERROR, USER_CONSENT_DENIED, USER_CONSENT_TIMED_OUT };
@@ -340,6 +340,11 @@ class Dumpstate {
      */
     bool IsUserConsentDenied() const;
 
+    /*
+     * Returns true if user consent is not necessary, or has been given.
+     */
+    bool IsUserConsentGranted() const;
+
     /*
      * Structure to hold options that determine the behavior of dumpstate.
      */
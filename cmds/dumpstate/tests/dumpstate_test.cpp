@@ -17,8 +17,10 @@
 #define LOG_TAG "dumpstate"
 #include <cutils/log.h>
 
+#include "DumpPool.h"
 #include "DumpstateInternal.h"
 #include "DumpstateService.h"
+#include "ZipEntryWriter.h"
 #include "android/os/BnDumpstate.h"
 #include "dumpstate.h"
 
@@ -30,6 +32,7 @@
 #include <signal.h>
 #include <sys/types.h>
 #include <unistd.h>
+#include <algorithm>
 #include <thread>
 
 #include <android-base/file.h>
@@ -37,6 +40,8 @@
 #include <android-base/stringprintf.h>
 #include <android-base/strings.h>
 #include <cutils/properties.h>
+#include <ziparchive/zip_writer.h>
+#include <zlib.h>
 
 namespace android {
 namespace os {
@@ -645,12 +650,47 @@ class DumpstateTest : public DumpstateBaseTest {
         return message;
     }
 
+    // Makes dumpstate need user consent, as when the bugreport is copied to the caller.
+    android::sp<Dumpstate::ConsentCallback> RequireUserConsent() {
+        ds.consent_callback_ = new Dumpstate::ConsentCallback();
+        return ds.consent_callback_;
+    }
+
+    void ClearUserConsent() {
+        ds.consent_callback_ = nullptr;
+    }
+
     // `stdout` and `stderr` from the last command ran.
     std::string out, err;
 
     Dumpstate& ds = Dumpstate::GetInstance();
 };
 
+TEST_F(DumpstateTest, UserConsentGrantedWhenNotNeeded) {
+    ClearUserConsent();
+    EXPECT_TRUE(ds.IsUserConsentGranted());
+    EXPECT_FALSE(ds.IsUserConsentDenied());
+}
+
+TEST_F(DumpstateTest, UserConsentGrantedOnlyOnceApproved) {
+    android::sp<Dumpstate::ConsentCallback> consent = RequireUserConsent();
+    EXPECT_FALSE(ds.IsUserConsentGranted());
+    EXPECT_FALSE(ds.IsUserConsentDenied());
+
+    consent->onReportApproved();
+    EXPECT_TRUE(ds.IsUserConsentGranted());
+    EXPECT_FALSE(ds.IsUserConsentDenied());
+    ClearUserConsent();
+}
+
+TEST_F(DumpstateTest, UserConsentNotGrantedOnceDenied) {
+    android::sp<Dumpstate::ConsentCallback> consent = RequireUserConsent();
+    consent->onReportDenied();
+    EXPECT_FALSE(ds.IsUserConsentGranted());
+    EXPECT_TRUE(ds.IsUserConsentDenied());
+    ClearUserConsent();
+}
+
 TEST_F(DumpstateTest, RunCommandNoArgs) {
     EXPECT_EQ(-1, RunCommand("", {}));
 }
@@ -1773,6 +1813,150 @@ TEST_F(DumpstateUtilTest, FindingPidWithNotExistingProcess) {
     EXPECT_THAT(err, StrEq("can't find the pid\n"));
 }
 
+class DumpPoolTest : public DumpstateBaseTest {
+  public:
+    void SetUp() {
+        DumpstateBaseTest::SetUp();
+        path_ = kTestDataPath + "DumpPool.txt";
+        fd = TEMP_FAILURE_RETRY(open(path_.c_str(),
+                                     O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC | O_NOFOLLOW,
+                                     S_IRUSR | S_IWUSR | S_IRGRP | S_IROTH));
+        ASSERT_GE(fd, 0) << "could not create FD for path " << path_;
+    }
+
+    void CaptureFdOut() {
+        close(fd);
+        ReadFileToString(path_, &out);
+    }
+
+    // Enqueues a task which just writes text to its output.
+    void EnqueueText(DumpPool* pool, const std::string& name, const std::string& text) {
+        pool->enqueueTask(name, [text](int out_fd) {
+            android::base::WriteStringToFd(text, out_fd);
+        });
+    }
+
+    int fd;
+    std::string out;
+
+  private:
+    std::string path_;
+};
+
+TEST_F(DumpPoolTest, WaitsInOrder) {
+    DumpPool pool(kTestDataPath, nullptr, false);
+    pool.start();
+    EnqueueText(&pool, "first", "I AM LINE1\n");
+    pool.enqueueTask("second", [](int out_fd) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+        android::base::WriteStringToFd("I AM LINE2\n", out_fd);
+    });
+    EnqueueText(&pool, "third", "I AM LINE3\n");
+
+    EXPECT_TRUE(pool.waitForTask("first", fd));
+    EXPECT_TRUE(pool.waitForTask("second", fd));
+    EXPECT_TRUE(pool.waitForTask("third", fd));
+    CaptureFdOut();
+    EXPECT_THAT(out, StrEq("I AM LINE1\nI AM LINE2\nI AM LINE3\n"));
+}
+
+TEST_F(DumpPoolTest, RunsInlineWhenNotStarted) {
+    DumpPool pool(kTestDataPath, nullptr, false);
+    EnqueueText(&pool, "only", "I AM LINE1\n");
+
+    EXPECT_TRUE(pool.waitForTask("only", fd));
+    EXPECT_FALSE(pool.waitForTask("only", fd));
+    EXPECT_FALSE(pool.waitForTask("whatever", fd));
+    CaptureFdOut();
+    EXPECT_THAT(out, StrEq("I AM LINE1\n"));
+}
+
+class ZipEntryWriterTest : public DumpstateBaseTest {
+  public:
+    void SetUp() {
+        DumpstateBaseTest::SetUp();
+        path_ = kTestDataPath + "ZipEntryWriter.zip";
+        file_ = fopen(path_.c_str(), "wb");
+        ASSERT_NE(nullptr, file_) << "could not create " << path_;
+        zip_writer_.reset(new ZipWriter(file_));
+    }
+
+    void TearDown() {
+        zip_writer_.reset();
+        if (file_ != nullptr) {
+            fclose(file_);
+        }
+        unlink(path_.c_str());
+    }
+
+    // Feeds data to an entry writer in chunks of at most ZipEntryWriter::kChunkSize, and returns
+    // whether every chunk was accepted.
+    bool WriteData(ZipEntryWriter* entry_writer, const std::vector<uint8_t>& data) {
+        size_t offset = 0;
+        while (offset < data.size()) {
+            std::vector<uint8_t>* chunk = entry_writer->GetChunk();
+            if (chunk == nullptr) {
+                return false;
+            }
+            size_t size = std::min(chunk->size(), data.size() - offset);
+            memcpy(chunk->data(), data.data() + offset, size);
+            entry_writer->QueueChunk(chunk, size);
+            offset += size;
+        }
+        return true;
+    }
+
+    std::unique_ptr<ZipWriter> zip_writer_;
+
+  private:
+    std::string path_;
+    FILE* file_ = nullptr;
+};
+
+TEST_F(ZipEntryWriterTest, CompressesEveryChunkInOrder) {
+    // More data than the chunks can hold at once, so that chunks are reused.
+    std::vector<uint8_t> data(ZipEntryWriter::kChunkSize * (ZipEntryWriter::kChunkCount + 2) + 123);
+    for (size_t i = 0; i < data.size(); i++) {
+        data[i] = static_cast<uint8_t>((i * 7) ^ (i >> 11));
+    }
+
+    ASSERT_EQ(0, zip_writer_->StartEntry("entry.txt", ZipWriter::kCompress));
+    {
+        ZipEntryWriter entry_writer(zip_writer_.get());
+        EXPECT_TRUE(WriteData(&entry_writer, data));
+        EXPECT_EQ(0, entry_writer.Finish());
+    }
+    ASSERT_EQ(0, zip_writer_->FinishEntry());
+
+    ZipWriter::FileEntry entry;
+    ASSERT_EQ(0, zip_writer_->GetLastEntry(&entry));
+    EXPECT_EQ(data.size(), entry.uncompressed_size);
+    EXPECT_EQ(crc32(0, data.data(), data.size()), entry.crc32);
+    EXPECT_EQ(0, zip_writer_->Finish());
+}
+
+TEST_F(ZipEntryWriterTest, EmptyEntry) {
+    ASSERT_EQ(0, zip_writer_->StartEntry("empty.txt", ZipWriter::kCompress));
+    {
+        ZipEntryWriter entry_writer(zip_writer_.get());
+        EXPECT_EQ(0, entry_writer.Finish());
+    }
+    ASSERT_EQ(0, zip_writer_->FinishEntry());
+
+    ZipWriter::FileEntry entry;
+    ASSERT_EQ(0, zip_writer_->GetLastEntry(&entry));
+    EXPECT_EQ(0u, entry.uncompressed_size);
+    EXPECT_EQ(0, zip_writer_->Finish());
+}
+
+TEST_F(ZipEntryWriterTest, StopsTakingChunksOnError) {
+    // Writing without an entry started fails.
+    std::vector<uint8_t> data(ZipEntryWriter::kChunkSize * ZipEntryWriter::kChunkCount * 4);
+    ZipEntryWriter entry_writer(zip_writer_.get());
+    EXPECT_FALSE(WriteData(&entry_writer, data));
+    EXPECT_NE(0, entry_writer.Finish());
+}
+
 }  // namespace dumpstate
 }  // namespace os
 }  // namespace android
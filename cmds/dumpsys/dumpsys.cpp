@@ -15,9 +15,13 @@
  */
 
 #include <algorithm>
+#include <atomic>
 #include <chrono>
+#include <condition_variable>
 #include <iomanip>
+#include <mutex>
 #include <thread>
+#include <vector>
 
 #include <android-base/file.h>
 #include <android-base/stringprintf.h>
@@ -49,6 +53,9 @@ using ::android::base::unique_fd;
 using ::android::base::WriteFully;
 using ::android::base::WriteStringToFd;
 
+// Dumps running at a time with --parallel.
+static constexpr size_t kMaxParallelDumps = 4;
+
 static int sort_func(const String16* lhs, const String16* rhs)
 {
     return lhs->compare(*rhs);
@@ -70,6 +77,7 @@ static void usage() {
             "         --priority LEVEL: filter services based on specified priority\n"
             "               LEVEL must be one of CRITICAL | HIGH | NORMAL\n"
             "         --skip SERVICES: dumps all services but SERVICES (comma-separated list)\n"
+            "         --parallel: dumps several services at a time, writing them in order\n"
             "         SERVICE [ARGS]: dumps only service SERVICE, optionally passing ARGS to it\n");
 }
 
@@ -120,11 +128,13 @@ int Dumpsys::main(int argc, char* const argv[]) {
     bool showListOnly = false;
     bool skipServices = false;
     bool asProto = false;
+    bool parallel = false;
     int timeoutArgMs = 10000;
     int priorityFlags = IServiceManager::DUMP_FLAG_PRIORITY_ALL;
     static struct option longOptions[] = {{"priority", required_argument, 0, 0},
                                           {"proto", no_argument, 0, 0},
                                           {"skip", no_argument, 0, 0},
+                                          {"parallel", no_argument, 0, 0},
                                           {"help", no_argument, 0, 0},
                                           {0, 0, 0, 0}};
 
@@ -147,6 +157,8 @@ int Dumpsys::main(int argc, char* const argv[]) {
                 skipServices = true;
             } else if (!strcmp(longOptions[optionIndex].name, "proto")) {
                 asProto = true;
+            } else if (!strcmp(longOptions[optionIndex].name, "parallel")) {
+                parallel = true;
             } else if (!strcmp(longOptions[optionIndex].name, "help")) {
                 usage();
                 return 0;
@@ -236,6 +248,19 @@ int Dumpsys::main(int argc, char* const argv[]) {
         return 0;
     }
 
+    if (parallel && N > 1) {
+        Vector<String16> dumpedServices;
+        for (const String16& serviceName : services) {
+            if (!IsSkipped(skippedServices, serviceName)) {
+                dumpedServices.add(serviceName);
+            }
+        }
+        writeDumpsInParallel(STDOUT_FILENO, dumpedServices, args, priorityFlags,
+                             std::chrono::milliseconds(timeoutArgMs), asProto,
+                             /* addSeparator = */ true, kMaxParallelDumps);
+        return 0;
+    }
+
     for (size_t i = 0; i < N; i++) {
         const String16& serviceName = services[i];
         if (IsSkipped(skippedServices, serviceName)) continue;
@@ -354,6 +379,10 @@ void Dumpsys::stopDumpThread(bool dumpComplete) {
 }
 
 void Dumpsys::writeDumpHeader(int fd, const String16& serviceName, int priorityFlags) const {
+    WriteStringToFd(dumpHeader(serviceName, priorityFlags), fd);
+}
+
+std::string Dumpsys::dumpHeader(const String16& serviceName, int priorityFlags) {
     std::string msg(
         "----------------------------------------"
         "---------------------------------------\n");
@@ -366,12 +395,20 @@ void Dumpsys::writeDumpHeader(int fd, const String16& serviceName, int priorityF
         StringAppendF(&msg, "DUMP OF SERVICE %s %s:\n", String8(priorityType).c_str(),
                       String8(serviceName).c_str());
     }
-    WriteStringToFd(msg, fd);
+    return msg;
 }
 
 status_t Dumpsys::writeDump(int fd, const String16& serviceName, std::chrono::milliseconds timeout,
                             bool asProto, std::chrono::duration<double>& elapsedDuration,
                             size_t& bytesWritten) const {
+    auto write = [fd](const char* data, size_t size) { return WriteFully(fd, data, size); };
+    return copyDump(write, serviceName, timeout, asProto, elapsedDuration, bytesWritten);
+}
+
+status_t Dumpsys::copyDump(const std::function<bool(const char* data, size_t size)>& write,
+                           const String16& serviceName, std::chrono::milliseconds timeout,
+                           bool asProto, std::chrono::duration<double>& elapsedDuration,
+                           size_t& bytesWritten) const {
     status_t status = OK;
     size_t totalBytes = 0;
     auto start = std::chrono::steady_clock::now();
@@ -415,7 +452,7 @@ status_t Dumpsys::writeDump(int fd, const String16& serviceName, std::chrono::mi
             break;
         }
 
-        if (!WriteFully(fd, buf, rc)) {
+        if (!write(buf, rc)) {
             aerr << "Failed to write while dumping service " << serviceName << ": "
                  << strerror(errno) << endl;
             status = -errno;
@@ -425,9 +462,8 @@ status_t Dumpsys::writeDump(int fd, const String16& serviceName, std::chrono::mi
     }
 
     if ((status == TIMED_OUT) && (!asProto)) {
-        std::string msg = StringPrintf("\n*** SERVICE '%s' DUMP TIMEOUT (%llums) EXPIRED ***\n\n",
-                                       String8(serviceName).string(), timeout.count());
-        WriteStringToFd(msg, fd);
+        std::string msg = timeoutMessage(serviceName, timeout);
+        write(msg.c_str(), msg.size());
     }
 
     elapsedDuration = std::chrono::steady_clock::now() - start;
@@ -435,16 +471,99 @@ status_t Dumpsys::writeDump(int fd, const String16& serviceName, std::chrono::mi
     return status;
 }
 
+std::string Dumpsys::timeoutMessage(const String16& serviceName,
+                                    std::chrono::milliseconds timeout) {
+    return StringPrintf("\n*** SERVICE '%s' DUMP TIMEOUT (%llums) EXPIRED ***\n\n",
+                        String8(serviceName).string(), timeout.count());
+}
+
 void Dumpsys::writeDumpFooter(int fd, const String16& serviceName,
                               const std::chrono::duration<double>& elapsedDuration) const {
+    WriteStringToFd(dumpFooter(serviceName, elapsedDuration), fd);
+}
+
+std::string Dumpsys::dumpFooter(const String16& serviceName,
+                                const std::chrono::duration<double>& elapsedDuration) {
     using std::chrono::system_clock;
     const auto finish = system_clock::to_time_t(system_clock::now());
     std::tm finish_tm;
     localtime_r(&finish, &finish_tm);
     std::stringstream oss;
     oss << std::put_time(&finish_tm, "%Y-%m-%d %H:%M:%S");
-    std::string msg =
-        StringPrintf("--------- %.3fs was the duration of dumpsys %s, ending at: %s\n",
-                     elapsedDuration.count(), String8(serviceName).string(), oss.str().c_str());
-    WriteStringToFd(msg, fd);
+    return StringPrintf("--------- %.3fs was the duration of dumpsys %s, ending at: %s\n",
+                        elapsedDuration.count(), String8(serviceName).string(),
+                        oss.str().c_str());
+}
+
+std::string Dumpsys::dumpToString(const String16& serviceName, const Vector<String16>& args,
+                                  int priorityFlags, std::chrono::milliseconds timeout,
+                                  bool asProto, bool addSeparator) const {
+    // Each dump needs a pipe and a thread of its own.
+    Dumpsys dumpsys(sm_);
+    std::string output;
+    if (dumpsys.startDumpThread(serviceName, args) != OK) {
+        return output;
+    }
+    if (addSeparator) {
+        output = dumpHeader(serviceName, priorityFlags);
+    }
+    auto append = [&output](const char* data, size_t size) {
+        output.append(data, size);
+        return true;
+    };
+    std::chrono::duration<double> elapsedDuration;
+    size_t bytesWritten = 0;
+    status_t status =
+        dumpsys.copyDump(append, serviceName, timeout, asProto, elapsedDuration, bytesWritten);
+    if (status == TIMED_OUT) {
+        output.append(timeoutMessage(serviceName, timeout));
+    }
+    if (addSeparator) {
+        output.append(dumpFooter(serviceName, elapsedDuration));
+    }
+    dumpsys.stopDumpThread(status == OK);
+    return output;
+}
+
+void Dumpsys::writeDumpsInParallel(int fd, const Vector<String16>& services,
+                                   const Vector<String16>& args, int priorityFlags,
+                                   std::chrono::milliseconds timeout, bool asProto,
+                                   bool addSeparator, size_t maxParallelDumps) const {
+    std::mutex lock;
+    std::condition_variable dumpedCondition;
+    std::vector<std::string> outputs(services.size());
+    std::vector<bool> dumped(services.size(), false);
+
+    std::atomic<size_t> nextService(0);
+    auto dumpServices = [&]() {
+        size_t i;
+        while ((i = nextService++) < services.size()) {
+            std::string output = dumpToString(services[i], args, priorityFlags, timeout,
+                                              asProto, addSeparator);
+            std::lock_guard<std::mutex> guard(lock);
+            outputs[i] = std::move(output);
+            dumped[i] = true;
+            dumpedCondition.notify_all();
+        }
+    };
+    std::vector<std::thread> threads;
+    for (size_t i = 0; i < std::min(maxParallelDumps, services.size()); i++) {
+        threads.emplace_back(dumpServices);
+    }
+
+    for (size_t i = 0; i < services.size(); i++) {
+        std::string output;
+        {
+            std::unique_lock<std::mutex> guard(lock);
+            dumpedCondition.wait(guard, [&dumped, i]() { return dumped[i]; });
+            output = std::move(outputs[i]);
+        }
+        if (!WriteStringToFd(output, fd)) {
+            aerr << "Failed to write while dumping service " << services[i] << ": "
+                 << strerror(errno) << endl;
+        }
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
 }
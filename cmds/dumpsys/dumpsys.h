@@ -17,6 +17,9 @@
 #ifndef FRAMEWORK_NATIVE_CMD_DUMPSYS_H_
 #define FRAMEWORK_NATIVE_CMD_DUMPSYS_H_
 
+#include <chrono>
+#include <functional>
+#include <string>
 #include <thread>
 
 #include <android-base/unique_fd.h>
@@ -115,7 +118,51 @@ class Dumpsys {
         return redirectFd_.get();
     }
 
+    /**
+     * Dumps services to a file descriptor, running up to {@code maxParallelDumps} dumps at a
+     * time, each with a timeout of its own. Dumps are buffered until the ones before them are
+     * written, so they show up in the order of {@code services}.
+     * @param fd file descriptor to write data
+     * @param services services to dump, skipping unknown ones
+     * @param args list of arguments to pass to service dump method.
+     * @param priorityFlags dump priority specified
+     * @param timeout timeout to terminate each dump if not completed
+     * @param asProto used to supresses additional output to the fd such as timeout
+     * error messages
+     * @param addSeparator whether to write a header and a footer around each dump
+     * @param maxParallelDumps number of dumps running at a time
+     */
+    void writeDumpsInParallel(int fd, const Vector<String16>& services,
+                              const Vector<String16>& args, int priorityFlags,
+                              std::chrono::milliseconds timeout, bool asProto, bool addSeparator,
+                              size_t maxParallelDumps) const;
+
   private:
+    /**
+     * Same as {@code writeDump}, but hands the dump to {@code write}, which returns
+     * {@code false} on errors, instead of writing it to a file descriptor.
+     */
+    status_t copyDump(const std::function<bool(const char* data, size_t size)>& write,
+                      const String16& serviceName, std::chrono::milliseconds timeout,
+                      bool asProto, std::chrono::duration<double>& elapsedDuration,
+                      size_t& bytesWritten) const;
+
+    /**
+     * Returns the whole output for a service, between its header and footer when
+     * {@code addSeparator} is set, or an empty string if it can't be dumped.
+     */
+    std::string dumpToString(const String16& serviceName, const Vector<String16>& args,
+                             int priorityFlags, std::chrono::milliseconds timeout, bool asProto,
+                             bool addSeparator) const;
+
+    static std::string dumpHeader(const String16& serviceName, int priorityFlags);
+
+    static std::string dumpFooter(const String16& serviceName,
+                                  const std::chrono::duration<double>& elapsedDuration);
+
+    static std::string timeoutMessage(const String16& serviceName,
+                                      std::chrono::milliseconds timeout);
+
     android::IServiceManager* sm_;
     std::thread activeThread_;
     mutable android::base::unique_fd redirectFd_;
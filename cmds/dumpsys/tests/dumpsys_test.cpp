@@ -32,6 +32,7 @@ using namespace android;
 using ::testing::_;
 using ::testing::Action;
 using ::testing::ActionInterface;
+using ::testing::ContainsRegex;
 using ::testing::DoAll;
 using ::testing::Eq;
 using ::testing::HasSubstr;
@@ -223,6 +224,10 @@ class DumpsysTest : public Test {
         EXPECT_THAT(stdout_, HasSubstr(expected));
     }
 
+    void AssertOutputMatches(const std::string& regex) {
+        EXPECT_THAT(stdout_, ContainsRegex(regex));
+    }
+
     void AssertDumped(const std::string& service, const std::string& dump) {
         EXPECT_THAT(stdout_, HasSubstr("DUMP OF SERVICE " + service + ":\n" + dump));
         EXPECT_THAT(stdout_, HasSubstr("was the duration of dumpsys " + service + ", ending at: "));
@@ -425,6 +430,22 @@ TEST_F(DumpsysTest, DumpMultipleServices) {
     AssertDumped("running3", "dump3");
 }
 
+// Tests 'dumpsys --parallel', which should keep dumps in order, whichever finishes first
+TEST_F(DumpsysTest, DumpMultipleServicesInParallel) {
+    ExpectListServices({"running1", "stopped2", "running3"});
+    ExpectDumpAndHang("running1", 1, "dump1");
+    ExpectCheckService("stopped2", false);
+    ExpectDump("running3", "dump3");
+
+    CallMain({"--parallel"});
+
+    AssertRunningServices({"running1", "running3"});
+    AssertDumped("running1", "dump1");
+    AssertStopped("stopped2");
+    AssertDumped("running3", "dump3");
+    AssertOutputMatches("DUMP OF SERVICE running1:.*DUMP OF SERVICE running3:");
+}
+
 // Tests 'dumpsys --skip skipped3 skipped5', which should skip these services
 TEST_F(DumpsysTest, DumpWithSkip) {
     ExpectListServices({"running1", "stopped2", "skipped3", "running4", "skipped5"});
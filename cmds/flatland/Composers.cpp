@@ -25,10 +25,12 @@ namespace android {
 class Blitter {
 public:
 
-    bool setUp(GLHelper* helper) {
+    // The program may be any of the blit variants, which share the uniforms
+    // of "Blit" and add some of layerSize, cornerRadius and texelStep.
+    bool setUp(GLHelper* helper, const char* pgmName = "Blit") {
         bool result;
 
-        result = helper->getShaderProgram("Blit", &mBlitPgm);
+        result = helper->getShaderProgram(pgmName, &mBlitPgm);
         if (!result) {
             return false;
         }
@@ -39,10 +41,23 @@ public:
         mObjToNdcUniformLoc = glGetUniformLocation(mBlitPgm, "objToNdc");
         mBlitSrcSamplerLoc = glGetUniformLocation(mBlitPgm, "blitSrc");
         mModColorUniformLoc = glGetUniformLocation(mBlitPgm, "modColor");
+        mLayerSizeUniformLoc = glGetUniformLocation(mBlitPgm, "layerSize");
+        mCornerRadiusUniformLoc = glGetUniformLocation(mBlitPgm, "cornerRadius");
+        mTexelStepUniformLoc = glGetUniformLocation(mBlitPgm, "texelStep");
 
         return true;
     }
 
+    // The radius, in pixels, of the corners of the layer.
+    void setCornerRadius(float radius) {
+        mCornerRadius = radius;
+    }
+
+    // The distance, in pixels of the source, between the samples blurred.
+    void setBlurStep(float step) {
+        mBlurStep = step;
+    }
+
     bool blit(GLuint texName, const float* texMatrix,
             int32_t x, int32_t y, uint32_t w, uint32_t h) {
         float modColor[4] = { 1.0f, 1.0f, 1.0f, 1.0f };
@@ -82,6 +97,16 @@ public:
         glUniformMatrix4fv(mObjToNdcUniformLoc, 1, GL_FALSE, screenToNdc);
         glUniformMatrix4fv(mUVToTexUniformLoc, 1, GL_FALSE, texMatrix);
         glUniform4fv(mModColorUniformLoc, 1, modColor);
+        if (mLayerSizeUniformLoc >= 0) {
+            glUniform2f(mLayerSizeUniformLoc, float(w), float(h));
+        }
+        if (mCornerRadiusUniformLoc >= 0) {
+            glUniform1f(mCornerRadiusUniformLoc, mCornerRadius);
+        }
+        if (mTexelStepUniformLoc >= 0) {
+            glUniform2f(mTexelStepUniformLoc, mBlurStep / float(w),
+                    mBlurStep / float(h));
+        }
 
         glActiveTexture(GL_TEXTURE0);
         glBindTexture(GL_TEXTURE_EXTERNAL_OES, texName);
@@ -107,6 +132,12 @@ private:
     GLint mObjToNdcUniformLoc;
     GLint mBlitSrcSamplerLoc;
     GLint mModColorUniformLoc;
+    GLint mLayerSizeUniformLoc;
+    GLint mCornerRadiusUniformLoc;
+    GLint mTexelStepUniformLoc;
+
+    float mCornerRadius = 0.0f;
+    float mBlurStep = 1.0f;
 };
 
 class ComposerBase : public Composer {
@@ -282,4 +313,88 @@ Composer* blendShrink() {
     return new BlendShrinkComp();
 }
 
+// Blends the layer through one of the blit variants, the way SurfaceFlinger
+// composes layers needing more than a plain blit.
+class EffectComp : public ComposerBase {
+public:
+    explicit EffectComp(const char* pgmName) : mPgmName(pgmName) {
+    }
+
+protected:
+    virtual bool setUp(GLHelper* helper) {
+        return mBlitter.setUp(helper, mPgmName);
+    }
+
+    virtual bool compose(GLuint texName, const sp<GLConsumer>& glc) {
+        bool result;
+
+        float texMatrix[16];
+        glc->getTransformMatrix(texMatrix);
+
+        float modColor[4] = { 1.0f, 1.0f, 1.0f, 1.0f };
+
+        int32_t x = mLayerDesc.x;
+        int32_t y = mLayerDesc.y;
+        int32_t w = mLayerDesc.width;
+        int32_t h = mLayerDesc.height;
+
+        glEnable(GL_BLEND);
+        glBlendFunc(GL_ONE, GL_ONE_MINUS_SRC_ALPHA);
+
+        result = mBlitter.modBlit(texName, texMatrix, modColor,
+                x, y, w, h);
+        if (!result) {
+            return false;
+        }
+
+        glDisable(GL_BLEND);
+
+        return true;
+    }
+
+    Blitter mBlitter;
+    const char* mPgmName;
+};
+
+Composer* roundedCorners() {
+    class RoundedCornersComp : public EffectComp {
+    public:
+        RoundedCornersComp() : EffectComp("RoundedBlit") {
+        }
+
+    private:
+        virtual bool setUp(GLHelper* helper) {
+            // About the radius of window corners, relative to the layer.
+            uint32_t size = mLayerDesc.width < mLayerDesc.height ?
+                    mLayerDesc.width : mLayerDesc.height;
+            mBlitter.setCornerRadius(float(size) / 16.0f);
+            return EffectComp::setUp(helper);
+        }
+    };
+    return new RoundedCornersComp();
+}
+
+Composer* wideColor() {
+    return new EffectComp("WideColorBlit");
+}
+
+Composer* hdr() {
+    return new EffectComp("HdrBlit");
+}
+
+Composer* blur() {
+    class BlurComp : public EffectComp {
+    public:
+        BlurComp() : EffectComp("BlurBlit") {
+        }
+
+    private:
+        virtual bool setUp(GLHelper* helper) {
+            mBlitter.setBlurStep(4.0f);
+            return EffectComp::setUp(helper);
+        }
+    };
+    return new BlurComp();
+}
+
 } // namespace android
@@ -25,7 +25,7 @@ namespace android {
 
 #define NELEMS(x) ((int) (sizeof(x) / sizeof((x)[0])))
 
-enum { MAX_NUM_LAYERS = 16 };
+enum { MAX_NUM_LAYERS = 64 };
 enum { MAX_TEST_RUNS = 16 };
 
 class Composer;
@@ -57,6 +57,10 @@ Composer* opaque();
 Composer* opaqueShrink();
 Composer* blend();
 Composer* blendShrink();
+Composer* roundedCorners();
+Composer* wideColor();
+Composer* hdr();
+Composer* blur();
 
 class Renderer {
 public:
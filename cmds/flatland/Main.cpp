@@ -26,6 +26,7 @@
 #include <EGL/egl.h>
 #include <GLES2/gl2.h>
 
+#include <errno.h>
 #include <math.h>
 #include <getopt.h>
 
@@ -34,9 +35,10 @@
 
 using namespace ::android;
 
-static uint32_t g_SleepBetweenSamplesMs = 0;
-static bool     g_PresentToWindow       = false;
-static size_t   g_BenchmarkNameLen      = 0;
+static uint32_t    g_SleepBetweenSamplesMs = 0;
+static bool        g_PresentToWindow       = false;
+static size_t      g_BenchmarkNameLen      = 0;
+static const char* g_JsonOutputPath        = nullptr;
 
 struct BenchmarkDesc {
     // The name of the test.
@@ -201,6 +203,300 @@ static const BenchmarkDesc benchmarks[] = {
             },
         },
     },
+
+    { "16:10 Rounded Corner Windows",
+        2560, 1600, { 800, 1200, 1600, 2400 },
+        {
+            {   // Wallpaper
+                0, staticGradient, opaque,
+                0,    50,     2560,   1454,
+            },
+            {   // Freeform window
+                0, staticGradient, roundedCorners,
+                160,  150,    1400,   1000,
+            },
+            {   // Freeform window
+                0, staticGradient, roundedCorners,
+                1000, 400,    1400,   1000,
+            },
+            {   // Status bar
+                0, staticGradient, opaque,
+                0,    0,      2560,   50,
+            },
+            {   // Navigation bar
+                0, staticGradient, opaque,
+                0,    1504,   2560,   96,
+            },
+        },
+    },
+
+    { "16:10 Wide Color Window",
+        2560, 1600, { 800, 1200, 1600, 2400 },
+        {
+            {   // Window
+                0, staticGradient, wideColor,
+                0,    50,     2560,   1454,
+            },
+            {   // Status bar
+                0, staticGradient, opaque,
+                0,    0,      2560,   50,
+            },
+            {   // Navigation bar
+                0, staticGradient, opaque,
+                0,    1504,   2560,   96,
+            },
+        },
+    },
+
+    { "16:10 HDR Video",
+        2560, 1600, { 800, 1200, 1600, 2400 },
+        {
+            {   // Video
+                0, staticGradient, hdr,
+                0,    0,      2560,   1600,
+            },
+            {   // Playback controls
+                0, staticGradient, blend,
+                0,    1400,   2560,   200,
+            },
+        },
+    },
+
+    { "16:10 Blurred Notification Shade",
+        2560, 1600, { 800, 1200, 1600, 2400 },
+        {
+            {   // Window
+                0, staticGradient, opaque,
+                0,    50,     2560,   1454,
+            },
+            {   // Blurred shade
+                0, staticGradient, blur,
+                0,    50,     2560,   1454,
+            },
+            {   // Notifications
+                0, staticGradient, roundedCorners,
+                640,  100,    1280,   900,
+            },
+            {   // Status bar
+                0, staticGradient, opaque,
+                0,    0,      2560,   50,
+            },
+            {   // Navigation bar
+                0, staticGradient, opaque,
+                0,    1504,   2560,   96,
+            },
+        },
+    },
+
+    { "16:10 Many Small Layers",
+        2560, 1600, { 800, 1200, 1600, 2400 },
+        {
+            {   // Wallpaper
+                0, staticGradient, opaque,
+                0,    50,     2560,   1454,
+            },
+            {   // Icon
+                0, staticGradient, blend,
+                120,  120,    160,    160,
+            },
+            {   // Icon
+                0, staticGradient, blend,
+                420,  120,    160,    160,
+            },
+            {   // Icon
+                0, staticGradient, blend,
+                720,  120,    160,    160,
+            },
+            {   // Icon
+                0, staticGradient, blend,
+                1020, 120,    160,    160,
+            },
+            {   // Icon
+                0, staticGradient, blend,
+                1320, 120,    160,    160,
+            },
+            {   // Icon
+                0, staticGradient, blend,
+                1620, 120,    160,    160,
+            },
+            {   // Icon
+                0, staticGradient, blend,
+                1920, 120,    160,    160,
+            },
+            {   // Icon
+                0, staticGradient, blend,
+                2220, 120,    160,    160,
+            },
+            {   // Icon
+                0, staticGradient, blend,
+                120,  340,    160,    160,
+            },
+            {   // Icon
+                0, staticGradient, blend,
+                420,  340,    160,    160,
+            },
+            {   // Icon
+                0, staticGradient, blend,
+                720,  340,    160,    160,
+            },
+            {   // Icon
+                0, staticGradient, blend,
+                1020, 340,    160,    160,
+            },
+            {   // Icon
+                0, staticGradient, blend,
+                1320, 340,    160,    160,
+            },
+            {   // Icon
+                0, staticGradient, blend,
+                1620, 340,    160,    160,
+            },
+            {   // Icon
+                0, staticGradient, blend,
+                1920, 340,    160,    160,
+            },
+            {   // Icon
+                0, staticGradient, blend,
+                2220, 340,    160,    160,
+            },
+            {   // Icon
+                0, staticGradient, blend,
+                120,  560,    160,    160,
+            },
+            {   // Icon
+                0, staticGradient, blend,
+                420,  560,    160,    160,
+            },
+            {   // Icon
+                0, staticGradient, blend,
+                720,  560,    160,    160,
+            },
+            {   // Icon
+                0, staticGradient, blend,
+                1020, 560,    160,    160,
+            },
+            {   // Icon
+                0, staticGradient, blend,
+                1320, 560,    160,    160,
+            },
+            {   // Icon
+                0, staticGradient, blend,
+                1620, 560,    160,    160,
+            },
+            {   // Icon
+                0, staticGradient, blend,
+                1920, 560,    160,    160,
+            },
+            {   // Icon
+                0, staticGradient, blend,
+                2220, 560,    160,    160,
+            },
+            {   // Icon
+                0, staticGradient, blend,
+                120,  780,    160,    160,
+            },
+            {   // Icon
+                0, staticGradient, blend,
+                420,  780,    160,    160,
+            },
+            {   // Icon
+                0, staticGradient, blend,
+                720,  780,    160,    160,
+            },
+            {   // Icon
+                0, staticGradient, blend,
+                1020, 780,    160,    160,
+            },
+            {   // Icon
+                0, staticGradient, blend,
+                1320, 780,    160,    160,
+            },
+            {   // Icon
+                0, staticGradient, blend,
+                1620, 780,    160,    160,
+            },
+            {   // Icon
+                0, staticGradient, blend,
+                1920, 780,    160,    160,
+            },
+            {   // Icon
+                0, staticGradient, blend,
+                2220, 780,    160,    160,
+            },
+            {   // Icon
+                0, staticGradient, blend,
+                120,  1000,   160,    160,
+            },
+            {   // Icon
+                0, staticGradient, blend,
+                420,  1000,   160,    160,
+            },
+            {   // Icon
+                0, staticGradient, blend,
+                720,  1000,   160,    160,
+            },
+            {   // Icon
+                0, staticGradient, blend,
+                1020, 1000,   160,    160,
+            },
+            {   // Icon
+                0, staticGradient, blend,
+                1320, 1000,   160,    160,
+            },
+            {   // Icon
+                0, staticGradient, blend,
+                1620, 1000,   160,    160,
+            },
+            {   // Icon
+                0, staticGradient, blend,
+                1920, 1000,   160,    160,
+            },
+            {   // Icon
+                0, staticGradient, blend,
+                2220, 1000,   160,    160,
+            },
+            {   // Icon
+                0, staticGradient, blend,
+                120,  1220,   160,    160,
+            },
+            {   // Icon
+                0, staticGradient, blend,
+                420,  1220,   160,    160,
+            },
+            {   // Icon
+                0, staticGradient, blend,
+                720,  1220,   160,    160,
+            },
+            {   // Icon
+                0, staticGradient, blend,
+                1020, 1220,   160,    160,
+            },
+            {   // Icon
+                0, staticGradient, blend,
+                1320, 1220,   160,    160,
+            },
+            {   // Icon
+                0, staticGradient, blend,
+                1620, 1220,   160,    160,
+            },
+            {   // Icon
+                0, staticGradient, blend,
+                1920, 1220,   160,    160,
+            },
+            {   // Icon
+                0, staticGradient, blend,
+                2220, 1220,   160,    160,
+            },
+            {   // Status bar
+                0, staticGradient, opaque,
+                0,    0,      2560,   50,
+            },
+            {   // Navigation bar
+                0, staticGradient, opaque,
+                0,    1504,   2560,   96,
+            },
+        },
+    },
 };
 
 static const ShaderDesc shaders[] = {
@@ -238,6 +534,209 @@ static const ShaderDesc shaders[] = {
         },
     },
 
+    {
+        // Clips the layer to rounded corners, antialiasing their edges.
+        .name="RoundedBlit",
+        .vertexShader={
+            "precision mediump float;",
+            "",
+            "attribute vec4 position;",
+            "attribute vec4 uv;",
+            "",
+            "varying vec4 texCoords;",
+            "varying vec2 layerCoords;",
+            "",
+            "uniform mat4 objToNdc;",
+            "uniform mat4 uvToTex;",
+            "uniform vec2 layerSize;",
+            "",
+            "void main() {",
+            "    gl_Position = objToNdc * position;",
+            "    texCoords = uvToTex * uv;",
+            "    layerCoords = uv.xy * layerSize;",
+            "}",
+        },
+        .fragmentShader={
+            "#extension GL_OES_EGL_image_external : require",
+            "precision mediump float;",
+            "",
+            "varying vec4 texCoords;",
+            "varying vec2 layerCoords;",
+            "",
+            "uniform samplerExternalOES blitSrc;",
+            "uniform vec4 modColor;",
+            "uniform vec2 layerSize;",
+            "uniform float cornerRadius;",
+            "",
+            "void main() {",
+            "    vec2 halfSize = layerSize * 0.5;",
+            "    vec2 d = abs(layerCoords - halfSize) - (halfSize - cornerRadius);",
+            "    float dist = length(max(d, 0.0)) - cornerRadius;",
+            "    float coverage = clamp(0.5 - dist, 0.0, 1.0);",
+            "    gl_FragColor = texture2D(blitSrc, texCoords.xy);",
+            "    gl_FragColor *= modColor * coverage;",
+            "}",
+        },
+    },
+
+    {
+        // Converts Display P3 content to sRGB, through linear light.
+        .name="WideColorBlit",
+        .vertexShader={
+            "precision mediump float;",
+            "",
+            "attribute vec4 position;",
+            "attribute vec4 uv;",
+            "",
+            "varying vec4 texCoords;",
+            "",
+            "uniform mat4 objToNdc;",
+            "uniform mat4 uvToTex;",
+            "",
+            "void main() {",
+            "    gl_Position = objToNdc * position;",
+            "    texCoords = uvToTex * uv;",
+            "}",
+        },
+        .fragmentShader={
+            "#extension GL_OES_EGL_image_external : require",
+            "precision mediump float;",
+            "",
+            "varying vec4 texCoords;",
+            "",
+            "uniform samplerExternalOES blitSrc;",
+            "uniform vec4 modColor;",
+            "",
+            "const mat3 p3ToSrgb = mat3(",
+            "        1.2249, -0.0421, -0.0196,",
+            "        -0.2247, 1.0419, -0.0786,",
+            "        0.0, 0.0, 1.0982);",
+            "",
+            "vec3 eotf(vec3 c) {",
+            "    return mix(c / 12.92, pow((c + 0.055) / 1.055, vec3(2.4)),",
+            "            step(vec3(0.04045), c));",
+            "}",
+            "",
+            "vec3 oetf(vec3 c) {",
+            "    return mix(c * 12.92, 1.055 * pow(c, vec3(1.0 / 2.4)) - 0.055,",
+            "            step(vec3(0.0031308), c));",
+            "}",
+            "",
+            "void main() {",
+            "    vec4 color = texture2D(blitSrc, texCoords.xy);",
+            "    vec3 linear = clamp(p3ToSrgb * eotf(color.rgb), 0.0, 1.0);",
+            "    gl_FragColor = vec4(oetf(linear), color.a) * modColor;",
+            "}",
+        },
+    },
+
+    {
+        // Decodes BT.2020 PQ content, and tone-maps it to an SDR display.
+        .name="HdrBlit",
+        .vertexShader={
+            "precision mediump float;",
+            "",
+            "attribute vec4 position;",
+            "attribute vec4 uv;",
+            "",
+            "varying vec4 texCoords;",
+            "",
+            "uniform mat4 objToNdc;",
+            "uniform mat4 uvToTex;",
+            "",
+            "void main() {",
+            "    gl_Position = objToNdc * position;",
+            "    texCoords = uvToTex * uv;",
+            "}",
+        },
+        .fragmentShader={
+            "#extension GL_OES_EGL_image_external : require",
+            "precision highp float;",
+            "",
+            "varying vec4 texCoords;",
+            "",
+            "uniform samplerExternalOES blitSrc;",
+            "uniform vec4 modColor;",
+            "",
+            "const mat3 bt2020ToSrgb = mat3(",
+            "        1.6605, -0.1246, -0.0182,",
+            "        -0.5876, 1.1329, -0.1006,",
+            "        -0.0728, -0.0083, 1.1187);",
+            "",
+            "// ST 2084, in nits.",
+            "vec3 eotf(vec3 c) {",
+            "    const float invM1 = 1.0 / ((2610.0 / 4096.0) / 4.0);",
+            "    const float invM2 = 1.0 / ((2523.0 / 4096.0) * 128.0);",
+            "    const float c1 = 3424.0 / 4096.0;",
+            "    const float c2 = (2413.0 / 4096.0) * 32.0;",
+            "    const float c3 = (2392.0 / 4096.0) * 32.0;",
+            "    vec3 p = pow(c, vec3(invM2));",
+            "    return 10000.0 * pow(max(p - c1, 0.0) / (c2 - c3 * p), vec3(invM1));",
+            "}",
+            "",
+            "// Extended Reinhard on luminance, from 1000 nits content to a 250",
+            "// nits display, normalized to the display.",
+            "vec3 toneMap(vec3 nits) {",
+            "    const float maxOut = 250.0;",
+            "    const float white = 1000.0 / maxOut;",
+            "    float l = dot(nits, vec3(0.2627, 0.6780, 0.0593)) / maxOut;",
+            "    float mapped = l * (1.0 + l / (white * white)) / (1.0 + l);",
+            "    return nits / maxOut * (l > 0.0 ? mapped / l : 0.0);",
+            "}",
+            "",
+            "void main() {",
+            "    vec4 color = texture2D(blitSrc, texCoords.xy);",
+            "    vec3 linear = clamp(bt2020ToSrgb * toneMap(eotf(color.rgb)), 0.0, 1.0);",
+            "    vec3 encoded = pow(linear, vec3(1.0 / 2.2));",
+            "    gl_FragColor = vec4(encoded, color.a) * modColor;",
+            "}",
+        },
+    },
+
+    {
+        // A single pass of a 3x3 gaussian, widened to sample taps texelStep
+        // apart.
+        .name="BlurBlit",
+        .vertexShader={
+            "precision mediump float;",
+            "",
+            "attribute vec4 position;",
+            "attribute vec4 uv;",
+            "",
+            "varying vec4 texCoords;",
+            "",
+            "uniform mat4 objToNdc;",
+            "uniform mat4 uvToTex;",
+            "",
+            "void main() {",
+            "    gl_Position = objToNdc * position;",
+            "    texCoords = uvToTex * uv;",
+            "}",
+        },
+        .fragmentShader={
+            "#extension GL_OES_EGL_image_external : require",
+            "precision mediump float;",
+            "",
+            "varying vec4 texCoords;",
+            "",
+            "uniform samplerExternalOES blitSrc;",
+            "uniform vec4 modColor;",
+            "uniform vec2 texelStep;",
+            "",
+            "void main() {",
+            "    vec2 c = texCoords.xy;",
+            "    vec2 dx = vec2(texelStep.x, 0.0);",
+            "    vec2 dy = vec2(0.0, texelStep.y);",
+            "    vec4 sum = texture2D(blitSrc, c) * 4.0;",
+            "    sum += (texture2D(blitSrc, c - dx) + texture2D(blitSrc, c + dx) +",
+            "            texture2D(blitSrc, c - dy) + texture2D(blitSrc, c + dy)) * 2.0;",
+            "    sum += texture2D(blitSrc, c - dx - dy) + texture2D(blitSrc, c + dx - dy) +",
+            "            texture2D(blitSrc, c - dx + dy) + texture2D(blitSrc, c + dx + dy);",
+            "    gl_FragColor = sum / 16.0 * modColor;",
+            "}",
+        },
+    },
+
     {
         .name="Gradient",
         .vertexShader={
@@ -586,8 +1085,20 @@ static int cmpDouble(const double* lhs, const double* rhs) {
     return 0;
 }
 
+// The result of a single benchmark run, as written with -j.
+struct BenchmarkResult {
+    const char* name;
+    uint32_t width;
+    uint32_t height;
+
+    // "ok", or why there is no frame time: "fast", "slow", "varies" or
+    // "error".
+    const char* status;
+    double frameTimeMs;
+};
+
 // Run a single benchmark and print the result.
-static bool runTest(const BenchmarkDesc b, size_t run) {
+static bool runTest(const BenchmarkDesc b, size_t run, BenchmarkResult* outResult) {
     bool success = true;
     double prevResult = 0.0, result = 0.0;
     Vector<double> samples;
@@ -598,6 +1109,12 @@ static bool runTest(const BenchmarkDesc b, size_t run) {
             runWidth, runHeight);
     fflush(stdout);
 
+    outResult->name = b.name;
+    outResult->width = runWidth;
+    outResult->height = runHeight;
+    outResult->status = "error";
+    outResult->frameTimeMs = 0.0;
+
     BenchmarkRunner r(b, run);
     if (!r.setUp()) {
         fprintf(stderr, "error initializing runner.\n");
@@ -628,10 +1145,12 @@ static bool runTest(const BenchmarkDesc b, size_t run) {
     if (totalFrames - warmUpFrames > 16) {
         // The test runs too fast to get a stable result.  Skip it.
         printf("  fast");
+        outResult->status = "fast";
         goto done;
     } else if (totalFrames == 5 && runTime > 200e6) {
         // The test runs too slow to be very useful.  Skip it.
         printf("  slow");
+        outResult->status = "slow";
         goto done;
     }
 
@@ -643,6 +1162,7 @@ static bool runTest(const BenchmarkDesc b, size_t run) {
 
         if (newSamples > 512) {
             printf("varies");
+            outResult->status = "varies";
             goto done;
         }
 
@@ -668,7 +1188,9 @@ static bool runTest(const BenchmarkDesc b, size_t run) {
         result = (samples[elem-1] + samples[elem]) * 0.5;
     } while (fabs(result - prevResult) > threshold * result);
 
-    printf("%6.3f", result / double(totalFrames - warmUpFrames) / 1e6);
+    outResult->status = "ok";
+    outResult->frameTimeMs = result / double(totalFrames - warmUpFrames) / 1e6;
+    printf("%6.3f", outResult->frameTimeMs);
 
 done:
 
@@ -689,19 +1211,65 @@ static void printResultsTableHeader() {
             "Scenario", static_cast<int>(rightPad), "");
 }
 
+// Write the results as a JSON array of objects, one per benchmark run.
+static bool writeJsonResults(const char* path, const Vector<BenchmarkResult>& results) {
+    FILE* out = fopen(path, "we");
+    if (out == nullptr) {
+        fprintf(stderr, "error opening %s: %s\n", path, strerror(errno));
+        return false;
+    }
+
+    fprintf(out, "[\n");
+    for (size_t i = 0; i < results.size(); i++) {
+        const BenchmarkResult& r = results[i];
+        fprintf(out, "  {\"scenario\": \"");
+        for (const char* c = r.name; *c != '\0'; c++) {
+            if (*c == '"' || *c == '\\') {
+                fputc('\\', out);
+            }
+            fputc(*c, out);
+        }
+        fprintf(out, "\", \"width\": %u, \"height\": %u, \"status\": \"%s\"",
+                r.width, r.height, r.status);
+        if (strcmp(r.status, "ok") == 0) {
+            fprintf(out, ", \"frame_time_ms\": %.3f", r.frameTimeMs);
+        }
+        fprintf(out, "}%s\n", i + 1 < results.size() ? "," : "");
+    }
+    fprintf(out, "]\n");
+
+    if (fclose(out) != 0) {
+        fprintf(stderr, "error writing %s: %s\n", path, strerror(errno));
+        return false;
+    }
+    return true;
+}
+
 // Run ALL the benchmarks!
 static bool runTests() {
+    bool success = true;
+    Vector<BenchmarkResult> results;
+
     printResultsTableHeader();
 
-    for (size_t i = 0; i < NELEMS(benchmarks); i++) {
+    for (size_t i = 0; success && i < NELEMS(benchmarks); i++) {
         const BenchmarkDesc& b = benchmarks[i];
         for (size_t j = 0; j < MAX_TEST_RUNS && b.runHeights[j]; j++) {
-            if (!runTest(b, j)) {
-                return false;
+            BenchmarkResult result;
+            success = runTest(b, j, &result);
+            results.add(result);
+            if (!success) {
+                break;
             }
         }
     }
-    return true;
+
+    // The runs which completed are written even after an error, which the
+    // last one records.
+    if (g_JsonOutputPath != nullptr && !writeJsonResults(g_JsonOutputPath, results)) {
+        return false;
+    }
+    return success;
 }
 
 // Return the length longest benchmark name.
@@ -723,6 +1291,7 @@ static void showHelp(const char *cmd) {
     fprintf(stderr, "options include:\n"
                     "  -s N            sleep for N ms between samples\n"
                     "  -d              display the test frame to a window\n"
+                    "  -j FILE         also write the results to FILE as JSON\n"
                     "  --help          print this helpful message and exit\n"
             );
 }
@@ -741,7 +1310,7 @@ int main(int argc, char** argv) {
             {     0,               0, 0,  0 }
         };
 
-        ret = getopt_long(argc, argv, "ds:",
+        ret = getopt_long(argc, argv, "dj:s:",
                           long_options, &option_index);
 
         if (ret < 0) {
@@ -753,6 +1322,10 @@ int main(int argc, char** argv) {
                 g_PresentToWindow = true;
             break;
 
+            case 'j':
+                g_JsonOutputPath = optarg;
+            break;
+
             case 's':
                 g_SleepBetweenSamplesMs = atoi(optarg);
             break;
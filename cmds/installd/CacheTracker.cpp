@@ -54,7 +54,20 @@ void CacheTracker::addDataPath(const std::string& dataPath) {
     mDataPaths.push_back(dataPath);
 }
 
-void CacheTracker::loadStats() {
+static void calculateCacheTreeSize(TreeSizeCache* treeSizeCache, const std::string& path,
+        int64_t* size) {
+    if (treeSizeCache == nullptr) {
+        calculate_tree_size(path, size);
+        return;
+    }
+    *size += treeSizeCache->get(path, [](const std::string& tree) {
+        TreeSizeCache::Sizes sizes;
+        calculate_tree_size(tree, &sizes.dataSize);
+        return sizes;
+    }).dataSize;
+}
+
+void CacheTracker::loadStats(TreeSizeCache* treeSizeCache) {
     ATRACE_BEGIN("loadStats quota");
     cacheUsed = 0;
     if (loadQuotaStats()) {
@@ -67,8 +80,8 @@ void CacheTracker::loadStats() {
     for (const auto& path : mDataPaths) {
         auto cachePath = read_path_inode(path, "cache", kXattrInodeCache);
         auto codeCachePath = read_path_inode(path, "code_cache", kXattrInodeCodeCache);
-        calculate_tree_size(cachePath, &cacheUsed);
-        calculate_tree_size(codeCachePath, &cacheUsed);
+        calculateCacheTreeSize(treeSizeCache, cachePath, &cacheUsed);
+        calculateCacheTreeSize(treeSizeCache, codeCachePath, &cacheUsed);
     }
     ATRACE_END();
 }
@@ -28,6 +28,7 @@
 #include <cutils/multiuser.h>
 
 #include "CacheItem.h"
+#include "TreeSizeCache.h"
 
 namespace android {
 namespace installd {
@@ -46,7 +47,12 @@ public:
 
     void addDataPath(const std::string& dataPath);
 
-    void loadStats();
+    /**
+     * Loads the cache used by this UID. Without quotas, the cache trees are
+     * measured through treeSizeCache when given, which keeps their sizes
+     * until they change.
+     */
+    void loadStats(TreeSizeCache* treeSizeCache = nullptr);
     void loadItems();
 
     void ensureItems();
@@ -0,0 +1,174 @@
+/*
+ * Copyright (C) 2019 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "DexoptScheduler.h"
+
+#include <algorithm>
+
+#include <android-base/logging.h>
+#include <android-base/parseint.h>
+#include <android-base/properties.h>
+
+using android::base::GetProperty;
+using android::base::ParseByteCount;
+using android::base::ParseUint;
+
+namespace android {
+namespace installd {
+
+static int64_t toMillis(std::chrono::steady_clock::duration duration) {
+    return std::chrono::duration_cast<std::chrono::milliseconds>(duration).count();
+}
+
+static uint64_t getByteCountProperty(const char* property) {
+    std::string value = GetProperty(property, "");
+    uint64_t bytes = 0;
+    if (!value.empty() && !ParseByteCount(value.c_str(), &bytes)) {
+        LOG(WARNING) << "Ignoring invalid " << property << ": " << value;
+        return 0;
+    }
+    return bytes;
+}
+
+DexoptScheduler::Budget DexoptScheduler::Budget::fromProperties() {
+    Budget budget;
+    std::string maxJobs = GetProperty("dalvik.vm.dex2oat-max-jobs", "");
+    if (!maxJobs.empty() && !ParseUint(maxJobs.c_str(), &budget.maxJobs, size_t(64))) {
+        LOG(WARNING) << "Ignoring invalid dalvik.vm.dex2oat-max-jobs: " << maxJobs;
+    }
+    budget.maxJobs = std::max(budget.maxJobs, size_t(1));
+    budget.memoryBytes = getByteCountProperty("dalvik.vm.dex2oat-jobs-memory");
+    budget.jobMemoryBytes = getByteCountProperty("dalvik.vm.dex2oat-Xmx");
+    return budget;
+}
+
+DexoptScheduler::Job::Job(DexoptScheduler* scheduler, uint64_t id)
+        : mScheduler(scheduler), mId(id) {}
+
+DexoptScheduler::Job::Job(Job&& other) : mScheduler(other.mScheduler), mId(other.mId) {
+    other.mScheduler = nullptr;
+}
+
+DexoptScheduler::Job::~Job() {
+    if (mScheduler != nullptr) {
+        mScheduler->finish(mId);
+    }
+}
+
+DexoptScheduler::DexoptScheduler(std::function<Budget()> getBudget)
+        : mGetBudget(std::move(getBudget)) {}
+
+bool DexoptScheduler::canStartLocked(const std::string& packageName, const Budget& budget,
+        uint64_t ticket) {
+    if (ticket != mNextTicketToStart) {
+        return false;
+    }
+    for (const auto& running : mRunningJobs) {
+        if (running.second.packageName == packageName) {
+            return false;
+        }
+    }
+    // A job always fits when nothing runs, whatever it needs.
+    if (mRunningJobs.empty()) {
+        return true;
+    }
+    if (mRunningJobs.size() >= budget.maxJobs) {
+        return false;
+    }
+    return budget.memoryBytes == 0 ||
+            mMemoryInUse + budget.jobMemoryBytes <= budget.memoryBytes;
+}
+
+DexoptScheduler::Job DexoptScheduler::start(const std::string& packageName,
+        const std::string& description) {
+    const Budget budget = mGetBudget();
+    const Clock::time_point scheduleTime = Clock::now();
+
+    std::unique_lock<std::mutex> lock(mLock);
+    const uint64_t ticket = mNextTicket++;
+    mCondition.wait(lock, [&] { return canStartLocked(packageName, budget, ticket); });
+    mNextTicketToStart++;
+
+    const uint64_t id = mNextJobId++;
+    const Clock::time_point startTime = Clock::now();
+    mRunningJobs[id] = {packageName, description, budget.jobMemoryBytes, startTime};
+    mMemoryInUse += budget.jobMemoryBytes;
+    const size_t running = mRunningJobs.size();
+    const uint64_t waiting = mNextTicket - mNextTicketToStart;
+    lock.unlock();
+
+    // The next waiting job may fit as well.
+    mCondition.notify_all();
+
+    LOG(DEBUG) << "Dexopt job " << id << " started: " << description << " after waiting "
+               << toMillis(startTime - scheduleTime) << "ms (" << running << " running, "
+               << waiting << " waiting)";
+    return Job(this, id);
+}
+
+void DexoptScheduler::finish(uint64_t id) {
+    std::unique_lock<std::mutex> lock(mLock);
+    auto it = mRunningJobs.find(id);
+    if (it == mRunningJobs.end()) {
+        return;
+    }
+    const Clock::duration jobTime = Clock::now() - it->second.startTime;
+    const std::string description = std::move(it->second.description);
+    mMemoryInUse -= it->second.memoryBytes;
+    mRunningJobs.erase(it);
+
+    mCompletedJobs++;
+    mTotalJobTime += jobTime;
+    if (jobTime > mLongestJobTime) {
+        mLongestJobTime = jobTime;
+        mLongestJob = description;
+    }
+    const size_t running = mRunningJobs.size();
+    const uint64_t waiting = mNextTicket - mNextTicketToStart;
+    lock.unlock();
+
+    mCondition.notify_all();
+
+    LOG(DEBUG) << "Dexopt job " << id << " finished: " << description << " in "
+               << toMillis(jobTime) << "ms (" << running << " running, " << waiting
+               << " waiting)";
+}
+
+bool DexoptScheduler::isConcurrent() {
+    return mGetBudget().maxJobs > 1;
+}
+
+void DexoptScheduler::dump(std::ostream& out) {
+    const Budget budget = mGetBudget();
+    std::lock_guard<std::mutex> lock(mLock);
+    const Clock::time_point now = Clock::now();
+
+    out << "Dexopt jobs: max " << budget.maxJobs << ", memory " << mMemoryInUse << "/"
+        << budget.memoryBytes << " bytes" << std::endl;
+    for (const auto& running : mRunningJobs) {
+        out << "    " << running.first << ": " << running.second.description << " running for "
+            << toMillis(now - running.second.startTime) << "ms" << std::endl;
+    }
+    out << "    " << (mNextTicket - mNextTicketToStart) << " waiting" << std::endl;
+    out << "    " << mCompletedJobs << " completed in " << toMillis(mTotalJobTime) << "ms";
+    if (mCompletedJobs > 0) {
+        out << ", longest " << mLongestJob << " in " << toMillis(mLongestJobTime) << "ms";
+    }
+    out << std::endl;
+}
+
+}  // namespace installd
+}  // namespace android
@@ -0,0 +1,123 @@
+/*
+ * Copyright (C) 2019 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef ANDROID_INSTALLD_DEXOPT_SCHEDULER_H
+#define ANDROID_INSTALLD_DEXOPT_SCHEDULER_H
+
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <ostream>
+#include <string>
+
+#include <android-base/macros.h>
+
+namespace android {
+namespace installd {
+
+/**
+ * Admits the dexopt jobs of installd, so that several dex2oat children can run
+ * at once within a budget of jobs and memory. The jobs of a package run one at
+ * a time, and jobs start in the order they were scheduled.
+ */
+class DexoptScheduler {
+public:
+    struct Budget {
+        // Maximum number of jobs running at once.
+        size_t maxJobs = 1;
+        // Memory all the running jobs may use, or 0 for no limit.
+        uint64_t memoryBytes = 0;
+        // Memory a job is expected to use, or 0 if unknown.
+        uint64_t jobMemoryBytes = 0;
+
+        /**
+         * Reads the budget from dalvik.vm.dex2oat-max-jobs and
+         * dalvik.vm.dex2oat-jobs-memory, with the memory of a job being the
+         * heap of dex2oat, dalvik.vm.dex2oat-Xmx. Defaults to one job at a
+         * time.
+         */
+        static Budget fromProperties();
+    };
+
+    /**
+     * A running job, which leaves the budget when destroyed.
+     */
+    class Job {
+    public:
+        Job(Job&& other);
+        ~Job();
+
+    private:
+        friend class DexoptScheduler;
+        Job(DexoptScheduler* scheduler, uint64_t id);
+
+        DexoptScheduler* mScheduler;
+        uint64_t mId;
+
+        DISALLOW_COPY_AND_ASSIGN(Job);
+    };
+
+    explicit DexoptScheduler(std::function<Budget()> getBudget = Budget::fromProperties);
+
+    /**
+     * Waits for the budget to let a job for packageName start, and starts it.
+     * description names the job in logs and dumps.
+     */
+    Job start(const std::string& packageName, const std::string& description);
+
+    // Whether jobs may currently run concurrently.
+    bool isConcurrent();
+
+    void dump(std::ostream& out);
+
+private:
+    using Clock = std::chrono::steady_clock;
+
+    struct RunningJob {
+        std::string packageName;
+        std::string description;
+        uint64_t memoryBytes;
+        Clock::time_point startTime;
+    };
+
+    bool canStartLocked(const std::string& packageName, const Budget& budget, uint64_t ticket);
+    void finish(uint64_t id);
+
+    const std::function<Budget()> mGetBudget;
+
+    std::mutex mLock;
+    std::condition_variable mCondition;
+
+    std::map<uint64_t, RunningJob> mRunningJobs;
+    uint64_t mNextJobId = 0;
+    uint64_t mMemoryInUse = 0;
+
+    // Tickets hand out the order in which waiting jobs start.
+    uint64_t mNextTicket = 0;
+    uint64_t mNextTicketToStart = 0;
+
+    uint64_t mCompletedJobs = 0;
+    Clock::duration mTotalJobTime{0};
+    Clock::duration mLongestJobTime{0};
+    std::string mLongestJob;
+};
+
+}  // namespace installd
+}  // namespace android
+
+#endif  // ANDROID_INSTALLD_DEXOPT_SCHEDULER_H
@@ -19,6 +19,8 @@
 #define ATRACE_TAG ATRACE_TAG_PACKAGE_MANAGER
 
 #include <algorithm>
+#include <atomic>
+#include <deque>
 #include <errno.h>
 #include <fstream>
 #include <fts.h>
@@ -37,6 +39,7 @@
 #include <sys/types.h>
 #include <sys/wait.h>
 #include <sys/xattr.h>
+#include <thread>
 #include <unistd.h>
 
 #include <android-base/file.h>
@@ -102,6 +105,9 @@ static constexpr int kVerityPageSize = 4096;
 static constexpr size_t kSha256Size = 32;
 static constexpr const char* kPropApkVerityMode = "ro.apk_verity.mode";
 
+// Threads walking the cache trees of apps at once when freeing cache.
+static constexpr size_t kMaxCacheWalkThreads = 4;
+
 namespace {
 
 constexpr const char* kDump = "android.permission.DUMP";
@@ -291,6 +297,12 @@ status_t InstalldNativeService::dump(int fd, const Vector<String16> & /* args */
         }
     }
 
+    out << endl;
+    mDexoptScheduler.dump(out);
+
+    out << endl;
+    mTreeSizeCache.dump(out);
+
     out << endl;
     out.flush();
 
@@ -822,6 +834,13 @@ binder::Status InstalldNativeService::fixupAppData(const std::unique_ptr<std::st
 }
 
 static int32_t copy_directory_recursive(const char* from, const char* to) {
+    // Clones only take metadata, so try them first. Files cloned before a
+    // failure are simply replaced by cp.
+    if (clone_directory_recursive(from, to) == 0) {
+        LOG(DEBUG) << "Cloned " << from << " to " << to;
+        return 0;
+    }
+
     char *argv[] = {
         (char*) kCpPath,
         (char*) "-F", /* delete any existing destination file first (--remove-destination) */
@@ -1233,6 +1252,28 @@ binder::Status InstalldNativeService::destroyUserData(const std::unique_ptr<std:
     return res;
 }
 
+// Runs work on every tracker, spread across a few threads, since trackers walk
+// unrelated trees and the walks mostly wait for storage.
+static void forEachCacheTracker(const std::vector<std::shared_ptr<CacheTracker>>& trackers,
+        const std::function<void(CacheTracker*)>& work) {
+    std::atomic<size_t> next(0);
+    auto worker = [&]() {
+        size_t i;
+        while ((i = next++) < trackers.size()) {
+            work(trackers[i].get());
+        }
+    };
+    std::vector<std::thread> threads;
+    const size_t threadCount = std::min(trackers.size(), kMaxCacheWalkThreads);
+    for (size_t i = 1; i < threadCount; i++) {
+        threads.emplace_back(worker);
+    }
+    worker();
+    for (auto& thread : threads) {
+        thread.join();
+    }
+}
+
 binder::Status InstalldNativeService::freeCache(const std::unique_ptr<std::string>& uuid,
         int64_t targetFreeBytes, int64_t cacheReservedBytes, int32_t flags) {
     ENFORCE_UID(AID_SYSTEM);
@@ -1317,13 +1358,32 @@ binder::Status InstalldNativeService::freeCache(const std::unique_ptr<std::strin
         };
         std::priority_queue<std::shared_ptr<CacheTracker>,
                 std::vector<std::shared_ptr<CacheTracker>>, decltype(cmp)> queue(cmp);
+        std::vector<std::shared_ptr<CacheTracker>> allTrackers;
         for (const auto& it : trackers) {
-            it.second->loadStats();
-            queue.push(it.second);
-            cacheTotal += it.second->cacheUsed;
+            allTrackers.push_back(it.second);
+        }
+        forEachCacheTracker(allTrackers, [this](CacheTracker* tracker) {
+            tracker->loadStats(&mTreeSizeCache);
+        });
+        std::vector<std::shared_ptr<CacheTracker>> clearableTrackers;
+        for (const auto& tracker : allTrackers) {
+            queue.push(tracker);
+            cacheTotal += tracker->cacheUsed;
+            // Only these trackers can be cleared, so their items are loaded
+            // ahead of time, all at once.
+            if (tracker->cacheUsed > 0 && (tracker->getCacheRatio() >= 10000
+                    || (flags & FLAG_FREE_CACHE_V2_DEFY_QUOTA))) {
+                clearableTrackers.push_back(tracker);
+            }
         }
         ATRACE_END();
 
+        ATRACE_BEGIN("items");
+        forEachCacheTracker(clearableTrackers, [](CacheTracker* tracker) {
+            tracker->ensureItems();
+        });
+        ATRACE_END();
+
         // 3. Bounce across the queue, freeing items from whichever tracker is
         // the most over their assigned quota
         ATRACE_BEGIN("bounce");
@@ -1545,6 +1605,32 @@ static void collectManualStats(const std::string& path, struct stats* stats) {
     closedir(d);
 }
 
+// Most of the time spent measuring an app goes to walking its data, so the
+// sizes of its data trees are kept until they change.
+static void collectCachedManualStats(TreeSizeCache& cache, const std::string& path,
+        struct stats* stats) {
+    TreeSizeCache::Sizes sizes = cache.get(path, [](const std::string& tree) {
+        struct stats treeStats;
+        memset(&treeStats, 0, sizeof(treeStats));
+        collectManualStats(tree, &treeStats);
+        TreeSizeCache::Sizes sizes;
+        sizes.dataSize = treeStats.dataSize;
+        sizes.cacheSize = treeStats.cacheSize;
+        return sizes;
+    });
+    stats->dataSize += sizes.dataSize;
+    stats->cacheSize += sizes.cacheSize;
+}
+
+static void calculateCachedTreeSize(TreeSizeCache& cache, const std::string& path,
+        int64_t* size) {
+    *size += cache.get(path, [](const std::string& tree) {
+        TreeSizeCache::Sizes sizes;
+        calculate_tree_size(tree, &sizes.dataSize);
+        return sizes;
+    }).dataSize;
+}
+
 static void collectManualStatsForUser(const std::string& path, struct stats* stats,
         bool exclude_apps = false) {
     DIR *d;
@@ -1691,9 +1777,9 @@ binder::Status InstalldNativeService::getAppSize(const std::unique_ptr<std::stri
 
             ATRACE_BEGIN("data");
             auto cePath = create_data_user_ce_package_path(uuid_, userId, pkgname, ceDataInodes[i]);
-            collectManualStats(cePath, &stats);
+            collectCachedManualStats(mTreeSizeCache, cePath, &stats);
             auto dePath = create_data_user_de_package_path(uuid_, userId, pkgname);
-            collectManualStats(dePath, &stats);
+            collectCachedManualStats(mTreeSizeCache, dePath, &stats);
             ATRACE_END();
 
             if (!uuid) {
@@ -1709,9 +1795,9 @@ binder::Status InstalldNativeService::getAppSize(const std::unique_ptr<std::stri
 
             ATRACE_BEGIN("external");
             auto extPath = create_data_media_package_path(uuid_, userId, "data", pkgname);
-            collectManualStats(extPath, &extStats);
+            collectCachedManualStats(mTreeSizeCache, extPath, &extStats);
             auto mediaPath = create_data_media_package_path(uuid_, userId, "media", pkgname);
-            calculate_tree_size(mediaPath, &extStats.dataSize);
+            calculateCachedTreeSize(mTreeSizeCache, mediaPath, &extStats.dataSize);
             ATRACE_END();
         }
 
@@ -2110,10 +2196,21 @@ binder::Status InstalldNativeService::dexopt(const std::string& apkPath, int32_t
     }
     CHECK_ARGUMENT_PATH(outputPath);
     CHECK_ARGUMENT_PATH(dexMetadataPath);
-    std::lock_guard<std::recursive_mutex> lock(mLock);
 
-    const char* apk_path = apkPath.c_str();
     const char* pkgname = getCStr(packageName, "*");
+    // When dexopt jobs may run concurrently, they only take mLock to wait for
+    // the operation in progress, and then rely on the scheduler to keep the
+    // jobs of a package from overlapping. Other operations on the package being
+    // compiled are serialized by the package manager.
+    std::unique_lock<std::recursive_mutex> lock(mLock);
+    const bool concurrent = mDexoptScheduler.isConcurrent();
+    if (concurrent) {
+        lock.unlock();
+    }
+    DexoptScheduler::Job job = mDexoptScheduler.start(pkgname,
+            StringPrintf("%s %s (%s)", pkgname, apkPath.c_str(), instructionSet.c_str()));
+
+    const char* apk_path = apkPath.c_str();
     const char* instruction_set = instructionSet.c_str();
     const char* oat_dir = getCStr(outputPath);
     const char* compiler_filter = compilerFilter.c_str();
@@ -2247,17 +2344,11 @@ static void run_verify_idmap(const char *target_apk, const char *overlay_apk, in
     PLOG(ERROR) << "execl (" << kIdMapPath << ") failed";
 }
 
-static bool delete_stale_idmap(const char* target_apk, const char* overlay_apk,
-        const char* idmap_path, int32_t uid) {
-    int idmap_fd = open(idmap_path, O_RDWR);
-    if (idmap_fd < 0) {
-        PLOG(ERROR) << "idmap open failed: " << idmap_path;
-        unlink(idmap_path);
-        return true;
-    }
-
-    pid_t pid;
-    pid = fork();
+// Forks a child which drops to the given uid, locks the idmap and execs idmap on it, to
+// verify it or to generate it. Returns the pid of the child, or -1 if it couldn't fork.
+static pid_t fork_idmap(bool verify, const char* target_apk, const char* overlay_apk,
+        const char* idmap_path, int idmap_fd, int32_t uid) {
+    pid_t pid = fork();
     if (pid == 0) {
         /* child -- drop privileges before continuing */
         if (setgid(uid) != 0) {
@@ -2272,21 +2363,24 @@ static bool delete_stale_idmap(const char* target_apk, const char* overlay_apk,
             PLOG(ERROR) << "flock(" << idmap_path << ") failed during idmap";
             exit(1);
         }
+        // The idmaps are opened close-on-exec, so that the children running side by side don't
+        // get each other's. Only this child's own idmap is handed to idmap.
+        if (fcntl(idmap_fd, F_SETFD, 0) != 0) {
+            PLOG(ERROR) << "fcntl(" << idmap_path << ") failed during idmap";
+            exit(1);
+        }
 
-        run_verify_idmap(target_apk, overlay_apk, idmap_fd);
-        exit(1); /* only if exec call to deleting stale idmap failed */
-    } else {
-        int status = wait_child(pid);
-        close(idmap_fd);
-
-        if (status != 0) {
-            // Failed on verifying if idmap is made from target_apk and overlay_apk.
-            LOG(DEBUG) << "delete stale idmap: " << idmap_path;
-            unlink(idmap_path);
-            return true;
+        if (verify) {
+            run_verify_idmap(target_apk, overlay_apk, idmap_fd);
+        } else {
+            run_idmap(target_apk, overlay_apk, idmap_fd);
         }
+        exit(1); /* only if exec call to idmap failed */
+    }
+    if (pid < 0) {
+        PLOG(ERROR) << "fork failed during idmap";
     }
-    return false;
+    return pid;
 }
 
 // Transform string /a/b/c.apk to (prefix)/a@b@c.apk@(suffix)
@@ -2324,93 +2418,191 @@ static int flatten_path(const char *prefix, const char *suffix,
     return 0;
 }
 
-binder::Status InstalldNativeService::idmap(const std::string& targetApkPath,
-        const std::string& overlayApkPath, int32_t uid) {
-    ENFORCE_UID(AID_SYSTEM);
-    CHECK_ARGUMENT_PATH(targetApkPath);
-    CHECK_ARGUMENT_PATH(overlayApkPath);
-    std::lock_guard<std::recursive_mutex> lock(mLock);
-
-    const char* target_apk = targetApkPath.c_str();
-    const char* overlay_apk = overlayApkPath.c_str();
-    ALOGV("idmap target_apk=%s overlay_apk=%s uid=%d\n", target_apk, overlay_apk, uid);
+namespace {
 
-    int idmap_fd = -1;
-    char idmap_path[PATH_MAX];
-    struct stat idmap_stat;
+// An idmap being brought up to date by idmap() or idmaps()
+struct IdmapJob {
+    std::string targetApk;
+    std::string overlayApk;
+    char idmapPath[PATH_MAX];
+    int idmapFd = -1;
+    pid_t pid = -1;
     bool outdated = false;
+    bool failed = false;
+};
 
-    if (flatten_path(IDMAP_PREFIX, IDMAP_SUFFIX, overlay_apk,
-                idmap_path, sizeof(idmap_path)) == -1) {
-        ALOGE("idmap cannot generate idmap path for overlay %s\n", overlay_apk);
-        goto fail;
-    }
-
-    if (stat(idmap_path, &idmap_stat) < 0) {
-        outdated = true;
-    } else {
-        outdated = delete_stale_idmap(target_apk, overlay_apk, idmap_path, uid);
-    }
+}  // namespace
 
-    if (outdated) {
-        idmap_fd = open(idmap_path, O_RDWR | O_CREAT | O_EXCL, 0644);
-    } else {
-        idmap_fd = open(idmap_path, O_RDWR);
-    }
+// Starts a child for each of the jobs, with as many running at once as there are CPUs, and
+// hands the exit status of each child to finish(), in the order they were started.
+static void run_idmap_children(const std::vector<IdmapJob*>& jobs,
+        const std::function<pid_t(IdmapJob*)>& start,
+        const std::function<void(IdmapJob*, int)>& finish) {
+    const size_t maxChildren = std::max(1u, std::thread::hardware_concurrency());
+    std::deque<IdmapJob*> running;
+    auto finishOldest = [&]() {
+        IdmapJob* job = running.front();
+        running.pop_front();
+        finish(job, wait_child(job->pid));
+    };
 
-    if (idmap_fd < 0) {
-        ALOGE("idmap cannot open '%s' for output: %s\n", idmap_path, strerror(errno));
-        goto fail;
-    }
-    if (fchown(idmap_fd, AID_SYSTEM, uid) < 0) {
-        ALOGE("idmap cannot chown '%s'\n", idmap_path);
-        goto fail;
+    for (IdmapJob* job : jobs) {
+        if (running.size() == maxChildren) {
+            finishOldest();
+        }
+        job->pid = start(job);
+        if (job->pid < 0) {
+            finish(job, -1);
+        } else {
+            running.push_back(job);
+        }
     }
-    if (fchmod(idmap_fd, S_IRUSR | S_IWUSR | S_IRGRP | S_IROTH) < 0) {
-        ALOGE("idmap cannot chmod '%s'\n", idmap_path);
-        goto fail;
+    while (!running.empty()) {
+        finishOldest();
     }
+}
 
-    if (!outdated) {
-        close(idmap_fd);
-        return ok();
-    }
+// Brings the idmaps of the jobs up to date. The idmaps of different overlays are independent
+// files, so their idmap children run side by side, both to verify the existing idmaps and to
+// generate the missing and stale ones.
+static void update_idmaps(std::vector<IdmapJob>& jobs, int32_t uid) {
+    std::vector<IdmapJob*> existing;
+    for (IdmapJob& job : jobs) {
+        const char* overlay_apk = job.overlayApk.c_str();
+        ALOGV("idmap target_apk=%s overlay_apk=%s uid=%d\n", job.targetApk.c_str(), overlay_apk,
+                uid);
+        if (flatten_path(IDMAP_PREFIX, IDMAP_SUFFIX, overlay_apk,
+                    job.idmapPath, sizeof(job.idmapPath)) == -1) {
+            ALOGE("idmap cannot generate idmap path for overlay %s\n", overlay_apk);
+            job.failed = true;
+            continue;
+        }
 
-    pid_t pid;
-    pid = fork();
-    if (pid == 0) {
-        /* child -- drop privileges before continuing */
-        if (setgid(uid) != 0) {
-            ALOGE("setgid(%d) failed during idmap\n", uid);
-            exit(1);
+        struct stat idmap_stat;
+        if (stat(job.idmapPath, &idmap_stat) < 0) {
+            job.outdated = true;
+            continue;
         }
-        if (setuid(uid) != 0) {
-            ALOGE("setuid(%d) failed during idmap\n", uid);
-            exit(1);
+        job.idmapFd = open(job.idmapPath, O_RDWR | O_CLOEXEC);
+        if (job.idmapFd < 0) {
+            PLOG(ERROR) << "idmap open failed: " << job.idmapPath;
+            unlink(job.idmapPath);
+            job.outdated = true;
+            continue;
         }
-        if (flock(idmap_fd, LOCK_EX | LOCK_NB) != 0) {
-            ALOGE("flock(%s) failed during idmap: %s\n", idmap_path, strerror(errno));
-            exit(1);
+        existing.push_back(&job);
+    }
+
+    // Delete the idmaps which weren't made from their target and overlay.
+    run_idmap_children(existing,
+            [uid](IdmapJob* job) {
+                return fork_idmap(true /*verify*/, job->targetApk.c_str(),
+                        job->overlayApk.c_str(), job->idmapPath, job->idmapFd, uid);
+            },
+            [](IdmapJob* job, int status) {
+                close(job->idmapFd);
+                job->idmapFd = -1;
+                if (status != 0) {
+                    // Failed on verifying if idmap is made from target_apk and overlay_apk.
+                    LOG(DEBUG) << "delete stale idmap: " << job->idmapPath;
+                    unlink(job->idmapPath);
+                    job->outdated = true;
+                }
+            });
+
+    std::vector<IdmapJob*> outdated;
+    for (IdmapJob& job : jobs) {
+        if (job.failed) {
+            continue;
         }
 
-        run_idmap(target_apk, overlay_apk, idmap_fd);
-        exit(1); /* only if exec call to idmap failed */
-    } else {
-        int status = wait_child(pid);
-        if (status != 0) {
-            ALOGE("idmap failed, status=0x%04x\n", status);
-            goto fail;
+        if (job.outdated) {
+            job.idmapFd = open(job.idmapPath, O_RDWR | O_CREAT | O_EXCL | O_CLOEXEC, 0644);
+        } else {
+            job.idmapFd = open(job.idmapPath, O_RDWR | O_CLOEXEC);
+        }
+        if (job.idmapFd < 0) {
+            ALOGE("idmap cannot open '%s' for output: %s\n", job.idmapPath, strerror(errno));
+            job.failed = true;
+            continue;
+        }
+        if (fchown(job.idmapFd, AID_SYSTEM, uid) < 0) {
+            ALOGE("idmap cannot chown '%s'\n", job.idmapPath);
+            job.failed = true;
+        } else if (fchmod(job.idmapFd, S_IRUSR | S_IWUSR | S_IRGRP | S_IROTH) < 0) {
+            ALOGE("idmap cannot chmod '%s'\n", job.idmapPath);
+            job.failed = true;
+        }
+        if (job.failed) {
+            close(job.idmapFd);
+            unlink(job.idmapPath);
+            continue;
+        }
+
+        if (job.outdated) {
+            outdated.push_back(&job);
+        } else {
+            close(job.idmapFd);
         }
     }
 
-    close(idmap_fd);
-    return ok();
-fail:
-    if (idmap_fd >= 0) {
-        close(idmap_fd);
-        unlink(idmap_path);
+    run_idmap_children(outdated,
+            [uid](IdmapJob* job) {
+                return fork_idmap(false /*verify*/, job->targetApk.c_str(),
+                        job->overlayApk.c_str(), job->idmapPath, job->idmapFd, uid);
+            },
+            [](IdmapJob* job, int status) {
+                close(job->idmapFd);
+                if (status != 0) {
+                    ALOGE("idmap failed, status=0x%04x\n", status);
+                    unlink(job->idmapPath);
+                    job->failed = true;
+                }
+            });
+}
+
+binder::Status InstalldNativeService::idmap(const std::string& targetApkPath,
+        const std::string& overlayApkPath, int32_t uid) {
+    ENFORCE_UID(AID_SYSTEM);
+    CHECK_ARGUMENT_PATH(targetApkPath);
+    CHECK_ARGUMENT_PATH(overlayApkPath);
+    std::lock_guard<std::recursive_mutex> lock(mLock);
+
+    std::vector<IdmapJob> jobs(1);
+    jobs[0].targetApk = targetApkPath;
+    jobs[0].overlayApk = overlayApkPath;
+    update_idmaps(jobs, uid);
+    return jobs[0].failed ? error() : ok();
+}
+
+binder::Status InstalldNativeService::idmaps(const std::vector<std::string>& targetApkPaths,
+        const std::vector<std::string>& overlayApkPaths, int32_t uid) {
+    ENFORCE_UID(AID_SYSTEM);
+    if (targetApkPaths.size() != overlayApkPaths.size()) {
+        return error("Expected as many target as overlay paths, got "
+                + std::to_string(targetApkPaths.size()) + " and "
+                + std::to_string(overlayApkPaths.size()));
+    }
+    for (size_t i = 0; i < targetApkPaths.size(); i++) {
+        CHECK_ARGUMENT_PATH(targetApkPaths[i]);
+        CHECK_ARGUMENT_PATH(overlayApkPaths[i]);
+    }
+    std::lock_guard<std::recursive_mutex> lock(mLock);
+
+    std::vector<IdmapJob> jobs(targetApkPaths.size());
+    for (size_t i = 0; i < jobs.size(); i++) {
+        jobs[i].targetApk = targetApkPaths[i];
+        jobs[i].overlayApk = overlayApkPaths[i];
+    }
+    update_idmaps(jobs, uid);
+
+    std::string failed;
+    for (const IdmapJob& job : jobs) {
+        if (job.failed) {
+            failed += failed.empty() ? job.overlayApk : ", " + job.overlayApk;
+        }
     }
-    return error();
+    return failed.empty() ? ok() : error("Failed to update the idmaps of " + failed);
 }
 
 binder::Status InstalldNativeService::removeIdmap(const std::string& overlayApkPath) {
@@ -29,6 +29,8 @@
 #include <cutils/multiuser.h>
 
 #include "android/os/BnInstalld.h"
+#include "DexoptScheduler.h"
+#include "TreeSizeCache.h"
 #include "installd_constants.h"
 
 namespace android {
@@ -121,6 +123,8 @@ public:
 
     binder::Status idmap(const std::string& targetApkPath, const std::string& overlayApkPath,
             int32_t uid);
+    binder::Status idmaps(const std::vector<std::string>& targetApkPaths,
+            const std::vector<std::string>& overlayApkPaths, int32_t uid);
     binder::Status removeIdmap(const std::string& overlayApkPath);
     binder::Status rmPackageDir(const std::string& packageDir);
     binder::Status freeCache(const std::unique_ptr<std::string>& uuid, int64_t targetFreeBytes,
@@ -168,6 +172,12 @@ private:
     /* Map from UID to cache quota size */
     std::unordered_map<uid_t, int64_t> mCacheQuotas;
 
+    /* Admits the dexopt jobs that run at once */
+    DexoptScheduler mDexoptScheduler;
+
+    /* Sizes of the app data trees measured without quotas */
+    TreeSizeCache mTreeSizeCache;
+
     std::string findDataMediaPath(const std::unique_ptr<std::string>& uuid, userid_t userid);
 };
 
@@ -0,0 +1,232 @@
+/*
+ * Copyright (C) 2019 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "TreeSizeCache.h"
+
+#include <errno.h>
+#include <fts.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+
+#include <android-base/logging.h>
+
+namespace android {
+namespace installd {
+
+// Everything which may change the space a tree occupies.
+static constexpr uint32_t kWatchMask = IN_CREATE | IN_DELETE | IN_MODIFY | IN_CLOSE_WRITE |
+        IN_MOVED_FROM | IN_MOVED_TO | IN_DELETE_SELF | IN_MOVE_SELF | IN_ONLYDIR |
+        IN_DONT_FOLLOW;
+
+TreeSizeCache::TreeSizeCache(size_t maxWatches)
+        : mMaxWatches(maxWatches), mInotifyFd(inotify_init1(IN_NONBLOCK | IN_CLOEXEC)) {
+    if (mInotifyFd < 0) {
+        PLOG(WARNING) << "Failed to init inotify; tree sizes won't be cached";
+    }
+}
+
+TreeSizeCache::Sizes TreeSizeCache::get(const std::string& path, const Measure& measure) {
+    if (mInotifyFd < 0) {
+        return measure(path);
+    }
+
+    std::unique_lock<std::mutex> lock(mLock);
+    drainEventsLocked();
+    auto it = mEntries.find(path);
+    if (it != mEntries.end()) {
+        if (it->second.measured) {
+            mHits++;
+            it->second.lastUse = mNextUse++;
+            return it->second.sizes;
+        }
+        // Another thread is measuring the tree already.
+        mMisses++;
+        lock.unlock();
+        return measure(path);
+    }
+    mMisses++;
+
+    // The tree is watched before being measured, so that any change racing
+    // with the measurement keeps it out of the cache.
+    it = mEntries.emplace(path, Entry()).first;
+    if (!watchTreeLocked(path, &it->second)) {
+        eraseLocked(it);
+        lock.unlock();
+        return measure(path);
+    }
+
+    lock.unlock();
+    const Sizes sizes = measure(path);
+    lock.lock();
+
+    drainEventsLocked();
+    it = mEntries.find(path);
+    if (it->second.stale) {
+        eraseLocked(it);
+    } else {
+        it->second.measured = true;
+        it->second.sizes = sizes;
+        it->second.lastUse = mNextUse++;
+    }
+    return sizes;
+}
+
+bool TreeSizeCache::watchTreeLocked(const std::string& path, Entry* entry) {
+    char *argv[] = { (char*) path.c_str(), nullptr };
+    FTS* fts = fts_open(argv, FTS_PHYSICAL | FTS_NOCHDIR | FTS_XDEV | FTS_NOSTAT, nullptr);
+    if (fts == nullptr) {
+        return false;
+    }
+    // Directories are watched as they are entered, before their children are
+    // read, so that none is created unseen.
+    bool watched = false;
+    FTSENT* p;
+    while ((p = fts_read(fts)) != nullptr) {
+        switch (p->fts_info) {
+        case FTS_D:
+            if (!addWatchLocked(p->fts_accpath, path, entry)) {
+                fts_close(fts);
+                return false;
+            }
+            watched = true;
+            break;
+        case FTS_DNR:
+        case FTS_ERR:
+        case FTS_NS:
+            // Parts of the tree we can't watch.
+            fts_close(fts);
+            return false;
+        }
+    }
+    fts_close(fts);
+    // Missing trees and single files aren't cached.
+    return watched;
+}
+
+bool TreeSizeCache::addWatchLocked(const char* directory, const std::string& path,
+        Entry* entry) {
+    // Watches shared with other trees are reused, so only new ones need room.
+    int wd = inotify_add_watch(mInotifyFd, directory, kWatchMask);
+    if (wd < 0) {
+        if (errno != ENOENT) {
+            PLOG(WARNING) << "Failed to watch " << directory;
+        }
+        return false;
+    }
+    auto watch = mWatches.find(wd);
+    if (watch == mWatches.end()) {
+        while (mWatches.size() >= mMaxWatches) {
+            if (!evictLocked()) {
+                inotify_rm_watch(mInotifyFd, wd);
+                return false;
+            }
+        }
+        watch = mWatches.emplace(wd, std::set<std::string>()).first;
+    }
+    watch->second.insert(path);
+    entry->watches.push_back(wd);
+    return true;
+}
+
+void TreeSizeCache::drainEventsLocked() {
+    alignas(struct inotify_event) char buffer[4096];
+    ssize_t length;
+    while ((length = TEMP_FAILURE_RETRY(read(mInotifyFd, buffer, sizeof(buffer)))) > 0) {
+        for (char* event = buffer; event < buffer + length;) {
+            const struct inotify_event* e = reinterpret_cast<struct inotify_event*>(event);
+            event += sizeof(struct inotify_event) + e->len;
+
+            if (e->mask & IN_Q_OVERFLOW) {
+                std::set<std::string> paths;
+                for (const auto& entry : mEntries) {
+                    paths.insert(entry.first);
+                }
+                invalidateLocked(paths);
+                continue;
+            }
+            auto watch = mWatches.find(e->wd);
+            if (watch == mWatches.end()) {
+                continue;
+            }
+            // The watch set changes as entries are erased.
+            const std::set<std::string> paths = watch->second;
+            invalidateLocked(paths);
+            if (e->mask & IN_IGNORED) {
+                // The kernel dropped the watch, and may reuse its descriptor.
+                mWatches.erase(e->wd);
+            }
+        }
+    }
+    if (length < 0 && errno != EAGAIN) {
+        PLOG(WARNING) << "Failed to read inotify events";
+    }
+}
+
+void TreeSizeCache::invalidateLocked(const std::set<std::string>& paths) {
+    for (const auto& path : paths) {
+        auto it = mEntries.find(path);
+        if (it == mEntries.end()) {
+            continue;
+        }
+        mInvalidations++;
+        if (it->second.measured) {
+            eraseLocked(it);
+        } else {
+            it->second.stale = true;
+        }
+    }
+}
+
+void TreeSizeCache::eraseLocked(std::map<std::string, Entry>::iterator it) {
+    for (int wd : it->second.watches) {
+        auto watch = mWatches.find(wd);
+        if (watch == mWatches.end()) {
+            continue;
+        }
+        watch->second.erase(it->first);
+        if (watch->second.empty()) {
+            inotify_rm_watch(mInotifyFd, wd);
+            mWatches.erase(watch);
+        }
+    }
+    mEntries.erase(it);
+}
+
+bool TreeSizeCache::evictLocked() {
+    auto oldest = mEntries.end();
+    for (auto it = mEntries.begin(); it != mEntries.end(); it++) {
+        if (it->second.measured &&
+                (oldest == mEntries.end() || it->second.lastUse < oldest->second.lastUse)) {
+            oldest = it;
+        }
+    }
+    if (oldest == mEntries.end()) {
+        return false;
+    }
+    eraseLocked(oldest);
+    return true;
+}
+
+void TreeSizeCache::dump(std::ostream& out) {
+    std::lock_guard<std::mutex> lock(mLock);
+    out << "Tree size cache: " << mEntries.size() << " trees, " << mWatches.size() << "/"
+        << mMaxWatches << " watches" << std::endl;
+    out << "    " << mHits << " hits, " << mMisses << " misses, " << mInvalidations
+        << " invalidations" << std::endl;
+}
+
+}  // namespace installd
+}  // namespace android
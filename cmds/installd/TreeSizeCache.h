@@ -0,0 +1,101 @@
+/*
+ * Copyright (C) 2019 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef ANDROID_INSTALLD_TREE_SIZE_CACHE_H
+#define ANDROID_INSTALLD_TREE_SIZE_CACHE_H
+
+#include <functional>
+#include <map>
+#include <mutex>
+#include <ostream>
+#include <set>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <android-base/macros.h>
+#include <android-base/unique_fd.h>
+
+namespace android {
+namespace installd {
+
+/**
+ * Caches the sizes measured for directory trees, for the storage queries which
+ * can't rely on quotas. Every directory of a cached tree is watched with
+ * inotify, and any change within the tree drops its sizes until they are
+ * measured again.
+ *
+ * Writes through a shared mapping raise no event of their own, so they are only
+ * seen once the file is closed, or when something else changes in the tree.
+ */
+class TreeSizeCache {
+public:
+    struct Sizes {
+        int64_t dataSize = 0;
+        int64_t cacheSize = 0;
+    };
+
+    using Measure = std::function<Sizes(const std::string& path)>;
+
+    // maxWatches caps the inotify watches held for all the cached trees.
+    explicit TreeSizeCache(size_t maxWatches = 4096);
+
+    /**
+     * Returns the sizes of the tree at path, running measure on it unless they
+     * are cached. A path must always be measured the same way.
+     */
+    Sizes get(const std::string& path, const Measure& measure);
+
+    void dump(std::ostream& out);
+
+private:
+    struct Entry {
+        std::vector<int> watches;
+        Sizes sizes;
+        // Whether sizes holds a measurement, rather than one being taken.
+        bool measured = false;
+        // Whether the tree changed while it was being measured.
+        bool stale = false;
+        uint64_t lastUse = 0;
+    };
+
+    bool watchTreeLocked(const std::string& path, Entry* entry);
+    bool addWatchLocked(const char* directory, const std::string& path, Entry* entry);
+    void drainEventsLocked();
+    void invalidateLocked(const std::set<std::string>& paths);
+    void eraseLocked(std::map<std::string, Entry>::iterator it);
+    bool evictLocked();
+
+    const size_t mMaxWatches;
+    android::base::unique_fd mInotifyFd;
+
+    std::mutex mLock;
+    std::map<std::string, Entry> mEntries;
+    // The paths of the entries each watch belongs to.
+    std::unordered_map<int, std::set<std::string>> mWatches;
+    uint64_t mNextUse = 0;
+
+    uint64_t mHits = 0;
+    uint64_t mMisses = 0;
+    uint64_t mInvalidations = 0;
+
+    DISALLOW_COPY_AND_ASSIGN(TreeSizeCache);
+};
+
+}  // namespace installd
+}  // namespace android
+
+#endif  // ANDROID_INSTALLD_TREE_SIZE_CACHE_H
@@ -17,6 +17,7 @@
 
 #include <array>
 #include <fcntl.h>
+#include <inttypes.h>
 #include <stdlib.h>
 #include <string.h>
 #include <sys/capability.h>
@@ -29,6 +30,8 @@
 #include <unistd.h>
 
 #include <iomanip>
+#include <map>
+#include <mutex>
 
 #include <android-base/file.h>
 #include <android-base/logging.h>
@@ -812,6 +815,36 @@ class RunProfman : public ExecVHelper {
 };
 
 
+// Profiles profman last found not worth compiling, by location. As long as none of them changes,
+// analyzing them again reaches the same outcome, so profman doesn't need to run.
+static std::mutex skipped_profiles_lock;
+static std::map<std::string, std::string> skipped_profiles;
+static constexpr size_t kMaxSkippedProfiles = 1024;
+
+// Describes the profiles given to profman well enough to tell when any of them was written or
+// replaced since.
+static bool get_profiles_signature(const std::vector<unique_fd>& profiles_fd,
+        const unique_fd& reference_profile_fd, std::string* signature) {
+    signature->clear();
+    auto append = [&](const unique_fd& fd) {
+        struct stat st;
+        if (fstat(fd.get(), &st) != 0) {
+            return false;
+        }
+        // Writes update the change time, and replacing a profile changes its inode.
+        *signature += StringPrintf("%" PRIu64 ":%" PRIu64 ":%" PRId64 ":%" PRId64 ".%09ld;",
+                static_cast<uint64_t>(st.st_dev), static_cast<uint64_t>(st.st_ino),
+                static_cast<int64_t>(st.st_size), static_cast<int64_t>(st.st_ctim.tv_sec),
+                st.st_ctim.tv_nsec);
+        return true;
+    };
+    for (const unique_fd& fd : profiles_fd) {
+        if (!append(fd)) {
+            return false;
+        }
+    }
+    return append(reference_profile_fd);
+}
 
 // Decides if profile guided compilation is needed or not based on existing profiles.
 // The location is the package name for primary apks or the dex path for secondary dex files.
@@ -831,6 +864,21 @@ static bool analyze_profiles(uid_t uid, const std::string& package_name,
         return false;
     }
 
+    // Taken before profman runs, so that profiles written meanwhile are analyzed again.
+    const std::string key = StringPrintf("%d:%s:%s:%d", uid, package_name.c_str(),
+            location.c_str(), is_secondary_dex);
+    std::string signature;
+    bool has_signature = get_profiles_signature(profiles_fd, reference_profile_fd, &signature);
+    if (has_signature) {
+        std::lock_guard<std::mutex> lock(skipped_profiles_lock);
+        auto it = skipped_profiles.find(key);
+        if (it != skipped_profiles.end() && it->second == signature) {
+            LOG(DEBUG) << "Profiles unchanged for location " << location
+                    << "; skipping profman";
+            return false;
+        }
+    }
+
     RunProfman profman_merge;
     profman_merge.SetupMerge(profiles_fd, reference_profile_fd);
     pid_t pid = fork();
@@ -844,6 +892,8 @@ static bool analyze_profiles(uid_t uid, const std::string& package_name,
     bool need_to_compile = false;
     bool should_clear_current_profiles = false;
     bool should_clear_reference_profile = false;
+    // Whether profman left the profiles as they were.
+    bool skipped_compilation = false;
     if (!WIFEXITED(return_code)) {
         LOG(WARNING) << "profman failed for location " << location << ": " << return_code;
     } else {
@@ -858,6 +908,7 @@ static bool analyze_profiles(uid_t uid, const std::string& package_name,
                 need_to_compile = false;
                 should_clear_current_profiles = false;
                 should_clear_reference_profile = false;
+                skipped_compilation = true;
                 break;
             case PROFMAN_BIN_RETURN_CODE_BAD_PROFILES:
                 LOG(WARNING) << "Bad profiles for location " << location;
@@ -884,6 +935,18 @@ static bool analyze_profiles(uid_t uid, const std::string& package_name,
         }
     }
 
+    {
+        std::lock_guard<std::mutex> lock(skipped_profiles_lock);
+        if (has_signature && skipped_compilation) {
+            if (skipped_profiles.size() >= kMaxSkippedProfiles) {
+                skipped_profiles.clear();
+            }
+            skipped_profiles[key] = signature;
+        } else {
+            skipped_profiles.erase(key);
+        }
+    }
+
     if (should_clear_current_profiles) {
         if (is_secondary_dex) {
             // For secondary dex files, the owning user is the current user.
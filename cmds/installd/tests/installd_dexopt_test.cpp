@@ -14,7 +14,11 @@
  * limitations under the License.
  */
 
+#include <atomic>
+#include <chrono>
 #include <cstdlib>
+#include <thread>
+#include <vector>
 #include <fcntl.h>
 #include <stdlib.h>
 #include <string.h>
@@ -35,6 +39,7 @@
 #include <selinux/android.h>
 #include <selinux/avc.h>
 
+#include "DexoptScheduler.h"
 #include "binder_test_utils.h"
 #include "dexopt.h"
 #include "InstalldNativeService.h"
@@ -1253,5 +1258,60 @@ TEST_F(DexoptTest, select_execution_binary) {
         /*is_debuggable_build=*/ false));
 }
 
+TEST(DexoptSchedulerTest, JobsStayWithinBudget) {
+    DexoptScheduler::Budget budget;
+    budget.maxJobs = 3;
+    budget.memoryBytes = 1024;
+    budget.jobMemoryBytes = 512;
+    DexoptScheduler scheduler([budget] { return budget; });
+    ASSERT_TRUE(scheduler.isConcurrent());
+
+    std::atomic<int> running(0);
+    std::atomic<int> maxRunning(0);
+    std::vector<std::thread> threads;
+    for (int i = 0; i < 8; i++) {
+        threads.emplace_back([&, i] {
+            DexoptScheduler::Job job =
+                    scheduler.start(android::base::StringPrintf("package%d", i % 4), "test job");
+            int now = ++running;
+            int max = maxRunning;
+            while (now > max && !maxRunning.compare_exchange_weak(max, now)) {}
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+            running--;
+        });
+    }
+    for (std::thread& thread : threads) {
+        thread.join();
+    }
+
+    // The memory budget only fits two jobs.
+    EXPECT_EQ(2, maxRunning);
+}
+
+TEST(DexoptSchedulerTest, JobsOfAPackageDontOverlap) {
+    DexoptScheduler::Budget budget;
+    budget.maxJobs = 4;
+    DexoptScheduler scheduler([budget] { return budget; });
+
+    std::atomic<int> running(0);
+    std::atomic<bool> overlapped(false);
+    std::vector<std::thread> threads;
+    for (int i = 0; i < 4; i++) {
+        threads.emplace_back([&] {
+            DexoptScheduler::Job job = scheduler.start("package", "test job");
+            if (++running > 1) {
+                overlapped = true;
+            }
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+            running--;
+        });
+    }
+    for (std::thread& thread : threads) {
+        thread.join();
+    }
+
+    EXPECT_FALSE(overlapped);
+}
+
 }  // namespace installd
 }  // namespace android
@@ -17,6 +17,7 @@
 #include <sstream>
 #include <string>
 
+#include <dirent.h>
 #include <fcntl.h>
 #include <stdlib.h>
 #include <string.h>
@@ -34,6 +35,7 @@
 
 #include "binder_test_utils.h"
 #include "InstalldNativeService.h"
+#include "TreeSizeCache.h"
 #include "dexopt.h"
 #include "globals.h"
 #include "utils.h"
@@ -249,6 +251,84 @@ TEST_F(ServiceTest, CalculateCache) {
     EXPECT_EQ("/data/dalvik-cache/isa/path@to@file.apk@classes.dex", std::string(buf));
 }
 
+TEST_F(ServiceTest, TreeSizeCache_InvalidatedOnChange) {
+    mkdir("com.example", 10000, 10000, 0700);
+    mkdir("com.example/files", 10000, 10000, 0700);
+
+    int measurements = 0;
+    auto measure = [&](const std::string&) {
+        measurements++;
+        return TreeSizeCache::Sizes();
+    };
+    TreeSizeCache cache;
+    const std::string path = get_full_path("com.example");
+
+    cache.get(path, measure);
+    cache.get(path, measure);
+    EXPECT_EQ(1, measurements);
+
+    // Changes deep in the tree drop the cached sizes.
+    touch("com.example/files/file", 10000, 10000, 0700);
+    cache.get(path, measure);
+    EXPECT_EQ(2, measurements);
+    cache.get(path, measure);
+    EXPECT_EQ(2, measurements);
+}
+
+TEST_F(ServiceTest, TreeSizeCache_MissingTreeNotCached) {
+    int measurements = 0;
+    auto measure = [&](const std::string&) {
+        measurements++;
+        return TreeSizeCache::Sizes();
+    };
+    TreeSizeCache cache;
+    const std::string path = get_full_path("com.example");
+
+    cache.get(path, measure);
+    cache.get(path, measure);
+    EXPECT_EQ(2, measurements);
+}
+
+static size_t count_open_fds() {
+    size_t count = 0;
+    DIR* dir = opendir("/proc/self/fd");
+    EXPECT_NE(nullptr, dir);
+    while (dir != nullptr && readdir(dir) != nullptr) {
+        count++;
+    }
+    if (dir != nullptr) {
+        closedir(dir);
+    }
+    return count;
+}
+
+TEST_F(ServiceTest, Idmaps_MismatchedPaths) {
+    std::vector<std::string> targets = {"/system/framework/framework-res.apk"};
+    std::vector<std::string> overlays;
+    EXPECT_BINDER_FAIL(service->idmaps(targets, overlays, 10000));
+}
+
+TEST_F(ServiceTest, Idmaps_NamesFailedOverlays) {
+    touch("overlay1.apk", 10000, 10000, 0644);
+    touch("overlay2.apk", 10000, 10000, 0644);
+    std::vector<std::string> targets(2, "/system/framework/framework-res.apk");
+    std::vector<std::string> overlays = {get_full_path("overlay1.apk"),
+                                         get_full_path("overlay2.apk")};
+
+    // Neither overlay is an apk, so the idmap children of both fail, side by side.
+    const size_t fds = count_open_fds();
+    binder::Status status = service->idmaps(targets, overlays, 10000);
+    ASSERT_FALSE(status.isOk());
+    const std::string message = status.exceptionMessage().string();
+    EXPECT_NE(std::string::npos, message.find(overlays[0])) << message;
+    EXPECT_NE(std::string::npos, message.find(overlays[1])) << message;
+
+    // The failed idmaps are not left behind, nor are their fds.
+    EXPECT_NE(0, access("/data/resource-cache/data@local@tmp@user@0@overlay1.apk@idmap", F_OK));
+    EXPECT_NE(0, access("/data/resource-cache/data@local@tmp@user@0@overlay2.apk@idmap", F_OK));
+    EXPECT_EQ(fds, count_open_fds());
+}
+
 static bool mkdirs(const std::string& path, mode_t mode) {
     struct stat sb;
     if (stat(path.c_str(), &sb) != -1 && S_ISDIR(sb.st_mode)) {
@@ -14,11 +14,15 @@
  * limitations under the License.
  */
 
+#include <fcntl.h>
 #include <stdlib.h>
 #include <string.h>
 
+#include <android-base/file.h>
 #include <android-base/logging.h>
 #include <android-base/scopeguard.h>
+#include <android-base/stringprintf.h>
+#include <diskusage/dirsize.h>
 #include <gtest/gtest.h>
 
 #include "InstalldNativeService.h"
@@ -628,5 +632,89 @@ TEST_F(UtilsTest, TestCreateDirIfNeeded) {
     ASSERT_NE(0, create_dir_if_needed("/data/local/tmp/user/0/bar/baz", 0700));
 }
 
+TEST_F(UtilsTest, TestCloneDirectoryRecursive) {
+    system("mkdir -p /data/local/tmp/user/0/from/dir /data/local/tmp/user/0/to");
+    system("echo data > /data/local/tmp/user/0/from/dir/file");
+    system("chmod 0751 /data/local/tmp/user/0/from/dir");
+
+    auto deleter = [&]() {
+        delete_dir_contents_and_dir("/data/local/tmp/user/0", true /* ignore_if_missing */);
+    };
+    auto scope_guard = android::base::make_scope_guard(deleter);
+
+    // Cloning needs reflink support from the filesystem, but directories get
+    // their attributes back either way.
+    int res = clone_directory_recursive("/data/local/tmp/user/0/from",
+            "/data/local/tmp/user/0/to");
+    struct stat st;
+    ASSERT_EQ(0, stat("/data/local/tmp/user/0/to/from/dir", &st));
+    EXPECT_EQ(0751, st.st_mode & ALLPERMS);
+    if (res == 0) {
+        std::string content;
+        ASSERT_TRUE(android::base::ReadFileToString("/data/local/tmp/user/0/to/from/dir/file",
+                &content));
+        EXPECT_EQ("data\n", content);
+    } else {
+        EXPECT_NE(0, access("/data/local/tmp/user/0/to/from/dir/file", F_OK));
+    }
+}
+
+// Fills the directory with a tree wider than the directories a parallel walk queues at once.
+static void create_sized_tree(const std::string& root) {
+    using android::base::StringPrintf;
+    for (int i = 0; i < 100; i++) {
+        std::string dir = StringPrintf("%s/dir%d/sub/subsub", root.c_str(), i);
+        system(("mkdir -p " + dir).c_str());
+        android::base::WriteStringToFile(std::string(i * 97, 'x'), dir + "/file");
+        android::base::WriteStringToFile(std::string(4096 + i, 'y'),
+                StringPrintf("%s/dir%d/file", root.c_str(), i));
+        symlink("file", StringPrintf("%s/dir%d/link", root.c_str(), i).c_str());
+    }
+}
+
+TEST_F(UtilsTest, CalculateDirSizeParallel) {
+    system("mkdir -p /data/local/tmp/user/0/tree");
+    auto deleter = [&]() {
+        delete_dir_contents_and_dir("/data/local/tmp/user/0", true /* ignore_if_missing */);
+    };
+    auto scope_guard = android::base::make_scope_guard(deleter);
+    create_sized_tree("/data/local/tmp/user/0/tree");
+
+    int64_t expected = calculate_dir_size(open("/data/local/tmp/user/0/tree",
+            O_RDONLY | O_DIRECTORY | O_CLOEXEC));
+    ASSERT_GT(expected, 0);
+    for (int threads : {1, 2, 8}) {
+        int dfd = open("/data/local/tmp/user/0/tree", O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+        ASSERT_GE(dfd, 0);
+        EXPECT_EQ(expected, calculate_dir_size_parallel(dfd, threads)) << threads << " threads";
+    }
+}
+
+TEST_F(UtilsTest, CalculateTreeSize_WholeTreeMatchesFtsWalk) {
+    system("mkdir -p /data/local/tmp/user/0/tree");
+    auto deleter = [&]() {
+        delete_dir_contents_and_dir("/data/local/tmp/user/0", true /* ignore_if_missing */);
+    };
+    auto scope_guard = android::base::make_scope_guard(deleter);
+    create_sized_tree("/data/local/tmp/user/0/tree");
+
+    // Without filters the tree is walked in parallel. Excluding a gid that owns nothing filters
+    // nothing out, but takes the fts walk.
+    int64_t wholeSize = 0;
+    int64_t ftsSize = 0;
+    ASSERT_EQ(0, calculate_tree_size("/data/local/tmp/user/0/tree", &wholeSize));
+    ASSERT_EQ(0, calculate_tree_size("/data/local/tmp/user/0/tree", &ftsSize, -1, 123456));
+    EXPECT_GT(wholeSize, 0);
+    EXPECT_EQ(ftsSize, wholeSize);
+
+    // A file is measured by the fts walk, and a missing path is an error.
+    int64_t fileSize = 0;
+    ASSERT_EQ(0, calculate_tree_size("/data/local/tmp/user/0/tree/dir1/file", &fileSize));
+    EXPECT_GT(fileSize, 0);
+    int64_t missingSize = 0;
+    EXPECT_EQ(-1, calculate_tree_size("/data/local/tmp/user/0/missing", &missingSize));
+    EXPECT_EQ(0, missingSize);
+}
+
 }  // namespace installd
 }  // namespace android
@@ -19,19 +19,23 @@
 #include <errno.h>
 #include <fcntl.h>
 #include <fts.h>
+#include <linux/fs.h>
 #include <stdlib.h>
 #include <sys/capability.h>
+#include <sys/ioctl.h>
 #include <sys/stat.h>
 #include <sys/wait.h>
 #include <sys/xattr.h>
 #include <sys/statvfs.h>
 
+#include <android-base/file.h>
 #include <android-base/logging.h>
 #include <android-base/strings.h>
 #include <android-base/stringprintf.h>
 #include <android-base/unique_fd.h>
 #include <cutils/fs.h>
 #include <cutils/properties.h>
+#include <diskusage/dirsize.h>
 #include <log/log.h>
 #include <private/android_filesystem_config.h>
 
@@ -376,11 +380,42 @@ std::vector<userid_t> get_known_users(const char* volume_uuid) {
     return users;
 }
 
+// Number of threads measuring a tree that is measured whole
+static constexpr int kTreeSizeThreads = 4;
+
+/**
+ * Measures the whole tree under path, the same as the fts walk of calculate_tree_size() without
+ * filters, but on several threads. Returns false if path is not a directory that can be opened,
+ * which is left to the fts walk.
+ */
+static bool calculate_whole_tree_size(const std::string& path, int64_t* size) {
+    int dfd = open(path.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (dfd < 0) {
+        return false;
+    }
+    struct stat st;
+    if (fstat(dfd, &st) != 0) {
+        close(dfd);
+        return false;
+    }
+    // The walk takes the fd, and doesn't count the directory itself
+    *size = stat_size(&st) + calculate_dir_size_parallel(dfd, kTreeSizeThreads);
+    return true;
+}
+
 int calculate_tree_size(const std::string& path, int64_t* size,
         int32_t include_gid, int32_t exclude_gid, bool exclude_apps) {
     FTS *fts;
     FTSENT *p;
     int64_t matchedSize = 0;
+    if (include_gid == -1 && exclude_gid == -1 && !exclude_apps
+            && calculate_whole_tree_size(path, &matchedSize)) {
+#if MEASURE_DEBUG
+        LOG(DEBUG) << "Measured " << path << " size " << matchedSize;
+#endif
+        *size += matchedSize;
+        return 0;
+    }
     char *argv[] = { (char*) path.c_str(), nullptr };
     if (!(fts = fts_open(argv, FTS_PHYSICAL | FTS_NOCHDIR | FTS_XDEV, nullptr))) {
         if (errno != ENOENT) {
@@ -714,6 +749,111 @@ int copy_dir_files(const char *srcname,
     return res;
 }
 
+static int preserve_attributes(const char* path, const struct stat* st) {
+    if (lchown(path, st->st_uid, st->st_gid) != 0) {
+        return -1;
+    }
+    // Symlinks have no mode of their own, and chown clears setuid bits.
+    if (!S_ISLNK(st->st_mode) && chmod(path, st->st_mode & ALLPERMS) != 0) {
+        return -1;
+    }
+    const struct timespec times[] = { st->st_atim, st->st_mtim };
+    return utimensat(AT_FDCWD, path, times, AT_SYMLINK_NOFOLLOW);
+}
+
+static int clone_file(const char* from, const char* to) {
+    if (unlink(to) != 0 && errno != ENOENT) {
+        return -1;
+    }
+    android::base::unique_fd from_fd(open(from, O_RDONLY | O_CLOEXEC | O_NOFOLLOW));
+    if (from_fd == -1) {
+        return -1;
+    }
+    android::base::unique_fd to_fd(
+            open(to, O_WRONLY | O_CREAT | O_EXCL | O_CLOEXEC | O_NOFOLLOW, 0600));
+    if (to_fd == -1) {
+        return -1;
+    }
+    if (ioctl(to_fd, FICLONE, from_fd.get()) != 0) {
+        int error = errno;
+        unlink(to);
+        errno = error;
+        return -1;
+    }
+    return 0;
+}
+
+static int clone_symlink(const char* from, const char* to, off_t size) {
+    std::string target(size, '\0');
+    if (readlink(from, &target[0], target.size()) != size) {
+        return -1;
+    }
+    if (unlink(to) != 0 && errno != ENOENT) {
+        return -1;
+    }
+    return symlink(target.c_str(), to);
+}
+
+int clone_directory_recursive(const std::string& from, const std::string& to_parent) {
+    const std::string to = to_parent + "/" + android::base::Basename(from);
+    char *argv[] = { (char*) from.c_str(), nullptr };
+    FTS* fts = fts_open(argv, FTS_PHYSICAL | FTS_NOCHDIR, nullptr);
+    if (fts == nullptr) {
+        return -1;
+    }
+
+    int res = 0;
+    FTSENT* p;
+    while ((p = fts_read(fts)) != nullptr) {
+        const std::string path = to + (p->fts_path + from.size());
+        int rc = 0;
+        switch (p->fts_info) {
+        case FTS_D:
+            // Once a clone failed, only the directories already created are
+            // finished, so that none is left with the mode below.
+            if (res != 0) {
+                fts_set(fts, p, FTS_SKIP);
+                continue;
+            }
+            // Writable until its children are in place, like cp does.
+            if (mkdir(path.c_str(), 0700) != 0 && errno != EEXIST) {
+                rc = -1;
+            }
+            break;
+        case FTS_DP:
+            rc = preserve_attributes(path.c_str(), p->fts_statp);
+            break;
+        case FTS_F:
+            if (res != 0) continue;
+            rc = clone_file(p->fts_accpath, path.c_str());
+            if (rc == 0) {
+                rc = preserve_attributes(path.c_str(), p->fts_statp);
+            }
+            break;
+        case FTS_SL:
+        case FTS_SLNONE:
+            if (res != 0) continue;
+            rc = clone_symlink(p->fts_accpath, path.c_str(), p->fts_statp->st_size);
+            if (rc == 0) {
+                rc = preserve_attributes(path.c_str(), p->fts_statp);
+            }
+            break;
+        default:
+            if (res != 0) continue;
+            // Special files, and parts of the tree we can't read.
+            errno = (p->fts_errno != 0) ? p->fts_errno : EOPNOTSUPP;
+            rc = -1;
+            break;
+        }
+        if (rc != 0) {
+            PLOG(DEBUG) << "Failed to clone " << p->fts_path << " to " << path;
+            res = -1;
+        }
+    }
+    fts_close(fts);
+    return res;
+}
+
 int64_t data_disk_free(const std::string& data_path) {
     struct statvfs sfs;
     if (statvfs(data_path.c_str(), &sfs) == 0) {
@@ -128,6 +128,14 @@ int rm_package_dir(const std::string& package_dir);
 
 int copy_dir_files(const char *srcname, const char *dstname, uid_t owner, gid_t group);
 
+/**
+ * Copies the tree at from into the directory to_parent, like cp -FpRPd, by
+ * sharing the extents of every file with reflinks. Stops copying files once
+ * one can't be cloned, typically because the filesystem lacks reflink support,
+ * and fails. The directories already created then keep their attributes.
+ */
+int clone_directory_recursive(const std::string& from, const std::string& to_parent);
+
 int64_t data_disk_free(const std::string& data_path);
 
 int get_path_inode(const std::string& path, ino_t *inode);
@@ -19,6 +19,7 @@
 #include <getopt.h>
 
 #include <algorithm>
+#include <atomic>
 #include <fstream>
 #include <functional>
 #include <iomanip>
@@ -26,6 +27,7 @@
 #include <map>
 #include <regex>
 #include <sstream>
+#include <thread>
 
 #include <android-base/file.h>
 #include <android-base/logging.h>
@@ -243,6 +245,7 @@ bool ListCommand::getPidInfo(
             uint64_t ptr;
             if (!::android::base::ParseUint(ptrString.c_str(), &ptr)) {
                 // Should not reach here, but just be tolerant.
+                std::lock_guard<std::mutex> lock(mErrLock);
                 err() << "Could not parse number " << ptrString << std::endl;
                 return;
             }
@@ -252,6 +255,7 @@ bool ListCommand::getPidInfo(
                 for (const std::string &pidStr : split(line.substr(pos + proc.size()), ' ')) {
                     int32_t pid;
                     if (!::android::base::ParseInt(pidStr, &pid)) {
+                        std::lock_guard<std::mutex> lock(mErrLock);
                         err() << "Could not parse number " << pidStr << std::endl;
                         return;
                     }
@@ -290,13 +294,15 @@ bool ListCommand::getPidInfo(
 }
 
 const PidInfo* ListCommand::getPidInfoCached(pid_t serverPid) {
-    auto pair = mCachedPidInfos.insert({serverPid, PidInfo{}});
-    if (pair.second /* did insertion take place? */) {
-        if (!getPidInfo(serverPid, &pair.first->second)) {
-            return nullptr;
-        }
+    CachedPidInfo* cached;
+    {
+        std::lock_guard<std::mutex> lock(mCachedPidInfosLock);
+        cached = &mCachedPidInfos[serverPid];
     }
-    return &pair.first->second;
+    std::call_once(cached->once, [&] {
+        cached->valid = getPidInfo(serverPid, &cached->info);
+    });
+    return cached->valid ? &cached->info : nullptr;
 }
 
 bool ListCommand::shouldFetchHalType(const HalType &type) const {
@@ -649,6 +655,9 @@ Status ListCommand::fetchPassthrough(const sp<IServiceManager> &manager) {
     return OK;
 }
 
+// Binderized entries fetched at a time.
+static constexpr size_t kMaxConcurrentFetches = 8;
+
 Status ListCommand::fetchBinderized(const sp<IServiceManager> &manager) {
     using vintf::operator<<;
 
@@ -666,16 +675,39 @@ Status ListCommand::fetchBinderized(const sp<IServiceManager> &manager) {
         return DUMP_BINDERIZED_ERROR;
     }
 
-    Status status = OK;
     std::map<std::string, TableEntry> allTableEntries;
+    std::vector<TableEntry*> entries;
     for (const auto &fqInstanceName : fqInstanceNames) {
         // create entry and default assign all fields.
         TableEntry& entry = allTableEntries[fqInstanceName];
         entry.interfaceName = fqInstanceName;
         entry.transport = mode;
         entry.serviceStatus = ServiceStatus::NON_RESPONSIVE;
+        entries.push_back(&entry);
+    }
 
-        status |= fetchBinderizedEntry(manager, &entry);
+    // Each entry takes a few IPCs, which may time out, to a process of its own, so a few
+    // entries are fetched at a time.
+    std::vector<Status> statuses(entries.size(), OK);
+    std::atomic<size_t> nextEntry{0};
+    const auto fetchEntries = [&] {
+        size_t i;
+        while ((i = nextEntry++) < entries.size()) {
+            statuses[i] = fetchBinderizedEntry(manager, entries[i]);
+        }
+    };
+    std::vector<std::thread> threads;
+    for (size_t i = 1; i < std::min(entries.size(), kMaxConcurrentFetches); i++) {
+        threads.emplace_back(fetchEntries);
+    }
+    fetchEntries();
+    for (auto& thread : threads) {
+        thread.join();
+    }
+
+    Status status = OK;
+    for (Status entryStatus : statuses) {
+        status |= entryStatus;
     }
 
     for (auto& pair : allTableEntries) {
@@ -688,6 +720,7 @@ Status ListCommand::fetchBinderizedEntry(const sp<IServiceManager> &manager,
                                          TableEntry *entry) {
     Status status = OK;
     const auto handleError = [&](Status additionalError, const std::string& msg) {
+        std::lock_guard<std::mutex> lock(mErrLock);
         err() << "Warning: Skipping \"" << entry->interfaceName << "\": " << msg << std::endl;
         status |= DUMP_BINDERIZED_ERROR | additionalError;
     };
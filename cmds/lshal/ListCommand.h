@@ -21,6 +21,8 @@
 #include <stdint.h>
 
 #include <fstream>
+#include <map>
+#include <mutex>
 #include <string>
 #include <vector>
 
@@ -108,7 +110,7 @@ protected:
     // Get relevant information for a PID by parsing files under /d/binder.
     // It is a virtual member function so that it can be mocked.
     virtual bool getPidInfo(pid_t serverPid, PidInfo *info) const;
-    // Retrieve from mCachedPidInfos and call getPidInfo if necessary.
+    // Retrieve from mCachedPidInfos and call getPidInfo if necessary. Thread-safe.
     const PidInfo* getPidInfoCached(pid_t serverPid);
 
     void dumpTable(const NullableOStream<std::ostream>& out) const;
@@ -187,8 +189,18 @@ protected:
     // If an entry exist and not empty, it contains the cached content of /proc/{pid}/cmdline.
     std::map<pid_t, std::string> mCmdlines;
 
-    // Cache for getPidInfo.
-    std::map<pid_t, PidInfo> mCachedPidInfos;
+    // Cache for getPidInfo. Binderized entries are fetched concurrently, and each PID is
+    // parsed once, by the first thread asking for it.
+    struct CachedPidInfo {
+        std::once_flag once;
+        bool valid = false;
+        PidInfo info;
+    };
+    std::mutex mCachedPidInfosLock;
+    std::map<pid_t, CachedPidInfo> mCachedPidInfos;
+
+    // Serializes the warnings of concurrent fetches.
+    mutable std::mutex mErrLock;
 
     // Cache for getPartition.
     std::map<pid_t, Partition> mPartitions;
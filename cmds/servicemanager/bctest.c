@@ -5,6 +5,7 @@
 #include <stdlib.h>
 #include <string.h>
 #include <errno.h>
+#include <time.h>
 
 #include "binder.h"
 
@@ -56,6 +57,50 @@ int svcmgr_publish(struct binder_state *bs, uint32_t target, const char *name, v
 
 unsigned token;
 
+static double now_sec(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/* Publish up to 'count' dummy services, and at every power of two report how
+ * many lookups per second servicemanager serves with that many of ours
+ * registered (on top of whatever the device already has).
+ */
+void svcmgr_bench(struct binder_state *bs, uint32_t target, unsigned count, unsigned iterations)
+{
+    char name[64];
+    unsigned published = 0;
+    unsigned next = 1;
+    unsigned i;
+    double start, elapsed;
+
+    while (published < count) {
+        snprintf(name, sizeof(name), "bctest_bench_%u", published);
+        if (svcmgr_publish(bs, target, name, &token)) {
+            fprintf(stderr, "bench: cannot publish %s\n", name);
+            return;
+        }
+        published++;
+        if (published != next && published != count)
+            continue;
+        next *= 2;
+
+        start = now_sec();
+        for (i = 0; i < iterations; i++) {
+            uint32_t handle;
+            snprintf(name, sizeof(name), "bctest_bench_%u", i % published);
+            handle = svcmgr_lookup(bs, target, name);
+            if (handle)
+                binder_release(bs, handle);
+        }
+        elapsed = now_sec() - start;
+        fprintf(stderr, "bench: %u services, %.0f lookups/sec\n",
+                published, elapsed > 0 ? iterations / elapsed : 0);
+    }
+}
+
 int main(int argc, char **argv)
 {
     struct binder_state *bs;
@@ -96,6 +141,21 @@ int main(int argc, char **argv)
             svcmgr_publish(bs, svcmgr, argv[1], &token);
             argc--;
             argv++;
+        } else if (!strcmp(argv[0],"bench")) {
+            unsigned count, iterations = 10000;
+            if (argc < 2) {
+                fprintf(stderr,"argument required\n");
+                return -1;
+            }
+            count = atoi(argv[1]);
+            argc--;
+            argv++;
+            if (argc > 1 && atoi(argv[1]) > 0) {
+                iterations = atoi(argv[1]);
+                argc--;
+                argv++;
+            }
+            svcmgr_bench(bs, svcmgr, count, iterations);
         } else {
             fprintf(stderr,"unknown command %s\n", argv[0]);
             return -1;
@@ -139,6 +139,7 @@ static int svc_can_find(const uint16_t *name, size_t name_len, pid_t spid, const
 struct svcinfo
 {
     struct svcinfo *next;
+    struct svcinfo *hnext;
     uint32_t handle;
     struct binder_death death;
     int allow_isolated;
@@ -149,11 +150,30 @@ struct svcinfo
 
 struct svcinfo *svclist = NULL;
 
+/* Services are never removed once added (a dead service just has its handle
+ * cleared), so lookups go through a fixed-size chained hash next to svclist,
+ * which keeps registration order for LIST_SERVICES.
+ */
+#define SVC_HASH_SIZE 256
+
+static struct svcinfo *svchash[SVC_HASH_SIZE];
+
+static uint32_t svc_hash(const uint16_t *s16, size_t len)
+{
+    uint32_t h = 2166136261u;
+
+    while (len--) {
+        h ^= *s16++;
+        h *= 16777619u;
+    }
+    return h & (SVC_HASH_SIZE - 1);
+}
+
 struct svcinfo *find_svc(const uint16_t *s16, size_t len)
 {
     struct svcinfo *si;
 
-    for (si = svclist; si; si = si->next) {
+    for (si = svchash[svc_hash(s16, len)]; si; si = si->hnext) {
         if ((len == si->len) &&
             !memcmp(s16, si->name, len * sizeof(uint16_t))) {
             return si;
@@ -206,6 +226,7 @@ uint32_t do_find_service(const uint16_t *s, size_t len, uid_t uid, pid_t spid, c
 int do_add_service(struct binder_state *bs, const uint16_t *s, size_t len, uint32_t handle,
                    uid_t uid, int allow_isolated, uint32_t dumpsys_priority, pid_t spid, const char* sid) {
     struct svcinfo *si;
+    uint32_t bucket;
 
     //ALOGI("add_service('%s',%x,%s) uid=%d\n", str8(s, len), handle,
     //        allow_isolated ? "allow_isolated" : "!allow_isolated", uid);
@@ -244,6 +265,9 @@ int do_add_service(struct binder_state *bs, const uint16_t *s, size_t len, uint3
         si->dumpsys_priority = dumpsys_priority;
         si->next = svclist;
         svclist = si;
+        bucket = svc_hash(s, len);
+        si->hnext = svchash[bucket];
+        svchash[bucket] = si;
     }
 
     binder_acquire(bs, handle);
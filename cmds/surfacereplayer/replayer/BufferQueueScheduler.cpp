@@ -17,14 +17,21 @@
 
 #include "BufferQueueScheduler.h"
 
+#include <GLES2/gl2.h>
 #include <android/native_window.h>
-#include <gui/Surface.h>
+
+#include <algorithm>
+#include <cstring>
 
 using namespace android;
 
 BufferQueueScheduler::BufferQueueScheduler(
-        const sp<SurfaceControl>& surfaceControl, const HSV& color, int id)
-      : mSurfaceControl(surfaceControl), mColor(color), mSurfaceId(id), mContinueScheduling(true) {}
+        const sp<SurfaceControl>& surfaceControl, const HSV& color, int id, bool gpuFill)
+      : mSurfaceControl(surfaceControl),
+        mColor(color),
+        mSurfaceId(id),
+        mContinueScheduling(true),
+        mGpuFill(gpuFill) {}
 
 void BufferQueueScheduler::startScheduling() {
     ALOGV("Starting Scheduler for %d Layer", mSurfaceId);
@@ -43,13 +50,20 @@ void BufferQueueScheduler::startScheduling() {
             lock.unlock();
 
             bufferUpdate(event.dimensions);
-            fillSurface(event.event);
+            if (mGpuFill) {
+                fillSurfaceWithGpu(event.event);
+            } else {
+                fillSurface(event.event);
+            }
             mColor.modulate();
             lock.lock();
             mBufferEvents.pop();
         }
         mCondition.wait(lock);
     }
+
+    // The context is current on this thread, so it is released here.
+    releaseEgl();
 }
 
 void BufferQueueScheduler::addEvent(const BufferEvent& event) {
@@ -89,15 +103,18 @@ void BufferQueueScheduler::fillSurface(const std::shared_ptr<Event>& event) {
     }
 
     auto color = mColor.getRGB();
+    const uint8_t pixel[4] = {color.r, color.g, color.b, LAYER_ALPHA};
+    uint32_t value;
+    memcpy(&value, pixel, sizeof(value));
 
+    // Only the first row is filled pixel by pixel, the others are copies of it.
     auto img = reinterpret_cast<uint8_t*>(outBuffer.bits);
-    for (int y = 0; y < outBuffer.height; y++) {
-        for (int x = 0; x < outBuffer.width; x++) {
-            uint8_t* pixel = img + (4 * (y * outBuffer.stride + x));
-            pixel[0] = color.r;
-            pixel[1] = color.g;
-            pixel[2] = color.b;
-            pixel[3] = LAYER_ALPHA;
+    if (outBuffer.height > 0) {
+        std::fill_n(reinterpret_cast<uint32_t*>(img), outBuffer.width, value);
+        const size_t rowSize = 4 * static_cast<size_t>(outBuffer.width);
+        const size_t stride = 4 * static_cast<size_t>(outBuffer.stride);
+        for (int y = 1; y < outBuffer.height; y++) {
+            memcpy(img + y * stride, img, rowSize);
         }
     }
 
@@ -107,3 +124,84 @@ void BufferQueueScheduler::fillSurface(const std::shared_ptr<Event>& event) {
 
     ALOGE_IF(status != NO_ERROR, "fillSurface: failed to unlock and post buffer, (%d)", status);
 }
+
+void BufferQueueScheduler::fillSurfaceWithGpu(const std::shared_ptr<Event>& event) {
+    sp<Surface> s = mSurfaceControl->getSurface();
+    if (s != mEglWindow && !initEgl(s)) {
+        ALOGE("fillSurfaceWithGpu: failed to set up EGL, (%#x)", eglGetError());
+        return;
+    }
+
+    auto color = mColor.getRGB();
+    glClearColor(color.r / 255.0f, color.g / 255.0f, color.b / 255.0f, LAYER_ALPHA / 255.0f);
+    glClear(GL_COLOR_BUFFER_BIT);
+
+    event->readyToExecute();
+
+    ALOGE_IF(eglSwapBuffers(mEglDisplay, mEglSurface) != EGL_TRUE,
+            "fillSurfaceWithGpu: failed to swap buffers, (%#x)", eglGetError());
+}
+
+bool BufferQueueScheduler::initEgl(const sp<Surface>& s) {
+    if (mEglContext == EGL_NO_CONTEXT) {
+        mEglDisplay = eglGetDisplay(EGL_DEFAULT_DISPLAY);
+        if (eglInitialize(mEglDisplay, nullptr, nullptr) != EGL_TRUE) {
+            return false;
+        }
+
+        const EGLint configAttribs[] = {
+                EGL_SURFACE_TYPE, EGL_WINDOW_BIT,
+                EGL_RENDERABLE_TYPE, EGL_OPENGL_ES2_BIT,
+                EGL_RED_SIZE, 8,
+                EGL_GREEN_SIZE, 8,
+                EGL_BLUE_SIZE, 8,
+                EGL_ALPHA_SIZE, 8,
+                EGL_NONE,
+        };
+        EGLint numConfigs = 0;
+        if (eglChooseConfig(mEglDisplay, configAttribs, &mEglConfig, 1, &numConfigs) != EGL_TRUE ||
+                numConfigs == 0) {
+            return false;
+        }
+
+        const EGLint contextAttribs[] = {EGL_CONTEXT_CLIENT_VERSION, 2, EGL_NONE};
+        mEglContext = eglCreateContext(mEglDisplay, mEglConfig, EGL_NO_CONTEXT, contextAttribs);
+        if (mEglContext == EGL_NO_CONTEXT) {
+            return false;
+        }
+    }
+
+    if (mEglSurface != EGL_NO_SURFACE) {
+        eglMakeCurrent(mEglDisplay, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+        eglDestroySurface(mEglDisplay, mEglSurface);
+        mEglSurface = EGL_NO_SURFACE;
+        mEglWindow = nullptr;
+    }
+
+    mEglSurface = eglCreateWindowSurface(mEglDisplay, mEglConfig, s.get(), nullptr);
+    if (mEglSurface == EGL_NO_SURFACE) {
+        return false;
+    }
+    if (eglMakeCurrent(mEglDisplay, mEglSurface, mEglSurface, mEglContext) != EGL_TRUE) {
+        eglDestroySurface(mEglDisplay, mEglSurface);
+        mEglSurface = EGL_NO_SURFACE;
+        return false;
+    }
+    mEglWindow = s;
+    return true;
+}
+
+void BufferQueueScheduler::releaseEgl() {
+    if (mEglContext == EGL_NO_CONTEXT) {
+        return;
+    }
+    // The display is shared with the other schedulers, so it isn't terminated.
+    eglMakeCurrent(mEglDisplay, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+    if (mEglSurface != EGL_NO_SURFACE) {
+        eglDestroySurface(mEglDisplay, mEglSurface);
+        mEglSurface = EGL_NO_SURFACE;
+    }
+    eglDestroyContext(mEglDisplay, mEglContext);
+    mEglContext = EGL_NO_CONTEXT;
+    mEglWindow = nullptr;
+}
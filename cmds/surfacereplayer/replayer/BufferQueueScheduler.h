@@ -20,6 +20,9 @@
 #include "Color.h"
 #include "Event.h"
 
+#include <EGL/egl.h>
+
+#include <gui/Surface.h>
 #include <gui/SurfaceControl.h>
 
 #include <utils/StrongPointer.h>
@@ -52,7 +55,10 @@ struct BufferEvent {
 
 class BufferQueueScheduler {
   public:
-    BufferQueueScheduler(const sp<SurfaceControl>& surfaceControl, const HSV& color, int id);
+    // With gpuFill, buffers are cleared through GLES rather than written by the CPU, keeping the
+    // replayer's own CPU time out of the replay.
+    BufferQueueScheduler(const sp<SurfaceControl>& surfaceControl, const HSV& color, int id,
+            bool gpuFill = false);
 
     void startScheduling();
     void addEvent(const BufferEvent&);
@@ -67,12 +73,25 @@ class BufferQueueScheduler {
     // then unlock and post the buffer.
     void fillSurface(const std::shared_ptr<Event>& event);
 
+    // Same as fillSurface, clearing the next buffer of an EGL window surface instead.
+    void fillSurfaceWithGpu(const std::shared_ptr<Event>& event);
+    bool initEgl(const sp<Surface>& s);
+    void releaseEgl();
+
     sp<SurfaceControl> mSurfaceControl;
     HSV mColor;
     const int mSurfaceId;
 
     bool mContinueScheduling;
 
+    const bool mGpuFill;
+    EGLDisplay mEglDisplay = EGL_NO_DISPLAY;
+    EGLConfig mEglConfig = nullptr;
+    EGLContext mEglContext = EGL_NO_CONTEXT;
+    EGLSurface mEglSurface = EGL_NO_SURFACE;
+    // The surface mEglSurface renders to, replaced when the layer's surface is.
+    sp<Surface> mEglWindow;
+
     std::queue<BufferEvent> mBufferEvents;
     std::mutex mMutex;
     std::condition_variable mCondition;
@@ -51,6 +51,11 @@ void printHelpMenu() {
 
     std::cout << "  -l  Indefinitely loop the replayer\n";
 
+    std::cout << "  -b  Benchmark the replay, reporting how late increments were replayed and "
+                 "the frame latencies of each layer\n";
+
+    std::cout << "  -g  Fill buffers through the GPU rather than the CPU\n";
+
     std::cout << "  -h  Display help menu\n";
 
     std::cout << std::endl;
@@ -61,11 +66,13 @@ int main(int argc, char** argv) {
     bool loop = false;
     bool wait = true;
     bool pauseBeginning = false;
+    bool benchmark = false;
+    bool gpuFill = false;
     int numThreads = DEFAULT_THREADS;
     long stopHere = -1;
 
     int opt = 0;
-    while ((opt = getopt(argc, argv, "mt:s:nlh?")) != -1) {
+    while ((opt = getopt(argc, argv, "mt:s:nlbgh?")) != -1) {
         switch (opt) {
             case 'm':
                 pauseBeginning = true;
@@ -82,6 +89,12 @@ int main(int argc, char** argv) {
             case 'l':
                 loop = true;
                 break;
+            case 'b':
+                benchmark = true;
+                break;
+            case 'g':
+                gpuFill = true;
+                break;
             case 'h':
             case '?':
                 printHelpMenu();
@@ -102,7 +115,7 @@ int main(int argc, char** argv) {
 
     status_t status = NO_ERROR;
     do {
-        android::Replayer r(filename, pauseBeginning, numThreads, wait, stopHere);
+        android::Replayer r(filename, pauseBeginning, numThreads, wait, stopHere, benchmark, gpuFill);
         status = r.replay();
     } while(loop);
 
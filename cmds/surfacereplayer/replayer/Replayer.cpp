@@ -33,12 +33,15 @@
 #include <utils/String8.h>
 #include <utils/Trace.h>
 
+#include <algorithm>
 #include <chrono>
 #include <cmath>
 #include <condition_variable>
 #include <cstdlib>
+#include <ctime>
 #include <fstream>
 #include <functional>
+#include <iomanip>
 #include <iostream>
 #include <mutex>
 #include <sstream>
@@ -51,14 +54,16 @@ using namespace android;
 std::atomic_bool Replayer::sReplayingManually(false);
 
 Replayer::Replayer(const std::string& filename, bool replayManually, int numThreads, bool wait,
-        nsecs_t stopHere)
+        nsecs_t stopHere, bool benchmark, bool gpuFill)
       : mTrace(),
         mLoaded(false),
         mIncrementIndex(0),
         mCurrentTime(0),
         mNumThreads(numThreads),
         mWaitForTimeStamps(wait),
-        mStopTimeStamp(stopHere) {
+        mStopTimeStamp(stopHere),
+        mBenchmark(benchmark),
+        mGpuFill(gpuFill) {
     srand(RAND_COLOR_SEED);
 
     std::string input;
@@ -82,14 +87,17 @@ Replayer::Replayer(const std::string& filename, bool replayManually, int numThre
     }
 }
 
-Replayer::Replayer(const Trace& t, bool replayManually, int numThreads, bool wait, nsecs_t stopHere)
+Replayer::Replayer(const Trace& t, bool replayManually, int numThreads, bool wait, nsecs_t stopHere,
+        bool benchmark, bool gpuFill)
       : mTrace(t),
         mLoaded(true),
         mIncrementIndex(0),
         mCurrentTime(0),
         mNumThreads(numThreads),
         mWaitForTimeStamps(wait),
-        mStopTimeStamp(stopHere) {
+        mStopTimeStamp(stopHere),
+        mBenchmark(benchmark),
+        mGpuFill(gpuFill) {
     srand(RAND_COLOR_SEED);
     mCurrentTime = mTrace.increment(0).time_stamp();
 
@@ -117,6 +125,8 @@ status_t Replayer::replay() {
     initReplay();
 
     ALOGV("Starting actual Replay!");
+    mFirstTimeStamp = mCurrentTime;
+    mReplayStartTime = systemTime();
     while (!mPendingIncrements.empty()) {
         mCurrentIncrement = mTrace.increment(mIncrementIndex);
 
@@ -125,7 +135,11 @@ status_t Replayer::replay() {
             sReplayingManually.store(true);
         }
 
-        waitForConsoleCommmand();
+        if (sReplayingManually) {
+            waitForConsoleCommmand();
+            // Resume the schedule from the last increment, as if it had been replayed now.
+            mReplayStartTime = systemTime() - (mCurrentTime - mFirstTimeStamp);
+        }
 
         if (mWaitForTimeStamps) {
             waitUntilTimestamp(mCurrentIncrement.time_stamp());
@@ -151,10 +165,20 @@ status_t Replayer::replay() {
 
         mIncrementIndex++;
         mCurrentTime = mCurrentIncrement.time_stamp();
+
+        // SurfaceFlinger only keeps the latest frames of each layer.
+        if (mBenchmark && systemTime() - mLastFrameStatsTime >= s2ns(1)) {
+            collectFrameStats();
+        }
     }
 
     SurfaceComposerClient::enableVSyncInjections(false);
 
+    if (mBenchmark) {
+        collectFrameStats();
+        printBenchmarkResults(systemTime() - mReplayStartTime);
+    }
+
     return status;
 }
 
@@ -296,7 +320,7 @@ status_t Replayer::dispatchEvent(int index) {
             auto layerId = increment.buffer_update().id();
             if (mBufferQueueSchedulers.count(layerId) == 0) {
                 mBufferQueueSchedulers[layerId] = std::make_shared<BufferQueueScheduler>(
-                        mLayers[layerId], mColors[layerId], layerId);
+                        mLayers[layerId], mColors[layerId], layerId, mGpuFill);
                 mBufferQueueSchedulers[layerId]->addEvent(bufferEvent);
 
                 std::thread(&BufferQueueScheduler::startScheduling,
@@ -665,8 +689,84 @@ void Replayer::updatePowerMode(const PowerModeUpdate& pmu, const std::shared_ptr
 }
 
 void Replayer::waitUntilTimestamp(int64_t timestamp) {
-    ALOGV("Waiting for %lld nanoseconds...", static_cast<int64_t>(timestamp - mCurrentTime));
-    std::this_thread::sleep_for(std::chrono::nanoseconds(timestamp - mCurrentTime));
+    // Increments are scheduled against the start of the replay rather than the previous
+    // increment, so the time spent dispatching them doesn't add up over the trace.
+    const nsecs_t dueTime = mReplayStartTime + (timestamp - mFirstTimeStamp);
+    ALOGV("Waiting for %lld nanoseconds...", static_cast<long long>(dueTime - systemTime()));
+    struct timespec due = {
+            .tv_sec = static_cast<time_t>(dueTime / 1000000000),
+            .tv_nsec = static_cast<long>(dueTime % 1000000000),
+    };
+    while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &due, nullptr) == EINTR) {
+    }
+    if (mBenchmark) {
+        mIncrementLateness.push_back(systemTime() - dueTime);
+    }
+}
+
+void Replayer::collectFrameStats() {
+    std::lock_guard<std::mutex> lock(mLayerLock);
+    for (const auto& [id, layer] : mLayers) {
+        FrameStats stats;
+        if (layer == nullptr || layer->getLayerFrameStats(&stats) != NO_ERROR) {
+            continue;
+        }
+        nsecs_t& lastDesiredTime = mLastFrameDesiredTimes[id];
+        for (size_t i = 0; i < stats.desiredPresentTimesNano.size(); i++) {
+            const nsecs_t desiredTime = stats.desiredPresentTimesNano[i];
+            const nsecs_t presentTime = stats.actualPresentTimesNano[i];
+            // Frames not presented yet are picked up by the next collection.
+            if (desiredTime <= lastDesiredTime || presentTime == INT64_MAX) {
+                continue;
+            }
+            lastDesiredTime = desiredTime;
+            mFrameLatencies[id].push_back(presentTime - desiredTime);
+            const nsecs_t readyTime = std::max(desiredTime, stats.frameReadyTimesNano[i]);
+            if (stats.refreshPeriodNano > 0 && presentTime - readyTime > stats.refreshPeriodNano) {
+                mJankyFrames[id]++;
+            }
+        }
+    }
+    mLastFrameStatsTime = systemTime();
+}
+
+static std::string formatDistribution(std::vector<nsecs_t> values) {
+    if (values.empty()) {
+        return "none";
+    }
+    std::sort(values.begin(), values.end());
+    auto percentile = [&values](size_t p) { return ns2us(values[(values.size() - 1) * p / 100]); };
+    nsecs_t total = 0;
+    for (nsecs_t value : values) {
+        total += value;
+    }
+    std::stringstream ss;
+    ss << std::fixed << std::setprecision(2) << "avg " << ns2us(total / values.size()) / 1000.0
+       << "ms, p50 " << percentile(50) / 1000.0 << "ms, p90 " << percentile(90) / 1000.0
+       << "ms, p99 " << percentile(99) / 1000.0 << "ms, max " << percentile(100) / 1000.0
+       << "ms";
+    return ss.str();
+}
+
+void Replayer::printBenchmarkResults(nsecs_t replayDuration) {
+    std::cout << std::fixed << std::setprecision(3) << "Replayed " << mTrace.increment_size()
+              << " increments of a " << (mCurrentTime - mFirstTimeStamp) / 1e9 << "s trace in "
+              << replayDuration / 1e9 << "s" << std::endl;
+    if (mWaitForTimeStamps) {
+        std::cout << "Increment lateness: " << formatDistribution(mIncrementLateness)
+                  << std::endl;
+    }
+
+    std::vector<layer_id> ids;
+    for (const auto& latencies : mFrameLatencies) {
+        ids.push_back(latencies.first);
+    }
+    std::sort(ids.begin(), ids.end());
+    for (layer_id id : ids) {
+        std::cout << "Layer " << id << ": " << mFrameLatencies[id].size() << " frames, "
+                  << mJankyFrames[id] << " janky, latency "
+                  << formatDistribution(mFrameLatencies[id]) << std::endl;
+    }
 }
 
 void Replayer::waitUntilDeferredTransactionLayerExists(
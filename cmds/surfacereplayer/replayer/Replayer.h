@@ -37,6 +37,7 @@
 #include <thread>
 #include <unordered_map>
 #include <utility>
+#include <vector>
 
 namespace android {
 
@@ -53,9 +54,10 @@ typedef google::protobuf::RepeatedPtrField<DisplayChange> DisplayChanges;
 class Replayer {
   public:
     Replayer(const std::string& filename, bool replayManually = false,
-            int numThreads = DEFAULT_THREADS, bool wait = true, nsecs_t stopHere = -1);
+            int numThreads = DEFAULT_THREADS, bool wait = true, nsecs_t stopHere = -1,
+            bool benchmark = false, bool gpuFill = false);
     Replayer(const Trace& trace, bool replayManually = false, int numThreads = DEFAULT_THREADS,
-            bool wait = true, nsecs_t stopHere = -1);
+            bool wait = true, nsecs_t stopHere = -1, bool benchmark = false, bool gpuFill = false);
 
     status_t replay();
 
@@ -119,6 +121,8 @@ class Replayer {
             display_id id, const ProjectionChange& pc);
 
     void waitUntilTimestamp(int64_t timestamp);
+    void collectFrameStats();
+    void printBenchmarkResults(nsecs_t replayDuration);
     void waitUntilDeferredTransactionLayerExists(
             const DeferredTransactionChange& dtc, std::unique_lock<std::mutex>& lock);
     status_t loadSurfaceComposerClient();
@@ -139,6 +143,22 @@ class Replayer {
     nsecs_t mStopTimeStamp;
     bool mHasStopped;
 
+    // Increments are due at mReplayStartTime plus their offset from mFirstTimeStamp.
+    nsecs_t mReplayStartTime = 0;
+    int64_t mFirstTimeStamp = 0;
+
+    // Benchmark results: how late increments were replayed, and the frame latencies
+    // SurfaceFlinger reported for each layer.
+    bool mBenchmark;
+    std::vector<nsecs_t> mIncrementLateness;
+    nsecs_t mLastFrameStatsTime = 0;
+    std::unordered_map<layer_id, std::vector<nsecs_t>> mFrameLatencies;
+    std::unordered_map<layer_id, size_t> mJankyFrames;
+    std::unordered_map<layer_id, nsecs_t> mLastFrameDesiredTimes;
+
+    // Whether buffers are filled through GLES rather than by the CPU.
+    bool mGpuFill;
+
     std::mutex mLayerLock;
     std::condition_variable mLayerCond;
     std::unordered_map<layer_id, sp<SurfaceControl>> mLayers;
@@ -25,6 +25,12 @@ __BEGIN_DECLS
 int64_t stat_size(struct stat *s);
 int64_t calculate_dir_size(int dfd);
 
+/*
+ * Same as calculate_dir_size(), with its subdirectories walked by up to the
+ * given number of threads, the calling one included. Takes ownership of dfd.
+ */
+int64_t calculate_dir_size_parallel(int dfd, int threads);
+
 __END_DECLS
 
 #endif /* __LIBDISKUSAGE_DIRSIZE_H */
@@ -29,13 +29,16 @@
  * The InputConsumer is used by the application to receive events from the input dispatcher.
  */
 
+#include <memory>
 #include <string>
+#include <vector>
 
 #include <binder/IBinder.h>
 #include <input/Input.h>
 #include <utils/Errors.h>
 #include <utils/Timers.h>
 #include <utils/RefBase.h>
+#include <utils/KeyedVector.h>
 #include <utils/Vector.h>
 #include <utils/BitSet.h>
 
@@ -136,6 +139,8 @@ struct InputMessage {
         struct Finished {
             uint32_t seq;
             bool handled;
+            // When the consumer handed the event out to the app, 0 if unknown
+            nsecs_t consumeTime __attribute__((aligned(8)));
 
             inline size_t size() const {
                 return sizeof(Finished);
@@ -171,8 +176,23 @@ public:
     static status_t openInputChannelPair(const std::string& name,
             sp<InputChannel>& outServerChannel, sp<InputChannel>& outClientChannel);
 
+    /* Creates a pair of input channels which, if useSharedRing is true, pass messages
+     * through a ring buffer in shared memory instead of one socket write per message.
+     * The socket then only carries a wake-up when the receiver has run out of messages
+     * and gone back to polling it. Without the ring, or if it cannot be set up, the
+     * channels send every message through the socket.
+     *
+     * The other overload uses the ring when ro.input.channel_shared_ring is set.
+     *
+     * Returns OK on success.
+     */
+    static status_t openInputChannelPair(const std::string& name,
+            sp<InputChannel>& outServerChannel, sp<InputChannel>& outClientChannel,
+            bool useSharedRing);
+
     inline std::string getName() const { return mName; }
     inline int getFd() const { return mFd; }
+    inline bool hasSharedRing() const { return mRings != nullptr; }
 
     /* Sends a message to the other endpoint.
      *
@@ -182,15 +202,26 @@ public:
      *
      * Returns OK on success.
      * Returns WOULD_BLOCK if the channel is full.
-     * Returns DEAD_OBJECT if the channel's peer has been closed.
+     * Returns DEAD_OBJECT if the channel's peer has been closed. With a shared ring, that
+     * is only noticed when the peer is waiting to be woken.
      * Other errors probably indicate that the channel is broken.
      */
     status_t sendMessage(const InputMessage* msg);
 
+    /* Sends count messages to the other endpoint in order, with as few writes as the
+     * channel allows.
+     *
+     * Returns OK if all were sent. Otherwise returns why the first unsent one was not, as
+     * sendMessage would, and none after it were sent either. outSent is set to how many
+     * were sent in both cases.
+     */
+    status_t sendMessages(const InputMessage* msgs, size_t count, size_t* outSent);
+
     /* Receives a message sent by the other endpoint.
      *
      * If there is no message present, try again after poll() indicates that the fd
-     * is readable.
+     * is readable. With a shared ring, the fd only becomes readable again once this
+     * has returned WOULD_BLOCK, so receivers must keep receiving until it does.
      *
      * Returns OK on success.
      * Returns WOULD_BLOCK if there is no message present.
@@ -209,11 +240,23 @@ public:
     void setToken(const sp<IBinder>& token);
 
 private:
+    class SharedRings;
+
     void setFd(int fd);
+    status_t sendSocketMessage(const void* data, size_t length);
+    status_t sendSocketMessages(const InputMessage* cleanMsgs, size_t count, size_t* outSent);
+    status_t receiveSocketMessage(InputMessage* msg);
+    status_t sendRingMessages(const InputMessage* cleanMsgs, size_t count, size_t* outSent);
+    status_t receiveRingMessage(InputMessage* msg);
 
     std::string mName;
     int mFd = -1;
 
+    // Shared with the peer and with any dups of this channel, if messages go through rings
+    std::shared_ptr<SharedRings> mRings;
+    // Which of the two rings this end sends on; it receives on the other
+    uint32_t mSendRingIndex = 0;
+
     sp<IBinder> mToken = nullptr;
 };
 
@@ -285,7 +328,8 @@ public:
 
     /* Receives the finished signal from the consumer in reply to the original dispatch signal.
      * If a signal was received, returns the message sequence number,
-     * and whether the consumer handled the message.
+     * and whether the consumer handled the message. The variant with outConsumeTime also returns
+     * when the consumer handed the event out, or 0 if it did not say.
      *
      * The returned sequence number is never 0 unless the operation failed.
      *
@@ -295,9 +339,28 @@ public:
      * Other errors probably indicate that the channel is broken.
      */
     status_t receiveFinishedSignal(uint32_t* outSeq, bool* outHandled);
+    status_t receiveFinishedSignal(uint32_t* outSeq, bool* outHandled, nsecs_t* outConsumeTime);
+
+    /* Holds on to the messages of the events published from now on, for endBatch()
+     * to send together. The publish methods then only fail on invalid arguments.
+     */
+    void beginBatch();
+
+    /* Sends the messages of the events published since beginBatch(), in order.
+     *
+     * Returns OK if all were sent. Otherwise returns why the first unsent one was not,
+     * as the publish methods would have, and drops it and those after it for the caller
+     * to publish again. outPublished is set to how many were sent in both cases.
+     */
+    status_t endBatch(size_t* outPublished);
 
 private:
+    status_t sendMessage(const InputMessage& msg);
+
     sp<InputChannel> mChannel;
+
+    bool mBatching = false;
+    std::vector<InputMessage> mBatch;
 };
 
 /*
@@ -375,10 +438,27 @@ public:
      */
     bool hasPendingBatch() const;
 
+    /* How touches are predicted past the most recent sample when resampling. */
+    enum class TouchPredictor {
+        // Extrapolates along the line through the two most recent samples.
+        LINEAR,
+        // Extrapolates along the parabola through the three most recent samples, which
+        // follows curved and accelerating strokes more closely. Falls back to LINEAR when
+        // the samples are too unevenly spaced for a stable fit.
+        QUADRATIC,
+    };
+
+    /* Chooses the touch predictor used for resampling, LINEAR by default. Applications
+     * opt in to another one; it has no effect when touch resampling is disabled.
+     */
+    void setTouchPredictor(TouchPredictor predictor) { mTouchPredictor = predictor; }
+
 private:
     // True if touch resampling is enabled.
     const bool mResampleTouch;
 
+    TouchPredictor mTouchPredictor = TouchPredictor::LINEAR;
+
     // The input channel.
     sp<InputChannel> mChannel;
 
@@ -389,9 +469,41 @@ private:
     // call to consume and that still needs to be handled.
     bool mMsgDeferred;
 
-    // Batched motion events per device and source.
-    struct Batch {
-        Vector<InputMessage> samples;
+    // Batched motion events per device and source. The samples of a batch share every field
+    // of its first message but their sequence number, event time, meta state and pointer
+    // coordinates, which are stored apart with only the axes present in each sample, and
+    // turned back into messages as the samples are consumed.
+    class Batch {
+    public:
+        explicit Batch(const InputMessage& msg);
+        Batch() = default;
+
+        // The first message, which holds the fields shared by every sample
+        const InputMessage& getHead() const { return mHead; }
+
+        size_t size() const { return mSeqs.size(); }
+        bool isEmpty() const { return mSeqs.empty(); }
+        uint32_t getSeq(size_t index) const { return mSeqs[index]; }
+        nsecs_t getEventTime(size_t index) const { return mEventTimes[index]; }
+
+        void addSample(const InputMessage& msg);
+
+        // Writes the sample at the given index into msg, whose other fields must already be
+        // those of the head.
+        void getSample(size_t index, InputMessage* msg) const;
+
+        void removeSamples(size_t count);
+
+    private:
+        InputMessage mHead;
+        std::vector<uint32_t> mSeqs;
+        std::vector<nsecs_t> mEventTimes;
+        std::vector<int32_t> mMetaStates;
+        // Where the values of each sample start in mValues
+        std::vector<size_t> mValueStarts;
+        // The axes present for each pointer of each sample, and their values packed in order
+        std::vector<uint64_t> mAxisBits;
+        std::vector<float> mValues;
     };
     Vector<Batch> mBatches;
 
@@ -434,11 +546,14 @@ private:
         }
     };
     struct TouchState {
+        // Enough samples for the quadratic predictor
+        static constexpr size_t HISTORY_SIZE = 3;
+
         int32_t deviceId;
         int32_t source;
         size_t historyCurrent;
         size_t historySize;
-        History history[2];
+        History history[HISTORY_SIZE];
         History lastResample;
 
         void initialize(int32_t deviceId, int32_t source) {
@@ -451,15 +566,16 @@ private:
         }
 
         void addHistory(const InputMessage& msg) {
-            historyCurrent ^= 1;
-            if (historySize < 2) {
+            historyCurrent = (historyCurrent + 1) % HISTORY_SIZE;
+            if (historySize < HISTORY_SIZE) {
                 historySize += 1;
             }
             history[historyCurrent].initializeFrom(msg);
         }
 
+        // The sample received 'index' samples ago, 0 being the most recent one
         const History* getHistory(size_t index) const {
-            return &history[(historyCurrent + index) & 1];
+            return &history[(historyCurrent + HISTORY_SIZE - index) % HISTORY_SIZE];
         }
 
         bool recentCoordinatesAreIdentical(uint32_t id) const {
@@ -492,6 +608,10 @@ private:
     };
     Vector<SeqChain> mSeqChains;
 
+    // When each event that has yet to be finished was returned by consume(), keyed by its
+    // sequence number, to be reported back in its finished signal.
+    KeyedVector<uint32_t, nsecs_t> mConsumeTimes;
+
     status_t consumeBatch(InputEventFactoryInterface* factory,
             nsecs_t frameTime, uint32_t* outSeq, InputEvent** outEvent);
     status_t consumeSamples(InputEventFactoryInterface* factory,
@@ -504,7 +624,9 @@ private:
     ssize_t findBatch(int32_t deviceId, int32_t source) const;
     ssize_t findTouchState(int32_t deviceId, int32_t source) const;
 
-    status_t sendUnchainedFinishedSignal(uint32_t seq, bool handled);
+    static void initializeFinishedMessage(InputMessage* msg, uint32_t seq, bool handled,
+            nsecs_t consumeTime);
+    status_t sendUnchainedFinishedSignal(uint32_t seq, bool handled, nsecs_t consumeTime);
 
     static void rewriteMessage(TouchState& state, InputMessage& msg);
     static void initializeKeyEvent(KeyEvent* event, const InputMessage* msg);
@@ -40,7 +40,8 @@ namespace android {
  * Also specifies other functions of the keyboard such as the keyboard type
  * and key modifier semantics.
  *
- * This object is immutable after it has been loaded.
+ * This object is immutable after it has been loaded. Loading an unchanged file, or one
+ * with the same contents, returns the map already loaded while it is still in use.
  */
 class KeyCharacterMap : public RefBase {
 public:
@@ -58,7 +58,8 @@ struct AxisInfo {
 /**
  * Describes a mapping from keyboard scan codes and joystick axes to Android key codes and axes.
  *
- * This object is immutable after it has been loaded.
+ * This object is immutable after it has been loaded. Loading an unchanged file, or one
+ * with the same contents, returns the map already loaded while it is still in use.
  */
 class KeyLayoutMap : public RefBase {
 public:
@@ -94,6 +95,9 @@ private:
 
     KeyLayoutMap();
 
+    static status_t loadContents(const std::string& filename, const std::string& contents,
+            sp<KeyLayoutMap>* outMap);
+
     const Key* getKey(int32_t scanCode, int32_t usageCode) const;
 
     class Parser {
@@ -20,6 +20,7 @@
 #include <stdint.h>
 #include <sys/time.h>
 #include <ui/DisplayInfo.h>
+#include <memory>
 #include <vector>
 
 namespace android {
@@ -28,6 +29,9 @@ namespace android {
  * Represents data from a single scan of the touchscreen device.
  * Similar in concept to a video frame, but the touch strength is used as
  * the values instead.
+ *
+ * Copies of a frame share its data, which is never modified in place, so frames
+ * can be handed along the input pipeline without copying the heatmap each time.
  */
 class TouchVideoFrame {
 public:
@@ -65,7 +69,7 @@ public:
 private:
     uint32_t mHeight;
     uint32_t mWidth;
-    std::vector<int16_t> mData;
+    std::shared_ptr<const std::vector<int16_t>> mData;
     struct timeval mTimestamp;
 
     /**
@@ -67,6 +67,10 @@ public:
 
     ~VelocityTracker();
 
+    // Switches to the specified strategy, discarding all movement information.
+    // Returns false and keeps the current strategy if the name is not recognized.
+    bool setStrategy(const char* strategy);
+
     // Resets the velocity tracker state.
     void clear();
 
@@ -296,6 +300,11 @@ private:
 
     size_t mIndex;
     Movement mMovements[HISTORY_SIZE];
+
+    // Estimates already computed since the last movement, so that repeated queries
+    // between samples, as happen during flings, do not walk the history again.
+    mutable BitSet32 mEstimatedIdBits;
+    mutable VelocityTracker::Estimator mEstimators[MAX_POINTER_ID + 1];
 };
 
 } // namespace android
@@ -23,9 +23,55 @@
 
 #include <limits>
 
+#if defined(__ARM_NEON__) || defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
 namespace android {
 // ----------------------------------------------------------------------------
 
+/*
+ * Returns true if each of the count rects at p has the same left and right
+ * edges as the rect at the same index in q. This is how the rasterizer decides
+ * whether a new span can simply extend the previous one downwards.
+ */
+template<typename RECT>
+inline bool same_horizontal_edges_scalar(RECT const* p, RECT const* q, size_t count)
+{
+    for (size_t i = 0; i < count; i++) {
+        if ((p[i].left != q[i].left) || (p[i].right != q[i].right)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+template<typename RECT>
+inline bool same_horizontal_edges(RECT const* p, RECT const* q, size_t count)
+{
+#if defined(__ARM_NEON__) || defined(__ARM_NEON)
+    static_assert(sizeof(RECT) == 4 * sizeof(uint32_t), "RECT must be {left, top, right, bottom}");
+    // Compare two rects per iteration, ignoring the top and bottom lanes.
+    const uint32_t laneMask[4] = { ~0u, 0u, ~0u, 0u };
+    const uint32x4_t mask = vld1q_u32(laneMask);
+    size_t i = 0;
+    for (; i + 2 <= count; i += 2) {
+        const uint32_t* a = reinterpret_cast<const uint32_t*>(p + i);
+        const uint32_t* b = reinterpret_cast<const uint32_t*>(q + i);
+        uint32x4_t diff = vorrq_u32(veorq_u32(vld1q_u32(a), vld1q_u32(b)),
+                                    veorq_u32(vld1q_u32(a + 4), vld1q_u32(b + 4)));
+        diff = vandq_u32(diff, mask);
+        uint32x2_t folded = vorr_u32(vget_low_u32(diff), vget_high_u32(diff));
+        if (vget_lane_u32(vpmax_u32(folded, folded), 0)) {
+            return false;
+        }
+    }
+    return same_horizontal_edges_scalar(p + i, q + i, count - i);
+#else
+    return same_horizontal_edges_scalar(p, q, count);
+#endif
+}
+
 template<typename RECT>
 class region_operator
 {
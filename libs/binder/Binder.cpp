@@ -20,9 +20,11 @@
 #include <utils/misc.h>
 #include <binder/BpBinder.h>
 #include <binder/IInterface.h>
+#include <binder/IPCThreadState.h>
 #include <binder/IResultReceiver.h>
 #include <binder/IShellCallback.h>
 #include <binder/Parcel.h>
+#include <binder/TransactionStats.h>
 
 #include <stdio.h>
 
@@ -130,9 +132,28 @@ status_t BBinder::transact(
         case PING_TRANSACTION:
             reply->writeInt32(pingBinder());
             break;
-        default:
-            err = onTransact(code, data, reply, flags);
+        default: {
+            const bool latencyStats = TransactionStats::isEnabled();
+            const bool callerStats = TransactionStats::isCallerStatsEnabled();
+            if (latencyStats || callerStats) {
+                // onTransact() may change the calling identity, so read it first.
+                const uid_t callingUid = callerStats ? IPCThreadState::self()->getCallingUid() : 0;
+                const nsecs_t startTime = latencyStats ? systemTime() : 0;
+                const nsecs_t startCpuTime = callerStats ? systemTime(SYSTEM_TIME_THREAD) : 0;
+                err = onTransact(code, data, reply, flags);
+                const String16& descriptor = getInterfaceDescriptor();
+                if (latencyStats) {
+                    TransactionStats::recordIncoming(descriptor, code, systemTime() - startTime);
+                }
+                if (callerStats) {
+                    TransactionStats::recordCaller(callingUid, descriptor, code,
+                                                   systemTime(SYSTEM_TIME_THREAD) - startCpuTime);
+                }
+            } else {
+                err = onTransact(code, data, reply, flags);
+            }
             break;
+        }
     }
 
     if (reply != nullptr) {
@@ -22,6 +22,7 @@
 #include <binder/Binder.h>
 #include <binder/BpBinder.h>
 #include <binder/TextOutput.h>
+#include <binder/TransactionStats.h>
 
 #include <android-base/macros.h>
 #include <cutils/sched_policy.h>
@@ -31,10 +32,13 @@
 #include <utils/threads.h>
 
 #include <private/binder/binder_module.h>
+#include <private/binder/ParcelBufferPool.h>
 #include <private/binder/Static.h>
+#include <private/binder/TransactionStatsTable.h>
 
 #include <errno.h>
 #include <inttypes.h>
+#include <poll.h>
 #include <pthread.h>
 #include <sched.h>
 #include <signal.h>
@@ -339,6 +343,16 @@ void IPCThreadState::shutdown()
     }
 }
 
+uint64_t IPCThreadState::getParcelBufferPoolHits()
+{
+    return ParcelBufferPool::getGlobalHitCount();
+}
+
+uint64_t IPCThreadState::getParcelBufferPoolMisses()
+{
+    return ParcelBufferPool::getGlobalMissCount();
+}
+
 void IPCThreadState::disableBackgroundScheduling(bool disable)
 {
     gDisableBackgroundScheduling = disable;
@@ -464,6 +478,9 @@ void IPCThreadState::flushCommands()
 {
     if (mProcess->mDriverFD <= 0)
         return;
+    // Commands queued while a oneway batch is open go out with it.
+    if (mOnewayBatchDepth > 0)
+        return;
     talkWithDriver(false);
     // The flush could have caused post-write refcount decrements to have
     // been executed, which in turn could result in BC_RELEASE/BC_DECREFS
@@ -582,14 +599,40 @@ void IPCThreadState::processPostWriteDerefs()
 }
 
 void IPCThreadState::joinThreadPool(bool isMain)
+{
+    joinThreadPoolInternal(isMain, false /*requested*/);
+}
+
+void IPCThreadState::joinThreadPoolInternal(bool isMain, bool requested)
 {
     LOG_THREADPOOL("**** THREAD %p (PID %d) IS JOINING THE THREAD POOL\n", (void*)pthread_self(), getpid());
 
     mOut.writeInt32(isMain ? BC_ENTER_LOOPER : BC_REGISTER_LOOPER);
 
     status_t result;
+    bool reaped = false;
     do {
         processPendingDerefs();
+
+        // In an adaptive pool, threads the driver spawned wait for work with
+        // a timeout and leave the pool if they stay idle.
+        if (requested && mIn.dataPosition() >= mIn.dataSize()) {
+            const int64_t idleTimeoutMs = mProcess->getIdleTimeoutMs();
+            if (idleTimeoutMs > 0 && !waitForWork(idleTimeoutMs)) {
+                bool keepWaiting = false;
+                if (mProcess->tryReapIdleThread(&keepWaiting)) {
+                    reaped = true;
+                    result = TIMED_OUT;
+                    break;
+                }
+                // Too early to leave, but the pool may still shrink later.
+                if (keepWaiting) {
+                    result = NO_ERROR;
+                    continue;
+                }
+            }
+        }
+
         // now get the next command to be processed, waiting if necessary
         result = getAndExecuteCommand();
 
@@ -609,10 +652,29 @@ void IPCThreadState::joinThreadPool(bool isMain)
     LOG_THREADPOOL("**** THREAD %p (PID %d) IS LEAVING THE THREAD POOL err=%d\n",
         (void*)pthread_self(), getpid(), result);
 
+    if (requested && !reaped) {
+        mProcess->onSpawnedThreadExit();
+    }
+
     mOut.writeInt32(BC_EXIT_LOOPER);
     talkWithDriver(false);
 }
 
+bool IPCThreadState::waitForWork(int64_t timeoutMs)
+{
+    // Anything pending (e.g. BC_REGISTER_LOOPER) must reach the driver before
+    // it can hand us work.
+    flushCommands();
+
+    struct pollfd pfd;
+    pfd.fd = mProcess->mDriverFD;
+    pfd.events = POLLIN;
+    pfd.revents = 0;
+    const int ret = TEMP_FAILURE_RETRY(poll(&pfd, 1, static_cast<int>(timeoutMs)));
+    // On error, fall through to the blocking read, which reports it.
+    return ret != 0;
+}
+
 int IPCThreadState::setupPolling(int* fd)
 {
     if (mProcess->mDriverFD <= 0) {
@@ -652,6 +714,7 @@ status_t IPCThreadState::transact(int32_t handle,
                                   Parcel* reply, uint32_t flags)
 {
     status_t err;
+    const nsecs_t startTime = TransactionStats::isEnabled() ? systemTime() : 0;
 
     flags |= TF_ACCEPT_FDS;
 
@@ -662,6 +725,16 @@ status_t IPCThreadState::transact(int32_t handle,
             << indent << data << dedent << endl;
     }
 
+    if ((flags & TF_ONE_WAY) == 0 && mPendingOnewayTransactions > 0) {
+        // The reply wait below would otherwise swallow the completions
+        // of the batched transactions.
+        flushOnewayBatch();
+    }
+
+    if ((flags & TF_ONE_WAY) != 0 && mOnewayBatchDepth > 0) {
+        return queueOnewayTransaction(handle, code, data, flags);
+    }
+
     LOG_ONEWAY(">>>> SEND from pid %d uid %d %s", getpid(), getuid(),
         (flags & TF_ONE_WAY) == 0 ? "READ REPLY" : "ONE WAY");
     err = writeTransactionData(BC_TRANSACTION, flags, handle, code, data, nullptr);
@@ -714,9 +787,100 @@ status_t IPCThreadState::transact(int32_t handle,
         err = waitForResponse(nullptr, nullptr);
     }
 
+    if (startTime != 0) {
+        TransactionStats::recordOutgoing(handle, code, systemTime() - startTime);
+    }
+
+    return err;
+}
+
+void IPCThreadState::beginOnewayBatch()
+{
+    mOnewayBatchDepth++;
+}
+
+status_t IPCThreadState::endOnewayBatch()
+{
+    LOG_ALWAYS_FATAL_IF(mOnewayBatchDepth <= 0, "endOnewayBatch() without beginOnewayBatch()");
+    if (--mOnewayBatchDepth > 0) {
+        return NO_ERROR;
+    }
+    const status_t err = flushOnewayBatch();
+    // Send whatever else was held back while the batch was open.
+    if (mOut.dataSize() > 0) {
+        flushCommands();
+        if (mOut.dataSize() == 0) {
+            releaseOnewayBatchParcels();
+        }
+    }
     return err;
 }
 
+status_t IPCThreadState::queueOnewayTransaction(int32_t handle, uint32_t code,
+        const Parcel& data, uint32_t flags)
+{
+    status_t err = data.errorCheck();
+    if (err != NO_ERROR) {
+        return (mLastError = err);
+    }
+
+    // The BC_TRANSACTION in mOut only points at the payload, and the caller
+    // is free to destroy its Parcel before the batch is flushed. Queue a copy
+    // that stays alive until the driver has read it. The copy also holds
+    // references on any binders in the payload.
+    Parcel* copy = new Parcel();
+    err = copy->appendFrom(&data, 0, data.dataSize());
+    if (err == NO_ERROR) {
+        err = writeTransactionData(BC_TRANSACTION, flags, handle, code, *copy, nullptr);
+    }
+    if (err != NO_ERROR) {
+        delete copy;
+        return (mLastError = err);
+    }
+    mOnewayBatchParcels.push(copy);
+
+    LOG_ONEWAY("Queued oneway transaction in batch (%zu pending)",
+            mPendingOnewayTransactions + 1);
+    mPendingOnewayTransactions++;
+    return NO_ERROR;
+}
+
+void IPCThreadState::releaseOnewayBatchParcels()
+{
+    for (size_t i = 0; i < mOnewayBatchParcels.size(); i++) {
+        delete mOnewayBatchParcels[i];
+    }
+    mOnewayBatchParcels.clear();
+}
+
+status_t IPCThreadState::flushOnewayBatch()
+{
+    // The first wait writes out every queued transaction in a single
+    // BINDER_WRITE_READ; the driver then returns one BR_TRANSACTION_COMPLETE,
+    // BR_FAILED_REPLY or BR_DEAD_REPLY per transaction, in order.
+    status_t result = NO_ERROR;
+    while (mPendingOnewayTransactions > 0) {
+        const status_t err = waitForResponse(nullptr, nullptr);
+        if (err == NO_ERROR) {
+            mPendingOnewayTransactions--;
+        } else if (err == DEAD_OBJECT || err == FAILED_TRANSACTION) {
+            // This one transaction failed; keep collecting the rest.
+            mPendingOnewayTransactions--;
+            result = err;
+        } else {
+            // We can no longer talk to the driver.
+            mPendingOnewayTransactions = 0;
+            result = err;
+        }
+    }
+    // If the driver hasn't consumed everything in mOut, queued transactions
+    // may still point at the copies; keep them until the next flush.
+    if (mOut.dataSize() == 0) {
+        releaseOnewayBatchParcels();
+    }
+    return result;
+}
+
 void IPCThreadState::incStrongHandle(int32_t handle, BpBinder *proxy)
 {
     LOG_REMOTEREFS("IPCThreadState::incStrongHandle(%d)\n", handle);
@@ -805,6 +969,10 @@ IPCThreadState::IPCThreadState()
       mPropagateWorkSource(false),
       mStrictModePolicy(0),
       mLastTransactionBinderFlags(0),
+      mBufferPool(new ParcelBufferPool()),
+      mTransactionStats(new TransactionStatsTable()),
+      mOnewayBatchDepth(0),
+      mPendingOnewayTransactions(0),
       mCallRestriction(mProcess->mCallRestriction)
 {
     pthread_setspecific(gTLS, this);
@@ -816,12 +984,23 @@ IPCThreadState::IPCThreadState()
 
 IPCThreadState::~IPCThreadState()
 {
+    releaseOnewayBatchParcels();
+
+    // mIn and mOut are destroyed after this, and may still look up the
+    // pool through self(); make sure they fall back to the heap.
+    ParcelBufferPool* pool = mBufferPool;
+    mBufferPool = nullptr;
+    delete pool;
+    delete mTransactionStats;
 }
 
 status_t IPCThreadState::sendReply(const Parcel& reply, uint32_t flags)
 {
     status_t err;
     status_t statusBuffer;
+    if (mPendingOnewayTransactions > 0) {
+        flushOnewayBatch();
+    }
     err = writeTransactionData(BC_REPLY, flags, -1, 0, reply, &statusBuffer);
     if (err < NO_ERROR) return err;
 
@@ -1272,7 +1451,7 @@ status_t IPCThreadState::executeCommand(int32_t cmd)
         break;
 
     case BR_SPAWN_LOOPER:
-        mProcess->spawnPooledThread(false);
+        mProcess->spawnRequestedThread();
         break;
 
     default:
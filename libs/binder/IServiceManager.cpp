@@ -25,11 +25,14 @@
 #endif
 #include <binder/Parcel.h>
 #include <cutils/properties.h>
+#include <utils/KeyedVector.h>
 #include <utils/String8.h>
 #include <utils/SystemClock.h>
 
 #include <private/binder/Static.h>
 
+#include <algorithm>
+
 #include <unistd.h>
 
 namespace android {
@@ -132,11 +135,113 @@ bool checkPermission(const String16& permission, pid_t pid, uid_t uid)
 
 // ----------------------------------------------------------------------
 
+// Process-local cache of name -> binder lookups. Entries are only kept for
+// remote binders we could link to death with, so a dead service is evicted
+// as soon as its obituary arrives and the next lookup goes back to
+// servicemanager.
+//
+// The cache only holds weak references: it hands a proxy back while some
+// other part of the process still holds it, and never keeps a remote service
+// alive on its own. Entries also expire after kTtlMs, which bounds how long
+// a lookup can keep returning the old binder after another process
+// re-registers the name while the old one is still alive.
+class ServiceCache : public IBinder::DeathRecipient
+{
+public:
+    static constexpr int64_t kTtlMs = 1000;
+
+    sp<IBinder> get(const String16& name)
+    {
+        AutoMutex _l(mLock);
+        ssize_t i = mEntries.indexOfKey(name);
+        if (i < 0) return nullptr;
+        const Entry& entry = mEntries.valueAt(i);
+        if (uptimeMillis() - entry.time >= kTtlMs) return nullptr;
+
+        sp<IBinder> svc = promote(entry.binder);
+        if (svc == nullptr) return nullptr;
+        if (!svc->isBinderAlive()) {
+            // Obituary is still in flight; don't hand out a dead proxy.
+            mEntries.removeItemsAt(i);
+            return nullptr;
+        }
+        return svc;
+    }
+
+    void put(const String16& name, const sp<IBinder>& svc)
+    {
+        if (svc == nullptr || svc->remoteBinder() == nullptr) return;
+
+        sp<IBinder> old;
+        {
+            AutoMutex _l(mLock);
+            ssize_t i = mEntries.indexOfKey(name);
+            if (i >= 0) {
+                Entry& entry = mEntries.editValueAt(i);
+                if (entry.binder.unsafe_get() == svc.get()) {
+                    // Same binder as before; it is already linked.
+                    entry.time = uptimeMillis();
+                    return;
+                }
+                old = promote(entry.binder);
+            }
+        }
+        if (old != nullptr) old->unlinkToDeath(this);
+
+        // A binder cached under several names is linked once per name; each
+        // obituary clears every entry for it, so the extra ones are no-ops.
+        if (svc->linkToDeath(this) != NO_ERROR) {
+            invalidate(name);
+            return;
+        }
+
+        AutoMutex _l(mLock);
+        mEntries.replaceValueFor(name, Entry{svc, uptimeMillis()});
+    }
+
+    void invalidate(const String16& name)
+    {
+        AutoMutex _l(mLock);
+        ssize_t i = mEntries.indexOfKey(name);
+        if (i >= 0) mEntries.editValueAt(i).time = 0;
+    }
+
+    virtual void binderDied(const wp<IBinder>& who)
+    {
+        IBinder* dead = who.unsafe_get();
+        AutoMutex _l(mLock);
+        for (size_t i = mEntries.size(); i > 0; i--) {
+            if (mEntries.valueAt(i - 1).binder.unsafe_get() == dead) {
+                mEntries.removeItemsAt(i - 1);
+            }
+        }
+    }
+
+private:
+    struct Entry {
+        wp<IBinder> binder;
+        int64_t time;
+    };
+
+    // A proxy whose last strong reference is gone cannot be promoted again,
+    // and trying logs an error, so only promote ones still held elsewhere.
+    // The raw pointer is valid: BpBinder lives as long as its weak refs.
+    static sp<IBinder> promote(const wp<IBinder>& binder)
+    {
+        if (binder.unsafe_get()->getStrongCount() <= 0) return nullptr;
+        return binder.promote();
+    }
+
+    Mutex mLock;
+    KeyedVector<String16, Entry> mEntries;
+};
+
 class BpServiceManager : public BpInterface<IServiceManager>
 {
 public:
     explicit BpServiceManager(const sp<IBinder>& impl)
-        : BpInterface<IServiceManager>(impl)
+        : BpInterface<IServiceManager>(impl),
+          mCache(new ServiceCache())
     {
     }
 
@@ -154,18 +259,28 @@ public:
             property_get("sys.boot_completed", bootCompleted, "0");
             gSystemBootCompleted = strcmp(bootCompleted, "1") == 0 ? true : false;
         }
-        // retry interval in millisecond; note that vendor services stay at 100ms
-        const long sleepTime = gSystemBootCompleted ? 1000 : 100;
-
-        int n = 0;
+        // max retry interval in millisecond; note that vendor services stay at 100ms
+        const long maxSleepTime = gSystemBootCompleted ? 1000 : 100;
+
+        // servicemanager has no registration notifications, so poll, but
+        // start short and back off: most services we wait for at startup
+        // are only a few milliseconds behind us.
+        long sleepTime = 5;
+        ALOGI("Waiting for service '%s' on '%s'...", String8(name).string(),
+            ProcessState::self()->getDriverName().c_str());
         while (uptimeMillis() < timeout) {
-            n++;
-            ALOGI("Waiting for service '%s' on '%s'...", String8(name).string(),
-                ProcessState::self()->getDriverName().c_str());
             usleep(1000*sleepTime);
 
             sp<IBinder> svc = checkService(name);
             if (svc != nullptr) return svc;
+
+            if (sleepTime < maxSleepTime) {
+                sleepTime = std::min(sleepTime * 2, maxSleepTime);
+                if (sleepTime == maxSleepTime) {
+                    ALOGI("Still waiting for service '%s' on '%s'...", String8(name).string(),
+                        ProcessState::self()->getDriverName().c_str());
+                }
+            }
         }
         ALOGW("Service %s didn't start. Returning NULL", String8(name).string());
         return nullptr;
@@ -173,11 +288,16 @@ public:
 
     virtual sp<IBinder> checkService( const String16& name) const
     {
+        sp<IBinder> svc = mCache->get(name);
+        if (svc != nullptr) return svc;
+
         Parcel data, reply;
         data.writeInterfaceToken(IServiceManager::getInterfaceDescriptor());
         data.writeString16(name);
         remote()->transact(CHECK_SERVICE_TRANSACTION, data, &reply);
-        return reply.readStrongBinder();
+        svc = reply.readStrongBinder();
+        mCache->put(name, svc);
+        return svc;
     }
 
     virtual status_t addService(const String16& name, const sp<IBinder>& service,
@@ -189,6 +309,7 @@ public:
         data.writeInt32(allowIsolated ? 1 : 0);
         data.writeInt32(dumpsysPriority);
         status_t err = remote()->transact(ADD_SERVICE_TRANSACTION, data, &reply);
+        mCache->invalidate(name);
         return err == NO_ERROR ? reply.readExceptionCode() : err;
     }
 
@@ -208,6 +329,9 @@ public:
         }
         return res;
     }
+
+private:
+    const sp<ServiceCache> mCache;
 };
 
 IMPLEMENT_META_INTERFACE(ServiceManager, "android.os.IServiceManager");
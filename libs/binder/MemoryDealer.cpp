@@ -25,6 +25,9 @@
 #include <utils/String8.h>
 #include <utils/threads.h>
 
+#include <set>
+#include <unordered_map>
+
 #include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
@@ -150,6 +153,15 @@ private:
         mutable chunk_t*    next;
     };
 
+    // Free chunks ordered by (size, start), so a best fit is a lower_bound
+    // and ties go to the lowest address like the old list walk did.
+    struct by_size {
+        bool operator()(const chunk_t* a, const chunk_t* b) const {
+            if (a->size != b->size) return a->size < b->size;
+            return a->start < b->start;
+        }
+    };
+
     ssize_t  alloc(size_t size, uint32_t flags);
     chunk_t* dealloc(size_t start);
     void     dump_l(const char* what) const;
@@ -157,7 +169,11 @@ private:
 
     static const int    kMemoryAlign;
     mutable Mutex       mLock;
+    // All chunks in address order; only used to find neighbours to merge.
     LinkedList<chunk_t> mList;
+    std::set<chunk_t*, by_size> mFreeChunks;
+    std::unordered_map<size_t, chunk_t*> mAllocatedChunks;
+    size_t              mAllocatedSize;
     size_t              mHeapSize;
 };
 
@@ -282,8 +298,11 @@ SimpleBestFitAllocator::SimpleBestFitAllocator(size_t size)
     size_t pagesize = getpagesize();
     mHeapSize = ((size + pagesize-1) & ~(pagesize-1));
 
+    mAllocatedSize = 0;
+
     chunk_t* node = new chunk_t(0, mHeapSize / kMemoryAlign);
     mList.insertHead(node);
+    mFreeChunks.insert(node);
 }
 
 SimpleBestFitAllocator::~SimpleBestFitAllocator()
@@ -329,96 +348,92 @@ ssize_t SimpleBestFitAllocator::alloc(size_t size, uint32_t flags)
         return 0;
     }
     size = (size + kMemoryAlign-1) / kMemoryAlign;
-    chunk_t* free_chunk = nullptr;
-    chunk_t* cur = mList.head();
 
     size_t pagesize = getpagesize();
-    while (cur) {
-        int extra = 0;
-        if (flags & PAGE_ALIGNED)
-            extra = ( -cur->start & ((pagesize/kMemoryAlign)-1) ) ;
-
-        // best fit
-        if (cur->free && (cur->size >= (size+extra))) {
-            if ((!free_chunk) || (cur->size < free_chunk->size)) {
-                free_chunk = cur;
-            }
-            if (cur->size == size) {
-                break;
-            }
+    chunk_t key(0, size);
+    auto it = mFreeChunks.lower_bound(&key);
+    if (flags & PAGE_ALIGNED) {
+        // Alignment padding depends on the start, so walk up from the
+        // smallest candidate until one still fits once padded.
+        while (it != mFreeChunks.end()) {
+            chunk_t* cur = *it;
+            size_t extra = ( -cur->start & ((pagesize/kMemoryAlign)-1) ) ;
+            if (cur->size >= size + extra) break;
+            ++it;
         }
-        cur = cur->next;
+    }
+    if (it == mFreeChunks.end()) {
+        return NO_MEMORY;
     }
 
-    if (free_chunk) {
-        const size_t free_size = free_chunk->size;
-        free_chunk->free = 0;
-        free_chunk->size = size;
-        if (free_size > size) {
-            int extra = 0;
-            if (flags & PAGE_ALIGNED)
-                extra = ( -free_chunk->start & ((pagesize/kMemoryAlign)-1) ) ;
-            if (extra) {
-                chunk_t* split = new chunk_t(free_chunk->start, extra);
-                free_chunk->start += extra;
-                mList.insertBefore(free_chunk, split);
-            }
+    chunk_t* free_chunk = *it;
+    mFreeChunks.erase(it);
 
-            ALOGE_IF((flags&PAGE_ALIGNED) && 
-                    ((free_chunk->start*kMemoryAlign)&(pagesize-1)),
-                    "PAGE_ALIGNED requested, but page is not aligned!!!");
+    const size_t free_size = free_chunk->size;
+    free_chunk->free = 0;
+    free_chunk->size = size;
+    if (free_size > size) {
+        int extra = 0;
+        if (flags & PAGE_ALIGNED)
+            extra = ( -free_chunk->start & ((pagesize/kMemoryAlign)-1) ) ;
+        if (extra) {
+            chunk_t* split = new chunk_t(free_chunk->start, extra);
+            free_chunk->start += extra;
+            mList.insertBefore(free_chunk, split);
+            mFreeChunks.insert(split);
+        }
 
-            const ssize_t tail_free = free_size - (size+extra);
-            if (tail_free > 0) {
-                chunk_t* split = new chunk_t(
-                        free_chunk->start + free_chunk->size, tail_free);
-                mList.insertAfter(free_chunk, split);
-            }
+        ALOGE_IF((flags&PAGE_ALIGNED) &&
+                ((free_chunk->start*kMemoryAlign)&(pagesize-1)),
+                "PAGE_ALIGNED requested, but page is not aligned!!!");
+
+        const ssize_t tail_free = free_size - (size+extra);
+        if (tail_free > 0) {
+            chunk_t* split = new chunk_t(
+                    free_chunk->start + free_chunk->size, tail_free);
+            mList.insertAfter(free_chunk, split);
+            mFreeChunks.insert(split);
         }
-        return (free_chunk->start)*kMemoryAlign;
     }
-    return NO_MEMORY;
+    mAllocatedChunks[free_chunk->start] = free_chunk;
+    mAllocatedSize += free_chunk->size;
+    return (free_chunk->start)*kMemoryAlign;
 }
 
 SimpleBestFitAllocator::chunk_t* SimpleBestFitAllocator::dealloc(size_t start)
 {
     start = start / kMemoryAlign;
-    chunk_t* cur = mList.head();
-    while (cur) {
-        if (cur->start == start) {
-            LOG_FATAL_IF(cur->free,
-                "block at offset 0x%08lX of size 0x%08lX already freed",
-                cur->start*kMemoryAlign, cur->size*kMemoryAlign);
-
-            // merge freed blocks together
-            chunk_t* freed = cur;
-            cur->free = 1;
-            do {
-                chunk_t* const p = cur->prev;
-                chunk_t* const n = cur->next;
-                if (p && (p->free || !cur->size)) {
-                    freed = p;
-                    p->size += cur->size;
-                    mList.remove(cur);
-                    delete cur;
-                }
-                cur = n;
-            } while (cur && cur->free);
-
-            #ifndef NDEBUG
-                if (!freed->free) {
-                    dump_l("dealloc (!freed->free)");
-                }
-            #endif
-            LOG_FATAL_IF(!freed->free,
-                "freed block at offset 0x%08lX of size 0x%08lX is not free!",
-                freed->start * kMemoryAlign, freed->size * kMemoryAlign);
-
-            return freed;
-        }
-        cur = cur->next;
+    auto it = mAllocatedChunks.find(start);
+    if (it == mAllocatedChunks.end()) {
+        return nullptr;
+    }
+
+    chunk_t* freed = it->second;
+    mAllocatedChunks.erase(it);
+    LOG_FATAL_IF(freed->free,
+        "block at offset 0x%08lX of size 0x%08lX already freed",
+        freed->start*kMemoryAlign, freed->size*kMemoryAlign);
+    mAllocatedSize -= freed->size;
+    freed->free = 1;
+
+    // merge freed blocks together
+    chunk_t* const p = freed->prev;
+    if (p && p->free) {
+        mFreeChunks.erase(p);
+        p->size += freed->size;
+        mList.remove(freed);
+        delete freed;
+        freed = p;
+    }
+    chunk_t* const n = freed->next;
+    if (n && n->free) {
+        mFreeChunks.erase(n);
+        freed->size += n->size;
+        mList.remove(n);
+        delete n;
     }
-    return nullptr;
+    mFreeChunks.insert(freed);
+    return freed;
 }
 
 void SimpleBestFitAllocator::dump(const char* what) const
@@ -478,6 +493,19 @@ void SimpleBestFitAllocator::dump_l(String8& result,
     snprintf(buffer, SIZE,
             "  size allocated: %u (%u KB)\n", int(size), int(size/1024));
     result.append(buffer);
+
+    // Fragmentation is how much of the free space is unusable for a single
+    // allocation of the largest free size: 0% means it is all one chunk.
+    const size_t freeSize = mHeapSize - mAllocatedSize*kMemoryAlign;
+    const size_t largestFree = mFreeChunks.empty() ? 0 :
+            (*mFreeChunks.rbegin())->size*kMemoryAlign;
+    snprintf(buffer, SIZE,
+            "  utilization: %u%%, %zu allocated / %zu free chunks, "
+            "largest free: %u KB, fragmentation: %u%%\n",
+            mHeapSize ? unsigned(mAllocatedSize*kMemoryAlign*100 / mHeapSize) : 0,
+            mAllocatedChunks.size(), mFreeChunks.size(), unsigned(largestFree/1024),
+            freeSize ? unsigned(100 - largestFree*100 / freeSize) : 0);
+    result.append(buffer);
 }
 
 
@@ -48,6 +48,7 @@
 #include <utils/String16.h>
 
 #include <private/binder/binder_module.h>
+#include <private/binder/ParcelBufferPool.h>
 #include <private/binder/Static.h>
 
 #ifndef INT32_MAX
@@ -87,6 +88,40 @@ static size_t gMaxFds = 0;
 // Maximum size of a blob to transfer in-place.
 static const size_t BLOB_INPLACE_LIMIT = 16 * 1024;
 
+// Data buffers at least this large are backed by anonymous pages rather than
+// the heap, so that growing them remaps the existing pages instead of copying
+// the whole contents on every reallocation.
+static const size_t MAPPED_DATA_THRESHOLD = 128 * 1024;
+
+static size_t page_round(size_t s) {
+    const size_t pageSize = static_cast<size_t>(getpagesize());
+    return (s + pageSize - 1) & ~(pageSize - 1);
+}
+
+static uint8_t* alloc_data(size_t desired, size_t* outCapacity, bool* outMapped) {
+    if (desired >= MAPPED_DATA_THRESHOLD) {
+        const size_t capacity = page_round(desired);
+        void* ptr = mmap(nullptr, capacity, PROT_READ | PROT_WRITE,
+                MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (ptr == MAP_FAILED) {
+            return nullptr;
+        }
+        *outCapacity = capacity;
+        *outMapped = true;
+        return static_cast<uint8_t*>(ptr);
+    }
+    *outMapped = false;
+    return static_cast<uint8_t*>(ParcelBufferPool::allocate(desired, outCapacity));
+}
+
+static void free_data(uint8_t* data, size_t capacity, bool mapped) {
+    if (mapped) {
+        munmap(data, capacity);
+    } else {
+        ParcelBufferPool::deallocate(data, capacity);
+    }
+}
+
 enum {
     BLOB_INPLACE = 0,
     BLOB_ASHMEM_IMMUTABLE = 1,
@@ -670,13 +705,18 @@ bool Parcel::enforceInterface(const String16& interface,
     updateWorkSourceRequestHeaderPosition();
     int32_t workSource = readInt32();
     threadState->setCallingWorkSourceUidWithoutPropagation(workSource);
-    // Interface descriptor.
-    const String16 str(readString16());
-    if (str == interface) {
+    // Interface descriptor, compared where it lies rather than copied on every transaction.
+    size_t len = 0;
+    const char16_t* str = readString16Inplace(&len);
+    if (str == nullptr) {
+        len = 0;
+    }
+    if (len == interface.size() &&
+            (len == 0 || memcmp(str, interface.string(), len * sizeof(char16_t)) == 0)) {
         return true;
     } else {
         ALOGW("**** enforceInterface() expected '%s' but read '%s'",
-                String8(interface).string(), String8(str).string());
+                String8(interface).string(), str != nullptr ? String8(str, len).string() : "");
         return false;
     }
 }
@@ -1280,6 +1320,21 @@ status_t Parcel::writeBlob(size_t len, bool mutableCopy, WritableBlob* outBlob)
         return NO_ERROR;
     }
 
+    return writeAshmemBlob(len, mutableCopy, outBlob);
+}
+
+status_t Parcel::writeSharedBlob(size_t len, WritableBlob* outBlob)
+{
+    if (len > INT32_MAX) {
+        return BAD_VALUE;
+    }
+    if (!mAllowFds) return FDS_NOT_ALLOWED;
+    return writeAshmemBlob(len, false /*mutableCopy*/, outBlob);
+}
+
+status_t Parcel::writeAshmemBlob(size_t len, bool mutableCopy, WritableBlob* outBlob)
+{
+    status_t status;
     ALOGV("writeBlob: write to ashmem");
     int fd = ashmem_create_region("Parcel Blob", len);
     if (fd < 0) return NO_MEMORY;
@@ -2573,6 +2628,7 @@ void Parcel::ipcSetDataReference(const uint8_t* data, size_t dataSize,
     mObjectsSize = mObjectsCapacity = objectsCount;
     mNextObjectHint = 0;
     mObjectsSorted = false;
+    mDataMapped = false;
     mOwner = relFunc;
     mOwnerCookie = relCookie;
     for (size_t i = 0; i < mObjectsSize; i++) {
@@ -2675,7 +2731,7 @@ void Parcel::freeDataNoInit()
               gParcelGlobalAllocCount--;
             }
             pthread_mutex_unlock(&gParcelGlobalAllocSizeLock);
-            free(mData);
+            free_data(mData, mDataCapacity, mDataMapped);
         }
         if (mObjects) free(mObjects);
     }
@@ -2697,6 +2753,36 @@ status_t Parcel::growData(size_t len)
             : continueWrite(newSize);
 }
 
+uint8_t* Parcel::reallocData(size_t desired, size_t* outCapacity)
+{
+    if (mDataMapped && desired >= MAPPED_DATA_THRESHOLD) {
+        // Let the kernel move the page mappings; nothing is copied.
+        const size_t capacity = page_round(desired);
+        void* ptr = mremap(mData, mDataCapacity, capacity, MREMAP_MAYMOVE);
+        if (ptr == MAP_FAILED) {
+            return nullptr;
+        }
+        *outCapacity = capacity;
+        return static_cast<uint8_t*>(ptr);
+    }
+
+    // Moving from the heap to mapped pages (or back) costs one last copy;
+    // after that, large buffers grow by remapping.
+    size_t capacity = 0;
+    bool mapped = false;
+    uint8_t* data = alloc_data(desired, &capacity, &mapped);
+    if (!data) {
+        return nullptr;
+    }
+    if (mData) {
+        memcpy(data, mData, mDataCapacity < capacity ? mDataCapacity : capacity);
+        free_data(mData, mDataCapacity, mDataMapped);
+    }
+    mDataMapped = mapped;
+    *outCapacity = capacity;
+    return data;
+}
+
 status_t Parcel::restartWrite(size_t desired)
 {
     if (desired > INT32_MAX) {
@@ -2710,7 +2796,8 @@ status_t Parcel::restartWrite(size_t desired)
         return continueWrite(desired);
     }
 
-    uint8_t* data = (uint8_t*)realloc(mData, desired);
+    size_t capacity = 0;
+    uint8_t* data = reallocData(desired, &capacity);
     if (!data && desired > mDataCapacity) {
         mError = NO_MEMORY;
         return NO_MEMORY;
@@ -2719,16 +2806,16 @@ status_t Parcel::restartWrite(size_t desired)
     releaseObjects();
 
     if (data) {
-        LOG_ALLOC("Parcel %p: restart from %zu to %zu capacity", this, mDataCapacity, desired);
+        LOG_ALLOC("Parcel %p: restart from %zu to %zu capacity", this, mDataCapacity, capacity);
         pthread_mutex_lock(&gParcelGlobalAllocSizeLock);
-        gParcelGlobalAllocSize += desired;
+        gParcelGlobalAllocSize += capacity;
         gParcelGlobalAllocSize -= mDataCapacity;
         if (!mData) {
             gParcelGlobalAllocCount++;
         }
         pthread_mutex_unlock(&gParcelGlobalAllocSizeLock);
         mData = data;
-        mDataCapacity = desired;
+        mDataCapacity = capacity;
     }
 
     mDataSize = mDataPos = 0;
@@ -2779,7 +2866,9 @@ status_t Parcel::continueWrite(size_t desired)
 
         // If there is a different owner, we need to take
         // posession.
-        uint8_t* data = (uint8_t*)malloc(desired);
+        size_t capacity = 0;
+        bool mapped = false;
+        uint8_t* data = alloc_data(desired, &capacity, &mapped);
         if (!data) {
             mError = NO_MEMORY;
             return NO_MEMORY;
@@ -2789,7 +2878,7 @@ status_t Parcel::continueWrite(size_t desired)
         if (objectsSize) {
             objects = (binder_size_t*)calloc(objectsSize, sizeof(binder_size_t));
             if (!objects) {
-                free(data);
+                free_data(data, capacity, mapped);
 
                 mError = NO_MEMORY;
                 return NO_MEMORY;
@@ -2813,17 +2902,18 @@ status_t Parcel::continueWrite(size_t desired)
         mOwner(this, mData, mDataSize, mObjects, mObjectsSize, mOwnerCookie);
         mOwner = nullptr;
 
-        LOG_ALLOC("Parcel %p: taking ownership of %zu capacity", this, desired);
+        LOG_ALLOC("Parcel %p: taking ownership of %zu capacity", this, capacity);
         pthread_mutex_lock(&gParcelGlobalAllocSizeLock);
-        gParcelGlobalAllocSize += desired;
+        gParcelGlobalAllocSize += capacity;
         gParcelGlobalAllocCount++;
         pthread_mutex_unlock(&gParcelGlobalAllocSizeLock);
 
         mData = data;
+        mDataMapped = mapped;
         mObjects = objects;
         mDataSize = (mDataSize < desired) ? mDataSize : desired;
         ALOGV("continueWrite Setting data size of %p to %zu", this, mDataSize);
-        mDataCapacity = desired;
+        mDataCapacity = capacity;
         mObjectsSize = mObjectsCapacity = objectsSize;
         mNextObjectHint = 0;
         mObjectsSorted = false;
@@ -2859,18 +2949,20 @@ status_t Parcel::continueWrite(size_t desired)
             mObjectsSorted = false;
         }
 
-        // We own the data, so we can just do a realloc().
+        // We own the data, so we can just do a realloc() (or a remap for
+        // large buffers).
         if (desired > mDataCapacity) {
-            uint8_t* data = (uint8_t*)realloc(mData, desired);
+            size_t capacity = 0;
+            uint8_t* data = reallocData(desired, &capacity);
             if (data) {
                 LOG_ALLOC("Parcel %p: continue from %zu to %zu capacity", this, mDataCapacity,
-                        desired);
+                        capacity);
                 pthread_mutex_lock(&gParcelGlobalAllocSizeLock);
-                gParcelGlobalAllocSize += desired;
+                gParcelGlobalAllocSize += capacity;
                 gParcelGlobalAllocSize -= mDataCapacity;
                 pthread_mutex_unlock(&gParcelGlobalAllocSizeLock);
                 mData = data;
-                mDataCapacity = desired;
+                mDataCapacity = capacity;
             } else {
                 mError = NO_MEMORY;
                 return NO_MEMORY;
@@ -2888,7 +2980,8 @@ status_t Parcel::continueWrite(size_t desired)
 
     } else {
         // This is the first data.  Easy!
-        uint8_t* data = (uint8_t*)malloc(desired);
+        size_t capacity = 0;
+        uint8_t* data = reallocData(desired, &capacity);
         if (!data) {
             mError = NO_MEMORY;
             return NO_MEMORY;
@@ -2899,9 +2992,9 @@ status_t Parcel::continueWrite(size_t desired)
             ALOGE("continueWrite: %zu/%p/%zu/%zu", mDataCapacity, mObjects, mObjectsCapacity, desired);
         }
 
-        LOG_ALLOC("Parcel %p: allocating with %zu capacity", this, desired);
+        LOG_ALLOC("Parcel %p: allocating with %zu capacity", this, capacity);
         pthread_mutex_lock(&gParcelGlobalAllocSizeLock);
-        gParcelGlobalAllocSize += desired;
+        gParcelGlobalAllocSize += capacity;
         gParcelGlobalAllocCount++;
         pthread_mutex_unlock(&gParcelGlobalAllocSizeLock);
 
@@ -2909,7 +3002,7 @@ status_t Parcel::continueWrite(size_t desired)
         mDataSize = mDataPos = 0;
         ALOGV("continueWrite Setting data size of %p to %zu", this, mDataSize);
         ALOGV("continueWrite Setting data pos of %p to %zu", this, mDataPos);
-        mDataCapacity = desired;
+        mDataCapacity = capacity;
     }
 
     return NO_ERROR;
@@ -2933,6 +3026,7 @@ void Parcel::initState()
     mHasFds = false;
     mFdsKnown = true;
     mAllowFds = true;
+    mDataMapped = false;
     mOwner = nullptr;
     mOpenAshmemSize = 0;
     mWorkSourceRequestHeaderPosition = 0;
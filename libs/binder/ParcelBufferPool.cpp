@@ -0,0 +1,139 @@
+/*
+ * Copyright (C) 2019 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#define LOG_TAG "ParcelBufferPool"
+
+#include <private/binder/ParcelBufferPool.h>
+
+#include <binder/IPCThreadState.h>
+
+#include <atomic>
+#include <stdlib.h>
+
+namespace android {
+
+static std::atomic<uint64_t> gPoolHits(0);
+static std::atomic<uint64_t> gPoolMisses(0);
+
+// Returns the size class serving |size|, or kNumClasses if it is too large
+// to be pooled.
+static size_t classForSize(size_t size) {
+    size_t cls = 0;
+    size_t classSize = ParcelBufferPool::kMinClassSize;
+    while (classSize < size && cls < ParcelBufferPool::kNumClasses) {
+        classSize <<= 1;
+        cls++;
+    }
+    return cls;
+}
+
+// Returns the largest size class that a block of |capacity| bytes can serve.
+static ssize_t classForCapacity(size_t capacity) {
+    if (capacity < ParcelBufferPool::kMinClassSize) {
+        return -1;
+    }
+    size_t cls = 0;
+    size_t classSize = ParcelBufferPool::kMinClassSize;
+    while ((classSize << 1) <= capacity && cls + 1 < ParcelBufferPool::kNumClasses) {
+        classSize <<= 1;
+        cls++;
+    }
+    return cls;
+}
+
+ParcelBufferPool::ParcelBufferPool() {
+    for (size_t i = 0; i < kNumClasses; i++) {
+        mCounts[i] = 0;
+    }
+}
+
+ParcelBufferPool::~ParcelBufferPool() {
+    trim();
+}
+
+ParcelBufferPool* ParcelBufferPool::current() {
+    IPCThreadState* state = IPCThreadState::selfOrNull();
+    return state != nullptr ? state->mBufferPool : nullptr;
+}
+
+void* ParcelBufferPool::allocate(size_t size, size_t* outCapacity) {
+    ParcelBufferPool* pool = current();
+    if (pool != nullptr) {
+        return pool->acquire(size, outCapacity);
+    }
+    void* data = malloc(size);
+    *outCapacity = size;
+    return data;
+}
+
+void ParcelBufferPool::deallocate(void* data, size_t capacity) {
+    ParcelBufferPool* pool = current();
+    if (pool != nullptr) {
+        pool->release(data, capacity);
+    } else {
+        free(data);
+    }
+}
+
+void* ParcelBufferPool::acquire(size_t size, size_t* outCapacity) {
+    const size_t cls = classForSize(size);
+    if (cls >= kNumClasses) {
+        gPoolMisses.fetch_add(1, std::memory_order_relaxed);
+        *outCapacity = size;
+        return malloc(size);
+    }
+
+    const size_t classSize = kMinClassSize << cls;
+    *outCapacity = classSize;
+    if (mCounts[cls] > 0) {
+        gPoolHits.fetch_add(1, std::memory_order_relaxed);
+        return mBlocks[cls][--mCounts[cls]];
+    }
+    gPoolMisses.fetch_add(1, std::memory_order_relaxed);
+    return malloc(classSize);
+}
+
+void ParcelBufferPool::release(void* data, size_t capacity) {
+    if (data == nullptr) {
+        return;
+    }
+    // Blocks larger than the biggest class are never cached, so that one
+    // oversized transaction does not pin its buffer for the thread's lifetime.
+    const ssize_t cls = capacity <= kMaxClassSize ? classForCapacity(capacity) : -1;
+    if (cls < 0 || mCounts[cls] >= kMaxBlocksPerClass) {
+        free(data);
+        return;
+    }
+    mBlocks[cls][mCounts[cls]++] = data;
+}
+
+void ParcelBufferPool::trim() {
+    for (size_t i = 0; i < kNumClasses; i++) {
+        while (mCounts[i] > 0) {
+            free(mBlocks[i][--mCounts[i]]);
+        }
+    }
+}
+
+uint64_t ParcelBufferPool::getGlobalHitCount() {
+    return gPoolHits.load(std::memory_order_relaxed);
+}
+
+uint64_t ParcelBufferPool::getGlobalMissCount() {
+    return gPoolMisses.load(std::memory_order_relaxed);
+}
+
+}; // namespace android
@@ -35,43 +35,57 @@ PermissionCache::PermissionCache() {
 }
 
 status_t PermissionCache::check(bool* granted,
-        const String16& permission, uid_t uid) const {
-    Mutex::Autolock _l(mLock);
+        const String16& permission, uid_t uid, nsecs_t now) const {
+    const Shard& shard = shardFor(uid);
+    Mutex::Autolock _l(shard.mLock);
     Entry e;
     e.name = permission;
     e.uid  = uid;
-    ssize_t index = mCache.indexOf(e);
+    ssize_t index = shard.mCache.indexOf(e);
     if (index >= 0) {
-        *granted = mCache.itemAt(index).granted;
-        return NO_ERROR;
+        const Entry& entry = shard.mCache.itemAt(index);
+        if (entry.expireTime > now) {
+            *granted = entry.granted;
+            return NO_ERROR;
+        }
     }
     return NAME_NOT_FOUND;
 }
 
 void PermissionCache::cache(const String16& permission,
-        uid_t uid, bool granted) {
-    Mutex::Autolock _l(mLock);
+        uid_t uid, bool granted, nsecs_t now) {
+    Shard& shard = shardFor(uid);
+    Mutex::Autolock _l(shard.mLock);
     Entry e;
-    ssize_t index = mPermissionNamesPool.indexOf(permission);
-    if (index > 0) {
-        e.name = mPermissionNamesPool.itemAt(index);
-    } else {
-        mPermissionNamesPool.add(permission);
-        e.name = permission;
-    }
+    e.name = permission;
     // note, we don't need to store the pid, which is not actually used in
     // permission checks
     e.uid  = uid;
     e.granted = granted;
-    index = mCache.indexOf(e);
+    e.expireTime = now + (granted ? GRANTED_TTL : DENIED_TTL);
+    ssize_t index = shard.mCache.indexOf(e);
     if (index < 0) {
-        mCache.add(e);
+        shard.mCache.add(e);
+    } else {
+        shard.mCache.editItemAt(index) = e;
     }
 }
 
 void PermissionCache::purge() {
-    Mutex::Autolock _l(mLock);
-    mCache.clear();
+    for (Shard& shard : mShards) {
+        Mutex::Autolock _l(shard.mLock);
+        shard.mCache.clear();
+    }
+}
+
+void PermissionCache::purge(uid_t uid) {
+    Shard& shard = shardFor(uid);
+    Mutex::Autolock _l(shard.mLock);
+    for (size_t i = shard.mCache.size(); i > 0; i--) {
+        if (shard.mCache.itemAt(i - 1).uid == uid) {
+            shard.mCache.removeAt(i - 1);
+        }
+    }
 }
 
 bool PermissionCache::checkCallingPermission(const String16& permission) {
@@ -109,5 +123,13 @@ bool PermissionCache::checkPermission(
     return granted;
 }
 
+void PermissionCache::invalidate(uid_t uid) {
+    PermissionCache::getInstance().purge(uid);
+}
+
+void PermissionCache::invalidateAll() {
+    PermissionCache::getInstance().purge();
+}
+
 // ---------------------------------------------------------------------------
 }; // namespace android
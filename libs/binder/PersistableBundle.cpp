@@ -19,7 +19,9 @@
 #include <binder/PersistableBundle.h>
 #include <private/binder/ParcelValTypes.h>
 
+#include <algorithm>
 #include <limits>
+#include <mutex>
 
 #include <binder/IBinder.h>
 #include <binder/Parcel.h>
@@ -29,6 +31,7 @@
 using android::BAD_TYPE;
 using android::BAD_VALUE;
 using android::NO_ERROR;
+using android::NOT_ENOUGH_DATA;
 using android::Parcel;
 using android::sp;
 using android::status_t;
@@ -45,6 +48,16 @@ enum {
 };
 
 namespace {
+template <typename T>
+void putValue(const android::String16& key, T&& value, map<android::String16, T>* map) {
+    auto it = map->find(key);
+    if (it == map->end()) {
+        map->emplace(key, std::move(value));
+    } else {
+        it->second = std::move(value);
+    }
+}
+
 template <typename T>
 bool getValue(const android::String16& key, T* out, const map<android::String16, T>& map) {
     const auto& it = map.find(key);
@@ -68,6 +81,16 @@ namespace android {
 
 namespace os {
 
+struct PersistableBundle::ParcelledData {
+    // Guards the data position of |parcel|, which is shared by the copies of a bundle
+    std::mutex lock;
+    // The magic number and entries of the bundle, as read
+    int32_t magic;
+    Parcel parcel;
+    // Where each key-value pair starts in |parcel|
+    vector<size_t> entryOffsets;
+};
+
 #define RETURN_IF_FAILED(calledOnce)                                     \
     {                                                                    \
         status_t returnStatus = calledOnce;                              \
@@ -98,6 +121,16 @@ status_t PersistableBundle::writeToParcel(Parcel* parcel) const {
         return NO_ERROR;
     }
 
+    if (mParcelledData != nullptr) {
+        // Still as it was read, so pass the entries through
+        std::lock_guard<std::mutex> lock(mParcelledData->lock);
+        const Parcel& data = mParcelledData->parcel;
+        RETURN_IF_FAILED(parcel->writeInt32(static_cast<int32_t>(data.dataSize())));
+        RETURN_IF_FAILED(parcel->writeInt32(mParcelledData->magic));
+        RETURN_IF_FAILED(parcel->appendFrom(&data, 0, data.dataSize()));
+        return NO_ERROR;
+    }
+
     size_t length_pos = parcel->dataPosition();
     RETURN_IF_FAILED(parcel->writeInt32(1));  // dummy, will hold length
     RETURN_IF_FAILED(parcel->writeInt32(BUNDLE_MAGIC_NATIVE));
@@ -137,6 +170,9 @@ bool PersistableBundle::empty() const {
 }
 
 size_t PersistableBundle::size() const {
+    if (mParcelledData != nullptr) {
+        return mParcelledData->entryOffsets.size();
+    }
     return (mBoolMap.size() +
             mIntMap.size() +
             mLongMap.size() +
@@ -151,6 +187,7 @@ size_t PersistableBundle::size() const {
 }
 
 size_t PersistableBundle::erase(const String16& key) {
+    unparcel();
     RETURN_IF_ENTRY_ERASED(mBoolMap, key);
     RETURN_IF_ENTRY_ERASED(mIntMap, key);
     RETURN_IF_ENTRY_ERASED(mLongMap, key);
@@ -219,91 +256,199 @@ void PersistableBundle::putPersistableBundle(const String16& key, const Persista
     mPersistableBundleMap[key] = value;
 }
 
+void PersistableBundle::putString(const String16& key, String16&& value) {
+    erase(key);
+    putValue(key, std::move(value), &mStringMap);
+}
+
+void PersistableBundle::putBooleanVector(const String16& key, vector<bool>&& value) {
+    erase(key);
+    putValue(key, std::move(value), &mBoolVectorMap);
+}
+
+void PersistableBundle::putIntVector(const String16& key, vector<int32_t>&& value) {
+    erase(key);
+    putValue(key, std::move(value), &mIntVectorMap);
+}
+
+void PersistableBundle::putLongVector(const String16& key, vector<int64_t>&& value) {
+    erase(key);
+    putValue(key, std::move(value), &mLongVectorMap);
+}
+
+void PersistableBundle::putDoubleVector(const String16& key, vector<double>&& value) {
+    erase(key);
+    putValue(key, std::move(value), &mDoubleVectorMap);
+}
+
+void PersistableBundle::putStringVector(const String16& key, vector<String16>&& value) {
+    erase(key);
+    putValue(key, std::move(value), &mStringVectorMap);
+}
+
+void PersistableBundle::putPersistableBundle(const String16& key, PersistableBundle&& value) {
+    erase(key);
+    putValue(key, std::move(value), &mPersistableBundleMap);
+}
+
 bool PersistableBundle::getBoolean(const String16& key, bool* out) const {
+    if (mParcelledData != nullptr) {
+        return getParcelled(key, VAL_BOOLEAN, out, &Parcel::readBool);
+    }
     return getValue(key, out, mBoolMap);
 }
 
 bool PersistableBundle::getInt(const String16& key, int32_t* out) const {
+    if (mParcelledData != nullptr) {
+        return getParcelled(key, VAL_INTEGER, out, &Parcel::readInt32);
+    }
     return getValue(key, out, mIntMap);
 }
 
 bool PersistableBundle::getLong(const String16& key, int64_t* out) const {
+    if (mParcelledData != nullptr) {
+        return getParcelled(key, VAL_LONG, out, &Parcel::readInt64);
+    }
     return getValue(key, out, mLongMap);
 }
 
 bool PersistableBundle::getDouble(const String16& key, double* out) const {
+    if (mParcelledData != nullptr) {
+        return getParcelled(key, VAL_DOUBLE, out, &Parcel::readDouble);
+    }
     return getValue(key, out, mDoubleMap);
 }
 
 bool PersistableBundle::getString(const String16& key, String16* out) const {
+    if (mParcelledData != nullptr) {
+        return getParcelled(key, VAL_STRING, out, &Parcel::readString16);
+    }
     return getValue(key, out, mStringMap);
 }
 
 bool PersistableBundle::getBooleanVector(const String16& key, vector<bool>* out) const {
+    if (mParcelledData != nullptr) {
+        return getParcelled(key, VAL_BOOLEANARRAY, out, &Parcel::readBoolVector);
+    }
     return getValue(key, out, mBoolVectorMap);
 }
 
 bool PersistableBundle::getIntVector(const String16& key, vector<int32_t>* out) const {
+    if (mParcelledData != nullptr) {
+        return getParcelled(key, VAL_INTARRAY, out, &Parcel::readInt32Vector);
+    }
     return getValue(key, out, mIntVectorMap);
 }
 
 bool PersistableBundle::getLongVector(const String16& key, vector<int64_t>* out) const {
+    if (mParcelledData != nullptr) {
+        return getParcelled(key, VAL_LONGARRAY, out, &Parcel::readInt64Vector);
+    }
     return getValue(key, out, mLongVectorMap);
 }
 
 bool PersistableBundle::getDoubleVector(const String16& key, vector<double>* out) const {
+    if (mParcelledData != nullptr) {
+        return getParcelled(key, VAL_DOUBLEARRAY, out, &Parcel::readDoubleVector);
+    }
     return getValue(key, out, mDoubleVectorMap);
 }
 
 bool PersistableBundle::getStringVector(const String16& key, vector<String16>* out) const {
+    if (mParcelledData != nullptr) {
+        return getParcelled(key, VAL_STRINGARRAY, out, &Parcel::readString16Vector);
+    }
     return getValue(key, out, mStringVectorMap);
 }
 
 bool PersistableBundle::getPersistableBundle(const String16& key, PersistableBundle* out) const {
+    if (mParcelledData != nullptr) {
+        std::lock_guard<std::mutex> lock(mParcelledData->lock);
+        PersistableBundle value;
+        if (!findParcelled(key, VAL_PERSISTABLEBUNDLE) ||
+            value.readFromParcel(&mParcelledData->parcel) != NO_ERROR) {
+            return false;
+        }
+        *out = std::move(value);
+        return true;
+    }
     return getValue(key, out, mPersistableBundleMap);
 }
 
 set<String16> PersistableBundle::getBooleanKeys() const {
+    if (mParcelledData != nullptr) {
+        return getParcelledKeys(VAL_BOOLEAN);
+    }
     return getKeys(mBoolMap);
 }
 
 set<String16> PersistableBundle::getIntKeys() const {
+    if (mParcelledData != nullptr) {
+        return getParcelledKeys(VAL_INTEGER);
+    }
     return getKeys(mIntMap);
 }
 
 set<String16> PersistableBundle::getLongKeys() const {
+    if (mParcelledData != nullptr) {
+        return getParcelledKeys(VAL_LONG);
+    }
     return getKeys(mLongMap);
 }
 
 set<String16> PersistableBundle::getDoubleKeys() const {
+    if (mParcelledData != nullptr) {
+        return getParcelledKeys(VAL_DOUBLE);
+    }
     return getKeys(mDoubleMap);
 }
 
 set<String16> PersistableBundle::getStringKeys() const {
+    if (mParcelledData != nullptr) {
+        return getParcelledKeys(VAL_STRING);
+    }
     return getKeys(mStringMap);
 }
 
 set<String16> PersistableBundle::getBooleanVectorKeys() const {
+    if (mParcelledData != nullptr) {
+        return getParcelledKeys(VAL_BOOLEANARRAY);
+    }
     return getKeys(mBoolVectorMap);
 }
 
 set<String16> PersistableBundle::getIntVectorKeys() const {
+    if (mParcelledData != nullptr) {
+        return getParcelledKeys(VAL_INTARRAY);
+    }
     return getKeys(mIntVectorMap);
 }
 
 set<String16> PersistableBundle::getLongVectorKeys() const {
+    if (mParcelledData != nullptr) {
+        return getParcelledKeys(VAL_LONGARRAY);
+    }
     return getKeys(mLongVectorMap);
 }
 
 set<String16> PersistableBundle::getDoubleVectorKeys() const {
+    if (mParcelledData != nullptr) {
+        return getParcelledKeys(VAL_DOUBLEARRAY);
+    }
     return getKeys(mDoubleVectorMap);
 }
 
 set<String16> PersistableBundle::getStringVectorKeys() const {
+    if (mParcelledData != nullptr) {
+        return getParcelledKeys(VAL_STRINGARRAY);
+    }
     return getKeys(mStringVectorMap);
 }
 
 set<String16> PersistableBundle::getPersistableBundleKeys() const {
+    if (mParcelledData != nullptr) {
+        return getParcelledKeys(VAL_PERSISTABLEBUNDLE);
+    }
     return getKeys(mPersistableBundleMap);
 }
 
@@ -380,11 +525,127 @@ status_t PersistableBundle::writeToParcelInner(Parcel* parcel) const {
     return NO_ERROR;
 }
 
+namespace {
+
+status_t skipEntries(const Parcel& parcel, vector<size_t>* entry_offsets);
+
+// Moves past |count| values of |size| bytes each, preceded by their count.
+status_t skipArray(const Parcel& parcel, size_t size) {
+    int32_t count;
+    RETURN_IF_FAILED(parcel.readInt32(&count));
+    if (count < 0) {
+        return UNEXPECTED_NULL;
+    }
+    if (static_cast<size_t>(count) > parcel.dataAvail() / size) {
+        return NOT_ENOUGH_DATA;
+    }
+    parcel.setDataPosition(parcel.dataPosition() + count * size);
+    return NO_ERROR;
+}
+
+// Moves past a value of the given type, checking it as far as reading it would.
+status_t skipValue(const Parcel& parcel, int32_t value_type) {
+    size_t length;
+    switch (value_type) {
+        case VAL_STRING: {
+            return parcel.readString16Inplace(&length) != nullptr ? NO_ERROR : UNEXPECTED_NULL;
+        }
+        case VAL_INTEGER:
+        case VAL_BOOLEAN: {
+            int32_t value;
+            return parcel.readInt32(&value);
+        }
+        case VAL_LONG:
+        case VAL_DOUBLE: {
+            int64_t value;
+            return parcel.readInt64(&value);
+        }
+        case VAL_STRINGARRAY: {
+            int32_t count;
+            RETURN_IF_FAILED(parcel.readInt32(&count));
+            if (count < 0) {
+                return UNEXPECTED_NULL;
+            }
+            for (; count > 0; --count) {
+                if (parcel.readString16Inplace(&length) == nullptr) {
+                    return UNEXPECTED_NULL;
+                }
+            }
+            return NO_ERROR;
+        }
+        case VAL_INTARRAY:
+        case VAL_BOOLEANARRAY: {
+            return skipArray(parcel, sizeof(int32_t));
+        }
+        case VAL_LONGARRAY:
+        case VAL_DOUBLEARRAY: {
+            return skipArray(parcel, sizeof(int64_t));
+        }
+        case VAL_PERSISTABLEBUNDLE: {
+            int32_t bundle_length;
+            RETURN_IF_FAILED(parcel.readInt32(&bundle_length));
+            if (bundle_length < 0) {
+                return UNEXPECTED_NULL;
+            }
+            if (bundle_length == 0) {
+                return NO_ERROR;
+            }
+            int32_t magic;
+            RETURN_IF_FAILED(parcel.readInt32(&magic));
+            if (magic != BUNDLE_MAGIC && magic != BUNDLE_MAGIC_NATIVE) {
+                ALOGE("Bad magic number for PersistableBundle: 0x%08x", magic);
+                return BAD_VALUE;
+            }
+            const size_t start_pos = parcel.dataPosition();
+            if (static_cast<size_t>(bundle_length) > parcel.dataAvail()) {
+                return BAD_VALUE;
+            }
+            RETURN_IF_FAILED(skipEntries(parcel, nullptr));
+            parcel.setDataPosition(start_pos + bundle_length);
+            return NO_ERROR;
+        }
+        default: {
+            ALOGE("Unrecognized type: %d", value_type);
+            return BAD_TYPE;
+        }
+    }
+}
+
+// Moves past the entries of a bundle, recording where each of them starts if asked to.
+status_t skipEntries(const Parcel& parcel, vector<size_t>* entry_offsets) {
+    /*
+     * To keep this implementation in sync with unparcel() in
+     * frameworks/base/core/java/android/os/BaseBundle.java, the number of
+     * key-value pairs must be read from the parcel before reading the key-value
+     * pairs themselves.
+     */
+    int32_t num_entries;
+    RETURN_IF_FAILED(parcel.readInt32(&num_entries));
+    if (entry_offsets != nullptr && num_entries > 0) {
+        entry_offsets->reserve(std::min(static_cast<size_t>(num_entries),
+                                        parcel.dataAvail() / (2 * sizeof(int32_t))));
+    }
+    for (; num_entries > 0; --num_entries) {
+        if (entry_offsets != nullptr) {
+            entry_offsets->push_back(parcel.dataPosition());
+        }
+        size_t key_length;
+        int32_t value_type;
+        if (parcel.readString16Inplace(&key_length) == nullptr) {
+            return UNEXPECTED_NULL;
+        }
+        RETURN_IF_FAILED(parcel.readInt32(&value_type));
+        RETURN_IF_FAILED(skipValue(parcel, value_type));
+    }
+    return NO_ERROR;
+}
+
+}  // namespace
+
 status_t PersistableBundle::readFromParcelInner(const Parcel* parcel, size_t length) {
     /*
-     * Note: we don't actually use length for anything other than an empty PersistableBundle
-     * check, since we do not actually need to copy in an entire Parcel, unlike in the Java
-     * implementation.
+     * Unlike in the Java implementation, the entries are not only copied in but also
+     * checked and indexed here, so that a malformed bundle fails to read as before.
      */
     if (length == 0) {
         // Empty PersistableBundle or end of data.
@@ -398,12 +659,33 @@ status_t PersistableBundle::readFromParcelInner(const Parcel* parcel, size_t len
         return BAD_VALUE;
     }
 
-    /*
-     * To keep this implementation in sync with unparcel() in
-     * frameworks/base/core/java/android/os/BaseBundle.java, the number of
-     * key-value pairs must be read from the parcel before reading the key-value
-     * pairs themselves.
-     */
+    if (!empty()) {
+        // Merge into what is already there
+        unparcel();
+        return readEntries(parcel);
+    }
+
+    const size_t start_pos = parcel->dataPosition();
+    if (length > parcel->dataAvail()) {
+        ALOGE("Bad length for PersistableBundle: %zu, %zu available", length,
+              parcel->dataAvail());
+        return BAD_VALUE;
+    }
+    auto data = std::make_shared<ParcelledData>();
+    data->magic = magic;
+    RETURN_IF_FAILED(data->parcel.appendFrom(parcel, start_pos, length));
+    parcel->setDataPosition(start_pos + length);
+
+    data->parcel.setDataPosition(0);
+    RETURN_IF_FAILED(skipEntries(data->parcel, &data->entryOffsets));
+
+    if (!data->entryOffsets.empty()) {
+        mParcelledData = std::move(data);
+    }
+    return NO_ERROR;
+}
+
+status_t PersistableBundle::readEntries(const Parcel* parcel) {
     int32_t num_entries;
     RETURN_IF_FAILED(parcel->readInt32(&num_entries));
 
@@ -473,6 +755,84 @@ status_t PersistableBundle::readFromParcelInner(const Parcel* parcel, size_t len
     return NO_ERROR;
 }
 
+void PersistableBundle::unparcel() {
+    if (mParcelledData == nullptr) {
+        return;
+    }
+    std::shared_ptr<ParcelledData> data = std::move(mParcelledData);
+    std::lock_guard<std::mutex> lock(data->lock);
+    data->parcel.setDataPosition(0);
+    // The entries were checked when read, so this cannot fail short of running out of memory
+    status_t status = readEntries(&data->parcel);
+    ALOGE_IF(status != NO_ERROR, "Failed to decode PersistableBundle: %d", status);
+}
+
+bool PersistableBundle::findParcelled(const String16& key, int32_t type) const {
+    const Parcel& parcel = mParcelledData->parcel;
+    for (size_t offset : mParcelledData->entryOffsets) {
+        parcel.setDataPosition(offset);
+        size_t key_length;
+        const char16_t* entry_key = parcel.readString16Inplace(&key_length);
+        if (entry_key == nullptr || key_length != key.size() ||
+            memcmp(entry_key, key.string(), key_length * sizeof(char16_t)) != 0) {
+            continue;
+        }
+        // Keys are unique, so this is the only candidate
+        int32_t value_type;
+        return parcel.readInt32(&value_type) == NO_ERROR && value_type == type;
+    }
+    return false;
+}
+
+template <typename T>
+bool PersistableBundle::getParcelled(const String16& key, int32_t type, T* out,
+                                     status_t (Parcel::*read)(T*) const) const {
+    std::lock_guard<std::mutex> lock(mParcelledData->lock);
+    T value;
+    if (!findParcelled(key, type) || (mParcelledData->parcel.*read)(&value) != NO_ERROR) {
+        return false;
+    }
+    *out = std::move(value);
+    return true;
+}
+
+set<String16> PersistableBundle::getParcelledKeys(int32_t type) const {
+    std::lock_guard<std::mutex> lock(mParcelledData->lock);
+    const Parcel& parcel = mParcelledData->parcel;
+    set<String16> keys;
+    for (size_t offset : mParcelledData->entryOffsets) {
+        parcel.setDataPosition(offset);
+        size_t key_length;
+        const char16_t* key = parcel.readString16Inplace(&key_length);
+        int32_t value_type;
+        if (key != nullptr && parcel.readInt32(&value_type) == NO_ERROR && value_type == type) {
+            keys.emplace(key, key_length);
+        }
+    }
+    return keys;
+}
+
+bool PersistableBundle::equals(const PersistableBundle& other) const {
+    if (mParcelledData != nullptr || other.mParcelledData != nullptr) {
+        if (mParcelledData == other.mParcelledData) {
+            return true;
+        }
+        PersistableBundle lhs = *this;
+        PersistableBundle rhs = other;
+        lhs.unparcel();
+        rhs.unparcel();
+        return lhs.equals(rhs);
+    }
+    return (mBoolMap == other.mBoolMap && mIntMap == other.mIntMap &&
+            mLongMap == other.mLongMap && mDoubleMap == other.mDoubleMap &&
+            mStringMap == other.mStringMap && mBoolVectorMap == other.mBoolVectorMap &&
+            mIntVectorMap == other.mIntVectorMap && mLongVectorMap == other.mLongVectorMap &&
+            mDoubleVectorMap == other.mDoubleVectorMap &&
+            mStringVectorMap == other.mStringVectorMap &&
+            mPersistableBundleMap == other.mPersistableBundleMap);
+}
+
+
 }  // namespace os
 
 }  // namespace android
@@ -25,6 +25,7 @@
 #include <utils/Log.h>
 #include <utils/String8.h>
 #include <utils/String8.h>
+#include <utils/SystemClock.h>
 #include <utils/threads.h>
 
 #include <private/binder/binder_module.h>
@@ -56,19 +57,22 @@ namespace android {
 class PoolThread : public Thread
 {
 public:
-    explicit PoolThread(bool isMain)
+    PoolThread(bool isMain, bool requested)
         : mIsMain(isMain)
+        , mRequested(requested)
     {
     }
     
 protected:
     virtual bool threadLoop()
     {
-        IPCThreadState::self()->joinThreadPool(mIsMain);
+        IPCThreadState::self()->joinThreadPoolInternal(mIsMain, mRequested);
         return false;
     }
     
     const bool mIsMain;
+    // Whether the driver asked for this thread
+    const bool mRequested;
 };
 
 sp<ProcessState> ProcessState::self()
@@ -243,26 +247,33 @@ void ProcessState::setCallRestriction(CallRestriction restriction) {
     mCallRestriction = restriction;
 }
 
-ProcessState::handle_entry* ProcessState::lookupHandleLocked(int32_t handle)
+ProcessState::handle_shard& ProcessState::shardForHandle(int32_t handle)
 {
-    const size_t N=mHandleToObject.size();
-    if (N <= (size_t)handle) {
+    return mHandleShards[static_cast<uint32_t>(handle) % kHandleShardCount];
+}
+
+ProcessState::handle_entry* ProcessState::lookupHandleLocked(handle_shard& shard, int32_t handle)
+{
+    const size_t index = static_cast<uint32_t>(handle) / kHandleShardCount;
+    const size_t N=shard.entries.size();
+    if (N <= index) {
         handle_entry e;
         e.binder = nullptr;
         e.refs = nullptr;
-        status_t err = mHandleToObject.insertAt(e, N, handle+1-N);
+        status_t err = shard.entries.insertAt(e, N, index+1-N);
         if (err < NO_ERROR) return nullptr;
     }
-    return &mHandleToObject.editItemAt(handle);
+    return &shard.entries.editItemAt(index);
 }
 
 sp<IBinder> ProcessState::getStrongProxyForHandle(int32_t handle)
 {
     sp<IBinder> result;
 
-    AutoMutex _l(mLock);
+    handle_shard& shard = shardForHandle(handle);
+    AutoMutex _l(shard.lock);
 
-    handle_entry* e = lookupHandleLocked(handle);
+    handle_entry* e = lookupHandleLocked(shard, handle);
 
     if (e != nullptr) {
         // We need to create a new BpBinder if there isn't currently one, OR we
@@ -317,15 +328,16 @@ wp<IBinder> ProcessState::getWeakProxyForHandle(int32_t handle)
 {
     wp<IBinder> result;
 
-    AutoMutex _l(mLock);
+    handle_shard& shard = shardForHandle(handle);
+    AutoMutex _l(shard.lock);
 
-    handle_entry* e = lookupHandleLocked(handle);
+    handle_entry* e = lookupHandleLocked(shard, handle);
 
     if (e != nullptr) {        
         // We need to create a new BpBinder if there isn't currently one, OR we
         // are unable to acquire a weak reference on this current one.  The
         // attemptIncWeak() is safe because we know the BpBinder destructor will always
-        // call expungeHandle(), which acquires the same lock we are holding now.
+        // call expungeHandle(), which acquires the same shard lock we are holding now.
         // We need to do this because there is a race condition between someone
         // releasing a reference on this BpBinder, and a new reference on its handle
         // arriving from the driver.
@@ -346,9 +358,10 @@ wp<IBinder> ProcessState::getWeakProxyForHandle(int32_t handle)
 
 void ProcessState::expungeHandle(int32_t handle, IBinder* binder)
 {
-    AutoMutex _l(mLock);
-    
-    handle_entry* e = lookupHandleLocked(handle);
+    handle_shard& shard = shardForHandle(handle);
+    AutoMutex _l(shard.lock);
+
+    handle_entry* e = lookupHandleLocked(shard, handle);
 
     // This handle may have already been replaced with a new BpBinder
     // (if someone failed the AttemptIncWeak() above); we don't want
@@ -365,26 +378,103 @@ String8 ProcessState::makeBinderThreadName() {
 }
 
 void ProcessState::spawnPooledThread(bool isMain)
+{
+    spawnPooledThreadInternal(isMain, false /*requested*/);
+}
+
+void ProcessState::spawnRequestedThread()
+{
+    spawnPooledThreadInternal(false /*isMain*/, true /*requested*/);
+}
+
+void ProcessState::spawnPooledThreadInternal(bool isMain, bool requested)
 {
     if (mThreadPoolStarted) {
+        if (requested) {
+            pthread_mutex_lock(&mThreadCountLock);
+            mSpawnedThreadsCount++;
+            mLastSpawnTimeMs = uptimeMillis();
+            pthread_mutex_unlock(&mThreadCountLock);
+        }
         String8 name = makeBinderThreadName();
         ALOGV("Spawning new pooled thread, name=%s\n", name.string());
-        sp<Thread> t = new PoolThread(isMain);
+        sp<Thread> t = new PoolThread(isMain, requested);
         t->run(name.string());
     }
 }
 
 status_t ProcessState::setThreadPoolMaxThreadCount(size_t maxThreads) {
     status_t result = NO_ERROR;
-    if (ioctl(mDriverFD, BINDER_SET_MAX_THREADS, &maxThreads) != -1) {
+    pthread_mutex_lock(&mThreadCountLock);
+    size_t driverMaxThreads = maxThreads + mReapedThreadsCount;
+    if (ioctl(mDriverFD, BINDER_SET_MAX_THREADS, &driverMaxThreads) != -1) {
         mMaxThreads = maxThreads;
     } else {
         result = -errno;
         ALOGE("Binder ioctl to set max threads failed: %s", strerror(-result));
     }
+    pthread_mutex_unlock(&mThreadCountLock);
     return result;
 }
 
+status_t ProcessState::setThreadPoolAdaptive(size_t minThreads, size_t maxThreads,
+                                             int64_t idleTimeoutMs) {
+    if (minThreads > maxThreads || idleTimeoutMs <= 0) {
+        return BAD_VALUE;
+    }
+    status_t result = setThreadPoolMaxThreadCount(maxThreads);
+    if (result == NO_ERROR) {
+        pthread_mutex_lock(&mThreadCountLock);
+        mMinThreads = minThreads;
+        mIdleTimeoutMs = idleTimeoutMs;
+        pthread_mutex_unlock(&mThreadCountLock);
+    }
+    return result;
+}
+
+int64_t ProcessState::getIdleTimeoutMs() {
+    pthread_mutex_lock(&mThreadCountLock);
+    int64_t idleTimeoutMs = mIdleTimeoutMs;
+    pthread_mutex_unlock(&mThreadCountLock);
+    return idleTimeoutMs;
+}
+
+bool ProcessState::tryReapIdleThread(bool* outKeepWaiting) {
+    bool reaped = false;
+    pthread_mutex_lock(&mThreadCountLock);
+    *outKeepWaiting = mIdleTimeoutMs > 0 && mSpawnedThreadsCount > mMinThreads;
+    // Keep the threads if the driver asked for one recently: the load that
+    // caused it is likely still around. Past that, shrink by at most one
+    // thread per idle timeout, so that a pool that is only briefly idle
+    // doesn't lose all of its threads at once and have to respawn them.
+    const int64_t now = uptimeMillis();
+    if (mIdleTimeoutMs > 0 && mSpawnedThreadsCount > mMinThreads &&
+            now - mLastSpawnTimeMs >= mIdleTimeoutMs && now - mLastReapTimeMs >= mIdleTimeoutMs) {
+        // Only threads the driver spawned count against its limit, so the
+        // raised limit still keeps them at mMaxThreads.
+        size_t driverMaxThreads = mMaxThreads + mReapedThreadsCount + 1;
+        if (ioctl(mDriverFD, BINDER_SET_MAX_THREADS, &driverMaxThreads) != -1) {
+            mReapedThreadsCount++;
+            mSpawnedThreadsCount--;
+            mLastReapTimeMs = now;
+            *outKeepWaiting = false;
+            reaped = true;
+        } else {
+            ALOGE("Binder ioctl to set max threads failed: %s", strerror(errno));
+        }
+    }
+    pthread_mutex_unlock(&mThreadCountLock);
+    return reaped;
+}
+
+void ProcessState::onSpawnedThreadExit() {
+    pthread_mutex_lock(&mThreadCountLock);
+    if (mSpawnedThreadsCount > 0) {
+        mSpawnedThreadsCount--;
+    }
+    pthread_mutex_unlock(&mThreadCountLock);
+}
+
 void ProcessState::giveThreadPoolName() {
     androidSetThreadName( makeBinderThreadName().string() );
 }
@@ -430,6 +520,12 @@ ProcessState::ProcessState(const char *driver)
     , mExecutingThreadsCount(0)
     , mMaxThreads(DEFAULT_MAX_BINDER_THREADS)
     , mStarvationStartTimeMs(0)
+    , mSpawnedThreadsCount(0)
+    , mMinThreads(0)
+    , mIdleTimeoutMs(0)
+    , mLastSpawnTimeMs(0)
+    , mLastReapTimeMs(0)
+    , mReapedThreadsCount(0)
     , mManagesContexts(false)
     , mBinderContextCheckFunc(nullptr)
     , mBinderContextUserData(nullptr)
@@ -0,0 +1,369 @@
+/*
+ * Copyright (C) 2019 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#define LOG_TAG "TransactionStats"
+
+#include <binder/TransactionStats.h>
+
+#include <binder/IPCThreadState.h>
+#include <cutils/properties.h>
+#include <private/binder/TransactionStatsTable.h>
+
+#include <inttypes.h>
+
+#include <algorithm>
+#include <iterator>
+#include <map>
+#include <mutex>
+#include <tuple>
+#include <vector>
+
+namespace android {
+
+// ---------------------------------------------------------------------------
+
+namespace {
+
+struct Key {
+    TransactionStats::Direction direction;
+    // Calling uid for CALLER transactions; unused for the others.
+    uid_t uid;
+    // Handle for outgoing transactions; unused for incoming ones.
+    int32_t handle;
+    String16 descriptor;
+    uint32_t code;
+
+    bool operator<(const Key& other) const {
+        if (direction != other.direction) return direction < other.direction;
+        if (uid != other.uid) return uid < other.uid;
+        if (handle != other.handle) return handle < other.handle;
+        if (code != other.code) return code < other.code;
+        return descriptor < other.descriptor;
+    }
+};
+
+struct Totals {
+    uint64_t buckets[TransactionStats::kNumBuckets] = {};
+    uint64_t totalNs = 0;
+    uint64_t maxUs = 0;
+
+    uint64_t count() const {
+        uint64_t count = 0;
+        for (uint64_t bucket : buckets) {
+            count += bucket;
+        }
+        return count;
+    }
+};
+
+struct Registry {
+    std::mutex lock;
+    std::vector<TransactionStatsTable*> tables;
+    // Totals of tables whose threads have exited.
+    std::map<Key, Totals> retired;
+    uint64_t retiredDropped = 0;
+};
+
+// Off unless this property is set when the process starts, or setEnabled() is
+// called.
+std::atomic<bool> gEnabled(property_get_bool("debug.binder.transaction_stats", false));
+std::atomic<bool> gCallerStatsEnabled(false);
+
+// Never destroyed: binder threads can outlive static destructors.
+Registry& registry() {
+    static Registry* sRegistry = new Registry();
+    return *sRegistry;
+}
+
+Key keyFor(const TransactionStatsTable::Entry& e) {
+    Key key;
+    key.direction = e.direction;
+    key.uid = e.direction == TransactionStats::CALLER ? e.uid : 0;
+    key.handle = e.direction == TransactionStats::OUTGOING ? static_cast<int32_t>(e.id) : 0;
+    key.descriptor = e.descriptor;
+    key.code = e.code;
+    return key;
+}
+
+void accumulate(const TransactionStatsTable::Entry& e, Totals* totals) {
+    for (size_t i = 0; i < TransactionStats::kNumBuckets; i++) {
+        totals->buckets[i] += e.buckets[i].load(std::memory_order_relaxed);
+    }
+    totals->totalNs += e.totalNs.load(std::memory_order_relaxed);
+    totals->maxUs = std::max(totals->maxUs, e.maxUs.load(std::memory_order_relaxed));
+}
+
+// Merges |table| into |out|; registry().lock must be held.
+uint64_t collectLocked(const TransactionStatsTable& table, std::map<Key, Totals>* out) {
+    for (const auto& e : table.mEntries) {
+        if (e.used.load(std::memory_order_acquire)) {
+            accumulate(e, &(*out)[keyFor(e)]);
+        }
+    }
+    return table.mDropped.load(std::memory_order_relaxed);
+}
+
+// Sums the tables of all threads, live and exited, into |out|, and returns
+// how many transactions did not fit.
+uint64_t collectAll(std::map<Key, Totals>* out) {
+    Registry& r = registry();
+    std::lock_guard<std::mutex> _l(r.lock);
+    *out = r.retired;
+    uint64_t dropped = r.retiredDropped;
+    for (const TransactionStatsTable* table : r.tables) {
+        dropped += collectLocked(*table, out);
+    }
+    return dropped;
+}
+
+// Zeroes the entries for which |matches| returns true. Racy against the
+// owning threads, which may lose an increment or two.
+template <typename Predicate>
+void resetEntries(Predicate matches) {
+    Registry& r = registry();
+    std::lock_guard<std::mutex> _l(r.lock);
+    for (auto it = r.retired.begin(); it != r.retired.end();) {
+        it = matches(it->first.direction) ? r.retired.erase(it) : std::next(it);
+    }
+    for (TransactionStatsTable* table : r.tables) {
+        for (auto& e : table->mEntries) {
+            if (!e.used.load(std::memory_order_acquire) || !matches(e.direction)) {
+                continue;
+            }
+            for (auto& b : e.buckets) {
+                b.store(0, std::memory_order_relaxed);
+            }
+            e.totalNs.store(0, std::memory_order_relaxed);
+            e.maxUs.store(0, std::memory_order_relaxed);
+        }
+    }
+}
+
+size_t bucketFor(uint64_t us) {
+    if (us < 2) {
+        return 0;
+    }
+    const size_t bucket = 63 - __builtin_clzll(us);
+    return std::min(bucket, TransactionStats::kNumBuckets - 1);
+}
+
+// Upper bound, in microseconds, of the bucket holding the |percent|th
+// percentile.
+uint64_t percentileUs(const Totals& totals, uint64_t count, uint32_t percent) {
+    const uint64_t target = (count * percent + 99) / 100;
+    uint64_t seen = 0;
+    for (size_t i = 0; i < TransactionStats::kNumBuckets; i++) {
+        seen += totals.buckets[i];
+        if (seen >= target) {
+            return 2ull << i;
+        }
+    }
+    return 2ull << (TransactionStats::kNumBuckets - 1);
+}
+
+void relaxedIncrement(std::atomic<uint64_t>& counter, uint64_t delta) {
+    // Only the owning thread writes, so a plain load/store pair is enough.
+    counter.store(counter.load(std::memory_order_relaxed) + delta, std::memory_order_relaxed);
+}
+
+} // namespace
+
+// ---------------------------------------------------------------------------
+
+TransactionStatsTable::TransactionStatsTable()
+    : mDropped(0)
+{
+    for (auto& e : mEntries) {
+        e.used.store(false, std::memory_order_relaxed);
+        for (auto& b : e.buckets) {
+            b.store(0, std::memory_order_relaxed);
+        }
+        e.totalNs.store(0, std::memory_order_relaxed);
+        e.maxUs.store(0, std::memory_order_relaxed);
+    }
+    Registry& r = registry();
+    std::lock_guard<std::mutex> _l(r.lock);
+    r.tables.push_back(this);
+}
+
+TransactionStatsTable::~TransactionStatsTable()
+{
+    Registry& r = registry();
+    std::lock_guard<std::mutex> _l(r.lock);
+    r.retiredDropped += collectLocked(*this, &r.retired);
+    r.tables.erase(std::remove(r.tables.begin(), r.tables.end(), this), r.tables.end());
+}
+
+void TransactionStatsTable::record(TransactionStats::Direction direction, uintptr_t id,
+                                   uid_t uid, uint32_t code, const String16* descriptor,
+                                   nsecs_t latency)
+{
+    const uint64_t ns = latency > 0 ? static_cast<uint64_t>(latency) : 0;
+    const uint64_t us = ns / 1000;
+
+    uint64_t hash = (static_cast<uint64_t>(id) ^ (static_cast<uint64_t>(code) << 32) ^
+                     (static_cast<uint64_t>(uid) << 2) ^ direction) * 0x9E3779B97F4A7C15ull;
+    for (size_t probe = 0; probe < kNumEntries; probe++) {
+        Entry& e = mEntries[(hash >> 58) % kNumEntries];
+        if (!e.used.load(std::memory_order_relaxed)) {
+            e.direction = direction;
+            e.id = id;
+            e.uid = uid;
+            e.code = code;
+            if (descriptor != nullptr) {
+                e.descriptor = *descriptor;
+            }
+            e.used.store(true, std::memory_order_release);
+        } else if (e.direction != direction || e.id != id || e.uid != uid || e.code != code) {
+            hash += 1ull << 58;
+            continue;
+        }
+        relaxedIncrement(e.buckets[bucketFor(us)], 1);
+        relaxedIncrement(e.totalNs, ns);
+        if (us > e.maxUs.load(std::memory_order_relaxed)) {
+            e.maxUs.store(us, std::memory_order_relaxed);
+        }
+        return;
+    }
+    relaxedIncrement(mDropped, 1);
+}
+
+// ---------------------------------------------------------------------------
+
+void TransactionStats::setEnabled(bool enabled)
+{
+    gEnabled.store(enabled, std::memory_order_relaxed);
+}
+
+bool TransactionStats::isEnabled()
+{
+    return gEnabled.load(std::memory_order_relaxed);
+}
+
+void TransactionStats::recordOutgoing(int32_t handle, uint32_t code, nsecs_t latency)
+{
+    IPCThreadState* state = IPCThreadState::selfOrNull();
+    if (state != nullptr && state->mTransactionStats != nullptr) {
+        state->mTransactionStats->record(OUTGOING, static_cast<uint32_t>(handle), 0, code,
+                                         nullptr, latency);
+    }
+}
+
+void TransactionStats::recordIncoming(const String16& descriptor, uint32_t code,
+                                      nsecs_t latency)
+{
+    IPCThreadState* state = IPCThreadState::selfOrNull();
+    if (state != nullptr && state->mTransactionStats != nullptr) {
+        // Descriptors are normally static members of the interface, so the
+        // address identifies the interface without comparing strings.
+        state->mTransactionStats->record(INCOMING, reinterpret_cast<uintptr_t>(&descriptor), 0,
+                                         code, &descriptor, latency);
+    }
+}
+
+void TransactionStats::dump(String8& result)
+{
+    std::map<Key, Totals> totals;
+    const uint64_t dropped = collectAll(&totals);
+
+    result.appendFormat("Binder transaction latency (%s):\n",
+                        isEnabled() ? "enabled" : "disabled");
+    for (const auto& [key, t] : totals) {
+        const uint64_t count = t.count();
+        if (count == 0 || key.direction == CALLER) {
+            continue;
+        }
+        if (key.direction == OUTGOING) {
+            result.appendFormat("  out handle=%d", key.handle);
+        } else {
+            result.appendFormat("  in %s",
+                                key.descriptor.size() > 0 ? String8(key.descriptor).string()
+                                                          : "<no descriptor>");
+        }
+        result.appendFormat(" code=%u: count=%" PRIu64 " mean=%" PRIu64 "us max=%" PRIu64
+                            "us p50<%" PRIu64 "us p90<%" PRIu64 "us p99<%" PRIu64 "us\n",
+                            key.code, count, t.totalNs / 1000 / count, t.maxUs,
+                            percentileUs(t, count, 50), percentileUs(t, count, 90),
+                            percentileUs(t, count, 99));
+    }
+    if (dropped > 0) {
+        result.appendFormat("  %" PRIu64 " transactions not recorded (table full)\n", dropped);
+    }
+}
+
+void TransactionStats::reset()
+{
+    resetEntries([](Direction) { return true; });
+    Registry& r = registry();
+    std::lock_guard<std::mutex> _l(r.lock);
+    r.retiredDropped = 0;
+    for (TransactionStatsTable* table : r.tables) {
+        table->mDropped.store(0, std::memory_order_relaxed);
+    }
+}
+
+void TransactionStats::setCallerStatsEnabled(bool enabled)
+{
+    gCallerStatsEnabled.store(enabled, std::memory_order_relaxed);
+}
+
+bool TransactionStats::isCallerStatsEnabled()
+{
+    return gCallerStatsEnabled.load(std::memory_order_relaxed);
+}
+
+void TransactionStats::recordCaller(uid_t uid, const String16& descriptor, uint32_t code,
+                                    nsecs_t cpuTime)
+{
+    IPCThreadState* state = IPCThreadState::selfOrNull();
+    if (state != nullptr && state->mTransactionStats != nullptr) {
+        state->mTransactionStats->record(CALLER, reinterpret_cast<uintptr_t>(&descriptor), uid,
+                                         code, &descriptor, cpuTime);
+    }
+}
+
+void TransactionStats::dumpCallers(String8& result)
+{
+    std::map<Key, Totals> totals;
+    const uint64_t dropped = collectAll(&totals);
+
+    result.appendFormat("Binder calls by calling uid (%s):\n",
+                        isCallerStatsEnabled() ? "enabled" : "disabled");
+    for (const auto& [key, t] : totals) {
+        const uint64_t count = t.count();
+        if (count == 0 || key.direction != CALLER) {
+            continue;
+        }
+        result.appendFormat("  uid=%d %s code=%u: count=%" PRIu64 " cpu=%.3fms mean=%" PRIu64
+                            "us max=%" PRIu64 "us\n",
+                            key.uid,
+                            key.descriptor.size() > 0 ? String8(key.descriptor).string()
+                                                      : "<no descriptor>",
+                            key.code, count, t.totalNs / 1e6, t.totalNs / 1000 / count, t.maxUs);
+    }
+    if (dropped > 0) {
+        result.appendFormat("  %" PRIu64 " transactions not recorded (table full)\n", dropped);
+    }
+}
+
+void TransactionStats::resetCallers()
+{
+    resetEntries([](Direction direction) { return direction == CALLER; });
+}
+
+// ---------------------------------------------------------------------------
+
+}; // namespace android
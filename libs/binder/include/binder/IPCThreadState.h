@@ -30,9 +30,14 @@ typedef  int  uid_t;
 namespace android {
 
 class IPCThreadStateBase;
+class ParcelBufferPool;
+class TransactionStatsTable;
 
 class IPCThreadState
 {
+    friend class ParcelBufferPool;
+    friend class PoolThread;
+    friend class TransactionStats;
 public:
     static  IPCThreadState*     self();
     static  IPCThreadState*     selfOrNull();  // self(), but won't instantiate
@@ -85,6 +90,32 @@ public:
                                          uint32_t code, const Parcel& data,
                                          Parcel* reply, uint32_t flags);
 
+            // While a batch is open, oneway transactions made on this thread
+            // are queued instead of being sent to the driver one at a time,
+            // and are submitted together when the outermost batch ends.
+            // Batches nest. Any non-oneway call made while a batch is open
+            // first flushes the queued transactions. Returns the last error
+            // reported for the batched transactions, if any.
+            void                beginOnewayBatch();
+            status_t            endOnewayBatch();
+
+            // Opens a oneway batch for the lifetime of the object.
+            class OnewayBatch {
+            public:
+                OnewayBatch() : mState(IPCThreadState::self()) {
+                    mState->beginOnewayBatch();
+                }
+                ~OnewayBatch() {
+                    mState->endOnewayBatch();
+                }
+
+            private:
+                OnewayBatch(const OnewayBatch&) = delete;
+                OnewayBatch& operator=(const OnewayBatch&) = delete;
+
+                IPCThreadState* const mState;
+            };
+
             void                incStrongHandle(int32_t handle, BpBinder *proxy);
             void                decStrongHandle(int32_t handle);
             void                incWeakHandle(int32_t handle, BpBinder *proxy);
@@ -98,6 +129,11 @@ public:
 
     static  void                shutdown();
 
+            // Process-wide hit/miss counts of the per-thread pools that
+            // recycle Parcel data buffers.
+    static  uint64_t            getParcelBufferPoolHits();
+    static  uint64_t            getParcelBufferPoolMisses();
+
     // Call this to disable switching threads to background scheduling when
     // receiving incoming IPC calls.  This is specifically here for the
     // Android system process, since it expects to have background apps calling
@@ -158,6 +194,14 @@ private:
                                                      uint32_t code,
                                                      const Parcel& data,
                                                      status_t* statusBuffer);
+            status_t            queueOnewayTransaction(int32_t handle,
+                                                       uint32_t code,
+                                                       const Parcel& data,
+                                                       uint32_t flags);
+            void                releaseOnewayBatchParcels();
+            status_t            flushOnewayBatch();
+            void                joinThreadPoolInternal(bool isMain, bool requested);
+            bool                waitForWork(int64_t timeoutMs);
             status_t            getAndExecuteCommand();
             status_t            executeCommand(int32_t command);
             void                processPendingDerefs();
@@ -190,6 +234,15 @@ private:
             int32_t             mStrictModePolicy;
             int32_t             mLastTransactionBinderFlags;
             IPCThreadStateBase  *mIPCThreadStateBase;
+            ParcelBufferPool    *mBufferPool;
+            TransactionStatsTable *mTransactionStats;
+            // Nesting depth of beginOnewayBatch(), and the number of queued
+            // oneway transactions whose completion hasn't been read yet.
+            int32_t             mOnewayBatchDepth;
+            size_t              mPendingOnewayTransactions;
+            // Copies of the queued oneway payloads, which the batched
+            // BC_TRANSACTIONs in mOut point at until they are written out.
+            Vector<Parcel*>     mOnewayBatchParcels;
 
             ProcessState::CallRestriction mCallRestriction;
 };
@@ -55,6 +55,12 @@ public:
 
     /**
      * Retrieve an existing service, non-blocking.
+     *
+     * Remote services are cached per process and evicted when they die, so
+     * repeated lookups of a live service do not go back to servicemanager.
+     * The cache only answers while the caller's process still holds the
+     * service, and for at most a second after the last round trip, so a name
+     * re-registered by another process is picked up within that second.
      */
     virtual sp<IBinder>         checkService( const String16& name) const = 0;
 
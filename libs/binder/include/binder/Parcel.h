@@ -233,6 +233,12 @@ public:
     // The caller should call release() on the blob after writing its contents.
     status_t            writeBlob(size_t len, bool mutableCopy, WritableBlob* outBlob);
 
+    // Like writeBlob(), but always backs the blob with an immutable ashmem
+    // region regardless of size, so the caller writes its payload directly into
+    // memory that the receiver maps read-only.  Fails with FDS_NOT_ALLOWED if
+    // the parcel does not accept file descriptors.
+    status_t            writeSharedBlob(size_t len, WritableBlob* outBlob);
+
     // Write an existing immutable blob file descriptor to the parcel.
     // This allows the client to send the same blob to multiple processes
     // as long as it keeps a dup of the blob file descriptor handy for later.
@@ -424,9 +430,11 @@ private:
     Parcel&             operator=(const Parcel& o);
     
     status_t            finishWrite(size_t len);
+    status_t            writeAshmemBlob(size_t len, bool mutableCopy, WritableBlob* outBlob);
     void                releaseObjects();
     void                acquireObjects();
     status_t            growData(size_t len);
+    uint8_t*            reallocData(size_t desired, size_t* outCapacity);
     status_t            restartWrite(size_t desired);
     status_t            continueWrite(size_t desired);
     status_t            writePointer(uintptr_t val);
@@ -491,6 +499,7 @@ private:
     mutable bool        mFdsKnown;
     mutable bool        mHasFds;
     bool                mAllowFds;
+    bool                mDataMapped;
 
     release_func        mOwner;
     void*               mOwnerCookie;
@@ -24,6 +24,7 @@
 
 #include <utils/String16.h>
 #include <utils/Singleton.h>
+#include <utils/Timers.h>
 #include <utils/SortedVector.h>
 
 namespace android {
@@ -32,37 +33,55 @@ namespace android {
 /*
  * PermissionCache caches permission checks for a given uid.
  *
- * Currently the cache is not updated when there is a permission change,
- * for instance when an application is uninstalled.
+ * Results, granted or denied, are only kept for a while, denied ones for less
+ * time, so that permission changes eventually apply. Services which learn that
+ * the permissions of a uid may have changed, for instance because its package
+ * was updated or uninstalled, invalidate its results right away.
  *
- * IMPORTANT: for the reason stated above, only system permissions are safe
- * to cache. This restriction may be lifted at a later time.
+ * The cache is split into shards by uid, each with its own lock, so checks
+ * for different callers don't contend.
  *
  */
 
 class PermissionCache : Singleton<PermissionCache> {
+    friend class PermissionCacheTest;
+
     struct Entry {
         String16    name;
         uid_t       uid;
         bool        granted;
+        nsecs_t     expireTime;
         inline bool operator < (const Entry& e) const {
             return (uid == e.uid) ? (name < e.name) : (uid < e.uid);
         }
     };
-    mutable Mutex mLock;
-    // we pool all the permission names we see, as many permissions checks
-    // will have identical names
-    SortedVector< String16 > mPermissionNamesPool;
-    // this is our cache per say. it stores pooled names.
-    SortedVector< Entry > mCache;
-
-    // free the whole cache, but keep the permission name pool
+    struct Shard {
+        mutable Mutex mLock;
+        // this is our cache per say.
+        SortedVector< Entry > mCache;
+    };
+    enum { SHARD_COUNT = 16 };
+    Shard mShards[SHARD_COUNT];
+
+    // How long results are kept for
+    static constexpr nsecs_t GRANTED_TTL = 60 * 1000000000LL;
+    static constexpr nsecs_t DENIED_TTL = 5 * 1000000000LL;
+
+    Shard& shardFor(uid_t uid) { return mShards[uid % SHARD_COUNT]; }
+    const Shard& shardFor(uid_t uid) const { return mShards[uid % SHARD_COUNT]; }
+
+    // free the whole cache
     void purge();
 
+    // free the results of one uid
+    void purge(uid_t uid);
+
+    // now is the time the result is looked up or cached at
     status_t check(bool* granted,
-            const String16& permission, uid_t uid) const;
+            const String16& permission, uid_t uid, nsecs_t now = systemTime()) const;
 
-    void cache(const String16& permission, uid_t uid, bool granted);
+    void cache(const String16& permission, uid_t uid, bool granted,
+            nsecs_t now = systemTime());
 
 public:
     PermissionCache();
@@ -74,6 +93,12 @@ public:
 
     static bool checkPermission(const String16& permission,
             pid_t pid, uid_t uid);
+
+    // Drops the cached results of a uid, whose permissions may have changed.
+    static void invalidate(uid_t uid);
+
+    // Drops every cached result.
+    static void invalidateAll();
 };
 
 // ---------------------------------------------------------------------------
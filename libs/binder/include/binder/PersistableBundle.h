@@ -18,6 +18,7 @@
 #define ANDROID_PERSISTABLE_BUNDLE_H
 
 #include <map>
+#include <memory>
 #include <set>
 #include <vector>
 
@@ -38,6 +39,15 @@ public:
     PersistableBundle() = default;
     virtual ~PersistableBundle() = default;
     PersistableBundle(const PersistableBundle& bundle) = default;
+    PersistableBundle(PersistableBundle&& bundle) = default;
+    PersistableBundle& operator=(const PersistableBundle& bundle) = default;
+    PersistableBundle& operator=(PersistableBundle&& bundle) = default;
+
+    /*
+     * A bundle read from a parcel keeps its entries encoded, only checking
+     * and indexing them, and shares them with its copies. Getters decode just
+     * the value they are asked for, and the first change decodes all of them.
+     */
 
     status_t writeToParcel(Parcel* parcel) const override;
     status_t readFromParcel(const Parcel* parcel) override;
@@ -63,6 +73,15 @@ public:
     void putStringVector(const String16& key, const std::vector<String16>& value);
     void putPersistableBundle(const String16& key, const PersistableBundle& value);
 
+    /* Setters taking ownership of |value| instead of copying it. */
+    void putString(const String16& key, String16&& value);
+    void putBooleanVector(const String16& key, std::vector<bool>&& value);
+    void putIntVector(const String16& key, std::vector<int32_t>&& value);
+    void putLongVector(const String16& key, std::vector<int64_t>&& value);
+    void putDoubleVector(const String16& key, std::vector<double>&& value);
+    void putStringVector(const String16& key, std::vector<String16>&& value);
+    void putPersistableBundle(const String16& key, PersistableBundle&& value);
+
     /*
      * Getters for PersistableBundle. If |key| exists, these methods write the
      * value associated with |key| into |out|, and return true. Otherwise, these
@@ -94,14 +113,7 @@ public:
     std::set<String16> getPersistableBundleKeys() const;
 
     friend bool operator==(const PersistableBundle& lhs, const PersistableBundle& rhs) {
-        return (lhs.mBoolMap == rhs.mBoolMap && lhs.mIntMap == rhs.mIntMap &&
-                lhs.mLongMap == rhs.mLongMap && lhs.mDoubleMap == rhs.mDoubleMap &&
-                lhs.mStringMap == rhs.mStringMap && lhs.mBoolVectorMap == rhs.mBoolVectorMap &&
-                lhs.mIntVectorMap == rhs.mIntVectorMap &&
-                lhs.mLongVectorMap == rhs.mLongVectorMap &&
-                lhs.mDoubleVectorMap == rhs.mDoubleVectorMap &&
-                lhs.mStringVectorMap == rhs.mStringVectorMap &&
-                lhs.mPersistableBundleMap == rhs.mPersistableBundleMap);
+        return lhs.equals(rhs);
     }
 
     friend bool operator!=(const PersistableBundle& lhs, const PersistableBundle& rhs) {
@@ -109,8 +121,26 @@ public:
     }
 
 private:
+    struct ParcelledData;
+
     status_t writeToParcelInner(Parcel* parcel) const;
     status_t readFromParcelInner(const Parcel* parcel, size_t length);
+    status_t readEntries(const Parcel* parcel);
+
+    // Decodes the entries still held by mParcelledData into the maps.
+    void unparcel();
+    // Positions the parcelled data at the value of |key| if it has type |type|.
+    // Must be called with mParcelledData->lock held.
+    bool findParcelled(const String16& key, int32_t type) const;
+    template <typename T>
+    bool getParcelled(const String16& key, int32_t type, T* out,
+                      status_t (Parcel::*read)(T*) const) const;
+    std::set<String16> getParcelledKeys(int32_t type) const;
+    bool equals(const PersistableBundle& other) const;
+
+    // Entries read from a parcel and not decoded yet, if any. The maps are
+    // empty while it is set.
+    std::shared_ptr<ParcelledData> mParcelledData;
 
     std::map<String16, bool> mBoolMap;
     std::map<String16, int32_t> mIntMap;
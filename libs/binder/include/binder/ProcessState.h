@@ -71,6 +71,15 @@ public:
             void                spawnPooledThread(bool isMain);
             
             status_t            setThreadPoolMaxThreadCount(size_t maxThreads);
+
+            // Switches the thread pool to adaptive sizing. The driver still
+            // spawns threads on demand (BR_SPAWN_LOOPER) up to |maxThreads|,
+            // but spawned threads that sit idle for |idleTimeoutMs| exit again,
+            // returning their stacks, as long as at least |minThreads| remain
+            // and no new thread was requested within the same period. At most
+            // one thread exits per |idleTimeoutMs|.
+            status_t            setThreadPoolAdaptive(size_t minThreads, size_t maxThreads,
+                                                      int64_t idleTimeoutMs);
             void                giveThreadPoolName();
 
             String8             getDriverName();
@@ -98,13 +107,35 @@ private:
                                 ProcessState(const ProcessState& o);
             ProcessState&       operator=(const ProcessState& o);
             String8             makeBinderThreadName();
+            // Spawns a thread the driver asked for with BR_SPAWN_LOOPER. Only
+            // these count against the driver's limit, and only these are
+            // reaped from an adaptive pool.
+            void                spawnRequestedThread();
+            void                spawnPooledThreadInternal(bool isMain, bool requested);
+            int64_t             getIdleTimeoutMs();
+            // Lets the calling idle thread leave an adaptive pool if it's time
+            // to shrink it. If not, |outKeepWaiting| says whether the thread
+            // should try again after waiting for another idle timeout.
+            bool                tryReapIdleThread(bool* outKeepWaiting);
+            void                onSpawnedThreadExit();
 
             struct handle_entry {
                 IBinder* binder;
                 RefBase::weakref_type* refs;
             };
 
-            handle_entry*       lookupHandleLocked(int32_t handle);
+            // Handles are spread over independently locked shards, so that
+            // threads resolving different handles don't serialize on one lock.
+            static constexpr size_t kHandleShardCount = 16;
+
+            struct alignas(64) handle_shard {
+                Mutex lock;
+                // Indexed by handle / kHandleShardCount.
+                Vector<handle_entry> entries;
+            };
+
+            handle_shard&       shardForHandle(int32_t handle);
+            handle_entry*       lookupHandleLocked(handle_shard& shard, int32_t handle);
 
             String8             mDriverName;
             int                 mDriverFD;
@@ -119,11 +150,23 @@ private:
             size_t              mMaxThreads;
             // Time when thread pool was emptied
             int64_t             mStarvationStartTimeMs;
+            // Number of threads spawned at the driver's request that are still
+            // in the thread pool.
+            size_t              mSpawnedThreadsCount;
+            // Adaptive thread pool state; mIdleTimeoutMs is 0 when disabled.
+            size_t              mMinThreads;
+            int64_t             mIdleTimeoutMs;
+            int64_t             mLastSpawnTimeMs;
+            int64_t             mLastReapTimeMs;
+            // Threads that exited the pool after being idle. The driver never
+            // forgets a thread it has spawned, so its limit is raised by this
+            // many to let it replace them.
+            size_t              mReapedThreadsCount;
+
+            handle_shard        mHandleShards[kHandleShardCount];
 
     mutable Mutex               mLock;  // protects everything below.
 
-            Vector<handle_entry>mHandleToObject;
-
             bool                mManagesContexts;
             context_check_func  mBinderContextCheckFunc;
             void*               mBinderContextUserData;
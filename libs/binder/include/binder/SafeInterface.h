@@ -29,6 +29,7 @@
 #include <utils/NativeHandle.h>
 
 #include <functional>
+#include <limits>
 #include <type_traits>
 
 namespace android {
@@ -81,6 +82,40 @@ public:
         return callParcel("write(sp<Flattenable>)", [&]() { return parcel->write(*(t.get())); });
     }
     template <typename T>
+    typename std::enable_if<std::is_base_of<Flattenable<T>, T>::value, status_t>::type read(
+            const Parcel& parcel, std::vector<T>* v) const {
+        int32_t size = 0;
+        status_t error = callParcel("readInt32(vector<Flattenable> size)",
+                                    [&]() { return parcel.readInt32(&size); });
+        if (error != NO_ERROR) return error;
+        if (size < 0 || static_cast<size_t>(size) > parcel.dataAvail()) {
+            ALOG(LOG_ERROR, mLogTag, "read(vector<Flattenable>): bad size %d", size);
+            return BAD_VALUE;
+        }
+        v->resize(static_cast<size_t>(size));
+        for (T& t : *v) {
+            error = read(parcel, &t);
+            if (error != NO_ERROR) return error;
+        }
+        return NO_ERROR;
+    }
+    template <typename T>
+    typename std::enable_if<std::is_base_of<Flattenable<T>, T>::value, status_t>::type write(
+            Parcel* parcel, const std::vector<T>& v) const {
+        if (v.size() > static_cast<size_t>(std::numeric_limits<int32_t>::max())) {
+            return BAD_VALUE;
+        }
+        status_t error = callParcel("writeInt32(vector<Flattenable> size)", [&]() {
+            return parcel->writeInt32(static_cast<int32_t>(v.size()));
+        });
+        if (error != NO_ERROR) return error;
+        for (const T& t : v) {
+            error = write(parcel, t);
+            if (error != NO_ERROR) return error;
+        }
+        return NO_ERROR;
+    }
+    template <typename T>
     typename std::enable_if<std::is_base_of<LightFlattenable<T>, T>::value, status_t>::type read(
             const Parcel& parcel, T* t) const {
         return callParcel("read(LightFlattenable)", [&]() { return parcel.read(*t); });
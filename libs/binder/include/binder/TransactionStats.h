@@ -0,0 +1,83 @@
+/*
+ * Copyright (C) 2019 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef ANDROID_BINDER_TRANSACTION_STATS_H
+#define ANDROID_BINDER_TRANSACTION_STATS_H
+
+#include <stdint.h>
+#include <sys/types.h>
+
+#include <utils/String8.h>
+#include <utils/String16.h>
+#include <utils/Timers.h>
+
+namespace android {
+
+// ---------------------------------------------------------------------------
+
+/*
+ * Per-process latency histograms of binder transactions, keyed by target and
+ * transaction code.
+ *
+ * Outgoing transactions are recorded by IPCThreadState::transact() per
+ * handle; incoming ones by BBinder::transact() per interface descriptor.
+ * Each thread records into its own table without taking any lock; dump() sums
+ * the tables of all threads. Recording is off by default. It is turned on for
+ * a process by setting debug.binder.transaction_stats before it starts, or
+ * with setEnabled().
+ *
+ * Latencies are bucketed by powers of two of microseconds: bucket 0 counts
+ * calls under 2us, bucket i counts calls in [2^i, 2^(i+1)) us.
+ *
+ * Optionally, and off by default, BBinder::transact() also attributes the
+ * thread CPU time of every incoming transaction to its calling uid, per
+ * interface descriptor and code, in the same tables. dumpCallers() prints
+ * those, to find which clients keep a service busy.
+ */
+class TransactionStats {
+public:
+    static constexpr size_t kNumBuckets = 24;
+
+    enum Direction : uint8_t {
+        OUTGOING = 0,
+        INCOMING = 1,
+        // Incoming, by calling uid. Their histograms hold thread CPU time.
+        CALLER = 2,
+    };
+
+    static  void    setEnabled(bool enabled);
+    static  bool    isEnabled();
+
+    static  void    recordOutgoing(int32_t handle, uint32_t code, nsecs_t latency);
+    static  void    recordIncoming(const String16& descriptor, uint32_t code, nsecs_t latency);
+
+    static  void    dump(String8& result);
+    static  void    reset();
+
+    static  void    setCallerStatsEnabled(bool enabled);
+    static  bool    isCallerStatsEnabled();
+
+    static  void    recordCaller(uid_t uid, const String16& descriptor, uint32_t code,
+                                 nsecs_t cpuTime);
+
+    static  void    dumpCallers(String8& result);
+    static  void    resetCallers();
+};
+
+// ---------------------------------------------------------------------------
+}; // namespace android
+
+#endif // ANDROID_BINDER_TRANSACTION_STATS_H
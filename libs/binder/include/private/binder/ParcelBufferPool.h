@@ -0,0 +1,71 @@
+/*
+ * Copyright (C) 2019 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef ANDROID_PARCEL_BUFFER_POOL_H
+#define ANDROID_PARCEL_BUFFER_POOL_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+namespace android {
+
+// A per-thread cache of Parcel data buffers, bucketed into power-of-two size
+// classes. Each IPCThreadState owns one, so the Parcels a thread creates and
+// destroys for every transaction recycle the same few heap blocks instead of
+// going through malloc/free on each call.
+//
+// Blocks are plain heap allocations, so a buffer acquired on one thread may
+// be released on another; it simply ends up cached by the releasing thread.
+class ParcelBufferPool {
+public:
+    static constexpr size_t kMinClassSize = 256;
+    static constexpr size_t kNumClasses = 8;  // 256 bytes .. 32KB
+    static constexpr size_t kMaxClassSize = kMinClassSize << (kNumClasses - 1);
+    // High-water mark of cached blocks per size class.
+    static constexpr size_t kMaxBlocksPerClass = 4;
+
+    ParcelBufferPool();
+    ~ParcelBufferPool();
+
+    // Allocates at least |size| bytes, from the calling thread's pool when
+    // there is one. The usable size of the block is returned in
+    // |outCapacity| and must be passed back to deallocate().
+    static void* allocate(size_t size, size_t* outCapacity);
+    static void deallocate(void* data, size_t capacity);
+
+    // Frees all cached blocks.
+    void trim();
+
+    // Process-wide counters, summed over all threads.
+    static uint64_t getGlobalHitCount();
+    static uint64_t getGlobalMissCount();
+
+private:
+    ParcelBufferPool(const ParcelBufferPool&) = delete;
+    ParcelBufferPool& operator=(const ParcelBufferPool&) = delete;
+
+    static ParcelBufferPool* current();
+
+    void* acquire(size_t size, size_t* outCapacity);
+    void release(void* data, size_t capacity);
+
+    void* mBlocks[kNumClasses][kMaxBlocksPerClass];
+    size_t mCounts[kNumClasses];
+};
+
+}; // namespace android
+
+#endif // ANDROID_PARCEL_BUFFER_POOL_H
@@ -0,0 +1,65 @@
+/*
+ * Copyright (C) 2019 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef ANDROID_TRANSACTION_STATS_TABLE_H
+#define ANDROID_TRANSACTION_STATS_TABLE_H
+
+#include <atomic>
+
+#include <binder/TransactionStats.h>
+
+namespace android {
+
+// The per-thread half of TransactionStats, owned by IPCThreadState. Only the
+// owning thread writes to a table; dumping threads read it concurrently, so
+// every field that changes after publication is atomic.
+class TransactionStatsTable {
+public:
+    static constexpr size_t kNumEntries = 64;
+
+    struct Entry {
+        // Set once the key fields below are valid.
+        std::atomic<bool> used;
+        TransactionStats::Direction direction;
+        uintptr_t id;
+        // Calling uid, for CALLER entries.
+        uid_t uid;
+        uint32_t code;
+        // Copy of the interface descriptor, for incoming transactions.
+        String16 descriptor;
+        std::atomic<uint64_t> buckets[TransactionStats::kNumBuckets];
+        std::atomic<uint64_t> totalNs;
+        std::atomic<uint64_t> maxUs;
+    };
+
+    TransactionStatsTable();
+    ~TransactionStatsTable();
+
+    void record(TransactionStats::Direction direction, uintptr_t id, uid_t uid, uint32_t code,
+                const String16* descriptor, nsecs_t latency);
+
+    Entry mEntries[kNumEntries];
+    // Transactions that did not fit in the table.
+    std::atomic<uint64_t> mDropped;
+
+private:
+    TransactionStatsTable(const TransactionStatsTable&) = delete;
+    TransactionStatsTable& operator=(const TransactionStatsTable&) = delete;
+};
+
+}; // namespace android
+
+#endif // ANDROID_TRANSACTION_STATS_TABLE_H
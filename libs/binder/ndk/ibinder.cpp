@@ -71,20 +71,21 @@ bool AIBinder::associateClass(const AIBinder_Class* clazz) {
     if (clazz == nullptr) return false;
     if (mClazz == clazz) return true;
 
-    String8 newDescriptor(clazz->getInterfaceDescriptor());
+    // Descriptors are compared as they are, and only converted for logging.
+    const String16& newDescriptor = clazz->getInterfaceDescriptor();
 
     if (mClazz != nullptr) {
-        String8 currentDescriptor(mClazz->getInterfaceDescriptor());
+        const String16& currentDescriptor = mClazz->getInterfaceDescriptor();
         if (newDescriptor == currentDescriptor) {
-            LOG(ERROR) << __func__ << ": Class descriptors '" << currentDescriptor
+            LOG(ERROR) << __func__ << ": Class descriptors '" << String8(currentDescriptor)
                        << "' match during associateClass, but they are different class objects. "
                           "Class descriptor collision?";
         } else {
             LOG(ERROR) << __func__
                        << ": Class cannot be associated on object which already has a class. "
                           "Trying to associate to '"
-                       << newDescriptor.c_str() << "' but already set to '"
-                       << currentDescriptor.c_str() << "'.";
+                       << String8(newDescriptor).c_str() << "' but already set to '"
+                       << String8(currentDescriptor).c_str() << "'.";
         }
 
         // always a failure because we know mClazz != clazz
@@ -93,10 +94,11 @@ bool AIBinder::associateClass(const AIBinder_Class* clazz) {
 
     CHECK(asABpBinder() != nullptr);  // ABBinder always has a descriptor
 
-    String8 descriptor(getBinder()->getInterfaceDescriptor());
+    const String16& descriptor = getBinder()->getInterfaceDescriptor();
     if (descriptor != newDescriptor) {
-        LOG(ERROR) << __func__ << ": Expecting binder to have class '" << newDescriptor.c_str()
-                   << "' but descriptor is actually '" << descriptor.c_str() << "'.";
+        LOG(ERROR) << __func__ << ": Expecting binder to have class '"
+                   << String8(newDescriptor).c_str() << "' but descriptor is actually '"
+                   << String8(descriptor).c_str() << "'.";
         return false;
     }
 
@@ -508,12 +510,12 @@ binder_status_t AIBinder_prepareTransaction(AIBinder* binder, AParcel** in) {
                         "calling the corresponding functionality in the same process.";
     }
 
-    *in = new AParcel(binder);
+    *in = AParcel::create(binder);
     status_t status = (*in)->get()->writeInterfaceToken(clazz->getInterfaceDescriptor());
     binder_status_t ret = PruneStatusT(status);
 
     if (ret != STATUS_OK) {
-        delete *in;
+        AParcel::destroy(*in);
         *in = nullptr;
     }
 
@@ -521,7 +523,7 @@ binder_status_t AIBinder_prepareTransaction(AIBinder* binder, AParcel** in) {
 }
 
 static void DestroyParcel(AParcel** parcel) {
-    delete *parcel;
+    AParcel::destroy(*parcel);
     *parcel = nullptr;
 }
 
@@ -558,13 +560,13 @@ binder_status_t AIBinder_transact(AIBinder* binder, transaction_code_t code, APa
         return STATUS_BAD_VALUE;
     }
 
-    *out = new AParcel(binder);
+    *out = AParcel::create(binder);
 
     status_t status = binder->getBinder()->transact(code, *(*in)->get(), (*out)->get(), flags);
     binder_status_t ret = PruneStatusT(status);
 
     if (ret != STATUS_OK) {
-        delete *out;
+        AParcel::destroy(*out);
         *out = nullptr;
     }
 
@@ -1015,6 +1015,81 @@ binder_status_t AParcel_readByteArray(const AParcel* parcel, void* arrayData,
 // @END-PRIMITIVE-READ-WRITE
 
 #endif  //__ANDROID_API__ >= __ANDROID_API_Q__
+
+#if __ANDROID_API__ >= 30
+
+/**
+ * A region of shared memory written into or read out of a parcel. Writers fill it in place and
+ * readers map it read-only, so the payload itself is never copied through the parcel.
+ */
+struct AParcel_Blob;
+typedef struct AParcel_Blob AParcel_Blob;
+
+/**
+ * Writes a shared memory blob of 'length' bytes to the next location in a non-null parcel. The
+ * caller fills the memory returned by AParcel_Blob_getMutableData and then releases the blob with
+ * AParcel_Blob_delete; the contents must be complete before the parcel is transacted.
+ *
+ * This requires the parcel to allow file descriptors.
+ *
+ * \param parcel the parcel to write to.
+ * \param length the size of the blob in bytes, must be greater than zero.
+ * \param outBlob the blob to fill. Ownership is passed to the caller of this function.
+ *
+ * \return STATUS_OK on successful write.
+ */
+binder_status_t AParcel_writeSharedBlob(AParcel* parcel, int32_t length, AParcel_Blob** outBlob)
+        __INTRODUCED_IN(30);
+
+/**
+ * Reads a blob of 'length' bytes from the next location in a non-null parcel. The data is mapped
+ * read-only and stays valid until AParcel_Blob_delete is called (or, for blobs small enough to have
+ * been written in place by the platform, until the parcel is deleted).
+ *
+ * \param parcel the parcel to read from.
+ * \param length the size of the blob in bytes, as written.
+ * \param outBlob the blob that was read. Ownership is passed to the caller of this function.
+ *
+ * \return STATUS_OK on successful read.
+ */
+binder_status_t AParcel_readSharedBlob(const AParcel* parcel, int32_t length,
+                                       AParcel_Blob** outBlob) __INTRODUCED_IN(30);
+
+/**
+ * Returns the contents of a blob.
+ *
+ * \param blob the blob to access.
+ *
+ * \return the start of the blob's data.
+ */
+const void* AParcel_Blob_getData(const AParcel_Blob* blob) __INTRODUCED_IN(30);
+
+/**
+ * Returns the writable contents of a blob obtained from AParcel_writeSharedBlob.
+ *
+ * \param blob the blob to access.
+ *
+ * \return the start of the blob's data, or nullptr if the blob was read from a parcel.
+ */
+void* AParcel_Blob_getMutableData(AParcel_Blob* blob) __INTRODUCED_IN(30);
+
+/**
+ * Returns the size of a blob.
+ *
+ * \param blob the blob to access.
+ *
+ * \return the size of the blob's data in bytes.
+ */
+int32_t AParcel_Blob_getSize(const AParcel_Blob* blob) __INTRODUCED_IN(30);
+
+/**
+ * Unmaps a blob. This does not affect the parcel it was written to or read from.
+ *
+ * \param blob the blob to delete.
+ */
+void AParcel_Blob_delete(AParcel_Blob* blob) __INTRODUCED_IN(30);
+
+#endif  //__ANDROID_API__ >= 30
 __END_DECLS
 
 /** @} */
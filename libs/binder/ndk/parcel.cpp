@@ -208,8 +208,52 @@ binder_status_t ReadArray(const AParcel* parcel, void* arrayData, ArrayAllocator
     return STATUS_OK;
 }
 
+namespace {
+
+// The parcels a thread keeps for its next transactions
+struct RecycledParcels {
+    static constexpr size_t kMaxParcels = 4;
+
+    ~RecycledParcels() {
+        for (size_t i = 0; i < count; i++) {
+            delete parcels[i];
+        }
+    }
+
+    AParcel* parcels[kMaxParcels];
+    size_t count = 0;
+};
+thread_local RecycledParcels gRecycledParcels;
+
+}  // namespace
+
+AParcel* AParcel::create(const AIBinder* binder) {
+    RecycledParcels& recycled = gRecycledParcels;
+    if (recycled.count == 0) {
+        return new AParcel(binder);
+    }
+    AParcel* parcel = recycled.parcels[--recycled.count];
+    parcel->mBinder = binder;
+    return parcel;
+}
+
+void AParcel::destroy(AParcel* parcel) {
+    if (parcel == nullptr) return;
+
+    RecycledParcels& recycled = gRecycledParcels;
+    if (!parcel->mOwns || recycled.count == RecycledParcels::kMaxParcels) {
+        delete parcel;
+        return;
+    }
+    // This releases the objects and file descriptors the parcel holds, and puts it back in the
+    // state of a new one.
+    parcel->mParcel->freeData();
+    parcel->mBinder = nullptr;
+    recycled.parcels[recycled.count++] = parcel;
+}
+
 void AParcel_delete(AParcel* parcel) {
-    delete parcel;
+    AParcel::destroy(parcel);
 }
 
 binder_status_t AParcel_setDataPosition(const AParcel* parcel, int32_t position) {
@@ -290,6 +334,47 @@ binder_status_t AParcel_readStatusHeader(const AParcel* parcel, AStatus** status
     return PruneStatusT(ret);
 }
 
+binder_status_t AParcel_writeSharedBlob(AParcel* parcel, int32_t length, AParcel_Blob** outBlob) {
+    if (length <= 0) return STATUS_BAD_VALUE;
+
+    std::unique_ptr<AParcel_Blob> blob = std::make_unique<AParcel_Blob>();
+    status_t status = parcel->get()->writeSharedBlob(length, &blob->writable);
+    if (status != STATUS_OK) return PruneStatusT(status);
+
+    blob->isWritable = true;
+    *outBlob = blob.release();
+    return STATUS_OK;
+}
+
+binder_status_t AParcel_readSharedBlob(const AParcel* parcel, int32_t length,
+                                       AParcel_Blob** outBlob) {
+    if (length <= 0) return STATUS_BAD_VALUE;
+
+    std::unique_ptr<AParcel_Blob> blob = std::make_unique<AParcel_Blob>();
+    status_t status = parcel->get()->readBlob(length, &blob->readable);
+    if (status != STATUS_OK) return PruneStatusT(status);
+
+    *outBlob = blob.release();
+    return STATUS_OK;
+}
+
+const void* AParcel_Blob_getData(const AParcel_Blob* blob) {
+    return blob->isWritable ? const_cast<AParcel_Blob*>(blob)->writable.data()
+                            : blob->readable.data();
+}
+
+void* AParcel_Blob_getMutableData(AParcel_Blob* blob) {
+    return blob->isWritable ? blob->writable.data() : nullptr;
+}
+
+int32_t AParcel_Blob_getSize(const AParcel_Blob* blob) {
+    return blob->isWritable ? blob->writable.size() : blob->readable.size();
+}
+
+void AParcel_Blob_delete(AParcel_Blob* blob) {
+    delete blob;
+}
+
 binder_status_t AParcel_writeString(AParcel* parcel, const char* string, int32_t length) {
     if (string == nullptr) {
         if (length != -1) {
@@ -42,6 +42,12 @@ struct AParcel {
         return AParcel(binder, const_cast<::android::Parcel*>(parcel), false);
     }
 
+    // Transactions take one of these for their input and output from a few that each thread
+    // recycles, with their Parcel, rather than allocating both on every call. A destroyed
+    // parcel's data is freed right away either way.
+    static AParcel* create(const AIBinder* binder);
+    static void destroy(AParcel* parcel);
+
     const AIBinder* getBinder() { return mBinder; }
 
    private:
@@ -52,3 +58,11 @@ struct AParcel {
     ::android::Parcel* mParcel;
     bool mOwns;
 };
+
+struct AParcel_Blob {
+    // Exactly one of these is in use, depending on which direction the blob came from. Both unmap
+    // on destruction.
+    ::android::Parcel::WritableBlob writable;
+    ::android::Parcel::ReadableBlob readable;
+    bool isWritable = false;
+};
@@ -0,0 +1,43 @@
+/*
+ * Copyright (C) 2019 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <benchmark/benchmark.h>
+#include <iface/iface.h>
+
+using ::android::sp;
+
+// Round trips to the service registered by libbinder_ndk_test_server.
+static void BM_DoubleNumber(benchmark::State& state) {
+    sp<IFoo> foo = IFoo::getService(IFoo::kSomeInstanceName);
+    if (foo == nullptr) {
+        state.SkipWithError("libbinder_ndk_test_server is not running");
+        return;
+    }
+
+    int32_t in = 0;
+    for (auto _ : state) {
+        int32_t out;
+        if (foo->doubleNumber(in, &out) != STATUS_OK || out != 2 * in) {
+            state.SkipWithError("doubleNumber failed");
+            break;
+        }
+        in++;
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_DoubleNumber);
+
+BENCHMARK_MAIN();
@@ -15,15 +15,20 @@
  */
 
 #include <android-base/logging.h>
+#include <android/binder_auto_utils.h>
 #include <android/binder_ibinder_jni.h>
 #include <android/binder_manager.h>
 #include <android/binder_process.h>
+#include <binder/Parcel.h>
 #include <gtest/gtest.h>
 #include <iface/iface.h>
 
+#include <algorithm>
 #include <chrono>
 #include <condition_variable>
+#include <cstring>
 #include <mutex>
+#include <string>
 
 using ::android::sp;
 
@@ -196,6 +201,121 @@ TEST(NdkBinder, AddServiceMultipleTimes) {
     EXPECT_EQ(IFoo::getService(kInstanceName1), IFoo::getService(kInstanceName2));
 }
 
+// Returns a parcel for a transaction to the test service, to write blobs into and read them back.
+static ndk::ScopedAParcel prepareFooParcel() {
+    AIBinder* binder = nullptr;
+    sp<IFoo> foo = IFoo::getService(IFoo::kSomeInstanceName, &binder);
+    if (foo == nullptr) return ndk::ScopedAParcel();
+
+    AParcel* parcel = nullptr;
+    EXPECT_EQ(STATUS_OK, AIBinder_prepareTransaction(binder, &parcel));
+    AIBinder_decStrong(binder);
+    return ndk::ScopedAParcel(parcel);
+}
+
+TEST(NdkBinder, SharedBlobRoundTrip) {
+    constexpr int32_t kBlobSize = 64 * 1024;
+
+    ndk::ScopedAParcel parcel = prepareFooParcel();
+    ASSERT_NE(nullptr, parcel.get());
+    const int32_t position = AParcel_getDataPosition(parcel.get());
+
+    AParcel_Blob* blob = nullptr;
+    ASSERT_EQ(STATUS_OK, AParcel_writeSharedBlob(parcel.get(), kBlobSize, &blob));
+    EXPECT_EQ(kBlobSize, AParcel_Blob_getSize(blob));
+    void* data = AParcel_Blob_getMutableData(blob);
+    ASSERT_NE(nullptr, data);
+    EXPECT_EQ(data, AParcel_Blob_getData(blob));
+    memset(data, 0xa5, kBlobSize);
+    AParcel_Blob_delete(blob);
+
+    ASSERT_EQ(STATUS_OK, AParcel_setDataPosition(parcel.get(), position));
+    ASSERT_EQ(STATUS_OK, AParcel_readSharedBlob(parcel.get(), kBlobSize, &blob));
+    EXPECT_EQ(kBlobSize, AParcel_Blob_getSize(blob));
+    EXPECT_EQ(nullptr, AParcel_Blob_getMutableData(blob));
+    const uint8_t* readData = static_cast<const uint8_t*>(AParcel_Blob_getData(blob));
+    ASSERT_NE(nullptr, readData);
+    EXPECT_TRUE(std::all_of(readData, readData + kBlobSize, [](uint8_t b) { return b == 0xa5; }));
+    AParcel_Blob_delete(blob);
+}
+
+TEST(NdkBinder, SharedBlobRejectsInvalidLength) {
+    ndk::ScopedAParcel parcel = prepareFooParcel();
+    ASSERT_NE(nullptr, parcel.get());
+
+    AParcel_Blob* blob = nullptr;
+    EXPECT_EQ(STATUS_BAD_VALUE, AParcel_writeSharedBlob(parcel.get(), 0, &blob));
+    EXPECT_EQ(STATUS_BAD_VALUE, AParcel_writeSharedBlob(parcel.get(), -1, &blob));
+    EXPECT_EQ(STATUS_BAD_VALUE, AParcel_readSharedBlob(parcel.get(), 0, &blob));
+    EXPECT_EQ(STATUS_BAD_VALUE, AParcel_readSharedBlob(parcel.get(), -1, &blob));
+    EXPECT_EQ(nullptr, blob);
+}
+
+TEST(NdkBinder, SharedBlobReadLargerThanWritten) {
+    constexpr int32_t kBlobSize = 4096;
+
+    ndk::ScopedAParcel parcel = prepareFooParcel();
+    ASSERT_NE(nullptr, parcel.get());
+    const int32_t position = AParcel_getDataPosition(parcel.get());
+
+    AParcel_Blob* blob = nullptr;
+    ASSERT_EQ(STATUS_OK, AParcel_writeSharedBlob(parcel.get(), kBlobSize, &blob));
+    AParcel_Blob_delete(blob);
+
+    blob = nullptr;
+    ASSERT_EQ(STATUS_OK, AParcel_setDataPosition(parcel.get(), position));
+    EXPECT_EQ(STATUS_BAD_VALUE, AParcel_readSharedBlob(parcel.get(), 2 * kBlobSize, &blob));
+    EXPECT_EQ(nullptr, blob);
+}
+
+TEST(NdkBinder, SharedBlobReadWithoutFileDescriptor) {
+    ndk::ScopedAParcel parcel = prepareFooParcel();
+    ASSERT_NE(nullptr, parcel.get());
+    const int32_t position = AParcel_getDataPosition(parcel.get());
+
+    // An ashmem blob header that is not followed by its file descriptor.
+    constexpr int32_t kBlobAshmemImmutable = 1;
+    ASSERT_EQ(STATUS_OK, AParcel_writeInt32(parcel.get(), kBlobAshmemImmutable));
+    ASSERT_EQ(STATUS_OK, AParcel_writeInt32(parcel.get(), 0));
+
+    AParcel_Blob* blob = nullptr;
+    ASSERT_EQ(STATUS_OK, AParcel_setDataPosition(parcel.get(), position));
+    EXPECT_EQ(STATUS_BAD_VALUE, AParcel_readSharedBlob(parcel.get(), sizeof(int32_t), &blob));
+    EXPECT_EQ(nullptr, blob);
+}
+
+TEST(NdkBinder, ParcelWriteSharedBlob) {
+    constexpr size_t kBlobSize = 4096;
+
+    ::android::Parcel parcel;
+    ::android::Parcel::WritableBlob blob;
+    ASSERT_EQ(::android::OK, parcel.writeSharedBlob(kBlobSize, &blob));
+    EXPECT_EQ(kBlobSize, blob.size());
+    EXPECT_FALSE(blob.isMutable());
+    ASSERT_NE(nullptr, blob.data());
+    memset(blob.data(), 0x5a, kBlobSize);
+    blob.release();
+
+    parcel.setDataPosition(0);
+    ::android::Parcel::ReadableBlob readBlob;
+    ASSERT_EQ(::android::OK, parcel.readBlob(kBlobSize, &readBlob));
+    const uint8_t* readData = static_cast<const uint8_t*>(readBlob.data());
+    ASSERT_NE(nullptr, readData);
+    EXPECT_TRUE(std::all_of(readData, readData + kBlobSize, [](uint8_t b) { return b == 0x5a; }));
+    readBlob.release();
+}
+
+TEST(NdkBinder, ParcelWriteSharedBlobErrors) {
+    ::android::Parcel parcel;
+    ::android::Parcel::WritableBlob blob;
+    EXPECT_EQ(::android::BAD_VALUE,
+              parcel.writeSharedBlob(static_cast<size_t>(INT32_MAX) + 1, &blob));
+
+    parcel.pushAllowFds(false);
+    EXPECT_EQ(::android::FDS_NOT_ALLOWED, parcel.writeSharedBlob(4096, &blob));
+    EXPECT_EQ(0u, parcel.dataSize());
+}
+
 int main(int argc, char* argv[]) {
     ::testing::InitGoogleTest(&argc, argv);
 
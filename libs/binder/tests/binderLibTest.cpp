@@ -14,12 +14,14 @@
  * limitations under the License.
  */
 
+#include <dirent.h>
 #include <errno.h>
 #include <fcntl.h>
 #include <poll.h>
 #include <pthread.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <thread>
 
 #include <gtest/gtest.h>
 
@@ -27,6 +29,7 @@
 #include <binder/IBinder.h>
 #include <binder/IPCThreadState.h>
 #include <binder/IServiceManager.h>
+#include <binder/TransactionStats.h>
 
 #include <sys/epoll.h>
 
@@ -73,6 +76,11 @@ enum BinderLibTestTranscationCode {
     BINDER_LIB_TEST_CREATE_BINDER_TRANSACTION,
     BINDER_LIB_TEST_GET_WORK_SOURCE_TRANSACTION,
     BINDER_LIB_TEST_ECHO_VECTOR,
+    BINDER_LIB_TEST_SET_ADAPTIVE_THREAD_POOL,
+    BINDER_LIB_TEST_GET_THREAD_COUNT,
+    BINDER_LIB_TEST_SLEEP_TRANSACTION,
+    BINDER_LIB_TEST_ADD_NAMED_SERVICE_TRANSACTION,
+    BINDER_LIB_TEST_PREVIOUS_NAMED_SERVICE_FREED_TRANSACTION,
 };
 
 pid_t start_server_process(int arg2, bool usePoll = false)
@@ -390,6 +398,52 @@ TEST_F(BinderLibTest, NopTransaction) {
     EXPECT_EQ(NO_ERROR, ret);
 }
 
+TEST_F(BinderLibTest, TransactionLatencyRecorded) {
+    TransactionStats::setEnabled(true);
+    TransactionStats::reset();
+    for (int i = 0; i < 10; i++) {
+        Parcel data, reply;
+        EXPECT_EQ(NO_ERROR, m_server->transact(BINDER_LIB_TEST_NOP_TRANSACTION, data, &reply));
+    }
+    TransactionStats::setEnabled(false);
+    String8 stats;
+    TransactionStats::dump(stats);
+    String8 expected;
+    expected.appendFormat("code=%u: count=10 ", BINDER_LIB_TEST_NOP_TRANSACTION);
+    EXPECT_NE(-1, stats.find(expected.string())) << stats.string();
+}
+
+TEST_F(BinderLibTest, TransactionLatencyNotRecordedWhenDisabled) {
+    TransactionStats::setEnabled(false);
+    TransactionStats::reset();
+    Parcel data, reply;
+    EXPECT_EQ(NO_ERROR, m_server->transact(BINDER_LIB_TEST_NOP_TRANSACTION, data, &reply));
+
+    String8 stats;
+    TransactionStats::dump(stats);
+    String8 recorded;
+    recorded.appendFormat("code=%u: count=", BINDER_LIB_TEST_NOP_TRANSACTION);
+    EXPECT_EQ(-1, stats.find(recorded.string())) << stats.string();
+}
+
+TEST_F(BinderLibTest, CallerStatsRecorded) {
+    TransactionStats::setCallerStatsEnabled(true);
+    TransactionStats::resetCallers();
+    sp<BBinder> binder = new BBinder();
+    for (int i = 0; i < 10; i++) {
+        Parcel data, reply;
+        binder->transact(BINDER_LIB_TEST_NOP_TRANSACTION, data, &reply);
+    }
+    TransactionStats::setCallerStatsEnabled(false);
+
+    String8 stats;
+    TransactionStats::dumpCallers(stats);
+    String8 expected;
+    expected.appendFormat("uid=%d <no descriptor> code=%u: count=10 ", getuid(),
+                          BINDER_LIB_TEST_NOP_TRANSACTION);
+    EXPECT_NE(-1, stats.find(expected.string())) << stats.string();
+}
+
 TEST_F(BinderLibTest, SetError) {
     int32_t testValue[] = { 0, -123, 123 };
     for (size_t i = 0; i < ARRAY_SIZE(testValue); i++) {
@@ -547,6 +601,49 @@ TEST_F(BinderLibTest, CallBack)
     EXPECT_EQ(NO_ERROR, ret);
 }
 
+TEST_F(BinderLibTest, OnewayBatch)
+{
+    const int kBatchSize = 8;
+    status_t ret;
+    std::vector<sp<BinderLibTestCallBack>> callBacks;
+
+    IPCThreadState::self()->beginOnewayBatch();
+    for (int i = 0; i < kBatchSize; i++) {
+        Parcel data;
+        sp<BinderLibTestCallBack> callBack = new BinderLibTestCallBack();
+        data.writeStrongBinder(callBack);
+        ret = m_server->transact(BINDER_LIB_TEST_NOP_CALL_BACK, data, nullptr, TF_ONE_WAY);
+        EXPECT_EQ(NO_ERROR, ret);
+        callBacks.push_back(callBack);
+    }
+    ret = IPCThreadState::self()->endOnewayBatch();
+    EXPECT_EQ(NO_ERROR, ret);
+
+    for (const auto& callBack : callBacks) {
+        ret = callBack->waitEvent(5);
+        EXPECT_EQ(NO_ERROR, ret);
+        ret = callBack->getResult();
+        EXPECT_EQ(NO_ERROR, ret);
+    }
+
+    // A synchronous call made while a batch is open flushes it first.
+    IPCThreadState::self()->beginOnewayBatch();
+    {
+        Parcel data, reply;
+        sp<BinderLibTestCallBack> callBack = new BinderLibTestCallBack();
+        data.writeStrongBinder(callBack);
+        ret = m_server->transact(BINDER_LIB_TEST_NOP_CALL_BACK, data, nullptr, TF_ONE_WAY);
+        EXPECT_EQ(NO_ERROR, ret);
+        Parcel data2;
+        ret = m_server->transact(BINDER_LIB_TEST_NOP_TRANSACTION, data2, &reply);
+        EXPECT_EQ(NO_ERROR, ret);
+        ret = callBack->waitEvent(5);
+        EXPECT_EQ(NO_ERROR, ret);
+    }
+    ret = IPCThreadState::self()->endOnewayBatch();
+    EXPECT_EQ(NO_ERROR, ret);
+}
+
 TEST_F(BinderLibTest, AddServer)
 {
     sp<IBinder> server = addServer();
@@ -1076,6 +1173,144 @@ TEST_F(BinderLibTest, VectorSent) {
     EXPECT_EQ(readValue, testValue);
 }
 
+TEST_F(BinderLibTest, LargeVectorSent) {
+    Parcel data, reply;
+    sp<IBinder> server = addServer();
+    ASSERT_TRUE(server != nullptr);
+
+    // Large enough that the parcel data moves to page-backed storage while
+    // it is being written.
+    std::vector<uint64_t> testValue(32 * 1024);
+    for (size_t i = 0; i < testValue.size(); i++) {
+        testValue[i] = i * 0x9e3779b97f4a7c15ULL;
+    }
+    for (size_t i = 0; i < testValue.size(); i++) {
+        data.writeUint64(testValue[i]);
+    }
+    data.setDataPosition(0);
+    std::vector<uint64_t> echoValue(testValue.size());
+    for (size_t i = 0; i < echoValue.size(); i++) {
+        echoValue[i] = data.readUint64();
+    }
+    EXPECT_EQ(testValue, echoValue);
+
+    data.setDataSize(0);
+    data.writeUint64Vector(testValue);
+    status_t ret = server->transact(BINDER_LIB_TEST_ECHO_VECTOR, data, &reply);
+    EXPECT_EQ(NO_ERROR, ret);
+    std::vector<uint64_t> readValue;
+    ret = reply.readUint64Vector(&readValue);
+    EXPECT_EQ(readValue, testValue);
+}
+
+static int32_t getServerThreadCount(const sp<IBinder>& server) {
+    Parcel data, reply;
+    if (server->transact(BINDER_LIB_TEST_GET_THREAD_COUNT, data, &reply) != NO_ERROR) {
+        return -1;
+    }
+    return reply.readInt32();
+}
+
+TEST_F(BinderLibTest, AdaptiveThreadPoolReapsIdleThreads) {
+    constexpr int32_t kMaxThreads = 4;
+    constexpr int32_t kIdleTimeoutMs = 100;
+    sp<IBinder> server = addServer();
+    ASSERT_TRUE(server != nullptr);
+
+    {
+        Parcel data, reply;
+        data.writeInt32(0 /*minThreads*/);
+        data.writeInt32(kMaxThreads);
+        data.writeInt32(kIdleTimeoutMs);
+        ASSERT_EQ(NO_ERROR, server->transact(BINDER_LIB_TEST_SET_ADAPTIVE_THREAD_POOL, data,
+                                             &reply));
+    }
+    const int32_t idleThreadCount = getServerThreadCount(server);
+    ASSERT_GT(idleThreadCount, 0);
+
+    // Keep more calls in flight than the pool may have threads, so that the
+    // driver spawns as many as it is allowed to.
+    std::vector<std::thread> callers;
+    for (int32_t i = 0; i < 3 * kMaxThreads; i++) {
+        callers.emplace_back([&server]() {
+            Parcel data, reply;
+            data.writeInt32(5 * kIdleTimeoutMs);
+            EXPECT_EQ(NO_ERROR, server->transact(BINDER_LIB_TEST_SLEEP_TRANSACTION, data, &reply));
+        });
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(2 * kIdleTimeoutMs));
+    const int32_t busyThreadCount = getServerThreadCount(server);
+    for (auto& caller : callers) {
+        caller.join();
+    }
+    EXPECT_GT(busyThreadCount, idleThreadCount);
+    // The driver never has more than kMaxThreads of its threads running.
+    EXPECT_LE(busyThreadCount, idleThreadCount + kMaxThreads);
+
+    // The spawned threads leave the pool one idle timeout at a time.
+    int32_t threadCount = getServerThreadCount(server);
+    for (int32_t i = 0; i < 5 * kMaxThreads && threadCount > idleThreadCount; i++) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(2 * kIdleTimeoutMs));
+        threadCount = getServerThreadCount(server);
+    }
+    EXPECT_LE(threadCount, idleThreadCount);
+}
+
+static sp<IBinder> addNamedService(const String16& name) {
+    sp<IServiceManager> sm = defaultServiceManager();
+    Parcel data, reply;
+    data.writeString16(name);
+    if (binder_env->getServer()->transact(BINDER_LIB_TEST_ADD_NAMED_SERVICE_TRANSACTION, data,
+                                          &reply) != NO_ERROR) {
+        return nullptr;
+    }
+    return sm->checkService(name);
+}
+
+TEST_F(BinderLibTest, CheckServiceSeesReregisteredService) {
+    const String16 name("test.binderLib.cache.reregister");
+    sp<IServiceManager> sm = defaultServiceManager();
+    sp<IBinder> first = addNamedService(name);
+    ASSERT_TRUE(first != nullptr);
+    EXPECT_EQ(first, sm->checkService(name));
+
+    // Register a new binder under the same name while we still hold the old
+    // one, so the cached proxy stays alive. Lookups must still move on to the
+    // new binder within a bounded time.
+    Parcel data, reply;
+    data.writeString16(name);
+    ASSERT_EQ(NO_ERROR, binder_env->getServer()->transact(
+            BINDER_LIB_TEST_ADD_NAMED_SERVICE_TRANSACTION, data, &reply));
+    sp<IBinder> current = sm->checkService(name);
+    for (int i = 0; i < 50 && current == first; i++) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+        current = sm->checkService(name);
+    }
+    ASSERT_TRUE(current != nullptr);
+    EXPECT_NE(first, current);
+}
+
+TEST_F(BinderLibTest, CheckServiceDoesNotPinService) {
+    const String16 name("test.binderLib.cache.pin");
+    ASSERT_TRUE(addNamedService(name) != nullptr);
+
+    // The lookup above cached the service and we dropped our reference. Once
+    // servicemanager lets go of it as well, nothing should keep it alive.
+    ASSERT_TRUE(addNamedService(name) != nullptr);
+    IPCThreadState::self()->flushCommands();
+    bool freed = false;
+    for (int i = 0; i < 50 && !freed; i++) {
+        Parcel data, reply;
+        ASSERT_EQ(NO_ERROR, binder_env->getServer()->transact(
+                BINDER_LIB_TEST_PREVIOUS_NAMED_SERVICE_FREED_TRANSACTION, data, &reply));
+        freed = reply.readBool();
+        if (!freed) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(100));
+        }
+    }
+    EXPECT_TRUE(freed);
+}
+
 class BinderLibTestService : public BBinder
 {
     public:
@@ -1387,6 +1622,44 @@ class BinderLibTestService : public BBinder
                 reply->writeUint64Vector(vector);
                 return NO_ERROR;
             }
+            case BINDER_LIB_TEST_SET_ADAPTIVE_THREAD_POOL: {
+                int32_t minThreads = data.readInt32();
+                int32_t maxThreads = data.readInt32();
+                int32_t idleTimeoutMs = data.readInt32();
+                return ProcessState::self()->setThreadPoolAdaptive(minThreads, maxThreads,
+                                                                   idleTimeoutMs);
+            }
+            case BINDER_LIB_TEST_GET_THREAD_COUNT: {
+                DIR* dir = opendir("/proc/self/task");
+                if (dir == nullptr) {
+                    return -errno;
+                }
+                int32_t count = 0;
+                while (struct dirent* entry = readdir(dir)) {
+                    if (entry->d_name[0] != '.') {
+                        count++;
+                    }
+                }
+                closedir(dir);
+                reply->writeInt32(count);
+                return NO_ERROR;
+            }
+            case BINDER_LIB_TEST_SLEEP_TRANSACTION:
+                usleep(data.readInt32() * 1000);
+                return NO_ERROR;
+            case BINDER_LIB_TEST_ADD_NAMED_SERVICE_TRANSACTION: {
+                sp<IBinder> service = new BBinder();
+                status_t ret = defaultServiceManager()->addService(data.readString16(), service);
+                if (ret != NO_ERROR) {
+                    return ret;
+                }
+                m_previousNamedService = m_namedService;
+                m_namedService = service;
+                return NO_ERROR;
+            }
+            case BINDER_LIB_TEST_PREVIOUS_NAMED_SERVICE_FREED_TRANSACTION:
+                reply->writeBool(m_previousNamedService.promote() == nullptr);
+                return NO_ERROR;
             default:
                 return UNKNOWN_TRANSACTION;
             };
@@ -1401,6 +1674,8 @@ class BinderLibTestService : public BBinder
         sp<IBinder> m_strongRef;
         bool m_callbackPending;
         sp<IBinder> m_callback;
+        sp<IBinder> m_namedService;
+        wp<IBinder> m_previousNamedService;
 };
 
 int run_server(int index, int readypipefd, bool usePoll)
@@ -0,0 +1,127 @@
+/*
+ * Copyright (C) 2019 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <gtest/gtest.h>
+
+#include <binder/PermissionCache.h>
+
+namespace android {
+
+static const String16 kPermission("android.permission.TEST");
+static const String16 kOtherPermission("android.permission.OTHER_TEST");
+static constexpr nsecs_t kNow = 1000 * 1000000000LL;
+
+class PermissionCacheTest : public ::testing::Test {
+protected:
+    void cache(const String16& permission, uid_t uid, bool granted, nsecs_t now = kNow) {
+        mCache.cache(permission, uid, granted, now);
+    }
+
+    // Returns NAME_NOT_FOUND, or NO_ERROR and sets *granted.
+    status_t check(bool* granted, const String16& permission, uid_t uid, nsecs_t now = kNow) {
+        return mCache.check(granted, permission, uid, now);
+    }
+
+    void purge() { mCache.purge(); }
+    void purge(uid_t uid) { mCache.purge(uid); }
+
+    const void* shardOf(uid_t uid) { return &mCache.shardFor(uid); }
+
+    static constexpr uid_t kShardCount = PermissionCache::SHARD_COUNT;
+    static constexpr nsecs_t kGrantedTtl = PermissionCache::GRANTED_TTL;
+    static constexpr nsecs_t kDeniedTtl = PermissionCache::DENIED_TTL;
+
+    PermissionCache mCache;
+};
+
+TEST_F(PermissionCacheTest, ReturnsCachedResults) {
+    bool granted = false;
+    EXPECT_EQ(NAME_NOT_FOUND, check(&granted, kPermission, 10001));
+
+    cache(kPermission, 10001, true);
+    cache(kOtherPermission, 10001, false);
+    ASSERT_EQ(NO_ERROR, check(&granted, kPermission, 10001));
+    EXPECT_TRUE(granted);
+    ASSERT_EQ(NO_ERROR, check(&granted, kOtherPermission, 10001));
+    EXPECT_FALSE(granted);
+    EXPECT_EQ(NAME_NOT_FOUND, check(&granted, kPermission, 10002));
+}
+
+TEST_F(PermissionCacheTest, SplitsUidsAcrossShards) {
+    EXPECT_EQ(shardOf(10001), shardOf(10001 + kShardCount));
+    for (uid_t uid = 10001; uid < 10001 + kShardCount - 1; uid++) {
+        EXPECT_NE(shardOf(uid), shardOf(uid + 1));
+    }
+
+    // Uids that share a shard keep their own results.
+    cache(kPermission, 10001, true);
+    cache(kPermission, 10001 + kShardCount, false);
+    bool granted = false;
+    ASSERT_EQ(NO_ERROR, check(&granted, kPermission, 10001));
+    EXPECT_TRUE(granted);
+    ASSERT_EQ(NO_ERROR, check(&granted, kPermission, 10001 + kShardCount));
+    EXPECT_FALSE(granted);
+}
+
+TEST_F(PermissionCacheTest, ExpiresGrantedResults) {
+    cache(kPermission, 10001, true);
+    bool granted = false;
+    EXPECT_EQ(NO_ERROR, check(&granted, kPermission, 10001, kNow + kGrantedTtl - 1));
+    EXPECT_EQ(NAME_NOT_FOUND, check(&granted, kPermission, 10001, kNow + kGrantedTtl));
+}
+
+TEST_F(PermissionCacheTest, ExpiresDeniedResultsSooner) {
+    ASSERT_LT(kDeniedTtl, kGrantedTtl);
+    cache(kPermission, 10001, false);
+    bool granted = true;
+    EXPECT_EQ(NO_ERROR, check(&granted, kPermission, 10001, kNow + kDeniedTtl - 1));
+    EXPECT_EQ(NAME_NOT_FOUND, check(&granted, kPermission, 10001, kNow + kDeniedTtl));
+}
+
+TEST_F(PermissionCacheTest, RecachingRenewsTheResult) {
+    cache(kPermission, 10001, false);
+    cache(kPermission, 10001, true, kNow + kDeniedTtl);
+    bool granted = false;
+    ASSERT_EQ(NO_ERROR, check(&granted, kPermission, 10001, kNow + kDeniedTtl));
+    EXPECT_TRUE(granted);
+}
+
+TEST_F(PermissionCacheTest, PurgeDropsEveryResult) {
+    for (uid_t uid = 10001; uid < 10001 + 2 * kShardCount; uid++) {
+        cache(kPermission, uid, true);
+    }
+    purge();
+    bool granted = false;
+    for (uid_t uid = 10001; uid < 10001 + 2 * kShardCount; uid++) {
+        EXPECT_EQ(NAME_NOT_FOUND, check(&granted, kPermission, uid));
+    }
+}
+
+TEST_F(PermissionCacheTest, PurgeOfUidKeepsTheOthers) {
+    cache(kPermission, 10001, true);
+    cache(kOtherPermission, 10001, true);
+    cache(kPermission, 10001 + kShardCount, true);
+    cache(kPermission, 10002, true);
+
+    purge(10001);
+    bool granted = false;
+    EXPECT_EQ(NAME_NOT_FOUND, check(&granted, kPermission, 10001));
+    EXPECT_EQ(NAME_NOT_FOUND, check(&granted, kOtherPermission, 10001));
+    EXPECT_EQ(NO_ERROR, check(&granted, kPermission, 10001 + kShardCount));
+    EXPECT_EQ(NO_ERROR, check(&granted, kPermission, 10002));
+}
+
+} // namespace android
@@ -108,3 +108,64 @@ TEST(ValueType, HandlesSwap) {
     ASSERT_TRUE(value_b.getInt(&int_x));
     ASSERT_EQ(31337, int_x);
 }
+
+TEST(PersistableBundle, ReadsBackWhatWasWritten) {
+    PersistableBundle nested;
+    nested.putString(String16("name"), String16("nested"));
+
+    PersistableBundle bundle;
+    bundle.putInt(String16("int"), 31337);
+    bundle.putLongVector(String16("longs"), vector<int64_t>{1, 2, 3});
+    bundle.putStringVector(String16("strings"), vector<String16>{String16("a"), String16("b")});
+    bundle.putPersistableBundle(String16("bundle"), nested);
+
+    android::Parcel parcel;
+    ASSERT_EQ(android::NO_ERROR, bundle.writeToParcel(&parcel));
+    parcel.setDataPosition(0);
+    PersistableBundle read;
+    ASSERT_EQ(android::NO_ERROR, read.readFromParcel(&parcel));
+    EXPECT_EQ(parcel.dataSize(), parcel.dataPosition());
+
+    EXPECT_EQ(4u, read.size());
+    int32_t int_x;
+    ASSERT_TRUE(read.getInt(String16("int"), &int_x));
+    EXPECT_EQ(31337, int_x);
+    int64_t long_x;
+    EXPECT_FALSE(read.getLong(String16("int"), &long_x));
+    PersistableBundle nested_x;
+    ASSERT_TRUE(read.getPersistableBundle(String16("bundle"), &nested_x));
+    EXPECT_EQ(nested, nested_x);
+    EXPECT_EQ(bundle.getStringVectorKeys(), read.getStringVectorKeys());
+    EXPECT_EQ(bundle, read);
+
+    // Changing a copy leaves the bundle it was copied from alone
+    PersistableBundle copy = read;
+    copy.putInt(String16("int"), 42);
+    EXPECT_NE(copy, read);
+    ASSERT_TRUE(read.getInt(String16("int"), &int_x));
+    EXPECT_EQ(31337, int_x);
+
+    // A bundle passed on unchanged reads back the same
+    android::Parcel forwarded;
+    ASSERT_EQ(android::NO_ERROR, read.writeToParcel(&forwarded));
+    forwarded.setDataPosition(0);
+    PersistableBundle forwarded_read;
+    ASSERT_EQ(android::NO_ERROR, forwarded_read.readFromParcel(&forwarded));
+    EXPECT_EQ(bundle, forwarded_read);
+}
+
+TEST(PersistableBundle, FailsToReadTruncatedData) {
+    PersistableBundle bundle;
+    bundle.putString(String16("string"), String16("value"));
+    bundle.putIntVector(String16("ints"), vector<int32_t>{1, 2, 3});
+
+    android::Parcel parcel;
+    ASSERT_EQ(android::NO_ERROR, bundle.writeToParcel(&parcel));
+    for (size_t size = sizeof(int32_t); size < parcel.dataSize(); size += sizeof(int32_t)) {
+        android::Parcel truncated;
+        ASSERT_EQ(android::NO_ERROR, truncated.appendFrom(&parcel, 0, size));
+        truncated.setDataPosition(0);
+        PersistableBundle read;
+        EXPECT_NE(android::NO_ERROR, read.readFromParcel(&truncated)) << size;
+    }
+}
@@ -21,7 +21,10 @@
 #include <dirent.h>
 #include <errno.h>
 #include <inttypes.h>
+#include <unistd.h>
 
+#include <algorithm>
+#include <memory>
 #include <mutex>
 #include <set>
 #include <string>
@@ -62,6 +65,10 @@ static std::vector<std::vector<uint32_t>> gPolicyCpus;
 static std::set<uint32_t> gAllFreqs;
 static unique_fd gMapFd;
 
+static std::mutex gLastUpdateMutex;
+static uint64_t gLastUpdate = 0;
+static std::unordered_map<uint32_t, std::vector<std::vector<uint64_t>>> gLastUidTimes;
+
 static bool readNumbersFromFile(const std::string &path, std::vector<uint32_t> *out) {
     std::string data;
 
@@ -227,6 +234,32 @@ bool getUidsCpuFreqTimes(
     return isOk(m.iterateWithValue(fn));
 }
 
+// Retrieve the times in ns that each uid spent running at each CPU freq, in the format of
+// getUidsCpuFreqTimes, but only for the uids whose times changed since the call which returned
+// *lastUpdate. *lastUpdate should be 0 on the first call, and is updated for the next one.
+// Only the times returned by the latest call are kept, so an older *lastUpdate returns all uids.
+// Returns false on error, in which case *lastUpdate is left unchanged.
+// Uids which no longer have times, such as those cleared by clearUidCpuFreqTimes, aren't reported.
+bool getUidsUpdatedCpuFreqTimes(
+        uint64_t *lastUpdate,
+        std::unordered_map<uint32_t, std::vector<std::vector<uint64_t>>> *freqTimeMap) {
+    std::unordered_map<uint32_t, std::vector<std::vector<uint64_t>>> uidTimes;
+    if (!getUidsCpuFreqTimes(&uidTimes)) return false;
+
+    std::lock_guard<std::mutex> guard(gLastUpdateMutex);
+    const bool sinceLastUpdate = *lastUpdate != 0 && *lastUpdate == gLastUpdate;
+    for (const auto &[uid, times] : uidTimes) {
+        if (sinceLastUpdate) {
+            auto last = gLastUidTimes.find(uid);
+            if (last != gLastUidTimes.end() && last->second == times) continue;
+        }
+        (*freqTimeMap)[uid] = times;
+    }
+    gLastUidTimes = std::move(uidTimes);
+    *lastUpdate = ++gLastUpdate;
+    return true;
+}
+
 // Clear all time in state data for a given uid. Returns false on error, true otherwise.
 bool clearUidCpuFreqTimes(uint32_t uid) {
     if (!gInitialized && !initGlobals()) return false;
@@ -240,5 +273,99 @@ bool clearUidCpuFreqTimes(uint32_t uid) {
     return true;
 }
 
+// Add the times in a /proc/<pid>/task/<tid>/time_in_state file to freqTimes, which the kernel
+// lists under the first CPU of each policy, in clock ticks:
+// cpu0
+// 300000 12
+// ...
+// cpu4
+// ...
+static bool addTaskCpuFreqTimes(const std::string &path,
+                                std::vector<std::vector<uint64_t>> *freqTimes) {
+    std::string data;
+    if (!android::base::ReadFileToString(path, &data)) return false;
+
+    static const uint64_t nsPerTick = 1000000000 / sysconf(_SC_CLK_TCK);
+    std::vector<uint64_t> *policyTimes = nullptr;
+    const std::vector<uint32_t> *policyFreqs = nullptr;
+    for (const auto &line : android::base::Split(data, "\n")) {
+        if (line.empty()) continue;
+        uint32_t cpu;
+        if (sscanf(line.c_str(), "cpu%" SCNu32, &cpu) == 1) {
+            policyTimes = nullptr;
+            for (uint32_t i = 0; i < gNPolicies; ++i) {
+                const auto &cpus = gPolicyCpus[i];
+                if (std::find(cpus.begin(), cpus.end(), cpu) == cpus.end()) continue;
+                policyTimes = &(*freqTimes)[i];
+                policyFreqs = &gPolicyFreqs[i];
+                break;
+            }
+            if (policyTimes == nullptr) return false;
+            continue;
+        }
+        uint32_t freq;
+        uint64_t ticks;
+        if (policyTimes == nullptr ||
+            sscanf(line.c_str(), "%" SCNu32 " %" SCNu64, &freq, &ticks) != 2) {
+            return false;
+        }
+        auto it = std::lower_bound(policyFreqs->begin(), policyFreqs->end(), freq);
+        if (it == policyFreqs->end() || *it != freq) continue;
+        (*policyTimes)[it - policyFreqs->begin()] += ticks * nsPerTick;
+    }
+    return true;
+}
+
+// Add the times of each thread of pid to freqTimes. Returns false if none of them could be read.
+static bool addPidCpuFreqTimes(pid_t pid, std::vector<std::vector<uint64_t>> *freqTimes) {
+    const std::string taskPath = StringPrintf("/proc/%d/task", pid);
+    std::unique_ptr<DIR, decltype(&closedir)> dir(opendir(taskPath.c_str()), closedir);
+    if (!dir) return false;
+
+    bool found = false;
+    struct dirent *d;
+    while ((d = readdir(dir.get()))) {
+        if (d->d_name[0] == '.') continue;
+        // Threads may exit while they are being read.
+        found |= addTaskCpuFreqTimes(taskPath + "/" + d->d_name + "/time_in_state", freqTimes);
+    }
+    return found;
+}
+
+static void resizeFreqTimes(std::vector<std::vector<uint64_t>> *freqTimes) {
+    freqTimes->clear();
+    freqTimes->resize(gNPolicies);
+    for (uint32_t i = 0; i < gNPolicies; ++i) (*freqTimes)[i].resize(gPolicyFreqs[i].size(), 0);
+}
+
+// Retrieve the times in ns that the live threads of process pid spent running at each CPU
+// frequency and store in freqTimes, in the format of getUidCpuFreqTimes. Relies on the kernel
+// exposing /proc/<pid>/task/<tid>/time_in_state; the times of threads which already exited are
+// not included. Returns false on error.
+bool getPidCpuFreqTimes(pid_t pid, std::vector<std::vector<uint64_t>> *freqTimes) {
+    if (!gInitialized && !initGlobals()) return false;
+    resizeFreqTimes(freqTimes);
+    return addPidCpuFreqTimes(pid, freqTimes);
+}
+
+// Retrieve the times in ns that the processes in the cgroup at cgroupPath, such as
+// /dev/cpuctl/top-app, spent running at each CPU frequency and store in freqTimes, in the format
+// of getUidCpuFreqTimes. Only the live threads of the processes in the cgroup at the time of the
+// call are counted, as in getPidCpuFreqTimes. Returns false on error.
+bool getCgroupCpuFreqTimes(const std::string &cgroupPath,
+                           std::vector<std::vector<uint64_t>> *freqTimes) {
+    if (!gInitialized && !initGlobals()) return false;
+
+    std::vector<uint32_t> pids;
+    if (!readNumbersFromFile(cgroupPath + "/cgroup.procs", &pids)) return false;
+
+    resizeFreqTimes(freqTimes);
+    for (uint32_t pid : pids) {
+        // Processes may exit while they are being read.
+        addPidCpuFreqTimes(pid, freqTimes);
+    }
+    return true;
+}
+
 } // namespace bpf
 } // namespace android
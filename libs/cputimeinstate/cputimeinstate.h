@@ -16,6 +16,9 @@
 
 #pragma once
 
+#include <sys/types.h>
+
+#include <string>
 #include <unordered_map>
 #include <vector>
 
@@ -25,7 +28,13 @@ namespace bpf {
 bool startTrackingUidCpuFreqTimes();
 bool getUidCpuFreqTimes(unsigned int uid, std::vector<std::vector<uint64_t>> *freqTimes);
 bool getUidsCpuFreqTimes(std::unordered_map<uint32_t, std::vector<std::vector<uint64_t>>> *tisMap);
+bool getUidsUpdatedCpuFreqTimes(
+        uint64_t *lastUpdate,
+        std::unordered_map<uint32_t, std::vector<std::vector<uint64_t>>> *tisMap);
 bool clearUidCpuFreqTimes(unsigned int uid);
+bool getPidCpuFreqTimes(pid_t pid, std::vector<std::vector<uint64_t>> *freqTimes);
+bool getCgroupCpuFreqTimes(const std::string &cgroupPath,
+                           std::vector<std::vector<uint64_t>> *freqTimes);
 
 } // namespace bpf
 } // namespace android
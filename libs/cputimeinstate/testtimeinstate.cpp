@@ -1,4 +1,7 @@
 
+#include <unistd.h>
+
+#include <chrono>
 #include <unordered_map>
 #include <vector>
 
@@ -33,6 +36,59 @@ TEST(TimeInStateTest, AllUid) {
     }
 }
 
+TEST(TimeInStateTest, AllUidUpdated) {
+    std::unordered_map<uint32_t, vector<vector<uint64_t>>> map, updatedMap;
+    uint64_t lastUpdate = 0;
+    ASSERT_TRUE(getUidsUpdatedCpuFreqTimes(&lastUpdate, &map));
+    ASSERT_FALSE(map.empty());
+    ASSERT_NE(lastUpdate, (uint64_t)0);
+
+    uint64_t firstUpdate = lastUpdate;
+    ASSERT_TRUE(getUidsUpdatedCpuFreqTimes(&lastUpdate, &updatedMap));
+    ASSERT_NE(lastUpdate, firstUpdate);
+    for (const auto &[uid, times] : updatedMap) {
+        auto it = map.find(uid);
+        if (it == map.end()) continue;
+        ASSERT_EQ(times.size(), it->second.size());
+        for (size_t i = 0; i < times.size(); ++i) {
+            ASSERT_EQ(times[i].size(), it->second[i].size());
+            for (size_t j = 0; j < times[i].size(); ++j) ASSERT_GE(times[i][j], it->second[i][j]);
+        }
+    }
+
+    // An outdated update reports every uid again.
+    updatedMap.clear();
+    ASSERT_TRUE(getUidsUpdatedCpuFreqTimes(&firstUpdate, &updatedMap));
+    ASSERT_GE(updatedMap.size(), map.size());
+}
+
+TEST(TimeInStateTest, UpdatedIncludesRunningUid) {
+    std::unordered_map<uint32_t, vector<vector<uint64_t>>> map, updatedMap;
+    uint64_t lastUpdate = 0;
+    ASSERT_TRUE(getUidsUpdatedCpuFreqTimes(&lastUpdate, &map));
+
+    // Run long enough for this uid's times to grow.
+    auto end = std::chrono::steady_clock::now() + std::chrono::milliseconds(200);
+    volatile uint64_t spin = 0;
+    while (std::chrono::steady_clock::now() < end) ++spin;
+
+    ASSERT_TRUE(getUidsUpdatedCpuFreqTimes(&lastUpdate, &updatedMap));
+    auto it = updatedMap.find(getuid());
+    ASSERT_NE(it, updatedMap.end());
+
+    uint64_t before = 0, after = 0;
+    auto last = map.find(getuid());
+    if (last != map.end()) {
+        for (const auto &policy : last->second) {
+            for (auto x : policy) before += x;
+        }
+    }
+    for (const auto &policy : it->second) {
+        for (auto x : policy) after += x;
+    }
+    ASSERT_GT(after, before);
+}
+
 TEST(TimeInStateTest, RemoveUid) {
     vector<vector<uint64_t>> times, times2;
     ASSERT_TRUE(getUidCpuFreqTimes(0, &times));
@@ -54,5 +110,26 @@ TEST(TimeInStateTest, RemoveUid) {
     }
 }
 
+TEST(TimeInStateTest, PidTimes) {
+    vector<vector<uint64_t>> uidTimes, pidTimes;
+    ASSERT_TRUE(getUidCpuFreqTimes(0, &uidTimes));
+    ASSERT_TRUE(getPidCpuFreqTimes(getpid(), &pidTimes));
+
+    ASSERT_EQ(pidTimes.size(), uidTimes.size());
+    for (size_t i = 0; i < pidTimes.size(); ++i) ASSERT_EQ(pidTimes[i].size(), uidTimes[i].size());
+}
+
+TEST(TimeInStateTest, CgroupTimes) {
+    vector<vector<uint64_t>> times;
+    ASSERT_TRUE(getCgroupCpuFreqTimes("/dev/cpuctl", &times));
+    ASSERT_FALSE(times.empty());
+
+    uint64_t sum = 0;
+    for (size_t i = 0; i < times.size(); ++i) {
+        for (auto x : times[i]) sum += x;
+    }
+    ASSERT_GT(sum, (uint64_t)0);
+}
+
 } // namespace bpf
 } // namespace android
@@ -17,6 +17,8 @@
 
 #include <dirent.h>
 #include <fcntl.h>
+#include <pthread.h>
+#include <stdlib.h>
 #include <sys/stat.h>
 #include <unistd.h>
 
@@ -69,3 +71,153 @@ int64_t calculate_dir_size(int dfd)
     closedir(d);
     return size;
 }
+
+/*
+ * Directories waiting to be walked, shared by the threads of a parallel walk.
+ * Only so many are kept open at once, and threads walk the subdirectories
+ * they find themselves beyond that, so that a wide tree can't exhaust the
+ * file descriptors of the process.
+ */
+#define MAX_QUEUED_DIRS 64
+
+struct dir_walk {
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+    int queue[MAX_QUEUED_DIRS];
+    int queued;
+    /* Number of threads walking a directory, which may queue more */
+    int active;
+    int64_t size;
+};
+
+static int queue_dir(struct dir_walk *walk, int dfd)
+{
+    int queued = 0;
+
+    pthread_mutex_lock(&walk->lock);
+    if (walk->queued < MAX_QUEUED_DIRS) {
+        walk->queue[walk->queued++] = dfd;
+        pthread_cond_signal(&walk->cond);
+        queued = 1;
+    }
+    pthread_mutex_unlock(&walk->lock);
+    return queued;
+}
+
+/* Like calculate_dir_size(), but hands subdirectories to the other threads */
+static int64_t walk_dir(struct dir_walk *walk, int dfd)
+{
+    int64_t size = 0;
+    struct stat s;
+    DIR *d;
+    struct dirent *de;
+
+    d = fdopendir(dfd);
+    if (d == NULL) {
+        close(dfd);
+        return 0;
+    }
+
+    while ((de = readdir(d))) {
+        const char *name = de->d_name;
+        if (de->d_type == DT_DIR) {
+            int subfd;
+
+            /* always skip "." and ".." */
+            if (name[0] == '.') {
+                if (name[1] == 0)
+                    continue;
+                if ((name[1] == '.') && (name[2] == 0))
+                    continue;
+            }
+
+            if (fstatat(dfd, name, &s, AT_SYMLINK_NOFOLLOW) == 0) {
+                size += stat_size(&s);
+            }
+            subfd = openat(dfd, name, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+            if (subfd >= 0 && !queue_dir(walk, subfd)) {
+                size += calculate_dir_size(subfd);
+            }
+        } else {
+            if (fstatat(dfd, name, &s, AT_SYMLINK_NOFOLLOW) == 0) {
+                size += stat_size(&s);
+            }
+        }
+    }
+    closedir(d);
+    return size;
+}
+
+static void *walk_dirs(void *arg)
+{
+    struct dir_walk *walk = arg;
+    int64_t size = 0;
+
+    pthread_mutex_lock(&walk->lock);
+    for (;;) {
+        int dfd;
+
+        while (walk->queued == 0 && walk->active > 0) {
+            pthread_cond_wait(&walk->cond, &walk->lock);
+        }
+        if (walk->queued == 0) {
+            /* Nothing is queued, and nothing is being walked that could queue more */
+            break;
+        }
+
+        dfd = walk->queue[--walk->queued];
+        walk->active++;
+        pthread_mutex_unlock(&walk->lock);
+
+        size += walk_dir(walk, dfd);
+
+        pthread_mutex_lock(&walk->lock);
+        walk->active--;
+        if (walk->active == 0 && walk->queued == 0) {
+            pthread_cond_broadcast(&walk->cond);
+        }
+    }
+    walk->size += size;
+    pthread_mutex_unlock(&walk->lock);
+    return NULL;
+}
+
+int64_t calculate_dir_size_parallel(int dfd, int threads)
+{
+    struct dir_walk walk;
+    pthread_t *workers;
+    int started = 0;
+    int i;
+
+    if (threads <= 1) {
+        return calculate_dir_size(dfd);
+    }
+
+    workers = malloc((threads - 1) * sizeof(pthread_t));
+    if (workers == NULL) {
+        return calculate_dir_size(dfd);
+    }
+
+    pthread_mutex_init(&walk.lock, NULL);
+    pthread_cond_init(&walk.cond, NULL);
+    walk.queue[0] = dfd;
+    walk.queued = 1;
+    walk.active = 0;
+    walk.size = 0;
+
+    /* The calling thread walks as well, so the walk goes on even if no thread starts */
+    for (i = 0; i < threads - 1; i++) {
+        if (pthread_create(&workers[started], NULL, walk_dirs, &walk) == 0) {
+            started++;
+        }
+    }
+    walk_dirs(&walk);
+    for (i = 0; i < started; i++) {
+        pthread_join(workers[i], NULL);
+    }
+
+    pthread_cond_destroy(&walk.cond);
+    pthread_mutex_destroy(&walk.lock);
+    free(workers);
+    return walk.size;
+}
@@ -16,6 +16,8 @@
 
 #include <inttypes.h>
 
+#include <algorithm>
+
 #include <android-base/stringprintf.h>
 #include <binder/Parcel.h>
 #include <graphicsenv/GpuStatsInfo.h>
@@ -86,6 +88,8 @@ status_t GpuStatsAppInfo::writeToParcel(Parcel* parcel) const {
     if ((status = parcel->writeInt64Vector(vkDriverLoadingTime)) != OK) return status;
     if ((status = parcel->writeInt64Vector(angleDriverLoadingTime)) != OK) return status;
     if ((status = parcel->writeBool(cpuVulkanInUse)) != OK) return status;
+    if ((status = parcel->writeInt64Vector(glLoadingPhaseHistogram)) != OK) return status;
+    if ((status = parcel->writeInt64Vector(vkLoadingPhaseHistogram)) != OK) return status;
     return OK;
 }
 
@@ -97,9 +101,34 @@ status_t GpuStatsAppInfo::readFromParcel(const Parcel* parcel) {
     if ((status = parcel->readInt64Vector(&vkDriverLoadingTime)) != OK) return status;
     if ((status = parcel->readInt64Vector(&angleDriverLoadingTime)) != OK) return status;
     if ((status = parcel->readBool(&cpuVulkanInUse)) != OK) return status;
+    if ((status = parcel->readInt64Vector(&glLoadingPhaseHistogram)) != OK) return status;
+    if ((status = parcel->readInt64Vector(&vkLoadingPhaseHistogram)) != OK) return status;
     return OK;
 }
 
+size_t GpuStatsAppInfo::getLoadingPhaseBucket(int64_t loadingPhaseTime) {
+    int64_t ms = loadingPhaseTime / 1000000;
+    size_t bucket = 0;
+    while (ms > 0 && bucket < LOADING_PHASE_BUCKET_COUNT - 1) {
+        ms >>= 1;
+        bucket++;
+    }
+    return bucket;
+}
+
+static void appendLoadingPhaseHistogram(const char* name, const std::vector<int64_t>& histogram,
+                                        std::string* result) {
+    const size_t bucketCount = GpuStatsAppInfo::LOADING_PHASE_BUCKET_COUNT;
+    StringAppendF(result, "%s:\n", name);
+    for (size_t i = 0; i < histogram.size(); i += bucketCount) {
+        StringAppendF(result, "  phase %zu:", i / bucketCount);
+        for (size_t j = i; j < std::min(histogram.size(), i + bucketCount); j++) {
+            StringAppendF(result, " %" PRId64, histogram[j]);
+        }
+        result->append("\n");
+    }
+}
+
 std::string GpuStatsAppInfo::toString() const {
     std::string result;
     StringAppendF(&result, "appPackageName = %s\n", appPackageName.c_str());
@@ -120,6 +149,35 @@ std::string GpuStatsAppInfo::toString() const {
         StringAppendF(&result, " %d", loadingTime);
     }
     result.append("\n");
+    appendLoadingPhaseHistogram("glLoadingPhaseHistogram", glLoadingPhaseHistogram, &result);
+    appendLoadingPhaseHistogram("vkLoadingPhaseHistogram", vkLoadingPhaseHistogram, &result);
+    return result;
+}
+
+status_t GpuMemoryInfo::writeToParcel(Parcel* parcel) const {
+    status_t status;
+    if ((status = parcel->writeInt32(pid)) != OK) return status;
+    if ((status = parcel->writeInt32(uid)) != OK) return status;
+    if ((status = parcel->writeUint64(driverMemory)) != OK) return status;
+    if ((status = parcel->writeUint64(graphicBufferMemory)) != OK) return status;
+    return OK;
+}
+
+status_t GpuMemoryInfo::readFromParcel(const Parcel* parcel) {
+    status_t status;
+    if ((status = parcel->readInt32(&pid)) != OK) return status;
+    if ((status = parcel->readInt32(&uid)) != OK) return status;
+    if ((status = parcel->readUint64(&driverMemory)) != OK) return status;
+    if ((status = parcel->readUint64(&graphicBufferMemory)) != OK) return status;
+    return OK;
+}
+
+std::string GpuMemoryInfo::toString() const {
+    std::string result;
+    StringAppendF(&result, "pid = %d\n", pid);
+    StringAppendF(&result, "uid = %d\n", uid);
+    StringAppendF(&result, "driverMemory = %" PRIu64 "\n", driverMemory);
+    StringAppendF(&result, "graphicBufferMemory = %" PRIu64 "\n", graphicBufferMemory);
     return result;
 }
 
@@ -155,6 +155,75 @@ void GraphicsEnv::setDriverPathAndSphalLibraries(const std::string path,
           sphalLibraries.c_str());
     mDriverPath = path;
     mSphalLibraries = sphalLibraries;
+
+    if (android::base::GetBoolProperty("ro.gfx.driver.preload", true)) {
+        preloadDriver(true);
+    }
+}
+
+static void* preloadLibrary(const android_dlextinfo& dlextinfo, const std::string& name) {
+    void* so = android_dlopen_ext(name.c_str(), RTLD_LOCAL | RTLD_NOW, &dlextinfo);
+    ALOGV_IF(so, "preloaded updatable driver %s", name.c_str());
+    return so;
+}
+
+void GraphicsEnv::preloadDriver(bool async) {
+    if (async) {
+        std::thread preloadThread([this]() { preloadDriver(false); });
+        preloadThread.detach();
+        return;
+    }
+
+    ATRACE_CALL();
+
+    // Whether ANGLE replaces the updatable GLES driver is only decided when the
+    // drivers are first used, so the GLES driver is left alone if it might.
+    const bool preloadGles = mAnglePath.empty();
+
+    android_namespace_t* ns = getDriverNamespace();
+    if (!ns) {
+        return;
+    }
+
+    const android_dlextinfo dlextinfo = {
+            .flags = ANDROID_DLEXT_USE_NAMESPACE,
+            .library_namespace = ns,
+    };
+
+    // Look for the drivers the way the EGL and Vulkan loaders do.
+    std::vector<void*> drivers;
+    for (const char* key : {"ro.hardware.egl", "ro.board.platform"}) {
+        const std::string suffix = android::base::GetProperty(key, "");
+        if (!preloadGles || suffix.empty()) {
+            continue;
+        }
+        if (void* so = preloadLibrary(dlextinfo, "libGLES_" + suffix + ".so")) {
+            drivers.push_back(so);
+            break;
+        }
+        if (void* so = preloadLibrary(dlextinfo, "libEGL_" + suffix + ".so")) {
+            drivers.push_back(so);
+            for (const char* kind : {"libGLESv1_CM_", "libGLESv2_"}) {
+                if (void* gles = preloadLibrary(dlextinfo, kind + suffix + ".so")) {
+                    drivers.push_back(gles);
+                }
+            }
+            break;
+        }
+    }
+    for (const char* key : {"ro.hardware.vulkan", "ro.board.platform"}) {
+        const std::string suffix = android::base::GetProperty(key, "");
+        if (suffix.empty()) {
+            continue;
+        }
+        if (void* so = preloadLibrary(dlextinfo, "vulkan." + suffix + ".so")) {
+            drivers.push_back(so);
+            break;
+        }
+    }
+
+    std::lock_guard<std::mutex> lock(mNamespaceMutex);
+    mPreloadedDrivers.insert(mPreloadedDrivers.end(), drivers.begin(), drivers.end());
 }
 
 void GraphicsEnv::hintActivityLaunch() {
@@ -172,6 +241,13 @@ void GraphicsEnv::hintActivityLaunch() {
             mGpuStats.vkDriverToSend = false;
             sendGpuStatsLocked(GraphicsEnv::Api::API_VK, true, mGpuStats.vkDriverLoadingTime);
         }
+        for (const Api api : {GraphicsEnv::Api::API_GL, GraphicsEnv::Api::API_VK}) {
+            for (int phase = 0; phase < LOADING_PHASE_COUNT; phase++) {
+                if (mGpuStats.loadingPhasesToSend[api] & (1u << phase)) {
+                    sendLoadingPhaseTimeLocked(api, static_cast<LoadingPhase>(phase));
+                }
+            }
+        }
     });
     trySendGpuStatsThread.detach();
 }
@@ -276,6 +352,42 @@ void GraphicsEnv::setTargetStats(const Stats stats, const uint64_t value) {
     }
 }
 
+void GraphicsEnv::setDriverLoadingPhaseTime(GraphicsEnv::Api api, GraphicsEnv::LoadingPhase phase,
+                                            int64_t loadingPhaseTime) {
+    ATRACE_CALL();
+
+    std::lock_guard<std::mutex> lock(mStatsLock);
+    if (mGpuStats.loadingPhaseTime[api][phase]) return;
+
+    mGpuStats.loadingPhaseTime[api][phase] = loadingPhaseTime;
+    mGpuStats.loadingPhasesToSend[api] |= 1u << phase;
+    sendLoadingPhaseTimeLocked(api, phase);
+}
+
+void GraphicsEnv::sendLoadingPhaseTimeLocked(GraphicsEnv::Api api,
+                                             GraphicsEnv::LoadingPhase phase) {
+    // Do not send for those skipping the GraphicsEnvironment setup yet, such as
+    // the zygote preloading the driver; hintActivityLaunch sends it later.
+    if (mGpuStats.appPackageName.empty()) return;
+
+    const sp<IGpuService> gpuService = getGpuService();
+    if (gpuService) {
+        mGpuStats.loadingPhasesToSend[api] &= ~(1u << phase);
+        gpuService->setDriverLoadingPhaseTime(mGpuStats.appPackageName,
+                                              mGpuStats.driverVersionCode, api, phase,
+                                              mGpuStats.loadingPhaseTime[api][phase]);
+    }
+}
+
+void GraphicsEnv::setGpuMemoryUsage(const GpuMemory type, const uint64_t bytes) {
+    ATRACE_CALL();
+
+    const sp<IGpuService> gpuService = getGpuService();
+    if (gpuService) {
+        gpuService->setGpuMemoryUsage(getpid(), type, bytes);
+    }
+}
+
 void GraphicsEnv::sendGpuStatsLocked(GraphicsEnv::Api api, bool isDriverLoaded,
                                      int64_t driverLoadingTime) {
     ATRACE_CALL();
@@ -520,6 +632,14 @@ const std::string& GraphicsEnv::getLayerPaths() {
     return mLayerPaths;
 }
 
+void GraphicsEnv::setLayerCachePath(const std::string path) {
+    mLayerCachePath = path;
+}
+
+const std::string& GraphicsEnv::getLayerCachePath() {
+    return mLayerCachePath;
+}
+
 const std::string& GraphicsEnv::getDebugLayers() {
     return mDebugLayers;
 }
@@ -104,6 +104,60 @@ public:
 
         remote()->transact(BnGpuService::SET_TARGET_STATS, data, &reply, IBinder::FLAG_ONEWAY);
     }
+
+    virtual void setDriverLoadingPhaseTime(const std::string& appPackageName,
+                                           const uint64_t driverVersionCode,
+                                           const GraphicsEnv::Api api,
+                                           const GraphicsEnv::LoadingPhase phase,
+                                           const int64_t loadingPhaseTime) {
+        Parcel data, reply;
+        data.writeInterfaceToken(IGpuService::getInterfaceDescriptor());
+
+        data.writeUtf8AsUtf16(appPackageName);
+        data.writeUint64(driverVersionCode);
+        data.writeInt32(static_cast<int32_t>(api));
+        data.writeInt32(static_cast<int32_t>(phase));
+        data.writeInt64(loadingPhaseTime);
+
+        remote()->transact(BnGpuService::SET_DRIVER_LOADING_PHASE_TIME, data, &reply,
+                           IBinder::FLAG_ONEWAY);
+    }
+
+    virtual void setGpuMemoryUsage(const int32_t pid, const GraphicsEnv::GpuMemory type,
+                                   const uint64_t bytes) {
+        Parcel data, reply;
+        data.writeInterfaceToken(IGpuService::getInterfaceDescriptor());
+
+        data.writeInt32(pid);
+        data.writeInt32(static_cast<int32_t>(type));
+        data.writeUint64(bytes);
+
+        remote()->transact(BnGpuService::SET_GPU_MEMORY_USAGE, data, &reply,
+                           IBinder::FLAG_ONEWAY);
+    }
+
+    virtual status_t getGpuMemoryInfo(std::vector<GpuMemoryInfo>* outInfo) const {
+        if (!outInfo) return UNEXPECTED_NULL;
+
+        Parcel data, reply;
+        status_t status;
+
+        if ((status = data.writeInterfaceToken(IGpuService::getInterfaceDescriptor())) != OK) {
+            return status;
+        }
+
+        if ((status = remote()->transact(BnGpuService::GET_GPU_MEMORY_INFO, data, &reply)) !=
+            OK) {
+            return status;
+        }
+
+        int32_t result = 0;
+        if ((status = reply.readInt32(&result)) != OK) return status;
+        if (result != OK) return result;
+
+        outInfo->clear();
+        return reply.readParcelableVector(outInfo);
+    }
 };
 
 IMPLEMENT_META_INTERFACE(GpuService, "android.graphicsenv.IGpuService");
@@ -196,6 +250,65 @@ status_t BnGpuService::onTransact(uint32_t code, const Parcel& data, Parcel* rep
 
             return OK;
         }
+        case SET_GPU_MEMORY_USAGE: {
+            CHECK_INTERFACE(IGpuService, data, reply);
+
+            int32_t pid;
+            if ((status = data.readInt32(&pid)) != OK) return status;
+
+            int32_t type;
+            if ((status = data.readInt32(&type)) != OK) return status;
+            if (type < 0 || type >= GraphicsEnv::GPU_MEMORY_COUNT) return BAD_VALUE;
+
+            uint64_t bytes;
+            if ((status = data.readUint64(&bytes)) != OK) return status;
+
+            setGpuMemoryUsage(pid, static_cast<GraphicsEnv::GpuMemory>(type), bytes);
+
+            return OK;
+        }
+        case GET_GPU_MEMORY_INFO: {
+            CHECK_INTERFACE(IGpuService, data, reply);
+
+            std::vector<GpuMemoryInfo> info;
+            const status_t result = getGpuMemoryInfo(&info);
+
+            if ((status = reply->writeInt32(result)) != OK) return status;
+            if (result != OK) return result;
+
+            if ((status = reply->writeParcelableVector(info)) != OK) return status;
+
+            return OK;
+        }
+        case SET_DRIVER_LOADING_PHASE_TIME: {
+            CHECK_INTERFACE(IGpuService, data, reply);
+
+            std::string appPackageName;
+            if ((status = data.readUtf8FromUtf16(&appPackageName)) != OK) return status;
+
+            uint64_t driverVersionCode;
+            if ((status = data.readUint64(&driverVersionCode)) != OK) return status;
+
+            int32_t api;
+            if ((status = data.readInt32(&api)) != OK) return status;
+            if (api != GraphicsEnv::Api::API_GL && api != GraphicsEnv::Api::API_VK) {
+                return BAD_VALUE;
+            }
+
+            int32_t phase;
+            if ((status = data.readInt32(&phase)) != OK) return status;
+            if (phase < 0 || phase >= GraphicsEnv::LOADING_PHASE_COUNT) return BAD_VALUE;
+
+            int64_t loadingPhaseTime;
+            if ((status = data.readInt64(&loadingPhaseTime)) != OK) return status;
+
+            setDriverLoadingPhaseTime(appPackageName, driverVersionCode,
+                                      static_cast<GraphicsEnv::Api>(api),
+                                      static_cast<GraphicsEnv::LoadingPhase>(phase),
+                                      loadingPhaseTime);
+
+            return OK;
+        }
         case SHELL_COMMAND_TRANSACTION: {
             int in = data.readFileDescriptor();
             int out = data.readFileDescriptor();
@@ -64,12 +64,39 @@ public:
     virtual status_t readFromParcel(const Parcel* parcel);
     std::string toString() const;
 
+    // The loading phase histograms hold LOADING_PHASE_BUCKET_COUNT buckets for
+    // each phase in turn. The first bucket counts the phases shorter than 1ms,
+    // bucket i those in [2^(i-1), 2^i) ms, and the last bucket all longer ones.
+    static const size_t LOADING_PHASE_BUCKET_COUNT = 12;
+    static size_t getLoadingPhaseBucket(int64_t loadingPhaseTime);
+
     std::string appPackageName = "";
     uint64_t driverVersionCode = 0;
     std::vector<int64_t> glDriverLoadingTime = {};
     std::vector<int64_t> vkDriverLoadingTime = {};
     std::vector<int64_t> angleDriverLoadingTime = {};
     bool cpuVulkanInUse = false;
+    std::vector<int64_t> glLoadingPhaseHistogram = {};
+    std::vector<int64_t> vkLoadingPhaseHistogram = {};
+};
+
+/*
+ * class for transporting the gpu memory used by a process from GpuService to
+ * authorized recipents. This class is intended to be a data container.
+ */
+class GpuMemoryInfo : public Parcelable {
+public:
+    GpuMemoryInfo() = default;
+    GpuMemoryInfo(const GpuMemoryInfo&) = default;
+    virtual ~GpuMemoryInfo() = default;
+    virtual status_t writeToParcel(Parcel* parcel) const;
+    virtual status_t readFromParcel(const Parcel* parcel);
+    std::string toString() const;
+
+    int32_t pid = 0;
+    int32_t uid = 0;
+    uint64_t driverMemory = 0;
+    uint64_t graphicBufferMemory = 0;
 };
 
 } // namespace android
@@ -47,6 +47,23 @@ public:
         CPU_VULKAN_IN_USE = 0,
     };
 
+    enum LoadingPhase {
+        NAMESPACE_SETUP = 0,
+        DLOPEN = 1,
+        ENTRY_POINT_RESOLUTION = 2,
+        LAYER_SETUP = 3,
+        FIRST_CONTEXT = 4,
+        LOADING_PHASE_COUNT = 5,
+    };
+
+    enum GpuMemory {
+        // Memory the GPU driver allocated on behalf of the process.
+        DRIVER_MEMORY = 0,
+        // Memory of the graphic buffers the process allocated.
+        GRAPHIC_BUFFER_MEMORY = 1,
+        GPU_MEMORY_COUNT = 2,
+    };
+
 private:
     struct GpuStats {
         std::string driverPackageName;
@@ -63,6 +80,10 @@ private:
         bool vkDriverToSend;
         int64_t glDriverLoadingTime;
         int64_t vkDriverLoadingTime;
+        // Indexed by Api, then LoadingPhase.
+        int64_t loadingPhaseTime[2][LOADING_PHASE_COUNT];
+        // Bit masks of the loading phases of each Api yet to be sent.
+        uint32_t loadingPhasesToSend[2];
 
         GpuStats()
               : driverPackageName(""),
@@ -78,7 +99,9 @@ private:
                 glDriverToSend(false),
                 vkDriverToSend(false),
                 glDriverLoadingTime(0),
-                vkDriverLoadingTime(0) {}
+                vkDriverLoadingTime(0),
+                loadingPhaseTime(),
+                loadingPhasesToSend() {}
     };
 
 public:
@@ -105,14 +128,25 @@ public:
     // which is required by android_link_namespaces.
     void setDriverPathAndSphalLibraries(const std::string path, const std::string sphalLibraries);
     android_namespace_t* getDriverNamespace();
+    // Create the driver namespace and load the updatable drivers into it ahead
+    // of their first use. A process that is about to fork, such as the zygote,
+    // must not pass async, so that no thread is left running.
+    void preloadDriver(bool async);
     void hintActivityLaunch();
     void setGpuStats(const std::string& driverPackageName, const std::string& driverVersionName,
                      uint64_t versionCode, int64_t driverBuildTime,
                      const std::string& appPackageName, const int32_t vulkanVersion);
     void setTargetStats(const Stats stats, const uint64_t value = 0);
+    // Report the total memory of the given type the process currently uses,
+    // so that GpuService can attribute graphics memory to processes.
+    void setGpuMemoryUsage(const GpuMemory type, const uint64_t bytes);
     void setDriverToLoad(Driver driver);
     void setDriverLoaded(Api api, bool isDriverLoaded, int64_t driverLoadingTime);
     void sendGpuStatsLocked(Api api, bool isDriverLoaded, int64_t driverLoadingTime);
+    // Record the time the first run of a phase of initializing the driver of api
+    // took, in nanoseconds. Later runs of the same phase are ignored.
+    void setDriverLoadingPhaseTime(Api api, LoadingPhase phase, int64_t loadingPhaseTime);
+    void sendLoadingPhaseTimeLocked(Api api, LoadingPhase phase);
 
     bool shouldUseAngle(std::string appName);
     bool shouldUseAngle();
@@ -131,6 +165,11 @@ public:
 
     const std::string& getLayerPaths();
 
+    // Set the file the Vulkan loader caches the metadata of the layers found
+    // in the layer paths in.
+    void setLayerCachePath(const std::string path);
+    const std::string& getLayerCachePath();
+
     void setDebugLayers(const std::string layers);
     void setDebugLayersGLES(const std::string layers);
     const std::string& getDebugLayers();
@@ -157,9 +196,13 @@ private:
     std::string mDebugLayers;
     std::string mDebugLayersGLES;
     std::string mLayerPaths;
+    std::string mLayerCachePath;
     std::mutex mNamespaceMutex;
     android_namespace_t* mDriverNamespace = nullptr;
     android_namespace_t* mAngleNamespace = nullptr;
+    // Handles of the drivers loaded by preloadDriver, kept open so that the
+    // loaders find them already loaded.
+    std::vector<void*> mPreloadedDrivers;
     NativeLoaderNamespace* mAppNamespace = nullptr;
 };
 
@@ -49,6 +49,20 @@ public:
 
     // get GPU app stats from GpuStats module.
     virtual status_t getGpuStatsAppInfo(std::vector<GpuStatsAppInfo>* outStats) const = 0;
+
+    // set the time of a phase of the first driver loading of an app.
+    virtual void setDriverLoadingPhaseTime(const std::string& appPackageName,
+                                           const uint64_t driverVersionCode,
+                                           const GraphicsEnv::Api api,
+                                           const GraphicsEnv::LoadingPhase phase,
+                                           const int64_t loadingPhaseTime) = 0;
+
+    // set the gpu memory of the given type a process currently uses.
+    virtual void setGpuMemoryUsage(const int32_t pid, const GraphicsEnv::GpuMemory type,
+                                   const uint64_t bytes) = 0;
+
+    // get the gpu memory used by each process from GpuMem module.
+    virtual status_t getGpuMemoryInfo(std::vector<GpuMemoryInfo>* outInfo) const = 0;
 };
 
 class BnGpuService : public BnInterface<IGpuService> {
@@ -58,6 +72,9 @@ public:
         GET_GPU_STATS_GLOBAL_INFO,
         GET_GPU_STATS_APP_INFO,
         SET_TARGET_STATS,
+        SET_GPU_MEMORY_USAGE,
+        GET_GPU_MEMORY_INFO,
+        SET_DRIVER_LOADING_PHASE_TIME,
         // Always append new enum to the end.
     };
 
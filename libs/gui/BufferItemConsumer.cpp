@@ -105,6 +105,65 @@ status_t BufferItemConsumer::releaseBuffer(const BufferItem &item,
     return err;
 }
 
+status_t BufferItemConsumer::acquireBuffers(uint32_t maxBuffers,
+        std::vector<BufferItem>* items, nsecs_t presentWhen, bool waitForFence) {
+    status_t err;
+
+    if (!items || maxBuffers == 0) return BAD_VALUE;
+
+    Mutex::Autolock _l(mMutex);
+
+    const size_t first = items->size();
+    err = acquireBuffersLocked(maxBuffers, presentWhen, items);
+    if (err != OK) {
+        if (err != NO_BUFFER_AVAILABLE) {
+            BI_LOGE("Error acquiring buffers: %s (%d)", strerror(err), err);
+        }
+        return err;
+    }
+
+    for (size_t i = first; i < items->size(); i++) {
+        BufferItem& item = (*items)[i];
+        if (waitForFence) {
+            err = item.mFence->waitForever("BufferItemConsumer::acquireBuffers");
+            if (err != OK) {
+                BI_LOGE("Failed to wait for fence of acquired buffer: %s (%d)",
+                        strerror(-err), err);
+                return err;
+            }
+        }
+
+        item.mGraphicBuffer = mSlots[item.mSlot].mGraphicBuffer;
+    }
+
+    return OK;
+}
+
+status_t BufferItemConsumer::releaseBuffers(const std::vector<BufferItem>& items,
+        const sp<Fence>& releaseFence) {
+    status_t result = OK;
+
+    Mutex::Autolock _l(mMutex);
+
+    for (const BufferItem& item : items) {
+        status_t err = addReleaseFenceLocked(item.mSlot, item.mGraphicBuffer, releaseFence);
+        if (err != OK) {
+            BI_LOGE("Failed to addReleaseFenceLocked");
+        }
+
+        err = releaseBufferLocked(item.mSlot, item.mGraphicBuffer, EGL_NO_DISPLAY,
+                EGL_NO_SYNC_KHR);
+        if (err != OK && err != IGraphicBufferConsumer::STALE_BUFFER_SLOT) {
+            BI_LOGE("Failed to release buffer: %s (%d)",
+                    strerror(-err), err);
+        }
+        if (result == OK) {
+            result = err;
+        }
+    }
+    return result;
+}
+
 void BufferItemConsumer::freeBufferLocked(int slotIndex) {
     sp<BufferFreedListener> listener = mBufferFreedListener.promote();
     if (listener != nullptr && mSlots[slotIndex].mGraphicBuffer != nullptr) {
@@ -265,7 +265,7 @@ status_t BufferQueueConsumer::acquireBuffer(BufferItem* outBuffer,
         // We might have freed a slot while dropping old buffers, or the producer
         // may be blocked waiting for the number of buffers in the queue to
         // decrease.
-        mCore->mDequeueCondition.notify_all();
+        mCore->notifyDequeueWaitersLocked();
 
         ATRACE_INT(mCore->mConsumerName.string(),
                 static_cast<int32_t>(mCore->mQueue.size()));
@@ -283,6 +283,29 @@ status_t BufferQueueConsumer::acquireBuffer(BufferItem* outBuffer,
     return NO_ERROR;
 }
 
+status_t BufferQueueConsumer::acquireBuffers(uint32_t maxBuffers,
+        nsecs_t expectedPresent, std::vector<BufferItem>* outBuffers) {
+    ATRACE_CALL();
+
+    if (maxBuffers == 0 || outBuffers == nullptr) {
+        BQ_LOGE("acquireBuffers: invalid arguments");
+        return BAD_VALUE;
+    }
+
+    outBuffers->clear();
+    status_t result = NO_ERROR;
+    while (outBuffers->size() < maxBuffers) {
+        BufferItem item;
+        result = acquireBuffer(&item, expectedPresent);
+        if (result != NO_ERROR) {
+            break;
+        }
+        outBuffers->push_back(item);
+    }
+
+    return outBuffers->empty() ? result : NO_ERROR;
+}
+
 status_t BufferQueueConsumer::detachBuffer(int slot) {
     ATRACE_CALL();
     ATRACE_BUFFER_INDEX(slot);
@@ -313,7 +336,7 @@ status_t BufferQueueConsumer::detachBuffer(int slot) {
     mCore->mActiveBuffers.erase(slot);
     mCore->mFreeSlots.insert(slot);
     mCore->clearBufferSlotLocked(slot);
-    mCore->mDequeueCondition.notify_all();
+    mCore->notifyDequeueWaitersLocked();
     VALIDATE_CONSISTENCY();
 
     return NO_ERROR;
@@ -464,7 +487,7 @@ status_t BufferQueueConsumer::releaseBuffer(int slot, uint64_t frameNumber,
         }
         BQ_LOGV("releaseBuffer: releasing slot %d", slot);
 
-        mCore->mDequeueCondition.notify_all();
+        mCore->notifyDequeueWaitersLocked();
         VALIDATE_CONSISTENCY();
     } // Autolock scope
 
@@ -518,7 +541,7 @@ status_t BufferQueueConsumer::disconnect() {
     mCore->mQueue.clear();
     mCore->freeAllBuffersLocked();
     mCore->mSharedBufferSlot = BufferQueueCore::INVALID_BUFFER_SLOT;
-    mCore->mDequeueCondition.notify_all();
+    mCore->notifyDequeueWaitersLocked();
     return NO_ERROR;
 }
 
@@ -94,6 +94,55 @@ status_t BufferQueueProducer::requestBuffer(int slot, sp<GraphicBuffer>* buf) {
     return NO_ERROR;
 }
 
+status_t BufferQueueProducer::requestBuffers(int slot,
+        std::vector<RequestBufferOutput>* outBuffers) {
+    ATRACE_CALL();
+    BQ_LOGV("requestBuffers: slot %d", slot);
+    std::lock_guard<std::mutex> lock(mCore->mMutex);
+
+    if (mCore->mIsAbandoned) {
+        BQ_LOGE("requestBuffers: BufferQueue has been abandoned");
+        return NO_INIT;
+    }
+
+    if (mCore->mConnectedApi == BufferQueueCore::NO_CONNECTED_API) {
+        BQ_LOGE("requestBuffers: BufferQueue has no connected producer");
+        return NO_INIT;
+    }
+
+    if (slot < 0 || slot >= BufferQueueDefs::NUM_BUFFER_SLOTS) {
+        BQ_LOGE("requestBuffers: slot index %d out of range [0, %d)",
+                slot, BufferQueueDefs::NUM_BUFFER_SLOTS);
+        return BAD_VALUE;
+    } else if (!mSlots[slot].mBufferState.isDequeued()) {
+        BQ_LOGE("requestBuffers: slot %d is not owned by the producer "
+                "(state = %s)", slot, mSlots[slot].mBufferState.string());
+        return BAD_VALUE;
+    }
+
+    outBuffers->clear();
+    mSlots[slot].mRequestBufferCalled = true;
+    if (mSlots[slot].mGraphicBuffer != nullptr) {
+        outBuffers->push_back({slot, mSlots[slot].mGraphicBuffer});
+    }
+
+    // Hand out the free buffers the producer has not seen yet along, such as
+    // the ones from allocateBuffers, so that their first dequeue needs no
+    // requestBuffer of its own. Once the producer has the buffer, dequeueBuffer
+    // no longer needs to report it as reallocated.
+    for (int freeSlot : mCore->mFreeBuffers) {
+        BufferSlot& freeBufferSlot(mSlots[freeSlot]);
+        if (freeBufferSlot.mGraphicBuffer == nullptr ||
+                freeBufferSlot.mRequestBufferCalled) {
+            continue;
+        }
+        freeBufferSlot.mRequestBufferCalled = true;
+        freeBufferSlot.mNeedsReallocation = false;
+        outBuffers->push_back({freeSlot, freeBufferSlot.mGraphicBuffer});
+    }
+    return NO_ERROR;
+}
+
 status_t BufferQueueProducer::setMaxDequeuedBufferCount(
         int maxDequeuedBuffers) {
     ATRACE_CALL();
@@ -164,7 +213,7 @@ status_t BufferQueueProducer::setMaxDequeuedBufferCount(
         if (delta < 0) {
             listener = mCore->mConsumerListener;
         }
-        mCore->mDequeueCondition.notify_all();
+        mCore->notifyDequeueWaitersLocked();
     } // Autolock scope
 
     // Call back without lock held
@@ -216,7 +265,7 @@ status_t BufferQueueProducer::setAsyncMode(bool async) {
         }
         mCore->mAsyncMode = async;
         VALIDATE_CONSISTENCY();
-        mCore->mDequeueCondition.notify_all();
+        mCore->notifyDequeueWaitersLocked();
         if (delta < 0) {
             listener = mCore->mConsumerListener;
         }
@@ -338,14 +387,17 @@ status_t BufferQueueProducer::waitForFreeSlotThenRelock(FreeSlotCaller caller,
                     (acquiredCount <= mCore->mMaxAcquiredBufferCount)) {
                 return WOULD_BLOCK;
             }
+            mCore->mDequeueWaiters++;
             if (mDequeueTimeout >= 0) {
                 std::cv_status result = mCore->mDequeueCondition.wait_for(lock,
                         std::chrono::nanoseconds(mDequeueTimeout));
+                mCore->mDequeueWaiters--;
                 if (result == std::cv_status::timeout) {
                     return TIMED_OUT;
                 }
             } else {
                 mCore->mDequeueCondition.wait(lock);
+                mCore->mDequeueWaiters--;
             }
         }
     } // while (tryAgain)
@@ -621,7 +673,7 @@ status_t BufferQueueProducer::detachBuffer(int slot) {
         mCore->mActiveBuffers.erase(slot);
         mCore->mFreeSlots.insert(slot);
         mCore->clearBufferSlotLocked(slot);
-        mCore->mDequeueCondition.notify_all();
+        mCore->notifyDequeueWaitersLocked();
         VALIDATE_CONSISTENCY();
         listener = mCore->mConsumerListener;
     }
@@ -955,7 +1007,7 @@ status_t BufferQueueProducer::queueBuffer(int slot,
         }
 
         mCore->mBufferHasBeenQueued = true;
-        mCore->mDequeueCondition.notify_all();
+        mCore->notifyDequeueWaitersLocked();
         mCore->mLastQueuedSlot = slot;
 
         output->width = mCore->mDefaultWidth;
@@ -1080,7 +1132,7 @@ status_t BufferQueueProducer::cancelBuffer(int slot, const sp<Fence>& fence) {
     }
 
     mSlots[slot].mFence = fence;
-    mCore->mDequeueCondition.notify_all();
+    mCore->notifyDequeueWaitersLocked();
     VALIDATE_CONSISTENCY();
 
     return NO_ERROR;
@@ -1305,7 +1357,7 @@ status_t BufferQueueProducer::disconnect(int api, DisconnectMode mode) {
                     mCore->mConnectedApi = BufferQueueCore::NO_CONNECTED_API;
                     mCore->mConnectedPid = -1;
                     mCore->mSidebandStream.clear();
-                    mCore->mDequeueCondition.notify_all();
+                    mCore->notifyDequeueWaitersLocked();
                     listener = mCore->mConsumerListener;
                 } else if (mCore->mConnectedApi == BufferQueueCore::NO_CONNECTED_API) {
                     BQ_LOGE("disconnect: not connected (req=%d)", api);
@@ -1348,6 +1400,16 @@ status_t BufferQueueProducer::setSidebandStream(const sp<NativeHandle>& stream)
 
 void BufferQueueProducer::allocateBuffers(uint32_t width, uint32_t height,
         PixelFormat format, uint64_t usage) {
+    allocateBuffers(width, height, format, usage, false /* replaceStale */);
+}
+
+void BufferQueueProducer::reallocateBuffers(uint32_t width, uint32_t height,
+        PixelFormat format, uint64_t usage) {
+    allocateBuffers(width, height, format, usage, true /* replaceStale */);
+}
+
+void BufferQueueProducer::allocateBuffers(uint32_t width, uint32_t height,
+        PixelFormat format, uint64_t usage, bool replaceStale) {
     ATRACE_CALL();
     while (true) {
         size_t newBufferCount = 0;
@@ -1366,6 +1428,33 @@ void BufferQueueProducer::allocateBuffers(uint32_t width, uint32_t height,
                 return;
             }
 
+            allocWidth = width > 0 ? width : mCore->mDefaultWidth;
+            allocHeight = height > 0 ? height : mCore->mDefaultHeight;
+            allocFormat = format != 0 ? format : mCore->mDefaultBufferFormat;
+            allocUsage = usage | mCore->mConsumerUsageBits;
+            allocName.assign(mCore->mConsumerName.string(), mCore->mConsumerName.size());
+
+            // For reallocateBuffers, once every slot holds a buffer, a free buffer
+            // that would fail dequeueBuffer's reallocation check (typically after a
+            // resize) is dropped so it can be replaced ahead of demand.
+            if (replaceStale && mCore->mFreeSlots.empty()) {
+                for (auto it = mCore->mFreeBuffers.begin(); it != mCore->mFreeBuffers.end();
+                        ++it) {
+                    const int slot = *it;
+                    const sp<GraphicBuffer>& buffer(mSlots[slot].mGraphicBuffer);
+                    if (slot == mCore->mSharedBufferSlot || buffer == nullptr ||
+                            !buffer->needsReallocation(allocWidth, allocHeight, allocFormat,
+                                    BQ_LAYER_COUNT, allocUsage)) {
+                        continue;
+                    }
+                    BQ_LOGV("allocateBuffers: replacing stale buffer in slot %d", slot);
+                    mCore->mFreeBuffers.erase(it);
+                    mCore->clearBufferSlotLocked(slot);
+                    mCore->mFreeSlots.insert(slot);
+                    break;
+                }
+            }
+
             // Only allocate one buffer at a time to reduce risks of overlapping an allocation from
             // both allocateBuffers and dequeueBuffer.
             newBufferCount = mCore->mFreeSlots.empty() ? 0 : 1;
@@ -1373,12 +1462,6 @@ void BufferQueueProducer::allocateBuffers(uint32_t width, uint32_t height,
                 return;
             }
 
-            allocWidth = width > 0 ? width : mCore->mDefaultWidth;
-            allocHeight = height > 0 ? height : mCore->mDefaultHeight;
-            allocFormat = format != 0 ? format : mCore->mDefaultBufferFormat;
-            allocUsage = usage | mCore->mConsumerUsageBits;
-            allocName.assign(mCore->mConsumerName.string(), mCore->mConsumerName.size());
-
             mCore->mIsAllocating = true;
         } // Autolock scope
 
@@ -1564,6 +1647,21 @@ void BufferQueueProducer::getFrameTimestamps(FrameEventHistoryDelta* outDelta) {
     addAndGetFrameTimestamps(nullptr, outDelta);
 }
 
+status_t BufferQueueProducer::getSharedFrameEvents(base::unique_fd* outFd) {
+    ATRACE_CALL();
+    BQ_LOGV("getSharedFrameEvents");
+    sp<IConsumerListener> listener;
+    {
+        std::lock_guard<std::mutex> lock(mCore->mMutex);
+        listener = mCore->mConsumerListener;
+    }
+    if (listener == nullptr) {
+        return NO_INIT;
+    }
+    *outFd = listener->getSharedFrameEvents();
+    return outFd->ok() ? NO_ERROR : INVALID_OPERATION;
+}
+
 void BufferQueueProducer::addAndGetFrameTimestamps(
         const NewFrameEventsEntry* newTimestamps,
         FrameEventHistoryDelta* outDelta) {
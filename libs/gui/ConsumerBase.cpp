@@ -352,22 +352,65 @@ status_t ConsumerBase::acquireBufferLocked(BufferItem *item,
         return err;
     }
 
-    if (item->mGraphicBuffer != nullptr) {
-        if (mSlots[item->mSlot].mGraphicBuffer != nullptr) {
-            freeBufferLocked(item->mSlot);
+    updateAcquiredSlotLocked(*item);
+
+    CB_LOGV("acquireBufferLocked: -> slot=%d/%" PRIu64,
+            item->mSlot, item->mFrameNumber);
+
+    return OK;
+}
+
+status_t ConsumerBase::acquireBuffersLocked(uint32_t maxBuffers,
+        nsecs_t presentWhen, std::vector<BufferItem>* items) {
+    if (mAbandoned) {
+        CB_LOGE("acquireBuffersLocked: ConsumerBase is abandoned!");
+        return NO_INIT;
+    }
+
+    std::vector<BufferItem> acquired;
+    status_t err = mConsumer->acquireBuffers(maxBuffers, presentWhen, &acquired);
+    if (err == INVALID_OPERATION) {
+        // Either the BufferQueue can only acquire buffers one at a time, or no
+        // more buffers can be acquired, which acquireBuffer reports again.
+        acquired.clear();
+        while (acquired.size() < maxBuffers) {
+            BufferItem item;
+            err = mConsumer->acquireBuffer(&item, presentWhen);
+            if (err != NO_ERROR) {
+                break;
+            }
+            acquired.push_back(item);
+        }
+        if (!acquired.empty()) {
+            err = NO_ERROR;
         }
-        mSlots[item->mSlot].mGraphicBuffer = item->mGraphicBuffer;
+    }
+    if (err != NO_ERROR) {
+        return err;
     }
 
-    mSlots[item->mSlot].mFrameNumber = item->mFrameNumber;
-    mSlots[item->mSlot].mFence = item->mFence;
+    for (const BufferItem& item : acquired) {
+        updateAcquiredSlotLocked(item);
+        items->push_back(item);
+    }
 
-    CB_LOGV("acquireBufferLocked: -> slot=%d/%" PRIu64,
-            item->mSlot, item->mFrameNumber);
+    CB_LOGV("acquireBuffersLocked: -> %zu buffers", acquired.size());
 
     return OK;
 }
 
+void ConsumerBase::updateAcquiredSlotLocked(const BufferItem& item) {
+    if (item.mGraphicBuffer != nullptr) {
+        if (mSlots[item.mSlot].mGraphicBuffer != nullptr) {
+            freeBufferLocked(item.mSlot);
+        }
+        mSlots[item.mSlot].mGraphicBuffer = item.mGraphicBuffer;
+    }
+
+    mSlots[item.mSlot].mFrameNumber = item.mFrameNumber;
+    mSlots[item.mSlot].mFence = item.mFence;
+}
+
 status_t ConsumerBase::addReleaseFence(int slot,
         const sp<GraphicBuffer> graphicBuffer, const sp<Fence>& fence) {
     Mutex::Autolock lock(mMutex);
@@ -35,6 +35,7 @@ CpuConsumer::CpuConsumer(const sp<IGraphicBufferConsumer>& bq,
         size_t maxLockedBuffers, bool controlledByApp) :
     ConsumerBase(bq, controlledByApp),
     mMaxLockedBuffers(maxLockedBuffers),
+    mPersistentMapping(false),
     mCurrentLockedBuffers(0)
 {
     // Create tracking entries for locked buffers
@@ -87,7 +88,8 @@ static bool isPossiblyYUV(PixelFormat format) {
     }
 }
 
-status_t CpuConsumer::lockBufferItem(const BufferItem& item, LockedBuffer* outBuffer) const {
+status_t CpuConsumer::lockBufferItem(const BufferItem& item, const Rect& rect,
+                                     LockedBuffer* outBuffer) const {
     android_ycbcr ycbcr = android_ycbcr();
 
     PixelFormat format = item.mGraphicBuffer->getPixelFormat();
@@ -95,7 +97,7 @@ status_t CpuConsumer::lockBufferItem(const BufferItem& item, LockedBuffer* outBu
     if (isPossiblyYUV(format)) {
         int fenceFd = item.mFence.get() ? item.mFence->dup() : -1;
         status_t err = item.mGraphicBuffer->lockAsyncYCbCr(GraphicBuffer::USAGE_SW_READ_OFTEN,
-                                                           item.mCrop, &ycbcr, fenceFd);
+                                                           rect, &ycbcr, fenceFd);
         if (err == OK) {
             flexFormat = HAL_PIXEL_FORMAT_YCbCr_420_888;
             if (format != HAL_PIXEL_FORMAT_YCbCr_420_888) {
@@ -119,7 +121,7 @@ status_t CpuConsumer::lockBufferItem(const BufferItem& item, LockedBuffer* outBu
         void* bufferPointer = nullptr;
         int fenceFd = item.mFence.get() ? item.mFence->dup() : -1;
         status_t err = item.mGraphicBuffer->lockAsync(GraphicBuffer::USAGE_SW_READ_OFTEN,
-                                                      item.mCrop, &bufferPointer, fenceFd);
+                                                      rect, &bufferPointer, fenceFd);
         if (err != OK) {
             CC_LOGE("Unable to lock buffer for CPU reading: %s (%d)", strerror(-err), err);
             return err;
@@ -148,12 +150,59 @@ status_t CpuConsumer::lockBufferItem(const BufferItem& item, LockedBuffer* outBu
     return OK;
 }
 
-status_t CpuConsumer::lockNextBuffer(LockedBuffer *nativeBuffer) {
-    status_t err;
+status_t CpuConsumer::mapBufferItemLocked(const BufferItem& item, LockedBuffer* outBuffer) {
+    if (!mPersistentMapping) {
+        return lockBufferItem(item, item.mCrop, outBuffer);
+    }
 
-    if (!nativeBuffer) return BAD_VALUE;
+    MappedBuffer& mapped = mMappedBuffers[item.mSlot];
+    if (mapped.mGraphicBuffer != item.mGraphicBuffer) {
+        clearMappedBufferLocked(item.mSlot);
 
-    Mutex::Autolock _l(mMutex);
+        // The mapping outlives this frame's crop, so map the whole buffer.
+        const Rect bounds(item.mGraphicBuffer->getWidth(), item.mGraphicBuffer->getHeight());
+        status_t err = lockBufferItem(item, bounds, outBuffer);
+        if (err != OK) {
+            return err;
+        }
+        mapped.mGraphicBuffer = item.mGraphicBuffer;
+        mapped.mMapping = *outBuffer;
+    } else {
+        // The buffer is still mapped; only wait for the producer to finish.
+        if (item.mFence.get()) {
+            status_t err = item.mFence->waitForever("CpuConsumer::mapBufferItemLocked");
+            if (err != OK) {
+                CC_LOGE("Failed to wait for buffer fence: %s (%d)", strerror(-err), err);
+                return err;
+            }
+        }
+
+        const LockedBuffer& mapping = mapped.mMapping;
+        outBuffer->data = mapping.data;
+        outBuffer->stride = mapping.stride;
+        outBuffer->dataCb = mapping.dataCb;
+        outBuffer->dataCr = mapping.dataCr;
+        outBuffer->chromaStride = mapping.chromaStride;
+        outBuffer->chromaStep = mapping.chromaStep;
+        outBuffer->width = mapping.width;
+        outBuffer->height = mapping.height;
+        outBuffer->format = mapping.format;
+        outBuffer->flexFormat = mapping.flexFormat;
+    }
+    mapped.mAcquired = true;
+
+    outBuffer->crop = item.mCrop;
+    outBuffer->transform = item.mTransform;
+    outBuffer->scalingMode = item.mScalingMode;
+    outBuffer->timestamp = item.mTimestamp;
+    outBuffer->dataSpace = item.mDataSpace;
+    outBuffer->frameNumber = item.mFrameNumber;
+
+    return OK;
+}
+
+status_t CpuConsumer::lockNextBufferLocked(LockedBuffer* nativeBuffer, size_t* outIdx) {
+    status_t err;
 
     if (mCurrentLockedBuffers == mMaxLockedBuffers) {
         CC_LOGW("Max buffers have been locked (%zd), cannot lock anymore.",
@@ -176,7 +225,7 @@ status_t CpuConsumer::lockNextBuffer(LockedBuffer *nativeBuffer) {
         b.mGraphicBuffer = mSlots[b.mSlot].mGraphicBuffer;
     }
 
-    err = lockBufferItem(b, nativeBuffer);
+    err = mapBufferItemLocked(b, nativeBuffer);
     if (err != OK) {
         return err;
     }
@@ -192,9 +241,59 @@ status_t CpuConsumer::lockNextBuffer(LockedBuffer *nativeBuffer) {
 
     mCurrentLockedBuffers++;
 
+    *outIdx = lockedIdx;
     return OK;
 }
 
+status_t CpuConsumer::lockNextBuffer(LockedBuffer *nativeBuffer) {
+    if (!nativeBuffer) return BAD_VALUE;
+
+    Mutex::Autolock _l(mMutex);
+
+    size_t lockedIdx;
+    return lockNextBufferLocked(nativeBuffer, &lockedIdx);
+}
+
+status_t CpuConsumer::lockNextBufferView(std::shared_ptr<const LockedBuffer>* outBuffer) {
+    if (!outBuffer) return BAD_VALUE;
+
+    Mutex::Autolock _l(mMutex);
+
+    auto buffer = std::make_unique<LockedBuffer>();
+    size_t lockedIdx;
+    status_t err = lockNextBufferLocked(buffer.get(), &lockedIdx);
+    if (err != OK) {
+        return err;
+    }
+
+    AcquiredBuffer& ab = mAcquiredBuffers.editItemAt(lockedIdx);
+    ab.mIsView = true;
+
+    // The view keeps the buffer alive, so that its memory stays valid even if
+    // the consumer goes away first, in which case the view unlocks it itself.
+    wp<CpuConsumer> weakThis(this);
+    sp<GraphicBuffer> graphicBuffer = ab.mGraphicBuffer;
+    *outBuffer = std::shared_ptr<const LockedBuffer>(buffer.release(),
+            [weakThis, graphicBuffer, lockedIdx](const LockedBuffer* lockedBuffer) {
+                sp<CpuConsumer> consumer = weakThis.promote();
+                if (consumer != nullptr) {
+                    consumer->releaseView(lockedIdx);
+                } else {
+                    graphicBuffer->unlock();
+                }
+                delete lockedBuffer;
+            });
+
+    return OK;
+}
+
+void CpuConsumer::releaseView(size_t lockedIdx) {
+    Mutex::Autolock _l(mMutex);
+
+    ALOG_ASSERT(mAcquiredBuffers[lockedIdx].mIsView);
+    releaseAcquiredBufferLocked(lockedIdx);
+}
+
 status_t CpuConsumer::unlockBuffer(const LockedBuffer &nativeBuffer) {
     Mutex::Autolock _l(mMutex);
 
@@ -205,18 +304,38 @@ status_t CpuConsumer::unlockBuffer(const LockedBuffer &nativeBuffer) {
         CC_LOGE("%s: Can't find buffer to free", __FUNCTION__);
         return BAD_VALUE;
     }
+    if (mAcquiredBuffers[lockedIdx].mIsView) {
+        CC_LOGE("%s: Buffer is a view, drop it instead", __FUNCTION__);
+        return BAD_VALUE;
+    }
 
+    return releaseAcquiredBufferLocked(lockedIdx);
+}
+
+status_t CpuConsumer::releaseAcquiredBufferLocked(size_t lockedIdx) {
     AcquiredBuffer& ab = mAcquiredBuffers.editItemAt(lockedIdx);
 
-    int fenceFd = -1;
-    status_t err = ab.mGraphicBuffer->unlockAsync(&fenceFd);
-    if (err != OK) {
-        CC_LOGE("%s: Unable to unlock graphic buffer %zd", __FUNCTION__,
-                lockedIdx);
-        return err;
+    sp<Fence> fence = Fence::NO_FENCE;
+    MappedBuffer* mapped = mPersistentMapping && ab.mSlot != BufferQueue::INVALID_BUFFER_SLOT
+            ? &mMappedBuffers[ab.mSlot]
+            : nullptr;
+    if (mapped != nullptr && mapped->mGraphicBuffer == ab.mGraphicBuffer) {
+        // Keep the buffer mapped. The consumer is done reading it, so there
+        // is nothing for the producer to wait for.
+        mapped->mAcquired = false;
+    } else {
+        int fenceFd = -1;
+        status_t err = ab.mGraphicBuffer->unlockAsync(&fenceFd);
+        if (err != OK) {
+            CC_LOGE("%s: Unable to unlock graphic buffer %zd", __FUNCTION__,
+                    lockedIdx);
+            return err;
+        }
+        if (fenceFd >= 0) {
+            fence = new Fence(fenceFd);
+        }
     }
 
-    sp<Fence> fence(fenceFd >= 0 ? new Fence(fenceFd) : Fence::NO_FENCE);
     addReleaseFenceLocked(ab.mSlot, ab.mGraphicBuffer, fence);
     releaseBufferLocked(ab.mSlot, ab.mGraphicBuffer);
 
@@ -227,4 +346,39 @@ status_t CpuConsumer::unlockBuffer(const LockedBuffer &nativeBuffer) {
     return OK;
 }
 
+status_t CpuConsumer::setPersistentMapping(bool enabled) {
+    Mutex::Autolock _l(mMutex);
+
+    if (mAbandoned) {
+        CC_LOGE("setPersistentMapping: CpuConsumer is abandoned!");
+        return NO_INIT;
+    }
+
+    if (!enabled) {
+        for (int i = 0; i < BufferQueue::NUM_BUFFER_SLOTS; i++) {
+            clearMappedBufferLocked(i);
+        }
+    }
+    mPersistentMapping = enabled;
+    return OK;
+}
+
+void CpuConsumer::clearMappedBufferLocked(int slot) {
+    MappedBuffer& mapped = mMappedBuffers[slot];
+    if (mapped.mGraphicBuffer != nullptr && !mapped.mAcquired) {
+        status_t err = mapped.mGraphicBuffer->unlock();
+        if (err != OK) {
+            CC_LOGE("%s: Unable to unlock graphic buffer in slot %d", __FUNCTION__, slot);
+        }
+    }
+    // An acquired buffer no longer matches its slot, so releasing it unlocks it.
+    mapped.mGraphicBuffer.clear();
+    mapped.mAcquired = false;
+}
+
+void CpuConsumer::freeBufferLocked(int slotIndex) {
+    clearMappedBufferLocked(slotIndex);
+    ConsumerBase::freeBufferLocked(slotIndex);
+}
+
 } // namespace android
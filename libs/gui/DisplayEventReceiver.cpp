@@ -25,6 +25,7 @@
 #include <private/gui/ComposerService.h>
 
 #include <private/gui/BitTube.h>
+#include <private/gui/VsyncTimeline.h>
 
 // ---------------------------------------------------------------------------
 
@@ -79,6 +80,58 @@ status_t DisplayEventReceiver::requestNextVsync() {
     return NO_INIT;
 }
 
+status_t DisplayEventReceiver::setWorkDuration(nsecs_t workDuration) {
+    if (workDuration < 0)
+        return BAD_VALUE;
+
+    if (mEventConnection != nullptr) {
+        return mEventConnection->setWorkDuration(workDuration);
+    }
+    return NO_INIT;
+}
+
+status_t DisplayEventReceiver::useVsyncTimeline(bool muteVSyncEvents) {
+    if (mEventConnection == nullptr) {
+        return NO_INIT;
+    }
+
+    auto timeline = std::make_unique<gui::VsyncTimeline>();
+    status_t err = mEventConnection->getVsyncTimeline(timeline.get(), muteVSyncEvents);
+    if (err != NO_ERROR) {
+        return err;
+    }
+    // Keep the existing mapping, which may be in use.
+    if (mVsyncTimeline == nullptr) {
+        mVsyncTimeline = std::move(timeline);
+    }
+    return NO_ERROR;
+}
+
+status_t DisplayEventReceiver::getLatestVsync(nsecs_t* outTimestamp, uint32_t* outCount,
+                                              nsecs_t* outPeriod) const {
+    if (mVsyncTimeline == nullptr) {
+        return NO_INIT;
+    }
+
+    gui::VsyncTimeline::Vsync vsync;
+    status_t err = mVsyncTimeline->read(&vsync);
+    if (err != NO_ERROR) {
+        return err;
+    }
+    *outTimestamp = vsync.timestamp;
+    *outCount = vsync.count;
+    *outPeriod = vsync.period;
+    return NO_ERROR;
+}
+
+status_t DisplayEventReceiver::waitForVsync(uint32_t afterCount, nsecs_t timeout) {
+    if (mVsyncTimeline == nullptr) {
+        return NO_INIT;
+    }
+
+    gui::VsyncTimeline::Vsync vsync;
+    return mVsyncTimeline->waitForVsync(afterCount, timeout, &vsync);
+}
 
 ssize_t DisplayEventReceiver::getEvents(DisplayEventReceiver::Event* events,
         size_t count) {
@@ -19,8 +19,11 @@
 #define LOG_TAG "FrameEvents"
 
 #include <android-base/stringprintf.h>
+#include <cutils/ashmem.h>
 #include <cutils/compiler.h>  // For CC_[UN]LIKELY
+#include <fcntl.h>
 #include <inttypes.h>
+#include <sys/mman.h>
 #include <utils/Log.h>
 
 #include <algorithm>
@@ -226,7 +229,11 @@ void FrameEventHistory::dump(std::string& outString) const {
 // ProducerFrameEventHistory
 // ============================================================================
 
-ProducerFrameEventHistory::~ProducerFrameEventHistory() = default;
+ProducerFrameEventHistory::~ProducerFrameEventHistory() {
+    if (mSharedEvents != nullptr) {
+        munmap(const_cast<SharedFrameEvents*>(mSharedEvents), sizeof(SharedFrameEvents));
+    }
+}
 
 nsecs_t ProducerFrameEventHistory::snapToNextTick(
         nsecs_t timestamp, nsecs_t tickPhase, nsecs_t tickInterval) {
@@ -307,10 +314,8 @@ void ProducerFrameEventHistory::applyDelta(
 }
 
 void ProducerFrameEventHistory::updateSignalTimes() {
-    mAcquireTimeline.updateSignalTimes();
-    mGpuCompositionDoneTimeline.updateSignalTimes();
-    mPresentTimeline.updateSignalTimes();
-    mReleaseTimeline.updateSignalTimes();
+    FenceTimeline::updateSignalTimes({&mAcquireTimeline, &mGpuCompositionDoneTimeline,
+                                      &mPresentTimeline, &mReleaseTimeline});
 }
 
 void ProducerFrameEventHistory::applyFenceDelta(FenceTimeline* timeline,
@@ -324,7 +329,9 @@ void ProducerFrameEventHistory::applyFenceDelta(FenceTimeline* timeline,
         case FenceTime::Snapshot::State::EMPTY:
             return;
         case FenceTime::Snapshot::State::FENCE:
-            ALOGE_IF((*dst)->isValid(), "applyFenceDelta: Unexpected fence.");
+            // With shared events, the signal time may have arrived first.
+            ALOGE_IF((*dst)->isValid() && mSharedEvents == nullptr,
+                     "applyFenceDelta: Unexpected fence.");
             *dst = createFenceTime(src.fence);
             timeline->push(*dst);
             return;
@@ -343,21 +350,130 @@ std::shared_ptr<FenceTime> ProducerFrameEventHistory::createFenceTime(
     return std::make_shared<FenceTime>(fence);
 }
 
+status_t ProducerFrameEventHistory::setSharedEvents(base::unique_fd fd) {
+    if (ashmem_get_size_region(fd) < static_cast<int>(sizeof(SharedFrameEvents))) {
+        ALOGE("setSharedEvents: Bad shared memory region.");
+        return BAD_VALUE;
+    }
+    void* mapping = mmap(nullptr, sizeof(SharedFrameEvents), PROT_READ, MAP_SHARED, fd, 0);
+    if (mapping == MAP_FAILED) {
+        status_t err = -errno;
+        ALOGE("setSharedEvents: Failed to map shared events: %s (%d)", strerror(-err), err);
+        return err;
+    }
+
+    if (mSharedEvents != nullptr) {
+        munmap(const_cast<SharedFrameEvents*>(mSharedEvents), sizeof(SharedFrameEvents));
+    }
+    mSharedEvents = static_cast<const SharedFrameEvents*>(mapping);
+    return NO_ERROR;
+}
+
+bool ProducerFrameEventHistory::applySharedEvents() {
+    if (mSharedEvents == nullptr) {
+        return false;
+    }
+
+    // The consumer only holds the sequence odd for a few stores, so a handful
+    // of attempts is enough unless it is preempted mid-update.
+    constexpr int kMaxReadAttempts = 4;
+    SharedFrameEvents::Data data;
+    bool consistent = false;
+    for (int attempt = 0; attempt < kMaxReadAttempts && !consistent; attempt++) {
+        const uint32_t sequence = mSharedEvents->sequence.load(std::memory_order_acquire);
+        if (sequence & 1) {
+            continue;
+        }
+        memcpy(&data, &mSharedEvents->data, sizeof(data));
+        std::atomic_thread_fence(std::memory_order_acquire);
+        consistent = mSharedEvents->sequence.load(std::memory_order_relaxed) == sequence;
+    }
+    if (!consistent) {
+        return false;
+    }
+
+    mCompositorTiming = data.compositorTiming;
+
+    bool upToDate = true;
+    for (size_t i = 0; i < mFrames.size(); i++) {
+        const SharedFrameEvents::Frame& shared = data.frames[i];
+        FrameEvents& frame = mFrames[i];
+        // New frames are added by queueBuffer, so only the frames the
+        // producer already knows of are updated here.
+        if (!shared.valid || !frame.valid || frame.frameNumber != shared.frameNumber) {
+            continue;
+        }
+
+        frame.postedTime = shared.postedTime;
+        frame.requestedPresentTime = shared.requestedPresentTime;
+        frame.latchTime = shared.latchTime;
+        frame.firstRefreshStartTime = shared.firstRefreshStartTime;
+        frame.lastRefreshStartTime = shared.lastRefreshStartTime;
+        frame.dequeueReadyTime = shared.dequeueReadyTime;
+
+        // A fence whose signal time is still pending consumer side is only
+        // known if the producer got the fence itself. Until then, the frame is
+        // left looking as if the consumer had not reached that point yet.
+        const bool gpuCompositionDoneKnown = applySharedSignalTime(
+                &frame.gpuCompositionDoneFence, shared.gpuCompositionDoneTime);
+        const bool displayPresentKnown = applySharedSignalTime(
+                &frame.displayPresentFence, shared.displayPresentTime);
+        if (shared.addPostCompositeCalled) {
+            if (gpuCompositionDoneKnown && displayPresentKnown) {
+                frame.addPostCompositeCalled = true;
+            } else {
+                upToDate = false;
+            }
+        }
+        if (shared.addReleaseCalled) {
+            if (applySharedSignalTime(&frame.releaseFence, shared.releaseTime)) {
+                frame.addReleaseCalled = true;
+            } else {
+                upToDate = false;
+            }
+        }
+    }
+    return upToDate;
+}
+
+bool ProducerFrameEventHistory::applySharedSignalTime(std::shared_ptr<FenceTime>* dst,
+                                                      nsecs_t signalTime) {
+    if (signalTime == Fence::SIGNAL_TIME_PENDING) {
+        return (*dst)->isValid();
+    }
+    if (signalTime == Fence::SIGNAL_TIME_INVALID) {
+        // There is no fence.
+        return true;
+    }
+    if ((*dst)->isValid()) {
+        (*dst)->applyTrustedSnapshot(FenceTime::Snapshot(signalTime));
+    } else {
+        *dst = std::make_shared<FenceTime>(signalTime);
+    }
+    return true;
+}
+
 
 // ============================================================================
 // ConsumerFrameEventHistory
 // ============================================================================
 
-ConsumerFrameEventHistory::~ConsumerFrameEventHistory() = default;
+ConsumerFrameEventHistory::~ConsumerFrameEventHistory() {
+    if (mSharedEvents != nullptr) {
+        munmap(mSharedEvents, sizeof(SharedFrameEvents));
+    }
+}
 
 void ConsumerFrameEventHistory::onDisconnect() {
     mCurrentConnectId++;
     mProducerWantsEvents = false;
+    publishSharedEvents();
 }
 
 void ConsumerFrameEventHistory::initializeCompositorTiming(
         const CompositorTiming& compositorTiming) {
     mCompositorTiming = compositorTiming;
+    publishSharedEvents();
 }
 
 void ConsumerFrameEventHistory::addQueue(const NewFrameEventsEntry& newEntry) {
@@ -377,6 +493,7 @@ void ConsumerFrameEventHistory::addQueue(const NewFrameEventsEntry& newEntry) {
     mFramesDirty[mQueueOffset].setDirty<FrameEvent::POSTED>();
 
     mQueueOffset = (mQueueOffset + 1) % mFrames.size();
+    publishSharedEvents();
 }
 
 void ConsumerFrameEventHistory::addLatch(
@@ -388,6 +505,7 @@ void ConsumerFrameEventHistory::addLatch(
     }
     frame->latchTime = latchTime;
     mFramesDirty[mCompositionOffset].setDirty<FrameEvent::LATCH>();
+    publishSharedEvents();
 }
 
 void ConsumerFrameEventHistory::addPreComposition(
@@ -404,6 +522,7 @@ void ConsumerFrameEventHistory::addPreComposition(
         frame->firstRefreshStartTime = refreshStartTime;
         mFramesDirty[mCompositionOffset].setDirty<FrameEvent::FIRST_REFRESH_START>();
     }
+    publishSharedEvents();
 }
 
 void ConsumerFrameEventHistory::addPostComposition(uint64_t frameNumber,
@@ -412,10 +531,13 @@ void ConsumerFrameEventHistory::addPostComposition(uint64_t frameNumber,
         const CompositorTiming& compositorTiming) {
     mCompositorTiming = compositorTiming;
 
+    // Publish even without a frame, since the compositor timing changed and
+    // the fences of earlier frames have often signaled since.
     FrameEvents* frame = getFrame(frameNumber, &mCompositionOffset);
     if (frame == nullptr) {
         ALOGE_IF(mProducerWantsEvents,
                 "addPostComposition: Did not find frame.");
+        publishSharedEvents();
         return;
     }
     // Only get GPU and present info for the first composite.
@@ -428,6 +550,7 @@ void ConsumerFrameEventHistory::addPostComposition(uint64_t frameNumber,
             mFramesDirty[mCompositionOffset].setDirty<FrameEvent::DISPLAY_PRESENT>();
         }
     }
+    publishSharedEvents();
 }
 
 void ConsumerFrameEventHistory::addRelease(uint64_t frameNumber,
@@ -441,6 +564,70 @@ void ConsumerFrameEventHistory::addRelease(uint64_t frameNumber,
     frame->dequeueReadyTime = dequeueReadyTime;
     frame->releaseFence = std::move(release);
     mFramesDirty[mReleaseOffset].setDirty<FrameEvent::RELEASE>();
+    publishSharedEvents();
+}
+
+base::unique_fd ConsumerFrameEventHistory::getSharedEvents() {
+    if (mSharedEvents == nullptr) {
+        base::unique_fd fd(ashmem_create_region("FrameEvents", sizeof(SharedFrameEvents)));
+        if (fd < 0) {
+            ALOGE("getSharedEvents: Failed to create shared memory.");
+            return {};
+        }
+        void* mapping = mmap(nullptr, sizeof(SharedFrameEvents), PROT_READ | PROT_WRITE,
+                             MAP_SHARED, fd, 0);
+        if (mapping == MAP_FAILED) {
+            ALOGE("getSharedEvents: Failed to map shared memory: %s", strerror(errno));
+            return {};
+        }
+        // Producers may only read the events.
+        if (ashmem_set_prot_region(fd, PROT_READ) < 0) {
+            ALOGE("getSharedEvents: Failed to protect shared memory.");
+            munmap(mapping, sizeof(SharedFrameEvents));
+            return {};
+        }
+        mSharedEvents = new (mapping) SharedFrameEvents{};
+        mSharedEventsFd = std::move(fd);
+        publishSharedEvents();
+    }
+    return base::unique_fd(fcntl(mSharedEventsFd, F_DUPFD_CLOEXEC, 0));
+}
+
+static nsecs_t getSharedSignalTime(const std::shared_ptr<FenceTime>& fence) {
+    return fence->isValid() ? fence->getCachedSignalTime() : Fence::SIGNAL_TIME_INVALID;
+}
+
+void ConsumerFrameEventHistory::publishSharedEvents() {
+    if (mSharedEvents == nullptr) {
+        return;
+    }
+
+    const uint32_t sequence = mSharedEvents->sequence.load(std::memory_order_relaxed);
+    mSharedEvents->sequence.store(sequence + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+
+    SharedFrameEvents::Data& data = mSharedEvents->data;
+    data.compositorTiming = mCompositorTiming;
+    for (size_t i = 0; i < mFrames.size(); i++) {
+        const FrameEvents& frame = mFrames[i];
+        SharedFrameEvents::Frame& shared = data.frames[i];
+        // As with deltas, only the current connection's frames are shared.
+        shared.valid = frame.valid && frame.connectId == mCurrentConnectId;
+        shared.frameNumber = frame.frameNumber;
+        shared.addPostCompositeCalled = frame.addPostCompositeCalled;
+        shared.addReleaseCalled = frame.addReleaseCalled;
+        shared.postedTime = frame.postedTime;
+        shared.requestedPresentTime = frame.requestedPresentTime;
+        shared.latchTime = frame.latchTime;
+        shared.firstRefreshStartTime = frame.firstRefreshStartTime;
+        shared.lastRefreshStartTime = frame.lastRefreshStartTime;
+        shared.dequeueReadyTime = frame.dequeueReadyTime;
+        shared.gpuCompositionDoneTime = getSharedSignalTime(frame.gpuCompositionDoneFence);
+        shared.displayPresentTime = getSharedSignalTime(frame.displayPresentFence);
+        shared.releaseTime = getSharedSignalTime(frame.releaseFence);
+    }
+
+    mSharedEvents->sequence.store(sequence + 2, std::memory_order_release);
 }
 
 void ConsumerFrameEventHistory::getFrameDelta(
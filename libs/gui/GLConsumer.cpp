@@ -324,18 +324,31 @@ sp<GraphicBuffer> GLConsumer::getDebugTexImageBuffer() {
 
 status_t GLConsumer::acquireBufferLocked(BufferItem *item,
         nsecs_t presentWhen, uint64_t maxFrameNumber) {
+    mKeepFreedEglImage = true;
     status_t err = ConsumerBase::acquireBufferLocked(item, presentWhen,
             maxFrameNumber);
+    mKeepFreedEglImage = false;
+    sp<EglImage> freedImage = mFreedEglImage;
+    mFreedEglImage.clear();
     if (err != NO_ERROR) {
         return err;
     }
 
     // If item->mGraphicBuffer is not null, this buffer has not been acquired
-    // before, so any prior EglImage created is using a stale buffer. This
-    // replaces any old EglImage with a new one (using the new buffer).
+    // before, so any prior EglImage created may be using a stale buffer. This
+    // replaces any old EglImage with a new one (using the new buffer), unless
+    // the buffer was only detached and attached back to its slot, as the
+    // outputs of a StreamSplitter are on every frame. Creating an EGLImage is
+    // expensive, so the one of that buffer is kept.
     if (item->mGraphicBuffer != nullptr) {
         int slot = item->mSlot;
-        mEglSlots[slot].mEglImage = new EglImage(item->mGraphicBuffer);
+        if (freedImage != nullptr &&
+                freedImage->graphicBuffer()->getId() ==
+                        item->mGraphicBuffer->getId()) {
+            mEglSlots[slot].mEglImage = freedImage;
+        } else {
+            mEglSlots[slot].mEglImage = new EglImage(item->mGraphicBuffer);
+        }
     }
 
     return NO_ERROR;
@@ -857,7 +870,13 @@ status_t GLConsumer::doGLFenceWaitLocked() const {
         return INVALID_OPERATION;
     }
 
-    if (mCurrentFence->isValid()) {
+    // A fence that already signaled needs no waiting, which saves importing it
+    // into an EGLSyncKHR for the GPU to wait on, or waiting on it here.
+    const nsecs_t signalTime = mCurrentFenceTime->getSignalTime();
+    const bool signaled = signalTime != Fence::SIGNAL_TIME_PENDING &&
+            signalTime != Fence::SIGNAL_TIME_INVALID;
+
+    if (mCurrentFence->isValid() && !signaled) {
         if (SyncFeatures::getInstance().useWaitSync() &&
             SyncFeatures::getInstance().useNativeFenceSync()) {
             // Create an EGLSyncKHR from the current fence.
@@ -908,6 +927,9 @@ void GLConsumer::freeBufferLocked(int slotIndex) {
     if (slotIndex == mCurrentTexture) {
         mCurrentTexture = BufferQueue::INVALID_BUFFER_SLOT;
     }
+    if (mKeepFreedEglImage) {
+        mFreedEglImage = mEglSlots[slotIndex].mEglImage;
+    }
     mEglSlots[slotIndex].mEglImage.clear();
     ConsumerBase::freeBufferLocked(slotIndex);
 }
@@ -17,6 +17,7 @@
 #include <gui/IDisplayEventConnection.h>
 
 #include <private/gui/BitTube.h>
+#include <private/gui/VsyncTimeline.h>
 
 namespace android {
 
@@ -26,7 +27,9 @@ enum class Tag : uint32_t {
     STEAL_RECEIVE_CHANNEL = IBinder::FIRST_CALL_TRANSACTION,
     SET_VSYNC_RATE,
     REQUEST_NEXT_VSYNC,
-    LAST = REQUEST_NEXT_VSYNC,
+    SET_WORK_DURATION,
+    GET_VSYNC_TIMELINE,
+    LAST = GET_VSYNC_TIMELINE,
 };
 
 } // Anonymous namespace
@@ -53,6 +56,16 @@ public:
         callRemoteAsync<decltype(&IDisplayEventConnection::requestNextVsync)>(
                 Tag::REQUEST_NEXT_VSYNC);
     }
+
+    status_t setWorkDuration(nsecs_t workDuration) override {
+        return callRemote<decltype(&IDisplayEventConnection::setWorkDuration)>(
+                Tag::SET_WORK_DURATION, workDuration);
+    }
+
+    status_t getVsyncTimeline(gui::VsyncTimeline* outTimeline, bool muteVSyncEvents) override {
+        return callRemote<decltype(&IDisplayEventConnection::getVsyncTimeline)>(
+                Tag::GET_VSYNC_TIMELINE, outTimeline, muteVSyncEvents);
+    }
 };
 
 // Out-of-line virtual method definition to trigger vtable emission in this translation unit (see
@@ -74,6 +87,10 @@ status_t BnDisplayEventConnection::onTransact(uint32_t code, const Parcel& data,
             return callLocal(data, reply, &IDisplayEventConnection::setVsyncRate);
         case Tag::REQUEST_NEXT_VSYNC:
             return callLocalAsync(data, reply, &IDisplayEventConnection::requestNextVsync);
+        case Tag::SET_WORK_DURATION:
+            return callLocal(data, reply, &IDisplayEventConnection::setWorkDuration);
+        case Tag::GET_VSYNC_TIMELINE:
+            return callLocal(data, reply, &IDisplayEventConnection::getVsyncTimeline);
     }
 }
 
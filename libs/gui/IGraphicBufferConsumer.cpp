@@ -52,7 +52,8 @@ enum class Tag : uint32_t {
     GET_OCCUPANCY_HISTORY,
     DISCARD_FREE_BUFFERS,
     DUMP_STATE,
-    LAST = DUMP_STATE,
+    ACQUIRE_BUFFERS,
+    LAST = ACQUIRE_BUFFERS,
 };
 
 } // Anonymous namespace
@@ -70,6 +71,12 @@ public:
         return callRemote<Signature>(Tag::ACQUIRE_BUFFER, buffer, presentWhen, maxFrameNumber);
     }
 
+    status_t acquireBuffers(uint32_t maxBuffers, nsecs_t presentWhen,
+                            std::vector<BufferItem>* outBuffers) override {
+        using Signature = decltype(&IGraphicBufferConsumer::acquireBuffers);
+        return callRemote<Signature>(Tag::ACQUIRE_BUFFERS, maxBuffers, presentWhen, outBuffers);
+    }
+
     status_t detachBuffer(int slot) override {
         using Signature = decltype(&IGraphicBufferConsumer::detachBuffer);
         return callRemote<Signature>(Tag::DETACH_BUFFER, slot);
@@ -175,6 +182,11 @@ BpGraphicBufferConsumer::~BpGraphicBufferConsumer() = default;
 
 IMPLEMENT_META_INTERFACE(GraphicBufferConsumer, "android.gui.IGraphicBufferConsumer");
 
+status_t IGraphicBufferConsumer::acquireBuffers(uint32_t /*maxBuffers*/, nsecs_t /*presentWhen*/,
+                                                std::vector<BufferItem>* /*outBuffers*/) {
+    return INVALID_OPERATION;
+}
+
 status_t BnGraphicBufferConsumer::onTransact(uint32_t code, const Parcel& data, Parcel* reply,
                                              uint32_t flags) {
     if (code < IBinder::FIRST_CALL_TRANSACTION || code > static_cast<uint32_t>(Tag::LAST)) {
@@ -224,6 +236,8 @@ status_t BnGraphicBufferConsumer::onTransact(uint32_t code, const Parcel& data,
             using Signature = status_t (IGraphicBufferConsumer::*)(const String8&, String8*) const;
             return callLocal<Signature>(data, reply, &IGraphicBufferConsumer::dumpState);
         }
+        case Tag::ACQUIRE_BUFFERS:
+            return callLocal(data, reply, &IGraphicBufferConsumer::acquireBuffers);
     }
 }
 
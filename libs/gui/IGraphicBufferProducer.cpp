@@ -73,6 +73,9 @@ enum {
     GET_UNIQUE_ID,
     GET_CONSUMER_USAGE,
     SET_LEGACY_BUFFER_DROP,
+    GET_SHARED_FRAME_EVENTS,
+    REQUEST_BUFFERS,
+    REALLOCATE_BUFFERS,
 };
 
 class BpGraphicBufferProducer : public BpInterface<IGraphicBufferProducer>
@@ -106,6 +109,36 @@ public:
         return result;
     }
 
+    virtual status_t requestBuffers(int slot, std::vector<RequestBufferOutput>* outBuffers) {
+        Parcel data, reply;
+        data.writeInterfaceToken(IGraphicBufferProducer::getInterfaceDescriptor());
+        data.writeInt32(slot);
+        status_t result = remote()->transact(REQUEST_BUFFERS, data, &reply);
+        if (result != NO_ERROR) {
+            return result;
+        }
+        result = reply.readInt32();
+        if (result != NO_ERROR) {
+            return result;
+        }
+        int32_t count = reply.readInt32();
+        if (count < 0 || count > BufferQueueDefs::NUM_BUFFER_SLOTS) {
+            return BAD_VALUE;
+        }
+        outBuffers->clear();
+        outBuffers->reserve(count);
+        for (int32_t i = 0; i < count; i++) {
+            RequestBufferOutput output{reply.readInt32(), new GraphicBuffer()};
+            result = reply.read(*output.buffer);
+            if (result != NO_ERROR) {
+                outBuffers->clear();
+                return result;
+            }
+            outBuffers->push_back(std::move(output));
+        }
+        return NO_ERROR;
+    }
+
     virtual status_t setMaxDequeuedBufferCount(int maxDequeuedBuffers) {
         Parcel data, reply;
         data.writeInterfaceToken(
@@ -367,6 +400,21 @@ public:
         }
     }
 
+    virtual void reallocateBuffers(uint32_t width, uint32_t height,
+            PixelFormat format, uint64_t usage) {
+        Parcel data, reply;
+        data.writeInterfaceToken(IGraphicBufferProducer::getInterfaceDescriptor());
+        data.writeUint32(width);
+        data.writeUint32(height);
+        data.writeInt32(static_cast<int32_t>(format));
+        data.writeUint64(usage);
+        status_t result = remote()->transact(REALLOCATE_BUFFERS, data, &reply,
+                IBinder::FLAG_ONEWAY);
+        if (result != NO_ERROR) {
+            ALOGE("reallocateBuffers failed to transact: %d", result);
+        }
+    }
+
     virtual status_t allowAllocation(bool allow) {
         Parcel data, reply;
         data.writeInterfaceToken(IGraphicBufferProducer::getInterfaceDescriptor());
@@ -510,6 +558,21 @@ public:
         }
     }
 
+    virtual status_t getSharedFrameEvents(base::unique_fd* outFd) {
+        Parcel data, reply;
+        data.writeInterfaceToken(IGraphicBufferProducer::getInterfaceDescriptor());
+        status_t result = remote()->transact(GET_SHARED_FRAME_EVENTS, data, &reply);
+        if (result != NO_ERROR) {
+            ALOGE("getSharedFrameEvents failed to transact: %d", result);
+            return result;
+        }
+        status_t actualResult = reply.readInt32();
+        if (actualResult != NO_ERROR) {
+            return actualResult;
+        }
+        return reply.readUniqueFileDescriptor(outFd);
+    }
+
     virtual status_t getUniqueId(uint64_t* outId) const {
         Parcel data, reply;
         data.writeInterfaceToken(IGraphicBufferProducer::getInterfaceDescriptor());
@@ -564,6 +627,10 @@ public:
         return mBase->requestBuffer(slot, buf);
     }
 
+    status_t requestBuffers(int slot, std::vector<RequestBufferOutput>* outBuffers) override {
+        return mBase->requestBuffers(slot, outBuffers);
+    }
+
     status_t setMaxDequeuedBufferCount(int maxDequeuedBuffers) override {
         return mBase->setMaxDequeuedBufferCount(maxDequeuedBuffers);
     }
@@ -628,6 +695,11 @@ public:
         return mBase->allocateBuffers(width, height, format, usage);
     }
 
+    void reallocateBuffers(uint32_t width, uint32_t height,
+            PixelFormat format, uint64_t usage) override {
+        return mBase->reallocateBuffers(width, height, format, usage);
+    }
+
     status_t allowAllocation(bool allow) override {
         return mBase->allowAllocation(allow);
     }
@@ -668,6 +740,10 @@ public:
         return mBase->getFrameTimestamps(outDelta);
     }
 
+    status_t getSharedFrameEvents(base::unique_fd* outFd) override {
+        return mBase->getSharedFrameEvents(outFd);
+    }
+
     status_t getUniqueId(uint64_t* outId) const override {
         return mBase->getUniqueId(outId);
     }
@@ -688,6 +764,26 @@ status_t IGraphicBufferProducer::setLegacyBufferDrop(bool drop) {
     return INVALID_OPERATION;
 }
 
+status_t IGraphicBufferProducer::requestBuffers(int slot,
+        std::vector<RequestBufferOutput>* outBuffers) {
+    // No-op for IGBP other than BufferQueue.
+    (void) slot;
+    (void) outBuffers;
+    return INVALID_OPERATION;
+}
+
+void IGraphicBufferProducer::reallocateBuffers(uint32_t width, uint32_t height,
+        PixelFormat format, uint64_t usage) {
+    // IGBP other than BufferQueue have no stale buffers to replace.
+    allocateBuffers(width, height, format, usage);
+}
+
+status_t IGraphicBufferProducer::getSharedFrameEvents(base::unique_fd* outFd) {
+    // Only BufferQueue consumers can share their frame events.
+    (void) outFd;
+    return INVALID_OPERATION;
+}
+
 status_t IGraphicBufferProducer::exportToParcel(Parcel* parcel) {
     status_t res = OK;
     res = parcel->writeUint32(USE_BUFFER_QUEUE);
@@ -777,6 +873,25 @@ status_t BnGraphicBufferProducer::onTransact(
             reply->writeInt32(result);
             return NO_ERROR;
         }
+        case REQUEST_BUFFERS: {
+            CHECK_INTERFACE(IGraphicBufferProducer, data, reply);
+            int slot = data.readInt32();
+            std::vector<RequestBufferOutput> buffers;
+            status_t actualResult = requestBuffers(slot, &buffers);
+            status_t result = reply->writeInt32(actualResult);
+            if (result != NO_ERROR || actualResult != NO_ERROR) {
+                return result;
+            }
+            reply->writeInt32(static_cast<int32_t>(buffers.size()));
+            for (const RequestBufferOutput& output : buffers) {
+                reply->writeInt32(output.slot);
+                result = reply->write(*output.buffer);
+                if (result != NO_ERROR) {
+                    return result;
+                }
+            }
+            return NO_ERROR;
+        }
         case SET_MAX_DEQUEUED_BUFFER_COUNT: {
             CHECK_INTERFACE(IGraphicBufferProducer, data, reply);
             int maxDequeuedBuffers = data.readInt32();
@@ -929,6 +1044,15 @@ status_t BnGraphicBufferProducer::onTransact(
             allocateBuffers(width, height, format, usage);
             return NO_ERROR;
         }
+        case REALLOCATE_BUFFERS: {
+            CHECK_INTERFACE(IGraphicBufferProducer, data, reply);
+            uint32_t width = data.readUint32();
+            uint32_t height = data.readUint32();
+            PixelFormat format = static_cast<PixelFormat>(data.readInt32());
+            uint64_t usage = data.readUint64();
+            reallocateBuffers(width, height, format, usage);
+            return NO_ERROR;
+        }
         case ALLOW_ALLOCATION: {
             CHECK_INTERFACE(IGraphicBufferProducer, data, reply);
             bool allow = static_cast<bool>(data.readInt32());
@@ -1015,6 +1139,16 @@ status_t BnGraphicBufferProducer::onTransact(
             }
             return NO_ERROR;
         }
+        case GET_SHARED_FRAME_EVENTS: {
+            CHECK_INTERFACE(IGraphicBufferProducer, data, reply);
+            base::unique_fd fd;
+            status_t actualResult = getSharedFrameEvents(&fd);
+            status_t result = reply->writeInt32(actualResult);
+            if (result != NO_ERROR || actualResult != NO_ERROR) {
+                return result;
+            }
+            return reply->writeUniqueFileDescriptor(fd);
+        }
         case GET_UNIQUE_ID: {
             CHECK_INTERFACE(IGraphicBufferProducer, data, reply);
             uint64_t outId = 0;
@@ -25,7 +25,8 @@ namespace { // Anonymous
 
 enum class Tag : uint32_t {
     ON_TRANSACTION_COMPLETED = IBinder::FIRST_CALL_TRANSACTION,
-    LAST = ON_TRANSACTION_COMPLETED,
+    ON_BUFFER_EVICTED,
+    LAST = ON_BUFFER_EVICTED,
 };
 
 } // Anonymous namespace
@@ -123,30 +124,173 @@ status_t TransactionStats::readFromParcel(const Parcel* input) {
     return input->readParcelableVector(&surfaceStats);
 }
 
+// The fences of all the transactions of a listener are written once, in a table that the
+// transactions and surfaces then refer to by index. Most of them are shared: every transaction
+// latched in a frame has the same present fence, and the layers composed by the GPU the same
+// release fence. Each fence written costs a file descriptor dup for the binder driver.
+namespace {
+
+class FenceTable {
+public:
+    // Returns the index of the fence in the table, or -1 if there is no fence
+    int32_t add(const sp<Fence>& fence) {
+        if (!fence) {
+            return -1;
+        }
+        auto [it, inserted] = mIndices.emplace(fence.get(), static_cast<int32_t>(mFences.size()));
+        if (inserted) {
+            mFences.push_back(fence);
+        }
+        return it->second;
+    }
+
+    status_t writeToParcel(Parcel* output) const {
+        status_t err = output->writeInt32(static_cast<int32_t>(mFences.size()));
+        if (err != NO_ERROR) {
+            return err;
+        }
+        for (const auto& fence : mFences) {
+            err = output->write(*fence);
+            if (err != NO_ERROR) {
+                return err;
+            }
+        }
+        return NO_ERROR;
+    }
+
+    status_t readFromParcel(const Parcel* input) {
+        int32_t count = 0;
+        status_t err = input->readInt32(&count);
+        if (err != NO_ERROR) {
+            return err;
+        }
+        if (count < 0 || static_cast<size_t>(count) > input->dataAvail()) {
+            return BAD_VALUE;
+        }
+        mFences.reserve(count);
+        for (int32_t i = 0; i < count; i++) {
+            sp<Fence> fence = new Fence();
+            err = input->read(*fence);
+            if (err != NO_ERROR) {
+                return err;
+            }
+            mFences.push_back(fence);
+        }
+        return NO_ERROR;
+    }
+
+    status_t get(int32_t index, sp<Fence>* outFence) const {
+        if (index == -1) {
+            *outFence = nullptr;
+            return NO_ERROR;
+        }
+        if (index < 0 || static_cast<size_t>(index) >= mFences.size()) {
+            return BAD_VALUE;
+        }
+        *outFence = mFences[index];
+        return NO_ERROR;
+    }
+
+private:
+    std::vector<sp<Fence>> mFences;
+    std::unordered_map<const Fence*, int32_t> mIndices;
+};
+
+} // Anonymous namespace
+
 status_t ListenerStats::writeToParcel(Parcel* output) const {
-    status_t err = output->writeInt32(static_cast<int32_t>(transactionStats.size()));
+    FenceTable fences;
+    for (const auto& stats : transactionStats) {
+        fences.add(stats.presentFence);
+        for (const auto& surface : stats.surfaceStats) {
+            fences.add(surface.previousReleaseFence);
+        }
+    }
+    status_t err = fences.writeToParcel(output);
+    if (err != NO_ERROR) {
+        return err;
+    }
+
+    err = output->writeInt32(static_cast<int32_t>(transactionStats.size()));
     if (err != NO_ERROR) {
         return err;
     }
     for (const auto& stats : transactionStats) {
-        err = output->writeParcelable(stats);
+        err = output->writeInt64Vector(stats.callbackIds);
         if (err != NO_ERROR) {
             return err;
         }
+        err = output->writeInt64(stats.latchTime);
+        if (err != NO_ERROR) {
+            return err;
+        }
+        err = output->writeInt32(fences.add(stats.presentFence));
+        if (err != NO_ERROR) {
+            return err;
+        }
+        err = output->writeInt32(static_cast<int32_t>(stats.surfaceStats.size()));
+        if (err != NO_ERROR) {
+            return err;
+        }
+        for (const auto& surface : stats.surfaceStats) {
+            err = output->writeStrongBinder(surface.surfaceControl);
+            if (err != NO_ERROR) {
+                return err;
+            }
+            err = output->writeInt64(surface.acquireTime);
+            if (err != NO_ERROR) {
+                return err;
+            }
+            err = output->writeInt32(fences.add(surface.previousReleaseFence));
+            if (err != NO_ERROR) {
+                return err;
+            }
+        }
     }
     return NO_ERROR;
 }
 
 status_t ListenerStats::readFromParcel(const Parcel* input) {
-    int32_t transactionStats_size = input->readInt32();
+    FenceTable fences;
+    status_t err = fences.readFromParcel(input);
+    if (err != NO_ERROR) {
+        return err;
+    }
 
+    int32_t transactionStats_size = input->readInt32();
     for (int i = 0; i < transactionStats_size; i++) {
         TransactionStats stats;
-        status_t err = input->readParcelable(&stats);
+        err = input->readInt64Vector(&stats.callbackIds);
+        if (err != NO_ERROR) {
+            return err;
+        }
+        err = input->readInt64(&stats.latchTime);
         if (err != NO_ERROR) {
             return err;
         }
-        transactionStats.push_back(stats);
+        err = fences.get(input->readInt32(), &stats.presentFence);
+        if (err != NO_ERROR) {
+            return err;
+        }
+
+        int32_t surfaceStats_size = input->readInt32();
+        for (int j = 0; j < surfaceStats_size; j++) {
+            SurfaceStats surface;
+            err = input->readStrongBinder(&surface.surfaceControl);
+            if (err != NO_ERROR) {
+                return err;
+            }
+            err = input->readInt64(&surface.acquireTime);
+            if (err != NO_ERROR) {
+                return err;
+            }
+            err = fences.get(input->readInt32(), &surface.previousReleaseFence);
+            if (err != NO_ERROR) {
+                return err;
+            }
+            stats.surfaceStats.push_back(surface);
+        }
+        transactionStats.push_back(std::move(stats));
     }
     return NO_ERROR;
 }
@@ -173,6 +317,11 @@ public:
                                          onTransactionCompleted)>(Tag::ON_TRANSACTION_COMPLETED,
                                                                   stats);
     }
+
+    void onBufferEvicted(uint64_t cacheId) override {
+        callRemoteAsync<decltype(
+                &ITransactionCompletedListener::onBufferEvicted)>(Tag::ON_BUFFER_EVICTED, cacheId);
+    }
 };
 
 // Out-of-line virtual method definitions to trigger vtable emission in this translation unit (see
@@ -191,6 +340,8 @@ status_t BnTransactionCompletedListener::onTransact(uint32_t code, const Parcel&
         case Tag::ON_TRANSACTION_COMPLETED:
             return callLocalAsync(data, reply,
                                   &ITransactionCompletedListener::onTransactionCompleted);
+        case Tag::ON_BUFFER_EVICTED:
+            return callLocalAsync(data, reply, &ITransactionCompletedListener::onBufferEvicted);
     }
 }
 
@@ -103,44 +103,58 @@ void StreamSplitter::setName(const String8 &name) {
 
 void StreamSplitter::onFrameAvailable(const BufferItem& /* item */) {
     ATRACE_CALL();
-    Mutex::Autolock lock(mMutex);
+    Mutex::Autolock outputLock(mOutputMutex);
 
-    // The current policy is that if any one consumer is consuming buffers too
-    // slowly, the splitter will stall the rest of the outputs by not acquiring
-    // any more buffers from the input. This will cause back pressure on the
-    // input queue, slowing down its producer.
-
-    // If there are too many outstanding buffers, we block until a buffer is
-    // released back to the input in onBufferReleased
-    while (mOutstandingBuffers >= MAX_OUTSTANDING_BUFFERS) {
-        mReleaseCondition.wait(mMutex);
-
-        // If the splitter is abandoned while we are waiting, the release
-        // condition variable will be broadcast, and we should just return
-        // without attempting to do anything more (since the input queue will
-        // also be abandoned).
-        if (mIsAbandoned) {
-            return;
-        }
-    }
-    ++mOutstandingBuffers;
-
-    // Acquire and detach the buffer from the input
     BufferItem bufferItem;
-    status_t status = mInput->acquireBuffer(&bufferItem, /* presentWhen */ 0);
-    LOG_ALWAYS_FATAL_IF(status != NO_ERROR,
-            "acquiring buffer from input failed (%d)", status);
+    sp<BufferTracker> tracker;
+    Vector<sp<IGraphicBufferProducer> > outputs;
+    { // Autolock scope
+        Mutex::Autolock lock(mMutex);
+
+        // The current policy is that if any one consumer is consuming buffers
+        // too slowly, the splitter will stall the rest of the outputs by not
+        // acquiring any more buffers from the input. This will cause back
+        // pressure on the input queue, slowing down its producer.
+
+        // If there are too many outstanding buffers, we block until a buffer
+        // is released back to the input in onBufferReleased
+        while (mOutstandingBuffers >= MAX_OUTSTANDING_BUFFERS) {
+            mReleaseCondition.wait(mMutex);
+
+            // If the splitter is abandoned while we are waiting, the release
+            // condition variable will be broadcast, and we should just return
+            // without attempting to do anything more (since the input queue
+            // will also be abandoned).
+            if (mIsAbandoned) {
+                return;
+            }
+        }
+        ++mOutstandingBuffers;
 
-    ALOGV("acquired buffer %#" PRIx64 " from input",
-            bufferItem.mGraphicBuffer->getId());
+        // Acquire and detach the buffer from the input
+        status_t status = mInput->acquireBuffer(&bufferItem, /* presentWhen */ 0);
+        LOG_ALWAYS_FATAL_IF(status != NO_ERROR,
+                "acquiring buffer from input failed (%d)", status);
 
-    status = mInput->detachBuffer(bufferItem.mSlot);
-    LOG_ALWAYS_FATAL_IF(status != NO_ERROR,
-            "detaching buffer from input failed (%d)", status);
+        ALOGV("acquired buffer %#" PRIx64 " from input",
+                bufferItem.mGraphicBuffer->getId());
 
-    // Initialize our reference count for this buffer
-    mBuffers.add(bufferItem.mGraphicBuffer->getId(),
-            new BufferTracker(bufferItem.mGraphicBuffer));
+        status = mInput->detachBuffer(bufferItem.mSlot);
+        LOG_ALWAYS_FATAL_IF(status != NO_ERROR,
+                "detaching buffer from input failed (%d)", status);
+
+        // Initialize our reference count for this buffer. Outputs added from
+        // now on don't get it, so they don't count.
+        outputs = mOutputs;
+        tracker = new BufferTracker(bufferItem.mGraphicBuffer, outputs.size());
+        mBuffers.add(bufferItem.mGraphicBuffer->getId(), tracker);
+    } // Autolock scope
+
+    // With no output to wait for, the buffer goes right back to the input
+    if (outputs.empty()) {
+        onBufferReleasedByAllOutputs(tracker);
+        return;
+    }
 
     IGraphicBufferProducer::QueueBufferInput queueInput(
             bufferItem.mTimestamp, bufferItem.mIsAutoTimestamp,
@@ -149,36 +163,32 @@ void StreamSplitter::onFrameAvailable(const BufferItem& /* item */) {
             bufferItem.mTransform, bufferItem.mFence);
 
     // Attach and queue the buffer to each of the outputs
-    Vector<sp<IGraphicBufferProducer> >::iterator output = mOutputs.begin();
-    for (; output != mOutputs.end(); ++output) {
+    Vector<sp<IGraphicBufferProducer> >::iterator output = outputs.begin();
+    for (; output != outputs.end(); ++output) {
         int slot;
-        status = (*output)->attachBuffer(&slot, bufferItem.mGraphicBuffer);
-        if (status == NO_INIT) {
-            // If we just discovered that this output has been abandoned, note
-            // that, increment the release count so that we still release this
-            // buffer eventually, and move on to the next output
-            onAbandonedLocked();
-            mBuffers.editValueFor(bufferItem.mGraphicBuffer->getId())->
-                    incrementReleaseCountLocked();
-            continue;
+        status_t status = (*output)->attachBuffer(&slot, bufferItem.mGraphicBuffer);
+        if (status == NO_ERROR) {
+            IGraphicBufferProducer::QueueBufferOutput queueOutput;
+            status = (*output)->queueBuffer(slot, queueInput, &queueOutput);
+            LOG_ALWAYS_FATAL_IF(status != NO_ERROR && status != NO_INIT,
+                    "queueing buffer to output failed (%d)", status);
         } else {
-            LOG_ALWAYS_FATAL_IF(status != NO_ERROR,
+            LOG_ALWAYS_FATAL_IF(status != NO_INIT,
                     "attaching buffer to output failed (%d)", status);
         }
 
-        IGraphicBufferProducer::QueueBufferOutput queueOutput;
-        status = (*output)->queueBuffer(slot, queueInput, &queueOutput);
         if (status == NO_INIT) {
             // If we just discovered that this output has been abandoned, note
-            // that, increment the release count so that we still release this
-            // buffer eventually, and move on to the next output
-            onAbandonedLocked();
-            mBuffers.editValueFor(bufferItem.mGraphicBuffer->getId())->
-                    incrementReleaseCountLocked();
+            // that, count it as released so that we still release this buffer
+            // eventually, and move on to the next output
+            {
+                Mutex::Autolock lock(mMutex);
+                onAbandonedLocked();
+            }
+            if (tracker->release(Fence::NO_FENCE)) {
+                onBufferReleasedByAllOutputs(tracker);
+            }
             continue;
-        } else {
-            LOG_ALWAYS_FATAL_IF(status != NO_ERROR,
-                    "queueing buffer to output failed (%d)", status);
         }
 
         ALOGV("queued buffer %#" PRIx64 " to output %p",
@@ -189,7 +199,6 @@ void StreamSplitter::onFrameAvailable(const BufferItem& /* item */) {
 void StreamSplitter::onBufferReleasedByOutput(
         const sp<IGraphicBufferProducer>& from) {
     ATRACE_CALL();
-    Mutex::Autolock lock(mMutex);
 
     sp<GraphicBuffer> buffer;
     sp<Fence> fence;
@@ -197,6 +206,7 @@ void StreamSplitter::onBufferReleasedByOutput(
     if (status == NO_INIT) {
         // If we just discovered that this output has been abandoned, note that,
         // but we can't do anything else, since buffer is invalid
+        Mutex::Autolock lock(mMutex);
         onAbandonedLocked();
         return;
     } else {
@@ -207,43 +217,57 @@ void StreamSplitter::onBufferReleasedByOutput(
     ALOGV("detached buffer %#" PRIx64 " from output %p",
           buffer->getId(), from.get());
 
-    const sp<BufferTracker>& tracker = mBuffers.editValueFor(buffer->getId());
+    sp<BufferTracker> tracker;
+    { // Autolock scope
+        Mutex::Autolock lock(mMutex);
+        tracker = mBuffers.valueFor(buffer->getId());
+    } // Autolock scope
+
+    // Check to see if this is the last outstanding reference to this buffer.
+    // The release fences of all outputs are merged into the fence we send back
+    // to the input.
+    if (tracker->release(fence)) {
+        onBufferReleasedByAllOutputs(tracker);
+    }
+}
 
-    // Merge the release fence of the incoming buffer so that the fence we send
-    // back to the input includes all of the outputs' fences
-    tracker->mergeFence(fence);
+void StreamSplitter::onBufferReleasedByAllOutputs(const sp<BufferTracker>& tracker) {
+    const uint64_t bufferId = tracker->getBuffer()->getId();
 
-    // Check to see if this is the last outstanding reference to this buffer
-    size_t releaseCount = tracker->incrementReleaseCountLocked();
-    ALOGV("buffer %#" PRIx64 " reference count %zu (of %zu)", buffer->getId(),
-            releaseCount, mOutputs.size());
-    if (releaseCount < mOutputs.size()) {
-        return;
-    }
+    bool isAbandoned;
+    { // Autolock scope
+        Mutex::Autolock lock(mMutex);
+        isAbandoned = mIsAbandoned;
+    } // Autolock scope
 
     // If we've been abandoned, we can't return the buffer to the input, so just
     // stop tracking it and move on
-    if (mIsAbandoned) {
-        mBuffers.removeItem(buffer->getId());
-        return;
+    if (!isAbandoned) {
+        // Attach and release the buffer back to the input
+        int consumerSlot;
+        status_t status = mInput->attachBuffer(&consumerSlot, tracker->getBuffer());
+        if (status == NO_ERROR) {
+            status = mInput->releaseBuffer(consumerSlot, /* frameNumber */ 0,
+                    EGL_NO_DISPLAY, EGL_NO_SYNC_KHR, tracker->getMergedFence());
+            LOG_ALWAYS_FATAL_IF(status != NO_ERROR && status != NO_INIT,
+                    "releasing buffer to input failed (%d)", status);
+        } else {
+            // An output may have abandoned us since, disconnecting the input
+            LOG_ALWAYS_FATAL_IF(status != NO_INIT,
+                    "attaching buffer to input failed (%d)", status);
+        }
+        isAbandoned = status == NO_INIT;
     }
 
-    // Attach and release the buffer back to the input
-    int consumerSlot;
-    status = mInput->attachBuffer(&consumerSlot, tracker->getBuffer());
-    LOG_ALWAYS_FATAL_IF(status != NO_ERROR,
-            "attaching buffer to input failed (%d)", status);
-
-    status = mInput->releaseBuffer(consumerSlot, /* frameNumber */ 0,
-            EGL_NO_DISPLAY, EGL_NO_SYNC_KHR, tracker->getMergedFence());
-    LOG_ALWAYS_FATAL_IF(status != NO_ERROR,
-            "releasing buffer to input failed (%d)", status);
-
-    ALOGV("released buffer %#" PRIx64 " to input", buffer->getId());
+    Mutex::Autolock lock(mMutex);
 
     // We no longer need to track the buffer once it has been returned to the
     // input
-    mBuffers.removeItem(buffer->getId());
+    mBuffers.removeItem(bufferId);
+    if (isAbandoned) {
+        return;
+    }
+    ALOGV("released buffer %#" PRIx64 " to input", bufferId);
 
     // Notify any waiting onFrameAvailable calls
     --mOutstandingBuffers;
@@ -275,13 +299,30 @@ void StreamSplitter::OutputListener::binderDied(const wp<IBinder>& /* who */) {
     mSplitter->onAbandonedLocked();
 }
 
-StreamSplitter::BufferTracker::BufferTracker(const sp<GraphicBuffer>& buffer)
-      : mBuffer(buffer), mMergedFence(Fence::NO_FENCE), mReleaseCount(0) {}
+StreamSplitter::BufferTracker::BufferTracker(const sp<GraphicBuffer>& buffer,
+        size_t outputCount)
+      : mBuffer(buffer), mFences(outputCount), mClaimedCount(0), mReleaseCount(0) {}
 
 StreamSplitter::BufferTracker::~BufferTracker() {}
 
-void StreamSplitter::BufferTracker::mergeFence(const sp<Fence>& with) {
-    mMergedFence = Fence::merge(String8("StreamSplitter"), mMergedFence, with);
+bool StreamSplitter::BufferTracker::release(const sp<Fence>& fence) {
+    const size_t index = mClaimedCount.fetch_add(1, std::memory_order_relaxed);
+    if (index >= mFences.size()) {
+        ALOGE("buffer %#" PRIx64 " released more often than it was queued",
+                mBuffer->getId());
+        return false;
+    }
+    mFences[index] = fence != nullptr ? fence : Fence::NO_FENCE;
+
+    // The release that completes last sees every fence stored before.
+    size_t releaseCount = mReleaseCount.fetch_add(1, std::memory_order_acq_rel) + 1;
+    ALOGV("buffer %#" PRIx64 " reference count %zu (of %zu)", mBuffer->getId(),
+            releaseCount, mFences.size());
+    return releaseCount == mFences.size();
+}
+
+sp<Fence> StreamSplitter::BufferTracker::getMergedFence() const {
+    return Fence::merge("StreamSplitter", mFences);
 }
 
 } // namespace android
@@ -62,6 +62,7 @@ Surface::Surface(const sp<IGraphicBufferProducer>& bufferProducer, bool controll
         mQueriedSupportedTimestamps(false),
         mFrameTimestampsSupportsPresent(false),
         mEnableFrameTimestamps(false),
+        mPreallocateOnResize(false),
         mFrameEventHistory(std::make_unique<ProducerFrameEventHistory>()) {
     // Initialize the ANativeWindow function pointers.
     ANativeWindow::setSwapInterval  = hook_setSwapInterval;
@@ -128,6 +129,38 @@ void Surface::allocateBuffers() {
             mReqFormat, mReqUsage);
 }
 
+void Surface::setPreallocateOnResize(bool enabled) {
+    Mutex::Autolock lock(mMutex);
+    mPreallocateOnResize = enabled;
+}
+
+void Surface::preallocateBuffers() {
+    uint32_t reqWidth;
+    uint32_t reqHeight;
+    PixelFormat reqFormat;
+    uint64_t reqUsage;
+    {
+        Mutex::Autolock lock(mMutex);
+        reqWidth = mReqWidth ? mReqWidth : mUserWidth;
+        reqHeight = mReqHeight ? mReqHeight : mUserHeight;
+        reqFormat = mReqFormat;
+        reqUsage = mReqUsage;
+    }
+
+    sp<IGraphicBufferProducer> producer = mGraphicBufferProducer;
+    if (IInterface::asBinder(producer)->localBinder() == nullptr) {
+        // One-way over binder, so the remote BufferQueue allocates on its own
+        // binder thread.
+        producer->reallocateBuffers(reqWidth, reqHeight, reqFormat, reqUsage);
+        return;
+    }
+    // An in-process BufferQueue would allocate inline on the caller's thread,
+    // which is exactly what this hint is meant to avoid.
+    std::thread([producer, reqWidth, reqHeight, reqFormat, reqUsage]() {
+        producer->reallocateBuffers(reqWidth, reqHeight, reqFormat, reqUsage);
+    }).detach();
+}
+
 status_t Surface::setGenerationNumber(uint32_t generation) {
     status_t result = mGraphicBufferProducer->setGenerationNumber(generation);
     if (result == NO_ERROR) {
@@ -177,6 +210,15 @@ void Surface::enableFrameTimestamps(bool enable) {
         FrameEventHistoryDelta delta;
         mGraphicBufferProducer->getFrameTimestamps(&delta);
         mFrameEventHistory->applyDelta(delta);
+
+        // Read the events from memory shared with the consumer from then on,
+        // if it offers any.
+        if (!mFrameEventHistory->hasSharedEvents()) {
+            base::unique_fd fd;
+            if (mGraphicBufferProducer->getSharedFrameEvents(&fd) == NO_ERROR) {
+                mFrameEventHistory->setSharedEvents(std::move(fd));
+            }
+        }
     }
     mEnableFrameTimestamps = enable;
 }
@@ -288,14 +330,17 @@ status_t Surface::getFrameTimestamps(uint64_t frameNumber,
         return NAME_NOT_FOUND;
     }
 
-    // Update our cache of events if the requested events are not available.
+    // Update our cache of events if the requested events are not available,
+    // from the shared events if possible and otherwise from the consumer.
     if (checkConsumerForUpdates(events, mLastFrameNumber,
             outLatchTime, outFirstRefreshStartTime, outLastRefreshStartTime,
             outGpuCompositionDoneTime, outDisplayPresentTime,
             outDequeueReadyTime, outReleaseTime)) {
-        FrameEventHistoryDelta delta;
-        mGraphicBufferProducer->getFrameTimestamps(&delta);
-        mFrameEventHistory->applyDelta(delta);
+        if (!mFrameEventHistory->applySharedEvents()) {
+            FrameEventHistoryDelta delta;
+            mGraphicBufferProducer->getFrameTimestamps(&delta);
+            mFrameEventHistory->applyDelta(delta);
+        }
         events = mFrameEventHistory->getFrame(frameNumber);
     }
 
@@ -434,6 +479,23 @@ int Surface::hook_perform(ANativeWindow* window, int operation, ...) {
     return result;
 }
 
+int Surface::hook_setBuffersTimestamp(ANativeWindow* window, int64_t timestamp) {
+    Surface* c = getSelf(window);
+    return c->setBuffersTimestamp(timestamp);
+}
+
+int Surface::hook_setBuffersDataSpace(ANativeWindow* window, android_dataspace_t dataSpace) {
+    Surface* c = getSelf(window);
+    return c->setBuffersDataSpace(static_cast<Dataspace>(dataSpace));
+}
+
+int Surface::hook_setSurfaceDamage(ANativeWindow* window, const android_native_rect_t* rects,
+                                   size_t numRects) {
+    Surface* c = getSelf(window);
+    c->setSurfaceDamage(const_cast<android_native_rect_t*>(rects), numRects);
+    return NO_ERROR;
+}
+
 int Surface::setSwapInterval(int interval) {
     ATRACE_CALL();
     // EGL specification states:
@@ -618,7 +680,26 @@ int Surface::dequeueBuffer(android_native_buffer_t** buffer, int* fenceFd) {
         if (mReportRemovedBuffers && (gbuf != nullptr)) {
             mRemovedBuffers.push_back(gbuf);
         }
-        result = mGraphicBufferProducer->requestBuffer(buf, &gbuf);
+        // Get the preallocated buffers of other slots along, so that dequeueing
+        // them later takes no requestBuffer round trip.
+        std::vector<IGraphicBufferProducer::RequestBufferOutput> requested;
+        result = mGraphicBufferProducer->requestBuffers(buf, &requested);
+        if (result == NO_ERROR) {
+            gbuf.clear();
+            for (IGraphicBufferProducer::RequestBufferOutput& output : requested) {
+                if (output.slot < 0 || output.slot >= NUM_BUFFER_SLOTS) {
+                    continue;
+                }
+                sp<GraphicBuffer>& slotBuffer(mSlots[output.slot].buffer);
+                if (mReportRemovedBuffers && output.slot != buf && slotBuffer != nullptr &&
+                        slotBuffer != output.buffer) {
+                    mRemovedBuffers.push_back(slotBuffer);
+                }
+                slotBuffer = std::move(output.buffer);
+            }
+        } else if (result == INVALID_OPERATION) {
+            result = mGraphicBufferProducer->requestBuffer(buf, &gbuf);
+        }
         if (result != NO_ERROR) {
             ALOGE("dequeueBuffer: IGraphicBufferProducer::requestBuffer failed: %d", result);
             mGraphicBufferProducer->cancelBuffer(buf, fence);
@@ -1073,6 +1154,9 @@ int Surface::perform(int operation, va_list args)
     case NATIVE_WINDOW_GET_CONSUMER_USAGE64:
         res = dispatchGetConsumerUsage64(args);
         break;
+    case NATIVE_WINDOW_GET_FAST_DISPATCH:
+        res = dispatchGetFastDispatch(args);
+        break;
     default:
         res = NAME_NOT_FOUND;
         break;
@@ -1273,6 +1357,18 @@ int Surface::dispatchGetConsumerUsage64(va_list args) {
     return getConsumerUsage(usage);
 }
 
+int Surface::dispatchGetFastDispatch(va_list args) {
+    static const ANativeWindowFastDispatch sFastDispatch = {
+            sizeof(ANativeWindowFastDispatch),
+            hook_setBuffersTimestamp,
+            hook_setBuffersDataSpace,
+            hook_setSurfaceDamage,
+    };
+    const ANativeWindowFastDispatch** dispatch = va_arg(args, const ANativeWindowFastDispatch**);
+    *dispatch = &sFastDispatch;
+    return NO_ERROR;
+}
+
 bool Surface::transformToDisplayInverse() {
     return (mTransform & NATIVE_WINDOW_TRANSFORM_INVERSE_DISPLAY) ==
             NATIVE_WINDOW_TRANSFORM_INVERSE_DISPLAY;
@@ -1544,12 +1640,19 @@ int Surface::setBuffersDimensions(uint32_t width, uint32_t height)
     if ((width && !height) || (!width && height))
         return BAD_VALUE;
 
-    Mutex::Autolock lock(mMutex);
-    if (width != mReqWidth || height != mReqHeight) {
-        mSharedBufferSlot = BufferItem::INVALID_BUFFER_SLOT;
+    bool preallocate = false;
+    {
+        Mutex::Autolock lock(mMutex);
+        if (width != mReqWidth || height != mReqHeight) {
+            mSharedBufferSlot = BufferItem::INVALID_BUFFER_SLOT;
+            preallocate = mPreallocateOnResize && width && !mSharedBufferMode;
+        }
+        mReqWidth = width;
+        mReqHeight = height;
+    }
+    if (preallocate) {
+        preallocateBuffers();
     }
-    mReqWidth = width;
-    mReqHeight = height;
     return NO_ERROR;
 }
 
@@ -1561,12 +1664,20 @@ int Surface::setBuffersUserDimensions(uint32_t width, uint32_t height)
     if ((width && !height) || (!width && height))
         return BAD_VALUE;
 
-    Mutex::Autolock lock(mMutex);
-    if (width != mUserWidth || height != mUserHeight) {
-        mSharedBufferSlot = BufferItem::INVALID_BUFFER_SLOT;
+    bool preallocate = false;
+    {
+        Mutex::Autolock lock(mMutex);
+        if (width != mUserWidth || height != mUserHeight) {
+            mSharedBufferSlot = BufferItem::INVALID_BUFFER_SLOT;
+            // Explicit buffer dimensions take precedence over user dimensions.
+            preallocate = mPreallocateOnResize && width && !mReqWidth && !mSharedBufferMode;
+        }
+        mUserWidth = width;
+        mUserHeight = height;
+    }
+    if (preallocate) {
+        preallocateBuffers();
     }
-    mUserWidth = width;
-    mUserHeight = height;
     return NO_ERROR;
 }
 
@@ -16,9 +16,16 @@
 
 #define LOG_TAG "SurfaceComposerClient"
 
+#include <pthread.h>
 #include <stdint.h>
 #include <sys/types.h>
 
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
 #include <utils/Errors.h>
 #include <utils/Log.h>
 #include <utils/SortedVector.h>
@@ -278,6 +285,12 @@ public:
         SurfaceComposerClient::doUncacheBufferTransaction(cacheId);
     }
 
+    // SurfaceFlinger no longer has the buffer, so it must be sent again the next time it is used.
+    void evicted(uint64_t cacheId) {
+        std::lock_guard<std::mutex> lock(mMutex);
+        mBuffers.erase(cacheId);
+    }
+
 private:
     void evictLeastRecentlyUsedBuffer() REQUIRES(mMutex) {
         auto itr = mBuffers.begin();
@@ -315,6 +328,10 @@ void bufferCacheCallback(void* /*context*/, uint64_t graphicBufferId) {
     BufferCache::getInstance().uncache(graphicBufferId);
 }
 
+void TransactionCompletedListener::onBufferEvicted(uint64_t cacheId) {
+    BufferCache::getInstance().evicted(cacheId);
+}
+
 // ---------------------------------------------------------------------------
 
 SurfaceComposerClient::Transaction::Transaction(const Transaction& other)
@@ -362,7 +379,7 @@ SurfaceComposerClient::Transaction& SurfaceComposerClient::Transaction::merge(Tr
     mInputWindowCommands.merge(other.mInputWindowCommands);
     other.mInputWindowCommands.clear();
 
-    mContainsBuffer = other.mContainsBuffer;
+    mContainsBuffer = mContainsBuffer || other.mContainsBuffer;
     other.mContainsBuffer = false;
 
     mEarlyWakeup = mEarlyWakeup || other.mEarlyWakeup;
@@ -438,11 +455,106 @@ void SurfaceComposerClient::Transaction::cacheBuffers() {
     }
 }
 
+// Batcher holds the transaction the applies made while batching is enabled are merged
+// into, and a thread that sends it once the batching window has passed. Its lock is held
+// while sending, so that transactions reach SurfaceFlinger in the order they are applied.
+class SurfaceComposerClient::Transaction::Batcher {
+public:
+    static Batcher& getInstance() {
+        // Never destroyed, since its thread may still be running at exit.
+        static Batcher* sInstance = new Batcher();
+        return *sInstance;
+    }
+
+    bool isActive() const { return mWindow.load() > 0 || mHasPending.load(); }
+
+    void setWindow(nsecs_t window) {
+        std::lock_guard lock(mMutex);
+        if (window <= 0) {
+            flushLocked();
+        }
+        mWindow = window;
+    }
+
+    status_t apply(Transaction& t, bool synchronous) {
+        std::lock_guard lock(mMutex);
+        const nsecs_t window = mWindow.load();
+        if (window <= 0 || t.mDesiredPresentTime >= 0) {
+            flushLocked();
+            return t.applyNow(synchronous);
+        }
+
+        mPending.merge(std::move(t));
+        mPending.mForceSynchronous |= t.mForceSynchronous;
+        mPending.mAnimation = mPending.mAnimation || t.mAnimation;
+        t.mForceSynchronous = 0;
+        t.mAnimation = false;
+
+        if (synchronous || mPending.mForceSynchronous || mPending.mEarlyWakeup) {
+            mHasPending = false;
+            return mPending.applyNow(synchronous);
+        }
+        if (!mHasPending) {
+            mDeadline = std::chrono::steady_clock::now() + std::chrono::nanoseconds(window);
+            mHasPending = true;
+            if (!mThreadStarted) {
+                std::thread(&Batcher::threadMain, this).detach();
+                mThreadStarted = true;
+            }
+            mCondition.notify_one();
+        }
+        return NO_ERROR;
+    }
+
+private:
+    Batcher() = default;
+
+    void flushLocked() {
+        if (mHasPending) {
+            mHasPending = false;
+            mPending.applyNow(false);
+        }
+    }
+
+    void threadMain() {
+        pthread_setname_np(pthread_self(), "TxnBatcher");
+        std::unique_lock lock(mMutex);
+        while (true) {
+            mCondition.wait(lock, [this] { return mHasPending.load(); });
+            while (mHasPending && std::chrono::steady_clock::now() < mDeadline) {
+                mCondition.wait_until(lock, mDeadline);
+            }
+            flushLocked();
+        }
+    }
+
+    std::mutex mMutex;
+    std::condition_variable mCondition;
+    std::atomic<nsecs_t> mWindow{0};
+    std::atomic<bool> mHasPending{false};
+    std::chrono::steady_clock::time_point mDeadline;
+    bool mThreadStarted = false;
+    Transaction mPending;
+};
+
+void SurfaceComposerClient::Transaction::setApplyBatchingWindow(nsecs_t window) {
+    Batcher::getInstance().setWindow(window);
+}
+
 status_t SurfaceComposerClient::Transaction::apply(bool synchronous) {
     if (mStatus != NO_ERROR) {
         return mStatus;
     }
 
+    Batcher& batcher = Batcher::getInstance();
+    if (batcher.isActive()) {
+        return batcher.apply(*this, synchronous);
+    }
+    return applyNow(synchronous);
+}
+
+status_t SurfaceComposerClient::Transaction::applyNow(bool synchronous) {
+
     sp<ISurfaceComposer> sf(ComposerService::getComposerService());
 
     std::vector<ListenerCallbacks> listenerCallbacks;
@@ -0,0 +1,205 @@
+/*
+ * Copyright 2019 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#define LOG_TAG "VsyncTimeline"
+
+#include <private/gui/VsyncTimeline.h>
+
+#include <fcntl.h>
+#include <linux/futex.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <climits>
+#include <new>
+
+#include <binder/Parcel.h>
+#include <cutils/ashmem.h>
+#include <log/log.h>
+
+namespace android {
+namespace gui {
+
+struct VsyncTimeline::Shared {
+    // Odd while a VSYNC is being published. This is also the futex word readers wait on, so it
+    // must stay 32 bits wide.
+    std::atomic<uint32_t> sequence{0};
+    std::atomic<uint32_t> count{0};
+    std::atomic<int64_t> timestamp{0};
+    std::atomic<int64_t> period{0};
+};
+
+static_assert(sizeof(std::atomic<uint32_t>) == sizeof(uint32_t), "futex word must be 32 bits");
+static_assert(std::atomic<uint32_t>::is_always_lock_free &&
+                      std::atomic<int64_t>::is_always_lock_free,
+              "atomics shared with other processes must be lock-free");
+
+// The publisher holds the sequence odd for a few stores, so a consistent read takes at most a
+// couple of attempts unless the publisher is preempted, or died, mid-update.
+static constexpr int kMaxReadAttempts = 16;
+
+static int futex(const std::atomic<uint32_t>* word, int op, uint32_t value,
+                 const timespec* timeout) {
+    // The timeline is shared with other processes, so no FUTEX_PRIVATE_FLAG.
+    return syscall(SYS_futex, reinterpret_cast<const uint32_t*>(word), op, value, timeout,
+                   nullptr, 0);
+}
+
+VsyncTimeline::VsyncTimeline(PublisherType) {
+    base::unique_fd fd(ashmem_create_region("VsyncTimeline", sizeof(Shared)));
+    if (fd < 0) {
+        ALOGE("VsyncTimeline: shared memory creation failed");
+        return;
+    }
+    void* mapping = mmap(nullptr, sizeof(Shared), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (mapping == MAP_FAILED) {
+        ALOGE("VsyncTimeline: can't map shared memory (%s)", strerror(errno));
+        return;
+    }
+    // Readers may only map the timeline read-only.
+    if (ashmem_set_prot_region(fd, PROT_READ) < 0) {
+        ALOGE("VsyncTimeline: can't protect shared memory (%s)", strerror(errno));
+        munmap(mapping, sizeof(Shared));
+        return;
+    }
+    mShared = new (mapping) Shared;
+    mFd = std::move(fd);
+}
+
+VsyncTimeline::~VsyncTimeline() {
+    if (mShared != nullptr) {
+        munmap(mShared, sizeof(Shared));
+    }
+}
+
+status_t VsyncTimeline::initCheck() const {
+    return mShared != nullptr ? NO_ERROR : NO_INIT;
+}
+
+status_t VsyncTimeline::share(VsyncTimeline* outTimeline) const {
+    if (mShared == nullptr) {
+        return NO_INIT;
+    }
+    base::unique_fd fd(fcntl(mFd, F_DUPFD_CLOEXEC, 0));
+    if (fd < 0) {
+        return -errno;
+    }
+    return outTimeline->map(std::move(fd));
+}
+
+void VsyncTimeline::publish(const Vsync& vsync) {
+    const uint32_t sequence = mShared->sequence.load(std::memory_order_relaxed);
+    mShared->sequence.store(sequence + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+
+    mShared->timestamp.store(vsync.timestamp, std::memory_order_relaxed);
+    mShared->count.store(vsync.count, std::memory_order_relaxed);
+    mShared->period.store(vsync.period, std::memory_order_relaxed);
+
+    mShared->sequence.store(sequence + 2, std::memory_order_release);
+    futex(&mShared->sequence, FUTEX_WAKE, INT_MAX, nullptr);
+}
+
+status_t VsyncTimeline::read(Vsync* outVsync) const {
+    if (mShared == nullptr) {
+        return NO_INIT;
+    }
+
+    for (int attempt = 0; attempt < kMaxReadAttempts; attempt++) {
+        const uint32_t sequence = mShared->sequence.load(std::memory_order_acquire);
+        if (sequence & 1) {
+            continue;
+        }
+        Vsync vsync;
+        vsync.timestamp = mShared->timestamp.load(std::memory_order_relaxed);
+        vsync.count = mShared->count.load(std::memory_order_relaxed);
+        vsync.period = mShared->period.load(std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (mShared->sequence.load(std::memory_order_relaxed) == sequence) {
+            *outVsync = vsync;
+            return NO_ERROR;
+        }
+    }
+    return WOULD_BLOCK;
+}
+
+status_t VsyncTimeline::waitForVsync(uint32_t afterCount, nsecs_t timeout,
+                                     Vsync* outVsync) const {
+    if (mShared == nullptr) {
+        return NO_INIT;
+    }
+
+    const nsecs_t deadline = systemTime(SYSTEM_TIME_MONOTONIC) + timeout;
+    while (true) {
+        const uint32_t sequence = mShared->sequence.load(std::memory_order_acquire);
+        Vsync vsync;
+        // Counts wrap around, so compare their distance.
+        if (read(&vsync) == NO_ERROR && static_cast<int32_t>(vsync.count - afterCount) > 0) {
+            *outVsync = vsync;
+            return NO_ERROR;
+        }
+
+        const nsecs_t remaining = deadline - systemTime(SYSTEM_TIME_MONOTONIC);
+        if (remaining <= 0) {
+            return TIMED_OUT;
+        }
+        const timespec relativeTimeout = {static_cast<time_t>(remaining / 1000000000),
+                                          static_cast<long>(remaining % 1000000000)};
+        // Returns right away if a VSYNC was published since the sequence was loaded.
+        futex(&mShared->sequence, FUTEX_WAIT, sequence, &relativeTimeout);
+    }
+}
+
+status_t VsyncTimeline::writeToParcel(Parcel* reply) const {
+    if (mFd < 0) return -EINVAL;
+
+    return reply->writeDupFileDescriptor(mFd);
+}
+
+status_t VsyncTimeline::readFromParcel(const Parcel* parcel) {
+    base::unique_fd fd(fcntl(parcel->readFileDescriptor(), F_DUPFD_CLOEXEC, 0));
+    if (fd < 0) {
+        int error = errno;
+        ALOGE("VsyncTimeline::readFromParcel: can't dup file descriptor (%s)", strerror(error));
+        return -error;
+    }
+    return map(std::move(fd));
+}
+
+status_t VsyncTimeline::map(base::unique_fd fd) {
+    if (ashmem_get_size_region(fd) < static_cast<int>(sizeof(Shared))) {
+        ALOGE("VsyncTimeline: bad shared memory region");
+        return BAD_VALUE;
+    }
+    void* mapping = mmap(nullptr, sizeof(Shared), PROT_READ, MAP_SHARED, fd, 0);
+    if (mapping == MAP_FAILED) {
+        int error = errno;
+        ALOGE("VsyncTimeline: can't map shared memory (%s)", strerror(error));
+        return -error;
+    }
+
+    if (mShared != nullptr) {
+        munmap(mShared, sizeof(Shared));
+    }
+    mShared = static_cast<Shared*>(mapping);
+    mFd = std::move(fd);
+    return NO_ERROR;
+}
+
+} // namespace gui
+} // namespace android
@@ -85,6 +85,22 @@ class BufferItemConsumer: public ConsumerBase
     status_t releaseBuffer(const BufferItem &item,
             const sp<Fence>& releaseFence = Fence::NO_FENCE);
 
+    // Gets up to maxBuffers of the pending buffers at once, appending them to
+    // items in queue order, which is cheaper than getting them one by one.
+    // Returns what acquireBuffer would if no buffer could be acquired, and
+    // stops short of maxBuffers when the queue runs out or when the maximum
+    // number of buffers is acquired.
+    //
+    // If waitForFence is true, waits on the fences of all the acquired
+    // BufferItems with no timeout before returning.
+    status_t acquireBuffers(uint32_t maxBuffers, std::vector<BufferItem>* items,
+            nsecs_t presentWhen, bool waitForFence = true);
+
+    // Returns the acquired buffers of items to the queue at once, as
+    // releaseBuffer does one by one, all with the same releaseFence.
+    status_t releaseBuffers(const std::vector<BufferItem>& items,
+            const sp<Fence>& releaseFence = Fence::NO_FENCE);
+
    private:
     void freeBufferLocked(int slotIndex) override;
 
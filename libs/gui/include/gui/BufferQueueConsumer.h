@@ -50,6 +50,10 @@ public:
     virtual status_t acquireBuffer(BufferItem* outBuffer,
             nsecs_t expectedPresent, uint64_t maxFrameNumber = 0) override;
 
+    // See IGraphicBufferConsumer::acquireBuffers
+    status_t acquireBuffers(uint32_t maxBuffers, nsecs_t expectedPresent,
+            std::vector<BufferItem>* outBuffers) override;
+
     // See IGraphicBufferConsumer::detachBuffer
     virtual status_t detachBuffer(int slot);
 
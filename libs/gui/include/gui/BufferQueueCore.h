@@ -136,6 +136,11 @@ private:
     // waitWhileAllocatingLocked blocks until mIsAllocating is false.
     void waitWhileAllocatingLocked(std::unique_lock<std::mutex>& lock) const;
 
+    // notifyDequeueWaitersLocked wakes any producer blocked on
+    // mDequeueCondition. It is a no-op when nobody is waiting, which saves the
+    // futex wake on every queue/acquire/release in the steady state.
+    void notifyDequeueWaitersLocked() const;
+
 #if DEBUG_ONLY_CODE
     // validateConsistencyLocked ensures that the free lists are in sync with
     // the information stored in mSlots
@@ -225,6 +230,10 @@ private:
     // synchronous mode.
     mutable std::condition_variable mDequeueCondition;
 
+    // mDequeueWaiters is the number of threads currently blocked on
+    // mDequeueCondition.
+    mutable int mDequeueWaiters;
+
     // mDequeueBufferCannotBlock indicates whether dequeueBuffer is allowed to
     // block. This flag is set during connect when both the producer and
     // consumer are controlled by the application.
@@ -40,6 +40,10 @@ public:
     // flags indicating that previously-returned buffers are no longer valid.
     virtual status_t requestBuffer(int slot, sp<GraphicBuffer>* buf);
 
+    // See IGraphicBufferProducer::requestBuffers
+    virtual status_t requestBuffers(int slot,
+            std::vector<RequestBufferOutput>* outBuffers) override;
+
     // see IGraphicsBufferProducer::setMaxDequeuedBufferCount
     virtual status_t setMaxDequeuedBufferCount(int maxDequeuedBuffers);
 
@@ -156,6 +160,10 @@ public:
     virtual void allocateBuffers(uint32_t width, uint32_t height,
             PixelFormat format, uint64_t usage) override;
 
+    // See IGraphicBufferProducer::reallocateBuffers
+    virtual void reallocateBuffers(uint32_t width, uint32_t height,
+            PixelFormat format, uint64_t usage) override;
+
     // See IGraphicBufferProducer::allowAllocation
     virtual status_t allowAllocation(bool allow);
 
@@ -184,6 +192,9 @@ public:
     // See IGraphicBufferProducer::getFrameTimestamps
     virtual void getFrameTimestamps(FrameEventHistoryDelta* outDelta) override;
 
+    // See IGraphicBufferProducer::getSharedFrameEvents
+    virtual status_t getSharedFrameEvents(base::unique_fd* outFd) override;
+
     // See IGraphicBufferProducer::getUniqueId
     virtual status_t getUniqueId(uint64_t* outId) const override;
 
@@ -205,6 +216,11 @@ private:
     void addAndGetFrameTimestamps(const NewFrameEventsEntry* newTimestamps,
             FrameEventHistoryDelta* outDelta);
 
+    // Does allocateBuffers, and also replaces stale free buffers for
+    // reallocateBuffers if replaceStale is set.
+    void allocateBuffers(uint32_t width, uint32_t height, PixelFormat format, uint64_t usage,
+            bool replaceStale);
+
     // waitForFreeSlotThenRelock finds the oldest slot in the FREE state. It may
     // block if there are no available slots and we are not in non-blocking
     // mode (producer and consumer controlled by the application). If it blocks,
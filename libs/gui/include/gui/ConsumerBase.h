@@ -112,6 +112,10 @@ private:
     ConsumerBase(const ConsumerBase&);
     void operator=(const ConsumerBase&);
 
+    // updateAcquiredSlotLocked updates the buffer slot of a buffer just
+    // acquired from the BufferQueue.
+    void updateAcquiredSlotLocked(const BufferItem& item);
+
 protected:
     // ConsumerBase constructs a new ConsumerBase object to consume image
     // buffers from the given IGraphicBufferConsumer.
@@ -190,6 +194,13 @@ protected:
     virtual status_t acquireBufferLocked(BufferItem *item, nsecs_t presentWhen,
             uint64_t maxFrameNumber = 0);
 
+    // acquireBuffersLocked fetches up to maxBuffers of the pending buffers
+    // from the BufferQueue in a single call, appends them to items and
+    // updates their buffer slots. It bypasses acquireBufferLocked, so only
+    // derived classes that don't override it may use it.
+    status_t acquireBuffersLocked(uint32_t maxBuffers, nsecs_t presentWhen,
+            std::vector<BufferItem>* items);
+
     // releaseBufferLocked relinquishes control over a buffer, returning that
     // control to the BufferQueue.
     //
@@ -24,6 +24,7 @@
 
 #include <utils/Vector.h>
 
+#include <memory>
 
 namespace android {
 
@@ -111,6 +112,23 @@ class CpuConsumer : public ConsumerBase
     // lockNextBuffer.
     status_t unlockBuffer(const LockedBuffer &nativeBuffer);
 
+    // Same as lockNextBuffer, but returns the locked buffer as a reference
+    // counted view. The buffer is unlocked and returned to the queue once the
+    // last reference to the view is dropped, and must not be passed to
+    // unlockBuffer. Returning a view looks up its tracking entry directly
+    // instead of searching the locked buffers.
+    status_t lockNextBufferView(std::shared_ptr<const LockedBuffer>* outBuffer);
+
+    // Keeps buffers mapped for CPU access from the first time they are locked
+    // until their slot is freed, instead of locking and unlocking them for
+    // every frame. A buffer that comes back from the producer is then only
+    // waited upon, which saves the gralloc lock and unlock for consumers that
+    // read every frame. Since the buffer is not locked again, the CPU caches
+    // are not invalidated between frames either, so this must only be enabled
+    // for producers that write the buffers through the CPU or for buffers
+    // that are CPU coherent. Disabled by default.
+    status_t setPersistentMapping(bool enabled);
+
   private:
     // Maximum number of buffers that can be locked at a time
     const size_t mMaxLockedBuffers;
@@ -125,25 +143,63 @@ class CpuConsumer : public ConsumerBase
         int mSlot;
         sp<GraphicBuffer> mGraphicBuffer;
         uintptr_t mLockedBufferId;
+        // Whether the buffer was handed out by lockNextBufferView, in which
+        // case only dropping the view may unlock it.
+        bool mIsView;
 
         AcquiredBuffer() :
                 mSlot(BufferQueue::INVALID_BUFFER_SLOT),
-                mLockedBufferId(kUnusedId) {
+                mLockedBufferId(kUnusedId),
+                mIsView(false) {
         }
 
         void reset() {
             mSlot = BufferQueue::INVALID_BUFFER_SLOT;
             mGraphicBuffer.clear();
             mLockedBufferId = kUnusedId;
+            mIsView = false;
         }
     };
 
+    // Tracking for the buffers kept mapped by setPersistentMapping, indexed
+    // by slot. mMapping holds the pointers and strides of the mapping.
+    struct MappedBuffer {
+        sp<GraphicBuffer> mGraphicBuffer;
+        LockedBuffer mMapping;
+        bool mAcquired = false;
+    };
+
     size_t findAcquiredBufferLocked(uintptr_t id) const;
 
-    status_t lockBufferItem(const BufferItem& item, LockedBuffer* outBuffer) const;
+    status_t lockBufferItem(const BufferItem& item, const Rect& rect,
+                            LockedBuffer* outBuffer) const;
+
+    // Maps the buffer of item and fills out outBuffer, reusing the persistent
+    // mapping of its slot when there is one.
+    status_t mapBufferItemLocked(const BufferItem& item, LockedBuffer* outBuffer);
+
+    // Acquires and locks the next buffer, returning the index of its
+    // AcquiredBuffer in outIdx.
+    status_t lockNextBufferLocked(LockedBuffer* nativeBuffer, size_t* outIdx);
+
+    // Returns the buffer of the AcquiredBuffer at lockedIdx to the queue.
+    status_t releaseAcquiredBufferLocked(size_t lockedIdx);
+
+    // Unmaps the persistent mapping of slot, unless the buffer is still
+    // acquired, in which case releasing it unmaps it.
+    void clearMappedBufferLocked(int slot);
+
+    // Called when the last reference to a view returned by
+    // lockNextBufferView is dropped.
+    void releaseView(size_t lockedIdx);
+
+    void freeBufferLocked(int slotIndex) override;
 
     Vector<AcquiredBuffer> mAcquiredBuffers;
 
+    bool mPersistentMapping;
+    MappedBuffer mMappedBuffers[BufferQueue::NUM_BUFFER_SLOTS];
+
     // Count of currently locked buffers
     size_t mCurrentLockedBuffers;
 };
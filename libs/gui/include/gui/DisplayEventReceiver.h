@@ -37,6 +37,7 @@ class IDisplayEventConnection;
 
 namespace gui {
 class BitTube;
+class VsyncTimeline;
 } // namespace gui
 
 static inline constexpr uint32_t fourcc(char c1, char c2, char c3, char c4) {
@@ -144,9 +145,42 @@ public:
      */
     status_t requestNextVsync();
 
+    /*
+     * setWorkDuration() hints how long it takes to produce a frame once its
+     * Event::VSync is received, so the event can be delivered as late as that
+     * still allows. A value of 0 clears the hint.
+     */
+    status_t setWorkDuration(nsecs_t workDuration);
+
+    /*
+     * useVsyncTimeline() maps the shared memory SurfaceFlinger publishes the
+     * latest Event::VSync in, so that getLatestVsync() and waitForVsync() can
+     * be used. If muteVSyncEvents is set, Event::VSync is no longer delivered
+     * through getFd(), while setVsyncRate() and requestNextVsync() still
+     * determine which VSYNCs get published. It may be called again to change
+     * muteVSyncEvents, but not while another thread reads the timeline.
+     */
+    status_t useVsyncTimeline(bool muteVSyncEvents);
+
+    /*
+     * getLatestVsync() reads the latest VSYNC published without a syscall.
+     * The count is 0 until the first VSYNC, and the period, the time between
+     * the last two consecutive VSYNCs, is 0 until known.
+     * Returns NO_INIT if useVsyncTimeline() was not called.
+     */
+    status_t getLatestVsync(nsecs_t* outTimestamp, uint32_t* outCount, nsecs_t* outPeriod) const;
+
+    /*
+     * waitForVsync() blocks until a VSYNC whose count is past afterCount is
+     * published, for up to timeout. Returns TIMED_OUT if none was, or NO_INIT
+     * if useVsyncTimeline() was not called.
+     */
+    status_t waitForVsync(uint32_t afterCount, nsecs_t timeout);
+
 private:
     sp<IDisplayEventConnection> mEventConnection;
     std::unique_ptr<gui::BitTube> mDataChannel;
+    std::unique_ptr<gui::VsyncTimeline> mVsyncTimeline;
 };
 
 // ----------------------------------------------------------------------------
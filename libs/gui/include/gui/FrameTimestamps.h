@@ -17,12 +17,14 @@
 #ifndef ANDROID_GUI_FRAMETIMESTAMPS_H
 #define ANDROID_GUI_FRAMETIMESTAMPS_H
 
+#include <android-base/unique_fd.h>
 #include <ui/FenceTime.h>
 #include <utils/Flattenable.h>
 #include <utils/StrongPointer.h>
 #include <utils/Timers.h>
 
 #include <array>
+#include <atomic>
 #include <bitset>
 #include <vector>
 
@@ -122,6 +124,42 @@ protected:
 };
 
 
+// The frame events the consumer publishes in memory shared with the producer,
+// so that the producer can read them without a call into the consumer. The
+// frames are at the same indices as in FrameEventHistory. Fences are replaced
+// by their signal times as far as the consumer knows them, which is
+// Fence::SIGNAL_TIME_PENDING until then, or Fence::SIGNAL_TIME_INVALID if
+// there is no fence. sequence is odd while the consumer updates data.
+struct SharedFrameEvents {
+    struct Frame {
+        uint64_t frameNumber;
+        uint32_t valid;
+        uint32_t addPostCompositeCalled;
+        uint32_t addReleaseCalled;
+        nsecs_t postedTime;
+        nsecs_t requestedPresentTime;
+        nsecs_t latchTime;
+        nsecs_t firstRefreshStartTime;
+        nsecs_t lastRefreshStartTime;
+        nsecs_t dequeueReadyTime;
+        nsecs_t gpuCompositionDoneTime;
+        nsecs_t displayPresentTime;
+        nsecs_t releaseTime;
+    };
+
+    struct Data {
+        CompositorTiming compositorTiming;
+        std::array<Frame, FrameEventHistory::MAX_FRAME_HISTORY> frames;
+    };
+
+    std::atomic<uint32_t> sequence;
+    Data data;
+};
+
+static_assert(std::atomic<uint32_t>::is_always_lock_free,
+              "SharedFrameEvents needs a lock-free sequence count.");
+
+
 // The producer's interface to FrameEventHistory
 class ProducerFrameEventHistory : public FrameEventHistory {
 public:
@@ -142,6 +180,16 @@ public:
             uint64_t frameNumber, std::shared_ptr<FenceTime>&& acquire);
     void applyDelta(const FrameEventHistoryDelta& delta);
 
+    // Maps the SharedFrameEvents the consumer publishes, from a file
+    // descriptor returned by IGraphicBufferProducer::getSharedFrameEvents.
+    status_t setSharedEvents(base::unique_fd fd);
+    bool hasSharedEvents() const { return mSharedEvents != nullptr; }
+    // Updates the frames the producer knows of from the shared events.
+    // Returns false if there are none, they could not be read consistently or
+    // they refer to fences the producer only gets through a delta, in which
+    // case the producer must ask the consumer for a delta as well.
+    bool applySharedEvents();
+
     void updateSignalTimes();
 
 protected:
@@ -153,8 +201,15 @@ protected:
     virtual std::shared_ptr<FenceTime> createFenceTime(
             const sp<Fence>& fence) const;
 
+    // Applies a signal time read from the shared events to a fence. Returns
+    // whether the fence is known from then on.
+    static bool applySharedSignalTime(std::shared_ptr<FenceTime>* dst,
+            nsecs_t signalTime);
+
     size_t mAcquireOffset{0};
 
+    const SharedFrameEvents* mSharedEvents{nullptr};
+
     // The consumer updates it's timelines in Layer and SurfaceFlinger since
     // they can coordinate shared timelines better. The producer doesn't have
     // shared timelines though, so just let it own and update all of them.
@@ -222,7 +277,14 @@ public:
 
     void getAndResetDelta(FrameEventHistoryDelta* delta);
 
+    // Returns a read-only file descriptor of the SharedFrameEvents the
+    // history publishes into from then on, creating them on first use.
+    base::unique_fd getSharedEvents();
+
 private:
+    // Copies the frames into the shared events, if there are any.
+    void publishSharedEvents();
+
     void getFrameDelta(FrameEventHistoryDelta* delta,
             const std::array<FrameEvents, MAX_FRAME_HISTORY>::iterator& frame);
 
@@ -234,6 +296,9 @@ private:
 
     int mCurrentConnectId{0};
     bool mProducerWantsEvents{false};
+
+    base::unique_fd mSharedEventsFd;
+    SharedFrameEvents* mSharedEvents{nullptr};
 };
 
 
@@ -480,6 +480,13 @@ private:
     // of the buffer allocated to a slot.
     EglSlot mEglSlots[BufferQueueDefs::NUM_BUFFER_SLOTS];
 
+    // mKeepFreedEglImage is set while acquireBufferLocked lets ConsumerBase
+    // free the slot of a buffer sent again, so that freeBufferLocked moves the
+    // EglImage of the slot to mFreedEglImage instead of destroying it. The
+    // image is reused if the buffer sent is the one it was created from.
+    bool mKeepFreedEglImage = false;
+    sp<EglImage> mFreedEglImage;
+
     // mCurrentTexture is the buffer slot index of the buffer that is currently
     // bound to the OpenGL texture. It is initialized to INVALID_BUFFER_SLOT,
     // indicating that no buffer slot is currently bound to the texture. Note,
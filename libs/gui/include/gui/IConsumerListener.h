@@ -16,6 +16,7 @@
 
 #pragma once
 
+#include <android-base/unique_fd.h>
 #include <binder/IInterface.h>
 #include <binder/SafeInterface.h>
 
@@ -79,6 +80,13 @@ public:
     // WARNING: This method can only be called when the BufferQueue is in the consumer's process.
     virtual void addAndGetFrameTimestamps(const NewFrameEventsEntry* /*newTimestamps*/,
                                           FrameEventHistoryDelta* /*outDelta*/) {}
+
+    // Returns a read-only file descriptor of the memory the consumer publishes its frame events
+    // in, or an invalid one if it does not share them. See
+    // IGraphicBufferProducer::getSharedFrameEvents.
+    //
+    // WARNING: This method can only be called when the BufferQueue is in the consumer's process.
+    virtual base::unique_fd getSharedFrameEvents() { return {}; }
 };
 
 class IConsumerListener : public ConsumerListener, public IInterface {
@@ -20,6 +20,7 @@
 #include <binder/SafeInterface.h>
 
 #include <utils/Errors.h>
+#include <utils/Timers.h>
 
 #include <cstdint>
 
@@ -27,6 +28,7 @@ namespace android {
 
 namespace gui {
 class BitTube;
+class VsyncTimeline;
 } // namespace gui
 
 class IDisplayEventConnection : public IInterface {
@@ -51,6 +53,20 @@ public:
      * requestNextVsync() schedules the next vsync event. It has no effect if the vsync rate is > 0.
      */
     virtual void requestNextVsync() = 0; // Asynchronous
+
+    /*
+     * setWorkDuration() hints how long the client takes to produce a frame once it gets the vsync
+     * event for it. Events may then be delivered later than to other clients, as late as still
+     * leaves that much time before the frame is due. A value of 0 clears the hint.
+     */
+    virtual status_t setWorkDuration(nsecs_t workDuration) = 0;
+
+    /*
+     * getVsyncTimeline() maps the shared memory the latest vsync is published in into outTimeline.
+     * If muteVSyncEvents is set, vsync events are no longer sent to the receive channel, while the
+     * vsync rate and requests still determine which vsyncs get published.
+     */
+    virtual status_t getVsyncTimeline(gui::VsyncTimeline* outTimeline, bool muteVSyncEvents) = 0;
 };
 
 class BnDisplayEventConnection : public SafeBnInterface<IDisplayEventConnection> {
@@ -28,6 +28,8 @@
 
 #include <utils/Errors.h>
 
+#include <vector>
+
 namespace android {
 
 class BufferItem;
@@ -80,6 +82,16 @@ public:
     virtual status_t acquireBuffer(BufferItem* buffer, nsecs_t presentWhen,
                                    uint64_t maxFrameNumber = 0) = 0;
 
+    // acquireBuffers acquires up to maxBuffers of the pending buffers, as successive calls to
+    // acquireBuffer would, but in a single call. The acquired buffers are returned in outBuffers,
+    // in queue order.
+    //
+    // Return of NO_ERROR means at least one buffer was acquired. Otherwise, what the first call to
+    // acquireBuffer would have returned is returned, or INVALID_OPERATION if the implementation
+    // only supports acquiring buffers one at a time.
+    virtual status_t acquireBuffers(uint32_t maxBuffers, nsecs_t presentWhen,
+                                    std::vector<BufferItem>* outBuffers);
+
     // detachBuffer attempts to remove all ownership of the buffer in the given slot from the buffer
     // queue. If this call succeeds, the slot will be freed, and there will be no way to obtain the
     // buffer from this interface. The freed slot will remain unallocated until either it is
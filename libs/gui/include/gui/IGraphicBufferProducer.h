@@ -20,6 +20,8 @@
 #include <stdint.h>
 #include <sys/types.h>
 
+#include <vector>
+
 #include <utils/Errors.h>
 #include <utils/RefBase.h>
 
@@ -106,6 +108,23 @@ public:
     //              * buffer specified by the slot is not dequeued
     virtual status_t requestBuffer(int slot, sp<GraphicBuffer>* buf) = 0;
 
+    struct RequestBufferOutput {
+        int slot;
+        sp<GraphicBuffer> buffer;
+    };
+
+    // requestBuffers does what requestBuffer does for the given slot, and also
+    // returns the buffers of the free slots which were allocated ahead of their
+    // first dequeue (see allocateBuffers) and not requested yet. Those slots
+    // then need no requestBuffer once dequeued, unless dequeueBuffer returns
+    // BUFFER_NEEDS_REALLOCATION for them. The buffer of the given slot, if it
+    // has one, comes first in outBuffers.
+    //
+    // Return of a value other than NO_ERROR means an error has occurred; the
+    // errors are those of requestBuffer, or INVALID_OPERATION if batching is
+    // not supported, in which case requestBuffer must be used.
+    virtual status_t requestBuffers(int slot, std::vector<RequestBufferOutput>* outBuffers);
+
     // setMaxDequeuedBufferCount sets the maximum number of buffers that can be
     // dequeued by the producer at one time. If this method succeeds, any new
     // buffer slots will be both unallocated and owned by the BufferQueue object
@@ -540,6 +559,17 @@ public:
     virtual void allocateBuffers(uint32_t width, uint32_t height,
             PixelFormat format, uint64_t usage) = 0;
 
+    // Like allocateBuffers, but once every slot holds a buffer, the free
+    // buffers which dequeueBuffer would have to reallocate for the given
+    // dimensions/format/usage are also replaced, one at a time. This is meant
+    // for when the producer is about to change its buffers' geometry, such as
+    // on a resize. Dequeued, queued, acquired and shared buffers are left
+    // alone.
+    //
+    // IGBP other than BufferQueue only allocate, as allocateBuffers does.
+    virtual void reallocateBuffers(uint32_t width, uint32_t height,
+            PixelFormat format, uint64_t usage);
+
     // Sets whether dequeueBuffer is allowed to allocate new buffers.
     //
     // Normally dequeueBuffer does not discriminate between free slots which
@@ -620,6 +650,14 @@ public:
     // Gets the frame events that haven't already been retrieved.
     virtual void getFrameTimestamps(FrameEventHistoryDelta* /*outDelta*/) {}
 
+    // Gets a read-only file descriptor of the memory the consumer publishes
+    // its frame events in, as SharedFrameEvents. Reading them there saves a
+    // getFrameTimestamps call whenever they are up to date.
+    //
+    // Return of a value other than NO_ERROR means the consumer does not share
+    // its frame events, and getFrameTimestamps must be used.
+    virtual status_t getSharedFrameEvents(base::unique_fd* outFd);
+
     // Returns a unique id for this BufferQueue
     virtual status_t getUniqueId(uint64_t* outId) const = 0;
 
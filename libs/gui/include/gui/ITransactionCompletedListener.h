@@ -84,6 +84,10 @@ public:
     DECLARE_META_INTERFACE(TransactionCompletedListener)
 
     virtual void onTransactionCompleted(ListenerStats stats) = 0;
+
+    // Called when SurfaceFlinger evicts a buffer this process cached, so that it is sent along
+    // with the buffer id the next time it is used.
+    virtual void onBufferEvicted(uint64_t cacheId) = 0;
 };
 
 class BnTransactionCompletedListener : public SafeBnInterface<ITransactionCompletedListener> {
@@ -25,6 +25,9 @@
 #include <utils/Mutex.h>
 #include <utils/StrongPointer.h>
 
+#include <atomic>
+#include <vector>
+
 namespace android {
 
 class GraphicBuffer;
@@ -67,13 +70,16 @@ public:
     void setName(const String8& name);
 
 private:
+    class BufferTracker;
+
     // From IConsumerListener
     //
     // During this callback, we store some tracking information, detach the
     // buffer from the input, and attach it to each of the outputs. This call
     // can block if there are too many outstanding buffers. If it blocks, it
     // will resume when onBufferReleasedByOutput releases a buffer back to the
-    // input.
+    // input. The outputs are fed without mMutex held, so that releases from
+    // outputs which already got the buffer don't wait for the others.
     virtual void onFrameAvailable(const BufferItem& item);
 
     // From IConsumerListener
@@ -97,6 +103,10 @@ private:
     // onFrameAvailable call to proceed.
     void onBufferReleasedByOutput(const sp<IGraphicBufferProducer>& from);
 
+    // Releases a buffer every output is done with back to the input, and stops
+    // tracking it. This must be called with mMutex unlocked.
+    void onBufferReleasedByAllOutputs(const sp<BufferTracker>& tracker);
+
     // When this is called, the splitter disconnects from (i.e., abandons) its
     // input queue and signals any waiting onFrameAvailable calls to wake up.
     // It still processes callbacks from other outputs, but only detaches their
@@ -126,18 +136,22 @@ private:
         sp<IGraphicBufferProducer> mOutput;
     };
 
+    // Counts the releases of a buffer by the outputs it was queued to, and
+    // collects their release fences, without a lock: each release claims a
+    // fence slot, and whichever release completes last merges them all into
+    // the one fence sent back to the input.
     class BufferTracker : public LightRefBase<BufferTracker> {
     public:
-        explicit BufferTracker(const sp<GraphicBuffer>& buffer);
+        BufferTracker(const sp<GraphicBuffer>& buffer, size_t outputCount);
 
         const sp<GraphicBuffer>& getBuffer() const { return mBuffer; }
-        const sp<Fence>& getMergedFence() const { return mMergedFence; }
 
-        void mergeFence(const sp<Fence>& with);
+        // Records a release by one output. Returns true for the last one, after
+        // which getMergedFence may be called. Safe to call from any thread.
+        bool release(const sp<Fence>& fence);
 
-        // Returns the new value
-        // Only called while mMutex is held
-        size_t incrementReleaseCountLocked() { return ++mReleaseCount; }
+        // Merges the release fences of all the outputs
+        sp<Fence> getMergedFence() const;
 
     private:
         // Only destroy through LightRefBase
@@ -149,8 +163,9 @@ private:
         BufferTracker& operator=(const BufferTracker& other);
 
         sp<GraphicBuffer> mBuffer; // One instance that holds this native handle
-        sp<Fence> mMergedFence;
-        size_t mReleaseCount;
+        std::vector<sp<Fence>> mFences; // One per output
+        std::atomic<size_t> mClaimedCount;
+        std::atomic<size_t> mReleaseCount;
     };
 
     // Only called from createSplitter
@@ -169,13 +184,17 @@ private:
 
     Mutex mMutex;
     Condition mReleaseCondition;
+    // Held while a buffer is fed to the outputs, which keeps the outputs
+    // getting the frames in order without holding mMutex.
+    Mutex mOutputMutex;
     int mOutstandingBuffers;
     sp<IGraphicBufferConsumer> mInput;
     Vector<sp<IGraphicBufferProducer> > mOutputs;
 
     // Map of GraphicBuffer IDs (GraphicBuffer::getId()) to buffer tracking
     // objects (which are mostly for counting how many outputs have released the
-    // buffer, but also contain merged release fences).
+    // buffer, but also collect their release fences). Guarded by mMutex; the
+    // trackers themselves are not.
     KeyedVector<uint64_t, sp<BufferTracker> > mBuffers;
 };
 
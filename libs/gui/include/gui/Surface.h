@@ -122,6 +122,14 @@ public:
      */
     void allocateBuffers();
 
+    /* Enables allocating buffers for the new geometry as soon as
+     * setBuffersDimensions or setBuffersUserDimensions changes it, instead of
+     * on the first dequeueBuffer afterwards. Free buffers of the old geometry
+     * are replaced; buffers still dequeued or acquired are left alone. The
+     * allocation never runs on the calling thread. Disabled by default.
+     */
+    void setPreallocateOnResize(bool enabled);
+
     /* Sets the generation number on the IGraphicBufferProducer and updates the
      * generation number on any buffers attached to the Surface after this call.
      * See IGBP::setGenerationNumber for more information. */
@@ -205,6 +213,12 @@ private:
             ANativeWindowBuffer* buffer, int fenceFd);
     static int hook_setSwapInterval(ANativeWindow* window, int interval);
 
+    // ANativeWindowFastDispatch hooks
+    static int hook_setBuffersTimestamp(ANativeWindow* window, int64_t timestamp);
+    static int hook_setBuffersDataSpace(ANativeWindow* window, android_dataspace_t dataSpace);
+    static int hook_setSurfaceDamage(ANativeWindow* window, const android_native_rect_t* rects,
+                                     size_t numRects);
+
     static int hook_cancelBuffer_DEPRECATED(ANativeWindow* window,
             ANativeWindowBuffer* buffer);
     static int hook_dequeueBuffer_DEPRECATED(ANativeWindow* window,
@@ -246,6 +260,7 @@ private:
     int dispatchGetWideColorSupport(va_list args);
     int dispatchGetHdrSupport(va_list args);
     int dispatchGetConsumerUsage64(va_list args);
+    int dispatchGetFastDispatch(va_list args);
     bool transformToDisplayInverse();
 
 protected:
@@ -504,10 +519,16 @@ protected:
     bool mEnableFrameTimestamps = false;
     std::unique_ptr<ProducerFrameEventHistory> mFrameEventHistory;
 
+    // See setPreallocateOnResize. Protected by mMutex.
+    bool mPreallocateOnResize;
+
     bool mReportRemovedBuffers = false;
     std::vector<sp<GraphicBuffer>> mRemovedBuffers;
 
     sp<IProducerListener> mListenerProxy;
+    // Starts an asynchronous allocateBuffers for the current request.
+    void preallocateBuffers();
+
     status_t getAndFlushBuffersFromSlots(const std::vector<int32_t>& slots,
             std::vector<sp<GraphicBuffer>>* outBuffers);
 };
@@ -28,6 +28,7 @@
 #include <utils/RefBase.h>
 #include <utils/Singleton.h>
 #include <utils/SortedVector.h>
+#include <utils/Timers.h>
 #include <utils/threads.h>
 
 #include <ui/ConfigStoreTypes.h>
@@ -320,12 +321,28 @@ public:
         void cacheBuffers();
         void registerSurfaceControlForCallback(const sp<SurfaceControl>& sc);
 
+        // Sends the transaction to SurfaceFlinger, bypassing apply batching.
+        status_t applyNow(bool synchronous);
+
+        // Batcher merges the applies made while apply batching is enabled.
+        class Batcher;
+        friend class Batcher;
+
     public:
         Transaction() = default;
         virtual ~Transaction() = default;
         Transaction(Transaction const& other);
 
         status_t apply(bool synchronous = false);
+        // Enables batching of applies within the process when window is positive. An
+        // asynchronous apply is then merged into a pending transaction, which is sent to
+        // SurfaceFlinger window nanoseconds after the first apply merged into it, so applies
+        // made within one window, typically a vsync period, cost a single binder call.
+        // Synchronous and early wakeup applies are merged into the pending transaction and
+        // send it right away; an apply with a desired present time sends the pending
+        // transaction first and is then sent on its own. Passing 0 sends the pending
+        // transaction and disables batching, which is the default.
+        static void setApplyBatchingWindow(nsecs_t window);
         // Merge another transaction in to this one, clearing other
         // as if it had been applied.
         Transaction& merge(Transaction&& other);
@@ -580,6 +597,9 @@ public:
 
     // Overrides BnTransactionCompletedListener's onTransactionCompleted
     void onTransactionCompleted(ListenerStats stats) override;
+
+    // Overrides BnTransactionCompletedListener's onBufferEvicted
+    void onBufferEvicted(uint64_t cacheId) override;
 };
 
 // ---------------------------------------------------------------------------
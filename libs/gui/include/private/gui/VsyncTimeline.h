@@ -0,0 +1,89 @@
+/*
+ * Copyright 2019 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <android-base/unique_fd.h>
+#include <binder/Parcelable.h>
+#include <utils/Errors.h>
+#include <utils/Timers.h>
+
+#include <cstdint>
+
+namespace android {
+
+class Parcel;
+
+namespace gui {
+
+// Shared memory the latest VSYNC of an EventThread is published in. Unlike the events sent through
+// a BitTube, it can be read without a syscall, and waited on with a futex.
+class VsyncTimeline : public Parcelable {
+public:
+    struct Vsync {
+        nsecs_t timestamp = 0;
+        // Number of VSYNC events since the display was connected, or 0 if there was none yet.
+        uint32_t count = 0;
+        // Time between the last two consecutive VSYNC events, or 0 if unknown.
+        nsecs_t period = 0;
+    };
+
+    // creates an unmapped VsyncTimeline (to unparcel into)
+    VsyncTimeline() = default;
+
+    // creates the shared memory of a VsyncTimeline, for the side which publishes to it
+    struct PublisherType {};
+    static constexpr PublisherType Publisher{};
+    explicit VsyncTimeline(PublisherType);
+
+    ~VsyncTimeline() override;
+
+    VsyncTimeline(const VsyncTimeline&) = delete;
+    VsyncTimeline& operator=(const VsyncTimeline&) = delete;
+
+    // check state after construction
+    status_t initCheck() const;
+
+    // maps the shared memory of this VsyncTimeline read-only into outTimeline
+    status_t share(VsyncTimeline* outTimeline) const;
+
+    // publishes a VSYNC and wakes the threads waiting for it. Only valid on the publisher.
+    void publish(const Vsync& vsync);
+
+    // reads the latest VSYNC. Returns NO_INIT if unmapped, or WOULD_BLOCK if the publisher kept
+    // updating it while it was being read.
+    status_t read(Vsync* outVsync) const;
+
+    // waits for a VSYNC whose count is past afterCount to be published, for up to timeout, and
+    // reads it. Returns TIMED_OUT if none was.
+    status_t waitForVsync(uint32_t afterCount, nsecs_t timeout, Vsync* outVsync) const;
+
+    // implement the Parcelable protocol. Only parcels the file descriptor
+    status_t writeToParcel(Parcel* reply) const override;
+    status_t readFromParcel(const Parcel* parcel) override;
+
+private:
+    struct Shared;
+
+    // maps the shared memory behind fd read-only
+    status_t map(base::unique_fd fd);
+
+    base::unique_fd mFd;
+    Shared* mShared = nullptr;
+};
+
+} // namespace gui
+} // namespace android
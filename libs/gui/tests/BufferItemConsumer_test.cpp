@@ -203,4 +203,33 @@ TEST_F(BufferItemConsumerTest, TriggerBufferFreed_DeleteBufferItemConsumer) {
     ASSERT_EQ(1, GetFreedBufferCount());
 }
 
+// Test that acquireBuffers takes all the queued buffers at once, and that
+// releaseBuffers gives them back.
+TEST_F(BufferItemConsumerTest, AcquireAndReleaseBuffers) {
+    for (int i = 0; i < kMaxLockedBuffers; i++) {
+        int slot;
+        DequeueBuffer(&slot);
+        QueueBuffer(slot);
+    }
+
+    std::vector<BufferItem> items;
+    ASSERT_EQ(NO_ERROR, mBIC->acquireBuffers(kMaxLockedBuffers + 1, &items, 0, false));
+    ASSERT_EQ(static_cast<size_t>(kMaxLockedBuffers), items.size());
+    for (size_t i = 0; i < items.size(); i++) {
+        EXPECT_EQ(items[0].mFrameNumber + i, items[i].mFrameNumber);
+        EXPECT_NE(nullptr, items[i].mGraphicBuffer);
+    }
+
+    std::vector<BufferItem> noItems;
+    EXPECT_EQ(IGraphicBufferConsumer::NO_BUFFER_AVAILABLE,
+              mBIC->acquireBuffers(kMaxLockedBuffers, &noItems, 0, false));
+    EXPECT_TRUE(noItems.empty());
+
+    ASSERT_EQ(NO_ERROR, mBIC->releaseBuffers(items, Fence::NO_FENCE));
+    for (int i = 0; i < kMaxLockedBuffers; i++) {
+        int slot;
+        DequeueBuffer(&slot);
+    }
+}
+
 }  // namespace android
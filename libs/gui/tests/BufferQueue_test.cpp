@@ -36,6 +36,7 @@
 
 #include <gtest/gtest.h>
 
+#include <algorithm>
 #include <thread>
 
 using namespace std::chrono_literals;
@@ -808,6 +809,125 @@ TEST_F(BufferQueueTest, CanAttachWhileDisallowingAllocation) {
     ASSERT_EQ(OK, mProducer->attachBuffer(&slot, buffer));
 }
 
+TEST_F(BufferQueueTest, ReallocateBuffersReplacesStaleFreeBuffers) {
+    createBufferQueue();
+    sp<DummyConsumer> dc(new DummyConsumer);
+    ASSERT_EQ(OK, mConsumer->consumerConnect(dc, false));
+    IGraphicBufferProducer::QueueBufferOutput output;
+    ASSERT_EQ(OK, mProducer->connect(new DummyProducerListener,
+            NATIVE_WINDOW_API_CPU, false, &output));
+    ASSERT_EQ(OK, mProducer->setMaxDequeuedBufferCount(2));
+
+    // Fill every slot with a 1x1 buffer.
+    const int kBufferCount = 3;
+    int slots[kBufferCount] = {};
+    sp<Fence> fence;
+    sp<GraphicBuffer> buffer;
+    for (int i = 0; i < kBufferCount; i++) {
+        ASSERT_EQ(IGraphicBufferProducer::BUFFER_NEEDS_REALLOCATION,
+                mProducer->dequeueBuffer(&slots[i], &fence, 1, 1, 0,
+                        GRALLOC_USAGE_SW_READ_OFTEN, nullptr, nullptr));
+        ASSERT_EQ(OK, mProducer->requestBuffer(slots[i], &buffer));
+    }
+    for (int i = 0; i < kBufferCount; i++) {
+        ASSERT_EQ(OK, mProducer->cancelBuffer(slots[i], Fence::NO_FENCE));
+    }
+
+    // Preallocating at the new size must replace all of them, so dequeueing
+    // at that size works without being allowed to allocate.
+    mProducer->reallocateBuffers(16, 16, 0, GRALLOC_USAGE_SW_READ_OFTEN);
+    ASSERT_EQ(OK, mProducer->setDequeueTimeout(0));
+    ASSERT_EQ(OK, mProducer->allowAllocation(false));
+    for (int i = 0; i < kBufferCount; i++) {
+        ASSERT_LE(OK, mProducer->dequeueBuffer(&slots[i], &fence, 16, 16, 0,
+                GRALLOC_USAGE_SW_READ_OFTEN, nullptr, nullptr));
+        ASSERT_EQ(OK, mProducer->requestBuffer(slots[i], &buffer));
+        EXPECT_EQ(16u, buffer->getWidth());
+        EXPECT_EQ(16u, buffer->getHeight());
+    }
+}
+
+TEST_F(BufferQueueTest, AllocateBuffersKeepsStaleFreeBuffers) {
+    createBufferQueue();
+    sp<DummyConsumer> dc(new DummyConsumer);
+    ASSERT_EQ(OK, mConsumer->consumerConnect(dc, false));
+    IGraphicBufferProducer::QueueBufferOutput output;
+    ASSERT_EQ(OK, mProducer->connect(new DummyProducerListener,
+            NATIVE_WINDOW_API_CPU, false, &output));
+    ASSERT_EQ(OK, mProducer->setMaxDequeuedBufferCount(2));
+
+    // Fill every slot with a 1x1 buffer.
+    const int kBufferCount = 3;
+    int slots[kBufferCount] = {};
+    sp<Fence> fence;
+    sp<GraphicBuffer> buffer;
+    for (int i = 0; i < kBufferCount; i++) {
+        ASSERT_EQ(IGraphicBufferProducer::BUFFER_NEEDS_REALLOCATION,
+                mProducer->dequeueBuffer(&slots[i], &fence, 1, 1, 0,
+                        GRALLOC_USAGE_SW_READ_OFTEN, nullptr, nullptr));
+        ASSERT_EQ(OK, mProducer->requestBuffer(slots[i], &buffer));
+    }
+    for (int i = 0; i < kBufferCount; i++) {
+        ASSERT_EQ(OK, mProducer->cancelBuffer(slots[i], Fence::NO_FENCE));
+    }
+
+    // Plain allocateBuffers only fills empty slots, so the 1x1 buffers stay
+    // and dequeueing at the new size still has to reallocate.
+    mProducer->allocateBuffers(16, 16, 0, GRALLOC_USAGE_SW_READ_OFTEN);
+    int slot = BufferQueue::INVALID_BUFFER_SLOT;
+    status_t result = mProducer->dequeueBuffer(&slot, &fence, 16, 16, 0,
+            GRALLOC_USAGE_SW_READ_OFTEN, nullptr, nullptr);
+    ASSERT_LE(OK, result);
+    EXPECT_TRUE(result & IGraphicBufferProducer::BUFFER_NEEDS_REALLOCATION);
+}
+
+TEST_F(BufferQueueTest, RequestBuffersReturnsPreallocatedBuffers) {
+    createBufferQueue();
+    sp<DummyConsumer> dc(new DummyConsumer);
+    ASSERT_EQ(OK, mConsumer->consumerConnect(dc, false));
+    IGraphicBufferProducer::QueueBufferOutput output;
+    ASSERT_EQ(OK, mProducer->connect(new DummyProducerListener,
+            NATIVE_WINDOW_API_CPU, false, &output));
+    ASSERT_EQ(OK, mProducer->setMaxDequeuedBufferCount(2));
+
+    const int kBufferCount = 3;
+    mProducer->allocateBuffers(16, 16, 0, GRALLOC_USAGE_SW_READ_OFTEN);
+
+    // The producer has not seen the preallocated buffer yet
+    int slot = BufferQueue::INVALID_BUFFER_SLOT;
+    sp<Fence> fence;
+    ASSERT_EQ(IGraphicBufferProducer::BUFFER_NEEDS_REALLOCATION,
+            mProducer->dequeueBuffer(&slot, &fence, 16, 16, 0,
+            GRALLOC_USAGE_SW_READ_OFTEN, nullptr, nullptr));
+    std::vector<IGraphicBufferProducer::RequestBufferOutput> buffers;
+    ASSERT_EQ(OK, mProducer->requestBuffers(slot, &buffers));
+    ASSERT_EQ(static_cast<size_t>(kBufferCount), buffers.size());
+    EXPECT_EQ(slot, buffers[0].slot);
+    for (const auto& requested : buffers) {
+        ASSERT_NE(nullptr, requested.buffer.get());
+        EXPECT_EQ(16u, requested.buffer->getWidth());
+    }
+
+    // The other slots are not reported as reallocated, and can be queued
+    // without requestBuffer
+    int otherSlot = BufferQueue::INVALID_BUFFER_SLOT;
+    ASSERT_EQ(OK, mProducer->dequeueBuffer(&otherSlot, &fence, 16, 16, 0,
+            GRALLOC_USAGE_SW_READ_OFTEN, nullptr, nullptr));
+    EXPECT_TRUE(std::any_of(buffers.begin(), buffers.end(),
+            [otherSlot](const auto& requested) { return requested.slot == otherSlot; }));
+    IGraphicBufferProducer::QueueBufferInput input(0, false,
+            HAL_DATASPACE_UNKNOWN, Rect(0, 0, 1, 1),
+            NATIVE_WINDOW_SCALING_MODE_FREEZE, 0, Fence::NO_FENCE);
+    ASSERT_EQ(OK, mProducer->queueBuffer(otherSlot, input, &output));
+
+    // Buffers already handed out are not returned again
+    ASSERT_EQ(OK, mProducer->requestBuffers(slot, &buffers));
+    ASSERT_EQ(1u, buffers.size());
+    EXPECT_EQ(slot, buffers[0].slot);
+
+    EXPECT_EQ(BAD_VALUE, mProducer->requestBuffers(-1, &buffers));
+}
+
 TEST_F(BufferQueueTest, CanRetrieveLastQueuedBuffer) {
     createBufferQueue();
     sp<DummyConsumer> dc(new DummyConsumer);
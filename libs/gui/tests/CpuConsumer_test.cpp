@@ -691,6 +691,86 @@ TEST_P(CpuConsumerTest, FromCpuInvalid) {
     ASSERT_EQ(BAD_VALUE, err) << "unlockBuffer did not fail";
 }
 
+TEST_P(CpuConsumerTest, FromCpuViews) {
+    status_t err;
+    CpuConsumerTestParams params = GetParam();
+
+    ASSERT_NO_FATAL_FAILURE(configureANW(mANW, params, params.maxLockedBuffers + 1));
+
+    const int64_t time = 1234L;
+    uint32_t stride;
+    for (int i = 0; i < params.maxLockedBuffers + 1; i++) {
+        ASSERT_NO_FATAL_FAILURE(produceOneFrame(mANW, params, time, &stride));
+    }
+
+    std::vector<std::shared_ptr<const CpuConsumer::LockedBuffer>> views(params.maxLockedBuffers);
+    for (int i = 0; i < params.maxLockedBuffers; i++) {
+        err = mCC->lockNextBufferView(&views[i]);
+        ASSERT_NO_ERROR(err, "lockNextBufferView error: ");
+
+        ASSERT_TRUE(views[i] != nullptr);
+        ASSERT_TRUE(views[i]->data != nullptr);
+        EXPECT_EQ(params.width, views[i]->width);
+        EXPECT_EQ(params.height, views[i]->height);
+        EXPECT_EQ(stride, views[i]->stride);
+        EXPECT_EQ(time, views[i]->timestamp);
+
+        checkAnyBuffer(*views[i], GetParam().format);
+    }
+
+    std::shared_ptr<const CpuConsumer::LockedBuffer> tooMuch;
+    err = mCC->lockNextBufferView(&tooMuch);
+    ASSERT_EQ(NOT_ENOUGH_DATA, err) << "Allowing too many locks";
+
+    // Views are only returned by dropping their last reference.
+    err = mCC->unlockBuffer(*views[0]);
+    ASSERT_EQ(BAD_VALUE, err) << "unlockBuffer accepted a view";
+
+    auto copy = views[0];
+    views[0].reset();
+    err = mCC->lockNextBufferView(&tooMuch);
+    ASSERT_EQ(NOT_ENOUGH_DATA, err) << "View was unlocked while still referenced";
+
+    copy.reset();
+    err = mCC->lockNextBufferView(&tooMuch);
+    ASSERT_NO_ERROR(err, "Did not allow new lock after dropping a view");
+    checkAnyBuffer(*tooMuch, GetParam().format);
+}
+
+TEST_P(CpuConsumerTest, FromCpuPersistentMapping) {
+    status_t err;
+    CpuConsumerTestParams params = GetParam();
+
+    ASSERT_NO_FATAL_FAILURE(configureANW(mANW, params, 1));
+    err = mCC->setPersistentMapping(true);
+    ASSERT_NO_ERROR(err, "setPersistentMapping error: ");
+
+    for (int i = 0; i < 10; i++) {
+        const int64_t time = 1000L + i;
+        uint32_t stride;
+        ASSERT_NO_FATAL_FAILURE(produceOneFrame(mANW, params, time, &stride));
+
+        CpuConsumer::LockedBuffer b;
+        err = mCC->lockNextBuffer(&b);
+        ASSERT_NO_ERROR(err, "getNextBuffer error: ");
+
+        ASSERT_TRUE(b.data != nullptr);
+        EXPECT_EQ(params.width, b.width);
+        EXPECT_EQ(params.height, b.height);
+        EXPECT_EQ(params.format, b.format);
+        EXPECT_EQ(stride, b.stride);
+        EXPECT_EQ(time, b.timestamp);
+
+        checkAnyBuffer(b, GetParam().format);
+
+        err = mCC->unlockBuffer(b);
+        ASSERT_NO_ERROR(err, "Could not unlock buffer: ");
+    }
+
+    err = mCC->setPersistentMapping(false);
+    ASSERT_NO_ERROR(err, "setPersistentMapping error: ");
+}
+
 TEST_P(CpuConsumerTest, FromCpuMultiThread) {
     CpuConsumerTestParams params = GetParam();
     ASSERT_NO_FATAL_FAILURE(configureANW(mANW, params, params.maxLockedBuffers + 1));
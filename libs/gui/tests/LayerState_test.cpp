@@ -0,0 +1,180 @@
+/*
+ * Copyright 2019 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#define LOG_TAG "LayerState_test"
+
+#include <gtest/gtest.h>
+
+#include <binder/Parcel.h>
+#include <gui/LayerState.h>
+
+namespace android {
+
+namespace {
+
+layer_state_t roundTrip(const layer_state_t& state) {
+    Parcel parcel;
+    EXPECT_EQ(NO_ERROR, state.write(parcel));
+    parcel.setDataPosition(0);
+    layer_state_t received;
+    EXPECT_EQ(NO_ERROR, received.read(parcel));
+    EXPECT_EQ(parcel.dataSize(), parcel.dataPosition());
+    return received;
+}
+
+} // namespace
+
+TEST(LayerStateTest, PositionOnlyStateSendsPosition) {
+    layer_state_t state;
+    state.what = layer_state_t::ePositionChanged;
+    state.x = 12.5f;
+    state.y = -3.0f;
+    // Not named by what, so not sent.
+    state.alpha = 0.5f;
+    state.z = 7;
+    state.crop = Rect(1, 2, 3, 4);
+
+    Parcel parcel;
+    ASSERT_EQ(NO_ERROR, state.write(parcel));
+    Parcel header;
+    header.writeStrongBinder(state.surface);
+    header.writeUint64(state.what);
+    EXPECT_EQ(header.dataSize() + 2 * sizeof(float), parcel.dataSize());
+
+    layer_state_t received = roundTrip(state);
+    EXPECT_EQ(state.what, received.what);
+    EXPECT_EQ(12.5f, received.x);
+    EXPECT_EQ(-3.0f, received.y);
+
+    const layer_state_t defaults;
+    EXPECT_EQ(defaults.alpha, received.alpha);
+    EXPECT_EQ(defaults.z, received.z);
+    EXPECT_EQ(defaults.crop, received.crop);
+    EXPECT_EQ(nullptr, received.buffer);
+    EXPECT_EQ(nullptr, received.acquireFence);
+}
+
+TEST(LayerStateTest, NamedFieldsRoundTrip) {
+    layer_state_t state;
+    state.what = layer_state_t::eLayerChanged | layer_state_t::eSizeChanged |
+            layer_state_t::eAlphaChanged | layer_state_t::eMatrixChanged |
+            layer_state_t::eTransparentRegionChanged | layer_state_t::eFlagsChanged |
+            layer_state_t::eLayerStackChanged | layer_state_t::eTransformChanged |
+            layer_state_t::eCropChanged | layer_state_t::eFrameChanged |
+            layer_state_t::eDataspaceChanged | layer_state_t::eColorTransformChanged |
+            layer_state_t::eCornerRadiusChanged | layer_state_t::eMetadataChanged |
+            layer_state_t::eBackgroundColorChanged | layer_state_t::eColorSpaceAgnosticChanged;
+    state.z = 4;
+    state.w = 640;
+    state.h = 480;
+    state.alpha = 0.25f;
+    state.matrix.dsdx = 2.0f;
+    state.matrix.dtdx = 0.5f;
+    state.matrix.dtdy = -0.5f;
+    state.matrix.dsdy = 3.0f;
+    state.transparentRegion = Region(Rect(10, 10, 20, 20));
+    state.flags = layer_state_t::eLayerOpaque;
+    state.mask = layer_state_t::eLayerOpaque | layer_state_t::eLayerHidden;
+    state.layerStack = 3;
+    state.transform = 4;
+    state.crop = Rect(0, 0, 32, 16);
+    state.frame = Rect(5, 6, 37, 22);
+    state.dataspace = ui::Dataspace::DISPLAY_P3;
+    state.colorTransform[0][0] = 0.5f;
+    state.colorTransform[3][1] = 0.25f;
+    state.cornerRadius = 8.0f;
+    state.metadata.setInt32(METADATA_WINDOW_TYPE, 2);
+    state.color = half3(0.25f, 0.5f, 0.75f);
+    state.bgColorAlpha = 0.75f;
+    state.bgColorDataspace = ui::Dataspace::SRGB;
+    state.colorSpaceAgnostic = true;
+
+    layer_state_t received = roundTrip(state);
+    EXPECT_EQ(state.what, received.what);
+    EXPECT_EQ(state.z, received.z);
+    EXPECT_EQ(state.w, received.w);
+    EXPECT_EQ(state.h, received.h);
+    EXPECT_EQ(state.alpha, received.alpha);
+    EXPECT_EQ(state.matrix.dsdx, received.matrix.dsdx);
+    EXPECT_EQ(state.matrix.dtdx, received.matrix.dtdx);
+    EXPECT_EQ(state.matrix.dtdy, received.matrix.dtdy);
+    EXPECT_EQ(state.matrix.dsdy, received.matrix.dsdy);
+    EXPECT_TRUE(state.transparentRegion.subtract(received.transparentRegion).isEmpty());
+    EXPECT_TRUE(received.transparentRegion.subtract(state.transparentRegion).isEmpty());
+    EXPECT_EQ(state.flags, received.flags);
+    EXPECT_EQ(state.mask, received.mask);
+    EXPECT_EQ(state.layerStack, received.layerStack);
+    EXPECT_EQ(state.transform, received.transform);
+    EXPECT_EQ(state.crop, received.crop);
+    EXPECT_EQ(state.frame, received.frame);
+    EXPECT_EQ(state.dataspace, received.dataspace);
+    for (int i = 0; i < 16; i++) {
+        EXPECT_EQ(state.colorTransform.asArray()[i], received.colorTransform.asArray()[i]);
+    }
+    EXPECT_EQ(state.cornerRadius, received.cornerRadius);
+    EXPECT_EQ(2, received.metadata.getInt32(METADATA_WINDOW_TYPE, 0));
+    EXPECT_EQ(state.color, received.color);
+    EXPECT_EQ(state.bgColorAlpha, received.bgColorAlpha);
+    EXPECT_EQ(state.bgColorDataspace, received.bgColorDataspace);
+    EXPECT_EQ(state.colorSpaceAgnostic, received.colorSpaceAgnostic);
+}
+
+TEST(LayerStateTest, SharedFieldsAreSentForEitherFlag) {
+    layer_state_t relative;
+    relative.what = layer_state_t::eRelativeLayerChanged;
+    relative.z = -2;
+    EXPECT_EQ(-2, roundTrip(relative).z);
+
+    layer_state_t background;
+    background.what = layer_state_t::eBackgroundColorChanged;
+    background.color = half3(1.0f, 0.0f, 0.5f);
+    background.bgColorAlpha = 0.5f;
+    layer_state_t received = roundTrip(background);
+    EXPECT_EQ(background.color, received.color);
+    EXPECT_EQ(0.5f, received.bgColorAlpha);
+}
+
+TEST(LayerStateTest, ConsecutiveStatesStayInSync) {
+    layer_state_t first;
+    first.what = layer_state_t::ePositionChanged | layer_state_t::eCornerRadiusChanged;
+    first.x = 1.0f;
+    first.y = 2.0f;
+    first.cornerRadius = 3.0f;
+    layer_state_t second;
+    second.what = layer_state_t::eAlphaChanged | layer_state_t::eCropChanged;
+    second.alpha = 0.75f;
+    second.crop = Rect(4, 5, 6, 7);
+
+    Parcel parcel;
+    ASSERT_EQ(NO_ERROR, first.write(parcel));
+    ASSERT_EQ(NO_ERROR, second.write(parcel));
+    parcel.setDataPosition(0);
+
+    layer_state_t receivedFirst;
+    layer_state_t receivedSecond;
+    ASSERT_EQ(NO_ERROR, receivedFirst.read(parcel));
+    ASSERT_EQ(NO_ERROR, receivedSecond.read(parcel));
+    EXPECT_EQ(parcel.dataSize(), parcel.dataPosition());
+
+    EXPECT_EQ(first.what, receivedFirst.what);
+    EXPECT_EQ(2.0f, receivedFirst.y);
+    EXPECT_EQ(3.0f, receivedFirst.cornerRadius);
+    EXPECT_EQ(second.what, receivedSecond.what);
+    EXPECT_EQ(0.75f, receivedSecond.alpha);
+    EXPECT_EQ(second.crop, receivedSecond.crop);
+}
+
+} // namespace android
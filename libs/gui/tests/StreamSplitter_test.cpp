@@ -28,6 +28,9 @@
 
 #include <gtest/gtest.h>
 
+#include <thread>
+#include <vector>
+
 namespace android {
 
 class StreamSplitterTest : public ::testing::Test {
@@ -195,6 +198,72 @@ TEST_F(StreamSplitterTest, OneInputMultipleOutputs) {
                                            nullptr, nullptr));
 }
 
+TEST_F(StreamSplitterTest, OutputsReleasingConcurrently) {
+    const int NUM_OUTPUTS = 4;
+    const int NUM_FRAMES = 8;
+
+    sp<IGraphicBufferProducer> inputProducer;
+    sp<IGraphicBufferConsumer> inputConsumer;
+    BufferQueue::createBufferQueue(&inputProducer, &inputConsumer);
+
+    sp<IGraphicBufferProducer> outputProducers[NUM_OUTPUTS] = {};
+    sp<IGraphicBufferConsumer> outputConsumers[NUM_OUTPUTS] = {};
+    for (int output = 0; output < NUM_OUTPUTS; ++output) {
+        BufferQueue::createBufferQueue(&outputProducers[output],
+                &outputConsumers[output]);
+        ASSERT_EQ(OK, outputConsumers[output]->consumerConnect(
+                    new DummyListener, false));
+    }
+
+    sp<StreamSplitter> splitter;
+    status_t status = StreamSplitter::createSplitter(inputConsumer, &splitter);
+    ASSERT_EQ(OK, status);
+    for (int output = 0; output < NUM_OUTPUTS; ++output) {
+        ASSERT_EQ(OK, splitter->addOutput(outputProducers[output]));
+        ASSERT_EQ(OK, outputProducers[output]->allowAllocation(false));
+    }
+
+    IGraphicBufferProducer::QueueBufferOutput qbOutput;
+    ASSERT_EQ(OK, inputProducer->connect(new DummyProducerListener,
+            NATIVE_WINDOW_API_CPU, false, &qbOutput));
+    // Fail rather than hang if a buffer never makes it back to the input
+    ASSERT_EQ(OK, inputProducer->setDequeueTimeout(ms2ns(1000)));
+
+    IGraphicBufferProducer::QueueBufferInput qbInput(0, false,
+            HAL_DATASPACE_UNKNOWN, Rect(0, 0, 1, 1),
+            NATIVE_WINDOW_SCALING_MODE_FREEZE, 0, Fence::NO_FENCE);
+    for (int frame = 0; frame < NUM_FRAMES; ++frame) {
+        int slot;
+        sp<Fence> fence;
+        sp<GraphicBuffer> buffer;
+        ASSERT_LE(OK, inputProducer->dequeueBuffer(&slot, &fence, 0, 0, 0,
+                GRALLOC_USAGE_SW_WRITE_OFTEN, nullptr, nullptr));
+        ASSERT_EQ(OK, inputProducer->requestBuffer(slot, &buffer));
+        ASSERT_EQ(OK, inputProducer->queueBuffer(slot, qbInput, &qbOutput));
+
+        // Every output releases the buffer from its own thread at once
+        std::vector<std::thread> releasers;
+        std::vector<status_t> results(NUM_OUTPUTS, NO_INIT);
+        for (int output = 0; output < NUM_OUTPUTS; ++output) {
+            releasers.emplace_back([&, output]() {
+                BufferItem item;
+                results[output] = outputConsumers[output]->acquireBuffer(&item, 0);
+                if (results[output] == OK) {
+                    results[output] = outputConsumers[output]->releaseBuffer(item.mSlot,
+                            item.mFrameNumber, EGL_NO_DISPLAY, EGL_NO_SYNC_KHR,
+                            Fence::NO_FENCE);
+                }
+            });
+        }
+        for (std::thread& releaser : releasers) {
+            releaser.join();
+        }
+        for (int output = 0; output < NUM_OUTPUTS; ++output) {
+            ASSERT_EQ(OK, results[output]) << "output " << output << " frame " << frame;
+        }
+    }
+}
+
 TEST_F(StreamSplitterTest, OutputAbandonment) {
     sp<IGraphicBufferProducer> inputProducer;
     sp<IGraphicBufferConsumer> inputConsumer;
@@ -696,6 +696,84 @@ TEST_F(SurfaceTextureGLTest, AbandonUnblocksDequeueBuffer) {
             reinterpret_cast<ProducerThread*>(pt.get())->getDequeueError());
 }
 
+// Fills a whole RGBA8 buffer with one color.
+static void fillRGBA8BufferSolid(const sp<GraphicBuffer>& buf, uint8_t r, uint8_t g, uint8_t b,
+        uint8_t a) {
+    uint8_t* img = nullptr;
+    ASSERT_EQ(NO_ERROR, buf->lock(GRALLOC_USAGE_SW_WRITE_OFTEN, reinterpret_cast<void**>(&img)));
+    for (uint32_t y = 0; y < buf->getHeight(); y++) {
+        for (uint32_t x = 0; x < buf->getWidth(); x++) {
+            uint8_t* pixel = img + 4 * (y * buf->getStride() + x);
+            pixel[0] = r;
+            pixel[1] = g;
+            pixel[2] = b;
+            pixel[3] = a;
+        }
+    }
+    ASSERT_EQ(NO_ERROR, buf->unlock());
+}
+
+// A buffer detached and attached back, as StreamSplitter outputs are on every frame, keeps
+// its EGLImage; the texture must still show what was written to it since.
+TEST_F(SurfaceTextureGLTest, TexturingFromReattachedBuffer) {
+    const int texWidth = 64;
+    const int texHeight = 64;
+    const uint64_t usage = GRALLOC_USAGE_SW_READ_OFTEN | GRALLOC_USAGE_SW_WRITE_OFTEN;
+
+    ASSERT_EQ(NO_ERROR, native_window_api_connect(mANW.get(), NATIVE_WINDOW_API_CPU));
+    sp<IGraphicBufferProducer> producer = mSTC->getIGraphicBufferProducer();
+    IGraphicBufferProducer::QueueBufferInput input(0, false, HAL_DATASPACE_UNKNOWN,
+            Rect(texWidth, texHeight), NATIVE_WINDOW_SCALING_MODE_FREEZE, 0, Fence::NO_FENCE);
+    IGraphicBufferProducer::QueueBufferOutput output;
+
+    auto expectTexture = [&](int r, int g, int b, int a) {
+        ASSERT_EQ(NO_ERROR, mST->updateTexImage());
+        glClearColor(0.2, 0.2, 0.2, 0.2);
+        glClear(GL_COLOR_BUFFER_BIT);
+        glViewport(0, 0, texWidth, texHeight);
+        drawTexture();
+        EXPECT_TRUE(checkPixel(texWidth / 2, texHeight / 2, r, g, b, a));
+    };
+
+    sp<GraphicBuffer> buffers[2];
+    const uint8_t colors[2][4] = {{255, 0, 0, 255}, {0, 255, 0, 255}};
+    for (int i = 0; i < 2; i++) {
+        int slot;
+        sp<Fence> fence;
+        ASSERT_LE(0, producer->dequeueBuffer(&slot, &fence, texWidth, texHeight,
+                HAL_PIXEL_FORMAT_RGBA_8888, usage, nullptr, nullptr));
+        ASSERT_EQ(NO_ERROR, producer->requestBuffer(slot, &buffers[i]));
+        ASSERT_EQ(NO_ERROR, fence->wait(Fence::TIMEOUT_NEVER));
+        ASSERT_NO_FATAL_FAILURE(fillRGBA8BufferSolid(buffers[i], colors[i][0], colors[i][1],
+                colors[i][2], colors[i][3]));
+        ASSERT_EQ(NO_ERROR, producer->queueBuffer(slot, input, &output));
+        ASSERT_NO_FATAL_FAILURE(expectTexture(colors[i][0], colors[i][1], colors[i][2],
+                colors[i][3]));
+    }
+
+    // The first buffer was released when the second was latched.
+    sp<GraphicBuffer> detached;
+    sp<Fence> fence;
+    ASSERT_EQ(NO_ERROR, producer->detachNextBuffer(&detached, &fence));
+    ASSERT_EQ(buffers[0]->getId(), detached->getId());
+    ASSERT_EQ(NO_ERROR, fence->wait(Fence::TIMEOUT_NEVER));
+
+    ASSERT_NO_FATAL_FAILURE(fillRGBA8BufferSolid(detached, 0, 0, 255, 255));
+    int slot;
+    ASSERT_LE(0, producer->attachBuffer(&slot, detached));
+    ASSERT_EQ(NO_ERROR, producer->queueBuffer(slot, input, &output));
+    ASSERT_NO_FATAL_FAILURE(expectTexture(0, 0, 255, 255));
+
+    // A buffer that was never sent gets an image of its own.
+    sp<GraphicBuffer> fresh = new GraphicBuffer(texWidth, texHeight, HAL_PIXEL_FORMAT_RGBA_8888,
+            1, usage | GRALLOC_USAGE_HW_TEXTURE, "TexturingFromReattachedBuffer");
+    ASSERT_EQ(NO_ERROR, fresh->initCheck());
+    ASSERT_NO_FATAL_FAILURE(fillRGBA8BufferSolid(fresh, 255, 255, 255, 255));
+    ASSERT_LE(0, producer->attachBuffer(&slot, fresh));
+    ASSERT_EQ(NO_ERROR, producer->queueBuffer(slot, input, &output));
+    ASSERT_NO_FATAL_FAILURE(expectTexture(255, 255, 255, 255));
+}
+
 TEST_F(SurfaceTextureGLTest, InvalidWidthOrHeightFails) {
     int texHeight = 16;
     ANativeWindowBuffer* anb;
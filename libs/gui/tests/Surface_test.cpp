@@ -342,6 +342,36 @@ TEST_F(SurfaceTest, QueryDefaultBuffersDataSpace) {
     ASSERT_EQ(TEST_DATASPACE, dataSpace);
 }
 
+TEST_F(SurfaceTest, FastDispatchSetsBuffersTimestamp) {
+    sp<IGraphicBufferProducer> producer;
+    sp<IGraphicBufferConsumer> consumer;
+    BufferQueue::createBufferQueue(&producer, &consumer);
+    sp<BufferItemConsumer> c = new BufferItemConsumer(consumer, GRALLOC_USAGE_SW_READ_OFTEN);
+    sp<Surface> s = new Surface(producer);
+    sp<ANativeWindow> anw(s);
+
+    const ANativeWindowFastDispatch* dispatch = nullptr;
+    ASSERT_EQ(NO_ERROR, native_window_get_fast_dispatch(anw.get(), &dispatch));
+    ASSERT_TRUE(NATIVE_WINDOW_FAST_DISPATCH_HAS(dispatch, setBuffersTimestamp));
+    ASSERT_TRUE(NATIVE_WINDOW_FAST_DISPATCH_HAS(dispatch, setBuffersDataSpace));
+    ASSERT_TRUE(NATIVE_WINDOW_FAST_DISPATCH_HAS(dispatch, setSurfaceDamage));
+
+    ASSERT_EQ(NO_ERROR, native_window_api_connect(anw.get(), NATIVE_WINDOW_API_CPU));
+    const int64_t timestamp = 123456789;
+    ASSERT_EQ(NO_ERROR, dispatch->setBuffersTimestamp(anw.get(), timestamp));
+
+    ANativeWindowBuffer* buffer;
+    int fenceFd;
+    ASSERT_EQ(NO_ERROR, anw->dequeueBuffer(anw.get(), &buffer, &fenceFd));
+    ASSERT_EQ(NO_ERROR, anw->queueBuffer(anw.get(), buffer, fenceFd));
+
+    BufferItem item;
+    ASSERT_EQ(NO_ERROR, c->acquireBuffer(&item, 0));
+    EXPECT_EQ(timestamp, item.mTimestamp);
+    EXPECT_EQ(NO_ERROR, c->releaseBuffer(item));
+    EXPECT_EQ(NO_ERROR, native_window_api_disconnect(anw.get(), NATIVE_WINDOW_API_CPU));
+}
+
 TEST_F(SurfaceTest, SettingGenerationNumber) {
     sp<IGraphicBufferProducer> producer;
     sp<IGraphicBufferConsumer> consumer;
@@ -653,7 +683,12 @@ public:
         mAddAndGetFrameTimestampsCallCount++;
     }
 
+    base::unique_fd getSharedFrameEvents() override {
+        return mShareFrameEvents ? mFrameEventHistory.getSharedEvents() : base::unique_fd();
+    }
+
     bool mGetFrameTimestampsEnabled = false;
+    bool mShareFrameEvents = false;
 
     ConsumerFrameEventHistory mFrameEventHistory;
     int mAddAndGetFrameTimestampsCallCount = 0;
@@ -1625,6 +1660,91 @@ TEST_F(GetFrameTimestampsTest, QueueTimestampsNoSync) {
     EXPECT_EQ(mFrames[1].kProducerAcquireTime, outAcquireTime);
 }
 
+// This test verifies that the producer reads the frame events from the memory
+// shared with the consumer instead of asking the consumer for them.
+TEST_F(GetFrameTimestampsTest, SharedEventsNoSync) {
+    mFakeConsumer->mShareFrameEvents = true;
+    enableFrameTimestamps();
+
+    const uint64_t fId1 = getNextFrameId();
+    dequeueAndQueue(0);
+    mFrames[0].signalQueueFences();
+
+    const uint64_t fId2 = getNextFrameId();
+    dequeueAndQueue(1);
+    mFrames[1].signalQueueFences();
+
+    // Signal the fences before the consumer records them, so that it shares
+    // their signal times, which lets the producer do without the fences.
+    mFrames[0].signalRefreshFences();
+    mFrames[0].signalReleaseFences();
+    mFrames[1].signalRefreshFences();
+    addFrameEvents(true, NO_FRAME_INDEX, 0);
+    addFrameEvents(true, 0, 1);
+
+    resetTimestamps();
+    int oldCount = mFakeConsumer->mGetFrameTimestampsCount;
+    int result = getAllFrameTimestamps(fId1);
+    EXPECT_EQ(oldCount, mFakeConsumer->mGetFrameTimestampsCount);
+    EXPECT_EQ(NO_ERROR, result);
+    EXPECT_EQ(mFrames[0].kRequestedPresentTime, outRequestedPresentTime);
+    EXPECT_EQ(mFrames[0].kProducerAcquireTime, outAcquireTime);
+    EXPECT_EQ(mFrames[0].kLatchTime, outLatchTime);
+    EXPECT_EQ(mFrames[0].mRefreshes[0].kStartTime, outFirstRefreshStartTime);
+    EXPECT_EQ(mFrames[0].mRefreshes[2].kStartTime, outLastRefreshStartTime);
+    EXPECT_EQ(mFrames[0].mRefreshes[0].kGpuCompositionDoneTime,
+            outGpuCompositionDoneTime);
+    EXPECT_EQ(mFrames[0].mRefreshes[0].kPresentTime, outDisplayPresentTime);
+    EXPECT_EQ(mFrames[0].kDequeueReadyTime, outDequeueReadyTime);
+    EXPECT_EQ(mFrames[0].kReleaseTime, outReleaseTime);
+
+    resetTimestamps();
+    oldCount = mFakeConsumer->mGetFrameTimestampsCount;
+    result = getAllFrameTimestamps(fId2);
+    EXPECT_EQ(oldCount, mFakeConsumer->mGetFrameTimestampsCount);
+    EXPECT_EQ(NO_ERROR, result);
+    EXPECT_EQ(mFrames[1].kLatchTime, outLatchTime);
+    EXPECT_EQ(mFrames[1].mRefreshes[0].kGpuCompositionDoneTime,
+            outGpuCompositionDoneTime);
+    EXPECT_EQ(mFrames[1].mRefreshes[0].kPresentTime, outDisplayPresentTime);
+    EXPECT_EQ(NATIVE_WINDOW_TIMESTAMP_PENDING, outDequeueReadyTime);
+    EXPECT_EQ(NATIVE_WINDOW_TIMESTAMP_PENDING, outReleaseTime);
+}
+
+// This test verifies that the producer still asks the consumer for the fences
+// whose signal times the shared events do not have yet.
+TEST_F(GetFrameTimestampsTest, SharedEventsPendingFencesSync) {
+    mFakeConsumer->mShareFrameEvents = true;
+    enableFrameTimestamps();
+
+    const uint64_t fId1 = getNextFrameId();
+    dequeueAndQueue(0);
+    mFrames[0].signalQueueFences();
+
+    addFrameEvents(true, NO_FRAME_INDEX, 0);
+
+    resetTimestamps();
+    int oldCount = mFakeConsumer->mGetFrameTimestampsCount;
+    int result = getAllFrameTimestamps(fId1);
+    EXPECT_EQ(oldCount + 1, mFakeConsumer->mGetFrameTimestampsCount);
+    EXPECT_EQ(NO_ERROR, result);
+    EXPECT_EQ(mFrames[0].kLatchTime, outLatchTime);
+    EXPECT_EQ(NATIVE_WINDOW_TIMESTAMP_PENDING, outGpuCompositionDoneTime);
+    EXPECT_EQ(NATIVE_WINDOW_TIMESTAMP_PENDING, outDisplayPresentTime);
+
+    // The producer has the fences now, so it learns of their signal times
+    // without asking again.
+    mFrames[0].signalRefreshFences();
+    resetTimestamps();
+    oldCount = mFakeConsumer->mGetFrameTimestampsCount;
+    result = getAllFrameTimestamps(fId1);
+    EXPECT_EQ(oldCount, mFakeConsumer->mGetFrameTimestampsCount);
+    EXPECT_EQ(NO_ERROR, result);
+    EXPECT_EQ(mFrames[0].mRefreshes[0].kGpuCompositionDoneTime,
+            outGpuCompositionDoneTime);
+    EXPECT_EQ(mFrames[0].mRefreshes[0].kPresentTime, outDisplayPresentTime);
+}
+
 TEST_F(GetFrameTimestampsTest, ZeroRequestedTimestampsNoSync) {
     enableFrameTimestamps();
 
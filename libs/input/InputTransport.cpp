@@ -23,12 +23,17 @@
 #include <fcntl.h>
 #include <inttypes.h>
 #include <math.h>
+#include <sys/mman.h>
 #include <sys/socket.h>
 #include <sys/types.h>
 #include <unistd.h>
 
+#include <algorithm>
+#include <atomic>
+
 #include <android-base/stringprintf.h>
 #include <binder/Parcel.h>
+#include <cutils/ashmem.h>
 #include <cutils/properties.h>
 #include <log/log.h>
 #include <utils/Trace.h>
@@ -75,6 +80,19 @@ static const nsecs_t RESAMPLE_MAX_PREDICTION = 8 * NANOS_PER_MS;
  */
 static const char* PROPERTY_RESAMPLING_ENABLED = "ro.input.resampling";
 
+/**
+ * System property for passing InputChannel messages through shared memory rings.
+ * Set to "1" to have new channel pairs use them, see InputChannel::openInputChannelPair.
+ */
+static const char* PROPERTY_SHARED_RING_ENABLED = "ro.input.channel_shared_ring";
+
+// Messages each direction of a shared ring holds, about what the socket buffer fits
+static const uint32_t SHARED_RING_CAPACITY = 32;
+
+// What goes through the socket to wake a receiver waiting on a shared ring. It is
+// shorter than any InputMessage, so cannot be mistaken for one.
+static const uint8_t SHARED_RING_DOORBELL = 0;
+
 template<typename T>
 inline static T min(const T& a, const T& b) {
     return a < b ? a : b;
@@ -84,6 +102,14 @@ inline static float lerp(float a, float b, float alpha) {
     return a + alpha * (b - a);
 }
 
+// Weights of the samples at times t0, t1 and t2 in the value at time t of the
+// parabola through them, times given relative to t0.
+inline static void quadraticWeights(float t1, float t2, float t, float outWeights[3]) {
+    outWeights[0] = (t - t1) * (t - t2) / (t1 * t2);
+    outWeights[1] = t * (t - t2) / (t1 * (t1 - t2));
+    outWeights[2] = t * (t - t1) / (t2 * (t2 - t1));
+}
+
 inline static bool isPointerEvent(int32_t source) {
     return (source & AINPUT_SOURCE_CLASS_POINTER) == AINPUT_SOURCE_CLASS_POINTER;
 }
@@ -211,6 +237,7 @@ void InputMessage::getSanitizedCopy(InputMessage* msg) const {
         case InputMessage::TYPE_FINISHED: {
             msg->body.finished.seq = body.finished.seq;
             msg->body.finished.handled = body.finished.handled;
+            msg->body.finished.consumeTime = body.finished.consumeTime;
             break;
         }
         default: {
@@ -220,6 +247,84 @@ void InputMessage::getSanitizedCopy(InputMessage* msg) const {
     }
 }
 
+// --- InputChannel::SharedRings ---
+
+/*
+ * One direction of a channel's shared memory. head and tail count the messages
+ * received and sent so far, and only ever grow; the receiver only writes head,
+ * the sender tail and the slots. Neither end trusts what the other wrote: a
+ * message is validated once copied out, and indices are wrapped into range.
+ */
+struct InputChannelRing {
+    std::atomic<uint32_t> head;
+    std::atomic<uint32_t> tail;
+    // Set by the receiver once it has drained the ring and goes back to polling
+    // the socket, for the sender to ring the doorbell when it adds a message
+    std::atomic<uint32_t> receiverWaiting;
+
+    struct Slot {
+        uint32_t length;
+        InputMessage message;
+    } slots[SHARED_RING_CAPACITY];
+};
+
+static_assert(std::atomic<uint32_t>::is_always_lock_free,
+              "shared ring atomics must work across processes");
+
+// Maps the memory holding both rings of a channel pair
+class InputChannel::SharedRings {
+public:
+    static std::shared_ptr<SharedRings> create(const std::string& name) {
+        int fd = ashmem_create_region(name.c_str(), sizeof(InputChannelRing) * 2);
+        if (fd < 0) {
+            ALOGE("channel '%s' ~ Could not create shared rings.  errno=%d", name.c_str(), errno);
+            return nullptr;
+        }
+        // ashmem starts out zeroed, which is two empty rings
+        std::shared_ptr<SharedRings> rings = fromFd(fd);
+        if (rings) {
+            // Neither end has looked at its ring yet and may go straight to
+            // polling the socket, so the first message must ring the doorbell
+            rings->getRing(0).receiverWaiting.store(1, std::memory_order_relaxed);
+            rings->getRing(1).receiverWaiting.store(1, std::memory_order_relaxed);
+        }
+        return rings;
+    }
+
+    // Takes ownership of fd
+    static std::shared_ptr<SharedRings> fromFd(int fd) {
+        const int size = ashmem_get_size_region(fd);
+        if (size < 0 || size_t(size) < sizeof(InputChannelRing) * 2) {
+            ALOGE("Shared rings region is too small (%d)", size);
+            ::close(fd);
+            return nullptr;
+        }
+        void* memory = mmap(nullptr, sizeof(InputChannelRing) * 2, PROT_READ | PROT_WRITE,
+                            MAP_SHARED, fd, 0);
+        if (memory == MAP_FAILED) {
+            ALOGE("Could not map shared rings.  errno=%d", errno);
+            ::close(fd);
+            return nullptr;
+        }
+        return std::shared_ptr<SharedRings>(
+                new SharedRings(fd, static_cast<InputChannelRing*>(memory)));
+    }
+
+    ~SharedRings() {
+        munmap(mRings, sizeof(InputChannelRing) * 2);
+        ::close(mFd);
+    }
+
+    int getFd() const { return mFd; }
+    InputChannelRing& getRing(uint32_t index) { return mRings[index % 2]; }
+
+private:
+    SharedRings(int fd, InputChannelRing* rings) : mFd(fd), mRings(rings) {}
+
+    const int mFd;
+    InputChannelRing* const mRings;
+};
+
 // --- InputChannel ---
 
 InputChannel::InputChannel(const std::string& name, int fd) :
@@ -255,6 +360,13 @@ void InputChannel::setFd(int fd) {
 
 status_t InputChannel::openInputChannelPair(const std::string& name,
         sp<InputChannel>& outServerChannel, sp<InputChannel>& outClientChannel) {
+    return openInputChannelPair(name, outServerChannel, outClientChannel,
+                                property_get_bool(PROPERTY_SHARED_RING_ENABLED, false));
+}
+
+status_t InputChannel::openInputChannelPair(const std::string& name,
+        sp<InputChannel>& outServerChannel, sp<InputChannel>& outClientChannel,
+        bool useSharedRing) {
     int sockets[2];
     if (socketpair(AF_UNIX, SOCK_SEQPACKET, 0, sockets)) {
         status_t result = -errno;
@@ -278,6 +390,15 @@ status_t InputChannel::openInputChannelPair(const std::string& name,
     std::string clientChannelName = name;
     clientChannelName += " (client)";
     outClientChannel = new InputChannel(clientChannelName, sockets[1]);
+
+    if (useSharedRing) {
+        // Falls back to the socket alone if the rings cannot be made
+        std::shared_ptr<SharedRings> rings = SharedRings::create(name);
+        outServerChannel->mRings = rings;
+        outServerChannel->mSendRingIndex = 0;
+        outClientChannel->mRings = rings;
+        outClientChannel->mSendRingIndex = 1;
+    }
     return OK;
 }
 
@@ -285,17 +406,122 @@ status_t InputChannel::sendMessage(const InputMessage* msg) {
     const size_t msgLength = msg->size();
     InputMessage cleanMsg;
     msg->getSanitizedCopy(&cleanMsg);
+    size_t sent;
+    status_t status = mRings ? sendRingMessages(&cleanMsg, 1, &sent)
+                             : sendSocketMessage(&cleanMsg, msgLength);
+
+#if DEBUG_CHANNEL_MESSAGES
+    if (status == OK) {
+        ALOGD("channel '%s' ~ sent message of type %d", mName.c_str(), msg->header.type);
+    } else {
+        ALOGD("channel '%s' ~ error sending message of type %d, status=%d", mName.c_str(),
+                msg->header.type, status);
+    }
+#endif
+    return status;
+}
+
+status_t InputChannel::sendMessages(const InputMessage* msgs, size_t count, size_t* outSent) {
+    std::vector<InputMessage> cleanMsgs(count);
+    for (size_t i = 0; i < count; i++) {
+        msgs[i].getSanitizedCopy(&cleanMsgs[i]);
+    }
+    status_t status = mRings ? sendRingMessages(cleanMsgs.data(), count, outSent)
+                             : sendSocketMessages(cleanMsgs.data(), count, outSent);
+
+#if DEBUG_CHANNEL_MESSAGES
+    ALOGD("channel '%s' ~ sent %zu of %zu messages, status=%d", mName.c_str(), *outSent, count,
+            status);
+#endif
+    return status;
+}
+
+status_t InputChannel::sendRingMessages(const InputMessage* cleanMsgs, size_t count,
+                                        size_t* outSent) {
+    InputChannelRing& ring = mRings->getRing(mSendRingIndex);
+    const uint32_t tail = ring.tail.load(std::memory_order_relaxed);
+    const uint32_t space =
+            SHARED_RING_CAPACITY - std::min(tail - ring.head.load(std::memory_order_acquire),
+                                            SHARED_RING_CAPACITY);
+    *outSent = std::min(count, size_t(space));
+    if (*outSent == 0) {
+        return WOULD_BLOCK;
+    }
+
+    for (size_t i = 0; i < *outSent; i++) {
+        InputChannelRing::Slot& slot = ring.slots[(tail + i) % SHARED_RING_CAPACITY];
+        const size_t length = cleanMsgs[i].size();
+        memcpy(&slot.message, &cleanMsgs[i], length);
+        slot.length = uint32_t(length);
+    }
+    // Ordered against the receiver setting receiverWaiting and then checking tail,
+    // so that either it sees these messages or this sees it waiting.
+    ring.tail.store(tail + uint32_t(*outSent), std::memory_order_seq_cst);
+
+    if (ring.receiverWaiting.exchange(0, std::memory_order_seq_cst) != 0) {
+        // The message is sent whatever happens to the doorbell. A full socket
+        // already wakes the receiver, so only a closed one is worth reporting.
+        status_t status =
+                sendSocketMessage(&SHARED_RING_DOORBELL, sizeof(SHARED_RING_DOORBELL));
+        if (status == DEAD_OBJECT) {
+            return status;
+        }
+    }
+    return *outSent == count ? OK : WOULD_BLOCK;
+}
+
+status_t InputChannel::sendSocketMessages(const InputMessage* cleanMsgs, size_t count,
+                                          size_t* outSent) {
+    // Each message stays its own packet, sent together with the others in one sendmmsg()
+    std::vector<iovec> iovs(count);
+    std::vector<mmsghdr> headers(count);
+    for (size_t i = 0; i < count; i++) {
+        iovs[i].iov_base = const_cast<InputMessage*>(&cleanMsgs[i]);
+        iovs[i].iov_len = cleanMsgs[i].size();
+        memset(&headers[i], 0, sizeof(mmsghdr));
+        headers[i].msg_hdr.msg_iov = &iovs[i];
+        headers[i].msg_hdr.msg_iovlen = 1;
+    }
+
+    *outSent = 0;
+    while (*outSent < count) {
+        int nSent = ::sendmmsg(mFd, &headers[*outSent], count - *outSent,
+                               MSG_DONTWAIT | MSG_NOSIGNAL);
+        if (nSent < 0) {
+            int error = errno;
+            if (error == EINTR) {
+                continue;
+            }
+            if (error == EAGAIN || error == EWOULDBLOCK) {
+                return WOULD_BLOCK;
+            }
+            if (error == EPIPE || error == ENOTCONN || error == ECONNREFUSED ||
+                error == ECONNRESET) {
+                return DEAD_OBJECT;
+            }
+            return -error;
+        }
+        for (int i = 0; i < nSent; i++, (*outSent)++) {
+            if (headers[*outSent].msg_len != iovs[*outSent].iov_len) {
+#if DEBUG_CHANNEL_MESSAGES
+                ALOGD("channel '%s' ~ error sending message, send was incomplete",
+                        mName.c_str());
+#endif
+                return DEAD_OBJECT;
+            }
+        }
+    }
+    return OK;
+}
+
+status_t InputChannel::sendSocketMessage(const void* data, size_t length) {
     ssize_t nWrite;
     do {
-        nWrite = ::send(mFd, &cleanMsg, msgLength, MSG_DONTWAIT | MSG_NOSIGNAL);
+        nWrite = ::send(mFd, data, length, MSG_DONTWAIT | MSG_NOSIGNAL);
     } while (nWrite == -1 && errno == EINTR);
 
     if (nWrite < 0) {
         int error = errno;
-#if DEBUG_CHANNEL_MESSAGES
-        ALOGD("channel '%s' ~ error sending message of type %d, errno=%d", mName.c_str(),
-                msg->header.type, error);
-#endif
         if (error == EAGAIN || error == EWOULDBLOCK) {
             return WOULD_BLOCK;
         }
@@ -305,25 +531,71 @@ status_t InputChannel::sendMessage(const InputMessage* msg) {
         return -error;
     }
 
-    if (size_t(nWrite) != msgLength) {
+    if (size_t(nWrite) != length) {
 #if DEBUG_CHANNEL_MESSAGES
-        ALOGD("channel '%s' ~ error sending message type %d, send was incomplete",
-                mName.c_str(), msg->header.type);
+        ALOGD("channel '%s' ~ error sending message, send was incomplete", mName.c_str());
 #endif
         return DEAD_OBJECT;
     }
+    return OK;
+}
+
+status_t InputChannel::receiveMessage(InputMessage* msg) {
+    if (!mRings) {
+        return receiveSocketMessage(msg);
+    }
+
+    InputChannelRing& ring = mRings->getRing(mSendRingIndex + 1);
+    for (;;) {
+        status_t status = receiveRingMessage(msg);
+        if (status != WOULD_BLOCK) {
+            return status;
+        }
+        // Take any doorbells off the socket, and notice the peer closing it
+        status = receiveSocketMessage(msg);
+        if (status != WOULD_BLOCK) {
+            return status;
+        }
+        if (ring.receiverWaiting.load(std::memory_order_relaxed) != 0) {
+            return WOULD_BLOCK;
+        }
+        // Ask for the doorbell before polling, then look at the ring once more for
+        // anything sent before the sender could see the request.
+        ring.receiverWaiting.store(1, std::memory_order_seq_cst);
+    }
+}
+
+status_t InputChannel::receiveRingMessage(InputMessage* msg) {
+    InputChannelRing& ring = mRings->getRing(mSendRingIndex + 1);
+    const uint32_t head = ring.head.load(std::memory_order_relaxed);
+    if (ring.tail.load(std::memory_order_seq_cst) == head) {
+        return WOULD_BLOCK;
+    }
+
+    const InputChannelRing::Slot& slot = ring.slots[head % SHARED_RING_CAPACITY];
+    const size_t length = std::min(size_t(slot.length), sizeof(InputMessage));
+    memcpy(msg, &slot.message, length);
+    ring.head.store(head + 1, std::memory_order_release);
+
+    if (!msg->isValid(length)) {
+#if DEBUG_CHANNEL_MESSAGES
+        ALOGD("channel '%s' ~ received invalid message", mName.c_str());
+#endif
+        return BAD_VALUE;
+    }
 
 #if DEBUG_CHANNEL_MESSAGES
-    ALOGD("channel '%s' ~ sent message of type %d", mName.c_str(), msg->header.type);
+    ALOGD("channel '%s' ~ received message of type %d", mName.c_str(), msg->header.type);
 #endif
     return OK;
 }
 
-status_t InputChannel::receiveMessage(InputMessage* msg) {
+status_t InputChannel::receiveSocketMessage(InputMessage* msg) {
     ssize_t nRead;
     do {
         nRead = ::recv(mFd, msg, sizeof(InputMessage), MSG_DONTWAIT);
-    } while (nRead == -1 && errno == EINTR);
+    } while ((nRead == -1 && errno == EINTR) ||
+             (mRings && nRead == ssize_t(sizeof(SHARED_RING_DOORBELL))));
 
     if (nRead < 0) {
         int error = errno;
@@ -361,7 +633,13 @@ status_t InputChannel::receiveMessage(InputMessage* msg) {
 
 sp<InputChannel> InputChannel::dup() const {
     int fd = ::dup(getFd());
-    return fd >= 0 ? new InputChannel(getName(), fd) : nullptr;
+    if (fd < 0) {
+        return nullptr;
+    }
+    sp<InputChannel> channel = new InputChannel(getName(), fd);
+    channel->mRings = mRings;
+    channel->mSendRingIndex = mSendRingIndex;
+    return channel;
 }
 
 
@@ -377,8 +655,19 @@ status_t InputChannel::write(Parcel& out) const {
     }
 
     s = out.writeDupFileDescriptor(getFd());
+    if (s != OK) {
+        return s;
+    }
 
-    return s;
+    s = out.writeBool(mRings != nullptr);
+    if (s != OK || !mRings) {
+        return s;
+    }
+    s = out.writeUint32(mSendRingIndex);
+    if (s != OK) {
+        return s;
+    }
+    return out.writeDupFileDescriptor(mRings->getFd());
 }
 
 status_t InputChannel::read(const Parcel& from) {
@@ -392,6 +681,17 @@ status_t InputChannel::read(const Parcel& from) {
         return BAD_VALUE;
     }
 
+    mRings = nullptr;
+    if (from.readBool()) {
+        mSendRingIndex = from.readUint32();
+        int rawRingsFd = from.readFileDescriptor();
+        int ringsFd = rawRingsFd >= 0 ? ::dup(rawRingsFd) : -1;
+        mRings = ringsFd >= 0 ? SharedRings::fromFd(ringsFd) : nullptr;
+        if (!mRings) {
+            return BAD_VALUE;
+        }
+    }
+
     return OK;
 }
 
@@ -461,7 +761,7 @@ status_t InputPublisher::publishKeyEvent(
     msg.body.key.repeatCount = repeatCount;
     msg.body.key.downTime = downTime;
     msg.body.key.eventTime = eventTime;
-    return mChannel->sendMessage(&msg);
+    return sendMessage(msg);
 }
 
 status_t InputPublisher::publishMotionEvent(
@@ -539,10 +839,44 @@ status_t InputPublisher::publishMotionEvent(
         msg.body.motion.pointers[i].properties.copyFrom(pointerProperties[i]);
         msg.body.motion.pointers[i].coords.copyFrom(pointerCoords[i]);
     }
+    return sendMessage(msg);
+}
+
+status_t InputPublisher::sendMessage(const InputMessage& msg) {
+    if (mBatching) {
+        mBatch.push_back(msg);
+        return OK;
+    }
     return mChannel->sendMessage(&msg);
 }
 
+void InputPublisher::beginBatch() {
+    mBatching = true;
+    mBatch.clear();
+}
+
+status_t InputPublisher::endBatch(size_t* outPublished) {
+    mBatching = false;
+    *outPublished = 0;
+    status_t status = OK;
+    if (!mBatch.empty()) {
+        status = mChannel->sendMessages(mBatch.data(), mBatch.size(), outPublished);
+    }
+#if DEBUG_TRANSPORT_ACTIONS
+    ALOGD("channel '%s' publisher ~ endBatch: published %zu of %zu, status=%d",
+            mChannel->getName().c_str(), *outPublished, mBatch.size(), status);
+#endif
+    mBatch.clear();
+    return status;
+}
+
 status_t InputPublisher::receiveFinishedSignal(uint32_t* outSeq, bool* outHandled) {
+    nsecs_t consumeTime;
+    return receiveFinishedSignal(outSeq, outHandled, &consumeTime);
+}
+
+status_t InputPublisher::receiveFinishedSignal(uint32_t* outSeq, bool* outHandled,
+        nsecs_t* outConsumeTime) {
 #if DEBUG_TRANSPORT_ACTIONS
     ALOGD("channel '%s' publisher ~ receiveFinishedSignal",
             mChannel->getName().c_str());
@@ -553,6 +887,7 @@ status_t InputPublisher::receiveFinishedSignal(uint32_t* outSeq, bool* outHandle
     if (result) {
         *outSeq = 0;
         *outHandled = false;
+        *outConsumeTime = 0;
         return result;
     }
     if (msg.header.type != InputMessage::TYPE_FINISHED) {
@@ -562,6 +897,7 @@ status_t InputPublisher::receiveFinishedSignal(uint32_t* outSeq, bool* outHandle
     }
     *outSeq = msg.body.finished.seq;
     *outHandled = msg.body.finished.handled;
+    *outConsumeTime = msg.body.finished.consumeTime;
     return OK;
 }
 
@@ -635,7 +971,7 @@ status_t InputConsumer::consume(InputEventFactoryInterface* factory,
             if (batchIndex >= 0) {
                 Batch& batch = mBatches.editItemAt(batchIndex);
                 if (canAddSample(batch, &mMsg)) {
-                    batch.samples.push(mMsg);
+                    batch.addSample(mMsg);
 #if DEBUG_TRANSPORT_ACTIONS
                     ALOGD("channel '%s' consumer ~ appended to batch event",
                             mChannel->getName().c_str());
@@ -644,19 +980,16 @@ status_t InputConsumer::consume(InputEventFactoryInterface* factory,
                 } else if (isPointerEvent(mMsg.body.motion.source) &&
                         mMsg.body.motion.action == AMOTION_EVENT_ACTION_CANCEL) {
                     // No need to process events that we are going to cancel anyways
-                    const size_t count = batch.samples.size();
-                    for (size_t i = 0; i < count; i++) {
-                        const InputMessage& msg = batch.samples.itemAt(i);
-                        sendFinishedSignal(msg.body.motion.seq, false);
+                    for (size_t i = 0; i < batch.size(); i++) {
+                        sendFinishedSignal(batch.getSeq(i), false);
                     }
-                    batch.samples.removeItemsAt(0, count);
                     mBatches.removeAt(batchIndex);
                 } else {
                     // We cannot append to the batch in progress, so we need to consume
                     // the previous batch right now and defer the new message until later.
                     mMsgDeferred = true;
                     status_t result = consumeSamples(factory,
-                            batch, batch.samples.size(), outSeq, outEvent);
+                            batch, batch.size(), outSeq, outEvent);
                     mBatches.removeAt(batchIndex);
                     if (result) {
                         return result;
@@ -673,9 +1006,7 @@ status_t InputConsumer::consume(InputEventFactoryInterface* factory,
             // Start a new batch if needed.
             if (mMsg.body.motion.action == AMOTION_EVENT_ACTION_MOVE
                     || mMsg.body.motion.action == AMOTION_EVENT_ACTION_HOVER_MOVE) {
-                mBatches.push();
-                Batch& batch = mBatches.editTop();
-                batch.samples.push(mMsg);
+                mBatches.push(Batch(mMsg));
 #if DEBUG_TRANSPORT_ACTIONS
                 ALOGD("channel '%s' consumer ~ started batch event",
                         mChannel->getName().c_str());
@@ -704,6 +1035,7 @@ status_t InputConsumer::consume(InputEventFactoryInterface* factory,
             return UNKNOWN_ERROR;
         }
     }
+    mConsumeTimes.add(*outSeq, systemTime(SYSTEM_TIME_MONOTONIC));
     return OK;
 }
 
@@ -714,7 +1046,7 @@ status_t InputConsumer::consumeBatch(InputEventFactoryInterface* factory,
         i--;
         Batch& batch = mBatches.editItemAt(i);
         if (frameTime < 0) {
-            result = consumeSamples(factory, batch, batch.samples.size(), outSeq, outEvent);
+            result = consumeSamples(factory, batch, batch.size(), outSeq, outEvent);
             mBatches.removeAt(i);
             return result;
         }
@@ -729,12 +1061,19 @@ status_t InputConsumer::consumeBatch(InputEventFactoryInterface* factory,
         }
 
         result = consumeSamples(factory, batch, split + 1, outSeq, outEvent);
+        InputMessage nextMsg;
         const InputMessage* next;
-        if (batch.samples.isEmpty()) {
+        if (batch.isEmpty()) {
             mBatches.removeAt(i);
             next = nullptr;
         } else {
-            next = &batch.samples.itemAt(0);
+            nextMsg.body.motion.pointerCount = batch.getHead().body.motion.pointerCount;
+            for (uint32_t j = 0; j < nextMsg.body.motion.pointerCount; j++) {
+                nextMsg.body.motion.pointers[j].properties.copyFrom(
+                        batch.getHead().body.motion.pointers[j].properties);
+            }
+            batch.getSample(0, &nextMsg);
+            next = &nextMsg;
         }
         if (!result && mResampleTouch) {
             resampleTouchState(sampleTime, static_cast<MotionEvent*>(*outEvent), next);
@@ -750,9 +1089,15 @@ status_t InputConsumer::consumeSamples(InputEventFactoryInterface* factory,
     MotionEvent* motionEvent = factory->createMotionEvent();
     if (! motionEvent) return NO_MEMORY;
 
+    // Only the fields that differ between samples, and that updateTouchState() may rewrite,
+    // are written for each sample.
+    InputMessage msg;
+    msg.header = batch.getHead().header;
+    memcpy(&msg.body.motion, &batch.getHead().body.motion, batch.getHead().body.motion.size());
+
     uint32_t chain = 0;
     for (size_t i = 0; i < count; i++) {
-        InputMessage& msg = batch.samples.editItemAt(i);
+        batch.getSample(i, &msg);
         updateTouchState(msg);
         if (i) {
             SeqChain seqChain;
@@ -765,7 +1110,7 @@ status_t InputConsumer::consumeSamples(InputEventFactoryInterface* factory,
         }
         chain = msg.body.motion.seq;
     }
-    batch.samples.removeItemsAt(0, count);
+    batch.removeSamples(count);
 
     *outSeq = chain;
     *outEvent = motionEvent;
@@ -921,8 +1266,10 @@ void InputConsumer::resampleTouchState(nsecs_t sampleTime, MotionEvent* event,
 
     // Find the data to use for resampling.
     const History* other;
+    const History* older = nullptr;
     History future;
     float alpha;
+    float weights[3];
     if (next) {
         // Interpolate between current sample and future sample.
         // So current->eventTime <= sampleTime <= future.eventTime.
@@ -962,6 +1309,24 @@ void InputConsumer::resampleTouchState(nsecs_t sampleTime, MotionEvent* event,
             sampleTime = maxPredict;
         }
         alpha = float(current->eventTime - sampleTime) / delta;
+
+        // Fit a parabola through the sample before as well if asked to.
+        if (mTouchPredictor == TouchPredictor::QUADRATIC && touchState.historySize >= 3) {
+            const History* oldest = touchState.getHistory(2);
+            nsecs_t olderDelta = other->eventTime - oldest->eventTime;
+            if (olderDelta >= RESAMPLE_MIN_DELTA && olderDelta <= RESAMPLE_MAX_DELTA) {
+                older = oldest;
+                quadraticWeights(float(other->eventTime - current->eventTime),
+                        float(older->eventTime - current->eventTime),
+                        float(sampleTime - current->eventTime), weights);
+            }
+#if DEBUG_RESAMPLING
+            else {
+                ALOGD("Quadratic prediction skipped, delta time out of range: %" PRId64 " ns.",
+                        olderDelta);
+            }
+#endif
+        }
     } else {
 #if DEBUG_RESAMPLING
         ALOGD("Not resampled, insufficient data.");
@@ -996,10 +1361,20 @@ void InputConsumer::resampleTouchState(nsecs_t sampleTime, MotionEvent* event,
         if (other->idBits.hasBit(id)
                 && shouldResampleTool(event->getToolType(i))) {
             const PointerCoords& otherCoords = other->getPointerById(id);
-            resampledCoords.setAxisValue(AMOTION_EVENT_AXIS_X,
-                    lerp(currentCoords.getX(), otherCoords.getX(), alpha));
-            resampledCoords.setAxisValue(AMOTION_EVENT_AXIS_Y,
-                    lerp(currentCoords.getY(), otherCoords.getY(), alpha));
+            if (older && older->idBits.hasBit(id)) {
+                const PointerCoords& olderCoords = older->getPointerById(id);
+                resampledCoords.setAxisValue(AMOTION_EVENT_AXIS_X,
+                        weights[0] * currentCoords.getX() + weights[1] * otherCoords.getX()
+                        + weights[2] * olderCoords.getX());
+                resampledCoords.setAxisValue(AMOTION_EVENT_AXIS_Y,
+                        weights[0] * currentCoords.getY() + weights[1] * otherCoords.getY()
+                        + weights[2] * olderCoords.getY());
+            } else {
+                resampledCoords.setAxisValue(AMOTION_EVENT_AXIS_X,
+                        lerp(currentCoords.getX(), otherCoords.getX(), alpha));
+                resampledCoords.setAxisValue(AMOTION_EVENT_AXIS_Y,
+                        lerp(currentCoords.getY(), otherCoords.getY(), alpha));
+            }
 #if DEBUG_RESAMPLING
             ALOGD("[%d] - out (%0.3f, %0.3f), cur (%0.3f, %0.3f), "
                     "other (%0.3f, %0.3f), alpha %0.3f",
@@ -1036,7 +1411,12 @@ status_t InputConsumer::sendFinishedSignal(uint32_t seq, bool handled) {
         return BAD_VALUE;
     }
 
-    // Send finished signals for the batch sequence chain first.
+    // Every message of a batch was handed out together, with the batch's last sequence number.
+    ssize_t consumeTimeIndex = mConsumeTimes.indexOfKey(seq);
+    nsecs_t consumeTime = consumeTimeIndex >= 0 ? mConsumeTimes.valueAt(consumeTimeIndex) : 0;
+
+    // Send finished signals for the batch sequence chain first, together with the
+    // one for the last message in the batch.
     size_t seqChainCount = mSeqChains.size();
     if (seqChainCount) {
         uint32_t currentSeq = seq;
@@ -1051,13 +1431,19 @@ status_t InputConsumer::sendFinishedSignal(uint32_t seq, bool handled) {
                  mSeqChains.removeAt(i);
              }
         }
-        status_t status = OK;
-        while (!status && chainIndex > 0) {
-            chainIndex--;
-            status = sendUnchainedFinishedSignal(chainSeqs[chainIndex], handled);
+
+        std::vector<InputMessage> msgs(chainIndex + 1);
+        for (size_t i = 0; i < chainIndex; i++) {
+            initializeFinishedMessage(&msgs[i], chainSeqs[chainIndex - 1 - i], handled,
+                    consumeTime);
         }
-        if (status) {
-            // An error occurred so at least one signal was not sent, reconstruct the chain.
+        initializeFinishedMessage(&msgs[chainIndex], seq, handled, consumeTime);
+
+        size_t sent;
+        status_t status = mChannel->sendMessages(msgs.data(), msgs.size(), &sent);
+        if (status && sent < chainIndex) {
+            // At least one signal of the chain was not sent, reconstruct what is left of it.
+            chainIndex -= sent + 1;
             for (;;) {
                 SeqChain seqChain;
                 seqChain.seq = chainIndex != 0 ? chainSeqs[chainIndex - 1] : seq;
@@ -1066,19 +1452,33 @@ status_t InputConsumer::sendFinishedSignal(uint32_t seq, bool handled) {
                 if (!chainIndex) break;
                 chainIndex--;
             }
-            return status;
         }
+        if (!status) {
+            mConsumeTimes.removeItem(seq);
+        }
+        return status;
     }
 
     // Send finished signal for the last message in the batch.
-    return sendUnchainedFinishedSignal(seq, handled);
+    status_t status = sendUnchainedFinishedSignal(seq, handled, consumeTime);
+    if (!status) {
+        mConsumeTimes.removeItem(seq);
+    }
+    return status;
 }
 
-status_t InputConsumer::sendUnchainedFinishedSignal(uint32_t seq, bool handled) {
+void InputConsumer::initializeFinishedMessage(InputMessage* msg, uint32_t seq, bool handled,
+        nsecs_t consumeTime) {
+    msg->header.type = InputMessage::TYPE_FINISHED;
+    msg->body.finished.seq = seq;
+    msg->body.finished.handled = handled;
+    msg->body.finished.consumeTime = consumeTime;
+}
+
+status_t InputConsumer::sendUnchainedFinishedSignal(uint32_t seq, bool handled,
+        nsecs_t consumeTime) {
     InputMessage msg;
-    msg.header.type = InputMessage::TYPE_FINISHED;
-    msg.body.finished.seq = seq;
-    msg.body.finished.handled = handled;
+    initializeFinishedMessage(&msg, seq, handled, consumeTime);
     return mChannel->sendMessage(&msg);
 }
 
@@ -1093,7 +1493,7 @@ bool InputConsumer::hasPendingBatch() const {
 ssize_t InputConsumer::findBatch(int32_t deviceId, int32_t source) const {
     for (size_t i = 0; i < mBatches.size(); i++) {
         const Batch& batch = mBatches.itemAt(i);
-        const InputMessage& head = batch.samples.itemAt(0);
+        const InputMessage& head = batch.getHead();
         if (head.body.motion.deviceId == deviceId && head.body.motion.source == source) {
             return i;
         }
@@ -1169,15 +1569,29 @@ void InputConsumer::addSample(MotionEvent* event, const InputMessage* msg) {
 }
 
 bool InputConsumer::canAddSample(const Batch& batch, const InputMessage *msg) {
-    const InputMessage& head = batch.samples.itemAt(0);
-    uint32_t pointerCount = msg->body.motion.pointerCount;
-    if (head.body.motion.pointerCount != pointerCount
-            || head.body.motion.action != msg->body.motion.action) {
+    const InputMessage::Body::Motion& head = batch.getHead().body.motion;
+    const InputMessage::Body::Motion& motion = msg->body.motion;
+    uint32_t pointerCount = motion.pointerCount;
+    if (head.pointerCount != pointerCount
+            || head.action != motion.action) {
+        return false;
+    }
+    // The batch only keeps the fields of its first message for these.
+    if (head.displayId != motion.displayId
+            || head.actionButton != motion.actionButton
+            || head.flags != motion.flags
+            || head.buttonState != motion.buttonState
+            || head.classification != motion.classification
+            || head.edgeFlags != motion.edgeFlags
+            || head.downTime != motion.downTime
+            || head.xOffset != motion.xOffset
+            || head.yOffset != motion.yOffset
+            || head.xPrecision != motion.xPrecision
+            || head.yPrecision != motion.yPrecision) {
         return false;
     }
     for (size_t i = 0; i < pointerCount; i++) {
-        if (head.body.motion.pointers[i].properties
-                != msg->body.motion.pointers[i].properties) {
+        if (head.pointers[i].properties != motion.pointers[i].properties) {
             return false;
         }
     }
@@ -1185,13 +1599,73 @@ bool InputConsumer::canAddSample(const Batch& batch, const InputMessage *msg) {
 }
 
 ssize_t InputConsumer::findSampleNoLaterThan(const Batch& batch, nsecs_t time) {
-    size_t numSamples = batch.samples.size();
+    size_t numSamples = batch.size();
     size_t index = 0;
-    while (index < numSamples
-            && batch.samples.itemAt(index).body.motion.eventTime <= time) {
+    while (index < numSamples && batch.getEventTime(index) <= time) {
         index += 1;
     }
     return ssize_t(index) - 1;
 }
 
+// --- InputConsumer::Batch ---
+
+InputConsumer::Batch::Batch(const InputMessage& msg) {
+    mHead.header = msg.header;
+    memcpy(&mHead.body.motion, &msg.body.motion, msg.body.motion.size());
+    addSample(msg);
+}
+
+void InputConsumer::Batch::addSample(const InputMessage& msg) {
+    mSeqs.push_back(msg.body.motion.seq);
+    mEventTimes.push_back(msg.body.motion.eventTime);
+    mMetaStates.push_back(msg.body.motion.metaState);
+    mValueStarts.push_back(mValues.size());
+    for (uint32_t i = 0; i < msg.body.motion.pointerCount; i++) {
+        const PointerCoords& coords = msg.body.motion.pointers[i].coords;
+        mAxisBits.push_back(coords.bits);
+        mValues.insert(mValues.end(), coords.values,
+                coords.values + BitSet64::count(coords.bits));
+    }
+}
+
+void InputConsumer::Batch::getSample(size_t index, InputMessage* msg) const {
+    const uint32_t pointerCount = mHead.body.motion.pointerCount;
+    msg->body.motion.seq = mSeqs[index];
+    msg->body.motion.eventTime = mEventTimes[index];
+    msg->body.motion.metaState = mMetaStates[index];
+    const uint64_t* bits = &mAxisBits[index * pointerCount];
+    const float* values = mValues.data() + mValueStarts[index];
+    for (uint32_t i = 0; i < pointerCount; i++) {
+        PointerCoords& coords = msg->body.motion.pointers[i].coords;
+        const uint32_t axisCount = BitSet64::count(bits[i]);
+        coords.bits = bits[i];
+        std::copy(values, values + axisCount, coords.values);
+        values += axisCount;
+    }
+}
+
+void InputConsumer::Batch::removeSamples(size_t count) {
+    if (count >= mSeqs.size()) {
+        mSeqs.clear();
+        mEventTimes.clear();
+        mMetaStates.clear();
+        mValueStarts.clear();
+        mAxisBits.clear();
+        mValues.clear();
+        return;
+    }
+
+    const size_t valueCount = mValueStarts[count];
+    mSeqs.erase(mSeqs.begin(), mSeqs.begin() + count);
+    mEventTimes.erase(mEventTimes.begin(), mEventTimes.begin() + count);
+    mMetaStates.erase(mMetaStates.begin(), mMetaStates.begin() + count);
+    mValueStarts.erase(mValueStarts.begin(), mValueStarts.begin() + count);
+    for (size_t& start : mValueStarts) {
+        start -= valueCount;
+    }
+    mAxisBits.erase(mAxisBits.begin(),
+            mAxisBits.begin() + count * mHead.body.motion.pointerCount);
+    mValues.erase(mValues.begin(), mValues.begin() + valueCount);
+}
+
 } // namespace android
@@ -33,6 +33,8 @@
 #include <utils/Tokenizer.h>
 #include <utils/Timers.h>
 
+#include "KeyMapCache.h"
+
 // Enables debug output for the parser.
 #define DEBUG_PARSER 0
 
@@ -108,17 +110,15 @@ KeyCharacterMap::~KeyCharacterMap() {
 
 status_t KeyCharacterMap::load(const std::string& filename,
         Format format, sp<KeyCharacterMap>* outMap) {
-    outMap->clear();
-
-    Tokenizer* tokenizer;
-    status_t status = Tokenizer::open(String8(filename.c_str()), &tokenizer);
-    if (status) {
-        ALOGE("Error %d opening key character map file %s.", status, filename.c_str());
-    } else {
-        status = load(tokenizer, format, outMap);
-        delete tokenizer;
-    }
-    return status;
+    // Maps are immutable once loaded, and combine() copies rather than modifies its
+    // inputs, so devices using the same map share one
+    static KeyMapCache<KeyCharacterMap> sCache;
+    return sCache.load(filename, format,
+            [format](const std::string& path, const std::string& contents,
+                    sp<KeyCharacterMap>* map) {
+                return loadContents(path, contents.c_str(), format, map);
+            },
+            outMap);
 }
 
 status_t KeyCharacterMap::loadContents(const std::string& filename, const char* contents,
@@ -27,6 +27,8 @@
 #include <utils/Tokenizer.h>
 #include <utils/Timers.h>
 
+#include "KeyMapCache.h"
+
 // Enables debug output for the parser.
 #define DEBUG_PARSER 0
 
@@ -50,10 +52,16 @@ KeyLayoutMap::~KeyLayoutMap() {
 }
 
 status_t KeyLayoutMap::load(const std::string& filename, sp<KeyLayoutMap>* outMap) {
-    outMap->clear();
+    // Layouts are immutable once loaded, so devices using the same layout share one
+    static KeyMapCache<KeyLayoutMap> sCache;
+    return sCache.load(filename, 0 /*kind*/, loadContents, outMap);
+}
 
+status_t KeyLayoutMap::loadContents(const std::string& filename, const std::string& contents,
+        sp<KeyLayoutMap>* outMap) {
     Tokenizer* tokenizer;
-    status_t status = Tokenizer::open(String8(filename.c_str()), &tokenizer);
+    status_t status = Tokenizer::fromContents(String8(filename.c_str()), contents.c_str(),
+            &tokenizer);
     if (status) {
         ALOGE("Error %d opening key layout map file %s.", status, filename.c_str());
     } else {
@@ -0,0 +1,136 @@
+/*
+ * Copyright (C) 2019 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef _LIBINPUT_KEY_MAP_CACHE_H
+#define _LIBINPUT_KEY_MAP_CACHE_H
+
+#include <errno.h>
+#include <sys/stat.h>
+
+#include <functional>
+#include <iterator>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+#include <android-base/file.h>
+#include <utils/Errors.h>
+#include <utils/Log.h>
+#include <utils/RefBase.h>
+
+namespace android {
+
+/*
+ * Process-wide cache of immutable maps parsed from files, such as key layouts and
+ * key character maps, so that devices using the same map share one parsed copy.
+ *
+ * Maps are found by file name first, as long as the file's inode, size and
+ * modification time are unchanged, and then by the file contents, which catches
+ * identical files installed under different names. The contents of each map are kept
+ * to compare with, which is cheap since map files are small. Only weak references
+ * are kept: a map is freed once no device holds it, and parsed again on next use.
+ */
+template <typename T>
+class KeyMapCache {
+public:
+    // Parses the contents of a file into a map, which the cache then shares
+    using Parser = std::function<status_t(const std::string& filename,
+                                          const std::string& contents, sp<T>* outMap)>;
+
+    // The kind distinguishes maps of one file parsed in different ways
+    status_t load(const std::string& filename, int kind, const Parser& parser, sp<T>* outMap) {
+        outMap->clear();
+
+        struct stat st;
+        if (stat(filename.c_str(), &st) != 0) {
+            const status_t status = -errno;
+            ALOGE("Error %d opening map file %s.", status, filename.c_str());
+            return status;
+        }
+        const std::string pathKey = std::to_string(kind) + ":" + filename;
+        {
+            std::scoped_lock lock(mLock);
+            auto it = mByPath.find(pathKey);
+            if (it != mByPath.end() && it->second.isSameFile(st)) {
+                *outMap = it->second.map.promote();
+                if (*outMap != nullptr) {
+                    return NO_ERROR;
+                }
+            }
+        }
+
+        std::string contents;
+        if (!base::ReadFileToString(filename, &contents)) {
+            const status_t status = errno ? -errno : UNKNOWN_ERROR;
+            ALOGE("Error %d reading map file %s.", status, filename.c_str());
+            return status;
+        }
+        // The whole contents are compared, so that a hash collision can't hand out
+        // another file's map
+        std::string contentKey = std::to_string(kind) + ":" + contents;
+        {
+            std::scoped_lock lock(mLock);
+            auto it = mByContent.find(contentKey);
+            if (it != mByContent.end()) {
+                *outMap = it->second.promote();
+            }
+        }
+
+        if (*outMap == nullptr) {
+            const status_t status = parser(filename, contents, outMap);
+            if (status) {
+                return status;
+            }
+        }
+
+        std::scoped_lock lock(mLock);
+        pruneLocked();
+        mByPath[pathKey] = {st.st_ino, st.st_size, st.st_mtime, *outMap};
+        mByContent[std::move(contentKey)] = *outMap;
+        return NO_ERROR;
+    }
+
+private:
+    struct PathEntry {
+        ino_t inode;
+        off_t size;
+        time_t modificationTime;
+        wp<T> map;
+
+        bool isSameFile(const struct stat& st) const {
+            return inode == st.st_ino && size == st.st_size && modificationTime == st.st_mtime;
+        }
+    };
+
+    // Drops the entries of maps which have been freed
+    void pruneLocked() {
+        for (auto it = mByPath.begin(); it != mByPath.end();) {
+            it = it->second.map.promote() == nullptr ? mByPath.erase(it) : std::next(it);
+        }
+        for (auto it = mByContent.begin(); it != mByContent.end();) {
+            it = it->second.promote() == nullptr ? mByContent.erase(it) : std::next(it);
+        }
+    }
+
+    std::mutex mLock;
+    std::unordered_map<std::string, PathEntry> mByPath;
+    // Keyed by the kind and the file contents
+    std::unordered_map<std::string, wp<T>> mByContent;
+};
+
+} // namespace android
+
+#endif // _LIBINPUT_KEY_MAP_CACHE_H
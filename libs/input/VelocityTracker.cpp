@@ -139,6 +139,19 @@ VelocityTracker::~VelocityTracker() {
     delete mStrategy;
 }
 
+bool VelocityTracker::setStrategy(const char* strategy) {
+    VelocityTrackerStrategy* newStrategy = createStrategy(strategy);
+    if (!newStrategy) {
+        ALOGD("Unrecognized velocity tracker strategy name '%s'.", strategy);
+        return false;
+    }
+    delete mStrategy;
+    mStrategy = newStrategy;
+    mCurrentPointerIdBits.clear();
+    mActivePointerId = -1;
+    return true;
+}
+
 bool VelocityTracker::configureStrategy(const char* strategy) {
     mStrategy = createStrategy(strategy);
     return mStrategy != nullptr;
@@ -404,6 +417,9 @@ void LeastSquaresVelocityTrackerStrategy::addMovement(nsecs_t eventTime, BitSet3
     }
 }
 
+// Number of data vectors fitted at once by solveLeastSquares, one per axis.
+static constexpr size_t LEAST_SQUARES_AXES = 2;
+
 /**
  * Solves a linear least squares problem to obtain a N degree polynomial that fits
  * the specified input data as nearly as possible.
@@ -447,18 +463,24 @@ void LeastSquaresVelocityTrackerStrategy::addMovement(nsecs_t eventTime, BitSet3
  * Finally we solve the system of linear equations given by R1 B = (Qtranspose W Y)
  * to find B.
  *
+ * Q1 and R1 only depend on X and W, so every axis in Y is solved with the same
+ * decomposition, which is the bulk of the work; each output B and R^2 is per axis.
+ *
  * For efficiency, we lay out A and Q column-wise in memory because we frequently
  * operate on the column vectors.  Conversely, we lay out R row-wise.
  *
  * http://en.wikipedia.org/wiki/Numerical_methods_for_linear_least_squares
  * http://en.wikipedia.org/wiki/Gram-Schmidt
  */
-static bool solveLeastSquares(const float* x, const float* y,
-        const float* w, uint32_t m, uint32_t n, float* outB, float* outDet) {
+static bool solveLeastSquares(const float* x, const float* const y[LEAST_SQUARES_AXES],
+        const float* w, uint32_t m, uint32_t n, float* const outB[LEAST_SQUARES_AXES],
+        float outDet[LEAST_SQUARES_AXES]) {
 #if DEBUG_STRATEGY
-    ALOGD("solveLeastSquares: m=%d, n=%d, x=%s, y=%s, w=%s", int(m), int(n),
-            vectorToString(x, m).c_str(), vectorToString(y, m).c_str(),
-            vectorToString(w, m).c_str());
+    ALOGD("solveLeastSquares: m=%d, n=%d, x=%s, w=%s", int(m), int(n),
+            vectorToString(x, m).c_str(), vectorToString(w, m).c_str());
+    for (size_t axis = 0; axis < LEAST_SQUARES_AXES; axis++) {
+        ALOGD("  - y[%zu]=%s", axis, vectorToString(y[axis], m).c_str());
+    }
 #endif
 
     // Expand the X vector to a matrix A, pre-multiplied by the weights.
@@ -521,53 +543,76 @@ static bool solveLeastSquares(const float* x, const float* y,
     ALOGD("  - qr=%s", matrixToString(&qr[0][0], m, n, false /*rowMajor*/).c_str());
 #endif
 
-    // Solve R B = Qt W Y to find B.  This is easy because R is upper triangular.
-    // We just work from bottom-right to top-left calculating B's coefficients.
-    float wy[m];
+    // The decomposition only depends on X and W, so every axis is fitted with it.
+    // The powers of X are the columns of A divided by the weights; keep them around for
+    // computing the residuals of each axis.
+    float xPowers[n][m];
     for (uint32_t h = 0; h < m; h++) {
-        wy[h] = y[h] * w[h];
-    }
-    for (uint32_t i = n; i != 0; ) {
-        i--;
-        outB[i] = vectorDot(&q[i][0], wy, m);
-        for (uint32_t j = n - 1; j > i; j--) {
-            outB[i] -= r[i][j] * outB[j];
+        xPowers[0][h] = 1;
+        for (uint32_t i = 1; i < n; i++) {
+            xPowers[i][h] = xPowers[i - 1][h] * x[h];
         }
-        outB[i] /= r[i][i];
     }
+    float w2[m];
+    for (uint32_t h = 0; h < m; h++) {
+        w2[h] = w[h] * w[h];
+    }
+
+    for (size_t axis = 0; axis < LEAST_SQUARES_AXES; axis++) {
+        const float* ya = y[axis];
+        float* b = outB[axis];
+
+        // Solve R B = Qt W Y to find B.  This is easy because R is upper triangular.
+        // We just work from bottom-right to top-left calculating B's coefficients.
+        float wy[m];
+        for (uint32_t h = 0; h < m; h++) {
+            wy[h] = ya[h] * w[h];
+        }
+        for (uint32_t i = n; i != 0; ) {
+            i--;
+            b[i] = vectorDot(&q[i][0], wy, m);
+            for (uint32_t j = n - 1; j > i; j--) {
+                b[i] -= r[i][j] * b[j];
+            }
+            b[i] /= r[i][i];
+        }
 #if DEBUG_STRATEGY
-    ALOGD("  - b=%s", vectorToString(outB, n).c_str());
+        ALOGD("  - b[%zu]=%s", axis, vectorToString(b, n).c_str());
 #endif
 
-    // Calculate the coefficient of determination as 1 - (SSerr / SStot) where
-    // SSerr is the residual sum of squares (variance of the error),
-    // and SStot is the total sum of squares (variance of the data) where each
-    // has been weighted.
-    float ymean = 0;
-    for (uint32_t h = 0; h < m; h++) {
-        ymean += y[h];
-    }
-    ymean /= m;
+        // Calculate the coefficient of determination as 1 - (SSerr / SStot) where
+        // SSerr is the residual sum of squares (variance of the error),
+        // and SStot is the total sum of squares (variance of the data) where each
+        // has been weighted.
+        float ymean = 0;
+        for (uint32_t h = 0; h < m; h++) {
+            ymean += ya[h];
+        }
+        ymean /= m;
 
-    float sserr = 0;
-    float sstot = 0;
-    for (uint32_t h = 0; h < m; h++) {
-        float err = y[h] - outB[0];
-        float term = 1;
+        float err[m];
+        for (uint32_t h = 0; h < m; h++) {
+            err[h] = ya[h] - b[0];
+        }
         for (uint32_t i = 1; i < n; i++) {
-            term *= x[h];
-            err -= term * outB[i];
+            for (uint32_t h = 0; h < m; h++) {
+                err[h] -= xPowers[i][h] * b[i];
+            }
         }
-        sserr += w[h] * w[h] * err * err;
-        float var = y[h] - ymean;
-        sstot += w[h] * w[h] * var * var;
-    }
-    *outDet = sstot > 0.000001f ? 1.0f - (sserr / sstot) : 1;
+        float sserr = 0;
+        float sstot = 0;
+        for (uint32_t h = 0; h < m; h++) {
+            sserr += w2[h] * err[h] * err[h];
+            float var = ya[h] - ymean;
+            sstot += w2[h] * var * var;
+        }
+        outDet[axis] = sstot > 0.000001f ? 1.0f - (sserr / sstot) : 1;
 #if DEBUG_STRATEGY
-    ALOGD("  - sserr=%f", sserr);
-    ALOGD("  - sstot=%f", sstot);
-    ALOGD("  - det=%f", *outDet);
+        ALOGD("  - sserr=%f", sserr);
+        ALOGD("  - sstot=%f", sstot);
+        ALOGD("  - det=%f", outDet[axis]);
 #endif
+    }
     return true;
 }
 
@@ -680,13 +725,14 @@ bool LeastSquaresVelocityTrackerStrategy::getEstimator(uint32_t id,
         }
     } else if (degree >= 1) {
         // General case for an Nth degree polynomial fit
-        float xdet, ydet;
         uint32_t n = degree + 1;
-        if (solveLeastSquares(time, x, w, m, n, outEstimator->xCoeff, &xdet)
-                && solveLeastSquares(time, y, w, m, n, outEstimator->yCoeff, &ydet)) {
+        const float* const ys[LEAST_SQUARES_AXES] = {x, y};
+        float* const outBs[LEAST_SQUARES_AXES] = {outEstimator->xCoeff, outEstimator->yCoeff};
+        float dets[LEAST_SQUARES_AXES];
+        if (solveLeastSquares(time, ys, w, m, n, outBs, dets)) {
             outEstimator->time = newestMovement.eventTime;
             outEstimator->degree = degree;
-            outEstimator->confidence = xdet * ydet;
+            outEstimator->confidence = dets[0] * dets[1];
 #if DEBUG_STRATEGY
             ALOGD("estimate: degree=%d, xCoeff=%s, yCoeff=%s, confidence=%f",
                     int(outEstimator->degree),
@@ -1017,11 +1063,13 @@ ImpulseVelocityTrackerStrategy::~ImpulseVelocityTrackerStrategy() {
 void ImpulseVelocityTrackerStrategy::clear() {
     mIndex = 0;
     mMovements[0].idBits.clear();
+    mEstimatedIdBits.clear();
 }
 
 void ImpulseVelocityTrackerStrategy::clearPointers(BitSet32 idBits) {
     BitSet32 remainingIdBits(mMovements[mIndex].idBits.value & ~idBits.value);
     mMovements[mIndex].idBits = remainingIdBits;
+    mEstimatedIdBits.value &= ~idBits.value;
 }
 
 void ImpulseVelocityTrackerStrategy::addMovement(nsecs_t eventTime, BitSet32 idBits,
@@ -1046,6 +1094,7 @@ void ImpulseVelocityTrackerStrategy::addMovement(nsecs_t eventTime, BitSet32 idB
     for (uint32_t i = 0; i < count; i++) {
         movement.positions[i] = positions[i];
     }
+    mEstimatedIdBits.clear();
 }
 
 /**
@@ -1159,6 +1208,10 @@ static float calculateImpulseVelocity(const nsecs_t* t, const float* x, size_t c
 
 bool ImpulseVelocityTrackerStrategy::getEstimator(uint32_t id,
         VelocityTracker::Estimator* outEstimator) const {
+    if (mEstimatedIdBits.hasBit(id)) {
+        *outEstimator = mEstimators[id];
+        return true;
+    }
     outEstimator->clear();
 
     // Iterate over movement samples in reverse time order and collect samples.
@@ -1201,6 +1254,8 @@ bool ImpulseVelocityTrackerStrategy::getEstimator(uint32_t id,
 #if DEBUG_STRATEGY
     ALOGD("velocity: (%f, %f)", outEstimator->xCoeff[1], outEstimator->yCoeff[1]);
 #endif
+    mEstimators[id] = *outEstimator;
+    mEstimatedIdBits.markBit(id);
     return true;
 }
 
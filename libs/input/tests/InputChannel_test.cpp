@@ -21,6 +21,8 @@
 #include <unistd.h>
 #include <time.h>
 #include <errno.h>
+#include <poll.h>
+#include <sys/socket.h>
 
 #include <gtest/gtest.h>
 #include <input/InputTransport.h>
@@ -189,5 +191,125 @@ TEST_F(InputChannelTest, SendAndReceive_MotionClassification) {
     }
 }
 
+static InputMessage makeKeyMessage(uint32_t seq) {
+    InputMessage msg;
+    memset(&msg, 0, sizeof(InputMessage));
+    msg.header.type = InputMessage::TYPE_KEY;
+    msg.body.key.seq = seq;
+    return msg;
+}
+
+static bool isReadable(int fd) {
+    struct pollfd pfd = {fd, POLLIN, 0};
+    return poll(&pfd, 1, 0) == 1 && (pfd.revents & POLLIN);
+}
+
+TEST_F(InputChannelTest, SharedRing_SendsBothWays) {
+    sp<InputChannel> serverChannel, clientChannel;
+    ASSERT_EQ(OK, InputChannel::openInputChannelPair("channel name",
+            serverChannel, clientChannel, true /*useSharedRing*/));
+    ASSERT_TRUE(serverChannel->hasSharedRing());
+    ASSERT_TRUE(clientChannel->hasSharedRing());
+
+    InputMessage serverMsg = makeKeyMessage(1);
+    EXPECT_EQ(OK, serverChannel->sendMessage(&serverMsg));
+
+    InputMessage clientMsg;
+    EXPECT_EQ(OK, clientChannel->receiveMessage(&clientMsg));
+    EXPECT_EQ(InputMessage::TYPE_KEY, clientMsg.header.type);
+    EXPECT_EQ(1u, clientMsg.body.key.seq);
+    EXPECT_EQ(WOULD_BLOCK, clientChannel->receiveMessage(&clientMsg));
+
+    InputMessage clientReply;
+    memset(&clientReply, 0, sizeof(InputMessage));
+    clientReply.header.type = InputMessage::TYPE_FINISHED;
+    clientReply.body.finished.seq = 1;
+    clientReply.body.finished.handled = true;
+    EXPECT_EQ(OK, clientChannel->sendMessage(&clientReply));
+
+    InputMessage serverReply;
+    EXPECT_EQ(OK, serverChannel->receiveMessage(&serverReply));
+    EXPECT_EQ(InputMessage::TYPE_FINISHED, serverReply.header.type);
+    EXPECT_EQ(1u, serverReply.body.finished.seq);
+    EXPECT_TRUE(serverReply.body.finished.handled);
+}
+
+TEST_F(InputChannelTest, SharedRing_WakesReceiverOnlyWhenWaiting) {
+    sp<InputChannel> serverChannel, clientChannel;
+    ASSERT_EQ(OK, InputChannel::openInputChannelPair("channel name",
+            serverChannel, clientChannel, true /*useSharedRing*/));
+
+    // The receiver has drained the channel, so wants waking
+    InputMessage msg;
+    EXPECT_EQ(WOULD_BLOCK, clientChannel->receiveMessage(&msg));
+    EXPECT_FALSE(isReadable(clientChannel->getFd()));
+
+    InputMessage first = makeKeyMessage(1);
+    InputMessage second = makeKeyMessage(2);
+    EXPECT_EQ(OK, serverChannel->sendMessage(&first));
+    EXPECT_EQ(OK, serverChannel->sendMessage(&second));
+
+    // Only the first message rang the doorbell
+    char doorbell[sizeof(InputMessage)];
+    EXPECT_EQ(1, ::recv(clientChannel->getFd(), doorbell, sizeof(doorbell), MSG_DONTWAIT));
+    EXPECT_EQ(-1, ::recv(clientChannel->getFd(), doorbell, sizeof(doorbell), MSG_DONTWAIT));
+
+    EXPECT_EQ(OK, clientChannel->receiveMessage(&msg));
+    EXPECT_EQ(1u, msg.body.key.seq);
+    EXPECT_EQ(OK, clientChannel->receiveMessage(&msg));
+    EXPECT_EQ(2u, msg.body.key.seq);
+    EXPECT_EQ(WOULD_BLOCK, clientChannel->receiveMessage(&msg));
+}
+
+TEST_F(InputChannelTest, SharedRing_WakesReceiverThatPollsFirst) {
+    sp<InputChannel> serverChannel, clientChannel;
+    ASSERT_EQ(OK, InputChannel::openInputChannelPair("channel name",
+            serverChannel, clientChannel, true /*useSharedRing*/));
+
+    // The receiver goes straight to polling without ever calling receiveMessage
+    EXPECT_FALSE(isReadable(clientChannel->getFd()));
+
+    InputMessage sent = makeKeyMessage(1);
+    EXPECT_EQ(OK, serverChannel->sendMessage(&sent));
+    EXPECT_TRUE(isReadable(clientChannel->getFd()));
+
+    InputMessage msg;
+    EXPECT_EQ(OK, clientChannel->receiveMessage(&msg));
+    EXPECT_EQ(1u, msg.body.key.seq);
+    EXPECT_EQ(WOULD_BLOCK, clientChannel->receiveMessage(&msg));
+    EXPECT_FALSE(isReadable(clientChannel->getFd()));
+}
+
+TEST_F(InputChannelTest, SharedRing_WhenFull_ReturnsWouldBlock) {
+    sp<InputChannel> serverChannel, clientChannel;
+    ASSERT_EQ(OK, InputChannel::openInputChannelPair("channel name",
+            serverChannel, clientChannel, true /*useSharedRing*/));
+
+    uint32_t sent = 0;
+    status_t status;
+    do {
+        InputMessage msg = makeKeyMessage(++sent);
+        status = serverChannel->sendMessage(&msg);
+    } while (status == OK && sent < 1000);
+    EXPECT_EQ(WOULD_BLOCK, status);
+
+    // Receiving one message makes room for one more
+    InputMessage msg;
+    EXPECT_EQ(OK, clientChannel->receiveMessage(&msg));
+    EXPECT_EQ(1u, msg.body.key.seq);
+    msg = makeKeyMessage(sent);
+    EXPECT_EQ(OK, serverChannel->sendMessage(&msg));
+}
+
+TEST_F(InputChannelTest, SharedRing_ReceiveWhenPeerClosed_ReturnsAnError) {
+    sp<InputChannel> serverChannel, clientChannel;
+    ASSERT_EQ(OK, InputChannel::openInputChannelPair("channel name",
+            serverChannel, clientChannel, true /*useSharedRing*/));
+
+    serverChannel.clear(); // close server channel
+
+    InputMessage msg;
+    EXPECT_EQ(DEAD_OBJECT, clientChannel->receiveMessage(&msg));
+}
 
 } // namespace android
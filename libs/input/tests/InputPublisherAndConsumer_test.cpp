@@ -21,6 +21,7 @@
 #include <time.h>
 
 #include <cutils/ashmem.h>
+#include <cutils/properties.h>
 #include <gtest/gtest.h>
 #include <input/InputTransport.h>
 #include <utils/Timers.h>
@@ -60,6 +61,7 @@ protected:
 
     void PublishAndConsumeKeyEvent();
     void PublishAndConsumeMotionEvent();
+    float ResampleStroke(InputConsumer::TouchPredictor predictor);
 };
 
 TEST_F(InputPublisherAndConsumerTest, GetChannel_ReturnsTheChannel) {
@@ -90,7 +92,9 @@ void InputPublisherAndConsumerTest::PublishAndConsumeKeyEvent() {
 
     uint32_t consumeSeq;
     InputEvent* event;
+    const nsecs_t beforeConsumeTime = systemTime(SYSTEM_TIME_MONOTONIC);
     status = mConsumer->consume(&mEventFactory, true /*consumeBatches*/, -1, &consumeSeq, &event);
+    const nsecs_t afterConsumeTime = systemTime(SYSTEM_TIME_MONOTONIC);
     ASSERT_EQ(OK, status)
             << "consumer consume should return OK";
 
@@ -119,13 +123,18 @@ void InputPublisherAndConsumerTest::PublishAndConsumeKeyEvent() {
 
     uint32_t finishedSeq = 0;
     bool handled = false;
-    status = mPublisher->receiveFinishedSignal(&finishedSeq, &handled);
+    nsecs_t consumeTime = 0;
+    status = mPublisher->receiveFinishedSignal(&finishedSeq, &handled, &consumeTime);
     ASSERT_EQ(OK, status)
             << "publisher receiveFinishedSignal should return OK";
     ASSERT_EQ(seq, finishedSeq)
             << "publisher receiveFinishedSignal should have returned the original sequence number";
     ASSERT_TRUE(handled)
             << "publisher receiveFinishedSignal should have set handled to consumer's reply";
+    ASSERT_GE(consumeTime, beforeConsumeTime)
+            << "publisher receiveFinishedSignal should have returned when the event was consumed";
+    ASSERT_LE(consumeTime, afterConsumeTime)
+            << "publisher receiveFinishedSignal should have returned when the event was consumed";
 }
 
 void InputPublisherAndConsumerTest::PublishAndConsumeMotionEvent() {
@@ -312,4 +321,143 @@ TEST_F(InputPublisherAndConsumerTest, PublishMultipleEvents_EndToEnd) {
     ASSERT_NO_FATAL_FAILURE(PublishAndConsumeKeyEvent());
 }
 
+TEST_F(InputPublisherAndConsumerTest, PublishBatch_SendsEventsAtEndOfBatch) {
+    uint32_t consumeSeq;
+    InputEvent* event;
+
+    mPublisher->beginBatch();
+    for (uint32_t seq = 1; seq <= 3; seq++) {
+        ASSERT_EQ(OK, mPublisher->publishKeyEvent(seq, 1, AINPUT_SOURCE_KEYBOARD,
+                ADISPLAY_ID_DEFAULT, AKEY_EVENT_ACTION_DOWN, 0, AKEYCODE_ENTER, 13, 0, 0, 3, 4));
+    }
+    ASSERT_EQ(WOULD_BLOCK, mConsumer->consume(&mEventFactory, true /*consumeBatches*/, -1,
+            &consumeSeq, &event))
+            << "events should not be sent before the batch ends";
+
+    size_t published = 0;
+    ASSERT_EQ(OK, mPublisher->endBatch(&published));
+    EXPECT_EQ(3u, published);
+
+    for (uint32_t seq = 1; seq <= 3; seq++) {
+        ASSERT_EQ(OK, mConsumer->consume(&mEventFactory, true /*consumeBatches*/, -1,
+                &consumeSeq, &event));
+        EXPECT_EQ(seq, consumeSeq);
+        ASSERT_EQ(AINPUT_EVENT_TYPE_KEY, event->getType());
+    }
+
+    // Outside of a batch, events go out right away again
+    ASSERT_EQ(OK, mPublisher->publishKeyEvent(4, 1, AINPUT_SOURCE_KEYBOARD,
+            ADISPLAY_ID_DEFAULT, AKEY_EVENT_ACTION_DOWN, 0, AKEYCODE_ENTER, 13, 0, 0, 3, 4));
+    ASSERT_EQ(OK, mConsumer->consume(&mEventFactory, true /*consumeBatches*/, -1,
+            &consumeSeq, &event));
+    EXPECT_EQ(4u, consumeSeq);
+}
+
+TEST_F(InputPublisherAndConsumerTest, ConsumeBatch_KeepsTheAxesOfEverySample) {
+    PointerProperties pointerProperties[2];
+    for (size_t i = 0; i < 2; i++) {
+        pointerProperties[i].clear();
+        pointerProperties[i].id = i;
+        pointerProperties[i].toolType = AMOTION_EVENT_TOOL_TYPE_FINGER;
+    }
+
+    // Every sample reports other axes, so that their values are packed differently.
+    for (uint32_t seq = 1; seq <= 3; seq++) {
+        PointerCoords pointerCoords[2];
+        for (size_t i = 0; i < 2; i++) {
+            pointerCoords[i].clear();
+            pointerCoords[i].setAxisValue(AMOTION_EVENT_AXIS_X, 10 * seq + i);
+            pointerCoords[i].setAxisValue(AMOTION_EVENT_AXIS_Y, 20 * seq + i);
+            if (seq == 2) {
+                pointerCoords[i].setAxisValue(AMOTION_EVENT_AXIS_PRESSURE, 0.5f + i);
+            }
+            if (seq == 3 && i == 1) {
+                pointerCoords[i].setAxisValue(AMOTION_EVENT_AXIS_GENERIC_1, 7);
+            }
+        }
+        ASSERT_EQ(OK, mPublisher->publishMotionEvent(seq, 1, AINPUT_SOURCE_JOYSTICK,
+                ADISPLAY_ID_DEFAULT, AMOTION_EVENT_ACTION_MOVE, 0, 0, 0, AMETA_NONE, 0,
+                MotionClassification::NONE, 0, 0, 1, 1, 0, seq, 2, pointerProperties,
+                pointerCoords));
+    }
+
+    uint32_t consumeSeq;
+    InputEvent* event;
+    ASSERT_EQ(OK, mConsumer->consume(&mEventFactory, true /*consumeBatches*/, -1,
+            &consumeSeq, &event));
+    EXPECT_EQ(3u, consumeSeq);
+    ASSERT_EQ(AINPUT_EVENT_TYPE_MOTION, event->getType());
+
+    MotionEvent* motionEvent = static_cast<MotionEvent*>(event);
+    ASSERT_EQ(2U, motionEvent->getHistorySize());
+    for (size_t sample = 0; sample < 3; sample++) {
+        const uint32_t seq = sample + 1;
+        for (size_t i = 0; i < 2; i++) {
+            const PointerCoords* coords = motionEvent->getHistoricalRawPointerCoords(i, sample);
+            EXPECT_EQ(nsecs_t(seq), motionEvent->getHistoricalEventTime(sample));
+            EXPECT_EQ(10.f * seq + i, coords->getAxisValue(AMOTION_EVENT_AXIS_X));
+            EXPECT_EQ(20.f * seq + i, coords->getAxisValue(AMOTION_EVENT_AXIS_Y));
+            EXPECT_EQ(seq == 2 ? 0.5f + i : 0.f,
+                    coords->getAxisValue(AMOTION_EVENT_AXIS_PRESSURE));
+            EXPECT_EQ(seq == 3 && i == 1 ? 7.f : 0.f,
+                    coords->getAxisValue(AMOTION_EVENT_AXIS_GENERIC_1));
+        }
+    }
+}
+
+// Publishes a finger touching down and accelerating along x = t^2 / 10ms, then returns
+// the x coordinate the consumer resamples 4ms past the last sample.
+float InputPublisherAndConsumerTest::ResampleStroke(InputConsumer::TouchPredictor predictor) {
+    mConsumer->setTouchPredictor(predictor);
+
+    PointerProperties pointerProperties;
+    pointerProperties.clear();
+    pointerProperties.id = 0;
+    pointerProperties.toolType = AMOTION_EVENT_TOOL_TYPE_FINGER;
+    PointerCoords pointerCoords;
+
+    uint32_t consumeSeq;
+    InputEvent* event = nullptr;
+    for (uint32_t seq = 1; seq <= 3; seq++) {
+        const nsecs_t eventTime = milliseconds_to_nanoseconds(10 * (seq - 1));
+        const float t = 10.f * (seq - 1);
+        pointerCoords.clear();
+        pointerCoords.setAxisValue(AMOTION_EVENT_AXIS_X, t * t / 10);
+        pointerCoords.setAxisValue(AMOTION_EVENT_AXIS_Y, 100);
+        EXPECT_EQ(OK, mPublisher->publishMotionEvent(seq, 1, AINPUT_SOURCE_TOUCHSCREEN,
+                ADISPLAY_ID_DEFAULT, seq == 1 ? AMOTION_EVENT_ACTION_DOWN
+                : AMOTION_EVENT_ACTION_MOVE, 0, 0, 0, 0, 0, MotionClassification::NONE,
+                0, 0, 1, 1, 0, eventTime, 1, &pointerProperties, &pointerCoords));
+
+        // The last move is consumed on a frame late enough for it to be extrapolated
+        const nsecs_t frameTime = seq < 3 ? -1 : eventTime + milliseconds_to_nanoseconds(9);
+        EXPECT_EQ(OK, mConsumer->consume(&mEventFactory, true /*consumeBatches*/, frameTime,
+                &consumeSeq, &event));
+    }
+    if (event == nullptr || event->getType() != AINPUT_EVENT_TYPE_MOTION) {
+        ADD_FAILURE() << "consumer should have returned a motion event";
+        return 0;
+    }
+    MotionEvent* motionEvent = static_cast<MotionEvent*>(event);
+    EXPECT_EQ(1U, motionEvent->getHistorySize()) << "the resampled sample should be added";
+    EXPECT_EQ(milliseconds_to_nanoseconds(24), motionEvent->getEventTime());
+    return motionEvent->getX(0);
+}
+
+TEST_F(InputPublisherAndConsumerTest, Resample_ByDefault_ExtrapolatesLinearly) {
+    if (!property_get_bool("ro.input.resampling", true)) {
+        GTEST_SKIP() << "touch resampling is disabled on this device";
+    }
+    // 40 plus 4ms at the last 3px/ms
+    EXPECT_NEAR(52.f, ResampleStroke(InputConsumer::TouchPredictor::LINEAR), 0.01f);
+}
+
+TEST_F(InputPublisherAndConsumerTest, Resample_WhenQuadratic_FollowsAcceleration) {
+    if (!property_get_bool("ro.input.resampling", true)) {
+        GTEST_SKIP() << "touch resampling is disabled on this device";
+    }
+    // 24^2 / 10
+    EXPECT_NEAR(57.6f, ResampleStroke(InputConsumer::TouchPredictor::QUADRATIC), 0.01f);
+}
+
 } // namespace android
@@ -99,5 +99,44 @@ TEST(InputWindowInfo, Parcelling) {
     ASSERT_EQ(i.touchableRegionCropHandle, i2.touchableRegionCropHandle);
 }
 
+TEST(InputWindowInfo, Equality) {
+    InputWindowInfo i;
+    i.token = new BBinder();
+    i.name = "Foobar";
+    i.layoutParamsFlags = 7;
+    i.layoutParamsType = 39;
+    i.dispatchingTimeout = 12;
+    i.frameLeft = 93;
+    i.frameTop = 34;
+    i.frameRight = 16;
+    i.frameBottom = 19;
+    i.globalScaleFactor = 0.3;
+    i.addTouchableRegion(Rect(0, 0, 10, 10));
+    i.visible = true;
+    i.canReceiveKeys = false;
+    i.hasFocus = false;
+    i.hasWallpaper = false;
+    i.paused = false;
+    i.layer = 7;
+    i.ownerPid = 19;
+    i.ownerUid = 24;
+    i.inputFeatures = 29;
+    i.displayId = 34;
+    i.applicationInfo.dispatchingTimeout = 5;
+    i.replaceTouchableRegionWithCrop = false;
+
+    Parcel p;
+    i.write(p);
+    p.setDataPosition(0);
+    InputWindowInfo i2 = InputWindowInfo::read(p);
+    ASSERT_TRUE(i == i2);
+
+    i2.frameLeft++;
+    ASSERT_TRUE(i != i2);
+    i2.frameLeft--;
+    i2.addTouchableRegion(Rect(20, 20, 30, 30));
+    ASSERT_TRUE(i != i2);
+}
+
 } // namespace test
 } // namespace android
@@ -0,0 +1,117 @@
+/*
+ * Copyright (C) 2019 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "../KeyMapCache.h"
+
+#include <android-base/file.h>
+#include <android-base/test_utils.h>
+#include <gtest/gtest.h>
+
+namespace android {
+
+struct TestMap : public RefBase {
+    std::string contents;
+};
+
+class KeyMapCacheTest : public testing::Test {
+protected:
+    std::string write(const char* name, const std::string& contents) {
+        const std::string path = std::string(mDir.path) + "/" + name;
+        EXPECT_TRUE(base::WriteStringToFile(contents, path));
+        return path;
+    }
+
+    sp<TestMap> load(const std::string& path, int kind = 0) {
+        sp<TestMap> map;
+        status_t status = mCache.load(path, kind,
+                [this](const std::string&, const std::string& contents, sp<TestMap>* outMap) {
+                    mParseCount++;
+                    *outMap = new TestMap();
+                    (*outMap)->contents = contents;
+                    return NO_ERROR;
+                },
+                &map);
+        EXPECT_EQ(NO_ERROR, status);
+        return map;
+    }
+
+    TemporaryDir mDir;
+    KeyMapCache<TestMap> mCache;
+    int mParseCount = 0;
+};
+
+TEST_F(KeyMapCacheTest, SharesMapOfSameFile) {
+    const std::string path = write("a.kl", "key 1 ESCAPE\n");
+    sp<TestMap> first = load(path);
+    sp<TestMap> second = load(path);
+    ASSERT_NE(nullptr, first);
+    EXPECT_EQ(first, second);
+    EXPECT_EQ(1, mParseCount);
+}
+
+TEST_F(KeyMapCacheTest, SharesMapOfIdenticalContents) {
+    sp<TestMap> first = load(write("a.kl", "key 1 ESCAPE\n"));
+    sp<TestMap> second = load(write("b.kl", "key 1 ESCAPE\n"));
+    ASSERT_NE(nullptr, first);
+    EXPECT_EQ(first, second);
+    EXPECT_EQ(1, mParseCount);
+}
+
+TEST_F(KeyMapCacheTest, DoesNotShareMapOfOtherContentsOfSameSize) {
+    sp<TestMap> first = load(write("a.kl", "key 1 ESCAPE\n"));
+    sp<TestMap> second = load(write("b.kl", "key 2 ESCAPE\n"));
+    ASSERT_NE(nullptr, first);
+    ASSERT_NE(nullptr, second);
+    EXPECT_NE(first, second);
+    EXPECT_EQ("key 2 ESCAPE\n", second->contents);
+    EXPECT_EQ(2, mParseCount);
+}
+
+TEST_F(KeyMapCacheTest, DoesNotShareMapAcrossKinds) {
+    const std::string path = write("a.kcm", "type FULL\n");
+    sp<TestMap> first = load(path, 1);
+    sp<TestMap> second = load(path, 2);
+    EXPECT_NE(first, second);
+    EXPECT_EQ(2, mParseCount);
+}
+
+TEST_F(KeyMapCacheTest, ReloadsEditedFile) {
+    const std::string path = write("a.kl", "key 1 ESCAPE\n");
+    sp<TestMap> first = load(path);
+    write("a.kl", "key 1 ESCAPE\nkey 2 1\n");
+    sp<TestMap> second = load(path);
+    ASSERT_NE(nullptr, second);
+    EXPECT_NE(first, second);
+    EXPECT_EQ("key 1 ESCAPE\nkey 2 1\n", second->contents);
+}
+
+TEST_F(KeyMapCacheTest, ParsesFreedMapAgain) {
+    const std::string path = write("a.kl", "key 1 ESCAPE\n");
+    load(path);
+    sp<TestMap> map = load(path);
+    ASSERT_NE(nullptr, map);
+    EXPECT_EQ(2, mParseCount);
+}
+
+TEST_F(KeyMapCacheTest, FailsOnMissingFile) {
+    sp<TestMap> map;
+    status_t status = mCache.load(std::string(mDir.path) + "/missing.kl", 0,
+            [](const std::string&, const std::string&, sp<TestMap>*) { return NO_ERROR; }, &map);
+    EXPECT_NE(NO_ERROR, status);
+    EXPECT_EQ(nullptr, map);
+}
+
+} // namespace android
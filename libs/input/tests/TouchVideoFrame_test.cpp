@@ -67,6 +67,17 @@ TEST(TouchVideoFrame, Equality) {
     ASSERT_FALSE(frame == changedTimestampFrame);
 }
 
+TEST(TouchVideoFrame, CopiesShareDataUntilRotated) {
+    TouchVideoFrame frame(3, 2, {1, 2, 3, 4, 5, 6}, TIMESTAMP);
+    TouchVideoFrame copy = frame;
+    ASSERT_EQ(&frame.getData(), &copy.getData());
+
+    // Rotating a copy must leave the original frame untouched
+    copy.rotate(DISPLAY_ORIENTATION_180);
+    ASSERT_EQ(std::vector<int16_t>({1, 2, 3, 4, 5, 6}), frame.getData());
+    ASSERT_EQ(std::vector<int16_t>({6, 5, 4, 3, 2, 1}), copy.getData());
+}
+
 // --- Rotate 90 degrees ---
 
 TEST(TouchVideoFrame, Rotate90_0x0) {
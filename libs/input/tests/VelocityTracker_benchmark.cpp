@@ -0,0 +1,83 @@
+/*
+ * Copyright (C) 2019 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <math.h>
+
+#include <benchmark/benchmark.h>
+#include <input/VelocityTracker.h>
+
+namespace android {
+
+// Pointers move at these velocities, in pixels per second, one per pointer id
+static constexpr float VELOCITY_X = 1200.f;
+static constexpr float VELOCITY_Y = -800.f;
+
+// A fling sampled at 120Hz, long enough to fill the tracker's history
+static constexpr size_t SAMPLE_COUNT = 24;
+static constexpr nsecs_t SAMPLE_INTERVAL = 8333333;
+
+// Feeds a straight fling of the given number of pointers to the strategy, and
+// reports the time to compute every pointer's velocity along with the relative
+// error of the result, which should be close to zero for the polynomial fits.
+static void BM_GetVelocity(benchmark::State& state, const char* strategy) {
+    const uint32_t pointerCount = uint32_t(state.range(0));
+    BitSet32 idBits;
+    for (uint32_t id = 0; id < pointerCount; id++) {
+        idBits.markBit(id);
+    }
+
+    VelocityTracker tracker(strategy);
+    VelocityTracker::Position positions[MAX_POINTERS];
+    for (size_t i = 0; i < SAMPLE_COUNT; i++) {
+        const nsecs_t eventTime = nsecs_t(i) * SAMPLE_INTERVAL;
+        const float seconds = eventTime * 1E-9f;
+        for (uint32_t id = 0; id < pointerCount; id++) {
+            // Small jitter, as a real digitizer would report
+            const float noise = (i % 3 == 0) ? 0.5f : -0.25f;
+            positions[id].x = 100.f * id + VELOCITY_X * seconds + noise;
+            positions[id].y = 2000.f + VELOCITY_Y * seconds - noise;
+        }
+        tracker.addMovement(eventTime, idBits, positions);
+    }
+
+    float error = 0;
+    for (auto _ : state) {
+        for (uint32_t id = 0; id < pointerCount; id++) {
+            float vx, vy;
+            tracker.getVelocity(id, &vx, &vy);
+            benchmark::DoNotOptimize(vx);
+            benchmark::DoNotOptimize(vy);
+            error = hypotf(vx - VELOCITY_X, vy - VELOCITY_Y) / hypotf(VELOCITY_X, VELOCITY_Y);
+        }
+    }
+    state.counters["error"] = error;
+    state.SetItemsProcessed(state.iterations() * pointerCount);
+}
+
+BENCHMARK_CAPTURE(BM_GetVelocity, impulse, "impulse")->Arg(1)->Arg(2)->Arg(5);
+BENCHMARK_CAPTURE(BM_GetVelocity, lsq1, "lsq1")->Arg(1)->Arg(2)->Arg(5);
+BENCHMARK_CAPTURE(BM_GetVelocity, lsq2, "lsq2")->Arg(1)->Arg(2)->Arg(5);
+BENCHMARK_CAPTURE(BM_GetVelocity, lsq3, "lsq3")->Arg(1)->Arg(2)->Arg(5);
+BENCHMARK_CAPTURE(BM_GetVelocity, wlsq2_delta, "wlsq2-delta")->Arg(1)->Arg(2)->Arg(5);
+BENCHMARK_CAPTURE(BM_GetVelocity, wlsq2_central, "wlsq2-central")->Arg(1)->Arg(2)->Arg(5);
+BENCHMARK_CAPTURE(BM_GetVelocity, wlsq2_recent, "wlsq2-recent")->Arg(1)->Arg(2)->Arg(5);
+BENCHMARK_CAPTURE(BM_GetVelocity, int1, "int1")->Arg(1)->Arg(2)->Arg(5);
+BENCHMARK_CAPTURE(BM_GetVelocity, int2, "int2")->Arg(1)->Arg(2)->Arg(5);
+BENCHMARK_CAPTURE(BM_GetVelocity, legacy, "legacy")->Arg(1)->Arg(2)->Arg(5);
+
+} // namespace android
+
+BENCHMARK_MAIN();
@@ -268,6 +268,30 @@ TEST_F(VelocityTrackerTest, ThreePointsLinearVelocityTest) {
     computeAndCheckVelocity("lsq2", motions, AMOTION_EVENT_AXIS_X, 500);
 }
 
+TEST_F(VelocityTrackerTest, ImpulseVelocityFollowsNewMovements) {
+    // The velocity is cached between movements, so it must be refreshed by each new one
+    VelocityTracker vt;
+    ASSERT_TRUE(vt.setStrategy("impulse"));
+    ASSERT_FALSE(vt.setStrategy("not-a-strategy"));
+    BitSet32 idBits(BitSet32::valueForBit(DEFAULT_POINTER_ID));
+    VelocityTracker::Position positions[] = {{0, 0}};
+    vt.addMovement(0, idBits, positions);
+    positions[0].x = 5;
+    vt.addMovement(10000000, idBits, positions);
+    float Vx, Vy;
+    vt.getVelocity(DEFAULT_POINTER_ID, &Vx, &Vy);
+    checkVelocity(Vx, 500);
+    vt.getVelocity(DEFAULT_POINTER_ID, &Vx, &Vy);
+    checkVelocity(Vx, 500);
+
+    positions[0].x = 10;
+    vt.addMovement(20000000, idBits, positions);
+    positions[0].x = 20;
+    vt.addMovement(30000000, idBits, positions);
+    vt.getVelocity(DEFAULT_POINTER_ID, &Vx, &Vy);
+    EXPECT_GT(Vx, 500);
+}
+
 
 /**
  * ================== VelocityTracker tests generated by recording real events =====================
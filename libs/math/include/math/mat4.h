@@ -26,6 +26,14 @@
 #include <sys/types.h>
 #include <limits>
 
+#if defined(__ARM_NEON__) || defined(__ARM_NEON)
+#include <arm_neon.h>
+#define MATH_MAT4_NEON
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#define MATH_MAT4_SSE2
+#endif
+
 #define PURE __attribute__((pure))
 
 #if __cplusplus >= 201402L
@@ -519,9 +527,10 @@ CONSTEXPR TMat44<T> TMat44<T>::lookAt(const TVec3<A>& eye, const TVec3<B>& cente
  * it determines the output type (only relevant when T != U).
  */
 
-// matrix * column-vector, result is a vector of the same type than the input vector
+// matrix * column-vector, computed one column at a time
 template <typename T, typename U>
-CONSTEXPR typename TMat44<T>::col_type PURE operator *(const TMat44<T>& lhs, const TVec4<U>& rhs) {
+CONSTEXPR typename TMat44<T>::col_type PURE multiplyScalar(const TMat44<T>& lhs,
+                                                           const TVec4<U>& rhs) {
     // Result is initialized to zero.
     typename TMat44<T>::col_type result;
     for (size_t col = 0; col < TMat44<T>::NUM_COLS; ++col) {
@@ -530,6 +539,47 @@ CONSTEXPR typename TMat44<T>::col_type PURE operator *(const TMat44<T>& lhs, con
     return result;
 }
 
+// matrix * column-vector, with SIMD for float matrices.  Each lane goes through
+// the same multiply and add per column as in multiplyScalar, so both give the
+// same results.
+template <typename T, typename U>
+inline typename TMat44<T>::col_type PURE multiplyVectorized(const TMat44<T>& lhs,
+                                                            const TVec4<U>& rhs) {
+    return multiplyScalar(lhs, rhs);
+}
+
+#if defined(MATH_MAT4_NEON)
+inline TVec4<float> PURE multiplyVectorized(const TMat44<float>& lhs, const TVec4<float>& rhs) {
+    float32x4_t result = vdupq_n_f32(0.0f);
+    result = vmlaq_n_f32(result, vld1q_f32(&lhs[0][0]), rhs[0]);
+    result = vmlaq_n_f32(result, vld1q_f32(&lhs[1][0]), rhs[1]);
+    result = vmlaq_n_f32(result, vld1q_f32(&lhs[2][0]), rhs[2]);
+    result = vmlaq_n_f32(result, vld1q_f32(&lhs[3][0]), rhs[3]);
+    TVec4<float> out(TVec4<float>::NO_INIT);
+    vst1q_f32(&out[0], result);
+    return out;
+}
+#elif defined(MATH_MAT4_SSE2)
+inline TVec4<float> PURE multiplyVectorized(const TMat44<float>& lhs, const TVec4<float>& rhs) {
+    __m128 result = _mm_setzero_ps();
+    result = _mm_add_ps(result, _mm_mul_ps(_mm_loadu_ps(&lhs[0][0]), _mm_set1_ps(rhs[0])));
+    result = _mm_add_ps(result, _mm_mul_ps(_mm_loadu_ps(&lhs[1][0]), _mm_set1_ps(rhs[1])));
+    result = _mm_add_ps(result, _mm_mul_ps(_mm_loadu_ps(&lhs[2][0]), _mm_set1_ps(rhs[2])));
+    result = _mm_add_ps(result, _mm_mul_ps(_mm_loadu_ps(&lhs[3][0]), _mm_set1_ps(rhs[3])));
+    TVec4<float> out(TVec4<float>::NO_INIT);
+    _mm_storeu_ps(&out[0], result);
+    return out;
+}
+#endif
+
+// matrix * column-vector, result is a vector of the same type than the input vector
+// matrix * matrix goes through this too, one column of the rhs matrix at a time.
+// Neither is usable in constant expressions, since the vector += isn't.
+template <typename T, typename U>
+CONSTEXPR typename TMat44<T>::col_type PURE operator *(const TMat44<T>& lhs, const TVec4<U>& rhs) {
+    return multiplyVectorized(lhs, rhs);
+}
+
 // mat44 * vec3, result is vec3( mat44 * {vec3, 1} )
 template <typename T, typename U>
 CONSTEXPR typename TMat44<T>::col_type PURE operator *(const TMat44<T>& lhs, const TVec3<U>& rhs) {
@@ -584,3 +634,5 @@ typedef details::TMat44<float> mat4f;
 
 #undef PURE
 #undef CONSTEXPR
+#undef MATH_MAT4_NEON
+#undef MATH_MAT4_SSE2
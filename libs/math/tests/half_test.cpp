@@ -18,6 +18,9 @@
 
 #include <math.h>
 #include <stdlib.h>
+#include <string.h>
+
+#include <vector>
 
 #include <math/half.h>
 #include <math/vec4.h>
@@ -50,6 +53,8 @@ TEST_F(HalfTest, Basics) {
     EXPECT_EQ(0xC000, half(-2).getBits());
     EXPECT_EQ(0x0400, half(6.10352e-5).getBits());
     EXPECT_EQ(0x7BFF, half(65504).getBits());
+    EXPECT_EQ(0x7C00, half(100000).getBits());
+    EXPECT_EQ(0xFC00, half(-100000).getBits());
     EXPECT_EQ(0x3555, half(1.0f/3).getBits());
 
     // numeric limits
@@ -82,6 +87,36 @@ TEST_F(HalfTest, Literals) {
 }
 
 
+TEST_F(HalfTest, BulkConversions) {
+    // Every half, converted at once and one by one. A half can only be built
+    // from any bits through its storage.
+    std::vector<half> halves(0x10000, half(0.0f));
+    for (uint32_t bits = 0; bits <= 0xFFFF; bits++) {
+        const uint16_t h16 = uint16_t(bits);
+        memcpy(static_cast<void*>(&halves[bits]), &h16, sizeof(h16));
+    }
+    std::vector<float> floats(halves.size());
+    half::toFloats(halves.data(), floats.data(), halves.size());
+    for (size_t i = 0; i < halves.size(); i++) {
+        const float expected = float(halves[i]);
+        EXPECT_EQ(0, memcmp(&expected, &floats[i], sizeof(float))) << "half bits " << i;
+    }
+
+    // A sweep of float bit patterns, including odd counts for the tail.
+    std::vector<float> inputs;
+    for (uint64_t bits = 0; bits <= 0xFFFFFFFF; bits += 0x10001) {
+        const uint32_t b = uint32_t(bits);
+        float f;
+        memcpy(&f, &b, sizeof(f));
+        inputs.push_back(f);
+    }
+    std::vector<half> converted(inputs.size(), half(0.0f));
+    half::fromFloats(inputs.data(), converted.data(), inputs.size());
+    for (size_t i = 0; i < inputs.size(); i++) {
+        EXPECT_EQ(half(inputs[i]).getBits(), converted[i].getBits()) << "float " << inputs[i];
+    }
+}
+
 TEST_F(HalfTest, Vec) {
     float4 f4(1,2,3,4);
     half4 h4(f4);
@@ -163,6 +163,30 @@ TEST_F(MatTest, ElementAccess) {
     EXPECT_FLOAT_EQ(m(3, 2), 100);
 }
 
+TEST_F(MatTest, VectorizedProducts) {
+    std::default_random_engine generator(171717);
+    std::uniform_real_distribution<float> distribution(-100.0f, 100.0f);
+    auto next = std::bind(distribution, generator);
+
+    for (size_t i = 0; i < 100; i++) {
+        mat4 a, b;
+        vec4 v(next(), next(), next(), next());
+        for (size_t c = 0; c < 4; c++) {
+            for (size_t r = 0; r < 4; r++) {
+                a[c][r] = next();
+                b[c][r] = next();
+            }
+        }
+
+        // The vectorized products round exactly like the generic ones.
+        EXPECT_EQ(details::multiplyScalar(a, v), a * v);
+        mat4 product = a * b;
+        for (size_t c = 0; c < 4; c++) {
+            EXPECT_EQ(details::multiplyScalar(a, b[c]), product[c]);
+        }
+    }
+}
+
 //------------------------------------------------------------------------------
 // MAT 3
 //------------------------------------------------------------------------------
@@ -0,0 +1,114 @@
+/*
+ * Copyright 2019 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <stdlib.h>
+
+#include <vector>
+
+#include <benchmark/benchmark.h>
+#include <math/half.h>
+#include <math/mat4.h>
+
+namespace android {
+
+static mat4 makeMatrix() {
+    mat4 m;
+    for (size_t c = 0; c < 4; c++) {
+        for (size_t r = 0; r < 4; r++) {
+            m[c][r] = float(random() % 1000) / 100.0f;
+        }
+    }
+    return m;
+}
+
+static void BM_Mat4TimesVec4(benchmark::State& state, bool vectorized) {
+    srandom(1234);
+    const mat4 m = makeMatrix();
+    vec4 v(0.25f, 0.5f, 0.75f, 1.0f);
+    for (auto _ : state) {
+        v = vectorized ? m * v : details::multiplyScalar(m, v);
+        benchmark::DoNotOptimize(v);
+    }
+}
+BENCHMARK_CAPTURE(BM_Mat4TimesVec4, scalar, false);
+BENCHMARK_CAPTURE(BM_Mat4TimesVec4, vectorized, true);
+
+static void BM_Mat4TimesMat4(benchmark::State& state, bool vectorized) {
+    srandom(1234);
+    const mat4 lhs = makeMatrix();
+    const mat4 rhs = makeMatrix();
+    for (auto _ : state) {
+        mat4 product;
+        if (vectorized) {
+            product = lhs * rhs;
+        } else {
+            for (size_t c = 0; c < 4; c++) {
+                product[c] = details::multiplyScalar(lhs, rhs[c]);
+            }
+        }
+        benchmark::DoNotOptimize(product);
+    }
+}
+BENCHMARK_CAPTURE(BM_Mat4TimesMat4, scalar, false);
+BENCHMARK_CAPTURE(BM_Mat4TimesMat4, vectorized, true);
+
+static void BM_FloatsToHalves(benchmark::State& state, bool vectorized) {
+    const size_t count = state.range(0);
+    std::vector<float> in(count);
+    for (size_t i = 0; i < count; i++) {
+        in[i] = float(i) / 7.0f;
+    }
+    std::vector<half> out(count, half(0.0f));
+    for (auto _ : state) {
+        if (vectorized) {
+            half::fromFloats(in.data(), out.data(), count);
+        } else {
+            for (size_t i = 0; i < count; i++) {
+                out[i] = half(in[i]);
+            }
+        }
+        benchmark::DoNotOptimize(out.data());
+    }
+    state.SetItemsProcessed(state.iterations() * count);
+}
+BENCHMARK_CAPTURE(BM_FloatsToHalves, scalar, false)->RangeMultiplier(8)->Range(4, 4096);
+BENCHMARK_CAPTURE(BM_FloatsToHalves, vectorized, true)->RangeMultiplier(8)->Range(4, 4096);
+
+static void BM_HalvesToFloats(benchmark::State& state, bool vectorized) {
+    const size_t count = state.range(0);
+    std::vector<half> in(count, half(0.0f));
+    for (size_t i = 0; i < count; i++) {
+        in[i] = half(float(i) / 7.0f);
+    }
+    std::vector<float> out(count);
+    for (auto _ : state) {
+        if (vectorized) {
+            half::toFloats(in.data(), out.data(), count);
+        } else {
+            for (size_t i = 0; i < count; i++) {
+                out[i] = float(in[i]);
+            }
+        }
+        benchmark::DoNotOptimize(out.data());
+    }
+    state.SetItemsProcessed(state.iterations() * count);
+}
+BENCHMARK_CAPTURE(BM_HalvesToFloats, scalar, false)->RangeMultiplier(8)->Range(4, 4096);
+BENCHMARK_CAPTURE(BM_HalvesToFloats, vectorized, true)->RangeMultiplier(8)->Range(4, 4096);
+
+} // namespace android
+
+BENCHMARK_MAIN();
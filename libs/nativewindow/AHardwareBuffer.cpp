@@ -67,6 +67,35 @@ int AHardwareBuffer_allocate(const AHardwareBuffer_Desc* desc, AHardwareBuffer**
     return NO_ERROR;
 }
 
+int AHardwareBuffer_allocateMultiple(const AHardwareBuffer_Desc* desc, uint32_t count,
+        AHardwareBuffer** outBuffers) {
+    if (!outBuffers || !desc || count == 0) return BAD_VALUE;
+    if (!AHardwareBuffer_isValidDescription(desc, /*log=*/true)) return BAD_VALUE;
+
+    int format = AHardwareBuffer_convertToPixelFormat(desc->format);
+    uint64_t usage = AHardwareBuffer_convertToGrallocUsageBits(desc->usage);
+    std::vector<sp<GraphicBuffer>> gbuffers;
+    status_t err = GraphicBuffer::allocate(
+            desc->width, desc->height, format, desc->layers, usage, count,
+            std::string("AHardwareBuffer pid [") + std::to_string(getpid()) + "]", &gbuffers);
+    if (err != 0) {
+        if (err == NO_MEMORY) {
+            GraphicBuffer::dumpAllocationsToSystemLog();
+        }
+        ALOGE("GraphicBuffer(w=%u, h=%u, lc=%u) x %u failed (%s)",
+                desc->width, desc->height, desc->layers, count, strerror(-err));
+        return err;
+    }
+
+    for (uint32_t i = 0; i < count; i++) {
+        outBuffers[i] = AHardwareBuffer_from_GraphicBuffer(gbuffers[i].get());
+
+        // Ensure the buffer doesn't get destroyed when the sp<> goes away.
+        AHardwareBuffer_acquire(outBuffers[i]);
+    }
+    return NO_ERROR;
+}
+
 void AHardwareBuffer_acquire(AHardwareBuffer* buffer) {
     // incStrong/decStrong token must be the same, doesn't matter what it is
     AHardwareBuffer_to_GraphicBuffer(buffer)->incStrong((void*)AHardwareBuffer_acquire);
@@ -520,6 +520,25 @@ int AHardwareBuffer_lockAndGetInfo(AHardwareBuffer* buffer, uint64_t usage,
         int32_t* outBytesPerPixel, int32_t* outBytesPerStride) __INTRODUCED_IN(29);
 #endif // __ANDROID_API__ >= 29
 
+#if __ANDROID_API__ >= 30
+
+/**
+ * Allocates count buffers that all match the passed AHardwareBuffer_Desc.
+ *
+ * This is equivalent to calling AHardwareBuffer_allocate() count times,
+ * except that the buffers are allocated together, which is faster when
+ * setting up a pool of buffers. Either all of the buffers are allocated,
+ * or none is.
+ *
+ * \return 0 on success, -EINVAL if \a desc or \a outBuffers is NULL, or
+ * \a count is 0, or an error number if the allocation fails for any
+ * reason. Each returned buffer has a reference count of 1.
+ */
+int AHardwareBuffer_allocateMultiple(const AHardwareBuffer_Desc* desc, uint32_t count,
+        AHardwareBuffer** outBuffers) __INTRODUCED_IN(30);
+
+#endif // __ANDROID_API__ >= 30
+
 __END_DECLS
 
 #endif // ANDROID_HARDWARE_BUFFER_H
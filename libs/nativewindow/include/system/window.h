@@ -34,6 +34,7 @@
 #include <cutils/native_handle.h>
 #include <errno.h>
 #include <limits.h>
+#include <stddef.h>
 #include <stdint.h>
 #include <string.h>
 #include <sys/cdefs.h>
@@ -238,6 +239,7 @@ enum {
     NATIVE_WINDOW_SET_BUFFERS_SMPTE2086_METADATA = 32,
     NATIVE_WINDOW_SET_BUFFERS_CTA861_3_METADATA = 33,
     NATIVE_WINDOW_SET_BUFFERS_HDR10_PLUS_METADATA = 34,
+    NATIVE_WINDOW_GET_FAST_DISPATCH             = 35,   /* private */
     // clang-format on
 };
 
@@ -985,4 +987,41 @@ static inline int native_window_get_consumer_usage(struct ANativeWindow* window,
     return window->perform(window, NATIVE_WINDOW_GET_CONSUMER_USAGE64, outUsage);
 }
 
+/*
+ * Typed entry points for setters called on every frame, which skip decoding
+ * the variable arguments of perform(). New entries are only ever appended, and
+ * size is the size of the table the window implements: entries past it must
+ * not be called, see NATIVE_WINDOW_FAST_DISPATCH_HAS.
+ *
+ * query() and setSwapInterval() are already typed hooks of ANativeWindow.
+ */
+typedef struct ANativeWindowFastDispatch {
+    size_t size;
+    int (*setBuffersTimestamp)(struct ANativeWindow* window, int64_t timestamp);
+    int (*setBuffersDataSpace)(struct ANativeWindow* window, android_dataspace_t dataSpace);
+    int (*setSurfaceDamage)(struct ANativeWindow* window, const android_native_rect_t* rects,
+                            size_t numRects);
+} ANativeWindowFastDispatch;
+
+#define NATIVE_WINDOW_FAST_DISPATCH_HAS(dispatch, entry)                 \
+    ((dispatch) != NULL &&                                               \
+     offsetof(ANativeWindowFastDispatch, entry) +                        \
+                     sizeof(((ANativeWindowFastDispatch*)NULL)->entry) <= \
+             (dispatch)->size &&                                          \
+     (dispatch)->entry != NULL)
+
+/*
+ * native_window_get_fast_dispatch(..., const ANativeWindowFastDispatch** outDispatch)
+ * Returns the table of typed entry points of the window, which stays valid as
+ * long as the window does, so callers are expected to look it up once. Windows
+ * that don't have one return NAME_NOT_FOUND (-ENOENT), and callers fall back to
+ * the native_window_* functions.
+ */
+static inline int native_window_get_fast_dispatch(
+        struct ANativeWindow* window, const ANativeWindowFastDispatch** outDispatch)
+{
+    *outDispatch = NULL;
+    return window->perform(window, NATIVE_WINDOW_GET_FAST_DISPATCH, outDispatch);
+}
+
 __END_DECLS
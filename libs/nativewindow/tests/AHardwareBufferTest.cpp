@@ -106,3 +106,31 @@ EXPECT_TRUE(TestUsageConversion(
         AHARDWAREBUFFER_USAGE_GPU_COLOR_OUTPUT | AHARDWAREBUFFER_USAGE_GPU_SAMPLED_IMAGE |
         AHARDWAREBUFFER_USAGE_VENDOR_1 | AHARDWAREBUFFER_USAGE_VENDOR_13));
 }
+
+TEST(AHardwareBufferTest, AllocateMultiple) {
+    AHardwareBuffer_Desc desc = {};
+    desc.width = 64;
+    desc.height = 64;
+    desc.layers = 1;
+    desc.format = AHARDWAREBUFFER_FORMAT_R8G8B8A8_UNORM;
+    desc.usage = AHARDWAREBUFFER_USAGE_CPU_READ_RARELY | AHARDWAREBUFFER_USAGE_CPU_WRITE_RARELY;
+
+    AHardwareBuffer* buffers[4] = {};
+    EXPECT_EQ(BAD_VALUE, AHardwareBuffer_allocateMultiple(&desc, 0, buffers));
+    ASSERT_EQ(NO_ERROR, AHardwareBuffer_allocateMultiple(&desc, 4, buffers));
+
+    for (AHardwareBuffer* buffer : buffers) {
+        ASSERT_NE(nullptr, buffer);
+        AHardwareBuffer_Desc outDesc;
+        AHardwareBuffer_describe(buffer, &outDesc);
+        EXPECT_EQ(desc.width, outDesc.width);
+        EXPECT_EQ(desc.height, outDesc.height);
+        EXPECT_EQ(desc.format, outDesc.format);
+        EXPECT_EQ(desc.usage, outDesc.usage);
+    }
+    EXPECT_NE(buffers[0], buffers[1]);
+
+    for (AHardwareBuffer* buffer : buffers) {
+        AHardwareBuffer_release(buffer);
+    }
+}
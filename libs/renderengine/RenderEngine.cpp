@@ -20,6 +20,7 @@
 #include <log/log.h>
 #include <private/gui/SyncFeatures.h>
 #include "gl/GLESRenderEngine.h"
+#include "threaded/RenderEngineThreaded.h"
 
 namespace android {
 namespace renderengine {
@@ -32,6 +33,15 @@ std::unique_ptr<impl::RenderEngine> RenderEngine::create(int hwcFormat, uint32_t
         ALOGD("RenderEngine GLES Backend");
         return renderengine::gl::GLESRenderEngine::create(hwcFormat, featureFlags, imageCacheSize);
     }
+    if (strcmp(prop, "threaded") == 0) {
+        ALOGD("Threaded RenderEngine with GLES Backend");
+        return renderengine::threaded::RenderEngineThreaded::create(
+                [=]() {
+                    return renderengine::gl::GLESRenderEngine::create(hwcFormat, featureFlags,
+                                                                      imageCacheSize);
+                },
+                featureFlags);
+    }
     ALOGE("UNKNOWN BackendType: %s, create GLES RenderEngine.", prop);
     return renderengine::gl::GLESRenderEngine::create(hwcFormat, featureFlags, imageCacheSize);
 }
@@ -52,6 +62,16 @@ bool RenderEngine::useWaitSync() const {
     return SyncFeatures::getInstance().useWaitSync();
 }
 
+void RenderEngine::drawLayersAsync(const DisplaySettings& display,
+                                   std::vector<LayerSettings>&& layers,
+                                   const sp<GraphicBuffer>& buffer, const bool useFramebufferCache,
+                                   base::unique_fd&& bufferFence, DrawLayersCallback&& callback) {
+    base::unique_fd drawFence;
+    const status_t result = drawLayers(display, layers, buffer->getNativeBuffer(),
+                                       useFramebufferCache, std::move(bufferFence), &drawFence);
+    callback(result, std::move(drawFence));
+}
+
 } // namespace impl
 } // namespace renderengine
 } // namespace android
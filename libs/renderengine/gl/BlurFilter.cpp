@@ -0,0 +1,286 @@
+/*
+ * Copyright 2019 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#define ATRACE_TAG ATRACE_TAG_GRAPHICS
+
+#include "BlurFilter.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+#include <GLES2/gl2.h>
+#include <GLES2/gl2ext.h>
+#include <log/log.h>
+#include <renderengine/Mesh.h>
+#include <utils/Trace.h>
+#include "GLESRenderEngine.h"
+#include "Program.h"
+#include "ProgramCache.h"
+
+namespace android {
+namespace renderengine {
+namespace gl {
+
+namespace {
+
+// Draws a quad covering the whole viewport
+const char* const kFullscreenVertexShader = R"SHADER(
+attribute vec4 position;
+attribute vec2 texCoords;
+varying vec2 outTexCoords;
+void main(void) {
+    outTexCoords = texCoords;
+    gl_Position = position;
+}
+)SHADER";
+
+// One pass of a Kawase blur, which approximates a gaussian blur with a few
+// passes of 5 bilinear samples at growing offsets.
+const char* const kBlurFragmentShader = R"SHADER(
+precision mediump float;
+uniform sampler2D sampler;
+uniform vec2 offset;
+varying vec2 outTexCoords;
+void main(void) {
+    vec4 sum = texture2D(sampler, outTexCoords);
+    sum += texture2D(sampler, outTexCoords + vec2(offset.x, offset.y));
+    sum += texture2D(sampler, outTexCoords + vec2(offset.x, -offset.y));
+    sum += texture2D(sampler, outTexCoords + vec2(-offset.x, offset.y));
+    sum += texture2D(sampler, outTexCoords + vec2(-offset.x, -offset.y));
+    gl_FragColor = sum * 0.2;
+}
+)SHADER";
+
+const char* const kCopyFragmentShader = R"SHADER(
+precision mediump float;
+uniform sampler2D sampler;
+varying vec2 outTexCoords;
+void main(void) {
+    gl_FragColor = texture2D(sampler, outTexCoords);
+}
+)SHADER";
+
+// Draws a layer's geometry, with what's behind it in the output as its texture
+const char* const kMixVertexShader = R"SHADER(
+attribute vec4 position;
+uniform mat4 projection;
+void main(void) {
+    gl_Position = projection * position;
+}
+)SHADER";
+
+const char* const kMixFragmentShader = R"SHADER(
+precision mediump float;
+uniform sampler2D sampler;
+uniform highp vec2 invSize;
+void main(void) {
+    gl_FragColor = texture2D(sampler, gl_FragCoord.xy * invSize);
+}
+)SHADER";
+
+bool equals(const mat4& lhs, const mat4& rhs) {
+    return memcmp(lhs.asArray(), rhs.asArray(), sizeof(float) * 16) == 0;
+}
+
+bool equals(const DisplaySettings& lhs, const DisplaySettings& rhs) {
+    return lhs.physicalDisplay == rhs.physicalDisplay && lhs.clip == rhs.clip &&
+            equals(lhs.globalTransform, rhs.globalTransform) &&
+            lhs.maxLuminance == rhs.maxLuminance && lhs.outputDataspace == rhs.outputDataspace &&
+            equals(lhs.colorTransform, rhs.colorTransform) &&
+            lhs.clearRegion.hasSameRects(rhs.clearRegion) && lhs.orientation == rhs.orientation;
+}
+
+// A buffer is known to show the same content for as long as it comes with the
+// same acquire fence.
+bool equals(const LayerSettings& lhs, const LayerSettings& rhs) {
+    const Buffer& lhsBuffer = lhs.source.buffer;
+    const Buffer& rhsBuffer = rhs.source.buffer;
+    return lhs.geometry.boundaries == rhs.geometry.boundaries &&
+            equals(lhs.geometry.positionTransform, rhs.geometry.positionTransform) &&
+            lhs.geometry.roundedCornersRadius == rhs.geometry.roundedCornersRadius &&
+            lhs.geometry.roundedCornersCrop == rhs.geometry.roundedCornersCrop &&
+            lhsBuffer.buffer == rhsBuffer.buffer && lhsBuffer.fence == rhsBuffer.fence &&
+            lhsBuffer.useTextureFiltering == rhsBuffer.useTextureFiltering &&
+            equals(lhsBuffer.textureTransform, rhsBuffer.textureTransform) &&
+            lhsBuffer.usePremultipliedAlpha == rhsBuffer.usePremultipliedAlpha &&
+            lhsBuffer.isOpaque == rhsBuffer.isOpaque &&
+            lhsBuffer.isY410BT2020 == rhsBuffer.isY410BT2020 &&
+            lhs.source.solidColor == rhs.source.solidColor &&
+            float(lhs.alpha) == float(rhs.alpha) && lhs.sourceDataspace == rhs.sourceDataspace &&
+            equals(lhs.colorTransform, rhs.colorTransform) &&
+            lhs.disableBlending == rhs.disableBlending &&
+            lhs.backgroundBlurRadius == rhs.backgroundBlurRadius;
+}
+
+std::unique_ptr<Program> createProgram(const char* vertex, const char* fragment) {
+    auto program = std::make_unique<Program>(ProgramCache::Key(), vertex, fragment);
+    LOG_ALWAYS_FATAL_IF(!program->isValid(), "Failed to compile blur shaders");
+    return program;
+}
+
+} // namespace
+
+BlurFilter::BlurFilter(GLESRenderEngine& engine)
+      : mCompositionFbo(engine), mPingFbo(engine), mPongFbo(engine) {}
+
+BlurFilter::~BlurFilter() = default;
+
+bool BlurFilter::isCached(const DisplaySettings& display, const std::vector<LayerSettings>& layers,
+                          size_t blurIndex) const {
+    if (!mHasContent || mLayers.size() != blurIndex ||
+        mRadius != layers[blurIndex].backgroundBlurRadius || !equals(mDisplay, display)) {
+        return false;
+    }
+    return std::equal(mLayers.begin(), mLayers.end(), layers.begin(),
+                      [](const LayerSettings& lhs, const LayerSettings& rhs) {
+                          return equals(lhs, rhs);
+                      });
+}
+
+status_t BlurFilter::setAsDrawTarget(const DisplaySettings& display,
+                                     const std::vector<LayerSettings>& layers, size_t blurIndex,
+                                     uint32_t width, uint32_t height) {
+    ATRACE_CALL();
+    ensurePrograms();
+
+    if (mCompositionFbo.getBufferWidth() != static_cast<int32_t>(width) ||
+        mCompositionFbo.getBufferHeight() != static_cast<int32_t>(height)) {
+        const uint32_t scaledWidth = std::max(1u, static_cast<uint32_t>(width * kFboScale));
+        const uint32_t scaledHeight = std::max(1u, static_cast<uint32_t>(height * kFboScale));
+        mCompositionFbo.allocateBuffers(width, height);
+        mPingFbo.allocateBuffers(scaledWidth, scaledHeight);
+        mPongFbo.allocateBuffers(scaledWidth, scaledHeight);
+    }
+
+    for (GLFramebuffer* fbo : {&mPingFbo, &mPongFbo, &mCompositionFbo}) {
+        glBindFramebuffer(GL_FRAMEBUFFER, fbo->getFramebufferName());
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D,
+                               fbo->getTextureName(), 0);
+    }
+    // The composition framebuffer is left bound
+    const GLenum status = glCheckFramebufferStatus(GL_FRAMEBUFFER);
+    if (status != GL_FRAMEBUFFER_COMPLETE) {
+        ALOGE("Blur framebuffer is incomplete: %d", status);
+        clearContent();
+        return BAD_VALUE;
+    }
+
+    mHasContent = true;
+    mDisplay = display;
+    mLayers.assign(layers.begin(), layers.begin() + blurIndex);
+    mRadius = layers[blurIndex].backgroundBlurRadius;
+    return NO_ERROR;
+}
+
+void BlurFilter::prepare() {
+    ATRACE_CALL();
+    glDisable(GL_BLEND);
+
+    // The Kawase offsets grow with each pass, so the radius spreads over the
+    // passes, in steps small enough to still be smooth.
+    const float radius = mRadius / 6.0f;
+    const uint32_t passes = std::clamp(static_cast<uint32_t>(std::ceil(radius)), 1u, kMaxPasses);
+    const float radiusByPasses = radius / passes;
+    const float stepX = radiusByPasses / mCompositionFbo.getBufferWidth();
+    const float stepY = radiusByPasses / mCompositionFbo.getBufferHeight();
+
+    mBlurProgram->use();
+    glActiveTexture(GL_TEXTURE0);
+    glUniform1i(mBlurProgram->getUniform("sampler"), 0);
+    const GLint offsetLoc = mBlurProgram->getUniform("offset");
+
+    // The first pass downsamples while it blurs
+    glBindTexture(GL_TEXTURE_2D, mCompositionFbo.getTextureName());
+    glUniform2f(offsetLoc, stepX, stepY);
+    glViewport(0, 0, mPingFbo.getBufferWidth(), mPingFbo.getBufferHeight());
+    glBindFramebuffer(GL_FRAMEBUFFER, mPingFbo.getFramebufferName());
+    drawFullscreen();
+
+    GLFramebuffer* read = &mPingFbo;
+    GLFramebuffer* draw = &mPongFbo;
+    for (uint32_t i = 1; i < passes; i++) {
+        glBindFramebuffer(GL_FRAMEBUFFER, draw->getFramebufferName());
+        glBindTexture(GL_TEXTURE_2D, read->getTextureName());
+        glUniform2f(offsetLoc, stepX * (i + 1), stepY * (i + 1));
+        drawFullscreen();
+        std::swap(read, draw);
+    }
+    mLastDrawTarget = read;
+}
+
+void BlurFilter::render(const GLFramebuffer& target, const Rect& viewport, const mat4& projection,
+                        const Mesh& mesh) {
+    ATRACE_CALL();
+    glDisable(GL_BLEND);
+    glActiveTexture(GL_TEXTURE0);
+    glBindFramebuffer(GL_FRAMEBUFFER, target.getFramebufferName());
+
+    // What's outside of the blurring layer stays sharp
+    mCopyProgram->use();
+    glUniform1i(mCopyProgram->getUniform("sampler"), 0);
+    glBindTexture(GL_TEXTURE_2D, mCompositionFbo.getTextureName());
+    glViewport(0, 0, mCompositionFbo.getBufferWidth(), mCompositionFbo.getBufferHeight());
+    drawFullscreen();
+
+    // Both were rendered with the same viewport, so a pixel of the output maps
+    // to the same normalized coordinates in the blurred buffer.
+    glViewport(viewport.left, viewport.top, viewport.getWidth(), viewport.getHeight());
+    mMixProgram->use();
+    glUniform1i(mMixProgram->getUniform("sampler"), 0);
+    glUniformMatrix4fv(mMixProgram->getUniform("projection"), 1, GL_FALSE, projection.asArray());
+    glUniform2f(mMixProgram->getUniform("invSize"), 1.0f / mCompositionFbo.getBufferWidth(),
+                1.0f / mCompositionFbo.getBufferHeight());
+    glBindTexture(GL_TEXTURE_2D, mLastDrawTarget->getTextureName());
+    glDisableVertexAttribArray(Program::texCoords);
+    glDisableVertexAttribArray(Program::cropCoords);
+    glVertexAttribPointer(Program::position, mesh.getVertexSize(), GL_FLOAT, GL_FALSE,
+                          mesh.getByteStride(), mesh.getPositions());
+    glDrawArrays(mesh.getPrimitive(), 0, mesh.getVertexCount());
+
+    glBindTexture(GL_TEXTURE_2D, 0);
+}
+
+void BlurFilter::clearContent() {
+    mHasContent = false;
+    mLayers.clear();
+    mLastDrawTarget = nullptr;
+}
+
+void BlurFilter::ensurePrograms() {
+    if (mBlurProgram != nullptr) {
+        return;
+    }
+    ATRACE_CALL();
+    mBlurProgram = createProgram(kFullscreenVertexShader, kBlurFragmentShader);
+    mCopyProgram = createProgram(kFullscreenVertexShader, kCopyFragmentShader);
+    mMixProgram = createProgram(kMixVertexShader, kMixFragmentShader);
+}
+
+void BlurFilter::drawFullscreen() {
+    static constexpr float kPositions[] = {-1.0f, -1.0f, 1.0f, -1.0f, 1.0f, 1.0f, -1.0f, 1.0f};
+    static constexpr float kTexCoords[] = {0.0f, 0.0f, 1.0f, 0.0f, 1.0f, 1.0f, 0.0f, 1.0f};
+    glDisableVertexAttribArray(Program::cropCoords);
+    glEnableVertexAttribArray(Program::position);
+    glEnableVertexAttribArray(Program::texCoords);
+    glVertexAttribPointer(Program::position, 2, GL_FLOAT, GL_FALSE, 0, kPositions);
+    glVertexAttribPointer(Program::texCoords, 2, GL_FLOAT, GL_FALSE, 0, kTexCoords);
+    glDrawArrays(GL_TRIANGLE_FAN, 0, 4);
+}
+
+} // namespace gl
+} // namespace renderengine
+} // namespace android
@@ -0,0 +1,107 @@
+/*
+ * Copyright 2019 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include <math/mat4.h>
+#include <renderengine/DisplaySettings.h>
+#include <renderengine/LayerSettings.h>
+#include <ui/Rect.h>
+#include "GLFramebuffer.h"
+
+namespace android {
+namespace renderengine {
+
+class Mesh;
+
+namespace gl {
+
+class GLESRenderEngine;
+class Program;
+
+// Blurs the layers drawn beneath a layer with a background blur radius.
+//
+// Those layers are drawn at full resolution into an intermediate framebuffer,
+// which is blurred in a few passes over framebuffers at a fraction of the
+// resolution. The output gets the intermediate content, with the blurred
+// version of it inside the blurring layer. As long as the layers beneath stay
+// the same, the blurred result is reused as is.
+class BlurFilter {
+public:
+    // Resolution of the blur passes, relative to the output
+    static constexpr float kFboScale = 0.25f;
+    // Upper bound on the number of blur passes, whatever the radius
+    static constexpr uint32_t kMaxPasses = 6;
+
+    explicit BlurFilter(GLESRenderEngine& engine);
+    ~BlurFilter();
+
+    // Whether the blurred result for the layers beneath layers[blurIndex] is
+    // the one from the last frame, so they need not be drawn again.
+    bool isCached(const DisplaySettings& display, const std::vector<LayerSettings>& layers,
+                  size_t blurIndex) const;
+
+    // Binds the intermediate framebuffer, sized like the output, to draw the
+    // layers beneath layers[blurIndex] into.
+    status_t setAsDrawTarget(const DisplaySettings& display,
+                             const std::vector<LayerSettings>& layers, size_t blurIndex,
+                             uint32_t width, uint32_t height);
+
+    // Blurs what was drawn into the intermediate framebuffer
+    void prepare();
+
+    // Binds the output and draws the intermediate content into it, then the
+    // blurred version of it inside mesh, whose positions are transformed by
+    // projection.
+    void render(const GLFramebuffer& target, const Rect& viewport, const mat4& projection,
+                const Mesh& mesh);
+
+    // Forgets about the last content, e.g. when no layer is blurring. The
+    // framebuffers are kept for when blurring starts again.
+    void clearContent();
+
+private:
+    void ensurePrograms();
+    void drawFullscreen();
+
+    // Full resolution layers beneath the blur
+    GLFramebuffer mCompositionFbo;
+    // Reduced resolution buffers the blur passes alternate between
+    GLFramebuffer mPingFbo;
+    GLFramebuffer mPongFbo;
+    // Which of the two holds the result of the last pass
+    GLFramebuffer* mLastDrawTarget = nullptr;
+
+    // Compiled the first time something is blurred
+    std::unique_ptr<Program> mBlurProgram;
+    std::unique_ptr<Program> mCopyProgram;
+    std::unique_ptr<Program> mMixProgram;
+
+    // What the blurred result was made from. Holding on to the buffers and
+    // fences of the layers keeps later frames from reusing their addresses.
+    bool mHasContent = false;
+    DisplaySettings mDisplay;
+    std::vector<LayerSettings> mLayers;
+    int mRadius = 0;
+};
+
+} // namespace gl
+} // namespace renderengine
+} // namespace android
@@ -20,6 +20,7 @@
 #define ATRACE_TAG ATRACE_TAG_GRAPHICS
 
 #include <sched.h>
+#include <algorithm>
 #include <cmath>
 #include <fstream>
 #include <sstream>
@@ -31,6 +32,7 @@
 #include <cutils/compiler.h>
 #include <cutils/properties.h>
 #include <gui/DebugEGLImageTracker.h>
+#include <private/EGL/cache.h>
 #include <renderengine/Mesh.h>
 #include <renderengine/Texture.h>
 #include <renderengine/private/Description.h>
@@ -38,10 +40,12 @@
 #include <ui/ColorSpace.h>
 #include <ui/DebugUtils.h>
 #include <ui/GraphicBuffer.h>
+#include <ui/PixelFormat.h>
 #include <ui/Rect.h>
 #include <ui/Region.h>
 #include <utils/KeyedVector.h>
 #include <utils/Trace.h>
+#include "BlurFilter.h"
 #include "GLESRenderEngine.h"
 #include "GLExtensions.h"
 #include "GLFramebuffer.h"
@@ -229,6 +233,15 @@ static status_t selectEGLConfig(EGLDisplay display, EGLint format, EGLint render
 
 std::unique_ptr<GLESRenderEngine> GLESRenderEngine::create(int hwcFormat, uint32_t featureFlags,
                                                            uint32_t imageCacheSize) {
+    // The blob cache file has to be set before EGL first uses it
+    char cacheDir[PROPERTY_VALUE_MAX];
+    property_get(PROPERTY_DEBUG_RENDERENGINE_SHADER_CACHE_DIR, cacheDir, "");
+    if (cacheDir[0] != '\0') {
+        const std::string dir(cacheDir);
+        egl_set_cache_filename((dir + "/renderengine_blobs").c_str());
+        ProgramCache::getInstance().setPersistedKeysFile(dir + "/renderengine_keys");
+    }
+
     // initialize EGL for the default display
     EGLDisplay display = eglGetDisplay(EGL_DEFAULT_DISPLAY);
     if (!eglInitialize(display, nullptr, nullptr)) {
@@ -360,7 +373,10 @@ GLESRenderEngine::GLESRenderEngine(uint32_t featureFlags, EGLDisplay display, EG
         mVpWidth(0),
         mVpHeight(0),
         mFramebufferImageCacheSize(imageCacheSize),
-        mUseColorManagement(featureFlags & USE_COLOR_MANAGEMENT) {
+        mUseColorManagement(featureFlags & USE_COLOR_MANAGEMENT),
+        mUnpinnedImageBudget(
+                size_t(property_get_int32(PROPERTY_DEBUG_RENDERENGINE_PREFETCH_BUDGET_MB, 64)) *
+                1024 * 1024) {
     glGetIntegerv(GL_MAX_TEXTURE_SIZE, &mMaxTextureSize);
     glGetIntegerv(GL_MAX_VIEWPORT_DIMS, mMaxViewportDims);
 
@@ -425,6 +441,7 @@ GLESRenderEngine::GLESRenderEngine(uint32_t featureFlags, EGLDisplay display, EG
     }
     mImageManager = std::make_unique<ImageManager>(this);
     mDrawingBuffer = createFramebuffer();
+    mBlurFilter = std::make_unique<BlurFilter>(*this);
 }
 
 GLESRenderEngine::~GLESRenderEngine() {
@@ -433,6 +450,7 @@ GLESRenderEngine::~GLESRenderEngine() {
     std::lock_guard<std::mutex> lock(mRenderingMutex);
     unbindFrameBuffer(mDrawingBuffer.get());
     mDrawingBuffer = nullptr;
+    mBlurFilter = nullptr;
     while (!mFramebufferImageCache.empty()) {
         EGLImageKHR expired = mFramebufferImageCache.front().second;
         mFramebufferImageCache.pop_front();
@@ -633,6 +651,12 @@ status_t GLESRenderEngine::bindExternalTextureBuffer(uint32_t texName,
         std::lock_guard<std::mutex> lock(mRenderingMutex);
         auto cachedImage = mImageCache.find(buffer->getId());
         found = (cachedImage != mImageCache.end());
+        if (found) {
+            touchUnpinnedImageLocked(buffer->getId());
+        }
+        // Prefetches on the image manager thread must not evict the image
+        // until it's bound, including one created below.
+        mBindingImages.insert(buffer->getId());
     }
 
     // If we couldn't find the image in the cache at this time, then either
@@ -641,6 +665,8 @@ status_t GLESRenderEngine::bindExternalTextureBuffer(uint32_t texName,
     if (!found) {
         status_t cacheResult = mImageManager->cache(buffer);
         if (cacheResult != NO_ERROR) {
+            std::lock_guard<std::mutex> lock(mRenderingMutex);
+            mBindingImages.erase(mBindingImages.find(buffer->getId()));
             return cacheResult;
         }
     }
@@ -652,6 +678,7 @@ status_t GLESRenderEngine::bindExternalTextureBuffer(uint32_t texName,
     // terrible went wrong and we should just bind something and move on.
     {
         std::lock_guard<std::mutex> lock(mRenderingMutex);
+        mBindingImages.erase(mBindingImages.find(buffer->getId()));
         auto cachedImage = mImageCache.find(buffer->getId());
 
         if (cachedImage == mImageCache.end()) {
@@ -677,6 +704,7 @@ status_t GLESRenderEngine::bindExternalTextureBuffer(uint32_t texName,
                 return UNKNOWN_ERROR;
             }
         } else {
+            mBlockingWaitCount++;
             status_t err = bufferFence->waitForever("RenderEngine::bindExternalTextureBuffer");
             if (err != NO_ERROR) {
                 ALOGE("error waiting for fence: %d", err);
@@ -699,7 +727,41 @@ std::shared_ptr<ImageManager::Barrier> GLESRenderEngine::cacheExternalTextureBuf
     return barrier;
 }
 
-status_t GLESRenderEngine::cacheExternalTextureBufferInternal(const sp<GraphicBuffer>& buffer) {
+void GLESRenderEngine::prefetchExternalTextureBuffer(const sp<GraphicBuffer>& buffer) {
+    mImageManager->prefetchAsync(buffer, nullptr);
+}
+
+std::shared_ptr<ImageManager::Barrier> GLESRenderEngine::prefetchExternalTextureBufferForTesting(
+        const sp<GraphicBuffer>& buffer) {
+    auto barrier = std::make_shared<ImageManager::Barrier>();
+    mImageManager->prefetchAsync(buffer, barrier);
+    return barrier;
+}
+
+void GLESRenderEngine::setUnpinnedImageBudgetForTesting(size_t bytes) {
+    std::lock_guard<std::mutex> lock(mRenderingMutex);
+    mUnpinnedImageBudget = bytes;
+}
+
+void GLESRenderEngine::touchUnpinnedImageLocked(uint64_t bufferId) {
+    const auto unpinned = mUnpinnedImages.find(bufferId);
+    if (unpinned != mUnpinnedImages.end()) {
+        mUnpinnedImageLru.splice(mUnpinnedImageLru.end(), mUnpinnedImageLru,
+                                 unpinned->second.lruPosition);
+    }
+}
+
+void GLESRenderEngine::removeUnpinnedImageLocked(uint64_t bufferId) {
+    const auto unpinned = mUnpinnedImages.find(bufferId);
+    if (unpinned != mUnpinnedImages.end()) {
+        mUnpinnedImageLru.erase(unpinned->second.lruPosition);
+        mUnpinnedImageBytes -= unpinned->second.bytes;
+        mUnpinnedImages.erase(unpinned);
+    }
+}
+
+status_t GLESRenderEngine::cacheExternalTextureBufferInternal(const sp<GraphicBuffer>& buffer,
+                                                              bool pinned) {
     if (buffer == nullptr) {
         return BAD_VALUE;
     }
@@ -707,7 +769,13 @@ status_t GLESRenderEngine::cacheExternalTextureBufferInternal(const sp<GraphicBu
     {
         std::lock_guard<std::mutex> lock(mRenderingMutex);
         if (mImageCache.count(buffer->getId()) > 0) {
-            // If there's already an image then fail fast here.
+            // If there's already an image then fail fast here, after making
+            // sure it's kept if it's now wanted.
+            if (pinned) {
+                removeUnpinnedImageLocked(buffer->getId());
+            } else {
+                touchUnpinnedImageLocked(buffer->getId());
+            }
             return NO_ERROR;
         }
     }
@@ -725,14 +793,47 @@ status_t GLESRenderEngine::cacheExternalTextureBufferInternal(const sp<GraphicBu
         return NO_INIT;
     }
 
+    // Destroyed without holding the lock, like the new image would be
+    std::vector<std::unique_ptr<Image>> evictedImages;
     {
         std::lock_guard<std::mutex> lock(mRenderingMutex);
         if (mImageCache.count(buffer->getId()) > 0) {
             // In theory it's possible for another thread to recache the image,
             // so bail out if another thread won.
+            if (pinned) {
+                removeUnpinnedImageLocked(buffer->getId());
+            }
             return NO_ERROR;
         }
         mImageCache.insert(std::make_pair(buffer->getId(), std::move(newImage)));
+
+        if (!pinned) {
+            // The image holds on to the buffer, so that's what it costs.
+            // Formats without a fixed pixel size, i.e. YUV, count as 12 bits.
+            const uint32_t bitsPerPixel = android::bitsPerPixel(buffer->getPixelFormat());
+            const size_t bytes = size_t(buffer->getStride()) * buffer->getHeight() *
+                    (bitsPerPixel != 0 ? bitsPerPixel : 12) / 8;
+            mUnpinnedImageLru.push_back(buffer->getId());
+            mUnpinnedImages.emplace(buffer->getId(),
+                                    UnpinnedImage{std::prev(mUnpinnedImageLru.end()), bytes});
+            mUnpinnedImageBytes += bytes;
+
+            // Never evict the image just created, it's about to be used, nor
+            // the ones being bound
+            const auto newest = std::prev(mUnpinnedImageLru.end());
+            for (auto it = mUnpinnedImageLru.begin();
+                 mUnpinnedImageBytes > mUnpinnedImageBudget && it != newest;) {
+                const uint64_t evictedId = *it++;
+                if (mBindingImages.count(evictedId) > 0) {
+                    continue;
+                }
+                ALOGV("Evicting image for buffer: %" PRIu64, evictedId);
+                removeUnpinnedImageLocked(evictedId);
+                const auto evicted = mImageCache.find(evictedId);
+                evictedImages.push_back(std::move(evicted->second));
+                mImageCache.erase(evicted);
+            }
+        }
     }
 
     return NO_ERROR;
@@ -761,6 +862,7 @@ void GLESRenderEngine::unbindExternalTextureBufferInternal(uint64_t bufferId) {
             // without holding the cache's lock.
             image = std::move(cachedImage->second);
             mImageCache.erase(bufferId);
+            removeUnpinnedImageLocked(bufferId);
             return;
         }
     }
@@ -822,21 +924,83 @@ void GLESRenderEngine::handleRoundedCorners(const DisplaySettings& display,
 
     // Finally, we cut the layer into 3 parts, with top and bottom parts having rounded corners
     // and the middle part without rounded corners.
+    // When only part of the output is redrawn, so are the parts of the layer.
+    auto setPartScissor = [this](const Rect& part) {
+        Rect scissor = part;
+        if (mDamageScissor.isValid() && !part.intersect(mDamageScissor, &scissor)) {
+            scissor = Rect::EMPTY_RECT;
+        }
+        setScissor(scissor);
+    };
     const int32_t radius = ceil(layer.geometry.roundedCornersRadius);
     const Rect topRect(bounds.left, bounds.top, bounds.right, bounds.top + radius);
-    setScissor(topRect);
+    setPartScissor(topRect);
     drawMesh(mesh);
     const Rect bottomRect(bounds.left, bounds.bottom - radius, bounds.right, bounds.bottom);
-    setScissor(bottomRect);
+    setPartScissor(bottomRect);
     drawMesh(mesh);
 
     // The middle part of the layer can turn off blending.
     const Rect middleRect(bounds.left, bounds.top + radius, bounds.right, bounds.bottom - radius);
-    setScissor(middleRect);
+    setPartScissor(middleRect);
     mState.cornerRadius = 0.0;
     disableBlending();
     drawMesh(mesh);
-    disableScissor();
+    if (mDamageScissor.isValid()) {
+        setScissor(mDamageScissor);
+    } else {
+        disableScissor();
+    }
+}
+
+bool GLESRenderEngine::canBatchLayer(const LayerSettings& batch, const LayerSettings& layer) {
+    // Positions are transformed up front, which only works for 2D transforms
+    const mat4& transform = layer.geometry.positionTransform;
+    const bool isAffine = transform[0][3] == 0.0f && transform[1][3] == 0.0f &&
+            transform[2][3] == 0.0f && transform[3][3] == 1.0f;
+    return layer.source.buffer.buffer == nullptr && layer.geometry.roundedCornersRadius == 0.0f &&
+            isAffine && layer.source.solidColor == batch.source.solidColor &&
+            layer.alpha == batch.alpha && layer.colorTransform == batch.colorTransform &&
+            layer.sourceDataspace == batch.sourceDataspace &&
+            layer.disableBlending == batch.disableBlending;
+}
+
+void GLESRenderEngine::drawLayerBatch(const DisplaySettings& display,
+                                      const std::vector<LayerSettings>& layers, size_t begin,
+                                      size_t end, const mat4& projectionMatrix) {
+    ATRACE_CALL();
+    const LayerSettings& batch = layers[begin];
+    mState.projectionMatrix = projectionMatrix;
+
+    // Two triangles per layer, in display space
+    Mesh mesh(Mesh::TRIANGLES, (end - begin) * 6, 2);
+    Mesh::VertexArray<vec2> position(mesh.getPositionArray<vec2>());
+    size_t vertex = 0;
+    for (size_t i = begin; i < end; i++) {
+        const mat4& transform = layers[i].geometry.positionTransform;
+        const FloatRect& bounds = layers[i].geometry.boundaries;
+        const vec2 leftTop = (transform * vec4(bounds.left, bounds.top, 0.0f, 1.0f)).xy;
+        const vec2 leftBottom = (transform * vec4(bounds.left, bounds.bottom, 0.0f, 1.0f)).xy;
+        const vec2 rightBottom = (transform * vec4(bounds.right, bounds.bottom, 0.0f, 1.0f)).xy;
+        const vec2 rightTop = (transform * vec4(bounds.right, bounds.top, 0.0f, 1.0f)).xy;
+        position[vertex++] = leftTop;
+        position[vertex++] = leftBottom;
+        position[vertex++] = rightBottom;
+        position[vertex++] = leftTop;
+        position[vertex++] = rightBottom;
+        position[vertex++] = rightTop;
+    }
+
+    setColorTransform(display.colorTransform * batch.colorTransform);
+    const half3 solidColor = batch.source.solidColor;
+    setupLayerBlending(/*premultipliedAlpha=*/true, /*opaque=*/false, /*disableTexture=*/true,
+                       half4(solidColor.r, solidColor.g, solidColor.b, batch.alpha),
+                       /*cornerRadius=*/0.0f);
+    if (batch.disableBlending) {
+        glDisable(GL_BLEND);
+    }
+    setSourceDataSpace(batch.sourceDataspace);
+    drawMesh(mesh);
 }
 
 status_t GLESRenderEngine::bindFrameBuffer(Framebuffer* framebuffer) {
@@ -846,9 +1010,12 @@ status_t GLESRenderEngine::bindFrameBuffer(Framebuffer* framebuffer) {
     uint32_t textureName = glFramebuffer->getTextureName();
     uint32_t framebufferName = glFramebuffer->getFramebufferName();
 
-    // Bind the texture and turn our EGLImage into a texture
-    glBindTexture(GL_TEXTURE_2D, textureName);
-    glEGLImageTargetTexture2DOES(GL_TEXTURE_2D, (GLeglImageOES)eglImage);
+    // Bind the texture and turn our EGLImage into a texture, unless the
+    // framebuffer has storage of its own
+    if (eglImage != EGL_NO_IMAGE_KHR) {
+        glBindTexture(GL_TEXTURE_2D, textureName);
+        glEGLImageTargetTexture2DOES(GL_TEXTURE_2D, (GLeglImageOES)eglImage);
+    }
 
     // Bind the Framebuffer to render into
     glBindFramebuffer(GL_FRAMEBUFFER, framebufferName);
@@ -948,6 +1115,7 @@ status_t GLESRenderEngine::drawLayers(const DisplaySettings& display,
 
     if (bufferFence.get() >= 0 && !waitFence(std::move(bufferFence))) {
         ATRACE_NAME("Waiting before draw");
+        mBlockingWaitCount++;
         sync_wait(bufferFence.get(), -1);
     }
 
@@ -965,12 +1133,53 @@ status_t GLESRenderEngine::drawLayers(const DisplaySettings& display,
         return fbo.getStatus();
     }
 
+    // Only the topmost layer blurring its background gets it, everything
+    // beneath it is blurred anyway. The blur buffers aren't protected.
+    GLFramebuffer* const target = static_cast<GLFramebuffer*>(getFramebufferForDrawing());
+    const auto blurLayer =
+            std::find_if(layers.rbegin(), layers.rend(),
+                         [](const LayerSettings& layer) { return layer.backgroundBlurRadius > 0; });
+    size_t blurIndex = layers.size();
+    bool blurCached = false;
+    if (blurLayer != layers.rend() && !mInProtectedContext) {
+        blurIndex = std::distance(blurLayer, layers.rend()) - 1;
+        blurCached = mBlurFilter->isCached(display, layers, blurIndex);
+        if (!blurCached &&
+            mBlurFilter->setAsDrawTarget(display, layers, blurIndex, target->getBufferWidth(),
+                                         target->getBufferHeight()) != NO_ERROR) {
+            ALOGE("Failed to set up background blur, drawing without it");
+            glBindFramebuffer(GL_FRAMEBUFFER, target->getFramebufferName());
+            blurIndex = layers.size();
+        }
+    } else {
+        mBlurFilter->clearContent();
+    }
+
+    // Only redraw what changed since the buffer was last drawn into. Blurs
+    // sample around what's redrawn, so they need everything.
+    mDamageScissor = Rect::INVALID_RECT;
+    if (!display.damageRegion.isEmpty() && blurIndex == layers.size()) {
+        Rect bufferBounds(target->getBufferWidth(), target->getBufferHeight());
+        display.damageRegion.getBounds().intersect(bufferBounds, &mDamageScissor);
+        if (mDamageScissor == bufferBounds) {
+            mDamageScissor = Rect::INVALID_RECT;
+        }
+    }
+    if (mDamageScissor.isValid()) {
+        ATRACE_NAME("Partial redraw");
+        setScissor(mDamageScissor);
+    }
+
     // clear the entire buffer, sometimes when we reuse buffers we'd persist
     // ghost images otherwise.
     // we also require a full transparent framebuffer for overlays. This is
     // probably not quite efficient on all GPUs, since we could filter out
     // opaque layers.
-    clearWithColor(0.0, 0.0, 0.0, 0.0);
+    // When blurring from the last frame's layers, drawing them again covers
+    // all of the buffer anyway.
+    if (!blurCached) {
+        clearWithColor(0.0, 0.0, 0.0, 0.0);
+    }
 
     setViewportAndProjection(display.physicalDisplay, display.clip);
 
@@ -979,13 +1188,14 @@ status_t GLESRenderEngine::drawLayers(const DisplaySettings& display,
 
     mat4 projectionMatrix = mState.projectionMatrix * display.globalTransform;
     mState.projectionMatrix = projectionMatrix;
-    if (!display.clearRegion.isEmpty()) {
+    if (!display.clearRegion.isEmpty() && !blurCached) {
         glDisable(GL_BLEND);
         fillRegionWithColor(display.clearRegion, 0.0, 0.0, 0.0, 1.0);
     }
 
     Mesh mesh(Mesh::TRIANGLE_FAN, 4, 2, 2);
-    for (auto layer : layers) {
+    for (size_t i = blurCached ? blurIndex : 0; i < layers.size(); i++) {
+        const LayerSettings& layer = layers[i];
         mState.projectionMatrix = projectionMatrix * layer.geometry.positionTransform;
 
         const FloatRect bounds = layer.geometry.boundaries;
@@ -998,6 +1208,30 @@ status_t GLESRenderEngine::drawLayers(const DisplaySettings& display,
         setupLayerCropping(layer, mesh);
         setColorTransform(display.colorTransform * layer.colorTransform);
 
+        if (i == blurIndex) {
+            // Everything beneath is in the blur's framebuffer, what's left
+            // goes to the output.
+            if (!blurCached) {
+                mBlurFilter->prepare();
+            }
+            mBlurFilter->render(*target, display.physicalDisplay, mState.projectionMatrix, mesh);
+        }
+
+        // Client composition for many layers is often mostly dim and clearing
+        // layers, so all the state setup for each of those adds up.
+        size_t batchEnd = i + 1;
+        if (canBatchLayer(layer, layer)) {
+            while (batchEnd < layers.size() && batchEnd != blurIndex &&
+                   canBatchLayer(layer, layers[batchEnd])) {
+                batchEnd++;
+            }
+        }
+        if (batchEnd > i + 1) {
+            drawLayerBatch(display, layers, i, batchEnd, projectionMatrix);
+            i = batchEnd - 1;
+            continue;
+        }
+
         bool usePremultipliedAlpha = true;
         bool disableTexture = true;
         bool isOpaque = false;
@@ -1056,12 +1290,18 @@ status_t GLESRenderEngine::drawLayers(const DisplaySettings& display,
         }
     }
 
+    if (mDamageScissor.isValid()) {
+        disableScissor();
+        mDamageScissor = Rect::INVALID_RECT;
+    }
+
     if (drawFence != nullptr) {
         *drawFence = flush();
     }
     // If flush failed or we don't support native fences, we need to force the
     // gl command stream to be executed.
     if (drawFence == nullptr || drawFence->get() < 0) {
+        mBlockingWaitCount++;
         bool success = finish();
         if (!success) {
             ALOGE("Failed to flush RenderEngine commands");
@@ -1362,6 +1602,7 @@ void GLESRenderEngine::dump(std::string& result) {
     StringAppendF(&result, "RenderEngine supports protected context: %d\n",
                   supportsProtectedContent());
     StringAppendF(&result, "RenderEngine is in protected context: %d\n", mInProtectedContext);
+    StringAppendF(&result, "RenderEngine blocking fence waits: %" PRIu32 "\n", mBlockingWaitCount);
     StringAppendF(&result, "RenderEngine program cache size for unprotected context: %zu\n",
                   cache.getSize(mEGLContext));
     StringAppendF(&result, "RenderEngine program cache size for protected context: %zu\n",
@@ -1372,6 +1613,9 @@ void GLESRenderEngine::dump(std::string& result) {
     {
         std::lock_guard<std::mutex> lock(mRenderingMutex);
         StringAppendF(&result, "RenderEngine image cache size: %zu\n", mImageCache.size());
+        StringAppendF(&result, "RenderEngine unpinned images: %zu (%zu of %zu KB)\n",
+                      mUnpinnedImages.size(), mUnpinnedImageBytes / 1024,
+                      mUnpinnedImageBudget / 1024);
         StringAppendF(&result, "Dumping buffer ids...\n");
         for (const auto& [id, unused] : mImageCache) {
             StringAppendF(&result, "0x%" PRIx64 "\n", id);
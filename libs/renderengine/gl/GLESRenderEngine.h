@@ -20,10 +20,12 @@
 #include <stdint.h>
 #include <condition_variable>
 #include <deque>
+#include <list>
 #include <mutex>
 #include <queue>
 #include <thread>
 #include <unordered_map>
+#include <unordered_set>
 
 #include <EGL/egl.h>
 #include <EGL/eglext.h>
@@ -45,6 +47,7 @@ class Texture;
 
 namespace gl {
 
+class BlurFilter;
 class GLImage;
 
 class GLESRenderEngine : public impl::RenderEngine {
@@ -67,6 +70,7 @@ public:
     base::unique_fd flush() override;
     bool finish() override;
     bool waitFence(base::unique_fd fenceFd) override;
+    uint32_t getBlockingWaitCount() const override { return mBlockingWaitCount; }
     void clearWithColor(float red, float green, float blue, float alpha) override;
     void fillRegionWithColor(const Region& region, float red, float green, float blue,
                              float alpha) override;
@@ -76,6 +80,7 @@ public:
     status_t bindExternalTextureBuffer(uint32_t texName, const sp<GraphicBuffer>& buffer,
                                        const sp<Fence>& fence) EXCLUDES(mRenderingMutex);
     void cacheExternalTextureBuffer(const sp<GraphicBuffer>& buffer) EXCLUDES(mRenderingMutex);
+    void prefetchExternalTextureBuffer(const sp<GraphicBuffer>& buffer) EXCLUDES(mRenderingMutex);
     void unbindExternalTextureBuffer(uint64_t bufferId) EXCLUDES(mRenderingMutex);
     status_t bindFrameBuffer(Framebuffer* framebuffer) override;
     void unbindFrameBuffer(Framebuffer* framebuffer) override;
@@ -107,6 +112,9 @@ public:
     std::shared_ptr<ImageManager::Barrier> cacheExternalTextureBufferForTesting(
             const sp<GraphicBuffer>& buffer);
     std::shared_ptr<ImageManager::Barrier> unbindExternalTextureBufferForTesting(uint64_t bufferId);
+    std::shared_ptr<ImageManager::Barrier> prefetchExternalTextureBufferForTesting(
+            const sp<GraphicBuffer>& buffer);
+    void setUnpinnedImageBudgetForTesting(size_t bytes) EXCLUDES(mRenderingMutex);
 
 protected:
     Framebuffer* getFramebufferForDrawing() override;
@@ -153,8 +161,14 @@ private:
     void setScissor(const Rect& region);
     void disableScissor();
     bool waitSync(EGLSyncKHR sync, EGLint flags);
-    status_t cacheExternalTextureBufferInternal(const sp<GraphicBuffer>& buffer)
+    // Unpinned images are evicted once they are the least recently used ones
+    // beyond the unpinned image budget.
+    status_t cacheExternalTextureBufferInternal(const sp<GraphicBuffer>& buffer, bool pinned)
             EXCLUDES(mRenderingMutex);
+    // Marks an unpinned image as the most recently used one
+    void touchUnpinnedImageLocked(uint64_t bufferId) REQUIRES(mRenderingMutex);
+    // Forgets about an image being unpinned, if it was
+    void removeUnpinnedImageLocked(uint64_t bufferId) REQUIRES(mRenderingMutex);
     void unbindExternalTextureBufferInternal(uint64_t bufferId) EXCLUDES(mRenderingMutex);
 
     // A data space is considered HDR data space if it has BT2020 color space
@@ -176,6 +190,12 @@ private:
     // blending is an expensive operation, we want to turn off blending when it's not necessary.
     void handleRoundedCorners(const DisplaySettings& display, const LayerSettings& layer,
                               const Mesh& mesh);
+    // Whether layer can be drawn along with the solid color layers from batch,
+    // in a single draw call. Only their geometry may differ.
+    static bool canBatchLayer(const LayerSettings& batch, const LayerSettings& layer);
+    // Draws layers [begin, end), which can all be batched, with one draw call.
+    void drawLayerBatch(const DisplaySettings& display, const std::vector<LayerSettings>& layers,
+                        size_t begin, size_t end, const mat4& projectionMatrix);
 
     EGLDisplay mEGLDisplay;
     EGLConfig mEGLConfig;
@@ -206,6 +226,8 @@ private:
     bool mInProtectedContext = false;
     // If set to true, then enables tracing flush() and finish() to systrace.
     bool mTraceGpuCompletion = false;
+    // Number of CPU waits on fences and on finish() in place of fences
+    uint32_t mBlockingWaitCount = 0;
     // Maximum size of mFramebufferImageCache. If more images would be cached, then (approximately)
     // the last recently used buffer should be kicked out.
     uint32_t mFramebufferImageCacheSize = 0;
@@ -229,6 +251,18 @@ private:
 
     // Cache of GL images that we'll store per GraphicBuffer ID
     std::unordered_map<uint64_t, std::unique_ptr<Image>> mImageCache GUARDED_BY(mRenderingMutex);
+    // Images in mImageCache which were prefetched or created while binding,
+    // rather than cached by the caller, least recently used first
+    struct UnpinnedImage {
+        std::list<uint64_t>::iterator lruPosition;
+        size_t bytes;
+    };
+    std::list<uint64_t> mUnpinnedImageLru GUARDED_BY(mRenderingMutex);
+    std::unordered_map<uint64_t, UnpinnedImage> mUnpinnedImages GUARDED_BY(mRenderingMutex);
+    size_t mUnpinnedImageBytes GUARDED_BY(mRenderingMutex) = 0;
+    size_t mUnpinnedImageBudget GUARDED_BY(mRenderingMutex);
+    // Buffers bindExternalTextureBuffer is binding, whose images aren't evicted
+    std::unordered_multiset<uint64_t> mBindingImages GUARDED_BY(mRenderingMutex);
     // Mutex guarding rendering operations, so that:
     // 1. GL operations aren't interleaved, and
     // 2. Internal state related to rendering that is potentially modified by
@@ -236,6 +270,10 @@ private:
     std::mutex mRenderingMutex;
 
     std::unique_ptr<Framebuffer> mDrawingBuffer;
+    std::unique_ptr<BlurFilter> mBlurFilter;
+    // What drawLayers is limited to when redrawing only the damage, or
+    // invalid when it redraws everything
+    Rect mDamageScissor = Rect::INVALID_RECT;
 
     class FlushTracer {
     public:
@@ -67,13 +67,32 @@ void ImageManager::cacheAsync(const sp<GraphicBuffer>& buffer,
 status_t ImageManager::cache(const sp<GraphicBuffer>& buffer) {
     ATRACE_CALL();
     auto barrier = std::make_shared<Barrier>();
-    cacheAsync(buffer, barrier);
+    // Nobody registered the buffer, so nobody will unbind it either
+    prefetchAsync(buffer, barrier);
     std::lock_guard<std::mutex> lock(barrier->mutex);
     barrier->condition.wait(barrier->mutex,
                             [&]() REQUIRES(barrier->mutex) { return barrier->isOpen; });
     return barrier->result;
 }
 
+void ImageManager::prefetchAsync(const sp<GraphicBuffer>& buffer,
+                                 const std::shared_ptr<Barrier>& barrier) {
+    if (buffer == nullptr) {
+        if (barrier != nullptr) {
+            {
+                std::lock_guard<std::mutex> lock(barrier->mutex);
+                barrier->isOpen = true;
+                barrier->result = BAD_VALUE;
+            }
+            barrier->condition.notify_one();
+        }
+        return;
+    }
+    ATRACE_CALL();
+    QueueEntry entry = {QueueEntry::Operation::Prefetch, buffer, buffer->getId(), barrier};
+    queueOperation(std::move(entry));
+}
+
 void ImageManager::releaseAsync(uint64_t bufferId, const std::shared_ptr<Barrier>& barrier) {
     ATRACE_CALL();
     QueueEntry entry = {QueueEntry::Operation::Delete, nullptr, bufferId, barrier};
@@ -121,7 +140,12 @@ void ImageManager::threadMain() {
                 mEngine->unbindExternalTextureBufferInternal(entry.bufferId);
                 break;
             case QueueEntry::Operation::Insert:
-                result = mEngine->cacheExternalTextureBufferInternal(entry.buffer);
+                result = mEngine->cacheExternalTextureBufferInternal(entry.buffer,
+                                                                     /*pinned*/ true);
+                break;
+            case QueueEntry::Operation::Prefetch:
+                result = mEngine->cacheExternalTextureBufferInternal(entry.buffer,
+                                                                     /*pinned*/ false);
                 break;
         }
         if (entry.barrier != nullptr) {
@@ -41,12 +41,16 @@ public:
     ~ImageManager();
     void cacheAsync(const sp<GraphicBuffer>& buffer, const std::shared_ptr<Barrier>& barrier)
             EXCLUDES(mMutex);
+    // Synchronously caches an image which may be evicted once unused
     status_t cache(const sp<GraphicBuffer>& buffer);
+    // Like cacheAsync, but the image may be evicted once unused
+    void prefetchAsync(const sp<GraphicBuffer>& buffer, const std::shared_ptr<Barrier>& barrier)
+            EXCLUDES(mMutex);
     void releaseAsync(uint64_t bufferId, const std::shared_ptr<Barrier>& barrier) EXCLUDES(mMutex);
 
 private:
     struct QueueEntry {
-        enum class Operation { Delete, Insert };
+        enum class Operation { Delete, Insert, Prefetch };
 
         Operation op = Operation::Delete;
         sp<GraphicBuffer> buffer = nullptr;
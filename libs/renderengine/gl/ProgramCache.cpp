@@ -18,8 +18,13 @@
 
 #include "ProgramCache.h"
 
+#include <fcntl.h>
+#include <string.h>
+
 #include <GLES2/gl2.h>
 #include <GLES2/gl2ext.h>
+#include <android-base/file.h>
+#include <android-base/unique_fd.h>
 #include <log/log.h>
 #include <renderengine/private/Description.h>
 #include <utils/String8.h>
@@ -77,26 +82,44 @@ Formatter& dedent(Formatter& f) {
     return f;
 }
 
+bool ProgramCache::primeKey(std::unordered_map<Key, std::unique_ptr<Program>, Key::Hash>& cache,
+                            const Key& key) {
+    if (cache.count(key) != 0) {
+        return false;
+    }
+    cache.emplace(key, generateProgram(key));
+    return true;
+}
+
 void ProgramCache::primeCache(EGLContext context, bool useColorManagement) {
     auto& cache = mCaches[context];
     uint32_t shaderCount = 0;
+    nsecs_t timeBefore = systemTime();
+
+    if (!mKeysToPrime.empty()) {
+        // What was used before is what will be used again
+        for (const Key& shaderKey : mKeysToPrime) {
+            shaderCount += primeKey(cache, shaderKey);
+        }
+        nsecs_t timeAfter = systemTime();
+        float compileTimeMs = static_cast<float>(timeAfter - timeBefore) / 1.0E6;
+        ALOGD("shader cache generated from %zu persisted keys - %u shaders in %f ms\n",
+              mKeysToPrime.size(), shaderCount, compileTimeMs);
+        return;
+    }
+
     uint32_t keyMask = Key::BLEND_MASK | Key::OPACITY_MASK | Key::ALPHA_MASK | Key::TEXTURE_MASK
         | Key::ROUNDED_CORNERS_MASK;
     // Prime the cache for all combinations of the above masks,
     // leaving off the experimental color matrix mask options.
 
-    nsecs_t timeBefore = systemTime();
     for (uint32_t keyVal = 0; keyVal <= keyMask; keyVal++) {
         Key shaderKey;
         shaderKey.set(keyMask, keyVal);
-        uint32_t tex = shaderKey.getTextureTarget();
-        if (tex != Key::TEXTURE_OFF && tex != Key::TEXTURE_EXT && tex != Key::TEXTURE_2D) {
+        if (!shaderKey.isValid()) {
             continue;
         }
-        if (cache.count(shaderKey) == 0) {
-            cache.emplace(shaderKey, generateProgram(shaderKey));
-            shaderCount++;
-        }
+        shaderCount += primeKey(cache, shaderKey);
     }
 
     // Prime for sRGB->P3 conversion
@@ -117,10 +140,7 @@ void ProgramCache::primeCache(EGLContext context, bool useColorManagement) {
 
             // Cache texture off option for window transition
             shaderKey.set(Key::TEXTURE_MASK, (i & 8) ? Key::TEXTURE_EXT : Key::TEXTURE_OFF);
-            if (cache.count(shaderKey) == 0) {
-                cache.emplace(shaderKey, generateProgram(shaderKey));
-                shaderCount++;
-            }
+            shaderCount += primeKey(cache, shaderKey);
         }
     }
 
@@ -129,6 +149,52 @@ void ProgramCache::primeCache(EGLContext context, bool useColorManagement) {
     ALOGD("shader cache generated - %u shaders in %f ms\n", shaderCount, compileTimeMs);
 }
 
+void ProgramCache::setPersistedKeysFile(const std::string& path) {
+    mPersistedKeysFile = path;
+    mPersistedKeys.clear();
+    mKeysToPrime.clear();
+
+    // The file is the version followed by one key per used program, all
+    // native endian uint32_t.
+    std::string contents;
+    if (!base::ReadFileToString(path, &contents)) {
+        ALOGI("No persisted program cache keys in %s", path.c_str());
+    }
+    std::vector<uint32_t> values(contents.size() / sizeof(uint32_t));
+    memcpy(values.data(), contents.data(), values.size() * sizeof(uint32_t));
+    if (values.empty() || values[0] != kPersistedKeysVersion) {
+        ALOGI_IF(!values.empty(), "Discarding program cache keys of version %u", values[0]);
+        const uint32_t version = kPersistedKeysVersion;
+        const std::string header(reinterpret_cast<const char*>(&version), sizeof(version));
+        if (!base::WriteStringToFile(header, path)) {
+            ALOGW("Unable to write program cache keys to %s", path.c_str());
+            mPersistedKeysFile.clear();
+        }
+        return;
+    }
+
+    for (size_t i = 1; i < values.size(); i++) {
+        Key key;
+        key.mKey = values[i];
+        if (key.isValid() && mPersistedKeys.insert(key).second) {
+            mKeysToPrime.push_back(key);
+        }
+    }
+    ALOGD("Loaded %zu persisted program cache keys", mKeysToPrime.size());
+}
+
+void ProgramCache::persistKey(const Key& key) {
+    if (mPersistedKeysFile.empty() || !mPersistedKeys.insert(key).second) {
+        return;
+    }
+
+    // Only happens once per new key, typically right after compiling it
+    base::unique_fd fd(open(mPersistedKeysFile.c_str(), O_WRONLY | O_APPEND | O_CLOEXEC));
+    if (fd < 0 || !base::WriteFully(fd, &key.mKey, sizeof(key.mKey))) {
+        ALOGW("Unable to persist program cache key %08X", key.mKey);
+    }
+}
+
 ProgramCache::Key ProgramCache::computeKey(const Description& description) {
     Key needs;
     needs.set(Key::TEXTURE_MASK,
@@ -724,6 +790,8 @@ void ProgramCache::useProgram(EGLContext context, const Description& description
               context, needs.mKey, uint32_t(ns2ms(time)), cache.size());
     }
 
+    persistKey(needs);
+
     // here we have a suitable program for this description
     std::unique_ptr<Program>& program = it->second;
     if (program->isValid()) {
@@ -18,7 +18,10 @@
 #define SF_RENDER_ENGINE_PROGRAMCACHE_H
 
 #include <memory>
+#include <string>
 #include <unordered_map>
+#include <unordered_set>
+#include <vector>
 
 #include <EGL/egl.h>
 #include <GLES2/gl2.h>
@@ -112,6 +115,9 @@ public:
             Y410_BT2020_MASK = 1 << Y410_BT2020_SHIFT,
             Y410_BT2020_OFF = 0 << Y410_BT2020_SHIFT,
             Y410_BT2020_ON = 1 << Y410_BT2020_SHIFT,
+
+            // All bits above. Bump kPersistedKeysVersion when changing them.
+            ALL_MASK = (1 << 13) - 1,
         };
 
         inline Key() : mKey(0) {}
@@ -166,6 +172,13 @@ public:
         }
         inline bool isY410BT2020() const { return (mKey & Y410_BT2020_MASK) == Y410_BT2020_ON; }
 
+        // Whether a program can be generated for this key
+        inline bool isValid() const {
+            const int tex = getTextureTarget();
+            return (mKey & ~ALL_MASK) == 0 &&
+                    (tex == TEXTURE_OFF || tex == TEXTURE_EXT || tex == TEXTURE_2D);
+        }
+
         // for use by std::unordered_map
 
         bool operator==(const Key& other) const { return mKey == other.mKey; }
@@ -178,9 +191,14 @@ public:
     ProgramCache() = default;
     ~ProgramCache() = default;
 
-    // Generate shaders to populate the cache
+    // Generate shaders to populate the cache. If keys were persisted by a
+    // previous run, exactly those are generated, otherwise a fixed set.
     void primeCache(const EGLContext context, bool useColorManagement);
 
+    // Loads the keys persisted in the given file, and appends the keys of
+    // programs used from now on which aren't in it yet.
+    void setPersistedKeysFile(const std::string& path);
+
     size_t getSize(const EGLContext context) { return mCaches[context].size(); }
 
     // useProgram lookup a suitable program in the cache or generates one
@@ -188,6 +206,18 @@ public:
     void useProgram(const EGLContext context, const Description& description);
 
 private:
+    friend class ProgramCacheTest;
+
+    // Increment when the meaning of the Key bits changes, which invalidates
+    // persisted keys.
+    static constexpr uint32_t kPersistedKeysVersion = 1;
+
+    // Generates the program for a key in the given cache unless it's there
+    bool primeKey(std::unordered_map<Key, std::unique_ptr<Program>, Key::Hash>& cache,
+                  const Key& key);
+    // Appends a key to the persisted keys file the first time it's used
+    void persistKey(const Key& key);
+
     // compute a cache Key from a Description
     static Key computeKey(const Description& description);
     // Generate EOTF based from Key.
@@ -209,6 +239,12 @@ private:
     // is never shrunk (and the GL program objects are never deleted).
     std::unordered_map<EGLContext, std::unordered_map<Key, std::unique_ptr<Program>, Key::Hash>>
             mCaches;
+
+    std::string mPersistedKeysFile;
+    // Keys loaded from, or since appended to, the persisted keys file
+    std::unordered_set<Key, Key::Hash> mPersistedKeys;
+    // In file order, for priming
+    std::vector<Key> mKeysToPrime;
 };
 
 } // namespace gl
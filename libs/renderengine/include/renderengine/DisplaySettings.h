@@ -60,7 +60,27 @@ struct DisplaySettings {
 
     // The orientation of the physical display.
     uint32_t orientation = ui::Transform::ROT_0;
+
+    // Region of the output buffer, in physical display space, which changed
+    // since the buffer was last drawn into. Only its bounds are redrawn, the
+    // rest of the buffer is left as it was. If empty, the whole buffer is
+    // redrawn.
+    Region damageRegion = Region::INVALID_REGION;
 };
 
+static inline bool operator==(const DisplaySettings& lhs, const DisplaySettings& rhs) {
+    return lhs.physicalDisplay == rhs.physicalDisplay && lhs.clip == rhs.clip &&
+            lhs.globalTransform == rhs.globalTransform && lhs.maxLuminance == rhs.maxLuminance &&
+            lhs.outputDataspace == rhs.outputDataspace &&
+            lhs.colorTransform == rhs.colorTransform &&
+            lhs.clearRegion.hasSameRects(rhs.clearRegion) &&
+            lhs.orientation == rhs.orientation &&
+            lhs.damageRegion.hasSameRects(rhs.damageRegion);
+}
+
+static inline bool operator!=(const DisplaySettings& lhs, const DisplaySettings& rhs) {
+    return !(lhs == rhs);
+}
+
 } // namespace renderengine
 } // namespace android
@@ -40,6 +40,10 @@ struct Buffer {
     // Fence that will fire when the buffer is ready to be bound.
     sp<Fence> fence = nullptr;
 
+    // Frame number of the layer's image in buffer. Producers reuse their
+    // buffers, so this tells apart two frames drawn from the same buffer.
+    uint64_t frameNumber = 0;
+
     // Texture identifier to bind the external texture to.
     // TODO(alecmouri): This is GL-specific...make the type backend-agnostic.
     uint32_t textureName = 0;
@@ -116,7 +120,49 @@ struct LayerSettings {
 
     // True if blending will be forced to be disabled.
     bool disableBlending = false;
+
+    // Radius, in output pixels, of the blur applied to what is drawn beneath
+    // this layer, within its geometry, if greater than 0. Only the topmost
+    // such layer is honored, since everything beneath it is blurred anyway.
+    int backgroundBlurRadius = 0;
 };
 
+// Buffers hold the same image if they are the same buffer at the same frame number. Neither
+// buffer nor fence pointers say that: producers reuse buffers, and frames without an acquire
+// fence all share Fence::NO_FENCE.
+static inline bool operator==(const Buffer& lhs, const Buffer& rhs) {
+    const bool sameBuffer = lhs.buffer == nullptr || rhs.buffer == nullptr
+            ? lhs.buffer == rhs.buffer
+            : lhs.buffer->getId() == rhs.buffer->getId();
+    return sameBuffer && lhs.frameNumber == rhs.frameNumber &&
+            lhs.textureName == rhs.textureName &&
+            lhs.useTextureFiltering == rhs.useTextureFiltering &&
+            lhs.textureTransform == rhs.textureTransform &&
+            lhs.usePremultipliedAlpha == rhs.usePremultipliedAlpha &&
+            lhs.isOpaque == rhs.isOpaque && lhs.isY410BT2020 == rhs.isY410BT2020;
+}
+
+static inline bool operator==(const Geometry& lhs, const Geometry& rhs) {
+    return lhs.boundaries == rhs.boundaries && lhs.positionTransform == rhs.positionTransform &&
+            lhs.roundedCornersRadius == rhs.roundedCornersRadius &&
+            lhs.roundedCornersCrop == rhs.roundedCornersCrop;
+}
+
+static inline bool operator==(const PixelSource& lhs, const PixelSource& rhs) {
+    return lhs.buffer == rhs.buffer && lhs.solidColor == rhs.solidColor;
+}
+
+static inline bool operator==(const LayerSettings& lhs, const LayerSettings& rhs) {
+    return lhs.geometry == rhs.geometry && lhs.source == rhs.source && lhs.alpha == rhs.alpha &&
+            lhs.sourceDataspace == rhs.sourceDataspace &&
+            lhs.colorTransform == rhs.colorTransform &&
+            lhs.disableBlending == rhs.disableBlending &&
+            lhs.backgroundBlurRadius == rhs.backgroundBlurRadius;
+}
+
+static inline bool operator!=(const LayerSettings& lhs, const LayerSettings& rhs) {
+    return !(lhs == rhs);
+}
+
 } // namespace renderengine
 } // namespace android
@@ -19,6 +19,7 @@
 
 #include <stdint.h>
 #include <sys/types.h>
+#include <functional>
 #include <memory>
 
 #include <android-base/unique_fd.h>
@@ -35,6 +36,20 @@
  */
 #define PROPERTY_DEBUG_RENDERENGINE_BACKEND "debug.renderengine.backend"
 
+/**
+ * Directory, writable by SurfaceFlinger, in which the GLES backend persists the
+ * shaders it used so that the next boot primes exactly those, along with the
+ * program binaries the driver stores through EGL_ANDROID_blob_cache. Unset
+ * disables persistence.
+ */
+#define PROPERTY_DEBUG_RENDERENGINE_SHADER_CACHE_DIR "debug.renderengine.shader_cache_dir"
+
+/**
+ * Memory, in MB, of the buffers whose images the GLES backend keeps around
+ * after prefetching them or binding them unannounced.
+ */
+#define PROPERTY_DEBUG_RENDERENGINE_PREFETCH_BUDGET_MB "debug.renderengine.prefetch_budget_mb"
+
 struct ANativeWindowBuffer;
 
 namespace android {
@@ -53,6 +68,10 @@ namespace impl {
 class RenderEngine;
 }
 
+namespace threaded {
+class RenderEngineThreaded;
+}
+
 enum class Protection {
     UNPROTECTED = 1,
     PROTECTED = 2,
@@ -102,6 +121,10 @@ public:
     // waitFence inserts a wait on an external fence fd to RenderEngine
     // command stream.  It returns false on errors.
     virtual bool waitFence(base::unique_fd fenceFd) = 0;
+    // getBlockingWaitCount returns how many times so far the CPU blocked on a
+    // fence or on the command stream, because the driver could neither wait on
+    // the fence itself nor signal a fence for the commands.
+    virtual uint32_t getBlockingWaitCount() const = 0;
 
     virtual void clearWithColor(float red, float green, float blue, float alpha) = 0;
     virtual void fillRegionWithColor(const Region& region, float red, float green, float blue,
@@ -122,6 +145,12 @@ public:
     // a buffer should never occur before binding the buffer if the caller
     // called {bind, cache}ExternalTextureBuffer before calling unbind.
     virtual void cacheExternalTextureBuffer(const sp<GraphicBuffer>& buffer) = 0;
+    // Starts creating Image resources for a buffer which is about to be
+    // drawn, e.g. as it is latched, so that drawing doesn't have to wait for
+    // them. Unlike with cacheExternalTextureBuffer, the caller doesn't need to
+    // unbind the buffer later: the resources are dropped, least recently used
+    // first, once prefetched buffers exceed a memory budget.
+    virtual void prefetchExternalTextureBuffer(const sp<GraphicBuffer>& buffer) = 0;
     // Removes internal resources referenced by the bufferId. This method should be
     // invoked when the caller will no longer hold a reference to a GraphicBuffer
     // and needs to clean up its resources.
@@ -216,6 +245,17 @@ public:
                                 ANativeWindowBuffer* buffer, const bool useFramebufferCache,
                                 base::unique_fd&& bufferFence, base::unique_fd* drawFence) = 0;
 
+    using DrawLayersCallback = std::function<void(status_t result, base::unique_fd drawFence)>;
+
+    // Same as drawLayers, except that the caller need not wait for the
+    // commands to be submitted. callback gets the result and the draw fence
+    // once they are, possibly on another thread. The layers and the buffer
+    // are held on to until then.
+    virtual void drawLayersAsync(const DisplaySettings& display,
+                                 std::vector<LayerSettings>&& layers,
+                                 const sp<GraphicBuffer>& buffer, const bool useFramebufferCache,
+                                 base::unique_fd&& bufferFence, DrawLayersCallback&& callback) = 0;
+
 protected:
     // Gets a framebuffer to render to. This framebuffer may or may not be
     // cached depending on the implementation.
@@ -224,6 +264,7 @@ protected:
     // live longer than RenderEngine.
     virtual Framebuffer* getFramebufferForDrawing() = 0;
     friend class BindNativeBufferAsFramebuffer;
+    friend class threaded::RenderEngineThreaded;
 };
 
 class BindNativeBufferAsFramebuffer {
@@ -258,6 +299,11 @@ public:
     bool useNativeFenceSync() const override;
     bool useWaitSync() const override;
 
+    // Draws right away, back-ends have no thread of their own
+    void drawLayersAsync(const DisplaySettings& display, std::vector<LayerSettings>&& layers,
+                         const sp<GraphicBuffer>& buffer, const bool useFramebufferCache,
+                         base::unique_fd&& bufferFence, DrawLayersCallback&& callback) override;
+
 protected:
     RenderEngine(uint32_t featureFlags);
     const uint32_t mFeatureFlags;
@@ -45,6 +45,7 @@ public:
     MOCK_METHOD0(flush, base::unique_fd());
     MOCK_METHOD0(finish, bool());
     MOCK_METHOD1(waitFence, bool(base::unique_fd*));
+    MOCK_CONST_METHOD0(getBlockingWaitCount, uint32_t());
     bool waitFence(base::unique_fd fd) override { return waitFence(&fd); };
     MOCK_METHOD4(clearWithColor, void(float, float, float, float));
     MOCK_METHOD5(fillRegionWithColor, void(const Region&, float, float, float, float));
@@ -52,6 +53,7 @@ public:
     MOCK_METHOD2(deleteTextures, void(size_t, uint32_t const*));
     MOCK_METHOD2(bindExternalTextureImage, void(uint32_t, const renderengine::Image&));
     MOCK_METHOD1(cacheExternalTextureBuffer, void(const sp<GraphicBuffer>&));
+    MOCK_METHOD1(prefetchExternalTextureBuffer, void(const sp<GraphicBuffer>&));
     MOCK_METHOD3(bindExternalTextureBuffer,
                  status_t(uint32_t, const sp<GraphicBuffer>&, const sp<Fence>&));
     MOCK_METHOD1(unbindExternalTextureBuffer, void(uint64_t));
@@ -82,6 +84,10 @@ public:
     MOCK_METHOD6(drawLayers,
                  status_t(const DisplaySettings&, const std::vector<LayerSettings>&,
                           ANativeWindowBuffer*, const bool, base::unique_fd&&, base::unique_fd*));
+    MOCK_METHOD6(drawLayersAsync,
+                 void(const DisplaySettings&, std::vector<LayerSettings>&&,
+                      const sp<GraphicBuffer>&, const bool, base::unique_fd&&,
+                      DrawLayersCallback&&));
 };
 
 } // namespace mock
@@ -0,0 +1,121 @@
+/*
+ * Copyright 2019 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <string.h>
+#include <unistd.h>
+
+#include <string>
+#include <vector>
+
+#include <android-base/file.h>
+#include <gtest/gtest.h>
+#include "../gl/ProgramCache.h"
+
+namespace android {
+namespace renderengine {
+namespace gl {
+
+class ProgramCacheTest : public ::testing::Test {
+protected:
+    using Key = ProgramCache::Key;
+
+    static Key makeKey(Key::key_t value) {
+        Key key;
+        key.set(~Key::key_t(0), value);
+        return key;
+    }
+
+    void writeKeysFile(uint32_t version, const std::vector<uint32_t>& keys) {
+        std::vector<uint32_t> values{version};
+        values.insert(values.end(), keys.begin(), keys.end());
+        ASSERT_TRUE(base::WriteStringToFile(std::string(reinterpret_cast<const char*>(
+                                                                values.data()),
+                                                        values.size() * sizeof(uint32_t)),
+                                            mPath));
+    }
+
+    std::vector<uint32_t> readKeysFile() {
+        std::string contents;
+        EXPECT_TRUE(base::ReadFileToString(mPath, &contents));
+        std::vector<uint32_t> values(contents.size() / sizeof(uint32_t));
+        memcpy(values.data(), contents.data(), values.size() * sizeof(uint32_t));
+        return values;
+    }
+
+    static std::vector<uint32_t> keysToPrime(const ProgramCache& cache) {
+        std::vector<uint32_t> keys;
+        for (const Key& key : cache.mKeysToPrime) {
+            keys.push_back(static_cast<uint32_t>(Key::Hash()(key)));
+        }
+        return keys;
+    }
+
+    void persistKey(uint32_t value) { mCache.persistKey(makeKey(value)); }
+
+    static constexpr uint32_t kVersion = ProgramCache::kPersistedKeysVersion;
+    static constexpr uint32_t kTextureExt = Key::TEXTURE_EXT;
+    static constexpr uint32_t kTexture2D = Key::TEXTURE_2D | Key::BLEND_PREMULT;
+    // There is no program for texture target 3
+    static constexpr uint32_t kInvalidTexture = Key::TEXTURE_MASK;
+
+    TemporaryDir mDir;
+    const std::string mPath = std::string(mDir.path) + "/renderengine_keys";
+    ProgramCache mCache;
+};
+
+TEST_F(ProgramCacheTest, missingFileStartsWithVersion) {
+    mCache.setPersistedKeysFile(mPath);
+    EXPECT_TRUE(keysToPrime(mCache).empty());
+    EXPECT_EQ(std::vector<uint32_t>{kVersion}, readKeysFile());
+}
+
+TEST_F(ProgramCacheTest, loadsValidKeysInFileOrder) {
+    writeKeysFile(kVersion, {kTexture2D, kInvalidTexture, kTextureExt, kTexture2D,
+                             Key::ALL_MASK + 1});
+    mCache.setPersistedKeysFile(mPath);
+    EXPECT_EQ((std::vector<uint32_t>{kTexture2D, kTextureExt}), keysToPrime(mCache));
+}
+
+TEST_F(ProgramCacheTest, discardsKeysOfOtherVersion) {
+    writeKeysFile(kVersion + 1, {kTexture2D, kTextureExt});
+    mCache.setPersistedKeysFile(mPath);
+    EXPECT_TRUE(keysToPrime(mCache).empty());
+    EXPECT_EQ(std::vector<uint32_t>{kVersion}, readKeysFile());
+}
+
+TEST_F(ProgramCacheTest, appendsEachNewKeyOnce) {
+    writeKeysFile(kVersion, {kTexture2D});
+    mCache.setPersistedKeysFile(mPath);
+
+    persistKey(kTexture2D);
+    persistKey(kTextureExt);
+    persistKey(kTextureExt);
+    EXPECT_EQ((std::vector<uint32_t>{kVersion, kTexture2D, kTextureExt}), readKeysFile());
+
+    // The next run primes what this one used
+    ProgramCache next;
+    next.setPersistedKeysFile(mPath);
+    EXPECT_EQ((std::vector<uint32_t>{kTexture2D, kTextureExt}), keysToPrime(next));
+}
+
+TEST_F(ProgramCacheTest, persistsNothingWithoutFile) {
+    persistKey(kTexture2D);
+    EXPECT_NE(0, access(mPath.c_str(), F_OK));
+}
+
+} // namespace gl
+} // namespace renderengine
+} // namespace android
@@ -789,11 +789,36 @@ TEST_F(RenderEngineTest, drawLayers_nullOutputFence) {
     layer.alpha = 1.0;
     layers.push_back(layer);
 
+    const uint32_t blockingWaitCount = sRE->getBlockingWaitCount();
     status_t status = sRE->drawLayers(settings, layers, mBuffer->getNativeBuffer(), true,
                                       base::unique_fd(), nullptr);
     sCurrentBuffer = mBuffer;
     ASSERT_EQ(NO_ERROR, status);
     expectBufferColor(fullscreenRect(), 255, 0, 0, 255);
+    // Without a fence to return, drawLayers has to finish()
+    EXPECT_EQ(blockingWaitCount + 1, sRE->getBlockingWaitCount());
+}
+
+TEST_F(RenderEngineTest, drawLayers_returnsFenceWithoutBlocking) {
+    if (!sRE->useNativeFenceSync()) {
+        return;
+    }
+
+    renderengine::DisplaySettings settings;
+    settings.physicalDisplay = fullscreenRect();
+    settings.clip = fullscreenRect();
+
+    std::vector<renderengine::LayerSettings> layers;
+    renderengine::LayerSettings layer;
+    layer.geometry.boundaries = fullscreenRect().toFloatRect();
+    BufferSourceVariant<ForceOpaqueBufferVariant>::fillColor(layer, 1.0f, 0.0f, 0.0f, this);
+    layer.alpha = 1.0;
+    layers.push_back(layer);
+
+    const uint32_t blockingWaitCount = sRE->getBlockingWaitCount();
+    invokeDraw(settings, layers, mBuffer);
+    expectBufferColor(fullscreenRect(), 255, 0, 0, 255);
+    EXPECT_EQ(blockingWaitCount, sRE->getBlockingWaitCount());
 }
 
 TEST_F(RenderEngineTest, drawLayers_doesNotCacheFramebuffer) {
@@ -988,6 +1013,121 @@ TEST_F(RenderEngineTest, drawLayers_clearRegion) {
     clearRegion();
 }
 
+TEST_F(RenderEngineTest, drawLayers_blursBackgroundWithinBlurringLayer) {
+    renderengine::DisplaySettings settings;
+    settings.physicalDisplay = fullscreenRect();
+    settings.clip = fullscreenRect();
+
+    // Red on the left half, blue on the right half
+    std::vector<renderengine::LayerSettings> layers;
+    renderengine::LayerSettings red;
+    red.geometry.boundaries = FloatRect(0, 0, DEFAULT_DISPLAY_WIDTH / 2, DEFAULT_DISPLAY_HEIGHT);
+    ColorSourceVariant::fillColor(red, 1.0f, 0.0f, 0.0f, this);
+    red.alpha = 1.0f;
+    layers.push_back(red);
+    renderengine::LayerSettings blue;
+    blue.geometry.boundaries = FloatRect(DEFAULT_DISPLAY_WIDTH / 2, 0, DEFAULT_DISPLAY_WIDTH,
+                                         DEFAULT_DISPLAY_HEIGHT);
+    ColorSourceVariant::fillColor(blue, 0.0f, 0.0f, 1.0f, this);
+    blue.alpha = 1.0f;
+    layers.push_back(blue);
+
+    // A transparent layer blurring the top half
+    renderengine::LayerSettings blur;
+    blur.geometry.boundaries = FloatRect(0, 0, DEFAULT_DISPLAY_WIDTH, DEFAULT_DISPLAY_HEIGHT / 2);
+    blur.alpha = 0.0f;
+    blur.backgroundBlurRadius = 24;
+    layers.push_back(blur);
+
+    auto expectColors = [this]() {
+        // The bottom half isn't blurred at all, and far from the edge the top
+        // half looks the same blurred.
+        const int32_t bottom = DEFAULT_DISPLAY_HEIGHT / 2;
+        expectBufferColor(Rect(0, bottom, DEFAULT_DISPLAY_WIDTH / 2, DEFAULT_DISPLAY_HEIGHT), 255,
+                          0, 0, 255);
+        expectBufferColor(Rect(DEFAULT_DISPLAY_WIDTH / 2, bottom, DEFAULT_DISPLAY_WIDTH,
+                               DEFAULT_DISPLAY_HEIGHT),
+                          0, 0, 255, 255);
+        expectBufferColor(Rect(0, 0, 4, bottom), 255, 0, 0, 255, 2);
+
+        // Where red and blue meet, they're mixed
+        uint8_t* pixels;
+        mBuffer->lock(GRALLOC_USAGE_SW_READ_OFTEN, reinterpret_cast<void**>(&pixels));
+        const uint8_t* edge = pixels +
+                (mBuffer->getStride() * (DEFAULT_DISPLAY_HEIGHT / 4) + DEFAULT_DISPLAY_WIDTH / 2) *
+                        4;
+        EXPECT_GT(edge[0], 0);
+        EXPECT_GT(edge[2], 0);
+        mBuffer->unlock();
+    };
+
+    invokeDraw(settings, layers, mBuffer);
+    expectColors();
+
+    // Nothing changed beneath the blur, so it's reused
+    invokeDraw(settings, layers, mBuffer);
+    expectColors();
+}
+
+TEST_F(RenderEngineTest, drawLayers_redrawsOnlyDamage) {
+    renderengine::DisplaySettings settings;
+    settings.physicalDisplay = fullscreenRect();
+    settings.clip = fullscreenRect();
+
+    std::vector<renderengine::LayerSettings> layers;
+    renderengine::LayerSettings layer;
+    layer.geometry.boundaries = fullscreenRect().toFloatRect();
+    ColorSourceVariant::fillColor(layer, 1.0f, 0.0f, 0.0f, this);
+    layer.alpha = 1.0f;
+    layers.push_back(layer);
+    invokeDraw(settings, layers, mBuffer);
+
+    // Only the left half is repainted blue, the right half keeps its red
+    const Rect damage(DEFAULT_DISPLAY_WIDTH / 2, DEFAULT_DISPLAY_HEIGHT);
+    settings.damageRegion = Region(damage);
+    ColorSourceVariant::fillColor(layers[0], 0.0f, 0.0f, 1.0f, this);
+    invokeDraw(settings, layers, mBuffer);
+
+    expectBufferColor(damage, 0, 0, 255, 255);
+    expectBufferColor(Rect(DEFAULT_DISPLAY_WIDTH / 2, 0, DEFAULT_DISPLAY_WIDTH,
+                           DEFAULT_DISPLAY_HEIGHT),
+                      255, 0, 0, 255);
+}
+
+TEST_F(RenderEngineTest, drawLayers_batchesSolidColorLayers) {
+    renderengine::DisplaySettings settings;
+    settings.physicalDisplay = fullscreenRect();
+    settings.clip = fullscreenRect();
+
+    // Four red quadrants, each placed by its transform, and a blue one on top
+    // of the last breaking up the batch
+    const int32_t halfWidth = DEFAULT_DISPLAY_WIDTH / 2;
+    const int32_t halfHeight = DEFAULT_DISPLAY_HEIGHT / 2;
+    std::vector<renderengine::LayerSettings> layers;
+    for (int32_t i = 0; i < 4; i++) {
+        renderengine::LayerSettings layer;
+        layer.geometry.boundaries = FloatRect(0, 0, halfWidth, halfHeight);
+        layer.geometry.positionTransform =
+                mat4::translate(vec4((i % 2) * halfWidth, (i / 2) * halfHeight, 0, 1));
+        ColorSourceVariant::fillColor(layer, 1.0f, 0.0f, 0.0f, this);
+        layer.alpha = 1.0f;
+        if (i == 3) {
+            renderengine::LayerSettings blue = layer;
+            ColorSourceVariant::fillColor(blue, 0.0f, 0.0f, 1.0f, this);
+            layers.push_back(layer);
+            layers.push_back(blue);
+        } else {
+            layers.push_back(layer);
+        }
+    }
+    invokeDraw(settings, layers, mBuffer);
+
+    expectBufferColor(Rect(0, 0, DEFAULT_DISPLAY_WIDTH, halfHeight), 255, 0, 0, 255);
+    expectBufferColor(Rect(0, halfHeight, halfWidth, DEFAULT_DISPLAY_HEIGHT), 255, 0, 0, 255);
+    expectBufferColor(Rect(halfWidth, halfHeight, DEFAULT_DISPLAY_WIDTH, DEFAULT_DISPLAY_HEIGHT),
+                      0, 0, 255, 255);
+}
+
 TEST_F(RenderEngineTest, drawLayers_fillsBufferAndCachesImages) {
     renderengine::DisplaySettings settings;
     settings.physicalDisplay = fullscreenRect();
@@ -1077,4 +1217,33 @@ TEST_F(RenderEngineTest, drawLayers_cacheExternalBufferCachesImages) {
     EXPECT_FALSE(sRE->isImageCachedForTesting(bufferId));
 }
 
+TEST_F(RenderEngineTest, drawLayers_prefetchExternalBufferEvictsLeastRecentlyUsed) {
+    // Only room for the image prefetched last
+    sRE->setUnpinnedImageBudgetForTesting(1);
+    auto waitFor = [](const std::shared_ptr<renderengine::gl::ImageManager::Barrier>& barrier) {
+        std::lock_guard<std::mutex> lock(barrier->mutex);
+        ASSERT_TRUE(barrier->condition.wait_for(barrier->mutex, std::chrono::seconds(5),
+                                                [&]() REQUIRES(barrier->mutex) {
+                                                    return barrier->isOpen;
+                                                }));
+        EXPECT_EQ(NO_ERROR, barrier->result);
+    };
+
+    sp<GraphicBuffer> pinned = allocateSourceBuffer(1, 1);
+    sp<GraphicBuffer> first = allocateSourceBuffer(1, 1);
+    sp<GraphicBuffer> second = allocateSourceBuffer(1, 1);
+    waitFor(sRE->cacheExternalTextureBufferForTesting(pinned));
+    waitFor(sRE->prefetchExternalTextureBufferForTesting(first));
+    EXPECT_TRUE(sRE->isImageCachedForTesting(first->getId()));
+
+    waitFor(sRE->prefetchExternalTextureBufferForTesting(second));
+    EXPECT_FALSE(sRE->isImageCachedForTesting(first->getId()));
+    EXPECT_TRUE(sRE->isImageCachedForTesting(second->getId()));
+    EXPECT_TRUE(sRE->isImageCachedForTesting(pinned->getId()));
+
+    waitFor(sRE->unbindExternalTextureBufferForTesting(pinned->getId()));
+    waitFor(sRE->unbindExternalTextureBufferForTesting(second->getId()));
+    sRE->setUnpinnedImageBudgetForTesting(64 * 1024 * 1024);
+}
+
 } // namespace android
@@ -0,0 +1,137 @@
+/*
+ * Copyright 2019 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <unistd.h>
+
+#include <future>
+#include <thread>
+
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+#include <renderengine/mock/RenderEngine.h>
+#include "../threaded/RenderEngineThreaded.h"
+
+namespace android {
+
+using testing::_;
+using testing::Invoke;
+using testing::Return;
+
+struct RenderEngineThreadedTest : public ::testing::Test {
+    // Expectations have to be set before the render thread takes ownership
+    void createThreaded() {
+        mThreadedRE = renderengine::threaded::RenderEngineThreaded::create(
+                [engine = mRenderEngine]() {
+                    return std::unique_ptr<renderengine::RenderEngine>(engine);
+                },
+                0);
+    }
+
+    renderengine::mock::RenderEngine* mRenderEngine = new renderengine::mock::RenderEngine();
+    std::unique_ptr<renderengine::threaded::RenderEngineThreaded> mThreadedRE;
+};
+
+TEST_F(RenderEngineThreadedTest, callsRunOnTheRenderThread) {
+    const auto callerId = std::this_thread::get_id();
+    EXPECT_CALL(*mRenderEngine, getMaxTextureSize()).WillOnce(Invoke([callerId]() {
+        EXPECT_NE(callerId, std::this_thread::get_id());
+        return size_t(20);
+    }));
+    createThreaded();
+
+    EXPECT_EQ(size_t(20), mThreadedRE->getMaxTextureSize());
+}
+
+TEST_F(RenderEngineThreadedTest, queuedCallsKeepTheirOrder) {
+    testing::InSequence seq;
+    EXPECT_CALL(*mRenderEngine, primeCache());
+    EXPECT_CALL(*mRenderEngine, setSourceY410BT2020(true));
+    EXPECT_CALL(*mRenderEngine, unbindExternalTextureBuffer(42));
+    EXPECT_CALL(*mRenderEngine, isProtected()).WillOnce(Return(true));
+    createThreaded();
+
+    mThreadedRE->primeCache();
+    mThreadedRE->setSourceY410BT2020(true);
+    mThreadedRE->unbindExternalTextureBuffer(42);
+    EXPECT_TRUE(mThreadedRE->isProtected());
+}
+
+TEST_F(RenderEngineThreadedTest, deleteTexturesCopiesTheNames) {
+    EXPECT_CALL(*mRenderEngine, deleteTextures(2, _))
+            .WillOnce(Invoke([](size_t count, uint32_t const* names) {
+                ASSERT_EQ(2u, count);
+                EXPECT_EQ(1u, names[0]);
+                EXPECT_EQ(2u, names[1]);
+            }));
+    createThreaded();
+
+    {
+        uint32_t names[] = {1, 2};
+        mThreadedRE->deleteTextures(2, names);
+        names[0] = names[1] = 0;
+    }
+    mThreadedRE.reset();
+}
+
+TEST_F(RenderEngineThreadedTest, drawLayersReturnsTheDrawFence) {
+    EXPECT_CALL(*mRenderEngine, drawLayers(_, _, _, true, _, _))
+            .WillOnce([](const renderengine::DisplaySettings&,
+                         const std::vector<renderengine::LayerSettings>&, ANativeWindowBuffer*,
+                         const bool, base::unique_fd&&, base::unique_fd* drawFence) -> status_t {
+                *drawFence = base::unique_fd(dup(STDOUT_FILENO));
+                return NO_ERROR;
+            });
+    createThreaded();
+
+    renderengine::DisplaySettings settings;
+    std::vector<renderengine::LayerSettings> layers;
+    base::unique_fd drawFence;
+    EXPECT_EQ(NO_ERROR,
+              mThreadedRE->drawLayers(settings, layers, nullptr, true, base::unique_fd(),
+                                      &drawFence));
+    EXPECT_GE(drawFence.get(), 0);
+}
+
+TEST_F(RenderEngineThreadedTest, drawLayersAsyncReturnsThroughTheCallback) {
+    std::promise<void> drawn;
+    EXPECT_CALL(*mRenderEngine, drawLayers(_, _, _, false, _, _))
+            .WillOnce([&drawn](const renderengine::DisplaySettings&,
+                               const std::vector<renderengine::LayerSettings>& layers,
+                               ANativeWindowBuffer*, const bool, base::unique_fd&&,
+                               base::unique_fd* drawFence) -> status_t {
+                EXPECT_EQ(1u, layers.size());
+                // The caller is not waiting on the draw
+                drawn.get_future().wait();
+                *drawFence = base::unique_fd(dup(STDOUT_FILENO));
+                return NO_ERROR;
+            });
+    createThreaded();
+
+    std::promise<std::pair<status_t, int>> result;
+    mThreadedRE->drawLayersAsync(renderengine::DisplaySettings(),
+                                 std::vector<renderengine::LayerSettings>(1), new GraphicBuffer(),
+                                 false, base::unique_fd(),
+                                 [&result](status_t status, base::unique_fd drawFence) {
+                                     result.set_value({status, drawFence.get()});
+                                 });
+    drawn.set_value();
+
+    const auto [status, fd] = result.get_future().get();
+    EXPECT_EQ(NO_ERROR, status);
+    EXPECT_GE(fd, 0);
+}
+
+} // namespace android
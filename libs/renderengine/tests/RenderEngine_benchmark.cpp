@@ -0,0 +1,261 @@
+/*
+ * Copyright 2019 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <chrono>
+#include <iterator>
+#include <memory>
+#include <vector>
+
+#include <benchmark/benchmark.h>
+#include <renderengine/RenderEngine.h>
+#include <renderengine/private/Description.h>
+#include <sync/sync.h>
+#include <ui/GraphicBuffer.h>
+#include <ui/PixelFormat.h>
+#include "../gl/GLESRenderEngine.h"
+#include "../gl/ProgramCache.h"
+
+namespace android {
+
+using renderengine::gl::GLESRenderEngine;
+
+constexpr uint32_t kDisplayWidth = 1080;
+constexpr uint32_t kDisplayHeight = 2280;
+
+// The source formats of the buffers drawn, indexed by the benchmark
+// arguments. Index 0 draws solid colors instead of buffers.
+static const PixelFormat kSourceFormats[] = {
+        PIXEL_FORMAT_NONE,
+        PIXEL_FORMAT_RGBA_8888,
+        PIXEL_FORMAT_RGBA_FP16,
+        PIXEL_FORMAT_RGBA_1010102,
+};
+
+// Keep around the same renderengine object for every benchmark, since it is
+// slow to set up and its caches are among what is measured.
+static GLESRenderEngine* getRenderEngine() {
+    static GLESRenderEngine* sRE =
+            GLESRenderEngine::create(static_cast<int32_t>(ui::PixelFormat::RGBA_8888),
+                                     renderengine::RenderEngine::USE_COLOR_MANAGEMENT, 32)
+                    .release();
+    return sRE;
+}
+
+static sp<GraphicBuffer> allocateOutputBuffer() {
+    return new GraphicBuffer(kDisplayWidth, kDisplayHeight, HAL_PIXEL_FORMAT_RGBA_8888, 1,
+                             GRALLOC_USAGE_HW_RENDER | GRALLOC_USAGE_HW_TEXTURE, "output");
+}
+
+static sp<GraphicBuffer> allocateSourceBuffer(uint32_t width, uint32_t height,
+                                              PixelFormat format) {
+    return new GraphicBuffer(width, height, format, 1, GRALLOC_USAGE_HW_TEXTURE, "input");
+}
+
+static void waitForBarrier(
+        const std::shared_ptr<renderengine::gl::ImageManager::Barrier>& barrier) {
+    std::lock_guard<std::mutex> lock(barrier->mutex);
+    barrier->condition.wait_for(barrier->mutex, std::chrono::seconds(5),
+                                [&]() REQUIRES(barrier->mutex) { return barrier->isOpen; });
+}
+
+// A stack of layers tiling the display, each one overlapping the next, like
+// the windows, bars and popups SurfaceFlinger composes.
+class LayerStack {
+public:
+    LayerStack(GLESRenderEngine* re, size_t layerCount, PixelFormat format) : mRE(re) {
+        const float step = float(kDisplayHeight) / float(layerCount + 1);
+        for (size_t i = 0; i < layerCount; i++) {
+            renderengine::LayerSettings layer;
+            layer.geometry.boundaries =
+                    FloatRect(0.0f, step * i, float(kDisplayWidth), step * (i + 2));
+            layer.alpha = 1.0f;
+            if (format == PIXEL_FORMAT_NONE) {
+                layer.source.solidColor = half3(0.25f * (i % 4), 0.5f, 0.75f);
+            } else {
+                uint32_t texName;
+                mRE->genTextures(1, &texName);
+                mTexNames.push_back(texName);
+                layer.source.buffer.buffer =
+                        allocateSourceBuffer(kDisplayWidth, uint32_t(step * 2), format);
+                layer.source.buffer.textureName = texName;
+                layer.source.buffer.isOpaque = (i == 0);
+            }
+            mLayers.push_back(layer);
+        }
+    }
+
+    ~LayerStack() {
+        mRE->deleteTextures(mTexNames.size(), mTexNames.data());
+        for (const auto& layer : mLayers) {
+            if (layer.source.buffer.buffer != nullptr) {
+                mRE->unbindExternalTextureBuffer(layer.source.buffer.buffer->getId());
+            }
+        }
+    }
+
+    std::vector<renderengine::LayerSettings>& layers() { return mLayers; }
+
+private:
+    GLESRenderEngine* const mRE;
+    std::vector<renderengine::LayerSettings> mLayers;
+    std::vector<uint32_t> mTexNames;
+};
+
+static renderengine::DisplaySettings displaySettings() {
+    renderengine::DisplaySettings settings;
+    settings.physicalDisplay = Rect(kDisplayWidth, kDisplayHeight);
+    settings.clip = Rect(kDisplayWidth, kDisplayHeight);
+    settings.outputDataspace = ui::Dataspace::V0_SRGB;
+    return settings;
+}
+
+// Draws a full frame, waiting for the GPU to be done with it so that the
+// time measured covers the whole composition.
+static void drawAndWait(GLESRenderEngine* re, const renderengine::DisplaySettings& settings,
+                        const std::vector<renderengine::LayerSettings>& layers,
+                        const sp<GraphicBuffer>& output) {
+    base::unique_fd fence;
+    re->drawLayers(settings, layers, output->getNativeBuffer(), true, base::unique_fd(), &fence);
+    if (fence >= 0) {
+        sync_wait(fence.get(), -1);
+    }
+}
+
+// Arguments: the layer count, and the index of the source format.
+static void BM_DrawLayers(benchmark::State& state) {
+    GLESRenderEngine* re = getRenderEngine();
+    LayerStack stack(re, state.range(0), kSourceFormats[state.range(1)]);
+    const renderengine::DisplaySettings settings = displaySettings();
+    sp<GraphicBuffer> output = allocateOutputBuffer();
+
+    // The first frame creates the images and programs, which later ones reuse.
+    drawAndWait(re, settings, stack.layers(), output);
+    for (auto _ : state) {
+        drawAndWait(re, settings, stack.layers(), output);
+    }
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_DrawLayers)->Apply([](benchmark::internal::Benchmark* b) {
+    for (int layerCount : {1, 4, 16}) {
+        for (int format = 0; format < int(std::size(kSourceFormats)); format++) {
+            b->Args({layerCount, format});
+        }
+    }
+});
+
+// Arguments: the layer count. Layers have rounded corners, and the topmost
+// one blurs what is beneath it, which takes programs and passes of their own.
+static void BM_DrawLayers_Effects(benchmark::State& state) {
+    GLESRenderEngine* re = getRenderEngine();
+    LayerStack stack(re, state.range(0), PIXEL_FORMAT_RGBA_8888);
+    for (auto& layer : stack.layers()) {
+        layer.geometry.roundedCornersRadius = 32.0f;
+        layer.geometry.roundedCornersCrop = layer.geometry.boundaries;
+    }
+    stack.layers().back().backgroundBlurRadius = 64;
+    const renderengine::DisplaySettings settings = displaySettings();
+    sp<GraphicBuffer> output = allocateOutputBuffer();
+
+    drawAndWait(re, settings, stack.layers(), output);
+    for (auto _ : state) {
+        drawAndWait(re, settings, stack.layers(), output);
+    }
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_DrawLayers_Effects)->Arg(1)->Arg(4)->Arg(16);
+
+// Arguments: the number of buffers bound in turn, all of them cached.
+static void BM_BindExternalTextureBuffer(benchmark::State& state) {
+    GLESRenderEngine* re = getRenderEngine();
+    std::vector<sp<GraphicBuffer>> buffers;
+    for (int64_t i = 0; i < state.range(0); i++) {
+        buffers.push_back(allocateSourceBuffer(256, 256, PIXEL_FORMAT_RGBA_8888));
+        waitForBarrier(re->cacheExternalTextureBufferForTesting(buffers.back()));
+    }
+    uint32_t texName;
+    re->genTextures(1, &texName);
+
+    size_t next = 0;
+    for (auto _ : state) {
+        re->bindExternalTextureBuffer(texName, buffers[next], nullptr);
+        next = (next + 1) % buffers.size();
+    }
+
+    re->deleteTextures(1, &texName);
+    for (const auto& buffer : buffers) {
+        waitForBarrier(re->unbindExternalTextureBufferForTesting(buffer->getId()));
+    }
+}
+BENCHMARK(BM_BindExternalTextureBuffer)->Arg(1)->Arg(8)->Arg(32);
+
+// Arguments: the index of the source format. Measures creating the image of a
+// new buffer, on the thread caching images.
+static void BM_CacheExternalTextureBuffer(benchmark::State& state) {
+    GLESRenderEngine* re = getRenderEngine();
+    const PixelFormat format = kSourceFormats[state.range(0)];
+    for (auto _ : state) {
+        state.PauseTiming();
+        sp<GraphicBuffer> buffer = allocateSourceBuffer(kDisplayWidth, kDisplayHeight, format);
+        state.ResumeTiming();
+
+        waitForBarrier(re->cacheExternalTextureBufferForTesting(buffer));
+
+        state.PauseTiming();
+        waitForBarrier(re->unbindExternalTextureBufferForTesting(buffer->getId()));
+        state.ResumeTiming();
+    }
+}
+BENCHMARK(BM_CacheExternalTextureBuffer)->DenseRange(1, 3);
+
+// Arguments: the number of distinct descriptions used in turn, whose programs
+// are all cached.
+static void BM_ProgramCacheLookup(benchmark::State& state) {
+    getRenderEngine();
+    const EGLContext context = eglGetCurrentContext();
+    using TransferFunction = renderengine::Description::TransferFunction;
+    const TransferFunction transferFunctions[] = {
+            TransferFunction::LINEAR,
+            TransferFunction::SRGB,
+            TransferFunction::ST2084,
+            TransferFunction::HLG,
+    };
+
+    std::vector<renderengine::Description> descriptions;
+    for (int64_t i = 0; i < state.range(0); i++) {
+        renderengine::Description description;
+        description.textureEnabled = (i & 1) != 0;
+        description.isPremultipliedAlpha = (i & 2) != 0;
+        description.isOpaque = (i & 4) == 0;
+        description.cornerRadius = (i & 8) != 0 ? 32.0f : 0.0f;
+        description.inputTransferFunction = transferFunctions[(i >> 4) % 4];
+        descriptions.push_back(description);
+    }
+    auto& cache = renderengine::gl::ProgramCache::getInstance();
+    for (const auto& description : descriptions) {
+        cache.useProgram(context, description);
+    }
+
+    size_t next = 0;
+    for (auto _ : state) {
+        cache.useProgram(context, descriptions[next]);
+        next = (next + 1) % descriptions.size();
+    }
+}
+BENCHMARK(BM_ProgramCacheLookup)->Arg(1)->Arg(16)->Arg(64);
+
+} // namespace android
+
+BENCHMARK_MAIN();
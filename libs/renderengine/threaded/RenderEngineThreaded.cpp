@@ -0,0 +1,347 @@
+/*
+ * Copyright 2019 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#define ATRACE_TAG ATRACE_TAG_GRAPHICS
+
+#include "RenderEngineThreaded.h"
+
+#include <pthread.h>
+
+#include <vector>
+
+#include <android-base/stringprintf.h>
+#include <log/log.h>
+#include <ui/Region.h>
+#include <utils/Trace.h>
+
+namespace android {
+namespace renderengine {
+namespace threaded {
+
+std::unique_ptr<RenderEngineThreaded> RenderEngineThreaded::create(CreateInstanceFactory factory,
+                                                                   uint32_t featureFlags) {
+    return std::make_unique<RenderEngineThreaded>(std::move(factory), featureFlags);
+}
+
+RenderEngineThreaded::RenderEngineThreaded(CreateInstanceFactory factory, uint32_t featureFlags)
+      : impl::RenderEngine(featureFlags) {
+    mThread = std::thread(&RenderEngineThreaded::threadMain, this, std::move(factory));
+}
+
+RenderEngineThreaded::~RenderEngineThreaded() {
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        mRunning = false;
+    }
+    mCondition.notify_all();
+    if (mThread.joinable()) {
+        mThread.join();
+    }
+}
+
+void RenderEngineThreaded::threadMain(CreateInstanceFactory factory) {
+    pthread_setname_np(pthread_self(), "RenderEngine");
+    // Same as the main thread, which would otherwise render
+    struct sched_param param = {0};
+    param.sched_priority = 2;
+    if (pthread_setschedparam(pthread_self(), SCHED_FIFO, &param) != 0) {
+        ALOGE("Couldn't set SCHED_FIFO for RenderEngine");
+    }
+
+    // The context is created, made current and destroyed on this thread
+    mRenderEngine = factory();
+    LOG_ALWAYS_FATAL_IF(mRenderEngine == nullptr, "Failed to create the threaded RenderEngine");
+
+    std::unique_lock<std::mutex> lock(mMutex);
+    while (true) {
+        mCondition.wait(lock, [this]() { return !mRunning || !mQueue.empty(); });
+        if (mQueue.empty()) {
+            break;
+        }
+        Work work = std::move(mQueue.front());
+        mQueue.pop();
+        lock.unlock();
+        work(*mRenderEngine);
+        lock.lock();
+    }
+    lock.unlock();
+
+    mRenderEngine.reset();
+}
+
+void RenderEngineThreaded::queue(Work&& work) const {
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        mQueue.push(std::move(work));
+    }
+    mCondition.notify_one();
+}
+
+std::unique_ptr<Framebuffer> RenderEngineThreaded::createFramebuffer() {
+    return call([](renderengine::RenderEngine& engine) { return engine.createFramebuffer(); });
+}
+
+std::unique_ptr<Image> RenderEngineThreaded::createImage() {
+    return call([](renderengine::RenderEngine& engine) { return engine.createImage(); });
+}
+
+void RenderEngineThreaded::primeCache() const {
+    // Compiling the shaders is slow and nobody needs to wait for it
+    queue([](renderengine::RenderEngine& engine) {
+        ATRACE_NAME("RenderEngine::primeCache");
+        engine.primeCache();
+    });
+}
+
+void RenderEngineThreaded::dump(std::string& result) {
+    android::base::StringAppendF(&result, "RenderEngine is threaded\n");
+    call([&result](renderengine::RenderEngine& engine) { engine.dump(result); });
+}
+
+bool RenderEngineThreaded::isCurrent() const {
+    return call([](renderengine::RenderEngine& engine) { return engine.isCurrent(); });
+}
+
+base::unique_fd RenderEngineThreaded::flush() {
+    return call([](renderengine::RenderEngine& engine) { return engine.flush(); });
+}
+
+bool RenderEngineThreaded::finish() {
+    return call([](renderengine::RenderEngine& engine) { return engine.finish(); });
+}
+
+bool RenderEngineThreaded::waitFence(base::unique_fd fenceFd) {
+    return call([&fenceFd](renderengine::RenderEngine& engine) {
+        return engine.waitFence(std::move(fenceFd));
+    });
+}
+
+uint32_t RenderEngineThreaded::getBlockingWaitCount() const {
+    return call([](renderengine::RenderEngine& engine) { return engine.getBlockingWaitCount(); });
+}
+
+void RenderEngineThreaded::clearWithColor(float red, float green, float blue, float alpha) {
+    queue([=](renderengine::RenderEngine& engine) {
+        engine.clearWithColor(red, green, blue, alpha);
+    });
+}
+
+void RenderEngineThreaded::fillRegionWithColor(const Region& region, float red, float green,
+                                               float blue, float alpha) {
+    queue([=](renderengine::RenderEngine& engine) {
+        engine.fillRegionWithColor(region, red, green, blue, alpha);
+    });
+}
+
+void RenderEngineThreaded::genTextures(size_t count, uint32_t* names) {
+    call([=](renderengine::RenderEngine& engine) { engine.genTextures(count, names); });
+}
+
+void RenderEngineThreaded::deleteTextures(size_t count, uint32_t const* names) {
+    queue([textures = std::vector<uint32_t>(names, names + count)](
+                  renderengine::RenderEngine& engine) {
+        engine.deleteTextures(textures.size(), textures.data());
+    });
+}
+
+void RenderEngineThreaded::bindExternalTextureImage(uint32_t texName, const Image& image) {
+    call([&](renderengine::RenderEngine& engine) {
+        engine.bindExternalTextureImage(texName, image);
+    });
+}
+
+status_t RenderEngineThreaded::bindExternalTextureBuffer(uint32_t texName,
+                                                         const sp<GraphicBuffer>& buffer,
+                                                         const sp<Fence>& fence) {
+    return call([&](renderengine::RenderEngine& engine) {
+        return engine.bindExternalTextureBuffer(texName, buffer, fence);
+    });
+}
+
+void RenderEngineThreaded::cacheExternalTextureBuffer(const sp<GraphicBuffer>& buffer) {
+    queue([buffer](renderengine::RenderEngine& engine) {
+        engine.cacheExternalTextureBuffer(buffer);
+    });
+}
+
+void RenderEngineThreaded::prefetchExternalTextureBuffer(const sp<GraphicBuffer>& buffer) {
+    queue([buffer](renderengine::RenderEngine& engine) {
+        engine.prefetchExternalTextureBuffer(buffer);
+    });
+}
+
+void RenderEngineThreaded::unbindExternalTextureBuffer(uint64_t bufferId) {
+    queue([bufferId](renderengine::RenderEngine& engine) {
+        engine.unbindExternalTextureBuffer(bufferId);
+    });
+}
+
+status_t RenderEngineThreaded::bindFrameBuffer(Framebuffer* framebuffer) {
+    return call([framebuffer](renderengine::RenderEngine& engine) {
+        return engine.bindFrameBuffer(framebuffer);
+    });
+}
+
+void RenderEngineThreaded::unbindFrameBuffer(Framebuffer* framebuffer) {
+    call([framebuffer](renderengine::RenderEngine& engine) {
+        engine.unbindFrameBuffer(framebuffer);
+    });
+}
+
+void RenderEngineThreaded::checkErrors() const {
+    call([](renderengine::RenderEngine& engine) { engine.checkErrors(); });
+}
+
+void RenderEngineThreaded::setViewportAndProjection(size_t vpw, size_t vph, Rect sourceCrop,
+                                                    ui::Transform::orientation_flags rotation) {
+    queue([=](renderengine::RenderEngine& engine) {
+        engine.setViewportAndProjection(vpw, vph, sourceCrop, rotation);
+    });
+}
+
+void RenderEngineThreaded::setupLayerBlending(bool premultipliedAlpha, bool opaque,
+                                              bool disableTexture, const half4& color,
+                                              float cornerRadius) {
+    queue([=](renderengine::RenderEngine& engine) {
+        engine.setupLayerBlending(premultipliedAlpha, opaque, disableTexture, color,
+                                  cornerRadius);
+    });
+}
+
+void RenderEngineThreaded::setupLayerTexturing(const Texture& texture) {
+    call([&texture](renderengine::RenderEngine& engine) { engine.setupLayerTexturing(texture); });
+}
+
+void RenderEngineThreaded::setupLayerBlackedOut() {
+    queue([](renderengine::RenderEngine& engine) { engine.setupLayerBlackedOut(); });
+}
+
+void RenderEngineThreaded::setupFillWithColor(float r, float g, float b, float a) {
+    queue([=](renderengine::RenderEngine& engine) { engine.setupFillWithColor(r, g, b, a); });
+}
+
+void RenderEngineThreaded::setupCornerRadiusCropSize(float width, float height) {
+    queue([=](renderengine::RenderEngine& engine) {
+        engine.setupCornerRadiusCropSize(width, height);
+    });
+}
+
+void RenderEngineThreaded::setColorTransform(const mat4& colorTransform) {
+    queue([colorTransform](renderengine::RenderEngine& engine) {
+        engine.setColorTransform(colorTransform);
+    });
+}
+
+void RenderEngineThreaded::disableTexturing() {
+    queue([](renderengine::RenderEngine& engine) { engine.disableTexturing(); });
+}
+
+void RenderEngineThreaded::disableBlending() {
+    queue([](renderengine::RenderEngine& engine) { engine.disableBlending(); });
+}
+
+void RenderEngineThreaded::setSourceY410BT2020(bool enable) {
+    queue([enable](renderengine::RenderEngine& engine) { engine.setSourceY410BT2020(enable); });
+}
+
+void RenderEngineThreaded::setSourceDataSpace(ui::Dataspace source) {
+    queue([source](renderengine::RenderEngine& engine) { engine.setSourceDataSpace(source); });
+}
+
+void RenderEngineThreaded::setOutputDataSpace(ui::Dataspace dataspace) {
+    queue([dataspace](renderengine::RenderEngine& engine) {
+        engine.setOutputDataSpace(dataspace);
+    });
+}
+
+void RenderEngineThreaded::setDisplayMaxLuminance(const float maxLuminance) {
+    queue([maxLuminance](renderengine::RenderEngine& engine) {
+        engine.setDisplayMaxLuminance(maxLuminance);
+    });
+}
+
+void RenderEngineThreaded::drawMesh(const Mesh& mesh) {
+    call([&mesh](renderengine::RenderEngine& engine) { engine.drawMesh(mesh); });
+}
+
+size_t RenderEngineThreaded::getMaxTextureSize() const {
+    return call([](renderengine::RenderEngine& engine) { return engine.getMaxTextureSize(); });
+}
+
+size_t RenderEngineThreaded::getMaxViewportDims() const {
+    return call([](renderengine::RenderEngine& engine) { return engine.getMaxViewportDims(); });
+}
+
+bool RenderEngineThreaded::isProtected() const {
+    return call([](renderengine::RenderEngine& engine) { return engine.isProtected(); });
+}
+
+bool RenderEngineThreaded::supportsProtectedContent() const {
+    return call(
+            [](renderengine::RenderEngine& engine) { return engine.supportsProtectedContent(); });
+}
+
+bool RenderEngineThreaded::useProtectedContext(bool useProtectedContext) {
+    return call([useProtectedContext](renderengine::RenderEngine& engine) {
+        return engine.useProtectedContext(useProtectedContext);
+    });
+}
+
+Framebuffer* RenderEngineThreaded::getFramebufferForDrawing() {
+    return call([](renderengine::RenderEngine& engine) {
+        return engine.getFramebufferForDrawing();
+    });
+}
+
+status_t RenderEngineThreaded::drawLayers(const DisplaySettings& display,
+                                          const std::vector<LayerSettings>& layers,
+                                          ANativeWindowBuffer* buffer,
+                                          const bool useFramebufferCache,
+                                          base::unique_fd&& bufferFence,
+                                          base::unique_fd* drawFence) {
+    ATRACE_CALL();
+    // Waits for the commands to be submitted, not for the GPU to finish them:
+    // drawFence only comes into existence once they are.
+    return call([&](renderengine::RenderEngine& engine) {
+        ATRACE_NAME("RenderEngine::drawLayers");
+        return engine.drawLayers(display, layers, buffer, useFramebufferCache,
+                                 std::move(bufferFence), drawFence);
+    });
+}
+
+void RenderEngineThreaded::drawLayersAsync(const DisplaySettings& display,
+                                           std::vector<LayerSettings>&& layers,
+                                           const sp<GraphicBuffer>& buffer,
+                                           const bool useFramebufferCache,
+                                           base::unique_fd&& bufferFence,
+                                           DrawLayersCallback&& callback) {
+    ATRACE_CALL();
+    // Work has to be copyable, so the fence travels as a raw fd
+    queue([display, layers = std::move(layers), buffer, useFramebufferCache,
+           bufferFenceFd = bufferFence.release(),
+           callback = std::move(callback)](renderengine::RenderEngine& engine) {
+        ATRACE_NAME("RenderEngine::drawLayersAsync");
+        base::unique_fd drawFence;
+        const status_t result =
+                engine.drawLayers(display, layers, buffer->getNativeBuffer(), useFramebufferCache,
+                                  base::unique_fd(bufferFenceFd), &drawFence);
+        callback(result, std::move(drawFence));
+    });
+}
+
+} // namespace threaded
+} // namespace renderengine
+} // namespace android
@@ -0,0 +1,150 @@
+/*
+ * Copyright 2019 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <condition_variable>
+#include <functional>
+#include <future>
+#include <mutex>
+#include <queue>
+#include <thread>
+#include <type_traits>
+
+#include <android-base/thread_annotations.h>
+#include <renderengine/RenderEngine.h>
+
+namespace android {
+namespace renderengine {
+namespace threaded {
+
+using CreateInstanceFactory = std::function<std::unique_ptr<renderengine::RenderEngine>()>;
+
+// Runs another RenderEngine on a dedicated thread, which owns its GL context.
+// Calls which return nothing the caller needs, such as cache maintenance and
+// shader warm-up, are queued without waiting. All other calls wait for the
+// render thread, which keeps the GL command stream in the order the caller
+// issued it.
+class RenderEngineThreaded : public impl::RenderEngine {
+public:
+    static std::unique_ptr<RenderEngineThreaded> create(CreateInstanceFactory factory,
+                                                        uint32_t featureFlags);
+
+    RenderEngineThreaded(CreateInstanceFactory factory, uint32_t featureFlags);
+    ~RenderEngineThreaded() override;
+
+    std::unique_ptr<Framebuffer> createFramebuffer() override;
+    std::unique_ptr<Image> createImage() override;
+    void primeCache() const override;
+
+    void dump(std::string& result) override;
+
+    bool isCurrent() const override;
+    base::unique_fd flush() override;
+    bool finish() override;
+    bool waitFence(base::unique_fd fenceFd) override;
+    uint32_t getBlockingWaitCount() const override;
+
+    void clearWithColor(float red, float green, float blue, float alpha) override;
+    void fillRegionWithColor(const Region& region, float red, float green, float blue,
+                             float alpha) override;
+    void genTextures(size_t count, uint32_t* names) override;
+    void deleteTextures(size_t count, uint32_t const* names) override;
+    void bindExternalTextureImage(uint32_t texName, const Image& image) override;
+    status_t bindExternalTextureBuffer(uint32_t texName, const sp<GraphicBuffer>& buffer,
+                                       const sp<Fence>& fence) override;
+    void cacheExternalTextureBuffer(const sp<GraphicBuffer>& buffer) override;
+    void prefetchExternalTextureBuffer(const sp<GraphicBuffer>& buffer) override;
+    void unbindExternalTextureBuffer(uint64_t bufferId) override;
+    status_t bindFrameBuffer(Framebuffer* framebuffer) override;
+    void unbindFrameBuffer(Framebuffer* framebuffer) override;
+
+    void checkErrors() const override;
+    void setViewportAndProjection(size_t vpw, size_t vph, Rect sourceCrop,
+                                  ui::Transform::orientation_flags rotation) override;
+    void setupLayerBlending(bool premultipliedAlpha, bool opaque, bool disableTexture,
+                            const half4& color, float cornerRadius) override;
+    void setupLayerTexturing(const Texture& texture) override;
+    void setupLayerBlackedOut() override;
+    void setupFillWithColor(float r, float g, float b, float a) override;
+    void setupCornerRadiusCropSize(float width, float height) override;
+    void setColorTransform(const mat4& colorTransform) override;
+    void disableTexturing() override;
+    void disableBlending() override;
+
+    void setSourceY410BT2020(bool enable) override;
+    void setSourceDataSpace(ui::Dataspace source) override;
+    void setOutputDataSpace(ui::Dataspace dataspace) override;
+    void setDisplayMaxLuminance(const float maxLuminance) override;
+
+    void drawMesh(const Mesh& mesh) override;
+
+    size_t getMaxTextureSize() const override;
+    size_t getMaxViewportDims() const override;
+
+    bool isProtected() const override;
+    bool supportsProtectedContent() const override;
+    bool useProtectedContext(bool useProtectedContext) override;
+
+    status_t drawLayers(const DisplaySettings& display, const std::vector<LayerSettings>& layers,
+                        ANativeWindowBuffer* buffer, const bool useFramebufferCache,
+                        base::unique_fd&& bufferFence, base::unique_fd* drawFence) override;
+    void drawLayersAsync(const DisplaySettings& display, std::vector<LayerSettings>&& layers,
+                         const sp<GraphicBuffer>& buffer, const bool useFramebufferCache,
+                         base::unique_fd&& bufferFence, DrawLayersCallback&& callback) override;
+
+protected:
+    Framebuffer* getFramebufferForDrawing() override;
+
+private:
+    using Work = std::function<void(renderengine::RenderEngine&)>;
+
+    void threadMain(CreateInstanceFactory factory) NO_THREAD_SAFETY_ANALYSIS;
+
+    // Queues work for the render thread without waiting for it
+    void queue(Work&& work) const EXCLUDES(mMutex);
+
+    // Runs work on the render thread and waits for its result
+    template <typename F>
+    std::invoke_result_t<F, renderengine::RenderEngine&> call(F&& f) const {
+        using Result = std::invoke_result_t<F, renderengine::RenderEngine&>;
+        std::promise<Result> promise;
+        auto future = promise.get_future();
+        queue([&promise, &f](renderengine::RenderEngine& engine) {
+            if constexpr (std::is_void_v<Result>) {
+                f(engine);
+                promise.set_value();
+            } else {
+                promise.set_value(f(engine));
+            }
+        });
+        return future.get();
+    }
+
+    // Only ever touched by the render thread
+    std::unique_ptr<renderengine::RenderEngine> mRenderEngine;
+
+    mutable std::mutex mMutex;
+    mutable std::condition_variable mCondition;
+    mutable std::queue<Work> mQueue GUARDED_BY(mMutex);
+    bool mRunning GUARDED_BY(mMutex) = true;
+
+    std::thread mThread;
+};
+
+} // namespace threaded
+} // namespace renderengine
+} // namespace android
@@ -21,8 +21,11 @@
 #include <sys/socket.h>
 
 #include <fcntl.h>
+#include <string.h>
 #include <unistd.h>
 
+#include <algorithm>
+
 #include <binder/Parcel.h>
 
 namespace android {
@@ -32,6 +35,9 @@ namespace android {
 // we really need.  So we make it smaller.
 static const size_t DEFAULT_SOCKET_BUFFER_SIZE = 4 * 1024;
 
+// The most messages handed to a single sendmmsg() call.
+static const size_t MAX_MESSAGES_PER_WRITE = 16;
+
 
 BitTube::BitTube()
     : mSendFd(-1), mReceiveFd(-1)
@@ -113,6 +119,48 @@ ssize_t BitTube::write(void const* vaddr, size_t size)
     return err == 0 ? len : -err;
 }
 
+ssize_t BitTube::write(void const* vaddr, size_t size, size_t messageSize)
+{
+    if (messageSize == 0 || messageSize >= size) {
+        return write(vaddr, size);
+    }
+
+    const char* data = reinterpret_cast<const char*>(vaddr);
+    size_t sent = 0;
+    while (sent < size) {
+        struct iovec iovs[MAX_MESSAGES_PER_WRITE];
+        struct mmsghdr msgs[MAX_MESSAGES_PER_WRITE];
+        size_t count = 0;
+        for (size_t offset = sent; offset < size && count < MAX_MESSAGES_PER_WRITE;
+                offset += messageSize, count++) {
+            iovs[count].iov_base = const_cast<char*>(data + offset);
+            iovs[count].iov_len = std::min(messageSize, size - offset);
+            memset(&msgs[count], 0, sizeof(msgs[count]));
+            msgs[count].msg_hdr.msg_iov = &iovs[count];
+            msgs[count].msg_hdr.msg_iovlen = 1;
+        }
+
+        int err, n;
+        do {
+            n = ::sendmmsg(mSendFd, msgs, count, MSG_DONTWAIT | MSG_NOSIGNAL);
+            err = n < 0 ? errno : 0;
+        } while (err == EINTR);
+        if (err != 0) {
+            return sent > 0 ? ssize_t(sent) : -err;
+        }
+
+        // as with send(), every message that went out went out whole
+        for (int i = 0; i < n; i++) {
+            sent += iovs[i].iov_len;
+        }
+        if (size_t(n) < count) {
+            // the socket buffer is full
+            break;
+        }
+    }
+    return ssize_t(sent);
+}
+
 ssize_t BitTube::read(void* vaddr, size_t size)
 {
     ssize_t err, len;
@@ -155,6 +203,21 @@ ssize_t BitTube::sendObjects(const sp<BitTube>& tube,
     return size < 0 ? size : size / static_cast<ssize_t>(objSize);
 }
 
+ssize_t BitTube::sendObjects(const sp<BitTube>& tube,
+        void const* events, size_t count, size_t objSize, size_t maxPerMessage)
+{
+    const char* vaddr = reinterpret_cast<const char*>(events);
+    ssize_t size = tube->write(vaddr, count*objSize, maxPerMessage*objSize);
+
+    // should never happen because of SOCK_SEQPACKET
+    LOG_ALWAYS_FATAL_IF((size >= 0) && (size % static_cast<ssize_t>(objSize)),
+            "BitTube::sendObjects(count=%zu, size=%zu, maxPerMessage=%zu), res=%zd (partial "
+            "events were sent!)",
+            count, objSize, maxPerMessage, size);
+
+    return size < 0 ? size : size / static_cast<ssize_t>(objSize);
+}
+
 ssize_t BitTube::recvObjects(const sp<BitTube>& tube,
         void* events, size_t count, size_t objSize)
 {
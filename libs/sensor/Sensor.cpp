@@ -451,6 +451,16 @@ bool Sensor::isDirectChannelTypeSupported(int32_t sharedMemType) const {
     }
 }
 
+void Sensor::setDirectReportSupport(int32_t highestRateLevel, uint32_t directChannelFlags) {
+    mFlags &= ~(SENSOR_FLAG_MASK_DIRECT_REPORT | SENSOR_FLAG_MASK_DIRECT_CHANNEL);
+    // only on continuous sensors direct report mode is defined
+    if ((mFlags & REPORTING_MODE_MASK) == SENSOR_FLAG_CONTINUOUS_MODE) {
+        mFlags |= (uint32_t(highestRateLevel) << SENSOR_FLAG_SHIFT_DIRECT_REPORT)
+                & SENSOR_FLAG_MASK_DIRECT_REPORT;
+        mFlags |= directChannelFlags & SENSOR_FLAG_MASK_DIRECT_CHANNEL;
+    }
+}
+
 int32_t Sensor::getReportingMode() const {
     return ((mFlags & REPORTING_MODE_MASK) >> REPORTING_MODE_SHIFT);
 }
@@ -63,6 +63,11 @@ ssize_t SensorEventQueue::write(const sp<BitTube>& tube,
     return BitTube::sendObjects(tube, events, numEvents);
 }
 
+ssize_t SensorEventQueue::write(const sp<BitTube>& tube,
+        ASensorEvent const* events, size_t numEvents, size_t maxEventsPerMessage) {
+    return BitTube::sendObjects(tube, events, numEvents, maxEventsPerMessage);
+}
+
 ssize_t SensorEventQueue::read(ASensorEvent* events, size_t numEvents) {
     if (mAvailable == 0) {
         ssize_t err = BitTube::recvObjects(mSensorChannel,
@@ -55,6 +55,16 @@ public:
         return sendObjects(tube, events, count, sizeof(T));
     }
 
+    // send objects (sized blobs) as consecutive messages of at most maxPerMessage objects each,
+    // using as few system calls as possible. Each message is written whole or not at all, and
+    // the call returns the number of objects in the messages that were written, or an error if
+    // not even the first one could be.
+    template <typename T>
+    static ssize_t sendObjects(const sp<BitTube>& tube,
+            T const* events, size_t count, size_t maxPerMessage) {
+        return sendObjects(tube, events, count, sizeof(T), maxPerMessage);
+    }
+
     // receive objects (sized blobs). If the receiving buffer isn't large enough,
     // excess messages are silently discarded.
     template <typename T>
@@ -72,6 +82,10 @@ private:
     // send a message. The write is guaranteed to send the whole message or fail.
     ssize_t write(void const* vaddr, size_t size);
 
+    // send consecutive messages of messageSize bytes (the last one may be shorter). Returns the
+    // number of bytes in the messages that were sent.
+    ssize_t write(void const* vaddr, size_t size, size_t messageSize);
+
     // receive a message. the passed buffer must be at least as large as the
     // write call used to send the message, excess data is silently discarded.
     ssize_t read(void* vaddr, size_t size);
@@ -82,6 +96,9 @@ private:
     static ssize_t sendObjects(const sp<BitTube>& tube,
             void const* events, size_t count, size_t objSize);
 
+    static ssize_t sendObjects(const sp<BitTube>& tube,
+            void const* events, size_t count, size_t objSize, size_t maxPerMessage);
+
     static ssize_t recvObjects(const sp<BitTube>& tube,
             void* events, size_t count, size_t objSize);
 };
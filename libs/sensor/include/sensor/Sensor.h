@@ -96,6 +96,10 @@ public:
     bool isDirectChannelTypeSupported(int32_t sharedMemType) const;
     int32_t getReportingMode() const;
 
+    // Overrides the direct report flags, for sensors whose direct reports are written by the
+    // sensor service rather than the HAL. directChannelFlags are SENSOR_FLAG_DIRECT_CHANNEL_*.
+    void setDirectReportSupport(int32_t highestRateLevel, uint32_t directChannelFlags);
+
     // Note that after setId() has been called, getUuid() no longer
     // returns the UUID.
     // TODO(b/29547335): Remove getUuid(), add getUuidIndex(), and
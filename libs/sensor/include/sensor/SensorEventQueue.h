@@ -74,6 +74,11 @@ public:
     static ssize_t write(const sp<BitTube>& tube,
             ASensorEvent const* events, size_t numEvents);
 
+    // writes the events as consecutive messages of at most maxEventsPerMessage events each, and
+    // returns how many events were in the messages that were written
+    static ssize_t write(const sp<BitTube>& tube,
+            ASensorEvent const* events, size_t numEvents, size_t maxEventsPerMessage);
+
     ssize_t read(ASensorEvent* events, size_t numEvents);
 
     status_t waitForEvent() const;
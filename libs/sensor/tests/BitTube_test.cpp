@@ -0,0 +1,121 @@
+/*
+ * Copyright 2019 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <errno.h>
+#include <stdint.h>
+
+#include <numeric>
+#include <vector>
+
+#include <gtest/gtest.h>
+#include <utils/Errors.h>
+
+#include <sensor/BitTube.h>
+
+namespace android {
+
+namespace {
+
+// An object as large as a sensor event, so that few of them fill a socket buffer.
+struct Blob {
+    int32_t index;
+    char payload[100];
+};
+
+std::vector<Blob> makeBlobs(size_t count) {
+    std::vector<Blob> blobs(count);
+    for (size_t i = 0; i < count; i++) {
+        blobs[i].index = static_cast<int32_t>(i);
+    }
+    return blobs;
+}
+
+// Reads one message, and returns the indices of the objects in it.
+std::vector<int32_t> receiveMessage(const sp<BitTube>& tube) {
+    Blob buffer[64];
+    ssize_t count = BitTube::recvObjects(tube, buffer, 64);
+    std::vector<int32_t> indices;
+    for (ssize_t i = 0; i < count; i++) {
+        indices.push_back(buffer[i].index);
+    }
+    return indices;
+}
+
+} // namespace
+
+TEST(BitTubeTest, SendsObjectsInMessagesOfAtMostMaxPerMessage) {
+    sp<BitTube> tube = new BitTube(64 * 1024);
+    ASSERT_EQ(NO_ERROR, tube->initCheck());
+    const std::vector<Blob> blobs = makeBlobs(10);
+
+    ASSERT_EQ(10, BitTube::sendObjects(tube, blobs.data(), blobs.size(), 3));
+
+    EXPECT_EQ(std::vector<int32_t>({0, 1, 2}), receiveMessage(tube));
+    EXPECT_EQ(std::vector<int32_t>({3, 4, 5}), receiveMessage(tube));
+    EXPECT_EQ(std::vector<int32_t>({6, 7, 8}), receiveMessage(tube));
+    EXPECT_EQ(std::vector<int32_t>({9}), receiveMessage(tube));
+    EXPECT_TRUE(receiveMessage(tube).empty());
+}
+
+TEST(BitTubeTest, SendsMoreMessagesThanOneSystemCallTakes) {
+    sp<BitTube> tube = new BitTube(64 * 1024);
+    ASSERT_EQ(NO_ERROR, tube->initCheck());
+    const std::vector<Blob> blobs = makeBlobs(40);
+
+    ASSERT_EQ(40, BitTube::sendObjects(tube, blobs.data(), blobs.size(), 1));
+
+    for (int32_t i = 0; i < 40; i++) {
+        EXPECT_EQ(std::vector<int32_t>({i}), receiveMessage(tube));
+    }
+    EXPECT_TRUE(receiveMessage(tube).empty());
+}
+
+TEST(BitTubeTest, SendsOneMessageWhenAllObjectsFit) {
+    sp<BitTube> tube = new BitTube(64 * 1024);
+    ASSERT_EQ(NO_ERROR, tube->initCheck());
+    const std::vector<Blob> blobs = makeBlobs(4);
+
+    ASSERT_EQ(4, BitTube::sendObjects(tube, blobs.data(), blobs.size(), 4));
+
+    EXPECT_EQ(std::vector<int32_t>({0, 1, 2, 3}), receiveMessage(tube));
+    EXPECT_TRUE(receiveMessage(tube).empty());
+}
+
+TEST(BitTubeTest, FullSocketSendsWholeMessagesOnly) {
+    sp<BitTube> tube = new BitTube();
+    ASSERT_EQ(NO_ERROR, tube->initCheck());
+    const std::vector<Blob> blobs = makeBlobs(1000);
+
+    ssize_t sent = BitTube::sendObjects(tube, blobs.data(), blobs.size(), 2);
+    ASSERT_GT(sent, 0);
+    ASSERT_LT(sent, 1000);
+    EXPECT_EQ(0, sent % 2);
+
+    // Nothing more fits until the receiver catches up.
+    EXPECT_EQ(-EAGAIN, BitTube::sendObjects(tube, blobs.data() + sent, blobs.size() - sent, 2));
+
+    std::vector<int32_t> received;
+    for (std::vector<int32_t> message = receiveMessage(tube); !message.empty();
+            message = receiveMessage(tube)) {
+        EXPECT_EQ(2u, message.size());
+        received.insert(received.end(), message.begin(), message.end());
+    }
+    std::vector<int32_t> expected(sent);
+    std::iota(expected.begin(), expected.end(), 0);
+    EXPECT_EQ(expected, received);
+}
+
+} // namespace android
@@ -85,4 +85,41 @@ TEST(SensorTest, FlattenAndUnflatten) {
     EXPECT_TRUE(sensorsMatch(sensor1, sensor2));
 }
 
+TEST(SensorTest, SetDirectReportSupport) {
+    sensor_t hwSensor = getTestSensorT();
+    hwSensor.flags |= (SENSOR_DIRECT_RATE_VERY_FAST << SENSOR_FLAG_SHIFT_DIRECT_REPORT)
+            | SENSOR_FLAG_DIRECT_CHANNEL_GRALLOC;
+    Sensor sensor(&hwSensor, SENSORS_DEVICE_API_VERSION_1_4);
+    ASSERT_EQ(SENSOR_DIRECT_RATE_VERY_FAST, sensor.getHighestDirectReportRateLevel());
+
+    // The flags written by the service replace the ones the HAL reported.
+    sensor.setDirectReportSupport(SENSOR_DIRECT_RATE_NORMAL, SENSOR_FLAG_DIRECT_CHANNEL_ASHMEM);
+    EXPECT_EQ(SENSOR_DIRECT_RATE_NORMAL, sensor.getHighestDirectReportRateLevel());
+    EXPECT_TRUE(sensor.isDirectChannelTypeSupported(SENSOR_DIRECT_MEM_TYPE_ASHMEM));
+    EXPECT_FALSE(sensor.isDirectChannelTypeSupported(SENSOR_DIRECT_MEM_TYPE_GRALLOC));
+
+    // The flags are carried across binder.
+    Sensor unflattened;
+    std::vector<uint8_t> buffer(sensor.getFlattenedSize());
+    ASSERT_EQ(OK, sensor.flatten(buffer.data(), buffer.size()));
+    ASSERT_EQ(OK, unflattened.unflatten(buffer.data(), buffer.size()));
+    EXPECT_TRUE(sensorsMatch(sensor, unflattened));
+
+    sensor.setDirectReportSupport(SENSOR_DIRECT_RATE_STOP, 0);
+    EXPECT_EQ(SENSOR_DIRECT_RATE_STOP, sensor.getHighestDirectReportRateLevel());
+    EXPECT_FALSE(sensor.isDirectChannelTypeSupported(SENSOR_DIRECT_MEM_TYPE_ASHMEM));
+}
+
+TEST(SensorTest, SetDirectReportSupportIgnoresNonContinuousSensors) {
+    sensor_t hwSensor = getTestSensorT();
+    hwSensor.type = SENSOR_TYPE_PROXIMITY;
+    hwSensor.stringType = SENSOR_STRING_TYPE_PROXIMITY;
+    hwSensor.flags = SENSOR_FLAG_ON_CHANGE_MODE;
+    Sensor sensor(&hwSensor, SENSORS_DEVICE_API_VERSION_1_4);
+
+    sensor.setDirectReportSupport(SENSOR_DIRECT_RATE_FAST, SENSOR_FLAG_DIRECT_CHANNEL_ASHMEM);
+    EXPECT_EQ(SENSOR_DIRECT_RATE_STOP, sensor.getHighestDirectReportRateLevel());
+    EXPECT_FALSE(sensor.isDirectChannelTypeSupported(SENSOR_DIRECT_MEM_TYPE_ASHMEM));
+}
+
 } // namespace android
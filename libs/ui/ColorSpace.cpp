@@ -16,6 +16,9 @@
 
 #include <ui/ColorSpace.h>
 
+#include <list>
+#include <mutex>
+
 using namespace std::placeholders;
 
 namespace android {
@@ -361,10 +364,19 @@ std::unique_ptr<float3[]> ColorSpace::createLUT(uint32_t size, const ColorSpace&
 
     ColorSpaceConnector connector(src, dst);
 
+    // The source decoding is done per component, so it only needs to be
+    // computed once per grid coordinate rather than for every entry
+    std::unique_ptr<float[]> linear(new float[size]);
+    for (uint32_t i = 0; i < size; i++) {
+        linear[i] = src.getEOTF()(src.getClamper()(i * m));
+    }
+
+    const mat3& transform = connector.getTransform();
     for (uint32_t z = 0; z < size; z++) {
         for (int32_t y = int32_t(size - 1); y >= 0; y--) {
             for (uint32_t x = 0; x < size; x++) {
-                *data++ = connector.transform({x * m, y * m, z * m});
+                const float3 rgb = float3{linear[x], linear[y], linear[z]};
+                *data++ = apply(dst.fromLinear(transform * rgb), dst.getClamper());
             }
         }
     }
@@ -372,6 +384,112 @@ std::unique_ptr<float3[]> ColorSpace::createLUT(uint32_t size, const ColorSpace&
     return lut;
 }
 
+namespace {
+
+// A small cache of the most recently used LUTs
+template <typename T>
+class LUTCache {
+public:
+    std::shared_ptr<const T[]> get(const std::string& key,
+                                   const std::function<std::unique_ptr<T[]>()>& create) {
+        {
+            std::lock_guard<std::mutex> lock(mMutex);
+            for (auto it = mEntries.begin(); it != mEntries.end(); ++it) {
+                if (it->first == key) {
+                    mEntries.splice(mEntries.begin(), mEntries, it);
+                    return it->second;
+                }
+            }
+        }
+
+        // Computing a LUT can take a while, so do it without the lock held;
+        // the first LUT inserted for a key wins
+        std::shared_ptr<const T[]> lut(create().release());
+
+        std::lock_guard<std::mutex> lock(mMutex);
+        for (const auto& entry : mEntries) {
+            if (entry.first == key) {
+                return entry.second;
+            }
+        }
+        mEntries.emplace_front(key, lut);
+        if (mEntries.size() > MAX_ENTRIES) {
+            mEntries.pop_back();
+        }
+        return lut;
+    }
+
+private:
+    static constexpr size_t MAX_ENTRIES = 8;
+
+    std::mutex mMutex;
+    // Most recently used first
+    std::list<std::pair<std::string, std::shared_ptr<const T[]>>> mEntries;
+};
+
+} // namespace
+
+static void appendKey(std::string* key, const ColorSpace& colorSpace) {
+    key->append(colorSpace.getName());
+    key->push_back('\0');
+    key->append(reinterpret_cast<const char*>(&colorSpace.getRGBtoXYZ()), sizeof(mat3));
+    key->append(reinterpret_cast<const char*>(&colorSpace.getTransferParameters()),
+                sizeof(ColorSpace::TransferParameters));
+}
+
+static std::string makeKey(char kind, uint32_t size, const ColorSpace& colorSpace) {
+    std::string key(1, kind);
+    key.append(reinterpret_cast<const char*>(&size), sizeof(size));
+    appendKey(&key, colorSpace);
+    return key;
+}
+
+std::shared_ptr<const float3[]> ColorSpace::getLUT(uint32_t size, const ColorSpace& src,
+                                                   const ColorSpace& dst) {
+    static LUTCache<float3> sCache;
+    size = clamp(size, 2u, 256u);
+    std::string key = makeKey('3', size, src);
+    appendKey(&key, dst);
+    return sCache.get(key, [&]() { return createLUT(size, src, dst); });
+}
+
+static std::unique_ptr<float[]> createTransferLUT(uint32_t size,
+                                                  const ColorSpace::transfer_function& f) {
+    size = clamp(size, 2u, 4096u);
+    float m = 1.0f / float(size - 1);
+
+    std::unique_ptr<float[]> lut(new float[size]);
+    for (uint32_t i = 0; i < size; i++) {
+        lut[i] = f(i * m);
+    }
+    return lut;
+}
+
+std::unique_ptr<float[]> ColorSpace::createEOTFLUT(uint32_t size) const {
+    return createTransferLUT(size, mEOTF);
+}
+
+std::unique_ptr<float[]> ColorSpace::createOETFLUT(uint32_t size) const {
+    return createTransferLUT(size, mOETF);
+}
+
+static LUTCache<float>& getTransferLUTCache() {
+    static LUTCache<float> sCache;
+    return sCache;
+}
+
+std::shared_ptr<const float[]> ColorSpace::getEOTFLUT(uint32_t size) const {
+    size = clamp(size, 2u, 4096u);
+    return getTransferLUTCache().get(makeKey('E', size, *this),
+                                     [&]() { return createEOTFLUT(size); });
+}
+
+std::shared_ptr<const float[]> ColorSpace::getOETFLUT(uint32_t size) const {
+    size = clamp(size, 2u, 4096u);
+    return getTransferLUTCache().get(makeKey('O', size, *this),
+                                     [&]() { return createOETFLUT(size); });
+}
+
 static const float2 ILLUMINANT_D50_XY = {0.34567f, 0.35850f};
 static const float3 ILLUMINANT_D50_XYZ = {0.964212f, 1.0f, 0.825188f};
 static const mat3 BRADFORD = mat3{
@@ -27,8 +27,10 @@
 #include <sync/sync.h>
 #pragma clang diagnostic pop
 
+#include <poll.h>
 #include <sys/types.h>
 #include <unistd.h>
+#include <algorithm>
 #include <utils/Log.h>
 #include <utils/String8.h>
 #include <utils/Trace.h>
@@ -100,6 +102,61 @@ sp<Fence> Fence::merge(const String8& name, const sp<Fence>& f1,
     return merge(name.string(), f1, f2);
 }
 
+sp<Fence> Fence::merge(const char* name, const std::vector<sp<Fence>>& fences) {
+    ATRACE_CALL();
+    std::vector<sp<Fence>> validFences;
+    validFences.reserve(fences.size());
+    for (const auto& fence : fences) {
+        if (fence.get() && fence->isValid() &&
+            std::find(validFences.begin(), validFences.end(), fence) == validFences.end()) {
+            validFences.push_back(fence);
+        }
+    }
+    if (validFences.empty()) {
+        return NO_FENCE;
+    }
+    if (validFences.size() == 1) {
+        return validFences[0];
+    }
+
+    // Check all the fences with a single poll.  A fence that already
+    // signaled did so before any of the pending ones will, so leaving it out
+    // does not change the signal time of the result.
+    std::vector<struct pollfd> pollFds;
+    pollFds.reserve(validFences.size());
+    for (const auto& fence : validFences) {
+        pollFds.push_back({fence->mFenceFd.get(), POLLIN, 0});
+    }
+    std::vector<sp<Fence>> pendingFences;
+    if (poll(pollFds.data(), pollFds.size(), 0) >= 0) {
+        for (size_t i = 0; i < validFences.size(); i++) {
+            if (!(pollFds[i].revents & POLLIN)) {
+                pendingFences.push_back(validFences[i]);
+            }
+        }
+    }
+    // If every fence signaled, or the poll failed, merge them all so that
+    // the latest signal time is kept.
+    if (pendingFences.empty()) {
+        pendingFences = std::move(validFences);
+    }
+    if (pendingFences.size() == 1) {
+        return pendingFences[0];
+    }
+
+    // The kernel merges two sync files at a time, but flattens the fences
+    // they hold, so chaining the merges does not nest sync files.  Each
+    // intermediate fence is closed as soon as the next merge is done.
+    sp<Fence> merged = pendingFences[0];
+    for (size_t i = 1; i < pendingFences.size(); i++) {
+        merged = merge(name, merged, pendingFences[i]);
+        if (!merged->isValid()) {
+            return NO_FENCE;
+        }
+    }
+    return merged;
+}
+
 int Fence::dup() const {
     return ::dup(mFenceFd);
 }
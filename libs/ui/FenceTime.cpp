@@ -21,9 +21,11 @@
 #include <cutils/compiler.h>  // For CC_[UN]LIKELY
 #include <utils/Log.h>
 #include <inttypes.h>
+#include <poll.h>
 #include <stdlib.h>
 
 #include <memory>
+#include <vector>
 
 namespace android {
 
@@ -273,29 +275,71 @@ void FenceTimeline::push(const std::shared_ptr<FenceTime>& fence) {
             // we are removing it from the timeline.
             front->getSignalTime();
         }
-        mQueue.pop();
+        mQueue.pop_front();
     }
-    mQueue.push(fence);
+    mQueue.push_back(fence);
 }
 
 void FenceTimeline::updateSignalTimes() {
+    updateSignalTimes({this});
+}
+
+void FenceTimeline::updateSignalTimes(std::initializer_list<FenceTimeline*> timelines) {
+    std::vector<std::shared_ptr<FenceTime>> fences;
+    for (FenceTimeline* timeline : timelines) {
+        timeline->getPendingFences(&fences);
+    }
+
+    // Hold references to the fences so that their file descriptors stay open
+    // while polled, even if another thread gets the signal times meanwhile.
+    std::vector<sp<Fence>> pendingFences;
+    std::vector<struct pollfd> pollFds;
+    pendingFences.reserve(fences.size());
+    pollFds.reserve(fences.size());
+    for (const auto& fenceTime : fences) {
+        std::lock_guard<std::mutex> lock(fenceTime->mMutex);
+        pendingFences.push_back(fenceTime->mFence);
+        // A negative fd is skipped by poll; those only exist in tests, and
+        // are queried below as before.
+        pollFds.push_back({fenceTime->mFence.get() ? fenceTime->mFence->get() : -1, POLLIN, 0});
+    }
+
+    const bool polled = !pollFds.empty() && poll(pollFds.data(), pollFds.size(), 0) >= 0;
+    for (size_t i = 0; i < fences.size(); i++) {
+        // Only fences that signaled or errored out are worth a query, unless
+        // the poll itself failed.
+        if (!polled || pollFds[i].fd < 0 || pollFds[i].revents != 0) {
+            fences[i]->getSignalTime();
+        }
+    }
+
+    for (FenceTimeline* timeline : timelines) {
+        timeline->popSignaledFences();
+    }
+}
+
+void FenceTimeline::getPendingFences(std::vector<std::shared_ptr<FenceTime>>* fences) {
+    std::lock_guard<std::mutex> lock(mMutex);
+    for (const auto& entry : mQueue) {
+        std::shared_ptr<FenceTime> fence = entry.lock();
+        if (fence && fence->getCachedSignalTime() == Fence::SIGNAL_TIME_PENDING) {
+            fences->push_back(std::move(fence));
+        }
+    }
+}
+
+void FenceTimeline::popSignaledFences() {
     std::lock_guard<std::mutex> lock(mMutex);
     while (!mQueue.empty()) {
         std::shared_ptr<FenceTime> fence = mQueue.front().lock();
-        if (!fence) {
-            // The shared_ptr no longer exists and no one cares about the
-            // timestamp anymore.
-            mQueue.pop();
-            continue;
-        } else if (fence->getSignalTime() != Fence::SIGNAL_TIME_PENDING) {
-            // The fence has signaled and we've removed the sp<Fence> ref.
-            mQueue.pop();
-            continue;
-        } else {
-            // The fence didn't signal yet. Break since the later ones
-            // shouldn't have signaled either.
+        if (fence && fence->getCachedSignalTime() == Fence::SIGNAL_TIME_PENDING) {
+            // The fence didn't signal yet. Later fences may have, but they
+            // stay queued to keep the timeline in order.
             break;
         }
+        // Either no one cares about the timestamp anymore, or the fence has
+        // signaled and we've removed the sp<Fence> ref.
+        mQueue.pop_front();
     }
 }
 
@@ -208,19 +208,53 @@ status_t GraphicBuffer::initWithSize(uint32_t inWidth, uint32_t inHeight,
             inUsage, &handle, &outStride, mId,
             std::move(requestorName));
     if (err == NO_ERROR) {
-        mBufferMapper.getTransportSize(handle, &mTransportNumFds, &mTransportNumInts);
-
-        width = static_cast<int>(inWidth);
-        height = static_cast<int>(inHeight);
-        format = inFormat;
-        layerCount = inLayerCount;
-        usage = inUsage;
-        usage_deprecated = int(usage);
-        stride = static_cast<int>(outStride);
+        initWithAllocatedHandle(handle, inWidth, inHeight, inFormat, inLayerCount, inUsage,
+                                outStride);
     }
     return err;
 }
 
+void GraphicBuffer::initWithAllocatedHandle(buffer_handle_t inHandle, uint32_t inWidth,
+        uint32_t inHeight, PixelFormat inFormat, uint32_t inLayerCount,
+        uint64_t inUsage, uint32_t inStride)
+{
+    handle = inHandle;
+    mBufferMapper.getTransportSize(handle, &mTransportNumFds, &mTransportNumInts);
+
+    width = static_cast<int>(inWidth);
+    height = static_cast<int>(inHeight);
+    format = inFormat;
+    layerCount = inLayerCount;
+    usage = inUsage;
+    usage_deprecated = int(usage);
+    stride = static_cast<int>(inStride);
+}
+
+status_t GraphicBuffer::allocate(uint32_t inWidth, uint32_t inHeight, PixelFormat inFormat,
+        uint32_t inLayerCount, uint64_t inUsage, uint32_t count,
+        std::string requestorName, std::vector<sp<GraphicBuffer>>* outBuffers)
+{
+    GraphicBufferAllocator& allocator = GraphicBufferAllocator::get();
+    std::vector<buffer_handle_t> handles(count);
+    uint32_t outStride = 0;
+    status_t err = allocator.allocate(inWidth, inHeight, inFormat, inLayerCount,
+            inUsage, count, handles.data(), &outStride, std::move(requestorName));
+    if (err != NO_ERROR) {
+        return err;
+    }
+
+    outBuffers->clear();
+    outBuffers->reserve(count);
+    for (buffer_handle_t allocated : handles) {
+        // Owns the data like the buffers allocated by initWithSize.
+        sp<GraphicBuffer> buffer = new GraphicBuffer();
+        buffer->initWithAllocatedHandle(allocated, inWidth, inHeight, inFormat, inLayerCount,
+                                        inUsage, outStride);
+        outBuffers->push_back(std::move(buffer));
+    }
+    return NO_ERROR;
+}
+
 status_t GraphicBuffer::initWithHandle(const native_handle_t* inHandle, HandleWrapMethod method,
                                        uint32_t inWidth, uint32_t inHeight, PixelFormat inFormat,
                                        uint32_t inLayerCount, uint64_t inUsage, uint32_t inStride) {
@@ -538,7 +572,7 @@ status_t GraphicBuffer::unflatten(void const*& buffer, size_t& size, int const*&
 
     if (handle != nullptr) {
         buffer_handle_t importedHandle;
-        status_t err = mBufferMapper.importBuffer(handle, uint32_t(width), uint32_t(height),
+        status_t err = mBufferMapper.importBuffer(mId, handle, uint32_t(width), uint32_t(height),
                 uint32_t(layerCount), format, usage, uint32_t(stride), &importedHandle);
         if (err != NO_ERROR) {
             width = height = stride = format = usage_deprecated = 0;
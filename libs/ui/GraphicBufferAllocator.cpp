@@ -23,9 +23,13 @@
 #include <limits.h>
 #include <stdio.h>
 
+#include <algorithm>
+#include <iterator>
+
 #include <grallocusage/GrallocUsageConversion.h>
 
 #include <android-base/stringprintf.h>
+#include <hardware/gralloc.h>
 #include <log/log.h>
 #include <utils/Singleton.h>
 #include <utils/Trace.h>
@@ -61,6 +65,37 @@ GraphicBufferAllocator::GraphicBufferAllocator() : mMapper(GraphicBufferMapper::
 
 GraphicBufferAllocator::~GraphicBufferAllocator() {}
 
+void GraphicBufferAllocator::trimPoolLocked(nsecs_t now, std::vector<buffer_handle_t>* toFree) {
+    while (!mPool.empty() &&
+           (mPool.size() > mPoolCapacity || now - mPool.front().freeTime > kPoolTimeout)) {
+        toFree->push_back(mPool.front().handle);
+        mPool.pop_front();
+    }
+}
+
+void GraphicBufferAllocator::setPoolCapacity(size_t capacity) {
+    std::vector<buffer_handle_t> toFree;
+    {
+        Mutex::Autolock _l(sLock);
+        mPoolCapacity = capacity;
+        trimPoolLocked(systemTime(), &toFree);
+    }
+    for (buffer_handle_t pooled : toFree) {
+        mMapper.freeBuffer(pooled);
+    }
+}
+
+void GraphicBufferAllocator::releasePooledBuffers() {
+    std::deque<pooled_buffer_t> pool;
+    {
+        Mutex::Autolock _l(sLock);
+        pool.swap(mPool);
+    }
+    for (const pooled_buffer_t& pooled : pool) {
+        mMapper.freeBuffer(pooled.handle);
+    }
+}
+
 size_t GraphicBufferAllocator::getTotalSize() const {
     Mutex::Autolock _l(sLock);
     size_t total = 0;
@@ -93,6 +128,21 @@ void GraphicBufferAllocator::dump(std::string& result) const {
     }
     StringAppendF(&result, "Total allocated (estimate): %.2f KB\n", total / 1024.0);
 
+    size_t pooled = 0;
+    for (const pooled_buffer_t& buffer : mPool) {
+        pooled += buffer.rec.size;
+    }
+    StringAppendF(&result, "Pooled buffers: %zu of %zu (%.2f KB)\n", mPool.size(), mPoolCapacity,
+                  pooled / 1024.0);
+    const uint64_t halAllocationCount = mAllocationCount - mPoolHitCount;
+    StringAppendF(&result,
+                  "Allocations: %" PRIu64 " (%" PRIu64 " from pool), gralloc latency avg %.3f ms "
+                  "max %.3f ms\n",
+                  mAllocationCount, mPoolHitCount,
+                  halAllocationCount ? ns2us(mTotalAllocationTime / halAllocationCount) / 1000.0
+                                     : 0.0,
+                  ns2us(mMaxAllocationTime) / 1000.0);
+
     result.append(mAllocator->dumpDebugInfo());
 }
 
@@ -107,9 +157,22 @@ status_t GraphicBufferAllocator::allocate(uint32_t width, uint32_t height,
         PixelFormat format, uint32_t layerCount, uint64_t usage,
         buffer_handle_t* handle, uint32_t* stride,
         uint64_t /*graphicBufferId*/, std::string requestorName)
+{
+    return allocate(width, height, format, layerCount, usage, 1, handle, stride,
+                    std::move(requestorName));
+}
+
+status_t GraphicBufferAllocator::allocate(uint32_t width, uint32_t height,
+        PixelFormat format, uint32_t layerCount, uint64_t usage,
+        uint32_t bufferCount, buffer_handle_t* handles, uint32_t* stride,
+        std::string requestorName)
 {
     ATRACE_CALL();
 
+    if (bufferCount == 0) {
+        return BAD_VALUE;
+    }
+
     // make sure to not allocate a N x 0 or 0 x N buffer, since this is
     // allowed from an API stand-point allocate a 1x1 buffer instead.
     if (!width || !height)
@@ -132,8 +195,45 @@ status_t GraphicBufferAllocator::allocate(uint32_t width, uint32_t height,
     usage &= ~static_cast<uint64_t>((1 << 10) | (1 << 13));
 #endif
 
-    status_t error =
-            mAllocator->allocate(width, height, format, layerCount, usage, 1, stride, handle);
+    uint32_t pooledCount = 0;
+    std::vector<buffer_handle_t> toFree;
+    {
+        Mutex::Autolock _l(sLock);
+        trimPoolLocked(systemTime(), &toFree);
+
+        // The most recently freed matches are the most likely to still be cached.
+        // A buffer only goes back to the requestor it was freed by, since it
+        // keeps its contents and any other process it was shared with.
+        for (auto it = mPool.rbegin(); it != mPool.rend() && pooledCount < bufferCount;) {
+            const alloc_rec_t& rec = it->rec;
+            if (rec.width == width && rec.height == height && rec.format == format &&
+                rec.layerCount == layerCount && rec.usage == usage &&
+                rec.requestorName == requestorName) {
+                handles[pooledCount++] = it->handle;
+                *stride = rec.stride;
+                alloc_rec_t reused = rec;
+                reused.requestorName = requestorName;
+                sAllocList.add(it->handle, reused);
+                it = std::make_reverse_iterator(mPool.erase(std::next(it).base()));
+                mAllocationCount++;
+                mPoolHitCount++;
+            } else {
+                ++it;
+            }
+        }
+    }
+    for (buffer_handle_t pooled : toFree) {
+        mMapper.freeBuffer(pooled);
+    }
+    if (pooledCount == bufferCount) {
+        return NO_ERROR;
+    }
+
+    const uint32_t allocationCount = bufferCount - pooledCount;
+    const nsecs_t allocationStart = systemTime();
+    status_t error = mAllocator->allocate(width, height, format, layerCount, usage,
+                                          allocationCount, stride, handles + pooledCount);
+    const nsecs_t allocationTime = systemTime() - allocationStart;
     size_t bufSize;
 
     // if stride has no meaning or is too large,
@@ -157,14 +257,24 @@ status_t GraphicBufferAllocator::allocate(uint32_t width, uint32_t height,
         rec.usage = usage;
         rec.size = bufSize;
         rec.requestorName = std::move(requestorName);
-        list.add(*handle, rec);
+        for (uint32_t i = pooledCount; i < bufferCount; i++) {
+            list.add(handles[i], rec);
+        }
+
+        mAllocationCount += allocationCount;
+        mTotalAllocationTime += allocationTime;
+        mMaxAllocationTime = std::max(mMaxAllocationTime, allocationTime);
 
         return NO_ERROR;
     } else {
-        ALOGE("Failed to allocate (%u x %u) layerCount %u format %d "
+        ALOGE("Failed to allocate %u x (%u x %u) layerCount %u format %d "
                 "usage %" PRIx64 ": %d",
-                width, height, layerCount, format, usage,
+                allocationCount, width, height, layerCount, format, usage,
                 error);
+        // Give the buffers taken from the pool back.
+        for (uint32_t i = 0; i < pooledCount; i++) {
+            free(handles[i]);
+        }
         return NO_MEMORY;
     }
 }
@@ -173,13 +283,28 @@ status_t GraphicBufferAllocator::free(buffer_handle_t handle)
 {
     ATRACE_CALL();
 
+    std::vector<buffer_handle_t> toFree;
+    {
+        Mutex::Autolock _l(sLock);
+        KeyedVector<buffer_handle_t, alloc_rec_t>& list(sAllocList);
+        const ssize_t index = list.indexOfKey(handle);
+        if (mPoolCapacity && index >= 0 &&
+            !(list.valueAt(index).usage & GRALLOC_USAGE_PROTECTED)) {
+            const nsecs_t now = systemTime();
+            mPool.push_back({handle, list.valueAt(index), now});
+            list.removeItemsAt(index);
+            trimPoolLocked(now, &toFree);
+        } else {
+            list.removeItem(handle);
+            toFree.push_back(handle);
+        }
+    }
+
     // We allocated a buffer from the allocator and imported it into the
     // mapper to get the handle.  We just need to free the handle now.
-    mMapper.freeBuffer(handle);
-
-    Mutex::Autolock _l(sLock);
-    KeyedVector<buffer_handle_t, alloc_rec_t>& list(sAllocList);
-    list.removeItem(handle);
+    for (buffer_handle_t freed : toFree) {
+        mMapper.freeBuffer(freed);
+    }
 
     return NO_ERROR;
 }
@@ -20,6 +20,11 @@
 
 #include <ui/GraphicBufferMapper.h>
 
+#include <pthread.h>
+#include <sys/stat.h>
+
+#include <thread>
+
 #include <grallocusage/GrallocUsageConversion.h>
 
 // We would eliminate the non-conforming zero-length array, but we can't since
@@ -90,6 +95,73 @@ status_t GraphicBufferMapper::importBuffer(buffer_handle_t rawHandle,
     return NO_ERROR;
 }
 
+// The identities of the fds of a handle, or an empty vector if any of them
+// can't be told.
+static std::vector<std::pair<dev_t, ino_t>> getFdIdentities(buffer_handle_t handle) {
+    std::vector<std::pair<dev_t, ino_t>> identities;
+    identities.reserve(handle->numFds);
+    for (int i = 0; i < handle->numFds; i++) {
+        struct stat st;
+        if (fstat(handle->data[i], &st) != 0) {
+            return {};
+        }
+        identities.emplace_back(st.st_dev, st.st_ino);
+    }
+    return identities;
+}
+
+status_t GraphicBufferMapper::importBuffer(uint64_t bufferId, buffer_handle_t rawHandle,
+        uint32_t width, uint32_t height, uint32_t layerCount,
+        PixelFormat format, uint64_t usage, uint32_t stride,
+        buffer_handle_t* outHandle)
+{
+    ATRACE_CALL();
+
+    // The id alone is not to be trusted, since it comes from the sender: the
+    // import is only shared if the handle's fds are those of the buffer already
+    // imported, and it is described the same way.
+    std::vector<std::pair<dev_t, ino_t>> fdIdentities = getFdIdentities(rawHandle);
+    if (fdIdentities.empty()) {
+        return importBuffer(rawHandle, width, height, layerCount, format, usage, stride,
+                            outHandle);
+    }
+
+    auto matches = [&](const SharedImport& shared) {
+        return shared.fdIdentities == fdIdentities && shared.width == width &&
+                shared.height == height && shared.layerCount == layerCount &&
+                shared.format == format && shared.usage == usage && shared.stride == stride;
+    };
+
+    {
+        std::lock_guard<std::mutex> lock(mSharedImportsMutex);
+        auto it = mSharedImports.find(bufferId);
+        if (it != mSharedImports.end() && matches(it->second)) {
+            it->second.refCount++;
+            *outHandle = it->second.handle;
+            return NO_ERROR;
+        }
+    }
+
+    // The import itself is done without the lock, so that imports of other
+    // buffers don't wait for it.
+    status_t error = importBuffer(rawHandle, width, height, layerCount, format, usage, stride,
+                                  outHandle);
+    if (error != NO_ERROR) {
+        return error;
+    }
+
+    // If the id is taken, by another buffer or by the same one imported
+    // concurrently, this import is simply not shared.
+    std::lock_guard<std::mutex> lock(mSharedImportsMutex);
+    if (mSharedImports.count(bufferId) == 0) {
+        mSharedImports.emplace(bufferId,
+                               SharedImport{*outHandle, std::move(fdIdentities), width, height,
+                                            layerCount, format, usage, stride, 1});
+        mSharedImportIds.emplace(*outHandle, bufferId);
+    }
+    return NO_ERROR;
+}
+
 void GraphicBufferMapper::getTransportSize(buffer_handle_t handle,
             uint32_t* outTransportNumFds, uint32_t* outTransportNumInts)
 {
@@ -100,6 +172,19 @@ status_t GraphicBufferMapper::freeBuffer(buffer_handle_t handle)
 {
     ATRACE_CALL();
 
+    {
+        std::lock_guard<std::mutex> lock(mSharedImportsMutex);
+        auto id = mSharedImportIds.find(handle);
+        if (id != mSharedImportIds.end()) {
+            auto shared = mSharedImports.find(id->second);
+            if (--shared->second.refCount > 0) {
+                return NO_ERROR;
+            }
+            mSharedImports.erase(shared);
+            mSharedImportIds.erase(id);
+        }
+    }
+
     mMapper->freeBuffer(handle);
 
     return NO_ERROR;
@@ -164,6 +249,59 @@ status_t GraphicBufferMapper::unlockAsync(buffer_handle_t handle, int *fenceFd)
     return NO_ERROR;
 }
 
+std::future<GraphicBufferMapper::LockResult> GraphicBufferMapper::scheduleLock(
+        buffer_handle_t handle, uint64_t usage, const Rect& bounds, int fenceFd) {
+    return scheduleLockTask([this, handle, usage, bounds, fenceFd]() {
+        ATRACE_NAME("GraphicBufferMapper::scheduledLock");
+        LockResult result;
+        result.error = mMapper->lock(handle, usage, bounds, fenceFd, &result.vaddr,
+                                     &result.bytesPerPixel, &result.bytesPerStride);
+        return result;
+    });
+}
+
+std::future<GraphicBufferMapper::LockResult> GraphicBufferMapper::scheduleLockYCbCr(
+        buffer_handle_t handle, uint64_t usage, const Rect& bounds, int fenceFd) {
+    return scheduleLockTask([this, handle, usage, bounds, fenceFd]() {
+        ATRACE_NAME("GraphicBufferMapper::scheduledLockYCbCr");
+        LockResult result;
+        result.error = mMapper->lock(handle, usage, bounds, fenceFd, &result.ycbcr);
+        return result;
+    });
+}
+
+std::future<GraphicBufferMapper::LockResult> GraphicBufferMapper::scheduleLockTask(
+        std::function<LockResult()> lockFunction) {
+    std::packaged_task<LockResult()> task(std::move(lockFunction));
+    std::future<LockResult> future = task.get_future();
+
+    std::lock_guard<std::mutex> lock(mLockQueueMutex);
+    mLockQueue.push_back(std::move(task));
+    if (!mLockWorkerStarted) {
+        // The mapper is a singleton that is never destroyed, so the worker
+        // can outlive every caller.
+        std::thread(&GraphicBufferMapper::lockWorkerLoop, this).detach();
+        mLockWorkerStarted = true;
+    }
+    mLockQueueCondition.notify_one();
+    return future;
+}
+
+void GraphicBufferMapper::lockWorkerLoop() {
+    pthread_setname_np(pthread_self(), "GBMapperLock");
+
+    std::unique_lock<std::mutex> lock(mLockQueueMutex);
+    while (true) {
+        mLockQueueCondition.wait(lock, [this]() { return !mLockQueue.empty(); });
+        std::packaged_task<LockResult()> task = std::move(mLockQueue.front());
+        mLockQueue.pop_front();
+
+        lock.unlock();
+        task();
+        lock.lock();
+    }
+}
+
 status_t GraphicBufferMapper::isSupported(uint32_t width, uint32_t height,
                                           android::PixelFormat format, uint32_t layerCount,
                                           uint64_t usage, bool* outSupported) {
@@ -19,6 +19,8 @@
 #include <inttypes.h>
 #include <limits.h>
 
+#include <utility>
+
 #include <android-base/stringprintf.h>
 
 #include <utils/Log.h>
@@ -68,7 +70,7 @@ const Region Region::INVALID_REGION(Rect::INVALID_RECT);
 // ----------------------------------------------------------------------------
 
 Region::Region() {
-    mStorage.add(Rect(0,0));
+    mStorage.push_back(Rect(0,0));
 }
 
 Region::Region(const Region& rhs)
@@ -79,8 +81,18 @@ Region::Region(const Region& rhs)
 #endif
 }
 
+Region::Region(Region&& rhs) noexcept
+    : mStorage(std::move(rhs.mStorage))
+{
+#if defined(VALIDATE_REGIONS)
+    validate(*this, "rhs move-ctor");
+#endif
+    // leave rhs as a valid, empty region
+    rhs.mStorage.push_back(Rect(0,0));
+}
+
 Region::Region(const Rect& rhs) {
-    mStorage.add(rhs);
+    mStorage.push_back(rhs);
 }
 
 Region::~Region()
@@ -101,8 +113,9 @@ Region::~Region()
  * final, correctly ordered region buffer. Each rectangle will be compared with the span directly
  * above it, and subdivided to resolve any remaining T-junctions.
  */
+template<typename STORAGE>
 static void reverseRectsResolvingJunctions(const Rect* begin, const Rect* end,
-        Vector<Rect>& dst, int spanDirection) {
+        STORAGE& dst, int spanDirection) {
     dst.clear();
 
     const Rect* current = end - 1;
@@ -110,7 +123,7 @@ static void reverseRectsResolvingJunctions(const Rect* begin, const Rect* end,
 
     // add first span immediately
     do {
-        dst.add(*current);
+        dst.push_back(*current);
         current--;
     } while (current->top == lastTop && current >= begin);
 
@@ -148,12 +161,12 @@ static void reverseRectsResolvingJunctions(const Rect* begin, const Rect* end,
                 if (prev.right <= left) break;
 
                 if (prev.right > left && prev.right < right) {
-                    dst.add(Rect(prev.right, top, right, bottom));
+                    dst.push_back(Rect(prev.right, top, right, bottom));
                     right = prev.right;
                 }
 
                 if (prev.left > left && prev.left < right) {
-                    dst.add(Rect(prev.left, top, right, bottom));
+                    dst.push_back(Rect(prev.left, top, right, bottom));
                     right = prev.left;
                 }
 
@@ -167,12 +180,12 @@ static void reverseRectsResolvingJunctions(const Rect* begin, const Rect* end,
                 if (prev.left >= right) break;
 
                 if (prev.left > left && prev.left < right) {
-                    dst.add(Rect(left, top, prev.left, bottom));
+                    dst.push_back(Rect(left, top, prev.left, bottom));
                     left = prev.left;
                 }
 
                 if (prev.right > left && prev.right < right) {
-                    dst.add(Rect(left, top, prev.right, bottom));
+                    dst.push_back(Rect(left, top, prev.right, bottom));
                     left = prev.right;
                 }
                 // if an entry in the previous span is too far left, nothing further right in the
@@ -184,7 +197,7 @@ static void reverseRectsResolvingJunctions(const Rect* begin, const Rect* end,
         }
 
         if (left < right) {
-            dst.add(Rect(left, top, right, bottom));
+            dst.push_back(Rect(left, top, right, bottom));
         }
 
         current--;
@@ -202,13 +215,13 @@ Region Region::createTJunctionFreeRegion(const Region& r) {
     if (r.isEmpty()) return r;
     if (r.isRect()) return r;
 
-    Vector<Rect> reversed;
+    FatVector<Rect, 16> reversed;
     reverseRectsResolvingJunctions(r.begin(), r.end(), reversed, direction_RTL);
 
     Region outputRegion;
     reverseRectsResolvingJunctions(reversed.begin(), reversed.end(),
             outputRegion.mStorage, direction_LTR);
-    outputRegion.mStorage.add(r.getBounds()); // to make region valid, mStorage must end with bounds
+    outputRegion.mStorage.push_back(r.getBounds()); // to make region valid, mStorage must end with bounds
 
 #if defined(VALIDATE_REGIONS)
     validate(outputRegion, "T-Junction free region");
@@ -227,12 +240,24 @@ Region& Region::operator = (const Region& rhs)
     return *this;
 }
 
+Region& Region::operator = (Region&& rhs) noexcept
+{
+#if defined(VALIDATE_REGIONS)
+    validate(rhs, "rhs.operator=(&&)");
+#endif
+    if (this != &rhs) {
+        mStorage = std::move(rhs.mStorage);
+        rhs.mStorage.push_back(Rect(0,0));
+    }
+    return *this;
+}
+
 Region& Region::makeBoundsSelf()
 {
     if (mStorage.size() >= 2) {
         const Rect bounds(getBounds());
         mStorage.clear();
-        mStorage.add(bounds);
+        mStorage.push_back(bounds);
     }
     return *this;
 }
@@ -256,38 +281,50 @@ bool Region::contains(int x, int y) const {
 void Region::clear()
 {
     mStorage.clear();
-    mStorage.add(Rect(0,0));
+    mStorage.push_back(Rect(0,0));
 }
 
 void Region::set(const Rect& r)
 {
     mStorage.clear();
-    mStorage.add(r);
+    mStorage.push_back(r);
 }
 
 void Region::set(int32_t w, int32_t h)
 {
     mStorage.clear();
-    mStorage.add(Rect(w, h));
+    mStorage.push_back(Rect(w, h));
 }
 
 void Region::set(uint32_t w, uint32_t h)
 {
     mStorage.clear();
-    mStorage.add(Rect(w, h));
+    mStorage.push_back(Rect(w, h));
 }
 
 bool Region::isTriviallyEqual(const Region& region) const {
     return begin() == region.begin();
 }
 
+bool Region::hasSameRects(const Region& region) const {
+    if (mStorage.size() != region.mStorage.size()) {
+        return false;
+    }
+    for (size_t i = 0; i < mStorage.size(); i++) {
+        if (mStorage[i] != region.mStorage[i]) {
+            return false;
+        }
+    }
+    return true;
+}
+
 // ----------------------------------------------------------------------------
 
 void Region::addRectUnchecked(int l, int t, int r, int b)
 {
     Rect rect(l,t,r,b);
     size_t where = mStorage.size() - 1;
-    mStorage.insertAt(rect, where, 1);
+    mStorage.insert(where, rect);
 }
 
 // ----------------------------------------------------------------------------
@@ -305,8 +342,11 @@ Region& Region::subtractSelf(const Rect& r) {
     return operationSelf(r, op_nand);
 }
 Region& Region::operationSelf(const Rect& r, uint32_t op) {
-    Region lhs(*this);
-    boolean_operation(op, *this, lhs, r);
+    // the rasterizer rebuilds our storage, so move it out of the way first;
+    // r may point into that storage
+    const Rect rhs(r);
+    Region lhs(std::move(*this));
+    boolean_operation(op, *this, lhs, rhs);
     return *this;
 }
 
@@ -325,7 +365,8 @@ Region& Region::subtractSelf(const Region& rhs) {
     return operationSelf(rhs, op_nand);
 }
 Region& Region::operationSelf(const Region& rhs, uint32_t op) {
-    Region lhs(*this);
+    // rhs may be ourselves, in which case it has to stay intact
+    Region lhs(&rhs == this ? Region(*this) : std::move(*this));
     boolean_operation(op, *this, lhs, rhs);
     return *this;
 }
@@ -337,7 +378,7 @@ Region& Region::translateSelf(int x, int y) {
 
 Region& Region::scaleSelf(float sx, float sy) {
     size_t count = mStorage.size();
-    Rect* rects = mStorage.editArray();
+    Rect* rects = mStorage.data();
     while (count) {
         rects->left = static_cast<int32_t>(rects->left * sx + 0.5f);
         rects->right = static_cast<int32_t>(rects->right * sx + 0.5f);
@@ -410,7 +451,7 @@ Region& Region::subtractSelf(const Region& rhs, int dx, int dy) {
     return operationSelf(rhs, dx, dy, op_nand);
 }
 Region& Region::operationSelf(const Region& rhs, int dx, int dy, uint32_t op) {
-    Region lhs(*this);
+    Region lhs(&rhs == this ? Region(*this) : std::move(*this));
     boolean_operation(op, *this, lhs, rhs, dx, dy);
     return *this;
 }
@@ -442,10 +483,10 @@ const Region Region::operation(const Region& rhs, int dx, int dy, uint32_t op) c
 class Region::rasterizer : public region_operator<Rect>::region_rasterizer
 {
     Rect bounds;
-    Vector<Rect>& storage;
+    FatVector<Rect, 4>& storage;
     Rect* head;
     Rect* tail;
-    Vector<Rect> span;
+    FatVector<Rect, 16> span;
     Rect* cur;
 public:
     explicit rasterizer(Region& reg)
@@ -472,8 +513,8 @@ Region::rasterizer::~rasterizer()
         flushSpan();
     }
     if (storage.size()) {
-        bounds.top = storage.itemAt(0).top;
-        bounds.bottom = storage.top().bottom;
+        bounds.top = storage[0].top;
+        bounds.bottom = storage.back().bottom;
         if (storage.size() == 1) {
             storage.clear();
         }
@@ -481,7 +522,7 @@ Region::rasterizer::~rasterizer()
         bounds.left  = 0;
         bounds.right = 0;
     }
-    storage.add(bounds);
+    storage.push_back(bounds);
 }
 
 void Region::rasterizer::operator()(const Rect& rect)
@@ -496,26 +537,18 @@ void Region::rasterizer::operator()(const Rect& rect)
             return;
         }
     }
-    span.add(rect);
-    cur = span.editArray() + (span.size() - 1);
+    span.push_back(rect);
+    cur = span.data() + (span.size() - 1);
 }
 
 void Region::rasterizer::flushSpan()
 {
     bool merge = false;
     if (tail-head == ssize_t(span.size())) {
-        Rect const* p = span.editArray();
+        Rect const* p = span.data();
         Rect const* q = head;
         if (p->top == q->bottom) {
-            merge = true;
-            while (q != tail) {
-                if ((p->left != q->left) || (p->right != q->right)) {
-                    merge = false;
-                    break;
-                }
-                p++;
-                q++;
-            }
+            merge = same_horizontal_edges(p, q, span.size());
         }
     }
     if (merge) {
@@ -526,10 +559,10 @@ void Region::rasterizer::flushSpan()
             r++;
         }
     } else {
-        bounds.left = min(span.itemAt(0).left, bounds.left);
-        bounds.right = max(span.top().right, bounds.right);
-        storage.appendVector(span);
-        tail = storage.editArray() + storage.size();
+        bounds.left = min(span[0].left, bounds.left);
+        bounds.right = max(span.back().right, bounds.right);
+        storage.append(span.data(), span.size());
+        tail = storage.data() + storage.size();
         head = tail - span.size();
     }
     span.clear();
@@ -537,7 +570,7 @@ void Region::rasterizer::flushSpan()
 
 bool Region::validate(const Region& reg, const char* name, bool silent)
 {
-    if (reg.mStorage.isEmpty()) {
+    if (reg.mStorage.empty()) {
         ALOGE_IF(!silent, "%s: mStorage is empty, which is never valid", name);
         // return immediately as the code below assumes mStorage is non-empty
         return false;
@@ -615,6 +648,72 @@ bool Region::validate(const Region& reg, const char* name, bool silent)
     return result;
 }
 
+bool Region::trivial_operation(uint32_t op, Region& dst,
+        const Region& lhs, const Region* rhs, const Rect& rhsBounds,
+        bool rhsIsRect, int dx, int dy)
+{
+    const Rect lhsBounds(lhs.getBounds());
+    const bool lhsEmpty = lhsBounds.isEmpty();
+    const bool rhsEmpty = rhsBounds.isEmpty();
+    const bool disjoint = lhsEmpty || rhsEmpty ||
+            lhsBounds.left >= rhsBounds.right || rhsBounds.left >= lhsBounds.right ||
+            lhsBounds.top >= rhsBounds.bottom || rhsBounds.top >= lhsBounds.bottom;
+    auto covers = [](const Rect& outer, const Rect& inner) {
+        return outer.left <= inner.left && outer.top <= inner.top &&
+                outer.right >= inner.right && outer.bottom >= inner.bottom;
+    };
+    auto setRhs = [&]() {
+        if (rhs) {
+            translate(dst, *rhs, dx, dy);
+        } else {
+            dst.set(rhsBounds);
+        }
+    };
+
+    switch (op) {
+        case op_or:
+        case op_xor:
+            if (rhsEmpty) {
+                dst = lhs;
+                return true;
+            }
+            if (lhsEmpty) {
+                setRhs();
+                return true;
+            }
+            return false;
+        case op_and:
+            if (disjoint) {
+                dst.clear();
+                return true;
+            }
+            if (rhsIsRect && covers(rhsBounds, lhsBounds)) {
+                dst = lhs;
+                return true;
+            }
+            if (lhs.isRect() && covers(lhsBounds, rhsBounds)) {
+                setRhs();
+                return true;
+            }
+            return false;
+        case op_nand:
+            if (lhsEmpty) {
+                dst.clear();
+                return true;
+            }
+            if (disjoint) {
+                dst = lhs;
+                return true;
+            }
+            if (rhsIsRect && covers(rhsBounds, lhsBounds)) {
+                dst.clear();
+                return true;
+            }
+            return false;
+    }
+    return false;
+}
+
 void Region::boolean_operation(uint32_t op, Region& dst,
         const Region& lhs,
         const Region& rhs, int dx, int dy)
@@ -625,6 +724,13 @@ void Region::boolean_operation(uint32_t op, Region& dst,
     validate(dst, "boolean_operation (before): dst");
 #endif
 
+#if !VALIDATE_WITH_CORECG
+    if (trivial_operation(op, dst, lhs, &rhs, Rect(rhs.getBounds()).offsetBy(dx, dy),
+            rhs.isRect(), dx, dy)) {
+        return;
+    }
+#endif
+
     size_t lhs_count;
     Rect const * const lhs_rects = lhs.getArray(&lhs_count);
 
@@ -740,6 +846,10 @@ void Region::boolean_operation(uint32_t op, Region& dst,
 #if VALIDATE_WITH_CORECG || defined(VALIDATE_REGIONS)
     boolean_operation(op, dst, lhs, Region(rhs), dx, dy);
 #else
+    if (trivial_operation(op, dst, lhs, nullptr, Rect(rhs).offsetBy(dx, dy), true, dx, dy)) {
+        return;
+    }
+
     size_t lhs_count;
     Rect const * const lhs_rects = lhs.getArray(&lhs_count);
 
@@ -773,7 +883,7 @@ void Region::translate(Region& reg, int dx, int dy)
         validate(reg, "translate (before)");
 #endif
         size_t count = reg.mStorage.size();
-        Rect* rects = reg.mStorage.editArray();
+        Rect* rects = reg.mStorage.data();
         while (count) {
             rects->offsetBy(dx, dy);
             rects++;
@@ -853,24 +963,24 @@ status_t Region::unflatten(void const* buffer, size_t size) {
         ALOGE("Region::unflatten() failed, invalid region");
         return BAD_VALUE;
     }
-    mStorage = result.mStorage;
+    mStorage = std::move(result.mStorage);
     return NO_ERROR;
 }
 
 // ----------------------------------------------------------------------------
 
 Region::const_iterator Region::begin() const {
-    return mStorage.array();
+    return mStorage.data();
 }
 
 Region::const_iterator Region::end() const {
     // Workaround for b/77643177
     // mStorage should never be empty, but somehow it is and it's causing
     // an abort in ubsan
-    if (mStorage.isEmpty()) return mStorage.array();
+    if (mStorage.empty()) return mStorage.data();
 
     size_t numRects = isRect() ? 1 : mStorage.size() - 1;
-    return mStorage.array() + numRects;
+    return mStorage.data() + numRects;
 }
 
 Rect const* Region::getArray(size_t* count) const {
@@ -16,12 +16,18 @@
 
 #include <math.h>
 
+#if defined(__aarch64__)
+#include <arm_neon.h>
+#endif
+
 #include <android-base/stringprintf.h>
 #include <cutils/compiler.h>
 #include <ui/Region.h>
 #include <ui/Transform.h>
 #include <utils/String8.h>
 
+#include <vector>
+
 namespace android {
 namespace ui {
 
@@ -84,6 +90,11 @@ Transform& Transform::operator=(const Transform& other) {
     return *this;
 }
 
+bool Transform::operator==(const Transform& other) const {
+    return mMatrix[0] == other.mMatrix[0] && mMatrix[1] == other.mMatrix[1] &&
+            mMatrix[2] == other.mMatrix[2];
+}
+
 const vec3& Transform::operator [] (size_t i) const {
     return mMatrix[i];
 }
@@ -208,6 +219,11 @@ Rect Transform::makeBounds(int w, int h) const
 Rect Transform::transform(const Rect& bounds, bool roundOutwards) const
 {
     Rect r;
+    if (CC_LIKELY(preserveRects())) {
+        transform(&bounds, 1, &r, roundOutwards);
+        return r;
+    }
+
     vec2 lt( bounds.left,  bounds.top    );
     vec2 rt( bounds.right, bounds.top    );
     vec2 lb( bounds.left,  bounds.bottom );
@@ -233,8 +249,97 @@ Rect Transform::transform(const Rect& bounds, bool roundOutwards) const
     return r;
 }
 
+void Transform::transform(const Rect* rects, size_t count, Rect* outRects,
+                          bool roundOutwards) const {
+    if (CC_UNLIKELY(!preserveRects())) {
+        for (size_t i = 0; i < count; i++) {
+            outRects[i] = transform(rects[i], roundOutwards);
+        }
+    } else if (getOrientation() & ROT_90) {
+        transformAlignedRects<true>(rects, count, outRects, roundOutwards);
+    } else {
+        transformAlignedRects<false>(rects, count, outRects, roundOutwards);
+    }
+}
+
+// A transform that preserves rects maps the left and right edges of a rect
+// to its new left and right edges, or to its top and bottom edges when it is
+// ROTATED by 90 degrees, so each edge takes a single multiply and add, and
+// the top-left and bottom-right corners are enough to bound the result.
+template <bool ROTATED>
+void Transform::transformAlignedRects(const Rect* rects, size_t count, Rect* outRects,
+                                      bool roundOutwards) const {
+    const mat33& M(mMatrix);
+    const float sx = ROTATED ? M[1][0] : M[0][0];
+    const float sy = ROTATED ? M[0][1] : M[1][1];
+    const float x = M[2][0];
+    const float y = M[2][1];
+
+    size_t i = 0;
+#if defined(__aarch64__)
+    static_assert(sizeof(Rect) == 4 * sizeof(int32_t), "Rect must be {left, top, right, bottom}");
+    // Transform the four edges of a rect per iteration.
+    const float scaleLanes[4] = { sx, sy, sx, sy };
+    const float offsetLanes[4] = { x, y, x, y };
+    const float32x4_t scale = vld1q_f32(scaleLanes);
+    const float32x4_t offset = vld1q_f32(offsetLanes);
+    const float32x2_t half = vdup_n_f32(0.5f);
+    for (; i < count; i++) {
+        int32x4_t edges = vld1q_s32(reinterpret_cast<const int32_t*>(rects + i));
+        if (ROTATED) {
+            // { left, top, right, bottom } -> { top, left, bottom, right }
+            edges = vrev64q_s32(edges);
+        }
+        const float32x4_t v = vfmaq_f32(offset, vcvtq_f32_s32(edges), scale);
+        float32x2_t lt = vmin_f32(vget_low_f32(v), vget_high_f32(v));
+        float32x2_t rb = vmax_f32(vget_low_f32(v), vget_high_f32(v));
+        if (roundOutwards) {
+            lt = vrndm_f32(lt);
+            rb = vrndp_f32(rb);
+        } else {
+            lt = vrndm_f32(vadd_f32(lt, half));
+            rb = vrndm_f32(vadd_f32(rb, half));
+        }
+        vst1q_s32(reinterpret_cast<int32_t*>(outRects + i), vcvtq_s32_f32(vcombine_f32(lt, rb)));
+    }
+#endif
+    for (; i < count; i++) {
+        const Rect& in = rects[i];
+        const float x0 = sx * (ROTATED ? in.top : in.left) + x;
+        const float x1 = sx * (ROTATED ? in.bottom : in.right) + x;
+        const float y0 = sy * (ROTATED ? in.left : in.top) + y;
+        const float y1 = sy * (ROTATED ? in.right : in.bottom) + y;
+
+        Rect& r = outRects[i];
+        if (roundOutwards) {
+            r.left   = static_cast<int32_t>(floorf(std::min(x0, x1)));
+            r.top    = static_cast<int32_t>(floorf(std::min(y0, y1)));
+            r.right  = static_cast<int32_t>(ceilf(std::max(x0, x1)));
+            r.bottom = static_cast<int32_t>(ceilf(std::max(y0, y1)));
+        } else {
+            r.left   = static_cast<int32_t>(floorf(std::min(x0, x1) + 0.5f));
+            r.top    = static_cast<int32_t>(floorf(std::min(y0, y1) + 0.5f));
+            r.right  = static_cast<int32_t>(floorf(std::max(x0, x1) + 0.5f));
+            r.bottom = static_cast<int32_t>(floorf(std::max(y0, y1) + 0.5f));
+        }
+    }
+}
+
 FloatRect Transform::transform(const FloatRect& bounds) const
 {
+    if (CC_LIKELY(preserveRects())) {
+        const mat33& M(mMatrix);
+        const bool rotated = getOrientation() & ROT_90;
+        const float sx = rotated ? M[1][0] : M[0][0];
+        const float sy = rotated ? M[0][1] : M[1][1];
+        const float x0 = sx * (rotated ? bounds.top : bounds.left) + M[2][0];
+        const float x1 = sx * (rotated ? bounds.bottom : bounds.right) + M[2][0];
+        const float y0 = sy * (rotated ? bounds.left : bounds.top) + M[2][1];
+        const float y1 = sy * (rotated ? bounds.right : bounds.bottom) + M[2][1];
+        return FloatRect(std::min(x0, x1), std::min(y0, y1), std::max(x0, x1),
+                         std::max(y0, y1));
+    }
+
     vec2 lt(bounds.left, bounds.top);
     vec2 rt(bounds.right, bounds.top);
     vec2 lb(bounds.left, bounds.bottom);
@@ -259,10 +364,12 @@ Region Transform::transform(const Region& reg) const
     Region out;
     if (CC_UNLIKELY(type() > TRANSLATE)) {
         if (CC_LIKELY(preserveRects())) {
-            Region::const_iterator it = reg.begin();
-            Region::const_iterator const end = reg.end();
-            while (it != end) {
-                out.orSelf(transform(*it++));
+            size_t count;
+            Rect const* rects = reg.getArray(&count);
+            std::vector<Rect> transformed(count);
+            transform(rects, count, transformed.data());
+            for (const Rect& rect : transformed) {
+                out.orSelf(rect);
             }
         } else {
             out.set(transform(reg.bounds()));
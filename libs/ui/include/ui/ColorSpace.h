@@ -253,6 +253,28 @@ public:
     static std::unique_ptr<float3[]> createLUT(uint32_t size, const ColorSpace& src,
                                                const ColorSpace& dst);
 
+    // Returns the 3D LUT createLUT would create, shared with the earlier calls
+    // for the same size and color spaces, so that the LUTs converting between
+    // the same color spaces are only computed once per process
+    // Color spaces are told apart by their name, RGB->XYZ matrix and transfer
+    // parameters, so color spaces with custom transfer functions must have
+    // distinct names
+    static std::shared_ptr<const float3[]> getLUT(uint32_t size, const ColorSpace& src,
+                                                  const ColorSpace& dst);
+
+    // Creates a 1D LUT of N entries, where N is the specified size
+    // (min=2, max=4096), sampling the EOTF (toLinear) or the OETF
+    // (fromLinear) of the color space over the domain [0..1]
+    // The generated 1D LUT is meant to be used as a 1D texture, or to
+    // decode or encode the components of 8-bit colors
+    std::unique_ptr<float[]> createEOTFLUT(uint32_t size) const;
+    std::unique_ptr<float[]> createOETFLUT(uint32_t size) const;
+
+    // Returns the 1D LUTs createEOTFLUT and createOETFLUT would create, cached
+    // like the 3D LUTs returned by getLUT
+    std::shared_ptr<const float[]> getEOTFLUT(uint32_t size) const;
+    std::shared_ptr<const float[]> getOETFLUT(uint32_t size) const;
+
 private:
     static constexpr mat3 computeXYZMatrix(
             const std::array<float2, 3>& primaries, const float2& whitePoint);
@@ -0,0 +1,179 @@
+/*
+ * Copyright (C) 2019 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef ANDROID_UI_FAT_VECTOR_H
+#define ANDROID_UI_FAT_VECTOR_H
+
+#include <stdlib.h>
+#include <string.h>
+
+#include <type_traits>
+
+#include <log/log.h>
+
+namespace android {
+// ---------------------------------------------------------------------------
+
+/*
+ * A vector of trivially copyable items which keeps its first SIZE items
+ * inside the object itself and only goes to the heap once it grows past
+ * that. Moving a FatVector which has spilled to the heap steals its buffer.
+ */
+template <typename T, size_t SIZE>
+class FatVector {
+    static_assert(std::is_trivially_copyable<T>::value, "FatVector requires a trivially copyable T");
+    static_assert(SIZE > 0, "FatVector requires some inline storage");
+
+public:
+    typedef T value_type;
+    typedef T* iterator;
+    typedef T const* const_iterator;
+
+    FatVector() : mData(inlineData()), mSize(0), mCapacity(SIZE) {}
+
+    FatVector(const FatVector& rhs) : FatVector() {
+        assign(rhs.begin(), rhs.end());
+    }
+
+    FatVector(FatVector&& rhs) noexcept : FatVector() {
+        steal(rhs);
+    }
+
+    ~FatVector() {
+        release();
+    }
+
+    FatVector& operator=(const FatVector& rhs) {
+        if (this != &rhs) {
+            assign(rhs.begin(), rhs.end());
+        }
+        return *this;
+    }
+
+    FatVector& operator=(FatVector&& rhs) noexcept {
+        if (this != &rhs) {
+            release();
+            mData = inlineData();
+            mSize = 0;
+            mCapacity = SIZE;
+            steal(rhs);
+        }
+        return *this;
+    }
+
+    inline size_t size() const { return mSize; }
+    inline bool empty() const { return mSize == 0; }
+    inline size_t capacity() const { return mCapacity; }
+
+    inline T* data() { return mData; }
+    inline const T* data() const { return mData; }
+
+    inline iterator begin() { return mData; }
+    inline iterator end() { return mData + mSize; }
+    inline const_iterator begin() const { return mData; }
+    inline const_iterator end() const { return mData + mSize; }
+
+    inline T& operator[](size_t index) { return mData[index]; }
+    inline const T& operator[](size_t index) const { return mData[index]; }
+    inline T& back() { return mData[mSize - 1]; }
+    inline const T& back() const { return mData[mSize - 1]; }
+
+    // keeps the current allocation
+    inline void clear() { mSize = 0; }
+
+    void reserve(size_t capacity) {
+        if (capacity > mCapacity) {
+            grow(capacity);
+        }
+    }
+
+    void push_back(const T& item) {
+        const T copy(item); // item may live in our own storage
+        if (mSize == mCapacity) {
+            grow(mCapacity * 2);
+        }
+        mData[mSize++] = copy;
+    }
+
+    void insert(size_t index, const T& item) {
+        const T copy(item);
+        if (mSize == mCapacity) {
+            grow(mCapacity * 2);
+        }
+        memmove(mData + index + 1, mData + index, (mSize - index) * sizeof(T));
+        mData[index] = copy;
+        mSize++;
+    }
+
+    void append(const T* items, size_t count) {
+        if (mSize + count > mCapacity) {
+            grow(mSize + count > mCapacity * 2 ? mSize + count : mCapacity * 2);
+        }
+        memcpy(mData + mSize, items, count * sizeof(T));
+        mSize += count;
+    }
+
+    void assign(const T* first, const T* last) {
+        const size_t count = static_cast<size_t>(last - first);
+        mSize = 0;
+        reserve(count);
+        memcpy(mData, first, count * sizeof(T));
+        mSize = count;
+    }
+
+private:
+    inline T* inlineData() { return reinterpret_cast<T*>(mInline); }
+    inline const T* inlineData() const { return reinterpret_cast<const T*>(mInline); }
+
+    void grow(size_t capacity) {
+        T* data = static_cast<T*>(malloc(capacity * sizeof(T)));
+        LOG_ALWAYS_FATAL_IF(data == nullptr, "FatVector: out of memory (%zu items)", capacity);
+        memcpy(data, mData, mSize * sizeof(T));
+        release();
+        mData = data;
+        mCapacity = capacity;
+    }
+
+    void release() {
+        if (mData != inlineData()) {
+            free(mData);
+        }
+    }
+
+    // this must be empty and using its inline storage
+    void steal(FatVector& rhs) {
+        if (rhs.mData == rhs.inlineData()) {
+            memcpy(mData, rhs.mData, rhs.mSize * sizeof(T));
+        } else {
+            mData = rhs.mData;
+            mCapacity = rhs.mCapacity;
+            rhs.mData = rhs.inlineData();
+            rhs.mCapacity = SIZE;
+        }
+        mSize = rhs.mSize;
+        rhs.mSize = 0;
+    }
+
+    T* mData;
+    size_t mSize;
+    size_t mCapacity;
+    alignas(T) unsigned char mInline[SIZE * sizeof(T)];
+};
+
+// ---------------------------------------------------------------------------
+}; // namespace android
+
+#endif // ANDROID_UI_FAT_VECTOR_H
@@ -19,6 +19,8 @@
 
 #include <stdint.h>
 
+#include <vector>
+
 #include <android-base/unique_fd.h>
 #include <utils/Flattenable.h>
 #include <utils/RefBase.h>
@@ -94,6 +96,16 @@ public:
     static sp<Fence> merge(const String8& name, const sp<Fence>& f1,
             const sp<Fence>& f2);
 
+    // merge combines any number of Fence objects into one that becomes
+    // signaled when all of them are signaled.  Invalid and repeated fences
+    // are skipped, and so are the fences that already signaled as long as
+    // others are still pending, which keeps the signal time of the result.
+    // When a single fence remains, it is returned as it is rather than
+    // being copied into a new sync file, so the result does not necessarily
+    // carry the given name.  NO_FENCE is returned if no fence is valid or
+    // the merge fails.
+    static sp<Fence> merge(const char* name, const std::vector<sp<Fence>>& fences);
+
     // Return a duplicate of the fence file descriptor. The caller is
     // responsible for closing the returned file descriptor. On error, -1 will
     // be returned and errno will indicate the problem.
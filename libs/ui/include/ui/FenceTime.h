@@ -23,18 +23,22 @@
 #include <utils/Timers.h>
 
 #include <atomic>
+#include <deque>
+#include <initializer_list>
 #include <mutex>
-#include <queue>
 #include <unordered_map>
+#include <vector>
 
 namespace android {
 
+class FenceTimeline;
 class FenceToFenceTimeMap;
 
 // A wrapper around fence that only implements isValid and getSignalTime.
 // It automatically closes the fence in a thread-safe manner once the signal
 // time is known.
 class FenceTime {
+friend class FenceTimeline;
 friend class FenceToFenceTimeMap;
 public:
     // An atomic snapshot of the FenceTime that is flattenable.
@@ -158,9 +162,21 @@ public:
     void push(const std::shared_ptr<FenceTime>& fence);
     void updateSignalTimes();
 
+    // Updates the signal times of several timelines at once. All the pending
+    // fences of the timelines are polled with a single syscall, and only the
+    // ones that signaled are queried for their signal time, which is then
+    // cached even if earlier fences of the timeline are still pending.
+    static void updateSignalTimes(std::initializer_list<FenceTimeline*> timelines);
+
 private:
+    // Adds the fences of the timeline that may still be pending to fences.
+    void getPendingFences(std::vector<std::shared_ptr<FenceTime>>* fences);
+
+    // Removes the fences at the front of the timeline that have signaled.
+    void popSignaledFences();
+
     mutable std::mutex mMutex;
-    std::queue<std::weak_ptr<FenceTime>> mQueue GUARDED_BY(mMutex);
+    std::deque<std::weak_ptr<FenceTime>> mQueue GUARDED_BY(mMutex);
 };
 
 // Used by test code to create or get FenceTimes for a given Fence.
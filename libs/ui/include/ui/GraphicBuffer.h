@@ -98,6 +98,12 @@ public:
             uint32_t inLayerCount, uint64_t inUsage,
             std::string requestorName = "<Unknown>");
 
+    // Allocate count identical buffers into outBuffers, with a single
+    // allocator call, which is cheaper than constructing them one by one.
+    static status_t allocate(uint32_t inWidth, uint32_t inHeight, PixelFormat inFormat,
+            uint32_t inLayerCount, uint64_t inUsage, uint32_t count,
+            std::string requestorName, std::vector<sp<GraphicBuffer>>* outBuffers);
+
     // Create a GraphicBuffer from an existing handle.
     enum HandleWrapMethod : uint8_t {
         // Wrap and use the handle directly.  It assumes the handle has been
@@ -260,6 +266,10 @@ private:
             PixelFormat inFormat, uint32_t inLayerCount,
             uint64_t inUsage, std::string requestorName);
 
+    void initWithAllocatedHandle(buffer_handle_t inHandle, uint32_t inWidth,
+            uint32_t inHeight, PixelFormat inFormat, uint32_t inLayerCount,
+            uint64_t inUsage, uint32_t inStride);
+
     status_t initWithHandle(const native_handle_t* inHandle, HandleWrapMethod method,
                             uint32_t inWidth, uint32_t inHeight, PixelFormat inFormat,
                             uint32_t inLayerCount, uint64_t inUsage, uint32_t inStride);
@@ -20,8 +20,10 @@
 
 #include <stdint.h>
 
+#include <deque>
 #include <memory>
 #include <string>
+#include <vector>
 
 #include <cutils/native_handle.h>
 
@@ -31,6 +33,7 @@
 #include <utils/KeyedVector.h>
 #include <utils/Mutex.h>
 #include <utils/Singleton.h>
+#include <utils/Timers.h>
 
 namespace android {
 
@@ -47,8 +50,32 @@ public:
             buffer_handle_t* handle, uint32_t* stride, uint64_t graphicBufferId,
             std::string requestorName);
 
+    // Allocates bufferCount identical buffers into handles, with a single
+    // allocator call for those that are not reused from the pool. All of them
+    // have the same stride.
+    status_t allocate(uint32_t w, uint32_t h, PixelFormat format,
+            uint32_t layerCount, uint64_t usage, uint32_t bufferCount,
+            buffer_handle_t* handles, uint32_t* stride,
+            std::string requestorName);
+
     status_t free(buffer_handle_t handle);
 
+    // Lets this process keep up to capacity freed buffers, for reuse by a
+    // later allocation with the same dimensions, format, usage and requestor
+    // name. The pool is off (0) unless the process asks for it. A pooled
+    // buffer keeps its old contents, and stays visible to any process it was
+    // shared with, so only processes that keep track of their buffers, such
+    // as SurfaceFlinger, should turn it on.
+    void setPoolCapacity(size_t capacity);
+
+    // Frees every pooled buffer, e.g. once the process has gone idle.
+    // Otherwise pooled buffers unused for a while only go on the next
+    // allocate() or free().
+    void releasePooledBuffers();
+
+    // How long a freed buffer stays in the pool waiting to be reused.
+    static constexpr nsecs_t kPoolTimeout = ms2ns(2000);
+
     size_t getTotalSize() const;
 
     void dump(std::string& res) const;
@@ -66,9 +93,32 @@ protected:
         std::string requestorName;
     };
 
+    // A freed buffer kept for reuse by a later allocation of the same
+    // dimensions, format and usage.
+    struct pooled_buffer_t {
+        buffer_handle_t handle;
+        alloc_rec_t rec;
+        nsecs_t freeTime;
+    };
+
+    // Takes the pooled buffers that have been unused for too long, and the
+    // oldest ones beyond the pool capacity, out of the pool into toFree.
+    void trimPoolLocked(nsecs_t now, std::vector<buffer_handle_t>* toFree);
+
     static Mutex sLock;
     static KeyedVector<buffer_handle_t, alloc_rec_t> sAllocList;
 
+    // The pool is empty unless setPoolCapacity() was called. Buffers are
+    // freed at the back and reused from the back. Guarded by sLock.
+    size_t mPoolCapacity = 0;
+    std::deque<pooled_buffer_t> mPool;
+
+    // Allocation statistics, guarded by sLock.
+    uint64_t mAllocationCount = 0;
+    uint64_t mPoolHitCount = 0;
+    nsecs_t mTotalAllocationTime = 0;
+    nsecs_t mMaxAllocationTime = 0;
+
     friend class Singleton<GraphicBufferAllocator>;
     GraphicBufferAllocator();
     ~GraphicBufferAllocator();
@@ -20,9 +20,18 @@
 #include <stdint.h>
 #include <sys/types.h>
 
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <future>
 #include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <utility>
+#include <vector>
 
 #include <ui/PixelFormat.h>
+#include <ui/Rect.h>
 #include <utils/Singleton.h>
 
 
@@ -36,7 +45,6 @@ namespace android {
 // ---------------------------------------------------------------------------
 
 class GrallocMapper;
-class Rect;
 
 class GraphicBufferMapper : public Singleton<GraphicBufferMapper>
 {
@@ -45,6 +53,15 @@ public:
         GRALLOC_2,
         GRALLOC_3,
     };
+    // The outcome of a lock scheduled on the worker thread.
+    struct LockResult {
+        status_t error = NO_INIT;
+        void* vaddr = nullptr;
+        int32_t bytesPerPixel = -1;
+        int32_t bytesPerStride = -1;
+        android_ycbcr ycbcr = {};
+    };
+
     static void preloadHal();
     static inline GraphicBufferMapper& get() { return getInstance(); }
 
@@ -55,6 +72,19 @@ public:
             PixelFormat format, uint64_t usage, uint32_t stride,
             buffer_handle_t* outHandle);
 
+    // Like importBuffer, but if the buffer with the given id is already
+    // imported in this process, and rawHandle refers to the same memory,
+    // the existing import is shared instead of importing it again. The
+    // imported outHandle must be freed with freeBuffer all the same, once
+    // per import; the handle stays valid until its last import is freed.
+    // Since the imports share the handle, they also share its lock: a shared
+    // buffer locked through one of them must be unlocked before it is locked
+    // through another.
+    status_t importBuffer(uint64_t bufferId, buffer_handle_t rawHandle,
+            uint32_t width, uint32_t height, uint32_t layerCount,
+            PixelFormat format, uint64_t usage, uint32_t stride,
+            buffer_handle_t* outHandle);
+
     status_t freeBuffer(buffer_handle_t handle);
 
     void getTransportSize(buffer_handle_t handle,
@@ -82,6 +112,17 @@ public:
 
     status_t unlockAsync(buffer_handle_t handle, int *fenceFd);
 
+    // Lock the buffer on a worker thread and return a future for the result,
+    // so that a CPU consumer can map its next buffer while it still processes
+    // the current one. Locks run one at a time, in the order they were
+    // scheduled. The handle must stay imported until the future is ready, and
+    // ownership of fenceFd passes to the mapper as with lockAsync.
+    std::future<LockResult> scheduleLock(buffer_handle_t handle, uint64_t usage,
+                                         const Rect& bounds, int fenceFd);
+
+    std::future<LockResult> scheduleLockYCbCr(buffer_handle_t handle, uint64_t usage,
+                                              const Rect& bounds, int fenceFd);
+
     status_t isSupported(uint32_t width, uint32_t height, android::PixelFormat format,
                          uint32_t layerCount, uint64_t usage, bool* outSupported);
 
@@ -96,9 +137,36 @@ private:
 
     GraphicBufferMapper();
 
+    std::future<LockResult> scheduleLockTask(std::function<LockResult()> lockFunction);
+    void lockWorkerLoop();
+
     std::unique_ptr<const GrallocMapper> mMapper;
 
     Version mMapperVersion;
+
+    // Locks scheduled on the worker thread, which is started by the first
+    // scheduleLock call.
+    std::mutex mLockQueueMutex;
+    std::condition_variable mLockQueueCondition;
+    std::deque<std::packaged_task<LockResult()>> mLockQueue;
+    bool mLockWorkerStarted = false;
+
+    // The buffers imported by id, shared by the imports of the same buffer.
+    struct SharedImport {
+        buffer_handle_t handle;
+        // The device and inode of each fd, which tell the memory apart
+        std::vector<std::pair<dev_t, ino_t>> fdIdentities;
+        uint32_t width;
+        uint32_t height;
+        uint32_t layerCount;
+        PixelFormat format;
+        uint64_t usage;
+        uint32_t stride;
+        size_t refCount;
+    };
+    std::mutex mSharedImportsMutex;
+    std::unordered_map<uint64_t, SharedImport> mSharedImports;
+    std::unordered_map<buffer_handle_t, uint64_t> mSharedImportIds;
 };
 
 // ---------------------------------------------------------------------------
@@ -22,6 +22,7 @@
 
 #include <utils/Vector.h>
 
+#include <ui/FatVector.h>
 #include <ui/Rect.h>
 #include <utils/Flattenable.h>
 
@@ -39,12 +40,14 @@ public:
 
                         Region();
                         Region(const Region& rhs);
+                        Region(Region&& rhs) noexcept;
     explicit            Region(const Rect& rhs);
                         ~Region();
 
     static  Region      createTJunctionFreeRegion(const Region& r);
 
         Region& operator = (const Region& rhs);
+        Region& operator = (Region&& rhs) noexcept;
 
     inline  bool        isEmpty() const     { return getBounds().isEmpty(); }
     inline  bool        isRect() const      { return mStorage.size() == 1; }
@@ -116,9 +119,14 @@ public:
     inline  Region&     operator += (const Point& pt);
 
 
-    // returns true if the regions share the same underlying storage
+    // returns true if the regions share the same underlying storage.
+    // Region storage is inline, so this only holds for the same object;
+    // use hasSameRects() to compare contents.
     bool isTriviallyEqual(const Region& region) const;
 
+    // returns true if both regions are made of the same rects
+    bool hasSameRects(const Region& region) const;
+
 
     /* various ways to access the rectangle list */
 
@@ -167,6 +175,13 @@ private:
     static void boolean_operation(uint32_t op, Region& dst,
             const Region& lhs, const Rect& rhs);
 
+    // Resolves op from the operands' bounds alone when possible (disjoint or
+    // containing operands, empty operands), without running the spanner.
+    // rhsBounds is already offset by dx/dy; rhs is null for a Rect operand.
+    static bool trivial_operation(uint32_t op, Region& dst,
+            const Region& lhs, const Region* rhs, const Rect& rhsBounds,
+            bool rhsIsRect, int dx, int dy);
+
     static void translate(Region& reg, int dx, int dy);
     static void translate(Region& dst, const Region& reg, int dx, int dy);
 
@@ -177,7 +192,9 @@ private:
     // with an extra Rect as the last element which is set to the
     // bounds of the region. However, if the region is
     // a simple Rect then mStorage contains only that rect.
-    Vector<Rect> mStorage;
+    // The first few rects are stored inline, which covers nearly every
+    // region SurfaceFlinger computes without touching the heap.
+    FatVector<Rect, 4> mStorage;
 };
 
 
@@ -82,9 +82,15 @@ public:
     Region  transform(const Region& reg) const;
     Rect    transform(const Rect& bounds,
                       bool roundOutwards = false) const;
+    // transforms count rects at once, which is faster than transforming them
+    // one by one for transforms that preserve rects
+    void    transform(const Rect* rects, size_t count, Rect* outRects,
+                      bool roundOutwards = false) const;
     FloatRect transform(const FloatRect& bounds) const;
     Transform& operator = (const Transform& other);
     Transform operator * (const Transform& rhs) const;
+    bool operator == (const Transform& other) const;
+    bool operator != (const Transform& other) const { return !(*this == other); }
     // assumes the last row is < 0 , 0 , 1 >
     vec2 transform(const vec2& v) const;
     vec3 transform(const vec3& v) const;
@@ -108,6 +114,9 @@ private:
     enum { UNKNOWN_TYPE = 0x80000000 };
 
     uint32_t type() const;
+    template <bool ROTATED>
+    void transformAlignedRects(const Rect* rects, size_t count, Rect* outRects,
+                               bool roundOutwards) const;
     static bool absIsOne(float f);
     static bool isZero(float f);
 
@@ -0,0 +1 @@
+../../include/ui/FatVector.h
\ No newline at end of file
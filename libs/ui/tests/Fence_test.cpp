@@ -0,0 +1,55 @@
+/*
+ * Copyright 2019 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#define LOG_TAG "FenceTest"
+
+#include <sys/eventfd.h>
+
+#include <ui/Fence.h>
+
+#include <gtest/gtest.h>
+
+namespace android {
+
+// Looks like a fence to poll: an eventfd polls as signaled once its counter
+// is non-zero. Just enough to exercise the checks the N-way merge makes
+// before it asks the kernel to merge sync files.
+static sp<Fence> makeFakeFence(bool signaled) {
+    return new Fence(eventfd(signaled ? 1 : 0, EFD_CLOEXEC));
+}
+
+TEST(FenceTest, MergeOfInvalidFencesIsNoFence) {
+    EXPECT_EQ(Fence::NO_FENCE, Fence::merge("test", {}));
+    EXPECT_EQ(Fence::NO_FENCE, Fence::merge("test", {Fence::NO_FENCE, Fence::NO_FENCE}));
+}
+
+TEST(FenceTest, MergeReturnsTheOnlyValidFence) {
+    sp<Fence> fence = makeFakeFence(false);
+    ASSERT_TRUE(fence->isValid());
+    EXPECT_EQ(fence, Fence::merge("test", {Fence::NO_FENCE, fence, Fence::NO_FENCE}));
+    EXPECT_EQ(fence, Fence::merge("test", {fence, fence}));
+}
+
+TEST(FenceTest, MergeSkipsSignaledFences) {
+    sp<Fence> pending = makeFakeFence(false);
+    sp<Fence> signaled = makeFakeFence(true);
+    ASSERT_TRUE(pending->isValid());
+    ASSERT_TRUE(signaled->isValid());
+    EXPECT_EQ(pending, Fence::merge("test", {signaled, pending}));
+    EXPECT_EQ(pending, Fence::merge("test", {pending, signaled, Fence::NO_FENCE}));
+}
+
+} // namespace android
@@ -26,6 +26,7 @@
 
 #include <algorithm>
 #include <limits>
+#include <vector>
 
 namespace android {
 
@@ -36,6 +37,11 @@ constexpr uint32_t kTestHeight = 1;
 constexpr uint32_t kTestLayerCount = 1;
 constexpr uint64_t kTestUsage = GraphicBuffer::USAGE_SW_WRITE_OFTEN;
 
+// Never imported into the mapper, so the tests must not let the allocator free them
+const buffer_handle_t kTestHandleA = reinterpret_cast<buffer_handle_t>(uintptr_t(0x1000));
+const buffer_handle_t kTestHandleB = reinterpret_cast<buffer_handle_t>(uintptr_t(0x2000));
+const buffer_handle_t kTestHandleC = reinterpret_cast<buffer_handle_t>(uintptr_t(0x3000));
+
 } // namespace
 
 using ::testing::DoAll;
@@ -53,7 +59,28 @@ public:
                     allocate)
                 .WillOnce(DoAll(SetArgPointee<6>(stride), Return(err)));
     }
+    void expectAllocate(uint32_t stride, buffer_handle_t handle) {
+        EXPECT_CALL(*(reinterpret_cast<const mock::MockGrallocAllocator*>(mAllocator.get())),
+                    allocate)
+                .WillOnce(DoAll(SetArgPointee<6>(stride), SetArgPointee<7>(handle),
+                                Return(NO_ERROR)));
+    }
     std::unique_ptr<const GrallocAllocator>& getAllocator() { return mAllocator; }
+
+    size_t getPoolCapacity() const { return mPoolCapacity; }
+    size_t getPoolSize() const {
+        Mutex::Autolock _l(sLock);
+        return mPool.size();
+    }
+    // Trims the pool as if it were now and the capacity were capacity, and
+    // returns what would have been freed.
+    std::vector<buffer_handle_t> trimPool(nsecs_t now, size_t capacity) {
+        Mutex::Autolock _l(sLock);
+        mPoolCapacity = capacity;
+        std::vector<buffer_handle_t> trimmed;
+        trimPoolLocked(now, &trimmed);
+        return trimmed;
+    }
 };
 
 class GraphicBufferAllocatorTest : public testing::Test {
@@ -113,4 +140,82 @@ TEST_F(GraphicBufferAllocatorTest, AllocateLargeStride) {
     ASSERT_EQ(NO_ERROR, err);
     ASSERT_EQ(expectedStride, stride);
 }
+
+TEST_F(GraphicBufferAllocatorTest, PoolIsOffByDefault) {
+    EXPECT_EQ(0u, mAllocator.getPoolCapacity());
+}
+
+TEST_F(GraphicBufferAllocatorTest, ReusesPooledBufferForSameUsageAndRequestor) {
+    mAllocator.setPoolCapacity(2);
+    mAllocator.expectAllocate(kTestWidth, kTestHandleA);
+    uint32_t stride = 0;
+    buffer_handle_t handle;
+    ASSERT_EQ(NO_ERROR,
+              mAllocator.allocate(kTestWidth, kTestHeight, PIXEL_FORMAT_RGBA_8888, kTestLayerCount,
+                                  kTestUsage, &handle, &stride, 0, "requestor"));
+    ASSERT_EQ(kTestHandleA, handle);
+    ASSERT_EQ(NO_ERROR, mAllocator.free(handle));
+    EXPECT_EQ(1u, mAllocator.getPoolSize());
+
+    // Taken from the pool, the gralloc allocator is not called again
+    stride = 0;
+    handle = nullptr;
+    ASSERT_EQ(NO_ERROR,
+              mAllocator.allocate(kTestWidth, kTestHeight, PIXEL_FORMAT_RGBA_8888, kTestLayerCount,
+                                  kTestUsage, &handle, &stride, 0, "requestor"));
+    EXPECT_EQ(kTestHandleA, handle);
+    EXPECT_EQ(kTestWidth, stride);
+    EXPECT_EQ(0u, mAllocator.getPoolSize());
+}
+
+TEST_F(GraphicBufferAllocatorTest, DoesNotReusePooledBufferForOtherUsageOrRequestor) {
+    mAllocator.setPoolCapacity(2);
+    mAllocator.expectAllocate(kTestWidth, kTestHandleA);
+    uint32_t stride = 0;
+    buffer_handle_t handle;
+    ASSERT_EQ(NO_ERROR,
+              mAllocator.allocate(kTestWidth, kTestHeight, PIXEL_FORMAT_RGBA_8888, kTestLayerCount,
+                                  kTestUsage, &handle, &stride, 0, "requestor"));
+    ASSERT_EQ(NO_ERROR, mAllocator.free(handle));
+
+    mAllocator.expectAllocate(kTestWidth, kTestHandleB);
+    ASSERT_EQ(NO_ERROR,
+              mAllocator.allocate(kTestWidth, kTestHeight, PIXEL_FORMAT_RGBA_8888, kTestLayerCount,
+                                  kTestUsage, &handle, &stride, 0, "other requestor"));
+    EXPECT_EQ(kTestHandleB, handle);
+
+    mAllocator.expectAllocate(kTestWidth, kTestHandleC);
+    ASSERT_EQ(NO_ERROR,
+              mAllocator.allocate(kTestWidth, kTestHeight, PIXEL_FORMAT_RGBA_8888, kTestLayerCount,
+                                  kTestUsage | GraphicBuffer::USAGE_SW_READ_OFTEN, &handle,
+                                  &stride, 0, "requestor"));
+    EXPECT_EQ(kTestHandleC, handle);
+    EXPECT_EQ(1u, mAllocator.getPoolSize());
+}
+
+TEST_F(GraphicBufferAllocatorTest, TrimsIdleAndExcessPooledBuffers) {
+    mAllocator.setPoolCapacity(2);
+    uint32_t stride = 0;
+    buffer_handle_t handle;
+    for (buffer_handle_t allocated : {kTestHandleA, kTestHandleB}) {
+        mAllocator.expectAllocate(kTestWidth, allocated);
+        ASSERT_EQ(NO_ERROR,
+                  mAllocator.allocate(kTestWidth, kTestHeight, PIXEL_FORMAT_RGBA_8888,
+                                      kTestLayerCount, kTestUsage, &handle, &stride, 0,
+                                      "requestor"));
+    }
+    ASSERT_EQ(NO_ERROR, mAllocator.free(kTestHandleA));
+    ASSERT_EQ(NO_ERROR, mAllocator.free(kTestHandleB));
+    ASSERT_EQ(2u, mAllocator.getPoolSize());
+
+    // Past the capacity, the oldest buffer goes first
+    const nsecs_t now = systemTime();
+    EXPECT_EQ(std::vector<buffer_handle_t>{kTestHandleA}, mAllocator.trimPool(now, 1));
+    EXPECT_EQ(1u, mAllocator.getPoolSize());
+
+    EXPECT_TRUE(mAllocator.trimPool(now, 2).empty());
+    EXPECT_EQ(std::vector<buffer_handle_t>{kTestHandleB},
+              mAllocator.trimPool(now + GraphicBufferAllocator::kPoolTimeout + 1, 2));
+    EXPECT_EQ(0u, mAllocator.getPoolSize());
+}
 } // namespace android
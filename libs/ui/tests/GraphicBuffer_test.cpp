@@ -18,8 +18,14 @@
 
 #include <ui/BufferHubBuffer.h>
 #include <ui/GraphicBuffer.h>
+#include <ui/GraphicBufferMapper.h>
 
 #include <gtest/gtest.h>
+#include <unistd.h>
+
+#include <chrono>
+#include <future>
+#include <vector>
 
 namespace android {
 
@@ -31,6 +37,49 @@ constexpr uint32_t kTestFormat = HAL_PIXEL_FORMAT_BLOB;
 constexpr uint32_t kTestLayerCount = 1;
 constexpr uint64_t kTestUsage = GraphicBuffer::USAGE_SW_WRITE_OFTEN;
 
+// Unflattens a copy of the buffer as if it had been received from another
+// process, optionally claiming the id of another buffer.
+sp<GraphicBuffer> receive(const sp<GraphicBuffer>& source, uint64_t claimedId) {
+    std::vector<int32_t> data(source->getFlattenedSize() / sizeof(int32_t));
+    std::vector<int> fds(source->getFdCount());
+
+    void* flatData = data.data();
+    size_t flatSize = data.size() * sizeof(int32_t);
+    int* flatFds = fds.data();
+    size_t flatFdCount = fds.size();
+    if (source->flatten(flatData, flatSize, flatFds, flatFdCount) != NO_ERROR) {
+        return nullptr;
+    }
+    // unflatten takes the fds, which still belong to the source here.
+    for (int& fd : fds) {
+        fd = dup(fd);
+    }
+    data[7] = static_cast<int32_t>(claimedId >> 32);
+    data[8] = static_cast<int32_t>(claimedId & 0xFFFFFFFF);
+
+    const void* unflatData = data.data();
+    size_t unflatSize = data.size() * sizeof(int32_t);
+    const int* unflatFds = fds.data();
+    size_t unflatFdCount = fds.size();
+    sp<GraphicBuffer> received = new GraphicBuffer();
+    if (received->unflatten(unflatData, unflatSize, unflatFds, unflatFdCount) != NO_ERROR) {
+        return nullptr;
+    }
+    return received;
+}
+
+sp<GraphicBuffer> receive(const sp<GraphicBuffer>& source) {
+    return receive(source, source->getId());
+}
+
+void writeThrough(const sp<GraphicBuffer>& buffer) {
+    void* vaddr = nullptr;
+    ASSERT_EQ(NO_ERROR, buffer->lock(kTestUsage, &vaddr));
+    ASSERT_NE(nullptr, vaddr);
+    static_cast<uint8_t*>(vaddr)[0] = 0xff;
+    ASSERT_EQ(NO_ERROR, buffer->unlock());
+}
+
 } // namespace
 
 class GraphicBufferTest : public testing::Test {};
@@ -135,4 +184,109 @@ TEST_F(GraphicBufferTest, flattenAndUnflatten) {
     EXPECT_EQ(gb2->getGenerationNumber(), 42);
 }
 
+TEST_F(GraphicBufferTest, UnflattenSameBufferSharesImport) {
+    sp<GraphicBuffer> gb(new GraphicBuffer(kTestWidth, kTestHeight, PIXEL_FORMAT_RGBA_8888,
+                                           kTestLayerCount, kTestUsage, std::string("test")));
+    ASSERT_EQ(NO_ERROR, gb->initCheck());
+
+    sp<GraphicBuffer> first = receive(gb);
+    sp<GraphicBuffer> second = receive(gb);
+    ASSERT_NE(nullptr, first);
+    ASSERT_NE(nullptr, second);
+    EXPECT_NE(gb->handle, first->handle);
+    EXPECT_EQ(first->handle, second->handle);
+    EXPECT_EQ(gb->getId(), second->getId());
+}
+
+TEST_F(GraphicBufferTest, FreeingOneSharedImportKeepsTheOthers) {
+    sp<GraphicBuffer> gb(new GraphicBuffer(kTestWidth, kTestHeight, PIXEL_FORMAT_RGBA_8888,
+                                           kTestLayerCount, kTestUsage, std::string("test")));
+    ASSERT_EQ(NO_ERROR, gb->initCheck());
+
+    sp<GraphicBuffer> first = receive(gb);
+    sp<GraphicBuffer> second = receive(gb);
+    ASSERT_NE(nullptr, first);
+    ASSERT_NE(nullptr, second);
+    buffer_handle_t shared = first->handle;
+
+    first.clear();
+    writeThrough(second);
+
+    // The import is still referenced by the second buffer, so it is shared
+    // again, and still usable once that one is gone as well.
+    sp<GraphicBuffer> third = receive(gb);
+    ASSERT_NE(nullptr, third);
+    EXPECT_EQ(shared, third->handle);
+    second.clear();
+    writeThrough(third);
+}
+
+TEST_F(GraphicBufferTest, UnflattenOtherBufferUnderSameIdIsNotShared) {
+    sp<GraphicBuffer> gb1(new GraphicBuffer(kTestWidth, kTestHeight, PIXEL_FORMAT_RGBA_8888,
+                                            kTestLayerCount, kTestUsage, std::string("test")));
+    sp<GraphicBuffer> gb2(new GraphicBuffer(kTestWidth, kTestHeight, PIXEL_FORMAT_RGBA_8888,
+                                            kTestLayerCount, kTestUsage, std::string("test")));
+    ASSERT_EQ(NO_ERROR, gb1->initCheck());
+    ASSERT_EQ(NO_ERROR, gb2->initCheck());
+
+    sp<GraphicBuffer> genuine = receive(gb1);
+    sp<GraphicBuffer> impostor = receive(gb2, gb1->getId());
+    ASSERT_NE(nullptr, genuine);
+    ASSERT_NE(nullptr, impostor);
+    EXPECT_NE(genuine->handle, impostor->handle);
+
+    // Freeing the impostor must not release the genuine import.
+    impostor.clear();
+    writeThrough(genuine);
+}
+
+TEST_F(GraphicBufferTest, ScheduleLockMapsBuffer) {
+    sp<GraphicBuffer> gb(
+            new GraphicBuffer(kTestWidth, kTestHeight, kTestFormat, kTestLayerCount, kTestUsage));
+    ASSERT_EQ(NO_ERROR, gb->initCheck());
+
+    GraphicBufferMapper& mapper = GraphicBufferMapper::get();
+    GraphicBufferMapper::LockResult result =
+            mapper.scheduleLock(gb->handle, kTestUsage, Rect(kTestWidth, kTestHeight), -1).get();
+    ASSERT_EQ(NO_ERROR, result.error);
+    ASSERT_NE(nullptr, result.vaddr);
+    static_cast<uint8_t*>(result.vaddr)[0] = 0x5a;
+    ASSERT_EQ(NO_ERROR, mapper.unlock(gb->handle));
+
+    // What was written through the scheduled lock is seen by a direct one.
+    void* vaddr = nullptr;
+    ASSERT_EQ(NO_ERROR, gb->lock(GraphicBuffer::USAGE_SW_READ_OFTEN, &vaddr));
+    EXPECT_EQ(0x5a, static_cast<uint8_t*>(vaddr)[0]);
+    ASSERT_EQ(NO_ERROR, gb->unlock());
+}
+
+TEST_F(GraphicBufferTest, ScheduledLocksRunInOrder) {
+    constexpr size_t kBufferCount = 8;
+    std::vector<sp<GraphicBuffer>> buffers;
+    for (size_t i = 0; i < kBufferCount; i++) {
+        buffers.push_back(new GraphicBuffer(kTestWidth, kTestHeight, kTestFormat,
+                                            kTestLayerCount, kTestUsage));
+        ASSERT_EQ(NO_ERROR, buffers.back()->initCheck());
+    }
+
+    GraphicBufferMapper& mapper = GraphicBufferMapper::get();
+    std::vector<std::future<GraphicBufferMapper::LockResult>> futures;
+    for (const sp<GraphicBuffer>& gb : buffers) {
+        futures.push_back(mapper.scheduleLock(gb->handle, kTestUsage,
+                                              Rect(kTestWidth, kTestHeight), -1));
+    }
+
+    // Once the last lock is done, every lock scheduled before it is too.
+    futures.back().wait();
+    for (size_t i = 0; i < kBufferCount; i++) {
+        ASSERT_EQ(std::future_status::ready, futures[i].wait_for(std::chrono::seconds(0)));
+        GraphicBufferMapper::LockResult result = futures[i].get();
+        EXPECT_EQ(NO_ERROR, result.error);
+        EXPECT_NE(nullptr, result.vaddr);
+        if (result.error == NO_ERROR) {
+            EXPECT_EQ(NO_ERROR, mapper.unlock(buffers[i]->handle));
+        }
+    }
+}
+
 } // namespace android
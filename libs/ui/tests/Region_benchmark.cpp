@@ -0,0 +1,94 @@
+/*
+ * Copyright (C) 2019 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <stdlib.h>
+
+#include <vector>
+
+#include <benchmark/benchmark.h>
+#include <private/ui/RegionHelper.h>
+#include <ui/Rect.h>
+#include <ui/Region.h>
+
+namespace android {
+
+// A synthetic stack of overlapping layers, roughly what SurfaceFlinger sees
+// when computing visible and covered regions on a phone-sized display.
+static std::vector<Region> makeLayerStack(size_t layerCount) {
+    srandom(1234);
+    std::vector<Region> layers;
+    for (size_t i = 0; i < layerCount; i++) {
+        Region r;
+        const int holes = random() % 4;
+        const int l = random() % 1080;
+        const int t = random() % 2280;
+        r.set(Rect(l, t, l + 1 + random() % (1080 - l), t + 1 + random() % (2280 - t)));
+        for (int h = 0; h < holes; h++) {
+            const int hl = random() % 1080;
+            const int ht = random() % 2280;
+            r.subtractSelf(Rect(hl, ht, hl + 32 + random() % 128, ht + 32 + random() % 128));
+        }
+        layers.push_back(r);
+    }
+    return layers;
+}
+
+static void BM_SameHorizontalEdges(benchmark::State& state, bool vectorized) {
+    const size_t count = state.range(0);
+    std::vector<Rect> p(count), q(count);
+    for (size_t i = 0; i < count; i++) {
+        p[i] = Rect(i * 4, 0, i * 4 + 2, 1);
+        q[i] = Rect(i * 4, 1, i * 4 + 2, 2);
+    }
+    for (auto _ : state) {
+        bool same = vectorized ? same_horizontal_edges(p.data(), q.data(), count)
+                               : same_horizontal_edges_scalar(p.data(), q.data(), count);
+        benchmark::DoNotOptimize(same);
+    }
+    state.SetItemsProcessed(state.iterations() * count);
+}
+BENCHMARK_CAPTURE(BM_SameHorizontalEdges, scalar, false)->RangeMultiplier(4)->Range(2, 512);
+BENCHMARK_CAPTURE(BM_SameHorizontalEdges, vectorized, true)->RangeMultiplier(4)->Range(2, 512);
+
+static void BM_VisibleRegions(benchmark::State& state) {
+    const std::vector<Region> layers = makeLayerStack(state.range(0));
+    for (auto _ : state) {
+        // Front to back, the way SurfaceFlinger computes visible regions.
+        Region opaque;
+        Region dirty;
+        for (auto it = layers.rbegin(); it != layers.rend(); ++it) {
+            const Region visible = it->subtract(opaque);
+            dirty.orSelf(visible);
+            opaque.orSelf(*it);
+        }
+        benchmark::DoNotOptimize(dirty);
+    }
+}
+BENCHMARK(BM_VisibleRegions)->Arg(4)->Arg(16)->Arg(64);
+
+static void BM_DisjointOperations(benchmark::State& state) {
+    const Region lhs(Rect(0, 0, 100, 100));
+    const Region rhs(Rect(200, 200, 300, 300));
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(lhs.intersect(rhs));
+        benchmark::DoNotOptimize(lhs.subtract(rhs));
+    }
+}
+BENCHMARK(BM_DisjointOperations);
+
+} // namespace android
+
+BENCHMARK_MAIN();
@@ -131,6 +131,38 @@ TEST_F(RegionTest, Bigger_TJunction) {
     checkTJunctionFreeFromRegion(r, 16);
 }
 
+TEST_F(RegionTest, MoveAndSelfOperations) {
+    // a staircase has more rects than fit in the region's inline storage
+    Region stairs;
+    for (int i = 0; i < 8; i++) {
+        stairs.orSelf(Rect(i, i, i + 4, i + 1));
+    }
+    const Region copy(stairs);
+    ASSERT_TRUE(copy.hasSameRects(stairs));
+    ASSERT_FALSE(copy.isTriviallyEqual(stairs));
+
+    Region moved(std::move(stairs));
+    ASSERT_TRUE(moved.hasSameRects(copy));
+    ASSERT_TRUE(stairs.isEmpty());
+
+    Region small(Rect(0, 0, 2, 2));
+    small = std::move(moved);
+    ASSERT_TRUE(small.hasSameRects(copy));
+    ASSERT_TRUE(moved.isEmpty());
+
+    // operating on ourselves, or with a rect pointing into our own storage
+    Region self(copy);
+    self.orSelf(self);
+    ASSERT_TRUE(self.hasSameRects(copy));
+    self.subtractSelf(self);
+    ASSERT_TRUE(self.isEmpty());
+
+    Region r(copy);
+    r.subtractSelf(*r.begin());
+    ASSERT_TRUE(r.hasSameRects(copy.subtract(*copy.begin())));
+    ASSERT_FALSE(r.hasSameRects(copy));
+}
+
 #define ITER_MAX 1000
 #define X_MAX 8
 #define Y_MAX 8
@@ -152,5 +184,50 @@ TEST_F(RegionTest, Random_TJunction) {
     }
 }
 
+TEST_F(RegionTest, Random_BooleanOperations) {
+    // Covers both the bounds-only shortcuts (empty, disjoint and covering
+    // operands) and the spanner, by checking every pixel of the result.
+    srandom(54321);
+
+    auto randomRegion = [](int maxRects) {
+        Region r;
+        int n = random() % (maxRects + 1);
+        for (int i = 0; i < n; i++) {
+            int l = random() % X_MAX;
+            int t = random() % Y_MAX;
+            r.orSelf(Rect(l, t, l + 1 + random() % (X_MAX - l), t + 1 + random() % (Y_MAX - t)));
+        }
+        return r;
+    };
+
+    for (int iter = 0; iter < ITER_MAX; iter++) {
+        const Region a = randomRegion(3);
+        const Region b = randomRegion(3);
+        const int dx = random() % 5 - 2;
+        const int dy = random() % 5 - 2;
+        const Rect rect = b.getBounds();
+
+        const Region orResult = a.merge(b, dx, dy);
+        const Region andResult = a.intersect(b, dx, dy);
+        const Region subResult = a.subtract(b, dx, dy);
+        const Region andRectResult = a.intersect(rect);
+        const Region subRectResult = a.subtract(rect);
+
+        for (int x = -2; x < X_MAX + 2; x++) {
+            for (int y = -2; y < Y_MAX + 2; y++) {
+                const bool inA = a.contains(x, y);
+                const bool inB = b.contains(x - dx, y - dy);
+                const bool inRect = x >= rect.left && x < rect.right &&
+                        y >= rect.top && y < rect.bottom;
+                ASSERT_EQ(inA || inB, orResult.contains(x, y));
+                ASSERT_EQ(inA && inB, andResult.contains(x, y));
+                ASSERT_EQ(inA && !inB, subResult.contains(x, y));
+                ASSERT_EQ(inA && inRect, andRectResult.contains(x, y));
+                ASSERT_EQ(inA && !inRect, subRectResult.contains(x, y));
+            }
+        }
+    }
+}
+
 }; // namespace android
 
@@ -0,0 +1,135 @@
+/*
+ * Copyright 2019 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#define LOG_TAG "TransformTest"
+
+#include <math.h>
+
+#include <algorithm>
+#include <vector>
+
+#include <ui/Transform.h>
+
+#include <gtest/gtest.h>
+
+namespace android {
+namespace ui {
+
+// Transforms the four corners of the rect, as Transform does for transforms
+// that do not preserve rects.
+static Rect transformCorners(const Transform& t, const Rect& in, bool roundOutwards) {
+    const vec2 corners[4] = {
+            t.transform(vec2(in.left, in.top)), t.transform(vec2(in.right, in.top)),
+            t.transform(vec2(in.left, in.bottom)), t.transform(vec2(in.right, in.bottom))};
+    float l = corners[0][0], t0 = corners[0][1], r = corners[0][0], b = corners[0][1];
+    for (const vec2& c : corners) {
+        l = std::min(l, c[0]);
+        t0 = std::min(t0, c[1]);
+        r = std::max(r, c[0]);
+        b = std::max(b, c[1]);
+    }
+    if (roundOutwards) {
+        return Rect(static_cast<int32_t>(floorf(l)), static_cast<int32_t>(floorf(t0)),
+                    static_cast<int32_t>(ceilf(r)), static_cast<int32_t>(ceilf(b)));
+    }
+    return Rect(static_cast<int32_t>(floorf(l + 0.5f)), static_cast<int32_t>(floorf(t0 + 0.5f)),
+                static_cast<int32_t>(floorf(r + 0.5f)), static_cast<int32_t>(floorf(b + 0.5f)));
+}
+
+static std::vector<Transform> makeAlignedTransforms() {
+    std::vector<Transform> transforms;
+    for (uint32_t orientation :
+         {Transform::ROT_0, Transform::FLIP_H, Transform::FLIP_V, Transform::ROT_90,
+          Transform::ROT_180, Transform::ROT_270}) {
+        Transform rotation;
+        rotation.set(orientation, 1080, 1920);
+        Transform translation;
+        translation.set(12.25f, -7.5f);
+        Transform scale;
+        scale.set(1.5f, 0, 0, 0.75f);
+        transforms.push_back(rotation);
+        transforms.push_back(translation * rotation);
+        transforms.push_back(translation * rotation * scale);
+    }
+    return transforms;
+}
+
+static const Rect kRects[] = {
+        Rect(0, 0, 100, 200), Rect(-5, 3, 7, 11), Rect(10, 20, 10, 20), Rect(33, 17, 1, 2),
+        Rect(1079, 1919, 1080, 1920),
+};
+
+TEST(TransformTest, AlignedRectsMatchTransformedCorners) {
+    for (const Transform& t : makeAlignedTransforms()) {
+        ASSERT_TRUE(t.preserveRects());
+        for (bool roundOutwards : {false, true}) {
+            for (const Rect& rect : kRects) {
+                EXPECT_EQ(transformCorners(t, rect, roundOutwards),
+                          t.transform(rect, roundOutwards))
+                        << "orientation " << t.getOrientation();
+            }
+        }
+    }
+}
+
+TEST(TransformTest, BatchMatchesSingleRects) {
+    Transform skew;
+    skew.set(1, 0.5f, 0.25f, 1);
+    std::vector<Transform> transforms = makeAlignedTransforms();
+    transforms.push_back(skew);
+
+    constexpr size_t count = sizeof(kRects) / sizeof(kRects[0]);
+    for (const Transform& t : transforms) {
+        for (bool roundOutwards : {false, true}) {
+            Rect out[count];
+            t.transform(kRects, count, out, roundOutwards);
+            for (size_t i = 0; i < count; i++) {
+                EXPECT_EQ(transformCorners(t, kRects[i], roundOutwards), out[i]);
+            }
+        }
+    }
+}
+
+TEST(TransformTest, AlignedFloatRectsMatchTransformedCorners) {
+    const FloatRect in(-1.5f, 2.25f, 40.75f, 19.0f);
+    for (const Transform& t : makeAlignedTransforms()) {
+        const vec2 lt = t.transform(vec2(in.left, in.top));
+        const vec2 rb = t.transform(vec2(in.right, in.bottom));
+        const FloatRect out = t.transform(in);
+        EXPECT_EQ(std::min(lt[0], rb[0]), out.left);
+        EXPECT_EQ(std::min(lt[1], rb[1]), out.top);
+        EXPECT_EQ(std::max(lt[0], rb[0]), out.right);
+        EXPECT_EQ(std::max(lt[1], rb[1]), out.bottom);
+    }
+}
+
+TEST(TransformTest, ComparesMatrices) {
+    Transform translation;
+    translation.set(12.25f, -7.5f);
+    Transform sameTranslation;
+    sameTranslation.set(12.25f, -7.5f);
+    Transform otherTranslation;
+    otherTranslation.set(12.25f, 7.5f);
+
+    EXPECT_TRUE(translation == sameTranslation);
+    EXPECT_FALSE(translation != sameTranslation);
+    EXPECT_TRUE(translation != otherTranslation);
+    EXPECT_TRUE(Transform() == translation * translation.inverse());
+    EXPECT_TRUE(Transform() != translation);
+}
+
+} // namespace ui
+} // namespace android
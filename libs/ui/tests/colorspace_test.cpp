@@ -178,6 +178,45 @@ TEST_F(ColorSpaceTest, LUT) {
     r = lut.get()[16 * 17 * 17 + 0 * 17 + 16]; // y (G) is flipped
     EXPECT_TRUE(all(lessThan(abs(r - float3{1.0f, 1.0f, 1.0f}), float3{1e-4f})));
 
+    // Every entry is what the connector computes
+    ColorSpaceConnector connector(ColorSpace::sRGB(), ColorSpace::AdobeRGB());
+    const float m = 1.0f / 16.0f;
+    for (uint32_t z = 0; z < 17; z++) {
+        for (uint32_t y = 0; y < 17; y++) {
+            for (uint32_t x = 0; x < 17; x++) {
+                EXPECT_EQ(connector.transform({x * m, (16 - y) * m, z * m}),
+                          lut.get()[z * 17 * 17 + y * 17 + x]);
+            }
+        }
+    }
+}
+
+TEST_F(ColorSpaceTest, CachedLUT) {
+    auto lut = ColorSpace::getLUT(17, ColorSpace::sRGB(), ColorSpace::AdobeRGB());
+    ASSERT_TRUE(lut != nullptr);
+    EXPECT_EQ(lut, ColorSpace::getLUT(17, ColorSpace::sRGB(), ColorSpace::AdobeRGB()));
+    EXPECT_NE(lut, ColorSpace::getLUT(17, ColorSpace::sRGB(), ColorSpace::DisplayP3()));
+    EXPECT_NE(lut, ColorSpace::getLUT(9, ColorSpace::sRGB(), ColorSpace::AdobeRGB()));
+
+    auto created = ColorSpace::createLUT(17, ColorSpace::sRGB(), ColorSpace::AdobeRGB());
+    for (uint32_t i = 0; i < 17 * 17 * 17; i++) {
+        EXPECT_EQ(created.get()[i], lut.get()[i]);
+    }
+}
+
+TEST_F(ColorSpaceTest, TransferLUT) {
+    ColorSpace sRGB = ColorSpace::sRGB();
+    auto eotf = sRGB.getEOTFLUT(256);
+    auto oetf = sRGB.getOETFLUT(256);
+    ASSERT_TRUE(eotf != nullptr);
+    ASSERT_TRUE(oetf != nullptr);
+    EXPECT_EQ(eotf, sRGB.getEOTFLUT(256));
+    EXPECT_NE(eotf, ColorSpace::linearSRGB().getEOTFLUT(256));
+
+    for (uint32_t i = 0; i < 256; i++) {
+        EXPECT_EQ(sRGB.getEOTF()(i * (1.0f / 255.0f)), eotf.get()[i]);
+        EXPECT_EQ(sRGB.getOETF()(i * (1.0f / 255.0f)), oetf.get()[i]);
+    }
 }
 
 }; // namespace android
@@ -166,6 +166,34 @@ TYPED_TEST(BroadcastRingTest, PutGet) {
   }
 }
 
+TYPED_TEST(BroadcastRingTest, GetLatest) {
+  using Record = typename TypeParam::Record;
+  using Ring = typename TypeParam::Ring;
+  Ring ring;
+  auto mmap = CreateRing(&ring, Ring::Traits::MinCount());
+  uint32_t sequence = ring.GetNextSequence();
+  {
+    Record record;
+    EXPECT_FALSE(ring.GetLatest(&sequence, &record));
+    EXPECT_EQ(Record(), record);
+  }
+  for (uint32_t i = 0; i < 2 * ring.record_count() + 1; ++i)
+    ring.Put(Record(FillChar(i)));
+  {
+    Record record;
+    EXPECT_TRUE(ring.GetLatest(&sequence, &record));
+    EXPECT_EQ(ring.GetNewestSequence(), sequence);
+    EXPECT_EQ(Record(FillChar(2 * ring.record_count())), record);
+  }
+  {
+    uint32_t next_sequence = sequence + 1;
+    Record record;
+    EXPECT_FALSE(ring.GetLatest(&next_sequence, &record));
+    EXPECT_EQ(sequence + 1, next_sequence);
+    EXPECT_EQ(Record(), record);
+  }
+}
+
 TYPED_TEST(BroadcastRingTest, FillOnce) {
   using Record = typename TypeParam::Record;
   using Ring = typename TypeParam::Ring;
@@ -827,6 +855,29 @@ std::unique_ptr<std::thread> CheckFillTask(std::atomic<bool>* quit,
       }));
 }
 
+template <typename Ring>
+std::unique_ptr<std::thread> CheckLatestTask(std::atomic<bool>* quit,
+                                             void* in_base, size_t in_size) {
+  return std::unique_ptr<std::thread>(
+      new std::thread([quit, in_base, in_size]() {
+        using Record = typename Ring::Record;
+
+        bool import_ok;
+        Ring in_ring;
+        std::tie(in_ring, import_ok) = Ring::Import(in_base, in_size);
+        ASSERT_TRUE(import_ok);
+
+        uint32_t sequence = in_ring.GetNextSequence();
+        while (!std::atomic_load_explicit(quit, std::memory_order_relaxed)) {
+          Record record;
+          if (in_ring.GetLatest(&sequence, &record)) {
+            ASSERT_EQ(Record(record.v[0]), record);
+            sequence++;
+          }
+        }
+      }));
+}
+
 template <typename Ring>
 void ThreadedOverwriteTorture() {
   using Record = typename Ring::Record;
@@ -842,6 +893,8 @@ void ThreadedOverwriteTorture() {
     std::atomic<bool> quit(false);
     std::unique_ptr<std::thread> check_task =
         CheckFillTask<Ring>(&quit, out_mmap.mmap(), out_mmap.size);
+    std::unique_ptr<std::thread> latest_task =
+        CheckLatestTask<Ring>(&quit, out_mmap.mmap(), out_mmap.size);
 
     constexpr int kIterations = 10000;
     for (int i = 0; i < kIterations; ++i) {
@@ -851,6 +904,7 @@ void ThreadedOverwriteTorture() {
 
     std::atomic_store_explicit(&quit, true, std::memory_order_relaxed);
     check_task->join();
+    latest_task->join();
   }
 }
 
@@ -369,6 +369,53 @@ class BroadcastRing {
     return Get(sequence, record);
   }
 
+  // Copies the newest available record with sequence at least |*sequence| to
+  // |record| without ever re-trying.
+  //
+  // Returns false if there is no recent enough record available, or if the
+  // newest record was overwritten while it was being copied. The latter needs
+  // the writer to lap the entire ring during a single record copy, so for a
+  // reasonably sized ring this is the same as GetNewest() with a bounded cost,
+  // which is what latency sensitive readers such as render threads want.
+  //
+  // Updates |*sequence| with the sequence number of the record returned. To get
+  // the following record, increment this number by one.
+  //
+  // This synchronizes with Reserve() and Publish() exactly like Get(). Since
+  // only the record just below |tail| is read, it is enough to check that
+  // |head| did not move past it: sequence numbers are compared by signed
+  // difference, so no loads of |head| before the copy are needed.
+  bool GetLatest(uint32_t* sequence /*inout*/, Record* record /*out*/) const {
+    uint32_t tail = std::atomic_load_explicit(&header_mmap()->tail,
+                                              std::memory_order_acquire);
+    uint32_t newest_sequence = tail - 1;
+    if (*sequence == tail) return false;  // No new records available.
+
+    uint32_t head = std::atomic_load_explicit(&header_mmap()->head,
+                                              std::memory_order_relaxed);
+    if (static_cast<int32_t>(newest_sequence - head) < 0)
+      return false;  // Empty ring, or the newest record is being replaced.
+
+    Geometry geometry = CalculateGeometry(record_count(), record_size(),
+                                          newest_sequence, tail);
+    RecordStorage* record_storage = record_mmap_reader(geometry.head_index);
+
+    Record latest;
+    GetRecordInternal(record_storage, &latest);
+
+    // NB: It is not sufficient to change this to a load-acquire of |head|.
+    std::atomic_thread_fence(std::memory_order_acquire);
+
+    uint32_t final_head = std::atomic_load_explicit(&header_mmap()->head,
+                                                    std::memory_order_relaxed);
+    if (static_cast<int32_t>(newest_sequence - final_head) < 0)
+      return false;  // Overwritten during the copy.
+
+    *sequence = newest_sequence;
+    *record = latest;
+    return true;
+  }
+
   // Returns true if this instance has been created or imported.
   bool is_valid() const { return !!data_.mmap; }
 
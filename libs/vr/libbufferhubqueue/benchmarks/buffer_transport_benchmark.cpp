@@ -8,18 +8,23 @@
 #include <gui/BufferItemConsumer.h>
 #include <gui/Surface.h>
 #include <private/dvr/epoll_file_descriptor.h>
+#include <utils/Timers.h>
 #include <utils/Trace.h>
 
+#include <algorithm>
 #include <chrono>
 #include <functional>
 #include <iostream>
+#include <mutex>
 #include <thread>
 #include <vector>
 
 #include <dlfcn.h>
 #include <poll.h>
+#include <sched.h>
 #include <sys/epoll.h>
 #include <sys/wait.h>
+#include <unistd.h>
 
 // Use ALWAYS at the tag level. Control is performed manually during command
 // line processing.
@@ -39,12 +44,85 @@ static const uint64_t kBufferUsage =
     GRALLOC_USAGE_SW_READ_OFTEN | GRALLOC_USAGE_SW_WRITE_OFTEN;
 static const uint32_t kBufferLayer = 1;
 static const int kMaxAcquiredImages = 1;
-static const int kQueueDepth = 2;  // We are double buffering for this test.
 static const size_t kMaxQueueCounts = 128;
 static const int kInvalidFence = -1;
 
+// CPUs to pin the producer threads and the consumer to, set on the command
+// line. Producer threads take consecutive CPUs from the first one. Negative
+// values leave the scheduler free to place the threads.
+static int producer_cpu = -1;
+static int consumer_cpu = -1;
+
 enum BufferTransportServiceCode {
   CREATE_BUFFER_QUEUE = IBinder::FIRST_CALL_TRANSACTION,
+  TAKE_CONSUMER_LATENCIES,
+};
+
+// Pins the calling thread, and the threads it creates later on, to a CPU.
+static void PinToCpu(int cpu) {
+  if (cpu < 0) {
+    return;
+  }
+  cpu_set_t cpu_set;
+  CPU_ZERO(&cpu_set);
+  CPU_SET(cpu % sysconf(_SC_NPROCESSORS_CONF), &cpu_set);
+  if (sched_setaffinity(0, sizeof(cpu_set), &cpu_set) < 0) {
+    LOG(ERROR) << "Failed to pin thread to CPU " << cpu << ": "
+               << strerror(errno);
+  }
+}
+
+// Returns the p-th percentile of the samples, which get reordered.
+static double Percentile(std::vector<double>* samples, double p) {
+  if (samples->empty()) {
+    return 0;
+  }
+  auto nth = samples->begin() + static_cast<size_t>(p / 100.0 *
+                                                    (samples->size() - 1));
+  std::nth_element(samples->begin(), nth, samples->end());
+  return *nth;
+}
+
+// Reports the mean and the tail of the samples as benchmark counters, which
+// land in the JSON output with --benchmark_format=json.
+static void ReportLatencies(State& state, const std::string& name,
+                            std::vector<double> samples,
+                            ::benchmark::Counter::Flags flags) {
+  double total = 0;
+  for (double sample : samples) {
+    total += sample;
+  }
+  const double mean = samples.empty() ? 0 : total / samples.size();
+  state.counters[name + "_us"] = ::benchmark::Counter(mean, flags);
+  state.counters[name + "_p50_us"] =
+      ::benchmark::Counter(Percentile(&samples, 50), flags);
+  state.counters[name + "_p90_us"] =
+      ::benchmark::Counter(Percentile(&samples, 90), flags);
+  state.counters[name + "_p99_us"] =
+      ::benchmark::Counter(Percentile(&samples, 99), flags);
+}
+
+// Records the time buffers take from being queued, which Surface stamps them
+// with, until the consumer has acquired them and waited for their fences.
+class LatencyRecorder {
+ public:
+  void Record(int64_t queue_time_ns) {
+    const nsecs_t now = systemTime(SYSTEM_TIME_MONOTONIC);
+    std::lock_guard<std::mutex> lock(mutex_);
+    samples_us_.push_back((now - queue_time_ns) / 1000.0);
+  }
+
+  // Returns the samples recorded since the last call.
+  std::vector<double> Take() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    std::vector<double> samples;
+    samples.swap(samples_us_);
+    return samples;
+  }
+
+ private:
+  std::mutex mutex_;
+  std::vector<double> samples_us_;
 };
 
 // A binder services that minics a compositor that consumes buffers. It provides
@@ -59,15 +137,18 @@ class BufferTransportService : public BBinder {
   virtual status_t onTransact(uint32_t code, const Parcel& data, Parcel* reply,
                               uint32_t flags = 0) {
     (void)flags;
-    (void)data;
     switch (code) {
       case CREATE_BUFFER_QUEUE: {
-        auto new_queue = std::make_shared<BufferQueueHolder>(this);
+        const bool wait_for_fences = data.readInt32() != 0;
+        auto new_queue =
+            std::make_shared<BufferQueueHolder>(this, wait_for_fences);
         reply->writeStrongBinder(
             IGraphicBufferProducer::asBinder(new_queue->producer));
         buffer_queues_.push_back(new_queue);
         return OK;
       }
+      case TAKE_CONSUMER_LATENCIES:
+        return reply->writeDoubleVector(latency_.Take());
       default:
         return UNKNOWN_TRANSACTION;
     };
@@ -76,9 +157,12 @@ class BufferTransportService : public BBinder {
  private:
   struct FrameListener : public ConsumerBase::FrameAvailableListener {
    public:
-    FrameListener(BufferTransportService* /*service*/,
-                  sp<BufferItemConsumer> buffer_item_consumer)
-        : buffer_item_consumer_(buffer_item_consumer) {}
+    FrameListener(BufferTransportService* service,
+                  sp<BufferItemConsumer> buffer_item_consumer,
+                  bool wait_for_fences)
+        : service_(service),
+          buffer_item_consumer_(buffer_item_consumer),
+          wait_for_fences_(wait_for_fences) {}
 
     void onFrameAvailable(const BufferItem& /*item*/) override {
       BufferItem buffer;
@@ -94,6 +178,12 @@ class BufferTransportService : public BBinder {
         return;
       }
 
+      if (wait_for_fences_) {
+        ATRACE_NAME("WaitForAcquireFence");
+        buffer.mFence->waitForever("BufferTransportService");
+      }
+      service_->latency_.Record(buffer.mTimestamp);
+
       {
         ATRACE_NAME("ReleaseBuffer");
         ret = buffer_item_consumer_->releaseBuffer(buffer);
@@ -106,18 +196,21 @@ class BufferTransportService : public BBinder {
     }
 
    private:
+    BufferTransportService* service_;
     sp<BufferItemConsumer> buffer_item_consumer_;
+    bool wait_for_fences_;
   };
 
   struct BufferQueueHolder {
-    explicit BufferQueueHolder(BufferTransportService* service) {
+    BufferQueueHolder(BufferTransportService* service, bool wait_for_fences) {
       BufferQueue::createBufferQueue(&producer, &consumer);
 
       sp<BufferItemConsumer> buffer_item_consumer =
           new BufferItemConsumer(consumer, kBufferUsage, kMaxAcquiredImages,
                                  /*controlledByApp=*/true);
       buffer_item_consumer->setName(String8("BinderBufferTransport"));
-      frame_listener_ = new FrameListener(service, buffer_item_consumer);
+      frame_listener_ =
+          new FrameListener(service, buffer_item_consumer, wait_for_fences);
       buffer_item_consumer->setFrameAvailableListener(frame_listener_);
     }
 
@@ -128,6 +221,7 @@ class BufferTransportService : public BBinder {
     sp<FrameListener> frame_listener_;
   };
 
+  LatencyRecorder latency_;
   std::vector<std::shared_ptr<BufferQueueHolder>> buffer_queues_;
 };
 
@@ -139,7 +233,14 @@ class BufferTransport {
   virtual ~BufferTransport() {}
 
   virtual int Start() = 0;
-  virtual sp<Surface> CreateSurface() = 0;
+
+  // Creates a surface whose consumer optionally waits for the acquire fence of
+  // each buffer before releasing it.
+  virtual sp<Surface> CreateSurface(bool wait_for_fences) = 0;
+
+  // Returns the consumer latencies, in microseconds, of the buffers acquired
+  // since the last call.
+  virtual std::vector<double> TakeConsumerLatencies() = 0;
 };
 
 // Binder-based buffer transport backend.
@@ -167,9 +268,10 @@ class BinderBufferTransport : public BufferTransport {
     return 0;
   }
 
-  sp<Surface> CreateSurface() override {
+  sp<Surface> CreateSurface(bool wait_for_fences) override {
     Parcel data;
     Parcel reply;
+    data.writeInt32(wait_for_fences);
     int error = service_->transact(CREATE_BUFFER_QUEUE, data, &reply);
     if (error != OK) {
       LOG(ERROR) << "Failed to get buffer queue over binder.";
@@ -199,6 +301,20 @@ class BinderBufferTransport : public BufferTransport {
     return surface;
   }
 
+  std::vector<double> TakeConsumerLatencies() override {
+    Parcel data;
+    Parcel reply;
+    std::vector<double> latencies;
+    int error = service_->transact(TAKE_CONSUMER_LATENCIES, data, &reply);
+    if (error == OK) {
+      error = reply.readDoubleVector(&latencies);
+    }
+    if (error != OK) {
+      LOG(ERROR) << "Failed to get consumer latencies over binder.";
+    }
+    return latencies;
+  }
+
  private:
   sp<IBinder> service_;
 };
@@ -258,6 +374,7 @@ class BufferHubTransport : public BufferTransport {
         LOG(ERROR) << "Failed to set scheduler policy, ret=" << ret;
         return;
       }
+      PinToCpu(consumer_cpu);
 
       stopped_.store(false);
       LOG(INFO) << "Reader Thread Running...";
@@ -290,8 +407,9 @@ class BufferHubTransport : public BufferTransport {
     return 0;
   }
 
-  sp<Surface> CreateSurface() override {
-    auto new_queue = std::make_shared<BufferQueueHolder>();
+  sp<Surface> CreateSurface(bool wait_for_fences) override {
+    auto new_queue =
+        std::make_shared<BufferQueueHolder>(wait_for_fences, &latency_);
     if (!new_queue->IsReady()) {
       LOG(ERROR) << "Failed to create BufferHub-based BufferQueue.";
       return nullptr;
@@ -318,9 +436,14 @@ class BufferHubTransport : public BufferTransport {
     return static_cast<Surface*>(new_queue->GetSurface());
   }
 
+  std::vector<double> TakeConsumerLatencies() override {
+    return latency_.Take();
+  }
+
  private:
   struct BufferQueueHolder {
-    BufferQueueHolder() {
+    BufferQueueHolder(bool wait_for_fences, LatencyRecorder* latency)
+        : wait_for_fences_(wait_for_fences), latency_(latency) {
       int ret = 0;
       ret = dvr_.Api().WriteBufferQueueCreate(
           kBufferWidth, kBufferHeight, kBufferFormat, kBufferLayer,
@@ -383,6 +506,17 @@ class BufferHubTransport : public BufferTransport {
         return;
       }
 
+      if (acquire_fence != kInvalidFence) {
+        if (wait_for_fences_) {
+          ATRACE_NAME("WaitForAcquireFence");
+          pollfd fence_poll = {.fd = acquire_fence, .events = POLLIN};
+          while (poll(&fence_poll, 1, /*timeout=*/-1) < 0 && errno == EINTR) {
+          }
+        }
+        close(acquire_fence);
+      }
+      latency_->Record(metadata.timestamp);
+
       if (buffer != nullptr) {
         ATRACE_NAME("ReleaseBuffer");
         ret = dvr_.Api().ReadBufferQueueReleaseBuffer(read_queue_, buffer,
@@ -397,6 +531,8 @@ class BufferHubTransport : public BufferTransport {
     DvrWriteBufferQueue* write_queue_ = nullptr;
     DvrReadBufferQueue* read_queue_ = nullptr;
     ANativeWindow* surface_ = nullptr;
+    bool wait_for_fences_;
+    LatencyRecorder* latency_;
   };
 
   static DvrApi dvr_;
@@ -404,6 +540,7 @@ class BufferHubTransport : public BufferTransport {
   std::thread reader_thread_;
 
   dvr::EpollFileDescriptor epoll_fd_;
+  LatencyRecorder latency_;
   std::vector<std::shared_ptr<BufferQueueHolder>> buffer_queues_;
 };
 
@@ -417,11 +554,17 @@ enum TransportType {
 // Main test suite, which supports two transport backend: 1) BinderBufferQueue,
 // 2) BufferHubQueue. The test case drives the producer end of both transport
 // backend by queuing buffers into the buffer queue by using ANativeWindow API.
+//
+// The arguments are the transport, the number of buffers in each queue, and
+// whether consumers wait for acquire fences. Each benchmark thread is one
+// producer with its own queue.
 class BufferTransportBenchmark : public ::benchmark::Fixture {
  public:
   void SetUp(State& state) override {
     if (state.thread_index == 0) {
       const int transport = state.range(0);
+      const int buffer_count = state.range(1);
+      const bool wait_for_fences = state.range(2) != 0;
       switch (transport) {
         case kBinderBufferTransport:
           transport_.reset(new BinderBufferTransport);
@@ -444,11 +587,32 @@ class BufferTransportBenchmark : public ::benchmark::Fixture {
       surfaces_.resize(state.threads);
       for (int i = 0; i < state.threads; i++) {
         // Common setup every thread needs.
-        surfaces_[i] = transport_->CreateSurface();
+        surfaces_[i] = transport_->CreateSurface(wait_for_fences);
         CHECK(surfaces_[i]);
 
+        ANativeWindow* window = static_cast<ANativeWindow*>(surfaces_[i].get());
+        int error = native_window_set_buffer_count(window, buffer_count);
+        if (error != 0) {
+          LOG(ERROR) << "Failed to set buffer count to " << buffer_count
+                     << ", error=" << error;
+        }
+
+        // Lock buffers a couple time from the queue, so that we have the
+        // buffer allocated.
+        for (int j = 0; j < buffer_count; j++) {
+          ANativeWindow_Buffer buffer;
+          error = ANativeWindow_lock(window, &buffer,
+                                     /*inOutDirtyBounds=*/nullptr);
+          CHECK_EQ(error, 0);
+          error = ANativeWindow_unlockAndPost(window);
+          CHECK_EQ(error, 0);
+        }
+
         LOG(INFO) << "Surface initialized on thread " << i << ".";
       }
+
+      // Leave the allocating buffers out of the consumer latencies.
+      transport_->TakeConsumerLatencies();
     }
   }
 
@@ -469,65 +633,80 @@ BENCHMARK_DEFINE_F(BufferTransportBenchmark, Producers)(State& state) {
   ANativeWindow* window = nullptr;
   ANativeWindow_Buffer buffer;
   int32_t error = 0;
-  double total_gain_buffer_us = 0;
-  double total_post_buffer_us = 0;
-  int iterations = 0;
+  std::vector<double> gain_buffer_us;
+  std::vector<double> post_buffer_us;
+  std::vector<double> producer_us;
 
   while (state.KeepRunning()) {
     if (window == nullptr) {
       CHECK(surfaces_[state.thread_index]);
       window = static_cast<ANativeWindow*>(surfaces_[state.thread_index].get());
-
-      // Lock buffers a couple time from the queue, so that we have the buffer
-      // allocated.
-      for (int i = 0; i < kQueueDepth; i++) {
-        error = ANativeWindow_lock(window, &buffer,
-                                   /*inOutDirtyBounds=*/nullptr);
-        CHECK_EQ(error, 0);
-        error = ANativeWindow_unlockAndPost(window);
-        CHECK_EQ(error, 0);
+      if (producer_cpu >= 0) {
+        PinToCpu(producer_cpu + state.thread_index);
       }
     }
 
+    std::chrono::duration<double, std::micro> gain_us;
     {
       ATRACE_NAME("GainBuffer");
       auto t1 = std::chrono::high_resolution_clock::now();
       error = ANativeWindow_lock(window, &buffer,
                                  /*inOutDirtyBounds=*/nullptr);
       auto t2 = std::chrono::high_resolution_clock::now();
-      std::chrono::duration<double, std::micro> delta_us = t2 - t1;
-      total_gain_buffer_us += delta_us.count();
+      gain_us = t2 - t1;
     }
     CHECK_EQ(error, 0);
 
+    std::chrono::duration<double, std::micro> post_us;
     {
       ATRACE_NAME("PostBuffer");
       auto t1 = std::chrono::high_resolution_clock::now();
       error = ANativeWindow_unlockAndPost(window);
       auto t2 = std::chrono::high_resolution_clock::now();
-      std::chrono::duration<double, std::micro> delta_us = t2 - t1;
-      total_post_buffer_us += delta_us.count();
+      post_us = t2 - t1;
     }
     CHECK_EQ(error, 0);
 
-    iterations++;
+    gain_buffer_us.push_back(gain_us.count());
+    post_buffer_us.push_back(post_us.count());
+    producer_us.push_back(gain_us.count() + post_us.count());
   }
 
-  state.counters["gain_buffer_us"] = ::benchmark::Counter(
-      total_gain_buffer_us / iterations, ::benchmark::Counter::kAvgThreads);
-  state.counters["post_buffer_us"] = ::benchmark::Counter(
-      total_post_buffer_us / iterations, ::benchmark::Counter::kAvgThreads);
-  state.counters["producer_us"] = ::benchmark::Counter(
-      (total_gain_buffer_us + total_post_buffer_us) / iterations,
-      ::benchmark::Counter::kAvgThreads);
+  // Producer figures are per thread, averaged over the threads.
+  ReportLatencies(state, "gain_buffer", std::move(gain_buffer_us),
+                  ::benchmark::Counter::kAvgThreads);
+  ReportLatencies(state, "post_buffer", std::move(post_buffer_us),
+                  ::benchmark::Counter::kAvgThreads);
+  ReportLatencies(state, "producer", std::move(producer_us),
+                  ::benchmark::Counter::kAvgThreads);
+
+  // Consumer figures cover all the queues, so only one thread reports them.
+  if (state.thread_index == 0) {
+    ReportLatencies(state, "consumer_latency",
+                    transport_->TakeConsumerLatencies(),
+                    ::benchmark::Counter::kDefaults);
+  }
+}
+
+// Transports, buffer counts and fence waits to compare.
+static void TransportArguments(::benchmark::internal::Benchmark* benchmark) {
+  for (int transport : {kBinderBufferTransport, kBufferHubTransport}) {
+    for (int buffer_count : {2, 3, 4}) {
+      for (int wait_for_fences : {0, 1}) {
+        benchmark->Args({transport, buffer_count, wait_for_fences});
+      }
+    }
+  }
 }
 
 BENCHMARK_REGISTER_F(BufferTransportBenchmark, Producers)
     ->Unit(::benchmark::kMicrosecond)
-    ->Ranges({{kBinderBufferTransport, kBufferHubTransport}})
+    ->Apply(TransportArguments)
     ->ThreadRange(1, 32);
 
 static void runBinderServer() {
+  // Binder threads inherit the CPU of the main thread.
+  PinToCpu(consumer_cpu);
   ProcessState::self()->setThreadPoolMaxThreadCount(0);
   ProcessState::self()->startThreadPool();
 
@@ -550,11 +729,14 @@ static void runBinderServer() {
 
 // To run binder-based benchmark, use:
 // adb shell buffer_transport_benchmark \
-//   --benchmark_filter="BufferTransportBenchmark/ContinuousLoad/0/"
+//   --benchmark_filter="BufferTransportBenchmark/Producers/0/"
 //
 // To run bufferhub-based benchmark, use:
 // adb shell buffer_transport_benchmark \
-//   --benchmark_filter="BufferTransportBenchmark/ContinuousLoad/1/"
+//   --benchmark_filter="BufferTransportBenchmark/Producers/1/"
+//
+// For results which scripts can compare, add --benchmark_format=json, or
+// --benchmark_out=<file> --benchmark_out_format=json.
 int main(int argc, char** argv) {
   bool tracing_enabled = false;
 
@@ -563,12 +745,21 @@ int main(int argc, char** argv) {
     if (std::string(argv[i]) == "--help") {
       std::cout << "Usage: binderThroughputTest [OPTIONS]" << std::endl;
       std::cout << "\t--trace: Enable systrace logging." << std::endl;
+      std::cout << "\t--producer_cpu=<cpu>: Pin producer threads to CPUs "
+                   "from <cpu> on."
+                << std::endl;
+      std::cout << "\t--consumer_cpu=<cpu>: Pin the consumer to <cpu>."
+                << std::endl;
       return 0;
     }
     if (std::string(argv[i]) == "--trace") {
       tracing_enabled = true;
       continue;
     }
+    if (sscanf(argv[i], "--producer_cpu=%d", &producer_cpu) == 1 ||
+        sscanf(argv[i], "--consumer_cpu=%d", &consumer_cpu) == 1) {
+      continue;
+    }
   }
 
   // Setup ATRACE/systrace based on command line.
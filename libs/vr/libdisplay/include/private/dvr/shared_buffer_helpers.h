@@ -87,14 +87,15 @@ class CPUMappedBroadcastRing : public CPUMappedBuffer {
   }
 
   // Helper function for getting records from the ring.
-  // Returns true if we were able to retrieve the latest.
+  // Returns true if we were able to retrieve the latest. This never spins on
+  // concurrent writes, so it is safe to call from latency sensitive threads.
   bool GetNewest(typename RingType::Record* record) {
     assert((usage_mode_ == CPUUsageMode::READ_OFTEN) ||
            (usage_mode_ == CPUUsageMode::READ_RARELY));
 
     auto ring = Ring();
     if (ring) {
-      return ring->GetNewest(&sequence_, record);
+      return ring->GetLatest(&sequence_, record);
     }
 
     return false;
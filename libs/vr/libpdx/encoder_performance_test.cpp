@@ -3,6 +3,7 @@
 #include <time.h>
 #include <unistd.h>
 
+#include <array>
 #include <chrono>
 #include <iomanip>
 #include <iostream>
@@ -11,6 +12,7 @@
 #include <pdx/rpc/argument_encoder.h>
 #include <pdx/rpc/message_buffer.h>
 #include <pdx/rpc/payload.h>
+#include <pdx/rpc/serializable.h>
 #include <pdx/utility.h>
 
 using namespace android::pdx::rpc;
@@ -403,6 +405,46 @@ class TestRunner {
   std::vector<TestEntry> tests_;
 };
 
+// Fields of a pose, as sent many times a frame in VR. The layout has no
+// padding, so it may be serialized as bytes.
+struct PoseFields {
+  std::array<float, 4> orientation;
+  std::array<float, 3> position;
+  std::array<float, 3> velocity;
+  int64_t timestamp_ns;
+  int32_t flags;
+  int32_t reserved;
+
+  bool operator!=(const PoseFields& other) const {
+    return memcmp(this, &other, sizeof(*this)) != 0;
+  }
+};
+
+// The same pose serialized member by member...
+struct MemberPose : PoseFields {
+ private:
+  PDX_SERIALIZABLE_MEMBERS(MemberPose, orientation, position, velocity,
+                           timestamp_ns, flags, reserved);
+};
+
+// ... and as bytes.
+struct BytesPose : PoseFields {
+ private:
+  PDX_SERIALIZABLE_BYTES(BytesPose);
+};
+
+template <typename T>
+T MakePose() {
+  T pose;
+  pose.orientation = {{0.f, 0.f, 0.70710677f, 0.70710677f}};
+  pose.position = {{0.1f, 1.6f, -0.3f}};
+  pose.velocity = {{0.f, 0.f, 0.f}};
+  pose.timestamp_ns = 123456789012345;
+  pose.flags = 3;
+  pose.reserved = 0;
+  return pose;
+}
+
 std::string GenerateContainerName(const std::string& type, size_t count) {
   std::stringstream ss;
   ss << type << "(" << count << ")";
@@ -476,6 +518,15 @@ int main(int /*argc*/, char** /*argv*/) {
         std::move(test_map));
   }
 
+  test_runner.AddTest("pose (members)", MakePose<MemberPose>());
+  test_runner.AddTest("pose (bytes)", MakePose<BytesPose>());
+  for (size_t len : {8, 64}) {
+    test_runner.AddTest(GenerateContainerName("vector<pose> (members)", len),
+                        std::vector<MemberPose>(len, MakePose<MemberPose>()));
+    test_runner.AddTest(GenerateContainerName("vector<pose> (bytes)", len),
+                        std::vector<BytesPose>(len, MakePose<BytesPose>()));
+  }
+
   // BufferWrapper can't be used with deserialization tests right now because
   // it requires external buffer to be filled in, which is not available.
   std::vector<std::vector<uint8_t>> data_buffers;
@@ -59,6 +59,7 @@ namespace rpc {
 //   * BufferWrapper of any POD type.
 //   * StringWrapper of any supported char type.
 //   * User types with correctly defined SerializableMembers member type.
+//   * User types defined with PDX_SERIALIZABLE_BYTES, as their raw bytes.
 //
 // Planned support for:
 //   * std::basic_string with all supported char types.
@@ -0,0 +1,84 @@
+#ifndef ANDROID_PDX_RPC_SHARED_BUFFER_H_
+#define ANDROID_PDX_RPC_SHARED_BUFFER_H_
+
+#include <cstddef>
+#include <cstdint>
+
+#include <pdx/file_handle.h>
+#include <pdx/status.h>
+
+#include "serializable.h"
+
+namespace android {
+namespace pdx {
+namespace rpc {
+
+// Buffer in shared memory for large payloads, such as images or long arrays of
+// samples. It serializes as a file handle and a size instead of its contents:
+// the sender fills it in place and the receiver reads it where it is, so the
+// payload is never copied into or out of the message buffer, nor through the
+// transport. Each buffer costs a shared memory region and a mapping on either
+// side, which only pays off for payloads of more than a few pages.
+//
+// The region is made read-only to every mapping but the creator's, and the
+// sender must not write to it once it is sent.
+//
+// Example usage:
+//     auto status = SharedBuffer::Create(size);
+//     if (!status)
+//       return status.error_status();
+//     SharedBuffer buffer = status.take();
+//     FillFrame(buffer.data(), buffer.size());
+//     ... pass the buffer as a remote method argument ...
+//
+//     // The receiver maps the buffer it deserialized.
+//     if (auto status = buffer.Map(); !status)
+//       return status;
+//     ConsumeFrame(buffer.data(), buffer.size());
+class SharedBuffer {
+ public:
+  SharedBuffer() = default;
+
+  // Adopts a region created by Create() and received some other way.
+  SharedBuffer(LocalHandle fd, std::size_t size);
+
+  SharedBuffer(SharedBuffer&& other) noexcept { *this = std::move(other); }
+  SharedBuffer& operator=(SharedBuffer&& other) noexcept;
+  ~SharedBuffer() { Unmap(); }
+
+  // Creates a buffer of the given size, mapped for writing.
+  static Status<SharedBuffer> Create(std::size_t size);
+
+  // Maps the buffer for reading, when not mapped already. Buffers are not
+  // mapped by deserialization, so should be deserialized into unmapped
+  // instances.
+  Status<void> Map();
+  void Unmap();
+
+  bool IsValid() const { return fd_.IsValid(); }
+  bool IsMapped() const { return data_ != nullptr; }
+  explicit operator bool() const { return IsValid(); }
+
+  // Null while unmapped. Only writable in buffers returned by Create().
+  std::uint8_t* data() { return data_; }
+  const std::uint8_t* data() const { return data_; }
+  std::size_t size() const { return size_; }
+
+  const LocalHandle& fd() const { return fd_; }
+
+ private:
+  LocalHandle fd_;
+  std::uint64_t size_{0};
+  std::uint8_t* data_{nullptr};
+
+  SharedBuffer(const SharedBuffer&) = delete;
+  void operator=(const SharedBuffer&) = delete;
+
+  PDX_SERIALIZABLE_MEMBERS(SharedBuffer, fd_, size_);
+};
+
+}  // namespace rpc
+}  // namespace pdx
+}  // namespace android
+
+#endif  // ANDROID_PDX_RPC_SHARED_BUFFER_H_
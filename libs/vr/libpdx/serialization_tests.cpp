@@ -2,6 +2,7 @@
 #include <fcntl.h>
 #include <unistd.h>
 
+#include <algorithm>
 #include <memory>
 #include <string>
 #include <thread>
@@ -14,6 +15,7 @@
 #include <pdx/rpc/payload.h>
 #include <pdx/rpc/serializable.h>
 #include <pdx/rpc/serialization.h>
+#include <pdx/rpc/shared_buffer.h>
 #include <pdx/rpc/string_wrapper.h>
 #include <pdx/utility.h>
 
@@ -65,6 +67,19 @@ struct TestType {
   PDX_SERIALIZABLE_MEMBERS(TestType, a, b, c, d);
 };
 
+struct TestBytesType {
+  std::int32_t a;
+  float b;
+  std::int64_t c;
+
+  bool operator==(const TestBytesType& other) const {
+    return a == other.a && b == other.b && c == other.c;
+  }
+
+ private:
+  PDX_SERIALIZABLE_BYTES(TestBytesType);
+};
+
 template <typename FileHandleType>
 struct TestTemplateType {
   FileHandleType fd;
@@ -735,6 +750,40 @@ TEST(SerializationTest, LocalHandle) {
   result.Clear();
 }
 
+TEST(SerializationTest, SharedBuffer) {
+  Payload result;
+  Payload expected;
+  const std::size_t kSize = 1 << 20;
+
+  auto status = SharedBuffer::Create(kSize);
+  ASSERT_TRUE(status);
+  SharedBuffer buffer = status.take();
+  ASSERT_TRUE(buffer.IsMapped());
+  std::fill(buffer.data(), buffer.data() + kSize, 0x5a);
+
+  // Only the handle and the size are serialized, not the contents.
+  Serialize(buffer, &result);
+  expected = decltype(expected)(
+      {ENCODING_TYPE_FIXARRAY_MIN + 2, ENCODING_TYPE_FIXEXT2,
+       ENCODING_EXT_TYPE_FILE_DESCRIPTOR, 0, 0, ENCODING_TYPE_UINT32, 0, 0,
+       0x10, 0});
+  EXPECT_EQ(expected, result);
+  EXPECT_EQ(1u, result.FdCount());
+  EXPECT_EQ(buffer.fd().Get(), result.FdArray()[0]);
+
+  // A receiver maps the same memory, read-only.
+  SharedBuffer received{buffer.fd().Duplicate(), kSize};
+  EXPECT_FALSE(received.IsMapped());
+  ASSERT_TRUE(received.Map());
+  EXPECT_EQ(0x5a, received.data()[kSize - 1]);
+  buffer.data()[0] = 0xa5;
+  EXPECT_EQ(0xa5, received.data()[0]);
+
+  // Sizes past the end of the region are refused.
+  SharedBuffer oversized{buffer.fd().Duplicate(), 2 * kSize};
+  EXPECT_FALSE(oversized.Map());
+}
+
 TEST(SerializationTest, string) {
   Payload result;
   Payload expected;
@@ -1233,6 +1282,30 @@ TEST(SerializationTest, Serializable) {
   EXPECT_EQ(expected, result);
 }
 
+TEST(SerializationTest, SerializableBytes) {
+  Payload result;
+  Payload expected;
+
+  TestBytesType t1{10, 0.0, 2};
+  Serialize(t1, &result);
+  expected = decltype(expected)(
+      {ENCODING_TYPE_BIN8, 16, 10, 0, 0, 0, kZeroFloatBytes[0],
+       kZeroFloatBytes[1], kZeroFloatBytes[2], kZeroFloatBytes[3], 2, 0, 0, 0,
+       0, 0, 0, 0});
+  EXPECT_EQ(expected, result);
+  EXPECT_EQ(GetSerializedSize(t1), result.Size());
+  result.Clear();
+
+  // Bytes types nest in other serializable types.
+  TestTemplateType<TestBytesType> tt{t1};
+  Serialize(tt, &result);
+  expected = decltype(expected)(
+      {ENCODING_TYPE_FIXARRAY_MIN + 1, ENCODING_TYPE_BIN8, 16, 10, 0, 0, 0,
+       kZeroFloatBytes[0], kZeroFloatBytes[1], kZeroFloatBytes[2],
+       kZeroFloatBytes[3], 2, 0, 0, 0, 0, 0, 0, 0});
+  EXPECT_EQ(expected, result);
+}
+
 TEST(SerializationTest, Variant) {
   Payload result;
   Payload expected;
@@ -2365,6 +2438,30 @@ TEST(DeserializationTest, Serializable) {
   EXPECT_EQ(TestTemplateType<LocalHandle>(LocalHandle(-1)), tt);
 }
 
+TEST(DeserializationTest, SerializableBytes) {
+  Payload buffer;
+  ErrorType error;
+
+  buffer = decltype(buffer)(
+      {ENCODING_TYPE_BIN8, 16, 10, 0, 0, 0, kOneFloatBytes[0],
+       kOneFloatBytes[1], kOneFloatBytes[2], kOneFloatBytes[3], 2, 0, 0, 0, 0,
+       0, 0, 0});
+  TestBytesType t1;
+  error = Deserialize(&t1, &buffer);
+  EXPECT_EQ(ErrorCode::NO_ERROR, error);
+  EXPECT_EQ((TestBytesType{10, 1.f, 2}), t1);
+
+  // The size must match the type exactly.
+  buffer = decltype(buffer)({ENCODING_TYPE_BIN8, 4, 10, 0, 0, 0});
+  error = Deserialize(&t1, &buffer);
+  EXPECT_EQ(ErrorCode::UNEXPECTED_TYPE_SIZE, error);
+
+  buffer = decltype(buffer)({ENCODING_TYPE_FIXARRAY_MIN + 3, 10,
+                             ENCODING_TYPE_POSITIVE_FIXINT_MIN + 1, 2});
+  error = Deserialize(&t1, &buffer);
+  EXPECT_EQ(ErrorCode::UNEXPECTED_ENCODING, error);
+}
+
 TEST(DeserializationTest, Variant) {
   Payload buffer;
   ErrorType error;
@@ -0,0 +1,95 @@
+#include "pdx/rpc/shared_buffer.h"
+
+#include <cutils/ashmem.h>
+#include <errno.h>
+#include <inttypes.h>
+#include <log/log.h>
+#include <string.h>
+#include <sys/mman.h>
+
+#include <utility>
+
+namespace android {
+namespace pdx {
+namespace rpc {
+
+SharedBuffer::SharedBuffer(LocalHandle fd, std::size_t size)
+    : fd_{std::move(fd)}, size_{size} {}
+
+SharedBuffer& SharedBuffer::operator=(SharedBuffer&& other) noexcept {
+  if (this != &other) {
+    Unmap();
+    fd_ = std::move(other.fd_);
+    size_ = other.size_;
+    data_ = other.data_;
+    other.size_ = 0;
+    other.data_ = nullptr;
+  }
+  return *this;
+}
+
+Status<SharedBuffer> SharedBuffer::Create(std::size_t size) {
+  if (size == 0)
+    return ErrorStatus(EINVAL);
+
+  LocalHandle fd{ashmem_create_region("pdx_shared_buffer", size)};
+  if (!fd) {
+    ALOGE("SharedBuffer::Create: Failed to create region of %zu bytes: %s",
+          size, strerror(errno));
+    return ErrorStatus(errno);
+  }
+
+  void* data =
+      mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd.Get(), 0);
+  if (data == MAP_FAILED) {
+    ALOGE("SharedBuffer::Create: Failed to map region: %s", strerror(errno));
+    return ErrorStatus(errno);
+  }
+
+  // Mappings made from now on, by receivers in particular, are read-only.
+  if (ashmem_set_prot_region(fd.Get(), PROT_READ) < 0) {
+    const int error = errno;
+    ALOGE("SharedBuffer::Create: Failed to protect region: %s",
+          strerror(error));
+    munmap(data, size);
+    return ErrorStatus(error);
+  }
+
+  SharedBuffer buffer{std::move(fd), size};
+  buffer.data_ = static_cast<std::uint8_t*>(data);
+  return {std::move(buffer)};
+}
+
+Status<void> SharedBuffer::Map() {
+  if (data_)
+    return {};
+  if (!fd_ || size_ == 0)
+    return ErrorStatus(EINVAL);
+
+  // The size comes from the sender, don't map past the end of the region.
+  const int region_size = ashmem_get_size_region(fd_.Get());
+  if (region_size < 0 || static_cast<std::uint64_t>(region_size) < size_) {
+    ALOGE("SharedBuffer::Map: Region size %d is less than %" PRIu64 " bytes",
+          region_size, size_);
+    return ErrorStatus(EINVAL);
+  }
+
+  void* data = mmap(nullptr, size_, PROT_READ, MAP_SHARED, fd_.Get(), 0);
+  if (data == MAP_FAILED) {
+    ALOGE("SharedBuffer::Map: Failed to map region: %s", strerror(errno));
+    return ErrorStatus(errno);
+  }
+  data_ = static_cast<std::uint8_t*>(data);
+  return {};
+}
+
+void SharedBuffer::Unmap() {
+  if (data_) {
+    munmap(data_, size_);
+    data_ = nullptr;
+  }
+}
+
+}  // namespace rpc
+}  // namespace pdx
+}  // namespace android
@@ -1,7 +1,9 @@
 #ifndef ANDROID_PDX_UDS_SERVICE_ENDPOINT_H_
 #define ANDROID_PDX_UDS_SERVICE_ENDPOINT_H_
 
+#include <sys/epoll.h>
 #include <sys/stat.h>
+#include <deque>
 #include <map>
 #include <memory>
 #include <mutex>
@@ -138,6 +140,9 @@ class Endpoint : public pdx::Endpoint {
       LocalHandle channel_fd, Channel* channel_state);
   Status<void> CloseChannelLocked(int32_t channel_id);
   Status<void> ReenableEpollEvent(const BorrowedHandle& channel_fd);
+  void AddPendingEvents(const epoll_event* events, size_t count);
+  bool TakePendingEvent(int* fd);
+  void RemovePendingEvent(int fd);
   Channel* GetChannelState(int32_t channel_id);
   BorrowedHandle GetChannelSocketFd(int32_t channel_id);
   Status<std::pair<BorrowedHandle, BorrowedHandle>> GetChannelEventFd(
@@ -151,6 +156,11 @@ class Endpoint : public pdx::Endpoint {
   LocalHandle socket_fd_;
   LocalHandle cancel_event_fd_;
   LocalHandle epoll_fd_;
+  LocalHandle pending_event_fd_;
+
+  // Ready channel fds set aside by MessageReceive(), oldest first.
+  std::mutex pending_mutex_;
+  std::deque<int> pending_fds_;
 
   mutable std::mutex channel_mutex_;
   std::map<int32_t, ChannelData> channels_;
@@ -5,7 +5,7 @@
 #include <sys/eventfd.h>
 #include <sys/socket.h>
 #include <sys/un.h>
-#include <algorithm>  // std::min
+#include <algorithm>  // std::any_of, std::find, std::find_if, std::min
 
 #include <android-base/logging.h>
 #include <android-base/strings.h>
@@ -20,6 +20,10 @@ namespace {
 
 constexpr int kMaxBackLogForSocketListen = 1;
 
+// Events taken from the epoll set per wake. Channel events are one-shot, so
+// those beyond the first are set aside for the next calls to MessageReceive().
+constexpr int kMaxEventsPerWake = 16;
+
 using android::pdx::BorrowedChannelHandle;
 using android::pdx::BorrowedHandle;
 using android::pdx::ChannelReference;
@@ -203,6 +207,22 @@ void Endpoint::Init(LocalHandle socket_fd) {
   CHECK_EQ(ret, 0)
       << "Endpoint::Endpoint: Failed to add cancel event fd to epoll fd: "
       << strerror(errno);
+
+  // Readable while events are set aside, so that the endpoint's epoll fd stays
+  // readable for dispatchers waiting on it.
+  pending_event_fd_.Reset(eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK));
+  CHECK(pending_event_fd_.IsValid())
+      << "Endpoint::Endpoint: Failed to create event fd: " << strerror(errno);
+
+  epoll_event pending_event;
+  pending_event.events = EPOLLIN;
+  pending_event.data.fd = pending_event_fd_.Get();
+
+  ret = epoll_ctl(epoll_fd_.Get(), EPOLL_CTL_ADD, pending_event_fd_.Get(),
+                  &pending_event);
+  CHECK_EQ(ret, 0)
+      << "Endpoint::Endpoint: Failed to add pending event fd to epoll fd: "
+      << strerror(errno);
   socket_fd_ = std::move(socket_fd);
 }
 
@@ -345,11 +365,52 @@ Status<void> Endpoint::CloseChannelLocked(int32_t channel_id) {
     status.SetValue();
   }
 
+  // The fd may be reused by a new channel, don't leave its events behind.
+  RemovePendingEvent(channel_fd);
   channel_fd_to_id_.erase(channel_fd);
   channels_.erase(iter);
   return status;
 }
 
+void Endpoint::AddPendingEvents(const epoll_event* events, size_t count) {
+  std::lock_guard<std::mutex> autolock(pending_mutex_);
+  for (size_t i = 0; i < count; i++) {
+    const int fd = events[i].data.fd;
+    // The cancel and pending event fds are level-triggered and will be
+    // reported again.
+    if (fd == cancel_event_fd_.Get() || fd == pending_event_fd_.Get())
+      continue;
+    if (pending_fds_.empty())
+      eventfd_write(pending_event_fd_.Get(), 1);
+    pending_fds_.push_back(fd);
+  }
+}
+
+bool Endpoint::TakePendingEvent(int* fd) {
+  std::lock_guard<std::mutex> autolock(pending_mutex_);
+  if (pending_fds_.empty())
+    return false;
+  *fd = pending_fds_.front();
+  pending_fds_.pop_front();
+  if (pending_fds_.empty()) {
+    eventfd_t value;
+    eventfd_read(pending_event_fd_.Get(), &value);
+  }
+  return true;
+}
+
+void Endpoint::RemovePendingEvent(int fd) {
+  std::lock_guard<std::mutex> autolock(pending_mutex_);
+  auto iter = std::find(pending_fds_.begin(), pending_fds_.end(), fd);
+  if (iter == pending_fds_.end())
+    return;
+  pending_fds_.erase(iter);
+  if (pending_fds_.empty()) {
+    eventfd_t value;
+    eventfd_read(pending_event_fd_.Get(), &value);
+  }
+}
+
 Status<void> Endpoint::ModifyChannelEvents(int channel_id, int clear_mask,
                                            int set_mask) {
   std::lock_guard<std::mutex> autolock(channel_mutex_);
@@ -577,25 +638,49 @@ void Endpoint::BuildCloseMessage(int32_t channel_id, Message* message) {
 }
 
 Status<void> Endpoint::MessageReceive(Message* message) {
-  // Receive at most one event from the epoll set. This should prevent multiple
-  // dispatch threads from attempting to handle messages on the same socket at
-  // the same time.
-  epoll_event event;
-  int count = RETRY_EINTR(
-      epoll_wait(epoll_fd_.Get(), &event, 1, is_blocking_ ? -1 : 0));
-  if (count < 0) {
-    ALOGE("Endpoint::MessageReceive: Failed to wait for epoll events: %s\n",
-          strerror(errno));
-    return ErrorStatus{errno};
-  } else if (count == 0) {
-    return ErrorStatus{ETIMEDOUT};
-  }
+  // Handle one event per call. Channel events are one-shot, which prevents
+  // multiple dispatch threads from attempting to handle messages on the same
+  // socket at the same time. Events left over from an earlier wake come first,
+  // so that many busy channels are drained with few calls to epoll_wait().
+  int fd;
+  while (!TakePendingEvent(&fd)) {
+    epoll_event events[kMaxEventsPerWake];
+    int count = RETRY_EINTR(epoll_wait(epoll_fd_.Get(), events,
+                                       kMaxEventsPerWake,
+                                       is_blocking_ ? -1 : 0));
+    if (count < 0) {
+      ALOGE("Endpoint::MessageReceive: Failed to wait for epoll events: %s\n",
+            strerror(errno));
+      return ErrorStatus{errno};
+    } else if (count == 0) {
+      return ErrorStatus{ETIMEDOUT};
+    }
 
-  if (event.data.fd == cancel_event_fd_.Get()) {
-    return ErrorStatus{ESHUTDOWN};
+    // Cancellation goes ahead of everything else.
+    if (std::any_of(events, events + count, [this](const epoll_event& e) {
+          return e.data.fd == cancel_event_fd_.Get();
+        })) {
+      AddPendingEvents(events, count);
+      return ErrorStatus{ESHUTDOWN};
+    }
+
+    // The first channel event is handled right away, the others set aside.
+    auto first =
+        std::find_if(events, events + count, [this](const epoll_event& e) {
+          return e.data.fd != pending_event_fd_.Get();
+        });
+    if (first == events + count) {
+      // Another thread took the events set aside.
+      if (!is_blocking_)
+        return ErrorStatus{ETIMEDOUT};
+      continue;
+    }
+    fd = first->data.fd;
+    AddPendingEvents(first + 1, events + count - (first + 1));
+    break;
   }
 
-  if (socket_fd_ && event.data.fd == socket_fd_.Get()) {
+  if (socket_fd_ && fd == socket_fd_.Get()) {
     auto status = AcceptConnection(message);
     auto reenable_status = ReenableEpollEvent(socket_fd_.Borrow());
     if (!reenable_status)
@@ -603,7 +688,7 @@ Status<void> Endpoint::MessageReceive(Message* message) {
     return status;
   }
 
-  BorrowedHandle channel_fd{event.data.fd};
+  BorrowedHandle channel_fd{fd};
   return ReceiveMessageForChannel(channel_fd, message);
 }
 
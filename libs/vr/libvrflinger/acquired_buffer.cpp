@@ -9,8 +9,12 @@ namespace android {
 namespace dvr {
 
 AcquiredBuffer::AcquiredBuffer(const std::shared_ptr<ConsumerBuffer>& buffer,
-                               LocalHandle acquire_fence, std::size_t slot)
-    : buffer_(buffer), acquire_fence_(std::move(acquire_fence)), slot_(slot) {}
+                               LocalHandle acquire_fence, std::size_t slot,
+                               int64_t timestamp_ns)
+    : buffer_(buffer),
+      acquire_fence_(std::move(acquire_fence)),
+      slot_(slot),
+      timestamp_ns_(timestamp_ns) {}
 
 AcquiredBuffer::AcquiredBuffer(const std::shared_ptr<ConsumerBuffer>& buffer,
                                int* error) {
@@ -45,6 +49,7 @@ AcquiredBuffer& AcquiredBuffer::operator=(AcquiredBuffer&& other) noexcept {
     swap(buffer_, other.buffer_);
     swap(acquire_fence_, other.acquire_fence_);
     swap(slot_, other.slot_);
+    swap(timestamp_ns_, other.timestamp_ns_);
   }
   return *this;
 }
@@ -19,9 +19,10 @@ class AcquiredBuffer {
   // Constructs an AcquiredBuffer from a ConsumerBuffer pointer and an acquire
   // fence. The ConsumerBuffer MUST be in the ACQUIRED state prior to calling
   // this constructor; the constructor does not attempt to ACQUIRE the buffer
-  // itself.
+  // itself. |timestamp_ns| is the timestamp from the buffer's metadata.
   AcquiredBuffer(const std::shared_ptr<ConsumerBuffer>& buffer,
-                 pdx::LocalHandle acquire_fence, std::size_t slot = 0);
+                 pdx::LocalHandle acquire_fence, std::size_t slot = 0,
+                 int64_t timestamp_ns = 0);
 
   // Constructs an AcquiredBuffer from a ConsumerBuffer. The ConsumerBuffer MUST
   // be in the POSTED state prior to calling this constructor, as this
@@ -70,12 +71,17 @@ class AcquiredBuffer {
   // part of a queue return 0.
   std::size_t slot() const { return slot_; }
 
+  // Returns the timestamp the producer posted the buffer with, or 0 if it is
+  // unknown.
+  int64_t timestamp_ns() const { return timestamp_ns_; }
+
  private:
   std::shared_ptr<ConsumerBuffer> buffer_;
   // Mutable so that the fence can be closed when it is determined to be
   // signaled during IsAvailable().
   mutable pdx::LocalHandle acquire_fence_;
   std::size_t slot_{0};
+  int64_t timestamp_ns_{0};
 
   AcquiredBuffer(const AcquiredBuffer&) = delete;
   void operator=(const AcquiredBuffer&) = delete;
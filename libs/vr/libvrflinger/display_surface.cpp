@@ -346,9 +346,10 @@ void DirectDisplaySurface::DequeueBuffersLocked() {
   while (true) {
     LocalHandle acquire_fence;
     size_t slot;
-    auto buffer_status = direct_queue_->Dequeue(
-        0, &slot, metadata_.get(),
-        direct_queue_->metadata_size(), &acquire_fence);
+    // Dequeue with the canonical metadata to keep the buffer's timestamp, which
+    // the hardware composer measures frame latency from.
+    DvrNativeBufferMetadata meta;
+    auto buffer_status = direct_queue_->Dequeue(0, &slot, &meta, &acquire_fence);
     ALOGD_IF(TRACE,
              "DirectDisplaySurface::DequeueBuffersLocked: Dequeue with metadata_size: %zu",
              direct_queue_->metadata_size());
@@ -364,6 +365,12 @@ void DirectDisplaySurface::DequeueBuffersLocked() {
     }
     auto buffer_consumer = buffer_status.take();
 
+    if (metadata_ && meta.user_metadata_ptr) {
+      memcpy(metadata_.get(),
+             reinterpret_cast<const void*>(meta.user_metadata_ptr),
+             direct_queue_->metadata_size());
+    }
+
     if (!visible()) {
       ATRACE_NAME("DropFrameOnInvisibleSurface");
       ALOGD_IF(TRACE,
@@ -381,8 +388,8 @@ void DirectDisplaySurface::DequeueBuffersLocked() {
       acquired_buffers_.PopBack();
     }
 
-    acquired_buffers_.Append(
-        AcquiredBuffer(buffer_consumer, std::move(acquire_fence), slot));
+    acquired_buffers_.Append(AcquiredBuffer(
+        buffer_consumer, std::move(acquire_fence), slot, meta.timestamp));
   }
 }
 
@@ -249,7 +249,7 @@ void HardwareComposer::OnPostThreadResumed() {
 
 void HardwareComposer::OnPostThreadPaused() {
   ALOGI("OnPostThreadPaused");
-  retire_fence_fds_.clear();
+  presented_frames_.clear();
   layers_.clear();
 
   // Phones create a new composer client on resume and destroy it on pause.
@@ -353,7 +353,7 @@ HWC::Error HardwareComposer::Present(hwc2_display_t display) {
   // According to the documentation, this fence is signaled at the time of
   // vsync/DMA for physical displays.
   if (error == HWC::Error::None) {
-    retire_fence_fds_.emplace_back(present_fence);
+    presented_frames_.push_back({LocalHandle(present_fence)});
   } else {
     ATRACE_INT("HardwareComposer: PresentResult", error);
   }
@@ -465,6 +465,36 @@ std::string HardwareComposer::Dump() {
   stream << "Active layers:       " << layers_.size() << std::endl;
   stream << std::endl;
 
+  if (!frame_latencies_.empty()) {
+    int64_t total_motion_to_photon_ns = 0, max_motion_to_photon_ns = 0;
+    int64_t total_latch_to_photon_ns = 0, max_latch_to_photon_ns = 0;
+    size_t motion_to_photon_count = 0;
+    for (const auto& latency : frame_latencies_) {
+      if (latency.motion_to_photon_ns > 0) {
+        total_motion_to_photon_ns += latency.motion_to_photon_ns;
+        max_motion_to_photon_ns =
+            std::max(max_motion_to_photon_ns, latency.motion_to_photon_ns);
+        motion_to_photon_count++;
+      }
+      total_latch_to_photon_ns += latency.latch_to_photon_ns;
+      max_latch_to_photon_ns =
+          std::max(max_latch_to_photon_ns, latency.latch_to_photon_ns);
+    }
+    stream << "Latency over the last " << frame_latencies_.size()
+           << " frames:" << std::endl;
+    if (motion_to_photon_count > 0) {
+      stream << "  motion to photon: avg="
+             << total_motion_to_photon_ns / motion_to_photon_count / 1000
+             << "us max=" << max_motion_to_photon_ns / 1000 << "us"
+             << std::endl;
+    }
+    stream << "  latch to photon:  avg="
+           << total_latch_to_photon_ns /
+                  static_cast<int64_t>(frame_latencies_.size()) / 1000
+           << "us max=" << max_latch_to_photon_ns / 1000 << "us" << std::endl;
+    stream << std::endl;
+  }
+
   for (size_t i = 0; i < layers_.size(); i++) {
     stream << "Layer " << i << ":";
     stream << " type=" << layers_[i].GetCompositionType().to_string();
@@ -485,24 +515,34 @@ std::string HardwareComposer::Dump() {
 void HardwareComposer::PostLayers(hwc2_display_t display) {
   ATRACE_NAME("HardwareComposer::PostLayers");
 
-  // Setup the hardware composer layers with current buffers.
+  // Setup the hardware composer layers with current buffers. This latches the
+  // newest buffer of each surface as late as the post thread can, right before
+  // validate and present.
+  int64_t content_time_ns = 0;
   for (auto& layer : layers_) {
     layer.Prepare();
+    const int64_t buffer_time_ns = layer.GetBufferTimestamp();
+    if (buffer_time_ns > 0 &&
+        (content_time_ns == 0 || buffer_time_ns < content_time_ns)) {
+      content_time_ns = buffer_time_ns;
+    }
   }
+  const int64_t latch_time_ns = GetSystemClockNs();
 
   // Now that we have taken in a frame from the application, we have a chance
   // to drop the frame before passing the frame along to HWC.
   // If the display driver has become backed up, we detect it here and then
   // react by skipping this frame to catch up latency.
-  while (!retire_fence_fds_.empty() &&
-         (!retire_fence_fds_.front() ||
-          sync_wait(retire_fence_fds_.front().Get(), 0) == 0)) {
+  while (!presented_frames_.empty() &&
+         (!presented_frames_.front().retire_fence ||
+          sync_wait(presented_frames_.front().retire_fence.Get(), 0) == 0)) {
+    RecordFrameLatency(presented_frames_.front());
     // There are only 2 fences in here, no performance problem to shift the
-    // array of ints.
-    retire_fence_fds_.erase(retire_fence_fds_.begin());
+    // array.
+    presented_frames_.erase(presented_frames_.begin());
   }
 
-  const bool is_fence_pending = static_cast<int32_t>(retire_fence_fds_.size()) >
+  const bool is_fence_pending = static_cast<int32_t>(presented_frames_.size()) >
                                 post_thread_config_.allowed_pending_fence_count;
 
   if (is_fence_pending) {
@@ -510,7 +550,7 @@ void HardwareComposer::PostLayers(hwc2_display_t display) {
 
     ALOGW_IF(is_fence_pending,
              "Warning: dropping a frame to catch up with HWC (pending = %zd)",
-             retire_fence_fds_.size());
+             presented_frames_.size());
 
     for (auto& layer : layers_) {
       layer.Drop();
@@ -543,6 +583,8 @@ void HardwareComposer::PostLayers(hwc2_display_t display) {
           error.to_string().c_str());
     return;
   }
+  presented_frames_.back().latch_time_ns = latch_time_ns;
+  presented_frames_.back().content_time_ns = content_time_ns;
 
   std::vector<Hwc2::Layer> out_layers;
   std::vector<int> out_fences;
@@ -563,6 +605,44 @@ void HardwareComposer::PostLayers(hwc2_display_t display) {
   }
 }
 
+void HardwareComposer::RecordFrameLatency(const PresentedFrame& frame) {
+  if (!frame.retire_fence)
+    return;
+
+  // The retire fence signals when the frame starts to scan out.
+  struct sync_file_info* info = sync_file_info(frame.retire_fence.Get());
+  if (info == nullptr)
+    return;
+  if (info->status != 1) {
+    sync_file_info_free(info);
+    return;
+  }
+  int64_t photon_time_ns = 0;
+  const struct sync_fence_info* fence_info = sync_get_fence_info(info);
+  for (size_t i = 0; i < info->num_fences; i++) {
+    photon_time_ns = std::max(photon_time_ns,
+                              static_cast<int64_t>(fence_info[i].timestamp_ns));
+  }
+  sync_file_info_free(info);
+
+  FrameLatency latency;
+  latency.latch_to_photon_ns = photon_time_ns - frame.latch_time_ns;
+  // Producers that timestamp buffers with their predicted display time would
+  // give a negative latency, which is not reported.
+  latency.motion_to_photon_ns =
+      frame.content_time_ns > 0 ? photon_time_ns - frame.content_time_ns : 0;
+  if (latency.motion_to_photon_ns < 0)
+    latency.motion_to_photon_ns = 0;
+
+  ATRACE_INT64("latch_to_photon_ns", latency.latch_to_photon_ns);
+  ATRACE_INT64("motion_to_photon_ns", latency.motion_to_photon_ns);
+
+  std::unique_lock<std::mutex> lock(post_thread_mutex_);
+  if (frame_latencies_.size() == kFrameLatencyHistory)
+    frame_latencies_.pop_front();
+  frame_latencies_.push_back(latency);
+}
+
 void HardwareComposer::SetDisplaySurfaces(
     std::vector<std::shared_ptr<DirectDisplaySurface>> surfaces) {
   ALOGI("HardwareComposer::SetDisplaySurfaces: surface count=%zd",
@@ -843,7 +923,7 @@ void HardwareComposer::PostThread() {
       // predictor will sync up with the real vsync.
       last_vsync_timestamp_ = GetSystemClockNs();
       vsync_prediction_interval_ = 1;
-      retire_fence_fds_.clear();
+      presented_frames_.clear();
     }
 
     int64_t vsync_timestamp = 0;
@@ -11,6 +11,7 @@
 
 #include <array>
 #include <condition_variable>
+#include <deque>
 #include <memory>
 #include <mutex>
 #include <optional>
@@ -145,6 +146,18 @@ class Layer {
     return buffer_id;
   }
 
+  // Returns the timestamp the producer posted the current buffer with, or 0 if
+  // unknown. Producers timestamp buffers when their content is sampled, e.g.
+  // from the pose, or when they are queued through ANativeWindow.
+  int64_t GetBufferTimestamp() const {
+    int64_t timestamp_ns = 0;
+    pdx::rpc::IfAnyOf<SourceSurface>::Call(
+        &source_, [&timestamp_ns](const SourceSurface& surface_source) {
+          timestamp_ns = surface_source.GetBufferTimestamp();
+        });
+    return timestamp_ns;
+  }
+
   // Compares Layers by surface id.
   bool operator<(const Layer& other) const {
     return GetSurfaceId() < other.GetSurfaceId();
@@ -242,6 +255,11 @@ class Layer {
       else
         return -1;
     }
+
+    // Returns the timestamp of the current buffer.
+    int64_t GetBufferTimestamp() const {
+      return acquired_buffer.timestamp_ns();
+    }
   };
 
   // State when the layer is connected to a buffer. Provides the same interface
@@ -403,6 +421,25 @@ class HardwareComposer {
   void PostLayers(hwc2_display_t display);
   void PostThread();
 
+  // A frame handed to hardware composer. Its latency is measured once the
+  // retire fence signals, which is when the frame starts to scan out.
+  struct PresentedFrame {
+    pdx::LocalHandle retire_fence;
+    // When the layers' buffers were latched, right before validate/present.
+    int64_t latch_time_ns = 0;
+    // The oldest buffer timestamp among the layers, or 0 if none is known.
+    int64_t content_time_ns = 0;
+  };
+
+  struct FrameLatency {
+    int64_t motion_to_photon_ns;
+    int64_t latch_to_photon_ns;
+  };
+
+  // Measures the latency of a frame whose retire fence has signaled, and
+  // exports it to systrace and the dump.
+  void RecordFrameLatency(const PresentedFrame& frame);
+
   // The post thread has two controlling states:
   // 1. Idle: no work to do (no visible surfaces).
   // 2. Suspended: explicitly halted (system is not in VR mode).
@@ -527,9 +564,14 @@ class HardwareComposer {
   // Counter tracking the number of skipped frames.
   int frame_skip_count_ = 0;
 
-  // Fd array for tracking retire fences that are returned by hwc. This allows
-  // us to detect when the display driver begins queuing frames.
-  std::vector<pdx::LocalHandle> retire_fence_fds_;
+  // Frames with the retire fences that are returned by hwc. This allows us to
+  // detect when the display driver begins queuing frames.
+  std::vector<PresentedFrame> presented_frames_;
+
+  // Latency of the last frames, most recent last. Written by the post thread
+  // and read by Dump(), under post_thread_mutex_.
+  static constexpr size_t kFrameLatencyHistory = 120;
+  std::deque<FrameLatency> frame_latencies_;
 
   // If we are publishing vsync data, we will put it here.
   std::unique_ptr<CPUMappedBroadcastRing<DvrVsyncRing>> vsync_ring_;
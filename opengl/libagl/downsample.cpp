@@ -0,0 +1,170 @@
+/*
+** Copyright 2019, The Android Open Source Project
+**
+** Licensed under the Apache License, Version 2.0 (the "License");
+** you may not use this file except in compliance with the License.
+** You may obtain a copy of the License at
+**
+**     http://www.apache.org/licenses/LICENSE-2.0
+**
+** Unless required by applicable law or agreed to in writing, software
+** distributed under the License is distributed on an "AS IS" BASIS,
+** WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+** See the License for the specific language governing permissions and
+** limitations under the License.
+*/
+
+#if defined(__ARM_NEON__) || defined(__ARM_NEON)
+#include <arm_neon.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+#include "downsample.h"
+
+namespace android {
+
+// ----------------------------------------------------------------------------
+
+#if defined(__ARM_NEON__) || defined(__ARM_NEON)
+
+int downsampleRGB565(uint16_t* dst,
+        uint16_t const* row0, uint16_t const* row1, int count)
+{
+    const uint16x8_t mask6 = vdupq_n_u16(0x3F);
+    const uint16x8_t mask5 = vdupq_n_u16(0x1F);
+    int x = 0;
+    for ( ; x+8 <= count ; x += 8) {
+        const uint16x8x2_t p0 = vld2q_u16(row0 + 2*x);
+        const uint16x8x2_t p1 = vld2q_u16(row1 + 2*x);
+        uint16x8_t r = vaddq_u16(
+                vaddq_u16(vshrq_n_u16(p0.val[0], 11), vshrq_n_u16(p0.val[1], 11)),
+                vaddq_u16(vshrq_n_u16(p1.val[0], 11), vshrq_n_u16(p1.val[1], 11)));
+        uint16x8_t g = vaddq_u16(
+                vaddq_u16(vandq_u16(vshrq_n_u16(p0.val[0], 5), mask6),
+                          vandq_u16(vshrq_n_u16(p0.val[1], 5), mask6)),
+                vaddq_u16(vandq_u16(vshrq_n_u16(p1.val[0], 5), mask6),
+                          vandq_u16(vshrq_n_u16(p1.val[1], 5), mask6)));
+        uint16x8_t b = vaddq_u16(
+                vaddq_u16(vandq_u16(p0.val[0], mask5), vandq_u16(p0.val[1], mask5)),
+                vaddq_u16(vandq_u16(p1.val[0], mask5), vandq_u16(p1.val[1], mask5)));
+        r = vshlq_n_u16(vshrq_n_u16(r, 2), 11);
+        g = vshlq_n_u16(vshrq_n_u16(g, 2), 5);
+        b = vshrq_n_u16(b, 2);
+        vst1q_u16(dst + x, vorrq_u16(vorrq_u16(r, g), b));
+    }
+    return x;
+}
+
+int downsampleRGBA8888(uint32_t* dst,
+        uint32_t const* row0, uint32_t const* row1, int count)
+{
+    int x = 0;
+    for ( ; x+4 <= count ; x += 4) {
+        const uint32x4x2_t p0 = vld2q_u32(row0 + 2*x);
+        const uint32x4x2_t p1 = vld2q_u32(row1 + 2*x);
+        const uint8x16_t p00 = vreinterpretq_u8_u32(p0.val[0]);
+        const uint8x16_t p10 = vreinterpretq_u8_u32(p0.val[1]);
+        const uint8x16_t p01 = vreinterpretq_u8_u32(p1.val[0]);
+        const uint8x16_t p11 = vreinterpretq_u8_u32(p1.val[1]);
+        uint16x8_t lo = vaddl_u8(vget_low_u8(p00), vget_low_u8(p10));
+        lo = vaddw_u8(lo, vget_low_u8(p01));
+        lo = vaddw_u8(lo, vget_low_u8(p11));
+        uint16x8_t hi = vaddl_u8(vget_high_u8(p00), vget_high_u8(p10));
+        hi = vaddw_u8(hi, vget_high_u8(p01));
+        hi = vaddw_u8(hi, vget_high_u8(p11));
+        const uint8x16_t rgba = vcombine_u8(vshrn_n_u16(lo, 2), vshrn_n_u16(hi, 2));
+        vst1q_u32(dst + x, vreinterpretq_u32_u8(rgba));
+    }
+    return x;
+}
+
+#elif defined(__SSE2__)
+
+// Sums the adjacent 16-bit lanes of v, giving four 32-bit lanes.
+static inline __m128i addPairs16(__m128i v)
+{
+    return _mm_add_epi32(_mm_and_si128(v, _mm_set1_epi32(0xFFFF)),
+                         _mm_srli_epi32(v, 16));
+}
+
+// Sums one channel over the 2x2 blocks of the 8 source pixels of each of
+// two pairs of rows, giving 8 16-bit lanes.
+static inline __m128i sumChannel565(__m128i a0, __m128i a1, __m128i b0, __m128i b1)
+{
+    return _mm_packs_epi32(addPairs16(_mm_add_epi16(a0, a1)),
+                           addPairs16(_mm_add_epi16(b0, b1)));
+}
+
+int downsampleRGB565(uint16_t* dst,
+        uint16_t const* row0, uint16_t const* row1, int count)
+{
+    const __m128i mask6 = _mm_set1_epi16(0x3F);
+    const __m128i mask5 = _mm_set1_epi16(0x1F);
+    int x = 0;
+    for ( ; x+8 <= count ; x += 8) {
+        const __m128i a0 = _mm_loadu_si128((__m128i const*)(row0 + 2*x));
+        const __m128i a1 = _mm_loadu_si128((__m128i const*)(row1 + 2*x));
+        const __m128i b0 = _mm_loadu_si128((__m128i const*)(row0 + 2*x + 8));
+        const __m128i b1 = _mm_loadu_si128((__m128i const*)(row1 + 2*x + 8));
+        __m128i r = sumChannel565(
+                _mm_srli_epi16(a0, 11), _mm_srli_epi16(a1, 11),
+                _mm_srli_epi16(b0, 11), _mm_srli_epi16(b1, 11));
+        __m128i g = sumChannel565(
+                _mm_and_si128(_mm_srli_epi16(a0, 5), mask6),
+                _mm_and_si128(_mm_srli_epi16(a1, 5), mask6),
+                _mm_and_si128(_mm_srli_epi16(b0, 5), mask6),
+                _mm_and_si128(_mm_srli_epi16(b1, 5), mask6));
+        __m128i b = sumChannel565(
+                _mm_and_si128(a0, mask5), _mm_and_si128(a1, mask5),
+                _mm_and_si128(b0, mask5), _mm_and_si128(b1, mask5));
+        r = _mm_slli_epi16(_mm_srli_epi16(r, 2), 11);
+        g = _mm_slli_epi16(_mm_srli_epi16(g, 2), 5);
+        b = _mm_srli_epi16(b, 2);
+        _mm_storeu_si128((__m128i*)(dst + x), _mm_or_si128(_mm_or_si128(r, g), b));
+    }
+    return x;
+}
+
+// Sums the 2x2 blocks of 4 pixels of each of two rows, giving the two
+// averages in the 8 16-bit lanes.
+static inline __m128i sum8888(__m128i p0, __m128i p1)
+{
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i lo = _mm_add_epi16(_mm_unpacklo_epi8(p0, zero), _mm_unpacklo_epi8(p1, zero));
+    const __m128i hi = _mm_add_epi16(_mm_unpackhi_epi8(p0, zero), _mm_unpackhi_epi8(p1, zero));
+    return _mm_unpacklo_epi64(_mm_add_epi16(lo, _mm_srli_si128(lo, 8)),
+                              _mm_add_epi16(hi, _mm_srli_si128(hi, 8)));
+}
+
+int downsampleRGBA8888(uint32_t* dst,
+        uint32_t const* row0, uint32_t const* row1, int count)
+{
+    int x = 0;
+    for ( ; x+4 <= count ; x += 4) {
+        const __m128i a = sum8888(_mm_loadu_si128((__m128i const*)(row0 + 2*x)),
+                                  _mm_loadu_si128((__m128i const*)(row1 + 2*x)));
+        const __m128i b = sum8888(_mm_loadu_si128((__m128i const*)(row0 + 2*x + 4)),
+                                  _mm_loadu_si128((__m128i const*)(row1 + 2*x + 4)));
+        _mm_storeu_si128((__m128i*)(dst + x),
+                _mm_packus_epi16(_mm_srli_epi16(a, 2), _mm_srli_epi16(b, 2)));
+    }
+    return x;
+}
+
+#else
+
+int downsampleRGB565(uint16_t*, uint16_t const*, uint16_t const*, int)
+{
+    return 0;
+}
+
+int downsampleRGBA8888(uint32_t*, uint32_t const*, uint32_t const*, int)
+{
+    return 0;
+}
+
+#endif
+
+// ----------------------------------------------------------------------------
+}; // namespace android
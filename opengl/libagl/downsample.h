@@ -0,0 +1,40 @@
+/*
+** Copyright 2019, The Android Open Source Project
+**
+** Licensed under the Apache License, Version 2.0 (the "License");
+** you may not use this file except in compliance with the License.
+** You may obtain a copy of the License at
+**
+**     http://www.apache.org/licenses/LICENSE-2.0
+**
+** Unless required by applicable law or agreed to in writing, software
+** distributed under the License is distributed on an "AS IS" BASIS,
+** WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+** See the License for the specific language governing permissions and
+** limitations under the License.
+*/
+
+#ifndef ANDROID_OPENGLES_DOWNSAMPLE_H
+#define ANDROID_OPENGLES_DOWNSAMPLE_H
+
+#include <stdint.h>
+
+namespace android {
+
+/*
+ * The vector versions of the 2x2 box filters of buildAPyramid. Each one
+ * filters the leading pixels of a destination row, as many as fit in whole
+ * vectors, from the two source rows row0 and row1, and returns how many it
+ * wrote. The caller finishes the row with the scalar code, which computes
+ * the exact same (truncated) averages.
+ */
+
+int downsampleRGB565(uint16_t* dst,
+        uint16_t const* row0, uint16_t const* row1, int count);
+
+int downsampleRGBA8888(uint32_t* dst,
+        uint32_t const* row0, uint32_t const* row1, int count);
+
+}; // namespace android
+
+#endif // ANDROID_OPENGLES_DOWNSAMPLE_H
@@ -19,6 +19,7 @@
 #include <stdlib.h>
 
 #include "context.h"
+#include "downsample.h"
 #include "state.h"
 #include "texture.h"
 #include "TextureObjectManager.h"
@@ -60,7 +61,10 @@ status_t buildAPyramid(ogles_context_t* c, EGLTextureObject* tex)
             const uint32_t mask = 0x07E0F81F;
             for (int y=0 ; y<h ; y++) {
                 size_t offset = (y*2) * bs;
-                for (int x=0 ; x<w ; x++) {
+                int x = downsampleRGB565(dst + y*stride,
+                        src + offset, src + offset + bs, w);
+                offset += 2*x;
+                for ( ; x<w ; x++) {
                     uint32_t p00 = src[offset];
                     uint32_t p10 = src[offset+1];
                     uint32_t p01 = src[offset+bs];
@@ -102,7 +106,10 @@ status_t buildAPyramid(ogles_context_t* c, EGLTextureObject* tex)
             uint32_t* dst = (uint32_t*)cur.data;
             for (int y=0 ; y<h ; y++) {
                 size_t offset = (y*2) * bs;
-                for (int x=0 ; x<w ; x++) {
+                int x = downsampleRGBA8888(dst + y*stride,
+                        src + offset, src + offset + bs, w);
+                offset += 2*x;
+                for ( ; x<w ; x++) {
                     uint32_t p00 = src[offset];
                     uint32_t p10 = src[offset+1];
                     uint32_t p01 = src[offset+bs];
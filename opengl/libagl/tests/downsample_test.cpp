@@ -0,0 +1,114 @@
+/*
+ * Copyright 2019 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <stdint.h>
+
+#include <random>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "../downsample.h"
+
+namespace android {
+namespace {
+
+// The truncated average of one channel of the 2x2 block at x.
+template <typename T>
+uint32_t average(const std::vector<T>& row0, const std::vector<T>& row1, int x, int shift,
+                 uint32_t mask) {
+    return (((row0[2 * x] >> shift) & mask) + ((row0[2 * x + 1] >> shift) & mask) +
+            ((row1[2 * x] >> shift) & mask) + ((row1[2 * x + 1] >> shift) & mask)) >> 2;
+}
+
+template <typename T>
+std::vector<T> randomRow(std::mt19937& random, int count) {
+    std::uniform_int_distribution<uint32_t> distribution;
+    std::vector<T> row(count);
+    for (T& pixel : row) {
+        pixel = static_cast<T>(distribution(random));
+    }
+    return row;
+}
+
+TEST(DownsampleTest, RGB565MatchesScalarAverages) {
+    std::mt19937 random(565);
+    for (int count = 1; count <= 40; count++) {
+        SCOPED_TRACE(count);
+        const std::vector<uint16_t> row0 = randomRow<uint16_t>(random, 2 * count);
+        const std::vector<uint16_t> row1 = randomRow<uint16_t>(random, 2 * count);
+        // One more than the row, to catch writes past it.
+        std::vector<uint16_t> dst(count + 1, 0xABCD);
+
+        const int written = downsampleRGB565(dst.data(), row0.data(), row1.data(), count);
+        ASSERT_GE(written, 0);
+        ASSERT_LE(written, count);
+        for (int x = 0; x < written; x++) {
+            const uint32_t r = average(row0, row1, x, 11, 0x1F);
+            const uint32_t g = average(row0, row1, x, 5, 0x3F);
+            const uint32_t b = average(row0, row1, x, 0, 0x1F);
+            EXPECT_EQ((r << 11) | (g << 5) | b, dst[x]) << "at " << x;
+        }
+        for (int x = written; x <= count; x++) {
+            EXPECT_EQ(0xABCD, dst[x]) << "at " << x;
+        }
+    }
+}
+
+TEST(DownsampleTest, RGBA8888MatchesScalarAverages) {
+    std::mt19937 random(8888);
+    for (int count = 1; count <= 40; count++) {
+        SCOPED_TRACE(count);
+        const std::vector<uint32_t> row0 = randomRow<uint32_t>(random, 2 * count);
+        const std::vector<uint32_t> row1 = randomRow<uint32_t>(random, 2 * count);
+        std::vector<uint32_t> dst(count + 1, 0xABCDEF01);
+
+        const int written = downsampleRGBA8888(dst.data(), row0.data(), row1.data(), count);
+        ASSERT_GE(written, 0);
+        ASSERT_LE(written, count);
+        for (int x = 0; x < written; x++) {
+            uint32_t expected = 0;
+            for (int shift = 0; shift < 32; shift += 8) {
+                expected |= average(row0, row1, x, shift, 0xFF) << shift;
+            }
+            EXPECT_EQ(expected, dst[x]) << "at " << x;
+        }
+        for (int x = written; x <= count; x++) {
+            EXPECT_EQ(0xABCDEF01, dst[x]) << "at " << x;
+        }
+    }
+}
+
+TEST(DownsampleTest, SaturatedPixelsDoNotOverflow) {
+    const std::vector<uint16_t> white565(32, 0xFFFF);
+    std::vector<uint16_t> dst565(16);
+    const int written565 =
+            downsampleRGB565(dst565.data(), white565.data(), white565.data(), 16);
+    for (int x = 0; x < written565; x++) {
+        EXPECT_EQ(0xFFFF, dst565[x]) << "at " << x;
+    }
+
+    const std::vector<uint32_t> white8888(32, 0xFFFFFFFF);
+    std::vector<uint32_t> dst8888(16);
+    const int written8888 =
+            downsampleRGBA8888(dst8888.data(), white8888.data(), white8888.data(), 16);
+    for (int x = 0; x < written8888; x++) {
+        EXPECT_EQ(0xFFFFFFFF, dst8888[x]) << "at " << x;
+    }
+}
+
+} // namespace
+} // namespace android
@@ -20,10 +20,12 @@
 
 #include <errno.h>
 #include <inttypes.h>
+#include <stdlib.h>
+#include <string.h>
 
 #include <cutils/properties.h>
 #include <log/log.h>
-#include <chrono>
+#include <string_view>
 
 namespace android {
 
@@ -41,19 +43,20 @@ BlobCache::BlobCache(size_t maxKeySize, size_t maxValueSize, size_t maxTotalSize
         mMaxKeySize(maxKeySize),
         mMaxValueSize(maxValueSize),
         mTotalSize(0) {
-    int64_t now = std::chrono::steady_clock::now().time_since_epoch().count();
-#ifdef _WIN32
-    srand(now);
-#else
-    mRandState[0] = (now >> 0) & 0xFFFF;
-    mRandState[1] = (now >> 16) & 0xFFFF;
-    mRandState[2] = (now >> 32) & 0xFFFF;
-#endif
-    ALOGV("initializing random seed using %lld", (unsigned long long)now);
 }
 
 void BlobCache::set(const void* key, size_t keySize, const void* value,
         size_t valueSize) {
+    insert(key, keySize, value, valueSize, false);
+}
+
+void BlobCache::setPersistent(const void* key, size_t keySize, const void* value,
+        size_t valueSize) {
+    insert(key, keySize, value, valueSize, true);
+}
+
+void BlobCache::insert(const void* key, size_t keySize, const void* value,
+        size_t valueSize, bool persistent) {
     if (mMaxKeySize < keySize) {
         ALOGV("set: not caching because the key is too large: %zu (limit: %zu)",
                 keySize, mMaxKeySize);
@@ -78,15 +81,10 @@ void BlobCache::set(const void* key, size_t keySize, const void* value,
         return;
     }
 
-    std::shared_ptr<Blob> dummyKey(new Blob(key, keySize, false));
-    CacheEntry dummyEntry(dummyKey, nullptr);
-
     while (true) {
-        auto index = std::lower_bound(mCacheEntries.begin(), mCacheEntries.end(), dummyEntry);
-        if (index == mCacheEntries.end() || dummyEntry < *index) {
+        auto index = mCacheIndex.find(KeyRef{key, keySize});
+        if (index == mCacheIndex.end()) {
             // Create a new cache entry.
-            std::shared_ptr<Blob> keyBlob(new Blob(key, keySize, true));
-            std::shared_ptr<Blob> valueBlob(new Blob(value, valueSize, true));
             size_t newTotalSize = mTotalSize + keySize + valueSize;
             if (mMaxTotalSize < newTotalSize) {
                 if (isCleanable()) {
@@ -101,14 +99,26 @@ void BlobCache::set(const void* key, size_t keySize, const void* value,
                     break;
                 }
             }
-            mCacheEntries.insert(index, CacheEntry(keyBlob, valueBlob));
+            std::shared_ptr<Blob> keyBlob(new Blob(key, keySize, !persistent));
+            std::shared_ptr<Blob> valueBlob(new Blob(value, valueSize, !persistent));
+            mCacheEntries.emplace_front(keyBlob, valueBlob);
+            mCacheEntries.front().setSaved(persistent);
+            mCacheEntries.front().setVerified(!persistent);
+            mCacheIndex.emplace(KeyRef{keyBlob->getData(), keySize}, mCacheEntries.begin());
             mTotalSize = newTotalSize;
             ALOGV("set: created new cache entry with %zu byte key and %zu byte value",
                     keySize, valueSize);
+        } else if (persistent) {
+            // Replace the existing cache entry, so that the key and value of a
+            // persistent entry always refer to the same memory.
+            remove(index->second);
+            continue;
         } else {
-            // Update the existing cache entry.
-            std::shared_ptr<Blob> valueBlob(new Blob(value, valueSize, true));
-            std::shared_ptr<Blob> oldValueBlob(index->getValue());
+            // Update the existing cache entry. It becomes the most recently
+            // used one first, so that cleaning evicts other entries before it.
+            auto entry = index->second;
+            mCacheEntries.splice(mCacheEntries.begin(), mCacheEntries, entry);
+            std::shared_ptr<Blob> oldValueBlob(entry->getValue());
             size_t newTotalSize = mTotalSize + valueSize - oldValueBlob->getSize();
             if (mMaxTotalSize < newTotalSize) {
                 if (isCleanable()) {
@@ -122,7 +132,10 @@ void BlobCache::set(const void* key, size_t keySize, const void* value,
                     break;
                 }
             }
-            index->setValue(valueBlob);
+            std::shared_ptr<Blob> valueBlob(new Blob(value, valueSize, true));
+            entry->setValue(valueBlob);
+            entry->setSaved(false);
+            entry->setVerified(true);
             mTotalSize = newTotalSize;
             ALOGV("set: updated existing cache entry with %zu byte key and %zu byte "
                     "value", keySize, valueSize);
@@ -138,17 +151,27 @@ size_t BlobCache::get(const void* key, size_t keySize, void* value,
                 keySize, mMaxKeySize);
         return 0;
     }
-    std::shared_ptr<Blob> dummyKey(new Blob(key, keySize, false));
-    CacheEntry dummyEntry(dummyKey, nullptr);
-    auto index = std::lower_bound(mCacheEntries.begin(), mCacheEntries.end(), dummyEntry);
-    if (index == mCacheEntries.end() || dummyEntry < *index) {
+    auto index = mCacheIndex.find(KeyRef{key, keySize});
+    if (index == mCacheIndex.end()) {
         ALOGV("get: no cache entry found for key of size %zu", keySize);
         return 0;
     }
 
-    // The key was found. Return the value if the caller's buffer is large
-    // enough.
-    std::shared_ptr<Blob> valueBlob(index->getValue());
+    // The key was found. Mark the entry as the most recently used one and
+    // return the value if the caller's buffer is large enough.
+    auto entry = index->second;
+    std::shared_ptr<Blob> valueBlob(entry->getValue());
+    if (!entry->isVerified()) {
+        if (!verifyPersistentValue(entry->getKey()->getData(), keySize, valueBlob->getData(),
+                valueBlob->getSize())) {
+            ALOGE("get: dropping cache entry with %zu byte key which failed verification",
+                    keySize);
+            remove(entry);
+            return 0;
+        }
+        entry->setVerified(true);
+    }
+    mCacheEntries.splice(mCacheEntries.begin(), mCacheEntries, entry);
     size_t valueBlobSize = valueBlob->getSize();
     if (valueBlobSize <= valueSize) {
         ALOGV("get: copying %zu bytes to caller's buffer", valueBlobSize);
@@ -189,12 +212,14 @@ int BlobCache::flatten(void* buffer, size_t size) const {
     header->mBuildIdLength = property_get("ro.build.id", buildId, "");
     memcpy(header->mBuildId, buildId, header->mBuildIdLength);
 
-    // Write cache entries
+    // Write cache entries from the least to the most recently used one, so
+    // that unflatten, which marks each entry it reads as the most recently
+    // used one, restores the current order.
     uint8_t* byteBuffer = reinterpret_cast<uint8_t*>(buffer);
     off_t byteOffset = align4(sizeof(Header) + header->mBuildIdLength);
-    for (const CacheEntry& e :  mCacheEntries) {
-        std::shared_ptr<Blob> const& keyBlob = e.getKey();
-        std::shared_ptr<Blob> const& valueBlob = e.getValue();
+    for (auto e = mCacheEntries.rbegin(); e != mCacheEntries.rend(); ++e) {
+        std::shared_ptr<Blob> const& keyBlob = e->getKey();
+        std::shared_ptr<Blob> const& valueBlob = e->getValue();
         size_t keySize = keyBlob->getSize();
         size_t valueSize = valueBlob->getSize();
 
@@ -226,7 +251,7 @@ int BlobCache::flatten(void* buffer, size_t size) const {
 
 int BlobCache::unflatten(void const* buffer, size_t size) {
     // All errors should result in the BlobCache being in an empty state.
-    mCacheEntries.clear();
+    clear();
 
     // Read the cache header
     if (size < sizeof(Header)) {
@@ -254,7 +279,7 @@ int BlobCache::unflatten(void const* buffer, size_t size) {
     size_t numEntries = header->mNumEntries;
     for (size_t i = 0; i < numEntries; i++) {
         if (byteOffset + sizeof(EntryHeader) > size) {
-            mCacheEntries.clear();
+            clear();
             ALOGE("unflatten: not enough room for cache entry headers");
             return -EINVAL;
         }
@@ -267,7 +292,7 @@ int BlobCache::unflatten(void const* buffer, size_t size) {
 
         size_t totalSize = align4(entrySize);
         if (byteOffset + totalSize > size) {
-            mCacheEntries.clear();
+            clear();
             ALOGE("unflatten: not enough room for cache entry headers");
             return -EINVAL;
         }
@@ -281,22 +306,40 @@ int BlobCache::unflatten(void const* buffer, size_t size) {
     return 0;
 }
 
-long int BlobCache::blob_random() {
-#ifdef _WIN32
-    return rand();
-#else
-    return nrand48(mRandState);
-#endif
+void BlobCache::forEachEntry(bool unsavedOnly, const EntryFunc& func) const {
+    for (auto e = mCacheEntries.rbegin(); e != mCacheEntries.rend(); ++e) {
+        if (unsavedOnly && e->isSaved()) {
+            continue;
+        }
+        std::shared_ptr<Blob> const& keyBlob = e->getKey();
+        std::shared_ptr<Blob> const& valueBlob = e->getValue();
+        func(keyBlob->getData(), keyBlob->getSize(), valueBlob->getData(), valueBlob->getSize());
+    }
+}
+
+void BlobCache::markAllSaved() {
+    for (CacheEntry& e : mCacheEntries) {
+        e.setSaved(true);
+    }
+}
+
+bool BlobCache::verifyPersistentValue(const void* /*key*/, size_t /*keySize*/,
+        const void* /*value*/, size_t /*valueSize*/) const {
+    return true;
+}
+
+void BlobCache::remove(CacheEntryList::iterator entry) {
+    const std::shared_ptr<Blob>& keyBlob = entry->getKey();
+    mCacheIndex.erase(KeyRef{keyBlob->getData(), keyBlob->getSize()});
+    mTotalSize -= keyBlob->getSize() + entry->getValue()->getSize();
+    mCacheEntries.erase(entry);
 }
 
 void BlobCache::clean() {
-    // Remove a random cache entry until the total cache size gets below half
-    // the maximum total cache size.
+    // Remove the least recently used cache entry until the total cache size
+    // gets below half the maximum total cache size.
     while (mTotalSize > mMaxTotalSize / 2) {
-        size_t i = size_t(blob_random() % (mCacheEntries.size()));
-        const CacheEntry& entry(mCacheEntries[i]);
-        mTotalSize -= entry.getKey()->getSize() + entry.getValue()->getSize();
-        mCacheEntries.erase(mCacheEntries.begin() + i);
+        remove(std::prev(mCacheEntries.end()));
     }
 }
 
@@ -319,14 +362,6 @@ BlobCache::Blob::~Blob() {
     }
 }
 
-bool BlobCache::Blob::operator<(const Blob& rhs) const {
-    if (mSize == rhs.mSize) {
-        return memcmp(mData, rhs.mData, mSize) < 0;
-    } else {
-        return mSize < rhs.mSize;
-    }
-}
-
 const void* BlobCache::Blob::getData() const {
     return mData;
 }
@@ -346,16 +381,16 @@ BlobCache::CacheEntry::CacheEntry(
 
 BlobCache::CacheEntry::CacheEntry(const CacheEntry& ce):
         mKey(ce.mKey),
-        mValue(ce.mValue) {
-}
-
-bool BlobCache::CacheEntry::operator<(const CacheEntry& rhs) const {
-    return *mKey < *rhs.mKey;
+        mValue(ce.mValue),
+        mSaved(ce.mSaved),
+        mVerified(ce.mVerified) {
 }
 
 const BlobCache::CacheEntry& BlobCache::CacheEntry::operator=(const CacheEntry& rhs) {
     mKey = rhs.mKey;
     mValue = rhs.mValue;
+    mSaved = rhs.mSaved;
+    mVerified = rhs.mVerified;
     return *this;
 }
 
@@ -371,4 +406,13 @@ void BlobCache::CacheEntry::setValue(const std::shared_ptr<Blob>& value) {
     mValue = value;
 }
 
+bool BlobCache::KeyRef::operator==(const KeyRef& rhs) const {
+    return size == rhs.size && memcmp(data, rhs.data, size) == 0;
+}
+
+size_t BlobCache::KeyRefHash::operator()(const KeyRef& key) const {
+    return std::hash<std::string_view>()(
+            std::string_view(reinterpret_cast<const char*>(key.data), key.size));
+}
+
 } // namespace android
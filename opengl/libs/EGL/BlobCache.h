@@ -19,14 +19,19 @@
 
 #include <stddef.h>
 
+#include <functional>
+#include <list>
 #include <memory>
-#include <vector>
+#include <unordered_map>
 
 namespace android {
 
 // A BlobCache is an in-memory cache for binary key/value pairs.  A BlobCache
 // does NOT provide any thread-safety guarantees.
 //
+// Entries are found through a hash of their key, and when the cache is full
+// the least recently used entries are evicted first.
+//
 // The cache contents can be serialized to an in-memory buffer or mmap'd file
 // and then reloaded in a subsequent execution of the program.  This
 // serialization is non-portable and the data should only be used by the device
@@ -38,6 +43,7 @@ public:
     // maxValueSize, respectively. The total combined size of ALL cache entries
     // (key sizes plus value sizes) will not exceed maxTotalSize.
     BlobCache(size_t maxKeySize, size_t maxValueSize, size_t maxTotalSize);
+    virtual ~BlobCache() = default;
 
     // set inserts a new binary value into the cache and associates it with the
     // given binary key.  If the key or value are too large for the cache then
@@ -69,6 +75,8 @@ public:
     // calls may fail, returning 0, even if earlier calls succeeded.  The return
     // value must be checked for each call.
     //
+    // A successful get marks the entry as the most recently used one.
+    //
     // Preconditions:
     //   key != NULL
     //   0 < keySize
@@ -93,13 +101,18 @@ public:
     // contents in the memory pointed to by 'buffer'.  The previous contents of
     // the BlobCache will be evicted from the cache.  If an error occurs while
     // unflattening the serialized cache contents then the BlobCache will be
-    // left in an empty state.
+    // left in an empty state.  The order in which entries were used survives
+    // the round trip through flatten and unflatten.
     //
     int unflatten(void const* buffer, size_t size);
 
     // clear flushes out all contents of the cache then the BlobCache, leaving
     // it in an empty state.
-    void clear() { mCacheEntries.clear(); }
+    void clear() {
+        mCacheIndex.clear();
+        mCacheEntries.clear();
+        mTotalSize = 0;
+    }
 
 protected:
     // mMaxTotalSize is the maximum size that all cache entries can occupy. This
@@ -109,15 +122,38 @@ protected:
     // will be evicted from the cache to make room for the new entry.
     const size_t mMaxTotalSize;
 
+    // An EntryFunc is called with the key and value of a cache entry.
+    using EntryFunc = std::function<void(const void* key, size_t keySize, const void* value,
+            size_t valueSize)>;
+
+    // setPersistent inserts a key/value pair like set does, but refers to the
+    // key and value memory instead of copying it.  That memory, such as a
+    // mapped cache file, must remain valid for the lifetime of the BlobCache.
+    // The entry counts as saved, and its value is checked with
+    // verifyPersistentValue the first time get reads it.
+    void setPersistent(const void* key, size_t keySize, const void* value,
+            size_t valueSize);
+
+    // forEachEntry calls func for each entry in the cache, from the least to
+    // the most recently used one.  If unsavedOnly is true, only the entries
+    // set since the last call to markAllSaved are visited.
+    void forEachEntry(bool unsavedOnly, const EntryFunc& func) const;
+
+    // markAllSaved marks every entry in the cache as saved.
+    void markAllSaved();
+
+    // verifyPersistentValue returns whether the value of an entry inserted by
+    // setPersistent is intact.  Entries which fail the check are removed from
+    // the cache.
+    virtual bool verifyPersistentValue(const void* key, size_t keySize, const void* value,
+            size_t valueSize) const;
+
 private:
     // Copying is disallowed.
     BlobCache(const BlobCache&);
     void operator=(const BlobCache&);
 
-    // A random function helper to get around MinGW not having nrand48()
-    long int blob_random();
-
-    // clean evicts a randomly chosen set of entries from the cache such that
+    // clean evicts the least recently used entries from the cache such that
     // the total size of all remaining entries is less than mMaxTotalSize/2.
     void clean();
 
@@ -131,8 +167,6 @@ private:
         Blob(const void* data, size_t size, bool copyData);
         ~Blob();
 
-        bool operator<(const Blob& rhs) const;
-
         const void* getData() const;
         size_t getSize() const;
 
@@ -159,7 +193,6 @@ private:
         CacheEntry(const std::shared_ptr<Blob>& key, const std::shared_ptr<Blob>& value);
         CacheEntry(const CacheEntry& ce);
 
-        bool operator<(const CacheEntry& rhs) const;
         const CacheEntry& operator=(const CacheEntry&);
 
         std::shared_ptr<Blob> getKey() const;
@@ -167,6 +200,12 @@ private:
 
         void setValue(const std::shared_ptr<Blob>& value);
 
+        bool isSaved() const { return mSaved; }
+        void setSaved(bool saved) { mSaved = saved; }
+
+        bool isVerified() const { return mVerified; }
+        void setVerified(bool verified) { mVerified = verified; }
+
     private:
 
         // mKey is the key that identifies the cache entry.
@@ -174,8 +213,38 @@ private:
 
         // mValue is the cached data associated with the key.
         std::shared_ptr<Blob> mValue;
+
+        // mSaved indicates whether the current value has been saved.
+        bool mSaved = false;
+
+        // mVerified is false for a persistent value which has not been checked
+        // with verifyPersistentValue yet.
+        bool mVerified = true;
+    };
+
+    // A KeyRef refers to the bytes of a key, which lets lookups use the
+    // caller's key without copying it. Keys in the index refer to the key Blob
+    // of their entry.
+    struct KeyRef {
+        const void* data;
+        size_t size;
+
+        bool operator==(const KeyRef& rhs) const;
     };
 
+    struct KeyRefHash {
+        size_t operator()(const KeyRef& key) const;
+    };
+
+    using CacheEntryList = std::list<CacheEntry>;
+
+    // insert implements set and setPersistent.
+    void insert(const void* key, size_t keySize, const void* value, size_t valueSize,
+            bool persistent);
+
+    // remove removes an entry from the cache.
+    void remove(CacheEntryList::iterator entry);
+
     // A Header is the header for the entire BlobCache serialization format. No
     // need to make this portable, so we simply write the struct out.
     struct Header {
@@ -236,13 +305,13 @@ private:
     // the cache.
     size_t mTotalSize;
 
-    // mRandState is the pseudo-random number generator state. It is passed to
-    // nrand48 to generate random numbers when needed.
-    unsigned short mRandState[3];
+    // mCacheEntries stores all the cache entries that are resident in memory,
+    // from the most to the least recently used.  Cache entries are added to it
+    // by the 'set' method.
+    CacheEntryList mCacheEntries;
 
-    // mCacheEntries stores all the cache entries that are resident in memory.
-    // Cache entries are added to it by the 'set' method.
-    std::vector<CacheEntry> mCacheEntries;
+    // mCacheIndex maps the key of each entry in mCacheEntries to the entry.
+    std::unordered_map<KeyRef, CacheEntryList::iterator, KeyRefHash> mCacheIndex;
 };
 
 }
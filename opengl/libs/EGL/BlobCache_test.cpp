@@ -267,6 +267,54 @@ TEST_F(BlobCacheTest, ExceedingTotalLimitHalvesCacheSize) {
     ASSERT_EQ(maxEntries/2 + 1, numCached);
 }
 
+TEST_F(BlobCacheTest, ExceedingTotalLimitEvictsLeastRecentlyUsed) {
+    // Fill up the entire cache with 1 char key/value pairs.
+    const int maxEntries = MAX_TOTAL_SIZE / 2;
+    for (int i = 0; i < maxEntries; i++) {
+        uint8_t k = i;
+        mBC->set(&k, 1, "x", 1);
+    }
+    // Use the oldest entry, then insert one more entry, causing a cache
+    // overflow.
+    uint8_t k0 = 0;
+    ASSERT_EQ(size_t(1), mBC->get(&k0, 1, nullptr, 0));
+    {
+        uint8_t k = maxEntries;
+        mBC->set(&k, 1, "x", 1);
+    }
+    // The entries used least recently were the ones evicted.
+    ASSERT_EQ(size_t(1), mBC->get(&k0, 1, nullptr, 0));
+    for (int i = 1; i <= maxEntries / 2; i++) {
+        uint8_t k = i;
+        ASSERT_EQ(size_t(0), mBC->get(&k, 1, nullptr, 0));
+    }
+    for (int i = maxEntries / 2 + 1; i <= maxEntries; i++) {
+        uint8_t k = i;
+        ASSERT_EQ(size_t(1), mBC->get(&k, 1, nullptr, 0));
+    }
+}
+
+TEST_F(BlobCacheTest, ClearEmptiesCache) {
+    const int maxEntries = MAX_TOTAL_SIZE / 2;
+    for (int i = 0; i < maxEntries; i++) {
+        uint8_t k = i;
+        mBC->set(&k, 1, "x", 1);
+    }
+    mBC->clear();
+    uint8_t k0 = 0;
+    ASSERT_EQ(size_t(0), mBC->get(&k0, 1, nullptr, 0));
+
+    // The whole cache is available again after clearing it.
+    for (int i = maxEntries; i < 2 * maxEntries; i++) {
+        uint8_t k = i;
+        mBC->set(&k, 1, "x", 1);
+    }
+    for (int i = maxEntries; i < 2 * maxEntries; i++) {
+        uint8_t k = i;
+        ASSERT_EQ(size_t(1), mBC->get(&k, 1, nullptr, 0));
+    }
+}
+
 class BlobCacheFlattenTest : public BlobCacheTest {
 protected:
     virtual void SetUp() {
@@ -342,6 +390,29 @@ TEST_F(BlobCacheFlattenTest, FlattenDoesntChangeCache) {
     }
 }
 
+TEST_F(BlobCacheFlattenTest, FlattenKeepsUsageOrder) {
+    // Fill up the entire cache with 1 char key/value pairs.
+    const int maxEntries = MAX_TOTAL_SIZE / 2;
+    for (int i = 0; i < maxEntries; i++) {
+        uint8_t k = i;
+        mBC->set(&k, 1, &k, 1);
+    }
+    uint8_t k0 = 0;
+    ASSERT_EQ(size_t(1), mBC->get(&k0, 1, nullptr, 0));
+
+    roundTrip();
+
+    // Overflowing the deserialized cache evicts the same entries as
+    // overflowing the original one would.
+    {
+        uint8_t k = maxEntries;
+        mBC2->set(&k, 1, &k, 1);
+    }
+    ASSERT_EQ(size_t(1), mBC2->get(&k0, 1, nullptr, 0));
+    uint8_t k1 = 1;
+    ASSERT_EQ(size_t(0), mBC2->get(&k1, 1, nullptr, 0));
+}
+
 TEST_F(BlobCacheFlattenTest, FlattenCatchesBufferTooSmall) {
     // Fill up the entire cache with 1 char key/value pairs.
     const int maxEntries = MAX_TOTAL_SIZE / 2;
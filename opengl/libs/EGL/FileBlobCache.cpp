@@ -17,18 +17,46 @@
 #include "FileBlobCache.h"
 
 #include <errno.h>
+#include <fcntl.h>
 #include <inttypes.h>
 #include <log/log.h>
+#include <stdio.h>
+#include <string.h>
 #include <sys/mman.h>
 #include <sys/stat.h>
+#include <unistd.h>
 
+#include <cutils/properties.h>
 
 // Cache file header
-static const char* cacheFileMagic = "EGL$";
-static const size_t cacheFileHeaderSize = 8;
+static const char* cacheFileMagic = "EGL@";
+static const uint32_t cacheFileVersion = 1;
 
 namespace android {
 
+// A FileHeader starts the cache file.  Like the BlobCache serialization
+// format, the file is only meant for the device that wrote it, so the struct
+// is simply written out.
+struct FileHeader {
+    char mMagic[4];
+    uint32_t mVersion;
+
+    // The build id of the device when the file was created.  A different build
+    // id invalidates the file.
+    uint32_t mBuildIdLength;
+    char mBuildId[PROPERTY_VALUE_MAX];
+};
+
+// A RecordHeader precedes each cache entry in the file.  It is followed by the
+// key and then the value, and padded so that every record is 4-byte aligned.
+// Later records for a key supersede earlier ones.
+struct RecordHeader {
+    // mCrc is the CRC of the rest of the record header, the key and the value.
+    uint32_t mCrc;
+    uint32_t mKeySize;
+    uint32_t mValueSize;
+};
+
 static uint32_t crc32c(const uint8_t* buf, size_t len) {
     const uint32_t polyBits = 0x82F63B78;
     uint32_t r = 0;
@@ -45,14 +73,55 @@ static uint32_t crc32c(const uint8_t* buf, size_t len) {
     return r;
 }
 
+// The file is rewritten when appending to it would make it larger than this
+// many times the maximum cache size.  Record headers are small next to shader
+// binaries, so this mostly bounds the space taken by stale records.
+static const size_t maxFileSizeFactor = 2;
+
+// Files larger than this many times the maximum cache size are not loaded.
+static const size_t maxLoadedFileSizeFactor = 4;
+
+static inline size_t align4(size_t size) {
+    return (size + 3) & ~3;
+}
+
+static inline size_t recordSize(size_t keySize, size_t valueSize) {
+    return align4(sizeof(RecordHeader) + keySize + valueSize);
+}
+
+static inline uint32_t recordCrc(const uint8_t* record, size_t keySize, size_t valueSize) {
+    const size_t crcSize = sizeof(RecordHeader::mCrc);
+    return crc32c(record + crcSize, sizeof(RecordHeader) - crcSize + keySize + valueSize);
+}
+
+static void fillFileHeader(FileHeader* header) {
+    memset(header, 0, sizeof(*header));
+    memcpy(header->mMagic, cacheFileMagic, sizeof(header->mMagic));
+    header->mVersion = cacheFileVersion;
+    header->mBuildIdLength = property_get("ro.build.id", header->mBuildId, "");
+}
+
+static bool writeFully(int fd, const uint8_t* data, size_t size, off_t offset) {
+    while (size > 0) {
+        ssize_t written = TEMP_FAILURE_RETRY(pwrite(fd, data, size, offset));
+        if (written < 0) {
+            return false;
+        }
+        data += written;
+        size -= written;
+        offset += written;
+    }
+    return true;
+}
+
 FileBlobCache::FileBlobCache(size_t maxKeySize, size_t maxValueSize, size_t maxTotalSize,
-        const std::string& filename)
+        const std::string& filename, mode_t fileMode)
         : BlobCache(maxKeySize, maxValueSize, maxTotalSize)
-        , mFilename(filename) {
+        , mFilename(filename)
+        , mFileMode(fileMode)
+        , mFileSize(0) {
     if (mFilename.length() > 0) {
-        size_t headerSize = cacheFileHeaderSize;
-
-        int fd = open(mFilename.c_str(), O_RDONLY, 0);
+        int fd = open(mFilename.c_str(), O_RDONLY | O_CLOEXEC, 0);
         if (fd == -1) {
             if (errno != ENOENT) {
                 ALOGE("error opening cache file %s: %s (%d)", mFilename.c_str(),
@@ -70,116 +139,202 @@ FileBlobCache::FileBlobCache(size_t maxKeySize, size_t maxValueSize, size_t maxT
 
         // Sanity check the size before trying to mmap it.
         size_t fileSize = statBuf.st_size;
-        if (fileSize > mMaxTotalSize * 2) {
+        if (fileSize > sizeof(FileHeader) + mMaxTotalSize * maxLoadedFileSizeFactor) {
             ALOGE("cache file is too large: %#" PRIx64,
                   static_cast<off64_t>(statBuf.st_size));
             close(fd);
             return;
         }
+        if (fileSize < sizeof(FileHeader)) {
+            close(fd);
+            return;
+        }
 
         uint8_t* buf = reinterpret_cast<uint8_t*>(mmap(nullptr, fileSize,
                 PROT_READ, MAP_PRIVATE, fd, 0));
+        close(fd);
         if (buf == MAP_FAILED) {
             ALOGE("error mmaping cache file: %s (%d)", strerror(errno),
                     errno);
-            close(fd);
             return;
         }
 
-        // Check the file magic and CRC
-        size_t cacheSize = fileSize - headerSize;
-        if (memcmp(buf, cacheFileMagic, 4) != 0) {
-            ALOGE("cache file has bad mojo");
-            close(fd);
-            return;
-        }
-        uint32_t* crc = reinterpret_cast<uint32_t*>(buf + 4);
-        if (crc32c(buf + headerSize, cacheSize) != *crc) {
-            ALOGE("cache file failed CRC check");
-            close(fd);
+        // Check the file magic and version.  Files in other formats, such as
+        // the one written before the file became append-only, are replaced on
+        // the next write.
+        FileHeader expected;
+        fillFileHeader(&expected);
+        const FileHeader* header = reinterpret_cast<const FileHeader*>(buf);
+        if (memcmp(header->mMagic, expected.mMagic, sizeof(header->mMagic)) != 0 ||
+                header->mVersion != expected.mVersion ||
+                header->mBuildIdLength != expected.mBuildIdLength ||
+                memcmp(header->mBuildId, expected.mBuildId, expected.mBuildIdLength) != 0) {
+            ALOGV("cache file has a different format or build, ignoring it");
+            munmap(buf, fileSize);
             return;
         }
 
-        int err = unflatten(buf + headerSize, cacheSize);
-        if (err < 0) {
-            ALOGE("error reading cache contents: %s (%d)", strerror(-err),
-                    -err);
-            munmap(buf, fileSize);
-            close(fd);
-            return;
+        // Values are only paged in as they are used, so there is no point in
+        // reading ahead of the record headers.
+        madvise(buf, fileSize, MADV_RANDOM);
+        mMappings.emplace_back(buf, fileSize);
+
+        size_t offset = sizeof(FileHeader);
+        while (offset + sizeof(RecordHeader) <= fileSize) {
+            const RecordHeader* record = reinterpret_cast<const RecordHeader*>(buf + offset);
+            const size_t keySize = record->mKeySize;
+            const size_t valueSize = record->mValueSize;
+            if (keySize == 0 || valueSize == 0 || keySize + valueSize > mMaxTotalSize ||
+                    recordSize(keySize, valueSize) > fileSize - offset) {
+                // A record cut short by an interrupted write ends the valid
+                // part of the file; the next write overwrites it.
+                ALOGW("cache file has a bad record at offset %zu", offset);
+                break;
+            }
+
+            const uint8_t* key = buf + offset + sizeof(RecordHeader);
+            setPersistent(key, keySize, key + keySize, valueSize);
+            offset += recordSize(keySize, valueSize);
         }
+        mFileSize = offset;
+    }
+}
+
+FileBlobCache::~FileBlobCache() {
+    // Drop the entries referring to the mappings before unmapping them.
+    clear();
+    for (const auto& mapping : mMappings) {
+        munmap(mapping.first, mapping.second);
+    }
+}
+
+bool FileBlobCache::verifyPersistentValue(const void* key, size_t keySize,
+        const void* /*value*/, size_t valueSize) const {
+    // Persistent entries always point into a mapped record, right behind its
+    // header.
+    const uint8_t* record = reinterpret_cast<const uint8_t*>(key) - sizeof(RecordHeader);
+    const RecordHeader* header = reinterpret_cast<const RecordHeader*>(record);
+    return recordCrc(record, keySize, valueSize) == header->mCrc;
+}
+
+void FileBlobCache::appendRecords(bool unsavedOnly, std::vector<uint8_t>* buffer) const {
+    forEachEntry(unsavedOnly, [buffer](const void* key, size_t keySize, const void* value,
+            size_t valueSize) {
+        // Resizing zero-fills the padding, which keeps the file reproducible.
+        const size_t offset = buffer->size();
+        buffer->resize(offset + recordSize(keySize, valueSize));
+        uint8_t* record = buffer->data() + offset;
 
-        munmap(buf, fileSize);
+        RecordHeader header;
+        header.mKeySize = keySize;
+        header.mValueSize = valueSize;
+        memcpy(record, &header, sizeof(header));
+        memcpy(record + sizeof(header), key, keySize);
+        memcpy(record + sizeof(header) + keySize, value, valueSize);
+
+        header.mCrc = recordCrc(record, keySize, valueSize);
+        memcpy(record, &header, sizeof(header));
+    });
+}
+
+bool FileBlobCache::rewriteFile() {
+    std::vector<uint8_t> buffer(sizeof(FileHeader));
+    fillFileHeader(reinterpret_cast<FileHeader*>(buffer.data()));
+    appendRecords(false, &buffer);
+
+    // Write the new file next to the old one and move it in place, so that the
+    // cache file is complete whenever it is opened.  Mappings of the old file
+    // stay valid.
+    const std::string tempName = mFilename + ".tmp";
+    const char* fname = tempName.c_str();
+    if (unlink(fname) == -1 && errno != ENOENT) {
+        ALOGE("error unlinking cache file %s: %s (%d)", fname, strerror(errno), errno);
+        return false;
+    }
+
+    // Create the file with no permissions so we can write it without anyone
+    // trying to read it.
+    int fd = open(fname, O_CREAT | O_EXCL | O_WRONLY | O_CLOEXEC, 0);
+    if (fd == -1) {
+        ALOGE("error creating cache file %s: %s (%d)", fname, strerror(errno), errno);
+        return false;
+    }
+
+    if (!writeFully(fd, buffer.data(), buffer.size(), 0)) {
+        ALOGE("error writing cache file: %s (%d)", strerror(errno), errno);
         close(fd);
+        unlink(fname);
+        return false;
+    }
+
+    // The file should stay writable by its owner so that later writes can
+    // append to it.
+    fchmod(fd, mFileMode);
+    close(fd);
+
+    if (rename(fname, mFilename.c_str()) == -1) {
+        ALOGE("error renaming cache file %s: %s (%d)", fname, strerror(errno), errno);
+        unlink(fname);
+        return false;
     }
+
+    mFileSize = buffer.size();
+    return true;
+}
+
+bool FileBlobCache::appendToFile(const std::vector<uint8_t>& buffer) {
+    int fd = open(mFilename.c_str(), O_WRONLY | O_CLOEXEC);
+    if (fd == -1) {
+        ALOGE("error opening cache file %s for appending: %s (%d)", mFilename.c_str(),
+                strerror(errno), errno);
+        return false;
+    }
+
+    // The file is rewritten instead if it has been truncated since it was
+    // loaded.
+    struct stat statBuf;
+    if (fstat(fd, &statBuf) == -1 || static_cast<size_t>(statBuf.st_size) < mFileSize) {
+        close(fd);
+        return false;
+    }
+
+    // Anything past the valid records, such as a record cut short by an
+    // interrupted write, is overwritten and cut off.
+    const size_t newFileSize = mFileSize + buffer.size();
+    if (!writeFully(fd, buffer.data(), buffer.size(), mFileSize) ||
+            ftruncate(fd, newFileSize) == -1) {
+        ALOGE("error appending to cache file: %s (%d)", strerror(errno), errno);
+        ftruncate(fd, mFileSize);
+        close(fd);
+        return false;
+    }
+
+    close(fd);
+    mFileSize = newFileSize;
+    return true;
 }
 
 void FileBlobCache::writeToFile() {
     if (mFilename.length() > 0) {
-        size_t cacheSize = getFlattenedSize();
-        size_t headerSize = cacheFileHeaderSize;
-        const char* fname = mFilename.c_str();
-
-        // Try to create the file with no permissions so we can write it
-        // without anyone trying to read it.
-        int fd = open(fname, O_CREAT | O_EXCL | O_RDWR, 0);
-        if (fd == -1) {
-            if (errno == EEXIST) {
-                // The file exists, delete it and try again.
-                if (unlink(fname) == -1) {
-                    // No point in retrying if the unlink failed.
-                    ALOGE("error unlinking cache file %s: %s (%d)", fname,
-                            strerror(errno), errno);
-                    return;
-                }
-                // Retry now that we've unlinked the file.
-                fd = open(fname, O_CREAT | O_EXCL | O_RDWR, 0);
+        // Append the entries set since the last write, as long as the stale
+        // records left behind by evicted and updated entries do not make the
+        // file grow too large.
+        if (mFileSize > 0) {
+            std::vector<uint8_t> buffer;
+            appendRecords(true, &buffer);
+            if (buffer.empty()) {
+                return;
             }
-            if (fd == -1) {
-                ALOGE("error creating cache file %s: %s (%d)", fname,
-                        strerror(errno), errno);
+            const size_t maxFileSize = sizeof(FileHeader) + mMaxTotalSize * maxFileSizeFactor;
+            if (mFileSize + buffer.size() <= maxFileSize && appendToFile(buffer)) {
+                markAllSaved();
                 return;
             }
         }
 
-        size_t fileSize = headerSize + cacheSize;
-
-        uint8_t* buf = new uint8_t [fileSize];
-        if (!buf) {
-            ALOGE("error allocating buffer for cache contents: %s (%d)",
-                    strerror(errno), errno);
-            close(fd);
-            unlink(fname);
-            return;
-        }
-
-        int err = flatten(buf + headerSize, cacheSize);
-        if (err < 0) {
-            ALOGE("error writing cache contents: %s (%d)", strerror(-err),
-                    -err);
-            delete [] buf;
-            close(fd);
-            unlink(fname);
-            return;
-        }
-
-        // Write the file magic and CRC
-        memcpy(buf, cacheFileMagic, 4);
-        uint32_t* crc = reinterpret_cast<uint32_t*>(buf + 4);
-        *crc = crc32c(buf + headerSize, cacheSize);
-
-        if (write(fd, buf, fileSize) == -1) {
-            ALOGE("error writing cache file: %s (%d)", strerror(errno),
-                    errno);
-            delete [] buf;
-            close(fd);
-            unlink(fname);
-            return;
+        if (rewriteFile()) {
+            markAllSaved();
         }
-
-        delete [] buf;
-        fchmod(fd, S_IRUSR);
-        close(fd);
     }
 }
 
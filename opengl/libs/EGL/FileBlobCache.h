@@ -18,24 +18,62 @@
 #define ANDROID_FILE_BLOB_CACHE_H
 
 #include "BlobCache.h"
+#include <sys/stat.h>
 #include <string>
+#include <vector>
 
 namespace android {
 
+// A FileBlobCache keeps the contents of a BlobCache in an append-only file.
+//
+// The file is mapped rather than read when the cache is created, and the
+// cache refers to the keys and values in the mapping, so only the pages of
+// the values actually used are ever read from disk.  Each value is checked
+// against its CRC the first time it is used.  Writing the cache appends only
+// the entries set since the last write; the file is rewritten from scratch
+// only when stale entries would make it grow past twice the maximum cache
+// size.
 class FileBlobCache : public BlobCache {
 public:
     // FileBlobCache attempts to load the saved cache contents from disk into
-    // BlobCache.
+    // BlobCache.  Files it creates get the permissions in fileMode.
     FileBlobCache(size_t maxKeySize, size_t maxValueSize, size_t maxTotalSize,
-            const std::string& filename);
+            const std::string& filename, mode_t fileMode = S_IRUSR | S_IWUSR);
+    ~FileBlobCache() override;
 
     // writeToFile attempts to save the current contents of BlobCache to
     // disk.
     void writeToFile();
 
+protected:
+    bool verifyPersistentValue(const void* key, size_t keySize, const void* value,
+            size_t valueSize) const override;
+
 private:
+    // appendRecords serializes the cache entries into buffer as records.  If
+    // unsavedOnly is true, only the entries not yet in the file are added.
+    void appendRecords(bool unsavedOnly, std::vector<uint8_t>* buffer) const;
+
+    // rewriteFile replaces the cache file with one holding every cache entry.
+    bool rewriteFile();
+
+    // appendToFile adds the records in buffer at the end of the cache file.
+    bool appendToFile(const std::vector<uint8_t>& buffer);
+
     // mFilename is the name of the file for storing cache contents.
     std::string mFilename;
+
+    // mFileMode is the permissions of the cache file once it is written.
+    mode_t mFileMode;
+
+    // mMappings are the cache files mapped into memory, which persistent
+    // cache entries refer to.  A rewritten file leaves its old mapping in
+    // place, since entries loaded from it may still be in the cache.
+    std::vector<std::pair<void*, size_t>> mMappings;
+
+    // mFileSize is the size of the valid records in the cache file, where the
+    // next records get appended, or 0 if there is no valid cache file.
+    size_t mFileSize;
 };
 
 } // namespace android
@@ -0,0 +1,205 @@
+/*
+ ** Copyright 2019, The Android Open Source Project
+ **
+ ** Licensed under the Apache License, Version 2.0 (the "License");
+ ** you may not use this file except in compliance with the License.
+ ** You may obtain a copy of the License at
+ **
+ **     http://www.apache.org/licenses/LICENSE-2.0
+ **
+ ** Unless required by applicable law or agreed to in writing, software
+ ** distributed under the License is distributed on an "AS IS" BASIS,
+ ** WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ ** See the License for the specific language governing permissions and
+ ** limitations under the License.
+ */
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <memory>
+#include <string>
+
+#include <gtest/gtest.h>
+
+#include "FileBlobCache.h"
+
+namespace android {
+
+class FileBlobCacheTest : public ::testing::Test {
+protected:
+    enum {
+        MAX_KEY_SIZE = 6,
+        MAX_VALUE_SIZE = 8,
+        MAX_TOTAL_SIZE = 64,
+    };
+
+    virtual void SetUp() {
+        const char* tmpdir = getenv("TMPDIR");
+        std::string dir = std::string(tmpdir ? tmpdir : "/data/local/tmp") +
+                "/FileBlobCacheTest.XXXXXX";
+        ASSERT_NE(nullptr, mkdtemp(&dir[0]));
+        mDirectory = dir;
+        mFilename = mDirectory + "/cache";
+    }
+
+    virtual void TearDown() {
+        unlink(mFilename.c_str());
+        rmdir(mDirectory.c_str());
+    }
+
+    std::unique_ptr<FileBlobCache> openCache() {
+        return std::make_unique<FileBlobCache>(MAX_KEY_SIZE, MAX_VALUE_SIZE, MAX_TOTAL_SIZE,
+                mFilename);
+    }
+
+    off_t fileSize() {
+        struct stat statBuf;
+        return stat(mFilename.c_str(), &statBuf) == 0 ? statBuf.st_size : -1;
+    }
+
+    void corruptByteAt(off_t offset) {
+        int fd = open(mFilename.c_str(), O_RDWR);
+        ASSERT_NE(-1, fd);
+        uint8_t byte;
+        ASSERT_EQ(1, pread(fd, &byte, 1, offset));
+        byte ^= 0xff;
+        ASSERT_EQ(1, pwrite(fd, &byte, 1, offset));
+        close(fd);
+    }
+
+    std::string mDirectory;
+    std::string mFilename;
+};
+
+TEST_F(FileBlobCacheTest, ReloadsWrittenEntries) {
+    {
+        auto cache = openCache();
+        cache->set("abcd", 4, "efgh", 4);
+        cache->set("ijk", 3, "lmnop", 5);
+        cache->writeToFile();
+    }
+
+    auto cache = openCache();
+    char buf[8] = {};
+    ASSERT_EQ(size_t(4), cache->get("abcd", 4, buf, sizeof(buf)));
+    ASSERT_EQ(0, memcmp(buf, "efgh", 4));
+    ASSERT_EQ(size_t(5), cache->get("ijk", 3, buf, sizeof(buf)));
+    ASSERT_EQ(0, memcmp(buf, "lmnop", 5));
+}
+
+TEST_F(FileBlobCacheTest, WriteAppendsOnlyNewEntries) {
+    auto cache = openCache();
+    cache->set("abcd", 4, "efgh", 4);
+    cache->writeToFile();
+    const off_t firstSize = fileSize();
+    ASSERT_GT(firstSize, 0);
+
+    // Writing without changes leaves the file alone.
+    cache->writeToFile();
+    ASSERT_EQ(firstSize, fileSize());
+
+    // A record is a 12 byte header, the key and the value, 4-byte aligned.
+    cache->set("ij", 2, "klmn", 4);
+    cache->writeToFile();
+    ASSERT_EQ(firstSize + 20, fileSize());
+
+    auto reloaded = openCache();
+    ASSERT_EQ(size_t(4), reloaded->get("abcd", 4, nullptr, 0));
+    ASSERT_EQ(size_t(4), reloaded->get("ij", 2, nullptr, 0));
+}
+
+TEST_F(FileBlobCacheTest, LaterRecordsSupersedeEarlierOnes) {
+    {
+        auto cache = openCache();
+        cache->set("abcd", 4, "efgh", 4);
+        cache->writeToFile();
+        cache->set("abcd", 4, "xy", 2);
+        cache->writeToFile();
+    }
+
+    auto cache = openCache();
+    char buf[8] = {};
+    ASSERT_EQ(size_t(2), cache->get("abcd", 4, buf, sizeof(buf)));
+    ASSERT_EQ(0, memcmp(buf, "xy", 2));
+}
+
+TEST_F(FileBlobCacheTest, CorruptValueIsDropped) {
+    {
+        auto cache = openCache();
+        cache->set("abcd", 4, "efgh", 4);
+        cache->writeToFile();
+    }
+    // The value is the last data in the file, ahead of no padding.
+    corruptByteAt(fileSize() - 1);
+
+    auto cache = openCache();
+    ASSERT_EQ(size_t(0), cache->get("abcd", 4, nullptr, 0));
+}
+
+TEST_F(FileBlobCacheTest, TruncatedRecordIsIgnored) {
+    {
+        auto cache = openCache();
+        cache->set("abcd", 4, "efgh", 4);
+        cache->writeToFile();
+        cache->set("ij", 2, "klmn", 4);
+        cache->writeToFile();
+    }
+    ASSERT_EQ(0, truncate(mFilename.c_str(), fileSize() - 3));
+
+    {
+        auto cache = openCache();
+        ASSERT_EQ(size_t(4), cache->get("abcd", 4, nullptr, 0));
+        ASSERT_EQ(size_t(0), cache->get("ij", 2, nullptr, 0));
+
+        // The next write replaces the partial record.
+        cache->set("op", 2, "qrst", 4);
+        cache->writeToFile();
+    }
+
+    auto cache = openCache();
+    ASSERT_EQ(size_t(4), cache->get("abcd", 4, nullptr, 0));
+    ASSERT_EQ(size_t(4), cache->get("op", 2, nullptr, 0));
+}
+
+TEST_F(FileBlobCacheTest, StaleRecordsAreCompacted) {
+    auto cache = openCache();
+    uint8_t value = 0;
+    cache->set("abcd", 4, &value, 1);
+    cache->writeToFile();
+    const off_t firstSize = fileSize();
+
+    for (int i = 1; i < 100; i++) {
+        value = i;
+        cache->set("abcd", 4, &value, 1);
+        cache->writeToFile();
+        ASSERT_LE(fileSize(), firstSize + off_t(MAX_TOTAL_SIZE * 2));
+    }
+
+    auto reloaded = openCache();
+    value = 0;
+    ASSERT_EQ(size_t(1), reloaded->get("abcd", 4, &value, 1));
+    ASSERT_EQ(99, value);
+}
+
+TEST_F(FileBlobCacheTest, WrittenFileHasRequestedMode) {
+    const mode_t mode = S_IRUSR | S_IWUSR | S_IRGRP | S_IROTH;
+    {
+        FileBlobCache cache(MAX_KEY_SIZE, MAX_VALUE_SIZE, MAX_TOTAL_SIZE, mFilename, mode);
+        cache.set("abcd", 4, "efgh", 4);
+        cache.writeToFile();
+    }
+
+    struct stat statBuf;
+    ASSERT_EQ(0, stat(mFilename.c_str(), &statBuf));
+    ASSERT_EQ(mode, statBuf.st_mode & 0777);
+
+    // Another process can load the file as it is.
+    auto cache = openCache();
+    ASSERT_EQ(size_t(4), cache->get("abcd", 4, nullptr, 0));
+}
+
+} // namespace android
@@ -19,9 +19,12 @@
 
 #include <EGL/Loader.h>
 
+#include <algorithm>
+#include <iterator>
 #include <string>
 
 #include <dirent.h>
+#include <stddef.h>
 #include <dlfcn.h>
 
 #include <android/dlext.h>
@@ -69,18 +72,36 @@ Loader& Loader::getInstance() {
     return loader;
 }
 
+// The time Loader::open spent in each phase of loading the driver, summed over
+// all the drivers it attempted to load. Loader::open is never run concurrently.
+static nsecs_t sLoadingPhaseTime[GraphicsEnv::LOADING_PHASE_COUNT];
+
+class LoadingPhaseTimer {
+public:
+    explicit LoadingPhaseTimer(GraphicsEnv::LoadingPhase phase)
+          : mPhase(phase), mStart(systemTime()) {}
+    ~LoadingPhaseTimer() { sLoadingPhaseTime[mPhase] += systemTime() - mStart; }
+
+private:
+    const GraphicsEnv::LoadingPhase mPhase;
+    const nsecs_t mStart;
+};
+
 static void* do_dlopen(const char* path, int mode) {
     ATRACE_CALL();
+    LoadingPhaseTimer timer(GraphicsEnv::DLOPEN);
     return dlopen(path, mode);
 }
 
 static void* do_android_dlopen_ext(const char* path, int mode, const android_dlextinfo* info) {
     ATRACE_CALL();
+    LoadingPhaseTimer timer(GraphicsEnv::DLOPEN);
     return android_dlopen_ext(path, mode, info);
 }
 
 static void* do_android_load_sphal_library(const char* path, int mode) {
     ATRACE_CALL();
+    LoadingPhaseTimer timer(GraphicsEnv::DLOPEN);
     return android_load_sphal_library(path, mode);
 }
 
@@ -260,6 +281,8 @@ void* Loader::open(egl_connection_t* cnx)
         return cnx->dso;
     }
 
+    std::fill(std::begin(sLoadingPhaseTime), std::end(sLoadingPhaseTime), 0);
+
     setEmulatorGlesValue();
 
     // Check if we should use ANGLE early, so loading each driver doesn't require repeated queries.
@@ -342,6 +365,11 @@ void* Loader::open(egl_connection_t* cnx)
 
     android::GraphicsEnv::getInstance().setDriverLoaded(android::GraphicsEnv::Api::API_GL, true,
                                                         systemTime() - openTime);
+    for (auto phase : {GraphicsEnv::NAMESPACE_SETUP, GraphicsEnv::DLOPEN,
+                       GraphicsEnv::ENTRY_POINT_RESOLUTION}) {
+        android::GraphicsEnv::getInstance().setDriverLoadingPhaseTime(
+                android::GraphicsEnv::Api::API_GL, phase, sLoadingPhaseTime[phase]);
+    }
 
     return (void*)hnd;
 }
@@ -370,8 +398,6 @@ void Loader::init_api(void* dso,
 {
     ATRACE_CALL();
 
-    const ssize_t SIZE = 256;
-    char scrap[SIZE];
     while (*api) {
         char const * name = *api;
         if (ref_api) {
@@ -383,54 +409,141 @@ void Loader::init_api(void* dso,
             }
         }
 
-        __eglMustCastToProperFunctionPointerType f =
-            (__eglMustCastToProperFunctionPointerType)dlsym(dso, name);
-        if (f == nullptr) {
-            // couldn't find the entry-point, use eglGetProcAddress()
-            f = getProcAddress(name);
+        *curr++ = resolve_api(dso, name, getProcAddress);
+        api++;
+        if (ref_api) ref_api++;
+    }
+}
+
+__eglMustCastToProperFunctionPointerType Loader::resolve_api(void* dso,
+        char const * name,
+        getProcAddressType getProcAddress)
+{
+    const ssize_t SIZE = 256;
+    char scrap[SIZE];
+
+    __eglMustCastToProperFunctionPointerType f =
+        (__eglMustCastToProperFunctionPointerType)dlsym(dso, name);
+    if (f == nullptr) {
+        // couldn't find the entry-point, use eglGetProcAddress()
+        f = getProcAddress(name);
+    }
+    if (f == nullptr) {
+        // Try without the OES postfix
+        ssize_t index = ssize_t(strlen(name)) - 3;
+        if ((index>0 && (index<SIZE-1)) && (!strcmp(name+index, "OES"))) {
+            strncpy(scrap, name, index);
+            scrap[index] = 0;
+            f = (__eglMustCastToProperFunctionPointerType)dlsym(dso, scrap);
+            //ALOGD_IF(f, "found <%s> instead", scrap);
         }
-        if (f == nullptr) {
-            // Try without the OES postfix
-            ssize_t index = ssize_t(strlen(name)) - 3;
-            if ((index>0 && (index<SIZE-1)) && (!strcmp(name+index, "OES"))) {
-                strncpy(scrap, name, index);
-                scrap[index] = 0;
-                f = (__eglMustCastToProperFunctionPointerType)dlsym(dso, scrap);
-                //ALOGD_IF(f, "found <%s> instead", scrap);
-            }
+    }
+    if (f == nullptr) {
+        // Try with the OES postfix
+        ssize_t index = ssize_t(strlen(name)) - 3;
+        if (index>0 && strcmp(name+index, "OES")) {
+            snprintf(scrap, SIZE, "%sOES", name);
+            f = (__eglMustCastToProperFunctionPointerType)dlsym(dso, scrap);
+            //ALOGD_IF(f, "found <%s> instead", scrap);
         }
-        if (f == nullptr) {
-            // Try with the OES postfix
-            ssize_t index = ssize_t(strlen(name)) - 3;
-            if (index>0 && strcmp(name+index, "OES")) {
-                snprintf(scrap, SIZE, "%sOES", name);
-                f = (__eglMustCastToProperFunctionPointerType)dlsym(dso, scrap);
-                //ALOGD_IF(f, "found <%s> instead", scrap);
-            }
+    }
+    if (f == nullptr) {
+        //ALOGD("%s", name);
+        f = (__eglMustCastToProperFunctionPointerType)gl_unimplemented;
+
+        /*
+         * GL_EXT_debug_label is special, we always report it as
+         * supported, it's handled by GLES_trace. If GLES_trace is not
+         * enabled, then these are no-ops.
+         */
+        if (!strcmp(name, "glInsertEventMarkerEXT")) {
+            f = (__eglMustCastToProperFunctionPointerType)gl_noop;
+        } else if (!strcmp(name, "glPushGroupMarkerEXT")) {
+            f = (__eglMustCastToProperFunctionPointerType)gl_noop;
+        } else if (!strcmp(name, "glPopGroupMarkerEXT")) {
+            f = (__eglMustCastToProperFunctionPointerType)gl_noop;
         }
-        if (f == nullptr) {
-            //ALOGD("%s", name);
-            f = (__eglMustCastToProperFunctionPointerType)gl_unimplemented;
-
-            /*
-             * GL_EXT_debug_label is special, we always report it as
-             * supported, it's handled by GLES_trace. If GLES_trace is not
-             * enabled, then these are no-ops.
-             */
-            if (!strcmp(name, "glInsertEventMarkerEXT")) {
-                f = (__eglMustCastToProperFunctionPointerType)gl_noop;
-            } else if (!strcmp(name, "glPushGroupMarkerEXT")) {
-                f = (__eglMustCastToProperFunctionPointerType)gl_noop;
-            } else if (!strcmp(name, "glPopGroupMarkerEXT")) {
-                f = (__eglMustCastToProperFunctionPointerType)gl_noop;
-            }
+    }
+    return f;
+}
+
+/*
+ * Resolving every GLESv2 entry point when the driver is loaded costs several
+ * dlsym() and eglGetProcAddress() lookups per entry, most of them for
+ * extensions the process never calls.  Instead, each hook starts out pointing
+ * at a stub with the same signature which resolves the entry point on its
+ * first call, stores it in the hook and forwards the call to it.  The stubs
+ * are generated from entries.in.
+ *
+ * The much smaller GLESv1 table is still resolved eagerly, so that only one
+ * set of stubs is needed.
+ */
+
+Loader::lazy_api_t Loader::lazy_api;
+
+namespace {
+
+template <size_t Slot, typename F>
+struct lazy_entry;
+
+template <size_t Slot, typename R, typename... Args>
+struct lazy_entry<Slot, R(Args...)> {
+    static R call(Args... args) {
+        auto f = reinterpret_cast<R (*)(Args...)>(Loader::resolve_lazy_api(Slot));
+        return f(args...);
+    }
+};
+
+#define GL_ENTRY(_r, _api, ...)                                                   \
+    (__eglMustCastToProperFunctionPointerType) &                                  \
+            lazy_entry<offsetof(gl_hooks_t::gl_t, _api) /                         \
+                               sizeof(__eglMustCastToProperFunctionPointerType),  \
+                       _r(__VA_ARGS__)>::call,
+
+const __eglMustCastToProperFunctionPointerType lazy_entries[] = {
+    #include "../entries.in"
+};
+
+#undef GL_ENTRY
+
+static_assert(sizeof(lazy_entries) == sizeof(gl_hooks_t::gl_t),
+              "lazy_entries must have one stub per GLES hook");
+
+} // anonymous namespace
+
+__eglMustCastToProperFunctionPointerType Loader::resolve_lazy_api(size_t slot) {
+    __eglMustCastToProperFunctionPointerType f =
+            resolve_api(lazy_api.dso, gl_names[slot], lazy_api.getProcAddress);
+
+    // Threads racing on the first call of an entry point all store the same
+    // value.
+    __atomic_store_n(&lazy_api.curr[slot], f, __ATOMIC_RELAXED);
+    return f;
+}
+
+void Loader::resolve_lazy_apis() {
+    ATRACE_CALL();
+
+    if (!lazy_api.curr) {
+        return;
+    }
+    for (size_t slot = 0; slot < NELEM(lazy_entries); slot++) {
+        if (lazy_api.curr[slot] == lazy_entries[slot]) {
+            resolve_lazy_api(slot);
         }
-        *curr++ = f;
-        api++;
-        if (ref_api) ref_api++;
     }
 }
 
+void Loader::init_lazy_api(void* dso,
+        __eglMustCastToProperFunctionPointerType* curr,
+        getProcAddressType getProcAddress)
+{
+    ATRACE_CALL();
+
+    lazy_api = {dso, getProcAddress, curr};
+    memcpy(curr, lazy_entries, sizeof(lazy_entries));
+}
+
 static void* load_system_driver(const char* kind, const char* suffix, const bool exact) {
     ATRACE_CALL();
     class MatchFile {
@@ -632,7 +745,11 @@ static void* load_updated_driver(const char* kind, android_namespace_t* ns) {
 
 Loader::driver_t* Loader::attempt_to_load_angle(egl_connection_t* cnx) {
     ATRACE_CALL();
-    android_namespace_t* ns = android::GraphicsEnv::getInstance().getAngleNamespace();
+    android_namespace_t* ns;
+    {
+        LoadingPhaseTimer timer(GraphicsEnv::NAMESPACE_SETUP);
+        ns = android::GraphicsEnv::getInstance().getAngleNamespace();
+    }
     if (!ns) {
         return nullptr;
     }
@@ -660,7 +777,11 @@ Loader::driver_t* Loader::attempt_to_load_angle(egl_connection_t* cnx) {
 Loader::driver_t* Loader::attempt_to_load_updated_driver(egl_connection_t* cnx) {
     ATRACE_CALL();
 #ifndef __ANDROID_VNDK__
-    android_namespace_t* ns = android::GraphicsEnv::getInstance().getDriverNamespace();
+    android_namespace_t* ns;
+    {
+        LoadingPhaseTimer timer(GraphicsEnv::NAMESPACE_SETUP);
+        ns = android::GraphicsEnv::getInstance().getDriverNamespace();
+    }
     if (!ns) {
         return nullptr;
     }
@@ -722,6 +843,8 @@ Loader::driver_t* Loader::attempt_to_load_system_driver(egl_connection_t* cnx, c
 }
 
 void Loader::initialize_api(void* dso, egl_connection_t* cnx, uint32_t mask) {
+    LoadingPhaseTimer timer(GraphicsEnv::ENTRY_POINT_RESOLUTION);
+
     if (mask & EGL) {
         getProcAddress = (getProcAddressType)dlsym(dso, "eglGetProcAddress");
 
@@ -756,10 +879,17 @@ void Loader::initialize_api(void* dso, egl_connection_t* cnx, uint32_t mask) {
     }
 
     if (mask & GLESv2) {
-        init_api(dso, gl_names, nullptr,
+        // debug.egl.eager_entry_points resolves every entry point up front,
+        // e.g. to compare driver load times.
+        const bool lazy = !property_get_bool("debug.egl.eager_entry_points", false);
+        __eglMustCastToProperFunctionPointerType* curr =
             (__eglMustCastToProperFunctionPointerType*)
-                &cnx->hooks[egl_connection_t::GLESv2_INDEX]->gl,
-            getProcAddress);
+                &cnx->hooks[egl_connection_t::GLESv2_INDEX]->gl;
+        if (lazy) {
+            init_lazy_api(dso, curr, getProcAddress);
+        } else {
+            init_api(dso, gl_names, nullptr, curr, getProcAddress);
+        }
     }
 }
 
@@ -53,7 +53,23 @@ public:
     void* open(egl_connection_t* cnx);
     void close(egl_connection_t* cnx);
 
+    // resolve_lazy_api is called by the stub initially installed in each
+    // GLESv2 hook; it looks up the driver entry point of the hook, replaces the
+    // stub with it and returns it.
+    static __eglMustCastToProperFunctionPointerType resolve_lazy_api(size_t slot);
+
+    // resolve_lazy_apis resolves every GLESv2 hook still pointing at its stub.
+    static void resolve_lazy_apis();
+
 private:
+    // The driver the GLESv2 hooks are lazily resolved against.
+    struct lazy_api_t {
+        void* dso;
+        getProcAddressType getProcAddress;
+        __eglMustCastToProperFunctionPointerType* curr;
+    };
+    static lazy_api_t lazy_api;
+
     Loader();
     driver_t* attempt_to_load_angle(egl_connection_t* cnx);
     driver_t* attempt_to_load_updated_driver(egl_connection_t* cnx);
@@ -67,6 +83,14 @@ private:
             char const * const * ref_api,
             __eglMustCastToProperFunctionPointerType* curr,
             getProcAddressType getProcAddress);
+
+    static void init_lazy_api(void* dso,
+            __eglMustCastToProperFunctionPointerType* curr,
+            getProcAddressType getProcAddress);
+
+    static __eglMustCastToProperFunctionPointerType resolve_api(void* dso,
+            char const * name,
+            getProcAddressType getProcAddress);
 };
 
 // ----------------------------------------------------------------------------
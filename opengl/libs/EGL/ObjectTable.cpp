@@ -0,0 +1,172 @@
+/*
+ ** Copyright 2019, The Android Open Source Project
+ **
+ ** Licensed under the Apache License, Version 2.0 (the "License");
+ ** you may not use this file except in compliance with the License.
+ ** You may obtain a copy of the License at
+ **
+ **     http://www.apache.org/licenses/LICENSE-2.0
+ **
+ ** Unless required by applicable law or agreed to in writing, software
+ ** distributed under the License is distributed on an "AS IS" BASIS,
+ ** WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ ** See the License for the specific language governing permissions and
+ ** limitations under the License.
+ */
+
+#include "ObjectTable.h"
+
+#include <thread>
+
+namespace android {
+
+namespace {
+
+constexpr size_t MIN_CAPACITY = 16;
+
+// Marks the slot of a removed object, so that lookups probe past it.
+const void* const TOMBSTONE = reinterpret_cast<const void*>(uintptr_t(1));
+
+size_t hashOf(const void* object) {
+    // Objects are at least 8 byte aligned, so the low bits carry nothing.
+    uint64_t h = uint64_t(reinterpret_cast<uintptr_t>(object) >> 3);
+    h *= 0x9e3779b97f4a7c15ull;
+    return size_t(h ^ (h >> 32));
+}
+
+} // namespace
+
+ObjectTable::Slots::Slots(size_t capacity)
+      : mask(capacity - 1), entries(new std::atomic<const void*>[capacity]) {
+    for (size_t i = 0; i < capacity; i++) {
+        entries[i].store(nullptr, std::memory_order_relaxed);
+    }
+}
+
+ObjectTable::ObjectTable() : mSlots(new Slots(MIN_CAPACITY)) {}
+
+ObjectTable::~ObjectTable() {
+    delete mSlots.load();
+}
+
+bool ObjectTable::contains(const void* object) const {
+    if (object == nullptr || object == TOMBSTONE) {
+        return false;
+    }
+    const Slots* slots = mSlots.load();
+    // The table is never more than half full, so there is always an empty
+    // slot to end the probe.
+    for (size_t i = hashOf(object) & slots->mask;; i = (i + 1) & slots->mask) {
+        const void* entry = slots->entries[i].load();
+        if (entry == object) {
+            return true;
+        }
+        if (entry == nullptr) {
+            return false;
+        }
+    }
+}
+
+void ObjectTable::insert(const void* object) {
+    std::lock_guard<std::mutex> _l(mWriteLock);
+    Slots* slots = mSlots.load(std::memory_order_relaxed);
+    if ((mUsed + 1) * 2 > slots->mask + 1) {
+        size_t capacity = MIN_CAPACITY;
+        while (capacity < (mSize + 1) * 4) {
+            capacity *= 2;
+        }
+        rehashLocked(capacity);
+        slots = mSlots.load(std::memory_order_relaxed);
+    }
+
+    for (size_t i = hashOf(object) & slots->mask;; i = (i + 1) & slots->mask) {
+        const void* entry = slots->entries[i].load(std::memory_order_relaxed);
+        if (entry == object) {
+            return;
+        }
+        if (entry == nullptr) {
+            slots->entries[i].store(object);
+            mSize++;
+            mUsed++;
+            return;
+        }
+    }
+}
+
+void ObjectTable::erase(const void* object) {
+    std::lock_guard<std::mutex> _l(mWriteLock);
+    Slots* slots = mSlots.load(std::memory_order_relaxed);
+    for (size_t i = hashOf(object) & slots->mask;; i = (i + 1) & slots->mask) {
+        const void* entry = slots->entries[i].load(std::memory_order_relaxed);
+        if (entry == object) {
+            slots->entries[i].store(TOMBSTONE);
+            mSize--;
+            synchronize();
+            return;
+        }
+        if (entry == nullptr) {
+            return;
+        }
+    }
+}
+
+std::vector<const void*> ObjectTable::clear() {
+    std::lock_guard<std::mutex> _l(mWriteLock);
+    std::vector<const void*> objects;
+    objects.reserve(mSize);
+    Slots* slots = mSlots.load(std::memory_order_relaxed);
+    for (size_t i = 0; i <= slots->mask; i++) {
+        const void* entry = slots->entries[i].load(std::memory_order_relaxed);
+        if (entry != nullptr && entry != TOMBSTONE) {
+            objects.push_back(entry);
+        }
+        slots->entries[i].store(nullptr);
+    }
+    mSize = 0;
+    mUsed = 0;
+    synchronize();
+    return objects;
+}
+
+size_t ObjectTable::size() const {
+    std::lock_guard<std::mutex> _l(mWriteLock);
+    return mSize;
+}
+
+void ObjectTable::rehashLocked(size_t capacity) {
+    Slots* oldSlots = mSlots.load(std::memory_order_relaxed);
+    Slots* newSlots = new Slots(capacity);
+    for (size_t i = 0; i <= oldSlots->mask; i++) {
+        const void* entry = oldSlots->entries[i].load(std::memory_order_relaxed);
+        if (entry == nullptr || entry == TOMBSTONE) {
+            continue;
+        }
+        size_t j = hashOf(entry) & newSlots->mask;
+        while (newSlots->entries[j].load(std::memory_order_relaxed) != nullptr) {
+            j = (j + 1) & newSlots->mask;
+        }
+        newSlots->entries[j].store(entry, std::memory_order_relaxed);
+    }
+    mSlots.store(newSlots);
+    mUsed = mSize;
+
+    // Lookups may still be probing the old slots.
+    synchronize();
+    delete oldSlots;
+}
+
+void ObjectTable::synchronize() {
+    // A lookup counts itself in the readers of the epoch it read before
+    // looking at the slots. Flipping the epoch and waiting for the readers of
+    // the previous one, twice, waits for every lookup that could have started
+    // before the change to the slots, including those that read the epoch
+    // just before a flip.
+    for (int phase = 0; phase < 2; phase++) {
+        const uint32_t epoch = mEpoch.fetch_add(1) & 1;
+        while (mReaders[epoch].load() != 0) {
+            std::this_thread::yield();
+        }
+    }
+}
+
+} // namespace android
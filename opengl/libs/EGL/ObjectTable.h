@@ -0,0 +1,104 @@
+/*
+ ** Copyright 2019, The Android Open Source Project
+ **
+ ** Licensed under the Apache License, Version 2.0 (the "License");
+ ** you may not use this file except in compliance with the License.
+ ** You may obtain a copy of the License at
+ **
+ **     http://www.apache.org/licenses/LICENSE-2.0
+ **
+ ** Unless required by applicable law or agreed to in writing, software
+ ** distributed under the License is distributed on an "AS IS" BASIS,
+ ** WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ ** See the License for the specific language governing permissions and
+ ** limitations under the License.
+ */
+
+#ifndef ANDROID_OBJECT_TABLE_H
+#define ANDROID_OBJECT_TABLE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace android {
+
+// An ObjectTable is a set of object addresses that can be looked up without
+// taking a lock, so that validating the handles passed to every EGL call does
+// not serialize the threads making them.
+//
+// Insertions and removals are serialized, and a removal only returns once no
+// lookup that could still see the object is running. Until then, the caller
+// of find() may use the object it found, e.g. to take a reference to it.
+class ObjectTable {
+public:
+    ObjectTable();
+    ~ObjectTable();
+
+    ObjectTable(const ObjectTable&) = delete;
+    ObjectTable& operator=(const ObjectTable&) = delete;
+
+    void insert(const void* object);
+    void erase(const void* object);
+
+    // Removes every object, returning them.
+    std::vector<const void*> clear();
+
+    size_t size() const;
+
+    // If the object is in the table, calls f while it cannot be removed from
+    // it, and returns true.
+    template <typename F>
+    bool find(const void* object, F&& f) const {
+        ReadSection section(*this);
+        if (!contains(object)) {
+            return false;
+        }
+        f();
+        return true;
+    }
+
+private:
+    // The lookups are counted by epoch, and a removal waits for the lookups of
+    // both epochs begun before it to be done.
+    class ReadSection {
+    public:
+        explicit ReadSection(const ObjectTable& table)
+              : mReaders(table.mReaders[table.mEpoch.load() & 1]) {
+            mReaders.fetch_add(1);
+        }
+        ~ReadSection() { mReaders.fetch_sub(1, std::memory_order_release); }
+
+    private:
+        std::atomic<uint32_t>& mReaders;
+    };
+
+    struct Slots {
+        explicit Slots(size_t capacity);
+        const size_t mask;
+        std::unique_ptr<std::atomic<const void*>[]> entries;
+    };
+
+    // Must be called in a ReadSection.
+    bool contains(const void* object) const;
+    // Waits for the ReadSections begun before it. Called with mWriteLock held.
+    void synchronize();
+    void rehashLocked(size_t capacity);
+
+    mutable std::mutex mWriteLock;
+    std::atomic<Slots*> mSlots;
+    size_t mSize = 0;
+    // The occupied slots, including the ones of removed objects
+    size_t mUsed = 0;
+
+    std::atomic<uint32_t> mEpoch{0};
+    mutable std::atomic<uint32_t> mReaders[2] = {};
+};
+
+} // namespace android
+
+#endif // ANDROID_OBJECT_TABLE_H
@@ -0,0 +1,138 @@
+/*
+ ** Copyright 2019, The Android Open Source Project
+ **
+ ** Licensed under the Apache License, Version 2.0 (the "License");
+ ** you may not use this file except in compliance with the License.
+ ** You may obtain a copy of the License at
+ **
+ **     http://www.apache.org/licenses/LICENSE-2.0
+ **
+ ** Unless required by applicable law or agreed to in writing, software
+ ** distributed under the License is distributed on an "AS IS" BASIS,
+ ** WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ ** See the License for the specific language governing permissions and
+ ** limitations under the License.
+ */
+
+#include <algorithm>
+#include <atomic>
+#include <thread>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "ObjectTable.h"
+
+namespace android {
+
+class ObjectTableTest : public ::testing::Test {
+protected:
+    bool contains(const void* object) const {
+        return mTable.find(object, [] {});
+    }
+
+    ObjectTable mTable;
+    int mObjects[256];
+};
+
+TEST_F(ObjectTableTest, FindsInsertedObjects) {
+    mTable.insert(&mObjects[0]);
+    mTable.insert(&mObjects[1]);
+    EXPECT_TRUE(contains(&mObjects[0]));
+    EXPECT_TRUE(contains(&mObjects[1]));
+    EXPECT_FALSE(contains(&mObjects[2]));
+    EXPECT_EQ(size_t(2), mTable.size());
+}
+
+TEST_F(ObjectTableTest, RejectsInvalidHandles) {
+    mTable.insert(&mObjects[0]);
+    mTable.erase(&mObjects[0]);
+    EXPECT_FALSE(contains(nullptr));
+    EXPECT_FALSE(contains(reinterpret_cast<const void*>(uintptr_t(1))));
+}
+
+TEST_F(ObjectTableTest, DoesNotFindErasedObjects) {
+    for (auto& object : mObjects) {
+        mTable.insert(&object);
+    }
+    for (size_t i = 0; i < std::size(mObjects); i += 2) {
+        mTable.erase(&mObjects[i]);
+    }
+    for (size_t i = 0; i < std::size(mObjects); i++) {
+        EXPECT_EQ(i % 2 == 1, contains(&mObjects[i])) << i;
+    }
+    EXPECT_EQ(std::size(mObjects) / 2, mTable.size());
+}
+
+TEST_F(ObjectTableTest, ReusesTheSlotsOfErasedObjects) {
+    // Far more insertions than slots, which takes rehashing away the
+    // tombstones of the erased objects.
+    for (int round = 0; round < 100; round++) {
+        for (auto& object : mObjects) {
+            mTable.insert(&object);
+        }
+        for (auto& object : mObjects) {
+            mTable.erase(&object);
+        }
+    }
+    EXPECT_EQ(size_t(0), mTable.size());
+    EXPECT_FALSE(contains(&mObjects[0]));
+}
+
+TEST_F(ObjectTableTest, ClearReturnsEveryObject) {
+    for (auto& object : mObjects) {
+        mTable.insert(&object);
+    }
+    std::vector<const void*> objects = mTable.clear();
+    EXPECT_EQ(std::size(mObjects), objects.size());
+    for (auto& object : mObjects) {
+        EXPECT_NE(objects.end(), std::find(objects.begin(), objects.end(), &object));
+        EXPECT_FALSE(contains(&object));
+    }
+    EXPECT_EQ(size_t(0), mTable.size());
+}
+
+// An object must not be seen as alive by a lookup once erase() returned.
+TEST_F(ObjectTableTest, EraseWaitsForLookups) {
+    std::atomic<bool> alive[std::size(mObjects)];
+    for (size_t i = 0; i < std::size(mObjects); i++) {
+        alive[i] = true;
+        mTable.insert(&mObjects[i]);
+    }
+
+    std::atomic<bool> done = false;
+    std::atomic<int> deadFound = 0;
+    std::vector<std::thread> readers;
+    for (int r = 0; r < 4; r++) {
+        readers.emplace_back([&] {
+            while (!done) {
+                for (size_t i = 0; i < std::size(mObjects); i++) {
+                    mTable.find(&mObjects[i], [&] {
+                        std::this_thread::yield();
+                        if (!alive[i]) {
+                            deadFound++;
+                        }
+                    });
+                }
+            }
+        });
+    }
+
+    for (int round = 0; round < 20; round++) {
+        for (size_t i = 0; i < std::size(mObjects); i++) {
+            mTable.erase(&mObjects[i]);
+            alive[i] = false;
+        }
+        for (size_t i = 0; i < std::size(mObjects); i++) {
+            alive[i] = true;
+            mTable.insert(&mObjects[i]);
+        }
+    }
+    done = true;
+    for (auto& reader : readers) {
+        reader.join();
+    }
+    EXPECT_EQ(0, deadFound);
+}
+
+} // namespace android
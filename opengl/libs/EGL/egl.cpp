@@ -21,8 +21,10 @@
 #include <EGL/egl.h>
 
 #include <cutils/properties.h>
+#include <graphicsenv/GraphicsEnv.h>
 
 #include <log/log.h>
+#include <utils/Timers.h>
 
 #include "../egl_impl.h"
 
@@ -196,7 +198,11 @@ static EGLBoolean egl_init_drivers_locked() {
         // Layers can be enabled long after the drivers have been loaded.
         // They will only be initialized once.
         LayerLoader& layer_loader(LayerLoader::getInstance());
+        const nsecs_t layerTime = systemTime();
         layer_loader.InitLayers(cnx);
+        android::GraphicsEnv::getInstance().setDriverLoadingPhaseTime(
+                android::GraphicsEnv::Api::API_GL, android::GraphicsEnv::LAYER_SETUP,
+                systemTime() - layerTime);
     }
 
     return cnx->dso ? EGL_TRUE : EGL_FALSE;
@@ -22,6 +22,8 @@
 
 #include <private/EGL/cache.h>
 
+#include <cutils/properties.h>
+#include <sys/stat.h>
 #include <unistd.h>
 
 #include <thread>
@@ -36,6 +38,9 @@ static const size_t maxTotalSize = 2 * 1024 * 1024;
 // The time in seconds to wait before saving newly inserted cache entries.
 static const unsigned int deferredSaveDelay = 4;
 
+// The property naming the cache file shared by all processes.
+static const char* sharedCacheFileProperty = "ro.egl.shared_blob_cache";
+
 // ----------------------------------------------------------------------------
 namespace android {
 // ----------------------------------------------------------------------------
@@ -47,6 +52,10 @@ void egl_set_cache_filename(const char* filename) {
     egl_cache_t::get()->setCacheFilename(filename);
 }
 
+void egl_set_cache_file_shared(bool shared) {
+    egl_cache_t::get()->setCacheFileShared(shared);
+}
+
 //
 // Callback functions passed to EGL.
 //
@@ -64,7 +73,9 @@ static EGLsizeiANDROID getBlob(const void* key, EGLsizeiANDROID keySize,
 // egl_cache_t definition
 //
 egl_cache_t::egl_cache_t() :
-        mInitialized(false) {
+        mInitialized(false),
+        mSharedBlobCacheLoaded(false),
+        mFileShared(false) {
 }
 
 egl_cache_t::~egl_cache_t() {
@@ -120,6 +131,8 @@ void egl_cache_t::terminate() {
         mBlobCache->writeToFile();
     }
     mBlobCache = nullptr;
+    mSharedBlobCache = nullptr;
+    mSharedBlobCacheLoaded = false;
 }
 
 void egl_cache_t::setBlob(const void* key, EGLsizeiANDROID keySize,
@@ -160,6 +173,14 @@ EGLsizeiANDROID egl_cache_t::getBlob(const void* key, EGLsizeiANDROID keySize,
     }
 
     if (mInitialized) {
+        BlobCache* sharedBc = getSharedBlobCacheLocked();
+        if (sharedBc) {
+            EGLsizeiANDROID size = sharedBc->get(key, keySize, value, valueSize);
+            if (size > 0) {
+                return size;
+            }
+        }
+
         BlobCache* bc = getBlobCacheLocked();
         return bc->get(key, keySize, value, valueSize);
     }
@@ -171,13 +192,36 @@ void egl_cache_t::setCacheFilename(const char* filename) {
     mFilename = filename;
 }
 
+void egl_cache_t::setCacheFileShared(bool shared) {
+    std::lock_guard<std::mutex> lock(mMutex);
+    mFileShared = shared;
+}
+
 BlobCache* egl_cache_t::getBlobCacheLocked() {
     if (mBlobCache == nullptr) {
-        mBlobCache.reset(new FileBlobCache(maxKeySize, maxValueSize, maxTotalSize, mFilename));
+        const mode_t fileMode = mFileShared ? S_IRUSR | S_IWUSR | S_IRGRP | S_IROTH
+                                            : S_IRUSR | S_IWUSR;
+        mBlobCache.reset(new FileBlobCache(maxKeySize, maxValueSize, maxTotalSize, mFilename,
+                fileMode));
     }
     return mBlobCache.get();
 }
 
+BlobCache* egl_cache_t::getSharedBlobCacheLocked() {
+    if (!mSharedBlobCacheLoaded) {
+        mSharedBlobCacheLoaded = true;
+
+        // The process that populates the shared cache reads it as its own.
+        char filename[PROPERTY_VALUE_MAX];
+        if (property_get(sharedCacheFileProperty, filename, "") > 0 && mFilename != filename &&
+                access(filename, R_OK) == 0) {
+            mSharedBlobCache.reset(new FileBlobCache(maxKeySize, maxValueSize, maxTotalSize,
+                    filename));
+        }
+    }
+    return mSharedBlobCache.get();
+}
+
 // ----------------------------------------------------------------------------
 }; // namespace android
 // ----------------------------------------------------------------------------
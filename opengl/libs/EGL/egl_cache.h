@@ -67,6 +67,10 @@ public:
     // cache contents from one program invocation to another.
     void setCacheFilename(const char* filename);
 
+    // setCacheFileShared sets whether the cache file is made readable by all
+    // processes, so it can serve as the shared cache of other processes.
+    void setCacheFileShared(bool shared);
+
 private:
     // Creation and (the lack of) destruction is handled internally.
     egl_cache_t();
@@ -82,6 +86,10 @@ private:
     // possible.
     BlobCache* getBlobCacheLocked();
 
+    // getSharedBlobCacheLocked returns the read-only BlobCache shared by all
+    // processes, loading it on first use, or NULL if there is none.
+    BlobCache* getSharedBlobCacheLocked();
+
     // mInitialized indicates whether the egl_cache_t is in the initialized
     // state.  It is initialized to false at construction time, and gets set to
     // true when initialize is called.  It is set back to false when terminate
@@ -95,6 +103,13 @@ private:
     // first time it's needed.
     std::unique_ptr<FileBlobCache> mBlobCache;
 
+    // mSharedBlobCache is the cache file prepopulated by the system which is
+    // named by the ro.egl.shared_blob_cache property.  It is consulted before
+    // mBlobCache and never written to.  mSharedBlobCacheLoaded indicates
+    // whether loading it has been attempted.
+    std::unique_ptr<FileBlobCache> mSharedBlobCache;
+    bool mSharedBlobCacheLoaded;
+
     // mFilename is the name of the file for storing cache contents in between
     // program invocations.  It is initialized to an empty string at
     // construction time, and can be set with the setCacheFilename method.  An
@@ -102,6 +117,10 @@ private:
     // from disk.
     std::string mFilename;
 
+    // mFileShared indicates whether the cache file is made readable by all
+    // processes.  It is set with the setCacheFileShared method.
+    bool mFileShared;
+
     // mSavePending indicates whether or not a deferred save operation is
     // pending.  Each time a key/value pair is inserted into the cache via
     // setBlob, a deferred save is initiated if one is not already pending.
@@ -105,24 +105,25 @@ egl_display_t* egl_display_t::get(EGLDisplay dpy) {
 }
 
 void egl_display_t::addObject(egl_object_t* object) {
-    std::lock_guard<std::mutex> _l(lock);
     objects.insert(object);
 }
 
 void egl_display_t::removeObject(egl_object_t* object) {
-    std::lock_guard<std::mutex> _l(lock);
     objects.erase(object);
 }
 
 bool egl_display_t::getObject(egl_object_t* object) const {
-    std::lock_guard<std::mutex> _l(lock);
-    if (objects.find(object) != objects.end()) {
+    // The object can't be deleted while find() runs the lambda: it is only
+    // deleted once its last reference is gone, and the table holds one until
+    // removeObject() returns.
+    bool valid = false;
+    objects.find(object, [&] {
         if (object->getDisplay() == this) {
             object->incRef();
-            return true;
+            valid = true;
         }
-    }
-    return false;
+    });
+    return valid;
 }
 
 EGLDisplay egl_display_t::getFromNativeDisplay(EGLNativeDisplayType disp,
@@ -483,14 +484,13 @@ EGLBoolean egl_display_t::terminate() {
         // Mark all objects remaining in the list as terminated, unless
         // there are no reference to them, it which case, we're free to
         // delete them.
-        size_t count = objects.size();
-        ALOGW_IF(count, "eglTerminate() called w/ %zu objects remaining", count);
-        for (auto o : objects) {
-            o->destroy();
+        // Clearing the list marks all object handles as "terminated".
+        std::vector<const void*> remaining = objects.clear();
+        ALOGW_IF(!remaining.empty(), "eglTerminate() called w/ %zu objects remaining",
+                 remaining.size());
+        for (auto o : remaining) {
+            static_cast<egl_object_t*>(const_cast<void*>(o))->destroy();
         }
-
-        // this marks all object handles are "terminated"
-        objects.clear();
     }
 
     { // scope for refLock
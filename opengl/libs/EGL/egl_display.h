@@ -24,13 +24,13 @@
 #include <condition_variable>
 #include <mutex>
 #include <string>
-#include <unordered_set>
 
 #include <EGL/egl.h>
 #include <EGL/eglext.h>
 
 #include <cutils/compiler.h>
 
+#include "ObjectTable.h"
 #include "egldefs.h"
 #include "../hooks.h"
 
@@ -125,7 +125,7 @@ private:
     mutable std::mutex                  lock;
     mutable std::mutex                  refLock;
     mutable std::condition_variable     refCond;
-            std::unordered_set<egl_object_t*> objects;
+            ObjectTable                 objects;
             std::string mVendorString;
             std::string mVersionString;
             std::string mClientApiString;
@@ -25,6 +25,8 @@
 #include <graphicsenv/GraphicsEnv.h>
 #include <log/log.h>
 #include <nativebridge/native_bridge.h>
+
+#include "Loader.h"
 #include <nativeloader/native_loader.h>
 #include <sys/prctl.h>
 
@@ -78,7 +80,8 @@ const void* getNextLayerProcAddress(void* layer_id, const char* name) {
 
     ALOGV("getNextLayerProcAddress servicing %s", name);
 
-    if (func_indices.find(name) == func_indices.end()) {
+    auto search = func_indices.find(name);
+    if (search == func_indices.end()) {
         // No entry for this function - it is an extension
         // call down the GPA chain directly to the impl
         ALOGV("getNextLayerProcAddress - name(%s) no func_indices entry found", name);
@@ -103,7 +106,7 @@ const void* getNextLayerProcAddress(void* layer_id, const char* name) {
         return reinterpret_cast<void*>(val);
     }
 
-    int index = func_indices[name];
+    int index = search->second;
     val = (*next_layer_funcs)[index];
     ALOGV("getNextLayerProcAddress - name(%s) index(%i) entry(%llu) - Got a hit, returning known entry", name, index, (unsigned long long)val);
     return reinterpret_cast<void*>(val);
@@ -116,10 +119,9 @@ void SetupFuncMaps(FunctionTable& functions, char const* const* entries, EGLFunc
 
         // Some names overlap, only fill with initial entry
         // This does mean that some indices will not be used
-        if (func_indices.find(name) == func_indices.end()) {
+        if (func_indices.emplace(name, func_idx).second) {
             ALOGV("SetupFuncMaps - name(%s), func_idx(%i), No entry for func_indices, assigning now", name, func_idx);
             func_names[func_idx] = name;
-            func_indices[name] = func_idx;
         } else {
             ALOGV("SetupFuncMaps - name(%s), func_idx(%i), Found entry for func_indices", name, func_idx);
         }
@@ -202,8 +204,9 @@ EGLFuncPointer LayerLoader::ApplyLayers(const char* name, EGLFuncPointer next) {
     return val;
 }
 
-void LayerLoader::LayerPlatformEntries(layer_setup_func layer_setup, EGLFuncPointer* curr,
-                                       char const* const* entries) {
+size_t LayerLoader::LayerPlatformEntries(layer_setup_func layer_setup, EGLFuncPointer* curr,
+                                         char const* const* entries) {
+    size_t replaced = 0;
     while (*entries) {
         char const* name = *entries;
 
@@ -215,6 +218,7 @@ void LayerLoader::LayerPlatformEntries(layer_setup_func layer_setup, EGLFuncPoin
         if (prev != *curr) {
             ALOGV("LayerPlatformEntries: Replaced (%llu) with platform entry (%llu), for %s",
                   (unsigned long long)prev, (unsigned long long)*curr, name);
+            replaced++;
         } else {
             ALOGV("LayerPlatformEntries: No change(%llu) for %s, which means layer did not "
                   "intercept",
@@ -224,31 +228,42 @@ void LayerLoader::LayerPlatformEntries(layer_setup_func layer_setup, EGLFuncPoin
         curr++;
         entries++;
     }
+    return replaced;
 }
 
-void LayerLoader::LayerDriverEntries(layer_setup_func layer_setup, EGLFuncPointer* curr,
-                                     char const* const* entries) {
+std::vector<bool> LayerLoader::FindPlatformEntries(char const* const* entries) {
+    std::vector<bool> platform_entries;
     while (*entries) {
-        char const* name = *entries;
-        EGLFuncPointer prev = *curr;
+        platform_entries.push_back(FindPlatformImplAddr(*entries) != nullptr);
+        entries++;
+    }
+    return platform_entries;
+}
+
+size_t LayerLoader::LayerDriverEntries(layer_setup_func layer_setup, EGLFuncPointer* curr,
+                                       char const* const* entries,
+                                       const std::vector<bool>& platform_entries) {
+    size_t replaced = 0;
+    for (size_t i = 0; entries[i]; i++) {
+        char const* name = entries[i];
+        EGLFuncPointer prev = curr[i];
 
         // Only apply layers to driver entries if not handled by the platform
-        if (FindPlatformImplAddr(name) == nullptr) {
+        if (!platform_entries[i]) {
             // Pass the existing entry point into the layer, replace the call with return value
-            *curr = ApplyLayer(layer_setup, name, *prev);
+            curr[i] = ApplyLayer(layer_setup, name, prev);
 
-            if (prev != *curr) {
+            if (prev != curr[i]) {
                 ALOGV("LayerDriverEntries: Replaced (%llu) with platform entry (%llu), for %s",
-                      (unsigned long long)prev, (unsigned long long)*curr, name);
+                      (unsigned long long)prev, (unsigned long long)curr[i], name);
+                replaced++;
             }
 
         } else {
             ALOGV("LayerDriverEntries: Skipped (%llu) for %s", (unsigned long long)prev, name);
         }
-
-        curr++;
-        entries++;
     }
+    return replaced;
 }
 
 bool LayerLoader::Initialized() {
@@ -268,6 +283,10 @@ void LayerLoader::InitLayers(egl_connection_t* cnx) {
     // Include the driver in layer_functions
     layer_functions.resize(layer_setup_.size() + 1);
 
+    // Layers keep the driver entry points they are given, so they must not be
+    // given the stubs that resolve them lazily.
+    Loader::resolve_lazy_apis();
+
     // Walk through the initial lists and create layer_functions[0]
     int func_idx = 0;
     char const* const* entries;
@@ -288,8 +307,18 @@ void LayerLoader::InitLayers(egl_connection_t* cnx) {
     SetupFuncMaps(layer_functions[0], entries, curr, func_idx);
     ALOGV("InitLayers: func_idx after gl_names: %i", func_idx);
 
-    // Walk through each layer's entry points per API, starting just above the driver
+    // Which driver entry points are handled by the platform does not change from
+    // one layer to the next, so only look it up once
+    const std::vector<bool> egl_platform_entries = FindPlatformEntries(egl_names);
+    const std::vector<bool> gl_platform_entries = FindPlatformEntries(gl_names);
+
+    // Walk through each layer's entry points per API, starting just above the driver.
+    // A layer only replaces the entry points it intercepts, and each layer is handed
+    // the table left by the layers below it, so calls skip the layers that do not
+    // intercept them.
     for (current_layer_ = 0; current_layer_ < layer_setup_.size(); current_layer_++) {
+        size_t intercepted = 0;
+
         // Init the layer with a key that points to layer just below it
         layer_init_[current_layer_](reinterpret_cast<void*>(&layer_functions[current_layer_]),
                                     reinterpret_cast<PFNEGLGETNEXTLAYERPROCADDRESSPROC>(
@@ -299,7 +328,7 @@ void LayerLoader::InitLayers(egl_connection_t* cnx) {
         func_idx = 0;
         entries = platform_names;
         curr = reinterpret_cast<EGLFuncPointer*>(&cnx->platform);
-        LayerPlatformEntries(layer_setup_[current_layer_], curr, entries);
+        intercepted += LayerPlatformEntries(layer_setup_[current_layer_], curr, entries);
 
         // Populate next function table after layers have been applied
         SetupFuncMaps(layer_functions[current_layer_ + 1], entries, curr, func_idx);
@@ -307,7 +336,8 @@ void LayerLoader::InitLayers(egl_connection_t* cnx) {
         // EGL
         entries = egl_names;
         curr = reinterpret_cast<EGLFuncPointer*>(&cnx->egl);
-        LayerDriverEntries(layer_setup_[current_layer_], curr, entries);
+        intercepted += LayerDriverEntries(layer_setup_[current_layer_], curr, entries,
+                                          egl_platform_entries);
 
         // Populate next function table after layers have been applied
         SetupFuncMaps(layer_functions[current_layer_ + 1], entries, curr, func_idx);
@@ -319,10 +349,13 @@ void LayerLoader::InitLayers(egl_connection_t* cnx) {
         // initialization.
         entries = gl_names;
         curr = reinterpret_cast<EGLFuncPointer*>(&cnx->hooks[egl_connection_t::GLESv2_INDEX]->gl);
-        LayerDriverEntries(layer_setup_[current_layer_], curr, entries);
+        intercepted += LayerDriverEntries(layer_setup_[current_layer_], curr, entries,
+                                          gl_platform_entries);
 
         // Populate next function table after layers have been applied
         SetupFuncMaps(layer_functions[current_layer_ + 1], entries, curr, func_idx);
+
+        ALOGI("GLES layer %u intercepts %zu entry points", current_layer_, intercepted);
     }
 
     // We only want to apply layers once
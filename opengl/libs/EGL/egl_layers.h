@@ -41,8 +41,12 @@ public:
 
     void LoadLayers();
     void InitLayers(egl_connection_t*);
-    void LayerPlatformEntries(layer_setup_func layer_setup, EGLFuncPointer*, char const* const*);
-    void LayerDriverEntries(layer_setup_func layer_setup, EGLFuncPointer*, char const* const*);
+    // LayerPlatformEntries and LayerDriverEntries return the number of entries the layer
+    // replaced.
+    size_t LayerPlatformEntries(layer_setup_func layer_setup, EGLFuncPointer*, char const* const*);
+    size_t LayerDriverEntries(layer_setup_func layer_setup, EGLFuncPointer*, char const* const*,
+                              const std::vector<bool>& platform_entries);
+    std::vector<bool> FindPlatformEntries(char const* const* entries);
     bool Initialized();
     std::string GetDebugLayers();
 
@@ -65,7 +65,8 @@ egl_surface_t::egl_surface_t(egl_display_t* dpy, EGLConfig config, EGLNativeWind
         connected(true),
         colorSpace(colorSpace),
         egl_smpte2086_dirty(false),
-        egl_cta861_3_dirty(false) {
+        egl_cta861_3_dirty(false),
+        fastDispatch(nullptr) {
     egl_smpte2086_metadata.displayPrimaryRed = { EGL_DONT_CARE, EGL_DONT_CARE };
     egl_smpte2086_metadata.displayPrimaryGreen = { EGL_DONT_CARE, EGL_DONT_CARE };
     egl_smpte2086_metadata.displayPrimaryBlue = { EGL_DONT_CARE, EGL_DONT_CARE };
@@ -77,6 +78,7 @@ egl_surface_t::egl_surface_t(egl_display_t* dpy, EGLConfig config, EGLNativeWind
 
     if (win) {
         win->incStrong(this);
+        native_window_get_fast_dispatch(win, &fastDispatch);
     }
 }
 
@@ -136,6 +136,8 @@ public:
 
     ANativeWindow* getNativeWindow() { return win; }
     ANativeWindow* getNativeWindow() const { return win; }
+    // Typed entry points of the window for the setters called on every frame, or null.
+    const ANativeWindowFastDispatch* getFastDispatch() const { return fastDispatch; }
     EGLint getColorSpace() const { return colorSpace; }
     EGLBoolean setSmpte2086Attribute(EGLint attribute, EGLint value);
     EGLBoolean setCta8613Attribute(EGLint attribute, EGLint value);
@@ -184,6 +186,8 @@ private:
 
     egl_smpte2086_metadata egl_smpte2086_metadata;
     egl_cta861_3_metadata egl_cta861_3_metadata;
+
+    const ANativeWindowFastDispatch* fastDispatch;
 };
 
 class egl_context_t: public egl_object_t {
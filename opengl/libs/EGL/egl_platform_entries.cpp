@@ -37,6 +37,7 @@
 #include <cutils/compiler.h>
 #include <cutils/properties.h>
 #include <log/log.h>
+#include <utils/Timers.h>
 
 #include <condition_variable>
 #include <deque>
@@ -972,9 +973,15 @@ EGLContext eglCreateContextImpl(EGLDisplay dpy, EGLConfig config,
                 }
             };
         }
+        const nsecs_t createTime = systemTime();
         EGLContext context = cnx->egl.eglCreateContext(
                 dp->disp.dpy, config, share_list, attrib_list);
         if (context != EGL_NO_CONTEXT) {
+            // Only the first context of the process is recorded.
+            android::GraphicsEnv::getInstance().setDriverLoadingPhaseTime(
+                    android::GraphicsEnv::Api::API_GL, android::GraphicsEnv::FIRST_CONTEXT,
+                    systemTime() - createTime);
+
             // figure out if it's a GLESv1 or GLESv2
             int version = 0;
             if (attrib_list) {
@@ -1443,8 +1450,14 @@ EGLBoolean eglSwapBuffersWithDamageKHRImpl(EGLDisplay dpy, EGLSurface draw,
         androidRects.push_back(androidRect);
     }
     if (s->cnx->angleBackend != EGL_PLATFORM_ANGLE_TYPE_VULKAN_ANGLE) {
-        native_window_set_surface_damage(s->getNativeWindow(), androidRects.data(),
-                                         androidRects.size());
+        const ANativeWindowFastDispatch* dispatch = s->getFastDispatch();
+        if (NATIVE_WINDOW_FAST_DISPATCH_HAS(dispatch, setSurfaceDamage)) {
+            dispatch->setSurfaceDamage(s->getNativeWindow(), androidRects.data(),
+                                       androidRects.size());
+        } else {
+            native_window_set_surface_damage(s->getNativeWindow(), androidRects.data(),
+                                             androidRects.size());
+        }
     }
 
     if (s->cnx->egl.eglSwapBuffersWithDamageKHR) {
@@ -2245,7 +2258,12 @@ EGLBoolean eglPresentationTimeANDROIDImpl(EGLDisplay dpy, EGLSurface surface,
     }
 
     egl_surface_t const * const s = get_surface(surface);
-    native_window_set_buffers_timestamp(s->getNativeWindow(), time);
+    const ANativeWindowFastDispatch* dispatch = s->getFastDispatch();
+    if (NATIVE_WINDOW_FAST_DISPATCH_HAS(dispatch, setBuffersTimestamp)) {
+        dispatch->setBuffersTimestamp(s->getNativeWindow(), time);
+    } else {
+        native_window_set_buffers_timestamp(s->getNativeWindow(), time);
+    }
 
     return EGL_TRUE;
 }
@@ -22,4 +22,12 @@ namespace android {
 
 ANDROID_API void egl_set_cache_filename(const char* filename);
 
+// egl_set_cache_file_shared makes the cache file of this process readable by
+// all processes.  A system service can use this to prepopulate the shared
+// cache named by the ro.egl.shared_blob_cache property, which every process
+// consults before its own cache: it points its own cache file at that path and
+// renders the content whose shaders should be shared.  It must be called
+// before the cache is first used.
+ANDROID_API void egl_set_cache_file_shared(bool shared);
+
 } // namespace android
@@ -0,0 +1,142 @@
+/*
+ * Copyright (C) 2019 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <fstream>
+#include <sstream>
+#include <string>
+
+#include <bufferhub/BufferHubBufferPool.h>
+#include <log/log.h>
+#include <ui/GraphicBufferAllocator.h>
+
+namespace android {
+namespace frameworks {
+namespace bufferhub {
+namespace V1_0 {
+namespace implementation {
+
+namespace {
+
+bool isSameBuffer(const AHardwareBuffer_Desc& a, const AHardwareBuffer_Desc& b) {
+    return a.width == b.width && a.height == b.height && a.layers == b.layers &&
+            a.format == b.format && a.usage == b.usage;
+}
+
+} // namespace
+
+BufferHubBufferPool::Owner BufferHubBufferPool::ownerOf(pid_t pid) {
+    Owner owner;
+    std::ifstream file("/proc/" + std::to_string(pid) + "/stat");
+    std::string line;
+    if (!std::getline(file, line)) {
+        ALOGW("%s: Failed to read the stat of pid %d", __FUNCTION__, pid);
+        return owner;
+    }
+    // The command name may contain spaces and parentheses, so count the fields from its end.
+    // starttime is the 20th field after it.
+    const size_t commEnd = line.rfind(')');
+    if (commEnd == std::string::npos) {
+        return owner;
+    }
+    std::istringstream fields(line.substr(commEnd + 1));
+    std::string field;
+    for (int i = 0; i < 19; ++i) {
+        fields >> field;
+    }
+    uint64_t startTime = 0;
+    if (fields >> startTime) {
+        owner.pid = pid;
+        owner.startTime = startTime;
+    }
+    return owner;
+}
+
+BufferHubBufferPool& BufferHubBufferPool::getInstance() {
+    static BufferHubBufferPool pool;
+
+    return pool;
+}
+
+native_handle_t* BufferHubBufferPool::take(const AHardwareBuffer_Desc& desc, const Owner& owner,
+                                           uint32_t* outStride) {
+    native_handle_t* handle = nullptr;
+    std::deque<Entry> freed;
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        pruneLocked(std::chrono::steady_clock::now(), &freed);
+        // Most recently released first, it is the likeliest to still be cached.
+        for (auto iter = mEntries.rbegin(); iter != mEntries.rend(); ++iter) {
+            if (iter->owner == owner && isSameBuffer(iter->desc, desc)) {
+                handle = iter->handle;
+                *outStride = iter->desc.stride;
+                mEntries.erase(std::next(iter).base());
+                break;
+            }
+        }
+    }
+    freeEntries(freed);
+    return handle;
+}
+
+void BufferHubBufferPool::put(const AHardwareBuffer_Desc& desc, const Owner& owner,
+                              native_handle_t* handle) {
+    const auto now = std::chrono::steady_clock::now();
+    std::deque<Entry> freed;
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        mEntries.push_back({desc, owner, handle, now});
+        pruneLocked(now, &freed);
+    }
+    freeEntries(freed);
+}
+
+void BufferHubBufferPool::clear() {
+    std::deque<Entry> freed;
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        freed.swap(mEntries);
+    }
+    freeEntries(freed);
+}
+
+size_t BufferHubBufferPool::size() {
+    std::lock_guard<std::mutex> lock(mMutex);
+    return mEntries.size();
+}
+
+void BufferHubBufferPool::pruneLocked(std::chrono::steady_clock::time_point now,
+                                      std::deque<Entry>* outFreed) {
+    while (!mEntries.empty() &&
+           (mEntries.size() > kMaxBuffers || now - mEntries.front().releaseTime > kMaxAge)) {
+        outFreed->push_back(mEntries.front());
+        mEntries.pop_front();
+    }
+}
+
+void BufferHubBufferPool::freeEntries(const std::deque<Entry>& entries) {
+    for (const Entry& entry : entries) {
+        status_t ret = GraphicBufferAllocator::get().free(entry.handle);
+        if (ret != OK) {
+            ALOGE("%s: Failed to free handle; Got error: %d", __FUNCTION__, ret);
+        }
+    }
+}
+
+} // namespace implementation
+} // namespace V1_0
+} // namespace bufferhub
+} // namespace frameworks
+} // namespace android
@@ -20,8 +20,10 @@
 #include <sstream>
 
 #include <android/hardware_buffer.h>
+#include <bufferhub/BufferHubBufferPool.h>
 #include <bufferhub/BufferHubService.h>
 #include <cutils/native_handle.h>
+#include <hwbinder/IPCThreadState.h>
 #include <log/log.h>
 #include <openssl/hmac.h>
 #include <system/graphics-base.h>
@@ -52,7 +54,8 @@ Return<void> BufferHubService::allocateBuffer(const HardwareBufferDescription& d
     std::shared_ptr<BufferNode> node =
             std::make_shared<BufferNode>(desc.width, desc.height, desc.layers, desc.format,
                                          desc.usage, userMetadataSize,
-                                         BufferHubIdGenerator::getInstance().getId());
+                                         BufferHubIdGenerator::getInstance().getId(),
+                                         hardware::IPCThreadState::self()->getCallingPid());
     if (node == nullptr || !node->isValid()) {
         ALOGE("%s: creating BufferNode failed.", __FUNCTION__);
         _hidl_cb(/*status=*/BufferHubStatus::ALLOCATION_FAILED, /*bufferClient=*/nullptr,
@@ -147,6 +150,9 @@ Return<void> BufferHubService::importBuffer(const hidl_handle& tokenHandle,
     }
 
     sp<BufferClient> client = new BufferClient(*originClient);
+    if (hardware::IPCThreadState::self()->getCallingPid() != client->getBufferNode()->ownerPid()) {
+        client->getBufferNode()->markShared();
+    }
     uint32_t clientStateMask = client->getBufferNode()->addNewActiveClientsBitToMask();
     if (clientStateMask == 0U) {
         // Reach max client count
@@ -293,6 +299,8 @@ Return<void> BufferHubService::debug(const hidl_handle& fd, const hidl_vec<hidl_
         }
     }
 
+    stream << "Pooled Buffers: " << BufferHubBufferPool::getInstance().size() << "\n\n";
+
     stream << "Unused Tokens:\n";
     stream << std::right;
     stream << std::setw(8) << "Buffer Id";
@@ -1,5 +1,6 @@
 #include <errno.h>
 
+#include <bufferhub/BufferHubBufferPool.h>
 #include <bufferhub/BufferHubService.h>
 #include <bufferhub/BufferNode.h>
 #include <log/log.h>
@@ -29,29 +30,37 @@ void BufferNode::initializeMetadata() {
 
 // Allocates a new BufferNode.
 BufferNode::BufferNode(uint32_t width, uint32_t height, uint32_t layerCount, uint32_t format,
-                       uint64_t usage, size_t userMetadataSize, int id)
-      : mId(id) {
-    uint32_t outStride = 0;
-    // graphicBufferId is not used in GraphicBufferAllocator::allocate
-    // TODO(b/112338294) After move to the service folder, stop using the
-    // hardcoded service name "bufferhub".
-    int ret = GraphicBufferAllocator::get().allocate(width, height, format, layerCount, usage,
-                                                     const_cast<const native_handle_t**>(
-                                                             &mBufferHandle),
-                                                     &outStride,
-                                                     /*graphicBufferId=*/0,
-                                                     /*requestor=*/"bufferhub");
-
-    if (ret != OK || mBufferHandle == nullptr) {
-        ALOGE("%s: Failed to allocate buffer: %s", __FUNCTION__, strerror(-ret));
-        return;
-    }
-
+                       uint64_t usage, size_t userMetadataSize, int id, pid_t ownerPid)
+      : mId(id),
+        mOwner(ownerPid >= 0 ? BufferHubBufferPool::ownerOf(ownerPid)
+                             : BufferHubBufferPool::Owner()) {
     mBufferDesc.width = width;
     mBufferDesc.height = height;
     mBufferDesc.layers = layerCount;
     mBufferDesc.format = format;
     mBufferDesc.usage = usage;
+
+    uint32_t outStride = 0;
+    mBufferHandle = mOwner.isValid()
+            ? BufferHubBufferPool::getInstance().take(mBufferDesc, mOwner, &outStride)
+            : nullptr;
+    if (mBufferHandle == nullptr) {
+        // graphicBufferId is not used in GraphicBufferAllocator::allocate
+        // TODO(b/112338294) After move to the service folder, stop using the
+        // hardcoded service name "bufferhub".
+        int ret = GraphicBufferAllocator::get().allocate(width, height, format, layerCount, usage,
+                                                         const_cast<const native_handle_t**>(
+                                                                 &mBufferHandle),
+                                                         &outStride,
+                                                         /*graphicBufferId=*/0,
+                                                         /*requestor=*/"bufferhub");
+
+        if (ret != OK || mBufferHandle == nullptr) {
+            ALOGE("%s: Failed to allocate buffer: %s", __FUNCTION__, strerror(-ret));
+            mBufferHandle = nullptr;
+            return;
+        }
+    }
     mBufferDesc.stride = outStride;
 
     mMetadata = BufferHubMetadata::create(userMetadataSize);
@@ -63,8 +72,11 @@ BufferNode::BufferNode(uint32_t width, uint32_t height, uint32_t layerCount, uin
 }
 
 BufferNode::~BufferNode() {
-    // Free the handle
-    if (mBufferHandle != nullptr) {
+    // Free the handle, or keep it for the owner to reuse. A buffer shared with other processes
+    // may still be mapped there, so it never goes to another allocation.
+    if (mBufferHandle != nullptr && mOwner.isValid() && !mShared.load(std::memory_order_relaxed)) {
+        BufferHubBufferPool::getInstance().put(mBufferDesc, mOwner, mBufferHandle);
+    } else if (mBufferHandle != nullptr) {
         status_t ret = GraphicBufferAllocator::get().free(mBufferHandle);
         if (ret != OK) {
             ALOGE("%s: Failed to free handle; Got error: %d", __FUNCTION__, ret);
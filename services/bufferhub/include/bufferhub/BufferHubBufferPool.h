@@ -0,0 +1,107 @@
+/*
+ * Copyright (C) 2019 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef ANDROID_FRAMEWORKS_BUFFERHUB_V1_0_BUFFER_POOL_H
+#define ANDROID_FRAMEWORKS_BUFFERHUB_V1_0_BUFFER_POOL_H
+
+#include <sys/types.h>
+
+#include <chrono>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+
+#include <android/hardware_buffer.h>
+#include <cutils/native_handle.h>
+#include <utils/Mutex.h>
+
+namespace android {
+namespace frameworks {
+namespace bufferhub {
+namespace V1_0 {
+namespace implementation {
+
+// A thread-safe pool of the gralloc buffers of recently freed BufferNodes, so that a process
+// recreating buffers of the same description, e.g. on surface recreation, skips gralloc
+// allocation. A buffer is only handed back to the process it was allocated for, which may still
+// have it mapped. Buffers not reused within kMaxAge are freed, oldest first past kMaxBuffers.
+class BufferHubBufferPool {
+public:
+    static constexpr size_t kMaxBuffers = 8;
+    static constexpr std::chrono::milliseconds kMaxAge{2000};
+
+    // A process, told apart from a later one reusing its pid by when it started, so that the
+    // buffers of a process which died never go to another one.
+    struct Owner {
+        pid_t pid = -1;
+        // In clock ticks since boot, as in /proc/<pid>/stat. 0 if unknown.
+        uint64_t startTime = 0;
+
+        bool isValid() const { return pid >= 0 && startTime != 0; }
+        bool operator==(const Owner& other) const {
+            return pid == other.pid && startTime == other.startTime;
+        }
+    };
+
+    // Returns the owner for the live process pid. The owner is not valid if the process could
+    // not be looked up, and its buffers must not be pooled.
+    static Owner ownerOf(pid_t pid);
+
+    // Get the singleton instance of this class
+    static BufferHubBufferPool& getInstance();
+
+    // Takes a buffer of the given width, height, layers, format and usage, released by the owner
+    // process, out of the pool. Returns nullptr if there is none, otherwise sets outStride.
+    native_handle_t* take(const AHardwareBuffer_Desc& desc, const Owner& owner,
+                          uint32_t* outStride);
+
+    // Gives the buffer of a freed BufferNode to the pool, which takes ownership of the handle.
+    // The description must include the stride the buffer was allocated with.
+    void put(const AHardwareBuffer_Desc& desc, const Owner& owner, native_handle_t* handle);
+
+    // Frees all the buffers in the pool.
+    void clear();
+
+    size_t size();
+
+private:
+    struct Entry {
+        AHardwareBuffer_Desc desc;
+        Owner owner;
+        native_handle_t* handle;
+        std::chrono::steady_clock::time_point releaseTime;
+    };
+
+    BufferHubBufferPool() = default;
+    ~BufferHubBufferPool() = default;
+
+    // Moves the expired and excess entries to outFreed, to be freed without holding the lock.
+    void pruneLocked(std::chrono::steady_clock::time_point now, std::deque<Entry>* outFreed)
+            REQUIRES(mMutex);
+    static void freeEntries(const std::deque<Entry>& entries);
+
+    std::mutex mMutex;
+    // Oldest first
+    std::deque<Entry> mEntries GUARDED_BY(mMutex);
+};
+
+} // namespace implementation
+} // namespace V1_0
+} // namespace bufferhub
+} // namespace frameworks
+} // namespace android
+
+#endif // ANDROID_FRAMEWORKS_BUFFERHUB_V1_0_BUFFER_POOL_H
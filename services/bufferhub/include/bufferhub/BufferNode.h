@@ -1,7 +1,12 @@
 #ifndef ANDROID_FRAMEWORKS_BUFFERHUB_V1_0_BUFFER_NODE_H_
 #define ANDROID_FRAMEWORKS_BUFFERHUB_V1_0_BUFFER_NODE_H_
 
+#include <sys/types.h>
+
+#include <atomic>
+
 #include <android/hardware_buffer.h>
+#include <bufferhub/BufferHubBufferPool.h>
 #include <bufferhub/BufferHubIdGenerator.h>
 #include <cutils/native_handle.h>
 #include <ui/BufferHubEventFd.h>
@@ -15,9 +20,10 @@ namespace implementation {
 
 class BufferNode {
 public:
-    // Allocates a new BufferNode.
+    // Allocates a new BufferNode. With a non-negative ownerPid, the gralloc buffer may come from
+    // BufferHubBufferPool, and is returned there when the node is freed, unless it is shared.
     BufferNode(uint32_t width, uint32_t height, uint32_t layerCount, uint32_t format,
-               uint64_t usage, size_t userMetadataSize, int id = -1);
+               uint64_t usage, size_t userMetadataSize, int id = -1, pid_t ownerPid = -1);
 
     ~BufferNode();
 
@@ -35,6 +41,12 @@ public:
     // Accessor of event fd.
     const BufferHubEventFd& eventFd() const { return mEventFd; }
 
+    pid_t ownerPid() const { return mOwner.pid; }
+
+    // Marks the buffer as imported by a process other than its owner, after which it is never
+    // reused.
+    void markShared() { mShared.store(true, std::memory_order_relaxed); }
+
     // Accessors of mMetadata.
     const BufferHubMetadata& metadata() const { return mMetadata; }
 
@@ -75,6 +87,10 @@ private:
     // TODO(b/118891412): remove default id = -1 and update comments after pdx is no longer in use
     const int mId = -1;
 
+    // The process the buffer was allocated for. Not valid if the buffer is not to be pooled.
+    const BufferHubBufferPool::Owner mOwner;
+    std::atomic<bool> mShared{false};
+
     // The following variables are atomic variables in mMetadata that are visible
     // to Bn object and Bp objects. Please find more info in
     // BufferHubDefs::MetadataHeader.
@@ -1,5 +1,8 @@
 #include <errno.h>
+#include <sys/wait.h>
+#include <unistd.h>
 
+#include <bufferhub/BufferHubBufferPool.h>
 #include <bufferhub/BufferNode.h>
 #include <gmock/gmock.h>
 #include <gtest/gtest.h>
@@ -22,6 +25,9 @@ const uint32_t kLayerCount = 1;
 const uint32_t kFormat = 1;
 const uint64_t kUsage = 0;
 const size_t kUserMetadataSize = 0;
+// Pooling needs live processes, which can be told apart from later ones reusing their pid
+const pid_t kOwnerPid = getpid();
+const pid_t kOtherPid = getppid();
 
 class BufferNodeTest : public ::testing::Test {
 protected:
@@ -100,6 +106,101 @@ TEST_F(BufferNodeTest, TestRemoveActiveClientsBitFromMask) {
     EXPECT_EQ(mBufferNode->getActiveClientsBitMask(), currentMask);
 }
 
+class BufferNodePoolTest : public ::testing::Test {
+protected:
+    void SetUp() override { BufferHubBufferPool::getInstance().clear(); }
+    void TearDown() override { BufferHubBufferPool::getInstance().clear(); }
+};
+
+TEST_F(BufferNodePoolTest, TestBufferReusedByOwner) {
+    const native_handle_t* handle = nullptr;
+    uint32_t stride = 0U;
+    {
+        BufferNode node(kWidth, kHeight, kLayerCount, kFormat, kUsage, kUserMetadataSize,
+                        /*id=*/-1, kOwnerPid);
+        ASSERT_TRUE(node.isValid());
+        handle = node.bufferHandle();
+        stride = node.bufferDesc().stride;
+    }
+    EXPECT_EQ(BufferHubBufferPool::getInstance().size(), 1U);
+
+    // Another process, or another description, gets a buffer of its own.
+    BufferNode otherOwner(kWidth, kHeight, kLayerCount, kFormat, kUsage, kUserMetadataSize,
+                          /*id=*/-1, kOtherPid);
+    ASSERT_TRUE(otherOwner.isValid());
+    EXPECT_NE(otherOwner.bufferHandle(), handle);
+    BufferNode otherSize(kWidth, kHeight * 2, kLayerCount, kFormat, kUsage, kUserMetadataSize,
+                         /*id=*/-1, kOwnerPid);
+    ASSERT_TRUE(otherSize.isValid());
+    EXPECT_NE(otherSize.bufferHandle(), handle);
+
+    BufferNode reused(kWidth, kHeight, kLayerCount, kFormat, kUsage, kUserMetadataSize,
+                      /*id=*/-1, kOwnerPid);
+    ASSERT_TRUE(reused.isValid());
+    EXPECT_EQ(reused.bufferHandle(), handle);
+    EXPECT_EQ(reused.bufferDesc().stride, stride);
+    EXPECT_EQ(BufferHubBufferPool::getInstance().size(), 0U);
+}
+
+TEST_F(BufferNodePoolTest, TestSharedBufferNotPooled) {
+    {
+        BufferNode node(kWidth, kHeight, kLayerCount, kFormat, kUsage, kUserMetadataSize,
+                        /*id=*/-1, kOwnerPid);
+        ASSERT_TRUE(node.isValid());
+        node.markShared();
+    }
+    EXPECT_EQ(BufferHubBufferPool::getInstance().size(), 0U);
+}
+
+TEST_F(BufferNodePoolTest, TestPoolIsBounded) {
+    for (uint32_t i = 0; i < BufferHubBufferPool::kMaxBuffers + 2; ++i) {
+        BufferNode node(kWidth, kHeight + i, kLayerCount, kFormat, kUsage, kUserMetadataSize,
+                        /*id=*/-1, kOwnerPid);
+        ASSERT_TRUE(node.isValid());
+    }
+    EXPECT_EQ(BufferHubBufferPool::getInstance().size(), BufferHubBufferPool::kMaxBuffers);
+}
+
+TEST_F(BufferNodePoolTest, TestOwnerOfLiveAndDeadProcess) {
+    const BufferHubBufferPool::Owner self = BufferHubBufferPool::ownerOf(getpid());
+    EXPECT_TRUE(self.isValid());
+    EXPECT_EQ(self.pid, getpid());
+    EXPECT_TRUE(BufferHubBufferPool::ownerOf(getpid()) == self);
+
+    pid_t child = fork();
+    ASSERT_GE(child, 0);
+    if (child == 0) {
+        _exit(0);
+    }
+    ASSERT_EQ(waitpid(child, nullptr, 0), child);
+    EXPECT_FALSE(BufferHubBufferPool::ownerOf(child).isValid());
+}
+
+TEST_F(BufferNodePoolTest, TestBufferNotReusedAfterPidReuse) {
+    const native_handle_t* handle = nullptr;
+    AHardwareBuffer_Desc desc;
+    {
+        BufferNode node(kWidth, kHeight, kLayerCount, kFormat, kUsage, kUserMetadataSize,
+                        /*id=*/-1, kOwnerPid);
+        ASSERT_TRUE(node.isValid());
+        handle = node.bufferHandle();
+        desc = node.bufferDesc();
+    }
+    ASSERT_EQ(BufferHubBufferPool::getInstance().size(), 1U);
+
+    // A later process with the same pid started later, and gets nothing from the pool
+    BufferHubBufferPool::Owner later = BufferHubBufferPool::ownerOf(kOwnerPid);
+    ASSERT_TRUE(later.isValid());
+    later.startTime++;
+    uint32_t stride = 0U;
+    EXPECT_EQ(BufferHubBufferPool::getInstance().take(desc, later, &stride), nullptr);
+
+    BufferNode reused(kWidth, kHeight, kLayerCount, kFormat, kUsage, kUserMetadataSize,
+                      /*id=*/-1, kOwnerPid);
+    ASSERT_TRUE(reused.isValid());
+    EXPECT_EQ(reused.bufferHandle(), handle);
+}
+
 } // namespace
 
 } // namespace implementation
@@ -30,6 +30,7 @@
 
 #include <vkjson.h>
 
+#include "gpumem/GpuMem.h"
 #include "gpustats/GpuStats.h"
 
 namespace android {
@@ -40,13 +41,17 @@ namespace {
 status_t cmdHelp(int out);
 status_t cmdVkjson(int out, int err);
 void dumpGameDriverInfo(std::string* result);
+bool mayReportOtherUidsGpuMemory(uid_t uid);
 } // namespace
 
 const String16 sDump("android.permission.DUMP");
+const String16 sUpdateDeviceStats("android.permission.UPDATE_DEVICE_STATS");
 
 const char* const GpuService::SERVICE_NAME = "gpu";
 
-GpuService::GpuService() : mGpuStats(std::make_unique<GpuStats>()){};
+GpuService::GpuService()
+      : mGpuStats(std::make_unique<GpuStats>()),
+        mGpuMem(std::make_unique<GpuMem>(&mayReportOtherUidsGpuMemory)){};
 
 void GpuService::setGpuStats(const std::string& driverPackageName,
                              const std::string& driverVersionName, uint64_t driverVersionCode,
@@ -72,6 +77,26 @@ void GpuService::setTargetStats(const std::string& appPackageName, const uint64_
     mGpuStats->insertTargetStats(appPackageName, driverVersionCode, stats, value);
 }
 
+void GpuService::setDriverLoadingPhaseTime(const std::string& appPackageName,
+                                           const uint64_t driverVersionCode,
+                                           const GraphicsEnv::Api api,
+                                           const GraphicsEnv::LoadingPhase phase,
+                                           const int64_t loadingPhaseTime) {
+    mGpuStats->insertLoadingPhaseTime(appPackageName, driverVersionCode, api, phase,
+                                      loadingPhaseTime);
+}
+
+void GpuService::setGpuMemoryUsage(const int32_t pid, const GraphicsEnv::GpuMemory type,
+                                   const uint64_t bytes) {
+    const uid_t uid = IPCThreadState::self()->getCallingUid();
+    mGpuMem->insert(pid, uid, type, bytes);
+}
+
+status_t GpuService::getGpuMemoryInfo(std::vector<GpuMemoryInfo>* outInfo) const {
+    mGpuMem->pullMemoryInfo(outInfo);
+    return OK;
+}
+
 status_t GpuService::shellCommand(int /*in*/, int out, int err, std::vector<String16>& args) {
     ATRACE_CALL();
 
@@ -107,6 +132,10 @@ status_t GpuService::doDump(int fd, const Vector<String16>& args, bool /*asProto
                 index++;
                 mGpuStats->dump(args, &result);
                 dumpAll = false;
+            } else if ((index < numArgs) && (args[index] == String16("--gpumem"))) {
+                index++;
+                mGpuMem->dump(&result);
+                dumpAll = false;
             }
         }
 
@@ -116,6 +145,9 @@ status_t GpuService::doDump(int fd, const Vector<String16>& args, bool /*asProto
 
             mGpuStats->dump(Vector<String16>(), &result);
             result.append("\n");
+
+            mGpuMem->dump(&result);
+            result.append("\n");
         }
     }
 
@@ -168,6 +200,13 @@ void dumpGameDriverInfo(std::string* result) {
     StringAppendF(result, "Pre-release Game Driver: %s\n", preReleaseGameDriver);
 }
 
+// Called on the binder thread of the setGpuMemoryUsage() call being checked.
+bool mayReportOtherUidsGpuMemory(uid_t uid) {
+    if (uid == AID_ROOT || uid == AID_SYSTEM || uid == AID_GRAPHICS) return true;
+    const pid_t pid = IPCThreadState::self()->getCallingPid();
+    return PermissionCache::checkPermission(sUpdateDeviceStats, pid, uid);
+}
+
 } // anonymous namespace
 
 } // namespace android
@@ -28,6 +28,7 @@
 
 namespace android {
 
+class GpuMem;
 class GpuStats;
 
 class GpuService : public BnGpuService, public PriorityDumper {
@@ -52,6 +53,13 @@ private:
     status_t getGpuStatsAppInfo(std::vector<GpuStatsAppInfo>* outStats) const override;
     void setTargetStats(const std::string& appPackageName, const uint64_t driverVersionCode,
                         const GraphicsEnv::Stats stats, const uint64_t value) override;
+    void setDriverLoadingPhaseTime(const std::string& appPackageName,
+                                   const uint64_t driverVersionCode, const GraphicsEnv::Api api,
+                                   const GraphicsEnv::LoadingPhase phase,
+                                   const int64_t loadingPhaseTime) override;
+    void setGpuMemoryUsage(const int32_t pid, const GraphicsEnv::GpuMemory type,
+                           const uint64_t bytes) override;
+    status_t getGpuMemoryInfo(std::vector<GpuMemoryInfo>* outInfo) const override;
 
     /*
      * IBinder interface
@@ -75,6 +83,7 @@ private:
      * Attributes
      */
     std::unique_ptr<GpuStats> mGpuStats;
+    std::unique_ptr<GpuMem> mGpuMem;
 };
 
 } // namespace android
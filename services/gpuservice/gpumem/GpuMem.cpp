@@ -0,0 +1,154 @@
+/*
+ * Copyright 2019 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#define LOG_TAG "GpuMem"
+#define ATRACE_TAG ATRACE_TAG_GRAPHICS
+
+#include "GpuMem.h"
+
+#include <android-base/stringprintf.h>
+#include <errno.h>
+#include <inttypes.h>
+#include <log/log.h>
+#include <sys/stat.h>
+#include <utils/Trace.h>
+
+namespace android {
+
+using base::StringAppendF;
+
+// Returns false if the uid pid runs as cannot be read from its /proc entry,
+// whether because pid is not running or because the entry cannot be inspected.
+static bool getProcessUid(pid_t pid, uid_t* outUid) {
+    struct stat st;
+    const std::string path = "/proc/" + std::to_string(pid);
+    if (stat(path.c_str(), &st) != 0) return false;
+    *outUid = st.st_uid;
+    return true;
+}
+
+static bool isProcessAlive(pid_t pid) {
+    struct stat st;
+    const std::string path = "/proc/" + std::to_string(pid);
+    return stat(path.c_str(), &st) == 0 || errno != ENOENT;
+}
+
+void GpuMem::insert(pid_t pid, uid_t uid, GraphicsEnv::GpuMemory type, uint64_t bytes) {
+    ATRACE_CALL();
+
+    ALOGV("Received:\n"
+          "\tpid[%d]\n"
+          "\tuid[%d]\n"
+          "\ttype[%d]\n"
+          "\tbytes[%" PRIu64 "]",
+          pid, uid, static_cast<int32_t>(type), bytes);
+
+    // Only privileged callers may report the memory of processes of other
+    // uids, such as the graphic buffers they allocate on their behalf.
+    uid_t processUid;
+    if (pid <= 0 || !getProcessUid(pid, &processUid) ||
+        (processUid != uid && !mMayReportOtherUids(uid))) {
+        ALOGW("Ignoring gpu memory reported by uid %d for pid %d", uid, pid);
+        return;
+    }
+
+    std::lock_guard<std::mutex> lock(mLock);
+    auto it = mMemoryInfo.find(pid);
+    if (it == mMemoryInfo.end()) {
+        if (!bytes) return;
+
+        if (mMemoryInfo.size() >= MAX_NUM_PROCESSES) {
+            pruneLocked();
+            if (mMemoryInfo.size() >= MAX_NUM_PROCESSES) {
+                ALOGV("GpuMemoryInfo has reached maximum size. Ignore new process.");
+                return;
+            }
+        }
+
+        GpuMemoryInfo info;
+        info.pid = pid;
+        info.uid = processUid;
+        it = mMemoryInfo.insert({pid, info}).first;
+    } else if (it->second.uid != static_cast<int32_t>(processUid)) {
+        // The pid has been reused by another process.
+        it->second = GpuMemoryInfo();
+        it->second.pid = pid;
+        it->second.uid = processUid;
+    }
+
+    switch (type) {
+        case GraphicsEnv::GpuMemory::DRIVER_MEMORY:
+            it->second.driverMemory = bytes;
+            break;
+        case GraphicsEnv::GpuMemory::GRAPHIC_BUFFER_MEMORY:
+            it->second.graphicBufferMemory = bytes;
+            break;
+        default:
+            break;
+    }
+
+    if (!it->second.driverMemory && !it->second.graphicBufferMemory) {
+        mMemoryInfo.erase(it);
+    }
+}
+
+void GpuMem::pruneLocked() {
+    for (auto it = mMemoryInfo.begin(); it != mMemoryInfo.end();) {
+        if (isProcessAlive(it->first)) {
+            ++it;
+        } else {
+            it = mMemoryInfo.erase(it);
+        }
+    }
+}
+
+void GpuMem::dump(std::string* result) {
+    ATRACE_CALL();
+
+    if (!result) {
+        ALOGE("Dump result shouldn't be nullptr.");
+        return;
+    }
+
+    std::lock_guard<std::mutex> lock(mLock);
+    pruneLocked();
+
+    uint64_t totalDriverMemory = 0;
+    uint64_t totalGraphicBufferMemory = 0;
+    for (const auto& ele : mMemoryInfo) {
+        result->append(ele.second.toString());
+        result->append("\n");
+        totalDriverMemory += ele.second.driverMemory;
+        totalGraphicBufferMemory += ele.second.graphicBufferMemory;
+    }
+    StringAppendF(result, "totalDriverMemory = %" PRIu64 "\n", totalDriverMemory);
+    StringAppendF(result, "totalGraphicBufferMemory = %" PRIu64 "\n", totalGraphicBufferMemory);
+}
+
+void GpuMem::pullMemoryInfo(std::vector<GpuMemoryInfo>* outInfo) {
+    ATRACE_CALL();
+
+    std::lock_guard<std::mutex> lock(mLock);
+    pruneLocked();
+
+    outInfo->clear();
+    outInfo->reserve(mMemoryInfo.size());
+    for (const auto& ele : mMemoryInfo) {
+        outInfo->emplace_back(ele.second);
+    }
+}
+
+} // namespace android
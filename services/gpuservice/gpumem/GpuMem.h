@@ -0,0 +1,66 @@
+/*
+ * Copyright 2019 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <sys/types.h>
+
+#include <functional>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <graphicsenv/GpuStatsInfo.h>
+#include <graphicsenv/GraphicsEnv.h>
+
+namespace android {
+
+// GpuMem keeps the graphics memory each process last reported using, so that
+// it can be attributed to processes in dumpsys and pulled by the framework.
+class GpuMem {
+public:
+    // Returns whether the caller running as uid may report the memory of
+    // processes running as other uids.
+    using PermissionCheck = std::function<bool(uid_t uid)>;
+
+    explicit GpuMem(PermissionCheck mayReportOtherUids)
+          : mMayReportOtherUids(std::move(mayReportOtherUids)) {}
+    ~GpuMem() = default;
+
+    // Record the memory of the given type pid currently uses. uid is the
+    // caller reporting it, which has to run as the same uid as pid unless it
+    // passes the permission check.
+    void insert(pid_t pid, uid_t uid, GraphicsEnv::GpuMemory type, uint64_t bytes);
+    // dumpsys interface
+    void dump(std::string* result);
+    // Pull the memory used by each live process
+    void pullMemoryInfo(std::vector<GpuMemoryInfo>* outInfo);
+
+private:
+    // Drop the records of processes that have died.
+    void pruneLocked();
+
+    // This limits the worst case number of processes tracked.
+    static const size_t MAX_NUM_PROCESSES = 256;
+    const PermissionCheck mMayReportOtherUids;
+    // GpuMem access should be guarded by mLock.
+    std::mutex mLock;
+    // Key is pid.
+    std::unordered_map<pid_t, GpuMemoryInfo> mMemoryInfo;
+};
+
+} // namespace android
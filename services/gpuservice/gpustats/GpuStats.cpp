@@ -147,6 +147,29 @@ void GpuStats::insertTargetStats(const std::string& appPackageName,
     }
 }
 
+void GpuStats::insertLoadingPhaseTime(const std::string& appPackageName,
+                                      const uint64_t driverVersionCode,
+                                      const GraphicsEnv::Api api,
+                                      const GraphicsEnv::LoadingPhase phase,
+                                      const int64_t loadingPhaseTime) {
+    ATRACE_CALL();
+
+    const std::string appStatsKey = appPackageName + std::to_string(driverVersionCode);
+
+    std::lock_guard<std::mutex> lock(mLock);
+    if (!mAppStats.count(appStatsKey)) {
+        return;
+    }
+
+    const size_t bucketCount = GpuStatsAppInfo::LOADING_PHASE_BUCKET_COUNT;
+    GpuStatsAppInfo& appInfo = mAppStats[appStatsKey];
+    std::vector<int64_t>& histogram = (api == GraphicsEnv::Api::API_GL)
+            ? appInfo.glLoadingPhaseHistogram
+            : appInfo.vkLoadingPhaseHistogram;
+    histogram.resize(GraphicsEnv::LOADING_PHASE_COUNT * bucketCount);
+    histogram[phase * bucketCount + GpuStatsAppInfo::getLoadingPhaseBucket(loadingPhaseTime)]++;
+}
+
 void GpuStats::interceptSystemDriverStatsLocked() {
     // Append cpuVulkanVersion and glesVersion to system driver stats
     if (!mGlobalStats.count(0) || mGlobalStats[0].glesVersion) {
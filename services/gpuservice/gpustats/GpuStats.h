@@ -40,6 +40,11 @@ public:
     // Insert target stats into app stats or potentially global stats as well.
     void insertTargetStats(const std::string& appPackageName, const uint64_t driverVersionCode,
                            const GraphicsEnv::Stats stats, const uint64_t value);
+    // Insert the time of a driver loading phase into the app's histograms.
+    void insertLoadingPhaseTime(const std::string& appPackageName,
+                                const uint64_t driverVersionCode, const GraphicsEnv::Api api,
+                                const GraphicsEnv::LoadingPhase phase,
+                                const int64_t loadingPhaseTime);
     // dumpsys interface
     void dump(const Vector<String16>& args, std::string* result);
     // Pull gpu global stats
@@ -0,0 +1,146 @@
+/*
+ * Copyright 2019 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#undef LOG_TAG
+#define LOG_TAG "gpuservice_unittest"
+
+#include <gtest/gtest.h>
+#include <log/log.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "gpumem/GpuMem.h"
+
+namespace android {
+namespace {
+
+constexpr uint64_t TEST_BYTES = 4096;
+
+class GpuMemTest : public testing::Test {
+public:
+    GpuMemTest() {
+        const ::testing::TestInfo* const test_info =
+                ::testing::UnitTest::GetInstance()->current_test_info();
+        ALOGD("**** Setting up for %s.%s\n", test_info->test_case_name(), test_info->name());
+    }
+
+    ~GpuMemTest() {
+        const ::testing::TestInfo* const test_info =
+                ::testing::UnitTest::GetInstance()->current_test_info();
+        ALOGD("**** Tearing down after %s.%s\n", test_info->test_case_name(), test_info->name());
+    }
+
+    std::vector<GpuMemoryInfo> pull() {
+        std::vector<GpuMemoryInfo> info;
+        mGpuMem.pullMemoryInfo(&info);
+        return info;
+    }
+
+    // Returns the pid of a child that has already exited and been reaped.
+    static pid_t deadPid() {
+        const pid_t pid = fork();
+        if (pid == 0) _exit(0);
+        waitpid(pid, nullptr, 0);
+        return pid;
+    }
+
+    static uid_t processUid(pid_t pid) {
+        struct stat st;
+        const std::string path = "/proc/" + std::to_string(pid);
+        EXPECT_EQ(0, stat(path.c_str(), &st));
+        return st.st_uid;
+    }
+
+    bool mMayReportOtherUids = false;
+    int mPermissionChecks = 0;
+    GpuMem mGpuMem{[this](uid_t) {
+        mPermissionChecks++;
+        return mMayReportOtherUids;
+    }};
+};
+
+TEST_F(GpuMemTest, recordsOwnProcess) {
+    mGpuMem.insert(getpid(), getuid(), GraphicsEnv::GpuMemory::DRIVER_MEMORY, TEST_BYTES);
+    mGpuMem.insert(getpid(), getuid(), GraphicsEnv::GpuMemory::GRAPHIC_BUFFER_MEMORY,
+                   2 * TEST_BYTES);
+
+    const auto info = pull();
+    ASSERT_EQ(1u, info.size());
+    EXPECT_EQ(getpid(), info[0].pid);
+    EXPECT_EQ(static_cast<int32_t>(getuid()), info[0].uid);
+    EXPECT_EQ(TEST_BYTES, info[0].driverMemory);
+    EXPECT_EQ(2 * TEST_BYTES, info[0].graphicBufferMemory);
+    EXPECT_EQ(0, mPermissionChecks);
+}
+
+TEST_F(GpuMemTest, removesProcessReportingNoMemory) {
+    mGpuMem.insert(getpid(), getuid(), GraphicsEnv::GpuMemory::DRIVER_MEMORY, TEST_BYTES);
+    mGpuMem.insert(getpid(), getuid(), GraphicsEnv::GpuMemory::DRIVER_MEMORY, 0);
+
+    EXPECT_TRUE(pull().empty());
+}
+
+TEST_F(GpuMemTest, ignoresInvalidPid) {
+    mMayReportOtherUids = true;
+    mGpuMem.insert(0, getuid(), GraphicsEnv::GpuMemory::DRIVER_MEMORY, TEST_BYTES);
+    mGpuMem.insert(-1, getuid(), GraphicsEnv::GpuMemory::DRIVER_MEMORY, TEST_BYTES);
+
+    EXPECT_TRUE(pull().empty());
+}
+
+TEST_F(GpuMemTest, ignoresProcessThatIsNotRunning) {
+    mMayReportOtherUids = true;
+    mGpuMem.insert(deadPid(), getuid(), GraphicsEnv::GpuMemory::DRIVER_MEMORY, TEST_BYTES);
+
+    EXPECT_TRUE(pull().empty());
+}
+
+TEST_F(GpuMemTest, ignoresOtherUidWithoutPermission) {
+    const pid_t initPid = 1;
+    const uid_t otherUid = processUid(initPid) + 1;
+    mGpuMem.insert(initPid, otherUid, GraphicsEnv::GpuMemory::DRIVER_MEMORY, TEST_BYTES);
+
+    EXPECT_TRUE(pull().empty());
+    EXPECT_EQ(1, mPermissionChecks);
+}
+
+TEST_F(GpuMemTest, recordsOtherUidWithPermission) {
+    const pid_t initPid = 1;
+    mMayReportOtherUids = true;
+    const uid_t otherUid = processUid(initPid) + 1;
+    mGpuMem.insert(initPid, otherUid, GraphicsEnv::GpuMemory::DRIVER_MEMORY, TEST_BYTES);
+
+    const auto info = pull();
+    ASSERT_EQ(1u, info.size());
+    EXPECT_EQ(initPid, info[0].pid);
+    // The record carries the uid of the process, not of the caller.
+    EXPECT_EQ(static_cast<int32_t>(processUid(initPid)), info[0].uid);
+    EXPECT_EQ(TEST_BYTES, info[0].driverMemory);
+}
+
+TEST_F(GpuMemTest, dumpsTotals) {
+    mGpuMem.insert(getpid(), getuid(), GraphicsEnv::GpuMemory::DRIVER_MEMORY, TEST_BYTES);
+
+    std::string result;
+    mGpuMem.dump(&result);
+    EXPECT_NE(std::string::npos,
+              result.find("totalDriverMemory = " + std::to_string(TEST_BYTES) + "\n"));
+    EXPECT_NE(std::string::npos, result.find("totalGraphicBufferMemory = 0\n"));
+}
+
+} // namespace
+} // namespace android
@@ -28,9 +28,12 @@
 #include <sys/limits.h>
 #include <sys/inotify.h>
 #include <sys/ioctl.h>
+#include <sys/stat.h>
 #include <sys/utsname.h>
 #include <unistd.h>
 
+#include <future>
+
 #define LOG_TAG "EventHub"
 
 // #define LOG_NDEBUG 0
@@ -71,6 +74,9 @@ namespace android {
 
 static constexpr bool DEBUG = false;
 
+// getEvents() reads input_events into the tail of the RawEvent buffer it fills
+static_assert(sizeof(struct input_event) <= sizeof(RawEvent));
+
 static const char *WAKE_LOCK_ID = "KeyEvents";
 static const char *DEVICE_PATH = "/dev/input";
 // v4l2 devices go directly into /dev
@@ -194,7 +200,7 @@ EventHub::Device::Device(int fd, int32_t id, const std::string& path,
         const InputDeviceIdentifier& identifier) :
         next(nullptr),
         fd(fd), id(id), path(path), identifier(identifier),
-        classes(0), configuration(nullptr), virtualKeyMap(nullptr),
+        classes(0), virtualKeyMap(nullptr),
         ffEffectPlaying(false), ffEffectId(-1), controllerNumber(0),
         enabled(true), isVirtual(fd < 0) {
     memset(keyBitmask, 0, sizeof(keyBitmask));
@@ -208,7 +214,6 @@ EventHub::Device::Device(int fd, int32_t id, const std::string& path,
 
 EventHub::Device::~Device() {
     close();
-    delete configuration;
 }
 
 void EventHub::Device::close() {
@@ -817,8 +822,6 @@ size_t EventHub::getEvents(int timeoutMillis, RawEvent* buffer, size_t bufferSiz
 
     AutoMutex _l(mLock);
 
-    struct input_event readBuffer[bufferSize];
-
     RawEvent* event = buffer;
     size_t capacity = bufferSize;
     bool awoken = false;
@@ -943,6 +946,11 @@ size_t EventHub::getEvents(int timeoutMillis, RawEvent* buffer, size_t bufferSiz
             }
             // This must be an input event
             if (eventItem.events & EPOLLIN) {
+                // Read straight into the unused tail of the caller's buffer and convert the
+                // events in place: an input_event is never larger than a RawEvent, so the
+                // conversion only ever writes over events that have already been read.
+                uint8_t* readBuffer = reinterpret_cast<uint8_t*>(event)
+                        + capacity * (sizeof(RawEvent) - sizeof(struct input_event));
                 int32_t readSize = read(device->fd, readBuffer,
                         sizeof(struct input_event) * capacity);
                 if (readSize == 0 || (readSize < 0 && errno == ENODEV)) {
@@ -963,7 +971,8 @@ size_t EventHub::getEvents(int timeoutMillis, RawEvent* buffer, size_t bufferSiz
 
                     size_t count = size_t(readSize) / sizeof(struct input_event);
                     for (size_t i = 0; i < count; i++) {
-                        struct input_event& iev = readBuffer[i];
+                        struct input_event iev;
+                        memcpy(&iev, readBuffer + i * sizeof(iev), sizeof(iev));
                         event->when = processEventTimestamp(iev);
                         event->deviceId = deviceId;
                         event->type = iev.type;
@@ -1187,14 +1196,23 @@ void EventHub::unregisterVideoDeviceFromEpollLocked(const TouchVideoDevice& vide
 }
 
 status_t EventHub::openDeviceLocked(const char* devicePath) {
+    Device* device = probeDevice(devicePath, mNextDeviceId++);
+    if (device == nullptr) {
+        return -1;
+    }
+    return addProbedDeviceLocked(device);
+}
+
+EventHub::Device* EventHub::probeDevice(const char* devicePath, int32_t deviceId) {
     char buffer[80];
 
     ALOGV("Opening device: %s", devicePath);
+    const nsecs_t startTime = systemTime(SYSTEM_TIME_MONOTONIC);
 
     int fd = open(devicePath, O_RDWR | O_CLOEXEC | O_NONBLOCK);
     if(fd < 0) {
         ALOGE("could not open %s, %s\n", devicePath, strerror(errno));
-        return -1;
+        return nullptr;
     }
 
     InputDeviceIdentifier identifier;
@@ -1213,7 +1231,7 @@ status_t EventHub::openDeviceLocked(const char* devicePath) {
         if (identifier.name == item) {
             ALOGI("ignoring event id %s driver %s\n", devicePath, item.c_str());
             close(fd);
-            return -1;
+            return nullptr;
         }
     }
 
@@ -1222,7 +1240,7 @@ status_t EventHub::openDeviceLocked(const char* devicePath) {
     if(ioctl(fd, EVIOCGVERSION, &driverVersion)) {
         ALOGE("could not get driver version for %s, %s\n", devicePath, strerror(errno));
         close(fd);
-        return -1;
+        return nullptr;
     }
 
     // Get device identifier.
@@ -1230,7 +1248,7 @@ status_t EventHub::openDeviceLocked(const char* devicePath) {
     if(ioctl(fd, EVIOCGID, &inputId)) {
         ALOGE("could not get device input id for %s, %s\n", devicePath, strerror(errno));
         close(fd);
-        return -1;
+        return nullptr;
     }
     identifier.bus = inputId.bustype;
     identifier.product = inputId.product;
@@ -1253,11 +1271,7 @@ status_t EventHub::openDeviceLocked(const char* devicePath) {
         identifier.uniqueId = buffer;
     }
 
-    // Fill in the descriptor.
-    assignDescriptorLocked(identifier);
-
     // Allocate device.  (The device object takes ownership of the fd at this point.)
-    int32_t deviceId = mNextDeviceId++;
     Device* device = new Device(fd, deviceId, devicePath, identifier);
 
     ALOGV("add device %d: %s\n", deviceId, devicePath);
@@ -1269,7 +1283,6 @@ status_t EventHub::openDeviceLocked(const char* devicePath) {
     ALOGV("  name:       \"%s\"\n", identifier.name.c_str());
     ALOGV("  location:   \"%s\"\n", identifier.location.c_str());
     ALOGV("  unique id:  \"%s\"\n", identifier.uniqueId.c_str());
-    ALOGV("  descriptor: \"%s\"\n", identifier.descriptor.c_str());
     ALOGV("  driver:     v%d.%d.%d\n",
         driverVersion >> 16, (driverVersion >> 8) & 0xff, driverVersion & 0xff);
 
@@ -1380,22 +1393,13 @@ status_t EventHub::openDeviceLocked(const char* devicePath) {
 
     // Load the key map.
     // We need to do this for joysticks too because the key layout may specify axes.
-    status_t keyMapStatus = NAME_NOT_FOUND;
     if (device->classes & (INPUT_DEVICE_CLASS_KEYBOARD | INPUT_DEVICE_CLASS_JOYSTICK)) {
         // Load the keymap for the device.
-        keyMapStatus = loadKeyMapLocked(device);
+        loadKeyMapLocked(device);
     }
 
     // Configure the keyboard, gamepad or virtual keyboard.
     if (device->classes & INPUT_DEVICE_CLASS_KEYBOARD) {
-        // Register the keyboard as a built-in keyboard if it is eligible.
-        if (!keyMapStatus
-                && mBuiltInKeyboardId == NO_BUILT_IN_KEYBOARD
-                && isEligibleBuiltInKeyboard(device->identifier,
-                        device->configuration, &device->keyMap)) {
-            mBuiltInKeyboardId = device->id;
-        }
-
         // 'Q' key support = cheap test of whether this is an alpha-capable kbd
         if (hasKeycodeLocked(device, AKEYCODE_Q)) {
             device->classes |= INPUT_DEVICE_CLASS_ALPHAKEY;
@@ -1424,7 +1428,7 @@ status_t EventHub::openDeviceLocked(const char* devicePath) {
         ALOGV("Dropping device: id=%d, path='%s', name='%s'",
                 deviceId, devicePath, device->identifier.name.c_str());
         delete device;
-        return -1;
+        return nullptr;
     }
 
     // Determine whether the device has a mic.
@@ -1437,6 +1441,25 @@ status_t EventHub::openDeviceLocked(const char* devicePath) {
         device->classes |= INPUT_DEVICE_CLASS_EXTERNAL;
     }
 
+    ALOGD("Probed device %s in %.1fms", devicePath,
+            (systemTime(SYSTEM_TIME_MONOTONIC) - startTime) * 0.000001f);
+    return device;
+}
+
+status_t EventHub::addProbedDeviceLocked(Device* device) {
+    // Fill in the descriptor, now that it can be told apart from those of the other devices.
+    assignDescriptorLocked(device->identifier);
+    ALOGV("  descriptor: \"%s\"\n", device->identifier.descriptor.c_str());
+
+    // Register the keyboard as a built-in keyboard if it is eligible.
+    if ((device->classes & INPUT_DEVICE_CLASS_KEYBOARD)
+            && device->keyMap.isComplete()
+            && mBuiltInKeyboardId == NO_BUILT_IN_KEYBOARD
+            && isEligibleBuiltInKeyboard(device->identifier,
+                    device->configuration.get(), &device->keyMap)) {
+        mBuiltInKeyboardId = device->id;
+    }
+
     if (device->classes & (INPUT_DEVICE_CLASS_JOYSTICK | INPUT_DEVICE_CLASS_DPAD)
             && device->classes & INPUT_DEVICE_CLASS_GAMEPAD) {
         device->controllerNumber = getNextControllerNumberLocked(device);
@@ -1465,12 +1488,12 @@ status_t EventHub::openDeviceLocked(const char* devicePath) {
 
     ALOGI("New device: id=%d, fd=%d, path='%s', name='%s', classes=0x%x, "
             "configuration='%s', keyLayout='%s', keyCharacterMap='%s', builtinKeyboard=%s, ",
-         deviceId, fd, devicePath, device->identifier.name.c_str(),
+         device->id, device->fd, device->path.c_str(), device->identifier.name.c_str(),
          device->classes,
          device->configurationFile.c_str(),
          device->keyMap.keyLayoutFile.c_str(),
          device->keyMap.keyCharacterMapFile.c_str(),
-         toString(mBuiltInKeyboardId == deviceId));
+         toString(mBuiltInKeyboardId == device->id));
 
     addDeviceLocked(device);
     return OK;
@@ -1611,15 +1634,37 @@ void EventHub::loadConfigurationLocked(Device* device) {
     if (device->configurationFile.empty()) {
         ALOGD("No input device configuration file found for device '%s'.",
                 device->identifier.name.c_str());
-    } else {
-        status_t status = PropertyMap::load(String8(device->configurationFile.c_str()),
-                &device->configuration);
-        if (status) {
-            ALOGE("Error loading input device configuration file for device '%s'.  "
-                    "Using default configuration.",
-                    device->identifier.name.c_str());
+        return;
+    }
+
+    struct stat st;
+    const bool haveStat = stat(device->configurationFile.c_str(), &st) == 0;
+    if (haveStat) {
+        std::scoped_lock lock(mConfigurationFilesLock);
+        auto it = mConfigurationFiles.find(device->configurationFile);
+        if (it != mConfigurationFiles.end() && it->second.inode == st.st_ino &&
+                it->second.size == st.st_size && it->second.modificationTime == st.st_mtime) {
+            device->configuration = it->second.configuration;
+            return;
         }
     }
+
+    PropertyMap* configuration;
+    status_t status = PropertyMap::load(String8(device->configurationFile.c_str()),
+            &configuration);
+    if (status) {
+        ALOGE("Error loading input device configuration file for device '%s'.  "
+                "Using default configuration.",
+                device->identifier.name.c_str());
+        return;
+    }
+    device->configuration.reset(configuration);
+
+    if (haveStat) {
+        std::scoped_lock lock(mConfigurationFilesLock);
+        mConfigurationFiles[device->configurationFile] =
+                {st.st_ino, st.st_size, st.st_mtime, device->configuration};
+    }
 }
 
 bool EventHub::loadVirtualKeyMapLocked(Device* device) {
@@ -1635,7 +1680,7 @@ bool EventHub::loadVirtualKeyMapLocked(Device* device) {
 }
 
 status_t EventHub::loadKeyMapLocked(Device* device) {
-    return device->keyMap.load(device->identifier, device->configuration);
+    return device->keyMap.load(device->identifier, device->configuration.get());
 }
 
 bool EventHub::isExternalDeviceLocked(Device* device) {
@@ -1869,15 +1914,32 @@ status_t EventHub::scanDirLocked(const char *dirname)
     strcpy(devname, dirname);
     filename = devname + strlen(devname);
     *filename++ = '/';
+    std::vector<std::string> devicePaths;
     while((de = readdir(dir))) {
         if(de->d_name[0] == '.' &&
            (de->d_name[1] == '\0' ||
             (de->d_name[1] == '.' && de->d_name[2] == '\0')))
             continue;
         strcpy(filename, de->d_name);
-        openDeviceLocked(devname);
+        devicePaths.push_back(devname);
     }
     closedir(dir);
+
+    // Probing a device mostly waits on its driver and on loading its configuration and key
+    // maps, none of which depends on the other devices, so all of them are probed at once.
+    // They are then added in the order they were found, as they would have been one by one.
+    std::vector<std::future<Device*>> probedDevices;
+    probedDevices.reserve(devicePaths.size());
+    for (const std::string& devicePath : devicePaths) {
+        probedDevices.push_back(std::async(std::launch::async, &EventHub::probeDevice, this,
+                devicePath.c_str(), mNextDeviceId++));
+    }
+    for (auto& probedDevice : probedDevices) {
+        Device* device = probedDevice.get();
+        if (device != nullptr) {
+            addProbedDeviceLocked(device);
+        }
+    }
     return 0;
 }
 
@@ -18,8 +18,12 @@
 #ifndef _RUNTIME_EVENT_HUB_H
 #define _RUNTIME_EVENT_HUB_H
 
+#include <memory>
+#include <mutex>
+#include <unordered_map>
 #include <vector>
 
+#include <android-base/thread_annotations.h>
 #include <input/Input.h>
 #include <input/InputDevice.h>
 #include <input/Keyboard.h>
@@ -329,7 +333,7 @@ private:
         int fd; // may be -1 if device is closed
         const int32_t id;
         const std::string path;
-        const InputDeviceIdentifier identifier;
+        InputDeviceIdentifier identifier; // the descriptor is assigned when the device is added
 
         std::unique_ptr<TouchVideoDevice> videoDevice;
 
@@ -344,7 +348,7 @@ private:
         uint8_t propBitmask[(INPUT_PROP_MAX + 1) / 8];
 
         std::string configurationFile;
-        PropertyMap* configuration;
+        std::shared_ptr<const PropertyMap> configuration;
         std::unique_ptr<VirtualKeyMap> virtualKeyMap;
         KeyMap keyMap;
 
@@ -377,6 +381,10 @@ private:
     };
 
     status_t openDeviceLocked(const char* devicePath);
+    // Opens the device and figures out what it is, touching nothing but the device itself, so
+    // that devices can be probed concurrently. Returns nullptr if it is not handled.
+    Device* probeDevice(const char* devicePath, int32_t deviceId);
+    status_t addProbedDeviceLocked(Device* device);
     void openVideoDeviceLocked(const std::string& devicePath);
     void createVirtualKeyboardLocked();
     void addDeviceLocked(Device* device);
@@ -432,6 +440,19 @@ private:
     // Protect all internal state.
     mutable Mutex mLock;
 
+    // The configuration files parsed so far, by path, shared by the devices using them. Devices
+    // are probed concurrently, so these have a lock of their own. They are kept after the
+    // devices using them are closed, so that reopening every device doesn't parse them again.
+    struct ConfigurationFile {
+        ino_t inode;
+        off_t size;
+        time_t modificationTime;
+        std::shared_ptr<const PropertyMap> configuration;
+    };
+    std::mutex mConfigurationFilesLock;
+    std::unordered_map<std::string, ConfigurationFile> mConfigurationFiles
+            GUARDED_BY(mConfigurationFilesLock);
+
     // The actual id of the built-in keyboard, or NO_BUILT_IN_KEYBOARD if none.
     // EventHub remaps the built-in keyboard to id 0 externally as required by the API.
     enum {
@@ -471,8 +492,9 @@ private:
     int mInputWd;
     int mVideoWd;
 
-    // Maximum number of signalled FDs to handle at a time.
-    static const int EPOLL_MAX_EVENTS = 16;
+    // Maximum number of signalled FDs to handle at a time. Large enough that a burst across
+    // every attached device is drained after a single epoll_wait.
+    static const int EPOLL_MAX_EVENTS = 64;
 
     // The array of pending epoll events and the index of the next event to be handled.
     struct epoll_event mPendingEventItems[EPOLL_MAX_EVENTS];
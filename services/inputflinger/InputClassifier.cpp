@@ -24,6 +24,7 @@
 #include <cmath>
 #include <inttypes.h>
 #include <log/log.h>
+#include <optional>
 #if defined(__linux__)
     #include <pthread.h>
 #endif
@@ -291,7 +292,7 @@ void MotionClassifier::reset(const NotifyDeviceResetArgs& args) {
     enqueueEvent(std::make_unique<NotifyDeviceResetArgs>(args));
 }
 
-const char* MotionClassifier::getServiceStatus() REQUIRES(mLock) {
+const char* MotionClassifier::getServiceStatus() {
     if (!mService) {
         return "null";
     }
@@ -302,8 +303,9 @@ const char* MotionClassifier::getServiceStatus() REQUIRES(mLock) {
 }
 
 void MotionClassifier::dump(std::string& dump) {
-    std::scoped_lock lock(mLock);
+    // Pinging a slow HAL must not hold up classify(), so the lock is only taken afterwards.
     dump += StringPrintf(INDENT2 "mService status: %s\n", getServiceStatus());
+    std::scoped_lock lock(mLock);
     dump += StringPrintf(INDENT2 "mEvents: %zu element(s) (max=%zu)\n",
             mEvents.size(), MAX_EVENTS);
     dump += INDENT2 "mClassifications, mLastDownTimes:\n";
@@ -372,16 +374,25 @@ void InputClassifier::notifyKey(const NotifyKeyArgs* args) {
 }
 
 void InputClassifier::notifyMotion(const NotifyMotionArgs* args) {
-    std::scoped_lock lock(mLock);
-    // MotionClassifier is only used for touch events, for now
-    const bool sendToMotionClassifier = mMotionClassifier && isTouchEvent(*args);
-    if (!sendToMotionClassifier) {
+    // classify() only queues the event for the HAL thread and returns the latest result it has
+    // for the gesture, so nothing here waits for the HAL. The lock is not held while the event
+    // goes on to the next stage.
+    std::optional<MotionClassification> classification;
+    { // acquire lock
+        std::scoped_lock lock(mLock);
+        // MotionClassifier is only used for touch events, for now
+        if (mMotionClassifier && isTouchEvent(*args)) {
+            classification = mMotionClassifier->classify(*args);
+        }
+    } // release lock
+
+    if (!classification) {
         mListener->notifyMotion(args);
         return;
     }
 
     NotifyMotionArgs newArgs(*args);
-    newArgs.classification = mMotionClassifier->classify(newArgs);
+    newArgs.classification = *classification;
     mListener->notifyMotion(&newArgs);
 }
 
@@ -391,27 +402,43 @@ void InputClassifier::notifySwitch(const NotifySwitchArgs* args) {
 }
 
 void InputClassifier::notifyDeviceReset(const NotifyDeviceResetArgs* args) {
-    std::scoped_lock lock(mLock);
-    if (mMotionClassifier) {
-        mMotionClassifier->reset(*args);
-    }
+    { // acquire lock
+        std::scoped_lock lock(mLock);
+        if (mMotionClassifier) {
+            mMotionClassifier->reset(*args);
+        }
+    } // release lock
+
     // continue to next stage
     mListener->notifyDeviceReset(args);
 }
 
 void InputClassifier::setMotionClassifier(
         std::unique_ptr<MotionClassifierInterface> motionClassifier) {
-    std::scoped_lock lock(mLock);
-    mMotionClassifier = std::move(motionClassifier);
+    std::shared_ptr<MotionClassifierInterface> oldMotionClassifier;
+    { // acquire lock
+        std::scoped_lock lock(mLock);
+        oldMotionClassifier = std::move(mMotionClassifier);
+        mMotionClassifier = std::move(motionClassifier);
+    } // release lock
+
+    // Destroying the old classifier waits for its HAL thread, which may be stuck in a HAL call.
+    // The lock is released by now, so notifyMotion is not held up by it.
+    oldMotionClassifier.reset();
 }
 
 void InputClassifier::dump(std::string& dump) {
-    std::scoped_lock lock(mLock);
+    std::shared_ptr<MotionClassifierInterface> motionClassifier;
+    { // acquire lock
+        std::scoped_lock lock(mLock);
+        motionClassifier = mMotionClassifier;
+    } // release lock
+
     dump += "Input Classifier State:\n";
 
     dump += INDENT1 "Motion Classifier:\n";
-    if (mMotionClassifier) {
-        mMotionClassifier->dump(dump);
+    if (motionClassifier) {
+        motionClassifier->dump(dump);
     } else {
         dump += INDENT2 "<nullptr>";
     }
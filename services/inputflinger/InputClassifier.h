@@ -19,6 +19,7 @@
 
 #include <android-base/thread_annotations.h>
 #include <utils/RefBase.h>
+#include <memory>
 #include <thread>
 #include <unordered_map>
 
@@ -208,9 +209,10 @@ private:
      */
     void requestExit();
     /**
-     * Return string status of mService
+     * Return string status of mService. This pings the HAL, so it must not be called with
+     * mLock held.
      */
-    const char* getServiceStatus() REQUIRES(mLock);
+    const char* getServiceStatus() EXCLUDES(mLock);
 };
 
 /**
@@ -242,7 +244,8 @@ private:
     // The next stage to pass input events to
     sp<InputListenerInterface> mListener;
 
-    std::unique_ptr<MotionClassifierInterface> mMotionClassifier GUARDED_BY(mLock);
+    // Shared so that dump can talk to the HAL without holding mLock
+    std::shared_ptr<MotionClassifierInterface> mMotionClassifier GUARDED_BY(mLock);
     std::thread mInitializeMotionClassifierThread;
     /**
      * Set the value of mMotionClassifier.
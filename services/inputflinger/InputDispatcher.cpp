@@ -45,8 +45,10 @@
 
 #include "InputDispatcher.h"
 
+#include <algorithm>
 #include <errno.h>
 #include <inttypes.h>
+#include <iterator>
 #include <limits.h>
 #include <sstream>
 #include <stddef.h>
@@ -268,6 +270,9 @@ void InputDispatcher::dispatchOnce() {
         std::scoped_lock _l(mLock);
         mDispatcherIsAlive.notify_all();
 
+        // Pick up everything the reader has notified since the last time around.
+        enqueuePostedInboundEventsLocked();
+
         // Run a dispatch loop if there are no pending commands.
         // The dispatch loop might enqueue commands to run afterwards.
         if (!haveCommandsLocked()) {
@@ -500,6 +505,42 @@ bool InputDispatcher::enqueueInboundEventLocked(EventEntry* entry) {
     return needWake;
 }
 
+void InputDispatcher::postInboundEvent(EventEntry* entry) {
+    EventEntry* head = mPostedInboundEvents.load(std::memory_order_relaxed);
+    do {
+        entry->next = head;
+    } while (!mPostedInboundEvents.compare_exchange_weak(head, entry,
+            std::memory_order_release, std::memory_order_relaxed));
+
+    // If something was already posted, the dispatcher has been woken and has yet to take it,
+    // so it will pick this event up along with it.
+    if (head == nullptr) {
+        mLooper->wake();
+    }
+}
+
+bool InputDispatcher::enqueuePostedInboundEventsLocked() {
+    EventEntry* entry = mPostedInboundEvents.exchange(nullptr, std::memory_order_acquire);
+
+    // The posted events are linked newest first.
+    EventEntry* oldest = nullptr;
+    while (entry != nullptr) {
+        EventEntry* next = entry->next;
+        entry->next = oldest;
+        oldest = entry;
+        entry = next;
+    }
+
+    bool needWake = false;
+    while (oldest != nullptr) {
+        EventEntry* next = oldest->next;
+        oldest->next = nullptr;
+        needWake |= enqueueInboundEventLocked(oldest);
+        oldest = next;
+    }
+    return needWake;
+}
+
 void InputDispatcher::addRecentEventLocked(EventEntry* entry) {
     entry->refCount += 1;
     mRecentQueue.enqueueAtTail(entry);
@@ -510,9 +551,17 @@ void InputDispatcher::addRecentEventLocked(EventEntry* entry) {
 
 sp<InputWindowHandle> InputDispatcher::findTouchedWindowAtLocked(int32_t displayId,
         int32_t x, int32_t y, bool addOutsideTargets, bool addPortalWindows) {
-    // Traverse windows from front to back to find touched window.
-    const std::vector<sp<InputWindowHandle>> windowHandles = getWindowHandlesLocked(displayId);
-    for (const sp<InputWindowHandle>& windowHandle : windowHandles) {
+    auto indexIt = mWindowHitIndexByDisplay.find(displayId);
+    if (indexIt == mWindowHitIndexByDisplay.end()) {
+        return nullptr;
+    }
+
+    // Traverse the windows which may be touched from front to back to find touched window.
+    const std::vector<sp<InputWindowHandle>>& windowHandles = getWindowHandlesLocked(displayId);
+    std::vector<size_t> candidates;
+    indexIt->second.getTouchCandidates(x, y, &candidates);
+    for (size_t index : candidates) {
+        const sp<InputWindowHandle>& windowHandle = windowHandles[index];
         const InputWindowInfo* windowInfo = windowHandle->getInfo();
         if (windowInfo->displayId == displayId) {
             int32_t flags = windowInfo->layoutParamsFlags;
@@ -688,6 +737,7 @@ InputDispatcher::CommandEntry* InputDispatcher::postCommandLocked(Command comman
 }
 
 void InputDispatcher::drainInboundQueueLocked() {
+    enqueuePostedInboundEventsLocked();
     while (! mInboundQueue.isEmpty()) {
         EventEntry* entry = mInboundQueue.dequeueAtHead();
         releaseInboundEventLocked(entry);
@@ -1551,7 +1601,7 @@ int32_t InputDispatcher::findTouchedWindowTargetsLocked(nsecs_t currentTime,
         sp<InputWindowHandle> foregroundWindowHandle =
                 mTempTouchState.getFirstForegroundWindowHandle();
         if (foregroundWindowHandle && foregroundWindowHandle->getInfo()->hasWallpaper) {
-            const std::vector<sp<InputWindowHandle>> windowHandles =
+            const std::vector<sp<InputWindowHandle>>& windowHandles =
                     getWindowHandlesLocked(displayId);
             for (const sp<InputWindowHandle>& windowHandle : windowHandles) {
                 const InputWindowInfo* info = windowHandle->getInfo();
@@ -1760,13 +1810,20 @@ bool InputDispatcher::checkInjectionPermission(const sp<InputWindowHandle>& wind
 bool InputDispatcher::isWindowObscuredAtPointLocked(
         const sp<InputWindowHandle>& windowHandle, int32_t x, int32_t y) const {
     int32_t displayId = windowHandle->getInfo()->displayId;
-    const std::vector<sp<InputWindowHandle>> windowHandles = getWindowHandlesLocked(displayId);
-    for (const sp<InputWindowHandle>& otherHandle : windowHandles) {
-        if (otherHandle == windowHandle) {
+    auto indexIt = mWindowHitIndexByDisplay.find(displayId);
+    if (indexIt == mWindowHitIndexByDisplay.end()) {
+        return false;
+    }
+
+    // Only the windows in front of this one whose frame may contain the point can obscure it.
+    const std::vector<sp<InputWindowHandle>>& windowHandles = getWindowHandlesLocked(displayId);
+    const ssize_t windowIndex = indexIt->second.indexOf(windowHandle);
+    for (size_t index : indexIt->second.getCell(x, y)) {
+        if (windowIndex >= 0 && index >= size_t(windowIndex)) {
             break;
         }
 
-        const InputWindowInfo* otherInfo = otherHandle->getInfo();
+        const InputWindowInfo* otherInfo = windowHandles[index]->getInfo();
         if (otherInfo->displayId == displayId
                 && otherInfo->visible && !otherInfo->isTrustedOverlay()
                 && otherInfo->frameContainsPoint(x, y)) {
@@ -1779,7 +1836,7 @@ bool InputDispatcher::isWindowObscuredAtPointLocked(
 
 bool InputDispatcher::isWindowObscuredLocked(const sp<InputWindowHandle>& windowHandle) const {
     int32_t displayId = windowHandle->getInfo()->displayId;
-    const std::vector<sp<InputWindowHandle>> windowHandles = getWindowHandlesLocked(displayId);
+    const std::vector<sp<InputWindowHandle>>& windowHandles = getWindowHandlesLocked(displayId);
     const InputWindowInfo* windowInfo = windowHandle->getInfo();
     for (const sp<InputWindowHandle>& otherHandle : windowHandles) {
         if (otherHandle == windowHandle) {
@@ -2173,119 +2230,135 @@ void InputDispatcher::startDispatchCycleLocked(nsecs_t currentTime,
             connection->getInputChannelName().c_str());
 #endif
 
-    while (connection->status == Connection::STATUS_NORMAL
-            && !connection->outboundQueue.isEmpty()) {
-        DispatchEntry* dispatchEntry = connection->outboundQueue.head;
+    // Publish all the outbound events together, so that they reach the channel in as
+    // few writes as it allows.
+    connection->inputPublisher.beginBatch();
+    size_t batched = 0;
+    status_t status = OK;
+    for (DispatchEntry* dispatchEntry = connection->outboundQueue.head;
+            connection->status == Connection::STATUS_NORMAL && dispatchEntry;
+            dispatchEntry = dispatchEntry->next) {
         dispatchEntry->deliveryTime = currentTime;
-
-        // Publish the event.
-        status_t status;
-        EventEntry* eventEntry = dispatchEntry->eventEntry;
-        switch (eventEntry->type) {
-        case EventEntry::TYPE_KEY: {
-            KeyEntry* keyEntry = static_cast<KeyEntry*>(eventEntry);
-
-            // Publish the key event.
-            status = connection->inputPublisher.publishKeyEvent(dispatchEntry->seq,
-                    keyEntry->deviceId, keyEntry->source, keyEntry->displayId,
-                    dispatchEntry->resolvedAction, dispatchEntry->resolvedFlags,
-                    keyEntry->keyCode, keyEntry->scanCode,
-                    keyEntry->metaState, keyEntry->repeatCount, keyEntry->downTime,
-                    keyEntry->eventTime);
+        status = publishDispatchEntryLocked(connection, dispatchEntry);
+        if (status) {
             break;
         }
+        batched++;
+    }
+    size_t published;
+    status_t sendStatus = connection->inputPublisher.endBatch(&published);
+    if (published < batched) {
+        status = sendStatus;
+    }
 
-        case EventEntry::TYPE_MOTION: {
-            MotionEntry* motionEntry = static_cast<MotionEntry*>(eventEntry);
-
-            PointerCoords scaledCoords[MAX_POINTERS];
-            const PointerCoords* usingCoords = motionEntry->pointerCoords;
-
-            // Set the X and Y offset depending on the input source.
-            float xOffset, yOffset;
-            if ((motionEntry->source & AINPUT_SOURCE_CLASS_POINTER)
-                    && !(dispatchEntry->targetFlags & InputTarget::FLAG_ZERO_COORDS)) {
-                float globalScaleFactor = dispatchEntry->globalScaleFactor;
-                float wxs = dispatchEntry->windowXScale;
-                float wys = dispatchEntry->windowYScale;
-                xOffset = dispatchEntry->xOffset * wxs;
-                yOffset = dispatchEntry->yOffset * wys;
-                if (wxs != 1.0f || wys != 1.0f || globalScaleFactor != 1.0f) {
-                    for (uint32_t i = 0; i < motionEntry->pointerCount; i++) {
-                        scaledCoords[i] = motionEntry->pointerCoords[i];
-                        scaledCoords[i].scale(globalScaleFactor, wxs, wys);
-                    }
-                    usingCoords = scaledCoords;
-                }
-            } else {
-                xOffset = 0.0f;
-                yOffset = 0.0f;
+    // Re-enqueue the published events on the wait queue.
+    for (size_t i = 0; i < published; i++) {
+        DispatchEntry* dispatchEntry = connection->outboundQueue.head;
+        connection->outboundQueue.dequeue(dispatchEntry);
+        traceOutboundQueueLength(connection);
+        connection->enqueueWaitQueueEntry(dispatchEntry);
+        traceWaitQueueLength(connection);
+    }
 
-                // We don't want the dispatch target to know.
-                if (dispatchEntry->targetFlags & InputTarget::FLAG_ZERO_COORDS) {
-                    for (uint32_t i = 0; i < motionEntry->pointerCount; i++) {
-                        scaledCoords[i].clear();
-                    }
-                    usingCoords = scaledCoords;
-                }
+    // Check the result of the first event not published.
+    if (status) {
+        if (status == WOULD_BLOCK) {
+            if (connection->waitQueue.isEmpty()) {
+                ALOGE("channel '%s' ~ Could not publish event because the pipe is full. "
+                        "This is unexpected because the wait queue is empty, so the pipe "
+                        "should be empty and we shouldn't have any problems writing an "
+                        "event to it, status=%d", connection->getInputChannelName().c_str(),
+                        status);
+                abortBrokenDispatchCycleLocked(currentTime, connection, true /*notify*/);
+            } else {
+                // Pipe is full and we are waiting for the app to finish process some events
+                // before sending more events to it.
+#if DEBUG_DISPATCH_CYCLE
+                ALOGD("channel '%s' ~ Could not publish event because the pipe is full, "
+                        "waiting for the application to catch up",
+                        connection->getInputChannelName().c_str());
+#endif
+                connection->inputPublisherBlocked = true;
             }
-
-            // Publish the motion event.
-            status = connection->inputPublisher.publishMotionEvent(dispatchEntry->seq,
-                    motionEntry->deviceId, motionEntry->source, motionEntry->displayId,
-                    dispatchEntry->resolvedAction, motionEntry->actionButton,
-                    dispatchEntry->resolvedFlags, motionEntry->edgeFlags,
-                    motionEntry->metaState, motionEntry->buttonState, motionEntry->classification,
-                    xOffset, yOffset, motionEntry->xPrecision, motionEntry->yPrecision,
-                    motionEntry->downTime, motionEntry->eventTime,
-                    motionEntry->pointerCount, motionEntry->pointerProperties,
-                    usingCoords);
-            break;
+        } else {
+            ALOGE("channel '%s' ~ Could not publish event due to an unexpected error, "
+                    "status=%d", connection->getInputChannelName().c_str(), status);
+            abortBrokenDispatchCycleLocked(currentTime, connection, true /*notify*/);
         }
+    }
+}
 
-        default:
-            ALOG_ASSERT(false);
-            return;
-        }
+status_t InputDispatcher::publishDispatchEntryLocked(const sp<Connection>& connection,
+        DispatchEntry* dispatchEntry) {
+    EventEntry* eventEntry = dispatchEntry->eventEntry;
+    switch (eventEntry->type) {
+    case EventEntry::TYPE_KEY: {
+        KeyEntry* keyEntry = static_cast<KeyEntry*>(eventEntry);
 
-        // Check the result.
-        if (status) {
-            if (status == WOULD_BLOCK) {
-                if (connection->waitQueue.isEmpty()) {
-                    ALOGE("channel '%s' ~ Could not publish event because the pipe is full. "
-                            "This is unexpected because the wait queue is empty, so the pipe "
-                            "should be empty and we shouldn't have any problems writing an "
-                            "event to it, status=%d", connection->getInputChannelName().c_str(),
-                            status);
-                    abortBrokenDispatchCycleLocked(currentTime, connection, true /*notify*/);
-                } else {
-                    // Pipe is full and we are waiting for the app to finish process some events
-                    // before sending more events to it.
-#if DEBUG_DISPATCH_CYCLE
-                    ALOGD("channel '%s' ~ Could not publish event because the pipe is full, "
-                            "waiting for the application to catch up",
-                            connection->getInputChannelName().c_str());
-#endif
-                    connection->inputPublisherBlocked = true;
+        // Publish the key event.
+        return connection->inputPublisher.publishKeyEvent(dispatchEntry->seq,
+                keyEntry->deviceId, keyEntry->source, keyEntry->displayId,
+                dispatchEntry->resolvedAction, dispatchEntry->resolvedFlags,
+                keyEntry->keyCode, keyEntry->scanCode,
+                keyEntry->metaState, keyEntry->repeatCount, keyEntry->downTime,
+                keyEntry->eventTime);
+    }
+
+    case EventEntry::TYPE_MOTION: {
+        MotionEntry* motionEntry = static_cast<MotionEntry*>(eventEntry);
+
+        PointerCoords scaledCoords[MAX_POINTERS];
+        const PointerCoords* usingCoords = motionEntry->pointerCoords;
+
+        // Set the X and Y offset depending on the input source.
+        float xOffset, yOffset;
+        if ((motionEntry->source & AINPUT_SOURCE_CLASS_POINTER)
+                && !(dispatchEntry->targetFlags & InputTarget::FLAG_ZERO_COORDS)) {
+            float globalScaleFactor = dispatchEntry->globalScaleFactor;
+            float wxs = dispatchEntry->windowXScale;
+            float wys = dispatchEntry->windowYScale;
+            xOffset = dispatchEntry->xOffset * wxs;
+            yOffset = dispatchEntry->yOffset * wys;
+            if (wxs != 1.0f || wys != 1.0f || globalScaleFactor != 1.0f) {
+                for (uint32_t i = 0; i < motionEntry->pointerCount; i++) {
+                    scaledCoords[i] = motionEntry->pointerCoords[i];
+                    scaledCoords[i].scale(globalScaleFactor, wxs, wys);
                 }
-            } else {
-                ALOGE("channel '%s' ~ Could not publish event due to an unexpected error, "
-                        "status=%d", connection->getInputChannelName().c_str(), status);
-                abortBrokenDispatchCycleLocked(currentTime, connection, true /*notify*/);
+                usingCoords = scaledCoords;
+            }
+        } else {
+            xOffset = 0.0f;
+            yOffset = 0.0f;
+
+            // We don't want the dispatch target to know.
+            if (dispatchEntry->targetFlags & InputTarget::FLAG_ZERO_COORDS) {
+                for (uint32_t i = 0; i < motionEntry->pointerCount; i++) {
+                    scaledCoords[i].clear();
+                }
+                usingCoords = scaledCoords;
             }
-            return;
         }
 
-        // Re-enqueue the event on the wait queue.
-        connection->outboundQueue.dequeue(dispatchEntry);
-        traceOutboundQueueLength(connection);
-        connection->waitQueue.enqueueAtTail(dispatchEntry);
-        traceWaitQueueLength(connection);
+        // Publish the motion event.
+        return connection->inputPublisher.publishMotionEvent(dispatchEntry->seq,
+                motionEntry->deviceId, motionEntry->source, motionEntry->displayId,
+                dispatchEntry->resolvedAction, motionEntry->actionButton,
+                dispatchEntry->resolvedFlags, motionEntry->edgeFlags,
+                motionEntry->metaState, motionEntry->buttonState, motionEntry->classification,
+                xOffset, yOffset, motionEntry->xPrecision, motionEntry->yPrecision,
+                motionEntry->downTime, motionEntry->eventTime,
+                motionEntry->pointerCount, motionEntry->pointerProperties,
+                usingCoords);
+    }
+
+    default:
+        ALOG_ASSERT(false);
+        return BAD_TYPE;
     }
 }
 
 void InputDispatcher::finishDispatchCycleLocked(nsecs_t currentTime,
-        const sp<Connection>& connection, uint32_t seq, bool handled) {
+        const sp<Connection>& connection, uint32_t seq, bool handled, nsecs_t consumeTime) {
 #if DEBUG_DISPATCH_CYCLE
     ALOGD("channel '%s' ~ finishDispatchCycle - seq=%u, handled=%s",
             connection->getInputChannelName().c_str(), seq, toString(handled));
@@ -2298,6 +2371,11 @@ void InputDispatcher::finishDispatchCycleLocked(nsecs_t currentTime,
         return;
     }
 
+    const DispatchEntry* dispatchEntry = connection->findWaitQueueEntry(seq);
+    if (dispatchEntry) {
+        connection->latencyStats.record(*dispatchEntry, consumeTime, currentTime);
+    }
+
     // Notify other system components and prepare to start the next dispatch cycle.
     onDispatchCycleFinishedLocked(currentTime, connection, seq, handled);
 }
@@ -2313,6 +2391,7 @@ void InputDispatcher::abortBrokenDispatchCycleLocked(nsecs_t currentTime,
     drainDispatchQueue(&connection->outboundQueue);
     traceOutboundQueueLength(connection);
     drainDispatchQueue(&connection->waitQueue);
+    connection->clearWaitQueueIndex();
     traceWaitQueueLength(connection);
 
     // The connection appears to be unrecoverably broken.
@@ -2369,11 +2448,13 @@ int InputDispatcher::handleReceiveCallback(int fd, int events, void* data) {
             for (;;) {
                 uint32_t seq;
                 bool handled;
-                status = connection->inputPublisher.receiveFinishedSignal(&seq, &handled);
+                nsecs_t consumeTime;
+                status = connection->inputPublisher.receiveFinishedSignal(&seq, &handled,
+                        &consumeTime);
                 if (status) {
                     break;
                 }
-                d->finishDispatchCycleLocked(currentTime, connection, seq, handled);
+                d->finishDispatchCycleLocked(currentTime, connection, seq, handled, consumeTime);
                 gotOne = true;
             }
             if (gotOne) {
@@ -2583,6 +2664,7 @@ InputDispatcher::splitMotionEvent(const MotionEntry* originalMotionEntry, BitSet
             originalMotionEntry->yPrecision,
             originalMotionEntry->downTime,
             splitPointerCount, splitPointerProperties, splitPointerCoords, 0, 0);
+    splitMotionEntry->enqueueTime = originalMotionEntry->enqueueTime;
 
     if (originalMotionEntry->injectionState) {
         splitMotionEntry->injectionState = originalMotionEntry->injectionState;
@@ -2597,18 +2679,7 @@ void InputDispatcher::notifyConfigurationChanged(const NotifyConfigurationChange
     ALOGD("notifyConfigurationChanged - eventTime=%" PRId64, args->eventTime);
 #endif
 
-    bool needWake;
-    { // acquire lock
-        std::scoped_lock _l(mLock);
-
-        ConfigurationChangedEntry* newEntry =
-                new ConfigurationChangedEntry(args->sequenceNum, args->eventTime);
-        needWake = enqueueInboundEventLocked(newEntry);
-    } // release lock
-
-    if (needWake) {
-        mLooper->wake();
-    }
+    postInboundEvent(new ConfigurationChangedEntry(args->sequenceNum, args->eventTime));
 }
 
 /**
@@ -2692,36 +2763,21 @@ void InputDispatcher::notifyKey(const NotifyKeyArgs* args) {
                 std::to_string(t.duration().count()).c_str());
     }
 
-    bool needWake;
-    { // acquire lock
-        mLock.lock();
-
-        if (shouldSendKeyToInputFilterLocked(args)) {
-            mLock.unlock();
-
-            policyFlags |= POLICY_FLAG_FILTERED;
-            if (!mPolicy->filterInputEvent(&event, policyFlags)) {
-                return; // event was consumed by the filter
-            }
-
-            mLock.lock();
+    if (shouldSendKeyToInputFilter(args)) {
+        policyFlags |= POLICY_FLAG_FILTERED;
+        if (!mPolicy->filterInputEvent(&event, policyFlags)) {
+            return; // event was consumed by the filter
         }
-
-        KeyEntry* newEntry = new KeyEntry(args->sequenceNum, args->eventTime,
-                args->deviceId, args->source, args->displayId, policyFlags,
-                args->action, flags, keyCode, args->scanCode,
-                metaState, repeatCount, args->downTime);
-
-        needWake = enqueueInboundEventLocked(newEntry);
-        mLock.unlock();
-    } // release lock
-
-    if (needWake) {
-        mLooper->wake();
     }
+
+    KeyEntry* newEntry = new KeyEntry(args->sequenceNum, args->eventTime,
+            args->deviceId, args->source, args->displayId, policyFlags,
+            args->action, flags, keyCode, args->scanCode,
+            metaState, repeatCount, args->downTime);
+    postInboundEvent(newEntry);
 }
 
-bool InputDispatcher::shouldSendKeyToInputFilterLocked(const NotifyKeyArgs* args) {
+bool InputDispatcher::shouldSendKeyToInputFilter(const NotifyKeyArgs* args) {
     return mInputFilterEnabled;
 }
 
@@ -2767,47 +2823,32 @@ void InputDispatcher::notifyMotion(const NotifyMotionArgs* args) {
                 std::to_string(t.duration().count()).c_str());
     }
 
-    bool needWake;
-    { // acquire lock
-        mLock.lock();
+    if (shouldSendMotionToInputFilter(args)) {
+        MotionEvent event;
+        event.initialize(args->deviceId, args->source, args->displayId,
+                args->action, args->actionButton,
+                args->flags, args->edgeFlags, args->metaState, args->buttonState,
+                args->classification, 0, 0, args->xPrecision, args->yPrecision,
+                args->downTime, args->eventTime,
+                args->pointerCount, args->pointerProperties, args->pointerCoords);
 
-        if (shouldSendMotionToInputFilterLocked(args)) {
-            mLock.unlock();
-
-            MotionEvent event;
-            event.initialize(args->deviceId, args->source, args->displayId,
-                    args->action, args->actionButton,
-                    args->flags, args->edgeFlags, args->metaState, args->buttonState,
-                    args->classification, 0, 0, args->xPrecision, args->yPrecision,
-                    args->downTime, args->eventTime,
-                    args->pointerCount, args->pointerProperties, args->pointerCoords);
-
-            policyFlags |= POLICY_FLAG_FILTERED;
-            if (!mPolicy->filterInputEvent(&event, policyFlags)) {
-                return; // event was consumed by the filter
-            }
-
-            mLock.lock();
+        policyFlags |= POLICY_FLAG_FILTERED;
+        if (!mPolicy->filterInputEvent(&event, policyFlags)) {
+            return; // event was consumed by the filter
         }
-
-        // Just enqueue a new motion event.
-        MotionEntry* newEntry = new MotionEntry(args->sequenceNum, args->eventTime,
-                args->deviceId, args->source, args->displayId, policyFlags,
-                args->action, args->actionButton, args->flags,
-                args->metaState, args->buttonState, args->classification,
-                args->edgeFlags, args->xPrecision, args->yPrecision, args->downTime,
-                args->pointerCount, args->pointerProperties, args->pointerCoords, 0, 0);
-
-        needWake = enqueueInboundEventLocked(newEntry);
-        mLock.unlock();
-    } // release lock
-
-    if (needWake) {
-        mLooper->wake();
     }
+
+    // Just enqueue a new motion event.
+    MotionEntry* newEntry = new MotionEntry(args->sequenceNum, args->eventTime,
+            args->deviceId, args->source, args->displayId, policyFlags,
+            args->action, args->actionButton, args->flags,
+            args->metaState, args->buttonState, args->classification,
+            args->edgeFlags, args->xPrecision, args->yPrecision, args->downTime,
+            args->pointerCount, args->pointerProperties, args->pointerCoords, 0, 0);
+    postInboundEvent(newEntry);
 }
 
-bool InputDispatcher::shouldSendMotionToInputFilterLocked(const NotifyMotionArgs* args) {
+bool InputDispatcher::shouldSendMotionToInputFilter(const NotifyMotionArgs* args) {
     return mInputFilterEnabled;
 }
 
@@ -2830,18 +2871,7 @@ void InputDispatcher::notifyDeviceReset(const NotifyDeviceResetArgs* args) {
             args->eventTime, args->deviceId);
 #endif
 
-    bool needWake;
-    { // acquire lock
-        std::scoped_lock _l(mLock);
-
-        DeviceResetEntry* newEntry =
-                new DeviceResetEntry(args->sequenceNum, args->eventTime, args->deviceId);
-        needWake = enqueueInboundEventLocked(newEntry);
-    } // release lock
-
-    if (needWake) {
-        mLooper->wake();
-    }
+    postInboundEvent(new DeviceResetEntry(args->sequenceNum, args->eventTime, args->deviceId));
 }
 
 int32_t InputDispatcher::injectInputEvent(const InputEvent* event,
@@ -3100,8 +3130,10 @@ void InputDispatcher::decrementPendingForegroundDispatches(EventEntry* entry) {
     }
 }
 
-std::vector<sp<InputWindowHandle>> InputDispatcher::getWindowHandlesLocked(
+const std::vector<sp<InputWindowHandle>>& InputDispatcher::getWindowHandlesLocked(
         int32_t displayId) const {
+    static const std::vector<sp<InputWindowHandle>> EMPTY_WINDOW_HANDLES;
+
     std::unordered_map<int32_t, std::vector<sp<InputWindowHandle>>>::const_iterator it =
             mWindowHandlesByDisplay.find(displayId);
     if(it != mWindowHandlesByDisplay.end()) {
@@ -3109,7 +3141,100 @@ std::vector<sp<InputWindowHandle>> InputDispatcher::getWindowHandlesLocked(
     }
 
     // Return an empty one if nothing found.
-    return std::vector<sp<InputWindowHandle>>();
+    return EMPTY_WINDOW_HANDLES;
+}
+
+void InputDispatcher::WindowHitIndex::build(
+        const std::vector<sp<InputWindowHandle>>& windowHandles) {
+    mCells.clear();
+    mTouchAnywhere.clear();
+    mIndices.clear();
+
+    // Each window is bucketed by the bounds of its frame and touchable region together.
+    std::vector<Rect> windowBounds;
+    windowBounds.reserve(windowHandles.size());
+    bool haveBounds = false;
+    for (size_t i = 0; i < windowHandles.size(); i++) {
+        const InputWindowInfo* info = windowHandles[i]->getInfo();
+        mIndices[windowHandles[i].get()] = i;
+
+        Rect bounds = info->touchableRegion.getBounds();
+        if (info->frameRight > info->frameLeft && info->frameBottom > info->frameTop) {
+            if (bounds.isEmpty()) {
+                bounds = Rect(info->frameLeft, info->frameTop, info->frameRight,
+                        info->frameBottom);
+            } else {
+                bounds = Rect(std::min(bounds.left, info->frameLeft),
+                        std::min(bounds.top, info->frameTop),
+                        std::max(bounds.right, info->frameRight),
+                        std::max(bounds.bottom, info->frameBottom));
+            }
+        }
+        windowBounds.push_back(bounds);
+        if (!bounds.isEmpty()) {
+            mLeft = haveBounds ? std::min(mLeft, bounds.left) : bounds.left;
+            mTop = haveBounds ? std::min(mTop, bounds.top) : bounds.top;
+            mRight = haveBounds ? std::max(mRight, bounds.right) : bounds.right;
+            mBottom = haveBounds ? std::max(mBottom, bounds.bottom) : bounds.bottom;
+            haveBounds = true;
+        }
+
+        int32_t flags = info->layoutParamsFlags;
+        bool isTouchModal = !(flags & InputWindowInfo::FLAG_NOT_TOUCHABLE)
+                && (flags & (InputWindowInfo::FLAG_NOT_FOCUSABLE
+                        | InputWindowInfo::FLAG_NOT_TOUCH_MODAL)) == 0;
+        if (isTouchModal || (flags & InputWindowInfo::FLAG_WATCH_OUTSIDE_TOUCH)) {
+            mTouchAnywhere.push_back(i);
+        }
+    }
+    if (!haveBounds) {
+        return;
+    }
+
+    mCellWidth = (int64_t(mRight) - mLeft + GRID_SIZE - 1) / GRID_SIZE;
+    mCellHeight = (int64_t(mBottom) - mTop + GRID_SIZE - 1) / GRID_SIZE;
+    mCells.resize(GRID_SIZE * GRID_SIZE);
+    for (size_t i = 0; i < windowBounds.size(); i++) {
+        const Rect& bounds = windowBounds[i];
+        if (bounds.isEmpty()) {
+            continue;
+        }
+        const int64_t left = (int64_t(bounds.left) - mLeft) / mCellWidth;
+        const int64_t right = (int64_t(bounds.right) - 1 - mLeft) / mCellWidth;
+        const int64_t top = (int64_t(bounds.top) - mTop) / mCellHeight;
+        const int64_t bottom = (int64_t(bounds.bottom) - 1 - mTop) / mCellHeight;
+        for (int64_t y = top; y <= bottom; y++) {
+            for (int64_t x = left; x <= right; x++) {
+                mCells[y * GRID_SIZE + x].push_back(i);
+            }
+        }
+    }
+}
+
+void InputDispatcher::WindowHitIndex::getTouchCandidates(int32_t x, int32_t y,
+        std::vector<size_t>* outIndices) const {
+    const std::vector<size_t>& cell = getCell(x, y);
+    outIndices->clear();
+    outIndices->reserve(cell.size() + mTouchAnywhere.size());
+    std::set_union(cell.begin(), cell.end(), mTouchAnywhere.begin(), mTouchAnywhere.end(),
+            std::back_inserter(*outIndices));
+}
+
+const std::vector<size_t>& InputDispatcher::WindowHitIndex::getCell(int32_t x, int32_t y) const {
+    static const std::vector<size_t> EMPTY_CELL;
+
+    if (mCells.empty() || x < mLeft || x >= mRight || y < mTop || y >= mBottom) {
+        return EMPTY_CELL;
+    }
+    const int64_t cellX = (int64_t(x) - mLeft) / mCellWidth;
+    const int64_t cellY = (int64_t(y) - mTop) / mCellHeight;
+    return mCells[cellY * GRID_SIZE + cellX];
+}
+
+ssize_t InputDispatcher::WindowHitIndex::indexOf(
+        const sp<InputWindowHandle>& windowHandle) const {
+    auto it = mIndices.find(windowHandle.get());
+    return it != mIndices.end() ? ssize_t(it->second) : -1;
 }
 
 sp<InputWindowHandle> InputDispatcher::getWindowHandleLocked(
@@ -3176,6 +3301,7 @@ void InputDispatcher::setInputWindows(const std::vector<sp<InputWindowHandle>>&
         if (inputWindowHandles.empty()) {
             // Remove all handles on a display if there are no windows left.
             mWindowHandlesByDisplay.erase(displayId);
+            mWindowHitIndexByDisplay.erase(displayId);
         } else {
             // Since we compare the pointer of input window handles across window updates, we need
             // to make sure the handle object for the same window stays unchanged across updates.
@@ -3237,6 +3363,7 @@ void InputDispatcher::setInputWindows(const std::vector<sp<InputWindowHandle>>&
 
             // Insert or replace
             mWindowHandlesByDisplay[displayId] = newHandles;
+            mWindowHitIndexByDisplay[displayId].build(newHandles);
         }
 
         if (!foundHoveredWindow) {
@@ -3587,7 +3714,7 @@ void InputDispatcher::logDispatchStateLocked() {
 void InputDispatcher::dumpDispatchStateLocked(std::string& dump) {
     dump += StringPrintf(INDENT "DispatchEnabled: %s\n", toString(mDispatchEnabled));
     dump += StringPrintf(INDENT "DispatchFrozen: %s\n", toString(mDispatchFrozen));
-    dump += StringPrintf(INDENT "InputFilterEnabled: %s\n", toString(mInputFilterEnabled));
+    dump += StringPrintf(INDENT "InputFilterEnabled: %s\n", toString(mInputFilterEnabled.load()));
     dump += StringPrintf(INDENT "FocusedDisplayId: %" PRId32 "\n", mFocusedDisplayId);
 
     if (!mFocusedApplicationHandlesByDisplay.empty()) {
@@ -3800,6 +3927,8 @@ void InputDispatcher::dumpDispatchStateLocked(std::string& dump) {
             } else {
                 dump += INDENT3 "WaitQueue: <empty>\n";
             }
+
+            connection->latencyStats.dump(dump);
         }
     } else {
         dump += INDENT "Connections: <none>\n";
@@ -4225,7 +4354,7 @@ void InputDispatcher::doDispatchCycleFinishedLockedInterruptible(
         // contents of the wait queue to have been drained, so we need to double-check
         // a few things.
         if (dispatchEntry == connection->findWaitQueueEntry(seq)) {
-            connection->waitQueue.dequeue(dispatchEntry);
+            connection->dequeueWaitQueueEntry(dispatchEntry);
             traceWaitQueueLength(connection);
             if (restartEvent && connection->status == Connection::STATUS_NORMAL) {
                 connection->outboundQueue.enqueueAtHead(dispatchEntry);
@@ -4528,7 +4657,8 @@ void InputDispatcher::InjectionState::release() {
 InputDispatcher::EventEntry::EventEntry(uint32_t sequenceNum, int32_t type,
         nsecs_t eventTime, uint32_t policyFlags) :
         sequenceNum(sequenceNum), refCount(1), type(type), eventTime(eventTime),
-        policyFlags(policyFlags), injectionState(nullptr), dispatchInProgress(false) {
+        enqueueTime(now()), policyFlags(policyFlags), injectionState(nullptr),
+        dispatchInProgress(false) {
 }
 
 InputDispatcher::EventEntry::~EventEntry() {
@@ -5077,12 +5207,72 @@ const char* InputDispatcher::Connection::getStatusLabel() const {
 }
 
 InputDispatcher::DispatchEntry* InputDispatcher::Connection::findWaitQueueEntry(uint32_t seq) {
-    for (DispatchEntry* entry = waitQueue.head; entry != nullptr; entry = entry->next) {
-        if (entry->seq == seq) {
-            return entry;
-        }
+    auto it = waitQueueBySeq.find(seq);
+    return it != waitQueueBySeq.end() ? it->second : nullptr;
+}
+
+void InputDispatcher::Connection::enqueueWaitQueueEntry(DispatchEntry* entry) {
+    waitQueue.enqueueAtTail(entry);
+    waitQueueBySeq[entry->seq] = entry;
+}
+
+void InputDispatcher::Connection::dequeueWaitQueueEntry(DispatchEntry* entry) {
+    waitQueue.dequeue(entry);
+    waitQueueBySeq.erase(entry->seq);
+}
+
+void InputDispatcher::Connection::clearWaitQueueIndex() {
+    waitQueueBySeq.clear();
+}
+
+// --- InputDispatcher::LatencyHistogram ---
+
+void InputDispatcher::LatencyHistogram::record(nsecs_t latency) {
+    latency = std::max(latency, nsecs_t(0));
+    size_t bucket = 0;
+    for (nsecs_t limit = 1000000LL; bucket < BUCKET_COUNT - 1 && latency >= limit; limit *= 2) {
+        bucket++;
     }
-    return nullptr;
+    buckets[bucket] += 1;
+    count += 1;
+    total += latency;
+    max = std::max(max, latency);
+}
+
+void InputDispatcher::LatencyHistogram::dump(std::string& dump, const char* name) const {
+    dump += StringPrintf(INDENT4 "%s: count=%" PRIu32 ", mean=%0.1fms, max=%0.1fms, buckets=[",
+            name, count, count ? total * 0.000001f / count : 0.f, max * 0.000001f);
+    for (size_t i = 0; i < BUCKET_COUNT; i++) {
+        dump += StringPrintf(i ? ", %" PRIu32 : "%" PRIu32, buckets[i]);
+    }
+    dump += "]\n";
+}
+
+// --- InputDispatcher::LatencyStats ---
+
+void InputDispatcher::LatencyStats::record(const DispatchEntry& dispatchEntry,
+        nsecs_t consumeTime, nsecs_t finishTime) {
+    const EventEntry& eventEntry = *dispatchEntry.eventEntry;
+    eventToEnqueue.record(eventEntry.enqueueTime - eventEntry.eventTime);
+    enqueueToPublish.record(dispatchEntry.deliveryTime - eventEntry.enqueueTime);
+    if (consumeTime != 0) {
+        publishToConsume.record(consumeTime - dispatchEntry.deliveryTime);
+        consumeToFinish.record(finishTime - consumeTime);
+    }
+    eventToFinish.record(finishTime - eventEntry.eventTime);
+}
+
+void InputDispatcher::LatencyStats::dump(std::string& dump) const {
+    if (eventToFinish.count == 0) {
+        dump += INDENT3 "Latency: <no finished events>\n";
+        return;
+    }
+    dump += INDENT3 "Latency (buckets <1, <2, <4, ... <128, >=128ms):\n";
+    eventToEnqueue.dump(dump, "EventToEnqueue");
+    enqueueToPublish.dump(dump, "EnqueueToPublish");
+    publishToConsume.dump(dump, "PublishToConsume");
+    consumeToFinish.dump(dump, "ConsumeToFinish");
+    eventToFinish.dump(dump, "EventToFinish");
 }
 
 // --- InputDispatcher::Monitor
@@ -17,7 +17,9 @@
 #ifndef _UI_INPUT_DISPATCHER_H
 #define _UI_INPUT_DISPATCHER_H
 
+#include <atomic>
 #include <condition_variable>
+#include <mutex>
 #include <input/Input.h>
 #include <input/InputApplication.h>
 #include <input/InputTransport.h>
@@ -459,6 +461,42 @@ private:
         inline Link() : next(nullptr), prev(nullptr) { }
     };
 
+    // Keeps the memory of up to Capacity freed entries of one type for the next ones, so that
+    // steady-state dispatch does not go back to the heap for every event. Entries are created
+    // on the reader and binder threads as well as the dispatcher thread, hence the lock.
+    template <typename T, size_t Capacity>
+    class EntryPool {
+    public:
+        static void* allocate(size_t size) {
+            if (size == sizeof(T)) {
+                std::scoped_lock _l(sLock);
+                if (sFreeCount > 0) {
+                    return sFree[--sFreeCount];
+                }
+            }
+            return ::operator new(size);
+        }
+
+        static void deallocate(void* ptr, size_t size) {
+            if (ptr == nullptr) {
+                return;
+            }
+            if (size == sizeof(T)) {
+                std::scoped_lock _l(sLock);
+                if (sFreeCount < Capacity) {
+                    sFree[sFreeCount++] = ptr;
+                    return;
+                }
+            }
+            ::operator delete(ptr);
+        }
+
+    private:
+        static inline std::mutex sLock;
+        static inline void* sFree[Capacity] GUARDED_BY(sLock);
+        static inline size_t sFreeCount GUARDED_BY(sLock) = 0;
+    };
+
     struct InjectionState {
         mutable int32_t refCount;
 
@@ -487,6 +525,7 @@ private:
         mutable int32_t refCount;
         int32_t type;
         nsecs_t eventTime;
+        nsecs_t enqueueTime; // when the event reached the dispatcher
         uint32_t policyFlags;
         InjectionState* injectionState;
 
@@ -552,8 +591,14 @@ private:
         virtual void appendDescription(std::string& msg) const;
         void recycle();
 
+        static void* operator new(size_t size) { return Pool::allocate(size); }
+        static void operator delete(void* ptr, size_t size) { Pool::deallocate(ptr, size); }
+
     protected:
         virtual ~KeyEntry();
+
+    private:
+        using Pool = EntryPool<KeyEntry, 16>;
     };
 
     struct MotionEntry : EventEntry {
@@ -585,8 +630,15 @@ private:
                 float xOffset, float yOffset);
         virtual void appendDescription(std::string& msg) const;
 
+        static void* operator new(size_t size) { return Pool::allocate(size); }
+        static void operator delete(void* ptr, size_t size) { Pool::deallocate(ptr, size); }
+
     protected:
         virtual ~MotionEntry();
+
+    private:
+        // Each motion event is usually split or copied for a few targets
+        using Pool = EntryPool<MotionEntry, 32>;
     };
 
     // Tracks the progress of dispatching a particular event to a particular connection.
@@ -619,7 +671,13 @@ private:
             return targetFlags & InputTarget::FLAG_SPLIT;
         }
 
+        static void* operator new(size_t size) { return Pool::allocate(size); }
+        static void operator delete(void* ptr, size_t size) { Pool::deallocate(ptr, size); }
+
     private:
+        // Dispatch entries stay on a connection's wait queue until the app finishes them
+        using Pool = EntryPool<DispatchEntry, 64>;
+
         static volatile int32_t sNextSeqAtomic;
 
         static uint32_t nextSeq();
@@ -856,6 +914,32 @@ private:
                 const CancelationOptions& options);
     };
 
+    // Counts latencies in buckets of doubling width, from under 1ms to 128ms and over.
+    struct LatencyHistogram {
+        static constexpr size_t BUCKET_COUNT = 9;
+
+        uint32_t buckets[BUCKET_COUNT] = {};
+        uint32_t count = 0;
+        nsecs_t total = 0;
+        nsecs_t max = 0;
+
+        void record(nsecs_t latency);
+        void dump(std::string& dump, const char* name) const;
+    };
+
+    // How long the events finished by a connection took in each stage on their way to it.
+    struct LatencyStats {
+        LatencyHistogram eventToEnqueue;   // read by EventHub and cooked by InputReader
+        LatencyHistogram enqueueToPublish; // dispatcher queues
+        LatencyHistogram publishToConsume; // input channel, until the app consumed the event
+        LatencyHistogram consumeToFinish;  // app handling
+        LatencyHistogram eventToFinish;    // the whole way, until the dispatcher got the finish
+
+        // consumeTime is 0 if the consumer did not report it
+        void record(const DispatchEntry& dispatchEntry, nsecs_t consumeTime, nsecs_t finishTime);
+        void dump(std::string& dump) const;
+    };
+
     /* Manages the dispatch state associated with a single input channel. */
     class Connection : public RefBase {
     protected:
@@ -886,8 +970,11 @@ private:
 
         // Queue of events that have been published to the connection but that have not
         // yet received a "finished" response from the application.
+        // Modified through the methods below, which keep waitQueueBySeq in sync with it.
         Queue<DispatchEntry> waitQueue;
 
+        LatencyStats latencyStats;
+
         explicit Connection(const sp<InputChannel>& inputChannel, bool monitor);
 
         inline const std::string getInputChannelName() const { return inputChannel->getName(); }
@@ -896,6 +983,14 @@ private:
         const char* getStatusLabel() const;
 
         DispatchEntry* findWaitQueueEntry(uint32_t seq);
+        void enqueueWaitQueueEntry(DispatchEntry* entry);
+        void dequeueWaitQueueEntry(DispatchEntry* entry);
+        void clearWaitQueueIndex();
+
+    private:
+        // The entries of the wait queue by sequence number, so that finishing an event doesn't
+        // walk the queue, which backs up when the application stops responding.
+        std::unordered_map<uint32_t, DispatchEntry*> waitQueueBySeq;
     };
 
     struct Monitor {
@@ -924,6 +1019,9 @@ private:
 
     EventEntry* mPendingEvent GUARDED_BY(mLock);
     Queue<EventEntry> mInboundQueue GUARDED_BY(mLock);
+    // Events notified by the reader, newest first, which have yet to be moved onto
+    // mInboundQueue. Pushing onto it does not take mLock.
+    std::atomic<EventEntry*> mPostedInboundEvents{nullptr};
     Queue<EventEntry> mRecentQueue GUARDED_BY(mLock);
     Queue<CommandEntry> mCommandQueue GUARDED_BY(mLock);
 
@@ -933,6 +1031,12 @@ private:
 
     // Enqueues an inbound event.  Returns true if mLooper->wake() should be called.
     bool enqueueInboundEventLocked(EventEntry* entry) REQUIRES(mLock);
+    // Hands an inbound event to the dispatcher thread without taking mLock, waking it if
+    // nothing else was posted since it last looked.
+    void postInboundEvent(EventEntry* entry) EXCLUDES(mLock);
+    // Enqueues every posted inbound event, oldest first.  Returns true if mLooper->wake()
+    // should be called.
+    bool enqueuePostedInboundEventsLocked() REQUIRES(mLock);
 
     // Cleans up input state when dropping an inbound event.
     void dropInboundEventLocked(EventEntry* entry, DropReason dropReason) REQUIRES(mLock);
@@ -1028,8 +1132,8 @@ private:
     CommandEntry* postCommandLocked(Command command) REQUIRES(mLock);
 
     // Input filter processing.
-    bool shouldSendKeyToInputFilterLocked(const NotifyKeyArgs* args) REQUIRES(mLock);
-    bool shouldSendMotionToInputFilterLocked(const NotifyMotionArgs* args) REQUIRES(mLock);
+    bool shouldSendKeyToInputFilter(const NotifyKeyArgs* args);
+    bool shouldSendMotionToInputFilter(const NotifyMotionArgs* args);
 
     // Inbound event processing.
     void drainInboundQueueLocked() REQUIRES(mLock);
@@ -1039,13 +1143,49 @@ private:
     // Dispatch state.
     bool mDispatchEnabled GUARDED_BY(mLock);
     bool mDispatchFrozen GUARDED_BY(mLock);
-    bool mInputFilterEnabled GUARDED_BY(mLock);
+    // Only changed with mLock held, but read without it when events are notified
+    std::atomic<bool> mInputFilterEnabled;
 
     std::unordered_map<int32_t, std::vector<sp<InputWindowHandle>>> mWindowHandlesByDisplay
             GUARDED_BY(mLock);
     // Get window handles by display, return an empty vector if not found.
-    std::vector<sp<InputWindowHandle>> getWindowHandlesLocked(int32_t displayId) const
+    const std::vector<sp<InputWindowHandle>>& getWindowHandlesLocked(int32_t displayId) const
             REQUIRES(mLock);
+
+    // Buckets the windows of a display by the cells of a coarse grid over their frames and
+    // touchable regions, so hit tests only look at the windows which can contain the point.
+    // Windows are referred to by their index in the display's window handles, front to back.
+    class WindowHitIndex {
+    public:
+        void build(const std::vector<sp<InputWindowHandle>>& windowHandles);
+
+        // Fills outIndices with every window which may be touched at the point, front to back.
+        // Touch modal windows and ones watching outside touches can be touched anywhere and are
+        // always included.
+        void getTouchCandidates(int32_t x, int32_t y, std::vector<size_t>* outIndices) const;
+
+        // Indices of the windows whose frame or touchable region may contain the point
+        const std::vector<size_t>& getCell(int32_t x, int32_t y) const;
+
+        // The index of the window, or -1 if it is not on the display
+        ssize_t indexOf(const sp<InputWindowHandle>& windowHandle) const;
+
+    private:
+        static constexpr int32_t GRID_SIZE = 8;
+
+        // Bounds of the grid, covering every window
+        int32_t mLeft = 0;
+        int32_t mTop = 0;
+        int32_t mRight = 0;
+        int32_t mBottom = 0;
+        int64_t mCellWidth = 1;
+        int64_t mCellHeight = 1;
+        std::vector<std::vector<size_t>> mCells;
+        std::vector<size_t> mTouchAnywhere;
+        std::unordered_map<const InputWindowHandle*, size_t> mIndices;
+    };
+    std::unordered_map<int32_t, WindowHitIndex> mWindowHitIndexByDisplay GUARDED_BY(mLock);
+
     sp<InputWindowHandle> getWindowHandleLocked(const sp<IBinder>& windowHandleToken) const
             REQUIRES(mLock);
     sp<InputChannel> getInputChannelLocked(const sp<IBinder>& windowToken) const REQUIRES(mLock);
@@ -1206,8 +1346,10 @@ private:
             REQUIRES(mLock);
     void startDispatchCycleLocked(nsecs_t currentTime, const sp<Connection>& connection)
             REQUIRES(mLock);
+    status_t publishDispatchEntryLocked(const sp<Connection>& connection,
+            DispatchEntry* dispatchEntry) REQUIRES(mLock);
     void finishDispatchCycleLocked(nsecs_t currentTime, const sp<Connection>& connection,
-            uint32_t seq, bool handled) REQUIRES(mLock);
+            uint32_t seq, bool handled, nsecs_t consumeTime) REQUIRES(mLock);
     void abortBrokenDispatchCycleLocked(nsecs_t currentTime, const sp<Connection>& connection,
             bool notify) REQUIRES(mLock);
     void drainDispatchQueue(Queue<DispatchEntry>* queue);
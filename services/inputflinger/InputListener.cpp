@@ -94,7 +94,7 @@ NotifyMotionArgs::NotifyMotionArgs(uint32_t sequenceNum, nsecs_t eventTime, int3
         int32_t edgeFlags, uint32_t deviceTimestamp, uint32_t pointerCount,
         const PointerProperties* pointerProperties, const PointerCoords* pointerCoords,
         float xPrecision, float yPrecision, nsecs_t downTime,
-        const std::vector<TouchVideoFrame>& videoFrames) :
+        std::vector<TouchVideoFrame> videoFrames) :
         NotifyArgs(sequenceNum, eventTime), deviceId(deviceId), source(source),
         displayId(displayId), policyFlags(policyFlags),
         action(action), actionButton(actionButton),
@@ -102,7 +102,7 @@ NotifyMotionArgs::NotifyMotionArgs(uint32_t sequenceNum, nsecs_t eventTime, int3
         classification(classification), edgeFlags(edgeFlags), deviceTimestamp(deviceTimestamp),
         pointerCount(pointerCount),
         xPrecision(xPrecision), yPrecision(yPrecision), downTime(downTime),
-        videoFrames(videoFrames) {
+        videoFrames(std::move(videoFrames)) {
     for (uint32_t i = 0; i < pointerCount; i++) {
         this->pointerProperties[i].copyFrom(pointerProperties[i]);
         this->pointerCoords[i].copyFrom(pointerCoords[i]);
@@ -258,5 +258,23 @@ void QueuedInputListener::flush() {
     mArgsQueue.clear();
 }
 
+void QueuedInputListener::merge(QueuedInputListener* other, size_t since) {
+    std::vector<NotifyArgs*> merged;
+    merged.reserve(mArgsQueue.size() - since + other->mArgsQueue.size());
+    auto ours = mArgsQueue.begin() + since;
+    auto theirs = other->mArgsQueue.begin();
+    while (ours != mArgsQueue.end() || theirs != other->mArgsQueue.end()) {
+        if (theirs == other->mArgsQueue.end()
+                || (ours != mArgsQueue.end() && (*ours)->eventTime <= (*theirs)->eventTime)) {
+            merged.push_back(*ours++);
+        } else {
+            merged.push_back(*theirs++);
+        }
+    }
+    mArgsQueue.resize(since);
+    mArgsQueue.insert(mArgsQueue.end(), merged.begin(), merged.end());
+    other->mArgsQueue.clear();
+}
+
 
 } // namespace android
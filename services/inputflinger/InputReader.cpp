@@ -55,6 +55,7 @@
 #include <log/log.h>
 
 #include <android-base/stringprintf.h>
+#include <cutils/properties.h>
 #include <input/Keyboard.h>
 #include <input/VirtualKeyMap.h>
 #include <statslog.h>
@@ -278,6 +279,9 @@ InputReader::InputReader(const sp<EventHubInterface>& eventHub,
         mDisableVirtualKeysTimeout(LLONG_MIN), mNextTimeout(LLONG_MAX),
         mConfigurationChangesToRefresh(0) {
     mQueuedListener = new QueuedInputListener(listener);
+    if (property_get_bool("ro.input.reader_touch_worker", false /* default_value */)) {
+        mTouchWorker = std::make_unique<InputReaderWorker>(listener);
+    }
 
     { // acquire lock
         AutoMutex _l(mLock);
@@ -373,8 +377,16 @@ void InputReader::processEventsLocked(const RawEvent* rawEvents, size_t count) {
 #if DEBUG_RAW_EVENTS
             ALOGD("BatchSize: %zu Count: %zu", batchSize, count);
 #endif
-            processEventsForDeviceLocked(deviceId, rawEvent, batchSize);
+            if (!mTouchWorker) {
+                processEventsForDeviceLocked(deviceId, rawEvent, batchSize);
+            } else if (isTouchWorkerDeviceLocked(deviceId)) {
+                mTouchWorkerBatches.push_back({deviceId, rawEvent, batchSize});
+            } else {
+                mReaderBatches.push_back({deviceId, rawEvent, batchSize});
+            }
         } else {
+            // Devices come and go between batches, never while any are being processed
+            processBatchesLocked();
             switch (rawEvent->type) {
             case EventHubInterface::DEVICE_ADDED:
                 addDeviceLocked(rawEvent->when, rawEvent->deviceId);
@@ -393,6 +405,53 @@ void InputReader::processEventsLocked(const RawEvent* rawEvents, size_t count) {
         count -= batchSize;
         rawEvent += batchSize;
     }
+    processBatchesLocked();
+}
+
+bool InputReader::isTouchWorkerDeviceLocked(int32_t deviceId) const {
+    ssize_t deviceIndex = mDevices.indexOfKey(deviceId);
+    if (deviceIndex < 0) {
+        return false;
+    }
+    // Keyboards stay on the reader thread since they update the global meta state,
+    // which is computed from the state of every keyboard.
+    const uint32_t classes = mDevices.valueAt(deviceIndex)->getClasses();
+    return (classes & (INPUT_DEVICE_CLASS_TOUCH | INPUT_DEVICE_CLASS_EXTERNAL_STYLUS))
+            && !(classes & INPUT_DEVICE_CLASS_KEYBOARD);
+}
+
+void InputReader::processBatchesLocked() {
+    if (!mTouchWorkerBatches.empty()) {
+        const size_t queueSize = mQueuedListener->getQueueSize();
+        {
+            std::scoped_lock lock(mContextLock);
+            mProcessingBatches = true;
+        }
+        mTouchWorker->start([this]() {
+            for (const EventBatch& batch : mTouchWorkerBatches) {
+                processEventsForDeviceLocked(batch.deviceId, batch.rawEvents, batch.count);
+            }
+        });
+        for (const EventBatch& batch : mReaderBatches) {
+            processEventsForDeviceLocked(batch.deviceId, batch.rawEvents, batch.count);
+        }
+        mTouchWorker->wait();
+        {
+            std::scoped_lock lock(mContextLock);
+            mProcessingBatches = false;
+            if (mFadePointerPending) {
+                mFadePointerPending = false;
+                fadePointerLocked();
+            }
+        }
+        mQueuedListener->merge(mTouchWorker->getQueuedListener(), queueSize);
+    } else {
+        for (const EventBatch& batch : mReaderBatches) {
+            processEventsForDeviceLocked(batch.deviceId, batch.rawEvents, batch.count);
+        }
+    }
+    mReaderBatches.clear();
+    mTouchWorkerBatches.clear();
 }
 
 void InputReader::addDeviceLocked(nsecs_t when, int32_t deviceId) {
@@ -848,6 +907,7 @@ void InputReader::dump(std::string& dump) {
     dump += "\n";
 
     dump += "Input Reader State:\n";
+    dump += StringPrintf(INDENT "TouchWorker: %s\n", toString(mTouchWorker != nullptr));
 
     for (size_t i = 0; i < mDevices.size(); i++) {
         mDevices.valueAt(i)->dump(dump);
@@ -929,37 +989,49 @@ InputReader::ContextImpl::ContextImpl(InputReader* reader) :
 
 void InputReader::ContextImpl::updateGlobalMetaState() {
     // lock is already held by the input loop
+    std::scoped_lock lock(mReader->mContextLock);
     mReader->updateGlobalMetaStateLocked();
 }
 
 int32_t InputReader::ContextImpl::getGlobalMetaState() {
     // lock is already held by the input loop
+    std::scoped_lock lock(mReader->mContextLock);
     return mReader->getGlobalMetaStateLocked();
 }
 
 void InputReader::ContextImpl::disableVirtualKeysUntil(nsecs_t time) {
     // lock is already held by the input loop
+    std::scoped_lock lock(mReader->mContextLock);
     mReader->disableVirtualKeysUntilLocked(time);
 }
 
 bool InputReader::ContextImpl::shouldDropVirtualKey(nsecs_t now,
         InputDevice* device, int32_t keyCode, int32_t scanCode) {
     // lock is already held by the input loop
+    std::scoped_lock lock(mReader->mContextLock);
     return mReader->shouldDropVirtualKeyLocked(now, device, keyCode, scanCode);
 }
 
 void InputReader::ContextImpl::fadePointer() {
     // lock is already held by the input loop
+    std::scoped_lock lock(mReader->mContextLock);
+    if (mReader->mProcessingBatches) {
+        // The devices of the other thread may be using their pointer controllers
+        mReader->mFadePointerPending = true;
+        return;
+    }
     mReader->fadePointerLocked();
 }
 
 void InputReader::ContextImpl::requestTimeoutAtTime(nsecs_t when) {
     // lock is already held by the input loop
+    std::scoped_lock lock(mReader->mContextLock);
     mReader->requestTimeoutAtTimeLocked(when);
 }
 
 int32_t InputReader::ContextImpl::bumpGeneration() {
     // lock is already held by the input loop
+    std::scoped_lock lock(mReader->mContextLock);
     return mReader->bumpGenerationLocked();
 }
 
@@ -969,6 +1041,7 @@ void InputReader::ContextImpl::getExternalStylusDevices(std::vector<InputDeviceI
 }
 
 void InputReader::ContextImpl::dispatchExternalStylusState(const StylusState& state) {
+    std::scoped_lock lock(mReader->mContextLock);
     mReader->dispatchExternalStylusState(state);
 }
 
@@ -977,6 +1050,9 @@ InputReaderPolicyInterface* InputReader::ContextImpl::getPolicy() {
 }
 
 InputListenerInterface* InputReader::ContextImpl::getListener() {
+    if (mReader->mTouchWorker && mReader->mTouchWorker->isCurrentThread()) {
+        return mReader->mTouchWorker->getQueuedListener();
+    }
     return mReader->mQueuedListener.get();
 }
 
@@ -985,9 +1061,57 @@ EventHubInterface* InputReader::ContextImpl::getEventHub() {
 }
 
 uint32_t InputReader::ContextImpl::getNextSequenceNum() {
+    std::scoped_lock lock(mReader->mContextLock);
     return (mReader->mNextSequenceNum)++;
 }
 
+
+// --- InputReaderWorker ---
+
+InputReaderWorker::InputReaderWorker(const sp<InputListenerInterface>& listener) :
+        mQueuedListener(new QueuedInputListener(listener)),
+        mThread(&InputReaderWorker::threadMain, this) {
+}
+
+InputReaderWorker::~InputReaderWorker() {
+    {
+        std::scoped_lock lock(mLock);
+        mExiting = true;
+    }
+    mCondition.notify_all();
+    mThread.join();
+}
+
+void InputReaderWorker::start(std::function<void()> work) {
+    {
+        std::scoped_lock lock(mLock);
+        mWork = std::move(work);
+        mBusy = true;
+    }
+    mCondition.notify_all();
+}
+
+void InputReaderWorker::wait() {
+    std::unique_lock lock(mLock);
+    mCondition.wait(lock, [this]() { return !mBusy; });
+}
+
+void InputReaderWorker::threadMain() {
+    std::unique_lock lock(mLock);
+    for (;;) {
+        mCondition.wait(lock, [this]() { return mBusy || mExiting; });
+        if (mExiting) {
+            return;
+        }
+        std::function<void()> work = std::move(mWork);
+        lock.unlock();
+        work();
+        lock.lock();
+        mBusy = false;
+        mCondition.notify_all();
+    }
+}
+
 // --- InputDevice ---
 
 InputDevice::InputDevice(InputReaderContext* context, int32_t id, int32_t generation,
@@ -3263,6 +3387,12 @@ void TouchInputMapper::configure(nsecs_t when,
     if (!changes) { // first time only
         // Configure basic parameters.
         configureParameters();
+        if (!mParameters.velocityTrackerStrategy.empty()
+                && !mPointerGesture.velocityTracker.setStrategy(
+                        mParameters.velocityTrackerStrategy.c_str())) {
+            ALOGW("Invalid value for touch.velocityTracker.strategy: '%s'",
+                    mParameters.velocityTrackerStrategy.c_str());
+        }
 
         // Configure common accumulators.
         mCursorScrollAccumulator.configure(getDevice());
@@ -3397,6 +3527,15 @@ void TouchInputMapper::configureParameters() {
     mParameters.wake = getDevice()->isExternal();
     getDevice()->getConfiguration().tryGetProperty(String8("touch.wake"),
             mParameters.wake);
+
+    // Devices whose touch data suits another velocity tracker strategy, such as
+    // "impulse" for panels with sparse or duplicate samples, can name it here.
+    mParameters.velocityTrackerStrategy.clear();
+    String8 velocityTrackerStrategyString;
+    if (getDevice()->getConfiguration().tryGetProperty(String8("touch.velocityTracker.strategy"),
+            velocityTrackerStrategyString)) {
+        mParameters.velocityTrackerStrategy = velocityTrackerStrategyString.string();
+    }
 }
 
 void TouchInputMapper::dumpParameters(std::string& dump) {
@@ -3437,6 +3576,9 @@ void TouchInputMapper::dumpParameters(std::string& dump) {
             mParameters.uniqueDisplayId.c_str());
     dump += StringPrintf(INDENT4 "OrientationAware: %s\n",
             toString(mParameters.orientationAware));
+    dump += StringPrintf(INDENT4 "VelocityTrackerStrategy: %s\n",
+            mParameters.velocityTrackerStrategy.empty() ? "default"
+                    : mParameters.velocityTrackerStrategy.c_str());
 }
 
 void TouchInputMapper::configureRawPointerAxes() {
@@ -3686,6 +3828,7 @@ void TouchInputMapper::configureSurface(nsecs_t when, bool* outResetNeeded) {
         mYTranslate = -mSurfaceTop;
         mXPrecision = 1.0f / mXScale;
         mYPrecision = 1.0f / mYScale;
+        updateRawToSurfaceTransform();
 
         mOrientedRanges.x.axis = AMOTION_EVENT_AXIS_X;
         mOrientedRanges.x.source = mSource;
@@ -4276,6 +4419,56 @@ void TouchInputMapper::dumpAffineTransformation(std::string& dump) {
 void TouchInputMapper::updateAffineTransformation() {
     mAffineTransform = getPolicy()->getTouchAffineTransformation(mDevice->getDescriptor(),
             mSurfaceOrientation);
+    updateRawToSurfaceTransform();
+}
+
+void TouchInputMapper::updateRawToSurfaceTransform() {
+    // The surface transform maps calibrated raw coordinates onto the oriented surface.
+    float sxx = 0, sxy = 0, sx0 = 0, syx = 0, syy = 0, sy0 = 0;
+    switch (mSurfaceOrientation) {
+    case DISPLAY_ORIENTATION_90:
+        // x = (y - yMin) * yScale + yTranslate, y = (xMax - x) * xScale + xTranslate
+        sxy = mYScale;
+        sx0 = mYTranslate - mRawPointerAxes.y.minValue * mYScale;
+        syx = -mXScale;
+        sy0 = mRawPointerAxes.x.maxValue * mXScale + mXTranslate;
+        mSurfaceOrientationOffset = -M_PI_2;
+        break;
+    case DISPLAY_ORIENTATION_180:
+        // x = (xMax - x) * xScale, y = (yMax - y) * yScale + yTranslate
+        sxx = -mXScale;
+        sx0 = mRawPointerAxes.x.maxValue * mXScale;
+        syy = -mYScale;
+        sy0 = mRawPointerAxes.y.maxValue * mYScale + mYTranslate;
+        mSurfaceOrientationOffset = -M_PI;
+        break;
+    case DISPLAY_ORIENTATION_270:
+        // x = (yMax - y) * yScale, y = (x - xMin) * xScale + xTranslate
+        sxy = -mYScale;
+        sx0 = mRawPointerAxes.y.maxValue * mYScale;
+        syx = mXScale;
+        sy0 = mXTranslate - mRawPointerAxes.x.minValue * mXScale;
+        mSurfaceOrientationOffset = M_PI_2;
+        break;
+    default:
+        // x = (x - xMin) * xScale + xTranslate, y = (y - yMin) * yScale + yTranslate
+        sxx = mXScale;
+        sx0 = mXTranslate - mRawPointerAxes.x.minValue * mXScale;
+        syy = mYScale;
+        sy0 = mYTranslate - mRawPointerAxes.y.minValue * mYScale;
+        mSurfaceOrientationOffset = 0;
+        break;
+    }
+
+    // Apply the device calibration first.
+    const TouchAffineTransformation& a = mAffineTransform;
+    mRawToSurfaceTransform = TouchAffineTransformation(
+            sxx * a.x_scale + sxy * a.y_xmix,
+            sxx * a.x_ymix + sxy * a.y_scale,
+            sxx * a.x_offset + sxy * a.y_offset + sx0,
+            syx * a.x_scale + syy * a.y_xmix,
+            syx * a.x_ymix + syy * a.y_scale,
+            syx * a.x_offset + syy * a.y_offset + sy0);
 }
 
 void TouchInputMapper::reset(nsecs_t when) {
@@ -4992,8 +5185,20 @@ void TouchInputMapper::cookPointerData() {
         mCurrentCookedState.buttonState = mCurrentRawState.buttonState;
     }
 
-    // Walk through the the active pointers and map device coordinates onto
-    // surface coordinates and adjust for display orientation.
+    // Map the positions of all pointers onto the surface at once, applying the device
+    // calibration, scale and display orientation in one step.
+    float surfaceX[MAX_POINTERS];
+    float surfaceY[MAX_POINTERS];
+    const TouchAffineTransformation& transform = mRawToSurfaceTransform;
+    for (uint32_t i = 0; i < currentPointerCount; i++) {
+        const float rawX = mCurrentRawState.rawPointerData.pointers[i].x;
+        const float rawY = mCurrentRawState.rawPointerData.pointers[i].y;
+        surfaceX[i] = rawX * transform.x_scale + rawY * transform.x_ymix + transform.x_offset;
+        surfaceY[i] = rawX * transform.y_xmix + rawY * transform.y_scale + transform.y_offset;
+    }
+
+    // Walk through the the active pointers and cook the remaining axes, adjusting
+    // them for display orientation.
     for (uint32_t i = 0; i < currentPointerCount; i++) {
         const RawPointerData::Pointer& in = mCurrentRawState.rawPointerData.pointers[i];
 
@@ -5133,74 +5338,58 @@ void TouchInputMapper::cookPointerData() {
             distance = 0;
         }
 
-        // Coverage
-        int32_t rawLeft, rawTop, rawRight, rawBottom;
-        switch (mCalibration.coverageCalibration) {
-        case Calibration::COVERAGE_CALIBRATION_BOX:
-            rawLeft = (in.toolMinor & 0xffff0000) >> 16;
-            rawRight = in.toolMinor & 0x0000ffff;
-            rawBottom = in.toolMajor & 0x0000ffff;
-            rawTop = (in.toolMajor & 0xffff0000) >> 16;
-            break;
-        default:
-            rawLeft = rawTop = rawRight = rawBottom = 0;
-            break;
+        // Adjust the orientation for the display orientation.
+        if (mSurfaceOrientationOffset != 0) {
+            orientation += mSurfaceOrientationOffset;
+            if (mOrientedRanges.haveOrientation) {
+                const float range = mOrientedRanges.orientation.max
+                        - mOrientedRanges.orientation.min;
+                if (mSurfaceOrientationOffset < 0 && orientation < mOrientedRanges.orientation.min) {
+                    orientation += range;
+                } else if (mSurfaceOrientationOffset > 0
+                        && orientation > mOrientedRanges.orientation.max) {
+                    orientation -= range;
+                }
+            }
         }
 
-        // Adjust X,Y coords for device calibration
-        // TODO: Adjust coverage coords?
-        float xTransformed = in.x, yTransformed = in.y;
-        mAffineTransform.applyTo(xTransformed, yTransformed);
+        const float x = surfaceX[i];
+        const float y = surfaceY[i];
 
-        // Adjust X, Y, and coverage coords for surface orientation.
-        float x, y;
-        float left, top, right, bottom;
-
-        switch (mSurfaceOrientation) {
-        case DISPLAY_ORIENTATION_90:
-            x = float(yTransformed - mRawPointerAxes.y.minValue) * mYScale + mYTranslate;
-            y = float(mRawPointerAxes.x.maxValue - xTransformed) * mXScale + mXTranslate;
-            left = float(rawTop - mRawPointerAxes.y.minValue) * mYScale + mYTranslate;
-            right = float(rawBottom- mRawPointerAxes.y.minValue) * mYScale + mYTranslate;
-            bottom = float(mRawPointerAxes.x.maxValue - rawLeft) * mXScale + mXTranslate;
-            top = float(mRawPointerAxes.x.maxValue - rawRight) * mXScale + mXTranslate;
-            orientation -= M_PI_2;
-            if (mOrientedRanges.haveOrientation && orientation < mOrientedRanges.orientation.min) {
-                orientation += (mOrientedRanges.orientation.max - mOrientedRanges.orientation.min);
-            }
-            break;
-        case DISPLAY_ORIENTATION_180:
-            x = float(mRawPointerAxes.x.maxValue - xTransformed) * mXScale;
-            y = float(mRawPointerAxes.y.maxValue - yTransformed) * mYScale + mYTranslate;
-            left = float(mRawPointerAxes.x.maxValue - rawRight) * mXScale;
-            right = float(mRawPointerAxes.x.maxValue - rawLeft) * mXScale;
-            bottom = float(mRawPointerAxes.y.maxValue - rawTop) * mYScale + mYTranslate;
-            top = float(mRawPointerAxes.y.maxValue - rawBottom) * mYScale + mYTranslate;
-            orientation -= M_PI;
-            if (mOrientedRanges.haveOrientation && orientation < mOrientedRanges.orientation.min) {
-                orientation += (mOrientedRanges.orientation.max - mOrientedRanges.orientation.min);
-            }
-            break;
-        case DISPLAY_ORIENTATION_270:
-            x = float(mRawPointerAxes.y.maxValue - yTransformed) * mYScale;
-            y = float(xTransformed - mRawPointerAxes.x.minValue) * mXScale + mXTranslate;
-            left = float(mRawPointerAxes.y.maxValue - rawBottom) * mYScale;
-            right = float(mRawPointerAxes.y.maxValue - rawTop) * mYScale;
-            bottom = float(rawRight - mRawPointerAxes.x.minValue) * mXScale + mXTranslate;
-            top = float(rawLeft - mRawPointerAxes.x.minValue) * mXScale + mXTranslate;
-            orientation += M_PI_2;
-            if (mOrientedRanges.haveOrientation && orientation > mOrientedRanges.orientation.max) {
-                orientation -= (mOrientedRanges.orientation.max - mOrientedRanges.orientation.min);
+        // Coverage, adjusted for surface orientation.
+        // TODO: Adjust coverage coords for device calibration?
+        float left = 0, top = 0, right = 0, bottom = 0;
+        if (mCalibration.coverageCalibration == Calibration::COVERAGE_CALIBRATION_BOX) {
+            const int32_t rawLeft = (in.toolMinor & 0xffff0000) >> 16;
+            const int32_t rawRight = in.toolMinor & 0x0000ffff;
+            const int32_t rawBottom = in.toolMajor & 0x0000ffff;
+            const int32_t rawTop = (in.toolMajor & 0xffff0000) >> 16;
+            switch (mSurfaceOrientation) {
+            case DISPLAY_ORIENTATION_90:
+                left = float(rawTop - mRawPointerAxes.y.minValue) * mYScale + mYTranslate;
+                right = float(rawBottom- mRawPointerAxes.y.minValue) * mYScale + mYTranslate;
+                bottom = float(mRawPointerAxes.x.maxValue - rawLeft) * mXScale + mXTranslate;
+                top = float(mRawPointerAxes.x.maxValue - rawRight) * mXScale + mXTranslate;
+                break;
+            case DISPLAY_ORIENTATION_180:
+                left = float(mRawPointerAxes.x.maxValue - rawRight) * mXScale;
+                right = float(mRawPointerAxes.x.maxValue - rawLeft) * mXScale;
+                bottom = float(mRawPointerAxes.y.maxValue - rawTop) * mYScale + mYTranslate;
+                top = float(mRawPointerAxes.y.maxValue - rawBottom) * mYScale + mYTranslate;
+                break;
+            case DISPLAY_ORIENTATION_270:
+                left = float(mRawPointerAxes.y.maxValue - rawBottom) * mYScale;
+                right = float(mRawPointerAxes.y.maxValue - rawTop) * mYScale;
+                bottom = float(rawRight - mRawPointerAxes.x.minValue) * mXScale + mXTranslate;
+                top = float(rawLeft - mRawPointerAxes.x.minValue) * mXScale + mXTranslate;
+                break;
+            default:
+                left = float(rawLeft - mRawPointerAxes.x.minValue) * mXScale + mXTranslate;
+                right = float(rawRight - mRawPointerAxes.x.minValue) * mXScale + mXTranslate;
+                bottom = float(rawBottom - mRawPointerAxes.y.minValue) * mYScale + mYTranslate;
+                top = float(rawTop - mRawPointerAxes.y.minValue) * mYScale + mYTranslate;
+                break;
             }
-            break;
-        default:
-            x = float(xTransformed - mRawPointerAxes.x.minValue) * mXScale + mXTranslate;
-            y = float(yTransformed - mRawPointerAxes.y.minValue) * mYScale + mYTranslate;
-            left = float(rawLeft - mRawPointerAxes.x.minValue) * mXScale + mXTranslate;
-            right = float(rawRight - mRawPointerAxes.x.minValue) * mXScale + mXTranslate;
-            bottom = float(rawBottom - mRawPointerAxes.y.minValue) * mYScale + mYTranslate;
-            top = float(rawTop - mRawPointerAxes.y.minValue) * mYScale + mYTranslate;
-            break;
         }
 
         // Write output coords.
@@ -33,8 +33,13 @@
 #include <utils/Timers.h>
 #include <utils/BitSet.h>
 
+#include <condition_variable>
+#include <functional>
+#include <memory>
+#include <mutex>
 #include <optional>
 #include <stddef.h>
+#include <thread>
 #include <unistd.h>
 #include <vector>
 
@@ -101,6 +106,39 @@ public:
 };
 
 
+/* Runs part of the input reader's event processing on a thread of its own.
+ *
+ * The events the worker's devices produce are queued on a listener of its own, which the
+ * input reader merges with its own queue once the work is done.
+ */
+class InputReaderWorker {
+public:
+    explicit InputReaderWorker(const sp<InputListenerInterface>& listener);
+    ~InputReaderWorker();
+
+    // Starts running the work on the worker thread.
+    void start(std::function<void()> work);
+    // Waits for the work last started to finish.
+    void wait();
+
+    bool isCurrentThread() const { return std::this_thread::get_id() == mThread.get_id(); }
+    QueuedInputListener* getQueuedListener() const { return mQueuedListener.get(); }
+
+private:
+    sp<QueuedInputListener> mQueuedListener;
+
+    std::mutex mLock;
+    std::condition_variable mCondition;
+    std::function<void()> mWork; // guarded by mLock
+    bool mBusy = false; // guarded by mLock
+    bool mExiting = false; // guarded by mLock
+
+    std::thread mThread;
+
+    void threadMain();
+};
+
+
 /* The input reader reads raw event data from the event hub and processes it into input events
  * that it sends to the input listener.  Some functions of the input reader, such as early
  * event filtering in low power states, are controlled by a separate policy object.
@@ -199,6 +237,26 @@ private:
     // low-level input event decoding and device management
     void processEventsLocked(const RawEvent* rawEvents, size_t count);
 
+    // Touch devices are processed on a worker thread, while the other devices are processed
+    // on the reader thread, when ro.input.reader_touch_worker is set. A touch gesture then
+    // no longer holds up keys. mContextLock serializes the worker's calls into the context
+    // with the reader thread's. Fading the pointer reaches the mappers of every device, so
+    // while both threads are processing batches it is deferred until they are done.
+    struct EventBatch {
+        int32_t deviceId;
+        const RawEvent* rawEvents;
+        size_t count;
+    };
+    std::unique_ptr<InputReaderWorker> mTouchWorker;
+    std::vector<EventBatch> mReaderBatches;
+    std::vector<EventBatch> mTouchWorkerBatches;
+    std::recursive_mutex mContextLock;
+    bool mProcessingBatches = false; // guarded by mContextLock
+    bool mFadePointerPending = false; // guarded by mContextLock
+
+    bool isTouchWorkerDeviceLocked(int32_t deviceId) const;
+    void processBatchesLocked();
+
     void addDeviceLocked(nsecs_t when, int32_t deviceId);
     void removeDeviceLocked(nsecs_t when, int32_t deviceId);
     void processEventsForDeviceLocked(int32_t deviceId, const RawEvent* rawEvents, size_t count);
@@ -1092,6 +1150,9 @@ protected:
         GestureMode gestureMode;
 
         bool wake;
+
+        // Velocity tracker strategy for pointer gestures, empty for the platform default.
+        std::string velocityTrackerStrategy;
     } mParameters;
 
     // Immutable calibration parameters in parsed form.
@@ -1172,6 +1233,12 @@ protected:
     // Affine location transformation/calibration
     struct TouchAffineTransformation mAffineTransform;
 
+    // The affine calibration, scale, translation and orientation together, computed
+    // whenever one of them changes, so cooking maps each pointer with a single transform.
+    TouchAffineTransformation mRawToSurfaceTransform;
+    // How much the reported orientation of pointers is rotated by the surface orientation.
+    double mSurfaceOrientationOffset = 0;
+
     RawPointerAxes mRawPointerAxes;
 
     struct RawState {
@@ -1278,6 +1345,7 @@ protected:
     virtual void resolveCalibration();
     virtual void dumpCalibration(std::string& dump);
     virtual void updateAffineTransformation();
+    void updateRawToSurfaceTransform();
     virtual void dumpAffineTransformation(std::string& dump);
     virtual void resolveExternalStylusPresence();
     virtual bool hasStylus() const = 0;
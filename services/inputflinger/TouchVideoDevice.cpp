@@ -196,9 +196,12 @@ std::optional<TouchVideoFrame> TouchVideoDevice::readFrame() {
         ALOGW("The timestamp %ld.%ld was not acquired using CLOCK_MONOTONIC",
                 buf.timestamp.tv_sec, buf.timestamp.tv_usec);
     }
-    std::vector<int16_t> data(mHeight * mWidth);
+    // The frame is copied out of the driver's buffer, which must go back to the driver
+    // right away: there are only NUM_BUFFERS of them, while frames may wait in mFrames
+    // and then travel with a NotifyMotionArgs. The copy is the only one; frames share
+    // their data from here on.
     const int16_t* readFrom = mReadLocations[buf.index];
-    std::copy(readFrom, readFrom + mHeight * mWidth, data.begin());
+    std::vector<int16_t> data(readFrom, readFrom + mHeight * mWidth);
     TouchVideoFrame frame(mHeight, mWidth, std::move(data), buf.timestamp);
 
     result = ioctl(mFd.get(), VIDIOC_QBUF, &buf);
@@ -131,7 +131,7 @@ struct NotifyMotionArgs : public NotifyArgs {
             int32_t edgeFlags, uint32_t deviceTimestamp, uint32_t pointerCount,
             const PointerProperties* pointerProperties, const PointerCoords* pointerCoords,
             float xPrecision, float yPrecision, nsecs_t downTime,
-            const std::vector<TouchVideoFrame>& videoFrames);
+            std::vector<TouchVideoFrame> videoFrames);
 
     NotifyMotionArgs(const NotifyMotionArgs& other);
 
@@ -219,6 +219,16 @@ public:
 
     void flush();
 
+    // Number of args waiting to be flushed
+    size_t getQueueSize() const { return mArgsQueue.size(); }
+
+    /*
+     * Moves the args queued on another listener into this one, interleaving them by event
+     * time with the args this listener queued from position 'since' onwards. The order of
+     * the args within each of the two queues is kept.
+     */
+    void merge(QueuedInputListener* other, size_t since);
+
 private:
     sp<InputListenerInterface> mInnerListener;
     std::vector<NotifyArgs*> mArgsQueue;
@@ -0,0 +1,329 @@
+/*
+ * Copyright 2019 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "../EventHub.h"
+
+#include <dirent.h>
+#include <fcntl.h>
+#include <linux/uinput.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/ioctl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <chrono>
+#include <memory>
+#include <set>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <android-base/file.h>
+#include <android-base/test_utils.h>
+#include <android-base/unique_fd.h>
+#include <gtest/gtest.h>
+
+namespace android {
+
+using android::base::unique_fd;
+using namespace std::chrono_literals;
+
+static const char* DEVICE_NAME = "EventHub test keyboard";
+static constexpr uint16_t DEVICE_VENDOR = 0x1234;
+static constexpr uint16_t DEVICE_PRODUCT = 0x5678;
+static const char* CONFIGURATION_FILE_NAME = "Vendor_1234_Product_5678.idc";
+static constexpr size_t EVENT_BUFFER_SIZE = 256;
+static constexpr int EVENT_TIMEOUT_MS = 1000;
+
+// --- UinputKeyboard ---
+
+// A keyboard created through uinput, which EventHub opens like any other
+// evdev device. The devices made by one test share their name and ids.
+class UinputKeyboard {
+public:
+    bool create() {
+        mFd.reset(open("/dev/uinput", O_WRONLY | O_NONBLOCK | O_CLOEXEC));
+        if (mFd < 0) {
+            return false;
+        }
+        if (ioctl(mFd, UI_SET_EVBIT, EV_KEY) < 0) {
+            return false;
+        }
+        for (int key = KEY_ESC; key <= KEY_Z; key++) {
+            ioctl(mFd, UI_SET_KEYBIT, key);
+        }
+
+        struct uinput_user_dev device = {};
+        strlcpy(device.name, DEVICE_NAME, UINPUT_MAX_NAME_SIZE);
+        device.id.bustype = BUS_USB;
+        device.id.vendor = DEVICE_VENDOR;
+        device.id.product = DEVICE_PRODUCT;
+        if (write(mFd, &device, sizeof(device)) != sizeof(device)) {
+            return false;
+        }
+        return ioctl(mFd, UI_DEV_CREATE) == 0;
+    }
+
+    ~UinputKeyboard() {
+        if (mFd >= 0) {
+            ioctl(mFd, UI_DEV_DESTROY);
+        }
+    }
+
+private:
+    unique_fd mFd;
+};
+
+// --- EventHubTest ---
+
+class EventHubTest : public testing::Test {
+protected:
+    // Creates count keyboards, and waits for their device nodes to appear so
+    // that an EventHub made afterwards finds them in its initial scan.
+    void createKeyboards(size_t count) {
+        const size_t nodeCount = countDeviceNodes();
+        for (size_t i = 0; i < count; i++) {
+            mKeyboards.push_back(std::make_unique<UinputKeyboard>());
+            ASSERT_TRUE(mKeyboards.back()->create()) << "uinput: " << strerror(errno);
+        }
+        for (int i = 0; i < 100 && countDeviceNodes() < nodeCount + count; i++) {
+            std::this_thread::sleep_for(50ms);
+        }
+        ASSERT_GE(countDeviceNodes(), nodeCount + count);
+    }
+
+    // Reads events until the end of a device scan, and returns the ids of the
+    // devices added by this test.
+    std::vector<int32_t> readAddedKeyboards(EventHub* eventHub) {
+        std::vector<int32_t> deviceIds;
+        RawEvent buffer[EVENT_BUFFER_SIZE];
+        const auto deadline = std::chrono::steady_clock::now() + 5s;
+        while (std::chrono::steady_clock::now() < deadline) {
+            // The call that closes the devices for a reopen returns no events.
+            size_t count = eventHub->getEvents(EVENT_TIMEOUT_MS, buffer, EVENT_BUFFER_SIZE);
+            for (size_t i = 0; i < count; i++) {
+                const RawEvent& event = buffer[i];
+                if (event.type == EventHubInterface::FINISHED_DEVICE_SCAN) {
+                    return deviceIds;
+                }
+                if (event.type == EventHubInterface::DEVICE_ADDED &&
+                        eventHub->getDeviceIdentifier(event.deviceId).name == DEVICE_NAME) {
+                    deviceIds.push_back(event.deviceId);
+                }
+            }
+        }
+        ADD_FAILURE() << "Timed out waiting for the end of the device scan";
+        return deviceIds;
+    }
+
+    std::vector<std::unique_ptr<UinputKeyboard>> mKeyboards;
+
+private:
+    static size_t countDeviceNodes() {
+        size_t count = 0;
+        DIR* dir = opendir("/dev/input");
+        if (dir == nullptr) {
+            return 0;
+        }
+        while (struct dirent* entry = readdir(dir)) {
+            if (strncmp(entry->d_name, "event", 5) == 0) {
+                count++;
+            }
+        }
+        closedir(dir);
+        return count;
+    }
+};
+
+TEST_F(EventHubTest, AddsEveryDeviceFoundAtStartup) {
+    constexpr size_t keyboardCount = 8;
+    ASSERT_NO_FATAL_FAILURE(createKeyboards(keyboardCount));
+
+    sp<EventHub> eventHub = new EventHub();
+    std::vector<int32_t> deviceIds = readAddedKeyboards(eventHub.get());
+    ASSERT_EQ(keyboardCount, deviceIds.size());
+
+    std::set<int32_t> ids;
+    for (int32_t deviceId : deviceIds) {
+        EXPECT_TRUE(ids.insert(deviceId).second) << "Device " << deviceId << " added twice";
+        EXPECT_TRUE(eventHub->getDeviceClasses(deviceId) & INPUT_DEVICE_CLASS_KEYBOARD);
+        InputDeviceIdentifier identifier = eventHub->getDeviceIdentifier(deviceId);
+        EXPECT_EQ(DEVICE_VENDOR, identifier.vendor);
+        EXPECT_EQ(DEVICE_PRODUCT, identifier.product);
+    }
+}
+
+TEST_F(EventHubTest, IdenticalDevicesGetDistinctDescriptors) {
+    // The devices are probed concurrently, but the descriptors, which tell
+    // identical devices apart with a nonce, are assigned one by one.
+    constexpr size_t keyboardCount = 4;
+    ASSERT_NO_FATAL_FAILURE(createKeyboards(keyboardCount));
+
+    sp<EventHub> eventHub = new EventHub();
+    std::vector<int32_t> deviceIds = readAddedKeyboards(eventHub.get());
+    ASSERT_EQ(keyboardCount, deviceIds.size());
+
+    std::set<std::string> descriptors;
+    std::set<int32_t> nonces;
+    for (int32_t deviceId : deviceIds) {
+        InputDeviceIdentifier identifier = eventHub->getDeviceIdentifier(deviceId);
+        EXPECT_FALSE(identifier.descriptor.empty());
+        EXPECT_TRUE(descriptors.insert(identifier.descriptor).second)
+                << "Duplicate descriptor " << identifier.descriptor;
+        EXPECT_TRUE(nonces.insert(identifier.nonce).second);
+    }
+}
+
+TEST_F(EventHubTest, ReopenAddsDevicesAgain) {
+    constexpr size_t keyboardCount = 4;
+    ASSERT_NO_FATAL_FAILURE(createKeyboards(keyboardCount));
+
+    sp<EventHub> eventHub = new EventHub();
+    std::vector<int32_t> deviceIds = readAddedKeyboards(eventHub.get());
+    ASSERT_EQ(keyboardCount, deviceIds.size());
+    std::set<std::string> descriptors;
+    for (int32_t deviceId : deviceIds) {
+        descriptors.insert(eventHub->getDeviceIdentifier(deviceId).descriptor);
+    }
+
+    eventHub->requestReopenDevices();
+    std::vector<int32_t> reopenedIds = readAddedKeyboards(eventHub.get());
+    ASSERT_EQ(keyboardCount, reopenedIds.size());
+    std::set<std::string> reopenedDescriptors;
+    for (int32_t deviceId : reopenedIds) {
+        reopenedDescriptors.insert(eventHub->getDeviceIdentifier(deviceId).descriptor);
+    }
+    EXPECT_EQ(descriptors, reopenedDescriptors);
+}
+
+// --- EventHubConfigurationTest ---
+
+// Serves the configuration file of the test keyboards from a temporary directory, which stands in
+// for the user repository of input device configuration files.
+class EventHubConfigurationTest : public EventHubTest {
+protected:
+    virtual void SetUp() {
+        const char* androidData = getenv("ANDROID_DATA");
+        mHadAndroidData = androidData != nullptr;
+        if (mHadAndroidData) {
+            mAndroidData = androidData;
+        }
+        setenv("ANDROID_DATA", mDir.path, 1 /*overwrite*/);
+
+        mDirs = {std::string(mDir.path) + "/system", std::string(mDir.path) + "/system/devices",
+                std::string(mDir.path) + "/system/devices/idc"};
+        for (const std::string& dir : mDirs) {
+            ASSERT_EQ(0, mkdir(dir.c_str(), 0700)) << dir << ": " << strerror(errno);
+        }
+        mConfigurationFile = mDirs.back() + "/" + CONFIGURATION_FILE_NAME;
+    }
+
+    virtual void TearDown() {
+        unlink(mConfigurationFile.c_str());
+        for (auto dir = mDirs.rbegin(); dir != mDirs.rend(); dir++) {
+            rmdir(dir->c_str());
+        }
+        if (mHadAndroidData) {
+            setenv("ANDROID_DATA", mAndroidData.c_str(), 1 /*overwrite*/);
+        } else {
+            unsetenv("ANDROID_DATA");
+        }
+    }
+
+    void writeConfigurationFile(const std::string& contents) {
+        ASSERT_TRUE(base::WriteStringToFile(contents, mConfigurationFile));
+    }
+
+    // Returns the value of test.value in the configuration of the device, or -1 if unset.
+    static int32_t getTestValue(EventHub* eventHub, int32_t deviceId) {
+        PropertyMap configuration;
+        eventHub->getConfiguration(deviceId, &configuration);
+        int32_t value = -1;
+        configuration.tryGetProperty(String8("test.value"), value);
+        return value;
+    }
+
+    TemporaryDir mDir;
+    std::string mConfigurationFile;
+
+private:
+    std::vector<std::string> mDirs;
+    bool mHadAndroidData = false;
+    std::string mAndroidData;
+};
+
+TEST_F(EventHubConfigurationTest, DevicesWithSameFileGetSameConfiguration) {
+    ASSERT_NO_FATAL_FAILURE(writeConfigurationFile("test.value = 7\n"));
+    ASSERT_NO_FATAL_FAILURE(createKeyboards(4));
+
+    sp<EventHub> eventHub = new EventHub();
+    std::vector<int32_t> deviceIds = readAddedKeyboards(eventHub.get());
+    ASSERT_EQ(4u, deviceIds.size());
+    for (int32_t deviceId : deviceIds) {
+        EXPECT_EQ(7, getTestValue(eventHub.get(), deviceId));
+    }
+}
+
+TEST_F(EventHubConfigurationTest, ReopenKeepsUnchangedConfiguration) {
+    ASSERT_NO_FATAL_FAILURE(writeConfigurationFile("test.value = 7\n"));
+    ASSERT_NO_FATAL_FAILURE(createKeyboards(2));
+
+    sp<EventHub> eventHub = new EventHub();
+    ASSERT_EQ(2u, readAddedKeyboards(eventHub.get()).size());
+
+    eventHub->requestReopenDevices();
+    std::vector<int32_t> deviceIds = readAddedKeyboards(eventHub.get());
+    ASSERT_EQ(2u, deviceIds.size());
+    for (int32_t deviceId : deviceIds) {
+        EXPECT_EQ(7, getTestValue(eventHub.get(), deviceId));
+    }
+}
+
+TEST_F(EventHubConfigurationTest, ReopenReadsChangedConfigurationFile) {
+    ASSERT_NO_FATAL_FAILURE(writeConfigurationFile("test.value = 7\n"));
+    ASSERT_NO_FATAL_FAILURE(createKeyboards(2));
+
+    sp<EventHub> eventHub = new EventHub();
+    ASSERT_EQ(2u, readAddedKeyboards(eventHub.get()).size());
+
+    // Rewritten within the same second, but with another size.
+    ASSERT_NO_FATAL_FAILURE(writeConfigurationFile("test.value = 1234\n"));
+    eventHub->requestReopenDevices();
+    std::vector<int32_t> deviceIds = readAddedKeyboards(eventHub.get());
+    ASSERT_EQ(2u, deviceIds.size());
+    for (int32_t deviceId : deviceIds) {
+        EXPECT_EQ(1234, getTestValue(eventHub.get(), deviceId));
+    }
+}
+
+TEST_F(EventHubConfigurationTest, ReopenDropsRemovedConfigurationFile) {
+    ASSERT_NO_FATAL_FAILURE(writeConfigurationFile("test.value = 7\n"));
+    ASSERT_NO_FATAL_FAILURE(createKeyboards(2));
+
+    sp<EventHub> eventHub = new EventHub();
+    ASSERT_EQ(2u, readAddedKeyboards(eventHub.get()).size());
+
+    ASSERT_EQ(0, unlink(mConfigurationFile.c_str()));
+    eventHub->requestReopenDevices();
+    std::vector<int32_t> deviceIds = readAddedKeyboards(eventHub.get());
+    ASSERT_EQ(2u, deviceIds.size());
+    for (int32_t deviceId : deviceIds) {
+        EXPECT_EQ(-1, getTestValue(eventHub.get(), deviceId));
+    }
+}
+
+} // namespace android
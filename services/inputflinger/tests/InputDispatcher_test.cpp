@@ -21,6 +21,12 @@
 #include <gtest/gtest.h>
 #include <linux/input.h>
 
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+
 namespace android {
 
 // An arbitrary time value.
@@ -88,6 +94,15 @@ public:
                 << "Expected filterInputEvent() to not have been called.";
     }
 
+    // Wait until the policy has been told about at least the given number of configuration
+    // changes and return the event times it saw, in the order they were dispatched.
+    std::vector<nsecs_t> waitForConfigurationChanges(size_t count) {
+        std::unique_lock<std::mutex> lock(mConfigurationChangedLock);
+        mConfigurationChangedCondition.wait_for(lock, std::chrono::seconds(5),
+                [this, count] { return mConfigurationChangedTimes.size() >= count; });
+        return mConfigurationChangedTimes;
+    }
+
     void assertOnPointerDownEquals(const sp<IBinder>& touchedToken) {
         ASSERT_EQ(mOnPointerDownToken, touchedToken)
                 << "Expected token from onPointerDownOutsideFocus was not matched";
@@ -101,7 +116,14 @@ private:
     int32_t mDisplayId;
     sp<IBinder> mOnPointerDownToken;
 
-    virtual void notifyConfigurationChanged(nsecs_t) {
+    std::mutex mConfigurationChangedLock;
+    std::condition_variable mConfigurationChangedCondition;
+    std::vector<nsecs_t> mConfigurationChangedTimes;
+
+    virtual void notifyConfigurationChanged(nsecs_t when) {
+        std::lock_guard<std::mutex> lock(mConfigurationChangedLock);
+        mConfigurationChangedTimes.push_back(when);
+        mConfigurationChangedCondition.notify_all();
     }
 
     virtual nsecs_t notifyANR(const sp<InputApplicationHandle>&,
@@ -209,6 +231,52 @@ protected:
 };
 
 
+// Events notified by the reader are handed to the dispatcher thread without taking its lock.
+// Every one of them must still be dispatched, in the order each notifier posted them.
+TEST_F(InputDispatcherTest, NotifyConfigurationChanged_FromManyThreads) {
+    constexpr size_t kThreadCount = 8;
+    constexpr size_t kEventsPerThread = 64;
+    std::vector<std::thread> threads;
+    for (size_t t = 0; t < kThreadCount; t++) {
+        threads.emplace_back([this, t] {
+            for (size_t i = 0; i < kEventsPerThread; i++) {
+                NotifyConfigurationChangedArgs args(/* sequenceNum */ 0,
+                        static_cast<nsecs_t>(t * kEventsPerThread + i));
+                mDispatcher->notifyConfigurationChanged(&args);
+            }
+        });
+    }
+    for (std::thread& thread : threads) {
+        thread.join();
+    }
+
+    std::vector<nsecs_t> times =
+            mFakePolicy->waitForConfigurationChanges(kThreadCount * kEventsPerThread);
+    ASSERT_EQ(kThreadCount * kEventsPerThread, times.size());
+
+    std::vector<nsecs_t> lastTimes(kThreadCount, -1);
+    for (nsecs_t time : times) {
+        size_t thread = static_cast<size_t>(time) / kEventsPerThread;
+        ASSERT_LT(thread, kThreadCount);
+        EXPECT_LT(lastTimes[thread], time) << "Events from one thread were reordered";
+        lastTimes[thread] = time;
+    }
+}
+
+TEST_F(InputDispatcherTest, NotifyConfigurationChanged_PreservesOrder) {
+    constexpr nsecs_t kEventCount = 256;
+    for (nsecs_t i = 0; i < kEventCount; i++) {
+        NotifyConfigurationChangedArgs args(/* sequenceNum */ 0, ARBITRARY_TIME + i);
+        mDispatcher->notifyConfigurationChanged(&args);
+    }
+
+    std::vector<nsecs_t> times = mFakePolicy->waitForConfigurationChanges(kEventCount);
+    ASSERT_EQ(static_cast<size_t>(kEventCount), times.size());
+    for (nsecs_t i = 0; i < kEventCount; i++) {
+        EXPECT_EQ(ARBITRARY_TIME + i, times[i]);
+    }
+}
+
 TEST_F(InputDispatcherTest, InjectInputEvent_ValidatesKeyEvents) {
     KeyEvent event;
 
@@ -401,6 +469,24 @@ public:
                 << mName.c_str() << ": consumer sendFinishedSignal should return OK.";
     }
 
+    // Consumes the next event without finishing it, as a slow application would.
+    void receiveEvent(int32_t expectedEventType, uint32_t* outSeq) {
+        InputEvent* event;
+        status_t status = mConsumer->consume(&mEventFactory, false /*consumeBatches*/, -1,
+            outSeq, &event);
+        ASSERT_EQ(OK, status)
+                << mName.c_str() << ": consumer consume should return OK.";
+        ASSERT_TRUE(event != nullptr)
+                << mName.c_str() << ": consumer should have returned non-NULL event.";
+        ASSERT_EQ(expectedEventType, event->getType())
+                << mName.c_str() << ": event type should match.";
+    }
+
+    void finishEvent(uint32_t seq) {
+        ASSERT_EQ(OK, mConsumer->sendFinishedSignal(seq, handled()))
+                << mName.c_str() << ": consumer sendFinishedSignal should return OK.";
+    }
+
     void assertNoEvents() {
         uint32_t consumeSeq;
         InputEvent* event;
@@ -521,8 +607,8 @@ static int32_t injectKeyDown(const sp<InputDispatcher>& dispatcher,
             INJECT_EVENT_TIMEOUT, POLICY_FLAG_FILTERED | POLICY_FLAG_PASS_TO_USER);
 }
 
-static int32_t injectMotionDown(const sp<InputDispatcher>& dispatcher, int32_t source,
-        int32_t displayId, int32_t x = 100, int32_t y = 200) {
+static int32_t injectMotionEvent(const sp<InputDispatcher>& dispatcher, int32_t action,
+        int32_t source, int32_t displayId, int32_t x, int32_t y) {
     MotionEvent event;
     PointerProperties pointerProperties[1];
     PointerCoords pointerCoords[1];
@@ -536,9 +622,9 @@ static int32_t injectMotionDown(const sp<InputDispatcher>& dispatcher, int32_t s
     pointerCoords[0].setAxisValue(AMOTION_EVENT_AXIS_Y, y);
 
     nsecs_t currentTime = systemTime(SYSTEM_TIME_MONOTONIC);
-    // Define a valid motion down event.
+    // Define a valid motion event.
     event.initialize(DEVICE_ID, source, displayId,
-            AMOTION_EVENT_ACTION_DOWN, /* actionButton */ 0, /* flags */ 0, /* edgeFlags */ 0,
+            action, /* actionButton */ 0, /* flags */ 0, /* edgeFlags */ 0,
             AMETA_NONE, /* buttonState */ 0, MotionClassification::NONE,
             /* xOffset */ 0, /* yOffset */ 0, /* xPrecision */ 0,
             /* yPrecision */ 0, currentTime, currentTime, /*pointerCount*/ 1, pointerProperties,
@@ -551,6 +637,11 @@ static int32_t injectMotionDown(const sp<InputDispatcher>& dispatcher, int32_t s
             INJECT_EVENT_TIMEOUT, POLICY_FLAG_FILTERED | POLICY_FLAG_PASS_TO_USER);
 }
 
+static int32_t injectMotionDown(const sp<InputDispatcher>& dispatcher, int32_t source,
+        int32_t displayId, int32_t x = 100, int32_t y = 200) {
+    return injectMotionEvent(dispatcher, AMOTION_EVENT_ACTION_DOWN, source, displayId, x, y);
+}
+
 static NotifyKeyArgs generateKeyArgs(int32_t action, int32_t displayId = ADISPLAY_ID_NONE) {
     nsecs_t currentTime = systemTime(SYSTEM_TIME_MONOTONIC);
     // Define a valid key event.
@@ -602,6 +693,45 @@ TEST_F(InputDispatcherTest, SetInputWindow_SingleWindowTouch) {
     window->consumeEvent(AINPUT_EVENT_TYPE_MOTION, ADISPLAY_ID_DEFAULT);
 }
 
+// Events finished in any order should leave the wait queue of the window, so that a key,
+// which waits for the window to finish everything sent to it, is delivered.
+TEST_F(InputDispatcherTest, FinishEventsOutOfOrder) {
+    sp<FakeApplicationHandle> application = new FakeApplicationHandle();
+    sp<FakeWindowHandle> window = new FakeWindowHandle(application, mDispatcher, "Fake Window",
+            ADISPLAY_ID_DEFAULT);
+    mDispatcher->setFocusedApplication(ADISPLAY_ID_DEFAULT, application);
+    window->setFocus();
+
+    std::vector<sp<InputWindowHandle>> inputWindowHandles;
+    inputWindowHandles.push_back(window);
+    mDispatcher->setInputWindows(inputWindowHandles, ADISPLAY_ID_DEFAULT);
+
+    // Taps rather than moves, which the consumer would batch.
+    std::vector<uint32_t> seqs;
+    for (int i = 0; i < 16; i++) {
+        for (int32_t action : {AMOTION_EVENT_ACTION_DOWN, AMOTION_EVENT_ACTION_UP}) {
+            ASSERT_EQ(INPUT_EVENT_INJECTION_SUCCEEDED, injectMotionEvent(mDispatcher, action,
+                    AINPUT_SOURCE_TOUCHSCREEN, ADISPLAY_ID_DEFAULT, 100, 200))
+                    << "Inject motion event should return INPUT_EVENT_INJECTION_SUCCEEDED";
+            uint32_t seq;
+            ASSERT_NO_FATAL_FAILURE(window->receiveEvent(AINPUT_EVENT_TYPE_MOTION, &seq));
+            seqs.push_back(seq);
+        }
+    }
+
+    // Finish the odd ones, then the even ones from the newest to the oldest.
+    for (size_t i = 1; i < seqs.size(); i += 2) {
+        window->finishEvent(seqs[i]);
+    }
+    for (size_t i = seqs.size(); i >= 2; i -= 2) {
+        window->finishEvent(seqs[i - 2]);
+    }
+
+    ASSERT_EQ(INPUT_EVENT_INJECTION_SUCCEEDED, injectKeyDown(mDispatcher))
+            << "Inject key event should return INPUT_EVENT_INJECTION_SUCCEEDED";
+    window->consumeEvent(AINPUT_EVENT_TYPE_KEY, ADISPLAY_ID_NONE);
+}
+
 // The foreground window should receive the first touch down event.
 TEST_F(InputDispatcherTest, SetInputWindow_MultiWindowsTouch) {
     sp<FakeApplicationHandle> application = new FakeApplicationHandle();
@@ -624,6 +754,32 @@ TEST_F(InputDispatcherTest, SetInputWindow_MultiWindowsTouch) {
     windowSecond->assertNoEvents();
 }
 
+// A touch outside a window's frame should skip it and find the window under the point.
+TEST_F(InputDispatcherTest, SetInputWindow_SideBySideWindowsTouch) {
+    sp<FakeApplicationHandle> application = new FakeApplicationHandle();
+    sp<FakeWindowHandle> windowLeft = new FakeWindowHandle(application, mDispatcher, "Left",
+            ADISPLAY_ID_DEFAULT);
+    windowLeft->setFrame(Rect(0, 0, 100, 100));
+    windowLeft->setLayoutParamFlags(InputWindowInfo::FLAG_NOT_TOUCH_MODAL);
+    sp<FakeWindowHandle> windowRight = new FakeWindowHandle(application, mDispatcher, "Right",
+            ADISPLAY_ID_DEFAULT);
+    windowRight->setFrame(Rect(100, 0, 1000, 100));
+    windowRight->setLayoutParamFlags(InputWindowInfo::FLAG_NOT_TOUCH_MODAL);
+
+    std::vector<sp<InputWindowHandle>> inputWindowHandles;
+    inputWindowHandles.push_back(windowLeft);
+    inputWindowHandles.push_back(windowRight);
+
+    mDispatcher->setInputWindows(inputWindowHandles, ADISPLAY_ID_DEFAULT);
+    ASSERT_EQ(INPUT_EVENT_INJECTION_SUCCEEDED, injectMotionDown(mDispatcher,
+            AINPUT_SOURCE_TOUCHSCREEN, ADISPLAY_ID_DEFAULT, 900, 50))
+            << "Inject motion event should return INPUT_EVENT_INJECTION_SUCCEEDED";
+
+    // Only the window under the touch should receive it.
+    windowRight->consumeEvent(AINPUT_EVENT_TYPE_MOTION, ADISPLAY_ID_DEFAULT);
+    windowLeft->assertNoEvents();
+}
+
 TEST_F(InputDispatcherTest, SetInputWindow_FocusedWindow) {
     sp<FakeApplicationHandle> application = new FakeApplicationHandle();
     sp<FakeWindowHandle> windowTop = new FakeWindowHandle(application, mDispatcher, "Top",
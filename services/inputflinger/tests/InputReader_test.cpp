@@ -1577,6 +1577,38 @@ TEST_F(InputReaderTest, Device_CanDispatchToDisplay) {
 }
 
 
+// --- QueuedInputListenerTest ---
+
+TEST(QueuedInputListenerTest, Merge_InterleavesByEventTimeAfterPosition) {
+    sp<TestInputListener> testListener = new TestInputListener();
+    sp<QueuedInputListener> listener = new QueuedInputListener(testListener);
+    sp<QueuedInputListener> other = new QueuedInputListener(testListener);
+
+    // The first arg was queued before the merge position and must stay first
+    NotifySwitchArgs args(1, ARBITRARY_TIME + 30, 0, 0, 0);
+    listener->notifySwitch(&args);
+    args.eventTime = ARBITRARY_TIME + 10;
+    listener->notifySwitch(&args);
+    args.eventTime = ARBITRARY_TIME + 40;
+    listener->notifySwitch(&args);
+    args.eventTime = ARBITRARY_TIME + 20;
+    other->notifySwitch(&args);
+    args.eventTime = ARBITRARY_TIME + 50;
+    other->notifySwitch(&args);
+
+    listener->merge(other.get(), 1);
+    ASSERT_EQ(5U, listener->getQueueSize());
+    ASSERT_EQ(0U, other->getQueueSize());
+    listener->flush();
+
+    for (nsecs_t expectedTime : {30, 10, 20, 40, 50}) {
+        NotifySwitchArgs notified;
+        ASSERT_NO_FATAL_FAILURE(testListener->assertNotifySwitchWasCalled(&notified));
+        ASSERT_EQ(ARBITRARY_TIME + expectedTime, notified.eventTime);
+    }
+}
+
+
 // --- InputDeviceTest ---
 
 class InputDeviceTest : public testing::Test {
@@ -5441,6 +5473,34 @@ TEST_F(MultiTouchInputMapperTest, Process_NormalMultiTouchGesture_WithSlots) {
     ASSERT_NO_FATAL_FAILURE(mFakeListener->assertNotifyMotionWasNotCalled());
 }
 
+TEST_F(MultiTouchInputMapperTest, Process_TenFingers_WhenOrientationAware_RotatesAllPointers) {
+    MultiTouchInputMapper* mapper = new MultiTouchInputMapper(mDevice);
+    addConfigurationProperty("touch.deviceType", "touchScreen");
+    prepareDisplay(DISPLAY_ORIENTATION_90);
+    prepareAxes(POSITION | ID | SLOT);
+    addMapperAndConfigure(mapper);
+
+    // All ten fingers go down at once, each at a different spot of the rotated display.
+    constexpr int32_t fingerCount = 10;
+    for (int32_t i = 0; i < fingerCount; i++) {
+        processSlot(mapper, i);
+        processPosition(mapper, RAW_X_MAX - toRawX(30 + i * 5) + RAW_X_MIN, toRawY(20 + i * 10));
+        processId(mapper, i);
+    }
+    processSync(mapper);
+
+    NotifyMotionArgs motionArgs;
+    for (int32_t i = 0; i < fingerCount; i++) {
+        ASSERT_NO_FATAL_FAILURE(mFakeListener->assertNotifyMotionWasCalled(&motionArgs));
+    }
+    ASSERT_EQ(size_t(fingerCount), motionArgs.pointerCount);
+    for (int32_t i = 0; i < fingerCount; i++) {
+        const int32_t id = motionArgs.pointerProperties[i].id;
+        ASSERT_NEAR(20 + id * 10, motionArgs.pointerCoords[i].getAxisValue(AMOTION_EVENT_AXIS_X), 1);
+        ASSERT_NEAR(30 + id * 5, motionArgs.pointerCoords[i].getAxisValue(AMOTION_EVENT_AXIS_Y), 1);
+    }
+}
+
 TEST_F(MultiTouchInputMapperTest, Process_AllAxes_WithDefaultCalibration) {
     MultiTouchInputMapper* mapper = new MultiTouchInputMapper(mDevice);
     addConfigurationProperty("touch.deviceType", "touchScreen");
@@ -49,7 +49,7 @@ CorrectedGyroSensor::CorrectedGyroSensor(sensor_t const* list, size_t count)
             .power      = mSensorFusion.getPowerUsage(),
             .minDelay   = mGyro.getMinDelay(),
     };
-    mSensor = Sensor(&sensor);
+    setSensor(sensor);
 }
 
 bool CorrectedGyroSensor::process(sensors_event_t* outEvent,
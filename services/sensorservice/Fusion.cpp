@@ -491,7 +491,21 @@ void Fusion::predict(const vec3_t& w, float dT) {
     if (x0.w < 0)
         x0 = -x0;
 
-    P = Phi*P*transpose(Phi) + GQGt;
+    // Phi's bottom row is | 0 I33 |, so most of the block products are trivial:
+    //
+    // P00 = Phi00*P00*Phi00' + Phi10*P01*Phi00' + Phi00*P10*Phi10' + Phi10*P11*Phi10'
+    //     = (Phi00*P00 + Phi10*P01)*Phi00' + P10*Phi10'  (using the new P10 below)
+    // P10 = Phi00*P10 + Phi10*P11
+    // P11 = P11
+    //
+    // which takes 6 3x3 products instead of the 16 of the generic 6x6 product.
+    const mat33_t Phi00t(transpose(Phi[0][0]));
+    const mat33_t P10(Phi[0][0]*P[1][0] + Phi[1][0]*P[1][1]);
+    P[0][0] = (Phi[0][0]*P[0][0] + Phi[1][0]*transpose(P[1][0]))*Phi00t
+            + P10*transpose(Phi[1][0]) + GQGt[0][0];
+    P[1][0] = P10 + GQGt[1][0];
+    P[0][1] = transpose(P10) + GQGt[0][1];
+    P[1][1] += GQGt[1][1];
 
     checkState();
 }
@@ -48,7 +48,7 @@ GravitySensor::GravitySensor(sensor_t const* list, size_t count) {
         .power      = mSensorFusion.getPowerUsage(),
         .minDelay   = mSensorFusion.getMinDelay(),
     };
-    mSensor = Sensor(&sensor);
+    setSensor(sensor);
 }
 
 bool GravitySensor::process(sensors_event_t* outEvent,
@@ -43,7 +43,7 @@ LinearAccelerationSensor::LinearAccelerationSensor(sensor_t const* list, size_t
         .power      = gsensor.getPowerUsage(),
         .minDelay   = gsensor.getMinDelay(),
     };
-    mSensor = Sensor(&sensor);
+    setSensor(sensor);
 }
 
 bool LinearAccelerationSensor::process(sensors_event_t* outEvent,
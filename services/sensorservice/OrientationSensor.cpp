@@ -41,7 +41,7 @@ OrientationSensor::OrientationSensor() {
         .power      = mSensorFusion.getPowerUsage(),
         .minDelay   = mSensorFusion.getMinDelay(),
     };
-    mSensor = Sensor(&sensor);
+    setSensor(sensor);
 }
 
 bool OrientationSensor::process(sensors_event_t* outEvent,
@@ -19,7 +19,11 @@
 
 #include <utils/Timers.h>
 
+#include <algorithm>
 #include <inttypes.h>
+#include <math.h>
+#include <string.h>
+#include <time.h>
 
 namespace android {
 namespace SensorServiceUtil {
@@ -28,23 +32,136 @@ namespace {
     constexpr size_t LOG_SIZE = 10;
     constexpr size_t LOG_SIZE_MED = 30;  // debugging for slower sensors
     constexpr size_t LOG_SIZE_LARGE = 50;  // larger samples for debugging
+
+    // What an event took before records were packed, which the default budgets are based on
+    constexpr size_t UNPACKED_EVENT_SIZE = sizeof(sensors_event_t) + sizeof(timespec);
+
+    // Values are kept in hundredths; NaN and values out of range get their own codes
+    constexpr float QUANTUM = 100.f;
+    constexpr int64_t MAX_QUANTIZED = 1ll << 60;
+    constexpr int64_t QUANTIZED_NAN = MAX_QUANTIZED + 1;
+
+    // Upper bound of an encoded record: two 64-bit varints and one per value
+    constexpr size_t MAX_VARINT_SIZE = 10;
+    constexpr size_t MAX_RECORD_SIZE = (2 + 16) * MAX_VARINT_SIZE;
+
+    void putVarint(int64_t value, uint8_t** out) {
+        // Zigzag, so that small negative deltas stay short
+        uint64_t v = (uint64_t(value) << 1) ^ uint64_t(value >> 63);
+        while (v >= 0x80) {
+            *(*out)++ = uint8_t(v) | 0x80;
+            v >>= 7;
+        }
+        *(*out)++ = uint8_t(v);
+    }
+
+    int64_t getVarint(const uint8_t** in) {
+        uint64_t v = 0;
+        for (uint32_t shift = 0; ; shift += 7) {
+            const uint8_t byte = *(*in)++;
+            v |= uint64_t(byte & 0x7f) << shift;
+            if ((byte & 0x80) == 0) {
+                break;
+            }
+        }
+        return int64_t(v >> 1) ^ -int64_t(v & 1);
+    }
+
+    int64_t quantize(float value) {
+        if (isnan(value)) {
+            return QUANTIZED_NAN;
+        }
+        const float scaled = value * QUANTUM;
+        if (scaled >= MAX_QUANTIZED) return MAX_QUANTIZED;
+        if (scaled <= -MAX_QUANTIZED) return -MAX_QUANTIZED;
+        return llroundf(scaled);
+    }
 }// unnamed namespace
 
-RecentEventLogger::RecentEventLogger(int sensorType) :
+RecentEventLogger::RecentEventLogger(int sensorType, size_t budgetBytes) :
         mSensorType(sensorType), mEventSize(eventSizeBySensorType(mSensorType)),
-        mRecentEvents(logSizeBySensorType(sensorType)), mMaskData(false),
+        mFirstBlock(0), mBlockCount(0), mRecordCount(0), mLastEvent(), mMaskData(false),
         mIsLastEventCurrent(false) {
-    // blank
+    static_assert(MAX_RECORD_SIZE <= BLOCK_SIZE, "a record must fit in a block");
+    if (budgetBytes == 0) {
+        budgetBytes = logSizeBySensorType(sensorType) * UNPACKED_EVENT_SIZE;
+    }
+    const size_t blocks = std::max<size_t>(budgetBytes / BLOCK_SIZE, 1);
+    mHistory.resize(blocks * BLOCK_SIZE);
+    mBlocks.resize(blocks);
 }
 
 void RecentEventLogger::addEvent(const sensors_event_t& event) {
+    timespec wallTime;
+    clock_gettime(CLOCK_REALTIME, &wallTime);
+    const int64_t wallTimeMs = wallTime.tv_sec * 1000ll + ns2ms(wallTime.tv_nsec);
+
     std::lock_guard<std::mutex> lk(mLock);
-    mRecentEvents.emplace(event);
+    mLastEvent = event;
     mIsLastEventCurrent = true;
+
+    uint8_t record[MAX_RECORD_SIZE];
+    RecordState state = mLastState;
+    size_t size = encode(event, wallTimeMs, &state, record);
+    if (mBlockCount == 0 ||
+            mBlocks[(mFirstBlock + mBlockCount - 1) % mBlocks.size()].used + size > BLOCK_SIZE) {
+        startBlockLocked();
+        state = RecordState();
+        size = encode(event, wallTimeMs, &state, record);
+    }
+    const size_t index = (mFirstBlock + mBlockCount - 1) % mBlocks.size();
+    Block& block = mBlocks[index];
+    memcpy(&mHistory[index * BLOCK_SIZE + block.used], record, size);
+    block.used += size;
+    ++block.records;
+    ++mRecordCount;
+    mLastState = state;
+}
+
+void RecentEventLogger::startBlockLocked() {
+    if (mBlockCount == mBlocks.size()) {
+        mRecordCount -= mBlocks[mFirstBlock].records;
+        mFirstBlock = (mFirstBlock + 1) % mBlocks.size();
+        --mBlockCount;
+    }
+    mBlocks[(mFirstBlock + mBlockCount) % mBlocks.size()] = Block();
+    ++mBlockCount;
+}
+
+size_t RecentEventLogger::encode(const sensors_event_t& event, int64_t wallTimeMs,
+                                 RecordState* state, uint8_t* out) const {
+    uint8_t* const start = out;
+    putVarint(event.timestamp - state->timestamp, &out);
+    putVarint(wallTimeMs - state->wallTimeMs, &out);
+    state->timestamp = event.timestamp;
+    state->wallTimeMs = wallTimeMs;
+    if (mSensorType == SENSOR_TYPE_STEP_COUNTER) {
+        const int64_t steps = int64_t(event.u64.step_counter);
+        putVarint(steps - state->values[0], &out);
+        state->values[0] = steps;
+    } else {
+        for (size_t k = 0; k < mEventSize; ++k) {
+            const int64_t value = quantize(event.data[k]);
+            putVarint(value - state->values[k], &out);
+            state->values[k] = value;
+        }
+    }
+    return out - start;
+}
+
+const uint8_t* RecentEventLogger::decode(const uint8_t* in, RecordState* state) const {
+    state->timestamp += getVarint(&in);
+    state->wallTimeMs += getVarint(&in);
+    const size_t count = mSensorType == SENSOR_TYPE_STEP_COUNTER ? 1 : mEventSize;
+    for (size_t k = 0; k < count; ++k) {
+        state->values[k] += getVarint(&in);
+    }
+    return in;
 }
 
 bool RecentEventLogger::isEmpty() const {
-    return mRecentEvents.size() == 0;
+    std::lock_guard<std::mutex> lk(mLock);
+    return mRecordCount == 0;
 }
 
 void RecentEventLogger::setLastEventStale() {
@@ -55,25 +172,41 @@ void RecentEventLogger::setLastEventStale() {
 std::string RecentEventLogger::dump() const {
     std::lock_guard<std::mutex> lk(mLock);
 
+    std::vector<RecordState> records;
+    records.reserve(mRecordCount);
+    for (size_t b = 0; b < mBlockCount; ++b) {
+        const size_t index = (mFirstBlock + b) % mBlocks.size();
+        const uint8_t* in = &mHistory[index * BLOCK_SIZE];
+        RecordState state;
+        for (size_t r = 0; r < mBlocks[index].records; ++r) {
+            in = decode(in, &state);
+            records.push_back(state);
+        }
+    }
+
     //TODO: replace String8 with std::string completely in this function
     String8 buffer;
 
-    buffer.appendFormat("last %zu events\n", mRecentEvents.size());
+    buffer.appendFormat("last %zu events\n", records.size());
     int j = 0;
-    for (int i = mRecentEvents.size() - 1; i >= 0; --i) {
-        const auto& ev = mRecentEvents[i];
-        struct tm * timeinfo = localtime(&(ev.mWallTime.tv_sec));
+    for (auto ev = records.rbegin(); ev != records.rend(); ++ev) {
+        const time_t wallTimeSec = ev->wallTimeMs / 1000;
+        struct tm * timeinfo = localtime(&wallTimeSec);
         buffer.appendFormat("\t%2d (ts=%.9f, wall=%02d:%02d:%02d.%03d) ",
-                ++j, ev.mEvent.timestamp/1e9, timeinfo->tm_hour, timeinfo->tm_min, timeinfo->tm_sec,
-                (int) ns2ms(ev.mWallTime.tv_nsec));
+                ++j, ev->timestamp/1e9, timeinfo->tm_hour, timeinfo->tm_min, timeinfo->tm_sec,
+                (int) (ev->wallTimeMs % 1000));
 
         // data
         if (!mMaskData) {
             if (mSensorType == SENSOR_TYPE_STEP_COUNTER) {
-                buffer.appendFormat("%" PRIu64 ", ", ev.mEvent.u64.step_counter);
+                buffer.appendFormat("%" PRIu64 ", ", uint64_t(ev->values[0]));
             } else {
                 for (size_t k = 0; k < mEventSize; ++k) {
-                    buffer.appendFormat("%.2f, ", ev.mEvent.data[k]);
+                    if (ev->values[k] == QUANTIZED_NAN) {
+                        buffer.append("nan, ");
+                    } else {
+                        buffer.appendFormat("%.2f, ", ev->values[k] / QUANTUM);
+                    }
                 }
             }
         } else {
@@ -95,9 +228,8 @@ void RecentEventLogger::setFormat(std::string format) {
 bool RecentEventLogger::populateLastEventIfCurrent(sensors_event_t *event) const {
     std::lock_guard<std::mutex> lk(mLock);
 
-    if (mIsLastEventCurrent && mRecentEvents.size()) {
-        // Index 0 contains the latest event emplace()'ed
-        *event = mRecentEvents[0].mEvent;
+    if (mIsLastEventCurrent) {
+        *event = mLastEvent;
         return true;
     } else {
         return false;
@@ -118,9 +250,5 @@ size_t RecentEventLogger::logSizeBySensorType(int sensorType) {
     return LOG_SIZE;
 }
 
-RecentEventLogger::SensorEventLog::SensorEventLog(const sensors_event_t& e) : mEvent(e) {
-    clock_gettime(CLOCK_REALTIME, &mWallTime);
-}
-
 } // namespace SensorServiceUtil
 } // namespace android
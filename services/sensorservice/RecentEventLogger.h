@@ -17,25 +17,27 @@
 #ifndef ANDROID_SENSOR_SERVICE_UTIL_RECENT_EVENT_LOGGER_H
 #define ANDROID_SENSOR_SERVICE_UTIL_RECENT_EVENT_LOGGER_H
 
-#include "RingBuffer.h"
 #include "SensorServiceUtils.h"
 
 #include <hardware/sensors.h>
 #include <utils/String8.h>
 
 #include <mutex>
+#include <vector>
 
 namespace android {
 namespace SensorServiceUtil {
 
-// A circular buffer that record the last N events of a sensor type for debugging. The size of this
-// buffer depends on sensor type and is controlled by logSizeBySensorType(). The last N events
-// generated from the sensor are stored in this buffer.  The buffer is NOT cleared when the sensor
-// unregisters and as a result very old data in the dumpsys output can be seen, which is an intended
-// behavior.
+// A circular buffer that record the last events of a sensor type for debugging. The memory it
+// takes depends on sensor type and is controlled by logSizeBySensorType(), unless a budget is
+// given. Events are stored compactly, so the buffer holds far more events than the budget would
+// fit as sensors_event_t: timestamps and wall times as deltas, and values quantized to the two
+// decimals dumpsys prints, as deltas too. The buffer is NOT cleared when the sensor unregisters
+// and as a result very old data in the dumpsys output can be seen, which is an intended behavior.
 class RecentEventLogger : public Dumpable {
 public:
-    explicit RecentEventLogger(int sensorType);
+    // A budget of zero bytes picks the default for the sensor type
+    explicit RecentEventLogger(int sensorType, size_t budgetBytes = 0);
     void addEvent(const sensors_event_t& event);
 
     // Populate event with the last recorded sensor event if it is not stale. An event is
@@ -51,17 +53,40 @@ public:
     virtual void setFormat(std::string format) override;
 
 protected:
-    struct SensorEventLog {
-        explicit SensorEventLog(const sensors_event_t& e);
-        timespec mWallTime;
-        sensors_event_t mEvent;
+    // Each record is relative to the state left by the one before it in the same block. The
+    // values are in hundredths, or the step count for step counters.
+    struct RecordState {
+        int64_t timestamp = 0;
+        int64_t wallTimeMs = 0;
+        int64_t values[16] = {};
     };
 
+    // The records are in blocks of BLOCK_SIZE bytes, used as a ring. Every block starts from a
+    // zeroed state, so that the oldest block can be dropped whole to make room.
+    struct Block {
+        uint16_t used = 0;
+        uint16_t records = 0;
+    };
+    static constexpr size_t BLOCK_SIZE = 256;
+
+    size_t encode(const sensors_event_t& event, int64_t wallTimeMs, RecordState* state,
+                  uint8_t* out) const;
+    const uint8_t* decode(const uint8_t* in, RecordState* state) const;
+    void startBlockLocked();
+
     const int mSensorType;
     const size_t mEventSize;
 
     mutable std::mutex mLock;
-    RingBuffer<SensorEventLog> mRecentEvents;
+    std::vector<uint8_t> mHistory;
+    std::vector<Block> mBlocks;
+    size_t mFirstBlock;
+    size_t mBlockCount;
+    size_t mRecordCount;
+    // The state after the last record, which the next one in the same block is relative to
+    RecordState mLastState;
+    // Kept whole, it is sent as is to connections enabling an on-change sensor
+    sensors_event_t mLastEvent;
 
     bool mMaskData;
     bool mIsLastEventCurrent;
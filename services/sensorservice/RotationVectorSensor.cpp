@@ -40,7 +40,7 @@ RotationVectorSensor::RotationVectorSensor(int mode) :
         .power      = mSensorFusion.getPowerUsage(),
         .minDelay   = mSensorFusion.getMinDelay(),
     };
-    mSensor = Sensor(&sensor);
+    setSensor(sensor);
 }
 
 bool RotationVectorSensor::process(sensors_event_t* outEvent,
@@ -126,7 +126,7 @@ GyroDriftSensor::GyroDriftSensor() {
         .power      = mSensorFusion.getPowerUsage(),
         .minDelay   = mSensorFusion.getMinDelay(),
     };
-    mSensor = Sensor(&sensor);
+    setSensor(sensor);
 }
 
 bool GyroDriftSensor::process(sensors_event_t* outEvent,
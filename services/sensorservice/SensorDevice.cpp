@@ -481,16 +481,19 @@ ssize_t SensorDevice::pollFmq(sensors_event_t* buffer, size_t maxNumEventsToRead
         }
     }
 
-    size_t eventsToRead = std::min({availableEvents, maxNumEventsToRead, mEventBuffer.size()});
+    size_t eventsToRead = std::min(availableEvents, maxNumEventsToRead);
     if (eventsToRead > 0) {
-        if (mEventQueue->read(mEventBuffer.data(), eventsToRead)) {
+        // Convert the events in place in the queue, rather than copying them out first
+        EventMessageQueue::MemTransaction transaction;
+        if (mEventQueue->beginRead(eventsToRead, &transaction)) {
+            for (size_t i = 0; i < eventsToRead; i++) {
+                convertToSensorEvent(*transaction.getSlot(i), &buffer[i]);
+            }
+            mEventQueue->commitRead(eventsToRead);
+
             // Notify the Sensors HAL that sensor events have been read. This is required to support
             // the use of writeBlocking by the Sensors HAL.
             mEventQueueFlag->wake(asBaseType(EventQueueFlagBits::EVENTS_READ));
-
-            for (size_t i = 0; i < eventsToRead; i++) {
-                convertToSensorEvent(mEventBuffer[i], &buffer[i]);
-            }
             eventsRead = eventsToRead;
         } else {
             ALOGW("Failed to read %zu events, currently %zu events available",
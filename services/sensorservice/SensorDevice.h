@@ -245,8 +245,6 @@ private:
     hardware::EventFlag* mEventQueueFlag;
     hardware::EventFlag* mWakeLockQueueFlag;
 
-    std::array<Event, SensorEventQueue::MAX_RECEIVE_BUFFER_EVENT_COUNT> mEventBuffer;
-
     sp<SensorsHalDeathReceivier> mSensorsHalDeathReceiver;
     std::atomic_bool mReconnecting;
 };
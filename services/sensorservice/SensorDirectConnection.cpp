@@ -16,7 +16,12 @@
 
 #include "SensorDevice.h"
 #include "SensorDirectConnection.h"
+#include "SensorInterface.h"
+#include "SensorServiceUtils.h"
 #include <hardware/sensors.h>
+#include <sys/mman.h>
+
+#include <algorithm>
 
 #define UNUSED(x) (void)(x)
 
@@ -43,8 +48,15 @@ void SensorService::SensorDirectConnection::destroy() {
         return;
     }
 
-    stopAll();
+    {
+        Mutex::Autolock _s(mService->mLock);
+        stopAll();
+    }
     mService->cleanupConnection(this);
+    if (mMappedEvents != nullptr) {
+        munmap(mMappedEvents, mMem.size);
+        mMappedEvents = nullptr;
+    }
     if (mMem.handle != nullptr) {
         native_handle_close(mMem.handle);
         native_handle_delete(const_cast<struct native_handle*>(mMem.handle));
@@ -60,7 +72,8 @@ void SensorService::SensorDirectConnection::dump(String8& result) const {
     result.appendFormat("\tPackage %s, HAL channel handle %d, total sensor activated %zu\n",
             String8(mOpPackageName).string(), getHalChannelHandle(), mActivated.size());
     for (auto &i : mActivated) {
-        result.appendFormat("\t\tSensor %#08x, rate %d\n", i.first, i.second);
+        result.appendFormat("\t\tSensor %#08x, rate %d%s\n", i.first, i.second,
+                mVirtualReports.count(i.first) ? ", written by service" : "");
     }
 }
 
@@ -96,6 +109,7 @@ status_t SensorService::SensorDirectConnection::flush() {
 int32_t SensorService::SensorDirectConnection::configureChannel(int handle, int rateLevel) {
 
     if (handle == -1 && rateLevel == SENSOR_DIRECT_RATE_STOP) {
+        Mutex::Autolock _s(mService->mLock);
         stopAll();
         return NO_ERROR;
     }
@@ -120,11 +134,37 @@ int32_t SensorService::SensorDirectConnection::configureChannel(int handle, int
         return INVALID_OPERATION;
     }
 
+    if (si->isVirtual()) {
+        Mutex::Autolock _s(mService->mLock);
+        Mutex::Autolock _l(mConnectionLock);
+        if (rateLevel == SENSOR_DIRECT_RATE_STOP) {
+            stopVirtualReportLocked(handle);
+            mActivated.erase(handle);
+            return NO_ERROR;
+        }
+        if (mVirtualReports.empty() && !mActivated.empty()) {
+            // the HAL is writing into the memory
+            return INVALID_OPERATION;
+        }
+        status_t err = startVirtualReportLocked(si, rateLevel);
+        if (err != NO_ERROR) {
+            return err;
+        }
+        mActivated[handle] = rateLevel;
+        // the handle doubles as the report token placed in the events
+        return handle;
+    }
+
     struct sensors_direct_cfg_t config = {
         .rate_level = rateLevel
     };
 
     Mutex::Autolock _l(mConnectionLock);
+    if (mHalChannelHandle <= 0
+            || (rateLevel != SENSOR_DIRECT_RATE_STOP && !mVirtualReports.empty())) {
+        // there is no HAL channel, or the service is writing into the memory
+        return INVALID_OPERATION;
+    }
     SensorDevice& dev(SensorDevice::getInstance());
     int ret = dev.configureDirectChannel(handle, getHalChannelHandle(), &config);
 
@@ -152,7 +192,11 @@ void SensorService::SensorDirectConnection::stopAll(bool backupRecord) {
     Mutex::Autolock _l(mConnectionLock);
     SensorDevice& dev(SensorDevice::getInstance());
     for (auto &i : mActivated) {
-        dev.configureDirectChannel(i.first, getHalChannelHandle(), &config);
+        if (mVirtualReports.count(i.first)) {
+            stopVirtualReportLocked(i.first);
+        } else {
+            dev.configureDirectChannel(i.first, getHalChannelHandle(), &config);
+        }
     }
 
     if (backupRecord && mActivatedBackup.empty()) {
@@ -172,12 +216,121 @@ void SensorService::SensorDirectConnection::recoverAll() {
     mActivatedBackup.clear();
 
     // re-enable them
-    for (auto &i : mActivated) {
-        struct sensors_direct_cfg_t config = {
-            .rate_level = i.second
-        };
-        dev.configureDirectChannel(i.first, getHalChannelHandle(), &config);
+    for (auto i = mActivated.begin(); i != mActivated.end();) {
+        sp<SensorInterface> si = mService->getSensorInterfaceFromHandle(i->first);
+        if (si != nullptr && si->isVirtual()) {
+            if (startVirtualReportLocked(si, i->second) != NO_ERROR) {
+                i = mActivated.erase(i);
+                continue;
+            }
+        } else {
+            struct sensors_direct_cfg_t config = {
+                .rate_level = i->second
+            };
+            dev.configureDirectChannel(i->first, getHalChannelHandle(), &config);
+        }
+        ++i;
+    }
+}
+
+void SensorService::SensorDirectConnection::sendEvents(const sensors_event_t* buffer,
+        size_t count) {
+    Mutex::Autolock _l(mConnectionLock);
+    if (mVirtualReports.empty()) {
+        return;
+    }
+
+    for (size_t i = 0; i < count; i++) {
+        const sensors_event_t& event = buffer[i];
+        if (event.type == SENSOR_TYPE_META_DATA) {
+            continue;
+        }
+        auto report = mVirtualReports.find(event.sensor);
+        if (report == mVirtualReports.end()) {
+            continue;
+        }
+        // the fusion runs at the highest rate any client asked for, so reports are
+        // decimated to their own rate, give or take jitter in the fusion input
+        VirtualReport& r = report->second;
+        if (event.timestamp - r.lastTimestamp < r.samplingPeriodNs - r.samplingPeriodNs / 8) {
+            continue;
+        }
+        r.lastTimestamp = event.timestamp;
+
+        // the counter is written last, for readers polling it to find complete events
+        sensors_event_t* slot = &mMappedEvents[mWritePosition];
+        mWritePosition = (mWritePosition + 1) % mMappedEventCount;
+        if (++mWriteCounter == 0) {
+            mWriteCounter = 1;
+        }
+        slot->version = sizeof(sensors_event_t);
+        slot->sensor = event.sensor;
+        slot->type = event.type;
+        slot->timestamp = event.timestamp;
+        memcpy(slot->data, event.data, sizeof(slot->data));
+        slot->flags = 0;
+        __atomic_store_n(&slot->reserved0, int32_t(mWriteCounter), __ATOMIC_RELEASE);
+    }
+}
+
+status_t SensorService::SensorDirectConnection::startVirtualReportLocked(
+        const sp<SensorInterface>& si, int rateLevel) {
+    if (!mapMemoryLocked()) {
+        return NO_MEMORY;
+    }
+
+    const int handle = si->getSensor().getHandle();
+    const nsecs_t samplingPeriodNs = std::max(SensorServiceUtil::directReportPeriodNs(rateLevel),
+            si->getSensor().getMinDelayNs());
+    auto report = mVirtualReports.find(handle);
+    if (report != mVirtualReports.end()) {
+        report->second.samplingPeriodNs = samplingPeriodNs;
+        return si->batch(&report->second, handle, 0, samplingPeriodNs, 0);
+    }
+
+    report = mVirtualReports.emplace(handle, VirtualReport{samplingPeriodNs, 0}).first;
+    status_t err = si->batch(&report->second, handle, 0, samplingPeriodNs, 0);
+    if (err == NO_ERROR) {
+        err = si->activate(&report->second, true);
+    }
+    if (err != NO_ERROR) {
+        mVirtualReports.erase(report);
+        return err;
+    }
+    mService->addDirectVirtualSensorLocked(handle);
+    return NO_ERROR;
+}
+
+void SensorService::SensorDirectConnection::stopVirtualReportLocked(int handle) {
+    auto report = mVirtualReports.find(handle);
+    if (report == mVirtualReports.end()) {
+        return;
+    }
+    sp<SensorInterface> si = mService->getSensorInterfaceFromHandle(handle);
+    if (si != nullptr) {
+        si->activate(&report->second, false);
+    }
+    mService->removeDirectVirtualSensorLocked(handle);
+    mVirtualReports.erase(report);
+}
+
+bool SensorService::SensorDirectConnection::mapMemoryLocked() {
+    if (mMappedEvents != nullptr) {
+        return true;
+    }
+    if (mMem.type != SENSOR_DIRECT_MEM_TYPE_ASHMEM
+            || mMem.size < sizeof(sensors_event_t)) {
+        return false;
+    }
+    void* addr = mmap(nullptr, mMem.size, PROT_READ | PROT_WRITE, MAP_SHARED,
+            mMem.handle->data[0], 0);
+    if (addr == MAP_FAILED) {
+        ALOGE("Failed to map direct channel memory: %s", strerror(errno));
+        return false;
     }
+    mMappedEvents = static_cast<sensors_event_t*>(addr);
+    mMappedEventCount = mMem.size / sizeof(sensors_event_t);
+    return true;
 }
 
 int32_t SensorService::SensorDirectConnection::getHalChannelHandle() const {
@@ -46,13 +46,17 @@ public:
 
     // stop all active sensor report. if backupRecord is set to false,
     // those report can be recovered by recoverAll
-    // called by SensorService when enter restricted mode
+    // called by SensorService when enter restricted mode, with its mLock held
     void stopAll(bool backupRecord = false);
 
     // recover sensor reports previously stopped by stopAll(true)
-    // called by SensorService when return to NORMAL mode.
+    // called by SensorService when return to NORMAL mode, with its mLock held
     void recoverAll();
 
+    // write the events of the virtual sensors reported by this connection into its shared
+    // memory, called by SensorService's thread with its mLock held
+    void sendEvents(const sensors_event_t* buffer, size_t count);
+
 protected:
     virtual ~SensorDirectConnection();
     // ISensorEventConnection functions
@@ -65,6 +69,19 @@ protected:
     virtual int32_t configureChannel(int handle, int rateLevel);
     virtual void destroy();
 private:
+    // Virtual sensors are computed by the service rather than the HAL, so the service writes
+    // their events into the shared memory itself, in the same format. Memory written by the
+    // HAL has the HAL's write position in it, so a connection reports either kind at a time.
+    struct VirtualReport {
+        nsecs_t samplingPeriodNs;
+        int64_t lastTimestamp;
+    };
+
+    // called with the service's mLock and mConnectionLock held
+    status_t startVirtualReportLocked(const sp<SensorInterface>& si, int rateLevel);
+    void stopVirtualReportLocked(int handle);
+    bool mapMemoryLocked();
+
     const sp<SensorService> mService;
     const uid_t mUid;
     const sensors_direct_mem_t mMem;
@@ -74,6 +91,12 @@ private:
     mutable Mutex mConnectionLock;
     std::unordered_map<int, int> mActivated;
     std::unordered_map<int, int> mActivatedBackup;
+    // The address of each report is the ident the virtual sensor is activated with
+    std::unordered_map<int, VirtualReport> mVirtualReports;
+    sensors_event_t* mMappedEvents = nullptr;
+    size_t mMappedEventCount = 0;
+    size_t mWritePosition = 0;
+    uint32_t mWriteCounter = 0;
 
     mutable Mutex mDestroyLock;
     bool mDestroyed;
@@ -14,6 +14,7 @@
  * limitations under the License.
  */
 
+#include <inttypes.h>
 #include <sys/socket.h>
 #include <utils/threads.h>
 
@@ -91,12 +92,14 @@ void SensorService::SensorEventConnection::dump(String8& result) {
             mMaxCacheSize);
     for (size_t i = 0; i < mSensorInfo.size(); ++i) {
         const FlushInfo& flushInfo = mSensorInfo.valueAt(i);
-        result.appendFormat("\t %s 0x%08x | status: %s | pending flush events %d \n",
+        result.appendFormat("\t %s 0x%08x | status: %s | pending flush events %d | "
+                            "period %" PRId64 "ns \n",
                             mService->getSensorName(mSensorInfo.keyAt(i)).string(),
                             mSensorInfo.keyAt(i),
                             flushInfo.mFirstFlushPending ? "First flush pending" :
                                                            "active",
-                            flushInfo.mPendingFlushEventsToSend);
+                            flushInfo.mPendingFlushEventsToSend,
+                            flushInfo.mSamplingPeriodNs);
     }
 #if DEBUG_CONNECTIONS
     result.appendFormat("\t events recvd: %d | sent %d | cache %d | dropped %d |"
@@ -118,16 +121,22 @@ bool SensorService::SensorEventConnection::addSensor(int32_t handle) {
         mSensorInfo.indexOfKey(handle) >= 0) {
         return false;
     }
-    mSensorInfo.add(handle, FlushInfo());
+    FlushInfo flushInfo;
+    flushInfo.mOneShot = si->getSensor().getReportingMode() == AREPORTING_MODE_ONE_SHOT;
+    mOneShotSensorCount += flushInfo.mOneShot ? 1 : 0;
+    mSensorInfo.add(handle, flushInfo);
     return true;
 }
 
 bool SensorService::SensorEventConnection::removeSensor(int32_t handle) {
     Mutex::Autolock _l(mConnectionLock);
-    if (mSensorInfo.removeItem(handle) >= 0) {
-        return true;
+    ssize_t index = mSensorInfo.indexOfKey(handle);
+    if (index < 0) {
+        return false;
     }
-    return false;
+    mOneShotSensorCount -= mSensorInfo.valueAt(index).mOneShot ? 1 : 0;
+    mSensorInfo.removeItemsAt(index);
+    return true;
 }
 
 bool SensorService::SensorEventConnection::hasSensor(int32_t handle) const {
@@ -142,10 +151,23 @@ bool SensorService::SensorEventConnection::hasAnySensor() const {
 
 bool SensorService::SensorEventConnection::hasOneShotSensors() const {
     Mutex::Autolock _l(mConnectionLock);
+    return mOneShotSensorCount > 0;
+}
+
+bool SensorService::SensorEventConnection::hasEventsToSend(
+        const std::vector<int32_t>& handles) const {
+    Mutex::Autolock _l(mConnectionLock);
+    // Both lists are sorted by handle, walk them together
+    size_t h = 0;
     for (size_t i = 0; i < mSensorInfo.size(); ++i) {
+        if (mSensorInfo.valueAt(i).mPendingFlushEventsToSend > 0) {
+            return true;
+        }
         const int handle = mSensorInfo.keyAt(i);
-        sp<SensorInterface> si = mService->getSensorInterfaceFromHandle(handle);
-        if (si != nullptr && si->getSensor().getReportingMode() == AREPORTING_MODE_ONE_SHOT) {
+        while (h < handles.size() && handles[h] < handle) {
+            ++h;
+        }
+        if (h < handles.size() && handles[h] == handle) {
             return true;
         }
     }
@@ -166,6 +188,30 @@ void SensorService::SensorEventConnection::setFirstFlushPending(int32_t handle,
     }
 }
 
+void SensorService::SensorEventConnection::setSamplingPeriod(int32_t handle,
+                                nsecs_t samplingPeriodNs) {
+    Mutex::Autolock _l(mConnectionLock);
+    ssize_t index = mSensorInfo.indexOfKey(handle);
+    if (index >= 0) {
+        FlushInfo& flushInfo = mSensorInfo.editValueAt(index);
+        flushInfo.mSamplingPeriodNs = samplingPeriodNs;
+    }
+}
+
+bool SensorService::SensorEventConnection::FlushInfo::isEventDue(int64_t timestamp) {
+    const int64_t delta = timestamp - mLastEventTimestamp;
+    mLastEventTimestamp = timestamp;
+    // Send the event closest to when the next one is due, so that the connection gets events
+    // no slower than it asked for even when the sensor period is not a divisor of its own. A
+    // timestamp going backwards means the sensor was restarted.
+    if (mSamplingPeriodNs <= 0 || mLastSentTimestamp == 0 || delta <= 0 ||
+            timestamp + delta / 2 >= mLastSentTimestamp + mSamplingPeriodNs) {
+        mLastSentTimestamp = timestamp;
+        return true;
+    }
+    return false;
+}
+
 void SensorService::SensorEventConnection::updateLooperRegistration(const sp<Looper>& looper) {
     Mutex::Autolock _l(mConnectionLock);
     updateLooperRegistrationLocked(looper);
@@ -286,8 +332,9 @@ status_t SensorService::SensorEventConnection::sendEvents(
                     }
                 } else {
                     // Regular sensor event, just copy it to the scratch buffer after checking
-                    // the AppOp.
-                    if (hasSensorAccess() && noteOpIfRequired(buffer[i])) {
+                    // that it is due at the rate of this connection and the AppOp.
+                    if (flushInfo.isEventDue(buffer[i].timestamp) && hasSensorAccess() &&
+                            noteOpIfRequired(buffer[i])) {
                         scratch[count++] = buffer[i];
                     }
                 }
@@ -510,48 +557,56 @@ void SensorService::SensorEventConnection::writeToSocketFromCache() {
     Mutex::Autolock _l(mConnectionLock);
     // Send pending flush complete events (if any)
     sendPendingFlushEventsLocked();
-    for (int numEventsSent = 0; numEventsSent < mCacheSize;) {
-        const int numEventsToWrite = helpers::min(mCacheSize - numEventsSent, maxWriteSize);
-        int index_wake_up_event = -1;
-        if (hasSensorAccess()) {
-            index_wake_up_event =
-                      findWakeUpSensorEventLocked(mEventCache + numEventsSent, numEventsToWrite);
-            if (index_wake_up_event >= 0) {
-                mEventCache[index_wake_up_event + numEventsSent].flags |=
-                        WAKE_UP_SENSOR_EVENT_NEEDS_ACK;
+
+    // Every message carries at most maxWriteSize events, and the first wake up event of each
+    // one needs an ack. Flag them all up front so that the messages go out in one batch.
+    const bool needsAck = hasSensorAccess();
+    auto wakeUpEventOfMessage = [&](int start) -> sensors_event_t* {
+        const int count = helpers::min(mCacheSize - start, maxWriteSize);
+        const int index = findWakeUpSensorEventLocked(mEventCache + start, count);
+        return index < 0 ? nullptr : &mEventCache[start + index];
+    };
+    if (needsAck) {
+        for (int start = 0; start < mCacheSize; start += maxWriteSize) {
+            if (sensors_event_t* event = wakeUpEventOfMessage(start)) {
+                event->flags |= WAKE_UP_SENSOR_EVENT_NEEDS_ACK;
                 ++mWakeLockRefCount;
 #if DEBUG_CONNECTIONS
                 ++mTotalAcksNeeded;
 #endif
             }
         }
+    }
 
-        ssize_t size = SensorEventQueue::write(mChannel,
-                          reinterpret_cast<ASensorEvent const*>(mEventCache + numEventsSent),
-                          numEventsToWrite);
-        if (size < 0) {
-            if (index_wake_up_event >= 0) {
-                // If there was a wake_up sensor_event, reset the flag.
-                mEventCache[index_wake_up_event + numEventsSent].flags  &=
-                        ~WAKE_UP_SENSOR_EVENT_NEEDS_ACK;
-                if (mWakeLockRefCount > 0) {
-                    --mWakeLockRefCount;
-                }
+    ssize_t size = SensorEventQueue::write(mChannel,
+                      reinterpret_cast<ASensorEvent const*>(mEventCache), mCacheSize,
+                      maxWriteSize);
+    // Only whole messages are sent, so this is a multiple of maxWriteSize unless everything was.
+    const int numEventsSent = size < 0 ? 0 : int(size);
 #if DEBUG_CONNECTIONS
-                --mTotalAcksNeeded;
+    mEventsSentFromCache += numEventsSent;
 #endif
-            }
-            memmove(mEventCache, &mEventCache[numEventsSent],
-                                 (mCacheSize - numEventsSent) * sizeof(sensors_event_t));
-            ALOGD_IF(DEBUG_CONNECTIONS, "wrote %d events from cache size==%d ",
-                    numEventsSent, mCacheSize);
-            mCacheSize -= numEventsSent;
-            return;
-        }
-        numEventsSent += numEventsToWrite;
+    if (numEventsSent < mCacheSize) {
+        if (needsAck) {
+            // The messages that weren't sent will be flagged again on the next attempt.
+            for (int start = numEventsSent; start < mCacheSize; start += maxWriteSize) {
+                if (sensors_event_t* event = wakeUpEventOfMessage(start)) {
+                    event->flags &= ~WAKE_UP_SENSOR_EVENT_NEEDS_ACK;
+                    if (mWakeLockRefCount > 0) {
+                        --mWakeLockRefCount;
+                    }
 #if DEBUG_CONNECTIONS
-        mEventsSentFromCache += numEventsToWrite;
+                    --mTotalAcksNeeded;
 #endif
+                }
+            }
+        }
+        memmove(mEventCache, &mEventCache[numEventsSent],
+                             (mCacheSize - numEventsSent) * sizeof(sensors_event_t));
+        ALOGD_IF(DEBUG_CONNECTIONS, "wrote %d events from cache size==%d ",
+                numEventsSent, mCacheSize);
+        mCacheSize -= numEventsSent;
+        return;
     }
     ALOGD_IF(DEBUG_CONNECTIONS, "wrote all events from cache size=%d ", mCacheSize);
     // All events from the cache have been sent. Reset cache size to zero.
@@ -20,6 +20,7 @@
 #include <stdint.h>
 #include <sys/types.h>
 #include <unordered_map>
+#include <vector>
 
 #include <utils/Vector.h>
 #include <utils/SortedVector.h>
@@ -58,9 +59,16 @@ public:
     bool hasSensor(int32_t handle) const;
     bool hasAnySensor() const;
     bool hasOneShotSensors() const;
+    // Whether sendEvents has anything to do for a buffer holding events of the given sensors,
+    // sorted by handle: events of sensors in this connection, or flush complete events still
+    // to be sent.
+    bool hasEventsToSend(const std::vector<int32_t>& handles) const;
     bool addSensor(int32_t handle);
     bool removeSensor(int32_t handle);
     void setFirstFlushPending(int32_t handle, bool value);
+    // Sets the period at which this connection wants events of a continuous sensor, which may
+    // run faster for other connections. Zero sends every event.
+    void setSamplingPeriod(int32_t handle, nsecs_t samplingPeriodNs);
     void dump(String8& result);
     bool needsWakeLock();
     void resetWakeLockRefCount();
@@ -166,10 +174,26 @@ private:
         // the events for the sensor are sent on that *connection*.
         bool mFirstFlushPending;
 
-        FlushInfo() : mPendingFlushEventsToSend(0), mFirstFlushPending(false) {}
+        // Noted when the sensor is added, as dynamic sensors may be gone by the time they are
+        // removed.
+        bool mOneShot;
+
+        // The sampling period this connection asked for, and the timestamps of the last event
+        // seen and of the last event sent, used to decimate events of sensors running faster.
+        nsecs_t mSamplingPeriodNs;
+        int64_t mLastEventTimestamp;
+        int64_t mLastSentTimestamp;
+
+        FlushInfo() : mPendingFlushEventsToSend(0), mFirstFlushPending(false), mOneShot(false),
+                mSamplingPeriodNs(0), mLastEventTimestamp(0), mLastSentTimestamp(0) {}
+
+        // Whether an event with the given timestamp is to be sent at the requested rate
+        bool isEventDue(int64_t timestamp);
     };
     // protected by SensorService::mLock. Key for this vector is the sensor handle.
     KeyedVector<int, FlushInfo> mSensorInfo;
+    // The number of one-shot sensors in mSensorInfo, checked on every batch of events
+    size_t mOneShotSensorCount = 0;
 
     sensors_event_t *mEventCache;
     int mCacheSize, mMaxCacheSize;
@@ -17,6 +17,7 @@
 #include "SensorInterface.h"
 #include "SensorDevice.h"
 #include "SensorFusion.h"
+#include "SensorServiceUtils.h"
 
 #include <stdint.h>
 #include <sys/types.h>
@@ -84,5 +85,22 @@ VirtualSensor::VirtualSensor() :
         BaseSensor(DUMMY_SENSOR), mSensorFusion(SensorFusion::getInstance()) {
 }
 
+void VirtualSensor::setSensor(const sensor_t& sensor) {
+    mSensor = Sensor(&sensor);
+
+    // Direct reports are decimated from fusion updates, so only rates the fusion reaches
+    // are offered: 50Hz for RATE_NORMAL and 200Hz for RATE_FAST.
+    int32_t rateLevel = SENSOR_DIRECT_RATE_STOP;
+    const nsecs_t minDelayNs = mSensor.getMinDelayNs();
+    if (minDelayNs <= SensorServiceUtil::directReportPeriodNs(SENSOR_DIRECT_RATE_FAST)) {
+        rateLevel = SENSOR_DIRECT_RATE_FAST;
+    } else if (minDelayNs <= SensorServiceUtil::directReportPeriodNs(SENSOR_DIRECT_RATE_NORMAL)) {
+        rateLevel = SENSOR_DIRECT_RATE_NORMAL;
+    }
+    if (rateLevel != SENSOR_DIRECT_RATE_STOP) {
+        mSensor.setDirectReportSupport(rateLevel, SENSOR_FLAG_DIRECT_CHANNEL_ASHMEM);
+    }
+}
+
 // ---------------------------------------------------------------------------
 }; // namespace android
@@ -97,6 +97,9 @@ public:
     VirtualSensor();
     virtual bool isVirtual() const override { return true; }
 protected:
+    // Sets mSensor, advertising the direct reports SensorDirectConnection writes itself
+    void setSensor(const sensor_t& sensor);
+
     SensorFusion& mSensorFusion;
 };
 
@@ -19,6 +19,7 @@
 #include <binder/IServiceManager.h>
 #include <binder/PermissionCache.h>
 #include <binder/PermissionController.h>
+#include <binder/TransactionStats.h>
 #include <cutils/ashmem.h>
 #include <cutils/misc.h>
 #include <cutils/properties.h>
@@ -48,6 +49,7 @@
 #include "SensorRecord.h"
 #include "SensorRegistrationInfo.h"
 
+#include <algorithm>
 #include <ctime>
 #include <inttypes.h>
 #include <math.h>
@@ -311,7 +313,10 @@ const Sensor& SensorService::registerSensor(SensorInterface* s, bool isDebug, bo
     int handle = s->getSensor().getHandle();
     int type = s->getSensor().getType();
     if (mSensors.add(handle, s, isDebug, isVirtual)){
-        mRecentEvent.emplace(handle, new SensorServiceUtil::RecentEventLogger(type));
+        // The memory kept for the recent events of each sensor, 0 for the default by type
+        const int32_t logBudgetBytes = property_get_int32("debug.sensors.event_log_bytes", 0);
+        mRecentEvent.emplace(handle, new SensorServiceUtil::RecentEventLogger(type,
+                std::max(logBudgetBytes, 0)));
         return s->getSensor();
     } else {
         return mSensors.getNonSensor();
@@ -404,6 +409,18 @@ status_t SensorService::dump(int fd, const Vector<String16>& args) {
                 // Transition to data injection mode supported only from NORMAL mode.
                 return INVALID_OPERATION;
             }
+        } else if (args.size() >= 1 && args[0] == String16("--binder-stats")) {
+            // --binder-stats [enable|disable|clear]
+            if (args.size() == 2 && args[1] == String16("enable")) {
+                TransactionStats::setCallerStatsEnabled(true);
+            } else if (args.size() == 2 && args[1] == String16("disable")) {
+                TransactionStats::setCallerStatsEnabled(false);
+            } else if (args.size() == 2 && args[1] == String16("clear")) {
+                TransactionStats::resetCallers();
+            } else if (args.size() != 1) {
+                return BAD_VALUE;
+            }
+            TransactionStats::dumpCallers(result);
         } else if (!mSensors.hasAnySensor()) {
             result.append("No Sensors on the device\n");
             result.appendFormat("devInitCheck : %d\n", SensorDevice::getInstance().initCheck());
@@ -695,16 +712,22 @@ void SensorService::cleanupAutoDisabledSensorLocked(const sp<SensorEventConnecti
 bool SensorService::threadLoop() {
     ALOGD("nuSensorService thread starting...");
 
-    // each virtual sensor could generate an event per "real" event, that's why we need to size
-    // numEventMax much smaller than MAX_RECEIVE_BUFFER_EVENT_COUNT.  in practice, this is too
-    // aggressive, but guaranteed to be enough.
+    // each active virtual sensor could generate an event per "real" event, that's why we need to
+    // size numEventMax much smaller than MAX_RECEIVE_BUFFER_EVENT_COUNT.  in practice, this is too
+    // aggressive, but guaranteed to be enough. It starts out leaving room for all virtual sensors
+    // and then follows the ones active, so that batches flushed from HAL FIFOs are read in few
+    // polls when no virtual sensor is in use.
     const size_t vcount = mSensors.getVirtualSensors().size();
     const size_t minBufferSize = SensorEventQueue::MAX_RECEIVE_BUFFER_EVENT_COUNT;
-    const size_t numEventMax = minBufferSize / (1 + vcount);
+    size_t numEventMax = minBufferSize / (1 + vcount);
+    // The virtual sensors the pending poll left room for. The first poll leaves room for all of
+    // them, so this only matters from the second batch on.
+    std::unordered_set<int> polledVirtualSensors;
 
     SensorDevice& device(SensorDevice::getInstance());
 
     const int halVersion = device.getHalDeviceVersion();
+    std::vector<int32_t> batchHandles;
     do {
         ssize_t count = device.poll(mSensorEventBuffer, numEventMax);
         if (count < 0) {
@@ -754,8 +777,17 @@ bool SensorService::threadLoop() {
                         fusion.process(event[i]);
                     }
                 }
+                // A virtual sensor enabled while the poll was pending only has room in this
+                // batch if all active ones fit. Otherwise it starts with the next batch, as if
+                // it had been enabled right after this one, rather than some events of this
+                // batch being dropped when the buffer runs out.
+                const bool roomForAllActive =
+                        size_t(count) * (1 + mActiveVirtualSensors.size()) <= minBufferSize;
                 for (size_t i=0 ; i<size_t(count) && k<minBufferSize ; i++) {
                     for (int handle : mActiveVirtualSensors) {
+                        if (!roomForAllActive && polledVirtualSensors.count(handle) == 0) {
+                            continue;
+                        }
                         if (count + k >= minBufferSize) {
                             ALOGE("buffer too small to hold all events: "
                                     "count=%zd, k=%zu, size=%zu",
@@ -784,6 +816,8 @@ bool SensorService::threadLoop() {
                 }
             }
         }
+        polledVirtualSensors = mActiveVirtualSensors;
+        numEventMax = minBufferSize / (1 + polledVirtualSensors.size());
 
         // handle backward compatibility for RotationVector sensor
         if (halVersion < SENSORS_DEVICE_API_VERSION_1_0) {
@@ -858,12 +892,26 @@ bool SensorService::threadLoop() {
             }
         }
 
+        // The sensors with events in this batch, so that connections with none of them can be
+        // passed over without filtering the whole buffer for each.
+        batchHandles.clear();
+        for (int i = 0; i < count; ++i) {
+            const sensors_event_t& event = mSensorEventBuffer[i];
+            batchHandles.push_back(event.type == SENSOR_TYPE_META_DATA ?
+                    event.meta_data.sensor : event.sensor);
+        }
+        std::sort(batchHandles.begin(), batchHandles.end());
+        batchHandles.erase(std::unique(batchHandles.begin(), batchHandles.end()),
+                batchHandles.end());
+
         // Send our events to clients. Check the state of wake lock for each client and release the
         // lock if none of the clients need it.
         bool needsWakeLock = false;
         for (const sp<SensorEventConnection>& connection : activeConnections) {
-            connection->sendEvents(mSensorEventBuffer, count, mSensorEventScratch,
-                    mMapFlushEventsToConnections);
+            if (connection->hasEventsToSend(batchHandles)) {
+                connection->sendEvents(mSensorEventBuffer, count, mSensorEventScratch,
+                        mMapFlushEventsToConnections);
+            }
             needsWakeLock |= connection->needsWakeLock();
             // If the connection has one-shot sensors, it may be cleaned up after first trigger.
             // Early check for one-shot sensors.
@@ -872,6 +920,13 @@ bool SensorService::threadLoop() {
             }
         }
 
+        // Direct connections only get the virtual sensors here, the HAL writes the others
+        if (!mDirectVirtualSensorCounts.empty()) {
+            for (const sp<SensorDirectConnection>& connection : connLock.getDirectConnections()) {
+                connection->sendEvents(mSensorEventBuffer, count);
+            }
+        }
+
         if (mWakeLockAcquired && !needsWakeLock) {
             setWakeLockAcquiredLocked(false);
         }
@@ -1199,7 +1254,15 @@ sp<ISensorEventConnection> SensorService::createSensorDirectConnection(
     SensorDevice& dev(SensorDevice::getInstance());
     int channelHandle = dev.registerDirectChannel(&mem);
 
-    if (channelHandle <= 0) {
+    if (channelHandle <= 0 && type == SENSOR_DIRECT_MEM_TYPE_ASHMEM) {
+        // The service writes virtual sensors into ashmem itself, so those can still be
+        // reported without a HAL channel
+        ALOGD_IF(DEBUG_CONNECTIONS, "SensorDevice::registerDirectChannel returns %d, "
+                "only virtual sensors can be reported", channelHandle);
+        channelHandle = 0;
+    }
+
+    if (channelHandle < 0 || (channelHandle == 0 && type != SENSOR_DIRECT_MEM_TYPE_ASHMEM)) {
         ALOGE("SensorDevice::registerDirectChannel returns %d", channelHandle);
     } else {
         mem.handle = clone;
@@ -1349,7 +1412,9 @@ void SensorService::cleanupConnection(SensorEventConnection* c) {
         if (rec && rec->removeConnection(connection)) {
             ALOGD_IF(DEBUG_CONNECTIONS, "... and it was the last connection");
             mActiveSensors.removeItemsAt(i, 1);
-            mActiveVirtualSensors.erase(handle);
+            if (mDirectVirtualSensorCounts.count(handle) == 0) {
+                mActiveVirtualSensors.erase(handle);
+            }
             delete rec;
             size--;
         } else {
@@ -1378,8 +1443,10 @@ void SensorService::cleanupConnection(SensorEventConnection* c) {
 void SensorService::cleanupConnection(SensorDirectConnection* c) {
     Mutex::Autolock _l(mLock);
 
-    SensorDevice& dev(SensorDevice::getInstance());
-    dev.unregisterDirectChannel(c->getHalChannelHandle());
+    if (c->getHalChannelHandle() > 0) {
+        SensorDevice& dev(SensorDevice::getInstance());
+        dev.unregisterDirectChannel(c->getHalChannelHandle());
+    }
     mConnectionHolder.removeDirectConnection(c);
 }
 
@@ -1480,6 +1547,11 @@ status_t SensorService::enable(const sp<SensorEventConnection>& connection,
         samplingPeriodNs = minDelayNs;
     }
 
+    // The sensor runs at the fastest rate of its connections, decimate for this one
+    if (sensor->getSensor().getReportingMode() == AREPORTING_MODE_CONTINUOUS) {
+        connection->setSamplingPeriod(handle, samplingPeriodNs);
+    }
+
     ALOGD_IF(DEBUG_CONNECTIONS, "Calling batch handle==%d flags=%d"
                                 "rate=%" PRId64 " timeout== %" PRId64"",
              handle, reservedFlags, samplingPeriodNs, maxBatchReportLatencyNs);
@@ -1572,7 +1644,9 @@ status_t SensorService::cleanupWithoutDisableLocked(
         // see if this sensor becomes inactive
         if (rec->removeConnection(connection)) {
             mActiveSensors.removeItem(handle);
-            mActiveVirtualSensors.erase(handle);
+            if (mDirectVirtualSensorCounts.count(handle) == 0) {
+                mActiveVirtualSensors.erase(handle);
+            }
             delete rec;
         }
         return NO_ERROR;
@@ -1580,6 +1654,23 @@ status_t SensorService::cleanupWithoutDisableLocked(
     return BAD_VALUE;
 }
 
+void SensorService::addDirectVirtualSensorLocked(int handle) {
+    if (mDirectVirtualSensorCounts[handle]++ == 0) {
+        mActiveVirtualSensors.emplace(handle);
+    }
+}
+
+void SensorService::removeDirectVirtualSensorLocked(int handle) {
+    auto count = mDirectVirtualSensorCounts.find(handle);
+    if (count == mDirectVirtualSensorCounts.end() || --count->second > 0) {
+        return;
+    }
+    mDirectVirtualSensorCounts.erase(count);
+    if (mActiveSensors.indexOfKey(handle) < 0) {
+        mActiveVirtualSensors.erase(handle);
+    }
+}
+
 status_t SensorService::setEventRate(const sp<SensorEventConnection>& connection,
         int handle, nsecs_t ns, const String16& opPackageName) {
     if (mInitCheck != NO_ERROR)
@@ -1599,7 +1690,12 @@ status_t SensorService::setEventRate(const sp<SensorEventConnection>& connection
         ns = minDelayNs;
     }
 
-    return sensor->setDelay(connection.get(), handle, ns);
+    status_t err = sensor->setDelay(connection.get(), handle, ns);
+    if (err == NO_ERROR &&
+            sensor->getSensor().getReportingMode() == AREPORTING_MODE_CONTINUOUS) {
+        connection->setSamplingPeriod(handle, ns);
+    }
+    return err;
 }
 
 status_t SensorService::flushSensor(const sp<SensorEventConnection>& connection,
@@ -1781,7 +1877,10 @@ void SensorService::UidPolicy::unregisterSelf() {
     am.unregisterUidObserver(this);
 }
 
-void SensorService::UidPolicy::onUidGone(__unused uid_t uid, __unused bool disabled) {
+void SensorService::UidPolicy::onUidGone(uid_t uid, __unused bool disabled) {
+    // The uid is gone once its package is updated or removed, or a permission of it revoked,
+    // all of which kill its processes, so the permissions it had may no longer hold.
+    PermissionCache::invalidate(uid);
     onUidIdle(uid, disabled);
 }
 
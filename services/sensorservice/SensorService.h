@@ -301,6 +301,10 @@ private:
     status_t cleanupWithoutDisableLocked(const sp<SensorEventConnection>& connection, int handle);
     void cleanupAutoDisabledSensorLocked(const sp<SensorEventConnection>& connection,
             sensors_event_t const* buffer, const int count);
+    // Counts a direct connection report of a virtual sensor, whose events the connection
+    // then writes into its shared memory. Both are called with mLock held.
+    void addDirectVirtualSensorLocked(int handle);
+    void removeDirectVirtualSensorLocked(int handle);
     static bool canAccessSensor(const Sensor& sensor, const char* operation,
             const String16& opPackageName);
     static bool hasPermissionForSensor(const Sensor& sensor);
@@ -382,6 +386,9 @@ private:
     mutable Mutex mLock;
     DefaultKeyedVector<int, SensorRecord*> mActiveSensors;
     std::unordered_set<int> mActiveVirtualSensors;
+    // Number of direct connections reporting each virtual sensor, which stays in
+    // mActiveVirtualSensors while any does
+    std::unordered_map<int, size_t> mDirectVirtualSensorCounts;
     SensorConnectionHolder mConnectionHolder;
     bool mWakeLockAcquired;
     sensors_event_t *mSensorEventBuffer, *mSensorEventScratch;
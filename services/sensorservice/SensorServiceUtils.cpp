@@ -62,5 +62,18 @@ size_t eventSizeBySensorType(int type) {
     }
 }
 
+int64_t directReportPeriodNs(int rateLevel) {
+    switch (rateLevel) {
+        case SENSOR_DIRECT_RATE_NORMAL:
+            return 20000000; // 50Hz
+        case SENSOR_DIRECT_RATE_FAST:
+            return 5000000; // 200Hz
+        case SENSOR_DIRECT_RATE_VERY_FAST:
+            return 1250000; // 800Hz
+        default:
+            return 0;
+    }
+}
+
 } // namespace SensorServiceUtil
 } // namespace android;
@@ -18,6 +18,7 @@
 #define ANDROID_SENSOR_SERVICE_UTIL
 
 #include <cstddef>
+#include <cstdint>
 #include <string>
 
 namespace android {
@@ -32,6 +33,9 @@ public:
 
 size_t eventSizeBySensorType(int type);
 
+// Nominal sampling period of a SENSOR_DIRECT_RATE_* level, 0 for SENSOR_DIRECT_RATE_STOP
+int64_t directReportPeriodNs(int rateLevel);
+
 } // namespace SensorServiceUtil
 } // namespace android;
 
@@ -48,6 +48,7 @@
 #include <mutex>
 #include <sstream>
 
+#include "ClientCache.h"
 #include "Colorizer.h"
 #include "DisplayDevice.h"
 #include "LayerRejecter.h"
@@ -55,9 +56,10 @@
 
 namespace android {
 
-BufferLayer::BufferLayer(const LayerCreationArgs& args)
+BufferLayer::BufferLayer(const LayerCreationArgs& args, bool deferTexture)
       : Layer(args),
-        mTextureName(args.flinger->getNewTexture()),
+        mTextureName(deferTexture ? args.flinger->getPooledTexture()
+                                  : args.flinger->getNewTexture()),
         mCompositionLayer{mFlinger->getCompositionEngine().createLayer(
                 compositionengine::LayerCreationArgs{this})} {
     ALOGV("Creating Layer %s", args.name.string());
@@ -69,10 +71,21 @@ BufferLayer::BufferLayer(const LayerCreationArgs& args)
 }
 
 BufferLayer::~BufferLayer() {
-    mFlinger->deleteTextureAsync(mTextureName);
+    if (mTextureName != 0) {
+        mFlinger->deleteTextureAsync(mTextureName);
+    }
     mFlinger->mTimeStats->onDestroy(getSequence());
 }
 
+uint32_t BufferLayer::getTextureName() {
+    if (mTextureName == 0) {
+        // The pool was empty when the layer was created, and has been grown
+        // since. We are on the main thread, so there is no need to wait.
+        mFlinger->getRenderEngine().genTextures(1, &mTextureName);
+    }
+    return mTextureName;
+}
+
 void BufferLayer::useSurfaceDamage() {
     if (mFlinger->mForceFullDamage) {
         surfaceDamageRegion = Region::INVALID_REGION;
@@ -105,6 +118,10 @@ bool BufferLayer::isVisible() const {
     return visible;
 }
 
+size_t BufferLayer::getBufferBytes() const {
+    return mActiveBuffer != nullptr ? ClientCache::getBufferBytes(mActiveBuffer) : 0;
+}
+
 bool BufferLayer::isFixedSize() const {
     return getEffectiveScalingMode() != NATIVE_WINDOW_SCALING_MODE_FREEZE;
 }
@@ -171,7 +188,8 @@ bool BufferLayer::prepareClientLayer(const RenderArea& renderArea, const Region&
         layer.source.buffer.buffer = mActiveBuffer;
         layer.source.buffer.isOpaque = isOpaque(s);
         layer.source.buffer.fence = mActiveBufferFence;
-        layer.source.buffer.textureName = mTextureName;
+        layer.source.buffer.frameNumber = mCurrentFrameNumber;
+        layer.source.buffer.textureName = getTextureName();
         layer.source.buffer.usePremultipliedAlpha = getPremultipledAlpha();
         layer.source.buffer.isY410BT2020 = isHdrY410();
         // TODO: we could be more subtle with isFixedSize()
@@ -445,6 +463,10 @@ bool BufferLayer::latchBuffer(bool& recomputeVisibleRegions, nsecs_t latchTime)
         return false;
     }
 
+    // Have the image ready by the time the buffer is client composited, if it
+    // is. Buffers RenderEngine already caches are left alone.
+    mFlinger->getRenderEngine().prefetchExternalTextureBuffer(mActiveBuffer);
+
     mBufferLatched = true;
 
     err = updateFrameNumber(latchTime);
@@ -458,6 +480,7 @@ bool BufferLayer::latchBuffer(bool& recomputeVisibleRegions, nsecs_t latchTime)
         // the first time we receive a buffer, we need to trigger a
         // geometry invalidation.
         recomputeVisibleRegions = true;
+        invalidateBounds();
     }
 
     ui::Dataspace dataSpace = getDrawingDataSpace();
@@ -498,6 +521,7 @@ bool BufferLayer::latchBuffer(bool& recomputeVisibleRegions, nsecs_t latchTime)
         mCurrentScalingMode = scalingMode;
         mTransformToDisplayInverse = transformToDisplayInverse;
         recomputeVisibleRegions = true;
+        invalidateBounds();
     }
 
     if (oldBuffer != nullptr) {
@@ -505,6 +529,7 @@ bool BufferLayer::latchBuffer(bool& recomputeVisibleRegions, nsecs_t latchTime)
         uint32_t bufHeight = mActiveBuffer->getHeight();
         if (bufWidth != uint32_t(oldBuffer->width) || bufHeight != uint32_t(oldBuffer->height)) {
             recomputeVisibleRegions = true;
+            invalidateBounds();
         }
     }
 
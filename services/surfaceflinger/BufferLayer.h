@@ -47,7 +47,9 @@ namespace android {
 
 class BufferLayer : public Layer {
 public:
-    explicit BufferLayer(const LayerCreationArgs& args);
+    // If deferTexture is set, the texture name is only obtained when first
+    // used on the main thread, so that creating the layer never waits for it.
+    explicit BufferLayer(const LayerCreationArgs& args, bool deferTexture = false);
     virtual ~BufferLayer() override;
 
     // -----------------------------------------------------------------------
@@ -71,6 +73,8 @@ public:
     // isVisible - true if this layer is visible, false otherwise
     bool isVisible() const override;
 
+    size_t getBufferBytes() const override;
+
     // isProtected - true if the layer may contain protected content in the
     // GRALLOC_USAGE_PROTECTED sense.
     bool isProtected() const override;
@@ -160,8 +164,12 @@ protected:
 
     static bool getOpacityForFormat(uint32_t format);
 
-    // from GLES
-    const uint32_t mTextureName;
+    // Returns the texture name, obtaining one if it was deferred. Must be
+    // called on the main thread.
+    uint32_t getTextureName();
+
+    // from GLES, 0 until obtained if deferred
+    uint32_t mTextureName;
 
     bool mRefreshPending{false};
 
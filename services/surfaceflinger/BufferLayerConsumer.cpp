@@ -20,6 +20,7 @@
 //#define LOG_NDEBUG 0
 
 #include "BufferLayerConsumer.h"
+#include "ClientCache.h"
 #include "Layer.h"
 #include "Scheduler/DispSync.h"
 
@@ -207,6 +208,17 @@ sp<Fence> BufferLayerConsumer::getPrevFinalReleaseFence() const {
     return ConsumerBase::mPrevFinalReleaseFence;
 }
 
+size_t BufferLayerConsumer::getBufferBytes() const {
+    Mutex::Autolock lock(mMutex);
+    size_t bytes = 0;
+    for (const auto& slot : mSlots) {
+        if (slot.mGraphicBuffer != nullptr) {
+            bytes += ClientCache::getBufferBytes(slot.mGraphicBuffer);
+        }
+    }
+    return bytes;
+}
+
 status_t BufferLayerConsumer::acquireBufferLocked(BufferItem* item, nsecs_t presentWhen,
                                                   uint64_t maxFrameNumber) {
     status_t err = ConsumerBase::acquireBufferLocked(item, presentWhen, maxFrameNumber);
@@ -506,6 +518,11 @@ void BufferLayerConsumer::addAndGetFrameTimestamps(const NewFrameEventsEntry* ne
     }
 }
 
+base::unique_fd BufferLayerConsumer::getSharedFrameEvents() {
+    sp<Layer> l = mLayer.promote();
+    return l.get() ? l->getSharedFrameEvents() : base::unique_fd();
+}
+
 void BufferLayerConsumer::abandonLocked() {
     BLC_LOGV("abandonLocked");
     mCurrentTextureBuffer = nullptr;
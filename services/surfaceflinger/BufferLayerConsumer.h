@@ -109,6 +109,10 @@ public:
 
     sp<Fence> getPrevFinalReleaseFence() const;
 
+    // Bytes of the buffers acquired from the BufferQueue so far, which stay
+    // allocated until their slots are freed.
+    size_t getBufferBytes() const;
+
     // See GLConsumer::getTransformMatrix.
     void getTransformMatrix(float mtx[16]);
 
@@ -247,6 +251,7 @@ private:
     void onSidebandStreamChanged() override;
     void addAndGetFrameTimestamps(const NewFrameEventsEntry* newTimestamps,
                                   FrameEventHistoryDelta* outDelta) override;
+    base::unique_fd getSharedFrameEvents() override;
 
     // computeCurrentTransformMatrixLocked computes the transform matrix for the
     // current texture.  It uses mCurrentTransform and the current GraphicBuffer
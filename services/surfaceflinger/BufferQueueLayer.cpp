@@ -62,6 +62,17 @@ std::vector<OccupancyTracker::Segment> BufferQueueLayer::getOccupancyHistory(boo
     return history;
 }
 
+size_t BufferQueueLayer::getBufferBytes() const {
+    return mConsumer->getBufferBytes();
+}
+
+void BufferQueueLayer::reclaimBuffers() {
+    // Only free slots are discarded, so the buffer on screen stays
+    status_t result = mConsumer->discardFreeBuffers();
+    ALOGW_IF(result != NO_ERROR, "[%s] Failed to discard free buffers (%d)", mName.string(),
+             result);
+}
+
 bool BufferQueueLayer::getTransformToDisplayInverse() const {
     return mConsumer->getTransformToDisplayInverse();
 }
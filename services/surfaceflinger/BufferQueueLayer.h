@@ -49,6 +49,9 @@ public:
     // If a buffer was replaced this frame, release the former buffer
     void releasePendingBuffer(nsecs_t dequeueReadyTime) override;
 
+    size_t getBufferBytes() const override;
+    void reclaimBuffers() override;
+
     void setDefaultBufferSize(uint32_t w, uint32_t h) override;
 
     int32_t getQueuedFrameCount() const override;
@@ -46,7 +46,8 @@ const std::array<float, 16> BufferStateLayer::IDENTITY_MATRIX{
 // clang-format on
 
 BufferStateLayer::BufferStateLayer(const LayerCreationArgs& args)
-      : BufferLayer(args), mHwcSlotGenerator(new HwcSlotGenerator()) {
+      : BufferLayer(args, /*deferTexture*/ true),
+        mHwcSlotGenerator(new HwcSlotGenerator(mFlinger->mBufferStateLayerHwcSlots)) {
     mOverrideScalingMode = NATIVE_WINDOW_SCALING_MODE_SCALE_TO_WINDOW;
     mCurrentState.dataspace = ui::Dataspace::V0_SRGB;
 }
@@ -501,7 +502,7 @@ status_t BufferStateLayer::bindTextureImage() {
     const State& s(getDrawingState());
     auto& engine(mFlinger->getRenderEngine());
 
-    return engine.bindExternalTextureBuffer(mTextureName, s.buffer, s.acquireFence);
+    return engine.bindExternalTextureBuffer(getTextureName(), s.buffer, s.acquireFence);
 }
 
 status_t BufferStateLayer::updateTexImage(bool& /*recomputeVisibleRegions*/, nsecs_t latchTime) {
@@ -635,8 +636,8 @@ uint32_t BufferStateLayer::HwcSlotGenerator::getHwcCacheSlot(const client_cache_
     if (itr == mCachedBuffers.end()) {
         return addCachedBuffer(clientCacheId);
     }
-    auto& [hwcCacheSlot, counter] = itr->second;
-    counter = mCounter++;
+    auto& [hwcCacheSlot, lruPosition] = itr->second;
+    mLruBuffers.splice(mLruBuffers.begin(), mLruBuffers, lruPosition);
     return hwcCacheSlot;
 }
 
@@ -650,7 +651,8 @@ uint32_t BufferStateLayer::HwcSlotGenerator::addCachedBuffer(const client_cache_
     ClientCache::getInstance().registerErasedRecipient(clientCacheId, wp<ErasedRecipient>(this));
 
     uint32_t hwcCacheSlot = getFreeHwcCacheSlot();
-    mCachedBuffers[clientCacheId] = {hwcCacheSlot, mCounter++};
+    mLruBuffers.push_front(clientCacheId);
+    mCachedBuffers[clientCacheId] = {hwcCacheSlot, mLruBuffers.begin()};
     return hwcCacheSlot;
 }
 
@@ -665,18 +667,10 @@ uint32_t BufferStateLayer::HwcSlotGenerator::getFreeHwcCacheSlot() REQUIRES(mMut
 }
 
 void BufferStateLayer::HwcSlotGenerator::evictLeastRecentlyUsed() REQUIRES(mMutex) {
-    uint64_t minCounter = UINT_MAX;
-    client_cache_t minClientCacheId = {};
-    for (const auto& [clientCacheId, slotCounter] : mCachedBuffers) {
-        const auto& [hwcCacheSlot, counter] = slotCounter;
-        if (counter < minCounter) {
-            minCounter = counter;
-            minClientCacheId = clientCacheId;
-        }
-    }
-    eraseBufferLocked(minClientCacheId);
+    const client_cache_t lruClientCacheId = mLruBuffers.back();
+    eraseBufferLocked(lruClientCacheId);
 
-    ClientCache::getInstance().unregisterErasedRecipient(minClientCacheId, this);
+    ClientCache::getInstance().unregisterErasedRecipient(lruClientCacheId, this);
 }
 
 void BufferStateLayer::HwcSlotGenerator::eraseBufferLocked(const client_cache_t& clientCacheId)
@@ -685,11 +679,12 @@ void BufferStateLayer::HwcSlotGenerator::eraseBufferLocked(const client_cache_t&
     if (itr == mCachedBuffers.end()) {
         return;
     }
-    auto& [hwcCacheSlot, counter] = itr->second;
+    auto& [hwcCacheSlot, lruPosition] = itr->second;
 
     // TODO send to hwc cache and resources
 
     mFreeHwcCacheSlots.push(hwcCacheSlot);
-    mCachedBuffers.erase(clientCacheId);
+    mLruBuffers.erase(lruPosition);
+    mCachedBuffers.erase(itr);
 }
 } // namespace android
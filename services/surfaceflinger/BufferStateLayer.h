@@ -19,12 +19,14 @@
 #include "BufferLayer.h"
 #include "Layer.h"
 
+#include <compositionengine/impl/HwcBufferCache.h>
 #include <gui/GLConsumer.h>
 #include <renderengine/Image.h>
 #include <renderengine/RenderEngine.h>
 #include <system/window.h>
 #include <utils/String8.h>
 
+#include <list>
 #include <stack>
 
 namespace android {
@@ -162,11 +164,18 @@ private:
 
     // TODO(marissaw): support sticky transform for LEGACY camera mode
 
+    // Assigns the buffers of the layer, by client cache id, the HWC cache slots they were last
+    // sent in, evicting the least recently used buffer when all slotCount slots are taken.
     class HwcSlotGenerator : public ClientCache::ErasedRecipient {
     public:
-        HwcSlotGenerator() {
-            for (uint32_t i = 0; i < BufferQueue::NUM_BUFFER_SLOTS; i++) {
-                mFreeHwcCacheSlots.push(i);
+        explicit HwcSlotGenerator(uint32_t slotCount = BufferQueue::NUM_BUFFER_SLOTS) {
+            using compositionengine::impl::HwcBufferCache;
+            const size_t count = std::clamp(slotCount, uint32_t(1),
+                                            uint32_t(HwcBufferCache::SLOT_COUNT - 1));
+            for (uint32_t i = 0; mFreeHwcCacheSlots.size() < count; i++) {
+                if (i != HwcBufferCache::FLATTENER_CACHING_SLOT) {
+                    mFreeHwcCacheSlots.push(i);
+                }
             }
         }
 
@@ -189,15 +198,17 @@ private:
 
         std::mutex mMutex;
 
-        std::unordered_map<client_cache_t,
-                           std::pair<uint32_t /*HwcCacheSlot*/, uint32_t /*counter*/>,
-                           CachedBufferHash>
-                mCachedBuffers GUARDED_BY(mMutex);
+        struct CachedBuffer {
+            uint32_t hwcCacheSlot;
+            std::list<client_cache_t>::iterator lruPosition;
+        };
+
+        std::unordered_map<client_cache_t, CachedBuffer, CachedBufferHash> mCachedBuffers
+                GUARDED_BY(mMutex);
         std::stack<uint32_t /*HwcCacheSlot*/> mFreeHwcCacheSlots GUARDED_BY(mMutex);
 
-        // The cache increments this counter value when a slot is updated or used.
-        // Used to track the least recently-used buffer
-        uint64_t mCounter = 0;
+        // The cached buffers, most recently used first
+        std::list<client_cache_t> mLruBuffers GUARDED_BY(mMutex);
     };
 
     sp<HwcSlotGenerator> mHwcSlotGenerator;
@@ -21,6 +21,10 @@
 
 #include <cinttypes>
 
+#include <gui/ITransactionCompletedListener.h>
+#include <ui/PixelFormat.h>
+#include <utils/Trace.h>
+
 #include "ClientCache.h"
 
 namespace android {
@@ -29,6 +33,13 @@ ANDROID_SINGLETON_STATIC_INSTANCE(ClientCache);
 
 ClientCache::ClientCache() : mDeathRecipient(new CacheDeathRecipient) {}
 
+size_t ClientCache::getBufferBytes(const sp<GraphicBuffer>& buffer) {
+    // YUV formats have no bytes per pixel, but take no more than 2 in practice.
+    const ssize_t pixelBytes = bytesPerPixel(buffer->getPixelFormat());
+    return size_t(buffer->getStride()) * buffer->getHeight() * buffer->getLayerCount() *
+            (pixelBytes > 0 ? pixelBytes : 2);
+}
+
 bool ClientCache::getBuffer(const client_cache_t& cacheId,
                             ClientCacheBuffer** outClientCacheBuffer) {
     auto& [processToken, id] = cacheId;
@@ -67,7 +78,8 @@ bool ClientCache::add(const client_cache_t& cacheId, const sp<GraphicBuffer>& bu
         return false;
     }
 
-    std::lock_guard lock(mMutex);
+    PendingErase pendingErase;
+    std::unique_lock lock(mMutex);
     sp<IBinder> token;
 
     // If this is a new process token, set a death recipient. If the client process dies, we will
@@ -98,10 +110,86 @@ bool ClientCache::add(const client_cache_t& cacheId, const sp<GraphicBuffer>& bu
         return false;
     }
 
-    processBuffers[id].buffer = buffer;
+    ClientCacheBuffer& buf = processBuffers[id];
+    mTotalBytes -= buf.bytes;
+    buf.buffer = buffer;
+    buf.bytes = getBufferBytes(buffer);
+    buf.lastUsed = mUseCounter++;
+    mTotalBytes += buf.bytes;
+
+    evictLocked(cacheId, &pendingErase);
+    lock.unlock();
+
+    notifyErased(pendingErase);
     return true;
 }
 
+void ClientCache::setMaxBytes(size_t maxBytes) {
+    PendingErase pendingErase;
+    {
+        std::lock_guard lock(mMutex);
+        mMaxBytes = maxBytes;
+        evictLocked({}, &pendingErase);
+    }
+    notifyErased(pendingErase);
+}
+
+void ClientCache::evictLocked(const client_cache_t& keep, PendingErase* pendingErase) {
+    if (mMaxBytes == 0 || mTotalBytes <= mMaxBytes) {
+        return;
+    }
+    ATRACE_CALL();
+
+    std::vector<client_cache_t> evicted;
+    while (mTotalBytes > mMaxBytes) {
+        // There are at most BUFFER_CACHE_MAX_SIZE buffers per process, so scanning them is cheaper
+        // than keeping them ordered on every get.
+        client_cache_t lruId;
+        const ClientCacheBuffer* lru = nullptr;
+        for (const auto& [processToken, processBuffers] : mBuffers) {
+            for (const auto& [id, buf] : processBuffers) {
+                if ((processToken == keep.token && id == keep.id) ||
+                    (lru && lru->lastUsed <= buf.lastUsed)) {
+                    continue;
+                }
+                lruId = {processToken, id};
+                lru = &buf;
+            }
+        }
+        if (!lru) {
+            break;
+        }
+
+        collectRecipients(lruId, *lru, pendingErase);
+        mTotalBytes -= lru->bytes;
+        mBuffers[lruId.token].erase(lruId.id);
+        evicted.push_back(lruId);
+    }
+
+    for (const auto& cacheId : evicted) {
+        if (sp<IBinder> token = cacheId.token.promote()) {
+            interface_cast<ITransactionCompletedListener>(token)->onBufferEvicted(cacheId.id);
+        }
+    }
+    ALOGV("evicted %zu buffers, %zu bytes left cached", evicted.size(), mTotalBytes);
+}
+
+void ClientCache::collectRecipients(const client_cache_t& cacheId, const ClientCacheBuffer& buf,
+                                    PendingErase* pendingErase) {
+    for (auto& recipient : buf.recipients) {
+        sp<ErasedRecipient> erasedRecipient = recipient.promote();
+        if (erasedRecipient) {
+            pendingErase->emplace_back(erasedRecipient, cacheId);
+        }
+    }
+}
+
+void ClientCache::notifyErased(const PendingErase& pendingErase) {
+    for (auto& [recipient, cacheId] : pendingErase) {
+        recipient->bufferErased(cacheId);
+    }
+}
+
 void ClientCache::erase(const client_cache_t& cacheId) {
     auto& [processToken, id] = cacheId;
     std::vector<sp<ErasedRecipient>> pendingErase;
@@ -120,6 +208,7 @@ void ClientCache::erase(const client_cache_t& cacheId) {
             }
         }
 
+        mTotalBytes -= buf->bytes;
         mBuffers[processToken].erase(id);
     }
 
@@ -137,6 +226,7 @@ sp<GraphicBuffer> ClientCache::get(const client_cache_t& cacheId) {
         return nullptr;
     }
 
+    buf->lastUsed = mUseCounter++;
     return buf->buffer;
 }
 
@@ -181,6 +271,7 @@ void ClientCache::removeProcess(const wp<IBinder>& processToken) {
         }
 
         for (auto& [id, clientCacheBuffer] : itr->second) {
+            mTotalBytes -= clientCacheBuffer.bytes;
             client_cache_t cacheId = {processToken, id};
             for (auto& recipient : clientCacheBuffer.recipients) {
                 sp<ErasedRecipient> erasedRecipient = recipient.promote();
@@ -29,6 +29,7 @@
 #include <unordered_map>
 
 #define BUFFER_CACHE_MAX_SIZE 64
+#define BUFFER_CACHE_DEFAULT_MAX_BYTES (1024 * 1024 * 1024)
 
 namespace android {
 
@@ -43,6 +44,14 @@ public:
 
     void removeProcess(const wp<IBinder>& processToken);
 
+    // Sets how many bytes of buffers all processes together may have cached. Past that, the least
+    // recently used buffers are evicted, their recipients notified through bufferErased, and the
+    // caching process told to send them again. 0 means no limit.
+    void setMaxBytes(size_t maxBytes);
+
+    // Approximate bytes of graphics memory buffer holds
+    static size_t getBufferBytes(const sp<GraphicBuffer>& buffer);
+
     class ErasedRecipient : public virtual RefBase {
     public:
         virtual void bufferErased(const client_cache_t& clientCacheId) = 0;
@@ -59,11 +68,20 @@ private:
     struct ClientCacheBuffer {
         sp<GraphicBuffer> buffer;
         std::set<wp<ErasedRecipient>> recipients;
+        size_t bytes = 0;
+        uint64_t lastUsed = 0;
     };
     std::map<wp<IBinder> /*caching process*/,
              std::unordered_map<uint64_t /*cache id*/, ClientCacheBuffer>>
             mBuffers GUARDED_BY(mMutex);
 
+    size_t mMaxBytes GUARDED_BY(mMutex) = BUFFER_CACHE_DEFAULT_MAX_BYTES;
+    size_t mTotalBytes GUARDED_BY(mMutex) = 0;
+    uint64_t mUseCounter GUARDED_BY(mMutex) = 0;
+
+    // Recipients to notify once mMutex is released
+    using PendingErase = std::vector<std::pair<sp<ErasedRecipient>, client_cache_t>>;
+
     class CacheDeathRecipient : public IBinder::DeathRecipient {
     public:
         void binderDied(const wp<IBinder>& who) override;
@@ -73,6 +91,12 @@ private:
 
     bool getBuffer(const client_cache_t& cacheId, ClientCacheBuffer** outClientCacheBuffer)
             REQUIRES(mMutex);
+
+    // Evicts least recently used buffers other than keep until the cache is within mMaxBytes
+    void evictLocked(const client_cache_t& keep, PendingErase* pendingErase) REQUIRES(mMutex);
+    static void collectRecipients(const client_cache_t& cacheId, const ClientCacheBuffer& buf,
+                                  PendingErase* pendingErase);
+    static void notifyErased(const PendingErase& pendingErase);
 };
 
 }; // namespace android
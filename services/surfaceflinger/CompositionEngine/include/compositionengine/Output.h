@@ -67,8 +67,10 @@ public:
     // belongsInOutput for full details.
     virtual void setLayerStackFilter(uint32_t layerStackId, bool isInternal) = 0;
 
-    // Sets the color transform matrix to use
-    virtual void setColorTransform(const mat4&) = 0;
+    // Sets the color transform matrix to use, along with a hint of what the
+    // matrix does. A non-identity matrix may only be hinted as something other
+    // than HAL_COLOR_TRANSFORM_ARBITRARY_MATRIX if it is that transform.
+    virtual void setColorTransform(const mat4&, android_color_transform_t hint) = 0;
 
     // Sets the output color mode
     virtual void setColorMode(ui::ColorMode, ui::Dataspace, ui::RenderIntent) = 0;
@@ -76,6 +76,11 @@ public:
     // Allocates a buffer as scratch space for GPU composition
     virtual sp<GraphicBuffer> dequeueBuffer(base::unique_fd* bufferFence) = 0;
 
+    // Returns how many frames ago the last dequeued buffer was queued, so
+    // what it holds is the result of that frame. 0 if its contents are
+    // undefined.
+    virtual int32_t getBufferAge() const = 0;
+
     // Queues the drawn buffer for consumption by HWC. readyFence is the fence
     // which will fire when the buffer is ready for consumption.
     virtual void queueBuffer(base::unique_fd&& readyFence) = 0;
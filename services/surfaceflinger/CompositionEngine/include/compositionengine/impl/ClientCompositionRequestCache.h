@@ -0,0 +1,66 @@
+/*
+ * Copyright 2019 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <deque>
+#include <vector>
+
+#include <renderengine/DisplaySettings.h>
+#include <renderengine/LayerSettings.h>
+
+namespace android::compositionengine::impl {
+
+// Remembers what client composition last drew into each of an output's
+// recently used client target buffers. When the request for a frame is the
+// same as the one a dequeued buffer already holds, drawing it again would not
+// change a pixel, so RenderEngine can be skipped and the buffer queued as is.
+//
+// The damage region of the display settings is not part of a request, as it
+// only says how much of the buffer to redraw.
+class ClientCompositionRequestCache {
+public:
+    // The client target is at most triple buffered
+    static constexpr size_t kMaxBuffers = 3;
+
+    // True if the buffer with the given id holds exactly what the request draws
+    bool exists(uint64_t bufferId, const renderengine::DisplaySettings&,
+                const std::vector<renderengine::LayerSettings>&) const;
+
+    // Records the request drawn into the buffer with the given id, evicting the
+    // least recently drawn buffer if need be.
+    void add(uint64_t bufferId, const renderengine::DisplaySettings&,
+             const std::vector<renderengine::LayerSettings>&);
+
+    // Forgets what the buffer with the given id holds, e.g. because it was drawn
+    // into without going through the cache.
+    void remove(uint64_t bufferId);
+
+    size_t size() const { return mEntries.size(); }
+
+private:
+    struct Entry {
+        uint64_t bufferId;
+        renderengine::DisplaySettings display;
+        std::vector<renderengine::LayerSettings> layers;
+    };
+
+    // Most recently drawn first
+    std::deque<Entry> mEntries;
+};
+
+} // namespace android::compositionengine::impl
@@ -38,7 +38,7 @@ public:
 
     // compositionengine::Output overrides
     void dump(std::string&) const override;
-    void setColorTransform(const mat4&) override;
+    void setColorTransform(const mat4&, android_color_transform_t hint) override;
     void setColorMode(ui::ColorMode, ui::Dataspace, ui::RenderIntent) override;
 
     // compositionengine::Display overrides
@@ -0,0 +1,126 @@
+/*
+ * Copyright 2019 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <compositionengine/Output.h>
+#include <ui/Fence.h>
+#include <ui/GraphicBuffer.h>
+#include <ui/GraphicTypes.h>
+#include <ui/Rect.h>
+
+namespace android::compositionengine {
+
+class Layer;
+class OutputLayer;
+
+namespace impl {
+
+// Tracks which layers of an output have stopped changing, and picks the
+// longest run of them adjacent in z order to be composited once into a single
+// buffer. Until one of them changes again, that buffer is shown on the HWC
+// layer of the bottom-most layer of the run, and the others are hidden, so
+// HWC spends one plane instead of several on static content.
+//
+// The Flattener only keeps the books and drives the HWC layers. Rendering the
+// run into a buffer is left to the caller, which knows how to draw its layers.
+class Flattener {
+public:
+    // How many consecutive frames a layer has to stay the same for before it
+    // can be flattened with its neighbours.
+    static constexpr uint32_t kDefaultFramesUntilFlattened = 30;
+
+    explicit Flattener(uint32_t framesUntilFlattened = kDefaultFramesUntilFlattened);
+
+    // Records this frame's state of the output layers, which must already be
+    // fully written to HWC for the frame, and updates the flattened run.
+    void updateLayers(const Output::OutputLayers&);
+
+    // The flattened run, as indices into the output layers ordered by z
+    bool hasRun() const { return !mRunLayers.empty(); }
+    size_t getRunStart() const { return mRunStart; }
+    size_t getRunSize() const { return mRunLayers.size(); }
+    const Rect& getRunBounds() const { return mRunBounds; }
+
+    // True if the layer at the given z index is currently being shown through
+    // the cached buffer.
+    bool isFlattened(size_t index) const {
+        return mBuffer != nullptr && index >= mRunStart && index < mRunStart + mRunLayers.size();
+    }
+
+    // True if there is a run but no buffer holding it yet
+    bool needsRender() const { return hasRun() && mBuffer == nullptr; }
+
+    // Sets the buffer the run was rendered into, in output space, along with
+    // the fence signaling the end of rendering.
+    void setBuffer(const sp<GraphicBuffer>&, const sp<Fence>& readyFence, ui::Dataspace);
+
+    // Gives up on the current run, e.g. because HWC could not take the
+    // cached buffer. Its layers have to stay the same for as long again before
+    // they are flattened the next time.
+    void abandonRun();
+
+    // Writes the cached buffer over the HWC state of the run, or restores the
+    // state of layers which just left it. Must be called after updateLayers.
+    void writeStateToHWC(const Output::OutputLayers&);
+
+    void dump(std::string&) const;
+
+private:
+    struct LayerHistory {
+        size_t hash = 0;
+        uint32_t framesUnchanged = 0;
+        uint64_t lastFrame = 0;
+    };
+
+    bool canFlatten(const OutputLayer&) const;
+    bool isRunIntact(const Output::OutputLayers&);
+    void clearRun();
+
+    const uint32_t mFramesUntilFlattened;
+    uint64_t mFrame = 0;
+
+    std::unordered_map<const Layer*, LayerHistory> mLayerHistory;
+
+    // The layers in the run, bottom-most first, and where the run starts
+    std::vector<const Layer*> mRunLayers;
+    size_t mRunStart = 0;
+    Rect mRunBounds;
+
+    sp<GraphicBuffer> mBuffer;
+    sp<Fence> mReadyFence;
+    ui::Dataspace mDataspace = ui::Dataspace::UNKNOWN;
+    bool mBufferPresented = false;
+
+    // Layers which left the run and need their own state written back to HWC
+    std::vector<const Layer*> mLayersToRestore;
+
+    struct Stats {
+        uint64_t runsRendered = 0;
+        uint64_t runsAbandoned = 0;
+        uint64_t framesFlattened = 0;
+        uint64_t layersFlattened = 0;
+    };
+    Stats mStats;
+};
+
+} // namespace impl
+} // namespace android::compositionengine
@@ -39,6 +39,14 @@ namespace compositionengine::impl {
 // use HWComposerBufferCache to mirror the cache in SF.
 class HwcBufferCache {
 public:
+    // An extra slot past the BufferQueue ones, reserved for the buffer the
+    // Flattener composites a layer's neighbours into.
+    static constexpr int FLATTENER_CACHING_SLOT = BufferQueue::NUM_BUFFER_SLOTS;
+    // The number of slots HWC caches for each layer. Those past the
+    // Flattener one are only used by BufferStateLayer, whose buffers are not
+    // tied to BufferQueue slots.
+    static constexpr int SLOT_COUNT = 2 * BufferQueue::NUM_BUFFER_SLOTS;
+
     HwcBufferCache();
     // Given a buffer, return the HWC cache slot and
     // buffer to be sent to HWC.
@@ -52,7 +60,7 @@ private:
     // an array where the index corresponds to a slot and the value corresponds to a (counter,
     // buffer) pair. "counter" is a unique value that indicates the last time this slot was updated
     // or used and allows us to keep track of the least-recently used buffer.
-    wp<GraphicBuffer> mBuffers[BufferQueue::NUM_BUFFER_SLOTS];
+    wp<GraphicBuffer> mBuffers[SLOT_COUNT];
 };
 
 } // namespace compositionengine::impl
@@ -44,7 +44,7 @@ public:
     void setBounds(const ui::Size&) override;
     void setLayerStackFilter(uint32_t layerStackId, bool isInternal) override;
 
-    void setColorTransform(const mat4&) override;
+    void setColorTransform(const mat4&, android_color_transform_t hint) override;
     void setColorMode(ui::ColorMode, ui::Dataspace, ui::RenderIntent) override;
 
     void dump(std::string&) const override;
@@ -54,6 +54,7 @@ public:
     status_t beginFrame(bool mustRecompose) override;
     status_t prepareFrame() override;
     sp<GraphicBuffer> dequeueBuffer(base::unique_fd* bufferFence) override;
+    int32_t getBufferAge() const override { return mBufferAge; }
     void queueBuffer(base::unique_fd&& readyFence) override;
     void onPresentDisplayCompleted() override;
     void setViewportAndProjection() override;
@@ -77,6 +78,8 @@ private:
     const sp<ANativeWindow> mNativeWindow;
     // Current buffer being rendered into
     sp<GraphicBuffer> mGraphicBuffer;
+    // Age of mGraphicBuffer when it was dequeued
+    int32_t mBufferAge{0};
     const sp<DisplaySurface> mDisplaySurface;
     ui::Size mSize;
     bool mProtected{false};
@@ -40,7 +40,7 @@ public:
     MOCK_METHOD1(setBounds, void(const ui::Size&));
     MOCK_METHOD2(setLayerStackFilter, void(uint32_t, bool));
 
-    MOCK_METHOD1(setColorTransform, void(const mat4&));
+    MOCK_METHOD2(setColorTransform, void(const mat4&, android_color_transform_t));
     MOCK_METHOD3(setColorMode, void(ui::ColorMode, ui::Dataspace, ui::RenderIntent));
 
     MOCK_CONST_METHOD1(dump, void(std::string&));
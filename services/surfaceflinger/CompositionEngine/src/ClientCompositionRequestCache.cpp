@@ -0,0 +1,60 @@
+/*
+ * Copyright 2019 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <algorithm>
+
+#include <compositionengine/impl/ClientCompositionRequestCache.h>
+
+namespace android::compositionengine::impl {
+
+namespace {
+
+bool hasSameSettings(const renderengine::DisplaySettings& cached,
+                     const renderengine::DisplaySettings& display) {
+    // Entries are stored without damage, so compare with the request's ignored
+    renderengine::DisplaySettings undamaged = display;
+    undamaged.damageRegion = Region::INVALID_REGION;
+    return cached == undamaged;
+}
+
+} // namespace
+
+bool ClientCompositionRequestCache::exists(
+        uint64_t bufferId, const renderengine::DisplaySettings& display,
+        const std::vector<renderengine::LayerSettings>& layers) const {
+    const auto it = std::find_if(mEntries.begin(), mEntries.end(),
+                                 [&](const Entry& entry) { return entry.bufferId == bufferId; });
+    return it != mEntries.end() && it->layers == layers && hasSameSettings(it->display, display);
+}
+
+void ClientCompositionRequestCache::add(uint64_t bufferId,
+                                        const renderengine::DisplaySettings& display,
+                                        const std::vector<renderengine::LayerSettings>& layers) {
+    remove(bufferId);
+    if (mEntries.size() >= kMaxBuffers) {
+        mEntries.pop_back();
+    }
+    Entry& entry = mEntries.emplace_front(Entry{bufferId, display, layers});
+    entry.display.damageRegion = Region::INVALID_REGION;
+}
+
+void ClientCompositionRequestCache::remove(uint64_t bufferId) {
+    mEntries.erase(std::remove_if(mEntries.begin(), mEntries.end(),
+                                  [&](const Entry& entry) { return entry.bufferId == bufferId; }),
+                   mEntries.end());
+}
+
+} // namespace android::compositionengine::impl
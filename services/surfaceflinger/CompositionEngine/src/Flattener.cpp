@@ -0,0 +1,334 @@
+/*
+ * Copyright 2019 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <algorithm>
+#include <cinttypes>
+#include <functional>
+
+#include <android-base/stringprintf.h>
+#include <compositionengine/Layer.h>
+#include <compositionengine/LayerFE.h>
+#include <compositionengine/OutputLayer.h>
+#include <compositionengine/impl/Flattener.h>
+#include <compositionengine/impl/LayerCompositionState.h>
+#include <compositionengine/impl/OutputLayerCompositionState.h>
+#include <utils/Trace.h>
+
+#include "DisplayHardware/HWComposer.h"
+
+namespace android::compositionengine::impl {
+
+namespace {
+
+template <typename T>
+void hashCombine(size_t& seed, const T& value) {
+    seed ^= std::hash<T>{}(value) + 0x9e3779b9 + (seed << 6) + (seed >> 2);
+}
+
+void hashRect(size_t& seed, const Rect& rect) {
+    hashCombine(seed, rect.left);
+    hashCombine(seed, rect.top);
+    hashCombine(seed, rect.right);
+    hashCombine(seed, rect.bottom);
+}
+
+// Hashes everything about a layer which shows up in what it draws on the
+// output. A new frame always comes with a new buffer or acquire fence.
+size_t hashLayerState(const OutputLayer& outputLayer) {
+    const auto& state = outputLayer.getState();
+    const auto& frontEnd = outputLayer.getLayer().getState().frontEnd;
+
+    size_t hash = 0;
+    hashRect(hash, state.displayFrame);
+    hashCombine(hash, state.sourceCrop.left);
+    hashCombine(hash, state.sourceCrop.top);
+    hashCombine(hash, state.sourceCrop.right);
+    hashCombine(hash, state.sourceCrop.bottom);
+    hashCombine(hash, static_cast<int32_t>(state.bufferTransform));
+    hashCombine(hash, state.z);
+    for (const Rect& rect : state.visibleRegion) {
+        hashRect(hash, rect);
+    }
+    hashCombine(hash, state.hwc ? static_cast<int32_t>(state.hwc->hwcCompositionType) : -1);
+
+    hashCombine(hash, frontEnd.buffer.get());
+    hashCombine(hash, frontEnd.acquireFence.get());
+    hashCombine(hash, static_cast<int32_t>(frontEnd.blendMode));
+    hashCombine(hash, frontEnd.alpha);
+    hashCombine(hash, static_cast<int32_t>(frontEnd.dataspace));
+    hashCombine(hash, frontEnd.color.r);
+    hashCombine(hash, frontEnd.color.g);
+    hashCombine(hash, frontEnd.color.b);
+    hashCombine(hash, frontEnd.color.a);
+    return hash;
+}
+
+bool isHdrDataspace(ui::Dataspace dataspace) {
+    const auto transfer = static_cast<ui::Dataspace>(static_cast<uint32_t>(dataspace) &
+                                                     static_cast<uint32_t>(
+                                                             ui::Dataspace::TRANSFER_MASK));
+    return transfer == ui::Dataspace::TRANSFER_ST2084 || transfer == ui::Dataspace::TRANSFER_HLG;
+}
+
+} // namespace
+
+Flattener::Flattener(uint32_t framesUntilFlattened)
+      : mFramesUntilFlattened(framesUntilFlattened) {}
+
+bool Flattener::canFlatten(const OutputLayer& outputLayer) const {
+    const auto& state = outputLayer.getState();
+    if (!state.hwc || state.displayFrame.isEmpty()) {
+        return false;
+    }
+
+    // Only layers HWC would otherwise put on their own plane are worth it.
+    // Client composited layers are drawn by the GPU each frame anyway.
+    const auto type = state.hwc->hwcCompositionType;
+    if (type != Hwc2::IComposerClient::Composition::DEVICE &&
+        type != Hwc2::IComposerClient::Composition::SOLID_COLOR) {
+        return false;
+    }
+
+    const auto& frontEnd = outputLayer.getLayer().getState().frontEnd;
+    if (frontEnd.sidebandStream != nullptr || isHdrDataspace(frontEnd.dataspace) ||
+        frontEnd.colorTransform != mat4()) {
+        return false;
+    }
+    if (frontEnd.buffer != nullptr && (frontEnd.buffer->getUsage() & GRALLOC_USAGE_PROTECTED)) {
+        return false;
+    }
+
+    auto it = mLayerHistory.find(&outputLayer.getLayer());
+    return it != mLayerHistory.end() && it->second.framesUnchanged >= mFramesUntilFlattened;
+}
+
+bool Flattener::isRunIntact(const Output::OutputLayers& outputLayers) {
+    auto start = std::find_if(outputLayers.begin(), outputLayers.end(), [&](const auto& layer) {
+        return &layer->getLayer() == mRunLayers.front();
+    });
+    if (start == outputLayers.end() ||
+        static_cast<size_t>(outputLayers.end() - start) < mRunLayers.size()) {
+        return false;
+    }
+
+    for (size_t i = 0; i < mRunLayers.size(); i++) {
+        const auto& outputLayer = *(start + i);
+        if (&outputLayer->getLayer() != mRunLayers[i] || !canFlatten(*outputLayer)) {
+            return false;
+        }
+    }
+
+    // Layers above or below the run may have come and gone
+    mRunStart = static_cast<size_t>(start - outputLayers.begin());
+    return true;
+}
+
+void Flattener::clearRun() {
+    mLayersToRestore.insert(mLayersToRestore.end(), mRunLayers.begin(), mRunLayers.end());
+    mRunLayers.clear();
+    mRunStart = 0;
+    mRunBounds = Rect::EMPTY_RECT;
+    mBuffer = nullptr;
+    mReadyFence = nullptr;
+    mBufferPresented = false;
+}
+
+void Flattener::updateLayers(const Output::OutputLayers& outputLayers) {
+    ATRACE_CALL();
+
+    mFrame++;
+    for (const auto& outputLayer : outputLayers) {
+        const size_t hash = hashLayerState(*outputLayer);
+        auto [it, inserted] = mLayerHistory.try_emplace(&outputLayer->getLayer());
+        auto& history = it->second;
+        if (inserted || history.hash != hash) {
+            history.hash = hash;
+            history.framesUnchanged = 0;
+        } else if (history.framesUnchanged < mFramesUntilFlattened) {
+            history.framesUnchanged++;
+        }
+        history.lastFrame = mFrame;
+    }
+    for (auto it = mLayerHistory.begin(); it != mLayerHistory.end();) {
+        it = it->second.lastFrame == mFrame ? std::next(it) : mLayerHistory.erase(it);
+    }
+
+    if (hasRun()) {
+        if (isRunIntact(outputLayers)) {
+            if (mBuffer != nullptr) {
+                mStats.framesFlattened++;
+            }
+            return;
+        }
+        clearRun();
+    }
+
+    // Pick the longest run of at least two layers which can be flattened
+    size_t bestStart = 0;
+    size_t bestSize = 0;
+    for (size_t i = 0; i < outputLayers.size();) {
+        if (!canFlatten(*outputLayers[i])) {
+            i++;
+            continue;
+        }
+        size_t end = i + 1;
+        while (end < outputLayers.size() && canFlatten(*outputLayers[end])) {
+            end++;
+        }
+        if (end - i > bestSize) {
+            bestStart = i;
+            bestSize = end - i;
+        }
+        i = end;
+    }
+    if (bestSize < 2) {
+        return;
+    }
+
+    Region bounds;
+    mRunStart = bestStart;
+    for (size_t i = bestStart; i < bestStart + bestSize; i++) {
+        mRunLayers.push_back(&outputLayers[i]->getLayer());
+        bounds.orSelf(outputLayers[i]->getState().displayFrame);
+    }
+    mRunBounds = bounds.getBounds();
+}
+
+void Flattener::setBuffer(const sp<GraphicBuffer>& buffer, const sp<Fence>& readyFence,
+                          ui::Dataspace dataspace) {
+    mBuffer = buffer;
+    mReadyFence = readyFence;
+    mDataspace = dataspace;
+    mBufferPresented = false;
+    mStats.runsRendered++;
+    mStats.layersFlattened += mRunLayers.size();
+}
+
+void Flattener::abandonRun() {
+    for (const auto* layer : mRunLayers) {
+        if (auto it = mLayerHistory.find(layer); it != mLayerHistory.end()) {
+            it->second.framesUnchanged = 0;
+        }
+    }
+    clearRun();
+    mStats.runsAbandoned++;
+}
+
+void Flattener::writeStateToHWC(const Output::OutputLayers& outputLayers) {
+    ATRACE_CALL();
+
+    if (!mLayersToRestore.empty()) {
+        for (const auto& outputLayer : outputLayers) {
+            auto it = std::find(mLayersToRestore.begin(), mLayersToRestore.end(),
+                                &outputLayer->getLayer());
+            if (it == mLayersToRestore.end() || !outputLayer->getState().hwc) {
+                continue;
+            }
+            // The frame's own buffer and per-frame state have been written
+            // already. Put the geometry back, and make sure HWC picks up the
+            // whole buffer again rather than just what changed since.
+            outputLayer->writeStateToHWC(true);
+            auto& hwcLayer = outputLayer->getState().hwc->hwcLayer;
+            if (auto error = hwcLayer->setSurfaceDamage(Region::INVALID_REGION);
+                error != HWC2::Error::None) {
+                ALOGE("[%s] Failed to restore surface damage: %s (%d)",
+                      outputLayer->getLayerFE().getDebugName(), to_string(error).c_str(),
+                      static_cast<int32_t>(error));
+            }
+        }
+        mLayersToRestore.clear();
+    }
+
+    if (mBuffer == nullptr) {
+        return;
+    }
+
+    for (size_t i = mRunStart; i < mRunStart + mRunLayers.size(); i++) {
+        const auto& outputLayer = outputLayers[i];
+        auto& hwcState = *outputLayer->editState().hwc;
+        auto& hwcLayer = hwcState.hwcLayer;
+        const char* name = outputLayer->getLayerFE().getDebugName();
+
+        if (i != mRunStart) {
+            // Already part of the cached buffer
+            if (auto error = hwcLayer->setPlaneAlpha(0.f); error != HWC2::Error::None) {
+                ALOGE("[%s] Failed to hide flattened layer: %s (%d)", name,
+                      to_string(error).c_str(), static_cast<int32_t>(error));
+            }
+            continue;
+        }
+
+        uint32_t hwcSlot = 0;
+        sp<GraphicBuffer> hwcBuffer;
+        hwcState.hwcBufferCache.getHwcBuffer(HwcBufferCache::FLATTENER_CACHING_SLOT, mBuffer,
+                                             &hwcSlot, &hwcBuffer);
+        const sp<Fence>& acquireFence = mBufferPresented ? Fence::NO_FENCE : mReadyFence;
+        const Region damage = mBufferPresented ? Region() : Region(mRunBounds);
+        mBufferPresented = true;
+
+        auto error = hwcLayer->setBuffer(hwcSlot, hwcBuffer, acquireFence);
+        if (error == HWC2::Error::None) {
+            error = hwcLayer->setDisplayFrame(mRunBounds);
+        }
+        if (error == HWC2::Error::None) {
+            error = hwcLayer->setSourceCrop(mRunBounds.toFloatRect());
+        }
+        if (error == HWC2::Error::None) {
+            error = hwcLayer->setTransform(HWC2::Transform::None);
+        }
+        if (error == HWC2::Error::None) {
+            error = hwcLayer->setBlendMode(HWC2::BlendMode::Premultiplied);
+        }
+        if (error == HWC2::Error::None) {
+            error = hwcLayer->setPlaneAlpha(1.f);
+        }
+        if (error == HWC2::Error::None) {
+            error = hwcLayer->setDataspace(mDataspace);
+        }
+        if (error == HWC2::Error::None) {
+            error = hwcLayer->setVisibleRegion(Region(mRunBounds));
+        }
+        if (error == HWC2::Error::None) {
+            error = hwcLayer->setSurfaceDamage(damage);
+        }
+        if (error == HWC2::Error::None &&
+            hwcState.hwcCompositionType != Hwc2::IComposerClient::Composition::DEVICE) {
+            error = hwcLayer->setCompositionType(HWC2::Composition::Device);
+            hwcState.hwcCompositionType = Hwc2::IComposerClient::Composition::DEVICE;
+        }
+        if (error != HWC2::Error::None) {
+            ALOGE("[%s] Failed to set cached buffer for %zu layers: %s (%d)", name,
+                  mRunLayers.size(), to_string(error).c_str(), static_cast<int32_t>(error));
+        }
+    }
+}
+
+void Flattener::dump(std::string& out) const {
+    using android::base::StringAppendF;
+
+    StringAppendF(&out,
+                  "  Layer caching: %zu layers tracked, %" PRIu64 " runs rendered (%" PRIu64
+                  " layers), %" PRIu64 " abandoned, %" PRIu64 " frames flattened\n",
+                  mLayerHistory.size(), mStats.runsRendered, mStats.layersFlattened,
+                  mStats.runsAbandoned, mStats.framesFlattened);
+    if (hasRun()) {
+        StringAppendF(&out, "    run of %zu layers from z %zu, bounds [%d %d %d %d]%s\n",
+                      mRunLayers.size(), mRunStart, mRunBounds.left, mRunBounds.top,
+                      mRunBounds.right, mRunBounds.bottom, mBuffer ? "" : " (not rendered)");
+    }
+}
+
+} // namespace android::compositionengine::impl
@@ -27,8 +27,7 @@ HwcBufferCache::HwcBufferCache() {
 void HwcBufferCache::getHwcBuffer(int slot, const sp<GraphicBuffer>& buffer, uint32_t* outSlot,
                                   sp<GraphicBuffer>* outBuffer) {
     // default is 0
-    if (slot == BufferQueue::INVALID_BUFFER_SLOT || slot < 0 ||
-        slot >= BufferQueue::NUM_BUFFER_SLOTS) {
+    if (slot == BufferQueue::INVALID_BUFFER_SLOT || slot < 0 || slot >= SLOT_COUNT) {
         *outSlot = 0;
     } else {
         *outSlot = slot;
@@ -88,15 +88,14 @@ void Output::setLayerStackFilter(uint32_t layerStackId, bool isInternal) {
     dirtyEntireOutput();
 }
 
-void Output::setColorTransform(const mat4& transform) {
-    if (mState.colorTransformMat == transform) {
+void Output::setColorTransform(const mat4& transform, android_color_transform_t hint) {
+    const bool isIdentity = (transform == mat4());
+    const auto newColorTransform = isIdentity ? HAL_COLOR_TRANSFORM_IDENTITY : hint;
+
+    if (mState.colorTransformMat == transform && mState.colorTransform == newColorTransform) {
         return;
     }
 
-    const bool isIdentity = (transform == mat4());
-    const auto newColorTransform =
-            isIdentity ? HAL_COLOR_TRANSFORM_IDENTITY : HAL_COLOR_TRANSFORM_ARBITRARY_MATRIX;
-
     mState.colorTransform = newColorTransform;
     mState.colorTransformMat = transform;
 
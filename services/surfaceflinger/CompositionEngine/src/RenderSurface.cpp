@@ -157,6 +157,12 @@ sp<GraphicBuffer> RenderSurface::dequeueBuffer(base::unique_fd* bufferFence) {
              mGraphicBuffer->getNativeBuffer()->handle);
     mGraphicBuffer = GraphicBuffer::from(buffer);
 
+    int age = 0;
+    if (mNativeWindow->query(mNativeWindow.get(), NATIVE_WINDOW_BUFFER_AGE, &age) != NO_ERROR) {
+        age = 0;
+    }
+    mBufferAge = age;
+
     *bufferFence = base::unique_fd(fd);
 
     return mGraphicBuffer;
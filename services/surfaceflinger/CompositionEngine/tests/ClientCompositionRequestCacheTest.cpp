@@ -0,0 +1,144 @@
+/*
+ * Copyright 2019 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <compositionengine/impl/ClientCompositionRequestCache.h>
+#include <gtest/gtest.h>
+
+namespace android::compositionengine {
+namespace {
+
+using impl::ClientCompositionRequestCache;
+
+class ClientCompositionRequestCacheTest : public testing::Test {
+public:
+    ClientCompositionRequestCacheTest() {
+        mDisplay.physicalDisplay = Rect(0, 0, 1080, 1920);
+        mDisplay.clip = mDisplay.physicalDisplay;
+
+        renderengine::LayerSettings layer;
+        layer.geometry.boundaries = FloatRect(0.f, 0.f, 100.f, 100.f);
+        layer.source.solidColor = half3(1.f, 0.f, 0.f);
+        layer.alpha = half(1.f);
+        mLayers.push_back(layer);
+    }
+
+    ClientCompositionRequestCache mCache;
+    renderengine::DisplaySettings mDisplay;
+    std::vector<renderengine::LayerSettings> mLayers;
+};
+
+TEST_F(ClientCompositionRequestCacheTest, nothingExistsInitially) {
+    EXPECT_FALSE(mCache.exists(1, mDisplay, mLayers));
+}
+
+TEST_F(ClientCompositionRequestCacheTest, findsTheRequestOfTheSameBuffer) {
+    mCache.add(1, mDisplay, mLayers);
+
+    EXPECT_TRUE(mCache.exists(1, mDisplay, mLayers));
+    EXPECT_FALSE(mCache.exists(2, mDisplay, mLayers));
+}
+
+TEST_F(ClientCompositionRequestCacheTest, ignoresDamage) {
+    mCache.add(1, mDisplay, mLayers);
+
+    mDisplay.damageRegion = Region(Rect(0, 0, 10, 10));
+    EXPECT_TRUE(mCache.exists(1, mDisplay, mLayers));
+}
+
+TEST_F(ClientCompositionRequestCacheTest, missesChangedLayers) {
+    mCache.add(1, mDisplay, mLayers);
+
+    auto moved = mLayers;
+    moved[0].geometry.boundaries = FloatRect(10.f, 0.f, 110.f, 100.f);
+    EXPECT_FALSE(mCache.exists(1, mDisplay, moved));
+
+    auto faded = mLayers;
+    faded[0].alpha = half(0.5f);
+    EXPECT_FALSE(mCache.exists(1, mDisplay, faded));
+
+    auto more = mLayers;
+    more.push_back(mLayers[0]);
+    EXPECT_FALSE(mCache.exists(1, mDisplay, more));
+}
+
+TEST_F(ClientCompositionRequestCacheTest, missesNewFramesInTheSameBuffer) {
+    mLayers[0].source.buffer.buffer = new GraphicBuffer();
+    mLayers[0].source.buffer.fence = Fence::NO_FENCE;
+    mLayers[0].source.buffer.frameNumber = 1;
+    mCache.add(1, mDisplay, mLayers);
+
+    auto nextFrame = mLayers;
+    nextFrame[0].source.buffer.frameNumber = 2;
+    EXPECT_FALSE(mCache.exists(1, mDisplay, nextFrame));
+
+    auto otherBuffer = mLayers;
+    otherBuffer[0].source.buffer.buffer = new GraphicBuffer();
+    EXPECT_FALSE(mCache.exists(1, mDisplay, otherBuffer));
+}
+
+TEST_F(ClientCompositionRequestCacheTest, findsTheSameFrameWithAnotherFence) {
+    mLayers[0].source.buffer.buffer = new GraphicBuffer();
+    mLayers[0].source.buffer.frameNumber = 1;
+    mCache.add(1, mDisplay, mLayers);
+
+    auto refenced = mLayers;
+    refenced[0].source.buffer.fence = Fence::NO_FENCE;
+    EXPECT_TRUE(mCache.exists(1, mDisplay, refenced));
+}
+
+TEST_F(ClientCompositionRequestCacheTest, missesChangedDisplaySettings) {
+    mCache.add(1, mDisplay, mLayers);
+
+    auto display = mDisplay;
+    display.clearRegion = Region(Rect(0, 0, 10, 10));
+    EXPECT_FALSE(mCache.exists(1, display, mLayers));
+
+    display = mDisplay;
+    display.outputDataspace = ui::Dataspace::DISPLAY_P3;
+    EXPECT_FALSE(mCache.exists(1, display, mLayers));
+}
+
+TEST_F(ClientCompositionRequestCacheTest, replacesTheRequestOfABuffer) {
+    mCache.add(1, mDisplay, mLayers);
+    auto faded = mLayers;
+    faded[0].alpha = half(0.5f);
+    mCache.add(1, mDisplay, faded);
+
+    EXPECT_EQ(1u, mCache.size());
+    EXPECT_FALSE(mCache.exists(1, mDisplay, mLayers));
+    EXPECT_TRUE(mCache.exists(1, mDisplay, faded));
+}
+
+TEST_F(ClientCompositionRequestCacheTest, evictsTheLeastRecentlyDrawnBuffer) {
+    for (uint64_t id = 1; id <= ClientCompositionRequestCache::kMaxBuffers + 1; id++) {
+        mCache.add(id, mDisplay, mLayers);
+    }
+
+    EXPECT_EQ(ClientCompositionRequestCache::kMaxBuffers, mCache.size());
+    EXPECT_FALSE(mCache.exists(1, mDisplay, mLayers));
+    EXPECT_TRUE(mCache.exists(ClientCompositionRequestCache::kMaxBuffers + 1, mDisplay, mLayers));
+}
+
+TEST_F(ClientCompositionRequestCacheTest, forgetsRemovedBuffers) {
+    mCache.add(1, mDisplay, mLayers);
+    mCache.remove(1);
+
+    EXPECT_EQ(0u, mCache.size());
+    EXPECT_FALSE(mCache.exists(1, mDisplay, mLayers));
+}
+
+} // namespace
+} // namespace android::compositionengine
@@ -117,20 +117,35 @@ TEST_F(DisplayTest, setColorTransformSetsTransform) {
 
     EXPECT_CALL(mCompositionEngine, getHwComposer()).WillRepeatedly(ReturnRef(mHwComposer));
 
-    EXPECT_CALL(mHwComposer, setColorTransform(DEFAULT_DISPLAY_ID, identity)).Times(1);
+    EXPECT_CALL(mHwComposer,
+                setColorTransform(DEFAULT_DISPLAY_ID, identity, HAL_COLOR_TRANSFORM_IDENTITY))
+            .Times(1);
 
-    mDisplay.setColorTransform(identity);
+    mDisplay.setColorTransform(identity, HAL_COLOR_TRANSFORM_ARBITRARY_MATRIX);
 
     EXPECT_EQ(HAL_COLOR_TRANSFORM_IDENTITY, mDisplay.getState().colorTransform);
 
     // Non-identity matrix sets a non-identity state value
     const mat4 nonIdentity = mat4() * 2;
 
-    EXPECT_CALL(mHwComposer, setColorTransform(DEFAULT_DISPLAY_ID, nonIdentity)).Times(1);
+    EXPECT_CALL(mHwComposer,
+                setColorTransform(DEFAULT_DISPLAY_ID, nonIdentity,
+                                  HAL_COLOR_TRANSFORM_ARBITRARY_MATRIX))
+            .Times(1);
 
-    mDisplay.setColorTransform(nonIdentity);
+    mDisplay.setColorTransform(nonIdentity, HAL_COLOR_TRANSFORM_ARBITRARY_MATRIX);
 
     EXPECT_EQ(HAL_COLOR_TRANSFORM_ARBITRARY_MATRIX, mDisplay.getState().colorTransform);
+
+    // The hint is passed through to the composer
+    EXPECT_CALL(mHwComposer,
+                setColorTransform(DEFAULT_DISPLAY_ID, nonIdentity,
+                                  HAL_COLOR_TRANSFORM_CORRECT_DEUTERANOPIA))
+            .Times(1);
+
+    mDisplay.setColorTransform(nonIdentity, HAL_COLOR_TRANSFORM_CORRECT_DEUTERANOPIA);
+
+    EXPECT_EQ(HAL_COLOR_TRANSFORM_CORRECT_DEUTERANOPIA, mDisplay.getState().colorTransform);
 }
 
 /* ------------------------------------------------------------------------
@@ -0,0 +1,189 @@
+/*
+ * Copyright 2019 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <compositionengine/impl/Flattener.h>
+#include <compositionengine/mock/Layer.h>
+#include <compositionengine/mock/LayerFE.h>
+#include <compositionengine/mock/OutputLayer.h>
+#include <gtest/gtest.h>
+
+#include "MockHWC2.h"
+#include "RegionMatcher.h"
+
+namespace android::compositionengine {
+namespace {
+
+using testing::_;
+using testing::NiceMock;
+using testing::Return;
+using testing::ReturnRef;
+
+constexpr uint32_t kFramesUntilFlattened = 2;
+
+const Rect kLayerFrames[] = {Rect(0, 0, 100, 100), Rect(0, 100, 100, 200), Rect(50, 50, 150, 150),
+                             Rect(0, 0, 200, 200)};
+constexpr size_t kLayerCount = sizeof(kLayerFrames) / sizeof(kLayerFrames[0]);
+
+class FlattenerTest : public testing::Test {
+public:
+    struct TestLayer {
+        mock::OutputLayer* outputLayer = nullptr;
+        std::shared_ptr<mock::Layer> layer{new NiceMock<mock::Layer>()};
+        sp<mock::LayerFE> layerFE{new NiceMock<mock::LayerFE>()};
+        std::shared_ptr<HWC2::mock::Layer> hwcLayer{new NiceMock<HWC2::mock::Layer>()};
+        impl::LayerCompositionState layerState;
+        impl::OutputLayerCompositionState outputLayerState;
+    };
+
+    FlattenerTest() {
+        for (size_t i = 0; i < kLayerCount; i++) {
+            auto& testLayer = mTestLayers[i];
+            auto outputLayer = std::make_unique<NiceMock<mock::OutputLayer>>();
+            testLayer.outputLayer = outputLayer.get();
+
+            testLayer.outputLayerState.displayFrame = kLayerFrames[i];
+            testLayer.outputLayerState.z = i;
+            testLayer.outputLayerState.hwc =
+                    impl::OutputLayerCompositionState::Hwc(testLayer.hwcLayer);
+            testLayer.outputLayerState.hwc->hwcCompositionType =
+                    Hwc2::IComposerClient::Composition::DEVICE;
+            testLayer.layerState.frontEnd.buffer = new GraphicBuffer();
+
+            ON_CALL(*outputLayer, getState()).WillByDefault(ReturnRef(testLayer.outputLayerState));
+            ON_CALL(*outputLayer, editState()).WillByDefault(ReturnRef(testLayer.outputLayerState));
+            ON_CALL(*outputLayer, getLayer()).WillByDefault(ReturnRef(*testLayer.layer));
+            ON_CALL(*outputLayer, getLayerFE()).WillByDefault(ReturnRef(*testLayer.layerFE));
+            ON_CALL(*testLayer.layer, getState()).WillByDefault(ReturnRef(testLayer.layerState));
+            ON_CALL(*testLayer.layerFE, getDebugName()).WillByDefault(Return("Test LayerFE"));
+
+            mOutputLayers.emplace_back(std::move(outputLayer));
+        }
+    }
+
+    void updateLayers(size_t frames) {
+        for (size_t i = 0; i < frames; i++) {
+            mFlattener.updateLayers(mOutputLayers);
+        }
+    }
+
+    TestLayer mTestLayers[kLayerCount];
+    Output::OutputLayers mOutputLayers;
+    impl::Flattener mFlattener{kFramesUntilFlattened};
+    sp<GraphicBuffer> mCachedBuffer{new GraphicBuffer()};
+    sp<Fence> mReadyFence{new Fence()};
+};
+
+TEST_F(FlattenerTest, layersAreNotFlattenedUntilTheyStopChanging) {
+    updateLayers(kFramesUntilFlattened);
+    EXPECT_FALSE(mFlattener.hasRun());
+
+    updateLayers(1);
+    ASSERT_TRUE(mFlattener.hasRun());
+    EXPECT_TRUE(mFlattener.needsRender());
+    EXPECT_EQ(0u, mFlattener.getRunStart());
+    EXPECT_EQ(kLayerCount, mFlattener.getRunSize());
+    EXPECT_EQ(Rect(0, 0, 200, 200), mFlattener.getRunBounds());
+    EXPECT_FALSE(mFlattener.isFlattened(0));
+
+    mFlattener.setBuffer(mCachedBuffer, mReadyFence, ui::Dataspace::SRGB);
+    EXPECT_FALSE(mFlattener.needsRender());
+    EXPECT_TRUE(mFlattener.isFlattened(0));
+    EXPECT_TRUE(mFlattener.isFlattened(kLayerCount - 1));
+    EXPECT_FALSE(mFlattener.isFlattened(kLayerCount));
+}
+
+TEST_F(FlattenerTest, runStaysWhileNothingChanges) {
+    updateLayers(kFramesUntilFlattened + 1);
+    mFlattener.setBuffer(mCachedBuffer, mReadyFence, ui::Dataspace::SRGB);
+
+    updateLayers(10);
+    EXPECT_TRUE(mFlattener.hasRun());
+    EXPECT_FALSE(mFlattener.needsRender());
+}
+
+TEST_F(FlattenerTest, newBufferBreaksTheRun) {
+    updateLayers(kFramesUntilFlattened + 1);
+    mFlattener.setBuffer(mCachedBuffer, mReadyFence, ui::Dataspace::SRGB);
+
+    mTestLayers[1].layerState.frontEnd.buffer = new GraphicBuffer();
+    updateLayers(1);
+
+    // Only the last two layers are left unchanged
+    ASSERT_TRUE(mFlattener.hasRun());
+    EXPECT_TRUE(mFlattener.needsRender());
+    EXPECT_EQ(2u, mFlattener.getRunStart());
+    EXPECT_EQ(2u, mFlattener.getRunSize());
+    EXPECT_EQ(Rect(0, 0, 200, 200), mFlattener.getRunBounds());
+}
+
+TEST_F(FlattenerTest, clientComposedLayersAreNotFlattened) {
+    mTestLayers[1].outputLayerState.hwc->hwcCompositionType =
+            Hwc2::IComposerClient::Composition::CLIENT;
+    mTestLayers[3].outputLayerState.hwc->hwcCompositionType =
+            Hwc2::IComposerClient::Composition::CLIENT;
+    updateLayers(kFramesUntilFlattened + 1);
+
+    EXPECT_FALSE(mFlattener.hasRun());
+}
+
+TEST_F(FlattenerTest, cachedBufferReplacesTheRunInHwc) {
+    updateLayers(kFramesUntilFlattened + 1);
+    mFlattener.setBuffer(mCachedBuffer, mReadyFence, ui::Dataspace::SRGB);
+
+    auto& lead = *mTestLayers[0].hwcLayer;
+    EXPECT_CALL(lead,
+                setBuffer(impl::HwcBufferCache::FLATTENER_CACHING_SLOT, mCachedBuffer, mReadyFence))
+            .WillOnce(Return(HWC2::Error::None));
+    EXPECT_CALL(lead, setDisplayFrame(Rect(0, 0, 200, 200))).WillOnce(Return(HWC2::Error::None));
+    EXPECT_CALL(lead, setBlendMode(HWC2::BlendMode::Premultiplied))
+            .WillOnce(Return(HWC2::Error::None));
+    EXPECT_CALL(lead, setDataspace(ui::Dataspace::SRGB)).WillOnce(Return(HWC2::Error::None));
+    for (size_t i = 1; i < kLayerCount; i++) {
+        EXPECT_CALL(*mTestLayers[i].hwcLayer, setPlaneAlpha(0.f))
+                .WillOnce(Return(HWC2::Error::None));
+        EXPECT_CALL(*mTestLayers[i].hwcLayer, setBuffer(_, _, _)).Times(0);
+    }
+    mFlattener.writeStateToHWC(mOutputLayers);
+
+    // The buffer is only sent, and waited for, the first time
+    EXPECT_CALL(lead,
+                setBuffer(impl::HwcBufferCache::FLATTENER_CACHING_SLOT, sp<GraphicBuffer>(),
+                          Fence::NO_FENCE))
+            .WillOnce(Return(HWC2::Error::None));
+    mFlattener.writeStateToHWC(mOutputLayers);
+}
+
+TEST_F(FlattenerTest, abandonedRunIsRestoredAndNotRetriedRightAway) {
+    updateLayers(kFramesUntilFlattened + 1);
+    mFlattener.setBuffer(mCachedBuffer, mReadyFence, ui::Dataspace::SRGB);
+    mFlattener.abandonRun();
+    EXPECT_FALSE(mFlattener.hasRun());
+
+    for (auto& testLayer : mTestLayers) {
+        EXPECT_CALL(*testLayer.outputLayer, writeStateToHWC(true));
+        EXPECT_CALL(*testLayer.hwcLayer, setSurfaceDamage(RegionEq(Region::INVALID_REGION)))
+                .WillOnce(Return(HWC2::Error::None));
+    }
+    mFlattener.writeStateToHWC(mOutputLayers);
+
+    updateLayers(kFramesUntilFlattened - 1);
+    EXPECT_FALSE(mFlattener.hasRun());
+    updateLayers(1);
+    EXPECT_TRUE(mFlattener.hasRun());
+}
+
+} // namespace
+} // namespace android::compositionengine
@@ -78,6 +78,24 @@ TEST_F(HwcBufferCacheTest, cacheWorksForMaxSlot) {
     testSlot(BufferQueue::NUM_BUFFER_SLOTS - 1, BufferQueue::NUM_BUFFER_SLOTS - 1);
 }
 
+TEST_F(HwcBufferCacheTest, cacheWorksForFlattenerCachingSlot) {
+    testSlot(impl::HwcBufferCache::FLATTENER_CACHING_SLOT,
+             impl::HwcBufferCache::FLATTENER_CACHING_SLOT);
+}
+
+TEST_F(HwcBufferCacheTest, cacheWorksPastTheFlattenerCachingSlot) {
+    testSlot(impl::HwcBufferCache::FLATTENER_CACHING_SLOT + 1,
+             impl::HwcBufferCache::FLATTENER_CACHING_SLOT + 1);
+}
+
+TEST_F(HwcBufferCacheTest, cacheWorksForLastSlot) {
+    testSlot(impl::HwcBufferCache::SLOT_COUNT - 1, impl::HwcBufferCache::SLOT_COUNT - 1);
+}
+
+TEST_F(HwcBufferCacheTest, cacheMapsSlotsPastTheLastSlotToZero) {
+    testSlot(impl::HwcBufferCache::SLOT_COUNT, 0);
+}
+
 TEST_F(HwcBufferCacheTest, cacheMapsNegativeSlotToZero) {
     testSlot(-123, 0);
 }
@@ -169,7 +169,7 @@ TEST_F(OutputTest, setColorTransformSetsTransform) {
     // Identity matrix sets an identity state value
     const mat4 identity;
 
-    mOutput.setColorTransform(identity);
+    mOutput.setColorTransform(identity, HAL_COLOR_TRANSFORM_ARBITRARY_MATRIX);
 
     EXPECT_EQ(HAL_COLOR_TRANSFORM_IDENTITY, mOutput.getState().colorTransform);
     EXPECT_EQ(identity, mOutput.getState().colorTransformMat);
@@ -180,7 +180,7 @@ TEST_F(OutputTest, setColorTransformSetsTransform) {
     // Non-identity matrix sets a non-identity state value
     const mat4 nonIdentityHalf = mat4() * 0.5;
 
-    mOutput.setColorTransform(nonIdentityHalf);
+    mOutput.setColorTransform(nonIdentityHalf, HAL_COLOR_TRANSFORM_ARBITRARY_MATRIX);
 
     EXPECT_EQ(HAL_COLOR_TRANSFORM_ARBITRARY_MATRIX, mOutput.getState().colorTransform);
     EXPECT_EQ(nonIdentityHalf, mOutput.getState().colorTransformMat);
@@ -191,7 +191,7 @@ TEST_F(OutputTest, setColorTransformSetsTransform) {
     // Non-identity matrix sets a non-identity state value
     const mat4 nonIdentityQuarter = mat4() * 0.25;
 
-    mOutput.setColorTransform(nonIdentityQuarter);
+    mOutput.setColorTransform(nonIdentityQuarter, HAL_COLOR_TRANSFORM_ARBITRARY_MATRIX);
 
     EXPECT_EQ(HAL_COLOR_TRANSFORM_ARBITRARY_MATRIX, mOutput.getState().colorTransform);
     EXPECT_EQ(nonIdentityQuarter, mOutput.getState().colorTransformMat);
@@ -200,6 +200,28 @@ TEST_F(OutputTest, setColorTransformSetsTransform) {
     EXPECT_THAT(mOutput.getState().dirtyRegion, RegionEq(Region(kDefaultDisplaySize)));
 }
 
+TEST_F(OutputTest, setColorTransformKeepsHint) {
+    const mat4 grayscale = mat4() * 0.5;
+
+    mOutput.setColorTransform(grayscale, HAL_COLOR_TRANSFORM_GRAYSCALE);
+
+    EXPECT_EQ(HAL_COLOR_TRANSFORM_GRAYSCALE, mOutput.getState().colorTransform);
+    EXPECT_EQ(grayscale, mOutput.getState().colorTransformMat);
+    EXPECT_THAT(mOutput.getState().dirtyRegion, RegionEq(Region(kDefaultDisplaySize)));
+
+    // A change of hint alone is still a state change
+    mOutput.editState().dirtyRegion.clear();
+    mOutput.setColorTransform(grayscale, HAL_COLOR_TRANSFORM_ARBITRARY_MATRIX);
+
+    EXPECT_EQ(HAL_COLOR_TRANSFORM_ARBITRARY_MATRIX, mOutput.getState().colorTransform);
+    EXPECT_THAT(mOutput.getState().dirtyRegion, RegionEq(Region(kDefaultDisplaySize)));
+
+    // The identity matrix is always hinted as such
+    mOutput.setColorTransform(mat4(), HAL_COLOR_TRANSFORM_GRAYSCALE);
+
+    EXPECT_EQ(HAL_COLOR_TRANSFORM_IDENTITY, mOutput.getState().colorTransform);
+}
+
 /* ------------------------------------------------------------------------
  * Output::setColorMode
  */
@@ -265,11 +265,29 @@ TEST_F(RenderSurfaceTest, dequeueBufferObtainsABuffer) {
     EXPECT_CALL(*mNativeWindow, dequeueBuffer(_, _))
             .WillOnce(
                     DoAll(SetArgPointee<0>(buffer.get()), SetArgPointee<1>(-1), Return(NO_ERROR)));
+    EXPECT_CALL(*mNativeWindow, query(NATIVE_WINDOW_BUFFER_AGE, _))
+            .WillOnce(DoAll(SetArgPointee<1>(2), Return(NO_ERROR)));
 
     base::unique_fd fence;
     EXPECT_EQ(buffer.get(), mSurface.dequeueBuffer(&fence).get());
 
     EXPECT_EQ(buffer.get(), mSurface.mutableGraphicBufferForTest().get());
+    EXPECT_EQ(2, mSurface.getBufferAge());
+}
+
+TEST_F(RenderSurfaceTest, dequeueBufferHandlesUnknownBufferAge) {
+    sp<GraphicBuffer> buffer = new GraphicBuffer();
+
+    EXPECT_CALL(*mNativeWindow, dequeueBuffer(_, _))
+            .WillOnce(
+                    DoAll(SetArgPointee<0>(buffer.get()), SetArgPointee<1>(-1), Return(NO_ERROR)));
+    EXPECT_CALL(*mNativeWindow, query(NATIVE_WINDOW_BUFFER_AGE, _))
+            .WillOnce(DoAll(SetArgPointee<1>(2), Return(INVALID_OPERATION)));
+
+    base::unique_fd fence;
+    EXPECT_EQ(buffer.get(), mSurface.dequeueBuffer(&fence).get());
+
+    EXPECT_EQ(0, mSurface.getBufferAge());
 }
 
 /* ------------------------------------------------------------------------
@@ -327,6 +345,8 @@ TEST_F(RenderSurfaceTest, queueBufferHandlesFlipClientTargetRequestWithNoBufferY
     EXPECT_CALL(*mNativeWindow, dequeueBuffer(_, _))
             .WillOnce(
                     DoAll(SetArgPointee<0>(buffer.get()), SetArgPointee<1>(-1), Return(NO_ERROR)));
+    EXPECT_CALL(*mNativeWindow, query(NATIVE_WINDOW_BUFFER_AGE, _))
+            .WillOnce(DoAll(SetArgPointee<1>(0), Return(NO_ERROR)));
     EXPECT_CALL(*mNativeWindow, queueBuffer(buffer->getNativeBuffer(), -1))
             .WillOnce(Return(NO_ERROR));
     EXPECT_CALL(*mDisplaySurface, advanceFrame()).Times(1);
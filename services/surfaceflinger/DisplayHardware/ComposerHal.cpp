@@ -18,11 +18,14 @@
 #define LOG_TAG "HwcComposer"
 
 #include <inttypes.h>
+
+#include <algorithm>
 #include <log/log.h>
 
 #include "ComposerHal.h"
 
 #include <composer-command-buffer/2.2/ComposerCommandBuffer.h>
+#include <compositionengine/impl/HwcBufferCache.h>
 #include <gui/BufferQueue.h>
 #include <hidl/HidlTransportSupport.h>
 #include <hidl/HidlTransportUtils.h>
@@ -249,6 +252,10 @@ Error Composer::executeCommands() {
     return execute();
 }
 
+Composer::CommandStats Composer::getCommandStats() const {
+    return mCommandStats;
+}
+
 uint32_t Composer::getMaxVirtualDisplayCount()
 {
     auto ret = mClient->getMaxVirtualDisplayCount();
@@ -309,7 +316,9 @@ Error Composer::acceptDisplayChanges(Display display)
 Error Composer::createLayer(Display display, Layer* outLayer)
 {
     Error error = kDefaultError;
-    mClient->createLayer(display, BufferQueue::NUM_BUFFER_SLOTS,
+    // Past the BufferQueue slots, one for the buffer layer caching may put on any layer and more
+    // for BufferStateLayer buffers
+    mClient->createLayer(display, compositionengine::impl::HwcBufferCache::SLOT_COUNT,
             [&](const auto& tmpError, const auto& tmpLayer) {
                 error = tmpError;
                 if (error != Error::NONE) {
@@ -553,6 +562,72 @@ Error Composer::presentDisplay(Display display, int* outPresentFence)
     return Error::NONE;
 }
 
+void Composer::queuePresentDisplay(Display display)
+{
+    // A present no one took the result of
+    if (const auto it = mQueuedPresents.find(display); it != mQueuedPresents.end()) {
+        for (int fence : it->second.releaseFences) {
+            close(fence);
+        }
+        if (it->second.presentFence >= 0) {
+            close(it->second.presentFence);
+        }
+        mQueuedPresents.erase(it);
+    }
+
+    mWriter.selectDisplay(display);
+    mWriter.presentDisplay();
+    mQueuedPresents.emplace(display, QueuedPresent());
+}
+
+Error Composer::takeQueuedPresent(Display display, int* outPresentFence,
+                                  std::vector<Layer>* outLayers, std::vector<int>* outReleaseFences)
+{
+    auto it = mQueuedPresents.find(display);
+    if (it == mQueuedPresents.end()) {
+        return Error::BAD_DISPLAY;
+    }
+    if (!it->second.executed) {
+        execute();
+    }
+
+    auto& present = it->second;
+    const Error error = present.error;
+    *outPresentFence = present.presentFence;
+    *outLayers = std::move(present.layers);
+    *outReleaseFences = std::move(present.releaseFences);
+    mQueuedPresents.erase(it);
+    return error;
+}
+
+bool Composer::hasPendingQueuedPresents() const
+{
+    return std::any_of(mQueuedPresents.begin(), mQueuedPresents.end(),
+                       [](const auto& entry) { return !entry.second.executed; });
+}
+
+void Composer::takeQueuedPresentResults(Error executeError, Error presentError)
+{
+    for (auto& [display, present] : mQueuedPresents) {
+        if (present.executed) {
+            continue;
+        }
+        present.executed = true;
+        if (executeError != Error::NONE) {
+            present.error = executeError;
+            continue;
+        }
+
+        mReader.takePresentFence(display, &present.presentFence);
+        mReader.takeReleaseFences(display, &present.layers, &present.releaseFences);
+        // Command errors do not say which display they were for, but a
+        // present that failed has no fence.
+        if (present.presentFence < 0) {
+            present.error = presentError;
+        }
+    }
+}
+
 Error Composer::setActiveConfig(Display display, Config config)
 {
     auto ret = mClient->setActiveConfig(display, config);
@@ -842,6 +917,7 @@ Error Composer::execute()
     hidl_vec<hidl_handle> commandHandles;
     if (!mWriter.writeQueue(&queueChanged, &commandLength, &commandHandles)) {
         mWriter.reset();
+        takeQueuedPresentResults(Error::NO_RESOURCES, Error::NONE);
         return Error::NO_RESOURCES;
     }
 
@@ -851,6 +927,7 @@ Error Composer::execute()
         auto error = unwrapRet(ret);
         if (error != Error::NONE) {
             mWriter.reset();
+            takeQueuedPresentResults(error, Error::NONE);
             return error;
         }
     }
@@ -860,6 +937,13 @@ Error Composer::execute()
         return Error::NONE;
     }
 
+    const uint64_t commandBytes = uint64_t(commandLength) * sizeof(uint32_t);
+    mCommandStats.executions++;
+    mCommandStats.commandBytes += commandBytes;
+    mCommandStats.handles += commandHandles.size();
+    mCommandStats.maxCommandBytes = std::max(mCommandStats.maxCommandBytes, commandBytes);
+    const bool carriesQueuedPresents = hasPendingQueuedPresents();
+
     Error error = kDefaultError;
     hardware::Return<void> ret;
     auto hidl_callback = [&](const auto& tmpError, const auto& tmpOutChanged,
@@ -905,6 +989,8 @@ Error Composer::execute()
         ALOGE("executeCommands failed because of %s", ret.description().c_str());
     }
 
+    const Error executeError = error;
+    Error presentError = Error::NONE;
     if (error == Error::NONE) {
         std::vector<CommandReader::CommandError> commandErrors =
             mReader.takeErrors();
@@ -913,7 +999,13 @@ Error Composer::execute()
             auto command =
                     static_cast<IComposerClient::Command>(mWriter.getCommand(cmdErr.location));
 
-            if (command == IComposerClient::Command::VALIDATE_DISPLAY ||
+            if (command == IComposerClient::Command::PRESENT_DISPLAY && carriesQueuedPresents) {
+                // Left to the queued presents, as presentDisplay is not
+                // used while some are
+                if (presentError == Error::NONE) {
+                    presentError = cmdErr.error;
+                }
+            } else if (command == IComposerClient::Command::VALIDATE_DISPLAY ||
                 command == IComposerClient::Command::PRESENT_DISPLAY ||
                 command == IComposerClient::Command::PRESENT_OR_VALIDATE_DISPLAY) {
                 error = cmdErr.error;
@@ -924,6 +1016,10 @@ Error Composer::execute()
         }
     }
 
+    if (carriesQueuedPresents) {
+        takeQueuedPresentResults(executeError, presentError);
+    }
+
     mWriter.reset();
 
     return error;
@@ -89,6 +89,16 @@ public:
     // Explicitly flush all pending commands in the command buffer.
     virtual Error executeCommands() = 0;
 
+    // How many times, and with how much, the command buffer went to the
+    // composer service
+    struct CommandStats {
+        uint64_t executions = 0;
+        uint64_t commandBytes = 0;
+        uint64_t handles = 0;
+        uint64_t maxCommandBytes = 0;
+    };
+    virtual CommandStats getCommandStats() const = 0;
+
     virtual uint32_t getMaxVirtualDisplayCount() = 0;
     virtual bool isUsingVrComposer() const = 0;
     virtual Error createVirtualDisplay(uint32_t width, uint32_t height, PixelFormat* format,
@@ -125,6 +135,16 @@ public:
 
     virtual Error presentDisplay(Display display, int* outPresentFence) = 0;
 
+    // Queues presenting the display without executing the command buffer,
+    // so that the present goes to the composer service along with the next
+    // commands executed, for this display or another. takeQueuedPresent
+    // returns its present and release fences, executing the command buffer
+    // first if nothing has since.
+    virtual void queuePresentDisplay(Display display) = 0;
+    virtual Error takeQueuedPresent(Display display, int* outPresentFence,
+                                    std::vector<Layer>* outLayers,
+                                    std::vector<int>* outReleaseFences) = 0;
+
     virtual Error setActiveConfig(Display display, Config config) = 0;
 
     /*
@@ -305,6 +325,7 @@ public:
 
     // Explicitly flush all pending commands in the command buffer.
     Error executeCommands() override;
+    CommandStats getCommandStats() const override;
 
     uint32_t getMaxVirtualDisplayCount() override;
     bool isUsingVrComposer() const override { return mIsUsingVrComposer; }
@@ -339,6 +360,9 @@ public:
                            std::vector<int>* outReleaseFences) override;
 
     Error presentDisplay(Display display, int* outPresentFence) override;
+    void queuePresentDisplay(Display display) override;
+    Error takeQueuedPresent(Display display, int* outPresentFence, std::vector<Layer>* outLayers,
+                            std::vector<int>* outReleaseFences) override;
 
     Error setActiveConfig(Display display, Config config) override;
 
@@ -451,6 +475,21 @@ private:
     CommandWriter mWriter;
     CommandReader mReader;
 
+    // The results of queued presents, read out of mReader by the execute
+    // that carried them, before the next one resets it
+    struct QueuedPresent {
+        bool executed = false;
+        Error error = Error::NONE;
+        int presentFence = -1;
+        std::vector<Layer> layers;
+        std::vector<int> releaseFences;
+    };
+    std::unordered_map<Display, QueuedPresent> mQueuedPresents;
+    bool hasPendingQueuedPresents() const;
+    void takeQueuedPresentResults(Error executeError, Error presentError);
+
+    CommandStats mCommandStats;
+
     // When true, the we attach to the vr_hwcomposer service instead of the
     // hwcomposer. This allows us to redirect surfaces to 3d surfaces in vr.
     const bool mIsUsingVrComposer;
@@ -555,11 +555,17 @@ Error Display::getReleaseFences(std::unordered_map<HWC2::Layer*, sp<Fence>>* out
     std::vector<int> fenceFds;
     auto intError = mComposer.getReleaseFences(mId, &layerIds, &fenceFds);
     auto error = static_cast<Error>(intError);
-    uint32_t numElements = layerIds.size();
     if (error != Error::None) {
         return error;
     }
 
+    return toReleaseFences(layerIds, fenceFds, outFences);
+}
+
+Error Display::toReleaseFences(const std::vector<hwc2_layer_t>& layerIds,
+                               const std::vector<int>& fenceFds,
+                               std::unordered_map<Layer*, sp<Fence>>* outFences) const {
+    uint32_t numElements = layerIds.size();
     std::unordered_map<HWC2::Layer*, sp<Fence>> releaseFences;
     releaseFences.reserve(numElements);
     for (uint32_t element = 0; element < numElements; ++element) {
@@ -594,6 +600,30 @@ Error Display::present(sp<Fence>* outPresentFence)
     return Error::None;
 }
 
+void Display::queuePresent()
+{
+    mComposer.queuePresentDisplay(mId);
+}
+
+Error Display::takeQueuedPresent(sp<Fence>* outPresentFence,
+                                 std::unordered_map<Layer*, sp<Fence>>* outReleaseFences)
+{
+    int32_t presentFenceFd = -1;
+    std::vector<Hwc2::Layer> layerIds;
+    std::vector<int> fenceFds;
+    auto intError = mComposer.takeQueuedPresent(mId, &presentFenceFd, &layerIds, &fenceFds);
+    auto error = static_cast<Error>(intError);
+    if (error != Error::None) {
+        for (int fenceFd : fenceFds) {
+            close(fenceFd);
+        }
+        return error;
+    }
+
+    *outPresentFence = new Fence(presentFenceFd);
+    return toReleaseFences(layerIds, fenceFds, outReleaseFences);
+}
+
 Error Display::setActiveConfig(const std::shared_ptr<const Config>& config)
 {
     if (config->getDisplayId() != mId) {
@@ -244,6 +244,12 @@ public:
             std::unordered_map<Layer*, android::sp<android::Fence>>* outFences) const = 0;
     [[clang::warn_unused_result]] virtual Error present(
             android::sp<android::Fence>* outPresentFence) = 0;
+    // Like present, but the present goes to HWC along with the next commands
+    // sent, for this display or another. takeQueuedPresent returns its result.
+    virtual void queuePresent() = 0;
+    [[clang::warn_unused_result]] virtual Error takeQueuedPresent(
+            android::sp<android::Fence>* outPresentFence,
+            std::unordered_map<Layer*, android::sp<android::Fence>>* outReleaseFences) = 0;
     [[clang::warn_unused_result]] virtual Error setActiveConfig(
             const std::shared_ptr<const Config>& config) = 0;
     [[clang::warn_unused_result]] virtual Error setClientTarget(
@@ -308,6 +314,10 @@ public:
     Error getReleaseFences(
             std::unordered_map<Layer*, android::sp<android::Fence>>* outFences) const override;
     Error present(android::sp<android::Fence>* outPresentFence) override;
+    void queuePresent() override;
+    Error takeQueuedPresent(
+            android::sp<android::Fence>* outPresentFence,
+            std::unordered_map<Layer*, android::sp<android::Fence>>* outReleaseFences) override;
     Error setActiveConfig(const std::shared_ptr<const HWC2::Display::Config>& config) override;
     Error setClientTarget(uint32_t slot, const android::sp<android::GraphicBuffer>& target,
                           const android::sp<android::Fence>& acquireFence,
@@ -341,6 +351,10 @@ private:
     // on this display
     Layer* getLayerById(hwc2_layer_t id) const;
 
+    Error toReleaseFences(const std::vector<hwc2_layer_t>& layerIds,
+                          const std::vector<int>& fenceFds,
+                          std::unordered_map<Layer*, android::sp<android::Fence>>* outFences) const;
+
     friend android::TestableSurfaceFlinger;
 
     // Member variables
@@ -20,8 +20,11 @@
 #define LOG_TAG "HWComposer"
 #define ATRACE_TAG ATRACE_TAG_GRAPHICS
 
+#include <android-base/stringprintf.h>
+#include <compositionengine/Layer.h>
 #include <compositionengine/Output.h>
 #include <compositionengine/OutputLayer.h>
+#include <compositionengine/impl/LayerCompositionState.h>
 #include <compositionengine/impl/OutputLayerCompositionState.h>
 #include <log/log.h>
 #include <ui/DebugUtils.h>
@@ -67,6 +70,8 @@
 
 namespace android {
 
+using android::base::StringAppendF;
+
 HWComposer::~HWComposer() = default;
 
 namespace impl {
@@ -399,6 +404,48 @@ status_t HWComposer::setClientTarget(DisplayId displayId, uint32_t slot,
     return NO_ERROR;
 }
 
+namespace {
+
+// How many layer configurations to remember per display, and how many frames
+// to trust a remembered outcome before letting HWC decide from scratch again,
+// in case it could now do better than it did then.
+constexpr size_t kMaxCompositionPredictions = 8;
+constexpr uint32_t kMaxCompositionPredictionUses = 300;
+
+template <typename T>
+void hashCombine(size_t& seed, const T& value) {
+    seed ^= std::hash<T>{}(value) + 0x9e3779b9 + (seed << 6) + (seed >> 2);
+}
+
+// Hashes what SurfaceFlinger asked HWC for this frame, excluding per-frame
+// content such as buffers and damage which doesn't normally sway HWC's
+// choice of composition types.
+size_t hashCompositionRequest(const compositionengine::Output& output) {
+    size_t hash = 0;
+    for (auto& outputLayer : output.getOutputLayersOrderedByZ()) {
+        const auto& state = outputLayer->getState();
+        const auto& frontEnd = outputLayer->getLayer().getState().frontEnd;
+        hashCombine(hash, state.hwc ? state.hwc->hwcLayer.get() : nullptr);
+        hashCombine(hash, state.hwc ? static_cast<int32_t>(state.hwc->hwcCompositionType) : -1);
+        hashCombine(hash, state.displayFrame.left);
+        hashCombine(hash, state.displayFrame.top);
+        hashCombine(hash, state.displayFrame.right);
+        hashCombine(hash, state.displayFrame.bottom);
+        hashCombine(hash, state.sourceCrop.left);
+        hashCombine(hash, state.sourceCrop.top);
+        hashCombine(hash, state.sourceCrop.right);
+        hashCombine(hash, state.sourceCrop.bottom);
+        hashCombine(hash, static_cast<int32_t>(state.bufferTransform));
+        hashCombine(hash, state.z);
+        hashCombine(hash, static_cast<int32_t>(frontEnd.blendMode));
+        hashCombine(hash, frontEnd.alpha);
+        hashCombine(hash, static_cast<int32_t>(frontEnd.dataspace));
+    }
+    return hash;
+}
+
+} // namespace
+
 status_t HWComposer::prepare(DisplayId displayId, const compositionengine::Output& output) {
     ATRACE_CALL();
 
@@ -415,6 +462,47 @@ status_t HWComposer::prepare(DisplayId displayId, const compositionengine::Outpu
 
     HWC2::Error error = HWC2::Error::None;
 
+    displayData.predictionStats.frames++;
+
+    // If HWC already changed the composition types for this exact request
+    // before, ask for what it settled on right away. Validate then has no
+    // changes to report, and if no client composition is predicted we can
+    // try to skip it altogether.
+    const auto& outputLayers = output.getOutputLayersOrderedByZ();
+    const size_t requestHash = hashCompositionRequest(output);
+    auto& predictions = displayData.compositionPredictions;
+    auto prediction = std::find_if(predictions.begin(), predictions.end(),
+                                   [&](const auto& p) { return p.requestHash == requestHash; });
+    if (prediction != predictions.end() &&
+        (prediction->types.size() != outputLayers.size() ||
+         ++prediction->uses > kMaxCompositionPredictionUses)) {
+        predictions.erase(prediction);
+        prediction = predictions.end();
+    }
+    const bool predicted = prediction != predictions.end();
+    bool predictsClientComposition = displayData.hasClientComposition;
+    if (predicted) {
+        displayData.predictionStats.predictions++;
+        predictsClientComposition = false;
+        size_t i = 0;
+        for (auto& outputLayer : outputLayers) {
+            auto& state = outputLayer->editState();
+            const auto type = prediction->types[i++];
+            if (!state.hwc) {
+                continue;
+            }
+            if (type == HWC2::Composition::Client) {
+                predictsClientComposition = true;
+            }
+            if (static_cast<HWC2::Composition>(state.hwc->hwcCompositionType) != type) {
+                if (state.hwc->hwcLayer->setCompositionType(type) == HWC2::Error::None) {
+                    state.hwc->hwcCompositionType =
+                            static_cast<Hwc2::IComposerClient::Composition>(type);
+                }
+            }
+        }
+    }
+
     // First try to skip validate altogether when there is no client
     // composition.  When there is client composition, since we haven't
     // rendered to the client target yet, we should not attempt to skip
@@ -424,7 +512,7 @@ status_t HWComposer::prepare(DisplayId displayId, const compositionengine::Outpu
     // The check below is incorrect.  We actually rely on HWC here to fall
     // back to validate when there is any client layer.
     displayData.validateWasSkipped = false;
-    if (!displayData.hasClientComposition) {
+    if (!predictsClientComposition) {
         sp<Fence> outPresentFence;
         uint32_t state = UINT32_MAX;
         error = hwcDisplay->presentOrValidate(&numTypes, &numRequests, &outPresentFence , &state);
@@ -438,6 +526,7 @@ status_t HWComposer::prepare(DisplayId displayId, const compositionengine::Outpu
             displayData.lastPresentFence = outPresentFence;
             displayData.validateWasSkipped = true;
             displayData.presentError = error;
+            displayData.predictionStats.validatesSkipped++;
             return NO_ERROR;
         }
         // Present failed but Validate ran.
@@ -505,6 +594,31 @@ status_t HWComposer::prepare(DisplayId displayId, const compositionengine::Outpu
     error = hwcDisplay->acceptChanges();
     RETURN_IF_HWC_ERROR_FOR("acceptChanges", error, displayId, BAD_INDEX);
 
+    // Remember what HWC made of this request, unless it took it as it was.
+    if (predicted && !changedTypes.empty()) {
+        displayData.predictionStats.mispredictions++;
+        predictions.erase(prediction);
+    }
+    if (!changedTypes.empty()) {
+        if (predictions.size() >= kMaxCompositionPredictions) {
+            predictions.erase(predictions.begin());
+        }
+        DisplayData::CompositionPrediction newPrediction;
+        newPrediction.requestHash = requestHash;
+        newPrediction.types.reserve(outputLayers.size());
+        for (auto& outputLayer : outputLayers) {
+            const auto& state = outputLayer->getState();
+            newPrediction.types.push_back(state.hwc
+                                                  ? static_cast<HWC2::Composition>(
+                                                            state.hwc->hwcCompositionType)
+                                                  : HWC2::Composition::Invalid);
+        }
+        predictions.push_back(std::move(newPrediction));
+    } else if (predicted) {
+        // keep it at the most recently used end
+        std::rotate(prediction, prediction + 1, predictions.end());
+    }
+
     return NO_ERROR;
 }
 
@@ -585,6 +699,51 @@ status_t HWComposer::presentAndGetReleaseFences(DisplayId displayId) {
     return NO_ERROR;
 }
 
+status_t HWComposer::queuePresent(DisplayId displayId) {
+    RETURN_IF_INVALID_DISPLAY(displayId, BAD_INDEX);
+
+    auto& displayData = mDisplayData[displayId];
+    if (displayData.validateWasSkipped) {
+        // Already presented, and the commands since go with the next ones
+        RETURN_IF_HWC_ERROR_FOR("present", displayData.presentError, displayId, UNKNOWN_ERROR);
+        return NO_ERROR;
+    }
+
+    displayData.hwcDisplay->queuePresent();
+    mQueuedPresents.push_back(displayId);
+    return NO_ERROR;
+}
+
+void HWComposer::presentQueuedDisplays() {
+    ATRACE_CALL();
+
+    mPresentedFrames++;
+
+    // Sends the queued presents still pending, or whatever commands were
+    // written since the last display presented with presentOrValidate.
+    const auto flushError = mHwcDevice->flushCommands();
+    ALOGE_IF(flushError != HWC2::Error::None, "presentQueuedDisplays: flushCommands failed: %s",
+             to_string(flushError).c_str());
+
+    for (const auto displayId : mQueuedPresents) {
+        const auto it = mDisplayData.find(displayId);
+        if (it == mDisplayData.end()) {
+            continue;
+        }
+        auto& displayData = it->second;
+        std::unordered_map<HWC2::Layer*, sp<Fence>> releaseFences;
+        const auto error =
+                displayData.hwcDisplay->takeQueuedPresent(&displayData.lastPresentFence,
+                                                          &releaseFences);
+        if (error != HWC2::Error::None) {
+            LOG_HWC_ERROR("present", error, displayId);
+            continue;
+        }
+        displayData.releaseFences = std::move(releaseFences);
+    }
+    mQueuedPresents.clear();
+}
+
 status_t HWComposer::setPowerMode(DisplayId displayId, int32_t intMode) {
     RETURN_IF_INVALID_DISPLAY(displayId, BAD_INDEX);
 
@@ -655,14 +814,14 @@ status_t HWComposer::setActiveConfig(DisplayId displayId, size_t configId) {
     return NO_ERROR;
 }
 
-status_t HWComposer::setColorTransform(DisplayId displayId, const mat4& transform) {
+status_t HWComposer::setColorTransform(DisplayId displayId, const mat4& transform,
+                                       android_color_transform_t hint) {
     RETURN_IF_INVALID_DISPLAY(displayId, BAD_INDEX);
 
     auto& displayData = mDisplayData[displayId];
     bool isIdentity = transform == mat4();
     auto error = displayData.hwcDisplay->setColorTransform(transform,
-            isIdentity ? HAL_COLOR_TRANSFORM_IDENTITY :
-            HAL_COLOR_TRANSFORM_ARBITRARY_MATRIX);
+            isIdentity ? HAL_COLOR_TRANSFORM_IDENTITY : hint);
     RETURN_IF_HWC_ERROR(error, displayId, UNKNOWN_ERROR);
     return NO_ERROR;
 }
@@ -806,6 +965,28 @@ void HWComposer::dump(std::string& result) const {
     // all the state going into the layers. This is probably better done in
     // Layer itself, but it's going to take a bit of work to get there.
     result.append(mHwcDevice->dump());
+
+    result.append("Composition type prediction:\n");
+    for (const auto& [displayId, displayData] : mDisplayData) {
+        const auto& stats = displayData.predictionStats;
+        StringAppendF(&result,
+                      "  Display %s: %" PRIu64 " frames, %" PRIu64 " validates skipped, %" PRIu64
+                      " predictions (%" PRIu64 " mispredicted), %zu configurations cached\n",
+                      to_string(displayId).c_str(), stats.frames, stats.validatesSkipped,
+                      stats.predictions, stats.mispredictions,
+                      displayData.compositionPredictions.size());
+    }
+
+    const auto stats = mHwcDevice->getComposer()->getCommandStats();
+    StringAppendF(&result,
+                  "Composer commands: %" PRIu64 " executions (%.2f per frame), %" PRIu64
+                  " bytes (%.0f per execution, at most %" PRIu64 "), %" PRIu64 " handles\n",
+                  stats.executions,
+                  mPresentedFrames ? static_cast<double>(stats.executions) / mPresentedFrames : 0.0,
+                  stats.commandBytes,
+                  stats.executions ? static_cast<double>(stats.commandBytes) / stats.executions
+                                   : 0.0,
+                  stats.maxCommandBytes, stats.handles);
 }
 
 std::optional<DisplayId> HWComposer::toPhysicalDisplayId(hwc2_display_t hwcDisplayId) const {
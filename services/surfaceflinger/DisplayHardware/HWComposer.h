@@ -81,14 +81,23 @@ public:
     // Present layers to the display and read releaseFences.
     virtual status_t presentAndGetReleaseFences(DisplayId displayId) = 0;
 
+    // Like presentAndGetReleaseFences, but the present goes to HWC along with
+    // the next commands sent, such as those to prepare the next display, and
+    // the release fences are read when presentQueuedDisplays sends whatever
+    // is left and completes the queued presents.
+    virtual status_t queuePresent(DisplayId displayId) = 0;
+    virtual void presentQueuedDisplays() = 0;
+
     // set power mode
     virtual status_t setPowerMode(DisplayId displayId, int mode) = 0;
 
     // set active config
     virtual status_t setActiveConfig(DisplayId displayId, size_t configId) = 0;
 
-    // Sets a color transform to be applied to the result of composition
-    virtual status_t setColorTransform(DisplayId displayId, const mat4& transform) = 0;
+    // Sets a color transform to be applied to the result of composition, and
+    // hints the composer at what it does
+    virtual status_t setColorTransform(DisplayId displayId, const mat4& transform,
+                                       android_color_transform_t hint) = 0;
 
     // reset state when an external, non-virtual display is disconnected
     virtual void disconnectDisplay(DisplayId displayId) = 0;
@@ -219,6 +228,9 @@ public:
     // Present layers to the display and read releaseFences.
     status_t presentAndGetReleaseFences(DisplayId displayId) override;
 
+    status_t queuePresent(DisplayId displayId) override;
+    void presentQueuedDisplays() override;
+
     // set power mode
     status_t setPowerMode(DisplayId displayId, int mode) override;
 
@@ -226,7 +238,8 @@ public:
     status_t setActiveConfig(DisplayId displayId, size_t configId) override;
 
     // Sets a color transform to be applied to the result of composition
-    status_t setColorTransform(DisplayId displayId, const mat4& transform) override;
+    status_t setColorTransform(DisplayId displayId, const mat4& transform,
+                               android_color_transform_t hint) override;
 
     // reset state when an external, non-virtual display is disconnected
     void disconnectDisplay(DisplayId displayId) override;
@@ -344,6 +357,24 @@ private:
         bool validateWasSkipped;
         HWC2::Error presentError;
 
+        // The composition types HWC settled on for recently seen layer
+        // configurations, most recently used last. A configuration is
+        // identified by a hash of the state SurfaceFlinger requested.
+        struct CompositionPrediction {
+            size_t requestHash = 0;
+            std::vector<HWC2::Composition> types; // in z order
+            uint32_t uses = 0;
+        };
+        std::vector<CompositionPrediction> compositionPredictions;
+
+        struct CompositionPredictionStats {
+            uint64_t frames = 0;
+            uint64_t validatesSkipped = 0;
+            uint64_t predictions = 0;
+            uint64_t mispredictions = 0;
+        };
+        CompositionPredictionStats predictionStats;
+
         bool vsyncTraceToggle = false;
 
         std::mutex vsyncEnabledLock;
@@ -355,6 +386,10 @@ private:
 
     std::unordered_map<DisplayId, DisplayData> mDisplayData;
 
+    // Displays whose present was queued, in order
+    std::vector<DisplayId> mQueuedPresents;
+    uint64_t mPresentedFrames = 0;
+
     // This must be destroyed before mDisplayData, because destructor may call back into HWComposer
     // and look up DisplayData.
     std::unique_ptr<HWC2::Device> mHwcDevice;
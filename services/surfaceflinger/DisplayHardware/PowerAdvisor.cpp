@@ -63,6 +63,23 @@ void PowerAdvisor::setExpensiveRenderingExpected(DisplayId displayId, bool expec
     }
 }
 
+void PowerAdvisor::setScreenIdle(bool idle) {
+    if (mNotifiedScreenIdle == idle) {
+        return;
+    }
+    const sp<V1_3::IPower> powerHal = getPowerHal();
+    if (powerHal == nullptr) {
+        return;
+    }
+    // The VSYNC hint tells whether VSYNC is needed, which it isn't while idle
+    auto ret = powerHal->powerHintAsync_1_3(PowerHint::VSYNC, !idle);
+    if (!ret.isOk()) {
+        mReconnectPowerHal = true;
+        return;
+    }
+    mNotifiedScreenIdle = idle;
+}
+
 sp<V1_3::IPower> PowerAdvisor::getPowerHal() {
     static sp<V1_3::IPower> sPowerHal_1_3 = nullptr;
     static bool sHasPowerHal_1_3 = true;
@@ -37,6 +37,8 @@ public:
     virtual ~PowerAdvisor();
 
     virtual void setExpensiveRenderingExpected(DisplayId displayId, bool expected) = 0;
+    // Lets the power HAL know nothing needs VSYNC while the screen is static
+    virtual void setScreenIdle(bool idle) = 0;
 };
 
 namespace impl {
@@ -51,12 +53,14 @@ public:
     ~PowerAdvisor() override;
 
     void setExpensiveRenderingExpected(DisplayId displayId, bool expected) override;
+    void setScreenIdle(bool idle) override;
 
 private:
     sp<V1_3::IPower> getPowerHal();
 
     std::unordered_set<DisplayId> mExpensiveDisplays;
     bool mNotifiedExpensiveRendering = false;
+    bool mNotifiedScreenIdle = false;
     bool mReconnectPowerHal = false;
 };
 
@@ -79,7 +79,7 @@ VirtualDisplaySurface::VirtualDisplaySurface(HWComposer& hwc,
         mDbgState(DBG_STATE_IDLE),
         mDbgLastCompositionType(COMPOSITION_UNKNOWN),
         mMustRecompose(false),
-        mForceHwcCopy(SurfaceFlinger::useHwcForRgbToYuv) {
+        mForceHwcCopy(false) {
     mSource[SOURCE_SINK] = sink;
     mSource[SOURCE_SCRATCH] = bqProducer;
 
@@ -106,6 +106,12 @@ VirtualDisplaySurface::VirtualDisplaySurface(HWComposer& hwc,
     }
     mOutputFormat = mDefaultOutputFormat;
 
+    // Only a video encoder gains from HWC converting GLES output to YUV. Any
+    // other consumer gets GLES output rendered straight into its buffers at
+    // its own resolution, without the copy through the scratch buffer.
+    mForceHwcCopy =
+            SurfaceFlinger::useHwcForRgbToYuv && (sinkUsage & GRALLOC_USAGE_HW_VIDEO_ENCODER);
+
     ConsumerBase::mName = String8::format("VDS: %s", mDisplayName.c_str());
     mConsumer->setConsumerName(ConsumerBase::mName);
     mConsumer->setConsumerUsageBits(GRALLOC_USAGE_HW_COMPOSER);
@@ -150,8 +156,8 @@ status_t VirtualDisplaySurface::prepareFrame(CompositionType compositionType) {
         // allows the format conversion to happen there, rather than passing RGB
         // directly to the consumer.
         //
-        // On the other hand, when the consumer prefers RGB or can consume RGB
-        // inexpensively, this forces an unnecessary copy.
+        // This is only done for video encoder sinks; other consumers take RGB
+        // directly, where the copy would be unnecessary.
         mCompositionType = COMPOSITION_MIXED;
     }
 
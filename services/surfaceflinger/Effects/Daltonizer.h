@@ -38,6 +38,9 @@ public:
     void setType(ColorBlindnessType type);
     void setMode(ColorBlindnessMode mode);
 
+    ColorBlindnessType getType() const { return mType; }
+    ColorBlindnessMode getMode() const { return mMode; }
+
     // returns the color transform to apply in the shader
     const mat4& operator()();
 
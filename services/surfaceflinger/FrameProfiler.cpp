@@ -0,0 +1,145 @@
+/*
+ * Copyright 2019 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#define ATRACE_TAG ATRACE_TAG_GRAPHICS
+
+#include "FrameProfiler.h"
+
+#include <algorithm>
+#include <iterator>
+
+#include <android-base/stringprintf.h>
+#include <utils/Trace.h>
+
+namespace android {
+
+namespace {
+
+constexpr size_t STAGE_COUNT = static_cast<size_t>(FrameProfiler::Stage::Count);
+
+constexpr const char* STAGE_NAMES[STAGE_COUNT] = {
+        "Transaction",
+        "PageFlip",
+        "PreComposition",
+        "RebuildLayerStacks",
+        "CalculateWorkingSet",
+        "Composition",
+        "PostComposition",
+};
+
+// The trace counters, in nanoseconds
+constexpr const char* STAGE_COUNTERS[STAGE_COUNT] = {
+        "StageTransaction",
+        "StagePageFlip",
+        "StagePreComposition",
+        "StageRebuildLayerStacks",
+        "StageCalculateWorkingSet",
+        "StageComposition",
+        "StagePostComposition",
+};
+
+// Upper bounds of the histogram buckets, the last one holding the rest
+constexpr nsecs_t BUCKET_LIMITS[] = {
+        us2ns(250), us2ns(500), ms2ns(1), ms2ns(2), ms2ns(4), ms2ns(8), ms2ns(16),
+};
+constexpr size_t BUCKET_COUNT = std::size(BUCKET_LIMITS) + 1;
+
+} // namespace
+
+void FrameProfiler::record(Stage stage, nsecs_t duration) {
+    const size_t index = static_cast<size_t>(stage);
+    ATRACE_INT64(STAGE_COUNTERS[index], duration);
+
+    std::lock_guard<std::mutex> lock(mMutex);
+    History& history = mHistories[index];
+    history.durations[history.next] = duration;
+    history.next = (history.next + 1) % HISTORY_SIZE;
+    history.count = std::min(history.count + 1, HISTORY_SIZE);
+}
+
+size_t FrameProfiler::count(Stage stage) const {
+    std::lock_guard<std::mutex> lock(mMutex);
+    return mHistories[static_cast<size_t>(stage)].count;
+}
+
+nsecs_t FrameProfiler::percentile(Stage stage, size_t percent) const {
+    std::lock_guard<std::mutex> lock(mMutex);
+    return percentileLocked(mHistories[static_cast<size_t>(stage)], percent);
+}
+
+nsecs_t FrameProfiler::percentileLocked(const History& history, size_t percent) {
+    if (history.count == 0) {
+        return 0;
+    }
+
+    std::array<nsecs_t, HISTORY_SIZE> durations = history.durations;
+    const auto end = durations.begin() + history.count;
+    const auto percentile = durations.begin() + (history.count - 1) * percent / 100;
+    std::nth_element(durations.begin(), percentile, end);
+    return *percentile;
+}
+
+void FrameProfiler::clear() {
+    std::lock_guard<std::mutex> lock(mMutex);
+    mHistories = {};
+}
+
+void FrameProfiler::dump(std::string& result) const {
+    std::lock_guard<std::mutex> lock(mMutex);
+
+    base::StringAppendF(&result, "Frame profile of the last %zu frames, in ms:\n", HISTORY_SIZE);
+    base::StringAppendF(&result, "  %-20s %6s %7s %7s %7s %7s %7s |", "Stage", "Frames", "Mean",
+                        "50%", "90%", "99%", "Max");
+    for (nsecs_t limit : BUCKET_LIMITS) {
+        base::StringAppendF(&result, " %6s", base::StringPrintf("<%g", limit / 1e6).c_str());
+    }
+    base::StringAppendF(&result, " %6s\n",
+                        base::StringPrintf(">=%g", BUCKET_LIMITS[BUCKET_COUNT - 2] / 1e6).c_str());
+
+    for (size_t i = 0; i < STAGE_COUNT; i++) {
+        const History& history = mHistories[i];
+        const auto begin = history.durations.begin();
+        const auto end = begin + history.count;
+
+        nsecs_t total = 0;
+        nsecs_t max = 0;
+        std::array<size_t, BUCKET_COUNT> buckets{};
+        for (auto it = begin; it != end; it++) {
+            total += *it;
+            max = std::max(max, *it);
+            buckets[std::upper_bound(std::begin(BUCKET_LIMITS), std::end(BUCKET_LIMITS), *it) -
+                    std::begin(BUCKET_LIMITS)]++;
+        }
+        const double mean = history.count > 0 ? double(total) / history.count : 0.0;
+
+        base::StringAppendF(&result, "  %-20s %6zu %7.3f %7.3f %7.3f %7.3f %7.3f |",
+                            STAGE_NAMES[i], history.count, mean / 1e6,
+                            percentileLocked(history, 50) / 1e6,
+                            percentileLocked(history, 90) / 1e6,
+                            percentileLocked(history, 99) / 1e6, max / 1e6);
+        for (size_t count : buckets) {
+            base::StringAppendF(&result, " %6zu", count);
+        }
+        result.append("\n");
+    }
+}
+
+const char* FrameProfiler::stageName(Stage stage) {
+    const size_t index = static_cast<size_t>(stage);
+    return index < STAGE_COUNT ? STAGE_NAMES[index] : "Unknown";
+}
+
+} // namespace android
@@ -0,0 +1,90 @@
+/*
+ * Copyright 2019 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <mutex>
+#include <string>
+
+#include <android-base/thread_annotations.h>
+#include <utils/Timers.h>
+
+namespace android {
+
+// Breaks the time the main thread spends on each frame down into stages. The
+// durations of the recent frames are kept for every stage, and reported as
+// percentiles and histograms by dumpsys SurfaceFlinger --frame-profile. Each
+// duration is also traced as a counter of its own.
+class FrameProfiler {
+public:
+    enum class Stage : size_t {
+        Transaction,         // handleMessageTransaction
+        PageFlip,            // handleMessageInvalidate
+        PreComposition,      // preComposition
+        RebuildLayerStacks,  // rebuildLayerStacks
+        CalculateWorkingSet, // calculateWorkingSet
+        Composition,         // prepareFrame and doComposition of every display
+        PostComposition,     // onDisplayPresented of every display, and postComposition
+        Count,
+    };
+
+    // Number of recent frames the durations of each stage are kept for
+    static constexpr size_t HISTORY_SIZE = 512;
+
+    // Records the time spent in a stage, from construction to destruction.
+    class ScopedStage {
+    public:
+        ScopedStage(FrameProfiler& profiler, Stage stage)
+              : mProfiler(profiler), mStage(stage), mStart(systemTime()) {}
+        ~ScopedStage() { mProfiler.record(mStage, systemTime() - mStart); }
+
+    private:
+        FrameProfiler& mProfiler;
+        const Stage mStage;
+        const nsecs_t mStart;
+    };
+
+    void record(Stage stage, nsecs_t duration) EXCLUDES(mMutex);
+
+    // Number of recent durations of the stage
+    size_t count(Stage stage) const EXCLUDES(mMutex);
+
+    // The given percentile of the recent durations of the stage, 0 if none
+    // were recorded.
+    nsecs_t percentile(Stage stage, size_t percent) const EXCLUDES(mMutex);
+
+    void clear() EXCLUDES(mMutex);
+
+    void dump(std::string& result) const EXCLUDES(mMutex);
+
+    static const char* stageName(Stage stage);
+
+private:
+    struct History {
+        std::array<nsecs_t, HISTORY_SIZE> durations{};
+        size_t count = 0;
+        size_t next = 0;
+    };
+
+    static nsecs_t percentileLocked(const History& history, size_t percent);
+
+    mutable std::mutex mMutex;
+    std::array<History, static_cast<size_t>(Stage::Count)> mHistories GUARDED_BY(mMutex);
+};
+
+} // namespace android
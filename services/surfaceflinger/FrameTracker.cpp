@@ -19,6 +19,9 @@
 
 #include <inttypes.h>
 
+#include <algorithm>
+#include <cmath>
+
 #include <android-base/stringprintf.h>
 #include <android/log.h>
 #include <utils/String8.h>
@@ -33,8 +36,12 @@ namespace android {
 FrameTracker::FrameTracker() :
         mOffset(0),
         mNumFences(0),
+        mNumPresentIntervals(0),
+        mNextIntervalIdx(0),
+        mLastPresentTime(0),
         mDisplayPeriod(0) {
     resetFrameCountersLocked();
+    std::fill(std::begin(mPresentIntervals), std::end(mPresentIntervals), 0);
 }
 
 void FrameTracker::setDesiredPresentTime(nsecs_t presentTime) {
@@ -77,8 +84,18 @@ void FrameTracker::advanceFrame() {
     // Update the statistic to include the frame we just finished.
     updateStatsLocked(mOffset);
 
+    // The frames before that one have most likely been presented by now.
+    updatePresentIntervalsLocked();
+
     // Advance to the next frame.
     mOffset = (mOffset+1) % NUM_FRAME_RECORDS;
+
+    if (mNextIntervalIdx == mOffset) {
+        // A present fence has been pending for the whole circular buffer, and
+        // its record is about to be clobbered.
+        mNextIntervalIdx = (mOffset+1) % NUM_FRAME_RECORDS;
+        mLastPresentTime = 0;
+    }
     mFrameRecords[mOffset].desiredPresentTime = INT64_MAX;
     mFrameRecords[mOffset].frameReadyTime = INT64_MAX;
     mFrameRecords[mOffset].actualPresentTime = INT64_MAX;
@@ -111,6 +128,11 @@ void FrameTracker::clearStats() {
     mFrameRecords[mOffset].desiredPresentTime = INT64_MAX;
     mFrameRecords[mOffset].frameReadyTime = INT64_MAX;
     mFrameRecords[mOffset].actualPresentTime = INT64_MAX;
+
+    std::fill(std::begin(mPresentIntervals), std::end(mPresentIntervals), 0);
+    mNumPresentIntervals = 0;
+    mNextIntervalIdx = mOffset;
+    mLastPresentTime = 0;
 }
 
 void FrameTracker::getStats(FrameStats* outStats) const {
@@ -211,6 +233,88 @@ void FrameTracker::updateStatsLocked(size_t newFrameIdx) const {
     }
 }
 
+// Intervals under 8us get a bucket each, longer ones one of 8 buckets per power
+// of two.
+static size_t intervalBucket(int64_t micros) {
+    if (micros < 8) {
+        return size_t(std::max(micros, int64_t(0)));
+    }
+    const int exponent = 63 - __builtin_clzll(micros);
+    const size_t bucket = 8 * (exponent - 2) + ((micros >> (exponent - 3)) & 7);
+    return std::min(bucket, size_t(FrameTracker::NUM_INTERVAL_BUCKETS - 1));
+}
+
+// intervalBucketEnd returns the interval, in microseconds, at which a bucket
+// ends.
+static int64_t intervalBucketEnd(size_t bucket) {
+    bucket++;
+    if (bucket < 8) {
+        return int64_t(bucket);
+    }
+    const int exponent = int(bucket / 8) + 2;
+    return int64_t(8 + bucket % 8) << (exponent - 3);
+}
+
+void FrameTracker::updatePresentIntervalsLocked() {
+    while (mNextIntervalIdx != mOffset) {
+        FrameRecord& record = mFrameRecords[mNextIntervalIdx];
+        if (record.actualPresentFence != nullptr) {
+            const nsecs_t signalTime = record.actualPresentFence->getSignalTime();
+            if (signalTime == Fence::SIGNAL_TIME_PENDING) {
+                return;
+            }
+            record.actualPresentTime = signalTime;
+            record.actualPresentFence = nullptr;
+            mNumFences--;
+            updateStatsLocked(mNextIntervalIdx);
+        }
+
+        if (isFrameValidLocked(mNextIntervalIdx)) {
+            const nsecs_t presentTime = record.actualPresentTime;
+            if (mLastPresentTime > 0 && presentTime > mLastPresentTime) {
+                mPresentIntervals[intervalBucket(ns2us(presentTime - mLastPresentTime))]++;
+                mNumPresentIntervals++;
+            }
+            mLastPresentTime = presentTime;
+        } else {
+            // Without a present time the next interval is unknown.
+            mLastPresentTime = 0;
+        }
+
+        mNextIntervalIdx = (mNextIntervalIdx+1) % NUM_FRAME_RECORDS;
+    }
+}
+
+nsecs_t FrameTracker::getPresentIntervalPercentile(float fraction) const {
+    Mutex::Autolock lock(mMutex);
+    return getPresentIntervalPercentileLocked(fraction);
+}
+
+nsecs_t FrameTracker::getPresentIntervalPercentileLocked(float fraction) const {
+    if (mNumPresentIntervals == 0) {
+        return 0;
+    }
+    const uint64_t rank = std::max(uint64_t(1),
+            uint64_t(std::ceil(double(fraction) * mNumPresentIntervals)));
+    uint64_t numIntervals = 0;
+    for (size_t i = 0; i < NUM_INTERVAL_BUCKETS; i++) {
+        numIntervals += mPresentIntervals[i];
+        if (numIntervals >= rank) {
+            return us2ns(intervalBucketEnd(i));
+        }
+    }
+    return us2ns(intervalBucketEnd(NUM_INTERVAL_BUCKETS - 1));
+}
+
+void FrameTracker::dumpPresentIntervals(std::string& result) const {
+    Mutex::Autolock lock(mMutex);
+    base::StringAppendF(&result,
+            "presentIntervals=%" PRIu64 " p50=%.3fms p95=%.3fms p99=%.3fms\n",
+            mNumPresentIntervals, getPresentIntervalPercentileLocked(0.5f) / 1e6,
+            getPresentIntervalPercentileLocked(0.95f) / 1e6,
+            getPresentIntervalPercentileLocked(0.99f) / 1e6);
+}
+
 void FrameTracker::resetFrameCountersLocked() {
     for (int i = 0; i < NUM_FRAME_BUCKETS; i++) {
         mNumFrames[i] = 0;
@@ -46,6 +46,10 @@ public:
 
     enum { NUM_FRAME_BUCKETS = 7 };
 
+    // NUM_INTERVAL_BUCKETS is the number of buckets of the present interval
+    // histogram, which covers intervals of up to about 16 seconds.
+    enum { NUM_INTERVAL_BUCKETS = 176 };
+
     FrameTracker();
 
     // setDesiredPresentTime sets the time at which the current frame
@@ -92,6 +96,16 @@ public:
     // dumpStats dump appends the current frame display time history to the result string.
     void dumpStats(std::string& result) const;
 
+    // getPresentIntervalPercentile returns the present-to-present interval
+    // that the given fraction of the frames since the last clearStats were
+    // within. Unlike the frame records, this covers every frame however long
+    // the run, to within an eighth of the actual interval.
+    nsecs_t getPresentIntervalPercentile(float fraction) const;
+
+    // dumpPresentIntervals appends the number of present intervals tracked and
+    // their p50, p95 and p99 to the result string.
+    void dumpPresentIntervals(std::string& result) const;
+
 private:
     struct FrameRecord {
         FrameRecord() :
@@ -125,6 +139,15 @@ private:
     // logStatsLocked dumps the current statistics to the binary event log.
     void logStatsLocked(const String8& name) const;
 
+    // updatePresentIntervalsLocked adds the intervals between the frames
+    // before the current one to the present interval histogram, oldest first,
+    // stopping at the first frame whose present fence has not signaled yet.
+    void updatePresentIntervalsLocked();
+
+    // getPresentIntervalPercentileLocked implements
+    // getPresentIntervalPercentile.
+    nsecs_t getPresentIntervalPercentileLocked(float fraction) const;
+
     // isFrameValidLocked returns true if the data for the given frame index is
     // valid and has all arrived (i.e. there are no oustanding fences).
     bool isFrameValidLocked(size_t idx) const;
@@ -152,6 +175,21 @@ private:
     // all frames with duration greater than 2^(NUM_FRAME_BUCKETS-1).
     int32_t mNumFrames[NUM_FRAME_BUCKETS];
 
+    // mPresentIntervals is a histogram of present-to-present intervals in
+    // microseconds. Intervals under 8us get a bucket each, and longer ones one
+    // of 8 buckets per power of two, so that its size is fixed whatever the
+    // number or range of intervals.
+    uint32_t mPresentIntervals[NUM_INTERVAL_BUCKETS];
+
+    // mNumPresentIntervals is the total count in mPresentIntervals.
+    uint64_t mNumPresentIntervals;
+
+    // mNextIntervalIdx is the index of the oldest frame record not added to
+    // mPresentIntervals yet, and mLastPresentTime the present time of the
+    // frame before it, or 0 if unknown.
+    size_t mNextIntervalIdx;
+    nsecs_t mLastPresentTime;
+
     // mDisplayPeriod is the display refresh period of the display for which
     // this FrameTracker is gathering information.
     nsecs_t mDisplayPeriod;
@@ -363,6 +363,26 @@ FloatRect Layer::getBoundsPreScaling(const ui::Transform& bufferScaleTransform)
 }
 
 void Layer::computeBounds(FloatRect parentBounds, ui::Transform parentTransform) {
+    const bool inputsChanged =
+            !(parentBounds == mBoundsParentBounds) || parentTransform != mBoundsParentTransform;
+    if (!mBoundsDirty && !inputsChanged) {
+        // The children get the same inputs as last time, so only those below which something
+        // changed need a look.
+        if (mDescendantBoundsDirty) {
+            mDescendantBoundsDirty = false;
+            ui::Transform bufferScaleTransform = getBufferScaleTransform();
+            for (const sp<Layer>& child : mDrawingChildren) {
+                child->computeBounds(getBoundsPreScaling(bufferScaleTransform),
+                                     getTransformWithScale(bufferScaleTransform));
+            }
+        }
+        return;
+    }
+    mBoundsParentBounds = parentBounds;
+    mBoundsParentTransform = parentTransform;
+    mBoundsDirty = false;
+    mDescendantBoundsDirty = false;
+
     const State& s(getDrawingState());
 
     // Calculate effective layer transform
@@ -393,6 +413,17 @@ void Layer::computeBounds(FloatRect parentBounds, ui::Transform parentTransform)
     }
 }
 
+void Layer::invalidateBounds() {
+    mBoundsDirty = true;
+    for (sp<Layer> parent = mDrawingParent.promote(); parent != nullptr;
+         parent = parent->mDrawingParent.promote()) {
+        if (parent->mDescendantBoundsDirty) {
+            break;
+        }
+        parent->mDescendantBoundsDirty = true;
+    }
+}
+
 Rect Layer::getCroppedBufferSize(const State& s) const {
     Rect size = getBufferSize(s);
     Rect crop = getCrop(s);
@@ -653,6 +684,11 @@ bool Layer::isSecure() const {
 void Layer::setVisibleRegion(const Region& visibleRegion) {
     // always called from main thread
     this->visibleRegion = visibleRegion;
+    if (mFlinger->mUseSmart90ForVideo) {
+        const Rect bounds = visibleRegion.getBounds();
+        mFlinger->mScheduler->setLayerVisibleArea(mSchedulerLayerHandle,
+                                                  int64_t(bounds.getWidth()) * bounds.getHeight());
+    }
 }
 
 void Layer::setCoveredRegion(const Region& coveredRegion) {
@@ -913,6 +949,7 @@ uint32_t Layer::doTransaction(uint32_t flags) {
 
 void Layer::commitTransaction(const State& stateToCommit) {
     mDrawingState = stateToCommit;
+    invalidateBounds();
 }
 
 uint32_t Layer::getTransactionFlags(uint32_t flags) {
@@ -1386,6 +1423,24 @@ void Layer::dumpFrameStats(std::string& result) const {
     mFrameTracker.dumpStats(result);
 }
 
+void Layer::dumpPresentIntervals(std::string& result) const {
+    mFrameTracker.dumpPresentIntervals(result);
+}
+
+void Layer::reclaimBuffersIfIdle(nsecs_t now, nsecs_t timeout, bool onscreen) {
+    if ((onscreen && isVisible()) || mLastVisibleTime == 0) {
+        mLastVisibleTime = now;
+        mBuffersReclaimed = false;
+        return;
+    }
+    if (mBuffersReclaimed || now - mLastVisibleTime < timeout) {
+        return;
+    }
+    ALOGV("[%s] Reclaiming buffers of unseen layer", mName.string());
+    reclaimBuffers();
+    mBuffersReclaimed = true;
+}
+
 void Layer::clearFrameStats() {
     mFrameTracker.clearStats();
 }
@@ -1435,6 +1490,11 @@ void Layer::addAndGetFrameTimestamps(const NewFrameEventsEntry* newTimestamps,
     }
 }
 
+base::unique_fd Layer::getSharedFrameEvents() {
+    Mutex::Autolock lock(mFrameEventHistoryMutex);
+    return mFrameEventHistory.getSharedEvents();
+}
+
 size_t Layer::getChildrenCount() const {
     size_t count = 0;
     for (const sp<Layer>& child : mCurrentChildren) {
@@ -1847,8 +1907,16 @@ void Layer::commitChildList() {
         const auto& child = mCurrentChildren[i];
         child->commitChildList();
     }
+    bool hierarchyChanged = mDrawingParent != mCurrentParent ||
+            mDrawingChildren.size() != mCurrentChildren.size();
+    for (size_t i = 0; !hierarchyChanged && i < mCurrentChildren.size(); i++) {
+        hierarchyChanged = mDrawingChildren[i] != mCurrentChildren[i];
+    }
     mDrawingChildren = mCurrentChildren;
     mDrawingParent = mCurrentParent;
+    if (hierarchyChanged) {
+        invalidateBounds();
+    }
 }
 
 static wp<Layer> extractLayerFromBinder(const wp<IBinder>& weakBinderHandle) {
@@ -1874,6 +1942,20 @@ void Layer::setInputInfo(const InputWindowInfo& info) {
     setTransactionFlags(eTransactionNeeded);
 }
 
+void Layer::recordOccupancyForTracing(const std::vector<OccupancyTracker::Segment>& history) {
+    if (history.empty()) {
+        return;
+    }
+    std::lock_guard<std::mutex> lock(mTracedOccupancyLock);
+    // history is newest first.
+    for (auto it = history.crbegin(); it != history.crend(); ++it) {
+        mTracedOccupancy.push_back(*it);
+    }
+    while (mTracedOccupancy.size() > kMaxTracedOccupancySegments) {
+        mTracedOccupancy.pop_front();
+    }
+}
+
 void Layer::writeToProto(LayerProto* layerInfo, LayerVector::StateSet stateSet,
                          uint32_t traceFlags) {
     const bool useDrawing = stateSet == LayerVector::StateSet::Drawing;
@@ -1980,6 +2062,18 @@ void Layer::writeToProto(LayerProto* layerInfo, LayerVector::StateSet stateSet,
         LayerProtoHelper::writeToProto(mBounds, [&]() { return layerInfo->mutable_bounds(); });
     }
 
+    if (traceFlags & SurfaceTracing::TRACE_BUFFERING) {
+        std::lock_guard<std::mutex> lock(mTracedOccupancyLock);
+        for (const auto& segment : mTracedOccupancy) {
+            OccupancySegmentProto* segmentProto = layerInfo->add_occupancy_segments();
+            segmentProto->set_total_time_ns(segment.totalTime);
+            segmentProto->set_num_frames(static_cast<uint32_t>(segment.numFrames));
+            segmentProto->set_occupancy_average(segment.occupancyAverage);
+            segmentProto->set_used_third_buffer(segment.usedThirdBuffer);
+        }
+        mTracedOccupancy.clear();
+    }
+
     if (traceFlags & SurfaceTracing::TRACE_INPUT) {
         LayerProtoHelper::writeToProto(state.inputInfo, state.touchableRegionCrop,
                                        [&]() { return layerInfo->mutable_input_window_info(); });
@@ -17,6 +17,7 @@
 #ifndef ANDROID_LAYER_H
 #define ANDROID_LAYER_H
 
+#include <android-base/thread_annotations.h>
 #include <compositionengine/LayerFE.h>
 #include <gui/BufferQueue.h>
 #include <gui/ISurfaceComposerClient.h>
@@ -38,7 +39,9 @@
 #include <utils/Timers.h>
 
 #include <cstdint>
+#include <deque>
 #include <list>
+#include <mutex>
 #include <optional>
 #include <vector>
 
@@ -362,7 +365,9 @@ public:
     FloatRect getBounds(const Region& activeTransparentRegion) const;
     FloatRect getBounds() const;
 
-    // Compute bounds for the layer and cache the results.
+    // Compute bounds for the layer and cache the results. Layers whose inputs and geometry are
+    // unchanged since they were last computed keep their cached bounds, and subtrees without
+    // any such change are not walked.
     void computeBounds(FloatRect parentBounds, ui::Transform parentTransform);
 
     // Returns the buffer scale transform if a scaling mode is set.
@@ -438,10 +443,10 @@ public:
     bool isRemovedFromCurrentState() const;
 
     void writeToProto(LayerProto* layerInfo, LayerVector::StateSet stateSet,
-                      uint32_t traceFlags = SurfaceTracing::TRACE_ALL);
+                      uint32_t traceFlags = SurfaceTracing::TRACE_DUMP);
 
     void writeToProto(LayerProto* layerInfo, const sp<DisplayDevice>& displayDevice,
-                      uint32_t traceFlags = SurfaceTracing::TRACE_ALL);
+                      uint32_t traceFlags = SurfaceTracing::TRACE_DUMP);
 
     virtual Geometry getActiveGeometry(const Layer::State& s) const { return s.active_legacy; }
     virtual uint32_t getActiveWidth(const Layer::State& s) const { return s.active_legacy.w; }
@@ -516,6 +521,9 @@ public:
     // If a buffer was replaced this frame, release the former buffer
     virtual void releasePendingBuffer(nsecs_t /*dequeueReadyTime*/) { }
 
+    // Frees the buffers held but not shown, see reclaimBuffersIfIdle
+    virtual void reclaimBuffers() {}
+
     /*
      * prepareClientLayer - populates a renderengine::LayerSettings to passed to
      * RenderEngine::drawLayers. Returns true if the layer can be used, and
@@ -623,6 +631,7 @@ public:
     static void miniDumpHeader(std::string& result);
     void miniDump(std::string& result, const sp<DisplayDevice>& display) const;
     void dumpFrameStats(std::string& result) const;
+    void dumpPresentIntervals(std::string& result) const;
     void dumpFrameEvents(std::string& result);
     void clearFrameStats();
     void logFrameStats();
@@ -632,9 +641,27 @@ public:
         return {};
     }
 
+    /*
+     * getBufferBytes - bytes of graphics memory held for this layer's buffers
+     */
+    virtual size_t getBufferBytes() const { return 0; }
+
+    /*
+     * reclaimBuffersIfIdle - frees the buffers this layer holds but does not
+     * show, once it has been offscreen or invisible for timeout. They are
+     * allocated again when its producer next draws.
+     */
+    void reclaimBuffersIfIdle(nsecs_t now, nsecs_t timeout, bool onscreen);
+
+    // Queues finished occupancy segments for the next layer trace entry. Only
+    // the most recent kMaxTracedOccupancySegments are kept between entries.
+    void recordOccupancyForTracing(const std::vector<OccupancyTracker::Segment>& history);
+
     void onDisconnect();
     void addAndGetFrameTimestamps(const NewFrameEventsEntry* newEntry,
                                   FrameEventHistoryDelta* outDelta);
+    // Returns the memory the layer's frame events are shared with its producer in.
+    base::unique_fd getSharedFrameEvents();
 
     virtual bool getTransformToDisplayInverse() const { return false; }
 
@@ -843,6 +870,11 @@ protected:
     // Timestamp history for UIAutomation. Thread safe.
     FrameTracker mFrameTracker;
 
+    // When the layer was last seen visible, and whether its buffers were
+    // reclaimed since. Only touched by the main thread.
+    nsecs_t mLastVisibleTime = 0;
+    bool mBuffersReclaimed = false;
+
     // Timestamp history for the consumer to query.
     // Accessed by both consumer and producer on main and binder threads.
     Mutex mFrameEventHistoryMutex;
@@ -941,11 +973,29 @@ private:
     // Layer bounds in screen space.
     FloatRect mScreenBounds;
 
+    // Marks the cached bounds of this layer, and so of its children, as needing to be computed
+    // again, and lets its ancestors know to walk down to it.
+    void invalidateBounds();
+
+    // The inputs the cached bounds were last computed from
+    FloatRect mBoundsParentBounds;
+    ui::Transform mBoundsParentTransform;
+    // Set when the geometry of the layer changed since its bounds were last computed
+    bool mBoundsDirty = true;
+    // Set when the bounds of some of its descendants have to be computed again
+    bool mDescendantBoundsDirty = false;
+
     void setZOrderRelativeOf(const wp<Layer>& relativeOf);
 
     bool mGetHandleCalled = false;
 
     void removeRemoteSyncPoints();
+
+    // Occupancy segments recorded on the main thread and drained by the tracing thread in
+    // writeToProto(), each segment ending up in exactly one trace entry.
+    static constexpr size_t kMaxTracedOccupancySegments = 4;
+    std::mutex mTracedOccupancyLock;
+    std::deque<OccupancyTracker::Segment> mTracedOccupancy GUARDED_BY(mTracedOccupancyLock);
 };
 
 } // namespace android
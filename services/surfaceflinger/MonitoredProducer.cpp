@@ -47,6 +47,11 @@ status_t MonitoredProducer::requestBuffer(int slot, sp<GraphicBuffer>* buf) {
     return mProducer->requestBuffer(slot, buf);
 }
 
+status_t MonitoredProducer::requestBuffers(int slot,
+        std::vector<RequestBufferOutput>* outBuffers) {
+    return mProducer->requestBuffers(slot, outBuffers);
+}
+
 status_t MonitoredProducer::setMaxDequeuedBufferCount(
         int maxDequeuedBuffers) {
     return mProducer->setMaxDequeuedBufferCount(maxDequeuedBuffers);
@@ -146,6 +151,10 @@ void MonitoredProducer::getFrameTimestamps(FrameEventHistoryDelta* outDelta) {
     mProducer->getFrameTimestamps(outDelta);
 }
 
+status_t MonitoredProducer::getSharedFrameEvents(base::unique_fd* outFd) {
+    return mProducer->getSharedFrameEvents(outFd);
+}
+
 status_t MonitoredProducer::getUniqueId(uint64_t* outId) const {
     return mProducer->getUniqueId(outId);
 }
@@ -24,6 +24,7 @@
 #include <cutils/properties.h>
 #include <gui/IRegionSamplingListener.h>
 #include <utils/Trace.h>
+#include <cmath>
 #include <string>
 
 #include <compositionengine/Display.h>
@@ -55,6 +56,13 @@ constexpr auto maxRegionSamplingSkips = 10;
 constexpr auto defaultRegionSamplingOffset = -3ms;
 constexpr auto defaultRegionSamplingPeriod = 100ms;
 constexpr auto defaultRegionSamplingTimerTimeout = 100ms;
+// The sampled area is rendered scaled down to at most this many pixels, the GPU filtering
+// averages the pixels in between.
+constexpr int32_t maxRegionSamplingPixels = 128 * 128;
+// While no listener's luma moves by more than this, the sampling period doubles, up to
+// maxRegionSamplingPeriodScale times the configured one.
+constexpr float regionSamplingLumaChangeThreshold = 2.0f / 255.0f;
+constexpr uint32_t maxRegionSamplingPeriodScale = 4;
 // TODO: (b/127403193) duration to string conversion could probably be constexpr
 template <typename Rep, typename Per>
 inline std::string toNsString(std::chrono::duration<Rep, Per> t) {
@@ -214,6 +222,7 @@ void RegionSamplingThread::addListener(const Rect& samplingArea, const sp<IBinde
 void RegionSamplingThread::removeListener(const sp<IRegionSamplingListener>& listener) {
     std::lock_guard lock(mSamplingMutex);
     mDescriptors.erase(wp<IBinder>(IInterface::asBinder(listener)));
+    mLastLumas.erase(wp<IBinder>(IInterface::asBinder(listener)));
 }
 
 void RegionSamplingThread::checkForStaleLuma() {
@@ -237,9 +246,11 @@ void RegionSamplingThread::notifySamplingOffset() {
 void RegionSamplingThread::doSample() {
     std::lock_guard lock(mThreadControlMutex);
     auto now = std::chrono::nanoseconds(systemTime(SYSTEM_TIME_MONOTONIC));
-    if (lastSampleTime + mTunables.mSamplingPeriod > now) {
+    if (lastSampleTime + mTunables.mSamplingPeriod * mSamplingPeriodScale > now) {
         ATRACE_INT(lumaSamplingStepTag, static_cast<int>(samplingStep::idleTimerWaiting));
         if (mDiscardedFrames == 0) mDiscardedFrames++;
+        // The stretched period can outlast the timer, which has to check again after it
+        if (mSamplingPeriodScale > 1) mIdleTimer.reset();
         return;
     }
     if (mDiscardedFrames < maxRegionSamplingSkips) {
@@ -270,6 +281,7 @@ void RegionSamplingThread::doSample() {
 void RegionSamplingThread::binderDied(const wp<IBinder>& who) {
     std::lock_guard lock(mSamplingMutex);
     mDescriptors.erase(who);
+    mLastLumas.erase(who);
 }
 
 namespace {
@@ -328,8 +340,27 @@ float sampleArea(const uint32_t* data, int32_t width, int32_t height, int32_t st
     return bucket / 255.0f;
 }
 
+int32_t samplingDownscale(const Rect& area, int32_t maxPixels) {
+    const int64_t pixels = int64_t(area.getWidth()) * area.getHeight();
+    if (pixels <= maxPixels) {
+        return 1;
+    }
+    return static_cast<int32_t>(std::ceil(std::sqrt(double(pixels) / maxPixels)));
+}
+
+Rect downscaleArea(const Rect& area, int32_t downscale) {
+    const auto roundUp = [downscale](int32_t value) {
+        return (value + downscale - 1) / downscale;
+    };
+    Rect scaled(area.left / downscale, area.top / downscale, roundUp(area.right),
+                roundUp(area.bottom));
+    scaled.right = std::max(scaled.right, scaled.left + 1);
+    scaled.bottom = std::max(scaled.bottom, scaled.top + 1);
+    return scaled;
+}
+
 std::vector<float> RegionSamplingThread::sampleBuffer(
-        const sp<GraphicBuffer>& buffer, const Point& leftTop,
+        const sp<GraphicBuffer>& buffer, const Point& leftTop, int32_t downscale,
         const std::vector<RegionSamplingThread::Descriptor>& descriptors, uint32_t orientation) {
     void* data_raw = nullptr;
     buffer->lock(GRALLOC_USAGE_SW_READ_OFTEN, &data_raw);
@@ -344,7 +375,7 @@ std::vector<float> RegionSamplingThread::sampleBuffer(
     std::transform(descriptors.begin(), descriptors.end(), lumas.begin(),
                    [&](auto const& descriptor) {
                        return sampleArea(data.get(), width, height, stride, orientation,
-                                         descriptor.area - leftTop);
+                                         downscaleArea(descriptor.area - leftTop, downscale));
                    });
     return lumas;
 }
@@ -380,6 +411,10 @@ void RegionSamplingThread::captureSample() {
     }
 
     const Rect sampledArea = sampleRegion.bounds();
+    // All the areas are rendered together, scaled down so that only a few pixels are read back
+    const int32_t downscale = samplingDownscale(sampledArea, maxRegionSamplingPixels);
+    const Rect bufferArea = downscaleArea(Rect(sampledArea.getWidth(), sampledArea.getHeight()),
+                                          downscale);
 
     auto dx = 0;
     auto dy = 0;
@@ -401,8 +436,8 @@ void RegionSamplingThread::captureSample() {
     ui::Transform t(orientation);
     auto screencapRegion = t.transform(sampleRegion);
     screencapRegion = screencapRegion.translate(dx, dy);
-    DisplayRenderArea renderArea(device, screencapRegion.bounds(), sampledArea.getWidth(),
-                                 sampledArea.getHeight(), ui::Dataspace::V0_SRGB, orientation);
+    DisplayRenderArea renderArea(device, screencapRegion.bounds(), bufferArea.getWidth(),
+                                 bufferArea.getHeight(), ui::Dataspace::V0_SRGB, orientation);
 
     std::unordered_set<sp<IRegionSamplingListener>, SpHash<IRegionSamplingListener>> listeners;
 
@@ -448,12 +483,12 @@ void RegionSamplingThread::captureSample() {
     };
 
     sp<GraphicBuffer> buffer = nullptr;
-    if (mCachedBuffer && mCachedBuffer->getWidth() == sampledArea.getWidth() &&
-        mCachedBuffer->getHeight() == sampledArea.getHeight()) {
+    if (mCachedBuffer && mCachedBuffer->getWidth() == bufferArea.getWidth() &&
+        mCachedBuffer->getHeight() == bufferArea.getHeight()) {
         buffer = mCachedBuffer;
     } else {
         const uint32_t usage = GRALLOC_USAGE_SW_READ_OFTEN | GRALLOC_USAGE_HW_RENDER;
-        buffer = new GraphicBuffer(sampledArea.getWidth(), sampledArea.getHeight(),
+        buffer = new GraphicBuffer(bufferArea.getWidth(), bufferArea.getHeight(),
                                    PIXEL_FORMAT_RGBA_8888, 1, usage, "RegionSamplingThread");
     }
 
@@ -468,16 +503,33 @@ void RegionSamplingThread::captureSample() {
     }
 
     ALOGV("Sampling %zu descriptors", activeDescriptors.size());
-    std::vector<float> lumas =
-            sampleBuffer(buffer, sampledArea.leftTop(), activeDescriptors, orientation);
+    std::vector<float> lumas = sampleBuffer(buffer, sampledArea.leftTop(), downscale,
+                                            activeDescriptors, orientation);
     if (lumas.size() != activeDescriptors.size()) {
         ALOGW("collected %zu median luma values for %zu descriptors", lumas.size(),
               activeDescriptors.size());
         return;
     }
 
+    bool lumaChanged = false;
     for (size_t d = 0; d < activeDescriptors.size(); ++d) {
         activeDescriptors[d].listener->onSampleCollected(lumas[d]);
+
+        const wp<IBinder> listener = IInterface::asBinder(activeDescriptors[d].listener);
+        const auto [it, inserted] = mLastLumas.try_emplace(listener, lumas[d]);
+        if (inserted || std::abs(it->second - lumas[d]) > regionSamplingLumaChangeThreshold) {
+            lumaChanged = true;
+        }
+        it->second = lumas[d];
+    }
+
+    {
+        // Sample less often while nothing changes, and at full rate again once it does
+        std::lock_guard lock(mThreadControlMutex);
+        mSamplingPeriodScale = lumaChanged
+                ? 1
+                : std::min(mSamplingPeriodScale * 2, maxRegionSamplingPeriodScale);
+        ATRACE_INT("LumaSamplingPeriodScale", mSamplingPeriodScale);
     }
 
     // Extend the lifetime of mCachedBuffer from the previous frame to here to ensure that:
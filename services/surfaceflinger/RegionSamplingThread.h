@@ -40,6 +40,12 @@ struct SamplingOffsetCallback;
 float sampleArea(const uint32_t* data, int32_t width, int32_t height, int32_t stride,
                  uint32_t orientation, const Rect& area);
 
+// Factor by which the sampled area is scaled down when rendered, so that there are at most
+// maxPixels pixels left to read back.
+int32_t samplingDownscale(const Rect& area, int32_t maxPixels);
+// Where area ends up once scaled down, rounded outwards and never empty.
+Rect downscaleArea(const Rect& area, int32_t downscale);
+
 class RegionSamplingThread : public IBinder::DeathRecipient {
 public:
     struct TimingTunables {
@@ -94,7 +100,7 @@ private:
         }
     };
     std::vector<float> sampleBuffer(
-            const sp<GraphicBuffer>& buffer, const Point& leftTop,
+            const sp<GraphicBuffer>& buffer, const Point& leftTop, int32_t downscale,
             const std::vector<RegionSamplingThread::Descriptor>& descriptors, uint32_t orientation);
 
     void doSample();
@@ -119,10 +125,14 @@ private:
     bool mSampleRequested GUARDED_BY(mThreadControlMutex) = false;
     uint32_t mDiscardedFrames GUARDED_BY(mThreadControlMutex) = 0;
     std::chrono::nanoseconds lastSampleTime GUARDED_BY(mThreadControlMutex);
+    // The sampling period is stretched by this while the sampled luma doesn't change
+    uint32_t mSamplingPeriodScale GUARDED_BY(mThreadControlMutex) = 1;
 
     std::mutex mSamplingMutex;
     std::unordered_map<wp<IBinder>, Descriptor, WpHash> mDescriptors GUARDED_BY(mSamplingMutex);
     sp<GraphicBuffer> mCachedBuffer GUARDED_BY(mSamplingMutex) = nullptr;
+    // Luma last reported to each listener
+    std::unordered_map<wp<IBinder>, float, WpHash> mLastLumas GUARDED_BY(mSamplingMutex);
 };
 
 } // namespace android
@@ -23,6 +23,7 @@
 #include <math.h>
 
 #include <algorithm>
+#include <cmath>
 
 #include <android-base/stringprintf.h>
 #include <bfqio/bfqio.h>
@@ -58,6 +59,16 @@ static const bool kEnableZeroPhaseTracer = false;
 // present time and the nearest software-predicted vsync.
 static const nsecs_t kErrorThreshold = 160000000000; // 400 usec squared
 
+// Resync samples farther than this from the fit vsync timeline are left out
+// of the model, e.g. late interrupts.
+static const nsecs_t kOutlierThreshold = 1000000; // 1 ms
+
+// The model is only trusted to run without hardware vsync events when the
+// samples it was fit to are at most this far from it on average, and the
+// last of them is at most kMaxConfidentModelAge old.
+static const nsecs_t kMaxConfidentResidual = 200000;   // 200 usec
+static const nsecs_t kMaxConfidentModelAge = 5000000000; // 5 sec
+
 #undef LOG_TAG
 #define LOG_TAG "DispSyncThread"
 class DispSyncThread : public Thread {
@@ -515,6 +526,9 @@ void DispSync::resetLocked() {
         mReferenceTime = mResyncSamples[lastSampleIdx];
     }
     mModelUpdated = false;
+    mModelConfident = false;
+    mModelResidual = 0;
+    mNumInlierSamples = 0;
     for (size_t i = 0; i < MAX_RESYNC_SAMPLES; i++) {
         mResyncSamples[i] = 0;
     }
@@ -544,6 +558,13 @@ bool DispSync::addPresentFence(const std::shared_ptr<FenceTime>& fenceTime) {
 void DispSync::beginResync() {
     Mutex::Autolock lock(mMutex);
     ALOGV("[%s] beginResync", mName);
+    // The samples a confident model was fit to still are on the vsync
+    // timeline, new ones only extend it
+    if (mModelConfident && mPendingPeriod == 0) {
+        mNumResyncSamplesSincePresent = 0;
+        mThread->unlockModel();
+        return;
+    }
     resetLocked();
 }
 
@@ -606,8 +627,10 @@ bool DispSync::addResyncSample(nsecs_t timestamp, bool* periodFlushed) {
     }
 
     // Check against kErrorThreshold / 2 to add some hysteresis before having to
-    // resync again
-    bool modelLocked = mModelUpdated && mError < (kErrorThreshold / 2) && mPendingPeriod == 0;
+    // resync again. Samples keep coming until the model is confident, unless
+    // it never gets there with this much jitter.
+    bool modelLocked = mModelUpdated && mError < (kErrorThreshold / 2) && mPendingPeriod == 0 &&
+            (mModelConfident || mNumResyncSamples >= MAX_RESYNC_SAMPLES);
     ALOGV("[%s] addResyncSample returning %s", mName, modelLocked ? "locked" : "unlocked");
     if (modelLocked) {
         *periodFlushed = true;
@@ -668,45 +691,109 @@ void DispSync::updateModelLocked() {
     ALOGV("[%s] updateModelLocked %zu", mName, mNumResyncSamples);
     if (mNumResyncSamples >= MIN_RESYNC_SAMPLES_FOR_UPDATE) {
         ALOGV("[%s] Computing...", mName);
-        nsecs_t durationSum = 0;
-        nsecs_t minDuration = INT64_MAX;
-        nsecs_t maxDuration = 0;
         // We skip the first 2 samples because the first vsync duration on some
         // devices may be much more inaccurate than on other devices, e.g. due
         // to delays in ramping up from a power collapse. By doing so this
         // actually increases the accuracy of the DispSync model even though
         // we're effectively relying on fewer sample points.
         static constexpr size_t numSamplesSkipped = 2;
-        for (size_t i = numSamplesSkipped; i < mNumResyncSamples; i++) {
-            size_t idx = (mFirstResyncSample + i) % MAX_RESYNC_SAMPLES;
-            size_t prev = (idx + MAX_RESYNC_SAMPLES - 1) % MAX_RESYNC_SAMPLES;
-            nsecs_t duration = mResyncSamples[idx] - mResyncSamples[prev];
-            durationSum += duration;
-            minDuration = min(minDuration, duration);
-            maxDuration = max(maxDuration, duration);
+        const size_t numSamples = mNumResyncSamples - numSamplesSkipped;
+        const nsecs_t firstSample =
+                mResyncSamples[(mFirstResyncSample + numSamplesSkipped) % MAX_RESYNC_SAMPLES];
+
+        // The samples are numbered by the vsync they belong to, which takes
+        // the period of the last fit if there is one: samples a confident
+        // model kept can be long apart. Otherwise they are consecutive, and
+        // their average duration will do.
+        nsecs_t period = mPeriod / (1 + mRefreshSkipCount);
+        if (!mModelUpdated || period <= 0) {
+            nsecs_t durationSum = 0;
+            nsecs_t minDuration = INT64_MAX;
+            nsecs_t maxDuration = 0;
+            for (size_t i = numSamplesSkipped + 1; i < mNumResyncSamples; i++) {
+                size_t idx = (mFirstResyncSample + i) % MAX_RESYNC_SAMPLES;
+                size_t prev = (idx + MAX_RESYNC_SAMPLES - 1) % MAX_RESYNC_SAMPLES;
+                nsecs_t duration = mResyncSamples[idx] - mResyncSamples[prev];
+                durationSum += duration;
+                minDuration = min(minDuration, duration);
+                maxDuration = max(maxDuration, duration);
+            }
+            // Exclude the min and max from the average
+            durationSum -= minDuration + maxDuration;
+            period = durationSum / nsecs_t(numSamples - 3);
+        }
+        if (period <= 0) {
+            return;
         }
 
-        // Exclude the min and max from the average
-        durationSum -= minDuration + maxDuration;
-        mPeriod = durationSum / (mNumResyncSamples - numSamplesSkipped - 2);
+        // Fit sample time = intercept + slope * vsync number by least squares,
+        // then again without the samples too far from the first fit.
+        double vsyncs[MAX_RESYNC_SAMPLES];
+        double times[MAX_RESYNC_SAMPLES];
+        bool inliers[MAX_RESYNC_SAMPLES];
+        for (size_t i = 0; i < numSamples; i++) {
+            size_t idx = (mFirstResyncSample + numSamplesSkipped + i) % MAX_RESYNC_SAMPLES;
+            times[i] = double(mResyncSamples[idx] - firstSample);
+            vsyncs[i] = std::round(times[i] / double(period));
+            inliers[i] = true;
+        }
 
-        ALOGV("[%s] mPeriod = %" PRId64, mName, ns2us(mPeriod));
+        double slope = double(period);
+        double intercept = 0;
+        size_t numInliers = numSamples;
+        for (int pass = 0; pass < 2; pass++) {
+            double sumX = 0, sumY = 0, sumXX = 0, sumXY = 0;
+            size_t n = 0;
+            for (size_t i = 0; i < numSamples; i++) {
+                if (!inliers[i]) continue;
+                sumX += vsyncs[i];
+                sumY += times[i];
+                sumXX += vsyncs[i] * vsyncs[i];
+                sumXY += vsyncs[i] * times[i];
+                n++;
+            }
+            const double denominator = n * sumXX - sumX * sumX;
+            if (n < 2 || denominator == 0) {
+                break;
+            }
+            slope = (n * sumXY - sumX * sumY) / denominator;
+            intercept = (sumY - slope * sumX) / n;
+
+            numInliers = 0;
+            for (size_t i = 0; i < numSamples; i++) {
+                const double residual = times[i] - (intercept + slope * vsyncs[i]);
+                inliers[i] = std::abs(residual) <= kOutlierThreshold;
+                numInliers += inliers[i];
+            }
+            if (numInliers < MIN_RESYNC_SAMPLES_FOR_UPDATE - numSamplesSkipped) {
+                // Too much is off to tell outliers apart, keep the plain fit
+                std::fill(inliers, inliers + numSamples, true);
+                numInliers = numSamples;
+                break;
+            }
+        }
 
-        double sampleAvgX = 0;
-        double sampleAvgY = 0;
-        double scale = 2.0 * M_PI / double(mPeriod);
-        for (size_t i = numSamplesSkipped; i < mNumResyncSamples; i++) {
-            size_t idx = (mFirstResyncSample + i) % MAX_RESYNC_SAMPLES;
-            nsecs_t sample = mResyncSamples[idx] - mReferenceTime;
-            double samplePhase = double(sample % mPeriod) * scale;
-            sampleAvgX += cos(samplePhase);
-            sampleAvgY += sin(samplePhase);
+        double squaredResidualSum = 0;
+        for (size_t i = 0; i < numSamples; i++) {
+            if (inliers[i]) {
+                const double residual = times[i] - (intercept + slope * vsyncs[i]);
+                squaredResidualSum += residual * residual;
+            }
         }
+        mModelResidual = nsecs_t(std::sqrt(squaredResidualSum / numInliers));
+        mNumInlierSamples = numInliers;
+        mModelConfident = !mIgnorePresentFences &&
+                mNumInlierSamples >= MIN_RESYNC_SAMPLES_FOR_CONFIDENCE &&
+                mModelResidual <= kMaxConfidentResidual;
 
-        sampleAvgX /= double(mNumResyncSamples - numSamplesSkipped);
-        sampleAvgY /= double(mNumResyncSamples - numSamplesSkipped);
+        mPeriod = nsecs_t(std::round(slope));
+        ALOGV("[%s] mPeriod = %" PRId64, mName, ns2us(mPeriod));
 
-        mPhase = nsecs_t(atan2(sampleAvgY, sampleAvgX) / scale);
+        // The phase is where the fit puts the vsync of the reference time,
+        // relative to it
+        const double reference = double(mReferenceTime - firstSample);
+        const double referenceVsync = std::round((reference - intercept) / slope);
+        mPhase = nsecs_t(std::round(intercept + slope * referenceVsync - reference));
 
         ALOGV("[%s] mPhase = %" PRId64, mName, ns2us(mPhase));
 
@@ -715,6 +802,12 @@ void DispSync::updateModelLocked() {
             ALOGV("[%s] Adjusting mPhase -> %" PRId64, mName, ns2us(mPhase));
         }
 
+        if (mTraceDetailedInfo) {
+            ATRACE_INT64("DispSync:Residual", mModelResidual);
+            ATRACE_INT("DispSync:Inliers", mNumInlierSamples);
+            ATRACE_INT("DispSync:Confident", mModelConfident);
+        }
+
         // Artificially inflate the period if requested.
         mPeriod += mPeriod * mRefreshSkipCount;
 
@@ -761,6 +854,10 @@ void DispSync::updateErrorLocked() {
     if (numErrSamples > 0) {
         mError = sqErrSum / numErrSamples;
         mZeroErrSamplesCount = 0;
+        // The model drifted, whatever it was fit to
+        if (mError >= kErrorThreshold / 2) {
+            mModelConfident = false;
+        }
     } else {
         mError = 0;
         // Use mod ACCEPTABLE_ZERO_ERR_SAMPLES_COUNT to avoid log spam.
@@ -815,6 +912,8 @@ void DispSync::dump(std::string& result) const {
                   mNumResyncSamplesSincePresent, MAX_RESYNC_SAMPLES_WITHOUT_PRESENT);
     StringAppendF(&result, "mNumResyncSamples: %zd (max %d)\n", mNumResyncSamples,
                   MAX_RESYNC_SAMPLES);
+    StringAppendF(&result, "model: %zu inlier samples, residual %" PRId64 " ns, %s\n",
+                  mNumInlierSamples, mModelResidual, mModelConfident ? "confident" : "not confident");
 
     result.append("mResyncSamples:\n");
     nsecs_t previous = -1;
@@ -856,6 +955,16 @@ void DispSync::dump(std::string& result) const {
     StringAppendF(&result, "current monotonic time: %" PRId64 "\n", now);
 }
 
+bool DispSync::isModelConfident(nsecs_t period) const {
+    Mutex::Autolock lock(mMutex);
+    if (!mModelConfident || mPendingPeriod != 0 || period != mIntendedPeriod) {
+        return false;
+    }
+    const size_t lastSampleIdx = (mFirstResyncSample + mNumResyncSamples - 1) % MAX_RESYNC_SAMPLES;
+    return systemTime(SYSTEM_TIME_MONOTONIC) - mResyncSamples[lastSampleIdx] <=
+            kMaxConfidentModelAge;
+}
+
 nsecs_t DispSync::expectedPresentTime() {
     // The HWC doesn't currently have a way to report additional latency.
     // Assume that whatever we submit now will appear right after the flip.
@@ -61,6 +61,7 @@ public:
     virtual nsecs_t computeNextRefresh(int periodOffset) const = 0;
     virtual void setIgnorePresentFences(bool ignore) = 0;
     virtual nsecs_t expectedPresentTime() = 0;
+    virtual bool isModelConfident(nsecs_t period) const = 0;
 
     virtual void dump(std::string& result) const = 0;
 
@@ -186,6 +187,11 @@ public:
     // Determine the expected present time when a buffer acquired now will be displayed.
     nsecs_t expectedPresentTime();
 
+    // Whether the model was fit closely to enough recent hardware vsync
+    // events, at the given period, for it to go on predicting without them.
+    // A resync is then only needed once present fences show it drifted.
+    bool isModelConfident(nsecs_t period) const override;
+
     // dump appends human-readable debug info to the result string.
     void dump(std::string& result) const override;
 
@@ -200,6 +206,7 @@ private:
     enum { NUM_PRESENT_SAMPLES = 8 };
     enum { MAX_RESYNC_SAMPLES_WITHOUT_PRESENT = 4 };
     enum { ACCEPTABLE_ZERO_ERR_SAMPLES_COUNT = 64 };
+    enum { MIN_RESYNC_SAMPLES_FOR_CONFIDENCE = 12 };
 
     const char* const mName;
 
@@ -239,6 +246,16 @@ private:
     // Whether we have updated the vsync event model since the last resync.
     bool mModelUpdated;
 
+    // The root mean square distance of the resync samples the model was fit
+    // to from the model, and how many samples those were. Samples too far
+    // from the fit are left out as outliers.
+    nsecs_t mModelResidual = 0;
+    size_t mNumInlierSamples = 0;
+
+    // Whether enough samples fit the model closely enough, and present fences
+    // haven't shown it drifting since, see isModelConfident().
+    bool mModelConfident = false;
+
     // These member variables are the state used during the resynchronization
     // process to store information about the hardware vsync event times used
     // to compute the model.
@@ -20,6 +20,7 @@
 #include <sched.h>
 #include <sys/types.h>
 
+#include <algorithm>
 #include <chrono>
 #include <cstdint>
 #include <optional>
@@ -64,6 +65,10 @@ std::string toString(VSyncRequest request) {
 }
 
 std::string toString(const EventThreadConnection& connection) {
+    if (connection.workDuration > 0) {
+        return StringPrintf("Connection{%p, %s, workDuration=%" PRId64 "}", &connection,
+                            toString(connection.vsyncRequest).c_str(), connection.workDuration);
+    }
     return StringPrintf("Connection{%p, %s}", &connection,
                         toString(connection.vsyncRequest).c_str());
 }
@@ -145,6 +150,19 @@ void EventThreadConnection::requestNextVsync() {
     mEventThread->requestNextVsync(this);
 }
 
+status_t EventThreadConnection::setWorkDuration(nsecs_t workDuration) {
+    if (workDuration < 0) {
+        return BAD_VALUE;
+    }
+    mEventThread->setWorkDuration(workDuration, this);
+    return NO_ERROR;
+}
+
+status_t EventThreadConnection::getVsyncTimeline(gui::VsyncTimeline* outTimeline,
+                                                 bool muteVSyncEvents) {
+    return mEventThread->getVsyncTimeline(outTimeline, muteVSyncEvents, this);
+}
+
 status_t EventThreadConnection::postEvent(const DisplayEventReceiver::Event& event) {
     ssize_t size = DisplayEventReceiver::sendEvents(&mChannel, &event, 1);
     return size < 0 ? status_t(size) : status_t(NO_ERROR);
@@ -213,6 +231,19 @@ void EventThread::setPhaseOffset(nsecs_t phaseOffset) {
     mVSyncSource->setPhaseOffset(phaseOffset);
 }
 
+void EventThread::setWorkBudget(nsecs_t workBudget) {
+    std::lock_guard<std::mutex> lock(mMutex);
+    mWorkBudget = workBudget;
+}
+
+void EventThread::setParked(bool parked) {
+    std::lock_guard<std::mutex> lock(mMutex);
+    if (mParked != parked) {
+        mParked = parked;
+        mCondition.notify_all();
+    }
+}
+
 sp<EventThreadConnection> EventThread::createEventConnection(
         ResyncCallback resyncCallback, ISurfaceComposer::ConfigChanged configChanged) const {
     return new EventThreadConnection(const_cast<EventThread*>(this), std::move(resyncCallback),
@@ -271,6 +302,23 @@ void EventThread::requestNextVsync(const sp<EventThreadConnection>& connection)
     }
 }
 
+void EventThread::setWorkDuration(nsecs_t workDuration,
+                                  const sp<EventThreadConnection>& connection) {
+    std::lock_guard<std::mutex> lock(mMutex);
+    connection->workDuration = workDuration;
+}
+
+status_t EventThread::getVsyncTimeline(gui::VsyncTimeline* outTimeline, bool muteVSyncEvents,
+                                       const sp<EventThreadConnection>& connection) {
+    std::lock_guard<std::mutex> lock(mMutex);
+    status_t err = mVSyncTimeline.share(outTimeline);
+    if (err != NO_ERROR) {
+        return err;
+    }
+    connection->muteVSyncEvents = muteVSyncEvents;
+    return NO_ERROR;
+}
+
 void EventThread::onScreenReleased() {
     std::lock_guard<std::mutex> lock(mMutex);
     if (!mVSyncState || mVSyncState->synthetic) {
@@ -335,6 +383,7 @@ void EventThread::threadMain(std::unique_lock<std::mutex>& lock) {
                     break;
 
                 case DisplayEventReceiver::DISPLAY_EVENT_VSYNC:
+                    publishVSyncEvent(*event);
                     if (mInterceptVSyncsCallback) {
                         mInterceptVSyncsCallback(event->header.timestamp);
                     }
@@ -348,7 +397,7 @@ void EventThread::threadMain(std::unique_lock<std::mutex>& lock) {
         auto it = mDisplayEventConnections.begin();
         while (it != mDisplayEventConnections.end()) {
             if (const auto connection = it->promote()) {
-                vsyncRequested |= connection->vsyncRequest != VSyncRequest::None;
+                vsyncRequested |= isVSyncRequested(*connection);
 
                 if (event && shouldConsumeEvent(*event, connection)) {
                     consumers.push_back(connection);
@@ -360,6 +409,10 @@ void EventThread::threadMain(std::unique_lock<std::mutex>& lock) {
             }
         }
 
+        if (!consumers.empty() && event->header.type == DisplayEventReceiver::DISPLAY_EVENT_VSYNC) {
+            deferVSyncEvent(*event, consumers);
+        }
+
         if (!consumers.empty()) {
             dispatchEvent(*event, consumers);
             consumers.clear();
@@ -379,6 +432,10 @@ void EventThread::threadMain(std::unique_lock<std::mutex>& lock) {
             } else if (nextState == State::VSync) {
                 mVSyncSource->setVSyncEnabled(true);
             }
+            if (nextState == State::Idle) {
+                // The next VSYNC is not a period away from the last one.
+                mLastVSync.count = 0;
+            }
 
             mState = nextState;
         }
@@ -387,14 +444,21 @@ void EventThread::threadMain(std::unique_lock<std::mutex>& lock) {
             continue;
         }
 
-        // Wait for event or client registration/request.
+        // Wait for event or client registration/request, or for a deferred event to be due.
+        const auto deferredDelay = dispatchDeferredEvents();
         if (mState == State::Idle) {
-            mCondition.wait(lock);
+            if (deferredDelay) {
+                mCondition.wait_for(lock, std::chrono::nanoseconds(*deferredDelay));
+            } else {
+                mCondition.wait(lock);
+            }
         } else {
             // Generate a fake VSYNC after a long timeout in case the driver stalls. When the
             // display is off, keep feeding clients at 60 Hz.
             const auto timeout = mState == State::SyntheticVSync ? 16ms : 1000ms;
-            if (mCondition.wait_for(lock, timeout) == std::cv_status::timeout) {
+            if (deferredDelay && std::chrono::nanoseconds(*deferredDelay) < timeout) {
+                mCondition.wait_for(lock, std::chrono::nanoseconds(*deferredDelay));
+            } else if (mCondition.wait_for(lock, timeout) == std::cv_status::timeout) {
                 ALOGW_IF(mState == State::VSync, "Faking VSYNC due to driver stall");
 
                 LOG_FATAL_IF(!mVSyncState);
@@ -416,16 +480,22 @@ bool EventThread::shouldConsumeEvent(const DisplayEventReceiver::Event& event,
             return connection->configChanged == ISurfaceComposer::eConfigChangedDispatch;
 
         case DisplayEventReceiver::DISPLAY_EVENT_VSYNC:
+            if (!isVSyncRequested(*connection)) {
+                return false;
+            }
+            // Muted connections read the event from the timeline, but their request is
+            // served all the same.
             switch (connection->vsyncRequest) {
                 case VSyncRequest::None:
                     return false;
                 case VSyncRequest::Single:
                     connection->vsyncRequest = VSyncRequest::None;
-                    return true;
+                    return !connection->muteVSyncEvents;
                 case VSyncRequest::Periodic:
-                    return true;
+                    return !connection->muteVSyncEvents;
                 default:
-                    return event.vsync.count % vsyncPeriod(connection->vsyncRequest) == 0;
+                    return !connection->muteVSyncEvents &&
+                            event.vsync.count % vsyncPeriod(connection->vsyncRequest) == 0;
             }
 
         default:
@@ -433,6 +503,17 @@ bool EventThread::shouldConsumeEvent(const DisplayEventReceiver::Event& event,
     }
 }
 
+bool EventThread::isVSyncRequested(const EventThreadConnection& connection) const {
+    switch (connection.vsyncRequest) {
+        case VSyncRequest::None:
+            return false;
+        case VSyncRequest::Single:
+            return true;
+        default:
+            return !mParked;
+    }
+}
+
 void EventThread::dispatchEvent(const DisplayEventReceiver::Event& event,
                                 const DisplayEventConsumers& consumers) {
     for (const auto& consumer : consumers) {
@@ -453,10 +534,74 @@ void EventThread::dispatchEvent(const DisplayEventReceiver::Event& event,
     }
 }
 
+void EventThread::publishVSyncEvent(const DisplayEventReceiver::Event& event) {
+    if (mVSyncTimeline.initCheck() != NO_ERROR) {
+        return;
+    }
+
+    gui::VsyncTimeline::Vsync vsync;
+    vsync.timestamp = event.header.timestamp;
+    vsync.count = event.vsync.count;
+    vsync.period = mLastVSync.period;
+    if (mLastVSync.count != 0 && vsync.count == mLastVSync.count + 1 &&
+        vsync.timestamp > mLastVSync.timestamp) {
+        vsync.period = vsync.timestamp - mLastVSync.timestamp;
+    }
+    mVSyncTimeline.publish(vsync);
+    mLastVSync = vsync;
+}
+
+void EventThread::deferVSyncEvent(const DisplayEventReceiver::Event& event,
+                                  DisplayEventConsumers& consumers) {
+    if (mWorkBudget <= 0) {
+        return;
+    }
+
+    // A connection which needs less than the budget gets the event as late as still leaves it
+    // its work duration, the others get it right away, all at once.
+    auto it = consumers.begin();
+    while (it != consumers.end()) {
+        const nsecs_t workDuration = (*it)->workDuration;
+        if (workDuration > 0 && workDuration < mWorkBudget) {
+            mDeferredEvents.push_back(
+                    {event.header.timestamp + mWorkBudget - workDuration, event, *it});
+            it = consumers.erase(it);
+        } else {
+            ++it;
+        }
+    }
+}
+
+std::optional<nsecs_t> EventThread::dispatchDeferredEvents() {
+    if (mDeferredEvents.empty()) {
+        return {};
+    }
+
+    const nsecs_t now = systemTime(SYSTEM_TIME_MONOTONIC);
+    std::optional<nsecs_t> nextDelay;
+    auto it = mDeferredEvents.begin();
+    while (it != mDeferredEvents.end()) {
+        if (it->dispatchTime > now) {
+            nextDelay = std::min(nextDelay.value_or(INT64_MAX), it->dispatchTime - now);
+            ++it;
+            continue;
+        }
+
+        const DeferredEvent deferred = std::move(*it);
+        it = mDeferredEvents.erase(it);
+        if (const auto connection = deferred.connection.promote()) {
+            ATRACE_NAME("dispatchDeferredVSync");
+            dispatchEvent(deferred.event, {connection});
+        }
+    }
+    return nextDelay;
+}
+
 void EventThread::dump(std::string& result) const {
     std::lock_guard<std::mutex> lock(mMutex);
 
-    StringAppendF(&result, "%s: state=%s VSyncState=", mThreadName, toCString(mState));
+    StringAppendF(&result, "%s: state=%s%s VSyncState=", mThreadName, toCString(mState),
+                  mParked ? " (parked)" : "");
     if (mVSyncState) {
         StringAppendF(&result, "{displayId=%" ANDROID_PHYSICAL_DISPLAY_ID_FORMAT ", count=%u%s}\n",
                       mVSyncState->displayId, mVSyncState->count,
@@ -470,6 +615,13 @@ void EventThread::dump(std::string& result) const {
         StringAppendF(&result, "    %s\n", toString(event).c_str());
     }
 
+    StringAppendF(&result, "  deferred events (count=%zu, workBudget=%" PRId64 "):\n",
+                  mDeferredEvents.size(), mWorkBudget);
+    for (const auto& deferred : mDeferredEvents) {
+        StringAppendF(&result, "    %s at %" PRId64 "\n", toString(deferred.event).c_str(),
+                      deferred.dispatchTime);
+    }
+
     StringAppendF(&result, "  connections (count=%zu):\n", mDisplayEventConnections.size());
     for (const auto& ptr : mDisplayEventConnections) {
         if (const auto connection = ptr.promote()) {
@@ -31,6 +31,7 @@
 #include <gui/DisplayEventReceiver.h>
 #include <gui/IDisplayEventConnection.h>
 #include <private/gui/BitTube.h>
+#include <private/gui/VsyncTimeline.h>
 
 #include <utils/Errors.h>
 
@@ -78,11 +79,17 @@ public:
     status_t stealReceiveChannel(gui::BitTube* outChannel) override;
     status_t setVsyncRate(uint32_t rate) override;
     void requestNextVsync() override; // asynchronous
+    status_t setWorkDuration(nsecs_t workDuration) override;
+    status_t getVsyncTimeline(gui::VsyncTimeline* outTimeline, bool muteVSyncEvents) override;
 
     // Called in response to requestNextVsync.
     const ResyncCallback resyncCallback;
 
     VSyncRequest vsyncRequest = VSyncRequest::None;
+    // How long the client takes to produce a frame, or 0 if unknown.
+    nsecs_t workDuration = 0;
+    // Whether the client reads VSYNC events from the timeline instead of the channel.
+    bool muteVSyncEvents = false;
     const ISurfaceComposer::ConfigChanged configChanged;
 
 private:
@@ -113,11 +120,25 @@ public:
 
     virtual void setPhaseOffset(nsecs_t phaseOffset) = 0;
 
+    // Sets how long after a VSYNC event is dispatched the frame produced for it is due.
+    // Connections which take less than that to produce a frame get the event later, such
+    // that they still have their work duration left.
+    virtual void setWorkBudget(nsecs_t workBudget) = 0;
+
+    // While parked, connections with a periodic VSYNC request neither get VSYNC events nor
+    // keep VSYNC enabled. Explicit requests for the next VSYNC are still served.
+    virtual void setParked(bool parked) = 0;
+
     virtual status_t registerDisplayEventConnection(
             const sp<EventThreadConnection>& connection) = 0;
     virtual void setVsyncRate(uint32_t rate, const sp<EventThreadConnection>& connection) = 0;
     // Requests the next vsync. If resetIdleTimer is set to true, it resets the idle timer.
     virtual void requestNextVsync(const sp<EventThreadConnection>& connection) = 0;
+    virtual void setWorkDuration(nsecs_t workDuration,
+                                 const sp<EventThreadConnection>& connection) = 0;
+    // Shares the timeline VSYNC events are published in with the connection.
+    virtual status_t getVsyncTimeline(gui::VsyncTimeline* outTimeline, bool muteVSyncEvents,
+                                      const sp<EventThreadConnection>& connection) = 0;
 };
 
 namespace impl {
@@ -137,6 +158,10 @@ public:
     status_t registerDisplayEventConnection(const sp<EventThreadConnection>& connection) override;
     void setVsyncRate(uint32_t rate, const sp<EventThreadConnection>& connection) override;
     void requestNextVsync(const sp<EventThreadConnection>& connection) override;
+    void setWorkDuration(nsecs_t workDuration,
+                         const sp<EventThreadConnection>& connection) override;
+    status_t getVsyncTimeline(gui::VsyncTimeline* outTimeline, bool muteVSyncEvents,
+                              const sp<EventThreadConnection>& connection) override;
 
     // called before the screen is turned off from main thread
     void onScreenReleased() override;
@@ -152,6 +177,10 @@ public:
 
     void setPhaseOffset(nsecs_t phaseOffset) override;
 
+    void setWorkBudget(nsecs_t workBudget) override;
+
+    void setParked(bool parked) override;
+
 private:
     friend EventThreadTest;
 
@@ -165,12 +194,22 @@ private:
 
     bool shouldConsumeEvent(const DisplayEventReceiver::Event& event,
                             const sp<EventThreadConnection>& connection) const REQUIRES(mMutex);
+    // Whether the connection wants VSYNC events, which periodic requests don't while parked.
+    bool isVSyncRequested(const EventThreadConnection& connection) const REQUIRES(mMutex);
     void dispatchEvent(const DisplayEventReceiver::Event& event,
                        const DisplayEventConsumers& consumers) REQUIRES(mMutex);
+    // Moves the consumers of a VSYNC event which should get it later to mDeferredEvents.
+    void deferVSyncEvent(const DisplayEventReceiver::Event& event,
+                         DisplayEventConsumers& consumers) REQUIRES(mMutex);
+    // Dispatches the deferred events which are due, and returns how long until the next one is.
+    std::optional<nsecs_t> dispatchDeferredEvents() REQUIRES(mMutex);
 
     void removeDisplayEventConnectionLocked(const wp<EventThreadConnection>& connection)
             REQUIRES(mMutex);
 
+    // Publishes a VSYNC event to the timeline, estimating the period from the previous one.
+    void publishVSyncEvent(const DisplayEventReceiver::Event& event) REQUIRES(mMutex);
+
     // Implements VSyncSource::Callback
     void onVSyncEvent(nsecs_t timestamp) override;
 
@@ -188,6 +227,22 @@ private:
     std::vector<wp<EventThreadConnection>> mDisplayEventConnections GUARDED_BY(mMutex);
     std::deque<DisplayEventReceiver::Event> mPendingEvents GUARDED_BY(mMutex);
 
+    // VSYNC events held back for connections with a work duration shorter than the budget.
+    struct DeferredEvent {
+        nsecs_t dispatchTime;
+        DisplayEventReceiver::Event event;
+        wp<EventThreadConnection> connection;
+    };
+    std::vector<DeferredEvent> mDeferredEvents GUARDED_BY(mMutex);
+    nsecs_t mWorkBudget GUARDED_BY(mMutex) = 0;
+
+    bool mParked GUARDED_BY(mMutex) = false;
+
+    // Latest VSYNC event, shared with connections which read it without a syscall.
+    gui::VsyncTimeline mVSyncTimeline{gui::VsyncTimeline::Publisher};
+    // Last VSYNC published since VSYNC was enabled, whose successor gives the period.
+    gui::VsyncTimeline::Vsync mLastVSync GUARDED_BY(mMutex);
+
     // VSYNC state of connected display.
     struct VSyncState {
         explicit VSyncState(PhysicalDisplayId displayId) : displayId(displayId) {}
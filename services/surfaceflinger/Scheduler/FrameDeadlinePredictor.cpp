@@ -0,0 +1,77 @@
+/*
+ * Copyright 2019 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "FrameDeadlinePredictor.h"
+
+#include <algorithm>
+#include <cinttypes>
+
+#include <android-base/stringprintf.h>
+
+namespace android {
+namespace scheduler {
+
+namespace {
+
+// Below this many measured frames there is nothing to predict from
+constexpr size_t MIN_FRAMES_FOR_PREDICTION = 8;
+
+} // namespace
+
+bool FrameDeadlinePredictor::willMissDeadline(nsecs_t now, nsecs_t deadline,
+                                              bool clientComposition) const {
+    const nsecs_t duration = predictDuration(clientComposition);
+    return duration > 0 && now + duration > deadline;
+}
+
+void FrameDeadlinePredictor::beginFrame(nsecs_t start) {
+    mFrameStart = start;
+}
+
+void FrameDeadlinePredictor::endFrame(nsecs_t now, bool clientComposition) {
+    if (!mFrameStart) {
+        return;
+    }
+
+    History& history = clientComposition ? mClientHistory : mDeviceHistory;
+    history.durations[history.next] = now - *mFrameStart;
+    history.next = (history.next + 1) % HISTORY_SIZE;
+    history.count = std::min(history.count + 1, HISTORY_SIZE);
+    mFrameStart.reset();
+}
+
+nsecs_t FrameDeadlinePredictor::predictDuration(bool clientComposition) const {
+    const History& history = clientComposition ? mClientHistory : mDeviceHistory;
+    if (history.count < MIN_FRAMES_FOR_PREDICTION) {
+        return 0;
+    }
+
+    std::array<nsecs_t, HISTORY_SIZE> durations = history.durations;
+    const auto end = durations.begin() + history.count;
+    const auto percentile = durations.begin() + (history.count - 1) * PERCENTILE / 100;
+    std::nth_element(durations.begin(), percentile, end);
+    return *percentile;
+}
+
+void FrameDeadlinePredictor::dump(std::string& result) const {
+    base::StringAppendF(&result,
+                        "Predicted frame duration: %.2f ms (device composition), "
+                        "%.2f ms (client composition)\n",
+                        predictDuration(false) / 1e6f, predictDuration(true) / 1e6f);
+}
+
+} // namespace scheduler
+} // namespace android
@@ -0,0 +1,69 @@
+/*
+ * Copyright 2019 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <optional>
+#include <string>
+
+#include <utils/Timers.h>
+
+namespace android {
+namespace scheduler {
+
+// Predicts, when SurfaceFlinger wakes up for a frame, whether the frame will
+// miss its expected present time. Frames take about as long as recent ones,
+// from invalidate until presentDisplay returns, counting frames with and
+// without client composition apart as the latter are the slow ones.
+class FrameDeadlinePredictor {
+public:
+    // Number of recent frames of each kind the prediction is made from
+    static constexpr size_t HISTORY_SIZE = 32;
+    // The prediction is this percentile of the recent durations: a frame only
+    // counts as on time if almost all recent frames would have been.
+    static constexpr size_t PERCENTILE = 90;
+
+    // Whether a frame starting now is predicted to miss deadline.
+    bool willMissDeadline(nsecs_t now, nsecs_t deadline, bool clientComposition) const;
+
+    // Called when a frame which started at start goes on to be composited.
+    void beginFrame(nsecs_t start);
+
+    // Called once the frame passed to the last beginFrame was presented.
+    void endFrame(nsecs_t now, bool clientComposition);
+
+    // Predicted duration of the next frame, 0 until enough frames of the kind
+    // were measured.
+    nsecs_t predictDuration(bool clientComposition) const;
+
+    void dump(std::string& result) const;
+
+private:
+    struct History {
+        std::array<nsecs_t, HISTORY_SIZE> durations{};
+        size_t count = 0;
+        size_t next = 0;
+    };
+
+    History mDeviceHistory;
+    History mClientHistory;
+    std::optional<nsecs_t> mFrameStart;
+};
+
+} // namespace scheduler
+} // namespace android
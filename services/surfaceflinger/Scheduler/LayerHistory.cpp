@@ -18,6 +18,7 @@
 
 #include "LayerHistory.h"
 
+#include <algorithm>
 #include <cinttypes>
 #include <cstdint>
 #include <limits>
@@ -25,6 +26,7 @@
 #include <string>
 #include <unordered_map>
 
+#include <android-base/stringprintf.h>
 #include <cutils/properties.h>
 #include <utils/Log.h>
 #include <utils/Timers.h>
@@ -35,6 +37,8 @@
 namespace android {
 namespace scheduler {
 
+using base::StringAppendF;
+
 std::atomic<int64_t> LayerHistory::sNextId = 0;
 
 LayerHistory::LayerHistory() {
@@ -94,6 +98,19 @@ void LayerHistory::insert(const std::unique_ptr<LayerHandle>& layerHandle, nsecs
     layerInfo->setHDRContent(isHdr);
 }
 
+void LayerHistory::setVisibleArea(const std::unique_ptr<LayerHandle>& layerHandle,
+                                  int64_t area) {
+    std::lock_guard lock(mLock);
+    auto layerInfoIterator = mActiveLayerInfos.find(layerHandle->mId);
+    if (layerInfoIterator == mActiveLayerInfos.end()) {
+        layerInfoIterator = mInactiveLayerInfos.find(layerHandle->mId);
+        if (layerInfoIterator == mInactiveLayerInfos.end()) {
+            return;
+        }
+    }
+    layerInfoIterator->second->setVisibleArea(area);
+}
+
 void LayerHistory::setVisibility(const std::unique_ptr<LayerHandle>& layerHandle, bool visible) {
     std::shared_ptr<LayerInfo> layerInfo;
     {
@@ -126,24 +143,41 @@ std::pair<float, bool> LayerHistory::getDesiredRefreshRateAndHDR() {
 
     removeIrrelevantLayers();
 
+    int64_t maxArea = 0;
+    for (const auto& [layerId, layerInfo] : mActiveLayerInfos) {
+        maxArea = std::max(maxArea, layerInfo->getVisibleArea().value_or(0));
+    }
+
     // Iterate through all layers that have been recently updated, and find the max refresh rate.
+    // Layers whose area isn't known count fully.
+    float fallbackRefreshRate = 0.f;
     for (const auto& [layerId, layerInfo] : mActiveLayerInfos) {
         const float layerRefreshRate = layerInfo->getDesiredRefreshRate();
+        const auto area = layerInfo->getVisibleArea();
+        const float weight = area && maxArea > 0 ? float(*area) / maxArea : 1.f;
         if (mTraceEnabled) {
             // Store the refresh rate in traces for easy debugging.
             std::string layerName = "LFPS " + layerInfo->getName();
             ATRACE_INT(layerName.c_str(), std::round(layerRefreshRate));
-            ALOGD("%s: %f", layerName.c_str(), std::round(layerRefreshRate));
+            ATRACE_INT(("LCadence " + layerInfo->getName()).c_str(), layerInfo->getCadence());
+            ATRACE_INT(("LWeight " + layerInfo->getName()).c_str(), std::round(weight * 100));
+            ALOGD("%s: %f cadence %zu weight %.2f", layerName.c_str(), std::round(layerRefreshRate),
+                  layerInfo->getCadence(), weight);
         }
-        if (layerInfo->isRecentlyActive() && layerRefreshRate > newRefreshRate) {
-            newRefreshRate = layerRefreshRate;
+        if (layerInfo->isRecentlyActive()) {
+            float& refreshRate = weight >= MIN_VOTE_WEIGHT ? newRefreshRate : fallbackRefreshRate;
+            refreshRate = std::max(refreshRate, layerRefreshRate);
         }
         isHDR |= layerInfo->getHDRContent();
     }
+    if (newRefreshRate == 0.f) {
+        newRefreshRate = fallbackRefreshRate;
+    }
     if (mTraceEnabled) {
         ALOGD("LayerHistory DesiredRefreshRate: %.2f", newRefreshRate);
     }
 
+    mDesiredRefreshRate = newRefreshRate;
     return {newRefreshRate, isHDR};
 }
 
@@ -175,6 +209,20 @@ void LayerHistory::removeIrrelevantLayers() {
     }
 }
 
+void LayerHistory::dump(std::string& result) const {
+    std::lock_guard lock(mLock);
+    StringAppendF(&result, "Layer history: desired %.2f fps\n", mDesiredRefreshRate);
+    for (const auto& [layerId, layerInfo] : mActiveLayerInfos) {
+        const auto area = layerInfo->getVisibleArea();
+        StringAppendF(&result, "    %s: %.2f fps, cadence %zu, area %s, %s\n",
+                      layerInfo->getName().c_str(), layerInfo->getReportedRefreshRate(),
+                      layerInfo->getCadence(),
+                      area ? std::to_string(*area).c_str() : "unknown",
+                      layerInfo->isRecentlyActive() ? "active" : "not yet relevant");
+    }
+    result.append("\n");
+}
+
 void LayerHistory::clearHistory() {
     std::lock_guard lock(mLock);
 
@@ -60,11 +60,18 @@ public:
     void insert(const std::unique_ptr<LayerHandle>& layerHandle, nsecs_t presentTime, bool isHdr);
     // Method for setting layer visibility
     void setVisibility(const std::unique_ptr<LayerHandle>& layerHandle, bool visible);
+    // Method for setting how much of the screen the layer covers, which
+    // weighs its vote
+    void setVisibleArea(const std::unique_ptr<LayerHandle>& layerHandle, int64_t area);
 
     // Returns the desired refresh rate, which is a max refresh rate of all the current
-    // layers. See go/content-fps-detection-in-scheduler for more information.
+    // layers. Layers much smaller than the largest one only count when no
+    // larger layer has a say.
     std::pair<float, bool> getDesiredRefreshRateAndHDR();
 
+    // Debugging - Dumps what the last decision was made from
+    void dump(std::string& result) const;
+
     // Clears all layer history.
     void clearHistory();
 
@@ -76,10 +83,17 @@ private:
     void removeIrrelevantLayers() REQUIRES(mLock);
 
     // Information about currently active layers.
-    std::mutex mLock;
+    mutable std::mutex mLock;
     std::unordered_map<int64_t, std::shared_ptr<LayerInfo>> mActiveLayerInfos GUARDED_BY(mLock);
     std::unordered_map<int64_t, std::shared_ptr<LayerInfo>> mInactiveLayerInfos GUARDED_BY(mLock);
 
+    // The result of the last getDesiredRefreshRateAndHDR()
+    float mDesiredRefreshRate GUARDED_BY(mLock) = 0.f;
+
+    // Fraction of the largest layer's area below which a layer's vote is
+    // only a fallback
+    static constexpr float MIN_VOTE_WEIGHT = 0.1f;
+
     // Each layer has it's own ID. This variable keeps track of the count.
     static std::atomic<int64_t> sNextId;
 
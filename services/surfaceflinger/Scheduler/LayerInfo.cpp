@@ -49,9 +49,31 @@ void LayerInfo::setLastPresentTime(nsecs_t lastPresentTime) {
     mLastPresentTime = lastPresentTime;
     // Ignore time diff that are too high - those are stale values
     if (timeDiff > OBSOLETE_TIME_EPSILON_NS.count()) return;
-    const nsecs_t refreshDuration = std::max(timeDiff, mMinRefreshDuration);
-    const int fps = 1e9f / refreshDuration;
-    mRefreshRateHistory.insertRefreshRate(fps);
+    mRefreshRateHistory.insertFrameDuration(timeDiff);
+}
+
+float LayerInfo::getDesiredRefreshRate() {
+    std::lock_guard lock(mLock);
+
+    if (mPresentTimeHistory.isLowActivityLayer()) {
+        return 1e9f / mLowActivityRefreshDuration;
+    }
+
+    const float refreshRate = mRefreshRateHistory.getRefreshRateAvg();
+    mCadence = mRefreshRateHistory.getCadence();
+    if (mReportedRefreshRate == 0.f) {
+        mReportedRefreshRate = refreshRate;
+        return mReportedRefreshRate;
+    }
+
+    const float hysteresis = mCadence > 0 ? PERIODIC_HYSTERESIS : APERIODIC_HYSTERESIS;
+    if (std::abs(refreshRate - mReportedRefreshRate) <= mReportedRefreshRate * hysteresis) {
+        mRefreshRateChangeCount = 0;
+    } else if (++mRefreshRateChangeCount >= HYSTERESIS_CALLS) {
+        mReportedRefreshRate = refreshRate;
+        mRefreshRateChangeCount = 0;
+    }
+    return mReportedRefreshRate;
 }
 
 } // namespace scheduler
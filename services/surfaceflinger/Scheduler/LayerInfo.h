@@ -16,11 +16,14 @@
 
 #pragma once
 
+#include <algorithm>
 #include <cinttypes>
+#include <cmath>
 #include <cstdint>
 #include <deque>
 #include <mutex>
 #include <numeric>
+#include <optional>
 #include <string>
 
 #include <log/log.h>
@@ -38,27 +41,50 @@ namespace scheduler {
  */
 class LayerInfo {
     /**
-     * Struct that keeps the information about the refresh rate for last
-     * HISTORY_SIZE frames. This is used to better determine the refresh rate
-     * for individual layers.
+     * Struct that keeps the time between the last HISTORY_SIZE frames. This is
+     * used to better determine the refresh rate for individual layers, and
+     * whether their frames come at a regular cadence.
      */
     class RefreshRateHistory {
     public:
         explicit RefreshRateHistory(nsecs_t minRefreshDuration)
               : mMinRefreshDuration(minRefreshDuration) {}
-        void insertRefreshRate(int refreshRate) {
-            mElements.push_back(refreshRate);
+        void insertFrameDuration(nsecs_t frameDuration) {
+            mElements.push_back(std::max(frameDuration, mMinRefreshDuration));
             if (mElements.size() > HISTORY_SIZE) {
                 mElements.pop_front();
             }
         }
 
+        // Averaging durations rather than rates, content alternating between
+        // two frame durations (e.g. 24fps on 60Hz) comes out at its real rate.
         float getRefreshRateAvg() const {
             if (mElements.empty()) {
                 return 1e9f / mMinRefreshDuration;
             }
 
-            return scheduler::calculate_mean(mElements);
+            return 1e9f / scheduler::calculate_mean(mElements);
+        }
+
+        // Returns the number of frames after which frame durations repeat, or
+        // 0 if they don't repeat at all.
+        size_t getCadence() const {
+            for (size_t cadence = 1; cadence <= MAX_CADENCE; cadence++) {
+                if (mElements.size() < cadence + PERIODIC_MIN_FRAMES) {
+                    break;
+                }
+                size_t repeats = 0;
+                for (size_t i = cadence; i < mElements.size(); i++) {
+                    if (std::abs(mElements[i] - mElements[i - cadence]) <=
+                        CADENCE_TOLERANCE.count()) {
+                        repeats++;
+                    }
+                }
+                if (repeats >= (mElements.size() - cadence) * PERIODIC_RATIO) {
+                    return cadence;
+                }
+            }
+            return 0;
         }
 
         void clearHistory() { mElements.clear(); }
@@ -66,6 +92,12 @@ class LayerInfo {
     private:
         std::deque<nsecs_t> mElements;
         static constexpr size_t HISTORY_SIZE = 30;
+        // 3:2 pulldown, the most common irregular one, alternates between
+        // two durations
+        static constexpr size_t MAX_CADENCE = 2;
+        static constexpr size_t PERIODIC_MIN_FRAMES = 6;
+        static constexpr float PERIODIC_RATIO = 0.8f;
+        static constexpr std::chrono::nanoseconds CADENCE_TOLERANCE = 2ms;
         const nsecs_t mMinRefreshDuration;
     };
 
@@ -156,20 +188,39 @@ public:
         mIsVisible = visible;
     }
 
+    void setVisibleArea(int64_t area) {
+        std::lock_guard lock(mLock);
+        mVisibleArea = area;
+    }
+
+    // How much of the screen the layer covers, if known.
+    std::optional<int64_t> getVisibleArea() const {
+        std::lock_guard lock(mLock);
+        return mVisibleArea;
+    }
+
     // Checks the present time history to see whether the layer is relevant.
     bool isRecentlyActive() const {
         std::lock_guard lock(mLock);
         return mPresentTimeHistory.isRelevant();
     }
 
-    // Calculate the average refresh rate.
-    float getDesiredRefreshRate() const {
+    // Calculate the average refresh rate. Once a rate has been reported, it
+    // only changes when the average moves away from it for a few calls in a
+    // row, farther so for content without a regular cadence.
+    float getDesiredRefreshRate();
+
+    // What the last getDesiredRefreshRate() returned for regular activity
+    float getReportedRefreshRate() const {
         std::lock_guard lock(mLock);
+        return mReportedRefreshRate;
+    }
 
-        if (mPresentTimeHistory.isLowActivityLayer()) {
-            return 1e9f / mLowActivityRefreshDuration;
-        }
-        return mRefreshRateHistory.getRefreshRateAvg();
+    // The cadence the last getDesiredRefreshRate() found, see
+    // RefreshRateHistory::getCadence().
+    size_t getCadence() const {
+        std::lock_guard lock(mLock);
+        return mCadence;
     }
 
     bool getHDRContent() {
@@ -195,6 +246,9 @@ public:
         std::lock_guard lock(mLock);
         mRefreshRateHistory.clearHistory();
         mPresentTimeHistory.clearHistory();
+        mReportedRefreshRate = 0.f;
+        mRefreshRateChangeCount = 0;
+        mCadence = 0;
     }
 
 private:
@@ -208,6 +262,16 @@ private:
     PresentTimeHistory mPresentTimeHistory GUARDED_BY(mLock);
     bool mIsHDR GUARDED_BY(mLock) = false;
     bool mIsVisible GUARDED_BY(mLock) = false;
+    std::optional<int64_t> mVisibleArea GUARDED_BY(mLock);
+    float mReportedRefreshRate GUARDED_BY(mLock) = 0.f;
+    size_t mRefreshRateChangeCount GUARDED_BY(mLock) = 0;
+    size_t mCadence GUARDED_BY(mLock) = 0;
+
+    // How far the average may move away from the reported rate, relative to
+    // it, before the latter follows
+    static constexpr float PERIODIC_HYSTERESIS = 0.05f;
+    static constexpr float APERIODIC_HYSTERESIS = 0.15f;
+    static constexpr size_t HYSTERESIS_CALLS = 3;
 };
 
 } // namespace scheduler
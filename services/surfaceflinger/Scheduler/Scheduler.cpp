@@ -122,10 +122,22 @@ Scheduler::Scheduler(impl::EventControlThread::SetVSyncEnabledFunction function,
                                                        });
         mDisplayPowerTimer->start();
     }
+
+    property_get("debug.sf.set_deep_idle_timer_ms", value, "0");
+    mSetDeepIdleTimerMs = atoi(value);
+    if (mSetDeepIdleTimerMs > 0) {
+        mDeepIdleTimer =
+                std::make_unique<scheduler::IdleTimer>(std::chrono::milliseconds(
+                                                               mSetDeepIdleTimerMs),
+                                                       [this] { resetDeepIdleTimerCallback(); },
+                                                       [this] { expiredDeepIdleTimerCallback(); });
+        mDeepIdleTimer->start();
+    }
 }
 
 Scheduler::~Scheduler() {
     // Ensure the IdleTimer thread is joined before we start destroying state.
+    mDeepIdleTimer.reset();
     mDisplayPowerTimer.reset();
     mTouchTimer.reset();
     mIdleTimer.reset();
@@ -215,6 +227,14 @@ void Scheduler::setPhaseOffset(const sp<Scheduler::ConnectionHandle>& handle, ns
     mConnections[handle->id]->thread->setPhaseOffset(phaseOffset);
 }
 
+void Scheduler::setWorkBudget(const sp<Scheduler::ConnectionHandle>& handle, nsecs_t workBudget) {
+    RETURN_IF_INVALID();
+    if (workBudget <= 0) {
+        workBudget += mPrimaryDispSync->getPeriod();
+    }
+    mConnections[handle->id]->thread->setWorkBudget(workBudget);
+}
+
 void Scheduler::getDisplayStatInfo(DisplayStatInfo* stats) {
     stats->vsyncTime = mPrimaryDispSync->computeNextRefresh(0);
     stats->vsyncPeriod = mPrimaryDispSync->getPeriod();
@@ -267,8 +287,13 @@ void Scheduler::resync() {
     const nsecs_t last = mLastResyncTime.exchange(now);
 
     if (now - last > kIgnoreDelay) {
-        resyncToHardwareVsync(false,
-                              mRefreshRateConfigs.getCurrentRefreshRate().second.vsyncPeriod);
+        const nsecs_t period = mRefreshRateConfigs.getCurrentRefreshRate().second.vsyncPeriod;
+        // A confident model keeps predicting on its own, present fences still
+        // get it resynced if it drifts
+        if (mPrimaryDispSync->isModelConfident(period)) {
+            return;
+        }
+        resyncToHardwareVsync(false, period);
     }
 }
 
@@ -324,6 +349,10 @@ void Scheduler::dumpPrimaryDispSync(std::string& result) const {
     mPrimaryDispSync->dump(result);
 }
 
+void Scheduler::dumpLayerHistory(std::string& result) const {
+    mLayerHistory.dump(result);
+}
+
 std::unique_ptr<scheduler::LayerHistory::LayerHandle> Scheduler::registerLayer(
         std::string const& name, int windowType) {
     uint32_t defaultFps, performanceFps;
@@ -353,6 +382,11 @@ void Scheduler::setLayerVisibility(
     mLayerHistory.setVisibility(layerHandle, visible);
 }
 
+void Scheduler::setLayerVisibleArea(
+        const std::unique_ptr<scheduler::LayerHistory::LayerHandle>& layerHandle, int64_t area) {
+    mLayerHistory.setVisibleArea(layerHandle, area);
+}
+
 void Scheduler::withPrimaryDispSync(std::function<void(DispSync&)> const& fn) {
     fn(*mPrimaryDispSync);
 }
@@ -390,6 +424,11 @@ void Scheduler::setChangeRefreshRateCallback(
     mChangeRefreshRateCallback = changeRefreshRateCallback;
 }
 
+void Scheduler::setDeepIdleCallback(const DeepIdleCallback&& deepIdleCallback) {
+    std::lock_guard<std::mutex> lock(mCallbackLock);
+    mDeepIdleCallback = deepIdleCallback;
+}
+
 void Scheduler::updateFrameSkipping(const int64_t skipCount) {
     ATRACE_INT("FrameSkipCount", skipCount);
     if (mSkipCount != skipCount) {
@@ -403,6 +442,9 @@ void Scheduler::resetIdleTimer() {
     if (mIdleTimer) {
         mIdleTimer->reset();
     }
+    if (mDeepIdleTimer) {
+        mDeepIdleTimer->reset();
+    }
 }
 
 void Scheduler::notifyTouchEvent() {
@@ -410,6 +452,10 @@ void Scheduler::notifyTouchEvent() {
         mTouchTimer->reset();
     }
 
+    if (mDeepIdleTimer) {
+        mDeepIdleTimer->reset();
+    }
+
     if (mSupportKernelTimer) {
         resetIdleTimer();
     }
@@ -475,6 +521,43 @@ void Scheduler::expiredDisplayPowerTimerCallback() {
     ATRACE_INT("ExpiredDisplayPowerTimer", 1);
 }
 
+void Scheduler::resetDeepIdleTimerCallback() {
+    setDeepIdle(false);
+}
+
+void Scheduler::expiredDeepIdleTimerCallback() {
+    setDeepIdle(true);
+}
+
+void Scheduler::setDeepIdle(bool idle) {
+    std::lock_guard<std::mutex> lock(mCallbackLock);
+    if (mDeepIdle == idle) {
+        return;
+    }
+    mDeepIdle = idle;
+    ATRACE_INT("DeepIdle", idle);
+
+    // Explicit requests for the next vsync, such as those of SurfaceFlinger itself, are still
+    // served, so the first frame out of idle is not held back.
+    for (const auto& [id, connection] : mConnections) {
+        connection->thread->setParked(idle);
+    }
+
+    if (idle) {
+        disableHardwareVsync(false);
+    } else {
+        // DispSync kept predicting meanwhile, resync it unless it is still confident
+        const nsecs_t period = mRefreshRateConfigs.getCurrentRefreshRate().second.vsyncPeriod;
+        if (!mPrimaryDispSync->isModelConfident(period)) {
+            resyncToHardwareVsync(false, period);
+        }
+    }
+
+    if (mDeepIdleCallback) {
+        mDeepIdleCallback(idle);
+    }
+}
+
 void Scheduler::expiredKernelTimerCallback() {
     ATRACE_INT("ExpiredKernelIdleTimer", 1);
     const auto refreshRate = mRefreshRateConfigs.getCurrentRefreshRate();
@@ -490,6 +573,7 @@ std::string Scheduler::doDump() {
     std::ostringstream stream;
     stream << "+  Idle timer interval: " << mSetIdleTimerMs << " ms" << std::endl;
     stream << "+  Touch timer interval: " << mSetTouchTimerMs << " ms" << std::endl;
+    stream << "+  Deep idle timer interval: " << mSetDeepIdleTimerMs << " ms" << std::endl;
     return stream.str();
 }
 
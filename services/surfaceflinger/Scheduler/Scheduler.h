@@ -50,6 +50,7 @@ public:
 
     using RefreshRateType = scheduler::RefreshRateConfigs::RefreshRateType;
     using ChangeRefreshRateCallback = std::function<void(RefreshRateType, ConfigEvent)>;
+    using DeepIdleCallback = std::function<void(bool idle)>;
 
     // Enum to indicate whether to start the transaction early, or at vsync time.
     enum class TransactionStart { EARLY, NORMAL };
@@ -120,6 +121,10 @@ public:
     // Offers ability to modify phase offset in the event thread.
     void setPhaseOffset(const sp<ConnectionHandle>& handle, nsecs_t phaseOffset);
 
+    // Sets how long after the connection's VSYNC events the frames produced for them are
+    // latched. A budget <= 0 means they are latched after the next vsync instead.
+    void setWorkBudget(const sp<ConnectionHandle>& handle, nsecs_t workBudget);
+
     void getDisplayStatInfo(DisplayStatInfo* stats);
 
     void enableHardwareVsync();
@@ -149,15 +154,21 @@ public:
     // Stores visibility for a layer.
     void setLayerVisibility(
             const std::unique_ptr<scheduler::LayerHistory::LayerHandle>& layerHandle, bool visible);
+    // Stores how much of the screen the layer covers, which weighs its vote.
+    void setLayerVisibleArea(
+            const std::unique_ptr<scheduler::LayerHistory::LayerHandle>& layerHandle,
+            int64_t area);
     // Updates FPS based on the most content presented.
     void updateFpsBasedOnContent();
     // Callback that gets invoked when Scheduler wants to change the refresh rate.
     void setChangeRefreshRateCallback(const ChangeRefreshRateCallback&& changeRefreshRateCallback);
+    // Callback that gets invoked when the screen enters or leaves deep idle.
+    void setDeepIdleCallback(const DeepIdleCallback&& deepIdleCallback);
 
     // Returns whether idle timer is enabled or not
     bool isIdleTimerEnabled() { return mSetIdleTimerMs > 0; }
 
-    // Function that resets the idle timer.
+    // Function that resets the idle timers, which also brings the screen out of deep idle.
     void resetIdleTimer();
 
     // Function that resets the touch timer.
@@ -171,6 +182,7 @@ public:
 
     // calls DispSync::dump() on primary disp sync
     void dumpPrimaryDispSync(std::string& result) const;
+    void dumpLayerHistory(std::string& result) const;
 
     // Get the appropriate refresh type for current conditions.
     RefreshRateType getPreferredRefreshRateType();
@@ -218,6 +230,12 @@ private:
     void resetDisplayPowerTimerCallback();
     // Function that is called when the display power timer expires.
     void expiredDisplayPowerTimerCallback();
+    // Function that is called when the deep idle timer resets.
+    void resetDeepIdleTimerCallback();
+    // Function that is called when the deep idle timer expires.
+    void expiredDeepIdleTimerCallback();
+    // Parks the periodic VSYNC requests and hardware VSYNC while idle, and resumes them.
+    void setDeepIdle(bool idle);
     // Sets vsync period.
     void setVsyncPeriod(const nsecs_t period);
     // handles various timer features to change the refresh rate.
@@ -283,8 +301,15 @@ private:
     int64_t mSetDisplayPowerTimerMs = 0;
     std::unique_ptr<scheduler::IdleTimer> mDisplayPowerTimer;
 
+    // Timer after which a static screen goes into deep idle. Set this variable to >0 to use
+    // this feature.
+    int64_t mSetDeepIdleTimerMs = 0;
+    std::unique_ptr<scheduler::IdleTimer> mDeepIdleTimer;
+
     std::mutex mCallbackLock;
     ChangeRefreshRateCallback mChangeRefreshRateCallback GUARDED_BY(mCallbackLock);
+    DeepIdleCallback mDeepIdleCallback GUARDED_BY(mCallbackLock);
+    bool mDeepIdle GUARDED_BY(mCallbackLock) = false;
 
     // In order to make sure that the features don't override themselves, we need a state machine
     // to keep track which feature requested the config change.
@@ -100,6 +100,14 @@ void VSyncModulator::onRefreshed(bool usedRenderEngine) {
     }
 }
 
+void VSyncModulator::onFrameMissPredicted() {
+    const bool updateOffsetsNeeded = mRemainingRenderEngineUsageCount == 0;
+    mRemainingRenderEngineUsageCount = MIN_EARLY_GL_FRAME_COUNT_TRANSACTION;
+    if (updateOffsetsNeeded) {
+        updateOffsets();
+    }
+}
+
 VSyncModulator::Offsets VSyncModulator::getOffsets() {
     std::lock_guard<std::mutex> lock(mMutex);
     return mOffsets;
@@ -136,6 +144,8 @@ void VSyncModulator::updateOffsetsLocked() {
 
     if (mAppConnectionHandle != nullptr) {
         mScheduler->setPhaseOffset(mAppConnectionHandle, desired.app);
+        // App frames are due when SF wakes up to latch them
+        mScheduler->setWorkBudget(mAppConnectionHandle, desired.sf - desired.app);
     }
 
     flushOffsets();
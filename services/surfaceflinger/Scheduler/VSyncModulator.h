@@ -97,6 +97,10 @@ public:
     // frame.
     void onRefreshed(bool usedRenderEngine);
 
+    // Called when the frame SF is starting is predicted to miss its deadline, so that we
+    // move into early GL offsets: the next frames need to start earlier.
+    void onFrameMissPredicted();
+
     // Returns the offsets that we are currently using
     Offsets getOffsets() EXCLUDES(mMutex);
 
@@ -26,6 +26,8 @@
 #include <cmath>
 #include <cstdint>
 #include <functional>
+#include <future>
+#include <limits>
 #include <mutex>
 #include <optional>
 #include <unordered_map>
@@ -36,6 +38,7 @@
 #include <binder/IPCThreadState.h>
 #include <binder/IServiceManager.h>
 #include <binder/PermissionCache.h>
+#include <binder/TransactionStats.h>
 
 #include <compositionengine/CompositionEngine.h>
 #include <compositionengine/Display.h>
@@ -372,6 +375,10 @@ SurfaceFlinger::SurfaceFlinger(Factory& factory) : SurfaceFlinger(factory, SkipI
     mUseHwcVirtualDisplays = atoi(value);
     ALOGI_IF(mUseHwcVirtualDisplays, "Enabling HWC virtual displays");
 
+    property_get("debug.sf.enable_hwc_vds_for_encoder", value, "1");
+    mUseHwcVirtualDisplaysForEncoder = atoi(value);
+    ALOGI_IF(mUseHwcVirtualDisplaysForEncoder, "Enabling HWC virtual displays for video encoders");
+
     property_get("ro.sf.disable_triple_buffer", value, "0");
     mLayerTripleBufferingDisabled = atoi(value);
     ALOGI_IF(mLayerTripleBufferingDisabled, "Disabling Triple Buffering");
@@ -380,6 +387,19 @@ SurfaceFlinger::SurfaceFlinger(Factory& factory) : SurfaceFlinger(factory, SkipI
     auto listSize = property_get_int32("debug.sf.max_igbp_list_size", int32_t(defaultListSize));
     mMaxGraphicBufferProducerListSize = (listSize > 0) ? size_t(listSize) : defaultListSize;
 
+    // All the HWC cache slots but the one the Flattener uses
+    const int32_t maxHwcSlots = compositionengine::impl::HwcBufferCache::SLOT_COUNT - 1;
+    mBufferStateLayerHwcSlots = uint32_t(
+            std::clamp(property_get_int32("debug.sf.buffer_state_layer_hwc_slots", maxHwcSlots),
+                       1, maxHwcSlots));
+
+    mLayerReclaimTimeout =
+            ms2ns(nsecs_t(property_get_int32("debug.sf.layer_reclaim_timeout_ms", 10000)));
+
+    const auto clientCacheMaxMb = property_get_int32("debug.sf.client_cache_max_mb",
+                                                     BUFFER_CACHE_DEFAULT_MAX_BYTES >> 20);
+    ClientCache::getInstance().setMaxBytes(size_t(std::max(clientCacheMaxMb, 0)) << 20);
+
     mUseSmart90ForVideo = use_smart_90_for_video(false);
     property_get("debug.sf.use_smart_90_for_video", value, "0");
 
@@ -391,6 +411,23 @@ SurfaceFlinger::SurfaceFlinger(Factory& factory) : SurfaceFlinger(factory, SkipI
     property_get("debug.sf.luma_sampling", value, "1");
     mLumaSampling = atoi(value);
 
+    property_get("debug.sf.enable_layer_caching", value, "0");
+    mLayerCachingEnabled = atoi(value);
+    ALOGI_IF(mLayerCachingEnabled, "Enabling layer caching");
+
+    // Buffers freed here are reused by the next allocation of the same kind for
+    // the same requestor, and all given back once no frame has been composed
+    // for a while.
+    property_get("debug.sf.gralloc_pool_size", value, "0");
+    const int grallocPoolSize = atoi(value);
+    if (grallocPoolSize > 0) {
+        GraphicBufferAllocator::get().setPoolCapacity(size_t(grallocPoolSize));
+        mGrallocPoolIdleTimer = std::make_unique<scheduler::IdleTimer>(
+                std::chrono::milliseconds(ns2ms(GraphicBufferAllocator::kPoolTimeout)), nullptr,
+                [] { GraphicBufferAllocator::get().releasePooledBuffers(); });
+        mGrallocPoolIdleTimer->start();
+    }
+
     const auto [early, gl, late] = mPhaseOffsets->getCurrentOffsets();
     mVsyncModulator.setPhaseOffsets(early, gl, late,
                                     mPhaseOffsets->getOffsetThresholdForNextVsync());
@@ -589,26 +626,31 @@ void SurfaceFlinger::bootFinished()
 }
 
 uint32_t SurfaceFlinger::getNewTexture() {
-    {
-        std::lock_guard lock(mTexturePoolMutex);
-        if (!mTexturePool.empty()) {
-            uint32_t name = mTexturePool.back();
-            mTexturePool.pop_back();
-            ATRACE_INT("TexturePoolSize", mTexturePool.size());
-            return name;
-        }
-
-        // The pool was too small, so increase it for the future
-        ++mTexturePoolSize;
+    uint32_t name = getPooledTexture();
+    if (name != 0) {
+        return name;
     }
 
     // The pool was empty, so we need to get a new texture name directly using a
     // blocking call to the main thread
-    uint32_t name = 0;
     postMessageSync(new LambdaMessage([&]() { getRenderEngine().genTextures(1, &name); }));
     return name;
 }
 
+uint32_t SurfaceFlinger::getPooledTexture() {
+    std::lock_guard lock(mTexturePoolMutex);
+    if (!mTexturePool.empty()) {
+        uint32_t name = mTexturePool.back();
+        mTexturePool.pop_back();
+        ATRACE_INT("TexturePoolSize", mTexturePool.size());
+        return name;
+    }
+
+    // The pool was too small, so increase it for the future
+    ++mTexturePoolSize;
+    return 0;
+}
+
 void SurfaceFlinger::deleteTextureAsync(uint32_t texture) {
     std::lock_guard lock(mTexturePoolMutex);
     // We don't change the pool size, so the fix-up logic in postComposition will decide whether
@@ -627,6 +669,24 @@ void SurfaceFlinger::init() {
 
     Mutex::Autolock _l(mStateLock);
 
+    const nsecs_t initStart = systemTime();
+    auto recordInitStage = [&](const char* name, nsecs_t start, nsecs_t end)
+            REQUIRES(mStateLock) { mInitStages.push_back({name, start - initStart, end - start}); };
+
+    // Connecting to the composer HAL mostly waits for its service to come up,
+    // so it is done on a thread of its own while RenderEngine is set up and
+    // primed here, as the EGL context is the main thread's. Processing the
+    // hotplugs needs both.
+    LOG_ALWAYS_FATAL_IF(mVrFlingerRequestsDisplay,
+            "Starting with vr flinger active is not currently supported.");
+    auto hwComposer = std::async(std::launch::async, [&] {
+        const nsecs_t start = systemTime();
+        auto hwc = getFactory().createHWComposer(getBE().mHwcServiceName);
+        return std::make_tuple(std::move(hwc), start, systemTime());
+    });
+
+    nsecs_t start = systemTime();
+
     // Get a RenderEngine for the given display / config (can't fail)
     int32_t renderEngineFeature = 0;
     renderEngineFeature |= (useColorManagement ?
@@ -642,13 +702,21 @@ void SurfaceFlinger::init() {
     mCompositionEngine->setRenderEngine(
             renderengine::RenderEngine::create(static_cast<int32_t>(defaultCompositionPixelFormat),
                                                renderEngineFeature, maxFrameBufferAcquiredBuffers));
+    recordInitStage("RenderEngine", start, systemTime());
 
-    LOG_ALWAYS_FATAL_IF(mVrFlingerRequestsDisplay,
-            "Starting with vr flinger active is not currently supported.");
-    mCompositionEngine->setHwComposer(getFactory().createHWComposer(getBE().mHwcServiceName));
+    start = systemTime();
+    getRenderEngine().primeCache();
+    recordInitStage("PrimeCache", start, systemTime());
+
+    auto [hwc, hwcStart, hwcEnd] = hwComposer.get();
+    recordInitStage("HWComposer", hwcStart, hwcEnd);
+    mCompositionEngine->setHwComposer(std::move(hwc));
+
+    start = systemTime();
     mCompositionEngine->getHwComposer().registerCallback(this, getBE().mComposerSequenceId);
     // Process any initial hotplug and resulting display changes.
     processDisplayHotplugEventsLocked();
+    recordInitStage("Hotplug", start, systemTime());
     const auto display = getDefaultDisplayDeviceLocked();
     LOG_ALWAYS_FATAL_IF(!display, "Missing internal display after registering composer callback.");
     LOG_ALWAYS_FATAL_IF(!getHwComposer().isConnected(*display->getId()),
@@ -684,8 +752,6 @@ void SurfaceFlinger::init() {
     // set initial conditions (e.g. unblank default device)
     initializeDisplays();
 
-    getRenderEngine().primeCache();
-
     // Inform native graphics APIs whether the present timestamp is supported:
 
     const bool presentFenceReliable =
@@ -696,6 +762,7 @@ void SurfaceFlinger::init() {
         ALOGE("Run StartPropertySetThread failed!");
     }
 
+    recordInitStage("Total", initStart, systemTime());
     ALOGV("Done initializing");
 }
 
@@ -1634,6 +1701,7 @@ bool SurfaceFlinger::previousFrameMissed(int graceTimeMs) NO_THREAD_SAFETY_ANALY
     }
 
     if (graceTimeMs > 0 && fence->getStatus() == Fence::Status::Unsignaled) {
+        mFrameBlockingWaitCount++;
         fence->wait(graceTimeMs);
     }
 
@@ -1659,6 +1727,7 @@ void SurfaceFlinger::onMessageReceived(int32_t what) NO_THREAD_SAFETY_ANALYSIS {
             // value throughout this frame to make sure all layers are
             // seeing this same value.
             populateExpectedPresentTime();
+            const nsecs_t frameStart = systemTime();
 
             // When Backpressure propagation is enabled we want to give a small grace period
             // for the present fence to fire instead of just giving up on this frame to handle cases
@@ -1687,6 +1756,18 @@ void SurfaceFlinger::onMessageReceived(int32_t what) NO_THREAD_SAFETY_ANALYSIS {
                 mGpuFrameMissedCount++;
             }
 
+            // Composition takes about as long as it did for recent frames, if that is past the
+            // deadline SF needs to wake up earlier for the next frames.
+            const bool frameMissPredicted =
+                    mFrameDeadlinePredictor.willMissDeadline(frameStart, mExpectedPresentTime,
+                                                             mHadClientComposition);
+            ATRACE_INT("PredictedFrameMissed", static_cast<int>(frameMissPredicted));
+            if (frameMissPredicted) {
+                mPredictedFrameMissedCount++;
+                mTimeStats->incrementPredictedMissedFrames();
+                mVsyncModulator.onFrameMissPredicted();
+            }
+
             if (mUseSmart90ForVideo) {
                 // This call is made each time SF wakes up and creates a new frame. It is part
                 // of video detection feature.
@@ -1710,8 +1791,14 @@ void SurfaceFlinger::onMessageReceived(int32_t what) NO_THREAD_SAFETY_ANALYSIS {
             // potentially trigger a display handoff.
             updateVrFlinger();
 
+            const nsecs_t transactionStart = systemTime();
             bool refreshNeeded = handleMessageTransaction();
+            const nsecs_t latchStart = systemTime();
             refreshNeeded |= handleMessageInvalidate();
+            mTransactionApplyDuration = latchStart - transactionStart;
+            mLatchDuration = systemTime() - latchStart;
+            mFrameProfiler.record(FrameProfiler::Stage::Transaction, mTransactionApplyDuration);
+            mFrameProfiler.record(FrameProfiler::Stage::PageFlip, mLatchDuration);
 
             updateCursorAsync();
             updateInputFlinger();
@@ -1721,6 +1808,7 @@ void SurfaceFlinger::onMessageReceived(int32_t what) NO_THREAD_SAFETY_ANALYSIS {
                 // Signal a refresh if a transaction modified the window state,
                 // a new buffer was latched, or if HWC has requested a full
                 // repaint
+                mFrameDeadlinePredictor.beginFrame(frameStart);
                 signalRefresh();
             }
             break;
@@ -1747,9 +1835,7 @@ bool SurfaceFlinger::handleMessageTransaction() {
         getTransactionFlags(eTransactionFlushNeeded);
     }
 
-    if (transactionFlushNeeded()) {
-        setTransactionFlags(eTransactionFlushNeeded);
-    }
+    scheduleTransactionFlush();
 
     return runHandleTransaction;
 }
@@ -1760,20 +1846,68 @@ void SurfaceFlinger::handleMessageRefresh() {
     mRefreshPending = false;
 
     const bool repaintEverything = mRepaintEverything.exchange(false);
-    preComposition();
-    rebuildLayerStacks();
-    calculateWorkingSet();
-    for (const auto& [token, display] : mDisplays) {
+    {
+        FrameProfiler::ScopedStage stage(mFrameProfiler, FrameProfiler::Stage::PreComposition);
+        preComposition();
+    }
+    {
+        FrameProfiler::ScopedStage stage(mFrameProfiler, FrameProfiler::Stage::RebuildLayerStacks);
+        rebuildLayerStacks();
+    }
+    {
+        FrameProfiler::ScopedStage stage(mFrameProfiler,
+                                         FrameProfiler::Stage::CalculateWorkingSet);
+        calculateWorkingSet();
+    }
+
+    // The present of each display is queued, to go to HWC along with the
+    // commands preparing the next display, so that each display takes one
+    // round trip to HWC. The presents still queued once the last display HWC
+    // knows of is composed are sent on their own.
+    const auto displays = getDisplaysInCompositionOrder();
+    const auto lastHwcDisplay =
+            std::find_if(displays.rbegin(), displays.rend(),
+                         [](const auto& display) { return display->getId().has_value(); });
+    struct StageDurations {
+        nsecs_t compositionStrategy = 0;
+        nsecs_t renderEngine = 0;
+    };
+    std::vector<StageDurations> stageDurations(displays.size());
+    nsecs_t hwcPresentDuration = 0;
+    const nsecs_t compositionStart = systemTime();
+    for (size_t i = 0; i < displays.size(); i++) {
+        const auto& display = displays[i];
         beginFrame(display);
+        const nsecs_t prepareStart = systemTime();
         prepareFrame(display);
+        stageDurations[i].compositionStrategy = systemTime() - prepareStart;
         doDebugFlashRegions(display, repaintEverything);
-        doComposition(display, repaintEverything);
-    }
+        doComposition(display, repaintEverything, &stageDurations[i].renderEngine);
+        if (lastHwcDisplay != displays.rend() && display == *lastHwcDisplay) {
+            const nsecs_t presentStart = systemTime();
+            getHwComposer().presentQueuedDisplays();
+            hwcPresentDuration = systemTime() - presentStart;
+        }
+    }
+    const nsecs_t postCompositionStart = systemTime();
+    mFrameProfiler.record(FrameProfiler::Stage::Composition,
+                          postCompositionStart - compositionStart);
+    for (size_t i = 0; i < displays.size(); i++) {
+        const nsecs_t presentedStart = systemTime();
+        onDisplayPresented(displays[i]);
+        const nsecs_t presentTime = systemTime();
+        recordFrameStages(displays[i], stageDurations[i].compositionStrategy,
+                          stageDurations[i].renderEngine,
+                          hwcPresentDuration + presentTime - presentedStart, presentTime);
+    }
+    const nsecs_t frameEnd = systemTime();
 
     logLayerStats();
 
     postFrame();
     postComposition();
+    mFrameProfiler.record(FrameProfiler::Stage::PostComposition,
+                          systemTime() - postCompositionStart);
 
     mHadClientComposition = false;
     mHadDeviceComposition = false;
@@ -1787,11 +1921,47 @@ void SurfaceFlinger::handleMessageRefresh() {
     }
 
     mVsyncModulator.onRefreshed(mHadClientComposition);
+    mFrameDeadlinePredictor.endFrame(frameEnd, mHadClientComposition);
+
+    // Fences are passed on all the way to HWC and the virtual display sinks, so the main
+    // thread only blocks on one where the driver can't do without
+    const uint32_t renderEngineBlockingWaitCount = getRenderEngine().getBlockingWaitCount();
+    const uint32_t blockingWaitCount = mFrameBlockingWaitCount + renderEngineBlockingWaitCount -
+            mRenderEngineBlockingWaitCount;
+    mRenderEngineBlockingWaitCount = renderEngineBlockingWaitCount;
+    mFrameBlockingWaitCount = 0;
+    ATRACE_INT("BlockingFenceWaits", static_cast<int>(blockingWaitCount));
+    mBlockingWaitCount += blockingWaitCount;
 
     mLayersWithQueuedFrames.clear();
+
+    if (mGrallocPoolIdleTimer) {
+        mGrallocPoolIdleTimer->reset();
+    }
 }
 
 
+std::vector<sp<DisplayDevice>> SurfaceFlinger::getDisplaysInCompositionOrder() const {
+    // mDisplays is ordered by token address, which says nothing about which
+    // display matters most. Compose (and present) the primary display first
+    // so it never waits on client composition for the other displays, and
+    // virtual displays last since nothing is scanning them out.
+    auto rank = [](const sp<DisplayDevice>& display) {
+        return display->isPrimary() ? 0 : display->isVirtual() ? 2 : 1;
+    };
+
+    std::vector<sp<DisplayDevice>> displays;
+    displays.reserve(mDisplays.size());
+    for (const auto& [token, display] : mDisplays) {
+        displays.push_back(display);
+    }
+    std::stable_sort(displays.begin(), displays.end(),
+                     [&](const sp<DisplayDevice>& lhs, const sp<DisplayDevice>& rhs) {
+                         return rank(lhs) < rank(rhs);
+                     });
+    return displays;
+}
+
 bool SurfaceFlinger::handleMessageInvalidate() {
     ATRACE_CALL();
     bool refreshNeeded = handlePageFlip();
@@ -1819,6 +1989,23 @@ void SurfaceFlinger::calculateWorkingSet() {
     // build the h/w work list
     if (CC_UNLIKELY(mGeometryInvalid)) {
         mGeometryInvalid = false;
+
+        // Latch the display independent front-end state (geometry, buffer,
+        // color, flags) of each composition layer once for the frame, even
+        // when the layer is shown on several displays. Every output then
+        // reads this same snapshot instead of going back to the Layer.
+        std::unordered_set<const compositionengine::Layer*> latchedLayers;
+        for (const auto& [token, displayDevice] : mDisplays) {
+            auto display = displayDevice->getCompositionDisplay();
+            for (auto& layer : display->getOutputLayersOrderedByZ()) {
+                auto& compositionLayer = layer->getLayer();
+                if (latchedLayers.insert(&compositionLayer).second) {
+                    layer->getLayerFE().latchCompositionState(compositionLayer.editState().frontEnd,
+                                                              true);
+                }
+            }
+        }
+
         for (const auto& [token, displayDevice] : mDisplays) {
             auto display = displayDevice->getCompositionDisplay();
 
@@ -1834,12 +2021,6 @@ void SurfaceFlinger::calculateWorkingSet() {
                 // The output Z order is set here based on a simple counter.
                 compositionState.z = zOrder++;
 
-                // Update the display independent composition state. This goes
-                // to the general composition layer state structure.
-                // TODO: Do this once per compositionengine::CompositionLayer.
-                layer->getLayerFE().latchCompositionState(layer->getLayer().editState().frontEnd,
-                                                          true);
-
                 // Recalculate the geometry state of the output layer.
                 layer->updateCompositionState(true);
 
@@ -1859,7 +2040,7 @@ void SurfaceFlinger::calculateWorkingSet() {
         auto* profile = display->getDisplayColorProfile();
 
         if (mDrawingState.colorMatrixChanged) {
-            display->setColorTransform(mDrawingState.colorMatrix);
+            display->setColorTransform(mDrawingState.colorMatrix, mDrawingState.colorMatrixHint);
         }
         Dataspace targetDataspace = Dataspace::UNKNOWN;
         if (useColorManagement) {
@@ -1903,6 +2084,10 @@ void SurfaceFlinger::calculateWorkingSet() {
             layer->setPerFrameData(displayDevice, displayState.transform, displayState.viewport,
                                    displayDevice->getSupportedPerFrameMetadata(), targetDataspace);
         }
+
+        if (mLayerCachingEnabled) {
+            updateLayerCaching(displayDevice);
+        }
     }
 
     mDrawingState.colorMatrixChanged = false;
@@ -1917,6 +2102,115 @@ void SurfaceFlinger::calculateWorkingSet() {
     }
 }
 
+void SurfaceFlinger::updateLayerCaching(const sp<DisplayDevice>& displayDevice) {
+    ATRACE_CALL();
+
+    auto display = displayDevice->getCompositionDisplay();
+    const auto& outputLayers = display->getOutputLayersOrderedByZ();
+    auto& flattener = mLayerFlatteners[displayDevice->getDisplayToken()];
+
+    flattener.updateLayers(outputLayers);
+    if (flattener.needsRender()) {
+        // Until the buffer is ready, the run's layers are composited as usual
+        const auto buffer = takeLayerCacheBuffer(displayDevice);
+        if (buffer && !renderFlattenedLayers(displayDevice, flattener, *buffer)) {
+            flattener.abandonRun();
+        }
+    }
+    flattener.writeStateToHWC(outputLayers);
+}
+
+std::optional<sp<GraphicBuffer>> SurfaceFlinger::takeLayerCacheBuffer(
+        const sp<DisplayDevice>& displayDevice) {
+    // Every run gets a buffer of its own, so a run is never rendered into a buffer HWC may
+    // still be showing for the previous one.
+    auto& allocation = mLayerCacheAllocations[displayDevice->getDisplayToken()];
+    if (!allocation.valid()) {
+        const auto& size = displayDevice->getCompositionDisplay()->getRenderSurface()->getSize();
+        const uint32_t width = static_cast<uint32_t>(size.getWidth());
+        const uint32_t height = static_cast<uint32_t>(size.getHeight());
+        allocation = std::async(std::launch::async, [this, width, height] {
+            const uint32_t usage =
+                    GRALLOC_USAGE_HW_RENDER | GRALLOC_USAGE_HW_COMPOSER | GRALLOC_USAGE_HW_TEXTURE;
+            return getFactory().createGraphicBuffer(width, height, HAL_PIXEL_FORMAT_RGBA_8888, 1,
+                                                    usage, "LayerCache");
+        });
+        return std::nullopt;
+    }
+    if (allocation.wait_for(std::chrono::seconds(0)) != std::future_status::ready) {
+        return std::nullopt;
+    }
+    return allocation.get();
+}
+
+bool SurfaceFlinger::renderFlattenedLayers(const sp<DisplayDevice>& displayDevice,
+                                           compositionengine::impl::Flattener& flattener,
+                                           const sp<GraphicBuffer>& buffer) {
+    ATRACE_CALL();
+
+    auto display = displayDevice->getCompositionDisplay();
+    const auto& displayState = display->getState();
+    auto& renderEngine = getRenderEngine();
+
+    // The cached buffer is never protected
+    if (renderEngine.isProtected()) {
+        return false;
+    }
+
+    if (buffer == nullptr || buffer->initCheck() != NO_ERROR) {
+        ALOGW("Allocating the layer cache for display [%s] failed",
+              displayDevice->getDisplayName().c_str());
+        return false;
+    }
+    const auto& size = display->getRenderSurface()->getSize();
+    if (buffer->getWidth() != static_cast<uint32_t>(size.getWidth()) ||
+        buffer->getHeight() != static_cast<uint32_t>(size.getHeight())) {
+        // The display was resized while the buffer was being allocated
+        return false;
+    }
+
+    // Same as client composition, except that HWC still applies the color
+    // transform to the cached buffer as it would to its layers.
+    renderengine::DisplaySettings displaySettings;
+    displaySettings.physicalDisplay = displayState.scissor;
+    displaySettings.clip = displayState.scissor;
+    displaySettings.globalTransform = displayState.transform.asMatrix4();
+    displaySettings.orientation = displayState.orientation;
+    const auto* profile = display->getDisplayColorProfile();
+    displaySettings.outputDataspace =
+            profile->hasWideColorGamut() ? displayState.dataspace : Dataspace::UNKNOWN;
+    displaySettings.maxLuminance = profile->getHdrCapabilities().getDesiredMaxLuminance();
+
+    const DisplayRenderArea renderArea(displayDevice);
+    const Region viewportRegion(displayState.viewport);
+    const auto& visibleLayers = displayDevice->getVisibleLayersSortedByZ();
+    std::vector<renderengine::LayerSettings> layerSettings;
+    Region clearRegion;
+    for (size_t i = flattener.getRunStart();
+         i < flattener.getRunStart() + flattener.getRunSize(); i++) {
+        const auto& layer = visibleLayers[i];
+        const Region clip(viewportRegion.intersect(layer->visibleRegion));
+        renderengine::LayerSettings settings;
+        if (!clip.isEmpty() &&
+            layer->prepareClientLayer(renderArea, clip, clearRegion, false, settings)) {
+            layerSettings.push_back(settings);
+        }
+    }
+
+    base::unique_fd readyFence;
+    status_t result =
+            renderEngine.drawLayers(displaySettings, layerSettings, buffer->getNativeBuffer(),
+                                    /*useFramebufferCache=*/false, base::unique_fd(), &readyFence);
+    if (result != NO_ERROR) {
+        ALOGW("Rendering the layer cache for display [%s] failed: %d",
+              displayDevice->getDisplayName().c_str(), result);
+        return false;
+    }
+
+    flattener.setBuffer(buffer, new Fence(readyFence.release()), displayState.dataspace);
+    return true;
+}
+
 void SurfaceFlinger::doDebugFlashRegions(const sp<DisplayDevice>& displayDevice,
                                          bool repaintEverything) {
     auto display = displayDevice->getCompositionDisplay();
@@ -1932,7 +2226,7 @@ void SurfaceFlinger::doDebugFlashRegions(const sp<DisplayDevice>& displayDevice,
         if (!dirtyRegion.isEmpty()) {
             base::unique_fd readyFence;
             // redraw the whole screen
-            doComposeSurfaces(displayDevice, dirtyRegion, &readyFence);
+            doComposeSurfaces(displayDevice, dirtyRegion, dirtyRegion, &readyFence);
 
             display->getRenderSurface()->queueBuffer(std::move(readyFence));
         }
@@ -2050,7 +2344,8 @@ void SurfaceFlinger::postComposition()
     // |mStateLock| not needed as we are on the main thread
     const auto displayDevice = getDefaultDisplayDeviceLocked();
 
-    getBE().mGlCompositionDoneTimeline.updateSignalTimes();
+    FenceTimeline::updateSignalTimes(
+            {&getBE().mGlCompositionDoneTimeline, &getBE().mDisplayTimeline});
     std::shared_ptr<FenceTime> glCompositionDoneFenceTime;
     if (displayDevice && getHwComposer().hasClientComposition(displayDevice->getId())) {
         glCompositionDoneFenceTime =
@@ -2062,7 +2357,6 @@ void SurfaceFlinger::postComposition()
         glCompositionDoneFenceTime = FenceTime::NO_FENCE;
     }
 
-    getBE().mDisplayTimeline.updateSignalTimes();
     mPreviousPresentFences[1] = mPreviousPresentFences[0];
     mPreviousPresentFences[0] = displayDevice
             ? getHwComposer().getPresentFence(*displayDevice->getId())
@@ -2088,8 +2382,11 @@ void SurfaceFlinger::postComposition()
                 layer->onPostComposition(displayDevice->getId(), glCompositionDoneFenceTime,
                                          presentFenceTime, compositorTiming);
         if (frameLatched) {
-            recordBufferingStats(layer->getName().string(),
-                    layer->getOccupancyHistory(false));
+            std::vector<OccupancyTracker::Segment> history = layer->getOccupancyHistory(false);
+            if (mTracingEnabled) {
+                layer->recordOccupancyForTracing(history);
+            }
+            recordBufferingStats(layer->getName().string(), std::move(history));
         }
     });
 
@@ -2127,6 +2424,8 @@ void SurfaceFlinger::postComposition()
 
     mTimeStats->setPresentFenceGlobal(presentFenceTime);
 
+    reclaimIdleLayerBuffers(dequeueReadyTime);
+
     if (displayDevice && getHwComposer().isConnected(*displayDevice->getId()) &&
         !displayDevice->isPoweredOn()) {
         return;
@@ -2185,6 +2484,23 @@ void SurfaceFlinger::postComposition()
     }
 }
 
+void SurfaceFlinger::reclaimIdleLayerBuffers(nsecs_t now) {
+    // Layers only need checking about as often as the timeout they wait for
+    if (mLayerReclaimTimeout <= 0 || now - mLastLayerReclaimCheck < mLayerReclaimTimeout / 2) {
+        return;
+    }
+    ATRACE_CALL();
+    mLastLayerReclaimCheck = now;
+
+    mDrawingState.traverseInZOrder(
+            [&](Layer* layer) { layer->reclaimBuffersIfIdle(now, mLayerReclaimTimeout, true); });
+    for (Layer* offscreenLayer : mOffscreenLayers) {
+        offscreenLayer->traverseInZOrder(LayerVector::StateSet::Drawing, [&](Layer* layer) {
+            layer->reclaimBuffersIfIdle(now, mLayerReclaimTimeout, false);
+        });
+    }
+}
+
 void SurfaceFlinger::computeLayerBounds() {
     for (const auto& pair : mDisplays) {
         const auto& displayDevice = pair.second;
@@ -2433,13 +2749,15 @@ void SurfaceFlinger::prepareFrame(const sp<DisplayDevice>& displayDevice) {
              displayDevice->getDebugName().c_str(), result, strerror(-result));
 }
 
-void SurfaceFlinger::doComposition(const sp<DisplayDevice>& displayDevice, bool repaintEverything) {
+void SurfaceFlinger::doComposition(const sp<DisplayDevice>& displayDevice, bool repaintEverything,
+                                   nsecs_t* outRenderEngineDuration) {
     ATRACE_CALL();
     ALOGV("doComposition");
 
     auto display = displayDevice->getCompositionDisplay();
     const auto& displayState = display->getState();
 
+    const nsecs_t renderStart = systemTime();
     if (displayState.isEnabled) {
         // transform the dirty region into this screen's coordinate space
         const Region dirtyRegion = display->getDirtyRegion(repaintEverything);
@@ -2449,8 +2767,37 @@ void SurfaceFlinger::doComposition(const sp<DisplayDevice>& displayDevice, bool
 
         display->editState().dirtyRegion.clear();
         display->getRenderSurface()->flip();
+
+        if (const auto displayId = display->getId()) {
+            getHwComposer().queuePresent(*displayId);
+        }
     }
-    postFramebuffer(displayDevice);
+    *outRenderEngineDuration = systemTime() - renderStart;
+}
+
+void SurfaceFlinger::recordFrameStages(const sp<DisplayDevice>& displayDevice,
+                                       nsecs_t compositionStrategyDuration,
+                                       nsecs_t renderEngineDuration, nsecs_t hwcPresentDuration,
+                                       nsecs_t presentTime) {
+    const auto displayId = displayDevice->getId();
+    if (!mTimeStats->isEnabled() || !displayId || !displayDevice->isPoweredOn()) {
+        return;
+    }
+
+    const auto config = getHwComposer().getActiveConfig(*displayId);
+    const uint32_t fps = config && config->getVsyncPeriod() > 0
+            ? static_cast<uint32_t>(std::round(1e9f / config->getVsyncPeriod()))
+            : 0;
+
+    TimeStats::FrameStages stages;
+    stages.transactionApply = mTransactionApplyDuration;
+    stages.latch = mLatchDuration;
+    stages.compositionStrategy = compositionStrategyDuration;
+    stages.renderEngine = renderEngineDuration;
+    stages.hwcPresent = hwcPresentDuration;
+    mTimeStats->recordFrameStages(displayId->value, fps, stages, presentTime,
+                                  std::make_shared<FenceTime>(
+                                          getHwComposer().getPresentFence(*displayId)));
 }
 
 void SurfaceFlinger::postFrame()
@@ -2469,14 +2816,21 @@ void SurfaceFlinger::postFramebuffer(const sp<DisplayDevice>& displayDevice) {
     ATRACE_CALL();
     ALOGV("postFramebuffer");
 
+    auto display = displayDevice->getCompositionDisplay();
+    const auto displayId = display->getId();
+
+    if (display->getState().isEnabled && displayId) {
+        getHwComposer().presentAndGetReleaseFences(*displayId);
+    }
+    onDisplayPresented(displayDevice);
+}
+
+void SurfaceFlinger::onDisplayPresented(const sp<DisplayDevice>& displayDevice) {
     auto display = displayDevice->getCompositionDisplay();
     const auto& displayState = display->getState();
     const auto displayId = display->getId();
 
     if (displayState.isEnabled) {
-        if (displayId) {
-            getHwComposer().presentAndGetReleaseFences(*displayId);
-        }
         display->getRenderSurface()->onPresentDisplayCompleted();
         for (auto& layer : display->getOutputLayersOrderedByZ()) {
             sp<Fence> releaseFence = Fence::NO_FENCE;
@@ -2500,8 +2854,9 @@ void SurfaceFlinger::postFramebuffer(const sp<DisplayDevice>& displayDevice) {
             // this is suboptimal.
             if (usedClientComposition) {
                 releaseFence =
-                        Fence::merge("LayerRelease", releaseFence,
-                                     display->getRenderSurface()->getClientTargetAcquireFence());
+                        Fence::merge("LayerRelease",
+                                     {releaseFence,
+                                      display->getRenderSurface()->getClientTargetAcquireFence()});
             }
 
             layer->getLayerFE().onLayerDisplayed(releaseFence);
@@ -2536,6 +2891,7 @@ void SurfaceFlinger::handleTransaction(uint32_t transactionFlags)
 
     Mutex::Autolock _l(mStateLock);
     mDebugInTransaction = systemTime();
+    commitPendingLayerAdditionsLocked();
 
     // Here we're guaranteed that some transaction flags are set
     // so we can call handleTransactionLocked() unconditionally.
@@ -2761,8 +3117,14 @@ void SurfaceFlinger::processDisplayChangesLocked() {
                     // they have external state (layer stack, projection,
                     // etc.) but no internal state (i.e. a DisplayDevice).
                     if (state.surface != nullptr) {
-                        // Allow VR composer to use virtual displays.
-                        if (mUseHwcVirtualDisplays || getHwComposer().isUsingVrComposer()) {
+                        // Allow VR composer to use virtual displays. Sinks feeding a
+                        // video encoder try HWC writeback straight into their buffers,
+                        // and fall back to GLES at the sink's resolution without it.
+                        int sinkUsage = 0;
+                        state.surface->query(NATIVE_WINDOW_CONSUMER_USAGE_BITS, &sinkUsage);
+                        const bool sinkIsEncoder = sinkUsage & GRALLOC_USAGE_HW_VIDEO_ENCODER;
+                        if (mUseHwcVirtualDisplays || getHwComposer().isUsingVrComposer() ||
+                            (mUseHwcVirtualDisplaysForEncoder && sinkIsEncoder)) {
                             int width = 0;
                             int status = state.surface->query(NATIVE_WINDOW_WIDTH, &width);
                             ALOGE_IF(status != NO_ERROR, "Unable to query width (%d)", status);
@@ -2867,6 +3229,12 @@ void SurfaceFlinger::handleTransactionLocked(uint32_t transactionFlags)
     if (transactionFlags & eDisplayTransactionNeeded) {
         processDisplayChangesLocked();
         processDisplayHotplugEventsLocked();
+        // start over with visible regions on display changes
+        mVisibleRegionCaches.clear();
+        mLayerFlatteners.clear();
+        mLayerCacheAllocations.clear();
+        mClientTargetDamageHistories.clear();
+        mClientCompositionRequestCaches.clear();
     }
 
     if (transactionFlags & (eDisplayLayerStackChanged|eDisplayTransactionNeeded)) {
@@ -2996,9 +3364,19 @@ void SurfaceFlinger::updateInputWindowInfo() {
         }
     });
 
+    // Geometry changes mark input info dirty too, but most of them leave the
+    // windows as they were; don't send InputFlinger the same list again.
+    if (inputHandles == mLastInputWindowInfos) {
+        if (mInputWindowCommands.syncInputWindows) {
+            setInputWindowsFinished();
+        }
+        return;
+    }
+
     mInputFlinger->setInputWindows(inputHandles,
                                    mInputWindowCommands.syncInputWindows ? mSetInputWindowsListener
                                                                          : nullptr);
+    mLastInputWindowInfos = std::move(inputHandles);
 }
 
 void SurfaceFlinger::commitInputWindowCommands() {
@@ -3064,6 +3442,8 @@ void SurfaceFlinger::initScheduler(DisplayId primaryDisplayId) {
     mEventQueue->setEventConnection(mScheduler->getEventConnection(mSfConnectionHandle));
     mVsyncModulator.setSchedulerAndHandles(mScheduler.get(), mAppConnectionHandle.get(),
                                            mSfConnectionHandle.get());
+    const auto offsets = mVsyncModulator.getOffsets();
+    mScheduler->setWorkBudget(mAppConnectionHandle, offsets.sf - offsets.app);
 
     mRegionSamplingThread =
             new RegionSamplingThread(*this, *mScheduler,
@@ -3074,6 +3454,12 @@ void SurfaceFlinger::initScheduler(DisplayId primaryDisplayId) {
                 Mutex::Autolock lock(mStateLock);
                 setRefreshRateTo(type, event);
             });
+    mScheduler->setDeepIdleCallback([this](bool idle) {
+        if (idle) {
+            mDeepIdleCount++;
+        }
+        postMessageAsync(new LambdaMessage([this, idle] { mPowerAdvisor.setScreenIdle(idle); }));
+    });
 }
 
 void SurfaceFlinger::commitTransaction()
@@ -3119,6 +3505,10 @@ void SurfaceFlinger::commitTransaction()
         });
 
         commitOffscreenLayers();
+
+        // The drawing hierarchy and z order are now fixed until the next
+        // commit; flatten them once for all the traversals until then.
+        mDrawingState.flattenZOrder();
     });
 
     mTransactionPending = false;
@@ -3158,6 +3548,19 @@ void SurfaceFlinger::commitOffscreenLayers() {
     }
 }
 
+bool SurfaceFlinger::VisibleRegionInputs::operator==(const VisibleRegionInputs& rhs) const {
+    if (bounds != rhs.bounds || translucent != rhs.translucent || opaque != rhs.opaque) {
+        return false;
+    }
+    // the transform and transparent region only matter for translucent layers
+    if (!translucent) {
+        return true;
+    }
+    return transform[0] == rhs.transform[0] && transform[1] == rhs.transform[1] &&
+            transform[2] == rhs.transform[2] &&
+            activeTransparentRegion.hasSameRects(rhs.activeTransparentRegion);
+}
+
 void SurfaceFlinger::computeVisibleRegions(const sp<const DisplayDevice>& displayDevice,
                                            Region& outDirtyRegion, Region& outOpaqueRegion) {
     ATRACE_CALL();
@@ -3171,6 +3574,9 @@ void SurfaceFlinger::computeVisibleRegions(const sp<const DisplayDevice>& displa
 
     outDirtyRegion.clear();
 
+    VisibleRegionCache& cache = mVisibleRegionCaches[displayDevice->getDisplayToken()];
+    const uint64_t generation = ++cache.generation;
+
     mDrawingState.traverseInReverseZOrder([&](Layer* layer) {
         // start with the whole surface at its current location
         const Layer::State& s(layer->getDrawingState());
@@ -3209,36 +3615,21 @@ void SurfaceFlinger::computeVisibleRegions(const sp<const DisplayDevice>& displa
          */
         Region transparentRegion;
 
+        VisibleRegionInputs inputs;
 
         // handle hidden surfaces by setting the visible region to empty
         if (CC_LIKELY(layer->isVisible())) {
-            const bool translucent = !layer->isOpaque(s);
-            Rect bounds(layer->getScreenBounds());
-
-            visibleRegion.set(bounds);
-            ui::Transform tr = layer->getTransform();
-            if (!visibleRegion.isEmpty()) {
-                // Remove the transparent area from the visible region
-                if (translucent) {
-                    if (tr.preserveRects()) {
-                        // transform the transparent region
-                        transparentRegion = tr.transform(layer->getActiveTransparentRegion(s));
-                    } else {
-                        // transformation too complex, can't do the
-                        // transparent region optimization.
-                        transparentRegion.clear();
-                    }
-                }
-
-                // compute the opaque region
-                const int32_t layerOrientation = tr.getOrientation();
-                if (layer->getAlpha() == 1.0f && !translucent &&
-                        layer->getRoundedCornerState().radius == 0.0f &&
-                        ((layerOrientation & ui::Transform::ROT_INVALID) == false)) {
-                    // the opaque region is the layer's footprint
-                    opaqueRegion = visibleRegion;
-                }
+            inputs.bounds = layer->getScreenBounds();
+            inputs.translucent = !layer->isOpaque(s);
+            inputs.transform = layer->getTransform();
+            if (inputs.translucent) {
+                inputs.activeTransparentRegion = layer->getActiveTransparentRegion(s);
             }
+            const int32_t layerOrientation = inputs.transform.getOrientation();
+            inputs.opaque = layer->getAlpha() == 1.0f && !inputs.translucent &&
+                    layer->getRoundedCornerState().radius == 0.0f &&
+                    ((layerOrientation & ui::Transform::ROT_INVALID) == false);
+            visibleRegion.set(inputs.bounds);
         }
 
         if (visibleRegion.isEmpty()) {
@@ -3246,6 +3637,55 @@ void SurfaceFlinger::computeVisibleRegions(const sp<const DisplayDevice>& displa
             return;
         }
 
+        auto [entryIt, inserted] = cache.entries.try_emplace(layer);
+        VisibleRegionCacheEntry& entry = entryIt->second;
+        if (!inserted && entry.inputs == inputs &&
+                entry.aboveOpaqueLayers.hasSameRects(aboveOpaqueLayers) &&
+                entry.aboveCoveredLayers.hasSameRects(aboveCoveredLayers) &&
+                entry.visibleRegion.hasSameRects(layer->visibleRegion) &&
+                entry.coveredRegion.hasSameRects(layer->coveredRegion)) {
+            // Nothing this layer's visibility depends on changed since the
+            // last pass, so its regions are the ones left on the layer. With
+            // the old and new regions equal, the dirty region computed below
+            // reduces to this (the visible region already excludes
+            // aboveOpaqueLayers).
+            if (layer->contentDirty) {
+                outDirtyRegion.orSelf(entry.visibleRegion);
+                layer->contentDirty = false;
+            } else {
+                outDirtyRegion.orSelf(entry.visibleRegion.intersect(entry.coveredRegion));
+            }
+            aboveOpaqueLayers = entry.aboveOpaqueLayersAfter;
+            aboveCoveredLayers = entry.aboveCoveredLayersAfter;
+            // another display showing this layer stack may have overwritten it
+            layer->setVisibleNonTransparentRegion(entry.visibleNonTransparentRegion);
+            entry.generation = generation;
+            return;
+        }
+
+        // Remove the transparent area from the visible region
+        if (inputs.translucent) {
+            if (inputs.transform.preserveRects()) {
+                // transform the transparent region
+                transparentRegion = inputs.transform.transform(inputs.activeTransparentRegion);
+            } else {
+                // transformation too complex, can't do the
+                // transparent region optimization.
+                transparentRegion.clear();
+            }
+        }
+
+        // compute the opaque region
+        if (inputs.opaque) {
+            // the opaque region is the layer's footprint
+            opaqueRegion = visibleRegion;
+        }
+
+        entry.generation = generation;
+        entry.inputs = std::move(inputs);
+        entry.aboveOpaqueLayers = aboveOpaqueLayers;
+        entry.aboveCoveredLayers = aboveCoveredLayers;
+
         // Clip the covered region to the visible region
         coveredRegion = aboveCoveredLayers.intersect(visibleRegion);
 
@@ -3294,8 +3734,23 @@ void SurfaceFlinger::computeVisibleRegions(const sp<const DisplayDevice>& displa
         layer->setCoveredRegion(coveredRegion);
         layer->setVisibleNonTransparentRegion(
                 visibleRegion.subtract(transparentRegion));
+
+        entry.aboveOpaqueLayersAfter = aboveOpaqueLayers;
+        entry.aboveCoveredLayersAfter = aboveCoveredLayers;
+        entry.visibleRegion = std::move(visibleRegion);
+        entry.coveredRegion = std::move(coveredRegion);
+        entry.visibleNonTransparentRegion = layer->visibleNonTransparentRegion;
     });
 
+    // forget layers which are gone, or no longer visible on this display
+    for (auto it = cache.entries.begin(); it != cache.entries.end();) {
+        if (it->second.generation != generation) {
+            it = cache.entries.erase(it);
+        } else {
+            ++it;
+        }
+    }
+
     outOpaqueRegion = aboveOpaqueLayers;
 }
 
@@ -3397,14 +3852,17 @@ void SurfaceFlinger::doDisplayComposition(const sp<DisplayDevice>& displayDevice
 
     ALOGV("doDisplayComposition");
     base::unique_fd readyFence;
-    if (!doComposeSurfaces(displayDevice, Region::INVALID_REGION, &readyFence)) return;
+    if (!doComposeSurfaces(displayDevice, Region::INVALID_REGION, inDirtyRegion, &readyFence)) {
+        return;
+    }
 
     // swap buffers (presentation)
     display->getRenderSurface()->queueBuffer(std::move(readyFence));
 }
 
 bool SurfaceFlinger::doComposeSurfaces(const sp<DisplayDevice>& displayDevice,
-                                       const Region& debugRegion, base::unique_fd* readyFence) {
+                                       const Region& debugRegion, const Region& dirtyRegion,
+                                       base::unique_fd* readyFence) {
     ATRACE_CALL();
     ALOGV("doComposeSurfaces");
 
@@ -3491,8 +3949,37 @@ bool SurfaceFlinger::doComposeSurfaces(const sp<DisplayDevice>& displayDevice,
     ALOGV("Rendering client layers");
     bool firstLayer = true;
     Region clearRegion = Region::INVALID_REGION;
-    for (auto& layer : displayDevice->getVisibleLayersSortedByZ()) {
+    const auto& visibleLayers = displayDevice->getVisibleLayersSortedByZ();
+    auto flattener = mLayerFlatteners.find(displayDevice->getDisplayToken());
+    bool abandonFlattenedRun = false;
+    for (size_t index = 0; index < visibleLayers.size(); index++) {
+        const auto& layer = visibleLayers[index];
         const Region viewportRegion(displayState.viewport);
+
+        // Layers shown through the layer cache are done by its buffer. If HWC
+        // couldn't take the buffer, draw what it stands for and stop caching.
+        if (flattener != mLayerFlatteners.end() && flattener->second.isFlattened(index)) {
+            const size_t runStart = flattener->second.getRunStart();
+            if (index == runStart &&
+                layer->getCompositionType(displayDevice) ==
+                        Hwc2::IComposerClient::Composition::CLIENT) {
+                for (size_t i = runStart; i < runStart + flattener->second.getRunSize(); i++) {
+                    const auto& flattenedLayer = visibleLayers[i];
+                    const Region clip(viewportRegion.intersect(flattenedLayer->visibleRegion));
+                    renderengine::LayerSettings layerSettings;
+                    if (!clip.isEmpty() &&
+                        flattenedLayer->prepareClientLayer(renderArea, clip, clearRegion,
+                                                           supportProtectedContent,
+                                                           layerSettings)) {
+                        clientCompositionLayers.push_back(layerSettings);
+                    }
+                }
+                abandonFlattenedRun = true;
+            }
+            firstLayer = false;
+            continue;
+        }
+
         const Region clip(viewportRegion.intersect(layer->visibleRegion));
         ALOGV("Layer: %s", layer->getName().string());
         ALOGV("  Composition type: %s", toString(layer->getCompositionType(displayDevice)).c_str());
@@ -3551,20 +4038,18 @@ bool SurfaceFlinger::doComposeSurfaces(const sp<DisplayDevice>& displayDevice,
         }
         firstLayer = false;
     }
+    if (abandonFlattenedRun) {
+        flattener->second.abandonRun();
+    }
 
     // Perform some cleanup steps if we used client composition.
     if (hasClientComposition) {
         clientCompositionDisplay.clearRegion = clearRegion;
+        // The debug flashes are gone the next frame, so is what's beneath
+        clientCompositionDisplay.damageRegion =
+                getClientTargetDamage(displayDevice, dirtyRegion, clientCompositionDisplay,
+                                      !debugRegion.isEmpty());
 
-        // We boost GPU frequency here because there will be color spaces conversion
-        // and it's expensive. We boost the GPU frequency so that GPU composition can
-        // finish in time. We must reset GPU frequency afterwards, because high frequency
-        // consumes extra battery.
-        const bool expensiveRenderingExpected =
-                clientCompositionDisplay.outputDataspace == Dataspace::DISPLAY_P3;
-        if (expensiveRenderingExpected && displayId) {
-            mPowerAdvisor.setExpensiveRenderingExpected(*displayId, true);
-        }
         if (!debugRegion.isEmpty()) {
             Region::const_iterator it = debugRegion.begin();
             Region::const_iterator end = debugRegion.end();
@@ -3578,15 +4063,98 @@ bool SurfaceFlinger::doComposeSurfaces(const sp<DisplayDevice>& displayDevice,
                 clientCompositionLayers.push_back(layerSettings);
             }
         }
-        renderEngine.drawLayers(clientCompositionDisplay, clientCompositionLayers,
-                                buf->getNativeBuffer(), /*useFramebufferCache=*/true, std::move(fd),
-                                readyFence);
-    } else if (displayId) {
-        mPowerAdvisor.setExpensiveRenderingExpected(*displayId, false);
+
+        // If the buffer already holds this very frame, drawing it again changes nothing. The
+        // buffers of virtual displays go to consumers which may write to them.
+        auto& requestCache = mClientCompositionRequestCaches[displayDevice->getDisplayToken()];
+        const bool canReuseBuffer = !displayDevice->isVirtual();
+        if (canReuseBuffer &&
+            requestCache.exists(buf->getId(), clientCompositionDisplay, clientCompositionLayers)) {
+            ATRACE_NAME("ClientCompositionReused");
+            if (displayId) {
+                mPowerAdvisor.setExpensiveRenderingExpected(*displayId, false);
+            }
+            return true;
+        }
+
+        // We boost GPU frequency here because there will be color spaces conversion
+        // and it's expensive. We boost the GPU frequency so that GPU composition can
+        // finish in time. We must reset GPU frequency afterwards, because high frequency
+        // consumes extra battery.
+        const bool expensiveRenderingExpected =
+                clientCompositionDisplay.outputDataspace == Dataspace::DISPLAY_P3;
+        if (expensiveRenderingExpected && displayId) {
+            mPowerAdvisor.setExpensiveRenderingExpected(*displayId, true);
+        }
+        const status_t status =
+                renderEngine.drawLayers(clientCompositionDisplay, clientCompositionLayers,
+                                        buf->getNativeBuffer(), /*useFramebufferCache=*/true,
+                                        std::move(fd), readyFence);
+        if (status == NO_ERROR && canReuseBuffer) {
+            requestCache.add(buf->getId(), clientCompositionDisplay, clientCompositionLayers);
+        } else {
+            requestCache.remove(buf->getId());
+        }
+    } else {
+        // HWC drew what changed meanwhile, which no client target has
+        mClientTargetDamageHistories.erase(displayDevice->getDisplayToken());
+        if (displayId) {
+            mPowerAdvisor.setExpensiveRenderingExpected(*displayId, false);
+        }
     }
     return true;
 }
 
+Region SurfaceFlinger::getClientTargetDamage(const sp<DisplayDevice>& displayDevice,
+                                             const Region& dirtyRegion,
+                                             const renderengine::DisplaySettings& settings,
+                                             bool forceFullRedraw) {
+    auto display = displayDevice->getCompositionDisplay();
+    const auto& displayState = display->getState();
+    auto& history = mClientTargetDamageHistories[displayDevice->getDisplayToken()];
+
+    // Layers may come, go or switch between HWC and the client with no
+    // damage to speak of, and everything drawn is subject to these settings
+    std::vector<std::pair<const Layer*, Hwc2::IComposerClient::Composition>> layers;
+    for (const auto& layer : displayDevice->getVisibleLayersSortedByZ()) {
+        layers.emplace_back(layer.get(), layer->getCompositionType(displayDevice));
+    }
+    const bool isProtected = getRenderEngine().isProtected();
+    if (layers != history.layers || settings.colorTransform != history.colorTransform ||
+        settings.outputDataspace != history.outputDataspace ||
+        isProtected != history.isProtected) {
+        forceFullRedraw = true;
+        history.layers = std::move(layers);
+        history.colorTransform = settings.colorTransform;
+        history.outputDataspace = settings.outputDataspace;
+        history.isProtected = isProtected;
+    }
+
+    const Region fullDamage(displayState.scissor);
+    const Region frameDamage =
+            forceFullRedraw ? fullDamage : displayState.transform.transform(dirtyRegion);
+    history.frames.push_front(frameDamage);
+    if (history.frames.size() > ClientTargetDamageHistory::kMaxFrames) {
+        history.frames.pop_back();
+    }
+
+    // The buffer holds what was drawn bufferAge frames ago, and misses what
+    // changed in every frame since
+    const int32_t bufferAge = display->getRenderSurface()->getBufferAge();
+    if (forceFullRedraw || bufferAge <= 0 ||
+        static_cast<size_t>(bufferAge) > history.frames.size()) {
+        return Region::INVALID_REGION;
+    }
+    Region damage;
+    for (int32_t i = 0; i < bufferAge; i++) {
+        damage.orSelf(history.frames[i]);
+    }
+    damage.andSelf(fullDamage);
+    // In the odd frame where nothing changed, this is empty and RenderEngine
+    // redraws everything
+    return damage;
+}
+
 void SurfaceFlinger::drawWormhole(const Region& region) const {
     auto& engine(getRenderEngine());
     engine.fillRegionWithColor(region, 0, 0, 0, 0);
@@ -3596,55 +4164,123 @@ status_t SurfaceFlinger::addClientLayer(const sp<Client>& client, const sp<IBind
                                         const sp<IGraphicBufferProducer>& gbc, const sp<Layer>& lbc,
                                         const sp<IBinder>& parentHandle,
                                         const sp<Layer>& parentLayer, bool addToCurrentState) {
+    if (mNumLayers >= MAX_LAYERS) {
+        ALOGE("AddClientLayer failed, mNumLayers (%zu) >= MAX_LAYERS (%zu)", mNumLayers,
+              MAX_LAYERS);
+        return NO_MEMORY;
+    }
+
     // add this layer to the current state list
     {
         Mutex::Autolock _l(mStateLock);
-        sp<Layer> parent;
-        if (parentHandle != nullptr) {
-            parent = fromHandle(parentHandle);
-            if (parent == nullptr) {
-                return NAME_NOT_FOUND;
-            }
-        } else {
-            parent = parentLayer;
+        // The parent may be a layer whose addition is still pending.
+        commitPendingLayerAdditionsLocked();
+        status_t err = addClientLayerLocked(handle, gbc, lbc, parentHandle, parentLayer,
+                                            addToCurrentState);
+        if (err != NO_ERROR) {
+            return err;
         }
+    }
 
-        if (mNumLayers >= MAX_LAYERS) {
-            ALOGE("AddClientLayer failed, mNumLayers (%zu) >= MAX_LAYERS (%zu)", mNumLayers,
-                  MAX_LAYERS);
-            return NO_MEMORY;
-        }
+    // attach this layer to the client
+    client->attachLayer(handle, lbc);
 
-        mLayersByLocalBinderToken.emplace(handle->localBinder(), lbc);
+    return NO_ERROR;
+}
 
-        if (parent == nullptr && addToCurrentState) {
-            mCurrentState.layersSortedByZ.add(lbc);
-        } else if (parent == nullptr) {
-            lbc->onRemovedFromCurrentState();
-        } else if (parent->isRemovedFromCurrentState()) {
-            parent->addChild(lbc);
-            lbc->onRemovedFromCurrentState();
-        } else {
-            parent->addChild(lbc);
+status_t SurfaceFlinger::addClientLayerLocked(const sp<IBinder>& handle,
+                                              const sp<IGraphicBufferProducer>& gbc,
+                                              const sp<Layer>& lbc,
+                                              const sp<IBinder>& parentHandle,
+                                              const sp<Layer>& parentLayer,
+                                              bool addToCurrentState) {
+    sp<Layer> parent;
+    if (parentHandle != nullptr) {
+        parent = fromHandle(parentHandle);
+        if (parent == nullptr) {
+            return NAME_NOT_FOUND;
         }
+    } else {
+        parent = parentLayer;
+    }
 
-        if (gbc != nullptr) {
-            mGraphicBufferProducerList.insert(IInterface::asBinder(gbc).get());
-            LOG_ALWAYS_FATAL_IF(mGraphicBufferProducerList.size() >
-                                        mMaxGraphicBufferProducerListSize,
-                                "Suspected IGBP leak: %zu IGBPs (%zu max), %zu Layers",
-                                mGraphicBufferProducerList.size(),
-                                mMaxGraphicBufferProducerListSize, mNumLayers);
-        }
-        mLayersAdded = true;
+    mLayersByLocalBinderToken.emplace(handle->localBinder(), lbc);
+
+    if (parent == nullptr && addToCurrentState) {
+        mCurrentState.layersSortedByZ.add(lbc);
+    } else if (parent == nullptr) {
+        lbc->onRemovedFromCurrentState();
+    } else if (parent->isRemovedFromCurrentState()) {
+        parent->addChild(lbc);
+        lbc->onRemovedFromCurrentState();
+    } else {
+        parent->addChild(lbc);
     }
 
-    // attach this layer to the client
+    if (gbc != nullptr) {
+        mGraphicBufferProducerList.insert(IInterface::asBinder(gbc).get());
+        LOG_ALWAYS_FATAL_IF(mGraphicBufferProducerList.size() > mMaxGraphicBufferProducerListSize,
+                            "Suspected IGBP leak: %zu IGBPs (%zu max), %zu Layers",
+                            mGraphicBufferProducerList.size(), mMaxGraphicBufferProducerListSize,
+                            mNumLayers);
+    }
+    mLayersAdded = true;
+    return NO_ERROR;
+}
+
+status_t SurfaceFlinger::addClientLayerDeferred(const sp<Client>& client,
+                                                const sp<IBinder>& handle, const sp<Layer>& lbc,
+                                                const sp<IBinder>& parentHandle,
+                                                const sp<Layer>& parentLayer,
+                                                bool addToCurrentState) {
+    if (mNumLayers >= MAX_LAYERS) {
+        ALOGE("AddClientLayer failed, mNumLayers (%zu) >= MAX_LAYERS (%zu)", mNumLayers,
+              MAX_LAYERS);
+        return NO_MEMORY;
+    }
+
+    {
+        std::lock_guard lock(mPendingLayerAdditionsMutex);
+        mPendingLayerAdditions.push_back(
+                {handle, lbc, parentHandle, parentLayer, addToCurrentState});
+        mHasPendingLayerAdditions = true;
+    }
+
+    // Transactions find the layer through its client, so it can be used at once.
     client->attachLayer(handle, lbc);
 
     return NO_ERROR;
 }
 
+void SurfaceFlinger::commitPendingLayerAdditionsLocked() {
+    if (!mHasPendingLayerAdditions.exchange(false)) {
+        return;
+    }
+
+    std::vector<PendingLayerAddition> additions;
+    {
+        std::lock_guard lock(mPendingLayerAdditionsMutex);
+        additions.swap(mPendingLayerAdditions);
+    }
+
+    // Additions are committed in the order the layers were created, so a
+    // parent is always in the tree before its children.
+    for (const auto& addition : additions) {
+        status_t err = addClientLayerLocked(addition.handle, nullptr, addition.layer,
+                                            addition.parentHandle, addition.parentLayer,
+                                            addition.addToCurrentState);
+        if (err == NAME_NOT_FOUND) {
+            // The parent went away before the layer made it to the tree. The
+            // client already has the layer, so it is kept offscreen, as if it
+            // had been created without a parent.
+            ALOGW("Parent of layer %s is gone, keeping it offscreen",
+                  addition.layer->getName().string());
+            addClientLayerLocked(addition.handle, nullptr, addition.layer, nullptr, nullptr,
+                                 false);
+        }
+    }
+}
+
 uint32_t SurfaceFlinger::peekTransactionFlags() {
     return mTransactionFlags;
 }
@@ -3673,6 +4309,7 @@ bool SurfaceFlinger::flushTransactionQueues() {
     // states) around outside the scope of the lock
     std::vector<const TransactionState> transactions;
     bool flushedATransaction = false;
+    nsecs_t nextFlushTime = std::numeric_limits<nsecs_t>::max();
     {
         Mutex::Autolock _l(mStateLock);
 
@@ -3681,19 +4318,34 @@ bool SurfaceFlinger::flushTransactionQueues() {
             auto& [applyToken, transactionQueue] = *it;
 
             while (!transactionQueue.empty()) {
-                const auto& transaction = transactionQueue.front();
-                if (!transactionIsReadyToBeApplied(transaction.desiredPresentTime,
-                                                   transaction.states)) {
-                    setTransactionFlags(eTransactionFlushNeeded);
+                if (!transactionIsReadyToBeApplied(transactionQueue.front().desiredPresentTime,
+                                                   transactionQueue.front().states)) {
+                    nextFlushTime =
+                            std::min(nextFlushTime,
+                                     transactionRetryTime(transactionQueue.front().desiredPresentTime,
+                                                          transactionQueue.front().states));
                     break;
                 }
-                transactions.push_back(transaction);
+                TransactionState transaction = transactionQueue.front();
+                transactionQueue.pop();
+
+                // A run of plain property updates, like an animation moving a
+                // layer every frame, would only overwrite the same state when
+                // applied one by one: fold the ready ones into one transaction.
+                while (!transactionQueue.empty() &&
+                       transaction.canCoalesce(transactionQueue.front()) &&
+                       transactionIsReadyToBeApplied(transactionQueue.front().desiredPresentTime,
+                                                     transactionQueue.front().states)) {
+                    transaction.coalesce(transactionQueue.front());
+                    transactionQueue.pop();
+                }
+
                 applyTransactionState(transaction.states, transaction.displays, transaction.flags,
                                       mPendingInputWindowCommands, transaction.desiredPresentTime,
                                       transaction.buffer, transaction.callback,
                                       transaction.postTime, transaction.privileged,
                                       /*isMainThread*/ true);
-                transactionQueue.pop();
+                transactions.push_back(std::move(transaction));
                 flushedATransaction = true;
             }
 
@@ -3704,10 +4356,81 @@ bool SurfaceFlinger::flushTransactionQueues() {
                 it = std::next(it, 1);
             }
         }
+        mNextTransactionFlushTime = nextFlushTime;
     }
     return flushedATransaction;
 }
 
+void SurfaceFlinger::scheduleTransactionFlush() {
+    if (!transactionFlushNeeded()) {
+        return;
+    }
+
+    const nsecs_t now = systemTime();
+    if (mNextTransactionFlushTime <= now + getVsyncPeriod()) {
+        setTransactionFlags(eTransactionFlushNeeded);
+        return;
+    }
+
+    // a wakeup at or before that time is already on its way
+    if (mScheduledTransactionFlushTime > now &&
+        mScheduledTransactionFlushTime <= mNextTransactionFlushTime) {
+        return;
+    }
+    mScheduledTransactionFlushTime = mNextTransactionFlushTime;
+    postMessageAsync(new LambdaMessage([this]() { setTransactionFlags(eTransactionFlushNeeded); }),
+                     mNextTransactionFlushTime - now);
+}
+
+bool SurfaceFlinger::TransactionState::canCoalesce(const TransactionState& next) const {
+    // Properties layer_state_t::merge() folds correctly, and whose final
+    // value doesn't depend on the values they were set to before. Buffers,
+    // fences and callbacks have per-transaction side effects and are
+    // never coalesced.
+    constexpr uint64_t kCoalescableChanges = layer_state_t::ePositionChanged |
+            layer_state_t::eLayerChanged | layer_state_t::eSizeChanged |
+            layer_state_t::eAlphaChanged | layer_state_t::eMatrixChanged |
+            layer_state_t::eTransparentRegionChanged | layer_state_t::eLayerStackChanged |
+            layer_state_t::eCropChanged_legacy | layer_state_t::eCornerRadiusChanged |
+            layer_state_t::eCropChanged | layer_state_t::eFrameChanged |
+            layer_state_t::eColorTransformChanged;
+    constexpr uint32_t kUncoalescableFlags = eSynchronous | eAnimation;
+
+    auto isPlainUpdate = [&](const TransactionState& transaction) {
+        if (!transaction.displays.isEmpty() || !transaction.callback.empty() ||
+            transaction.buffer.isValid() || (transaction.flags & kUncoalescableFlags)) {
+            return false;
+        }
+        for (const ComposerState& state : transaction.states) {
+            if (state.state.what & ~kCoalescableChanges) {
+                return false;
+            }
+        }
+        return true;
+    };
+
+    return flags == next.flags && privileged == next.privileged && isPlainUpdate(*this) &&
+            isPlainUpdate(next);
+}
+
+void SurfaceFlinger::TransactionState::coalesce(const TransactionState& next) {
+    for (const ComposerState& nextState : next.states) {
+        bool merged = false;
+        for (size_t i = 0; i < states.size(); i++) {
+            const ComposerState& state = states[i];
+            if (state.state.surface == nextState.state.surface &&
+                IInterface::asBinder(state.client) == IInterface::asBinder(nextState.client)) {
+                states.editItemAt(i).state.merge(nextState.state);
+                merged = true;
+                break;
+            }
+        }
+        if (!merged) {
+            states.add(nextState);
+        }
+    }
+}
+
 bool SurfaceFlinger::transactionFlushNeeded() {
     return !mTransactionQueues.empty();
 }
@@ -3756,6 +4479,27 @@ bool SurfaceFlinger::transactionIsReadyToBeApplied(int64_t desiredPresentTime,
     return true;
 }
 
+nsecs_t SurfaceFlinger::transactionRetryTime(int64_t desiredPresentTime,
+                                             const Vector<ComposerState>& states) {
+    // There is no telling when a fence will signal, so keep checking
+    for (const ComposerState& state : states) {
+        const layer_state_t& s = state.state;
+        if ((s.what & layer_state_t::eAcquireFenceChanged) && s.acquireFence &&
+            s.acquireFence->getStatus() == Fence::Status::Unsignaled) {
+            return 0;
+        }
+    }
+
+    // The transaction becomes ready on the first frame expected to present
+    // after desiredPresentTime. Wake up a frame before that, so that frame's
+    // transaction handling picks it up.
+    const nsecs_t expectedPresentTime = getExpectedPresentTime();
+    if (desiredPresentTime < expectedPresentTime) {
+        return 0;
+    }
+    return systemTime() + (desiredPresentTime - expectedPresentTime) - getVsyncPeriod();
+}
+
 void SurfaceFlinger::setTransactionState(const Vector<ComposerState>& states,
                                          const Vector<DisplayState>& displays, uint32_t flags,
                                          const sp<IBinder>& applyToken,
@@ -3812,6 +4556,9 @@ void SurfaceFlinger::applyTransactionState(const Vector<ComposerState>& states,
                                            const std::vector<ListenerCallbacks>& listenerCallbacks,
                                            const int64_t postTime, bool privileged,
                                            bool isMainThread) {
+    // Transactions may order, reparent or remove the layers created so far.
+    commitPendingLayerAdditionsLocked();
+
     uint32_t transactionFlags = 0;
 
     if (flags & eAnimation) {
@@ -4336,8 +5083,16 @@ status_t SurfaceFlinger::createLayer(const String8& name, const sp<Client>& clie
     }
 
     bool addToCurrentState = callingThreadHasUnscopedSurfaceFlingerAccess();
-    result = addClientLayer(client, *handle, *gbp, layer, parentHandle, parentLayer,
-                            addToCurrentState);
+    if ((flags & ISurfaceComposerClient::eFXSurfaceMask) ==
+        ISurfaceComposerClient::eFXSurfaceBufferState) {
+        // Buffer state layers are created in numbers, so they don't wait to be
+        // inserted into the tree.
+        result = addClientLayerDeferred(client, *handle, layer, parentHandle, parentLayer,
+                                        addToCurrentState);
+    } else {
+        result = addClientLayer(client, *handle, *gbp, layer, parentHandle, parentLayer,
+                                addToCurrentState);
+    }
     if (result != NO_ERROR) {
         return result;
     }
@@ -4357,6 +5112,7 @@ String8 SurfaceFlinger::getUniqueLayerName(const String8& name)
 
     // Grab the state lock since we're accessing mCurrentState
     Mutex::Autolock lock(mStateLock);
+    commitPendingLayerAdditionsLocked();
 
     // Loop over layers until we're sure there is no matching name
     while (matchFound) {
@@ -4446,6 +5202,8 @@ void SurfaceFlinger::markLayerPendingRemovalLocked(const sp<Layer>& layer) {
 void SurfaceFlinger::onHandleDestroyed(sp<Layer>& layer)
 {
     Mutex::Autolock lock(mStateLock);
+    // The layer may not have been inserted into the tree yet.
+    commitPendingLayerAdditionsLocked();
     // If a layer has a parent, we allow it to out-live it's handle
     // with the idea that the parent holds a reference and will eventually
     // be cleaned up. However no one cleans up the top-level so we do so
@@ -4647,6 +5405,8 @@ status_t SurfaceFlinger::doDump(int fd, const DumpArgs& args,
         using namespace std::string_literals;
 
         static const std::unordered_map<std::string, Dumper> dumpers = {
+                {"--binder-latency"s, argsDumper(&SurfaceFlinger::dumpBinderLatency)},
+                {"--binder-stats"s, argsDumper(&SurfaceFlinger::dumpBinderCallerStats)},
                 {"--clear-layer-stats"s, dumper([this](std::string&) { mLayerStats.clear(); })},
                 {"--disable-layer-stats"s, dumper([this](std::string&) { mLayerStats.disable(); })},
                 {"--display-id"s, dumper(&SurfaceFlinger::dumpDisplayIdentificationData)},
@@ -4656,8 +5416,14 @@ status_t SurfaceFlinger::doDump(int fd, const DumpArgs& args,
                 {"--dump-layer-stats"s, dumper([this](std::string& s) { mLayerStats.dump(s); })},
                 {"--enable-layer-stats"s, dumper([this](std::string&) { mLayerStats.enable(); })},
                 {"--frame-events"s, dumper(&SurfaceFlinger::dumpFrameEventsLocked)},
+                {"--init"s, dumper(&SurfaceFlinger::dumpInitStagesLocked)},
+                {"--frame-profile"s, dumper([this](std::string& s) { mFrameProfiler.dump(s); })},
+                {"--frame-profile-clear"s, dumper([this](std::string&) { mFrameProfiler.clear(); })},
                 {"--latency"s, argsDumper(&SurfaceFlinger::dumpStatsLocked)},
                 {"--latency-clear"s, argsDumper(&SurfaceFlinger::clearStatsLocked)},
+                {"--latency-percentiles"s,
+                 argsDumper(&SurfaceFlinger::dumpPresentIntervalsLocked)},
+                {"--layer-memory"s, dumper(&SurfaceFlinger::dumpLayerMemoryLocked)},
                 {"--list"s, dumper(&SurfaceFlinger::listLayersLocked)},
                 {"--static-screen"s, dumper(&SurfaceFlinger::dumpStaticScreenStats)},
                 {"--timestats"s, protoDumper(&SurfaceFlinger::dumpTimeStats)},
@@ -4667,20 +5433,35 @@ status_t SurfaceFlinger::doDump(int fd, const DumpArgs& args,
 
         const auto flag = args.empty() ? ""s : std::string(String8(args[0]));
 
+        // Layers are only copied into a proto under the lock. Serializing or
+        // formatting them, which takes most of the dump, waits until it is
+        // released so that composition is not held up.
+        std::optional<LayersProto> layersProto;
+        size_t layersPos = 0;
+        const bool incremental = flag == "--proto-only";
+
         if (const auto it = dumpers.find(flag); it != dumpers.end()) {
             (it->second)(args, asProto, result);
+        } else if (asProto || incremental) {
+            layersProto = dumpProtoInfo(LayerVector::StateSet::Current);
         } else {
-            if (asProto) {
-                LayersProto layersProto = dumpProtoInfo(LayerVector::StateSet::Current);
-                result.append(layersProto.SerializeAsString().c_str(), layersProto.ByteSize());
-            } else {
-                dumpAllLocked(args, result);
-            }
+            layersProto.emplace();
+            dumpAllLocked(args, result, &*layersProto, &layersPos);
         }
 
         if (locked) {
             mStateLock.unlock();
         }
+
+        if (layersProto && (asProto || incremental)) {
+            if (incremental) {
+                removeUnchangedLayers(&*layersProto);
+            }
+            result.append(layersProto->SerializeAsString());
+        } else if (layersProto) {
+            auto layerTree = LayerProtoParser::generateLayerTree(*layersProto);
+            result.insert(layersPos, LayerProtoParser::layerTreeToString(layerTree) + "\n");
+        }
     }
     write(fd, result.c_str(), result.size());
     return NO_ERROR;
@@ -4724,6 +5505,87 @@ void SurfaceFlinger::clearStatsLocked(const DumpArgs& args, std::string&) {
     mAnimFrameTracker.clearStats();
 }
 
+void SurfaceFlinger::dumpBinderLatency(const DumpArgs& args, std::string& result) const {
+    // --binder-latency [enable|disable|clear]
+    if (args.size() > 1) {
+        const auto command = String8(args[1]);
+        if (command == "enable") {
+            TransactionStats::setEnabled(true);
+        } else if (command == "disable") {
+            TransactionStats::setEnabled(false);
+        } else if (command == "clear") {
+            TransactionStats::reset();
+        } else {
+            StringAppendF(&result, "Unknown --binder-latency command: %s\n", command.string());
+            return;
+        }
+    }
+
+    String8 stats;
+    TransactionStats::dump(stats);
+    result.append(stats.string());
+}
+
+void SurfaceFlinger::dumpBinderCallerStats(const DumpArgs& args, std::string& result) const {
+    // --binder-stats [enable|disable|clear]
+    if (args.size() > 1) {
+        const auto command = String8(args[1]);
+        if (command == "enable") {
+            TransactionStats::setCallerStatsEnabled(true);
+        } else if (command == "disable") {
+            TransactionStats::setCallerStatsEnabled(false);
+        } else if (command == "clear") {
+            TransactionStats::resetCallers();
+        } else {
+            StringAppendF(&result, "Unknown --binder-stats command: %s\n", command.string());
+            return;
+        }
+    }
+
+    String8 stats;
+    TransactionStats::dumpCallers(stats);
+    result.append(stats.string());
+}
+
+void SurfaceFlinger::dumpPresentIntervalsLocked(const DumpArgs& args, std::string& result) const {
+    if (args.size() > 1) {
+        const auto name = String8(args[1]);
+        mCurrentState.traverseInZOrder([&](Layer* layer) {
+            if (name == layer->getName()) {
+                layer->dumpPresentIntervals(result);
+            }
+        });
+    } else {
+        mCurrentState.traverseInZOrder([&](Layer* layer) {
+            StringAppendF(&result, "%s: ", layer->getName().string());
+            layer->dumpPresentIntervals(result);
+        });
+        result.append("<win-anim>: ");
+        mAnimFrameTracker.dumpPresentIntervals(result);
+    }
+}
+
+void SurfaceFlinger::dumpLayerMemoryLocked(std::string& result) const {
+    size_t totalBytes = 0;
+    const auto dumpLayer = [&](Layer* layer, const char* where) {
+        const size_t bytes = layer->getBufferBytes();
+        totalBytes += bytes;
+        StringAppendF(&result, "%10.1f KiB %s %s\n", bytes / 1024.0, where,
+                      layer->getName().string());
+    };
+
+    mCurrentState.traverseInZOrder([&](Layer* layer) { dumpLayer(layer, "onscreen "); });
+    for (Layer* offscreenLayer : mOffscreenLayers) {
+        offscreenLayer->traverseInZOrder(LayerVector::StateSet::Drawing,
+                                         [&](Layer* layer) { dumpLayer(layer, "offscreen"); });
+    }
+    StringAppendF(&result, "Total: %.1f KiB\n", totalBytes / 1024.0);
+    if (mLayerReclaimTimeout > 0) {
+        StringAppendF(&result, "Unshown buffers reclaimed after %" PRId64 "ms unseen\n",
+                      ns2ms(mLayerReclaimTimeout));
+    }
+}
+
 void SurfaceFlinger::dumpTimeStats(const DumpArgs& args, bool asProto, std::string& result) const {
     mTimeStats->parseArgs(asProto, args, result);
 }
@@ -4770,6 +5632,9 @@ void SurfaceFlinger::dumpVSync(std::string& result) const {
     StringAppendF(&result, "(config override by backdoor: %s)\n\n",
                   mDebugDisplayConfigSetByBackdoor ? "yes" : "no");
     mScheduler->dump(mAppConnectionHandle, result);
+    if (mUseSmart90ForVideo) {
+        mScheduler->dumpLayerHistory(result);
+    }
     StringAppendF(&result, "+  Refresh rate switching: %s\n",
                   mRefreshRateConfigs->refreshRateSwitchingSupported() ? "on" : "off");
 }
@@ -4789,6 +5654,14 @@ void SurfaceFlinger::dumpStaticScreenStats(std::string& result) const {
                   bucketTimeSec, percent);
 }
 
+void SurfaceFlinger::dumpInitStagesLocked(std::string& result) const {
+    result.append("Initialization stages (ms from the start of init, duration):\n");
+    for (const auto& stage : mInitStages) {
+        StringAppendF(&result, "  %-14s %8.3f %8.3f\n", stage.name, stage.start / 1e6,
+                      stage.duration / 1e6);
+    }
+}
+
 void SurfaceFlinger::recordBufferingStats(const char* layerName,
         std::vector<OccupancyTracker::Segment>&& history) {
     Mutex::Autolock lock(getBE().mBufferingStatsMutex);
@@ -4962,7 +5835,33 @@ LayersProto SurfaceFlinger::dumpVisibleLayersProtoInfo(
     return layersProto;
 }
 
-void SurfaceFlinger::dumpAllLocked(const DumpArgs& args, std::string& result) const {
+void SurfaceFlinger::removeUnchangedLayers(LayersProto* layersProto) {
+    std::lock_guard lock(mIncrementalDumpMutex);
+
+    std::unordered_map<int32_t, size_t> layerHashes;
+    auto* layers = layersProto->mutable_layers();
+    layers->erase(std::remove_if(layers->begin(), layers->end(),
+                                 [&](const LayerProto& layer) {
+                                     const size_t hash =
+                                             std::hash<std::string>{}(layer.SerializeAsString());
+                                     layerHashes[layer.id()] = hash;
+                                     const auto it = mIncrementalDumpLayerHashes.find(layer.id());
+                                     return it != mIncrementalDumpLayerHashes.end() &&
+                                             it->second == hash;
+                                 }),
+                  layers->end());
+
+    for (const auto& [id, hash] : mIncrementalDumpLayerHashes) {
+        if (layerHashes.count(id) == 0) {
+            layersProto->add_removed_layer_ids(id);
+        }
+    }
+    layersProto->set_incremental(!mIncrementalDumpLayerHashes.empty());
+    mIncrementalDumpLayerHashes = std::move(layerHashes);
+}
+
+void SurfaceFlinger::dumpAllLocked(const DumpArgs& args, std::string& result,
+                                   LayersProto* layersProto, size_t* layersPos) const {
     const bool colorize = !args.empty() && args[0] == String16("--color");
     Colorizer colorizer(colorize);
 
@@ -5006,7 +5905,17 @@ void SurfaceFlinger::dumpAllLocked(const DumpArgs& args, std::string& result) co
 
     StringAppendF(&result, "Total missed frame count: %u\n", mFrameMissedCount.load());
     StringAppendF(&result, "HWC missed frame count: %u\n", mHwcFrameMissedCount.load());
-    StringAppendF(&result, "GPU missed frame count: %u\n\n", mGpuFrameMissedCount.load());
+    StringAppendF(&result, "GPU missed frame count: %u\n", mGpuFrameMissedCount.load());
+    StringAppendF(&result, "Predicted missed frame count: %u\n",
+                  mPredictedFrameMissedCount.load());
+    StringAppendF(&result, "Blocking fence wait count: %u\n", mBlockingWaitCount.load());
+    StringAppendF(&result, "Deep idle count: %u\n", mDeepIdleCount.load());
+    mFrameDeadlinePredictor.dump(result);
+    result.append("\n");
+
+    StringAppendF(&result, "Parcel buffer pool: %" PRIu64 " hits, %" PRIu64 " misses\n\n",
+                  IPCThreadState::getParcelBufferPoolHits(),
+                  IPCThreadState::getParcelBufferPoolMisses());
 
     dumpBufferingStats(result);
 
@@ -5019,12 +5928,9 @@ void SurfaceFlinger::dumpAllLocked(const DumpArgs& args, std::string& result) co
                   mGraphicBufferProducerList.size(), mMaxGraphicBufferProducerListSize);
     colorizer.reset(result);
 
-    {
-        LayersProto layersProto = dumpProtoInfo(LayerVector::StateSet::Current);
-        auto layerTree = LayerProtoParser::generateLayerTree(layersProto);
-        result.append(LayerProtoParser::layerTreeToString(layerTree));
-        result.append("\n");
-    }
+    // The layer tree is formatted into place once the caller drops the lock
+    *layersProto = dumpProtoInfo(LayerVector::StateSet::Current);
+    *layersPos = result.size();
 
     {
         StringAppendF(&result, "Composition layers\n");
@@ -5114,6 +6020,12 @@ void SurfaceFlinger::dumpAllLocked(const DumpArgs& args, std::string& result) co
     bool hwcDisabled = mDebugDisableHWC || mDebugRegion;
     StringAppendF(&result, "  h/w composer %s\n", hwcDisabled ? "disabled" : "enabled");
     getHwComposer().dump(result);
+    for (const auto& [token, flattener] : mLayerFlatteners) {
+        if (const auto display = getDisplayDeviceLocked(token)) {
+            StringAppendF(&result, "Display %s:\n", display->getDebugName().c_str());
+            flattener.dump(result);
+        }
+    }
 
     /*
      * Dump gralloc state
@@ -5172,8 +6084,37 @@ void SurfaceFlinger::updateColorMatrixLocked() {
         colorMatrix = mClientColorMatrix * mDaltonizer();
     }
 
-    if (mCurrentState.colorMatrix != colorMatrix) {
+    // When the matrix is just one of the accessibility transforms the composer
+    // knows about, say so, so that it can apply it without falling back to
+    // client composition.
+    android_color_transform_t hint = HAL_COLOR_TRANSFORM_ARBITRARY_MATRIX;
+    if (mClientColorMatrix == mat4()) {
+        const ColorBlindnessType type = mDaltonizer.getType();
+        if (type == ColorBlindnessType::None) {
+            if (mGlobalSaturationFactor == 0.0f) {
+                hint = HAL_COLOR_TRANSFORM_GRAYSCALE;
+            }
+        } else if (mGlobalSaturationFactor == 1.0f &&
+                   mDaltonizer.getMode() == ColorBlindnessMode::Correction) {
+            switch (type) {
+                case ColorBlindnessType::Protanomaly:
+                    hint = HAL_COLOR_TRANSFORM_CORRECT_PROTANOPIA;
+                    break;
+                case ColorBlindnessType::Deuteranomaly:
+                    hint = HAL_COLOR_TRANSFORM_CORRECT_DEUTERANOPIA;
+                    break;
+                case ColorBlindnessType::Tritanomaly:
+                    hint = HAL_COLOR_TRANSFORM_CORRECT_TRITANOPIA;
+                    break;
+                case ColorBlindnessType::None:
+                    break;
+            }
+        }
+    }
+
+    if (mCurrentState.colorMatrix != colorMatrix || mCurrentState.colorMatrixHint != hint) {
         mCurrentState.colorMatrix = colorMatrix;
+        mCurrentState.colorMatrixHint = hint;
         mCurrentState.colorMatrixChanged = true;
         setTransactionFlags(eTransactionNeeded);
     }
@@ -5862,6 +6803,7 @@ status_t SurfaceFlinger::captureLayers(
 
     {
         Mutex::Autolock _l(mStateLock);
+        commitPendingLayerAdditionsLocked();
 
         parent = fromHandle(layerHandleBinder);
         if (parent == nullptr || parent->isRemovedFromCurrentState()) {
@@ -5960,7 +6902,7 @@ status_t SurfaceFlinger::captureScreenCommon(RenderArea& renderArea,
                                              bool useIdentityTransform,
                                              bool& outCapturedSecureLayers) {
     // This mutex protects syncFd and captureResult for communication of the return values from the
-    // main thread back to this Binder thread
+    // main thread, or the RenderEngine thread, back to this Binder thread
     std::mutex captureMutex;
     std::condition_variable captureCondition;
     std::unique_lock<std::mutex> captureLock(captureMutex);
@@ -5982,22 +6924,37 @@ status_t SurfaceFlinger::captureScreenCommon(RenderArea& renderArea,
         }
 
         status_t result = NO_ERROR;
-        int fd = -1;
+        renderengine::DisplaySettings display;
+        std::vector<renderengine::LayerSettings> layers;
         {
             Mutex::Autolock _l(mStateLock);
             renderArea.render([&] {
-                result = captureScreenImplLocked(renderArea, traverseLayers, buffer.get(),
-                                                 useIdentityTransform, forSystem, &fd,
-                                                 outCapturedSecureLayers);
+                result = checkCaptureAllowedLocked(traverseLayers, forSystem,
+                                                   outCapturedSecureLayers);
+                if (result == NO_ERROR) {
+                    prepareScreenImplLocked(renderArea, traverseLayers, useIdentityTransform,
+                                            &display, &layers);
+                }
             });
         }
 
-        {
+        const auto setCaptureResult = [&](status_t status, base::unique_fd fd) {
             std::unique_lock<std::mutex> captureLock(captureMutex);
-            syncFd = fd;
-            captureResult = std::make_optional<status_t>(result);
+            syncFd = fd.release();
+            captureResult = std::make_optional<status_t>(status);
             captureCondition.notify_one();
+        };
+        if (result != NO_ERROR) {
+            setCaptureResult(result, base::unique_fd());
+            return;
         }
+
+        // The main thread does not wait for the draw, which RenderEngine reports back to the
+        // Binder thread directly.
+        getRenderEngine().useProtectedContext(false);
+        getRenderEngine().drawLayersAsync(display, std::move(layers), buffer,
+                                          /*useFramebufferCache=*/false, base::unique_fd(),
+                                          setCaptureResult);
     });
 
     status_t result = postMessageAsync(message);
@@ -6022,10 +6979,10 @@ status_t SurfaceFlinger::captureScreenCommon(RenderArea& renderArea,
     return result;
 }
 
-void SurfaceFlinger::renderScreenImplLocked(const RenderArea& renderArea,
-                                            TraverseLayersFunction traverseLayers,
-                                            ANativeWindowBuffer* buffer, bool useIdentityTransform,
-                                            int* outSyncFd) {
+void SurfaceFlinger::prepareScreenImplLocked(
+        const RenderArea& renderArea, TraverseLayersFunction traverseLayers,
+        bool useIdentityTransform, renderengine::DisplaySettings* outDisplay,
+        std::vector<renderengine::LayerSettings>* outLayers) {
     ATRACE_CALL();
 
     const auto reqWidth = renderArea.getReqWidth();
@@ -6034,8 +6991,8 @@ void SurfaceFlinger::renderScreenImplLocked(const RenderArea& renderArea,
     const auto transform = renderArea.getTransform();
     const auto sourceCrop = renderArea.getSourceCrop();
 
-    renderengine::DisplaySettings clientCompositionDisplay;
-    std::vector<renderengine::LayerSettings> clientCompositionLayers;
+    renderengine::DisplaySettings& clientCompositionDisplay = *outDisplay;
+    std::vector<renderengine::LayerSettings>& clientCompositionLayers = *outLayers;
 
     // assume that bounds are never offset, and that they are the same as the
     // buffer bounds.
@@ -6114,6 +7071,19 @@ void SurfaceFlinger::renderScreenImplLocked(const RenderArea& renderArea,
     });
 
     clientCompositionDisplay.clearRegion = clearRegion;
+}
+
+void SurfaceFlinger::renderScreenImplLocked(const RenderArea& renderArea,
+                                            TraverseLayersFunction traverseLayers,
+                                            ANativeWindowBuffer* buffer, bool useIdentityTransform,
+                                            int* outSyncFd) {
+    ATRACE_CALL();
+
+    renderengine::DisplaySettings clientCompositionDisplay;
+    std::vector<renderengine::LayerSettings> clientCompositionLayers;
+    prepareScreenImplLocked(renderArea, traverseLayers, useIdentityTransform,
+                            &clientCompositionDisplay, &clientCompositionLayers);
+
     // Use an empty fence for the buffer fence, since we just created the buffer so
     // there is no need for synchronization with the GPU.
     base::unique_fd bufferFence;
@@ -6132,6 +7102,17 @@ status_t SurfaceFlinger::captureScreenImplLocked(const RenderArea& renderArea,
                                                  int* outSyncFd, bool& outCapturedSecureLayers) {
     ATRACE_CALL();
 
+    const status_t result =
+            checkCaptureAllowedLocked(traverseLayers, forSystem, outCapturedSecureLayers);
+    if (result != NO_ERROR) {
+        return result;
+    }
+    renderScreenImplLocked(renderArea, traverseLayers, buffer, useIdentityTransform, outSyncFd);
+    return NO_ERROR;
+}
+
+status_t SurfaceFlinger::checkCaptureAllowedLocked(TraverseLayersFunction traverseLayers,
+                                                   bool forSystem, bool& outCapturedSecureLayers) {
     traverseLayers([&](Layer* layer) {
         outCapturedSecureLayers =
                 outCapturedSecureLayers || (layer->isVisible() && layer->isSecure());
@@ -6144,7 +7125,6 @@ status_t SurfaceFlinger::captureScreenImplLocked(const RenderArea& renderArea,
         ALOGW("FB is protected: PERMISSION_DENIED");
         return PERMISSION_DENIED;
     }
-    renderScreenImplLocked(renderArea, traverseLayers, buffer, useIdentityTransform, outSyncFd);
     return NO_ERROR;
 }
 
@@ -6158,13 +7138,34 @@ void SurfaceFlinger::setInputWindowsFinished() {
 // ---------------------------------------------------------------------------
 
 void SurfaceFlinger::State::traverseInZOrder(const LayerVector::Visitor& visitor) const {
+    if (layersInZOrderValid) {
+        for (const auto& layer : layersInZOrder) {
+            visitor(layer.get());
+        }
+        return;
+    }
     layersSortedByZ.traverseInZOrder(stateSet, visitor);
 }
 
 void SurfaceFlinger::State::traverseInReverseZOrder(const LayerVector::Visitor& visitor) const {
+    if (layersInZOrderValid) {
+        // the reverse traversal visits layers in exactly the opposite order
+        for (auto it = layersInZOrder.rbegin(); it != layersInZOrder.rend(); ++it) {
+            visitor(it->get());
+        }
+        return;
+    }
     layersSortedByZ.traverseInReverseZOrder(stateSet, visitor);
 }
 
+void SurfaceFlinger::State::flattenZOrder() {
+    layersInZOrderValid = false;
+    layersInZOrder.clear();
+    layersSortedByZ.traverseInZOrder(stateSet,
+                                     [&](Layer* layer) { layersInZOrder.emplace_back(layer); });
+    layersInZOrderValid = true;
+}
+
 void SurfaceFlinger::traverseLayersInDisplay(const sp<const DisplayDevice>& display,
                                              const LayerVector::Visitor& visitor) {
     // We loop through the first level of layers without traversing,
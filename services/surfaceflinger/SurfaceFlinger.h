@@ -23,6 +23,8 @@
  */
 
 #include <android-base/thread_annotations.h>
+#include <compositionengine/impl/ClientCompositionRequestCache.h>
+#include <compositionengine/impl/Flattener.h>
 #include <cutils/atomic.h>
 #include <cutils/compiler.h>
 #include <gui/BufferQueue.h>
@@ -33,12 +35,15 @@
 #include <gui/OccupancyTracker.h>
 #include <hardware/hwcomposer_defs.h>
 #include <input/ISetInputWindowsListener.h>
+#include <input/InputWindow.h>
 #include <layerproto/LayerProtoHeader.h>
 #include <math/mat4.h>
 #include <serviceutils/PriorityDumper.h>
 #include <system/graphics.h>
 #include <ui/FenceTime.h>
 #include <ui/PixelFormat.h>
+#include <ui/Region.h>
+#include <ui/Transform.h>
 #include <utils/Errors.h>
 #include <utils/KeyedVector.h>
 #include <utils/RefBase.h>
@@ -51,9 +56,11 @@
 #include "DisplayHardware/HWC2.h"
 #include "DisplayHardware/PowerAdvisor.h"
 #include "Effects/Daltonizer.h"
+#include "FrameProfiler.h"
 #include "FrameTracker.h"
 #include "LayerStats.h"
 #include "LayerVector.h"
+#include "Scheduler/FrameDeadlinePredictor.h"
 #include "Scheduler/RefreshRateConfigs.h"
 #include "Scheduler/RefreshRateStats.h"
 #include "Scheduler/Scheduler.h"
@@ -64,10 +71,13 @@
 
 #include <atomic>
 #include <cstdint>
+#include <deque>
 #include <functional>
+#include <future>
 #include <map>
 #include <memory>
 #include <mutex>
+#include <optional>
 #include <queue>
 #include <set>
 #include <string>
@@ -99,6 +109,7 @@ class DisplaySurface;
 
 namespace renderengine {
 class RenderEngine;
+struct DisplaySettings;
 } // namespace renderengine
 
 namespace dvr {
@@ -288,6 +299,10 @@ public:
     // synchronous message to the main thread to obtain one on the fly
     uint32_t getNewTexture();
 
+    // Obtains a name from the texture pool, or returns 0 if the pool is empty,
+    // growing it for the future. Never waits for the main thread.
+    uint32_t getPooledTexture();
+
     // utility function to delete a texture on the main thread
     void deleteTextureAsync(uint32_t texture);
 
@@ -372,7 +387,11 @@ private:
             colorMatrixChanged = other.colorMatrixChanged;
             if (colorMatrixChanged) {
                 colorMatrix = other.colorMatrix;
+                colorMatrixHint = other.colorMatrixHint;
             }
+            // the hierarchy is about to change, stop using the flattened one
+            layersInZOrder.clear();
+            layersInZOrderValid = false;
             return *this;
         }
 
@@ -382,9 +401,20 @@ private:
 
         bool colorMatrixChanged = true;
         mat4 colorMatrix;
+        android_color_transform_t colorMatrixHint = HAL_COLOR_TRANSFORM_IDENTITY;
 
         void traverseInZOrder(const LayerVector::Visitor& visitor) const;
         void traverseInReverseZOrder(const LayerVector::Visitor& visitor) const;
+
+        // Flattens the layer tree in z order, so that traversals until the
+        // next assignment walk an array instead of the tree. Only valid while
+        // the hierarchy and z order don't change, i.e. for mDrawingState
+        // between transaction commits.
+        void flattenZOrder();
+
+    private:
+        std::vector<sp<Layer>> layersInZOrder;
+        bool layersInZOrderValid = false;
     };
 
     /* ------------------------------------------------------------------------
@@ -580,6 +610,9 @@ private:
     bool flushTransactionQueues();
     // Returns true if there is at least one transaction that needs to be flushed
     bool transactionFlushNeeded();
+    // Arranges for the transaction queues to be flushed again once the first
+    // pending transaction may have become ready, rather than on every frame
+    void scheduleTransactionFlush();
     uint32_t getTransactionFlags(uint32_t flags);
     uint32_t peekTransactionFlags();
     // Can only be called from the main thread or with mStateLock held
@@ -591,6 +624,9 @@ private:
     bool containsAnyInvalidClientState(const Vector<ComposerState>& states);
     bool transactionIsReadyToBeApplied(int64_t desiredPresentTime,
                                        const Vector<ComposerState>& states);
+    // When a transaction which isn't ready should be looked at again; 0 for
+    // the next frame
+    nsecs_t transactionRetryTime(int64_t desiredPresentTime, const Vector<ComposerState>& states);
     uint32_t setClientStateLocked(const ComposerState& composerState, int64_t desiredPresentTime,
                                   const std::vector<ListenerCallbacks>& listenerCallbacks,
                                   int64_t postTime, bool privileged) REQUIRES(mStateLock);
@@ -636,6 +672,21 @@ private:
                             const sp<IGraphicBufferProducer>& gbc, const sp<Layer>& lbc,
                             const sp<IBinder>& parentHandle, const sp<Layer>& parentLayer,
                             bool addToCurrentState);
+    status_t addClientLayerLocked(const sp<IBinder>& handle, const sp<IGraphicBufferProducer>& gbc,
+                                  const sp<Layer>& lbc, const sp<IBinder>& parentHandle,
+                                  const sp<Layer>& parentLayer, bool addToCurrentState)
+            REQUIRES(mStateLock);
+
+    // Like addClientLayer, but only attaches the layer to its client, leaving
+    // its insertion into the layer tree to the next commit of pending layers,
+    // so that creating it doesn't wait for mStateLock.
+    status_t addClientLayerDeferred(const sp<Client>& client, const sp<IBinder>& handle,
+                                    const sp<Layer>& lbc, const sp<IBinder>& parentHandle,
+                                    const sp<Layer>& parentLayer, bool addToCurrentState);
+
+    // Inserts the layers added by addClientLayerDeferred into the layer tree.
+    // Called before anything depending on the tree being up to date happens.
+    void commitPendingLayerAdditionsLocked() REQUIRES(mStateLock);
 
     // Traverse through all the layers and compute and cache its bounds.
     void computeLayerBounds();
@@ -648,6 +699,11 @@ private:
 
     using TraverseLayersFunction = std::function<void(const LayerVector::Visitor&)>;
 
+    // Sets up what renderScreenImplLocked draws, which needs no SurfaceFlinger state after that.
+    void prepareScreenImplLocked(const RenderArea& renderArea,
+                                 TraverseLayersFunction traverseLayers, bool useIdentityTransform,
+                                 renderengine::DisplaySettings* outDisplay,
+                                 std::vector<renderengine::LayerSettings>* outLayers);
     void renderScreenImplLocked(const RenderArea& renderArea, TraverseLayersFunction traverseLayers,
                                 ANativeWindowBuffer* buffer, bool useIdentityTransform,
                                 int* outSyncFd);
@@ -662,6 +718,9 @@ private:
                                      TraverseLayersFunction traverseLayers,
                                      ANativeWindowBuffer* buffer, bool useIdentityTransform,
                                      bool forSystem, int* outSyncFd, bool& outCapturedSecureLayers);
+    // Whether the caller may capture the layers, secure ones being for the system only.
+    status_t checkCaptureAllowedLocked(TraverseLayersFunction traverseLayers, bool forSystem,
+                                       bool& outCapturedSecureLayers);
     void traverseLayersInDisplay(const sp<const DisplayDevice>& display,
                                  const LayerVector::Visitor& visitor);
 
@@ -756,14 +815,63 @@ private:
     void computeVisibleRegions(const sp<const DisplayDevice>& display, Region& dirtyRegion,
                                Region& opaqueRegion);
 
+    // Everything computeVisibleRegions() derives a layer's visibility from,
+    // besides the layers above it.
+    struct VisibleRegionInputs {
+        Rect bounds;
+        ui::Transform transform;
+        Region activeTransparentRegion;
+        bool translucent = false;
+        bool opaque = false;
+
+        bool operator==(const VisibleRegionInputs& rhs) const;
+    };
+
+    // What computeVisibleRegions() computed for a layer on the last pass over
+    // a display, and the state of the layers above it at the time. If none of
+    // it changed, the result still holds and the layer can be skipped.
+    struct VisibleRegionCacheEntry {
+        uint64_t generation = 0;
+        VisibleRegionInputs inputs;
+        Region aboveOpaqueLayers;
+        Region aboveCoveredLayers;
+        Region aboveOpaqueLayersAfter;
+        Region aboveCoveredLayersAfter;
+        Region visibleRegion;
+        Region coveredRegion;
+        Region visibleNonTransparentRegion;
+    };
+
+    struct VisibleRegionCache {
+        uint64_t generation = 0;
+        std::unordered_map<const Layer*, VisibleRegionCacheEntry> entries;
+    };
+
+    // What was redrawn into the last few client target buffers of a display,
+    // and what they were drawn from. Any change to the latter means the whole
+    // buffer has to be redrawn.
+    struct ClientTargetDamageHistory {
+        static constexpr size_t kMaxFrames = 4;
+        // Most recent first, in physical display space
+        std::deque<Region> frames;
+        std::vector<std::pair<const Layer*, Hwc2::IComposerClient::Composition>> layers;
+        mat4 colorTransform;
+        ui::Dataspace outputDataspace = ui::Dataspace::UNKNOWN;
+        bool isProtected = false;
+    };
+
     void preComposition();
     void postComposition();
+    // Frees the unshown buffers of layers that have been offscreen or invisible for a while
+    void reclaimIdleLayerBuffers(nsecs_t now);
     void getCompositorTiming(CompositorTiming* compositorTiming);
     void updateCompositorTiming(const DisplayStatInfo& stats, nsecs_t compositeTime,
                                 std::shared_ptr<FenceTime>& presentFenceTime);
     void setCompositorTimingSnapped(const DisplayStatInfo& stats,
                                     nsecs_t compositeToPresentLatency);
     void rebuildLayerStacks();
+    // mDisplays, primary display first and virtual displays last
+    std::vector<sp<DisplayDevice>> getDisplaysInCompositionOrder() const;
 
     ui::Dataspace getBestDataspace(const sp<DisplayDevice>& display, ui::Dataspace* outHdrDataSpace,
                                    bool* outIsHdrClientComposition) const;
@@ -775,6 +883,15 @@ private:
                        ui::Dataspace* outDataSpace, ui::RenderIntent* outRenderIntent) const;
 
     void calculateWorkingSet();
+    // Flattens the display's layers which stopped changing into one cached
+    // buffer, once the per-frame state of its layers is written to HWC.
+    void updateLayerCaching(const sp<DisplayDevice>& display);
+    // Returns the buffer a new run is to be rendered into, or nullopt while it is still
+    // being allocated off the main thread.
+    std::optional<sp<GraphicBuffer>> takeLayerCacheBuffer(const sp<DisplayDevice>& display);
+    bool renderFlattenedLayers(const sp<DisplayDevice>& display,
+                               compositionengine::impl::Flattener& flattener,
+                               const sp<GraphicBuffer>& buffer);
     /*
      * beginFrame - This function handles any pre-frame processing that needs to be
      * prior to any CompositionInfo handling and is not dependent on data in
@@ -786,7 +903,14 @@ private:
      * to prepare the hardware composer
      */
     void prepareFrame(const sp<DisplayDevice>& display);
-    void doComposition(const sp<DisplayDevice>& display, bool repainEverything);
+    // Reports how long drawing with RenderEngine took. The present on HWC is
+    // queued, and completed by onDisplayPresented.
+    void doComposition(const sp<DisplayDevice>& display, bool repainEverything,
+                       nsecs_t* outRenderEngineDuration);
+    // Passes how long each stage of presenting a frame on a display took to TimeStats
+    void recordFrameStages(const sp<DisplayDevice>& display, nsecs_t compositionStrategyDuration,
+                           nsecs_t renderEngineDuration, nsecs_t hwcPresentDuration,
+                           nsecs_t presentTime);
     void doDebugFlashRegions(const sp<DisplayDevice>& display, bool repaintEverything);
     void logLayerStats();
     void doDisplayComposition(const sp<DisplayDevice>& display, const Region& dirtyRegion);
@@ -795,9 +919,16 @@ private:
     // will be populated if using GL and native fence sync is supported, to
     // signal when drawing has completed.
     bool doComposeSurfaces(const sp<DisplayDevice>& display, const Region& debugRegionm,
-                           base::unique_fd* readyFence);
+                           const Region& dirtyRegion, base::unique_fd* readyFence);
+    // What of the client target buffer just dequeued holds stale content,
+    // given what changed this frame. Empty when all of it has to be redrawn.
+    Region getClientTargetDamage(const sp<DisplayDevice>& display, const Region& dirtyRegion,
+                                 const renderengine::DisplaySettings& settings,
+                                 bool forceFullRedraw);
 
     void postFramebuffer(const sp<DisplayDevice>& display);
+    // Passes the release fences of the frame just presented on the display on to its layers
+    void onDisplayPresented(const sp<DisplayDevice>& display);
     void postFrame();
     void drawWormhole(const Region& region) const;
 
@@ -886,17 +1017,29 @@ private:
         return std::bind(dump, this, _1, _2, _3);
     }
 
-    void dumpAllLocked(const DumpArgs& args, std::string& result) const REQUIRES(mStateLock);
+    // Dumps everything but the layer tree, which is copied into layersProto for the caller to
+    // format at layersPos in result once it releases mStateLock.
+    void dumpAllLocked(const DumpArgs& args, std::string& result, LayersProto* layersProto,
+                       size_t* layersPos) const REQUIRES(mStateLock);
+    // For dumpsys --proto-only, drops the layers unchanged since the last such dump and lists
+    // the ones removed since.
+    void removeUnchangedLayers(LayersProto* layersProto) EXCLUDES(mIncrementalDumpMutex);
 
     void appendSfConfigString(std::string& result) const;
     void listLayersLocked(std::string& result) const;
     void dumpStatsLocked(const DumpArgs& args, std::string& result) const REQUIRES(mStateLock);
     void clearStatsLocked(const DumpArgs& args, std::string& result);
+    void dumpPresentIntervalsLocked(const DumpArgs& args, std::string& result) const
+            REQUIRES(mStateLock);
+    void dumpLayerMemoryLocked(std::string& result) const REQUIRES(mStateLock);
     void dumpTimeStats(const DumpArgs& args, bool asProto, std::string& result) const;
+    void dumpBinderLatency(const DumpArgs& args, std::string& result) const;
+    void dumpBinderCallerStats(const DumpArgs& args, std::string& result) const;
     void logFrameStats();
 
     void dumpVSync(std::string& result) const REQUIRES(mStateLock);
     void dumpStaticScreenStats(std::string& result) const;
+    void dumpInitStagesLocked(std::string& result) const REQUIRES(mStateLock);
     // Not const because each Layer needs to query Fences and cache timestamps.
     void dumpFrameEventsLocked(std::string& result);
 
@@ -906,7 +1049,7 @@ private:
     void dumpDisplayIdentificationData(std::string& result) const;
     void dumpWideColorInfo(std::string& result) const;
     LayersProto dumpProtoInfo(LayerVector::StateSet stateSet,
-                              uint32_t traceFlags = SurfaceTracing::TRACE_ALL) const;
+                              uint32_t traceFlags = SurfaceTracing::TRACE_DUMP) const;
     void withTracingLock(std::function<void()> operation) REQUIRES(mStateLock);
     LayersProto dumpVisibleLayersProtoInfo(const sp<DisplayDevice>& display) const;
 
@@ -951,6 +1094,11 @@ private:
     // guards access to the mDrawing state if tracing is enabled.
     mutable std::mutex mDrawingStateLock;
 
+    // Hash of each layer's proto as of the last dumpsys --proto-only
+    std::mutex mIncrementalDumpMutex;
+    std::unordered_map<int32_t, size_t> mIncrementalDumpLayerHashes
+            GUARDED_BY(mIncrementalDumpMutex);
+
     // global color transform states
     Daltonizer mDaltonizer;
     float mGlobalSaturationFactor = 1.0f;
@@ -959,6 +1107,12 @@ private:
     // Can't be unordered_set because wp<> isn't hashable
     std::set<wp<IBinder>> mGraphicBufferProducerList;
     size_t mMaxGraphicBufferProducerListSize = MAX_LAYERS;
+    // HWC cache slots each BufferStateLayer cycles its buffers through
+    uint32_t mBufferStateLayerHwcSlots = BufferQueue::NUM_BUFFER_SLOTS;
+    // How long layers stay offscreen or invisible before the buffers they do
+    // not show are freed, or 0 to keep them. Only used by the main thread.
+    nsecs_t mLayerReclaimTimeout = 0;
+    nsecs_t mLastLayerReclaimCheck = 0;
 
     // protected by mStateLock (but we could use another lock)
     bool mLayersRemoved = false;
@@ -981,6 +1135,19 @@ private:
     // don't need synchronization
     State mDrawingState{LayerVector::StateSet::Drawing};
     bool mVisibleRegionsDirty = false;
+    // Per display results of computeVisibleRegions(), dropped on display changes
+    std::map<wp<IBinder>, VisibleRegionCache> mVisibleRegionCaches;
+    // Per HWC display layer caching state, dropped on display changes
+    bool mLayerCachingEnabled = false;
+    std::map<wp<IBinder>, compositionengine::impl::Flattener> mLayerFlatteners;
+    // Layer cache buffers being allocated for the next run, per HWC display. Dropping one
+    // while it is still pending waits for that allocation to finish.
+    std::map<wp<IBinder>, std::future<sp<GraphicBuffer>>> mLayerCacheAllocations;
+    // Per display client target damage, dropped on display changes
+    std::map<wp<IBinder>, ClientTargetDamageHistory> mClientTargetDamageHistories;
+    // Per display requests drawn into the client target buffers, dropped on display changes
+    std::map<wp<IBinder>, compositionengine::impl::ClientCompositionRequestCache>
+            mClientCompositionRequestCaches;
     // Set during transaction commit stage to track if the input info for a layer has changed.
     bool mInputInfoChanged = false;
     bool mGeometryInvalid = false;
@@ -1003,6 +1170,14 @@ private:
     };
     BootStage mBootStage = BootStage::BOOTLOADER;
 
+    // The stages of init, some of which overlap
+    struct InitStage {
+        const char* name;
+        nsecs_t start; // Since the start of init
+        nsecs_t duration;
+    };
+    std::vector<InitStage> mInitStages GUARDED_BY(mStateLock);
+
     struct HotplugEvent {
         hwc2_display_t hwcDisplayId;
         HWC2::Connection connection = HWC2::Connection::Invalid;
@@ -1018,6 +1193,18 @@ private:
     // protected by mStateLock
     std::unordered_map<BBinder*, wp<Layer>> mLayersByLocalBinderToken;
 
+    struct PendingLayerAddition {
+        sp<IBinder> handle;
+        sp<Layer> layer;
+        sp<IBinder> parentHandle;
+        sp<Layer> parentLayer;
+        bool addToCurrentState;
+    };
+    std::mutex mPendingLayerAdditionsMutex;
+    std::vector<PendingLayerAddition> mPendingLayerAdditions
+            GUARDED_BY(mPendingLayerAdditionsMutex);
+    std::atomic<bool> mHasPendingLayerAdditions = false;
+
     // don't use a lock for these, we don't care
     int mDebugRegion = 0;
     bool mDebugDisableHWC = false;
@@ -1033,9 +1220,24 @@ private:
     LayerStats mLayerStats;
     const std::shared_ptr<TimeStats> mTimeStats;
     bool mUseHwcVirtualDisplays = false;
+    // Whether virtual displays whose sink is a video encoder use HWC writeback
+    bool mUseHwcVirtualDisplaysForEncoder = true;
     std::atomic<uint32_t> mFrameMissedCount = 0;
     std::atomic<uint32_t> mHwcFrameMissedCount = 0;
     std::atomic<uint32_t> mGpuFrameMissedCount = 0;
+    std::atomic<uint32_t> mPredictedFrameMissedCount = 0;
+    // CPU waits on fences by the main thread, in total and in the frame being composited, which
+    // were done by SF itself or added to the RenderEngine count since the last frame.
+    std::atomic<uint32_t> mBlockingWaitCount = 0;
+    uint32_t mFrameBlockingWaitCount = 0;
+    uint32_t mRenderEngineBlockingWaitCount = 0;
+    // Main thread time spent applying transactions and latching buffers for the next frame
+    nsecs_t mTransactionApplyDuration = 0;
+    nsecs_t mLatchDuration = 0;
+    scheduler::FrameDeadlinePredictor mFrameDeadlinePredictor;
+    FrameProfiler mFrameProfiler;
+    // Times the screen went static for long enough for the Scheduler to park VSYNC
+    std::atomic<uint32_t> mDeepIdleCount = 0;
 
     TransactionCompletedThread mTransactionCompletedThread;
 
@@ -1081,6 +1283,12 @@ private:
                 postTime(postTime),
                 privileged(privileged) {}
 
+        // Whether next, queued right behind this transaction, only sets layer
+        // properties which applying it right after this one would simply
+        // overwrite, so that the two can be applied as one.
+        bool canCoalesce(const TransactionState& next) const;
+        void coalesce(const TransactionState& next);
+
         Vector<ComposerState> states;
         Vector<DisplayState> displays;
         uint32_t flags;
@@ -1091,6 +1299,11 @@ private:
         bool privileged;
     };
     std::unordered_map<sp<IBinder>, std::queue<TransactionState>, IBinderHash> mTransactionQueues;
+    // Main thread only: when the last flushTransactionQueues() found the
+    // transaction queues need looking at again, and the time of the last
+    // delayed wakeup posted for that.
+    nsecs_t mNextTransactionFlushTime = 0;
+    nsecs_t mScheduledTransactionFlushTime = 0;
 
     /* ------------------------------------------------------------------------
      * Feature prototyping
@@ -1141,6 +1354,10 @@ private:
     std::unique_ptr<scheduler::RefreshRateConfigs> mRefreshRateConfigs;
     std::unique_ptr<scheduler::RefreshRateStats> mRefreshRateStats;
 
+    // Gives the pooled gralloc buffers back once no frame has been composed
+    // for a while. Only there when debug.sf.gralloc_pool_size is set.
+    std::unique_ptr<scheduler::IdleTimer> mGrallocPoolIdleTimer;
+
     // All configs are allowed if the set is empty.
     using DisplayConfigs = std::set<int32_t>;
     DisplayConfigs mAllowedDisplayConfigs GUARDED_BY(mStateLock);
@@ -1165,6 +1382,8 @@ private:
     InputWindowCommands mPendingInputWindowCommands GUARDED_BY(mStateLock);
     // Should only be accessed by the main thread.
     InputWindowCommands mInputWindowCommands;
+    // The window list last sent to InputFlinger. Main thread only.
+    std::vector<InputWindowInfo> mLastInputWindowInfos;
 
     struct SetInputWindowsListener : BnSetInputWindowsListener {
         explicit SetInputWindowsListener(sp<SurfaceFlinger> flinger)
@@ -21,8 +21,13 @@
 #include "SurfaceFlinger.h"
 #include "SurfaceInterceptor.h"
 
+#include <algorithm>
+#include <array>
+#include <chrono>
 #include <fstream>
 
+#include <pthread.h>
+
 #include <android-base/file.h>
 #include <log/log.h>
 #include <utils/Trace.h>
@@ -36,11 +41,61 @@ SurfaceInterceptor::~SurfaceInterceptor() = default;
 
 namespace impl {
 
+namespace {
+
+// How often the writer thread adds the captures to the trace
+constexpr auto kWriterInterval = std::chrono::milliseconds(5);
+
+std::atomic<uint64_t> sNextInstanceId{1};
+
+} // namespace
+
+class SurfaceInterceptor::CaptureBuffer {
+public:
+    // Only called by the thread the buffer belongs to
+    bool push(Capture&& capture) {
+        const size_t head = mHead.load(std::memory_order_relaxed);
+        const size_t next = (head + 1) % kCapacity;
+        if (next == mTail.load(std::memory_order_acquire)) {
+            return false;
+        }
+        mCaptures[head] = std::move(capture);
+        mHead.store(next, std::memory_order_release);
+        return true;
+    }
+
+    // Only called with mTraceMutex held, by one thread at a time
+    template <typename F>
+    void drain(F&& f) {
+        size_t tail = mTail.load(std::memory_order_relaxed);
+        const size_t head = mHead.load(std::memory_order_acquire);
+        while (tail != head) {
+            f(std::move(mCaptures[tail]));
+            mCaptures[tail] = Capture();
+            tail = (tail + 1) % kCapacity;
+        }
+        mTail.store(tail, std::memory_order_release);
+    }
+
+private:
+    // Several frames worth of transactions and buffer updates
+    static constexpr size_t kCapacity = 1024;
+
+    std::array<Capture, kCapacity> mCaptures;
+    std::atomic<size_t> mHead{0};
+    std::atomic<size_t> mTail{0};
+};
+
 SurfaceInterceptor::SurfaceInterceptor(SurfaceFlinger* flinger)
-    :   mFlinger(flinger)
+    :   mFlinger(flinger),
+        mInstanceId(sNextInstanceId++)
 {
 }
 
+SurfaceInterceptor::~SurfaceInterceptor() {
+    stopWriter();
+}
+
 void SurfaceInterceptor::enable(const SortedVector<sp<Layer>>& layers,
         const DefaultKeyedVector< wp<IBinder>, DisplayDeviceState>& displays)
 {
@@ -48,10 +103,16 @@ void SurfaceInterceptor::enable(const SortedVector<sp<Layer>>& layers,
         return;
     }
     ATRACE_CALL();
+    {
+        std::lock_guard<std::mutex> protoGuard(mTraceMutex);
+        // What was captured while a previous trace was being written out
+        discardCaptures();
+        mDroppedCaptures = 0;
+        saveExistingDisplaysLocked(displays);
+        saveExistingSurfacesLocked(layers);
+    }
     mEnabled = true;
-    std::lock_guard<std::mutex> protoGuard(mTraceMutex);
-    saveExistingDisplaysLocked(displays);
-    saveExistingSurfacesLocked(layers);
+    startWriter();
 }
 
 void SurfaceInterceptor::disable() {
@@ -59,8 +120,12 @@ void SurfaceInterceptor::disable() {
         return;
     }
     ATRACE_CALL();
-    std::lock_guard<std::mutex> protoGuard(mTraceMutex);
     mEnabled = false;
+    stopWriter();
+    std::lock_guard<std::mutex> protoGuard(mTraceMutex);
+    writeCapturesLocked();
+    ALOGW_IF(mDroppedCaptures > 0, "Dropped %u increments, the capture buffers were full",
+             mDroppedCaptures.load());
     status_t err(writeProtoFileLocked());
     ALOGE_IF(err == PERMISSION_DENIED, "Could not save the proto file! Permission denied");
     ALOGE_IF(err == NOT_ENOUGH_DATA, "Could not save the proto file! There are missing fields");
@@ -71,6 +136,92 @@ bool SurfaceInterceptor::isEnabled() {
     return mEnabled;
 }
 
+SurfaceInterceptor::CaptureBuffer* SurfaceInterceptor::getCaptureBuffer() {
+    struct ThreadCaptureBuffer {
+        uint64_t instanceId = 0;
+        CaptureBuffer* buffer = nullptr;
+    };
+    thread_local ThreadCaptureBuffer threadBuffer;
+
+    if (threadBuffer.instanceId != mInstanceId) {
+        std::lock_guard<std::mutex> lock(mCaptureBuffersMutex);
+        mCaptureBuffers.push_back(std::make_unique<CaptureBuffer>());
+        threadBuffer.instanceId = mInstanceId;
+        threadBuffer.buffer = mCaptureBuffers.back().get();
+    }
+    return threadBuffer.buffer;
+}
+
+void SurfaceInterceptor::capture(std::function<void(Increment*)>&& write) {
+    if (!getCaptureBuffer()->push({systemTime(), std::move(write)})) {
+        mDroppedCaptures++;
+    }
+}
+
+void SurfaceInterceptor::startWriter() {
+    std::lock_guard<std::mutex> lock(mWriterMutex);
+    if (mWriterRunning) {
+        return;
+    }
+    mWriterRunning = true;
+    mWriterThread = std::thread(&SurfaceInterceptor::writerMain, this);
+    pthread_setname_np(mWriterThread.native_handle(), "SurfaceIntercept");
+}
+
+void SurfaceInterceptor::stopWriter() {
+    {
+        std::lock_guard<std::mutex> lock(mWriterMutex);
+        mWriterRunning = false;
+    }
+    mWriterCondition.notify_all();
+    if (mWriterThread.joinable()) {
+        mWriterThread.join();
+    }
+}
+
+void SurfaceInterceptor::writerMain() {
+    std::unique_lock<std::mutex> lock(mWriterMutex);
+    while (mWriterRunning) {
+        mWriterCondition.wait_for(lock, kWriterInterval);
+        lock.unlock();
+        {
+            std::lock_guard<std::mutex> protoGuard(mTraceMutex);
+            writeCapturesLocked();
+        }
+        lock.lock();
+    }
+}
+
+void SurfaceInterceptor::writeCapturesLocked() {
+    std::vector<Capture> captures;
+    {
+        std::lock_guard<std::mutex> lock(mCaptureBuffersMutex);
+        for (const auto& buffer : mCaptureBuffers) {
+            buffer->drain([&](Capture&& capture) { captures.push_back(std::move(capture)); });
+        }
+    }
+    if (captures.empty()) {
+        return;
+    }
+    ATRACE_CALL();
+    // Each buffer is in order already, only the threads need interleaving
+    std::stable_sort(captures.begin(), captures.end(), [](const Capture& a, const Capture& b) {
+        return a.timestamp < b.timestamp;
+    });
+    for (auto& capture : captures) {
+        Increment* increment(mTrace.add_increment());
+        increment->set_time_stamp(capture.timestamp);
+        capture.write(increment);
+    }
+}
+
+void SurfaceInterceptor::discardCaptures() {
+    std::lock_guard<std::mutex> lock(mCaptureBuffersMutex);
+    for (const auto& buffer : mCaptureBuffers) {
+        buffer->drain([](Capture&&) {});
+    }
+}
+
 void SurfaceInterceptor::saveExistingDisplaysLocked(
         const DefaultKeyedVector< wp<IBinder>, DisplayDeviceState>& displays)
 {
@@ -86,7 +237,9 @@ void SurfaceInterceptor::saveExistingSurfacesLocked(const SortedVector<sp<Layer>
     ATRACE_CALL();
     for (const auto& l : layers) {
         l->traverseInZOrder(LayerVector::StateSet::Drawing, [this](Layer* layer) {
-            addSurfaceCreationLocked(createTraceIncrementLocked(), layer);
+            addSurfaceCreationLocked(createTraceIncrementLocked(), getLayerId(layer),
+                                     getLayerName(layer), layer->mCurrentState.active_legacy.w,
+                                     layer->mCurrentState.active_legacy.h);
             addInitialSurfaceStateLocked(createTraceIncrementLocked(), layer);
         });
     }
@@ -111,8 +264,9 @@ void SurfaceInterceptor::addInitialSurfaceStateLocked(Increment* increment,
     addCropLocked(transaction, layerId, layer->mCurrentState.crop_legacy);
     addCornerRadiusLocked(transaction, layerId, layer->mCurrentState.cornerRadius);
     if (layer->mCurrentState.barrierLayer_legacy != nullptr) {
+        const sp<const Layer> barrierLayer(layer->mCurrentState.barrierLayer_legacy.promote());
         addDeferTransactionLocked(transaction, layerId,
-                                  layer->mCurrentState.barrierLayer_legacy.promote(),
+                                  barrierLayer != nullptr ? getLayerId(barrierLayer) : -1,
                                   layer->mCurrentState.frameNumber_legacy);
     }
     addOverrideScalingModeLocked(transaction, layerId, layer->getEffectiveScalingMode());
@@ -126,7 +280,11 @@ void SurfaceInterceptor::addInitialDisplayStateLocked(Increment* increment,
     transaction->set_synchronous(false);
     transaction->set_animation(false);
 
-    addDisplaySurfaceLocked(transaction, display.sequenceId, display.surface);
+    uint64_t bufferQueueId = 0;
+    std::string bufferQueueName;
+    if (resolveDisplaySurface(display.surface, &bufferQueueId, &bufferQueueName)) {
+        addDisplaySurfaceLocked(transaction, display.sequenceId, bufferQueueId, bufferQueueName);
+    }
     addDisplayLayerStackLocked(transaction, display.sequenceId, display.layerStack);
     addDisplaySizeLocked(transaction, display.sequenceId, display.width, display.height);
     addDisplayProjectionLocked(transaction, display.sequenceId, display.orientation,
@@ -299,16 +457,16 @@ void SurfaceInterceptor::addCornerRadiusLocked(Transaction* transaction, int32_t
 }
 
 void SurfaceInterceptor::addDeferTransactionLocked(Transaction* transaction, int32_t layerId,
-        const sp<const Layer>& layer, uint64_t frameNumber)
+        int32_t barrierLayerId, uint64_t frameNumber)
 {
     SurfaceChange* change(createSurfaceChangeLocked(transaction, layerId));
-    if (layer == nullptr) {
+    if (barrierLayerId < 0) {
         ALOGE("An existing layer could not be retrieved with the handle"
                 " for the deferred transaction");
         return;
     }
     DeferredTransactionChange* deferTransaction(change->mutable_deferred_transaction());
-    deferTransaction->set_layer_id(getLayerId(layer));
+    deferTransaction->set_layer_id(barrierLayerId);
     deferTransaction->set_frame_number(frameNumber);
 }
 
@@ -320,18 +478,59 @@ void SurfaceInterceptor::addOverrideScalingModeLocked(Transaction* transaction,
     overrideChange->set_override_scaling_mode(overrideScalingMode);
 }
 
-void SurfaceInterceptor::addSurfaceChangesLocked(Transaction* transaction,
-        const layer_state_t& state)
+bool SurfaceInterceptor::resolveSurfaceChanges(const layer_state_t& state,
+        SurfaceChanges* outChanges)
 {
     const sp<const Layer> layer(getLayer(state.surface));
     if (layer == nullptr) {
         ALOGE("An existing layer could not be retrieved with the surface "
                 "from the layer_state_t surface in the update transaction");
-        return;
+        return false;
     }
+    outChanges->layerId = getLayerId(layer);
+    outChanges->barrierLayerId = -1;
 
-    const int32_t layerId(getLayerId(layer));
+    if (state.what & layer_state_t::eDeferTransaction_legacy) {
+        sp<Layer> otherLayer = nullptr;
+        if (state.barrierHandle_legacy != nullptr) {
+            otherLayer =
+                    static_cast<Layer::Handle*>(state.barrierHandle_legacy.get())->owner.promote();
+        } else if (state.barrierGbp_legacy != nullptr) {
+            auto const& gbp = state.barrierGbp_legacy;
+            if (mFlinger->authenticateSurfaceTextureLocked(gbp)) {
+                otherLayer = (static_cast<MonitoredProducer*>(gbp.get()))->getLayer();
+            } else {
+                ALOGE("Attempt to defer transaction to to an unrecognized GraphicBufferProducer");
+            }
+        }
+        if (otherLayer != nullptr) {
+            outChanges->barrierLayerId = getLayerId(otherLayer);
+        }
+    }
 
+    // Only the values addSurfaceChangesLocked records
+    layer_state_t& traced(outChanges->state);
+    traced.what = state.what;
+    traced.x = state.x;
+    traced.y = state.y;
+    traced.z = state.z;
+    traced.w = state.w;
+    traced.h = state.h;
+    traced.alpha = state.alpha;
+    traced.matrix = state.matrix;
+    traced.transparentRegion = state.transparentRegion;
+    traced.flags = state.flags;
+    traced.layerStack = state.layerStack;
+    traced.crop_legacy = state.crop_legacy;
+    traced.cornerRadius = state.cornerRadius;
+    traced.frameNumber_legacy = state.frameNumber_legacy;
+    traced.overrideScalingMode = state.overrideScalingMode;
+    return true;
+}
+
+void SurfaceInterceptor::addSurfaceChangesLocked(Transaction* transaction, int32_t layerId,
+        int32_t barrierLayerId, const layer_state_t& state)
+{
     if (state.what & layer_state_t::ePositionChanged) {
         addPositionLocked(transaction, layerId, state.x, state.y);
     }
@@ -363,19 +562,7 @@ void SurfaceInterceptor::addSurfaceChangesLocked(Transaction* transaction,
         addCornerRadiusLocked(transaction, layerId, state.cornerRadius);
     }
     if (state.what & layer_state_t::eDeferTransaction_legacy) {
-        sp<Layer> otherLayer = nullptr;
-        if (state.barrierHandle_legacy != nullptr) {
-            otherLayer =
-                    static_cast<Layer::Handle*>(state.barrierHandle_legacy.get())->owner.promote();
-        } else if (state.barrierGbp_legacy != nullptr) {
-            auto const& gbp = state.barrierGbp_legacy;
-            if (mFlinger->authenticateSurfaceTextureLocked(gbp)) {
-                otherLayer = (static_cast<MonitoredProducer*>(gbp.get()))->getLayer();
-            } else {
-                ALOGE("Attempt to defer transaction to to an unrecognized GraphicBufferProducer");
-            }
-        }
-        addDeferTransactionLocked(transaction, layerId, otherLayer, state.frameNumber_legacy);
+        addDeferTransactionLocked(transaction, layerId, barrierLayerId, state.frameNumber_legacy);
     }
     if (state.what & layer_state_t::eOverrideScalingModeChanged) {
         addOverrideScalingModeLocked(transaction, layerId, state.overrideScalingMode);
@@ -383,10 +570,13 @@ void SurfaceInterceptor::addSurfaceChangesLocked(Transaction* transaction,
 }
 
 void SurfaceInterceptor::addDisplayChangesLocked(Transaction* transaction,
-        const DisplayState& state, int32_t sequenceId)
+        const DisplayChanges& changes)
 {
-    if (state.what & DisplayState::eSurfaceChanged) {
-        addDisplaySurfaceLocked(transaction, sequenceId, state.surface);
+    const DisplayState& state(changes.state);
+    const int32_t sequenceId(changes.sequenceId);
+    if ((state.what & DisplayState::eSurfaceChanged) && changes.hasSurface) {
+        addDisplaySurfaceLocked(transaction, sequenceId, changes.bufferQueueId,
+                changes.bufferQueueName);
     }
     if (state.what & DisplayState::eLayerStackChanged) {
         addDisplayLayerStackLocked(transaction, sequenceId, state.layerStack);
@@ -400,48 +590,26 @@ void SurfaceInterceptor::addDisplayChangesLocked(Transaction* transaction,
     }
 }
 
-void SurfaceInterceptor::addTransactionLocked(Increment* increment,
-        const Vector<ComposerState>& stateUpdates,
-        const DefaultKeyedVector< wp<IBinder>, DisplayDeviceState>& displays,
-        const Vector<DisplayState>& changedDisplays, uint32_t transactionFlags)
-{
-    Transaction* transaction(increment->mutable_transaction());
-    transaction->set_synchronous(transactionFlags & BnSurfaceComposer::eSynchronous);
-    transaction->set_animation(transactionFlags & BnSurfaceComposer::eAnimation);
-    for (const auto& compState: stateUpdates) {
-        addSurfaceChangesLocked(transaction, compState.state);
-    }
-    for (const auto& disp: changedDisplays) {
-        ssize_t dpyIdx = displays.indexOfKey(disp.token);
-        if (dpyIdx >= 0) {
-            const DisplayDeviceState& dispState(displays.valueAt(dpyIdx));
-            addDisplayChangesLocked(transaction, disp, dispState.sequenceId);
-        }
-    }
-}
-
-void SurfaceInterceptor::addSurfaceCreationLocked(Increment* increment,
-        const sp<const Layer>& layer)
+void SurfaceInterceptor::addSurfaceCreationLocked(Increment* increment, int32_t layerId,
+        const std::string& name, uint32_t w, uint32_t h)
 {
     SurfaceCreation* creation(increment->mutable_surface_creation());
-    creation->set_id(getLayerId(layer));
-    creation->set_name(getLayerName(layer));
-    creation->set_w(layer->mCurrentState.active_legacy.w);
-    creation->set_h(layer->mCurrentState.active_legacy.h);
+    creation->set_id(layerId);
+    creation->set_name(name);
+    creation->set_w(w);
+    creation->set_h(h);
 }
 
-void SurfaceInterceptor::addSurfaceDeletionLocked(Increment* increment,
-        const sp<const Layer>& layer)
-{
+void SurfaceInterceptor::addSurfaceDeletionLocked(Increment* increment, int32_t layerId) {
     SurfaceDeletion* deletion(increment->mutable_surface_deletion());
-    deletion->set_id(getLayerId(layer));
+    deletion->set_id(layerId);
 }
 
-void SurfaceInterceptor::addBufferUpdateLocked(Increment* increment, const sp<const Layer>& layer,
+void SurfaceInterceptor::addBufferUpdateLocked(Increment* increment, int32_t layerId,
         uint32_t width, uint32_t height, uint64_t frameNumber)
 {
     BufferUpdate* update(increment->mutable_buffer_update());
-    update->set_id(getLayerId(layer));
+    update->set_id(layerId);
     update->set_w(width);
     update->set_h(height);
     update->set_frame_number(frameNumber);
@@ -452,24 +620,29 @@ void SurfaceInterceptor::addVSyncUpdateLocked(Increment* increment, nsecs_t time
     event->set_when(timestamp);
 }
 
-void SurfaceInterceptor::addDisplaySurfaceLocked(Transaction* transaction, int32_t sequenceId,
-        const sp<const IGraphicBufferProducer>& surface)
+bool SurfaceInterceptor::resolveDisplaySurface(const sp<const IGraphicBufferProducer>& surface,
+        uint64_t* outBufferQueueId, std::string* outBufferQueueName)
 {
     if (surface == nullptr) {
-        return;
+        return false;
     }
-    uint64_t bufferQueueId = 0;
-    status_t err(surface->getUniqueId(&bufferQueueId));
-    if (err == NO_ERROR) {
-        DisplayChange* dispChange(createDisplayChangeLocked(transaction, sequenceId));
-        DispSurfaceChange* surfaceChange(dispChange->mutable_surface());
-        surfaceChange->set_buffer_queue_id(bufferQueueId);
-        surfaceChange->set_buffer_queue_name(surface->getConsumerName().string());
-    }
-    else {
+    status_t err(surface->getUniqueId(outBufferQueueId));
+    if (err != NO_ERROR) {
         ALOGE("invalid graphic buffer producer received while tracing a display change (%s)",
                 strerror(-err));
+        return false;
     }
+    *outBufferQueueName = surface->getConsumerName().string();
+    return true;
+}
+
+void SurfaceInterceptor::addDisplaySurfaceLocked(Transaction* transaction, int32_t sequenceId,
+        uint64_t bufferQueueId, const std::string& bufferQueueName)
+{
+    DisplayChange* dispChange(createDisplayChangeLocked(transaction, sequenceId));
+    DispSurfaceChange* surfaceChange(dispChange->mutable_surface());
+    surfaceChange->set_buffer_queue_id(bufferQueueId);
+    surfaceChange->set_buffer_queue_name(bufferQueueName);
 }
 
 void SurfaceInterceptor::addDisplayLayerStackLocked(Transaction* transaction,
@@ -534,9 +707,48 @@ void SurfaceInterceptor::saveTransaction(const Vector<ComposerState>& stateUpdat
         return;
     }
     ATRACE_CALL();
-    std::lock_guard<std::mutex> protoGuard(mTraceMutex);
-    addTransactionLocked(createTraceIncrementLocked(), stateUpdates, displays, changedDisplays,
-            flags);
+    std::vector<SurfaceChanges> surfaceChanges;
+    surfaceChanges.reserve(stateUpdates.size());
+    for (const auto& compState: stateUpdates) {
+        SurfaceChanges changes;
+        if (resolveSurfaceChanges(compState.state, &changes)) {
+            surfaceChanges.push_back(std::move(changes));
+        }
+    }
+    std::vector<DisplayChanges> displayChanges;
+    for (const auto& disp: changedDisplays) {
+        ssize_t dpyIdx = displays.indexOfKey(disp.token);
+        if (dpyIdx < 0) {
+            continue;
+        }
+        DisplayChanges changes;
+        changes.sequenceId = displays.valueAt(dpyIdx).sequenceId;
+        changes.state.what = disp.what;
+        changes.state.layerStack = disp.layerStack;
+        changes.state.orientation = disp.orientation;
+        changes.state.viewport = disp.viewport;
+        changes.state.frame = disp.frame;
+        changes.state.width = disp.width;
+        changes.state.height = disp.height;
+        changes.hasSurface = (disp.what & DisplayState::eSurfaceChanged) &&
+                resolveDisplaySurface(disp.surface, &changes.bufferQueueId,
+                                      &changes.bufferQueueName);
+        displayChanges.push_back(std::move(changes));
+    }
+
+    capture([this, flags, surfaceChanges = std::move(surfaceChanges),
+             displayChanges = std::move(displayChanges)](Increment* increment) {
+        Transaction* transaction(increment->mutable_transaction());
+        transaction->set_synchronous(flags & BnSurfaceComposer::eSynchronous);
+        transaction->set_animation(flags & BnSurfaceComposer::eAnimation);
+        for (const auto& changes : surfaceChanges) {
+            addSurfaceChangesLocked(transaction, changes.layerId, changes.barrierLayerId,
+                    changes.state);
+        }
+        for (const auto& changes : displayChanges) {
+            addDisplayChangesLocked(transaction, changes);
+        }
+    });
 }
 
 void SurfaceInterceptor::saveSurfaceCreation(const sp<const Layer>& layer) {
@@ -544,8 +756,11 @@ void SurfaceInterceptor::saveSurfaceCreation(const sp<const Layer>& layer) {
         return;
     }
     ATRACE_CALL();
-    std::lock_guard<std::mutex> protoGuard(mTraceMutex);
-    addSurfaceCreationLocked(createTraceIncrementLocked(), layer);
+    capture([this, layerId = getLayerId(layer), name = getLayerName(layer),
+             w = layer->mCurrentState.active_legacy.w,
+             h = layer->mCurrentState.active_legacy.h](Increment* increment) {
+        addSurfaceCreationLocked(increment, layerId, name, w, h);
+    });
 }
 
 void SurfaceInterceptor::saveSurfaceDeletion(const sp<const Layer>& layer) {
@@ -553,8 +768,9 @@ void SurfaceInterceptor::saveSurfaceDeletion(const sp<const Layer>& layer) {
         return;
     }
     ATRACE_CALL();
-    std::lock_guard<std::mutex> protoGuard(mTraceMutex);
-    addSurfaceDeletionLocked(createTraceIncrementLocked(), layer);
+    capture([this, layerId = getLayerId(layer)](Increment* increment) {
+        addSurfaceDeletionLocked(increment, layerId);
+    });
 }
 
 void SurfaceInterceptor::saveBufferUpdate(const sp<const Layer>& layer, uint32_t width,
@@ -564,16 +780,18 @@ void SurfaceInterceptor::saveBufferUpdate(const sp<const Layer>& layer, uint32_t
         return;
     }
     ATRACE_CALL();
-    std::lock_guard<std::mutex> protoGuard(mTraceMutex);
-    addBufferUpdateLocked(createTraceIncrementLocked(), layer, width, height, frameNumber);
+    capture([this, layerId = getLayerId(layer), width, height, frameNumber](Increment* increment) {
+        addBufferUpdateLocked(increment, layerId, width, height, frameNumber);
+    });
 }
 
 void SurfaceInterceptor::saveVSyncEvent(nsecs_t timestamp) {
     if (!mEnabled) {
         return;
     }
-    std::lock_guard<std::mutex> protoGuard(mTraceMutex);
-    addVSyncUpdateLocked(createTraceIncrementLocked(), timestamp);
+    capture([this, timestamp](Increment* increment) {
+        addVSyncUpdateLocked(increment, timestamp);
+    });
 }
 
 void SurfaceInterceptor::saveDisplayCreation(const DisplayDeviceState& info) {
@@ -581,8 +799,11 @@ void SurfaceInterceptor::saveDisplayCreation(const DisplayDeviceState& info) {
         return;
     }
     ATRACE_CALL();
-    std::lock_guard<std::mutex> protoGuard(mTraceMutex);
-    addDisplayCreationLocked(createTraceIncrementLocked(), info);
+    DisplayDeviceState traced(info);
+    traced.surface = nullptr;
+    capture([this, info = std::move(traced)](Increment* increment) {
+        addDisplayCreationLocked(increment, info);
+    });
 }
 
 void SurfaceInterceptor::saveDisplayDeletion(int32_t sequenceId) {
@@ -590,8 +811,9 @@ void SurfaceInterceptor::saveDisplayDeletion(int32_t sequenceId) {
         return;
     }
     ATRACE_CALL();
-    std::lock_guard<std::mutex> protoGuard(mTraceMutex);
-    addDisplayDeletionLocked(createTraceIncrementLocked(), sequenceId);
+    capture([this, sequenceId](Increment* increment) {
+        addDisplayDeletionLocked(increment, sequenceId);
+    });
 }
 
 void SurfaceInterceptor::savePowerModeUpdate(int32_t sequenceId, int32_t mode) {
@@ -599,8 +821,9 @@ void SurfaceInterceptor::savePowerModeUpdate(int32_t sequenceId, int32_t mode) {
         return;
     }
     ATRACE_CALL();
-    std::lock_guard<std::mutex> protoGuard(mTraceMutex);
-    addPowerModeUpdateLocked(createTraceIncrementLocked(), sequenceId, mode);
+    capture([this, sequenceId, mode](Increment* increment) {
+        addPowerModeUpdateLocked(increment, sequenceId, mode);
+    });
 }
 
 } // namespace impl
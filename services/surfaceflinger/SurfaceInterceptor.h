@@ -19,7 +19,13 @@
 
 #include <frameworks/native/cmds/surfacereplayer/proto/src/trace.pb.h>
 
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <memory>
 #include <mutex>
+#include <thread>
+#include <vector>
 
 #include <gui/LayerState.h>
 
@@ -76,11 +82,15 @@ namespace impl {
 /*
  * SurfaceInterceptor intercepts and stores incoming streams of window
  * properties on SurfaceFlinger.
+ *
+ * The calling threads only copy what they intercept into a buffer of their own,
+ * without locking. A writer thread drains those buffers every few milliseconds
+ * and adds the increments to the trace.
  */
 class SurfaceInterceptor final : public android::SurfaceInterceptor {
 public:
     explicit SurfaceInterceptor(SurfaceFlinger* const flinger);
-    ~SurfaceInterceptor() override = default;
+    ~SurfaceInterceptor() override;
 
     // Both vectors are used to capture the current state of SF as the initial snapshot in the trace
     void enable(const SortedVector<sp<Layer>>& layers,
@@ -106,6 +116,28 @@ public:
     void saveVSyncEvent(nsecs_t timestamp) override;
 
 private:
+    // An intercepted event, written into its increment by the writer thread.
+    // Whatever needs SurfaceFlinger state, such as the layer a handle refers
+    // to, is resolved by the calling thread beforehand.
+    struct Capture {
+        nsecs_t timestamp = 0;
+        std::function<void(Increment*)> write;
+    };
+    // Single producer, single consumer ring of captures
+    class CaptureBuffer;
+
+    // Queues a capture in the buffer of the calling thread. If that buffer is
+    // full, the capture is dropped.
+    void capture(std::function<void(Increment*)>&& write);
+    CaptureBuffer* getCaptureBuffer();
+
+    void startWriter();
+    void stopWriter();
+    void writerMain();
+    // Adds everything captured so far to the trace, in timestamp order
+    void writeCapturesLocked();
+    void discardCaptures();
+
     // The creation increments of Surfaces and Displays do not contain enough information to capture
     // the initial state of each object, so a transaction with all of the missing properties is
     // performed at the initial snapshot for each display and surface.
@@ -121,9 +153,10 @@ private:
     int32_t getLayerId(const sp<const Layer>& layer);
 
     Increment* createTraceIncrementLocked();
-    void addSurfaceCreationLocked(Increment* increment, const sp<const Layer>& layer);
-    void addSurfaceDeletionLocked(Increment* increment, const sp<const Layer>& layer);
-    void addBufferUpdateLocked(Increment* increment, const sp<const Layer>& layer, uint32_t width,
+    void addSurfaceCreationLocked(Increment* increment, int32_t layerId, const std::string& name,
+            uint32_t w, uint32_t h);
+    void addSurfaceDeletionLocked(Increment* increment, int32_t layerId);
+    void addBufferUpdateLocked(Increment* increment, int32_t layerId, uint32_t width,
             uint32_t height, uint64_t frameNumber);
     void addVSyncUpdateLocked(Increment* increment, nsecs_t timestamp);
     void addDisplayCreationLocked(Increment* increment, const DisplayDeviceState& info);
@@ -146,33 +179,64 @@ private:
     void addCropLocked(Transaction* transaction, int32_t layerId, const Rect& rect);
     void addCornerRadiusLocked(Transaction* transaction, int32_t layerId, float cornerRadius);
     void addDeferTransactionLocked(Transaction* transaction, int32_t layerId,
-            const sp<const Layer>& layer, uint64_t frameNumber);
+            int32_t barrierLayerId, uint64_t frameNumber);
     void addOverrideScalingModeLocked(Transaction* transaction, int32_t layerId,
             int32_t overrideScalingMode);
-    void addSurfaceChangesLocked(Transaction* transaction, const layer_state_t& state);
-    void addTransactionLocked(Increment* increment, const Vector<ComposerState>& stateUpdates,
-            const DefaultKeyedVector< wp<IBinder>, DisplayDeviceState>& displays,
-            const Vector<DisplayState>& changedDisplays, uint32_t transactionFlags);
+    void addSurfaceChangesLocked(Transaction* transaction, int32_t layerId,
+            int32_t barrierLayerId, const layer_state_t& state);
+
+    // A layer_state_t with the layers it refers to resolved, and without any
+    // reference to other objects, so that the writer thread never ends up
+    // destroying them
+    struct SurfaceChanges {
+        int32_t layerId;
+        int32_t barrierLayerId;
+        layer_state_t state;
+    };
+    // A DisplayState with its display and surface resolved
+    struct DisplayChanges {
+        int32_t sequenceId;
+        DisplayState state;
+        bool hasSurface;
+        uint64_t bufferQueueId;
+        std::string bufferQueueName;
+    };
+    bool resolveSurfaceChanges(const layer_state_t& state, SurfaceChanges* outChanges);
+    bool resolveDisplaySurface(const sp<const IGraphicBufferProducer>& surface,
+            uint64_t* outBufferQueueId, std::string* outBufferQueueName);
 
     // Add display transactions to the trace
     DisplayChange* createDisplayChangeLocked(Transaction* transaction, int32_t sequenceId);
     void addDisplaySurfaceLocked(Transaction* transaction, int32_t sequenceId,
-            const sp<const IGraphicBufferProducer>& surface);
+            uint64_t bufferQueueId, const std::string& bufferQueueName);
     void addDisplayLayerStackLocked(Transaction* transaction, int32_t sequenceId,
             uint32_t layerStack);
     void addDisplaySizeLocked(Transaction* transaction, int32_t sequenceId, uint32_t w,
             uint32_t h);
     void addDisplayProjectionLocked(Transaction* transaction, int32_t sequenceId,
             int32_t orientation, const Rect& viewport, const Rect& frame);
-    void addDisplayChangesLocked(Transaction* transaction,
-            const DisplayState& state, int32_t sequenceId);
+    void addDisplayChangesLocked(Transaction* transaction, const DisplayChanges& changes);
 
 
-    bool mEnabled {false};
+    std::atomic<bool> mEnabled {false};
     std::string mOutputFileName {DEFAULT_FILENAME};
     std::mutex mTraceMutex {};
     Trace mTrace {};
     SurfaceFlinger* const mFlinger;
+
+    // Tells the buffers of this instance apart from those of an earlier one in
+    // the thread_local lookup of the calling thread
+    const uint64_t mInstanceId;
+    // A buffer is added the first time a thread captures something, and lives
+    // as long as the interceptor
+    std::mutex mCaptureBuffersMutex {};
+    std::vector<std::unique_ptr<CaptureBuffer>> mCaptureBuffers {};
+    std::atomic<uint32_t> mDroppedCaptures {0};
+
+    std::mutex mWriterMutex {};
+    std::condition_variable mWriterCondition {};
+    bool mWriterRunning {false};
+    std::thread mWriterThread {};
 };
 
 } // namespace impl
@@ -18,6 +18,7 @@
 #define ATRACE_TAG ATRACE_TAG_GRAPHICS
 
 #include "SurfaceTracing.h"
+#include <Layer.h>
 #include <SurfaceFlinger.h>
 
 #include <android-base/file.h>
@@ -35,13 +36,13 @@ void SurfaceTracing::mainLoop() {
     addFirstEntry();
     bool enabled = true;
     while (enabled) {
-        LayersTraceProto entry = traceWhenNotified();
+        TraceEntry entry = traceWhenNotified();
         enabled = addTraceToBuffer(entry);
     }
 }
 
 void SurfaceTracing::addFirstEntry() {
-    LayersTraceProto entry;
+    TraceEntry entry;
     {
         std::scoped_lock lock(mSfLock);
         entry = traceLayersLocked("tracing.enable");
@@ -49,16 +50,16 @@ void SurfaceTracing::addFirstEntry() {
     addTraceToBuffer(entry);
 }
 
-LayersTraceProto SurfaceTracing::traceWhenNotified() {
+SurfaceTracing::TraceEntry SurfaceTracing::traceWhenNotified() {
     std::unique_lock<std::mutex> lock(mSfLock);
     mCanStartTrace.wait(lock);
     android::base::ScopedLockAssertion assumeLock(mSfLock);
-    LayersTraceProto entry = traceLayersLocked(mWhere);
+    TraceEntry entry = traceLayersLocked(mWhere);
     lock.unlock();
     return entry;
 }
 
-bool SurfaceTracing::addTraceToBuffer(LayersTraceProto& entry) {
+bool SurfaceTracing::addTraceToBuffer(TraceEntry& entry) {
     std::scoped_lock lock(mTraceLock);
     mBuffer.emplace(std::move(entry));
     if (mWriteToFile) {
@@ -82,32 +83,112 @@ void SurfaceTracing::writeToFileAsync() {
 
 void SurfaceTracing::LayersTraceBuffer::reset(size_t newSize) {
     // use the swap trick to make sure memory is released
-    std::queue<LayersTraceProto>().swap(mStorage);
+    std::deque<Entry>().swap(mStorage);
+    SerializedLayers().swap(mLastLayers);
     mSizeInBytes = newSize;
     mUsedInBytes = 0U;
+    mLayerCount = 0U;
+    mChangedLayerCount = 0U;
 }
 
-void SurfaceTracing::LayersTraceBuffer::emplace(LayersTraceProto&& proto) {
-    auto protoSize = proto.ByteSize();
-    while (mUsedInBytes + protoSize > mSizeInBytes) {
-        if (mStorage.empty()) {
+size_t SurfaceTracing::LayersTraceBuffer::sizeOf(const Entry& entry) {
+    size_t size = entry.header.ByteSize() + entry.layerIds.size() * sizeof(int32_t);
+    for (const auto& [id, layer] : entry.changedLayers) {
+        size += sizeof(id) + layer.size();
+    }
+    return size;
+}
+
+void SurfaceTracing::LayersTraceBuffer::emplace(TraceEntry&& traceEntry) {
+    Entry entry;
+    SerializedLayers layers;
+    entry.layerIds.reserve(traceEntry.layers.size());
+    for (auto& [id, serialized] : traceEntry.layers) {
+        const auto last = mLastLayers.find(id);
+        if (last == mLastLayers.end() || last->second != serialized) {
+            entry.changedLayers.emplace(id, serialized);
+        }
+        entry.layerIds.push_back(id);
+        layers.emplace(id, std::move(serialized));
+    }
+    entry.header.Swap(&traceEntry.header);
+    entry.sizeInBytes = sizeOf(entry);
+    mLastLayers = std::move(layers);
+
+    while (!mStorage.empty() && mUsedInBytes + entry.sizeInBytes > mSizeInBytes) {
+        popFront();
+    }
+    if (mStorage.empty()) {
+        // Nothing left to decode this entry against
+        entry.changedLayers = mLastLayers;
+        entry.sizeInBytes = sizeOf(entry);
+        if (entry.sizeInBytes > mSizeInBytes) {
+            mLastLayers.clear();
             return;
         }
-        mUsedInBytes -= mStorage.front().ByteSize();
-        mStorage.pop();
     }
-    mUsedInBytes += protoSize;
-    mStorage.emplace();
-    mStorage.back().Swap(&proto);
+
+    mLayerCount += entry.layerIds.size();
+    mChangedLayerCount += entry.changedLayers.size();
+    mUsedInBytes += entry.sizeInBytes;
+    mStorage.push_back(std::move(entry));
+}
+
+void SurfaceTracing::LayersTraceBuffer::popFront() {
+    Entry& oldest = mStorage.front();
+    mUsedInBytes -= oldest.sizeInBytes;
+    if (mStorage.size() > 1) {
+        Entry& next = mStorage[1];
+        mUsedInBytes -= next.sizeInBytes;
+        for (const int32_t id : next.layerIds) {
+            const auto layer = oldest.changedLayers.find(id);
+            if (layer != oldest.changedLayers.end()) {
+                // Only added if the next entry doesn't have a newer one
+                next.changedLayers.emplace(id, std::move(layer->second));
+            }
+        }
+        next.sizeInBytes = sizeOf(next);
+        mUsedInBytes += next.sizeInBytes;
+    }
+    mStorage.pop_front();
+}
+
+static void appendVarint(std::string* output, uint64_t value) {
+    while (value >= 0x80) {
+        output->push_back(static_cast<char>((value & 0x7f) | 0x80));
+        value >>= 7;
+    }
+    output->push_back(static_cast<char>(value));
 }
 
-void SurfaceTracing::LayersTraceBuffer::flush(LayersTraceFileProto* fileProto) {
-    fileProto->mutable_entry()->Reserve(mStorage.size());
+// Appends the field of an already serialized message, so that it isn't parsed and serialized
+// again as part of the message containing it.
+static void appendMessageField(std::string* output, uint32_t fieldNumber,
+                               const std::string& message) {
+    constexpr uint32_t kWireTypeLengthDelimited = 2;
+    appendVarint(output, (fieldNumber << 3) | kWireTypeLengthDelimited);
+    appendVarint(output, message.size());
+    output->append(message);
+}
 
+void SurfaceTracing::LayersTraceBuffer::flush(std::string* output) {
+    SerializedLayers layers;
+    std::string tracedLayers;
+    std::string traceEntry;
     while (!mStorage.empty()) {
-        auto entry = fileProto->add_entry();
-        entry->Swap(&mStorage.front());
-        mStorage.pop();
+        Entry& entry = mStorage.front();
+        for (auto& [id, layer] : entry.changedLayers) {
+            layers[id] = std::move(layer);
+        }
+
+        tracedLayers.clear();
+        for (const int32_t id : entry.layerIds) {
+            appendMessageField(&tracedLayers, LayersProto::kLayersFieldNumber, layers[id]);
+        }
+        entry.header.SerializeToString(&traceEntry);
+        appendMessageField(&traceEntry, LayersTraceProto::kLayersFieldNumber, tracedLayers);
+        appendMessageField(output, LayersTraceFileProto::kEntryFieldNumber, traceEntry);
+        mStorage.pop_front();
     }
 }
 
@@ -156,14 +237,19 @@ void SurfaceTracing::setTraceFlags(uint32_t flags) {
     mTraceFlags = flags;
 }
 
-LayersTraceProto SurfaceTracing::traceLayersLocked(const char* where) {
+SurfaceTracing::TraceEntry SurfaceTracing::traceLayersLocked(const char* where) {
     ATRACE_CALL();
 
-    LayersTraceProto entry;
-    entry.set_elapsed_realtime_nanos(elapsedRealtimeNano());
-    entry.set_where(where);
-    LayersProto layers(mFlinger.dumpProtoInfo(LayerVector::StateSet::Drawing, mTraceFlags));
-    entry.mutable_layers()->Swap(&layers);
+    TraceEntry entry;
+    entry.header.set_elapsed_realtime_nanos(elapsedRealtimeNano());
+    entry.header.set_where(where);
+    entry.header.set_missed_frame_count(mFlinger.mFrameMissedCount);
+    LayerProto layerProto;
+    mFlinger.mDrawingState.traverseInZOrder([&](Layer* layer) {
+        layer->writeToProto(&layerProto, LayerVector::StateSet::Drawing, mTraceFlags);
+        entry.layers.emplace_back(layerProto.id(), layerProto.SerializeAsString());
+        layerProto.Clear();
+    });
 
     return entry;
 }
@@ -176,13 +262,12 @@ void SurfaceTracing::writeProtoFileLocked() {
 
     fileProto.set_magic_number(uint64_t(LayersTraceFileProto_MagicNumber_MAGIC_NUMBER_H) << 32 |
                                LayersTraceFileProto_MagicNumber_MAGIC_NUMBER_L);
-    mBuffer.flush(&fileProto);
-    mBuffer.reset(mBufferSize);
-
     if (!fileProto.SerializeToString(&output)) {
         ALOGE("Could not save the proto file! Permission denied");
         mLastErr = PERMISSION_DENIED;
     }
+    mBuffer.flush(&output);
+    mBuffer.reset(mBufferSize);
     if (!android::base::WriteStringToFile(output, kDefaultFileName, S_IRWXU | S_IRGRP, getuid(),
                                           getgid(), true)) {
         ALOGE("Could not save the proto file! There are missing fields");
@@ -198,6 +283,8 @@ void SurfaceTracing::dump(std::string& result) const {
     base::StringAppendF(&result, "  number of entries: %zu (%.2fMB / %.2fMB)\n",
                         mBuffer.frameCount(), float(mBuffer.used()) / float(1_MB),
                         float(mBuffer.size()) / float(1_MB));
+    base::StringAppendF(&result, "  changed layers stored: %zu of %zu traced\n",
+                        mBuffer.changedLayerCount(), mBuffer.layerCount());
 }
 
 } // namespace android
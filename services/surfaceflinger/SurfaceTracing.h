@@ -22,10 +22,13 @@
 
 #include <android-base/thread_annotations.h>
 #include <condition_variable>
+#include <deque>
 #include <memory>
 #include <mutex>
-#include <queue>
+#include <string>
 #include <thread>
+#include <unordered_map>
+#include <vector>
 
 using namespace android::surfaceflinger;
 
@@ -56,38 +59,77 @@ public:
         TRACE_CRITICAL = 1 << 0,
         TRACE_INPUT = 1 << 1,
         TRACE_EXTRA = 1 << 2,
-        TRACE_ALL = 0xffffffff
+        TRACE_BUFFERING = 1 << 3,
+        TRACE_ALL = 0xffffffff,
+        // What dumpsys writes: everything except the occupancy segments, which are drained
+        // as they are written and so must only be consumed by layer tracing.
+        TRACE_DUMP = TRACE_ALL & ~TRACE_BUFFERING
     };
     void setTraceFlags(uint32_t flags);
 
-private:
-    static constexpr auto kDefaultBufferCapInByte = 100_MB;
-    static constexpr auto kDefaultFileName = "/data/misc/wmtrace/layers_trace.pb";
+    // A traced frame. Each layer is serialized as soon as it is traced, rather than being
+    // collected into a LayersProto first, and is not serialized again after that.
+    struct TraceEntry {
+        // Everything but the layers
+        LayersTraceProto header;
+        // Serialized LayerProtos by layer id, in Z order
+        std::vector<std::pair<int32_t, std::string>> layers;
+    };
 
-    class LayersTraceBuffer { // ring buffer
+    // Ring buffer of delta encoded entries. Each entry only holds the layers which changed
+    // since the entry before it, except for the oldest one, which holds all of them. Entries
+    // are written out as full snapshots.
+    class LayersTraceBuffer {
     public:
         size_t size() const { return mSizeInBytes; }
         size_t used() const { return mUsedInBytes; }
         size_t frameCount() const { return mStorage.size(); }
+        size_t layerCount() const { return mLayerCount; }
+        size_t changedLayerCount() const { return mChangedLayerCount; }
 
         void setSize(size_t newSize) { mSizeInBytes = newSize; }
         void reset(size_t newSize);
-        void emplace(LayersTraceProto&& proto);
-        void flush(LayersTraceFileProto* fileProto);
+        void emplace(TraceEntry&& traceEntry);
+        // Appends the entries to output as the entry field of a serialized
+        // LayersTraceFileProto, and empties the buffer.
+        void flush(std::string* output);
 
     private:
+        using SerializedLayers = std::unordered_map<int32_t, std::string>;
+
+        struct Entry {
+            LayersTraceProto header;
+            // All the layers, in the order they were traced
+            std::vector<int32_t> layerIds;
+            SerializedLayers changedLayers;
+            size_t sizeInBytes = 0U;
+        };
+
+        static size_t sizeOf(const Entry& entry);
+        // Drops the oldest entry, after moving the layers the next one lacks to it
+        void popFront();
+
         size_t mUsedInBytes = 0U;
         size_t mSizeInBytes = 0U;
-        std::queue<LayersTraceProto> mStorage;
+        std::deque<Entry> mStorage;
+        // Layers of the newest entry
+        SerializedLayers mLastLayers;
+        // Layers traced and stored since the last reset
+        size_t mLayerCount = 0U;
+        size_t mChangedLayerCount = 0U;
     };
 
+private:
+    static constexpr auto kDefaultBufferCapInByte = 100_MB;
+    static constexpr auto kDefaultFileName = "/data/misc/wmtrace/layers_trace.pb";
+
     void mainLoop();
     void addFirstEntry();
-    LayersTraceProto traceWhenNotified();
-    LayersTraceProto traceLayersLocked(const char* where) REQUIRES(mSfLock);
+    TraceEntry traceWhenNotified();
+    TraceEntry traceLayersLocked(const char* where) REQUIRES(mSfLock);
 
     // Returns true if trace is enabled.
-    bool addTraceToBuffer(LayersTraceProto& entry);
+    bool addTraceToBuffer(TraceEntry& entry);
     void writeProtoFileLocked() REQUIRES(mTraceLock);
 
     const SurfaceFlinger& mFlinger;
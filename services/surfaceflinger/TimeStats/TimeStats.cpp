@@ -73,35 +73,102 @@ std::string TimeStats::miniDump() {
     std::string result = "TimeStats miniDump:\n";
     std::lock_guard<std::mutex> lock(mMutex);
     android::base::StringAppendF(&result, "Number of tracked layers is %zu\n",
-                                 mTimeStatsTracker.size());
+                                 mNumLayerRecords.load());
     return result;
 }
 
 void TimeStats::incrementTotalFrames() {
     if (!mEnabled.load()) return;
 
-    ATRACE_CALL();
-
-    std::lock_guard<std::mutex> lock(mMutex);
-    mTimeStats.totalFrames++;
+    mTotalFrames++;
 }
 
 void TimeStats::incrementMissedFrames() {
     if (!mEnabled.load()) return;
 
-    ATRACE_CALL();
-
-    std::lock_guard<std::mutex> lock(mMutex);
-    mTimeStats.missedFrames++;
+    mMissedFrames++;
 }
 
 void TimeStats::incrementClientCompositionFrames() {
     if (!mEnabled.load()) return;
 
-    ATRACE_CALL();
+    mClientCompositionFrames++;
+}
 
-    std::lock_guard<std::mutex> lock(mMutex);
-    mTimeStats.clientCompositionFrames++;
+void TimeStats::incrementPredictedMissedFrames() {
+    if (!mEnabled.load()) return;
+
+    mPredictedMissedFrames++;
+}
+
+void TimeStats::flushGlobalCountersLocked() {
+    mTimeStats.totalFrames += mTotalFrames.exchange(0);
+    mTimeStats.missedFrames += mMissedFrames.exchange(0);
+    mTimeStats.clientCompositionFrames += mClientCompositionFrames.exchange(0);
+    mTimeStats.predictedMissedFrames += mPredictedMissedFrames.exchange(0);
+}
+
+TimeStats::LayerRecord* TimeStats::findLayerRecord(int32_t layerID) {
+    const uint64_t owner = kSlotInUse | static_cast<uint32_t>(layerID);
+    const size_t start = static_cast<uint32_t>(layerID) % NUM_LAYER_SLOTS;
+    for (size_t i = 0; i < NUM_LAYER_SLOTS; ++i) {
+        const size_t slot = (start + i) % NUM_LAYER_SLOTS;
+        const uint64_t value = mLayerSlots[slot].load(std::memory_order_acquire);
+        if (value == owner) return &mLayerRecords[slot];
+        if (value == kSlotFree) break;
+    }
+    return nullptr;
+}
+
+TimeStats::LayerRecord* TimeStats::addLayerRecordLocked(int32_t layerID,
+                                                        const std::string& layerName) {
+    if (mNumLayerRecords.load() >= MAX_NUM_LAYER_RECORDS) return nullptr;
+
+    const size_t start = static_cast<uint32_t>(layerID) % NUM_LAYER_SLOTS;
+    for (size_t i = 0; i < NUM_LAYER_SLOTS; ++i) {
+        const size_t slot = (start + i) % NUM_LAYER_SLOTS;
+        const uint64_t value = mLayerSlots[slot].load(std::memory_order_relaxed);
+        if (value != kSlotFree && value != kSlotRemoved) continue;
+
+        LayerRecord& layerRecord = mLayerRecords[slot];
+        {
+            std::lock_guard<std::mutex> lock(layerRecord.mutex);
+            layerRecord.inUse = true;
+            layerRecord.layerID = layerID;
+            layerRecord.layerName = layerName;
+        }
+        mLayerSlots[slot].store(kSlotInUse | static_cast<uint32_t>(layerID),
+                                std::memory_order_release);
+        mNumLayerRecords++;
+        return &layerRecord;
+    }
+    return nullptr;
+}
+
+void TimeStats::removeLayerRecordLocked(int32_t layerID, LayerRecord* layerRecord) {
+    {
+        std::lock_guard<std::mutex> lock(layerRecord->mutex);
+        if (!layerRecord->belongsTo(layerID)) return;
+        flushLayerStatsLocked(layerRecord);
+        layerRecord->inUse = false;
+        layerRecord->waitData = -1;
+        layerRecord->droppedFrames = 0;
+        layerRecord->prevTimeRecord = TimeRecord();
+        layerRecord->timeRecords.clear();
+    }
+
+    const size_t slot = layerRecord - mLayerRecords.data();
+    mLayerSlots[slot].store(kSlotRemoved, std::memory_order_release);
+    mNumLayerRecords--;
+
+    // A removed slot at the end of a probe sequence can be freed, so that
+    // lookups of untracked layers stop early
+    if (mLayerSlots[(slot + 1) % NUM_LAYER_SLOTS].load() == kSlotFree) {
+        for (size_t i = slot; mLayerSlots[i].load() == kSlotRemoved;
+             i = (i + NUM_LAYER_SLOTS - 1) % NUM_LAYER_SLOTS) {
+            mLayerSlots[i].store(kSlotFree, std::memory_order_release);
+        }
+    }
 }
 
 bool TimeStats::recordReadyLocked(int32_t layerID, TimeRecord* timeRecord) {
@@ -162,79 +229,122 @@ static std::string getPackageName(const std::string& layerName) {
     return "";
 }
 
-void TimeStats::flushAvailableRecordsToStatsLocked(int32_t layerID) {
+static const char* const deltaNames[] = {
+        "post2acquire",  "post2present",    "acquire2present",
+        "latch2present", "desired2present", "present2present",
+};
+
+void TimeStats::flushLayerStatsLocked(LayerRecord* layerRecord) {
+    static_assert(std::size(deltaNames) == kDeltaCount);
+    if (layerRecord->pendingTotalFrames == 0) return;
+
+    const std::string& layerName = layerRecord->layerName;
+    if (!mTimeStats.stats.count(layerName)) {
+        mTimeStats.stats[layerName].layerName = layerName;
+        mTimeStats.stats[layerName].packageName = getPackageName(layerName);
+    }
+    TimeStatsHelper::TimeStatsLayer& timeStatsLayer = mTimeStats.stats[layerName];
+    timeStatsLayer.totalFrames += layerRecord->pendingTotalFrames;
+    timeStatsLayer.droppedFrames += layerRecord->pendingDroppedFrames;
+    for (size_t i = 0; i < kDeltaCount; ++i) {
+        timeStatsLayer.deltas[deltaNames[i]].merge(layerRecord->pendingDeltas[i]);
+    }
+
+    layerRecord->pendingTotalFrames = 0;
+    layerRecord->pendingDroppedFrames = 0;
+    layerRecord->pendingDeltas = {};
+}
+
+void TimeStats::flushAllLayerStatsLocked() {
+    for (size_t slot = 0; slot < NUM_LAYER_SLOTS; ++slot) {
+        if (!(mLayerSlots[slot].load() & kSlotInUse)) continue;
+        LayerRecord& layerRecord = mLayerRecords[slot];
+        std::lock_guard<std::mutex> lock(layerRecord.mutex);
+        if (layerRecord.inUse) {
+            flushLayerStatsLocked(&layerRecord);
+        }
+    }
+}
+
+void TimeStats::flushAvailableRecordsToStatsLocked(LayerRecord* layerRecord) {
     ATRACE_CALL();
 
-    LayerRecord& layerRecord = mTimeStatsTracker[layerID];
-    TimeRecord& prevTimeRecord = layerRecord.prevTimeRecord;
-    std::deque<TimeRecord>& timeRecords = layerRecord.timeRecords;
+    const int32_t layerID = layerRecord->layerID;
+    TimeRecord& prevTimeRecord = layerRecord->prevTimeRecord;
+    std::deque<TimeRecord>& timeRecords = layerRecord->timeRecords;
+    auto& deltas = layerRecord->pendingDeltas;
     while (!timeRecords.empty()) {
         if (!recordReadyLocked(layerID, &timeRecords[0])) break;
         ALOGV("[%d]-[%" PRIu64 "]-presentFenceTime[%" PRId64 "]", layerID,
               timeRecords[0].frameTime.frameNumber, timeRecords[0].frameTime.presentTime);
 
-        const std::string& layerName = layerRecord.layerName;
         if (prevTimeRecord.ready) {
-            if (!mTimeStats.stats.count(layerName)) {
-                mTimeStats.stats[layerName].layerName = layerName;
-                mTimeStats.stats[layerName].packageName = getPackageName(layerName);
-            }
-            TimeStatsHelper::TimeStatsLayer& timeStatsLayer = mTimeStats.stats[layerName];
-            timeStatsLayer.totalFrames++;
-            timeStatsLayer.droppedFrames += layerRecord.droppedFrames;
-            layerRecord.droppedFrames = 0;
+            layerRecord->pendingTotalFrames++;
+            layerRecord->pendingDroppedFrames += layerRecord->droppedFrames;
+            layerRecord->droppedFrames = 0;
 
             const int32_t postToAcquireMs = msBetween(timeRecords[0].frameTime.postTime,
                                                       timeRecords[0].frameTime.acquireTime);
             ALOGV("[%d]-[%" PRIu64 "]-post2acquire[%d]", layerID,
                   timeRecords[0].frameTime.frameNumber, postToAcquireMs);
-            timeStatsLayer.deltas["post2acquire"].insert(postToAcquireMs);
+            TimeStatsHelper::Histogram::insert(&deltas[static_cast<size_t>(Delta::PostToAcquire)],
+                                               postToAcquireMs);
 
             const int32_t postToPresentMs = msBetween(timeRecords[0].frameTime.postTime,
                                                       timeRecords[0].frameTime.presentTime);
             ALOGV("[%d]-[%" PRIu64 "]-post2present[%d]", layerID,
                   timeRecords[0].frameTime.frameNumber, postToPresentMs);
-            timeStatsLayer.deltas["post2present"].insert(postToPresentMs);
+            TimeStatsHelper::Histogram::insert(&deltas[static_cast<size_t>(Delta::PostToPresent)],
+                                               postToPresentMs);
 
             const int32_t acquireToPresentMs = msBetween(timeRecords[0].frameTime.acquireTime,
                                                          timeRecords[0].frameTime.presentTime);
             ALOGV("[%d]-[%" PRIu64 "]-acquire2present[%d]", layerID,
                   timeRecords[0].frameTime.frameNumber, acquireToPresentMs);
-            timeStatsLayer.deltas["acquire2present"].insert(acquireToPresentMs);
+            TimeStatsHelper::Histogram::insert(&deltas[static_cast<size_t>(Delta::AcquireToPresent)],
+                                               acquireToPresentMs);
 
             const int32_t latchToPresentMs = msBetween(timeRecords[0].frameTime.latchTime,
                                                        timeRecords[0].frameTime.presentTime);
             ALOGV("[%d]-[%" PRIu64 "]-latch2present[%d]", layerID,
                   timeRecords[0].frameTime.frameNumber, latchToPresentMs);
-            timeStatsLayer.deltas["latch2present"].insert(latchToPresentMs);
+            TimeStatsHelper::Histogram::insert(&deltas[static_cast<size_t>(Delta::LatchToPresent)],
+                                               latchToPresentMs);
 
             const int32_t desiredToPresentMs = msBetween(timeRecords[0].frameTime.desiredTime,
                                                          timeRecords[0].frameTime.presentTime);
             ALOGV("[%d]-[%" PRIu64 "]-desired2present[%d]", layerID,
                   timeRecords[0].frameTime.frameNumber, desiredToPresentMs);
-            timeStatsLayer.deltas["desired2present"].insert(desiredToPresentMs);
+            TimeStatsHelper::Histogram::insert(&deltas[static_cast<size_t>(Delta::DesiredToPresent)],
+                                               desiredToPresentMs);
 
             const int32_t presentToPresentMs = msBetween(prevTimeRecord.frameTime.presentTime,
                                                          timeRecords[0].frameTime.presentTime);
             ALOGV("[%d]-[%" PRIu64 "]-present2present[%d]", layerID,
                   timeRecords[0].frameTime.frameNumber, presentToPresentMs);
-            timeStatsLayer.deltas["present2present"].insert(presentToPresentMs);
+            TimeStatsHelper::Histogram::insert(&deltas[static_cast<size_t>(Delta::PresentToPresent)],
+                                               presentToPresentMs);
         }
 
-        // Output additional trace points to track frame time.
-        ATRACE_INT64(("TimeStats-Post - " + layerName).c_str(), timeRecords[0].frameTime.postTime);
-        ATRACE_INT64(("TimeStats-Acquire - " + layerName).c_str(),
-                     timeRecords[0].frameTime.acquireTime);
-        ATRACE_INT64(("TimeStats-Latch - " + layerName).c_str(),
-                     timeRecords[0].frameTime.latchTime);
-        ATRACE_INT64(("TimeStats-Desired - " + layerName).c_str(),
-                     timeRecords[0].frameTime.desiredTime);
-        ATRACE_INT64(("TimeStats-Present - " + layerName).c_str(),
-                     timeRecords[0].frameTime.presentTime);
+        // Output additional trace points to track frame time. Building their
+        // names is most of the cost, so only do it while tracing.
+        if (ATRACE_ENABLED()) {
+            const std::string& layerName = layerRecord->layerName;
+            ATRACE_INT64(("TimeStats-Post - " + layerName).c_str(),
+                         timeRecords[0].frameTime.postTime);
+            ATRACE_INT64(("TimeStats-Acquire - " + layerName).c_str(),
+                         timeRecords[0].frameTime.acquireTime);
+            ATRACE_INT64(("TimeStats-Latch - " + layerName).c_str(),
+                         timeRecords[0].frameTime.latchTime);
+            ATRACE_INT64(("TimeStats-Desired - " + layerName).c_str(),
+                         timeRecords[0].frameTime.desiredTime);
+            ATRACE_INT64(("TimeStats-Present - " + layerName).c_str(),
+                         timeRecords[0].frameTime.presentTime);
+        }
 
         prevTimeRecord = timeRecords[0];
         timeRecords.pop_front();
-        layerRecord.waitData--;
+        layerRecord->waitData--;
     }
 }
 
@@ -261,17 +371,29 @@ void TimeStats::setPostTime(int32_t layerID, uint64_t frameNumber, const std::st
     ALOGV("[%d]-[%" PRIu64 "]-[%s]-PostTime[%" PRId64 "]", layerID, frameNumber, layerName.c_str(),
           postTime);
 
-    std::lock_guard<std::mutex> lock(mMutex);
-    if (!mTimeStatsTracker.count(layerID) && mTimeStatsTracker.size() < MAX_NUM_LAYER_RECORDS &&
-        layerNameIsValid(layerName)) {
-        mTimeStatsTracker[layerID].layerName = layerName;
+    LayerRecord* layerRecord = findLayerRecord(layerID);
+    if (!layerRecord) {
+        if (mNumLayerRecords.load() >= MAX_NUM_LAYER_RECORDS || !layerNameIsValid(layerName)) {
+            return;
+        }
+        std::lock_guard<std::mutex> lock(mMutex);
+        layerRecord = findLayerRecord(layerID);
+        if (!layerRecord) {
+            layerRecord = addLayerRecordLocked(layerID, layerName);
+        }
+        if (!layerRecord) return;
     }
-    if (!mTimeStatsTracker.count(layerID)) return;
-    LayerRecord& layerRecord = mTimeStatsTracker[layerID];
-    if (layerRecord.timeRecords.size() == MAX_NUM_TIME_RECORDS) {
+
+    std::lock_guard<std::mutex> lock(layerRecord->mutex);
+    if (!layerRecord->belongsTo(layerID)) return;
+    if (layerRecord->timeRecords.size() == MAX_NUM_TIME_RECORDS) {
         ALOGE("[%d]-[%s]-timeRecords is at its maximum size[%zu]. Ignore this when unittesting.",
-              layerID, layerRecord.layerName.c_str(), MAX_NUM_TIME_RECORDS);
-        mTimeStatsTracker.erase(layerID);
+              layerID, layerRecord->layerName.c_str(), MAX_NUM_TIME_RECORDS);
+        // Start over, as if the layer was seen for the first time
+        layerRecord->waitData = -1;
+        layerRecord->droppedFrames = 0;
+        layerRecord->prevTimeRecord = TimeRecord();
+        layerRecord->timeRecords.clear();
         return;
     }
     // For most media content, the acquireFence is invalid because the buffer is
@@ -287,10 +409,10 @@ void TimeStats::setPostTime(int32_t layerID, uint64_t frameNumber, const std::st
                             .desiredTime = postTime,
                     },
     };
-    layerRecord.timeRecords.push_back(timeRecord);
-    if (layerRecord.waitData < 0 ||
-        layerRecord.waitData >= static_cast<int32_t>(layerRecord.timeRecords.size()))
-        layerRecord.waitData = layerRecord.timeRecords.size() - 1;
+    layerRecord->timeRecords.push_back(timeRecord);
+    if (layerRecord->waitData < 0 ||
+        layerRecord->waitData >= static_cast<int32_t>(layerRecord->timeRecords.size()))
+        layerRecord->waitData = layerRecord->timeRecords.size() - 1;
 }
 
 void TimeStats::setLatchTime(int32_t layerID, uint64_t frameNumber, nsecs_t latchTime) {
@@ -299,13 +421,14 @@ void TimeStats::setLatchTime(int32_t layerID, uint64_t frameNumber, nsecs_t latc
     ATRACE_CALL();
     ALOGV("[%d]-[%" PRIu64 "]-LatchTime[%" PRId64 "]", layerID, frameNumber, latchTime);
 
-    std::lock_guard<std::mutex> lock(mMutex);
-    if (!mTimeStatsTracker.count(layerID)) return;
-    LayerRecord& layerRecord = mTimeStatsTracker[layerID];
-    if (layerRecord.waitData < 0 ||
-        layerRecord.waitData >= static_cast<int32_t>(layerRecord.timeRecords.size()))
+    LayerRecord* layerRecord = findLayerRecord(layerID);
+    if (!layerRecord) return;
+    std::lock_guard<std::mutex> lock(layerRecord->mutex);
+    if (!layerRecord->belongsTo(layerID)) return;
+    if (layerRecord->waitData < 0 ||
+        layerRecord->waitData >= static_cast<int32_t>(layerRecord->timeRecords.size()))
         return;
-    TimeRecord& timeRecord = layerRecord.timeRecords[layerRecord.waitData];
+    TimeRecord& timeRecord = layerRecord->timeRecords[layerRecord->waitData];
     if (timeRecord.frameTime.frameNumber == frameNumber) {
         timeRecord.frameTime.latchTime = latchTime;
     }
@@ -317,13 +440,14 @@ void TimeStats::setDesiredTime(int32_t layerID, uint64_t frameNumber, nsecs_t de
     ATRACE_CALL();
     ALOGV("[%d]-[%" PRIu64 "]-DesiredTime[%" PRId64 "]", layerID, frameNumber, desiredTime);
 
-    std::lock_guard<std::mutex> lock(mMutex);
-    if (!mTimeStatsTracker.count(layerID)) return;
-    LayerRecord& layerRecord = mTimeStatsTracker[layerID];
-    if (layerRecord.waitData < 0 ||
-        layerRecord.waitData >= static_cast<int32_t>(layerRecord.timeRecords.size()))
+    LayerRecord* layerRecord = findLayerRecord(layerID);
+    if (!layerRecord) return;
+    std::lock_guard<std::mutex> lock(layerRecord->mutex);
+    if (!layerRecord->belongsTo(layerID)) return;
+    if (layerRecord->waitData < 0 ||
+        layerRecord->waitData >= static_cast<int32_t>(layerRecord->timeRecords.size()))
         return;
-    TimeRecord& timeRecord = layerRecord.timeRecords[layerRecord.waitData];
+    TimeRecord& timeRecord = layerRecord->timeRecords[layerRecord->waitData];
     if (timeRecord.frameTime.frameNumber == frameNumber) {
         timeRecord.frameTime.desiredTime = desiredTime;
     }
@@ -335,13 +459,14 @@ void TimeStats::setAcquireTime(int32_t layerID, uint64_t frameNumber, nsecs_t ac
     ATRACE_CALL();
     ALOGV("[%d]-[%" PRIu64 "]-AcquireTime[%" PRId64 "]", layerID, frameNumber, acquireTime);
 
-    std::lock_guard<std::mutex> lock(mMutex);
-    if (!mTimeStatsTracker.count(layerID)) return;
-    LayerRecord& layerRecord = mTimeStatsTracker[layerID];
-    if (layerRecord.waitData < 0 ||
-        layerRecord.waitData >= static_cast<int32_t>(layerRecord.timeRecords.size()))
+    LayerRecord* layerRecord = findLayerRecord(layerID);
+    if (!layerRecord) return;
+    std::lock_guard<std::mutex> lock(layerRecord->mutex);
+    if (!layerRecord->belongsTo(layerID)) return;
+    if (layerRecord->waitData < 0 ||
+        layerRecord->waitData >= static_cast<int32_t>(layerRecord->timeRecords.size()))
         return;
-    TimeRecord& timeRecord = layerRecord.timeRecords[layerRecord.waitData];
+    TimeRecord& timeRecord = layerRecord->timeRecords[layerRecord->waitData];
     if (timeRecord.frameTime.frameNumber == frameNumber) {
         timeRecord.frameTime.acquireTime = acquireTime;
     }
@@ -355,13 +480,14 @@ void TimeStats::setAcquireFence(int32_t layerID, uint64_t frameNumber,
     ALOGV("[%d]-[%" PRIu64 "]-AcquireFenceTime[%" PRId64 "]", layerID, frameNumber,
           acquireFence->getSignalTime());
 
-    std::lock_guard<std::mutex> lock(mMutex);
-    if (!mTimeStatsTracker.count(layerID)) return;
-    LayerRecord& layerRecord = mTimeStatsTracker[layerID];
-    if (layerRecord.waitData < 0 ||
-        layerRecord.waitData >= static_cast<int32_t>(layerRecord.timeRecords.size()))
+    LayerRecord* layerRecord = findLayerRecord(layerID);
+    if (!layerRecord) return;
+    std::lock_guard<std::mutex> lock(layerRecord->mutex);
+    if (!layerRecord->belongsTo(layerID)) return;
+    if (layerRecord->waitData < 0 ||
+        layerRecord->waitData >= static_cast<int32_t>(layerRecord->timeRecords.size()))
         return;
-    TimeRecord& timeRecord = layerRecord.timeRecords[layerRecord.waitData];
+    TimeRecord& timeRecord = layerRecord->timeRecords[layerRecord->waitData];
     if (timeRecord.frameTime.frameNumber == frameNumber) {
         timeRecord.acquireFence = acquireFence;
     }
@@ -373,20 +499,21 @@ void TimeStats::setPresentTime(int32_t layerID, uint64_t frameNumber, nsecs_t pr
     ATRACE_CALL();
     ALOGV("[%d]-[%" PRIu64 "]-PresentTime[%" PRId64 "]", layerID, frameNumber, presentTime);
 
-    std::lock_guard<std::mutex> lock(mMutex);
-    if (!mTimeStatsTracker.count(layerID)) return;
-    LayerRecord& layerRecord = mTimeStatsTracker[layerID];
-    if (layerRecord.waitData < 0 ||
-        layerRecord.waitData >= static_cast<int32_t>(layerRecord.timeRecords.size()))
+    LayerRecord* layerRecord = findLayerRecord(layerID);
+    if (!layerRecord) return;
+    std::lock_guard<std::mutex> lock(layerRecord->mutex);
+    if (!layerRecord->belongsTo(layerID)) return;
+    if (layerRecord->waitData < 0 ||
+        layerRecord->waitData >= static_cast<int32_t>(layerRecord->timeRecords.size()))
         return;
-    TimeRecord& timeRecord = layerRecord.timeRecords[layerRecord.waitData];
+    TimeRecord& timeRecord = layerRecord->timeRecords[layerRecord->waitData];
     if (timeRecord.frameTime.frameNumber == frameNumber) {
         timeRecord.frameTime.presentTime = presentTime;
         timeRecord.ready = true;
-        layerRecord.waitData++;
+        layerRecord->waitData++;
     }
 
-    flushAvailableRecordsToStatsLocked(layerID);
+    flushAvailableRecordsToStatsLocked(layerRecord);
 }
 
 void TimeStats::setPresentFence(int32_t layerID, uint64_t frameNumber,
@@ -397,20 +524,21 @@ void TimeStats::setPresentFence(int32_t layerID, uint64_t frameNumber,
     ALOGV("[%d]-[%" PRIu64 "]-PresentFenceTime[%" PRId64 "]", layerID, frameNumber,
           presentFence->getSignalTime());
 
-    std::lock_guard<std::mutex> lock(mMutex);
-    if (!mTimeStatsTracker.count(layerID)) return;
-    LayerRecord& layerRecord = mTimeStatsTracker[layerID];
-    if (layerRecord.waitData < 0 ||
-        layerRecord.waitData >= static_cast<int32_t>(layerRecord.timeRecords.size()))
+    LayerRecord* layerRecord = findLayerRecord(layerID);
+    if (!layerRecord) return;
+    std::lock_guard<std::mutex> lock(layerRecord->mutex);
+    if (!layerRecord->belongsTo(layerID)) return;
+    if (layerRecord->waitData < 0 ||
+        layerRecord->waitData >= static_cast<int32_t>(layerRecord->timeRecords.size()))
         return;
-    TimeRecord& timeRecord = layerRecord.timeRecords[layerRecord.waitData];
+    TimeRecord& timeRecord = layerRecord->timeRecords[layerRecord->waitData];
     if (timeRecord.frameTime.frameNumber == frameNumber) {
         timeRecord.presentFence = presentFence;
         timeRecord.ready = true;
-        layerRecord.waitData++;
+        layerRecord->waitData++;
     }
 
-    flushAvailableRecordsToStatsLocked(layerID);
+    flushAvailableRecordsToStatsLocked(layerRecord);
 }
 
 void TimeStats::onDestroy(int32_t layerID) {
@@ -419,9 +547,10 @@ void TimeStats::onDestroy(int32_t layerID) {
     ATRACE_CALL();
     ALOGV("[%d]-onDestroy", layerID);
 
+    LayerRecord* layerRecord = findLayerRecord(layerID);
+    if (!layerRecord) return;
     std::lock_guard<std::mutex> lock(mMutex);
-    if (!mTimeStatsTracker.count(layerID)) return;
-    mTimeStatsTracker.erase(layerID);
+    removeLayerRecordLocked(layerID, layerRecord);
 }
 
 void TimeStats::removeTimeRecord(int32_t layerID, uint64_t frameNumber) {
@@ -430,20 +559,21 @@ void TimeStats::removeTimeRecord(int32_t layerID, uint64_t frameNumber) {
     ATRACE_CALL();
     ALOGV("[%d]-[%" PRIu64 "]-removeTimeRecord", layerID, frameNumber);
 
-    std::lock_guard<std::mutex> lock(mMutex);
-    if (!mTimeStatsTracker.count(layerID)) return;
-    LayerRecord& layerRecord = mTimeStatsTracker[layerID];
+    LayerRecord* layerRecord = findLayerRecord(layerID);
+    if (!layerRecord) return;
+    std::lock_guard<std::mutex> lock(layerRecord->mutex);
+    if (!layerRecord->belongsTo(layerID)) return;
     size_t removeAt = 0;
-    for (const TimeRecord& record : layerRecord.timeRecords) {
+    for (const TimeRecord& record : layerRecord->timeRecords) {
         if (record.frameTime.frameNumber == frameNumber) break;
         removeAt++;
     }
-    if (removeAt == layerRecord.timeRecords.size()) return;
-    layerRecord.timeRecords.erase(layerRecord.timeRecords.begin() + removeAt);
-    if (layerRecord.waitData > static_cast<int32_t>(removeAt)) {
-        layerRecord.waitData--;
+    if (removeAt == layerRecord->timeRecords.size()) return;
+    layerRecord->timeRecords.erase(layerRecord->timeRecords.begin() + removeAt);
+    if (layerRecord->waitData > static_cast<int32_t>(removeAt)) {
+        layerRecord->waitData--;
     }
-    layerRecord.droppedFrames++;
+    layerRecord->droppedFrames++;
 }
 
 void TimeStats::flushPowerTimeLocked() {
@@ -550,6 +680,57 @@ void TimeStats::setPresentFenceGlobal(const std::shared_ptr<FenceTime>& presentF
     flushAvailableGlobalRecordsToStatsLocked();
 }
 
+void TimeStats::flushAvailableFrameStagesToStatsLocked() {
+    using FrameStage = TimeStatsHelper::FrameStage;
+
+    while (!mFrameStagesRecords.empty()) {
+        const FrameStagesRecord& record = mFrameStagesRecords.front();
+        nsecs_t signalTime = Fence::SIGNAL_TIME_INVALID;
+        if (record.presentFence != nullptr && record.presentFence->isValid()) {
+            signalTime = record.presentFence->getSignalTime();
+            if (signalTime == Fence::SIGNAL_TIME_PENDING) break;
+        }
+
+        TimeStatsHelper::TimeStatsFrameStages& frameStages =
+                mTimeStats.frameStages[{record.displayId, record.fps}];
+        frameStages.displayId = record.displayId;
+        frameStages.fps = record.fps;
+        frameStages.totalFrames++;
+        auto& stages = frameStages.stages;
+        stages[static_cast<size_t>(FrameStage::TransactionApply)].insert(
+                record.stages.transactionApply);
+        stages[static_cast<size_t>(FrameStage::Latch)].insert(record.stages.latch);
+        stages[static_cast<size_t>(FrameStage::CompositionStrategy)].insert(
+                record.stages.compositionStrategy);
+        stages[static_cast<size_t>(FrameStage::RenderEngine)].insert(record.stages.renderEngine);
+        stages[static_cast<size_t>(FrameStage::HwcPresent)].insert(record.stages.hwcPresent);
+        // Displays without present fences have no fence signal stage
+        if (signalTime != Fence::SIGNAL_TIME_INVALID) {
+            stages[static_cast<size_t>(FrameStage::FenceSignal)].insert(
+                    std::max(signalTime - record.presentTime, nsecs_t(0)));
+        }
+
+        mFrameStagesRecords.pop_front();
+    }
+}
+
+void TimeStats::recordFrameStages(uint64_t displayId, uint32_t fps, const FrameStages& stages,
+                                  nsecs_t presentTime,
+                                  const std::shared_ptr<FenceTime>& presentFence) {
+    if (!mEnabled.load()) return;
+
+    ATRACE_CALL();
+    std::lock_guard<std::mutex> lock(mMutex);
+    if (mFrameStagesRecords.size() == MAX_NUM_TIME_RECORDS) {
+        // Same as for the global present fences, the front one must be stuck
+        ALOGE("FrameStagesRecords is already at its maximum size[%zu]", MAX_NUM_TIME_RECORDS);
+        mFrameStagesRecords.pop_front();
+    }
+
+    mFrameStagesRecords.push_back({displayId, fps, stages, presentTime, presentFence});
+    flushAvailableFrameStagesToStatsLocked();
+}
+
 void TimeStats::enable() {
     if (mEnabled.load()) return;
 
@@ -578,19 +759,41 @@ void TimeStats::clear() {
     ATRACE_CALL();
 
     std::lock_guard<std::mutex> lock(mMutex);
-    mTimeStatsTracker.clear();
+    for (size_t slot = 0; slot < NUM_LAYER_SLOTS; ++slot) {
+        LayerRecord& layerRecord = mLayerRecords[slot];
+        {
+            std::lock_guard<std::mutex> recordLock(layerRecord.mutex);
+            layerRecord.inUse = false;
+            layerRecord.waitData = -1;
+            layerRecord.droppedFrames = 0;
+            layerRecord.prevTimeRecord = TimeRecord();
+            layerRecord.timeRecords.clear();
+            layerRecord.pendingTotalFrames = 0;
+            layerRecord.pendingDroppedFrames = 0;
+            layerRecord.pendingDeltas = {};
+        }
+        mLayerSlots[slot].store(kSlotFree, std::memory_order_release);
+    }
+    mNumLayerRecords = 0;
+    mTotalFrames = 0;
+    mMissedFrames = 0;
+    mClientCompositionFrames = 0;
+    mPredictedMissedFrames = 0;
     mTimeStats.stats.clear();
     mTimeStats.statsStart = (mEnabled.load() ? static_cast<int64_t>(std::time(0)) : 0);
     mTimeStats.statsEnd = 0;
     mTimeStats.totalFrames = 0;
     mTimeStats.missedFrames = 0;
     mTimeStats.clientCompositionFrames = 0;
+    mTimeStats.predictedMissedFrames = 0;
     mTimeStats.displayOnTime = 0;
     mTimeStats.presentToPresent.hist.clear();
     mTimeStats.refreshRateStats.clear();
     mPowerTime.prevTime = systemTime();
     mGlobalRecord.prevPresentTime = 0;
     mGlobalRecord.presentFences.clear();
+    mFrameStagesRecords.clear();
+    mTimeStats.frameStages.clear();
     ALOGD("Cleared");
 }
 
@@ -609,6 +812,9 @@ void TimeStats::dump(bool asProto, std::optional<uint32_t> maxLayers, std::strin
     mTimeStats.statsEnd = static_cast<int64_t>(std::time(0));
 
     flushPowerTimeLocked();
+    flushGlobalCountersLocked();
+    flushAllLayerStatsLocked();
+    flushAvailableFrameStagesToStatsLocked();
 
     if (asProto) {
         ALOGD("Dumping TimeStats as proto");
@@ -26,6 +26,8 @@
 #include <utils/String16.h>
 #include <utils/Vector.h>
 
+#include <array>
+#include <atomic>
 #include <deque>
 #include <mutex>
 #include <optional>
@@ -37,6 +39,16 @@ namespace android {
 
 class TimeStats {
 public:
+    // How long SurfaceFlinger spent on each stage of presenting a frame on a
+    // display. The transaction and latch stages are shared by all displays.
+    struct FrameStages {
+        nsecs_t transactionApply = 0;
+        nsecs_t latch = 0;
+        nsecs_t compositionStrategy = 0;
+        nsecs_t renderEngine = 0;
+        nsecs_t hwcPresent = 0;
+    };
+
     virtual ~TimeStats() = default;
 
     virtual void parseArgs(bool asProto, const Vector<String16>& args, std::string& result) = 0;
@@ -46,6 +58,8 @@ public:
     virtual void incrementTotalFrames() = 0;
     virtual void incrementMissedFrames() = 0;
     virtual void incrementClientCompositionFrames() = 0;
+    // Counts frames predicted at invalidate time to miss their deadline.
+    virtual void incrementPredictedMissedFrames() = 0;
 
     virtual void setPostTime(int32_t layerID, uint64_t frameNumber, const std::string& layerName,
                              nsecs_t postTime) = 0;
@@ -66,6 +80,11 @@ public:
     // Source of truth is RefrehRateStats.
     virtual void recordRefreshRate(uint32_t fps, nsecs_t duration) = 0;
     virtual void setPresentFenceGlobal(const std::shared_ptr<FenceTime>& presentFence) = 0;
+    // The fence signal stage lasts from presentTime, when HWC was done
+    // presenting, until presentFence signals.
+    virtual void recordFrameStages(uint64_t displayId, uint32_t fps, const FrameStages& stages,
+                                   nsecs_t presentTime,
+                                   const std::shared_ptr<FenceTime>& presentFence) = 0;
 };
 
 namespace impl {
@@ -87,7 +106,24 @@ class TimeStats : public android::TimeStats {
         std::shared_ptr<FenceTime> presentFence;
     };
 
+    // The deltas measured for each frame of a layer
+    enum class Delta {
+        PostToAcquire,
+        PostToPresent,
+        AcquireToPresent,
+        LatchToPresent,
+        DesiredToPresent,
+        PresentToPresent,
+        Count,
+    };
+    static constexpr size_t kDeltaCount = static_cast<size_t>(Delta::Count);
+
+    // A slot in mLayerRecords. Each slot has its own lock, so the only contention
+    // is between the threads reporting frames of the same layer, and dump.
     struct LayerRecord {
+        std::mutex mutex;
+        bool inUse = false;
+        int32_t layerID = 0;
         std::string layerName;
         // This is the index in timeRecords, at which the timestamps for that
         // specific frame are still not fully received. This is not waiting for
@@ -96,6 +132,14 @@ class TimeStats : public android::TimeStats {
         uint32_t droppedFrames = 0;
         TimeRecord prevTimeRecord;
         std::deque<TimeRecord> timeRecords;
+
+        // Stats of the frames measured since the last flushLayerStatsLocked,
+        // which adds them to mTimeStats
+        int32_t pendingTotalFrames = 0;
+        int32_t pendingDroppedFrames = 0;
+        std::array<TimeStatsHelper::Histogram::Buckets, kDeltaCount> pendingDeltas{};
+
+        bool belongsTo(int32_t id) const { return inUse && layerID == id; }
     };
 
     struct PowerTime {
@@ -108,6 +152,15 @@ class TimeStats : public android::TimeStats {
         std::deque<std::shared_ptr<FenceTime>> presentFences;
     };
 
+    // Frame stages waiting for the present fence to signal
+    struct FrameStagesRecord {
+        uint64_t displayId = 0;
+        uint32_t fps = 0;
+        FrameStages stages;
+        nsecs_t presentTime = 0;
+        std::shared_ptr<FenceTime> presentFence;
+    };
+
 public:
     TimeStats() = default;
 
@@ -118,6 +171,7 @@ public:
     void incrementTotalFrames() override;
     void incrementMissedFrames() override;
     void incrementClientCompositionFrames() override;
+    void incrementPredictedMissedFrames() override;
 
     void setPostTime(int32_t layerID, uint64_t frameNumber, const std::string& layerName,
                      nsecs_t postTime) override;
@@ -138,14 +192,30 @@ public:
     // Source of truth is RefrehRateStats.
     void recordRefreshRate(uint32_t fps, nsecs_t duration) override;
     void setPresentFenceGlobal(const std::shared_ptr<FenceTime>& presentFence) override;
+    void recordFrameStages(uint64_t displayId, uint32_t fps, const FrameStages& stages,
+                           nsecs_t presentTime,
+                           const std::shared_ptr<FenceTime>& presentFence) override;
 
     static const size_t MAX_NUM_TIME_RECORDS = 64;
 
 private:
+    // Finds the slot of a layer without locking. The caller must lock the slot,
+    // and check that it still belongs to the layer.
+    LayerRecord* findLayerRecord(int32_t layerID);
+    // Takes a slot for a layer, if the layer limit allows. Slots are only taken
+    // and given back with mMutex held.
+    LayerRecord* addLayerRecordLocked(int32_t layerID, const std::string& layerName);
+    void removeLayerRecordLocked(int32_t layerID, LayerRecord* layerRecord);
+    // Moves the pending stats of a layer into mTimeStats
+    void flushLayerStatsLocked(LayerRecord* layerRecord);
+    void flushAllLayerStatsLocked();
+    void flushGlobalCountersLocked();
+
     bool recordReadyLocked(int32_t layerID, TimeRecord* timeRecord);
-    void flushAvailableRecordsToStatsLocked(int32_t layerID);
+    void flushAvailableRecordsToStatsLocked(LayerRecord* layerRecord);
     void flushPowerTimeLocked();
     void flushAvailableGlobalRecordsToStatsLocked();
+    void flushAvailableFrameStagesToStatsLocked();
 
     void enable();
     void disable();
@@ -155,12 +225,28 @@ private:
     std::atomic<bool> mEnabled = false;
     std::mutex mMutex;
     TimeStatsHelper::TimeStatsGlobal mTimeStats;
-    // Hashmap for LayerRecord with layerID as the hash key
-    std::unordered_map<int32_t, LayerRecord> mTimeStatsTracker;
     PowerTime mPowerTime;
     GlobalRecord mGlobalRecord;
+    std::deque<FrameStagesRecord> mFrameStagesRecords;
+
+    // Counted without locking, and added to mTimeStats on dump
+    std::atomic<int32_t> mTotalFrames = 0;
+    std::atomic<int32_t> mMissedFrames = 0;
+    std::atomic<int32_t> mClientCompositionFrames = 0;
+    std::atomic<int32_t> mPredictedMissedFrames = 0;
 
     static const size_t MAX_NUM_LAYER_RECORDS = 200;
+    // Open addressed by layerID, with room to spare so that probing stays short
+    static const size_t NUM_LAYER_SLOTS = 256;
+
+    // Which layer each slot in mLayerRecords belongs to, as kSlotFree,
+    // kSlotRemoved, or kSlotInUse | layerID. Probing stops at free slots only.
+    static constexpr uint64_t kSlotFree = 0;
+    static constexpr uint64_t kSlotRemoved = 1;
+    static constexpr uint64_t kSlotInUse = uint64_t(1) << 32;
+    std::array<std::atomic<uint64_t>, NUM_LAYER_SLOTS> mLayerSlots{};
+    std::array<LayerRecord, NUM_LAYER_SLOTS> mLayerRecords;
+    std::atomic<size_t> mNumLayerRecords = 0;
 };
 
 } // namespace impl
@@ -18,9 +18,11 @@
 #include <android-base/stringprintf.h>
 #include <inttypes.h>
 
+#include <algorithm>
 #include <array>
+#include <cmath>
 
-#define HISTOGRAM_SIZE 85
+#define HISTOGRAM_SIZE TimeStatsHelper::Histogram::kBucketCount
 
 using android::base::StringAppendF;
 using android::base::StringPrintf;
@@ -48,6 +50,24 @@ void TimeStatsHelper::Histogram::insert(int32_t delta) {
     hist[*iter]++;
 }
 
+void TimeStatsHelper::Histogram::insert(Buckets* buckets, int32_t delta) {
+    if (delta < 0) return;
+    if (delta > histogramConfig[HISTOGRAM_SIZE - 1]) {
+        (*buckets)[HISTOGRAM_SIZE - 1] += delta / histogramConfig[HISTOGRAM_SIZE - 1];
+        return;
+    }
+    auto iter = std::lower_bound(histogramConfig.begin(), histogramConfig.end(), delta);
+    (*buckets)[iter - histogramConfig.begin()]++;
+}
+
+void TimeStatsHelper::Histogram::merge(const Buckets& buckets) {
+    for (int32_t i = 0; i < HISTOGRAM_SIZE; ++i) {
+        if (buckets[i] != 0) {
+            hist[histogramConfig[i]] += buckets[i];
+        }
+    }
+}
+
 int64_t TimeStatsHelper::Histogram::totalTime() const {
     int64_t ret = 0;
     for (const auto& ele : hist) {
@@ -77,6 +97,60 @@ std::string TimeStatsHelper::Histogram::toString() const {
     return result;
 }
 
+// Samples under 8us get a bucket each, longer ones one of 8 buckets per power
+// of two
+static size_t durationBucket(int64_t micros) {
+    if (micros < 8) return std::max(micros, int64_t(0));
+    const int exponent = 63 - __builtin_clzll(micros);
+    const size_t bucket = 8 * (exponent - 2) + ((micros >> (exponent - 3)) & 7);
+    return std::min(bucket, TimeStatsHelper::DurationHistogram::kBucketCount - 1);
+}
+
+static int64_t durationBucketEnd(size_t bucket) {
+    bucket++;
+    if (bucket < 8) return bucket;
+    const int exponent = bucket / 8 + 2;
+    return static_cast<int64_t>(8 + bucket % 8) << (exponent - 3);
+}
+
+void TimeStatsHelper::DurationHistogram::insert(nsecs_t duration) {
+    mBuckets[durationBucket(ns2us(duration))]++;
+    mCount++;
+}
+
+int64_t TimeStatsHelper::DurationHistogram::percentileMicros(float fraction) const {
+    if (mCount == 0) return 0;
+    const int64_t rank = std::max(int64_t(1), static_cast<int64_t>(std::ceil(fraction * mCount)));
+    int64_t seen = 0;
+    for (size_t i = 0; i < kBucketCount; ++i) {
+        seen += mBuckets[i];
+        if (seen >= rank) return durationBucketEnd(i);
+    }
+    return durationBucketEnd(kBucketCount - 1);
+}
+
+static const char* const frameStageNames[] = {
+        "transactionApply", "latch", "compositionStrategy", "renderEngine", "hwcPresent",
+        "fenceSignal",
+};
+static_assert(std::size(frameStageNames) == TimeStatsHelper::kFrameStageCount);
+
+std::string TimeStatsHelper::TimeStatsFrameStages::toString() const {
+    std::string result;
+    StringAppendF(&result, "displayId = %" PRIu64 " fps = %u totalFrames = %d\n", displayId, fps,
+                  totalFrames);
+    StringAppendF(&result, "%-20s %8s %8s %8s %8s %8s\n", "stage (us)", "count", "p50", "p90",
+                  "p95", "p99");
+    for (size_t i = 0; i < kFrameStageCount; ++i) {
+        const DurationHistogram& stage = stages[i];
+        StringAppendF(&result, "%-20s %8d %8" PRId64 " %8" PRId64 " %8" PRId64 " %8" PRId64 "\n",
+                      frameStageNames[i], stage.count(), stage.percentileMicros(0.5f),
+                      stage.percentileMicros(0.9f), stage.percentileMicros(0.95f),
+                      stage.percentileMicros(0.99f));
+    }
+    return result;
+}
+
 std::string TimeStatsHelper::TimeStatsLayer::toString() const {
     std::string result = "\n";
     StringAppendF(&result, "layerName = %s\n", layerName.c_str());
@@ -102,6 +176,7 @@ std::string TimeStatsHelper::TimeStatsGlobal::toString(std::optional<uint32_t> m
     StringAppendF(&result, "totalFrames = %d\n", totalFrames);
     StringAppendF(&result, "missedFrames = %d\n", missedFrames);
     StringAppendF(&result, "clientCompositionFrames = %d\n", clientCompositionFrames);
+    StringAppendF(&result, "predictedMissedFrames = %d\n", predictedMissedFrames);
     StringAppendF(&result, "displayOnTime = %" PRId64 " ms\n", displayOnTime);
     StringAppendF(&result, "displayConfigStats is as below:\n");
     for (const auto& [fps, duration] : refreshRateStats) {
@@ -111,6 +186,12 @@ std::string TimeStatsHelper::TimeStatsGlobal::toString(std::optional<uint32_t> m
     StringAppendF(&result, "totalP2PTime = %" PRId64 " ms\n", presentToPresent.totalTime());
     StringAppendF(&result, "presentToPresent histogram is as below:\n");
     result.append(presentToPresent.toString());
+    if (!frameStages.empty()) {
+        StringAppendF(&result, "frameStages are as below:\n");
+        for (const auto& [key, stages] : frameStages) {
+            result.append(stages.toString());
+        }
+    }
     const auto dumpStats = generateDumpStats(maxLayers);
     for (const auto& ele : dumpStats) {
         result.append(ele->toString());
@@ -145,6 +226,7 @@ SFTimeStatsGlobalProto TimeStatsHelper::TimeStatsGlobal::toProto(
     globalProto.set_total_frames(totalFrames);
     globalProto.set_missed_frames(missedFrames);
     globalProto.set_client_composition_frames(clientCompositionFrames);
+    globalProto.set_predicted_missed_frames(predictedMissedFrames);
     globalProto.set_display_on_time(displayOnTime);
     for (const auto& ele : refreshRateStats) {
         SFTimeStatsDisplayConfigBucketProto* configBucketProto =
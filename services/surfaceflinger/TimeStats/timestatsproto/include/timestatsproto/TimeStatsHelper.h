@@ -18,6 +18,8 @@
 #include <timestatsproto/TimeStatsProtoHeader.h>
 #include <utils/Timers.h>
 
+#include <array>
+#include <map>
 #include <optional>
 #include <string>
 #include <unordered_map>
@@ -30,16 +32,63 @@ class TimeStatsHelper {
 public:
     class Histogram {
     public:
+        // Number of time buckets the deltas are lower bounded to
+        static constexpr int32_t kBucketCount = 85;
+        // Count per time bucket, which can be inserted into without allocating.
+        // Collected where deltas are measured, and merged into a Histogram later.
+        using Buckets = std::array<int32_t, kBucketCount>;
+
         // Key is the delta time between timestamps
         // Value is the number of appearances of that delta
         std::unordered_map<int32_t, int32_t> hist;
 
         void insert(int32_t delta);
+        static void insert(Buckets* buckets, int32_t delta);
+        void merge(const Buckets& buckets);
         int64_t totalTime() const;
         float averageTime() const;
         std::string toString() const;
     };
 
+    // Durations in microseconds, in buckets at most an eighth apart, so that
+    // percentiles stay meaningful for stages well under a millisecond
+    class DurationHistogram {
+    public:
+        static constexpr size_t kBucketCount = 176;
+
+        void insert(nsecs_t duration);
+        int32_t count() const { return mCount; }
+        // Upper bound of the bucket holding the given fraction of the samples
+        int64_t percentileMicros(float fraction) const;
+
+    private:
+        std::array<int32_t, kBucketCount> mBuckets{};
+        int32_t mCount = 0;
+    };
+
+    // What SurfaceFlinger does to present a frame, in order
+    enum class FrameStage {
+        TransactionApply,
+        Latch,
+        CompositionStrategy,
+        RenderEngine,
+        HwcPresent,
+        FenceSignal,
+        Count,
+    };
+    static constexpr size_t kFrameStageCount = static_cast<size_t>(FrameStage::Count);
+
+    // Stage durations of the frames presented on a display at a refresh rate
+    class TimeStatsFrameStages {
+    public:
+        uint64_t displayId = 0;
+        uint32_t fps = 0;
+        int32_t totalFrames = 0;
+        std::array<DurationHistogram, kFrameStageCount> stages;
+
+        std::string toString() const;
+    };
+
     class TimeStatsLayer {
     public:
         std::string layerName;
@@ -59,10 +108,13 @@ public:
         int32_t totalFrames = 0;
         int32_t missedFrames = 0;
         int32_t clientCompositionFrames = 0;
+        int32_t predictedMissedFrames = 0;
         int64_t displayOnTime = 0;
         Histogram presentToPresent;
         std::unordered_map<std::string, TimeStatsLayer> stats;
         std::unordered_map<uint32_t, nsecs_t> refreshRateStats;
+        // Keyed by display id and refresh rate. Only part of the text dump.
+        std::map<std::pair<uint64_t, uint32_t>, TimeStatsFrameStages> frameStages;
 
         std::string toString(std::optional<uint32_t> maxLayers) const;
         SFTimeStatsGlobalProto toProto(std::optional<uint32_t> maxLayers) const;
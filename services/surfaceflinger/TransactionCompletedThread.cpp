@@ -24,6 +24,7 @@
 #include <cinttypes>
 
 #include <binder/IInterface.h>
+#include <binder/IPCThreadState.h>
 #include <gui/ITransactionCompletedListener.h>
 #include <utils/RefBase.h>
 
@@ -227,6 +228,9 @@ void TransactionCompletedThread::threadMain() {
         mConditionVariable.wait(mMutex);
         std::vector<ListenerStats> completedListenerStats;
 
+        // The callbacks are oneway; submit them to the driver together.
+        IPCThreadState::self()->beginOnewayBatch();
+
         // For each listener
         auto completedTransactionsItr = mCompletedTransactions.begin();
         while (completedTransactionsItr != mCompletedTransactions.end()) {
@@ -274,6 +278,7 @@ void TransactionCompletedThread::threadMain() {
 
             completedListenerStats.push_back(std::move(listenerStats));
         }
+        IPCThreadState::self()->endOnewayBatch();
 
         if (mPresentFence) {
             mPresentFence.clear();
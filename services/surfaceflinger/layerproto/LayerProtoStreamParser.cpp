@@ -0,0 +1,358 @@
+/*
+ * Copyright 2019 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include <layerproto/LayerProtoStreamParser.h>
+
+#include <cstring>
+
+namespace android {
+namespace surfaceflinger {
+
+namespace {
+
+// Wire types, see https://developers.google.com/protocol-buffers/docs/encoding
+enum WireType : uint32_t {
+    VARINT = 0,
+    FIXED64 = 1,
+    LENGTH_DELIMITED = 2,
+    FIXED32 = 5,
+};
+
+// Field numbers of the messages around LayerProto
+constexpr uint32_t TRACE_FILE_ENTRY = 2;
+constexpr uint32_t ENTRY_ELAPSED_REALTIME_NANOS = 1;
+constexpr uint32_t ENTRY_WHERE = 2;
+constexpr uint32_t ENTRY_LAYERS = 3;
+constexpr uint32_t ENTRY_MISSED_FRAME_COUNT = 4;
+constexpr uint32_t LAYERS_LAYERS = 1;
+
+} // namespace
+
+// Walks the fields of one message. Any read past the end or of an unknown wire
+// type marks the reader as failed, after which no more fields are returned.
+class LayerProtoStreamParser::Reader {
+public:
+    Reader(const uint8_t* data, size_t size) : mPos(data), mEnd(data + size) {}
+
+    bool failed() const { return mFailed; }
+
+    // Reads the next field header, returning false at the end or on error
+    bool next(uint32_t* fieldNumber, uint32_t* wireType) {
+        if (mFailed || mPos == mEnd) {
+            return false;
+        }
+        const uint64_t tag = readVarint();
+        *fieldNumber = uint32_t(tag >> 3);
+        *wireType = uint32_t(tag & 0x7);
+        return !mFailed;
+    }
+
+    uint64_t readVarint() {
+        uint64_t value = 0;
+        for (uint32_t shift = 0; shift < 64; shift += 7) {
+            if (mPos == mEnd) {
+                break;
+            }
+            const uint8_t byte = *mPos++;
+            value |= uint64_t(byte & 0x7f) << shift;
+            if ((byte & 0x80) == 0) {
+                return value;
+            }
+        }
+        mFailed = true;
+        return 0;
+    }
+
+    uint32_t readFixed32() {
+        uint32_t value = 0;
+        if (!take(sizeof(value))) return 0;
+        memcpy(&value, mPos - sizeof(value), sizeof(value));
+        return value;
+    }
+
+    uint64_t readFixed64() {
+        uint64_t value = 0;
+        if (!take(sizeof(value))) return 0;
+        memcpy(&value, mPos - sizeof(value), sizeof(value));
+        return value;
+    }
+
+    float readFloat() {
+        const uint32_t bits = readFixed32();
+        float value;
+        memcpy(&value, &bits, sizeof(value));
+        return value;
+    }
+
+    Reader readMessage() {
+        const uint64_t size = readVarint();
+        if (mFailed || !take(size)) {
+            return Reader(nullptr, 0);
+        }
+        return Reader(mPos - size, size);
+    }
+
+    std::string_view readString() {
+        const Reader reader = readMessage();
+        return std::string_view(reinterpret_cast<const char*>(reader.mPos),
+                                size_t(reader.mEnd - reader.mPos));
+    }
+
+    // Repeated scalars may come one per field or packed together
+    void readRepeatedVarint(uint32_t wireType, std::vector<int32_t>* values) {
+        if (wireType == VARINT) {
+            values->push_back(int32_t(readVarint()));
+            return;
+        }
+        Reader packed = readMessage();
+        while (!packed.mFailed && packed.mPos != packed.mEnd) {
+            values->push_back(int32_t(packed.readVarint()));
+        }
+        mFailed |= packed.mFailed;
+    }
+
+    void skip(uint32_t wireType) {
+        switch (wireType) {
+            case VARINT:
+                readVarint();
+                break;
+            case FIXED64:
+                take(sizeof(uint64_t));
+                break;
+            case LENGTH_DELIMITED:
+                readMessage();
+                break;
+            case FIXED32:
+                take(sizeof(uint32_t));
+                break;
+            default:
+                // Groups are long deprecated and never written by SurfaceFlinger
+                mFailed = true;
+                break;
+        }
+    }
+
+private:
+    bool take(uint64_t size) {
+        if (mFailed || size > uint64_t(mEnd - mPos)) {
+            mFailed = true;
+            return false;
+        }
+        mPos += size;
+        return true;
+    }
+
+    const uint8_t* mPos;
+    const uint8_t* mEnd;
+    bool mFailed = false;
+};
+
+bool LayerProtoStreamParser::parseTrace(const uint8_t* data, size_t size,
+                                        const SnapshotVisitor& snapshotVisitor,
+                                        const LayerVisitor& layerVisitor) const {
+    Reader reader(data, size);
+    uint32_t fieldNumber, wireType;
+    while (reader.next(&fieldNumber, &wireType)) {
+        if (fieldNumber == TRACE_FILE_ENTRY && wireType == LENGTH_DELIMITED) {
+            if (!parseEntry(reader.readMessage(), snapshotVisitor, layerVisitor)) {
+                return false;
+            }
+        } else {
+            reader.skip(wireType);
+        }
+    }
+    return !reader.failed();
+}
+
+bool LayerProtoStreamParser::parseEntry(Reader entry, const SnapshotVisitor& snapshotVisitor,
+                                        const LayerVisitor& layerVisitor) const {
+    // The snapshot fields may follow the layers, so they are gathered first by
+    // skipping over the layers, which costs no more than reading their length.
+    Snapshot snapshot;
+    Reader reader = entry;
+    uint32_t fieldNumber, wireType;
+    while (reader.next(&fieldNumber, &wireType)) {
+        if (fieldNumber == ENTRY_ELAPSED_REALTIME_NANOS && wireType == FIXED64) {
+            snapshot.elapsedRealtimeNanos = reader.readFixed64();
+        } else if (fieldNumber == ENTRY_WHERE && wireType == LENGTH_DELIMITED) {
+            snapshot.where = reader.readString();
+        } else if (fieldNumber == ENTRY_MISSED_FRAME_COUNT && wireType == VARINT) {
+            snapshot.missedFrameCount = uint32_t(reader.readVarint());
+        } else {
+            reader.skip(wireType);
+        }
+    }
+    if (reader.failed()) {
+        return false;
+    }
+    if (!snapshotVisitor(snapshot)) {
+        return true;
+    }
+
+    reader = entry;
+    while (reader.next(&fieldNumber, &wireType)) {
+        if (fieldNumber == ENTRY_LAYERS && wireType == LENGTH_DELIMITED) {
+            if (!visitLayers(reader.readMessage(), layerVisitor)) {
+                return false;
+            }
+        } else {
+            reader.skip(wireType);
+        }
+    }
+    return !reader.failed();
+}
+
+bool LayerProtoStreamParser::parseLayers(const uint8_t* data, size_t size,
+                                         const LayerVisitor& layerVisitor) const {
+    return visitLayers(Reader(data, size), layerVisitor);
+}
+
+bool LayerProtoStreamParser::visitLayers(Reader reader, const LayerVisitor& layerVisitor) const {
+    uint32_t fieldNumber, wireType;
+    Layer layer;
+    while (reader.next(&fieldNumber, &wireType)) {
+        if (fieldNumber != LAYERS_LAYERS || wireType != LENGTH_DELIMITED) {
+            reader.skip(wireType);
+            continue;
+        }
+        if (!parseLayer(reader.readMessage(), &layer)) {
+            return false;
+        }
+        layerVisitor(layer);
+    }
+    return !reader.failed();
+}
+
+bool LayerProtoStreamParser::parseLayer(Reader reader, Layer* layer) const {
+    // Keep the children's storage around from one layer to the next
+    std::vector<int32_t> children = std::move(layer->children);
+    children.clear();
+    *layer = Layer();
+    layer->children = std::move(children);
+
+    uint32_t fieldNumber, wireType;
+    while (reader.next(&fieldNumber, &wireType)) {
+        if (fieldNumber >= 64 || (mFields & (1ull << fieldNumber)) == 0) {
+            reader.skip(wireType);
+            continue;
+        }
+
+        switch (fieldNumber) {
+            case 1:
+                layer->id = int32_t(reader.readVarint());
+                break;
+            case 2:
+                layer->name = reader.readString();
+                break;
+            case 3:
+                reader.readRepeatedVarint(wireType, &layer->children);
+                break;
+            case 5:
+                layer->type = reader.readString();
+                break;
+            case 9:
+                layer->layerStack = uint32_t(reader.readVarint());
+                break;
+            case 10:
+                layer->z = int32_t(reader.readVarint());
+                break;
+            case 11: {
+                Reader position = reader.readMessage();
+                uint32_t field, type;
+                while (position.next(&field, &type)) {
+                    if (field == 1 && type == FIXED32) {
+                        layer->position.x = position.readFloat();
+                    } else if (field == 2 && type == FIXED32) {
+                        layer->position.y = position.readFloat();
+                    } else {
+                        position.skip(type);
+                    }
+                }
+                if (position.failed()) return false;
+                break;
+            }
+            case 13: {
+                Reader size = reader.readMessage();
+                uint32_t field, type;
+                while (size.next(&field, &type)) {
+                    if (field == 1 && type == VARINT) {
+                        layer->size.x = int32_t(size.readVarint());
+                    } else if (field == 2 && type == VARINT) {
+                        layer->size.y = int32_t(size.readVarint());
+                    } else {
+                        size.skip(type);
+                    }
+                }
+                if (size.failed()) return false;
+                break;
+            }
+            case 16:
+                layer->isOpaque = reader.readVarint() != 0;
+                break;
+            case 22:
+                layer->flags = uint32_t(reader.readVarint());
+                break;
+            case 25:
+                layer->parent = int32_t(reader.readVarint());
+                break;
+            case 26:
+                layer->zOrderRelativeOf = int32_t(reader.readVarint());
+                break;
+            case 27: {
+                Reader buffer = reader.readMessage();
+                uint32_t field, type;
+                while (buffer.next(&field, &type)) {
+                    if (type != VARINT) {
+                        buffer.skip(type);
+                    } else if (field == 1) {
+                        layer->activeBuffer.width = uint32_t(buffer.readVarint());
+                    } else if (field == 2) {
+                        layer->activeBuffer.height = uint32_t(buffer.readVarint());
+                    } else if (field == 3) {
+                        layer->activeBuffer.stride = uint32_t(buffer.readVarint());
+                    } else if (field == 4) {
+                        layer->activeBuffer.format = int32_t(buffer.readVarint());
+                    } else {
+                        buffer.skip(type);
+                    }
+                }
+                if (buffer.failed()) return false;
+                break;
+            }
+            case 28:
+                layer->queuedFrames = int32_t(reader.readVarint());
+                break;
+            case 35:
+                layer->hwcCompositionType = int32_t(reader.readVarint());
+                break;
+            case 36:
+                layer->isProtected = reader.readVarint() != 0;
+                break;
+            case 37:
+                layer->currFrame = reader.readVarint();
+                break;
+            case 41:
+                layer->cornerRadius = reader.readFloat();
+                break;
+            default:
+                reader.skip(wireType);
+                break;
+        }
+    }
+    return !reader.failed();
+}
+
+} // namespace surfaceflinger
+} // namespace android
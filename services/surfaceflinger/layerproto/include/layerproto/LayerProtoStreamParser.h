@@ -0,0 +1,123 @@
+/*
+ * Copyright 2019 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#pragma once
+
+#include <math/vec2.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <string_view>
+#include <vector>
+
+namespace android {
+namespace surfaceflinger {
+
+// Reads layers straight from the wire format of a LayersTraceFileProto or a
+// LayersProto, one at a time, without building protobuf messages or a layer
+// tree. Only the LayerProto fields asked for are decoded; the rest are skipped
+// over, so tools looking at a few fields of large traces stay fast.
+//
+// Strings point into the parsed data, which must outlive the visitors' use of
+// them; mapping the trace file and parsing the mapping avoids copying it.
+class LayerProtoStreamParser {
+public:
+    // LayerProto fields which can be decoded, one bit per field number
+    enum Field : uint64_t {
+        ID = 1ull << 1,
+        NAME = 1ull << 2,
+        CHILDREN = 1ull << 3,
+        TYPE = 1ull << 5,
+        LAYER_STACK = 1ull << 9,
+        Z = 1ull << 10,
+        POSITION = 1ull << 11,
+        SIZE = 1ull << 13,
+        IS_OPAQUE = 1ull << 16,
+        FLAGS = 1ull << 22,
+        PARENT = 1ull << 25,
+        Z_ORDER_RELATIVE_OF = 1ull << 26,
+        ACTIVE_BUFFER = 1ull << 27,
+        QUEUED_FRAMES = 1ull << 28,
+        HWC_COMPOSITION_TYPE = 1ull << 35,
+        IS_PROTECTED = 1ull << 36,
+        CURR_FRAME = 1ull << 37,
+        CORNER_RADIUS = 1ull << 41,
+    };
+    using FieldMask = uint64_t;
+    static constexpr FieldMask ALL_FIELDS = ~FieldMask(0);
+
+    struct ActiveBuffer {
+        uint32_t width = 0;
+        uint32_t height = 0;
+        uint32_t stride = 0;
+        int32_t format = 0;
+    };
+
+    // Fields not asked for, or not in the data, keep their proto defaults
+    struct Layer {
+        int32_t id = 0;
+        std::string_view name;
+        std::vector<int32_t> children;
+        std::string_view type;
+        uint32_t layerStack = 0;
+        int32_t z = 0;
+        float2 position;
+        int2 size;
+        bool isOpaque = false;
+        uint32_t flags = 0;
+        int32_t parent = 0;
+        int32_t zOrderRelativeOf = 0;
+        ActiveBuffer activeBuffer;
+        int32_t queuedFrames = 0;
+        int32_t hwcCompositionType = 0;
+        bool isProtected = false;
+        uint64_t currFrame = 0;
+        float cornerRadius = 0.f;
+    };
+
+    struct Snapshot {
+        uint64_t elapsedRealtimeNanos = 0;
+        std::string_view where;
+        uint32_t missedFrameCount = 0;
+    };
+
+    // Called for each trace entry before its layers. Returning false skips them.
+    using SnapshotVisitor = std::function<bool(const Snapshot&)>;
+    // Called for each layer, with the same Layer object reset in between
+    using LayerVisitor = std::function<void(const Layer&)>;
+
+    explicit LayerProtoStreamParser(FieldMask fields = ALL_FIELDS) : mFields(fields) {}
+
+    // Parses a LayersTraceFileProto, entry by entry. Returns false if the data is malformed.
+    bool parseTrace(const uint8_t* data, size_t size, const SnapshotVisitor& snapshotVisitor,
+                    const LayerVisitor& layerVisitor) const;
+
+    // Parses a single LayersProto, such as dumpsys SurfaceFlinger --proto writes
+    bool parseLayers(const uint8_t* data, size_t size, const LayerVisitor& layerVisitor) const;
+
+private:
+    class Reader;
+
+    bool parseEntry(Reader entry, const SnapshotVisitor& snapshotVisitor,
+                    const LayerVisitor& layerVisitor) const;
+    bool visitLayers(Reader layersProto, const LayerVisitor& layerVisitor) const;
+    bool parseLayer(Reader reader, Layer* layer) const;
+
+    const FieldMask mFields;
+};
+
+} // namespace surfaceflinger
+} // namespace android
@@ -31,7 +31,9 @@
 
 #include <fstream>
 #include <random>
+#include <set>
 #include <thread>
+#include <vector>
 
 namespace android {
 
@@ -862,4 +864,48 @@ TEST_F(SurfaceInterceptorTest, InterceptSimultaneousUpdatesWorks) {
     ASSERT_TRUE(singleIncrementFound(capturedTrace, Increment::IncrementCase::kSurfaceCreation));
 }
 
+// Transactions arrive on several binder threads, each capturing into a buffer of its own. All of
+// them have to make it into the trace, in the order they were captured.
+TEST_F(SurfaceInterceptorTest, InterceptUpdatesFromManyThreadsWorks) {
+    constexpr int kThreads = 8;
+    constexpr int kUpdatesPerThread = 16;
+    enableInterceptor();
+    setupBackgroundSurface();
+    std::vector<std::thread> threads;
+    for (int i = 0; i < kThreads; i++) {
+        threads.emplace_back([this, i]() {
+            for (int j = 0; j < kUpdatesPerThread; j++) {
+                Transaction t;
+                t.setPosition(mBGSurfaceControl, i, j);
+                t.apply(true);
+            }
+        });
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+    disableInterceptor();
+
+    Trace capturedTrace;
+    ASSERT_EQ(NO_ERROR, readProtoFile(&capturedTrace));
+    preProcessTrace(capturedTrace);
+
+    std::set<std::pair<float, float>> positions;
+    int64_t lastTimeStamp = 0;
+    for (const auto& increment : capturedTrace.increment()) {
+        EXPECT_LE(lastTimeStamp, increment.time_stamp());
+        lastTimeStamp = increment.time_stamp();
+        if (increment.increment_case() != increment.kTransaction) {
+            continue;
+        }
+        for (const auto& change : increment.transaction().surface_change()) {
+            if (change.id() == mBGLayerId &&
+                change.SurfaceChange_case() == SurfaceChange::SurfaceChangeCase::kPosition) {
+                positions.emplace(change.position().x(), change.position().y());
+            }
+        }
+    }
+    EXPECT_EQ(static_cast<size_t>(kThreads * kUpdatesPerThread), positions.size());
+}
+
 }
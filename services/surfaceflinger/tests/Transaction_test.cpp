@@ -2934,6 +2934,147 @@ TEST_F(LayerTransactionTest, ReparentToSelf) {
     }
 }
 
+// BufferStateLayers are inserted into the layer tree after createSurface returns; the
+// transactions that follow must still find them, and their parent.
+TEST_F(LayerTransactionTest, BufferStateChildUsableRightAfterCreation) {
+    sp<SurfaceControl> parent;
+    ASSERT_NO_FATAL_FAILURE(
+            parent = createLayer("parent", 64, 64, ISurfaceComposerClient::eFXSurfaceBufferState));
+    sp<SurfaceControl> child;
+    ASSERT_NO_FATAL_FAILURE(child = createLayer("child", 32, 32,
+                                                ISurfaceComposerClient::eFXSurfaceBufferState,
+                                                parent.get()));
+    ASSERT_NO_FATAL_FAILURE(fillBufferStateLayerColor(parent, Color::BLUE, 64, 64));
+    ASSERT_NO_FATAL_FAILURE(fillBufferStateLayerColor(child, Color::RED, 32, 32));
+    Transaction()
+            .setFrame(parent, Rect(0, 0, 64, 64))
+            .setFrame(child, Rect(0, 0, 32, 32))
+            .setLayer(child, 1)
+            .apply();
+
+    auto shot = screenshot();
+    shot->expectColor(Rect(0, 0, 32, 32), Color::RED);
+    shot->expectColor(Rect(32, 0, 64, 32), Color::BLUE);
+    shot->expectColor(Rect(0, 32, 64, 64), Color::BLUE);
+    shot->expectBorder(Rect(0, 0, 64, 64), Color::BLACK);
+}
+
+TEST_F(LayerTransactionTest, BufferStateLayersCreatedFromManyThreads) {
+    constexpr int kThreadCount = 4;
+    constexpr int kLayersPerThread = 8;
+    constexpr int kLayerSize = 8;
+    std::vector<sp<SurfaceControl>> layers(kThreadCount * kLayersPerThread);
+    std::vector<std::thread> threads;
+    for (int t = 0; t < kThreadCount; t++) {
+        threads.emplace_back([&, t] {
+            for (int i = 0; i < kLayersPerThread; i++) {
+                const int index = t * kLayersPerThread + i;
+                layers[index] = createLayer("test", kLayerSize, kLayerSize,
+                                            ISurfaceComposerClient::eFXSurfaceBufferState);
+            }
+        });
+    }
+    for (std::thread& thread : threads) {
+        thread.join();
+    }
+
+    for (size_t i = 0; i < layers.size(); i++) {
+        ASSERT_NE(nullptr, layers[i]);
+        ASSERT_NO_FATAL_FAILURE(
+                fillBufferStateLayerColor(layers[i], Color::RED, kLayerSize, kLayerSize));
+        const int32_t left = static_cast<int32_t>(i) * kLayerSize;
+        Transaction().setFrame(layers[i], Rect(left, 0, left + kLayerSize, kLayerSize)).apply();
+    }
+
+    auto shot = screenshot();
+    const Rect all(0, 0, static_cast<int32_t>(layers.size()) * kLayerSize, kLayerSize);
+    shot->expectColor(all, Color::RED);
+    shot->expectBorder(all, Color::BLACK);
+}
+
+TEST_F(LayerTransactionTest, BufferStateChildOfRemovedParentStaysOffscreen) {
+    sp<SurfaceControl> parent;
+    ASSERT_NO_FATAL_FAILURE(parent = createLayer("parent", 32, 32));
+    sp<SurfaceControl> child;
+    ASSERT_NO_FATAL_FAILURE(child = createLayer("child", 32, 32,
+                                                ISurfaceComposerClient::eFXSurfaceBufferState,
+                                                parent.get()));
+    ASSERT_NO_FATAL_FAILURE(fillBufferStateLayerColor(child, Color::RED, 32, 32));
+    Transaction().setFrame(child, Rect(0, 0, 32, 32)).apply();
+    Transaction().reparent(parent, nullptr).apply();
+    parent.clear();
+
+    auto shot = screenshot();
+    shot->expectColor(Rect(0, 0, 32, 32), Color::BLACK);
+}
+
+class TransactionBatchingTest : public LayerTransactionTest {
+protected:
+    void TearDown() override {
+        Transaction::setApplyBatchingWindow(0);
+        LayerTransactionTest::TearDown();
+    }
+
+    // Captures the screen without applying a transaction first, which would send the
+    // pending batch along with it.
+    std::unique_ptr<ScreenCapture> screenshotWithoutSync() {
+        sp<ISurfaceComposer> sf(ComposerService::getComposerService());
+        sp<GraphicBuffer> outBuffer;
+        EXPECT_EQ(NO_ERROR,
+                  sf->captureScreen(SurfaceComposerClient::getInternalDisplayToken(), &outBuffer,
+                                    Rect(), 0, 0, false));
+        return std::make_unique<ScreenCapture>(outBuffer);
+    }
+};
+
+TEST_F(TransactionBatchingTest, SynchronousApplySendsBatch) {
+    sp<SurfaceControl> layer;
+    ASSERT_NO_FATAL_FAILURE(layer = createLayer("test", 32, 32));
+    ASSERT_NO_FATAL_FAILURE(fillBufferQueueLayerColor(layer, Color::RED, 32, 32));
+
+    Transaction::setApplyBatchingWindow(std::chrono::nanoseconds(10s).count());
+    Transaction().setPosition(layer, 5, 10).apply();
+    Transaction().setPosition(layer, 20, 20).apply();
+
+    // screenshot() applies synchronously, which sends the merged batch with it; the later
+    // apply wins.
+    const Rect rect(20, 20, 52, 52);
+    auto shot = screenshot();
+    shot->expectColor(rect, Color::RED);
+    shot->expectBorder(rect, Color::BLACK);
+}
+
+TEST_F(TransactionBatchingTest, BatchIsSentAfterWindow) {
+    sp<SurfaceControl> layer;
+    ASSERT_NO_FATAL_FAILURE(layer = createLayer("test", 32, 32));
+    ASSERT_NO_FATAL_FAILURE(fillBufferQueueLayerColor(layer, Color::RED, 32, 32));
+
+    Transaction::setApplyBatchingWindow(std::chrono::nanoseconds(16ms).count());
+    Transaction().setPosition(layer, 5, 10).apply();
+    std::this_thread::sleep_for(200ms);
+
+    const Rect rect(5, 10, 37, 42);
+    auto shot = screenshotWithoutSync();
+    shot->expectColor(rect, Color::RED);
+    shot->expectBorder(rect, Color::BLACK);
+}
+
+TEST_F(TransactionBatchingTest, DisablingBatchingSendsBatch) {
+    sp<SurfaceControl> layer;
+    ASSERT_NO_FATAL_FAILURE(layer = createLayer("test", 32, 32));
+    ASSERT_NO_FATAL_FAILURE(fillBufferQueueLayerColor(layer, Color::RED, 32, 32));
+
+    Transaction::setApplyBatchingWindow(std::chrono::nanoseconds(10s).count());
+    Transaction().setPosition(layer, 5, 10).apply();
+    Transaction::setApplyBatchingWindow(0);
+    std::this_thread::sleep_for(200ms);
+
+    const Rect rect(5, 10, 37, 42);
+    auto shot = screenshotWithoutSync();
+    shot->expectColor(rect, Color::RED);
+    shot->expectBorder(rect, Color::BLACK);
+}
+
 class ColorTransformHelper {
 public:
     static void DegammaColorSingle(half& s) {
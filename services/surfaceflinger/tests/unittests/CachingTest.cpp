@@ -20,6 +20,7 @@
 #include <gmock/gmock.h>
 #include <gtest/gtest.h>
 #include <gui/BufferQueue.h>
+#include <set>
 #include "BufferStateLayer.h"
 
 namespace android {
@@ -90,4 +91,22 @@ TEST_F(SlotGenerationTest, getHwcCacheSlot_Reuse) {
         cacheId++;
     }
 }
+
+TEST_F(SlotGenerationTest, getHwcCacheSlot_SkipsFlattenerSlot) {
+    using compositionengine::impl::HwcBufferCache;
+    constexpr uint32_t kSlotCount = HwcBufferCache::SLOT_COUNT - 1;
+    BufferStateLayer::HwcSlotGenerator hwcSlotGenerator(kSlotCount);
+
+    sp<IBinder> binder = new BBinder();
+    std::set<uint32_t> slots;
+    for (uint32_t i = 0; i < kSlotCount; i++) {
+        client_cache_t id;
+        id.token = binder;
+        id.id = i;
+        slots.insert(hwcSlotGenerator.getHwcCacheSlot(id));
+    }
+    EXPECT_EQ(kSlotCount, slots.size());
+    EXPECT_EQ(0u, slots.count(HwcBufferCache::FLATTENER_CACHING_SLOT));
+    EXPECT_EQ(uint32_t(HwcBufferCache::SLOT_COUNT - 1), *slots.rbegin());
+}
 } // namespace android
@@ -0,0 +1,113 @@
+/*
+ * Copyright 2019 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#undef LOG_TAG
+#define LOG_TAG "ColorMatrixTest"
+
+#include <gtest/gtest.h>
+#include <log/log.h>
+
+#include "Effects/Daltonizer.h"
+#include "TestableSurfaceFlinger.h"
+
+namespace android {
+namespace {
+
+class ColorMatrixTest : public testing::Test {
+public:
+    ColorMatrixTest() {
+        const ::testing::TestInfo* const test_info =
+                ::testing::UnitTest::GetInstance()->current_test_info();
+        ALOGD("**** Setting up for %s.%s\n", test_info->test_case_name(), test_info->name());
+
+        // A transaction is already pending, so updating the color matrix doesn't try to wake
+        // up the main thread.
+        mFlinger.mutableTransactionFlags() = eTransactionNeeded;
+    }
+
+    ~ColorMatrixTest() {
+        const ::testing::TestInfo* const test_info =
+                ::testing::UnitTest::GetInstance()->current_test_info();
+        ALOGD("**** Tearing down after %s.%s\n", test_info->test_case_name(), test_info->name());
+    }
+
+    void setDaltonizer(ColorBlindnessType type, ColorBlindnessMode mode) {
+        mFlinger.mutableDaltonizer().setType(type);
+        mFlinger.mutableDaltonizer().setMode(mode);
+    }
+
+    // Returns the hint given to the composer for the current inputs.
+    android_color_transform_t updateHint() {
+        mFlinger.updateColorMatrixLocked();
+        return mFlinger.mutableCurrentState().colorMatrixHint;
+    }
+
+    TestableSurfaceFlinger mFlinger;
+};
+
+TEST_F(ColorMatrixTest, zeroSaturationIsGrayscale) {
+    mFlinger.mutableGlobalSaturationFactor() = 0.0f;
+    EXPECT_EQ(HAL_COLOR_TRANSFORM_GRAYSCALE, updateHint());
+
+    mFlinger.mutableGlobalSaturationFactor() = 0.5f;
+    EXPECT_EQ(HAL_COLOR_TRANSFORM_ARBITRARY_MATRIX, updateHint());
+}
+
+TEST_F(ColorMatrixTest, correctionIsHintedByType) {
+    setDaltonizer(ColorBlindnessType::Protanomaly, ColorBlindnessMode::Correction);
+    EXPECT_EQ(HAL_COLOR_TRANSFORM_CORRECT_PROTANOPIA, updateHint());
+
+    setDaltonizer(ColorBlindnessType::Deuteranomaly, ColorBlindnessMode::Correction);
+    EXPECT_EQ(HAL_COLOR_TRANSFORM_CORRECT_DEUTERANOPIA, updateHint());
+
+    setDaltonizer(ColorBlindnessType::Tritanomaly, ColorBlindnessMode::Correction);
+    EXPECT_EQ(HAL_COLOR_TRANSFORM_CORRECT_TRITANOPIA, updateHint());
+}
+
+TEST_F(ColorMatrixTest, simulationIsArbitrary) {
+    setDaltonizer(ColorBlindnessType::Deuteranomaly, ColorBlindnessMode::Simulation);
+    EXPECT_EQ(HAL_COLOR_TRANSFORM_ARBITRARY_MATRIX, updateHint());
+}
+
+TEST_F(ColorMatrixTest, combinedTransformsAreArbitrary) {
+    // Grayscale and a correction together
+    mFlinger.mutableGlobalSaturationFactor() = 0.0f;
+    setDaltonizer(ColorBlindnessType::Protanomaly, ColorBlindnessMode::Correction);
+    EXPECT_EQ(HAL_COLOR_TRANSFORM_ARBITRARY_MATRIX, updateHint());
+
+    // A client matrix on top of grayscale
+    setDaltonizer(ColorBlindnessType::None, ColorBlindnessMode::Correction);
+    EXPECT_EQ(HAL_COLOR_TRANSFORM_GRAYSCALE, updateHint());
+    mFlinger.mutableClientColorMatrix() = mat4() * 0.5f;
+    EXPECT_EQ(HAL_COLOR_TRANSFORM_ARBITRARY_MATRIX, updateHint());
+}
+
+TEST_F(ColorMatrixTest, changeOfHintAloneIsAChange) {
+    mFlinger.mutableGlobalSaturationFactor() = 0.0f;
+    ASSERT_EQ(HAL_COLOR_TRANSFORM_GRAYSCALE, updateHint());
+    const mat4 grayscale = mFlinger.mutableCurrentState().colorMatrix;
+
+    // The same matrix from a client, which the composer can't be told is grayscale.
+    mFlinger.mutableGlobalSaturationFactor() = 1.0f;
+    mFlinger.mutableClientColorMatrix() = grayscale;
+    mFlinger.mutableCurrentState().colorMatrixChanged = false;
+    EXPECT_EQ(HAL_COLOR_TRANSFORM_ARBITRARY_MATRIX, updateHint());
+    EXPECT_EQ(grayscale, mFlinger.mutableCurrentState().colorMatrix);
+    EXPECT_TRUE(mFlinger.mutableCurrentState().colorMatrixChanged);
+}
+
+} // namespace
+} // namespace android
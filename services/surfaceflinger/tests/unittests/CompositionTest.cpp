@@ -309,8 +309,8 @@ struct BaseDisplayVariant {
         EXPECT_CALL(*test->mComposer, presentOrValidateDisplay(HWC_DISPLAY, _, _, _, _)).Times(1);
         EXPECT_CALL(*test->mComposer, getDisplayRequests(HWC_DISPLAY, _, _, _)).Times(1);
         EXPECT_CALL(*test->mComposer, acceptDisplayChanges(HWC_DISPLAY)).Times(1);
-        EXPECT_CALL(*test->mComposer, presentDisplay(HWC_DISPLAY, _)).Times(1);
-        EXPECT_CALL(*test->mComposer, getReleaseFences(HWC_DISPLAY, _, _)).Times(1);
+        EXPECT_CALL(*test->mComposer, queuePresentDisplay(HWC_DISPLAY)).Times(1);
+        EXPECT_CALL(*test->mComposer, takeQueuedPresent(HWC_DISPLAY, _, _, _)).Times(1);
 
         EXPECT_CALL(*test->mRenderEngine, useNativeFenceSync()).WillRepeatedly(Return(true));
         // TODO: remove once we verify that we can just grab the fence from the
@@ -367,6 +367,8 @@ struct BaseDisplayVariant {
         EXPECT_CALL(*test->mNativeWindow, dequeueBuffer(_, _))
                 .WillOnce(DoAll(SetArgPointee<0>(test->mNativeWindowBuffer), SetArgPointee<1>(-1),
                                 Return(0)));
+        EXPECT_CALL(*test->mNativeWindow, query(NATIVE_WINDOW_BUFFER_AGE, _))
+                .WillOnce(DoAll(SetArgPointee<1>(0), Return(0)));
         EXPECT_CALL(*test->mRenderEngine, drawLayers)
                 .WillRepeatedly(
                         [](const renderengine::DisplaySettings& displaySettings,
@@ -378,6 +380,8 @@ struct BaseDisplayVariant {
                             EXPECT_EQ(Rect(DEFAULT_DISPLAY_WIDTH, DEFAULT_DISPLAY_HEIGHT),
                                       displaySettings.clip);
                             EXPECT_EQ(ui::Dataspace::UNKNOWN, displaySettings.outputDataspace);
+                            // Buffers of unknown age are redrawn in full
+                            EXPECT_TRUE(displaySettings.damageRegion.isEmpty());
                             return NO_ERROR;
                         });
     }
@@ -516,6 +520,7 @@ struct BaseLayerProperties {
         Mock::VerifyAndClear(test->mMessageQueue);
 
         EXPECT_CALL(*test->mRenderEngine, useNativeFenceSync()).WillRepeatedly(Return(true));
+        EXPECT_CALL(*test->mRenderEngine, prefetchExternalTextureBuffer(_)).Times(1);
         bool ignoredRecomputeVisibleRegions;
         layer->latchBuffer(ignoredRecomputeVisibleRegions, 0);
         Mock::VerifyAndClear(test->mRenderEngine);
@@ -1326,5 +1331,30 @@ TEST_F(CompositionTest, captureScreenNormalBufferLayerOnPoweredOffDisplay) {
             NoCompositionTypeVariant, REScreenshotResultVariant>>();
 }
 
+/* ------------------------------------------------------------------------
+ *  Occupancy segments in layer protos
+ */
+
+TEST_F(CompositionTest, onlyLayerTracingDrainsOccupancySegments) {
+    sp<ColorLayer> layer = ColorLayerVariant<ColorLayerProperties>::createLayer(this);
+    layer->recordOccupancyForTracing({OccupancyTracker::Segment(1000, 2, 0.5f, false)});
+
+    // dumpsys must neither show nor consume the segments queued for the trace
+    LayerProto dumped;
+    layer->writeToProto(&dumped, LayerVector::StateSet::Drawing);
+    EXPECT_EQ(0, dumped.occupancy_segments_size());
+
+    LayerProto traced;
+    layer->writeToProto(&traced, LayerVector::StateSet::Drawing, SurfaceTracing::TRACE_ALL);
+    ASSERT_EQ(1, traced.occupancy_segments_size());
+    EXPECT_EQ(1000, traced.occupancy_segments(0).total_time_ns());
+    EXPECT_EQ(2u, traced.occupancy_segments(0).num_frames());
+
+    // Each segment appears in exactly one trace entry
+    LayerProto tracedAgain;
+    layer->writeToProto(&tracedAgain, LayerVector::StateSet::Drawing, SurfaceTracing::TRACE_ALL);
+    EXPECT_EQ(0, tracedAgain.occupancy_segments_size());
+}
+
 } // namespace
 } // namespace android
@@ -0,0 +1,94 @@
+/*
+ * Copyright 2019 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#undef LOG_TAG
+#define LOG_TAG "SchedulerUnittests"
+
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <vector>
+
+#include <utils/Timers.h>
+
+#include "Scheduler/DispSync.h"
+
+namespace android {
+namespace {
+
+constexpr nsecs_t kPeriod = 16666667;
+constexpr size_t kNumSamples = 24;
+
+class DispSyncTest : public testing::Test {
+protected:
+    DispSyncTest() {
+        mDispSync.init(true, 0);
+        mDispSync.setPeriod(kPeriod);
+    }
+
+    // Feeds hardware vsync events ending about now, each jitter[i % size]
+    // off the true vsync timeline. Returns whether the model locked.
+    bool addSamples(const std::vector<nsecs_t>& jitter, nsecs_t outlierIndex = -1) {
+        const nsecs_t start = systemTime(SYSTEM_TIME_MONOTONIC) - kNumSamples * kPeriod;
+        bool periodFlushed = false;
+        bool locked = false;
+        for (size_t i = 0; i < kNumSamples; i++) {
+            nsecs_t timestamp = start + i * kPeriod + jitter[i % jitter.size()];
+            if (nsecs_t(i) == outlierIndex) {
+                timestamp += 3000000;
+            }
+            locked = !mDispSync.addResyncSample(timestamp, &periodFlushed);
+            mLastVsync = start + i * kPeriod;
+        }
+        return locked;
+    }
+
+    impl::DispSync mDispSync{"DispSyncTest"};
+    nsecs_t mLastVsync = 0;
+};
+
+TEST_F(DispSyncTest, regressionRejectsOutlier) {
+    EXPECT_TRUE(addSamples({0, 100000, -100000, 50000}, kNumSamples / 2));
+
+    EXPECT_NEAR(kPeriod, mDispSync.getPeriod(), 10000);
+    EXPECT_TRUE(mDispSync.isModelConfident(kPeriod));
+
+    // The next predicted vsync stays on the true timeline
+    const nsecs_t next = mDispSync.computeNextRefresh(0);
+    const nsecs_t offset = (next - mLastVsync) % kPeriod;
+    EXPECT_LT(std::min(offset, kPeriod - offset), 500000);
+}
+
+TEST_F(DispSyncTest, jitteryModelIsNotConfident) {
+    addSamples({0, 700000, -700000, 400000});
+
+    EXPECT_NEAR(kPeriod, mDispSync.getPeriod(), 100000);
+    EXPECT_FALSE(mDispSync.isModelConfident(kPeriod));
+}
+
+TEST_F(DispSyncTest, modelIsNotConfidentAtAnotherPeriod) {
+    addSamples({0});
+
+    EXPECT_TRUE(mDispSync.isModelConfident(kPeriod));
+    EXPECT_FALSE(mDispSync.isModelConfident(kPeriod / 2));
+
+    mDispSync.setPeriod(kPeriod / 2);
+    EXPECT_FALSE(mDispSync.isModelConfident(kPeriod));
+}
+
+} // namespace
+} // namespace android
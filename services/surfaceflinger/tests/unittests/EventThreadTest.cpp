@@ -425,6 +425,108 @@ TEST_F(EventThreadTest, setPhaseOffsetForwardsToVSyncSource) {
     expectVSyncSetPhaseOffsetCallReceived(321);
 }
 
+TEST_F(EventThreadTest, vsyncIsDeferredByBudgetLeftOverByWorkDuration) {
+    // A second connection with no work duration gets events right away
+    ConnectionEventRecorder otherConnectionEventRecorder{0};
+    sp<MockEventThreadConnection> otherConnection =
+            createConnection(otherConnectionEventRecorder,
+                             ISurfaceComposer::eConfigChangedSuppress);
+    mThread->setVsyncRate(1, otherConnection);
+    mThread->setVsyncRate(1, mConnection);
+
+    mThread->setWorkBudget(ms2ns(50));
+    EXPECT_EQ(NO_ERROR, mConnection->setWorkDuration(ms2ns(10)));
+    expectVSyncSetEnabledCallReceived(true);
+
+    const nsecs_t timestamp = systemTime(SYSTEM_TIME_MONOTONIC);
+    mCallback->onVSyncEvent(timestamp);
+    expectInterceptCallReceived(timestamp);
+    expectVsyncEventReceivedByConnection("otherConnection", otherConnectionEventRecorder,
+                                         timestamp, 1u);
+
+    // The first connection only gets it 40ms after the event
+    EXPECT_FALSE(mConnectionEventCallRecorder.waitForCall(20ms).has_value());
+    expectVsyncEventReceivedByConnection(timestamp, 1u);
+    EXPECT_GE(systemTime(SYSTEM_TIME_MONOTONIC), timestamp + ms2ns(40));
+}
+
+TEST_F(EventThreadTest, vsyncIsNotDeferredForWorkDurationBeyondBudget) {
+    mThread->setVsyncRate(1, mConnection);
+    mThread->setWorkBudget(ms2ns(10));
+    EXPECT_EQ(NO_ERROR, mConnection->setWorkDuration(ms2ns(20)));
+    EXPECT_EQ(BAD_VALUE, mConnection->setWorkDuration(-1));
+    expectVSyncSetEnabledCallReceived(true);
+
+    const nsecs_t timestamp = systemTime(SYSTEM_TIME_MONOTONIC);
+    mCallback->onVSyncEvent(timestamp);
+    expectInterceptCallReceived(timestamp);
+    expectVsyncEventReceivedByConnection(timestamp, 1u);
+}
+
+TEST_F(EventThreadTest, parkingHoldsBackPeriodicButNotSingleRequests) {
+    mThread->setVsyncRate(1, mConnection);
+    expectVSyncSetEnabledCallReceived(true);
+
+    // Nothing else asks for VSYNC, so it gets disabled
+    mThread->setParked(true);
+    expectVSyncSetEnabledCallReceived(false);
+
+    // Another connection asking for the next VSYNC still gets it, alone
+    ConnectionEventRecorder otherConnectionEventRecorder{0};
+    sp<MockEventThreadConnection> otherConnection =
+            createConnection(otherConnectionEventRecorder,
+                             ISurfaceComposer::eConfigChangedSuppress);
+    mThread->requestNextVsync(otherConnection);
+    expectVSyncSetEnabledCallReceived(true);
+
+    mCallback->onVSyncEvent(123);
+    expectInterceptCallReceived(123);
+    expectVsyncEventReceivedByConnection("otherConnection", otherConnectionEventRecorder, 123,
+                                         1u);
+    EXPECT_FALSE(mConnectionEventCallRecorder.waitForUnexpectedCall().has_value());
+    expectVSyncSetEnabledCallReceived(false);
+
+    // Unparking brings the periodic connection back
+    mThread->setParked(false);
+    expectVSyncSetEnabledCallReceived(true);
+    mCallback->onVSyncEvent(456);
+    expectInterceptCallReceived(456);
+    expectVsyncEventReceivedByConnection(456, 2u);
+}
+
+TEST_F(EventThreadTest, mutedConnectionReadsVSyncFromTimeline) {
+    gui::VsyncTimeline timeline;
+    ASSERT_EQ(NO_ERROR, mConnection->getVsyncTimeline(&timeline, true));
+    gui::VsyncTimeline::Vsync vsync;
+    EXPECT_EQ(TIMED_OUT, timeline.waitForVsync(0, ms2ns(1), &vsync));
+
+    mThread->setVsyncRate(1, mConnection);
+    expectVSyncSetEnabledCallReceived(true);
+
+    // The timeline gets the event, but the channel does not
+    mCallback->onVSyncEvent(123);
+    expectInterceptCallReceived(123);
+    ASSERT_EQ(NO_ERROR, timeline.waitForVsync(0, ms2ns(100), &vsync));
+    EXPECT_EQ(123, vsync.timestamp);
+    EXPECT_EQ(1u, vsync.count);
+    EXPECT_EQ(0, vsync.period);
+    EXPECT_FALSE(mConnectionEventCallRecorder.waitForUnexpectedCall().has_value());
+
+    // The period is estimated from consecutive events
+    mCallback->onVSyncEvent(456);
+    expectInterceptCallReceived(456);
+    ASSERT_EQ(NO_ERROR, timeline.waitForVsync(1, ms2ns(100), &vsync));
+    EXPECT_EQ(456, vsync.timestamp);
+    EXPECT_EQ(2u, vsync.count);
+    EXPECT_EQ(333, vsync.period);
+
+    // Unmuting brings the events back to the channel
+    ASSERT_EQ(NO_ERROR, mConnection->getVsyncTimeline(&timeline, false));
+    mCallback->onVSyncEvent(789);
+    expectInterceptCallReceived(789);
+    expectVsyncEventReceivedByConnection(789, 3u);
+}
+
 TEST_F(EventThreadTest, postHotplugInternalDisconnect) {
     mThread->onHotplugReceived(INTERNAL_DISPLAY_ID, false);
     expectHotplugEventReceivedByConnection(INTERNAL_DISPLAY_ID, false);
@@ -0,0 +1,80 @@
+/*
+ * Copyright 2019 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#undef LOG_TAG
+#define LOG_TAG "SchedulerUnittests"
+
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+
+#include "Scheduler/FrameDeadlinePredictor.h"
+
+namespace android {
+namespace scheduler {
+namespace {
+
+class FrameDeadlinePredictorTest : public testing::Test {
+protected:
+    void addFrames(size_t count, nsecs_t duration, bool clientComposition) {
+        for (size_t i = 0; i < count; i++) {
+            mPredictor.beginFrame(mTime);
+            mTime += duration;
+            mPredictor.endFrame(mTime, clientComposition);
+            mTime += ms2ns(16);
+        }
+    }
+
+    FrameDeadlinePredictor mPredictor;
+    nsecs_t mTime = 0;
+};
+
+TEST_F(FrameDeadlinePredictorTest, nothingIsPredictedWithoutHistory) {
+    EXPECT_EQ(0, mPredictor.predictDuration(false));
+    EXPECT_FALSE(mPredictor.willMissDeadline(0, 1, false));
+
+    addFrames(2, ms2ns(20), false);
+    EXPECT_EQ(0, mPredictor.predictDuration(false));
+}
+
+TEST_F(FrameDeadlinePredictorTest, predictsFromRecentFramesOfTheSameKind) {
+    addFrames(FrameDeadlinePredictor::HISTORY_SIZE, ms2ns(4), false);
+    addFrames(FrameDeadlinePredictor::HISTORY_SIZE, ms2ns(12), true);
+
+    EXPECT_EQ(ms2ns(4), mPredictor.predictDuration(false));
+    EXPECT_EQ(ms2ns(12), mPredictor.predictDuration(true));
+
+    EXPECT_FALSE(mPredictor.willMissDeadline(0, ms2ns(8), false));
+    EXPECT_TRUE(mPredictor.willMissDeadline(0, ms2ns(8), true));
+}
+
+TEST_F(FrameDeadlinePredictorTest, occasionalSpikesAreIgnored) {
+    addFrames(FrameDeadlinePredictor::HISTORY_SIZE - 1, ms2ns(4), false);
+    addFrames(1, ms2ns(30), false);
+
+    EXPECT_EQ(ms2ns(4), mPredictor.predictDuration(false));
+}
+
+TEST_F(FrameDeadlinePredictorTest, framesWhichWereNotStartedAreNotMeasured) {
+    addFrames(FrameDeadlinePredictor::HISTORY_SIZE, ms2ns(4), false);
+
+    // A refresh without invalidate, e.g. from a power mode change
+    mPredictor.endFrame(mTime + ms2ns(100), false);
+    EXPECT_EQ(ms2ns(4), mPredictor.predictDuration(false));
+}
+
+} // namespace
+} // namespace scheduler
+} // namespace android
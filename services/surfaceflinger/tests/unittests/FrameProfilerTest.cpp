@@ -0,0 +1,97 @@
+/*
+ * Copyright 2019 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#undef LOG_TAG
+#define LOG_TAG "LibSurfaceFlingerUnittests"
+
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+
+#include "FrameProfiler.h"
+
+using testing::HasSubstr;
+
+namespace android {
+namespace {
+
+using Stage = FrameProfiler::Stage;
+
+TEST(FrameProfilerTest, nothingIsReportedWithoutFrames) {
+    FrameProfiler profiler;
+    EXPECT_EQ(0u, profiler.count(Stage::Composition));
+    EXPECT_EQ(0, profiler.percentile(Stage::Composition, 50));
+}
+
+TEST(FrameProfilerTest, keepsStagesApart) {
+    FrameProfiler profiler;
+    for (int i = 1; i <= 100; i++) {
+        profiler.record(Stage::Transaction, us2ns(i));
+        profiler.record(Stage::Composition, ms2ns(i));
+    }
+
+    EXPECT_EQ(100u, profiler.count(Stage::Transaction));
+    EXPECT_EQ(100u, profiler.count(Stage::Composition));
+    EXPECT_EQ(0u, profiler.count(Stage::PageFlip));
+    EXPECT_EQ(us2ns(50), profiler.percentile(Stage::Transaction, 50));
+    EXPECT_EQ(ms2ns(90), profiler.percentile(Stage::Composition, 90));
+    EXPECT_EQ(ms2ns(100), profiler.percentile(Stage::Composition, 100));
+}
+
+TEST(FrameProfilerTest, onlyKeepsRecentFrames) {
+    FrameProfiler profiler;
+    for (size_t i = 0; i < FrameProfiler::HISTORY_SIZE; i++) {
+        profiler.record(Stage::PostComposition, ms2ns(20));
+    }
+    for (size_t i = 0; i < FrameProfiler::HISTORY_SIZE; i++) {
+        profiler.record(Stage::PostComposition, ms2ns(2));
+    }
+
+    EXPECT_EQ(FrameProfiler::HISTORY_SIZE, profiler.count(Stage::PostComposition));
+    EXPECT_EQ(ms2ns(2), profiler.percentile(Stage::PostComposition, 100));
+}
+
+TEST(FrameProfilerTest, scopedStageRecordsItsDuration) {
+    FrameProfiler profiler;
+    { FrameProfiler::ScopedStage stage(profiler, Stage::RebuildLayerStacks); }
+
+    EXPECT_EQ(1u, profiler.count(Stage::RebuildLayerStacks));
+    EXPECT_GE(profiler.percentile(Stage::RebuildLayerStacks, 50), 0);
+}
+
+TEST(FrameProfilerTest, clearDropsEveryStage) {
+    FrameProfiler profiler;
+    profiler.record(Stage::Transaction, ms2ns(1));
+    profiler.record(Stage::Composition, ms2ns(1));
+    profiler.clear();
+
+    EXPECT_EQ(0u, profiler.count(Stage::Transaction));
+    EXPECT_EQ(0u, profiler.count(Stage::Composition));
+}
+
+TEST(FrameProfilerTest, dumpsEveryStage) {
+    FrameProfiler profiler;
+    profiler.record(Stage::CalculateWorkingSet, ms2ns(3));
+
+    std::string result;
+    profiler.dump(result);
+    for (size_t i = 0; i < static_cast<size_t>(Stage::Count); i++) {
+        EXPECT_THAT(result, HasSubstr(FrameProfiler::stageName(static_cast<Stage>(i))));
+    }
+    EXPECT_THAT(result, HasSubstr("  CalculateWorkingSet       1   3.000"));
+}
+
+} // namespace
+} // namespace android
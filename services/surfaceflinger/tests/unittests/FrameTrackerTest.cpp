@@ -0,0 +1,77 @@
+/*
+ * Copyright 2019 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#undef LOG_TAG
+#define LOG_TAG "LibSurfaceFlingerUnittests"
+
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+
+#include "FrameTracker.h"
+
+namespace android {
+namespace {
+
+constexpr nsecs_t kPeriod = 16666667;
+constexpr nsecs_t kJankPeriod = 3 * kPeriod;
+
+class FrameTrackerTest : public testing::Test {
+protected:
+    // Presents numFrames frames, one every period, after the last one.
+    void presentFrames(size_t numFrames, nsecs_t period) {
+        for (size_t i = 0; i < numFrames; i++) {
+            mPresentTime += period;
+            mFrameTracker.setDesiredPresentTime(mPresentTime);
+            mFrameTracker.setFrameReadyTime(mPresentTime);
+            mFrameTracker.setActualPresentTime(mPresentTime);
+            mFrameTracker.advanceFrame();
+        }
+    }
+
+    // Whether interval is no more than an eighth above expected
+    static bool isWithinBucket(nsecs_t interval, nsecs_t expected) {
+        return interval >= expected && interval <= expected + expected / 8;
+    }
+
+    FrameTracker mFrameTracker;
+    nsecs_t mPresentTime = 0;
+};
+
+TEST_F(FrameTrackerTest, percentilesOutliveFrameRecords) {
+    EXPECT_EQ(0, mFrameTracker.getPresentIntervalPercentile(0.5f));
+
+    // Many more frames than NUM_FRAME_RECORDS, 2% of them janky
+    for (size_t i = 0; i < 20; i++) {
+        presentFrames(49, kPeriod);
+        presentFrames(1, kJankPeriod);
+    }
+    presentFrames(1, kPeriod);
+
+    EXPECT_TRUE(isWithinBucket(mFrameTracker.getPresentIntervalPercentile(0.5f), kPeriod));
+    EXPECT_TRUE(isWithinBucket(mFrameTracker.getPresentIntervalPercentile(0.95f), kPeriod));
+    EXPECT_TRUE(isWithinBucket(mFrameTracker.getPresentIntervalPercentile(0.99f), kJankPeriod));
+}
+
+TEST_F(FrameTrackerTest, clearStatsForgetsPresentIntervals) {
+    presentFrames(10, kJankPeriod);
+    mFrameTracker.clearStats();
+    presentFrames(10, kPeriod);
+
+    EXPECT_TRUE(isWithinBucket(mFrameTracker.getPresentIntervalPercentile(1.0f), kPeriod));
+}
+
+} // namespace
+} // namespace android
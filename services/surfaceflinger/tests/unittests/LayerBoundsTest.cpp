@@ -0,0 +1,182 @@
+/*
+ * Copyright 2019 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#undef LOG_TAG
+#define LOG_TAG "LayerBoundsTest"
+
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+#include <gui/LayerMetadata.h>
+#include <log/log.h>
+#include <utils/String8.h>
+
+#include "ColorLayer.h"
+#include "Layer.h"
+
+#include "TestableScheduler.h"
+#include "TestableSurfaceFlinger.h"
+#include "mock/MockDispSync.h"
+#include "mock/MockEventControlThread.h"
+#include "mock/MockEventThread.h"
+
+namespace android {
+namespace {
+
+using testing::_;
+
+const FloatRect DISPLAY_BOUNDS(0, 0, 1000, 1000);
+
+class LayerBoundsTest : public testing::Test {
+public:
+    LayerBoundsTest() {
+        const ::testing::TestInfo* const test_info =
+                ::testing::UnitTest::GetInstance()->current_test_info();
+        ALOGD("**** Setting up for %s.%s\n", test_info->test_case_name(), test_info->name());
+
+        setupScheduler();
+    }
+
+    ~LayerBoundsTest() {
+        const ::testing::TestInfo* const test_info =
+                ::testing::UnitTest::GetInstance()->current_test_info();
+        ALOGD("**** Tearing down after %s.%s\n", test_info->test_case_name(), test_info->name());
+    }
+
+    void setupScheduler() {
+        std::vector<scheduler::RefreshRateConfigs::InputConfig> configs{{/*hwcId=*/0, 16666667}};
+        mFlinger.mutableRefreshRateConfigs() =
+                std::make_unique<scheduler::RefreshRateConfigs>(/*refreshRateSwitching=*/false,
+                                                                configs,
+                                                                /*currentConfig=*/0);
+        mScheduler = new TestableScheduler(*mFlinger.mutableRefreshRateConfigs());
+        mScheduler->mutableEventControlThread().reset(mEventControlThread);
+        mScheduler->mutablePrimaryDispSync().reset(mPrimaryDispSync);
+        EXPECT_CALL(*mEventThread.get(), registerDisplayEventConnection(_));
+        sp<Scheduler::ConnectionHandle> connectionHandle =
+                mScheduler->addConnection(std::move(mEventThread));
+        mFlinger.mutableSfConnectionHandle() = std::move(connectionHandle);
+
+        mFlinger.mutableScheduler().reset(mScheduler);
+    }
+
+    sp<ColorLayer> createLayer(const char* name, const Rect& crop) {
+        sp<ColorLayer> layer =
+                new ColorLayer(LayerCreationArgs(mFlinger.mFlinger.get(), sp<Client>(),
+                                                 String8(name), 0, 0, 0, LayerMetadata()));
+        mFlinger.mutableLayerCurrentState(layer).crop_legacy = crop;
+        commit(layer);
+        return layer;
+    }
+
+    void setPosition(const sp<Layer>& layer, float x, float y) {
+        mFlinger.mutableLayerCurrentState(layer).active_legacy.transform.set(x, y);
+        commit(layer);
+    }
+
+    void setCrop(const sp<Layer>& layer, const Rect& crop) {
+        mFlinger.mutableLayerCurrentState(layer).crop_legacy = crop;
+        commit(layer);
+    }
+
+    // Commits the pending state and children of the layer, as a transaction would.
+    void commit(const sp<Layer>& layer) {
+        mFlinger.commitLayerTransaction(layer);
+        layer->commitChildList();
+    }
+
+    TestableScheduler* mScheduler;
+    TestableSurfaceFlinger mFlinger;
+
+    std::unique_ptr<mock::EventThread> mEventThread = std::make_unique<mock::EventThread>();
+    mock::EventControlThread* mEventControlThread = new mock::EventControlThread();
+    mock::DispSync* mPrimaryDispSync = new mock::DispSync();
+};
+
+TEST_F(LayerBoundsTest, childFollowsParentPosition) {
+    sp<ColorLayer> parent = createLayer("parent", Rect(0, 0, 100, 100));
+    sp<ColorLayer> child = createLayer("child", Rect(0, 0, 10, 10));
+    parent->addChild(child);
+    commit(parent);
+
+    parent->computeBounds(DISPLAY_BOUNDS, ui::Transform());
+    EXPECT_EQ(Rect(0, 0, 10, 10), child->getScreenBounds(false /*reduceTransparentRegion*/));
+
+    setPosition(parent, 50, 60);
+    parent->computeBounds(DISPLAY_BOUNDS, ui::Transform());
+    EXPECT_EQ(Rect(50, 60, 150, 160), parent->getScreenBounds(false /*reduceTransparentRegion*/));
+    EXPECT_EQ(Rect(50, 60, 60, 70), child->getScreenBounds(false /*reduceTransparentRegion*/));
+}
+
+TEST_F(LayerBoundsTest, changedDescendantOfUnchangedLayersIsRecomputed) {
+    sp<ColorLayer> root = createLayer("root", Rect(0, 0, 100, 100));
+    sp<ColorLayer> middle = createLayer("middle", Rect(0, 0, 50, 50));
+    sp<ColorLayer> leaf = createLayer("leaf", Rect(0, 0, 10, 10));
+    root->addChild(middle);
+    middle->addChild(leaf);
+    commit(middle);
+    commit(root);
+    root->computeBounds(DISPLAY_BOUNDS, ui::Transform());
+
+    setCrop(leaf, Rect(0, 0, 20, 30));
+    root->computeBounds(DISPLAY_BOUNDS, ui::Transform());
+    EXPECT_EQ(Rect(0, 0, 20, 30), leaf->getScreenBounds(false /*reduceTransparentRegion*/));
+
+    // Still cropped by its unchanged parent.
+    setCrop(leaf, Rect(0, 0, 80, 80));
+    root->computeBounds(DISPLAY_BOUNDS, ui::Transform());
+    EXPECT_EQ(Rect(0, 0, 50, 50), leaf->getScreenBounds(false /*reduceTransparentRegion*/));
+}
+
+TEST_F(LayerBoundsTest, unchangedLayerKeepsCachedBounds) {
+    sp<ColorLayer> layer = createLayer("layer", Rect(0, 0, 100, 100));
+    layer->computeBounds(DISPLAY_BOUNDS, ui::Transform());
+
+    // Not committed, so nothing says the bounds have to be computed again.
+    mFlinger.mutableLayerDrawingState(layer).crop_legacy = Rect(0, 0, 10, 10);
+    layer->computeBounds(DISPLAY_BOUNDS, ui::Transform());
+    EXPECT_EQ(Rect(0, 0, 100, 100), layer->getScreenBounds(false /*reduceTransparentRegion*/));
+
+    // Nor does an equal parent transform.
+    layer->computeBounds(DISPLAY_BOUNDS, ui::Transform(ui::Transform::ROT_0));
+    EXPECT_EQ(Rect(0, 0, 100, 100), layer->getScreenBounds(false /*reduceTransparentRegion*/));
+
+    // Other parent bounds do.
+    layer->computeBounds(FloatRect(0, 0, 500, 500), ui::Transform());
+    EXPECT_EQ(Rect(0, 0, 10, 10), layer->getScreenBounds(false /*reduceTransparentRegion*/));
+}
+
+TEST_F(LayerBoundsTest, reparentedChildUsesNewParent) {
+    sp<ColorLayer> left = createLayer("left", Rect(0, 0, 100, 100));
+    sp<ColorLayer> right = createLayer("right", Rect(0, 0, 100, 100));
+    setPosition(right, 200, 0);
+    sp<ColorLayer> child = createLayer("child", Rect(0, 0, 10, 10));
+    left->addChild(child);
+    commit(left);
+    left->computeBounds(DISPLAY_BOUNDS, ui::Transform());
+    right->computeBounds(DISPLAY_BOUNDS, ui::Transform());
+    EXPECT_EQ(Rect(0, 0, 10, 10), child->getScreenBounds(false /*reduceTransparentRegion*/));
+
+    left->removeChild(child);
+    right->addChild(child);
+    commit(left);
+    commit(right);
+    left->computeBounds(DISPLAY_BOUNDS, ui::Transform());
+    right->computeBounds(DISPLAY_BOUNDS, ui::Transform());
+    EXPECT_EQ(Rect(200, 0, 210, 10), child->getScreenBounds(false /*reduceTransparentRegion*/));
+}
+
+} // namespace
+} // namespace android
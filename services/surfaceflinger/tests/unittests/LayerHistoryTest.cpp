@@ -135,6 +135,73 @@ TEST_F(LayerHistoryTest, multipleLayers) {
     EXPECT_FLOAT_EQ(30.f, mLayerHistory->getDesiredRefreshRateAndHDR().first);
 }
 
+TEST_F(LayerHistoryTest, pulldownCadence) {
+    std::unique_ptr<LayerHistory::LayerHandle> test24FpsLayer =
+            mLayerHistory->createLayer("24FpsLayer", MIN_REFRESH_RATE, MAX_REFRESH_RATE);
+    mLayerHistory->setVisibility(test24FpsLayer, true);
+
+    // 24fps content on a 60Hz display alternates between 2 and 3 vsyncs
+    nsecs_t presentTime = systemTime();
+    for (int i = 0; i < RELEVANT_FRAME_THRESHOLD; i++) {
+        presentTime += (i % 2) ? 50'000'000 : THIRTY_FPS_INTERVAL;
+        mLayerHistory->insert(test24FpsLayer, presentTime, false /*isHDR*/);
+        mLayerHistory->getDesiredRefreshRateAndHDR();
+    }
+
+    EXPECT_NEAR(24.f, mLayerHistory->getDesiredRefreshRateAndHDR().first, 0.5f);
+}
+
+TEST_F(LayerHistoryTest, refreshRateChangesOnlyAfterHysteresis) {
+    std::unique_ptr<LayerHistory::LayerHandle> testLayer =
+            mLayerHistory->createLayer("TestLayer", MIN_REFRESH_RATE, MAX_REFRESH_RATE);
+    mLayerHistory->setVisibility(testLayer, true);
+
+    nsecs_t presentTime = systemTime();
+    for (int i = 0; i < RELEVANT_FRAME_THRESHOLD; i++) {
+        presentTime += THIRTY_FPS_INTERVAL;
+        mLayerHistory->insert(testLayer, presentTime, false /*isHDR*/);
+    }
+    EXPECT_FLOAT_EQ(30.f, mLayerHistory->getDesiredRefreshRateAndHDR().first);
+
+    // A little jitter doesn't change anything
+    for (int i = 0; i < 30; i++) {
+        presentTime += 32'000'000;
+        mLayerHistory->insert(testLayer, presentTime, false /*isHDR*/);
+        EXPECT_FLOAT_EQ(30.f, mLayerHistory->getDesiredRefreshRateAndHDR().first);
+    }
+
+    // A real change takes a few calls to show
+    static constexpr uint64_t SIXTY_FPS_INTERVAL = 16'666'667;
+    for (int i = 0; i < 30; i++) {
+        presentTime += SIXTY_FPS_INTERVAL;
+        mLayerHistory->insert(testLayer, presentTime, false /*isHDR*/);
+    }
+    EXPECT_FLOAT_EQ(30.f, mLayerHistory->getDesiredRefreshRateAndHDR().first);
+    EXPECT_FLOAT_EQ(30.f, mLayerHistory->getDesiredRefreshRateAndHDR().first);
+    EXPECT_NEAR(60.f, mLayerHistory->getDesiredRefreshRateAndHDR().first, 0.1f);
+}
+
+TEST_F(LayerHistoryTest, smallLayersOnlyVoteWhenAlone) {
+    std::unique_ptr<LayerHistory::LayerHandle> test30FpsLayer =
+            mLayerHistory->createLayer("30FpsLayer", MIN_REFRESH_RATE, MAX_REFRESH_RATE);
+    mLayerHistory->setVisibility(test30FpsLayer, true);
+    mLayerHistory->setVisibleArea(test30FpsLayer, 1000 * 1000);
+    std::unique_ptr<LayerHistory::LayerHandle> testSmallLayer =
+            mLayerHistory->createLayer("SmallLayer", MIN_REFRESH_RATE, MAX_REFRESH_RATE);
+    mLayerHistory->setVisibility(testSmallLayer, true);
+    mLayerHistory->setVisibleArea(testSmallLayer, 10 * 10);
+
+    forceRelevancy(testSmallLayer);
+    EXPECT_FLOAT_EQ(MAX_REFRESH_RATE, mLayerHistory->getDesiredRefreshRateAndHDR().first);
+
+    nsecs_t startTime = systemTime();
+    for (int i = 0; i < RELEVANT_FRAME_THRESHOLD; i++) {
+        mLayerHistory->insert(test30FpsLayer, startTime + (i * THIRTY_FPS_INTERVAL),
+                              false /*isHDR*/);
+    }
+    EXPECT_FLOAT_EQ(30.f, mLayerHistory->getDesiredRefreshRateAndHDR().first);
+}
+
 } // namespace
 } // namespace scheduler
 } // namespace android
\ No newline at end of file
@@ -136,4 +136,22 @@ TEST_F(RegionSamplingTest, orientation_90) {
                 testing::Eq(1.0));
 }
 
+TEST_F(RegionSamplingTest, downscale_keeps_pixel_count_under_limit) {
+    EXPECT_EQ(1, samplingDownscale(whole_area, kWidth * kHeight));
+    EXPECT_EQ(2, samplingDownscale(whole_area, kWidth * kHeight / 2));
+
+    const Rect navBar{0, 0, 1080, 132};
+    const int32_t downscale = samplingDownscale(navBar, 128 * 128);
+    EXPECT_EQ(3, downscale);
+    const Rect scaled = downscaleArea(navBar, downscale);
+    EXPECT_LE(scaled.getWidth() * scaled.getHeight(), 128 * 128);
+}
+
+TEST_F(RegionSamplingTest, downscaled_area_rounds_outwards) {
+    EXPECT_EQ(Rect(1, 0, 3, 2), downscaleArea(Rect(5, 1, 11, 7), 4));
+    // Areas smaller than the downscale keep a pixel
+    EXPECT_EQ(Rect(2, 2, 3, 3), downscaleArea(Rect(9, 9, 10, 10), 4));
+    EXPECT_EQ(Rect(5, 1, 11, 7), downscaleArea(Rect(5, 1, 11, 7), 1));
+}
+
 } // namespace android
@@ -0,0 +1,187 @@
+/*
+ * Copyright 2019 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#undef LOG_TAG
+#define LOG_TAG "LibSurfaceFlingerUnittests"
+
+#include <gtest/gtest.h>
+
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "SurfaceTracing.h"
+
+namespace android {
+namespace {
+
+using LayersTraceBuffer = SurfaceTracing::LayersTraceBuffer;
+using TraceEntry = SurfaceTracing::TraceEntry;
+
+constexpr size_t kLargeBufferSize = 1_MB;
+
+class SurfaceTracingTest : public testing::Test {
+protected:
+    // Layers are given as pairs of id and name
+    static TraceEntry makeEntry(const char* where,
+                                const std::vector<std::pair<int32_t, std::string>>& layers) {
+        TraceEntry entry;
+        entry.header.set_where(where);
+        for (const auto& [id, name] : layers) {
+            LayerProto layer;
+            layer.set_id(id);
+            layer.set_name(name);
+            entry.layers.emplace_back(id, layer.SerializeAsString());
+        }
+        return entry;
+    }
+
+    static size_t sizeOf(TraceEntry&& entry) {
+        LayersTraceBuffer buffer;
+        buffer.reset(kLargeBufferSize);
+        buffer.emplace(std::move(entry));
+        return buffer.used();
+    }
+
+    static LayersTraceFileProto flush(LayersTraceBuffer& buffer) {
+        std::string output;
+        buffer.flush(&output);
+        LayersTraceFileProto fileProto;
+        EXPECT_TRUE(fileProto.ParseFromString(output));
+        return fileProto;
+    }
+
+    static std::vector<std::pair<int32_t, std::string>> layersOf(const LayersTraceProto& entry) {
+        std::vector<std::pair<int32_t, std::string>> layers;
+        for (const auto& layer : entry.layers().layers()) {
+            layers.emplace_back(layer.id(), layer.name());
+        }
+        return layers;
+    }
+
+    LayersTraceBuffer mBuffer;
+};
+
+TEST_F(SurfaceTracingTest, storesOnlyChangedLayers) {
+    mBuffer.reset(kLargeBufferSize);
+    mBuffer.emplace(makeEntry("first", {{1, "a"}, {2, "b"}}));
+    mBuffer.emplace(makeEntry("same", {{1, "a"}, {2, "b"}}));
+    mBuffer.emplace(makeEntry("changed", {{1, "a"}, {2, "c"}}));
+
+    EXPECT_EQ(3u, mBuffer.frameCount());
+    EXPECT_EQ(6u, mBuffer.layerCount());
+    EXPECT_EQ(3u, mBuffer.changedLayerCount());
+
+    const LayersTraceFileProto fileProto = flush(mBuffer);
+    ASSERT_EQ(3, fileProto.entry_size());
+    EXPECT_EQ("first", fileProto.entry(0).where());
+    EXPECT_EQ((std::vector<std::pair<int32_t, std::string>>{{1, "a"}, {2, "b"}}),
+              layersOf(fileProto.entry(0)));
+    EXPECT_EQ("same", fileProto.entry(1).where());
+    EXPECT_EQ((std::vector<std::pair<int32_t, std::string>>{{1, "a"}, {2, "b"}}),
+              layersOf(fileProto.entry(1)));
+    EXPECT_EQ("changed", fileProto.entry(2).where());
+    EXPECT_EQ((std::vector<std::pair<int32_t, std::string>>{{1, "a"}, {2, "c"}}),
+              layersOf(fileProto.entry(2)));
+    EXPECT_EQ(0u, mBuffer.frameCount());
+}
+
+TEST_F(SurfaceTracingTest, keepsTheLayerOrder) {
+    mBuffer.reset(kLargeBufferSize);
+    mBuffer.emplace(makeEntry("first", {{1, "a"}, {2, "b"}}));
+    mBuffer.emplace(makeEntry("reordered", {{2, "b"}, {1, "a"}, {3, "new"}}));
+
+    const LayersTraceFileProto fileProto = flush(mBuffer);
+    ASSERT_EQ(2, fileProto.entry_size());
+    EXPECT_EQ((std::vector<std::pair<int32_t, std::string>>{{2, "b"}, {1, "a"}, {3, "new"}}),
+              layersOf(fileProto.entry(1)));
+}
+
+TEST_F(SurfaceTracingTest, staysWithinItsSize) {
+    const std::string name(100, 'x');
+    const size_t entrySize = sizeOf(makeEntry("frame", {{1, name + "0"}}));
+    mBuffer.reset(3 * entrySize);
+
+    for (int i = 0; i < 10; i++) {
+        mBuffer.emplace(makeEntry("frame", {{1, name + std::to_string(i)}}));
+        EXPECT_LE(mBuffer.used(), mBuffer.size());
+    }
+    EXPECT_EQ(3u, mBuffer.frameCount());
+
+    const LayersTraceFileProto fileProto = flush(mBuffer);
+    ASSERT_EQ(3, fileProto.entry_size());
+    for (int i = 0; i < 3; i++) {
+        EXPECT_EQ((std::vector<std::pair<int32_t, std::string>>{{1, name + std::to_string(7 + i)}}),
+                  layersOf(fileProto.entry(i)));
+    }
+}
+
+TEST_F(SurfaceTracingTest, evictionKeepsTheOldestEntryComplete) {
+    const std::string name(100, 'x');
+    const size_t entrySize = sizeOf(makeEntry("frame", {{1, name}, {2, "b0"}}));
+    // Room for a complete entry and a couple of entries with one changed layer
+    mBuffer.reset(entrySize + entrySize / 2);
+
+    for (int i = 0; i < 10; i++) {
+        mBuffer.emplace(makeEntry("frame", {{1, name}, {2, "b" + std::to_string(i)}}));
+        EXPECT_LE(mBuffer.used(), mBuffer.size());
+    }
+    ASSERT_GT(mBuffer.frameCount(), 1u);
+    ASSERT_LT(mBuffer.frameCount(), 10u);
+
+    // The unchanged layer was only stored with the first entry, which has been evicted
+    const int count = static_cast<int>(mBuffer.frameCount());
+    const LayersTraceFileProto fileProto = flush(mBuffer);
+    ASSERT_EQ(count, fileProto.entry_size());
+    for (int i = 0; i < count; i++) {
+        const std::string b = "b" + std::to_string(10 - count + i);
+        EXPECT_EQ((std::vector<std::pair<int32_t, std::string>>{{1, name}, {2, b}}),
+                  layersOf(fileProto.entry(i)));
+    }
+}
+
+TEST_F(SurfaceTracingTest, dropsEntriesLargerThanItsSize) {
+    const std::string name(100, 'x');
+    mBuffer.reset(sizeOf(makeEntry("frame", {{1, name}})) - 1);
+
+    mBuffer.emplace(makeEntry("frame", {{1, name}}));
+    EXPECT_EQ(0u, mBuffer.frameCount());
+    EXPECT_EQ(0u, mBuffer.used());
+
+    // A smaller entry still gets all of its layers, with nothing to decode it against
+    mBuffer.emplace(makeEntry("frame", {{1, "a"}}));
+    const LayersTraceFileProto fileProto = flush(mBuffer);
+    ASSERT_EQ(1, fileProto.entry_size());
+    EXPECT_EQ((std::vector<std::pair<int32_t, std::string>>{{1, "a"}}),
+              layersOf(fileProto.entry(0)));
+}
+
+TEST_F(SurfaceTracingTest, resetEmptiesTheBuffer) {
+    mBuffer.reset(kLargeBufferSize);
+    mBuffer.emplace(makeEntry("frame", {{1, "a"}}));
+    mBuffer.reset(kLargeBufferSize);
+
+    EXPECT_EQ(0u, mBuffer.frameCount());
+    EXPECT_EQ(0u, mBuffer.used());
+    EXPECT_EQ(0u, mBuffer.layerCount());
+
+    // The next entry is complete again
+    mBuffer.emplace(makeEntry("frame", {{1, "a"}}));
+    EXPECT_EQ(1u, mBuffer.changedLayerCount());
+}
+
+} // namespace
+} // namespace android
@@ -207,6 +207,7 @@ public:
 
     auto& mutableLayerCurrentState(sp<Layer> layer) { return layer->mCurrentState; }
     auto& mutableLayerDrawingState(sp<Layer> layer) { return layer->mDrawingState; }
+    void commitLayerTransaction(sp<Layer> layer) { layer->commitTransaction(layer->mCurrentState); }
 
     void setLayerSidebandStream(sp<Layer> layer, sp<NativeHandle> sidebandStream) {
         layer->mDrawingState.sidebandStream = sidebandStream;
@@ -296,6 +297,8 @@ public:
         return mFlinger->SurfaceFlinger::getDisplayNativePrimaries(displayToken, primaries);
     }
 
+    auto updateColorMatrixLocked() { return mFlinger->updateColorMatrixLocked(); }
+
     /* ------------------------------------------------------------------------
      * Read-only access to private data to assert post-conditions.
      */
@@ -318,12 +321,15 @@ public:
     auto& mutablePrimaryDisplayOrientation() { return SurfaceFlinger::primaryDisplayOrientation; }
     auto& mutableUseColorManagement() { return SurfaceFlinger::useColorManagement; }
 
+    auto& mutableClientColorMatrix() { return mFlinger->mClientColorMatrix; }
     auto& mutableCurrentState() { return mFlinger->mCurrentState; }
+    auto& mutableDaltonizer() { return mFlinger->mDaltonizer; }
     auto& mutableDisplayColorSetting() { return mFlinger->mDisplayColorSetting; }
     auto& mutableDisplays() { return mFlinger->mDisplays; }
     auto& mutableDrawingState() { return mFlinger->mDrawingState; }
     auto& mutableEventQueue() { return mFlinger->mEventQueue; }
     auto& mutableGeometryInvalid() { return mFlinger->mGeometryInvalid; }
+    auto& mutableGlobalSaturationFactor() { return mFlinger->mGlobalSaturationFactor; }
     auto& mutableInterceptor() { return mFlinger->mInterceptor; }
     auto& mutableMainThreadId() { return mFlinger->mMainThreadId; }
     auto& mutablePendingHotplugEvents() { return mFlinger->mPendingHotplugEvents; }
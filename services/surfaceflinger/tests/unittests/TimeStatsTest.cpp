@@ -38,6 +38,7 @@ namespace android {
 namespace {
 
 using testing::Contains;
+using testing::HasSubstr;
 using testing::SizeIs;
 using testing::UnorderedElementsAre;
 
@@ -222,6 +223,7 @@ TEST_F(TimeStatsTest, canIncreaseGlobalStats) {
     constexpr size_t TOTAL_FRAMES = 5;
     constexpr size_t MISSED_FRAMES = 4;
     constexpr size_t CLIENT_COMPOSITION_FRAMES = 3;
+    constexpr size_t PREDICTED_MISSED_FRAMES = 2;
 
     EXPECT_TRUE(inputCommand(InputCommand::ENABLE, FMT_STRING).empty());
 
@@ -234,6 +236,9 @@ TEST_F(TimeStatsTest, canIncreaseGlobalStats) {
     for (size_t i = 0; i < CLIENT_COMPOSITION_FRAMES; i++) {
         ASSERT_NO_FATAL_FAILURE(mTimeStats->incrementClientCompositionFrames());
     }
+    for (size_t i = 0; i < PREDICTED_MISSED_FRAMES; i++) {
+        ASSERT_NO_FATAL_FAILURE(mTimeStats->incrementPredictedMissedFrames());
+    }
 
     SFTimeStatsGlobalProto globalProto;
     ASSERT_TRUE(globalProto.ParseFromString(inputCommand(InputCommand::DUMP_ALL, FMT_PROTO)));
@@ -244,6 +249,8 @@ TEST_F(TimeStatsTest, canIncreaseGlobalStats) {
     EXPECT_EQ(MISSED_FRAMES, globalProto.missed_frames());
     ASSERT_TRUE(globalProto.has_client_composition_frames());
     EXPECT_EQ(CLIENT_COMPOSITION_FRAMES, globalProto.client_composition_frames());
+    ASSERT_TRUE(globalProto.has_predicted_missed_frames());
+    EXPECT_EQ(PREDICTED_MISSED_FRAMES, globalProto.predicted_missed_frames());
 }
 
 TEST_F(TimeStatsTest, canInsertGlobalPresentToPresent) {
@@ -489,12 +496,64 @@ TEST_F(TimeStatsTest, layerTimeStatsOnDestroy) {
     EXPECT_EQ(1, layerProto.total_frames());
 }
 
+TEST_F(TimeStatsTest, dumpAddsUpFramesAcrossDumpsAndDestroyedLayers) {
+    EXPECT_TRUE(inputCommand(InputCommand::ENABLE, FMT_STRING).empty());
+
+    insertTimeRecord(NORMAL_SEQUENCE, LAYER_ID_0, 1, 1000000);
+    insertTimeRecord(NORMAL_SEQUENCE, LAYER_ID_0, 2, 2000000);
+    EXPECT_FALSE(inputCommand(InputCommand::DUMP_ALL, FMT_PROTO).empty());
+
+    insertTimeRecord(NORMAL_SEQUENCE, LAYER_ID_0, 3, 3000000);
+    ASSERT_NO_FATAL_FAILURE(mTimeStats->onDestroy(LAYER_ID_0));
+
+    SFTimeStatsGlobalProto globalProto;
+    ASSERT_TRUE(globalProto.ParseFromString(inputCommand(InputCommand::DUMP_ALL, FMT_PROTO)));
+
+    ASSERT_EQ(1, globalProto.stats_size());
+    const SFTimeStatsLayerProto& layerProto = globalProto.stats().Get(0);
+    ASSERT_TRUE(layerProto.has_total_frames());
+    EXPECT_EQ(2, layerProto.total_frames());
+    for (const SFTimeStatsDeltaProto& deltaProto : layerProto.deltas()) {
+        int32_t frameCount = 0;
+        for (const SFTimeStatsHistogramBucketProto& histogramProto : deltaProto.histograms()) {
+            frameCount += histogramProto.frame_count();
+        }
+        EXPECT_EQ(2, frameCount) << deltaProto.delta_name();
+    }
+}
+
+TEST_F(TimeStatsTest, canRecordFrameStagesPerDisplayAndRefreshRate) {
+    EXPECT_TRUE(inputCommand(InputCommand::ENABLE, FMT_STRING).empty());
+
+    TimeStats::FrameStages stages;
+    stages.transactionApply = 100000;
+    stages.latch = 200000;
+    stages.compositionStrategy = 300000;
+    stages.renderEngine = 4000000;
+    stages.hwcPresent = 500000;
+    ASSERT_NO_FATAL_FAILURE(mTimeStats->recordFrameStages(1, 60, stages, 10000000,
+                                                          std::make_shared<FenceTime>(16000000)));
+    ASSERT_NO_FATAL_FAILURE(mTimeStats->recordFrameStages(1, 90, stages, 10000000,
+                                                          std::make_shared<FenceTime>(16000000)));
+    ASSERT_NO_FATAL_FAILURE(mTimeStats->recordFrameStages(1, 90, stages, 10000000, nullptr));
+
+    const std::string result(inputCommand(InputCommand::DUMP_ALL, FMT_STRING));
+    EXPECT_THAT(result, HasSubstr("displayId = 1 fps = 60 totalFrames = 1\n"));
+    EXPECT_THAT(result, HasSubstr("displayId = 1 fps = 90 totalFrames = 2\n"));
+    // Each duration falls in a bucket ending at most an eighth above it
+    EXPECT_THAT(result,
+                HasSubstr("renderEngine                2     4096     4096     4096     4096\n"));
+    EXPECT_THAT(result,
+                HasSubstr("fenceSignal                 1     6144     6144     6144     6144\n"));
+}
+
 TEST_F(TimeStatsTest, canClearTimeStats) {
     EXPECT_TRUE(inputCommand(InputCommand::ENABLE, FMT_STRING).empty());
 
     ASSERT_NO_FATAL_FAILURE(mTimeStats->incrementTotalFrames());
     ASSERT_NO_FATAL_FAILURE(mTimeStats->incrementMissedFrames());
     ASSERT_NO_FATAL_FAILURE(mTimeStats->incrementClientCompositionFrames());
+    ASSERT_NO_FATAL_FAILURE(mTimeStats->incrementPredictedMissedFrames());
     ASSERT_NO_FATAL_FAILURE(mTimeStats->setPowerMode(HWC_POWER_MODE_NORMAL));
     ASSERT_NO_FATAL_FAILURE(
             mTimeStats->setPresentFenceGlobal(std::make_shared<FenceTime>(1000000)));
@@ -511,6 +570,7 @@ TEST_F(TimeStatsTest, canClearTimeStats) {
     EXPECT_EQ(0, globalProto.total_frames());
     EXPECT_EQ(0, globalProto.missed_frames());
     EXPECT_EQ(0, globalProto.client_composition_frames());
+    EXPECT_EQ(0, globalProto.predicted_missed_frames());
     EXPECT_EQ(0, globalProto.present_to_present_size());
     EXPECT_EQ(0, globalProto.stats_size());
 }
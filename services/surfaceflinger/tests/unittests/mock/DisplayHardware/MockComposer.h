@@ -54,6 +54,7 @@ public:
     MOCK_METHOD0(isRemote, bool());
     MOCK_METHOD0(resetCommands, void());
     MOCK_METHOD0(executeCommands, Error());
+    MOCK_CONST_METHOD0(getCommandStats, CommandStats());
     MOCK_METHOD0(getMaxVirtualDisplayCount, uint32_t());
     MOCK_CONST_METHOD0(isUsingVrComposer, bool());
     MOCK_METHOD4(createVirtualDisplay, Error(uint32_t, uint32_t, PixelFormat*, Display*));
@@ -80,6 +81,9 @@ public:
     MOCK_METHOD3(getDisplayIdentificationData, Error(Display, uint8_t*, std::vector<uint8_t>*));
     MOCK_METHOD3(getReleaseFences, Error(Display, std::vector<Layer>*, std::vector<int>*));
     MOCK_METHOD2(presentDisplay, Error(Display, int*));
+    MOCK_METHOD1(queuePresentDisplay, void(Display));
+    MOCK_METHOD4(takeQueuedPresent,
+                 Error(Display, int*, std::vector<Layer>*, std::vector<int>*));
     MOCK_METHOD2(setActiveConfig, Error(Display, Config));
     MOCK_METHOD6(setClientTarget,
                  Error(Display, uint32_t, const sp<GraphicBuffer>&, int, Dataspace,
@@ -65,6 +65,10 @@ public:
     MOCK_CONST_METHOD1(getReleaseFences,
                        Error(std::unordered_map<Layer*, android::sp<android::Fence>>* outFences));
     MOCK_METHOD1(present, Error(android::sp<android::Fence>*));
+    MOCK_METHOD0(queuePresent, void());
+    MOCK_METHOD2(takeQueuedPresent,
+                 Error(android::sp<android::Fence>*,
+                       std::unordered_map<Layer*, android::sp<android::Fence>>*));
     MOCK_METHOD1(setActiveConfig, Error(const std::shared_ptr<const HWC2::Display::Config>&));
     MOCK_METHOD4(setClientTarget,
                  Error(uint32_t, const android::sp<android::GraphicBuffer>&,
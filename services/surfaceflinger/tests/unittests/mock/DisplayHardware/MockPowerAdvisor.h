@@ -30,6 +30,7 @@ public:
     ~PowerAdvisor() override;
 
     MOCK_METHOD2(setExpensiveRenderingExpected, void(DisplayId displayId, bool expected));
+    MOCK_METHOD1(setScreenIdle, void(bool idle));
 };
 
 } // namespace mock
@@ -40,6 +40,7 @@ public:
     MOCK_CONST_METHOD1(computeNextRefresh, nsecs_t(int));
     MOCK_METHOD1(setIgnorePresentFences, void(bool));
     MOCK_METHOD0(expectedPresentTime, nsecs_t());
+    MOCK_CONST_METHOD1(isModelConfident, bool(nsecs_t));
 
     MOCK_CONST_METHOD1(dump, void(std::string&));
 
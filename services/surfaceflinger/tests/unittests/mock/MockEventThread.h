@@ -36,10 +36,15 @@ public:
     MOCK_METHOD2(onConfigChanged, void(PhysicalDisplayId, int32_t));
     MOCK_CONST_METHOD1(dump, void(std::string&));
     MOCK_METHOD1(setPhaseOffset, void(nsecs_t phaseOffset));
+    MOCK_METHOD1(setWorkBudget, void(nsecs_t workBudget));
+    MOCK_METHOD1(setParked, void(bool parked));
     MOCK_METHOD1(registerDisplayEventConnection,
                  status_t(const sp<android::EventThreadConnection> &));
     MOCK_METHOD2(setVsyncRate, void(uint32_t, const sp<android::EventThreadConnection> &));
     MOCK_METHOD1(requestNextVsync, void(const sp<android::EventThreadConnection> &));
+    MOCK_METHOD2(setWorkDuration, void(nsecs_t, const sp<android::EventThreadConnection> &));
+    MOCK_METHOD3(getVsyncTimeline,
+                 status_t(gui::VsyncTimeline *, bool, const sp<android::EventThreadConnection> &));
     MOCK_METHOD1(pauseVsyncCallback, void(bool));
 };
 
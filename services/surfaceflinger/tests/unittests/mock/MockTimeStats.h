@@ -33,6 +33,7 @@ public:
     MOCK_METHOD0(miniDump, std::string());
     MOCK_METHOD0(incrementTotalFrames, void());
     MOCK_METHOD0(incrementMissedFrames, void());
+    MOCK_METHOD0(incrementPredictedMissedFrames, void());
     MOCK_METHOD0(incrementClientCompositionFrames, void());
     MOCK_METHOD4(setPostTime, void(int32_t, uint64_t, const std::string&, nsecs_t));
     MOCK_METHOD3(setLatchTime, void(int32_t, uint64_t, nsecs_t));
@@ -46,6 +47,9 @@ public:
     MOCK_METHOD1(setPowerMode, void(int32_t));
     MOCK_METHOD2(recordRefreshRate, void(uint32_t, nsecs_t));
     MOCK_METHOD1(setPresentFenceGlobal, void(const std::shared_ptr<FenceTime>&));
+    MOCK_METHOD5(recordFrameStages,
+                 void(uint64_t, uint32_t, const FrameStages&, nsecs_t,
+                      const std::shared_ptr<FenceTime>&));
 };
 
 } // namespace mock
@@ -313,6 +313,10 @@ void BufferHubChannel::SignalAvailable() {
   ALOGD_IF(TRACE,
            "BufferHubChannel::SignalAvailable: channel_id=%d buffer_id=%d",
            channel_id(), buffer_id());
+  // Avoid a round trip through the endpoint when nothing changes, which the
+  // producer's fan-out to many consumers would otherwise pay on every cycle.
+  if (signaled_)
+    return;
   signaled_ = true;
   const auto status = service_->ModifyChannelEvents(channel_id_, 0, POLLIN);
   ALOGE_IF(!status,
@@ -326,6 +330,8 @@ void BufferHubChannel::ClearAvailable() {
   ALOGD_IF(TRACE,
            "BufferHubChannel::ClearAvailable: channel_id=%d buffer_id=%d",
            channel_id(), buffer_id());
+  if (!signaled_)
+    return;
   signaled_ = false;
   const auto status = service_->ModifyChannelEvents(channel_id_, POLLIN, 0);
   ALOGE_IF(!status,
@@ -33,6 +33,7 @@ class BufferHubChannel : public pdx::Channel {
       : service_(service),
         buffer_id_(buffer_id),
         channel_id_(channel_id),
+        signaled_(false),
         channel_type_(channel_type) {}
   virtual ~BufferHubChannel() {}
 
@@ -89,10 +90,11 @@ class BufferHubChannel : public pdx::Channel {
   // Returns the buffer info for this buffer.
   virtual BufferInfo GetBufferInfo() const = 0;
 
-  // Signal the client fd that an ownership change occurred using POLLIN.
+  // Signal the client fd that an ownership change occurred using POLLIN. Does
+  // nothing if the event is already signaled.
   void SignalAvailable();
 
-  // Clear the ownership change event.
+  // Clear the ownership change event. Does nothing if it is not signaled.
   void ClearAvailable();
 
   // Signal hangup event.
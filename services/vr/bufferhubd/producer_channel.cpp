@@ -427,9 +427,15 @@ Status<void> ProducerChannel::OnProducerPost(Message&,
 
   // Signal any interested consumers. If there are none, the buffer will stay
   // in posted state until a consumer comes online. This behavior guarantees
-  // that no frame is silently dropped.
+  // that no frame is silently dropped. The producer client posted to the
+  // consumers in the shared buffer state, so consumers it left out have
+  // nothing to acquire and are not woken up.
+  const uint32_t buffer_state = buffer_state_->load(std::memory_order_acquire);
   for (auto& consumer : consumer_channels_) {
-    consumer->OnProducerPosted();
+    if (!BufferHubDefs::isClientReleased(buffer_state,
+                                         consumer->client_state_mask())) {
+      consumer->OnProducerPosted();
+    }
   }
 
   return {};
@@ -3,6 +3,7 @@
 #include <log/log.h>
 
 #include <algorithm>
+#include <cstdlib>
 #include <iomanip>
 #include <iostream>
 #include <sstream>
@@ -268,6 +269,22 @@ std::vector<pid_t> CpuSet::GetTasks() const {
   return tasks;
 }
 
+Status<void> CpuSet::SetCpuList(const std::string& cpu_list) const {
+  base::unique_fd file(OpenFile(prefix_enabled_ ? "cpuset.cpus" : "cpus",
+                                O_WRONLY));
+  if (file.get() < 0) {
+    const int error = errno;
+    ALOGE("CpuSet::SetCpuList: Failed to open %s/cpus: %s", path_.c_str(),
+          strerror(error));
+    return ErrorStatus(error);
+  }
+
+  if (!base::WriteStringToFd(cpu_list, file.get()))
+    return ErrorStatus(errno);
+  else
+    return {};
+}
+
 std::string CpuSet::GetCpuList() const {
   if (auto file = OpenPropertyFilePointer("cpus")) {
     stdio_filebuf<char> filebuf(file.get());
@@ -286,5 +303,51 @@ void CpuSet::AddChild(std::unique_ptr<CpuSet> child) {
   children_.push_back(std::move(child));
 }
 
+std::vector<int> ParseCpuList(const std::string& cpu_list) {
+  std::vector<int> cpus;
+  std::istringstream stream(cpu_list);
+
+  for (std::string range; std::getline(stream, range, ',');) {
+    char* end;
+    const long first = std::strtol(range.c_str(), &end, 10);
+    if (end == range.c_str() || first < 0)
+      continue;
+
+    long last = first;
+    if (*end == '-') {
+      const char* last_start = end + 1;
+      last = std::strtol(last_start, &end, 10);
+      if (end == last_start || last < first)
+        continue;
+    }
+
+    for (long cpu = first; cpu <= last; cpu++)
+      cpus.push_back(static_cast<int>(cpu));
+  }
+
+  std::sort(cpus.begin(), cpus.end());
+  cpus.erase(std::unique(cpus.begin(), cpus.end()), cpus.end());
+  return cpus;
+}
+
+std::string FormatCpuList(const std::vector<int>& cpus) {
+  std::ostringstream stream;
+
+  for (size_t i = 0; i < cpus.size();) {
+    size_t j = i;
+    while (j + 1 < cpus.size() && cpus[j + 1] == cpus[j] + 1)
+      j++;
+
+    if (i != 0)
+      stream << ",";
+    stream << cpus[i];
+    if (j != i)
+      stream << "-" << cpus[j];
+    i = j + 1;
+  }
+
+  return stream.str();
+}
+
 }  // namespace dvr
 }  // namespace android
@@ -30,6 +30,7 @@ class CpuSet {
   bool IsRoot() const { return parent_ == nullptr; }
 
   std::string GetCpuList() const;
+  pdx::Status<void> SetCpuList(const std::string& cpu_list) const;
 
   pdx::Status<void> AttachTask(pid_t task_id) const;
   std::vector<pid_t> GetTasks() const;
@@ -61,6 +62,11 @@ class CpuSet {
   void operator=(const CpuSet&) = delete;
 };
 
+// Converts between the kernel's cpu list format, such as "0-2,4", and a sorted
+// list of cpu numbers. Malformed ranges are skipped.
+std::vector<int> ParseCpuList(const std::string& cpu_list);
+std::string FormatCpuList(const std::vector<int>& cpus);
+
 class CpuSetManager {
  public:
   CpuSetManager() {}
@@ -0,0 +1,282 @@
+#include "partition_tuner.h"
+
+#include <inttypes.h>
+#include <log/log.h>
+#include <sys/prctl.h>
+
+#include <algorithm>
+#include <iomanip>
+
+namespace android {
+namespace dvr {
+
+PartitionTuner::PartitionTuner(CpuSetManager* cpusets,
+                               std::vector<std::string> partitions,
+                               const Config& config)
+    : cpusets_(cpusets), config_(config) {
+  for (auto& path : partitions) {
+    Partition partition;
+    partition.path = std::move(path);
+    if (cpusets_) {
+      partition.cpuset = cpusets_->Lookup(partition.path);
+      if (!partition.cpuset) {
+        ALOGE("PartitionTuner::PartitionTuner: Failed to lookup cpuset=%s",
+              partition.path.c_str());
+        continue;
+      }
+    }
+    partitions_.push_back(std::move(partition));
+  }
+}
+
+PartitionTuner::~PartitionTuner() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stop_ = true;
+  }
+  condition_.notify_one();
+  if (thread_.joinable())
+    thread_.join();
+}
+
+bool PartitionTuner::Start() {
+  if (partitions_.size() < 2) {
+    ALOGW("PartitionTuner::Start: Need at least two partitions, got %zu.",
+          partitions_.size());
+    return false;
+  }
+  if (config_.period.count() <= 0) {
+    ALOGE("PartitionTuner::Start: Invalid period of %lldms.",
+          static_cast<long long>(config_.period.count()));
+    return false;
+  }
+  thread_ = std::thread(&PartitionTuner::ThreadMain, this);
+  return true;
+}
+
+void PartitionTuner::ThreadMain() {
+  prctl(PR_SET_NAME, reinterpret_cast<unsigned long>("PartitionTuner"), 0, 0,
+        0);
+
+  auto last_sample = std::chrono::steady_clock::now();
+  Sample(std::chrono::nanoseconds::zero());
+
+  std::unique_lock<std::mutex> lock(mutex_);
+  while (!condition_.wait_for(lock, config_.period, [this] { return stop_; })) {
+    lock.unlock();
+    const auto now = std::chrono::steady_clock::now();
+    Sample(now - last_sample);
+    last_sample = now;
+    lock.lock();
+  }
+}
+
+void PartitionTuner::Sample(std::chrono::nanoseconds elapsed) {
+  // Reading the statistics of every task takes a while, so it is done without
+  // the lock, which dumpsys would otherwise wait on.
+  std::vector<Load> loads;
+  for (auto& partition : partitions_)
+    loads.push_back(SamplePartition(partition, elapsed));
+
+  // The first sample only records the baseline statistics of each task.
+  if (elapsed == std::chrono::nanoseconds::zero())
+    return;
+
+  if (auto move = Evaluate(loads))
+    ApplyMove(*move);
+}
+
+PartitionTuner::Load PartitionTuner::SamplePartition(
+    Partition& partition, std::chrono::nanoseconds elapsed) {
+  Load load;
+  load.cpu_count = ParseCpuList(partition.cpuset->GetCpuList()).size();
+
+  uint64_t run_time_ns = 0;
+  uint64_t wait_time_ns = 0;
+  uint64_t timeslice_count = 0;
+
+  // Tasks which are new to the partition only start counting from the next
+  // sample; tasks which left it are dropped.
+  std::unordered_map<pid_t, Task::SchedStats> task_stats;
+  for (pid_t task_id : partition.cpuset->GetTasks()) {
+    Task::SchedStats stats;
+    if (!Task::ReadSchedStats(task_id, &stats))
+      continue;
+
+    auto search = partition.task_stats.find(task_id);
+    if (search != partition.task_stats.end()) {
+      const Task::SchedStats& previous = search->second;
+      if (stats.run_time_ns >= previous.run_time_ns &&
+          stats.wait_time_ns >= previous.wait_time_ns &&
+          stats.timeslice_count >= previous.timeslice_count) {
+        run_time_ns += stats.run_time_ns - previous.run_time_ns;
+        wait_time_ns += stats.wait_time_ns - previous.wait_time_ns;
+        timeslice_count += stats.timeslice_count - previous.timeslice_count;
+      }
+    }
+    task_stats.emplace(task_id, stats);
+  }
+  partition.task_stats = std::move(task_stats);
+
+  if (load.cpu_count > 0 && elapsed.count() > 0) {
+    load.utilization = static_cast<double>(run_time_ns) /
+                       (static_cast<double>(elapsed.count()) * load.cpu_count);
+  }
+  if (timeslice_count > 0)
+    load.mean_wait_ns = static_cast<int64_t>(wait_time_ns / timeslice_count);
+
+  ALOGD_IF(TRACE,
+           "PartitionTuner::SamplePartition: cpuset=%s cpus=%zu "
+           "utilization=%.2f mean_wait_ns=%" PRId64,
+           partition.path.c_str(), load.cpu_count, load.utilization,
+           load.mean_wait_ns);
+  return load;
+}
+
+std::optional<PartitionTuner::Move> PartitionTuner::Evaluate(
+    const std::vector<Load>& loads) {
+  if (loads.size() != partitions_.size())
+    return {};
+
+  std::lock_guard<std::mutex> lock(mutex_);
+  for (size_t i = 0; i < loads.size(); i++) {
+    const Load& load = loads[i];
+    Partition& partition = partitions_[i];
+
+    const bool busy = load.utilization > config_.high_utilization ||
+                      load.mean_wait_ns > config_.high_wait.count();
+    const bool idle = !busy && load.utilization < config_.low_utilization;
+
+    partition.busy_periods = busy ? partition.busy_periods + 1 : 0;
+    partition.idle_periods = idle ? partition.idle_periods + 1 : 0;
+    partition.last_load = load;
+  }
+
+  // The busiest partition that has been overloaded long enough takes a cpu
+  // from the least busy partition that has been idle long enough.
+  std::optional<size_t> to;
+  std::optional<size_t> from;
+  for (size_t i = 0; i < partitions_.size(); i++) {
+    const Partition& partition = partitions_[i];
+    const double utilization = partition.last_load.utilization;
+
+    if (partition.busy_periods >= config_.hysteresis_periods &&
+        (!to || utilization > partitions_[*to].last_load.utilization)) {
+      to = i;
+    }
+    if (partition.idle_periods >= config_.hysteresis_periods &&
+        partition.last_load.cpu_count > config_.min_cpus &&
+        (!from || utilization < partitions_[*from].last_load.utilization)) {
+      from = i;
+    }
+  }
+  if (!to || !from)
+    return {};
+
+  // Both partitions have to earn the next move from scratch.
+  partitions_[*to].busy_periods = 0;
+  partitions_[*from].idle_periods = 0;
+  return Move{*from, *to};
+}
+
+void PartitionTuner::ApplyMove(const Move& move) {
+  const Partition& from = partitions_[move.from];
+  const Partition& to = partitions_[move.to];
+  Load from_load;
+  Load to_load;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    from_load = from.last_load;
+    to_load = to.last_load;
+  }
+
+  const std::string from_list = from.cpuset->GetCpuList();
+  std::vector<int> from_cpus = ParseCpuList(from_list);
+  std::vector<int> to_cpus = ParseCpuList(to.cpuset->GetCpuList());
+  if (from_cpus.size() <= config_.min_cpus)
+    return;
+
+  // The partitions are siblings, so the cpu has to leave one before it can be
+  // given to the other when they are exclusive.
+  const int cpu = from_cpus.back();
+  from_cpus.pop_back();
+  to_cpus.push_back(cpu);
+  std::sort(to_cpus.begin(), to_cpus.end());
+
+  std::ostringstream decision;
+  decision << "cpu " << cpu << " from " << from.path << " (utilization "
+           << static_cast<int>(from_load.utilization * 100) << "%) to "
+           << to.path << " (utilization "
+           << static_cast<int>(to_load.utilization * 100) << "%, wait "
+           << to_load.mean_wait_ns / 1000 << "us)";
+
+  auto status = from.cpuset->SetCpuList(FormatCpuList(from_cpus));
+  if (!status) {
+    decision << " failed: " << status.GetErrorMessage();
+    RecordDecision(decision.str());
+    return;
+  }
+
+  status = to.cpuset->SetCpuList(FormatCpuList(to_cpus));
+  if (!status) {
+    decision << " failed: " << status.GetErrorMessage();
+    auto restore_status = from.cpuset->SetCpuList(from_list);
+    ALOGE_IF(!restore_status,
+             "PartitionTuner::ApplyMove: Failed to restore cpuset=%s to "
+             "cpus=%s: %s",
+             from.path.c_str(), from_list.c_str(),
+             restore_status.GetErrorMessage().c_str());
+  }
+  RecordDecision(decision.str());
+}
+
+void PartitionTuner::RecordDecision(const std::string& decision) {
+  const auto uptime = std::chrono::duration_cast<std::chrono::seconds>(
+      std::chrono::steady_clock::now().time_since_epoch());
+  ALOGI("PartitionTuner: %s", decision.c_str());
+
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (decisions_.size() == kDecisionHistory)
+    decisions_.pop_front();
+  decisions_.push_back(std::to_string(uptime.count()) + "s: " + decision);
+}
+
+void PartitionTuner::DumpState(std::ostringstream& stream) const {
+  std::lock_guard<std::mutex> lock(mutex_);
+
+  size_t max_path = 4;
+  for (const auto& partition : partitions_)
+    max_path = std::max(max_path, partition.path.length());
+
+  stream << "Partition tuner:" << std::endl;
+  stream << std::left;
+  stream << std::setw(max_path) << "Path";
+  stream << " ";
+  stream << std::setw(6) << "CPUs";
+  stream << " ";
+  stream << std::setw(6) << "Util";
+  stream << " ";
+  stream << std::setw(8) << "Wait(us)";
+  stream << std::endl;
+
+  for (const auto& partition : partitions_) {
+    stream << std::left;
+    stream << std::setw(max_path) << partition.path;
+    stream << " ";
+    stream << std::right;
+    stream << std::setw(6) << partition.last_load.cpu_count;
+    stream << " ";
+    stream << std::setw(5)
+           << static_cast<int>(partition.last_load.utilization * 100) << "%";
+    stream << " ";
+    stream << std::setw(8) << partition.last_load.mean_wait_ns / 1000;
+    stream << std::endl;
+  }
+
+  stream << "Decisions:" << std::endl;
+  for (const auto& decision : decisions_)
+    stream << "  " << decision << std::endl;
+}
+
+}  // namespace dvr
+}  // namespace android
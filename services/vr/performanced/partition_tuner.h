@@ -0,0 +1,120 @@
+#ifndef ANDROID_DVR_PERFORMANCED_PARTITION_TUNER_H_
+#define ANDROID_DVR_PERFORMANCED_PARTITION_TUNER_H_
+
+#include <sys/types.h>
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <optional>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "cpu_set.h"
+#include "task.h"
+
+namespace android {
+namespace dvr {
+
+// PartitionTuner resizes a group of sibling cpusets at runtime to follow their
+// load. Each period it samples the scheduler statistics of the tasks in every
+// partition; a partition that stays busy, or whose tasks keep waiting on the
+// run queue, takes a cpu from a partition that stays idle. Moves only happen
+// after the same conditions hold for several consecutive periods, so short
+// bursts do not make the partitions oscillate.
+//
+// Tasks stay in the partitions the scheduler policies put them in; only the
+// cpus behind each partition change.
+class PartitionTuner {
+ public:
+  struct Config {
+    std::chrono::milliseconds period{1000};
+    // A partition busier than this fraction of its cpus wants another cpu.
+    double high_utilization = 0.85;
+    // A partition less busy than this fraction of its cpus may give one up.
+    double low_utilization = 0.35;
+    // Mean run queue wait per timeslice above which a partition wants another
+    // cpu, regardless of utilization.
+    std::chrono::nanoseconds high_wait{2000000};
+    // Consecutive periods a condition must hold before acting on it.
+    int hysteresis_periods = 3;
+    size_t min_cpus = 1;
+  };
+
+  // Load of one partition over one period.
+  struct Load {
+    size_t cpu_count = 0;
+    double utilization = 0.0;
+    int64_t mean_wait_ns = 0;
+  };
+
+  // Indices of the partitions a cpu moves from and to.
+  struct Move {
+    size_t from;
+    size_t to;
+  };
+
+  // |partitions| are cpuset paths, all children of the same parent, that
+  // share that parent's cpus between them.
+  PartitionTuner(CpuSetManager* cpusets, std::vector<std::string> partitions,
+                 const Config& config);
+  ~PartitionTuner();
+
+  // Starts the sampling thread. Returns false, and tunes nothing, if there are
+  // fewer than two partitions or the period is not positive.
+  bool Start();
+
+  void DumpState(std::ostringstream& stream) const;
+
+  // Advances the policy by one period of loads, one per partition, and returns
+  // the move to make, if any. Exposed for testing.
+  std::optional<Move> Evaluate(const std::vector<Load>& loads);
+
+ private:
+  struct Partition {
+    std::string path;
+    CpuSet* cpuset = nullptr;
+    // Consecutive periods the partition was overloaded or idle.
+    int busy_periods = 0;
+    int idle_periods = 0;
+    Load last_load;
+    // Cumulative statistics of the tasks seen in the previous sample. Only the
+    // sampling thread uses them, without holding |mutex_|.
+    std::unordered_map<pid_t, Task::SchedStats> task_stats;
+  };
+
+  void ThreadMain();
+  void Sample(std::chrono::nanoseconds elapsed);
+  Load SamplePartition(Partition& partition, std::chrono::nanoseconds elapsed);
+  void ApplyMove(const Move& move);
+  void RecordDecision(const std::string& decision);
+
+  CpuSetManager* cpusets_;
+  const Config config_;
+
+  // Guards the state dumpsys reads. Reading the tasks' statistics and writing
+  // the cpusets are done without it.
+  mutable std::mutex mutex_;
+  std::condition_variable condition_;
+  bool stop_ = false;
+  std::vector<Partition> partitions_;
+
+  static constexpr size_t kDecisionHistory = 32;
+  std::deque<std::string> decisions_;
+
+  std::thread thread_;
+
+  PartitionTuner(const PartitionTuner&) = delete;
+  void operator=(const PartitionTuner&) = delete;
+};
+
+}  // namespace dvr
+}  // namespace android
+
+#endif  // ANDROID_DVR_PERFORMANCED_PARTITION_TUNER_H_
@@ -0,0 +1,118 @@
+#include <gtest/gtest.h>
+
+#include <string>
+#include <vector>
+
+#include "cpu_set.h"
+#include "partition_tuner.h"
+
+using android::dvr::FormatCpuList;
+using android::dvr::ParseCpuList;
+using android::dvr::PartitionTuner;
+
+namespace {
+
+using Load = PartitionTuner::Load;
+
+constexpr Load kBusy{.cpu_count = 2, .utilization = 0.95, .mean_wait_ns = 0};
+constexpr Load kIdle{.cpu_count = 2, .utilization = 0.10, .mean_wait_ns = 0};
+constexpr Load kModerate{
+    .cpu_count = 2, .utilization = 0.50, .mean_wait_ns = 0};
+
+PartitionTuner::Config TestConfig() {
+  PartitionTuner::Config config;
+  config.hysteresis_periods = 3;
+  return config;
+}
+
+}  // anonymous namespace
+
+TEST(PartitionTunerTest, ParseCpuList) {
+  EXPECT_EQ((std::vector<int>{}), ParseCpuList(""));
+  EXPECT_EQ((std::vector<int>{3}), ParseCpuList("3"));
+  EXPECT_EQ((std::vector<int>{0, 1, 2, 4}), ParseCpuList("0-2,4"));
+  EXPECT_EQ((std::vector<int>{1, 2, 5}), ParseCpuList("5,1-2\n"));
+  EXPECT_EQ((std::vector<int>{0}), ParseCpuList("0,2-1,x"));
+}
+
+TEST(PartitionTunerTest, FormatCpuList) {
+  EXPECT_EQ("", FormatCpuList({}));
+  EXPECT_EQ("3", FormatCpuList({3}));
+  EXPECT_EQ("0-2,4", FormatCpuList({0, 1, 2, 4}));
+  EXPECT_EQ("0,2,4-5", FormatCpuList({0, 2, 4, 5}));
+}
+
+TEST(PartitionTunerTest, MovesCpuAfterHysteresis) {
+  PartitionTuner tuner(nullptr, {"/busy", "/idle"}, TestConfig());
+
+  EXPECT_FALSE(tuner.Evaluate({kBusy, kIdle}));
+  EXPECT_FALSE(tuner.Evaluate({kBusy, kIdle}));
+  auto move = tuner.Evaluate({kBusy, kIdle});
+  ASSERT_TRUE(move);
+  EXPECT_EQ(1u, move->from);
+  EXPECT_EQ(0u, move->to);
+
+  // The next move needs the conditions to hold for another full window.
+  EXPECT_FALSE(tuner.Evaluate({kBusy, kIdle}));
+  EXPECT_FALSE(tuner.Evaluate({kBusy, kIdle}));
+  EXPECT_TRUE(tuner.Evaluate({kBusy, kIdle}));
+}
+
+TEST(PartitionTunerTest, BurstsDoNotMoveCpus) {
+  PartitionTuner tuner(nullptr, {"/busy", "/idle"}, TestConfig());
+
+  for (int i = 0; i < 10; i++) {
+    EXPECT_FALSE(tuner.Evaluate({kBusy, kIdle}));
+    EXPECT_FALSE(tuner.Evaluate({kBusy, kIdle}));
+    EXPECT_FALSE(tuner.Evaluate({kModerate, kIdle}));
+  }
+}
+
+TEST(PartitionTunerTest, SchedulerLatencyCountsAsBusy) {
+  PartitionTuner tuner(nullptr, {"/waiting", "/idle"}, TestConfig());
+  const Load waiting{
+      .cpu_count = 2, .utilization = 0.50, .mean_wait_ns = 5000000};
+
+  EXPECT_FALSE(tuner.Evaluate({waiting, kIdle}));
+  EXPECT_FALSE(tuner.Evaluate({waiting, kIdle}));
+  auto move = tuner.Evaluate({waiting, kIdle});
+  ASSERT_TRUE(move);
+  EXPECT_EQ(0u, move->to);
+}
+
+TEST(PartitionTunerTest, KeepsMinimumCpus) {
+  PartitionTuner tuner(nullptr, {"/busy", "/idle"}, TestConfig());
+  const Load last_cpu{.cpu_count = 1, .utilization = 0.0, .mean_wait_ns = 0};
+
+  for (int i = 0; i < 10; i++)
+    EXPECT_FALSE(tuner.Evaluate({kBusy, last_cpu}));
+}
+
+TEST(PartitionTunerTest, RejectsInvalidPeriods) {
+  PartitionTuner::Config config = TestConfig();
+  config.period = std::chrono::milliseconds(0);
+  PartitionTuner zero(nullptr, {"/a", "/b"}, config);
+  EXPECT_FALSE(zero.Start());
+
+  config.period = std::chrono::milliseconds(-1);
+  PartitionTuner negative(nullptr, {"/a", "/b"}, config);
+  EXPECT_FALSE(negative.Start());
+}
+
+TEST(PartitionTunerTest, NeedsTwoPartitions) {
+  PartitionTuner tuner(nullptr, {"/a"}, TestConfig());
+  EXPECT_FALSE(tuner.Start());
+}
+
+TEST(PartitionTunerTest, PicksBusiestAndIdlestPartitions) {
+  PartitionTuner tuner(nullptr, {"/a", "/b", "/c", "/d"}, TestConfig());
+  const Load busier{.cpu_count = 2, .utilization = 0.99, .mean_wait_ns = 0};
+  const Load idler{.cpu_count = 2, .utilization = 0.01, .mean_wait_ns = 0};
+
+  std::optional<PartitionTuner::Move> move;
+  for (int i = 0; i < 3; i++)
+    move = tuner.Evaluate({kBusy, idler, busier, kIdle});
+  ASSERT_TRUE(move);
+  EXPECT_EQ(1u, move->from);
+  EXPECT_EQ(2u, move->to);
+}
@@ -6,6 +6,8 @@
 #include <sys/prctl.h>
 #include <unistd.h>
 
+#include <android-base/strings.h>
+#include <cutils/properties.h>
 #include <pdx/default_transport/service_endpoint.h>
 #include <pdx/rpc/argument_encoder.h>
 #include <pdx/rpc/message_buffer.h>
@@ -35,6 +37,10 @@ const char kRootCpuSet[] = "/";
 
 const char kVrAppRenderPolicy[] = "vr:app:render";
 
+// Comma separated list of sibling cpusets to resize according to their load.
+const char kTunedPartitionsProperty[] = "dvr.performanced.tuned_partitions";
+const char kTunerPeriodProperty[] = "dvr.performanced.tuner_period_ms";
+
 const bool kAllowAppsToRequestVrAppRenderPolicy = false;
 
 constexpr unsigned long kTimerSlackForegroundNs = 50000;
@@ -224,6 +230,19 @@ PerformanceService::PerformanceService()
         .scheduler_policy = SCHED_BATCH,
         .priority = 0}},
   };
+
+  char tuned_partitions[PROPERTY_VALUE_MAX];
+  property_get(kTunedPartitionsProperty, tuned_partitions, "");
+  if (tuned_partitions[0] != '\0') {
+    PartitionTuner::Config config;
+    config.period = std::chrono::milliseconds(property_get_int32(
+        kTunerPeriodProperty, static_cast<int32_t>(config.period.count())));
+
+    partition_tuner_ = std::make_unique<PartitionTuner>(
+        &cpuset_, base::Split(tuned_partitions, ","), config);
+    if (!partition_tuner_->Start())
+      partition_tuner_.reset();
+  }
 }
 
 bool PerformanceService::IsInitialized() const {
@@ -235,6 +254,8 @@ std::string PerformanceService::DumpState(size_t /*max_length*/) {
   std::ostringstream stream;
   stream << "vr_app_render_thread: " << vr_app_render_thread_ << std::endl;
   cpuset_.DumpState(stream);
+  if (partition_tuner_)
+    partition_tuner_->DumpState(stream);
   return stream.str();
 }
 
@@ -2,12 +2,14 @@
 #define ANDROID_DVR_PERFORMANCED_PERFORMANCE_SERVICE_H_
 
 #include <functional>
+#include <memory>
 #include <string>
 #include <unordered_map>
 
 #include <pdx/service.h>
 
 #include "cpu_set.h"
+#include "partition_tuner.h"
 #include "task.h"
 
 namespace android {
@@ -80,6 +82,10 @@ class PerformanceService : public pdx::ServiceBase<PerformanceService> {
 
   pid_t vr_app_render_thread_ = -1;
 
+  // Resizes the partitions listed in the dvr.performanced.tuned_partitions
+  // property at runtime; null when the property is not set.
+  std::unique_ptr<PartitionTuner> partition_tuner_;
+
   PerformanceService(const PerformanceService&) = delete;
   void operator=(const PerformanceService&) = delete;
 };
@@ -148,6 +148,26 @@ void Task::ReadStatusFields() {
   }
 }
 
+bool Task::ReadSchedStats(pid_t task_id, SchedStats* stats) {
+  std::ostringstream stream;
+  stream << kProcBase << "/" << task_id << "/schedstat";
+
+  UniqueFile file(fopen(stream.str().c_str(), "re"));
+  if (!file)
+    return false;
+
+  unsigned long long run_time_ns, wait_time_ns, timeslice_count;
+  if (fscanf(file.get(), "%llu %llu %llu", &run_time_ns, &wait_time_ns,
+             &timeslice_count) != 3) {
+    return false;
+  }
+
+  stats->run_time_ns = run_time_ns;
+  stats->wait_time_ns = wait_time_ns;
+  stats->timeslice_count = timeslice_count;
+  return true;
+}
+
 std::string Task::GetCpuSetPath() const {
   if (auto file = OpenTaskFilePointer("cpuset")) {
     stdio_filebuf<char> filebuf(file.get());
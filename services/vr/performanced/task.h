@@ -46,6 +46,19 @@ class Task {
 
   std::string GetCpuSetPath() const;
 
+  // Scheduler statistics from /proc/<task_id>/schedstat, accumulated over the
+  // lifetime of the task.
+  struct SchedStats {
+    uint64_t run_time_ns = 0;    // Time spent running on a cpu.
+    uint64_t wait_time_ns = 0;   // Time spent runnable on a run queue.
+    uint64_t timeslice_count = 0;
+  };
+
+  // Reads the scheduler statistics of |task_id| without reading the rest of its
+  // status, which keeps periodic sampling of many tasks cheap. Returns false if
+  // the task has exited or the kernel does not provide schedstat.
+  static bool ReadSchedStats(pid_t task_id, SchedStats* stats);
+
  private:
   pid_t task_id_;
   base::unique_fd task_fd_;
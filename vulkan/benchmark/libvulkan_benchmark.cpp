@@ -0,0 +1,409 @@
+/*
+ * Copyright 2019 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Benchmarks of the loader side of the Vulkan entry points. Against the null
+// driver (vulkan.default) every driver call is a no-op, so the numbers are the
+// cost of libvulkan and whatever layers are enabled. Each benchmark is labelled
+// with the name of the physical device it ran against.
+
+#define VK_USE_PLATFORM_ANDROID_KHR
+
+#include <string>
+
+#include <benchmark/benchmark.h>
+#include <gui/BufferItem.h>
+#include <gui/BufferQueue.h>
+#include <gui/IConsumerListener.h>
+#include <gui/Surface.h>
+#include <ui/Fence.h>
+#include <vulkan/vulkan.h>
+
+namespace {
+
+const char kNullDriverName[] = "Android Vulkan Null Driver";
+
+const char* const kInstanceExtensions[] = {
+    VK_KHR_SURFACE_EXTENSION_NAME,
+    VK_KHR_ANDROID_SURFACE_EXTENSION_NAME,
+};
+
+const char* const kDeviceExtensions[] = {
+    VK_KHR_SWAPCHAIN_EXTENSION_NAME,
+};
+
+VkInstance CreateInstance() {
+    const VkApplicationInfo app_info = {
+        .sType = VK_STRUCTURE_TYPE_APPLICATION_INFO,
+        .pApplicationName = "libvulkan_benchmark",
+        .apiVersion = VK_API_VERSION_1_1,
+    };
+    const VkInstanceCreateInfo create_info = {
+        .sType = VK_STRUCTURE_TYPE_INSTANCE_CREATE_INFO,
+        .pApplicationInfo = &app_info,
+        .enabledExtensionCount = static_cast<uint32_t>(
+            sizeof(kInstanceExtensions) / sizeof(kInstanceExtensions[0])),
+        .ppEnabledExtensionNames = kInstanceExtensions,
+    };
+    VkInstance instance = VK_NULL_HANDLE;
+    if (vkCreateInstance(&create_info, nullptr, &instance) != VK_SUCCESS)
+        return VK_NULL_HANDLE;
+    return instance;
+}
+
+VkPhysicalDevice GetPhysicalDevice(VkInstance instance) {
+    uint32_t count = 1;
+    VkPhysicalDevice gpu = VK_NULL_HANDLE;
+    VkResult result = vkEnumeratePhysicalDevices(instance, &count, &gpu);
+    if ((result != VK_SUCCESS && result != VK_INCOMPLETE) || count == 0)
+        return VK_NULL_HANDLE;
+    return gpu;
+}
+
+VkDevice CreateDevice(VkPhysicalDevice gpu) {
+    const float priority = 1.0f;
+    const VkDeviceQueueCreateInfo queue_info = {
+        .sType = VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO,
+        .queueFamilyIndex = 0,
+        .queueCount = 1,
+        .pQueuePriorities = &priority,
+    };
+    const VkDeviceCreateInfo create_info = {
+        .sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO,
+        .queueCreateInfoCount = 1,
+        .pQueueCreateInfos = &queue_info,
+        .enabledExtensionCount = static_cast<uint32_t>(
+            sizeof(kDeviceExtensions) / sizeof(kDeviceExtensions[0])),
+        .ppEnabledExtensionNames = kDeviceExtensions,
+    };
+    VkDevice device = VK_NULL_HANDLE;
+    if (vkCreateDevice(gpu, &create_info, nullptr, &device) != VK_SUCCESS)
+        return VK_NULL_HANDLE;
+    return device;
+}
+
+// An instance, physical device and device shared by the benchmarks that don't
+// measure creating them.
+class Context {
+   public:
+    Context() {
+        instance_ = CreateInstance();
+        if (instance_ == VK_NULL_HANDLE)
+            return;
+        gpu_ = GetPhysicalDevice(instance_);
+        if (gpu_ == VK_NULL_HANDLE)
+            return;
+        VkPhysicalDeviceProperties properties;
+        vkGetPhysicalDeviceProperties(gpu_, &properties);
+        device_name_ = properties.deviceName;
+        device_ = CreateDevice(gpu_);
+        if (device_ != VK_NULL_HANDLE)
+            vkGetDeviceQueue(device_, 0, 0, &queue_);
+    }
+
+    ~Context() {
+        if (device_ != VK_NULL_HANDLE)
+            vkDestroyDevice(device_, nullptr);
+        if (instance_ != VK_NULL_HANDLE)
+            vkDestroyInstance(instance_, nullptr);
+    }
+
+    Context(const Context&) = delete;
+    Context& operator=(const Context&) = delete;
+
+    // Labels the benchmark with the device name, or skips it when there is
+    // no usable device.
+    bool Prepare(benchmark::State& state) const {
+        if (queue_ == VK_NULL_HANDLE) {
+            state.SkipWithError("failed to create a Vulkan device");
+            return false;
+        }
+        state.SetLabel(device_name_ == kNullDriverName
+                           ? device_name_
+                           : device_name_ + " (not the null driver)");
+        return true;
+    }
+
+    VkInstance instance() const { return instance_; }
+    VkPhysicalDevice gpu() const { return gpu_; }
+    VkDevice device() const { return device_; }
+    VkQueue queue() const { return queue_; }
+
+   private:
+    VkInstance instance_ = VK_NULL_HANDLE;
+    VkPhysicalDevice gpu_ = VK_NULL_HANDLE;
+    VkDevice device_ = VK_NULL_HANDLE;
+    VkQueue queue_ = VK_NULL_HANDLE;
+    std::string device_name_;
+};
+
+const Context& GetContext() {
+    static const Context* context = new Context();
+    return *context;
+}
+
+void BM_CreateDestroyInstance(benchmark::State& state) {
+    if (!GetContext().Prepare(state))
+        return;
+    for (auto _ : state) {
+        VkInstance instance = CreateInstance();
+        if (instance == VK_NULL_HANDLE) {
+            state.SkipWithError("vkCreateInstance failed");
+            break;
+        }
+        vkDestroyInstance(instance, nullptr);
+    }
+}
+BENCHMARK(BM_CreateDestroyInstance);
+
+void BM_EnumeratePhysicalDevices(benchmark::State& state) {
+    const Context& context = GetContext();
+    if (!context.Prepare(state))
+        return;
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(GetPhysicalDevice(context.instance()));
+    }
+}
+BENCHMARK(BM_EnumeratePhysicalDevices);
+
+void BM_CreateDestroyDevice(benchmark::State& state) {
+    const Context& context = GetContext();
+    if (!context.Prepare(state))
+        return;
+    for (auto _ : state) {
+        VkDevice device = CreateDevice(context.gpu());
+        if (device == VK_NULL_HANDLE) {
+            state.SkipWithError("vkCreateDevice failed");
+            break;
+        }
+        vkDestroyDevice(device, nullptr);
+    }
+}
+BENCHMARK(BM_CreateDestroyDevice);
+
+void BM_GetDeviceProcAddr(benchmark::State& state) {
+    const Context& context = GetContext();
+    if (!context.Prepare(state))
+        return;
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(
+            vkGetDeviceProcAddr(context.device(), "vkCmdDraw"));
+    }
+}
+BENCHMARK(BM_GetDeviceProcAddr);
+
+// Records one command per iteration through the libvulkan trampoline, in a
+// command buffer that is restarted every state.range(0) commands.
+void BM_CmdDraw(benchmark::State& state) {
+    const Context& context = GetContext();
+    if (!context.Prepare(state))
+        return;
+
+    const VkCommandPoolCreateInfo pool_info = {
+        .sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO,
+        .flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT,
+        .queueFamilyIndex = 0,
+    };
+    VkCommandPool pool;
+    vkCreateCommandPool(context.device(), &pool_info, nullptr, &pool);
+    const VkCommandBufferAllocateInfo alloc_info = {
+        .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO,
+        .commandPool = pool,
+        .level = VK_COMMAND_BUFFER_LEVEL_PRIMARY,
+        .commandBufferCount = 1,
+    };
+    VkCommandBuffer cmd;
+    vkAllocateCommandBuffers(context.device(), &alloc_info, &cmd);
+
+    const VkCommandBufferBeginInfo begin_info = {
+        .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
+        .flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT,
+    };
+    const int64_t commands_per_buffer = state.range(0);
+    int64_t recorded = 0;
+    vkBeginCommandBuffer(cmd, &begin_info);
+    for (auto _ : state) {
+        vkCmdDraw(cmd, 3, 1, 0, 0);
+        if (++recorded == commands_per_buffer) {
+            vkEndCommandBuffer(cmd);
+            vkBeginCommandBuffer(cmd, &begin_info);
+            recorded = 0;
+        }
+    }
+    vkEndCommandBuffer(cmd);
+
+    vkFreeCommandBuffers(context.device(), pool, 1, &cmd);
+    vkDestroyCommandPool(context.device(), pool, nullptr);
+}
+BENCHMARK(BM_CmdDraw)->Arg(1)->Arg(1000);
+
+void BM_QueueSubmit(benchmark::State& state) {
+    const Context& context = GetContext();
+    if (!context.Prepare(state))
+        return;
+    for (auto _ : state) {
+        vkQueueSubmit(context.queue(), 0, nullptr, VK_NULL_HANDLE);
+    }
+    vkQueueWaitIdle(context.queue());
+}
+BENCHMARK(BM_QueueSubmit);
+
+class DummyConsumerListener : public android::BnConsumerListener {
+   public:
+    void onFrameAvailable(const android::BufferItem&) override {}
+    void onBuffersReleased() override {}
+    void onSidebandStreamChanged() override {}
+};
+
+// A VkSurfaceKHR on top of a BufferQueue whose consumer end is drained by
+// the benchmark, so presenting never waits on a compositor.
+class BufferQueueSurface {
+   public:
+    explicit BufferQueueSurface(VkInstance instance) : instance_(instance) {
+        android::sp<android::IGraphicBufferProducer> producer;
+        android::BufferQueue::createBufferQueue(&producer, &consumer_);
+        consumer_->consumerConnect(new DummyConsumerListener(), false);
+        consumer_->setDefaultBufferSize(kWidth, kHeight);
+        window_ = new android::Surface(producer);
+
+        const VkAndroidSurfaceCreateInfoKHR create_info = {
+            .sType = VK_STRUCTURE_TYPE_ANDROID_SURFACE_CREATE_INFO_KHR,
+            .window = window_.get(),
+        };
+        if (vkCreateAndroidSurfaceKHR(instance_, &create_info, nullptr,
+                                      &surface_) != VK_SUCCESS)
+            surface_ = VK_NULL_HANDLE;
+    }
+
+    ~BufferQueueSurface() {
+        if (surface_ != VK_NULL_HANDLE)
+            vkDestroySurfaceKHR(instance_, surface_, nullptr);
+    }
+
+    BufferQueueSurface(const BufferQueueSurface&) = delete;
+    BufferQueueSurface& operator=(const BufferQueueSurface&) = delete;
+
+    VkSwapchainKHR CreateSwapchain(VkDevice device,
+                                   VkPhysicalDevice gpu) const {
+        VkSurfaceCapabilitiesKHR capabilities;
+        vkGetPhysicalDeviceSurfaceCapabilitiesKHR(gpu, surface_,
+                                                  &capabilities);
+        const VkSwapchainCreateInfoKHR create_info = {
+            .sType = VK_STRUCTURE_TYPE_SWAPCHAIN_CREATE_INFO_KHR,
+            .surface = surface_,
+            .minImageCount = capabilities.minImageCount,
+            .imageFormat = VK_FORMAT_R8G8B8A8_UNORM,
+            .imageColorSpace = VK_COLOR_SPACE_SRGB_NONLINEAR_KHR,
+            .imageExtent = {kWidth, kHeight},
+            .imageArrayLayers = 1,
+            .imageUsage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT,
+            .imageSharingMode = VK_SHARING_MODE_EXCLUSIVE,
+            .preTransform = VK_SURFACE_TRANSFORM_IDENTITY_BIT_KHR,
+            .compositeAlpha = VK_COMPOSITE_ALPHA_INHERIT_BIT_KHR,
+            .presentMode = VK_PRESENT_MODE_FIFO_KHR,
+            .clipped = VK_TRUE,
+        };
+        VkSwapchainKHR swapchain = VK_NULL_HANDLE;
+        if (vkCreateSwapchainKHR(device, &create_info, nullptr, &swapchain) !=
+            VK_SUCCESS)
+            return VK_NULL_HANDLE;
+        return swapchain;
+    }
+
+    // Hands the last presented buffer back to the producer.
+    void ConsumeFrame() const {
+        android::BufferItem item;
+        if (consumer_->acquireBuffer(&item, 0) == android::NO_ERROR)
+            consumer_->releaseHelper(item.mSlot, item.mFrameNumber,
+                                     android::Fence::NO_FENCE);
+    }
+
+    VkSurfaceKHR surface() const { return surface_; }
+
+   private:
+    static constexpr uint32_t kWidth = 64;
+    static constexpr uint32_t kHeight = 64;
+
+    const VkInstance instance_;
+    android::sp<android::IGraphicBufferConsumer> consumer_;
+    android::sp<android::Surface> window_;
+    VkSurfaceKHR surface_ = VK_NULL_HANDLE;
+};
+
+void BM_CreateDestroySwapchain(benchmark::State& state) {
+    const Context& context = GetContext();
+    if (!context.Prepare(state))
+        return;
+    BufferQueueSurface surface(context.instance());
+    if (surface.surface() == VK_NULL_HANDLE) {
+        state.SkipWithError("vkCreateAndroidSurfaceKHR failed");
+        return;
+    }
+    for (auto _ : state) {
+        VkSwapchainKHR swapchain =
+            surface.CreateSwapchain(context.device(), context.gpu());
+        if (swapchain == VK_NULL_HANDLE) {
+            state.SkipWithError("vkCreateSwapchainKHR failed");
+            break;
+        }
+        vkDestroySwapchainKHR(context.device(), swapchain, nullptr);
+    }
+}
+BENCHMARK(BM_CreateDestroySwapchain);
+
+// One vkAcquireNextImageKHR and vkQueuePresentKHR per iteration. The
+// consumer side of the BufferQueue is included in the time.
+void BM_AcquirePresent(benchmark::State& state) {
+    const Context& context = GetContext();
+    if (!context.Prepare(state))
+        return;
+    BufferQueueSurface surface(context.instance());
+    VkSwapchainKHR swapchain = VK_NULL_HANDLE;
+    if (surface.surface() != VK_NULL_HANDLE)
+        swapchain = surface.CreateSwapchain(context.device(), context.gpu());
+    if (swapchain == VK_NULL_HANDLE) {
+        state.SkipWithError("failed to create a swapchain");
+        return;
+    }
+
+    for (auto _ : state) {
+        uint32_t index;
+        VkResult result =
+            vkAcquireNextImageKHR(context.device(), swapchain, UINT64_MAX,
+                                  VK_NULL_HANDLE, VK_NULL_HANDLE, &index);
+        if (result != VK_SUCCESS) {
+            state.SkipWithError("vkAcquireNextImageKHR failed");
+            break;
+        }
+        const VkPresentInfoKHR present_info = {
+            .sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR,
+            .swapchainCount = 1,
+            .pSwapchains = &swapchain,
+            .pImageIndices = &index,
+        };
+        if (vkQueuePresentKHR(context.queue(), &present_info) != VK_SUCCESS) {
+            state.SkipWithError("vkQueuePresentKHR failed");
+            break;
+        }
+        surface.ConsumeFrame();
+    }
+
+    vkDestroySwapchainKHR(context.device(), swapchain, nullptr);
+}
+BENCHMARK(BM_AcquirePresent);
+
+}  // namespace
+
+BENCHMARK_MAIN();
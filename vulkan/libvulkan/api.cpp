@@ -34,6 +34,7 @@
 #include <android-base/strings.h>
 #include <cutils/properties.h>
 #include <log/log.h>
+#include <utils/Timers.h>
 #include <utils/Trace.h>
 
 #include <vulkan/vk_layer_interface.h>
@@ -1171,7 +1172,12 @@ bool EnsureInitialized() {
 
     std::call_once(once_flag, []() {
         if (driver::OpenHAL()) {
+            const nsecs_t discover_time = systemTime();
             DiscoverLayers();
+            android::GraphicsEnv::getInstance().setDriverLoadingPhaseTime(
+                android::GraphicsEnv::Api::API_VK,
+                android::GraphicsEnv::LAYER_SETUP,
+                systemTime() - discover_time);
             initialized = true;
         }
     });
@@ -152,10 +152,27 @@ class CreateInfoWrapper {
 
 Hal Hal::hal_;
 
+// The time Hal::Open spent in each phase of loading the driver.
+nsecs_t g_loading_phase_time[android::GraphicsEnv::LOADING_PHASE_COUNT];
+
+class LoadingPhaseTimer {
+   public:
+    explicit LoadingPhaseTimer(android::GraphicsEnv::LoadingPhase phase)
+        : phase_(phase), start_(systemTime()) {}
+    ~LoadingPhaseTimer() {
+        g_loading_phase_time[phase_] += systemTime() - start_;
+    }
+
+   private:
+    const android::GraphicsEnv::LoadingPhase phase_;
+    const nsecs_t start_;
+};
+
 void* LoadLibrary(const android_dlextinfo& dlextinfo,
                   const char* subname,
                   int subname_len) {
     ATRACE_CALL();
+    LoadingPhaseTimer timer(android::GraphicsEnv::DLOPEN);
 
     const char kLibFormat[] = "vulkan.%*s.so";
     char* name = static_cast<char*>(
@@ -209,7 +226,11 @@ int LoadDriver(android_namespace_t* library_namespace,
 int LoadBuiltinDriver(const hwvulkan_module_t** module) {
     ATRACE_CALL();
 
-    auto ns = android_get_exported_namespace("sphal");
+    android_namespace_t* ns;
+    {
+        LoadingPhaseTimer timer(android::GraphicsEnv::NAMESPACE_SETUP);
+        ns = android_get_exported_namespace("sphal");
+    }
     if (!ns)
         return -ENOENT;
     android::GraphicsEnv::getInstance().setDriverToLoad(
@@ -220,7 +241,11 @@ int LoadBuiltinDriver(const hwvulkan_module_t** module) {
 int LoadUpdatedDriver(const hwvulkan_module_t** module) {
     ATRACE_CALL();
 
-    auto ns = android::GraphicsEnv::getInstance().getDriverNamespace();
+    android_namespace_t* ns;
+    {
+        LoadingPhaseTimer timer(android::GraphicsEnv::NAMESPACE_SETUP);
+        ns = android::GraphicsEnv::getInstance().getDriverNamespace();
+    }
     if (!ns)
         return -ENOENT;
     android::GraphicsEnv::getInstance().setDriverToLoad(
@@ -252,6 +277,7 @@ bool Hal::Open() {
                 "Failed to load Vulkan driver into sphal namespace. This "
                 "usually means the driver has forbidden library dependencies."
                 "Please fix, this will soon stop working.");
+            LoadingPhaseTimer timer(android::GraphicsEnv::DLOPEN);
             result =
                 hw_get_module(HWVULKAN_HARDWARE_MODULE_ID,
                               reinterpret_cast<const hw_module_t**>(&module));
@@ -267,9 +293,12 @@ bool Hal::Open() {
 
     hwvulkan_device_t* device;
     ATRACE_BEGIN("hwvulkan module open");
-    result =
-        module->common.methods->open(&module->common, HWVULKAN_DEVICE_0,
-                                     reinterpret_cast<hw_device_t**>(&device));
+    {
+        LoadingPhaseTimer timer(android::GraphicsEnv::ENTRY_POINT_RESOLUTION);
+        result = module->common.methods->open(
+            &module->common, HWVULKAN_DEVICE_0,
+            reinterpret_cast<hw_device_t**>(&device));
+    }
     ATRACE_END();
     if (result != 0) {
         android::GraphicsEnv::getInstance().setDriverLoaded(
@@ -286,6 +315,13 @@ bool Hal::Open() {
 
     android::GraphicsEnv::getInstance().setDriverLoaded(
         android::GraphicsEnv::Api::API_VK, true, systemTime() - openTime);
+    for (auto phase : {android::GraphicsEnv::NAMESPACE_SETUP,
+                       android::GraphicsEnv::DLOPEN,
+                       android::GraphicsEnv::ENTRY_POINT_RESOLUTION}) {
+        android::GraphicsEnv::getInstance().setDriverLoadingPhaseTime(
+            android::GraphicsEnv::Api::API_VK, phase,
+            g_loading_phase_time[phase]);
+    }
 
     return true;
 }
@@ -1134,6 +1170,7 @@ VkResult CreateDevice(VkPhysicalDevice physicalDevice,
                       const VkDeviceCreateInfo* pCreateInfo,
                       const VkAllocationCallbacks* pAllocator,
                       VkDevice* pDevice) {
+    const nsecs_t create_time = systemTime();
     const InstanceData& instance_data = GetData(physicalDevice);
     const VkAllocationCallbacks& data_allocator =
         (pAllocator) ? *pAllocator : instance_data.allocator;
@@ -1212,6 +1249,11 @@ VkResult CreateDevice(VkPhysicalDevice physicalDevice,
 
     *pDevice = dev;
 
+    // Only the first device of the process is recorded.
+    android::GraphicsEnv::getInstance().setDriverLoadingPhaseTime(
+        android::GraphicsEnv::Api::API_VK, android::GraphicsEnv::FIRST_CONTEXT,
+        systemTime() - create_time);
+
     return VK_SUCCESS;
 }
 
@@ -471,16 +471,55 @@ const ProcHook g_proc_hooks[] = {
     // clang-format on
 };
 
+constexpr size_t kProcHookCount =
+    sizeof(g_proc_hooks) / sizeof(g_proc_hooks[0]);
+
+// The hash table over the hook names has at least twice as many buckets as
+// there are hooks, so that a lookup rarely probes more than one.
+constexpr size_t ProcHookBucketCount(size_t count) {
+    size_t buckets = 1;
+    while (buckets < 2 * count)
+        buckets *= 2;
+    return buckets;
+}
+constexpr size_t kProcHookBuckets = ProcHookBucketCount(kProcHookCount);
+
+uint32_t HashProcHookName(const char* name) {
+    // FNV-1a
+    uint32_t hash = 2166136261u;
+    for (; *name; name++)
+        hash = (hash ^ static_cast<uint8_t>(*name)) * 16777619u;
+    return hash;
+}
+
+// Maps each bucket to the index of its hook in g_proc_hooks plus one, or to
+// zero for an empty bucket.  Collisions probe the following buckets.
+struct ProcHookTable {
+    uint16_t buckets[kProcHookBuckets] = {};
+
+    ProcHookTable() {
+        for (size_t i = 0; i < kProcHookCount; i++) {
+            size_t bucket =
+                HashProcHookName(g_proc_hooks[i].name) & (kProcHookBuckets - 1);
+            while (buckets[bucket])
+                bucket = (bucket + 1) & (kProcHookBuckets - 1);
+            buckets[bucket] = static_cast<uint16_t>(i + 1);
+        }
+    }
+};
+
 }  // namespace
 
 const ProcHook* GetProcHook(const char* name) {
-    const auto& begin = g_proc_hooks;
-    const auto& end =
-        g_proc_hooks + sizeof(g_proc_hooks) / sizeof(g_proc_hooks[0]);
-    const auto hook = std::lower_bound(
-        begin, end, name,
-        [](const ProcHook& e, const char* n) { return strcmp(e.name, n) < 0; });
-    return (hook < end && strcmp(hook->name, name) == 0) ? hook : nullptr;
+    static const ProcHookTable table;
+    size_t bucket = HashProcHookName(name) & (kProcHookBuckets - 1);
+    while (table.buckets[bucket]) {
+        const ProcHook* hook = &g_proc_hooks[table.buckets[bucket] - 1];
+        if (strcmp(hook->name, name) == 0)
+            return hook;
+        bucket = (bucket + 1) & (kProcHookBuckets - 1);
+    }
+    return nullptr;
 }
 
 ProcHook::Extension GetProcHookExtension(const char* name) {
@@ -21,14 +21,19 @@
 #include <alloca.h>
 #include <dirent.h>
 #include <dlfcn.h>
+#include <stdio.h>
 #include <string.h>
 #include <sys/prctl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <zlib.h>
 
 #include <mutex>
 #include <string>
 #include <vector>
 
 #include <android/dlext.h>
+#include <android-base/file.h>
 #include <android-base/strings.h>
 #include <cutils/properties.h>
 #include <graphicsenv/GraphicsEnv.h>
@@ -343,19 +348,291 @@ void* LayerLibrary::GetGPA(const Layer& layer,
 std::vector<LayerLibrary> g_layer_libraries;
 std::vector<Layer> g_instance_layers;
 
-void AddLayerLibrary(const std::string& path, const std::string& filename) {
+bool AddLayerLibrary(const std::string& path, const std::string& filename) {
     LayerLibrary library(path + "/" + filename, filename);
     if (!library.Open())
-        return;
+        return false;
 
     if (!library.EnumerateLayers(g_layer_libraries.size(), g_instance_layers)) {
         library.Close();
-        return;
+        return false;
     }
 
     library.Close();
 
     g_layer_libraries.emplace_back(std::move(library));
+    return true;
+}
+
+// ----------------------------------------------------------------------------
+// Layer metadata cache
+//
+// Discovering layers opens every layer library to enumerate its layers and
+// their extensions. When the application provides a cache file through
+// GraphicsEnv::setLayerCachePath, the layers found are saved there together
+// with the size and modification time of each search path and library. As
+// long as none of those change, later processes take the layers from the
+// cache, and only open the libraries of the layers they enable.
+
+// The size and modification time of a file or directory.
+struct FileStamp {
+    int64_t size;
+    int64_t mtime_ns;
+
+    bool operator==(const FileStamp& other) const {
+        return size == other.size && mtime_ns == other.mtime_ns;
+    }
+};
+
+bool GetFileStamp(const std::string& path, FileStamp* stamp) {
+    struct stat st;
+    if (stat(path.c_str(), &st) != 0)
+        return false;
+    stamp->size = st.st_size;
+    stamp->mtime_ns = st.st_mtim.tv_sec * 1000000000LL + st.st_mtim.tv_nsec;
+    return true;
+}
+
+// A search path is either a directory or a directory in an APK; the APK
+// changes whenever anything in it does.
+std::string GetSearchPathFile(const std::string& path) {
+    return path.substr(0, path.find("!/"));
+}
+
+bool IsSearchPathInZip(const std::string& path) {
+    return path.find("!/") != std::string::npos;
+}
+
+struct CachedLibrary {
+    std::string filename;
+    // Only checked for libraries in directories.
+    FileStamp stamp;
+    // Empty if the library is not a usable layer library.
+    std::vector<Layer> layers;
+};
+
+struct CachedSearchPath {
+    std::string path;
+    // Missing search paths are recorded with a stamp of -1.
+    FileStamp stamp;
+    std::vector<CachedLibrary> libraries;
+};
+
+const uint32_t kLayerCacheMagic = 0x434c4b56;  // "VKLC"
+const uint32_t kLayerCacheVersion = 1;
+
+struct LayerCacheHeader {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t payload_size;
+    uint32_t payload_crc;
+};
+
+class LayerCacheWriter {
+   public:
+    void Write(const void* data, size_t size) {
+        const uint8_t* bytes = static_cast<const uint8_t*>(data);
+        buffer_.insert(buffer_.end(), bytes, bytes + size);
+    }
+    void WriteU32(uint32_t value) { Write(&value, sizeof(value)); }
+    void WriteString(const std::string& str) {
+        WriteU32(static_cast<uint32_t>(str.size()));
+        Write(str.data(), str.size());
+    }
+    void WriteStamp(const FileStamp& stamp) { Write(&stamp, sizeof(stamp)); }
+    template <typename T>
+    void WriteArray(const std::vector<T>& values) {
+        WriteU32(static_cast<uint32_t>(values.size()));
+        Write(values.data(), values.size() * sizeof(T));
+    }
+
+    const std::vector<uint8_t>& buffer() const { return buffer_; }
+
+   private:
+    std::vector<uint8_t> buffer_;
+};
+
+class LayerCacheReader {
+   public:
+    LayerCacheReader(const uint8_t* data, size_t size)
+        : data_(data), remaining_(size) {}
+
+    bool Read(void* data, size_t size) {
+        if (size > remaining_)
+            return false;
+        if (size == 0)
+            return true;
+        memcpy(data, data_, size);
+        data_ += size;
+        remaining_ -= size;
+        return true;
+    }
+    bool ReadU32(uint32_t* value) { return Read(value, sizeof(*value)); }
+    bool ReadString(std::string* str) {
+        uint32_t size;
+        if (!ReadU32(&size) || size > remaining_)
+            return false;
+        str->assign(reinterpret_cast<const char*>(data_), size);
+        data_ += size;
+        remaining_ -= size;
+        return true;
+    }
+    bool ReadStamp(FileStamp* stamp) { return Read(stamp, sizeof(*stamp)); }
+    template <typename T>
+    bool ReadArray(std::vector<T>* values) {
+        uint32_t count;
+        if (!ReadU32(&count) || count > remaining_ / sizeof(T))
+            return false;
+        values->resize(count);
+        return Read(values->data(), count * sizeof(T));
+    }
+
+   private:
+    const uint8_t* data_;
+    size_t remaining_;
+};
+
+void SaveLayerCache(const std::string& cache_path,
+                    const std::vector<CachedSearchPath>& search_paths) {
+    ATRACE_CALL();
+
+    LayerCacheWriter writer;
+    writer.WriteU32(static_cast<uint32_t>(search_paths.size()));
+    for (const auto& search_path : search_paths) {
+        writer.WriteString(search_path.path);
+        writer.WriteStamp(search_path.stamp);
+        writer.WriteU32(static_cast<uint32_t>(search_path.libraries.size()));
+        for (const auto& library : search_path.libraries) {
+            writer.WriteString(library.filename);
+            writer.WriteStamp(library.stamp);
+            writer.WriteU32(static_cast<uint32_t>(library.layers.size()));
+            for (const auto& layer : library.layers) {
+                writer.Write(&layer.properties, sizeof(layer.properties));
+                writer.WriteU32(layer.is_global ? 1 : 0);
+                writer.WriteArray(layer.instance_extensions);
+                writer.WriteArray(layer.device_extensions);
+            }
+        }
+    }
+
+    const std::vector<uint8_t>& payload = writer.buffer();
+    LayerCacheHeader header = {
+        kLayerCacheMagic, kLayerCacheVersion,
+        static_cast<uint32_t>(payload.size()),
+        static_cast<uint32_t>(crc32(0, payload.data(), payload.size()))};
+    std::string contents(reinterpret_cast<const char*>(&header),
+                         sizeof(header));
+    contents.append(reinterpret_cast<const char*>(payload.data()),
+                    payload.size());
+
+    // Replace the cache atomically, so that concurrent readers never see a
+    // partial file.
+    const std::string tmp_path = cache_path + ".tmp";
+    if (!android::base::WriteStringToFile(contents, tmp_path,
+                                          S_IRUSR | S_IWUSR, getuid(),
+                                          getgid()) ||
+        rename(tmp_path.c_str(), cache_path.c_str()) != 0) {
+        ALOGW("failed to write layer cache '%s': %s", cache_path.c_str(),
+              strerror(errno));
+        unlink(tmp_path.c_str());
+    }
+}
+
+// Reads the cache, and checks that it was made for the same search paths and
+// that none of them or their libraries changed since.
+bool LoadLayerCache(const std::string& cache_path,
+                    const std::vector<std::string>& paths,
+                    std::vector<CachedSearchPath>* search_paths) {
+    ATRACE_CALL();
+
+    std::string contents;
+    if (!android::base::ReadFileToString(cache_path, &contents))
+        return false;
+
+    LayerCacheHeader header;
+    if (contents.size() < sizeof(header))
+        return false;
+    memcpy(&header, contents.data(), sizeof(header));
+    const uint8_t* payload =
+        reinterpret_cast<const uint8_t*>(contents.data()) + sizeof(header);
+    if (header.magic != kLayerCacheMagic ||
+        header.version != kLayerCacheVersion ||
+        header.payload_size != contents.size() - sizeof(header) ||
+        header.payload_crc != crc32(0, payload, header.payload_size)) {
+        ALOGW("ignoring invalid layer cache '%s'", cache_path.c_str());
+        return false;
+    }
+
+    LayerCacheReader reader(payload, header.payload_size);
+    uint32_t path_count;
+    if (!reader.ReadU32(&path_count) || path_count != paths.size())
+        return false;
+    search_paths->resize(path_count);
+    for (uint32_t i = 0; i < path_count; i++) {
+        CachedSearchPath& search_path = (*search_paths)[i];
+        FileStamp stamp = {-1, -1};
+        if (!reader.ReadString(&search_path.path) ||
+            search_path.path != paths[i] ||
+            !reader.ReadStamp(&search_path.stamp))
+            return false;
+        GetFileStamp(GetSearchPathFile(search_path.path), &stamp);
+        if (!(stamp == search_path.stamp))
+            return false;
+
+        uint32_t library_count;
+        if (!reader.ReadU32(&library_count))
+            return false;
+        search_path.libraries.resize(library_count);
+        for (auto& library : search_path.libraries) {
+            if (!reader.ReadString(&library.filename) ||
+                !reader.ReadStamp(&library.stamp))
+                return false;
+            if (!IsSearchPathInZip(search_path.path)) {
+                stamp = {-1, -1};
+                GetFileStamp(search_path.path + "/" + library.filename,
+                             &stamp);
+                if (!(stamp == library.stamp))
+                    return false;
+            }
+
+            uint32_t layer_count;
+            if (!reader.ReadU32(&layer_count))
+                return false;
+            for (uint32_t j = 0; j < layer_count; j++) {
+                Layer layer;
+                uint32_t is_global;
+                if (!reader.Read(&layer.properties, sizeof(layer.properties)) ||
+                    !reader.ReadU32(&is_global) ||
+                    !reader.ReadArray(&layer.instance_extensions) ||
+                    !reader.ReadArray(&layer.device_extensions))
+                    return false;
+                layer.is_global = is_global != 0;
+                library.layers.push_back(std::move(layer));
+            }
+        }
+    }
+    return true;
+}
+
+// Adds the layer libraries of a validated cache, in the order they were
+// originally discovered in.
+void AddCachedLayerLibraries(const std::vector<CachedSearchPath>& search_paths) {
+    for (const auto& search_path : search_paths) {
+        for (const auto& library : search_path.libraries) {
+            if (library.layers.empty())
+                continue;
+            for (Layer layer : library.layers) {
+                layer.library_idx = g_layer_libraries.size();
+                ALOGD("added %s layer '%s' from library '%s/%s' (cached)",
+                      (layer.is_global) ? "global" : "instance",
+                      layer.properties.layerName, search_path.path.c_str(),
+                      library.filename.c_str());
+                g_instance_layers.push_back(std::move(layer));
+            }
+            g_layer_libraries.emplace_back(
+                search_path.path + "/" + library.filename, library.filename);
+        }
+    }
 }
 
 template <typename Functor>
@@ -430,11 +707,15 @@ void ForEachFileInPath(const std::string& path, Functor functor) {
     }
 }
 
-void DiscoverLayersInPathList(const std::string& pathstr) {
+void DiscoverLayersInPaths(const std::vector<std::string>& paths,
+                           std::vector<CachedSearchPath>* search_paths) {
     ATRACE_CALL();
 
-    std::vector<std::string> paths = android::base::Split(pathstr, ":");
     for (const auto& path : paths) {
+        search_paths->push_back({path, {-1, -1}, {}});
+        CachedSearchPath& search_path = search_paths->back();
+        GetFileStamp(GetSearchPathFile(path), &search_path.stamp);
+
         ForEachFileInPath(path, [&](const std::string& filename) {
             if (android::base::StartsWith(filename, "libVkLayer") &&
                 android::base::EndsWith(filename, ".so")) {
@@ -455,8 +736,18 @@ void DiscoverLayersInPathList(const std::string& pathstr) {
                     }
                 }
 
-                if (!duplicate)
-                    AddLayerLibrary(path, filename);
+                if (!duplicate) {
+                    CachedLibrary library = {filename, {-1, -1}, {}};
+                    if (!IsSearchPathInZip(path))
+                        GetFileStamp(path + "/" + filename, &library.stamp);
+                    const size_t first_layer = g_instance_layers.size();
+                    if (AddLayerLibrary(path, filename)) {
+                        library.layers.assign(
+                            g_instance_layers.begin() + first_layer,
+                            g_instance_layers.end());
+                    }
+                    search_path.libraries.push_back(std::move(library));
+                }
             }
         });
     }
@@ -484,11 +775,30 @@ void* GetLayerGetProcAddr(const Layer& layer,
 void DiscoverLayers() {
     ATRACE_CALL();
 
+    std::vector<std::string> paths;
     if (android::GraphicsEnv::getInstance().isDebuggable()) {
-        DiscoverLayersInPathList(kSystemLayerLibraryDir);
+        paths.push_back(kSystemLayerLibraryDir);
     }
-    if (!android::GraphicsEnv::getInstance().getLayerPaths().empty())
-        DiscoverLayersInPathList(android::GraphicsEnv::getInstance().getLayerPaths());
+    const std::string& layer_paths =
+        android::GraphicsEnv::getInstance().getLayerPaths();
+    if (!layer_paths.empty()) {
+        for (const auto& path : android::base::Split(layer_paths, ":"))
+            paths.push_back(path);
+    }
+
+    std::vector<CachedSearchPath> search_paths;
+    const std::string& cache_path =
+        android::GraphicsEnv::getInstance().getLayerCachePath();
+    if (!cache_path.empty() &&
+        LoadLayerCache(cache_path, paths, &search_paths)) {
+        AddCachedLayerLibraries(search_paths);
+        return;
+    }
+
+    search_paths.clear();
+    DiscoverLayersInPaths(paths, &search_paths);
+    if (!cache_path.empty())
+        SaveLayerCache(cache_path, search_paths);
 }
 
 uint32_t GetLayerCount() {
@@ -0,0 +1,141 @@
+/*
+ * Copyright 2019 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#define ATRACE_TAG ATRACE_TAG_GRAPHICS
+
+#include "predequeuer.h"
+
+#include <errno.h>
+#include <log/log.h>
+#include <pthread.h>
+#include <string.h>
+#include <sync/sync.h>
+#include <unistd.h>
+#include <utils/Errors.h>
+#include <utils/Trace.h>
+
+#include <thread>
+
+namespace vulkan {
+namespace driver {
+
+std::shared_ptr<Predequeuer> Predequeuer::Start(
+    const android::sp<ANativeWindow>& window,
+    uint32_t max_dequeued) {
+    auto predequeuer = std::make_shared<Predequeuer>(window, max_dequeued);
+    std::thread([predequeuer] { predequeuer->ThreadMain(); }).detach();
+    return predequeuer;
+}
+
+int Predequeuer::Take(Buffer* buffer) {
+    ATRACE_CALL();
+    std::unique_lock<std::mutex> lock(mutex_);
+    for (;;) {
+        if (!ready_.empty()) {
+            *buffer = ready_.front();
+            ready_.pop_front();
+            cond_.notify_all();
+            return 0;
+        }
+        if (error_ != 0) {
+            // Report each failure once; the next Take tries again.
+            int err = error_;
+            error_ = 0;
+            cond_.notify_all();
+            return err;
+        }
+        // The application holds every buffer it may dequeue, which
+        // dequeueBuffer would refuse too.
+        if (stopped_ || (!dequeueing_ && dequeued_ >= max_dequeued_))
+            return android::INVALID_OPERATION;
+        cond_.wait(lock);
+    }
+}
+
+void Predequeuer::Returned() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    dequeued_--;
+    cond_.notify_all();
+}
+
+void Predequeuer::Stop() {
+    std::deque<Buffer> ready;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stopped_ = true;
+        ready.swap(ready_);
+        dequeued_ -= static_cast<uint32_t>(ready.size());
+        cond_.notify_all();
+    }
+    for (const Buffer& buffer : ready)
+        Cancel(buffer);
+}
+
+void Predequeuer::ThreadMain() {
+    pthread_setname_np(pthread_self(), "VkPredequeue");
+
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (!stopped_) {
+        if (error_ != 0 || !ready_.empty() || dequeued_ >= max_dequeued_) {
+            cond_.wait(lock);
+            continue;
+        }
+        dequeued_++;
+        dequeueing_ = true;
+        lock.unlock();
+
+        Buffer buffer = {nullptr, -1, -1};
+        int err;
+        {
+            ATRACE_NAME("predequeueBuffer");
+            err = window_->dequeueBuffer(window_.get(), &buffer.buffer,
+                                         &buffer.fence);
+        }
+        if (err == 0 && buffer.fence != -1) {
+            buffer.fence_clone = dup(buffer.fence);
+            if (buffer.fence_clone == -1) {
+                ALOGE("dup(fence) failed, stalling until signalled: %s (%d)",
+                      strerror(errno), errno);
+                sync_wait(buffer.fence, -1 /* forever */);
+            }
+        }
+
+        lock.lock();
+        dequeueing_ = false;
+        if (err != 0) {
+            // Reported by the next Take.
+            dequeued_--;
+            error_ = err;
+        } else if (stopped_) {
+            dequeued_--;
+            lock.unlock();
+            Cancel(buffer);
+            lock.lock();
+        } else {
+            ready_.push_back(buffer);
+        }
+        cond_.notify_all();
+    }
+}
+
+void Predequeuer::Cancel(const Buffer& buffer) {
+    window_->cancelBuffer(window_.get(), buffer.buffer, buffer.fence);
+    if (buffer.fence_clone != -1)
+        close(buffer.fence_clone);
+}
+
+}  // namespace driver
+}  // namespace vulkan
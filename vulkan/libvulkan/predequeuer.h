@@ -0,0 +1,90 @@
+/*
+ * Copyright 2019 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef LIBVULKAN_PREDEQUEUER_H
+#define LIBVULKAN_PREDEQUEUER_H 1
+
+#include <system/window.h>
+#include <utils/StrongPointer.h>
+
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+
+namespace vulkan {
+namespace driver {
+
+// Predequeuer keeps a buffer dequeued from the window ahead of
+// vkAcquireNextImageKHR, so that acquiring an image takes a buffer that is
+// already dequeued instead of waiting in dequeueBuffer, and the dequeue fence
+// is duplicated off the application's thread too.
+//
+// Once started it makes every dequeue of the swapchain, so that the buffers
+// it holds and the buffers the application holds never exceed the number of
+// buffers that may be dequeued at once.  Its thread may be blocked in
+// dequeueBuffer when the swapchain goes away, so the thread shares ownership
+// of it and returns any buffer it gets after being stopped by itself.
+class Predequeuer {
+   public:
+    struct Buffer {
+        ANativeWindowBuffer* buffer;
+        // The dequeue fence, and a duplicate of it which is handed to the
+        // driver; both are owned by whoever holds the buffer.
+        int fence;
+        int fence_clone;
+    };
+
+    static std::shared_ptr<Predequeuer> Start(
+        const android::sp<ANativeWindow>& window,
+        uint32_t max_dequeued);
+
+    Predequeuer(const android::sp<ANativeWindow>& window, uint32_t max_dequeued)
+        : window_(window), max_dequeued_(max_dequeued) {}
+
+    // Takes the next dequeued buffer, waiting for the thread to dequeue one if
+    // none is ready yet.  Returns 0, or the error dequeueBuffer failed with.
+    int Take(Buffer* buffer);
+
+    // Called when a buffer returned by Take is queued or cancelled.
+    void Returned();
+
+    // Stops dequeueing buffers, and cancels the ones not taken yet.
+    void Stop();
+
+   private:
+    void ThreadMain();
+    void Cancel(const Buffer& buffer);
+
+    const android::sp<ANativeWindow> window_;
+    const uint32_t max_dequeued_;
+
+    std::mutex mutex_;
+    std::condition_variable cond_;
+    // Buffers dequeued by the thread and not taken yet.
+    std::deque<Buffer> ready_;
+    // Buffers dequeued by the thread and not queued or cancelled yet,
+    // including the one the thread may be dequeueing.
+    uint32_t dequeued_ = 0;
+    bool dequeueing_ = false;
+    int error_ = 0;
+    bool stopped_ = false;
+};
+
+}  // namespace driver
+}  // namespace vulkan
+
+#endif  // LIBVULKAN_PREDEQUEUER_H
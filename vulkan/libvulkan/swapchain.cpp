@@ -17,20 +17,26 @@
 #define ATRACE_TAG ATRACE_TAG_GRAPHICS
 
 #include <android/hardware/graphics/common/1.0/types.h>
+#include <cutils/properties.h>
 #include <grallocusage/GrallocUsageConversion.h>
 #include <log/log.h>
 #include <sync/sync.h>
 #include <system/window.h>
 #include <ui/BufferQueueDefs.h>
+#include <utils/Errors.h>
 #include <utils/StrongPointer.h>
+#include <utils/Timers.h>
 #include <utils/Trace.h>
 #include <utils/Vector.h>
 
 #include <algorithm>
+#include <deque>
+#include <memory>
 #include <unordered_set>
 #include <vector>
 
 #include "driver.h"
+#include "predequeuer.h"
 
 using android::hardware::graphics::common::V1_0::BufferUsage;
 
@@ -217,6 +223,75 @@ Surface* SurfaceFromHandle(VkSurfaceKHR handle) {
     return reinterpret_cast<Surface*>(handle);
 }
 
+// FramePacer chooses the desired present time of frames the application does
+// not time itself with VK_GOOGLE_display_timing, so that they are displayed
+// at a steady rate.  It measures the rate the application queues frames at,
+// rounds its period up to a whole number of refresh cycles, and schedules
+// each frame that many refresh cycles after the previous one, counting from
+// the last frame the display timestamps show as presented.
+class FramePacer {
+   public:
+    // Returns the desired present time for the frame about to be queued with
+    // native frame ID frame_id, or 0 while too little history is known.
+    int64_t NextPresentTime(ANativeWindow* window,
+                            uint64_t frame_id,
+                            int64_t refresh_duration) {
+        const int64_t now = systemTime(SYSTEM_TIME_MONOTONIC);
+
+        for (Frame& frame : frames_) {
+            if (frame.actual_present_time != NATIVE_WINDOW_TIMESTAMP_PENDING)
+                continue;
+            int64_t actual_present_time = 0;
+            int ret = native_window_get_frame_timestamps(
+                window, frame.id, nullptr, nullptr, nullptr, nullptr, nullptr,
+                nullptr, &actual_present_time, nullptr, nullptr);
+            if (ret == android::NO_ERROR)
+                frame.actual_present_time = actual_present_time;
+        }
+
+        int64_t desired_present_time = 0;
+        if (frames_.size() == kHistory && refresh_duration > 0) {
+            // Frames are scheduled on a whole number of refresh cycles,
+            // allowing a little jitter before rounding up.
+            const int64_t frame_duration =
+                (now - frames_.front().queue_time) / kHistory;
+            const int64_t cycles = std::max<int64_t>(
+                1, (frame_duration - refresh_duration / 10 +
+                    refresh_duration - 1) /
+                       refresh_duration);
+
+            // Schedule relative to the last frame known to be presented, one
+            // interval per frame queued since then.
+            int64_t frames_since = 1;
+            for (auto it = frames_.rbegin(); it != frames_.rend(); ++it) {
+                if (it->actual_present_time > 0) {
+                    desired_present_time =
+                        it->actual_present_time +
+                        frames_since * cycles * refresh_duration;
+                    break;
+                }
+                frames_since++;
+            }
+        }
+
+        frames_.push_back({frame_id, now, NATIVE_WINDOW_TIMESTAMP_PENDING});
+        if (frames_.size() > kHistory)
+            frames_.pop_front();
+        return desired_present_time;
+    }
+
+   private:
+    // Number of frames the application's frame rate is measured over.
+    static constexpr size_t kHistory = 8;
+
+    struct Frame {
+        uint64_t id;
+        int64_t queue_time;
+        int64_t actual_present_time;
+    };
+    std::deque<Frame> frames_;
+};
+
 // Maximum number of TimingInfo structs to keep per swapchain:
 enum { MAX_TIMING_INFOS = 10 };
 // Minimum number of frames to look for in the past (so we don't cause
@@ -271,6 +346,14 @@ struct Swapchain {
     } images[android::BufferQueueDefs::NUM_BUFFER_SLOTS];
 
     android::Vector<TimingInfo> timing;
+
+    // Dequeues buffers ahead of vkAcquireNextImageKHR when the
+    // ro.vulkan.swapchain_predequeue property is set; null otherwise.
+    std::shared_ptr<Predequeuer> predequeuer;
+
+    // Paces frames presented without VkPresentTimeGOOGLE when the
+    // ro.vulkan.swapchain_pacing property is set; null otherwise.
+    std::unique_ptr<FramePacer> pacer;
 };
 
 VkSwapchainKHR HandleFromSwapchain(Swapchain* swapchain) {
@@ -333,6 +416,8 @@ void ReleaseSwapchainImage(VkDevice device,
 void OrphanSwapchain(VkDevice device, Swapchain* swapchain) {
     if (swapchain->surface.swapchain_handle != HandleFromSwapchain(swapchain))
         return;
+    if (swapchain->predequeuer)
+        swapchain->predequeuer->Stop();
     for (uint32_t i = 0; i < swapchain->num_images; i++) {
         if (!swapchain->images[i].dequeued)
             ReleaseSwapchainImage(device, nullptr, -1, swapchain->images[i]);
@@ -1370,6 +1455,17 @@ VkResult CreateSwapchainKHR(VkDevice device,
         return result;
     }
 
+    if (!swapchain->shared &&
+        property_get_bool("ro.vulkan.swapchain_predequeue", false)) {
+        swapchain->predequeuer = Predequeuer::Start(
+            surface.window, num_images - min_undequeued_buffers);
+    }
+    // Pacing only makes sense when every frame is displayed.
+    if (create_info->presentMode == VK_PRESENT_MODE_FIFO_KHR &&
+        property_get_bool("ro.vulkan.swapchain_pacing", false)) {
+        swapchain->pacer = std::make_unique<FramePacer>();
+    }
+
     surface.swapchain_handle = HandleFromSwapchain(swapchain);
     *swapchain_handle = surface.swapchain_handle;
     return VK_SUCCESS;
@@ -1391,6 +1487,8 @@ void DestroySwapchainKHR(VkDevice device,
     if (swapchain->frame_timestamps_enabled) {
         native_window_enable_frame_timestamps(window, false);
     }
+    if (swapchain->predequeuer)
+        swapchain->predequeuer->Stop();
     for (uint32_t i = 0; i < swapchain->num_images; i++)
         ReleaseSwapchainImage(device, window, -1, swapchain->images[i]);
     if (active)
@@ -1462,7 +1560,16 @@ VkResult AcquireNextImageKHR(VkDevice device,
 
     ANativeWindowBuffer* buffer;
     int fence_fd;
-    err = window->dequeueBuffer(window, &buffer, &fence_fd);
+    int fence_clone = -1;
+    if (swapchain.predequeuer) {
+        Predequeuer::Buffer predequeued;
+        err = swapchain.predequeuer->Take(&predequeued);
+        buffer = predequeued.buffer;
+        fence_fd = predequeued.fence;
+        fence_clone = predequeued.fence_clone;
+    } else {
+        err = window->dequeueBuffer(window, &buffer, &fence_fd);
+    }
     if (err != 0) {
         // TODO(jessehall): Improve error reporting. Can we enumerate possible
         // errors and translate them to valid Vulkan result codes?
@@ -1481,11 +1588,15 @@ VkResult AcquireNextImageKHR(VkDevice device,
     if (idx == swapchain.num_images) {
         ALOGE("dequeueBuffer returned unrecognized buffer");
         window->cancelBuffer(window, buffer, fence_fd);
+        if (fence_clone != -1)
+            close(fence_clone);
+        if (swapchain.predequeuer)
+            swapchain.predequeuer->Returned();
         return VK_ERROR_OUT_OF_DATE_KHR;
     }
 
-    int fence_clone = -1;
-    if (fence_fd != -1) {
+    // The predequeuer has already duplicated the fence.
+    if (fence_fd != -1 && !swapchain.predequeuer) {
         fence_clone = dup(fence_fd);
         if (fence_clone == -1) {
             ALOGE("dup(fence) failed, stalling until signalled: %s (%d)",
@@ -1507,6 +1618,8 @@ VkResult AcquireNextImageKHR(VkDevice device,
         window->cancelBuffer(window, buffer, fence_fd);
         swapchain.images[idx].dequeued = false;
         swapchain.images[idx].dequeue_fence = -1;
+        if (swapchain.predequeuer)
+            swapchain.predequeuer->Returned();
         return result;
     }
 
@@ -1694,6 +1807,32 @@ VkResult QueuePresentKHR(VkQueue queue, const VkPresentInfoKHR* present_info) {
                             window,
                             static_cast<int64_t>(time->desiredPresentTime));
                     }
+                } else if (swapchain.pacer) {
+                    if (!swapchain.frame_timestamps_enabled) {
+                        native_window_enable_frame_timestamps(window, true);
+                        swapchain.frame_timestamps_enabled = true;
+                    }
+
+                    uint64_t nativeFrameId = 0;
+                    err = native_window_get_next_frame_id(
+                            window, &nativeFrameId);
+                    if (err == android::NO_ERROR) {
+                        int64_t desired_present_time =
+                            swapchain.pacer->NextPresentTime(
+                                window, nativeFrameId,
+                                swapchain.refresh_duration);
+                        // The window keeps the timestamp for later frames,
+                        // so frames that are not paced need it reset.
+                        if (desired_present_time) {
+                            ATRACE_INT64("vkPacedPresentDelay",
+                                         desired_present_time -
+                                             systemTime(SYSTEM_TIME_MONOTONIC));
+                        } else {
+                            desired_present_time = NATIVE_WINDOW_TIMESTAMP_AUTO;
+                        }
+                        native_window_set_buffers_timestamp(
+                            window, desired_present_time);
+                    }
                 }
 
                 err = window->queueBuffer(window, img.buffer.get(), fence);
@@ -1710,6 +1849,8 @@ VkResult QueuePresentKHR(VkQueue queue, const VkPresentInfoKHR* present_info) {
                     img.dequeue_fence = -1;
                 }
                 img.dequeued = false;
+                if (swapchain.predequeuer)
+                    swapchain.predequeuer->Returned();
 
                 // If the swapchain is in shared mode, immediately dequeue the
                 // buffer so it can be presented again without an intervening
@@ -0,0 +1,311 @@
+/*
+ * Copyright 2019 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <utils/Errors.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <set>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "../predequeuer.h"
+
+namespace vulkan {
+namespace driver {
+namespace {
+
+const auto kTimeout = std::chrono::seconds(5);
+
+// A window handing out a fixed set of buffers, which counts how many are
+// dequeued at once.  Dequeues block while the window is paused or every
+// buffer is dequeued, like BufferQueue's do.
+class FakeWindow : public ANativeWindow {
+   public:
+    explicit FakeWindow(size_t buffer_count) : buffers_(buffer_count) {
+        common.incRef = IncRef;
+        common.decRef = DecRef;
+        ANativeWindow::dequeueBuffer = DequeueBuffer;
+        ANativeWindow::cancelBuffer = CancelBuffer;
+    }
+
+    // Makes the next dequeue fail with err instead of returning a buffer.
+    void FailNextDequeue(int err) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        next_error_ = err;
+    }
+
+    // Makes dequeues return a fence.
+    void UseFences() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        use_fences_ = true;
+    }
+
+    void SetPaused(bool paused) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        paused_ = paused;
+        cond_.notify_all();
+    }
+
+    // Stands in for queueBuffer: the buffer goes back to the window.
+    void Queue(ANativeWindowBuffer* buffer) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        ASSERT_EQ(1u, dequeued_.erase(buffer));
+        cond_.notify_all();
+    }
+
+    // Waits until a dequeue is blocked in the window, or the given number of
+    // buffers are dequeued.
+    bool WaitForBlockedDequeue() {
+        std::unique_lock<std::mutex> lock(mutex_);
+        return cond_.wait_for(lock, kTimeout, [this] { return blocked_; });
+    }
+    bool WaitForDequeued(size_t count) {
+        std::unique_lock<std::mutex> lock(mutex_);
+        return cond_.wait_for(lock, kTimeout,
+                              [&] { return dequeued_.size() == count; });
+    }
+    bool WaitForCancelled(size_t count) {
+        std::unique_lock<std::mutex> lock(mutex_);
+        return cond_.wait_for(lock, kTimeout,
+                              [&] { return cancelled_ == count; });
+    }
+
+    size_t dequeued() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return dequeued_.size();
+    }
+    size_t max_dequeued() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return max_dequeued_;
+    }
+    size_t cancelled() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return cancelled_;
+    }
+
+   private:
+    static FakeWindow* From(android_native_base_t* base) {
+        return static_cast<FakeWindow*>(reinterpret_cast<ANativeWindow*>(base));
+    }
+    static FakeWindow* From(ANativeWindow* window) {
+        return static_cast<FakeWindow*>(window);
+    }
+
+    static void IncRef(android_native_base_t* base) { From(base)->refs_++; }
+    static void DecRef(android_native_base_t* base) {
+        FakeWindow* window = From(base);
+        if (--window->refs_ == 0)
+            delete window;
+    }
+
+    static int DequeueBuffer(ANativeWindow* window,
+                             ANativeWindowBuffer** buffer,
+                             int* fence) {
+        return From(window)->Dequeue(buffer, fence);
+    }
+    static int CancelBuffer(ANativeWindow* window,
+                            ANativeWindowBuffer* buffer,
+                            int fence) {
+        return From(window)->Cancel(buffer, fence);
+    }
+
+    int Dequeue(ANativeWindowBuffer** buffer, int* fence) {
+        std::unique_lock<std::mutex> lock(mutex_);
+        if (next_error_ != 0) {
+            int err = next_error_;
+            next_error_ = 0;
+            return err;
+        }
+        blocked_ = true;
+        cond_.notify_all();
+        cond_.wait(lock, [this] {
+            return !paused_ && dequeued_.size() < buffers_.size();
+        });
+        blocked_ = false;
+        for (ANativeWindowBuffer& b : buffers_) {
+            if (dequeued_.insert(&b).second) {
+                *buffer = &b;
+                break;
+            }
+        }
+        max_dequeued_ = std::max(max_dequeued_, dequeued_.size());
+        *fence = use_fences_ ? open("/dev/null", O_RDONLY | O_CLOEXEC) : -1;
+        cond_.notify_all();
+        return 0;
+    }
+
+    int Cancel(ANativeWindowBuffer* buffer, int fence) {
+        if (fence != -1)
+            close(fence);
+        std::lock_guard<std::mutex> lock(mutex_);
+        EXPECT_EQ(1u, dequeued_.erase(buffer));
+        cancelled_++;
+        cond_.notify_all();
+        return 0;
+    }
+
+    std::atomic<int> refs_{0};
+    std::vector<ANativeWindowBuffer> buffers_;
+
+    std::mutex mutex_;
+    std::condition_variable cond_;
+    std::set<ANativeWindowBuffer*> dequeued_;
+    size_t max_dequeued_ = 0;
+    size_t cancelled_ = 0;
+    int next_error_ = 0;
+    bool use_fences_ = false;
+    bool paused_ = false;
+    bool blocked_ = false;
+};
+
+class PredequeuerTest : public ::testing::Test {
+   protected:
+    static constexpr uint32_t kBufferCount = 3;
+    static constexpr uint32_t kMaxDequeued = 2;
+
+    void SetUp() override { window_ = new FakeWindow(kBufferCount); }
+
+    void TearDown() override {
+        if (predequeuer_)
+            predequeuer_->Stop();
+    }
+
+    void Start() { predequeuer_ = Predequeuer::Start(window_, kMaxDequeued); }
+
+    // Queues a buffer taken from the predequeuer back to the window.
+    void Present(const Predequeuer::Buffer& buffer) {
+        window_->Queue(buffer.buffer);
+        if (buffer.fence != -1)
+            close(buffer.fence);
+        if (buffer.fence_clone != -1)
+            close(buffer.fence_clone);
+        predequeuer_->Returned();
+    }
+
+    android::sp<FakeWindow> window_;
+    std::shared_ptr<Predequeuer> predequeuer_;
+};
+
+TEST_F(PredequeuerTest, TakesBuffersDequeuedAhead) {
+    Start();
+    ASSERT_TRUE(window_->WaitForDequeued(1));
+
+    Predequeuer::Buffer first;
+    ASSERT_EQ(0, predequeuer_->Take(&first));
+    Predequeuer::Buffer second;
+    ASSERT_EQ(0, predequeuer_->Take(&second));
+    EXPECT_NE(first.buffer, second.buffer);
+    EXPECT_EQ(-1, first.fence_clone);
+
+    Present(first);
+    Present(second);
+}
+
+TEST_F(PredequeuerTest, DuplicatesDequeueFence) {
+    window_->UseFences();
+    Start();
+
+    Predequeuer::Buffer buffer;
+    ASSERT_EQ(0, predequeuer_->Take(&buffer));
+    ASSERT_NE(-1, buffer.fence);
+    ASSERT_NE(-1, buffer.fence_clone);
+    EXPECT_NE(buffer.fence, buffer.fence_clone);
+    EXPECT_NE(-1, fcntl(buffer.fence_clone, F_GETFD));
+
+    Present(buffer);
+}
+
+TEST_F(PredequeuerTest, TakePastDequeueLimitFails) {
+    Start();
+
+    Predequeuer::Buffer buffers[kMaxDequeued];
+    for (Predequeuer::Buffer& buffer : buffers)
+        ASSERT_EQ(0, predequeuer_->Take(&buffer));
+
+    // Like dequeueBuffer, refuse rather than block while the application
+    // holds every buffer it may dequeue.
+    Predequeuer::Buffer extra;
+    EXPECT_EQ(android::INVALID_OPERATION, predequeuer_->Take(&extra));
+
+    Present(buffers[0]);
+    ASSERT_EQ(0, predequeuer_->Take(&extra));
+    Present(extra);
+    Present(buffers[1]);
+}
+
+TEST_F(PredequeuerTest, NeverDequeuesPastLimit) {
+    Start();
+
+    for (int i = 0; i < 100; i++) {
+        Predequeuer::Buffer buffer;
+        ASSERT_EQ(0, predequeuer_->Take(&buffer));
+        Present(buffer);
+    }
+    EXPECT_LE(window_->max_dequeued(), kMaxDequeued);
+}
+
+TEST_F(PredequeuerTest, ReportsDequeueErrorOnce) {
+    window_->FailNextDequeue(-EBUSY);
+    Start();
+
+    Predequeuer::Buffer buffer;
+    EXPECT_EQ(-EBUSY, predequeuer_->Take(&buffer));
+    ASSERT_EQ(0, predequeuer_->Take(&buffer));
+    Present(buffer);
+}
+
+TEST_F(PredequeuerTest, StopCancelsUntakenBuffers) {
+    Start();
+
+    Predequeuer::Buffer taken;
+    ASSERT_EQ(0, predequeuer_->Take(&taken));
+    ASSERT_TRUE(window_->WaitForDequeued(kMaxDequeued));
+
+    predequeuer_->Stop();
+    EXPECT_TRUE(window_->WaitForCancelled(1));
+    EXPECT_EQ(1u, window_->dequeued());
+
+    Predequeuer::Buffer buffer;
+    EXPECT_EQ(android::INVALID_OPERATION, predequeuer_->Take(&buffer));
+    Present(taken);
+}
+
+TEST_F(PredequeuerTest, StopWhileDequeueBlocked) {
+    window_->SetPaused(true);
+    Start();
+    ASSERT_TRUE(window_->WaitForBlockedDequeue());
+
+    predequeuer_->Stop();
+    predequeuer_.reset();
+    EXPECT_EQ(0u, window_->cancelled());
+
+    // The thread cancels the buffer it gets after being stopped by itself.
+    window_->SetPaused(false);
+    EXPECT_TRUE(window_->WaitForCancelled(1));
+    EXPECT_EQ(0u, window_->dequeued());
+}
+
+}  // namespace
+}  // namespace driver
+}  // namespace vulkan